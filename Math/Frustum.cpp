@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// View frustum and bounding sphere, used to skip rendering things that are off screen
+//--------------------------------------------------------------------------------------
+
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Bounding sphere
+-----------------------------------------------------------------------------------------*/
+
+// Return the sphere moved into the space given by a matrix
+BoundingSphere BoundingSphere::Transformed(const Matrix4x4& m) const
+{
+	if (IsEmpty())  return *this;
+
+	Vector4 worldCentre = m.TransformPoint(centre);
+	float maxScale = std::max({ m.XAxis().Length(), m.YAxis().Length(), m.ZAxis().Length() });
+	return { { worldCentre.x, worldCentre.y, worldCentre.z }, radius * maxScale };
+}
+
+
+// Grow this sphere to enclose another one as well
+void BoundingSphere::Merge(const BoundingSphere& other)
+{
+	if (other.IsEmpty())  return;
+	if (IsEmpty())
+	{
+		*this = other;
+		return;
+	}
+
+	Vector3 offset = other.centre - centre;
+	float distance = offset.Length();
+	if (distance + other.radius <= radius)  return; // Other sphere is already inside this one
+	if (distance + radius <= other.radius)  // This sphere is inside the other one
+	{
+		*this = other;
+		return;
+	}
+
+	// New sphere spans from the far side of this sphere to the far side of the other one
+	float newRadius = (distance + radius + other.radius) * 0.5f;
+	centre += offset * ((newRadius - radius) / distance);
+	radius  = newRadius;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Frustum
+-----------------------------------------------------------------------------------------*/
+
+// Extract the frustum planes from a view-projection matrix. Points are row vectors multiplied on the left of the matrix, so
+// clip space x, y, z and w are the dot products of the point with the matrix columns. For example the left plane is x >= -w,
+// i.e. (column 0 + column 3) . p >= 0
+Frustum::Frustum(const Matrix4x4& m)
+{
+	auto makePlane = [](float a, float b, float c, float d)
+	{
+		float length = std::sqrt(a * a + b * b + c * c);
+		return Plane{ { a / length, b / length, c / length }, d / length };
+	};
+
+	mPlanes[0] = makePlane(m.e03 + m.e00, m.e13 + m.e10, m.e23 + m.e20, m.e33 + m.e30); // Left
+	mPlanes[1] = makePlane(m.e03 - m.e00, m.e13 - m.e10, m.e23 - m.e20, m.e33 - m.e30); // Right
+	mPlanes[2] = makePlane(m.e03 + m.e01, m.e13 + m.e11, m.e23 + m.e21, m.e33 + m.e31); // Bottom
+	mPlanes[3] = makePlane(m.e03 - m.e01, m.e13 - m.e11, m.e23 - m.e21, m.e33 - m.e31); // Top
+	mPlanes[4] = makePlane(m.e02,         m.e12,         m.e22,         m.e32);         // Near (DirectX clip z starts at 0)
+	mPlanes[5] = makePlane(m.e03 - m.e02, m.e13 - m.e12, m.e23 - m.e22, m.e33 - m.e32); // Far
+}
+
+
+// Returns false if the sphere is certainly outside the frustum, true if it may be visible
+bool Frustum::IsSphereVisible(const BoundingSphere& sphere) const
+{
+	if (sphere.IsEmpty())  return false;
+
+	for (auto& plane : mPlanes)
+	{
+		if (Dot(plane.normal, sphere.centre) + plane.distance < -sphere.radius)  return false;
+	}
+	return true;
+}
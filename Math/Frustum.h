@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------
+// View frustum and bounding sphere, used to skip rendering things that are off screen
+//--------------------------------------------------------------------------------------
+// The frustum is the volume a camera can see, bounded by six planes (left, right, bottom, top, near and far). The planes are
+// extracted directly from a view-projection matrix: a point is visible if after multiplying by the matrix its x, y and z
+// are within the clip volume (-w <= x <= w, -w <= y <= w, 0 <= z <= w for DirectX), and each of those six inequalities is a
+// plane in world space made from the columns of the matrix.
+//
+// A sphere is tested against the planes one at a time. It is off screen if it is entirely on the outside of any plane. The
+// test is conservative: a sphere near a corner of the frustum may be outside without being outside any single plane, which
+// just means it is rendered when it didn't need to be
+//
+//   Frustum frustum = camera->GetFrustum();
+//   if (frustum.IsSphereVisible(mesh.BoundingSphere().Transformed(entityMatrix)))  ...
+
+#ifndef _FRUSTUM_H_INCLUDED_
+#define _FRUSTUM_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Vector4.h"
+#include "Matrix4x4.h"
+
+
+// Sphere enclosing some geometry. A negative radius indicates there is no geometry, which is never visible
+struct BoundingSphere
+{
+	Vector3 centre = { 0, 0, 0 };
+	float   radius = -1.0f;
+
+	bool IsEmpty() const  { return radius < 0.0f; }
+
+	// Return the sphere moved into the space given by a matrix. The radius is scaled by the largest scale in the matrix so the
+	// result still encloses the geometry if the scaling is not uniform
+	BoundingSphere Transformed(const Matrix4x4& m) const;
+
+	// Grow this sphere to enclose another one as well
+	void Merge(const BoundingSphere& other);
+};
+
+
+class Frustum
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Extract the frustum planes from a view-projection matrix (see Camera::GetViewProjectionMatrix)
+	explicit Frustum(const Matrix4x4& viewProjection);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Tests
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Returns false if the sphere is certainly outside the frustum, true if it may be visible. Empty spheres are never visible
+	bool IsSphereVisible(const BoundingSphere& sphere) const;
+
+	// One of the six planes as (normal.x, normal.y, normal.z, distance), for the same test in a shader (see GpuCuller.h)
+	Vector4 PlaneVector(unsigned int plane) const  { return { mPlanes[plane].normal, mPlanes[plane].distance }; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Each plane is the normal (pointing into the frustum) and distance: a point p is inside the plane if Dot(normal, p) + distance >= 0
+	// Normals are unit length so the same expression gives the distance of a sphere centre from the plane
+	struct Plane
+	{
+		Vector3 normal;
+		float   distance;
+	};
+	Plane mPlanes[6];
+};
+
+
+#endif //_FRUSTUM_H_INCLUDED_
@@ -3,25 +3,106 @@
 //--------------------------------------------------------------------------------------
 
 #include "MathHelpers.h"
+#include "Random.h"
+
+#include <emmintrin.h> // SSE2, always available on x64
+
 
 /*-----------------------------------------------------------------------------------------
-	Float work
+	Fast approximate trig
 -----------------------------------------------------------------------------------------*/
 
-// Test if a float value is approximately 0
-// Epsilon value is the range around zero that is considered equal to zero
-const float EPSILON32 = 0.5e-6f; // For 32-bit floats, requires zero to 6 decimal places
-template<> bool IsZero<float>(const float x)
+// Each function is the matching single value version in MathHelpers.h written for four values at once, with the branches
+// replaced by selecting between results using comparison masks. Leftover values at the end use the single value versions
+namespace
+{
+	inline __m128 Select(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+	}
+
+	const __m128 SIGN_BIT = _mm_set1_ps(-0.0f);
+	const __m128 PI       = _mm_set1_ps(std::numbers::pi_v<float>);
+	const __m128 HALF_PI  = _mm_set1_ps(std::numbers::pi_v<float> / 2);
+
+	__m128 WithoutTurns4(__m128 x)
+	{
+		// Round away from zero then truncate, as the single value version does
+		__m128 half  = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(x, SIGN_BIT));
+		__m128 turns = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(0.5f / std::numbers::pi_v<float>)), half);
+		turns = _mm_cvtepi32_ps(_mm_cvttps_epi32(turns));
+		return _mm_sub_ps(_mm_sub_ps(x, _mm_mul_ps(turns, _mm_set1_ps(6.28125f))), _mm_mul_ps(turns, _mm_set1_ps(1.9353071795864769e-3f)));
+	}
+
+	__m128 SinPolynomial4(__m128 r)
+	{
+		__m128 r2 = _mm_mul_ps(r, r);
+		__m128 p = _mm_mul_ps(r2, _mm_set1_ps(-2.5052108e-8f));
+		p = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(2.7557319e-6f), p));
+		p = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(-1.9841270e-4f), p));
+		p = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(8.3333333e-3f), p));
+		p = _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(-1.6666667e-1f), p));
+		return _mm_mul_ps(r, _mm_add_ps(_mm_set1_ps(1.0f), p));
+	}
+
+	__m128 FastSin4(__m128 x)
+	{
+		__m128 r = WithoutTurns4(x);
+		__m128 negR = _mm_xor_ps(r, SIGN_BIT);
+		r = Select(_mm_cmpgt_ps(r, HALF_PI), _mm_sub_ps(PI, r), Select(_mm_cmpgt_ps(negR, HALF_PI), _mm_sub_ps(_mm_xor_ps(PI, SIGN_BIT), r), r));
+		return SinPolynomial4(r);
+	}
+
+	__m128 FastCos4(__m128 x)
+	{
+		return SinPolynomial4(_mm_sub_ps(HALF_PI, _mm_andnot_ps(SIGN_BIT, WithoutTurns4(x))));
+	}
+
+	__m128 FastAtan24(__m128 y, __m128 x)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		__m128 ax = _mm_andnot_ps(SIGN_BIT, x);
+		__m128 ay = _mm_andnot_ps(SIGN_BIT, y);
+		__m128 maxXY = _mm_max_ps(ax, ay);
+		__m128 both0 = _mm_cmpeq_ps(maxXY, zero);
+
+		// Divide by 1 where x and y are both 0, the result there is replaced by 0 at the end
+		__m128 t  = _mm_div_ps(_mm_min_ps(ax, ay), Select(both0, _mm_set1_ps(1.0f), maxXY));
+		__m128 t2 = _mm_mul_ps(t, t);
+		__m128 p = _mm_mul_ps(t2, _mm_set1_ps(-0.01172120f));
+		p = _mm_mul_ps(t2, _mm_add_ps(_mm_set1_ps(0.05265332f), p));
+		p = _mm_mul_ps(t2, _mm_add_ps(_mm_set1_ps(-0.11643287f), p));
+		p = _mm_mul_ps(t2, _mm_add_ps(_mm_set1_ps(0.19354346f), p));
+		p = _mm_mul_ps(t2, _mm_add_ps(_mm_set1_ps(-0.33262347f), p));
+		__m128 r = _mm_mul_ps(t, _mm_add_ps(_mm_set1_ps(0.99997726f), p));
+
+		r = Select(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(HALF_PI, r), r);
+		r = Select(_mm_cmplt_ps(x, zero), _mm_sub_ps(PI, r), r);
+		r = Select(_mm_cmplt_ps(y, zero), _mm_xor_ps(r, SIGN_BIT), r);
+		return _mm_andnot_ps(both0, r);
+	}
+}
+
+
+void FastSin(const float* angles, float* out, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)  _mm_storeu_ps(out + i, FastSin4(_mm_loadu_ps(angles + i)));
+	for (; i < count; ++i)  out[i] = FastSin(angles[i]);
+}
+
+void FastCos(const float* angles, float* out, size_t count)
 {
-	return std::abs(x) < EPSILON32;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)  _mm_storeu_ps(out + i, FastCos4(_mm_loadu_ps(angles + i)));
+	for (; i < count; ++i)  out[i] = FastCos(angles[i]);
 }
 
-// Test if a double value is approximately 0
-// Epsilon value is the range around zero that is considered equal to zero
-const double EPSILON64 = 0.5e-15; // For 64-bit floats, requires zero to 15 decimal places
-template<> bool IsZero<double>(const double x)
+void FastAtan2(const float* y, const float* x, float* out, size_t count)
 {
-	return std::abs(x) < EPSILON64;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)  _mm_storeu_ps(out + i, FastAtan24(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+	for (; i < count; ++i)  out[i] = FastAtan2(y[i], x[i]);
 }
 
 
@@ -29,29 +110,19 @@ template<> bool IsZero<double>(const double x)
 	Random numbers
 -----------------------------------------------------------------------------------------*/
 
-// Return random integer from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on Visual Studio)
+// Return random number from a to b (inclusive) using the calling thread's stream (see Random.h)
+// Floats have 2^24 different values spread evenly across the range, doubles 2^53
 template<> int Random<int>(const int a, const int b)
 {
-	// Could just use a + rand() % (b-a), but using a more complex form to allow range
-	// to exceed RAND_MAX and still return values spread across the range
-	int t = (b - a + 1) * rand();
-	return t == 0 ? a : a + (t - 1) / RAND_MAX;
+	return ThreadRandom().Range(a, b);
 }
 
-// Return random float from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on Visual Studio)
 template<> float Random<float>(const float a, const float b)
 {
-	return a + (b - a) * (static_cast<float>(rand()) / RAND_MAX);
+	return ThreadRandom().Range(a, b);
 }
 
-// Return random double from a to b (inclusive)
-// Can only return up to RAND_MAX different values, spread evenly across the given range
-// RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on Visual Studio)
 template<> double Random<double>(const double a, const double b)
 {
-	return a + (b - a) * (static_cast<double>(rand()) / RAND_MAX);
+	return ThreadRandom().Range(a, b);
 }
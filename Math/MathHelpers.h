@@ -8,6 +8,7 @@
 #include <cmath>
 #include <numbers>
 #include <type_traits>
+#include <cstddef>
 
 // Special type to handle situations where floating point numbers are exceptionally required in integer-based template classes
 // For example a Vector2i (2D vector with int coords) needs a length function that returns a float not an int, so this type is used
@@ -20,7 +21,14 @@ template <typename T> using FloatTypeFor = std::conditional_t<std::is_floating_p
 
 
 // Test if a floating point value is approximately 0
-template <typename T> bool IsZero(const T x);
+// Epsilon value is the range around zero that is considered equal to zero: zero to 6 decimal places for 32-bit floats,
+// 15 decimal places for 64-bit floats. Defined here so it can be used in constant expressions
+template <typename T> constexpr bool IsZero(const T x)
+{
+	static_assert(std::is_floating_point_v<T>, "IsZero is only for float and double");
+	constexpr T epsilon = std::is_same_v<T, float> ? static_cast<T>(0.5e-6f) : static_cast<T>(0.5e-15);
+	return (x < 0 ? -x : x) < epsilon;
+}
 
 
 // 1 / Sqrt. Used often (e.g. normalising) and can be optimised, so it gets its own function
@@ -46,7 +54,68 @@ template <typename T, typename U = std::conditional_t<std::is_integral_v<T>, flo
 }
 
 
+// Used by FastSin and FastCos: the angle x with whole turns removed, from -pi to pi
+inline float WithoutTurns(float x)
+{
+	// 2pi is split in two so the subtraction is nearly exact
+	float turns = static_cast<float>(static_cast<int>(x * (0.5f / std::numbers::pi_v<float>) + (x < 0 ? -0.5f : 0.5f)));
+	return (x - turns * 6.28125f) - turns * 1.9353071795864769e-3f;
+}
+
+// Used by FastSin and FastCos: sine of r from -pi/2 to pi/2. Taylor series to the r^11 term, the first dropped term is
+// under 6e-8 in this range
+inline float SinPolynomial(float r)
+{
+	float r2 = r * r;
+	return r * (1 + r2 * (-1.6666667e-1f + r2 * (8.3333333e-3f + r2 * (-1.9841270e-4f + r2 * (2.7557319e-6f + r2 * -2.5052108e-8f)))));
+}
+
+// Fast approximate sine and cosine, for animation and other effects that don't need the last few bits of accuracy. Several
+// times faster than std::sin/cos. The angle is brought into -pi/2 to pi/2 and a polynomial used there. Absolute error is
+// under 3e-7 for angles up to +-1000 radians, growing slowly beyond that as the angle itself loses precision (about 1.5e-6
+// at +-100000 radians)
+inline float FastSin(float x)
+{
+	// sin(pi - r) = sin(r), folds -pi to pi into -pi/2 to pi/2
+	float r = WithoutTurns(x);
+	if      (r >  std::numbers::pi_v<float> / 2)  r =  std::numbers::pi_v<float> - r;
+	else if (r < -std::numbers::pi_v<float> / 2)  r = -std::numbers::pi_v<float> - r;
+	return SinPolynomial(r);
+}
+
+inline float FastCos(float x)
+{
+	// cos(r) = sin(pi/2 - |r|). Found from the reduced angle rather than as FastSin(x + pi/2), which would round away accuracy
+	return SinPolynomial(std::numbers::pi_v<float> / 2 - std::abs(WithoutTurns(x)));
+}
+
+// Fast approximate atan2, the angle of (x, y) from -pi to pi matching std::atan2. Absolute error is under 2e-6 radians
+inline float FastAtan2(float y, float x)
+{
+	float ax = std::abs(x);
+	float ay = std::abs(y);
+	float maxXY = ax > ay ? ax : ay;
+	if (maxXY == 0)  return 0;
+
+	// Polynomial for atan on 0 to 1, then the other octants by symmetry
+	float t = (ax < ay ? ax : ay) / maxXY;
+	float t2 = t * t;
+	float r = t * (0.99997726f + t2 * (-0.33262347f + t2 * (0.19354346f + t2 * (-0.11643287f + t2 * (0.05265332f + t2 * -0.01172120f)))));
+	if (ay > ax)  r = std::numbers::pi_v<float> / 2 - r;
+	if (x < 0)    r = std::numbers::pi_v<float> - r;
+	return y < 0 ? -r : r;
+}
+
+// Batched versions of the above, four values at a time with SSE and exactly the same results as the single value versions.
+// The input and output arrays can be the same
+void FastSin(const float* angles, float* out, size_t count);
+void FastCos(const float* angles, float* out, size_t count);
+void FastAtan2(const float* y, const float* x, float* out, size_t count);
+
+
 // Return random number from a to b (inclusive) - will return int, float or double random number matching the type of the parameters a & b
+// Uses a fast generator belonging to the calling thread, so is safe to call from worker threads. Repeatable from run to run
+// unless the numbers are taken by different threads each time. See Random.h for seeding and for streams of your own
 template <typename T> T Random(const T a, const T b);
 
 
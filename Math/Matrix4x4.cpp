@@ -294,16 +294,6 @@ template<typename T> Matrix4x4T<T>& Matrix4x4T<T>::Transpose()
 // They can be used as temporaries in calculations, e.g.
 //     Matrix4x4 m = MatrixScaling(3.0f) * MatrixTranslation({ 10.0f, -10.0f, 20.0f });
 
-// Return a translation matrix of the given vector
-template<typename T> Matrix4x4T<T> MatrixTranslation(const Vector3T<T>& t)
-{
-    return Matrix4x4T<T>{ 1,   0,   0,    0,
-                          0,   1,   0,    0,
-                          0,   0,   1,    0,
-                          t.x, t.y, t.z,  1 };
-}
-
-
 // Return an X-axis rotation matrix of the given angle (in radians)
 template<typename T> Matrix4x4T<T> MatrixRotationX(T x)
 {
@@ -348,25 +338,6 @@ template<typename T> Matrix4x4T<T> MatrixRotation(Vector3T<T> rotations)
 
 
 
-// Return a matrix that is a scaling in X,Y and Z of the values in the given vector
-template<typename T> Matrix4x4T<T> MatrixScaling(const Vector3T<T>& s)
-{
-    return Matrix4x4T<T>{ s.x,   0,   0,  0,
-                            0, s.y,   0,  0,
-                            0,   0, s.z,  0,
-                            0,   0,   0,  1 };
-}
-
-// Return a matrix that is a uniform scaling of the given amount
-template<typename T> Matrix4x4T<T> MatrixScaling(const T s)
-{
-    return Matrix4x4T<T>{ s, 0, 0, 0,
-                          0, s, 0, 0,
-                          0, 0, s, 0,
-                          0, 0, 0, 1 };
-}
-
-
 // Return the inverse of given matrix assuming that it is an affine matrix
 // Most commonly used to get the view matrix from the camera's positioning matrix
 template<typename T> Matrix4x4T<T> InverseAffine(const Matrix4x4T<T>& m)
@@ -465,25 +436,22 @@ template<typename T> Matrix4x4T<T> Inverse(const Matrix4x4T<T>& m)
 template class Matrix4x4T<float>;  // Matrix4x4 or Matrix4x4f
 template class Matrix4x4T<double>; // Matrix4x4d
 
-// Also need to instantiate all the non-member template functions
+// Also need to instantiate all the non-member template functions. Where SIMD is used, the multiplies and inverses for
+// float are explicit specialisations in Matrix4x4SIMD.h instead
+#ifndef MATRIX4X4_SIMD
 template Matrix4x4 operator*(const Matrix4x4& m1, const Matrix4x4& m2);
 template Vector4   operator*(const Vector4& v, const Matrix4x4& m);
-template Matrix4x4 MatrixTranslation(const Vector3& t);
+template Matrix4x4 InverseAffine(const Matrix4x4& m);
+template Matrix4x4 Inverse(const Matrix4x4& m);
+#endif
 template Matrix4x4 MatrixRotationX(float x);
 template Matrix4x4 MatrixRotationY(float y);
 template Matrix4x4 MatrixRotationZ(float z);
-template Matrix4x4 MatrixScaling(const Vector3& s);
-template Matrix4x4 MatrixScaling(const float s);
-template Matrix4x4 InverseAffine(const Matrix4x4& m);
-template Matrix4x4 Inverse(const Matrix4x4& m);
 
 template Matrix4x4d operator*(const Matrix4x4d& m1, const Matrix4x4d& m2);
 template Vector4d   operator*(const Vector4d& v, const Matrix4x4d& m);
-template Matrix4x4d MatrixTranslation(const Vector3d& t);
 template Matrix4x4d MatrixRotationX(double x);
 template Matrix4x4d MatrixRotationY(double y);
 template Matrix4x4d MatrixRotationZ(double z);
-template Matrix4x4d MatrixScaling(const Vector3d& s);
-template Matrix4x4d MatrixScaling(const double s);
 template Matrix4x4d InverseAffine(const Matrix4x4d& m);
 template Matrix4x4d Inverse(const Matrix4x4d& m);
@@ -4,7 +4,8 @@
 //--------------------------------------------------------------------------------------
 // Template classes usually put all code in header file. However, here we use explicit template instantiation at the
 // end of the .cpp file (see the comment there), which allows us to put the code in the cpp file and just the class
-// interface here, just like an ordinary non-templated class
+// interface here, just like an ordinary non-templated class. The exceptions are the constructors, the identity matrix and
+// the translation and scaling functions, which are constexpr and defined here so they can be compile-time constants
 
 #ifndef _MATRIX4X4_H_DEFINED_
 #define _MATRIX4X4_H_DEFINED_
@@ -12,6 +13,9 @@
 #include "Vector3.h"
 #include "Vector4.h"
 
+#include <cstring>
+#include <type_traits>
+
 
 // Template class to support float or double values. Do not use this typename, use the simpler types below
 template <typename T> class Matrix4x4T;
@@ -22,8 +26,8 @@ using Matrix4x4d = Matrix4x4T<double>; // 4x4 Matrix with double values
 using Matrix4x4 = Matrix4x4f; // Add extra simple name for float coords - the most common use-case
 
 
-// Full declaration
-template <typename T> class Matrix4x4T
+// Full declaration. Float matrices are 16-byte aligned so each row can be loaded as one SSE register (see Matrix4x4SIMD.h)
+template <typename T> class alignas(std::is_same_v<T, float> ? 16 : alignof(T)) Matrix4x4T
 {
 // Allow public access for such a simple, well-defined class
 public:
@@ -40,32 +44,27 @@ public:
 
     // Default constructor - leaves values uninitialised (for performance)
     #pragma warning(suppress: 26495) // disable warning about constructor leaving things uninitialised ("suppress" affects next line only)
-    Matrix4x4T<T>() {}
+    constexpr Matrix4x4T() {}
 
 
     // Construct with 16 values
-    Matrix4x4T<T>(T v00, T v01, T v02, T v03, 
-                  T v10, T v11, T v12, T v13,
-                  T v20, T v21, T v22, T v23,
-                  T v30, T v31, T v32, T v33)
-    {
-        e00 = v00; e01 = v01; e02 = v02; e03 = v03; 
-        e10 = v10; e11 = v11; e12 = v12; e13 = v13;
-        e20 = v20; e21 = v21; e22 = v22; e23 = v23;
-        e30 = v30; e31 = v31; e32 = v32; e33 = v33;
-    }
+    constexpr Matrix4x4T(T v00, T v01, T v02, T v03, 
+                         T v10, T v11, T v12, T v13,
+                         T v20, T v21, T v22, T v23,
+                         T v30, T v31, T v32, T v33)
+        : e00(v00), e01(v01), e02(v02), e03(v03),
+          e10(v10), e11(v11), e12(v12), e13(v13),
+          e20(v20), e21(v21), e22(v22), e23(v23),
+          e30(v30), e31(v31), e32(v32), e33(v33) {}
 
 
     // Construct using a pointer to 16 values
     explicit Matrix4x4T<T>(T* elts) // explicit means don't allow conversion from pointer to Matrix4x4 without writing the constructor name
 	                                // i.e. Matrix4x4 m = somepointer; // Not allowed      Matrix4x4 m = Matrix4x4(somepointer); // OK, explicitly asked for constructor
     {
-        // Ugly, but useful constructor. Convert the pointer parameter to a matrix pointer then use the default
-        // assignment = operator to copy that matrix to this one. Not guaranteed to be portable code but will
-        // work in practice. There are more modern, standard ways to support this kind of constructor, but would
-        // need advanced C++ work to do properly that would distract from understanding the basics of the class.
-        // For production code the more advanced way would be better. Ask tutor if you want to know more.
-        *this = *reinterpret_cast<Matrix4x4T<T>*>(elts);
+        // Copy the 16 values straight into the elements. The values needn't be aligned like a matrix is, so this
+        // doesn't treat the pointer as a matrix
+        std::memcpy(&e00, elts, 16 * sizeof(T));
     }
 
 
@@ -130,7 +129,7 @@ public:
     Vector3T<T>& Position()  { return Row(3); }
 
     // Direct access to position of matrix - returns a const reference - used as getter where matrix is const
-    const Vector3T<T>& Position() const { return Row(2); }
+    const Vector3T<T>& Position() const { return Row(3); }
 
 
     /*-----------------------------------------------------------------------------------------
@@ -242,11 +241,11 @@ public:
     static const Matrix4x4T<T> Identity;
 };
 
-// Initialise static identity matrix
-template <typename T> const Matrix4x4T<T> Matrix4x4T<T>::Identity = { 1, 0, 0, 0,
-                                                                      0, 1, 0, 0,
-                                                                      0, 0, 1, 0,
-                                                                      0, 0, 0, 1 };
+// Initialise static identity matrix, constexpr so it can be used in constant expressions
+template <typename T> constexpr Matrix4x4T<T> Matrix4x4T<T>::Identity = { 1, 0, 0, 0,
+                                                                          0, 1, 0, 0,
+                                                                          0, 0, 1, 0,
+                                                                          0, 0, 0, 1 };
 
 
 /*-----------------------------------------------------------------------------------------
@@ -268,9 +267,16 @@ template<typename T> Vector4T<T> operator*(const Vector4T<T>& v, const Matrix4x4
 // The following functions create a new matrix holding a particular transformation
 // They can be used as temporaries in calculations, e.g.
 //     Matrix4x4 m = MatrixScaling(3) * MatrixTranslation({ 10, -10, 20 });
+// Translations and scalings are constexpr, defined here, so they can be compile-time constants
 
 // Return a translation matrix of the given vector
-template<typename T> Matrix4x4T<T> MatrixTranslation(const Vector3T<T>& t);
+template<typename T> constexpr Matrix4x4T<T> MatrixTranslation(const Vector3T<T>& t)
+{
+    return Matrix4x4T<T>{ 1,   0,   0,    0,
+                          0,   1,   0,    0,
+                          0,   0,   1,    0,
+                          t.x, t.y, t.z,  1 };
+}
 
 
 // Return an X-axis rotation matrix of the given angle (in radians)
@@ -287,10 +293,22 @@ template<typename T> Matrix4x4T<T> MatrixRotation(Vector3T<T> rotations);
 
 
 // Return a matrix that is a scaling in X,Y and Z of the values in the given vector
-template<typename T> Matrix4x4T<T> MatrixScaling(const Vector3T<T>& s);
+template<typename T> constexpr Matrix4x4T<T> MatrixScaling(const Vector3T<T>& s)
+{
+    return Matrix4x4T<T>{ s.x,   0,   0,  0,
+                            0, s.y,   0,  0,
+                            0,   0, s.z,  0,
+                            0,   0,   0,  1 };
+}
 
 // Return a matrix that is a uniform scaling of the given amount
-template<typename T> Matrix4x4T<T> MatrixScaling(const T s);
+template<typename T> constexpr Matrix4x4T<T> MatrixScaling(const T s)
+{
+    return Matrix4x4T<T>{ s, 0, 0, 0,
+                          0, s, 0, 0,
+                          0, 0, s, 0,
+                          0, 0, 0, 1 };
+}
 
 
 
@@ -300,4 +318,8 @@ template<typename T> Matrix4x4T<T> InverseAffine(const Matrix4x4T<T>& m);
 
 template<typename T> Matrix4x4T<T> Inverse(const Matrix4x4T<T>& m);
 
+
+// Faster versions of the functions above for float matrices
+#include "Matrix4x4SIMD.h"
+
 #endif // _MATRIX4X4_H_DEFINED_
@@ -0,0 +1,252 @@
+//--------------------------------------------------------------------------------------
+// SSE versions of the most used Matrix4x4 (float) operations
+//--------------------------------------------------------------------------------------
+// Included at the end of Matrix4x4.h, do not include directly. Multiplies, vector transforms and inverses of float matrices
+// sit under every hierarchy update, camera update and entity movement in the game, so for float they are replaced by the
+// explicit specialisations below, which are inline so they can be optimised into the calling code. Each row of a matrix is
+// one SSE register, float matrices are 16-byte aligned (see Matrix4x4.h) so rows are loaded and stored with aligned moves.
+// Matrix4x4d, and all other functions, use the generic code in Matrix4x4.cpp
+//
+// Selected at compile time: SSE2 is always available on x64. Where the compiler targets AVX2 (/arch:AVX2) multiplies and
+// adds are fused. Define MATRIX4X4_NO_SIMD to use the generic code for float too, e.g. to compare results
+
+#ifndef _MATRIX4X4_SIMD_H_DEFINED_
+#define _MATRIX4X4_SIMD_H_DEFINED_
+
+#if !defined(MATRIX4X4_NO_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define MATRIX4X4_SIMD
+#endif
+
+#ifdef MATRIX4X4_SIMD
+
+#include <emmintrin.h> // SSE2
+#if defined(__AVX2__) || defined(__FMA__)
+#include <immintrin.h>
+#endif
+
+
+/*-----------------------------------------------------------------------------------------
+    Helpers
+-----------------------------------------------------------------------------------------*/
+
+namespace Matrix4x4SIMD
+{
+    // Rows of a float matrix as SSE registers
+    inline __m128 LoadRow(const Matrix4x4f& m, int row)       { return _mm_load_ps(&m.e00 + row * 4); }
+    inline void   StoreRow(Matrix4x4f& m, int row, __m128 v)  { _mm_store_ps(&m.e00 + row * 4, v); }
+
+    // Lanes x, y, z, w picked from a register
+    template <int x, int y, int z, int w> inline __m128 Swizzle(__m128 v)
+    {
+        return _mm_castsi128_ps(_mm_shuffle_epi32(_mm_castps_si128(v), _MM_SHUFFLE(w, z, y, x)));
+    }
+
+    // a * b + c
+    inline __m128 MulAdd(__m128 a, __m128 b, __m128 c)
+    {
+    #if defined(__AVX2__) || defined(__FMA__)
+        return _mm_fmadd_ps(a, b, c);
+    #else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+    #endif
+    }
+
+    // Row vector v times the matrix with the given rows: v.x * r0 + v.y * r1 + v.z * r2 + v.w * r3
+    inline __m128 Transform(__m128 v, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+    {
+        __m128 result = _mm_mul_ps(Swizzle<0, 0, 0, 0>(v), r0);
+        result = MulAdd(Swizzle<1, 1, 1, 1>(v), r1, result);
+        result = MulAdd(Swizzle<2, 2, 2, 2>(v), r2, result);
+        return   MulAdd(Swizzle<3, 3, 3, 3>(v), r3, result);
+    }
+
+    // Matrix product m1 * m2 into mOut, which may be either of the inputs
+    inline void Multiply(const Matrix4x4f& m1, const Matrix4x4f& m2, Matrix4x4f& mOut)
+    {
+        __m128 b0 = LoadRow(m2, 0), b1 = LoadRow(m2, 1), b2 = LoadRow(m2, 2), b3 = LoadRow(m2, 3);
+        __m128 r0 = Transform(LoadRow(m1, 0), b0, b1, b2, b3);
+        __m128 r1 = Transform(LoadRow(m1, 1), b0, b1, b2, b3);
+        __m128 r2 = Transform(LoadRow(m1, 2), b0, b1, b2, b3);
+        __m128 r3 = Transform(LoadRow(m1, 3), b0, b1, b2, b3);
+        StoreRow(mOut, 0, r0);
+        StoreRow(mOut, 1, r1);
+        StoreRow(mOut, 2, r2);
+        StoreRow(mOut, 3, r3);
+    }
+
+    // Cross product of the xyz of two registers, w is 0
+    inline __m128 Cross(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(_mm_mul_ps(Swizzle<1, 2, 0, 3>(a), Swizzle<2, 0, 1, 3>(b)),
+                          _mm_mul_ps(Swizzle<2, 0, 1, 3>(a), Swizzle<1, 2, 0, 3>(b)));
+    }
+
+    // 2x2 matrices held in a register as (m00, m01, m10, m11), with # meaning the adjugate. Used for the general inverse
+    inline __m128 Mat2Mul(__m128 a, __m128 b)     // a * b
+    {
+        return _mm_add_ps(_mm_mul_ps(a, Swizzle<0, 3, 0, 3>(b)), _mm_mul_ps(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b)));
+    }
+    inline __m128 Mat2AdjMul(__m128 a, __m128 b)  // a# * b
+    {
+        return _mm_sub_ps(_mm_mul_ps(Swizzle<3, 3, 0, 0>(a), b), _mm_mul_ps(Swizzle<1, 1, 2, 2>(a), Swizzle<2, 3, 0, 1>(b)));
+    }
+    inline __m128 Mat2MulAdj(__m128 a, __m128 b)  // a * b#
+    {
+        return _mm_sub_ps(_mm_mul_ps(a, Swizzle<3, 0, 3, 0>(b)), _mm_mul_ps(Swizzle<1, 0, 3, 2>(a), Swizzle<2, 1, 2, 1>(b)));
+    }
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Operators
+-----------------------------------------------------------------------------------------*/
+
+// Post-multiply this matrix by the given one
+template<> inline Matrix4x4f& Matrix4x4f::operator*=(const Matrix4x4f& m)
+{
+    Matrix4x4SIMD::Multiply(*this, m, *this); // All of m is loaded before anything is stored, so m can be this matrix
+    return *this;
+}
+
+// Matrix-matrix multiplication
+template<> inline Matrix4x4f operator*(const Matrix4x4f& m1, const Matrix4x4f& m2)
+{
+    Matrix4x4f mOut;
+    Matrix4x4SIMD::Multiply(m1, m2, mOut);
+    return mOut;
+}
+
+// Vector-matrix multiplication, transforms the vector by the matrix
+template<> inline Vector4f operator*(const Vector4f& v, const Matrix4x4f& m)
+{
+    using namespace Matrix4x4SIMD;
+    Vector4f vOut;
+    _mm_storeu_ps(&vOut.x, Transform(_mm_loadu_ps(&v.x), LoadRow(m, 0), LoadRow(m, 1), LoadRow(m, 2), LoadRow(m, 3)));
+    return vOut;
+}
+
+
+// Transform a point (w=1), the result has w=1 as the matrix is assumed to be affine
+template<> inline Vector4f Matrix4x4f::TransformPoint(const Vector3f& v) const
+{
+    using namespace Matrix4x4SIMD;
+    __m128 result = MulAdd(_mm_set1_ps(v.x), LoadRow(*this, 0), LoadRow(*this, 3));
+    result = MulAdd(_mm_set1_ps(v.y), LoadRow(*this, 1), result);
+    result = MulAdd(_mm_set1_ps(v.z), LoadRow(*this, 2), result);
+    Vector4f vOut;
+    _mm_storeu_ps(&vOut.x, result);
+    vOut.w = 1;
+    return vOut;
+}
+
+// Transform a vector (w=0)
+template<> inline Vector4f Matrix4x4f::TransformVector(const Vector3f& v) const
+{
+    using namespace Matrix4x4SIMD;
+    __m128 result = _mm_mul_ps(_mm_set1_ps(v.x), LoadRow(*this, 0));
+    result = MulAdd(_mm_set1_ps(v.y), LoadRow(*this, 1), result);
+    result = MulAdd(_mm_set1_ps(v.z), LoadRow(*this, 2), result);
+    Vector4f vOut;
+    _mm_storeu_ps(&vOut.x, result);
+    vOut.w = 0;
+    return vOut;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+    Inverses
+-----------------------------------------------------------------------------------------*/
+
+// Inverse of an affine matrix. The inverse of the upper-left 3x3 has the cross products of pairs of its rows as its columns,
+// divided by the determinant. The inverse translation is the negated translation transformed by that
+template<> inline Matrix4x4f InverseAffine(const Matrix4x4f& m)
+{
+    using namespace Matrix4x4SIMD;
+    __m128 r0 = LoadRow(m, 0), r1 = LoadRow(m, 1), r2 = LoadRow(m, 2);
+    __m128 c0 = Cross(r1, r2);
+    __m128 c1 = Cross(r2, r0);
+    __m128 c2 = Cross(r0, r1);
+    __m128 c3 = _mm_setzero_ps();
+
+    // Determinant in every lane
+    __m128 det = _mm_mul_ps(r0, c0);
+    det = _mm_add_ps(det, Swizzle<1, 0, 3, 2>(det));
+    det = _mm_add_ps(Swizzle<2, 2, 0, 0>(det), det); // x: x+y+z (w lanes of the cross products are 0)
+    det = Swizzle<0, 0, 0, 0>(det);
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    // Transpose the cross products to get the rows of the inverse 3x3, w of each becomes 0
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    c0 = _mm_mul_ps(c0, invDet);
+    c1 = _mm_mul_ps(c1, invDet);
+    c2 = _mm_mul_ps(c2, invDet);
+
+    __m128 position = LoadRow(m, 3);
+    __m128 translation = _mm_mul_ps(Swizzle<0, 0, 0, 0>(position), c0);
+    translation = MulAdd(Swizzle<1, 1, 1, 1>(position), c1, translation);
+    translation = MulAdd(Swizzle<2, 2, 2, 2>(position), c2, translation);
+    translation = _mm_sub_ps(_mm_setr_ps(0, 0, 0, 1), translation);
+
+    Matrix4x4f mOut;
+    StoreRow(mOut, 0, c0);
+    StoreRow(mOut, 1, c1);
+    StoreRow(mOut, 2, c2);
+    StoreRow(mOut, 3, translation);
+    return mOut;
+}
+
+
+// General matrix inverse. Treats the matrix as four 2x2 blocks  | A B |  and builds the inverse from their determinants and
+//                                                               | C D |  adjugates, which need no dividing except by the
+// final determinant. Returns an uninitialised matrix if the matrix is singular, as the generic version does
+template<> inline Matrix4x4f Inverse(const Matrix4x4f& m)
+{
+    using namespace Matrix4x4SIMD;
+    __m128 r0 = LoadRow(m, 0), r1 = LoadRow(m, 1), r2 = LoadRow(m, 2), r3 = LoadRow(m, 3);
+
+    // The 2x2 blocks
+    __m128 A = _mm_movelh_ps(r0, r1);
+    __m128 B = _mm_movehl_ps(r1, r0);
+    __m128 C = _mm_movelh_ps(r2, r3);
+    __m128 D = _mm_movehl_ps(r3, r2);
+
+    // Determinants of the blocks (|A|, |B|, |C|, |D|)
+    __m128 detSub = _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(3, 1, 3, 1))),
+                               _mm_mul_ps(_mm_shuffle_ps(r0, r2, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_ps(r1, r3, _MM_SHUFFLE(2, 0, 2, 0))));
+    __m128 detA = Swizzle<0, 0, 0, 0>(detSub);
+    __m128 detB = Swizzle<1, 1, 1, 1>(detSub);
+    __m128 detC = Swizzle<2, 2, 2, 2>(detSub);
+    __m128 detD = Swizzle<3, 3, 3, 3>(detSub);
+
+    __m128 D_C = Mat2AdjMul(D, C); // D# C
+    __m128 A_B = Mat2AdjMul(A, B); // A# B
+    __m128 X_  = _mm_sub_ps(_mm_mul_ps(detD, A), Mat2Mul(B, D_C));    // |D| A - B (D# C)
+    __m128 W_  = _mm_sub_ps(_mm_mul_ps(detA, D), Mat2Mul(C, A_B));    // |A| D - C (A# B)
+    __m128 Y_  = _mm_sub_ps(_mm_mul_ps(detB, C), Mat2MulAdj(D, A_B)); // |B| C - D (A# B)#
+    __m128 Z_  = _mm_sub_ps(_mm_mul_ps(detC, B), Mat2MulAdj(A, D_C)); // |C| B - A (D# C)#
+
+    // |M| = |A| |D| + |B| |C| - trace((A# B)(D# C)), in every lane
+    __m128 trace = _mm_mul_ps(A_B, Swizzle<0, 2, 1, 3>(D_C));
+    trace = _mm_add_ps(trace, Swizzle<2, 3, 0, 1>(trace));
+    trace = _mm_add_ps(trace, Swizzle<1, 0, 3, 2>(trace));
+    __m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+    if (_mm_cvtss_f32(detM) == 0)  return Matrix4x4f();
+
+    // The blocks above are adjugates, undo that with these signs and the shuffles below
+    __m128 invDetM = _mm_div_ps(_mm_setr_ps(1, -1, -1, 1), detM);
+    X_ = _mm_mul_ps(X_, invDetM);
+    Y_ = _mm_mul_ps(Y_, invDetM);
+    Z_ = _mm_mul_ps(Z_, invDetM);
+    W_ = _mm_mul_ps(W_, invDetM);
+
+    Matrix4x4f mOut;
+    StoreRow(mOut, 0, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(1, 3, 1, 3)));
+    StoreRow(mOut, 1, _mm_shuffle_ps(X_, Y_, _MM_SHUFFLE(0, 2, 0, 2)));
+    StoreRow(mOut, 2, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(1, 3, 1, 3)));
+    StoreRow(mOut, 3, _mm_shuffle_ps(Z_, W_, _MM_SHUFFLE(0, 2, 0, 2)));
+    return mOut;
+}
+
+#endif // MATRIX4X4_SIMD
+
+#endif // _MATRIX4X4_SIMD_H_DEFINED_
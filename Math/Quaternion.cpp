@@ -0,0 +1,159 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class, a rotation held in four floats
+//--------------------------------------------------------------------------------------
+
+#include "Quaternion.h"
+
+#include <cmath>
+
+
+const Quaternion Quaternion::Identity = { 0, 0, 0, 1 };
+
+
+/*-----------------------------------------------------------------------------------------
+	Member functions
+-----------------------------------------------------------------------------------------*/
+
+// Rotate the given vector by this quaternion, which must be normalised
+Vector3 Quaternion::Rotate(const Vector3& v) const
+{
+	// v + 2w(q x v) + 2q x (q x v), with q the xyz part. Fewer operations than building the matrix
+	Vector3 q = { x, y, z };
+	Vector3 t = 2.0f * Cross(q, v);
+	return v + w * t + Cross(q, t);
+}
+
+
+// The rotation as a matrix with no translation or scaling. The quaternion must be normalised
+Matrix4x4 Quaternion::ToMatrix() const
+{
+	float xx = x * x,  yy = y * y,  zz = z * z;
+	float xy = x * y,  xz = x * z,  yz = y * z;
+	float wx = w * x,  wy = w * y,  wz = w * z;
+
+	// Rows are the rotated X, Y and Z axes since vectors multiply matrices from the left in this app
+	return { 1 - 2 * (yy + zz),     2 * (xy + wz),     2 * (xz - wy), 0,
+	             2 * (xy - wz), 1 - 2 * (xx + zz),     2 * (yz + wx), 0,
+	             2 * (xz + wy),     2 * (yz - wx), 1 - 2 * (xx + yy), 0,
+	                         0,                 0,                 0, 1 };
+}
+
+
+// Scale back to unit length
+void Quaternion::Normalise()
+{
+	float lengthSquared = Dot(*this);
+	if (IsZero(lengthSquared))
+	{
+		*this = Identity;
+		return;
+	}
+	float invLength = InvSqrt(lengthSquared);
+	x *= invLength;
+	y *= invLength;
+	z *= invLength;
+	w *= invLength;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Rotation by q1 then by q2. This is the usual quaternion product q2q1, written in matrix order
+Quaternion operator*(const Quaternion& q1, const Quaternion& q2)
+{
+	return { q2.w * q1.x + q2.x * q1.w + q2.y * q1.z - q2.z * q1.y,
+	         q2.w * q1.y - q2.x * q1.z + q2.y * q1.w + q2.z * q1.x,
+	         q2.w * q1.z + q2.x * q1.y - q2.y * q1.x + q2.z * q1.w,
+	         q2.w * q1.w - q2.x * q1.x - q2.y * q1.y - q2.z * q1.z };
+}
+
+
+// Rotation of the given angle (radians) around the given axis, which must be normalised
+Quaternion QuaternionRotationAxis(const Vector3& axis, float angle)
+{
+	float s = std::sin(angle * 0.5f);
+	return { axis.x * s, axis.y * s, axis.z * s, std::cos(angle * 0.5f) };
+}
+
+Quaternion QuaternionRotationX(float x)  { return { std::sin(x * 0.5f), 0, 0, std::cos(x * 0.5f) }; }
+Quaternion QuaternionRotationY(float y)  { return { 0, std::sin(y * 0.5f), 0, std::cos(y * 0.5f) }; }
+Quaternion QuaternionRotationZ(float z)  { return { 0, 0, std::sin(z * 0.5f), std::cos(z * 0.5f) }; }
+
+
+// Rotation of a matrix, which may also hold a position and scaling
+Quaternion QuaternionFromMatrix(const Matrix4x4& m)
+{
+	// Remove the scaling from the axes first
+	Vector3 xAxis = Normalise(m.Row(0));
+	Vector3 yAxis = Normalise(m.Row(1));
+	Vector3 zAxis = Normalise(m.Row(2));
+
+	// Take the square root of the largest of the four possible terms, which avoids dividing by a small number
+	Quaternion q;
+	float trace = xAxis.x + yAxis.y + zAxis.z;
+	if (trace > 0)
+	{
+		float s = 0.5f / std::sqrt(trace + 1);
+		q = { (yAxis.z - zAxis.y) * s, (zAxis.x - xAxis.z) * s, (xAxis.y - yAxis.x) * s, 0.25f / s };
+	}
+	else if (xAxis.x > yAxis.y && xAxis.x > zAxis.z)
+	{
+		float s = 2 * std::sqrt(1 + xAxis.x - yAxis.y - zAxis.z);
+		q = { 0.25f * s, (xAxis.y + yAxis.x) / s, (xAxis.z + zAxis.x) / s, (yAxis.z - zAxis.y) / s };
+	}
+	else if (yAxis.y > zAxis.z)
+	{
+		float s = 2 * std::sqrt(1 + yAxis.y - xAxis.x - zAxis.z);
+		q = { (xAxis.y + yAxis.x) / s, 0.25f * s, (yAxis.z + zAxis.y) / s, (zAxis.x - xAxis.z) / s };
+	}
+	else
+	{
+		float s = 2 * std::sqrt(1 + zAxis.z - xAxis.x - yAxis.y);
+		q = { (xAxis.z + zAxis.x) / s, (yAxis.z + zAxis.y) / s, 0.25f * s, (xAxis.y - yAxis.x) / s };
+	}
+	q.Normalise();
+	return q;
+}
+
+
+// Rotation that turns the Z axis to the given direction with the X axis kept horizontal, matching Matrix4x4::FaceDirection
+Quaternion QuaternionFacing(const Vector3& direction)
+{
+	if (IsZero(direction.Length()))  return Quaternion::Identity;
+
+	Matrix4x4 facing = Matrix4x4::Identity;
+	facing.FaceDirection(direction);
+	return QuaternionFromMatrix(facing);
+}
+
+
+// Smooth blend from q1 (t = 0) to q2 (t = 1) at a constant angular speed, taking the shortest way round
+Quaternion Slerp(const Quaternion& q1, const Quaternion& q2, float t)
+{
+	// q and -q are the same rotation, use whichever is nearer q1 so the blend goes the short way
+	float cosAngle = q1.Dot(q2);
+	Quaternion to = q2;
+	if (cosAngle < 0)
+	{
+		cosAngle = -cosAngle;
+		to = { -q2.x, -q2.y, -q2.z, -q2.w };
+	}
+
+	// For nearly equal rotations the sine below is tiny, a normalised straight line blend is just as good there
+	float weight1 = 1 - t;
+	float weight2 = t;
+	if (cosAngle < 0.9995f)
+	{
+		float angle = std::acos(cosAngle);
+		float invSin = 1 / std::sin(angle);
+		weight1 = std::sin(weight1 * angle) * invSin;
+		weight2 = std::sin(weight2 * angle) * invSin;
+	}
+
+	Quaternion result = { q1.x * weight1 + to.x * weight2, q1.y * weight1 + to.y * weight2,
+	                      q1.z * weight1 + to.z * weight2, q1.w * weight1 + to.w * weight2 };
+	result.Normalise();
+	return result;
+}
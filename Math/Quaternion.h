@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// Quaternion class, a rotation held in four floats
+//--------------------------------------------------------------------------------------
+// A unit quaternion (x, y, z, w) is a rotation of angle a around a unit axis n, with x, y, z = n * sin(a/2) and w = cos(a/2).
+// Compared with the rotation part of a matrix it is smaller (4 floats rather than 9), combining two rotations is cheaper, and
+// it can be brought back to exactly a rotation by normalising, so rotating a bit at a time every frame doesn't slowly build
+// up skew or scaling the way multiplying matrices does. Rotations can also be smoothly blended with Slerp.
+//
+// Quaternions are combined in the same order as matrices in this app: q1 * q2 rotates by q1 then by q2, so the matrix of
+// q1 * q2 is q1.ToMatrix() * q2.ToMatrix(). The matrices are the same as those from MatrixRotationX/Y/Z for the same angles
+//
+//   Quaternion spin = QuaternionRotationY(angle) * spin; // Rotate around local Y, as Matrix4x4::RotateLocalY
+//   Vector3 facing = spin.Rotate({ 0, 0, 1 });
+//   Matrix4x4 m = Slerp(from, to, 0.5f).ToMatrix();
+
+#ifndef _QUATERNION_H_INCLUDED_
+#define _QUATERNION_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+
+
+class Quaternion
+{
+public:
+	// Components, defaults to the identity (no rotation)
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float w = 1;
+
+	Quaternion() = default;
+	Quaternion(float xIn, float yIn, float zIn, float wIn) : x(xIn), y(yIn), z(zIn), w(wIn) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Member functions
+	-----------------------------------------------------------------------------------------*/
+
+	// Rotate the given vector by this quaternion, which must be normalised
+	Vector3 Rotate(const Vector3& v) const;
+
+	// The rotation as a matrix with no translation or scaling. The quaternion must be normalised
+	Matrix4x4 ToMatrix() const;
+
+	// Scale back to unit length, call after many small rotations have been combined to remove rounding errors
+	void Normalise();
+
+	float Dot(const Quaternion& q) const  { return x * q.x + y * q.y + z * q.z + w * q.w; }
+
+	// The opposite rotation, for a normalised quaternion
+	Quaternion Conjugate() const  { return { -x, -y, -z, w }; }
+
+	static const Quaternion Identity;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Non-member functions
+-----------------------------------------------------------------------------------------*/
+
+// Rotation by q1 then by q2, the same order as multiplying their matrices
+Quaternion operator*(const Quaternion& q1, const Quaternion& q2);
+
+// Rotation of the given angle (radians) around the given axis, which must be normalised
+Quaternion QuaternionRotationAxis(const Vector3& axis, float angle);
+
+// Rotations around the X, Y and Z axes, matching MatrixRotationX/Y/Z
+Quaternion QuaternionRotationX(float x);
+Quaternion QuaternionRotationY(float y);
+Quaternion QuaternionRotationZ(float z);
+
+// Rotation of a matrix, which may also hold a position and scaling (they are ignored). The matrix's axes must be at right
+// angles, which is true of any matrix made from rotations, translations and scalings
+Quaternion QuaternionFromMatrix(const Matrix4x4& m);
+
+// Rotation that turns the Z axis to the given direction with the X axis kept horizontal, matching Matrix4x4::FaceDirection.
+// Returns the identity if the direction is zero
+Quaternion QuaternionFacing(const Vector3& direction);
+
+// Smooth blend from q1 (t = 0) to q2 (t = 1) at a constant angular speed, taking the shortest way round. Both must be normalised
+Quaternion Slerp(const Quaternion& q1, const Quaternion& q2, float t);
+
+
+#endif //_QUATERNION_H_INCLUDED_
@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// RandomStream class, a small fast seedable random number generator
+//--------------------------------------------------------------------------------------
+
+#include "Random.h"
+
+#include <atomic>
+
+
+/*-----------------------------------------------------------------------------------------
+	Bulk generation
+-----------------------------------------------------------------------------------------*/
+
+// Fill count values with random numbers from a to b (inclusive). Works on a local copy of the generator so the compiler
+// can keep the state in registers rather than writing it back to memory after every number
+void RandomStream::Fill(float* out, size_t count, float a, float b)
+{
+	RandomStream local = *this;
+	float scale = (b - a) * (1.0f / 16777215.0f);
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = a + static_cast<float>(local.Next() >> 8) * scale;
+	}
+	*this = local;
+}
+
+void RandomStream::Fill(double* out, size_t count, double a, double b)
+{
+	RandomStream local = *this;
+	for (size_t i = 0; i < count; ++i)  out[i] = local.Range(a, b);
+	*this = local;
+}
+
+void RandomStream::Fill(int* out, size_t count, int a, int b)
+{
+	RandomStream local = *this;
+	for (size_t i = 0; i < count; ++i)  out[i] = local.Range(a, b);
+	*this = local;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	App-wide seed and per-thread streams
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	std::atomic<uint64_t> gSeed = RandomStream::DEFAULT_SEED;
+	std::atomic<uint32_t> gSeedVersion = 0; // Increased by SeedRandom so threads can see their stream is out of date
+	std::atomic<uint32_t> gNextThreadStream = 0;
+
+	// Each thread's stream and the seed version it was started from
+	struct ThreadStream
+	{
+		uint32_t     streamNumber = gNextThreadStream++;
+		uint32_t     seedVersion  = gSeedVersion;
+		RandomStream stream       = RandomStream(gSeed, streamNumber);
+	};
+	thread_local ThreadStream tThreadStream;
+}
+
+
+// Set the seed for the app's random numbers and restart the calling thread's stream from it
+void SeedRandom(uint64_t seed)
+{
+	gSeed = seed;
+	++gSeedVersion;
+	tThreadStream.seedVersion = gSeedVersion;
+	tThreadStream.stream.Seed(seed, tThreadStream.streamNumber);
+}
+
+// The seed set by SeedRandom (or RandomStream::DEFAULT_SEED)
+uint64_t RandomSeed()
+{
+	return gSeed;
+}
+
+// The calling thread's stream, restarted from the current seed if SeedRandom has been called since it was last used
+RandomStream& ThreadRandom()
+{
+	ThreadStream& threadStream = tThreadStream;
+	uint32_t seedVersion = gSeedVersion.load(std::memory_order_relaxed);
+	if (threadStream.seedVersion != seedVersion)
+	{
+		threadStream.seedVersion = seedVersion;
+		threadStream.stream.Seed(gSeed, threadStream.streamNumber);
+	}
+	return threadStream.stream;
+}
@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------------------
+// RandomStream class, a small fast seedable random number generator
+//--------------------------------------------------------------------------------------
+// A PCG32 generator: 64 bits of state, a 32-bit result per call and a handful of instructions with no locking. Unlike the C
+// rand() function each stream is a separate object, so every run from the same seed gives the same numbers and threads
+// don't share (or fight over) any state. A seed picks the sequence and a stream number picks one of 2^63 independent
+// sequences for that seed, so many streams can be made from one seed without overlapping, e.g. one per entity:
+//
+//   RandomStream random(RandomSeed(), GetID()); // Same numbers for this entity every run
+//   float delay = random.Range(2.0f, 5.0f);
+//   random.Fill(offsets.data(), offsets.size(), -1.0f, 1.0f);
+//
+// The Random function in MathHelpers uses a stream belonging to the calling thread (ThreadRandom below), safe to call from
+// worker threads. Code that must give the same results whichever thread runs it should keep its own stream instead
+
+#ifndef _RANDOM_H_INCLUDED_
+#define _RANDOM_H_INCLUDED_
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+
+class RandomStream
+{
+public:
+	// Seed used by the app unless SeedRandom is called, so runs are repeatable by default
+	static constexpr uint64_t DEFAULT_SEED = 0x853c49e6748fea9bull;
+
+	// Start the given stream of the given seed
+	constexpr RandomStream(uint64_t seed = DEFAULT_SEED, uint64_t stream = 0)
+	{
+		Seed(seed, stream);
+	}
+
+	// Restart the generator as if newly constructed with this seed and stream
+	constexpr void Seed(uint64_t seed, uint64_t stream = 0)
+	{
+		mState = 0;
+		mIncrement = (stream << 1) | 1; // Must be odd
+		Next();
+		mState += seed;
+		Next();
+	}
+
+	// Next 32 random bits
+	constexpr uint32_t Next()
+	{
+		uint64_t oldState = mState;
+		mState = oldState * 6364136223846793005ull + mIncrement;
+		uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18) ^ oldState) >> 27);
+		uint32_t rotate = static_cast<uint32_t>(oldState >> 59);
+		return (xorShifted >> rotate) | (xorShifted << ((0u - rotate) & 31));
+	}
+
+	// Random number from a to b (inclusive), as the Random function in MathHelpers. Floats have 2^24 different
+	// values spread evenly across the range, doubles 2^53. Integer ranges can be up to the full range of int
+	template <typename T> constexpr T Range(const T a, const T b)
+	{
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			return a + (b - a) * Unit<T>();
+		}
+		else
+		{
+			static_assert(std::is_integral_v<T> && sizeof(T) <= 4, "RandomStream::Range supports float, double and integers up to 32 bits");
+			// Scale 32 bits into the range with a multiply rather than %. The bias is under one part in 2^32/range
+			uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(b) - static_cast<int64_t>(a)) + 1;
+			return static_cast<T>(static_cast<int64_t>(a) + static_cast<int64_t>((Next() * range) >> 32));
+		}
+	}
+
+	// Fill count values with random numbers from a to b (inclusive), several times faster than calling Range in a loop
+	// as the generator state stays in registers
+	void Fill(float*  out, size_t count, float  a, float  b);
+	void Fill(double* out, size_t count, double a, double b);
+	void Fill(int*    out, size_t count, int    a, int    b);
+
+private:
+	// Random number from 0 to 1 inclusive
+	template <typename T> constexpr T Unit()
+	{
+		if constexpr (std::is_same_v<T, float>)
+		{
+			return static_cast<float>(Next() >> 8) * (1.0f / 16777215.0f);
+		}
+		else
+		{
+			uint64_t high = Next(); // Separate statements so the order of the two calls is fixed
+			uint64_t bits = (high << 21) ^ (Next() >> 11);
+			return static_cast<T>(bits) * (static_cast<T>(1) / 9007199254740991.0);
+		}
+	}
+
+	uint64_t mState     = 0;
+	uint64_t mIncrement = 1;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	App-wide seed and per-thread streams
+-----------------------------------------------------------------------------------------*/
+
+// Set the seed for the app's random numbers and restart the calling thread's stream from it. Other threads restart their
+// streams from the new seed the next time they ask for a number. Call before creating the scene to make a run repeatable
+void SeedRandom(uint64_t seed);
+
+// The seed set by SeedRandom (or RandomStream::DEFAULT_SEED). Use when making streams of your own
+uint64_t RandomSeed();
+
+// The calling thread's stream. Threads are given stream numbers in the order they first use it, so the main thread,
+// which gets numbers first during setup, is always stream 0
+RandomStream& ThreadRandom();
+
+
+#endif //_RANDOM_H_INCLUDED_
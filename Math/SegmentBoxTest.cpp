@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// Line segment against axis-aligned box tests, one box at a time or four at once with SSE
+//--------------------------------------------------------------------------------------
+
+#include "SegmentBoxTest.h"
+
+#include <xmmintrin.h> // SSE, always available on x64
+#include <algorithm>
+#include <cmath>
+
+
+// Prepare the segment from start to end for the tests below
+PreparedSegment PrepareSegment(const Vector3& start, const Vector3& end)
+{
+	// Direction components smaller than this are treated as zero. The replacement inverse is larger than any real inverse
+	// (at most 1e20) so it still puts everything off the segment unless the start is within the slab
+	const float kZeroDir     = 1e-20f;
+	const float kLargeInvDir = 1e30f;
+	auto safeInverse = [&](float d) { return std::abs(d) < kZeroDir ? (d < 0.0f ? -kLargeInvDir : kLargeInvDir) : 1.0f / d; };
+
+	Vector3 dir = end - start;
+	return { start, { safeInverse(dir.x), safeInverse(dir.y), safeInverse(dir.z) } };
+}
+
+
+// Returns true if the segment touches or passes through the box
+bool SegmentHitsBox(const PreparedSegment& segment, const Vector3& boxMin, const Vector3& boxMax)
+{
+	// Parameter range of the segment (0 = start, 1 = end) between the two planes on each axis, narrowed by each axis in turn
+	float tMin = 0.0f;
+	float tMax = 1.0f;
+
+	float t0 = (boxMin.x - segment.start.x) * segment.invDir.x;
+	float t1 = (boxMax.x - segment.start.x) * segment.invDir.x;
+	tMin = std::max(tMin, std::min(t0, t1));
+	tMax = std::min(tMax, std::max(t0, t1));
+
+	t0 = (boxMin.y - segment.start.y) * segment.invDir.y;
+	t1 = (boxMax.y - segment.start.y) * segment.invDir.y;
+	tMin = std::max(tMin, std::min(t0, t1));
+	tMax = std::min(tMax, std::max(t0, t1));
+
+	t0 = (boxMin.z - segment.start.z) * segment.invDir.z;
+	t1 = (boxMax.z - segment.start.z) * segment.invDir.z;
+	tMin = std::max(tMin, std::min(t0, t1));
+	tMax = std::min(tMax, std::max(t0, t1));
+
+	return tMin <= tMax;
+}
+
+
+// Test the segment against all four boxes in the group at once. Returns a mask with bit n set if box n is hit
+// Exactly the same steps as SegmentHitsBox, on four boxes in parallel and with no branches
+unsigned int SegmentHitsBoxes4(const PreparedSegment& segment, const BoxGroup4& boxes)
+{
+	__m128 tMin = _mm_setzero_ps();
+	__m128 tMax = _mm_set1_ps(1.0f);
+
+	auto narrowAxis = [&](const float* boxMin, const float* boxMax, float start, float invDir)
+	{
+		__m128 startAxis  = _mm_set1_ps(start);
+		__m128 invDirAxis = _mm_set1_ps(invDir);
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxMin), startAxis), invDirAxis);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(boxMax), startAxis), invDirAxis);
+		tMin = _mm_max_ps(tMin, _mm_min_ps(t0, t1));
+		tMax = _mm_min_ps(tMax, _mm_max_ps(t0, t1));
+	};
+	narrowAxis(boxes.minX, boxes.maxX, segment.start.x, segment.invDir.x);
+	narrowAxis(boxes.minY, boxes.maxY, segment.start.y, segment.invDir.y);
+	narrowAxis(boxes.minZ, boxes.maxZ, segment.start.z, segment.invDir.z);
+
+	return static_cast<unsigned int>(_mm_movemask_ps(_mm_cmple_ps(tMin, tMax)));
+}
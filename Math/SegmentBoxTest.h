@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Line segment against axis-aligned box tests, one box at a time or four at once with SSE
+//--------------------------------------------------------------------------------------
+// Both tests use the slab method: for each axis find the part of the segment between the box's two planes on that axis, the
+// segment hits the box if those parts overlap. The segment is prepared once (PrepareSegment) and can then be tested against
+// any number of boxes without further divisions.
+//
+// Axes the segment doesn't move along are handled without dividing by zero: the inverse direction is replaced with a very
+// large value of the same sign, so the segment is either entirely between the planes on that axis (start inside the box
+// on that axis, including exactly on a face) or entirely outside them. No NaNs are produced, so the results are well defined.
+//
+// The single box and four box tests perform the same operations, so they always give the same result for the same box
+//
+//   PreparedSegment segment = PrepareSegment(start, end);
+//   bool hit = SegmentHitsBox(segment, boxMin, boxMax);
+//   unsigned int hits = SegmentHitsBoxes4(segment, boxGroup); // Bit n set if box n in the group is hit
+
+#ifndef _SEGMENT_BOX_TEST_H_INCLUDED_
+#define _SEGMENT_BOX_TEST_H_INCLUDED_
+
+#include "Vector3.h"
+
+
+// Segment from start to end prepared for testing against boxes
+struct PreparedSegment
+{
+	Vector3 start;
+	Vector3 invDir; // 1 / (end - start) for each axis, with zero components replaced as described above
+};
+
+// Four boxes in structure-of-arrays form for SegmentHitsBoxes4, box n uses element n of each array
+struct BoxGroup4
+{
+	alignas(16) float minX[4];
+	alignas(16) float minY[4];
+	alignas(16) float minZ[4];
+	alignas(16) float maxX[4];
+	alignas(16) float maxY[4];
+	alignas(16) float maxZ[4];
+
+	// Set box n of the group
+	void Set(int n, const Vector3& boxMin, const Vector3& boxMax)
+	{
+		minX[n] = boxMin.x;  minY[n] = boxMin.y;  minZ[n] = boxMin.z;
+		maxX[n] = boxMax.x;  maxY[n] = boxMax.y;  maxZ[n] = boxMax.z;
+	}
+};
+
+
+// Prepare the segment from start to end for the tests below
+PreparedSegment PrepareSegment(const Vector3& start, const Vector3& end);
+
+// Returns true if the segment touches or passes through the box
+bool SegmentHitsBox(const PreparedSegment& segment, const Vector3& boxMin, const Vector3& boxMax);
+
+// Test the segment against all four boxes in the group at once. Returns a mask with bit n set if box n is hit
+unsigned int SegmentHitsBoxes4(const PreparedSegment& segment, const BoxGroup4& boxes);
+
+
+#endif //_SEGMENT_BOX_TEST_H_INCLUDED_
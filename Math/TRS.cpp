@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// TRS transform - a position, rotation and scale held separately
+//--------------------------------------------------------------------------------------
+
+#include "TRS.h"
+
+
+// The matrix for this transform
+Matrix4x4 TRS::ToMatrix() const
+{
+	Matrix4x4 m = rotation.ToMatrix();
+	m.Row(0) *= scale.x;
+	m.Row(1) *= scale.y;
+	m.Row(2) *= scale.z;
+	m.Position() = position;
+	return m;
+}
+
+
+void TRS::Rotate(const Quaternion& turn, bool local)
+{
+	rotation = local ? turn * rotation : rotation * turn;
+	rotation.Normalise();
+}
+
+
+// The TRS of a matrix made from a position, rotation and scaling
+TRS TRSFromMatrix(const Matrix4x4& m)
+{
+	TRS trs;
+	trs.position = m.Position();
+	trs.rotation = QuaternionFromMatrix(m);
+	trs.scale    = m.GetScale();
+	return trs;
+}
+
+
+// The transform child then parent, the same order as multiplying their matrices
+TRS operator*(const TRS& child, const TRS& parent)
+{
+	TRS result;
+	Vector3 scaledPosition = { child.position.x * parent.scale.x, child.position.y * parent.scale.y, child.position.z * parent.scale.z };
+	result.position = parent.rotation.Rotate(scaledPosition) + parent.position;
+	result.rotation = child.rotation * parent.rotation;
+	result.scale    = { child.scale.x * parent.scale.x, child.scale.y * parent.scale.y, child.scale.z * parent.scale.z };
+	return result;
+}
+
+
+// Blend from a to b, a straight line for position and scale and Slerp for rotation
+TRS Interpolate(const TRS& a, const TRS& b, float t)
+{
+	TRS result;
+	result.position = a.position + (b.position - a.position) * t;
+	result.rotation = Slerp(a.rotation, b.rotation, t);
+	result.scale    = a.scale + (b.scale - a.scale) * t;
+	return result;
+}
@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------
+// TRS transform - a position, rotation and scale held separately
+//--------------------------------------------------------------------------------------
+// The compact alternative to a 4x4 matrix for things that are turned a little every frame: 10 floats rather than 16, with
+// the rotation a Quaternion so each turn is cheap and exact. Position, rotation and scale can be read or changed directly
+// rather than extracting them from a matrix (Matrix4x4::GetRotation, GetScale), which is slow and, for the rotation, goes
+// through Euler angles. The matrix is made from it once when needed for rendering with ToMatrix.
+//
+// Combining TRS transforms and converting to a matrix both apply scale, then rotation, then position, which is the order
+// matrices in this app are built in (e.g. Matrix4x4(position, rotation, scale)). Non-uniform scales only combine exactly
+// when the parent's scale is uniform, as is the case for everything the app uses them for
+//
+//   TRS spin = TRSFromMatrix(Transform());        // Once, when the entity is created
+//   spin.RotateLocalY(turnSpeed * frameTime);     // Each frame
+//   Transform() = spin.ToMatrix();
+
+#ifndef _TRS_H_INCLUDED_
+#define _TRS_H_INCLUDED_
+
+#include "Quaternion.h"
+#include "Vector3.h"
+#include "Matrix4x4.h"
+
+
+struct TRS
+{
+	Vector3    position = { 0, 0, 0 };
+	Quaternion rotation;              // Identity by default
+	Vector3    scale    = { 1, 1, 1 };
+
+	// The matrix for this transform
+	Matrix4x4 ToMatrix() const;
+
+	// Rotate around the transform's own axes, as Matrix4x4::RotateLocalX/Y/Z. The rotation is renormalised each time, so
+	// any number of small turns don't build up errors. A non-uniform scale turns with the axes rather than skewing them
+	void RotateLocalX(float x)  { Rotate(QuaternionRotationX(x), true); }
+	void RotateLocalY(float y)  { Rotate(QuaternionRotationY(y), true); }
+	void RotateLocalZ(float z)  { Rotate(QuaternionRotationZ(z), true); }
+
+	// Rotate around the world (or parent) axes, as Matrix4x4::RotateX/Y/Z. Does not move the position
+	void RotateX(float x)  { Rotate(QuaternionRotationX(x), false); }
+	void RotateY(float y)  { Rotate(QuaternionRotationY(y), false); }
+	void RotateZ(float z)  { Rotate(QuaternionRotationZ(z), false); }
+
+	// Turn the Z axis to face the given direction keeping the position and scale, as Matrix4x4::FaceDirection
+	void FaceDirection(const Vector3& direction)  { rotation = QuaternionFacing(direction); }
+
+	// Facing direction, the rotated Z axis (unscaled)
+	Vector3 Facing() const  { return rotation.Rotate({ 0, 0, 1 }); }
+
+private:
+	void Rotate(const Quaternion& turn, bool local);
+};
+
+
+// The TRS of a matrix made from a position, rotation and scaling (possibly non-uniform)
+TRS TRSFromMatrix(const Matrix4x4& m);
+
+// The transform child then parent, the same order as multiplying their matrices (child * parent)
+TRS operator*(const TRS& child, const TRS& parent);
+
+// Blend from a (t = 0) to b (t = 1), a straight line for position and scale and Slerp for rotation
+TRS Interpolate(const TRS& a, const TRS& b, float t);
+
+
+#endif //_TRS_H_INCLUDED_
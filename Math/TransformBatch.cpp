@@ -0,0 +1,113 @@
+//--------------------------------------------------------------------------------------
+// Batched transforms - many matrices or points processed in one tight loop
+//--------------------------------------------------------------------------------------
+
+#include "TransformBatch.h"
+
+#include <xmmintrin.h> // SSE, always available on x64
+
+
+// Multiply out a hierarchy of parent-relative matrices into absolute ones
+void MultiplyByParents(const Matrix4x4& root, const Matrix4x4* locals, const uint32_t* parents, unsigned int count, Matrix4x4* out)
+{
+	if (count == 0)  return;
+
+	// Each multiply is itself done with SSE for float matrices (see Matrix4x4SIMD.h). The parents array is separate from the
+	// rest of the node data so this loop only reads the matrices and the indices
+	out[0] = root;
+	for (unsigned int node = 1; node < count; ++node)
+	{
+		out[node] = locals[node - 1] * out[parents[node]];
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Points
+-----------------------------------------------------------------------------------------*/
+
+// Transform the points by the matrix (as points, w = 1) into out
+void TransformPoints(const Matrix4x4& m, const PointsSoA& points, PointsSoA& out)
+{
+	size_t count = points.Size();
+	out.Resize(count);
+	const float* px = points.x.data();  const float* py = points.y.data();  const float* pz = points.z.data();
+	float* ox = out.x.data();  float* oy = out.y.data();  float* oz = out.z.data();
+
+	// Four points at a time, each matrix element is spread across a register once before the loop
+	size_t i = 0;
+	__m128 m00 = _mm_set1_ps(m.e00), m01 = _mm_set1_ps(m.e01), m02 = _mm_set1_ps(m.e02);
+	__m128 m10 = _mm_set1_ps(m.e10), m11 = _mm_set1_ps(m.e11), m12 = _mm_set1_ps(m.e12);
+	__m128 m20 = _mm_set1_ps(m.e20), m21 = _mm_set1_ps(m.e21), m22 = _mm_set1_ps(m.e22);
+	__m128 m30 = _mm_set1_ps(m.e30), m31 = _mm_set1_ps(m.e31), m32 = _mm_set1_ps(m.e32);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+		__m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)), m30);
+		__m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)), m31);
+		__m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22)), m32);
+		_mm_storeu_ps(ox + i, rx);
+		_mm_storeu_ps(oy + i, ry);
+		_mm_storeu_ps(oz + i, rz);
+	}
+
+	// Leftover points with the same operations
+	for (; i < count; ++i)
+	{
+		float x = px[i], y = py[i], z = pz[i];
+		ox[i] = x * m.e00 + y * m.e10 + z * m.e20 + m.e30;
+		oy[i] = x * m.e01 + y * m.e11 + z * m.e21 + m.e31;
+		oz[i] = x * m.e02 + y * m.e12 + z * m.e22 + m.e32;
+	}
+}
+
+
+// Project world points to pixels with a camera's view-projection matrix and the viewport size
+void ProjectToPixels(const Matrix4x4& m, float nearClip, float viewportWidth, float viewportHeight,
+                     const PointsSoA& points, PointsSoA& pixels)
+{
+	size_t count = points.Size();
+	pixels.Resize(count);
+	const float* px = points.x.data();  const float* py = points.y.data();  const float* pz = points.z.data();
+	float* ox = pixels.x.data();  float* oy = pixels.y.data();  float* oz = pixels.z.data();
+
+	// Clip space x, y and w are needed, z isn't. Pixel x = (x / w + 1) * width / 2 and pixel y = (1 - y / w) * height / 2
+	float halfWidth  = viewportWidth  * 0.5f;
+	float halfHeight = viewportHeight * 0.5f;
+
+	size_t i = 0;
+	__m128 m00 = _mm_set1_ps(m.e00), m01 = _mm_set1_ps(m.e01), m03 = _mm_set1_ps(m.e03);
+	__m128 m10 = _mm_set1_ps(m.e10), m11 = _mm_set1_ps(m.e11), m13 = _mm_set1_ps(m.e13);
+	__m128 m20 = _mm_set1_ps(m.e20), m21 = _mm_set1_ps(m.e21), m23 = _mm_set1_ps(m.e23);
+	__m128 m30 = _mm_set1_ps(m.e30), m31 = _mm_set1_ps(m.e31), m33 = _mm_set1_ps(m.e33);
+	__m128 one = _mm_set1_ps(1.0f), minW = _mm_set1_ps(nearClip);
+	__m128 scaleX = _mm_set1_ps(halfWidth), scaleY = _mm_set1_ps(halfHeight);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)), m30);
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)), m31);
+		__m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m03), _mm_mul_ps(y, m13)), _mm_mul_ps(z, m23)), m33);
+
+		// Points behind the near clip may divide by zero, their results are masked to 0 so no infinities or NaNs are stored
+		__m128 visible = _mm_cmpge_ps(cw, minW);
+		__m128 pixelX = _mm_mul_ps(_mm_add_ps(_mm_div_ps(cx, cw), one), scaleX);
+		__m128 pixelY = _mm_mul_ps(_mm_sub_ps(one, _mm_div_ps(cy, cw)), scaleY);
+		_mm_storeu_ps(ox + i, _mm_and_ps(pixelX, visible));
+		_mm_storeu_ps(oy + i, _mm_and_ps(pixelY, visible));
+		_mm_storeu_ps(oz + i, cw);
+	}
+
+	// Leftover points with the same operations
+	for (; i < count; ++i)
+	{
+		float x = px[i], y = py[i], z = pz[i];
+		float cx = x * m.e00 + y * m.e10 + z * m.e20 + m.e30;
+		float cy = x * m.e01 + y * m.e11 + z * m.e21 + m.e31;
+		float cw = x * m.e03 + y * m.e13 + z * m.e23 + m.e33;
+		bool visible = cw >= nearClip;
+		ox[i] = visible ? (cx / cw + 1.0f) * halfWidth  : 0.0f;
+		oy[i] = visible ? (1.0f - cy / cw) * halfHeight : 0.0f;
+		oz[i] = cw;
+	}
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Batched transforms - many matrices or points processed in one tight loop
+//--------------------------------------------------------------------------------------
+// Functions for the places that transform a whole set of things by the same matrix, or a whole hierarchy at once, rather than
+// making one function call per item: mesh hierarchies, text labels and screen picking. Points are given in structure-of-arrays
+// form (PointsSoA), so four points at a time are loaded into SSE registers and each matrix element is only loaded once. The
+// leftover points at the end of the arrays are done one at a time with the same operations, so results don't depend on where
+// a point is in the arrays
+//
+//   MultiplyByParents(root, localMatrices, parentIndices, numNodes, worldMatrices);
+//
+//   PointsSoA labels, pixels;
+//   labels.Add(position); ...
+//   ProjectToPixels(camera.GetViewProjectionMatrix(), camera.GetNearClip(), viewportWidth, viewportHeight, labels, pixels);
+//   if (pixels.z[n] >= camera.GetNearClip())  ... // pixels.x[n], pixels.y[n] is on screen
+
+#ifndef _TRANSFORM_BATCH_H_INCLUDED_
+#define _TRANSFORM_BATCH_H_INCLUDED_
+
+#include "Matrix4x4.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// Points in structure-of-arrays form, point n uses element n of each array
+struct PointsSoA
+{
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+	size_t Size() const  { return x.size(); }
+
+	// Clearing keeps the capacity, so a PointsSoA kept from frame to frame doesn't reallocate
+	void Clear()  { x.clear();  y.clear();  z.clear(); }
+	void Resize(size_t size)  { x.resize(size);  y.resize(size);  z.resize(size); }
+	void Reserve(size_t size)  { x.reserve(size);  y.reserve(size);  z.reserve(size); }
+
+	void Add(const Vector3& point)  { x.push_back(point.x);  y.push_back(point.y);  z.push_back(point.z); }
+	Vector3 Get(size_t n) const  { return { x[n], y[n], z[n] }; }
+};
+
+
+// Multiply out a hierarchy of parent-relative matrices into absolute ones: out[0] = root, then out[n] = locals[n - 1] * out[parents[n]]
+// for n from 1 to count - 1. Parents must come before their children (parents[n] < n), as in a mesh's depth-first node order.
+// The locals array holds count - 1 matrices and can be nullptr if count is 1. parents[0] is not used
+void MultiplyByParents(const Matrix4x4& root, const Matrix4x4* locals, const uint32_t* parents, unsigned int count, Matrix4x4* out);
+
+// Transform the points by the matrix (as points, w = 1) into out, which is resized to match. out can be the same as points
+void TransformPoints(const Matrix4x4& matrix, const PointsSoA& points, PointsSoA& out);
+
+// Project world points to pixels with a camera's view-projection matrix and the viewport size, the same result as
+// Camera::PixelFromWorldPt for each point. pixels is resized to match and can be the same as points. pixels.x and pixels.y are
+// the pixel coordinates and pixels.z the distance in front of the camera (clip space w). Points nearer than nearClip are behind
+// the camera or too close to be seen, for those x and y are 0
+void ProjectToPixels(const Matrix4x4& viewProjection, float nearClip, float viewportWidth, float viewportHeight,
+                     const PointsSoA& points, PointsSoA& pixels);
+
+
+#endif //_TRANSFORM_BATCH_H_INCLUDED_
@@ -2,9 +2,10 @@
 // Vector2 class, encapsulating (x,y) coordinate and supporting functions
 // Supports, float (Vector2), double (Vector2d) and int (Vector2i)
 //--------------------------------------------------------------------------------------
-// Template classes usually put all code in header file. However, here we use explicit template instantiation at the
-// end of the .cpp file (see the comment there), which allows us to put the code in the cpp file and just the class
-// interface here, just like an ordinary non-templated class
+// All the code is in this header so that these small functions can be inlined into the code using them. Everything except
+// the functions needing a square root is constexpr, so vectors can be compile-time constants and calculations on constants
+// are done by the compiler, e.g.
+//     constexpr Vector2 halfSize = Vector2{ 800, 600 } * 0.5f;
 
 #ifndef _VECTOR2_H_DEFINED_
 #define _VECTOR2_H_DEFINED_
@@ -37,23 +38,15 @@ public:
 
     // Default constructor - leaves values uninitialised (for performance)
     #pragma warning(suppress: 26495) // disable warning about constructor leaving things uninitialised ("suppress" affects next line only)
-    Vector2T() {}
+    constexpr Vector2T() {}
 
     // Construct with 2 values
-    Vector2T(const T xIn, const T yIn)
-    {
-        x = xIn;
-        y = yIn;
-    }
+    constexpr Vector2T(const T xIn, const T yIn) : x(xIn), y(yIn) {}
 
     // Construct using a pointer to 2 values
-    explicit Vector2T(const T* elts) // explicit means don't allow conversion from pointer to Vector2 without writing the constructor name
-		                             // i.e. Vector2 v = somepointer; // Not allowed      Vector2 v = Vector2(somepointer); // OK, explicitly asked for constructor
-    {
-        // See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
-        x = elts[0];
-        y = elts[1];
-    }
+    explicit constexpr Vector2T(const T* elts) // explicit means don't allow conversion from pointer to Vector2 without writing the constructor name
+		                                       // i.e. Vector2 v = somepointer; // Not allowed      Vector2 v = Vector2(somepointer); // OK, explicitly asked for constructor
+        : x(elts[0]), y(elts[1]) {} // See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
 
 
     /*-----------------------------------------------------------------------------------------
@@ -61,24 +54,34 @@ public:
     -----------------------------------------------------------------------------------------*/
 
     // Addition of another vector to this one, e.g. Position += Velocity
-    Vector2T& operator+= (const Vector2T& v);
+    constexpr Vector2T& operator+= (const Vector2T& v)  { x += v.x;  y += v.y;  return *this; }
 
     // Subtraction of another vector from this one, e.g. Velocity -= Gravity
-    Vector2T& operator-= (const Vector2T& v);
+    constexpr Vector2T& operator-= (const Vector2T& v)  { x -= v.x;  y -= v.y;  return *this; }
 
     // Negate this vector (e.g. Velocity = -Velocity)
-    Vector2T& operator- ();
+    constexpr Vector2T& operator- ()  { x = -x;  y = -y;  return *this; }
 
     // Plus sign in front of vector - called unary positive and usually does nothing. Included for completeness (e.g. Velocity = +Velocity)
-    Vector2T& operator+ ();
+    constexpr Vector2T& operator+ ()  { return *this; }
 
 	// Multiply vector by scalar (scales vector)
     // Integer vectors can be multiplied by a float but the resulting vector will rounded to integers
-    Vector2T& operator*= (FloatTypeFor<T> s);
+    constexpr Vector2T& operator*= (FloatTypeFor<T> s)
+    {
+        x = static_cast<T>(x * s);
+        y = static_cast<T>(y * s);
+        return *this;
+    }
 
 	// Divide vector by scalar (scales vector)
     // Integer vectors can be divided by a float but the resulting vector will rounded to integers
-    Vector2T& operator/= (FloatTypeFor<T> s);
+    constexpr Vector2T& operator/= (FloatTypeFor<T> s)
+    {
+        x = static_cast<T>(x / s);
+        y = static_cast<T>(y / s);
+        return *this;
+    }
 
 
     /*-----------------------------------------------------------------------------------------
@@ -86,7 +89,7 @@ public:
     -----------------------------------------------------------------------------------------*/
 
     // Returns length of the vector (return value always floating point, even with an integer vector)
-    FloatTypeFor<T> Length() const;
+    FloatTypeFor<T> Length() const  { return static_cast<FloatTypeFor<T>>(std::sqrt(x * x + y * y)); }
 };
 
 
@@ -94,16 +97,25 @@ public:
     Non-member operators
 -----------------------------------------------------------------------------------------*/
 // Vector-vector addition
-template <typename T> Vector2T<T> operator+ (const Vector2T<T>& v, const Vector2T<T>& w);
+template <typename T> constexpr Vector2T<T> operator+ (const Vector2T<T>& v, const Vector2T<T>& w)  { return { v.x + w.x, v.y + w.y }; }
 
 // Vector-vector subtraction
-template <typename T> Vector2T<T> operator- (const Vector2T<T>& v, const Vector2T<T>& w);
+template <typename T> constexpr Vector2T<T> operator- (const Vector2T<T>& v, const Vector2T<T>& w)  { return { v.x - w.x, v.y - w.y }; }
 
 // Vector-scalar multiplication & division
 // Integer vectors can be multiplied/divided by a float but the resulting vector will rounded to integers
-template <typename T> Vector2T<T> operator* (const Vector2T<T>& v, FloatTypeFor<T> s);
-template <typename T> Vector2T<T> operator* (FloatTypeFor<T> s, const Vector2T<T>& v);
-template <typename T> Vector2T<T> operator/ (const Vector2T<T>& v, FloatTypeFor<T> s);
+template <typename T> constexpr Vector2T<T> operator* (const Vector2T<T>& v, FloatTypeFor<T> s)
+{
+    return { static_cast<T>(v.x * s), static_cast<T>(v.y * s) };
+}
+template <typename T> constexpr Vector2T<T> operator* (FloatTypeFor<T> s, const Vector2T<T>& v)
+{
+    return { static_cast<T>(v.x * s), static_cast<T>(v.y * s) };
+}
+template <typename T> constexpr Vector2T<T> operator/ (const Vector2T<T>& v, FloatTypeFor<T> s)
+{
+    return { static_cast<T>(v.x / s), static_cast<T>(v.y / s) };
+}
 
 
 /*-----------------------------------------------------------------------------------------
@@ -114,10 +126,20 @@ template <typename T> Vector2T<T> operator/ (const Vector2T<T>& v, FloatTypeFor<
 template <typename T> FloatTypeFor<T> Distance(const Vector2T<T>& v1, const Vector2T<T>& v2)  { return (v2 - v1).Length(); }
 
 // Dot product of two given vectors (order not important) - non-member version
-template <typename T> T Dot(const Vector2T<T>& v1, const Vector2T<T>& v2);
+template <typename T> constexpr T Dot(const Vector2T<T>& v1, const Vector2T<T>& v2)  { return v1.x * v2.x + v1.y * v2.y; }
 
 // Return unit length vector in the same direction as given one (not supported for int coordinates Vector2i)
-template <typename T> Vector2T<T> Normalise(const Vector2T<T>& v);
+template <typename T> Vector2T<T> Normalise(const Vector2T<T>& v)
+{
+    static_assert(std::is_floating_point_v<T>, "Normalise does not make sense for Vector2i (integer coordinates)");
+    T lengthSq = v.x*v.x + v.y*v.y;
+
+    // Can't normalise zero length vector
+    if (IsZero(lengthSq))  return { 0, 0 };
+
+    T invLength = InvSqrt(lengthSq);
+    return { v.x * invLength, v.y * invLength };
+}
 
 
 #endif // _VECTOR2_H_DEFINED_
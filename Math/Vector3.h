@@ -2,9 +2,10 @@
 // Vector3 class, encapsulating (x,y,z) coordinates and supporting functions
 // Supports float (Vector3), double (Vector3d) and int (Vector3i)
 //--------------------------------------------------------------------------------------
-// Template classes usually put all code in header file. However, here we use explicit template instantiation at the
-// end of the .cpp file (see the comment there), which allows us to put the code in the cpp file and just the class
-// interface here, just like an ordinary non-templated class
+// All the code is in this header so that these small functions can be inlined into the code using them. Everything except
+// the functions needing a square root is constexpr, so vectors can be compile-time constants and calculations on constants
+// are done by the compiler, e.g.
+//     constexpr Vector3 areaCentre = (areaMin + areaMax) * 0.5f;
 
 #ifndef _VECTOR3_H_DEFINED_
 #define _VECTOR3_H_DEFINED_
@@ -39,25 +40,15 @@ public:
 
 	// Default constructor - leaves values uninitialised (for performance)
     #pragma warning(suppress: 26495) // disable warning about constructor leaving things uninitialised ("suppress" affects next line only)
-    Vector3T() {}
+    constexpr Vector3T() {}
 
 	// Construct with 3 values
-	Vector3T(const T xIn, const T yIn, const T zIn)
-	{
-		x = xIn;
-		y = yIn;
-		z = zIn;
-	}
-	
+	constexpr Vector3T(const T xIn, const T yIn, const T zIn) : x(xIn), y(yIn), z(zIn) {}
+
     // Construct using a pointer to three values
-    explicit Vector3T(const T* elts) // explicit means don't allow conversion from pointer to Vector3 without writing the constructor name
-                                     // i.e. Vector3 v = somepointer; // Not allowed      Vector3 v = Vector3(somepointer); // OK, explicitly asked for constructor
-    {
-        // See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
-        x = elts[0];
-        y = elts[1];
-        z = elts[2];
-    }
+    explicit constexpr Vector3T(const T* elts) // explicit means don't allow conversion from pointer to Vector3 without writing the constructor name
+                                               // i.e. Vector3 v = somepointer; // Not allowed      Vector3 v = Vector3(somepointer); // OK, explicitly asked for constructor
+        : x(elts[0]), y(elts[1]), z(elts[2]) {} // See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
 
 
     /*-----------------------------------------------------------------------------------------
@@ -65,24 +56,36 @@ public:
     -----------------------------------------------------------------------------------------*/
 
     // Addition of another vector to this one, e.g. Position += Velocity
-    Vector3T& operator+= (const Vector3T& v);
+    constexpr Vector3T& operator+= (const Vector3T& v)  { x += v.x;  y += v.y;  z += v.z;  return *this; }
 
     // Subtraction of another vector from this one, e.g. Velocity -= Gravity
-    Vector3T& operator-= (const Vector3T& v);
+    constexpr Vector3T& operator-= (const Vector3T& v)  { x -= v.x;  y -= v.y;  z -= v.z;  return *this; }
 
     // Negate this vector (e.g. Velocity = -Velocity)
-    Vector3T& operator- ();
+    constexpr Vector3T& operator- ()  { x = -x;  y = -y;  z = -z;  return *this; }
 
     // Plus sign in front of vector - called unary positive and usually does nothing. Included for completeness (e.g. Velocity = +Velocity)
-    Vector3T& operator+ ();
+    constexpr Vector3T& operator+ ()  { return *this; }
 
     // Multiply vector by scalar (scales vector)
     // Integer vectors can be multiplied by a float but the resulting vector will rounded to integers
-    Vector3T& operator*= (FloatTypeFor<T> s);
+    constexpr Vector3T& operator*= (FloatTypeFor<T> s)
+    {
+        x = static_cast<T>(x * s);
+        y = static_cast<T>(y * s);
+        z = static_cast<T>(z * s);
+        return *this;
+    }
 
 	// Divide vector by scalar (scales vector)
     // Integer vectors can be divided by a float but the resulting vector will rounded to integers
-    Vector3T& operator/= (FloatTypeFor<T> s);
+    constexpr Vector3T& operator/= (FloatTypeFor<T> s)
+    {
+        x = static_cast<T>(x / s);
+        y = static_cast<T>(y / s);
+        z = static_cast<T>(z / s);
+        return *this;
+    }
 
 
     /*-----------------------------------------------------------------------------------------
@@ -90,25 +93,34 @@ public:
     -----------------------------------------------------------------------------------------*/
 
     // Returns length of the vector (return value always floating point, even with an integer vector)
-    FloatTypeFor<T> Length() const;
+    FloatTypeFor<T> Length() const  { return static_cast<FloatTypeFor<T>>(std::sqrt(x * x + y * y + z * z)); }
 };
-	
+
 
 /*-----------------------------------------------------------------------------------------
     Non-member operators
 -----------------------------------------------------------------------------------------*/
 
 // Vector-vector addition
-template <typename T> Vector3T<T> operator+ (const Vector3T<T>& v, const Vector3T<T>& w);
+template <typename T> constexpr Vector3T<T> operator+ (const Vector3T<T>& v, const Vector3T<T>& w)  { return { v.x + w.x, v.y + w.y, v.z + w.z }; }
 
 // Vector-vector subtraction
-template <typename T> Vector3T<T> operator- (const Vector3T<T>& v, const Vector3T<T>& w);
+template <typename T> constexpr Vector3T<T> operator- (const Vector3T<T>& v, const Vector3T<T>& w)  { return { v.x - w.x, v.y - w.y, v.z - w.z }; }
 
 // Vector-scalar multiplication & division
 // Integer vectors can be multiplied/divided by a float but the resulting vector will rounded to integers
-template <typename T> Vector3T<T> operator* (const Vector3T<T>& v, FloatTypeFor<T> s);
-template <typename T> Vector3T<T> operator* (FloatTypeFor<T> s, const Vector3T<T>& v);
-template <typename T> Vector3T<T> operator/ (const Vector3T<T>& v, FloatTypeFor<T> s);
+template <typename T> constexpr Vector3T<T> operator* (const Vector3T<T>& v, FloatTypeFor<T> s)
+{
+    return { static_cast<T>(v.x * s), static_cast<T>(v.y * s), static_cast<T>(v.z * s) };
+}
+template <typename T> constexpr Vector3T<T> operator* (FloatTypeFor<T> s, const Vector3T<T>& v)
+{
+    return { static_cast<T>(v.x * s), static_cast<T>(v.y * s), static_cast<T>(v.z * s) };
+}
+template <typename T> constexpr Vector3T<T> operator/ (const Vector3T<T>& v, FloatTypeFor<T> s)
+{
+    return { static_cast<T>(v.x / s), static_cast<T>(v.y / s), static_cast<T>(v.z / s) };
+}
 
 
 /*-----------------------------------------------------------------------------------------
@@ -119,16 +131,35 @@ template <typename T> Vector3T<T> operator/ (const Vector3T<T>& v, FloatTypeFor<
 template <typename T> FloatTypeFor<T> Distance(const Vector3T<T>& v1, const Vector3T<T>& v2)  { return (v2 - v1).Length(); }
 
 // Dot product of two given vectors (order not important) - non-member version
-template <typename T> T Dot(const Vector3T<T>& v1, const Vector3T<T>& v2);
+template <typename T> constexpr T Dot(const Vector3T<T>& v1, const Vector3T<T>& v2)  { return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z; }
 
 // Cross product of two given vectors (order is important) - non-member version
-template <typename T> Vector3T<T> Cross(const Vector3T<T>& v1, const Vector3T<T>& v2);
+template <typename T> constexpr Vector3T<T> Cross(const Vector3T<T>& v1, const Vector3T<T>& v2)
+{
+    return { v1.y * v2.z - v1.z * v2.y, v1.z * v2.x - v1.x * v2.z, v1.x * v2.y - v1.y * v2.x };
+}
 
-// Return unit length vector in the same direction as given one
-template <typename T> Vector3T<T> Normalise(const Vector3T<T>& v);
+// Return unit length vector in the same direction as given one (not supported for int coordinates Vector3i)
+template <typename T> Vector3T<T> Normalise(const Vector3T<T>& v)
+{
+    static_assert(std::is_floating_point_v<T>, "Normalise does not make sense for Vector3i (integer coordinates)");
+    T lengthSq = v.x*v.x + v.y*v.y + v.z*v.z;
+
+    // Can't normalise zero length vector
+    if (IsZero(lengthSq))  return { 0, 0, 0 };
 
-template <typename T> Vector3T<T> Lerp(const Vector3T<T>& a, const Vector3T<T>& b, float t);
+    T invLength = InvSqrt(lengthSq);
+    return { v.x * invLength, v.y * invLength, v.z * invLength };
+}
 
-template <typename T> Vector3T<T> OffsetNorm(const Vector3T<T>& offset, float dist);
+// Performs linear interpolation between two values.
+template <typename T> constexpr Vector3T<T> Lerp(const Vector3T<T>& a, const Vector3T<T>& b, float t)  { return a + (b - a) * t; }
+
+// Returns a normalized vector from the given offset if the distance is above a small threshold.
+template <typename T> constexpr Vector3T<T> OffsetNorm(const Vector3T<T>& offset, float dist)
+{
+    if (dist < 0.0001f)  return { 0, 0, 0 };
+    return offset / dist;
+}
 
 #endif // _VECTOR3_H_DEFINED_
@@ -3,9 +3,7 @@
 // Used for points and vectors when they are being multiplied by 4x4 matrices
 // Supports float (Vector4) and double (Vector4d) 
 //--------------------------------------------------------------------------------------
-// Template classes usually put all code in header file. However, here we use explicit template instantiation at the
-// end of the .cpp file (see the comment there), which allows us to put the code in the cpp file and just the class
-// interface here, just like an ordinary non-templated class
+// All the code is in this header and constexpr, like Vector2 and Vector3
 
 #ifndef _VECTOR4_H_DEFINED_
 #define _VECTOR4_H_DEFINED_
@@ -39,41 +37,23 @@ public:
 
 	// Default constructor - leaves values uninitialised (for performance)
 	#pragma warning(suppress: 26495) // disable warning about constructor leaving things uninitialised ("suppress" affects next line only)
-	Vector4T<T>() {}
+	constexpr Vector4T() {}
 
 	// Construct with 4 values
-	Vector4T<T>(const T xIn, const T yIn, const T zIn, const T wIn)
-	{
-		x = xIn;
-		y = yIn;
-		z = zIn;
-		w = wIn;
-	}
+	constexpr Vector4T(const T xIn, const T yIn, const T zIn, const T wIn) : x(xIn), y(yIn), z(zIn), w(wIn) {}
 	
 	// Construct with Vector3 and an additional w value (use to initialise with points (w=1) and vectors (w=0))
-	Vector4T<T>(const Vector3& vIn, const T wIn)
-	{
-		x = vIn.x;
-		y = vIn.y;
-		z = vIn.z;
-		w = wIn;
-	}
+	constexpr Vector4T(const Vector3& vIn, const T wIn) : x(vIn.x), y(vIn.y), z(vIn.z), w(wIn) {}
 	
     // Construct using a pointer to 4 values
-	explicit Vector4T<T>(const T* elts) // explicit means don't allow conversion from pointer to Vector4 without writing the constructor name
-	                                    // i.e. Vector4 v = somepointer; // Not allowed      Vector4 v = Vector4(somepointer); // OK, explicitly asked for constructor
-    {
-		// See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
-		x = elts[0];
-        y = elts[1];
-        z = elts[2];
-        w = elts[3];
-    }
+	explicit constexpr Vector4T(const T* elts) // explicit means don't allow conversion from pointer to Vector4 without writing the constructor name
+	                                           // i.e. Vector4 v = somepointer; // Not allowed      Vector4 v = Vector4(somepointer); // OK, explicitly asked for constructor
+		: x(elts[0]), y(elts[1]), z(elts[2]), w(elts[3]) {} // See comment on similar constructor in Matrix4x4 class regarding this kind of constructor
 
 	// Cast to Vector3 - allows use of Vector3 methods on the x,y,z members only (e.g. dot product)
-	operator Vector3T<T>()
+	constexpr operator Vector3T<T>() const
 	{
-		return Vector3T<T>(&x);
+		return { x, y, z };
 	}
 };
 
@@ -1,60 +1,75 @@
 #include "Obstacle.h"
-#include <algorithm> // for std::min, std::max
+#include "SegmentBoxTest.h"
+
+#include <algorithm>
 #include <cmath>
 
+//------------------------------------------------------------------------------
+// Work out the obstacle's boxes once, obstacles never move after they are created. The mesh's box is in the space of the
+// root matrix, so the obstacle's transform turns it into an oriented box in the world. Its axis-aligned box encloses the
+// corners of that, and is the box itself when the transform only moves and scales
+Obstacle::Obstacle(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, Atom name /*= {}*/,
+                   const Vector3& halfExtents /*= Vector3(0.0f, 0.0f, 0.0f)*/)
+    : Entity(entityTemplate, id, transform, name)
+{
+    bool givenExtents = halfExtents.x > 0.0f || halfExtents.y > 0.0f || halfExtents.z > 0.0f;
+    if (givenExtents || !entityTemplate.GetBoundingBox(mLocalBox.min, mLocalBox.max))
+    {
+        Vector3 extents = givenExtents ? halfExtents : DEFAULT_HALF_EXTENTS;
+        mAABB.min = Transform().Position() - extents;
+        mAABB.max = Transform().Position() + extents;
+        return;
+    }
+
+    const Matrix4x4& world = Transform();
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        Vector3 local = { (corner & 1) ? mLocalBox.max.x : mLocalBox.min.x,
+                          (corner & 2) ? mLocalBox.max.y : mLocalBox.min.y,
+                          (corner & 4) ? mLocalBox.max.z : mLocalBox.min.z };
+        Vector4 transformed = world.TransformPoint(local);
+        Vector3 point = { transformed.x, transformed.y, transformed.z };
+        if (corner == 0)  mAABB.min = mAABB.max = point;
+        mAABB.min = { std::min(mAABB.min.x, point.x), std::min(mAABB.min.y, point.y), std::min(mAABB.min.z, point.z) };
+        mAABB.max = { std::max(mAABB.max.x, point.x), std::max(mAABB.max.y, point.y), std::max(mAABB.max.z, point.z) };
+    }
+
+    // Turned if any axis of the transform has more than one non-zero component, then the segment tests also use the oriented box
+    auto isAxisAligned = [](const Vector3& axis)
+    {
+        const float tiny = 1e-5f * axis.Length();
+        int nonZero = (std::abs(axis.x) > tiny) + (std::abs(axis.y) > tiny) + (std::abs(axis.z) > tiny);
+        return nonZero <= 1;
+    };
+    mOriented = !isAxisAligned(world.XAxis()) || !isAxisAligned(world.YAxis()) || !isAxisAligned(world.ZAxis());
+    if (mOriented)  mWorldToLocal = InverseAffine(world);
+}
+
+
 //------------------------------------------------------------------------------
 // Determines if a line segment (start to end) intersects with an axis-aligned bounding box (AABB).
-// The algorithm uses the Ray-Box intersection algorithm based on the slab method. This method checks 
+// The algorithm uses the Ray-Box intersection algorithm based on the slab method. This method checks
 // the intersection along each axis separately and determines if the segment overlaps with the box.
 // Reference: www.scratchapixel.com. (n.d.). A Minimal Ray-Tracer: Rendering Simple Shapes (Sphere, Cube, Disk, Plane, etc.).
 // Available at: https://www.scratchapixel.com/lessons/3d-basic-rendering/minimal-ray-tracer-rendering-simple-shapes/ray-box-intersection.html
-bool Obstacle::IntersectsLineSegment(const Vector3& start, const Vector3& end)
+//
+// The test itself is shared with the obstacle BVH, which tests four obstacles at a time with the SSE version (see SegmentBoxTest.h)
+// Segments that don't move along an axis are handled there without dividing by zero. A turned obstacle is then tested again
+// in its own space, where its box is axis-aligned
+bool Obstacle::IntersectsLineSegment(const Vector3& start, const Vector3& end) const
 {
-    const AABB& box = mAABB;
-
-    Vector3 dir = end - start;
-    Vector3 invDir;
-    invDir.x = 1.0f / dir.x;
-    invDir.y = 1.0f / dir.y;
-    invDir.z = 1.0f / dir.z;
-
-    int sign[3];
-    sign[0] = (invDir.x < 0);
-    sign[1] = (invDir.y < 0);
-    sign[2] = (invDir.z < 0);
-
-    float tmin, tmax, tymin, tymax, tzmin, tzmax;
-
-    // X-axis
-    tmin = (box.min.x - start.x) * invDir.x;
-    tmax = (box.max.x - start.x) * invDir.x;
-    if (sign[0])
-        std::swap(tmin, tmax);
-
-    // Y-axis
-    tymin = (box.min.y - start.y) * invDir.y;
-    tymax = (box.max.y - start.y) * invDir.y;
-    if (sign[1])
-        std::swap(tymin, tymax);
-
-    if (tmin > tymax || tymin > tmax)
-        return false;
-
-    tmin = std::max(tmin, tymin);
-    tmax = std::min(tmax, tymax);
-
-    // Z-axis
-    tzmin = (box.min.z - start.z) * invDir.z;
-    tzmax = (box.max.z - start.z) * invDir.z;
-    if (sign[2])
-        std::swap(tzmin, tzmax);
-
-    if (tmin > tzmax || tzmin > tmax)
-        return false;
-
-    tmin = std::max(tmin, tzmin);
-    tmax = std::min(tmax, tzmax);
-
-    // Check if the intersection is within the line segment [0, 1]
-    return tmax >= 0.0f && tmin <= 1.0f;
-}
\ No newline at end of file
+    if (!SegmentHitsBox(PrepareSegment(start, end), mAABB.min, mAABB.max))  return false;
+    return !mOriented || HitsOrientedBox(start, end);
+}
+
+
+// Determines if a line segment intersects with the obstacle's box in its own space
+bool Obstacle::HitsOrientedBox(const Vector3& start, const Vector3& end) const
+{
+    if (!mOriented)  return true; // The axis-aligned box is the obstacle's box
+
+    Vector4 localStart = mWorldToLocal.TransformPoint(start);
+    Vector4 localEnd   = mWorldToLocal.TransformPoint(end);
+    return SegmentHitsBox(PrepareSegment({ localStart.x, localStart.y, localStart.z }, { localEnd.x, localEnd.y, localEnd.z }),
+                          mLocalBox.min, mLocalBox.max);
+}
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// Bone palette - the bone matrices of every skinned mesh drawn in a frame, in one structured buffer
+//--------------------------------------------------------------------------------------
+
+#include "BonePalette.h"
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+BonePalette::BonePalette(ID3D11Device* device, ID3D11DeviceContext* context)
+	: mDevice(device), mContext(context)
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Start writing the given number of bone matrices. Returns nullptr on failure
+BonePalette::BoneMatrix* BonePalette::Begin(unsigned int numBones)
+{
+	if (!Reserve(mNextBone + numBones))  return nullptr;
+	mScratch.resize(numBones);
+	return mScratch.data();
+}
+
+
+// Upload the matrices written since Begin and bind the palette. Returns the index of the first of them in the palette
+uint32_t BonePalette::End()
+{
+	uint32_t first = mNextBone;
+	uint32_t numBones = static_cast<uint32_t>(mScratch.size());
+	if (numBones > 0)
+	{
+		// Only the range written is updated, it hasn't been used by any draw this frame so there is nothing to wait for
+		UINT stride = sizeof(BoneMatrix);
+		D3D11_BOX box = { first * stride, 0, 0, (first + numBones) * stride, 1, 1 };
+		mContext->UpdateSubresource(mBuffer, 0, &box, mScratch.data(), 0, 0);
+		mNextBone += numBones;
+		mScratch.clear();
+	}
+	mContext->VSSetShaderResources(SLOT, 1, &mView.p);
+	return first;
+}
+
+
+// Start a new frame, the ranges written in the last frame are reused
+void BonePalette::NextFrame()
+{
+	mLastFrameBones = mNextBone;
+	mNextBone = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Private Functions
+//--------------------------------------------------------------------------------------
+
+// Make sure the palette can hold the given number of bones, replacing it with a larger one if not
+bool BonePalette::Reserve(uint32_t numBones)
+{
+	if (numBones <= mCapacity)  return true;
+
+	uint32_t capacity = (mCapacity > 0) ? mCapacity : INITIAL_CAPACITY;
+	while (capacity < numBones)  capacity *= 2;
+
+	// Default usage as only the new ranges are updated each draw, a dynamic buffer could only be rewritten whole
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.ByteWidth           = capacity * sizeof(BoneMatrix);
+	bufferDesc.Usage               = D3D11_USAGE_DEFAULT;
+	bufferDesc.CPUAccessFlags      = 0;
+	bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = sizeof(BoneMatrix);
+	CComPtr<ID3D11Buffer> buffer;
+	if (FAILED(mDevice->CreateBuffer(&bufferDesc, nullptr, &buffer)))  return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+	viewDesc.Format              = DXGI_FORMAT_UNKNOWN;
+	viewDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+	viewDesc.Buffer.FirstElement = 0;
+	viewDesc.Buffer.NumElements  = capacity;
+	CComPtr<ID3D11ShaderResourceView> view;
+	if (FAILED(mDevice->CreateShaderResourceView(buffer, &viewDesc, &view)))  return false;
+
+	// Draws already made this frame keep the old buffer (bound with its view) alive until they are done with it, so its bones
+	// don't need copying. Ranges are still handed out from mNextBone, leaving the new buffer's start unused until next frame
+	mBuffer   = buffer;
+	mView     = view;
+	mCapacity = capacity;
+	return true;
+}
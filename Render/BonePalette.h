@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------
+// Bone palette - the bone matrices of every skinned mesh drawn in a frame, in one structured buffer
+//--------------------------------------------------------------------------------------
+// Skinned vertex shaders read their bone matrices from this buffer (gBonePalette in Common.hlsli) rather than from a constant
+// buffer, so a mesh isn't limited to the bones that fit in a constant buffer and each skinned draw uploads only the bones it
+// uses. Each draw writes its bones into the next free range of the palette and tells the shader where the range starts with
+// the small skinning constants (SkinningConstants in CBufferTypes.h). A range can hold the bones of several instances one
+// after another, the shader finding an instance's bones from SV_InstanceID and the number of bones per instance, so skinned
+// meshes can be drawn instanced too.
+//
+// Matrices are stored as the first three columns of the row-vector matrices used on the CPU, which is the float4x3 the shader
+// reads, 48 bytes a bone rather than 64. Ranges are never reused within a frame, so the GPU never waits for a draw still
+// reading an earlier range. The buffer is created on first use and grows when a frame needs more bones than it holds
+//
+//   BonePalette::BoneMatrix* bones = DX->Bones()->Begin(numBones); // nullptr on failure
+//   ... write numBones matrices with bones[i].Set(matrix) ...
+//   gSkinningConstants.boneOffset = DX->Bones()->End();
+//   DX->Bones()->NextFrame(); // Once a frame, after everything has been drawn
+
+#ifndef _BONE_PALETTE_H_INCLUDED_
+#define _BONE_PALETTE_H_INCLUDED_
+
+#include "Matrix4x4.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+
+//--------------------------------------------------------------------------------------
+// Bone Palette Class
+//--------------------------------------------------------------------------------------
+class BonePalette
+{
+	//--------------------------------------------------------------------------------------
+	// Types / Constants
+	//--------------------------------------------------------------------------------------
+public:
+	// A bone matrix as the shader reads it, a column_major float4x3
+	struct BoneMatrix
+	{
+		float columns[3][4];
+
+		void Set(const Matrix4x4& m)
+		{
+			columns[0][0] = m.e00;  columns[0][1] = m.e10;  columns[0][2] = m.e20;  columns[0][3] = m.e30;
+			columns[1][0] = m.e01;  columns[1][1] = m.e11;  columns[1][2] = m.e21;  columns[1][3] = m.e31;
+			columns[2][0] = m.e02;  columns[2][1] = m.e12;  columns[2][2] = m.e22;  columns[2][3] = m.e32;
+		}
+	};
+
+	// The shader resource slot the palette is bound to for vertex shaders, must match gBonePalette in Common.hlsli
+	static constexpr unsigned int SLOT = 9;
+
+
+	//--------------------------------------------------------------------------------------
+	// Construction
+	//--------------------------------------------------------------------------------------
+public:
+	// Pass the device and context the palette is created with and uploaded by
+	BonePalette(ID3D11Device* device, ID3D11DeviceContext* context);
+
+
+	//--------------------------------------------------------------------------------------
+	// Usage
+	//--------------------------------------------------------------------------------------
+public:
+	// Start writing the given number of bone matrices. Returns where to write them, or nullptr if the palette couldn't be
+	// created or grown. Call End when they have been written
+	BoneMatrix* Begin(unsigned int numBones);
+
+	// Upload the matrices written since Begin and bind the palette for vertex shaders. Returns the index of the first of them
+	// in the palette, for SkinningConstants::boneOffset
+	uint32_t End();
+
+	// Start a new frame, the ranges written in the last frame are reused
+	void NextFrame();
+
+	// Bones uploaded in the last complete frame, and the number the palette can hold
+	uint32_t NumBones()  { return mLastFrameBones; }
+	uint32_t Capacity()  { return mCapacity; }
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Functions
+	//--------------------------------------------------------------------------------------
+private:
+	// Make sure the palette can hold the given number of bones, replacing it with a larger one if not. Returns false on failure
+	bool Reserve(uint32_t numBones);
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Data
+	//--------------------------------------------------------------------------------------
+private:
+	// The palette starts with space for this many bones, then doubles in size as needed
+	static constexpr uint32_t INITIAL_CAPACITY = 4096;
+
+	ID3D11Device*        mDevice;
+	ID3D11DeviceContext* mContext;
+
+	CComPtr<ID3D11Buffer>             mBuffer;
+	CComPtr<ID3D11ShaderResourceView> mView;
+	uint32_t mCapacity = 0; // In bones
+
+	// Matrices between Begin and End, kept rather than recreated to keep the capacity
+	std::vector<BoneMatrix> mScratch;
+
+	uint32_t mNextBone       = 0; // Start of the free part of the palette this frame
+	uint32_t mLastFrameBones = 0;
+};
+
+
+#endif //_BONE_PALETTE_H_INCLUDED_
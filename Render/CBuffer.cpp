@@ -13,6 +13,34 @@
 #include "CBuffer.h"
 
 
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+// Create the constant buffer manager, pass DirectX device and context. Also creates the per-draw ring buffer if the device
+// supports constant buffer offsets
+CBufferManager::CBufferManager(ID3D11Device* device, ID3D11DeviceContext* context)
+	: mDXDevice(device), mDXContext(context)
+{
+	// Binding part of a buffer needs Direct3D 11.1, and writing to a constant buffer the GPU may be reading from needs no-overwrite
+	// maps of constant buffers. Without both the ring isn't created and the buffers given to UpdateDrawCBuffer are used
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	if (FAILED(mDXContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)(&mDXContext1))) ||
+	    FAILED(mDXDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) ||
+	    !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		return;
+	}
+
+	D3D11_BUFFER_DESC ringDesc = {};
+	ringDesc.BindFlags      = D3D11_BIND_CONSTANT_BUFFER;
+	ringDesc.ByteWidth      = RING_SIZE; // Larger than one constant buffer can be, only a part of it is bound at a time
+	ringDesc.Usage          = D3D11_USAGE_DYNAMIC;
+	ringDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(mDXDevice->CreateBuffer(&ringDesc, nullptr, &mRing)))  mRing = nullptr;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Constant buffer creation
 //--------------------------------------------------------------------------------------
@@ -41,6 +69,7 @@ ID3D11Buffer* CBufferManager::CreateCBuffer(std::size_t size)
 	}
 
 	mCBuffers.push_back(cBuffer);
+	mBufferBytes += cbDesc.ByteWidth;
 	return cBuffer;
 }
 
@@ -59,4 +88,69 @@ void CBufferManager::EnableCBuffer(ID3D11Buffer* buffer, unsigned int slot)
 	mDXContext->DSSetConstantBuffers(slot, 1, &buffer);
 	mDXContext->GSSetConstantBuffers(slot, 1, &buffer);
 	mDXContext->PSSetConstantBuffers(slot, 1, &buffer);
+	mDrawSlotBuffers[slot] = buffer;
+}
+
+
+// Update the constants for the following draws on the given slot of the vertex and pixel shaders, and bind them there. Uses
+// the ring buffer if enabled, otherwise updates the given buffer and binds it to the slot if it isn't already
+void CBufferManager::UpdateDrawCBuffer(ID3D11Buffer* buffer, unsigned int slot, const void* data, std::size_t size)
+{
+	if (mUseRing && mRing != nullptr)
+	{
+		// Start again at the beginning when the ring is full. Discarding gives a fresh buffer, the GPU keeps the old one until it
+		// has finished drawing from it, so nothing written earlier is overwritten while in use
+		bool wrap = (mRingOffset + RingBytes(size) > RING_SIZE);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (SUCCEEDED(mDXContext->Map(mRing, 0, wrap ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped)))
+		{
+			if (wrap)
+			{
+				// The fresh buffer has none of the constants still bound on other slots, so write those again first
+				mRingOffset = 0;
+				++mStats.ringWraps;
+				for (unsigned int otherSlot = 0; otherSlot < D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT; ++otherSlot)
+				{
+					auto& otherData = mDrawSlotData[otherSlot];
+					if (otherSlot != slot && mDrawSlotBuffers[otherSlot] == mRing)  WriteToRing(mapped, otherSlot, otherData.data(), otherData.size());
+				}
+			}
+			WriteToRing(mapped, slot, data, size);
+			mDXContext->Unmap(mRing, 0);
+			++mStats.ringUpdates;
+			gRenderCounters.Add(RenderCounter::CBufferMaps);
+			gRenderCounters.Add(RenderCounter::CBufferBytes, size);
+			return;
+		}
+	}
+
+	// Without the ring, or if it failed to map
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(mDXContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return;
+	std::memcpy(mapped.pData, data, size);
+	mDXContext->Unmap(buffer, 0);
+	gRenderCounters.Add(RenderCounter::CBufferMaps);
+	gRenderCounters.Add(RenderCounter::CBufferBytes, size);
+	if (mDrawSlotBuffers[slot] != buffer)
+	{
+		mDXContext->VSSetConstantBuffers(slot, 1, &buffer);
+		mDXContext->PSSetConstantBuffers(slot, 1, &buffer);
+		mDrawSlotBuffers[slot] = buffer;
+	}
+}
+
+
+// Copy constants into the mapped ring at the next free space and bind that space to the given slot. Keeps a copy of the
+// constants in case the ring wraps while they are still bound
+void CBufferManager::WriteToRing(D3D11_MAPPED_SUBRESOURCE& mapped, unsigned int slot, const void* data, std::size_t size)
+{
+	std::memcpy(static_cast<char*>(mapped.pData) + mRingOffset, data, size);
+	if (data != mDrawSlotData[slot].data())  mDrawSlotData[slot].assign(static_cast<const char*>(data), static_cast<const char*>(data) + size);
+
+	UINT firstConstant = mRingOffset / 16;
+	UINT numConstants  = RingBytes(size) / 16;
+	mDXContext1->VSSetConstantBuffers1(slot, 1, &mRing.p, &firstConstant, &numConstants);
+	mDXContext1->PSSetConstantBuffers1(slot, 1, &mRing.p, &firstConstant, &numConstants);
+	mDrawSlotBuffers[slot] = mRing;
+	mRingOffset += RingBytes(size);
 }
@@ -9,17 +9,29 @@
 // constant buffers. Any code that requires a constant buffer should request it from this class and the calling
 // code will not be  responsible for the lifetime of returned buffer. The CBufferManager will release all
 // its buffers when destroyed. Practically that means that all constant buffers will exist until the app closes
+//
+// Constants that change for every draw (per-mesh and skinning constants) are updated with UpdateDrawCBuffer. Rather than each
+// update discarding its own small buffer, which drivers handle poorly thousands of times a frame, these can be written into
+// one large ring buffer. Each update takes the next 256-byte aligned space in the ring with a no-overwrite Map, which the
+// driver doesn't need to rename or track, and binds just that space to the slot with the Direct3D 11.1 calls
+// VSSetConstantBuffers1 / PSSetConstantBuffers1. The whole ring is discarded only when it wraps round, so the GPU keeps the
+// copy it may still be reading. The ring is only used on the immediate context and needs driver support for constant buffer
+// offsets, otherwise the given buffer is updated as usual
 
 #ifndef _C_BUFFER_H_INCLUDED_
 #define _C_BUFFER_H_INCLUDED_
 
+#include "RenderCounters.h"
+
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
-#include <d3d11.h>
+#include <d3d11_1.h>
 #include <atlbase.h> // For CComPtr (see member variables)
 
 #include <vector>
 #include <string>
 #include <cstddef>
+#include <cstring>
+#include <stdint.h>
 
 
 //--------------------------------------------------------------------------------------
@@ -31,9 +43,9 @@ class CBufferManager
 	// Construction
 	//--------------------------------------------------------------------------------------
 public:
-	// Create the constant buffer manager, pass DirectX device and context
-	CBufferManager(ID3D11Device* device, ID3D11DeviceContext* context)
-		: mDXDevice(device), mDXContext(context) {}
+	// Create the constant buffer manager, pass DirectX device and context. Also creates the per-draw ring buffer if the device
+	// supports constant buffer offsets
+	CBufferManager(ID3D11Device* device, ID3D11DeviceContext* context);
 
 
 	//--------------------------------------------------------------------------------------
@@ -61,13 +73,61 @@ public:
 	// be available to shaders. This is used to update model and camera positions, lighting data etc.
 	template <class T>
 	void UpdateCBuffer(ID3D11Buffer* buffer, const T& bufferData)
+	{
+		UpdateCBuffer(mDXContext, buffer, bufferData);
+	}
+
+	// As above, but update the buffer through the given device context. A deferred context recording on another thread gets its
+	// own copy of the buffer contents, so several can update the same buffer at once
+	template <class T>
+	void UpdateCBuffer(ID3D11DeviceContext* context, ID3D11Buffer* buffer, const T& bufferData)
 	{
 		D3D11_MAPPED_SUBRESOURCE cb;
-		mDXContext->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &cb);
+		context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &cb);
 		memcpy(cb.pData, &bufferData, sizeof(T));
-		mDXContext->Unmap(buffer, 0);
+		context->Unmap(buffer, 0);
+		gRenderCounters.Add(RenderCounter::CBufferMaps);
+		gRenderCounters.Add(RenderCounter::CBufferBytes, sizeof(T));
 	}
 
+	// Update the constants for the following draws on the given slot of the vertex and pixel shaders, and bind them there. Uses
+	// the ring buffer if enabled, otherwise updates the given buffer and binds it to the slot if it isn't already. Only for the
+	// immediate context
+	template <class T>
+	void UpdateDrawCBuffer(ID3D11Buffer* buffer, unsigned int slot, const T& bufferData)
+	{
+		UpdateDrawCBuffer(buffer, slot, &bufferData, sizeof(T));
+	}
+	void UpdateDrawCBuffer(ID3D11Buffer* buffer, unsigned int slot, const void* data, std::size_t size);
+
+	// Enable or disable the per-draw ring buffer, it is only used if supported
+	bool  IsRingSupported()  { return mRing != nullptr; }
+	bool& UseRing()          { return mUseRing; }
+
+	// Statistics for the control panel, totals since the last reset. Updates are those through the ring, wraps count the
+	// times the ring was discarded to start again at the beginning
+	struct Stats
+	{
+		uint32_t ringUpdates = 0;
+		uint32_t ringWraps   = 0;
+	};
+	const Stats& GetStats()    { return mStats; }
+	void         ResetStats()  { mStats = {}; }
+
+	// GPU memory used by the constant buffers created with CreateCBuffer and the per-draw ring, for the memory report
+	uint64_t GetBufferBytes()  { return mBufferBytes + (mRing != nullptr ? RING_SIZE : 0); }
+
+
+	//--------------------------------------------------------------------------------------
+	// Private helper functions
+	//--------------------------------------------------------------------------------------
+private:
+	// Copy constants into the mapped ring at the next free space and bind that space to the given slot
+	void WriteToRing(D3D11_MAPPED_SUBRESOURCE& mapped, unsigned int slot, const void* data, std::size_t size);
+
+	// Space taken in the ring by constants of the given size
+	static unsigned int RingBytes(std::size_t size)  { return static_cast<unsigned int>((size + RING_ALIGNMENT - 1) / RING_ALIGNMENT * RING_ALIGNMENT); }
+
 
 	//--------------------------------------------------------------------------------------
 	// Private Data
@@ -81,9 +141,25 @@ private:
 	// don't need a destructor to release everything from DirectX, it will happen automatically when the CBufferManger
 	// is destroyed. CComPtr requires <atlbase.h> to be included (and the ATL component to be installed as part of Visual Studio)
 	std::vector<CComPtr<ID3D11Buffer>> mCBuffers;
+	uint64_t mBufferBytes = 0;
 
 	// Description of the most recent error from CreateCBuffer
 	std::string mLastError;
+
+	// Per-draw ring buffer, nullptr if constant buffer offsets aren't supported. Offsets are bound in units of 16-byte
+	// constants and must be multiples of 16 constants, hence the 256-byte alignment
+	static constexpr unsigned int RING_SIZE      = 1024 * 1024;
+	static constexpr unsigned int RING_ALIGNMENT = 256;
+	CComPtr<ID3D11DeviceContext1> mDXContext1;
+	CComPtr<ID3D11Buffer>         mRing;
+	unsigned int mRingOffset = RING_SIZE; // Next free byte, starting full so the first update discards
+	bool  mUseRing = true;
+	Stats mStats;
+
+	// The buffer last bound to each slot by UpdateDrawCBuffer, so the given buffers are only bound when needed, and the
+	// constants last written to the ring for each slot
+	ID3D11Buffer*     mDrawSlotBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+	std::vector<char> mDrawSlotData   [D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
 };
 
 
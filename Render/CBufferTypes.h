@@ -12,7 +12,9 @@
 
 #include "MeshTypes.h"
 #include "Matrix4x4.h"
+#include "Vector2.h"
 #include "Vector3.h"
+#include "Vector4.h"
 #include "ColourTypes.h"
 
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
@@ -65,22 +67,206 @@ struct PerCameraConstants
 
 // Data required to render the next mesh in the scene, most importantly its transformation matrices. This data is updated and sent to
 // the GPU several times every frame, once per mesh (or mesh type). Other than that it works in the same way as the per-frame buffer
+// Kept small as it is sent for every node of every rigid mesh, the bone matrices for skinned meshes are in a separate buffer below
 struct PerMeshConstants
 {
 	Matrix4x4  worldMatrix = Matrix4x4::Identity;
 	ColourRGBA meshColour = { 1, 1, 1, 1 };  // Per-mesh colour, typically used to tint it (e.g. tinting light meshes to the colour of the light they emit)
-	Matrix4x4  boneMatrices[MAX_BONES] = {};
 };
 
 
-// Data required to render the material used by the next submesh in the scene. This data is updated and sent to the GPU several times
-// every frame, once per submesh. Other than that it works in the same way as the above buffers
+// Where the next skinned mesh's bone matrices are in the bone palette (see BonePalette.h). Only sent and bound to the vertex shader
+// when a skinned mesh is rendered. Instance i of an instanced draw uses the bones from boneOffset + i * bonesPerInstance
+struct SkinningConstants
+{
+	uint32_t boneOffset       = 0;
+	uint32_t bonesPerInstance = 0;
+	uint32_t padding6[2]      = {};
+};
+
+
+// Data required to render the material used by the next submesh in the scene. These constants don't change after a material is
+// imported, so each RenderState holds its own immutable constant buffer of them and binds it when the material changes
 struct PerMaterialConstants
 {
 	ColourRGBA diffuseColour  = { 1, 1, 1, 1 }; // Alpha will be imported from mesh file
 	ColourRGB  specularColour = { 0, 0, 0 };
 	float      specularPower  = 0;
 	float      parallaxDepth  = 0;
+	uint32_t   materialSlice  = 0;              // Slice of the texture arrays holding this material's textures, if it uses them (see ImportFlags::TextureArrays)
+	float      padding5[2] = {};                // Immutable buffers are created from the structure, so it must fill a multiple of 16 bytes
+
+	// Restores 16-bit vertex positions to model space (see ImportFlags::CompressPositions): position = stored * scale + offset
+	Vector3    positionScale  = { 1, 1, 1 };
+	float      padding6 = {};
+	Vector3    positionOffset = { 0, 0, 0 };
+	float      padding7 = {};
+};
+
+
+// Settings for the compute shader that culls instances on the GPU (see GpuCuller.h). Only bound to the compute shader, which has
+// its own constant buffer slots, so it uses slot 0 there
+struct CullConstants
+{
+	Vector4   frustumPlanes[6];  // The camera frustum planes, see Frustum::PlaneVector
+	uint32_t  numInstances = 0;
+	uint32_t  padding8[3]  = {};
+};
+
+
+// Settings for the compute shader that scatters changes into the scene buffer (see SceneBuffer.h), slot 0 of the compute
+// shaders as above
+struct SceneScatterConstants
+{
+	uint32_t  numUpdates  = 0;
+	uint32_t  padding8[3] = {};
+};
+
+
+// Settings for the particle compute shaders (see ParticleSystem.h), slot 0 of the compute shaders as above. The counts of the
+// particle lists are in a second buffer on slot 1, written on the GPU
+struct ParticleConstants
+{
+	float     frameTime       = 0; // Seconds to move the particles on by
+	float     gravity         = 0;
+	float     drag            = 0; // Fraction of speed lost per second
+	uint32_t  randomSeed      = 0; // Changed every frame so each frame's bursts are different
+	uint32_t  numBursts       = 0;
+	uint32_t  numNewParticles = 0; // In all the bursts
+	float     padding11[2]    = {};
+};
+
+
+// Settings for the GPU missile compute shaders (see GpuMissiles.h), slot 0 of the compute shaders as above
+struct MissileConstants
+{
+	float     frameTime   = 0; // Seconds to move the missiles on by
+	float     gravity     = 0;
+	float     floorHeight = 0; // Missiles below this are gone
+	float     hitRadius   = 0; // Distance from a boat's position that counts as a hit
+	uint32_t  numLaunches = 0;
+	uint32_t  numTargets  = 0; // Boats that can be hit
+	uint32_t  numNodes    = 0; // Drawn nodes of the missile mesh, each with its own matrix
+	uint32_t  numArgs     = 0; // Indirect draws of the missile mesh, one per sub-mesh
+	uint32_t  maxHits     = 0;
+	uint32_t  padding13[3] = {};
+};
+
+
+// Settings for the compute shaders prefiltering the environment map at load (see EnvironmentLighting.h), slot 0 of the compute
+// shaders as above
+struct IBLConstants
+{
+	float     roughness  = 0; // Of the mip-map being prefiltered
+	uint32_t  outputSize = 0; // Texels along each side of the output
+	float     sourceSize = 0; // Texels along each side of the source's top mip-map
+	uint32_t  numSamples = 0;
+};
+
+
+// Settings for finding the light cluster of a pixel (see ClusteredLights.h). Uses slot 6 and stays bound, the Blinn and PBR pixel
+// shaders read it along with the per-frame constants
+struct LightClusterConstants
+{
+	Vector2   origin;          // Top-left of the viewport, in pixels
+	Vector2   tileScale;       // Clusters per pixel across and down the viewport
+	float     sliceScale = 0;  // Depth slice of a view space depth z is log(z) * sliceScale + sliceBias
+	float     sliceBias  = 0;
+	uint32_t  numLights  = 0;
+	float     padding14  = {};
+};
+
+
+// Settings for the tessellated water surface (see WaterRenderer.h). Slot 5 of the vertex, hull, domain and pixel shaders, only bound
+// while drawing the water. Must match Water.hlsli
+struct WaterConstants
+{
+	static constexpr unsigned int NUM_WAVES = 4;
+
+	Vector3    gridCentre;               // Camera position snapped to the innermost patches, at water height
+	float      gridExtent        = 0;    // From the centre to the edge of the grid, world units
+	uint32_t   gridPatches       = 0;    // Patches along each side of the grid
+	float      tessellationScale = 0;    // An edge's tessellation factor is this times its length over its distance from the camera
+	float      maxTessellation   = 0;
+	float      time              = 0;    // Seconds the waves have moved for
+	Vector4    waves[NUM_WAVES];         // Direction x and z (normalised), wavelength, amplitude
+	ColourRGBA diffuseColour;
+	Vector3    specularColour;
+	float      specularPower     = 0;
+	float      uvScale           = 0;    // Texture repeats per world unit
+	float      waveFadeDistance  = 0;    // Waves flatten out towards this distance from the camera, where tessellation is coarse
+	float      steepness         = 0;    // 0 for sine waves to 1 for the sharpest crests without loops
+	float      padding15         = 0;
+};
+
+
+// Settings for upscaling the scene rendered at a reduced resolution to the back buffer (see DynamicResolution.h). Uses slot 5 so the
+// per-frame and other constant buffers stay bound
+struct UpscaleConstants
+{
+	Vector2   uvScale;  // Fraction of the scene texture covered by the scene
+	Vector2   uvMax;    // Centre of the last texel of the scene, sampling is clamped here so nothing outside the scene blends in
+};
+
+
+// Settings for downsampling the depth buffer and compositing the effects drawn at half resolution (see HalfResEffects.h). Also
+// slot 5, it is only bound for those two draws
+struct HalfResConstants
+{
+	uint32_t  sceneWidth     = 0; // Pixels of the scene in the full size depth buffer
+	uint32_t  sceneHeight    = 0;
+	uint32_t  halfWidth      = 0; // Pixels of the half size targets in use
+	uint32_t  halfHeight     = 0;
+	float     depthScale     = 0; // View distance is depthScale / (depth - depthOffset), from the camera's projection matrix
+	float     depthOffset    = 0;
+	float     depthTolerance = 0;
+	float     padding16      = 0;
+};
+
+
+// Settings for drawing the glyphs of text labels (see LabelRenderer.h). Also slot 5, it is only bound while drawing the labels
+struct LabelConstants
+{
+	Vector2   pixelsToClip; // Scale from pixels in the viewport to clip space, 2 / width and -2 / height
+	Vector2   texelsToUV;   // Scale from texels in the font's sprite sheet to texture coordinates, 1 / size
+};
+
+
+// Settings for drawing floating text (see FloatingTextRenderer.h), also slot 5. Times are in seconds and heights in world units
+struct FloatingTextConstants
+{
+	Matrix4x4 viewProjectionMatrix = Matrix4x4::Identity;
+	Vector2   pixelsToClip;
+	Vector2   texelsToUV;
+	float     time;        // Now, on the clock of the popups' start times
+	float     lifetime;
+	float     fadeTime;    // Popups fade out over the end of their lifetime
+	float     startHeight; // Above the popup's point when it starts...
+	float     riseHeight;  // ...rising this far over its lifetime
+	float     lineHeight;  // Pixels between the lines of a stack of popups
+	uint32_t  maxGlyphs;   // Glyphs drawn for each popup, those beyond the end of its text are collapsed
+	float     padding9;
+};
+
+
+// Settings for drawing impostors (see ImpostorRenderer.h), also slot 5
+struct ImpostorConstants
+{
+	uint32_t gridSize;      // Views along each side of the atlas
+	uint32_t firstInstance; // Of this draw in the instance buffer, as SV_InstanceID starts from 0 for every draw
+	float    padding10[2];
+};
+
+
+// The main light's shadow map (see ShadowMap.h). Uses slot 7 and stays bound, the Blinn, PBR and water pixel shaders read it.
+// Must match Shadows.hlsli
+struct ShadowConstants
+{
+	Matrix4x4 viewProjectionMatrix = Matrix4x4::Identity; // World to the shadow map's clip space, depth 0 nearest the light
+	float     texelSize = 0;   // Of the map in UV units, for the filtering
+	float     depthBias = 0;   // In clip space depth
+	uint32_t  enabled   = 0;   // Unbound constants read as zero, so without shadows everything is lit
+	float     padding15 = {};
 };
 
 
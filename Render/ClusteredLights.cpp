@@ -0,0 +1,246 @@
+//--------------------------------------------------------------------------------------
+// Clustered lights - many small point lights for the Blinn and PBR pixel shaders, each pixel lighting only with those near it
+//--------------------------------------------------------------------------------------
+
+#include "ClusteredLights.h"
+#include "Vector4.h"
+
+#include "RenderGlobals.h"
+#include "CBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the cluster buffers and constants. Throws std::runtime_error on failure
+ClusteredLights::ClusteredLights()
+{
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(LightClusterConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Clustered lights: failure creating constant buffer");
+
+	// The cluster buffer is the same size in every view, create it now so a failure shows up here rather than every frame
+	mClusters.assign(NUM_CLUSTERS * 2, 0);
+	if (!UploadStructured(mClusterBuffer, mClusterSRV, mClusterCapacity, mClusters.data(), 2 * sizeof(uint32_t), NUM_CLUSTERS))
+		throw std::runtime_error("Clustered lights: failure creating cluster buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add a light for this frame only
+void ClusteredLights::AddLight(const Vector3& position, const ColourRGB& colour, float radius)
+{
+	if (mLights.size() >= MAX_LIGHTS || radius <= 0)  return;
+	GpuLight light;
+	light.position = position;
+	light.radius   = radius;
+	light.colour   = colour;
+	mLights.push_back(light);
+}
+
+
+// Add a light that fades out over the given lifetime
+void ClusteredLights::AddFlash(const Vector3& position, const ColourRGB& colour, float radius, float lifetime)
+{
+	if (mFlashes.size() >= MAX_LIGHTS || lifetime <= 0)  return;
+	mFlashes.push_back({ position, colour, radius, 0.0f, lifetime });
+}
+
+
+// Age the flashes by the time of a simulation step, removing those that have faded out
+void ClusteredLights::Advance(float stepTime)
+{
+	for (Flash& flash : mFlashes)  flash.age += stepTime;
+	mFlashes.erase(std::remove_if(mFlashes.begin(), mFlashes.end(), [](const Flash& flash) { return flash.age >= flash.lifetime; }),
+	               mFlashes.end());
+}
+
+
+// Start the lights of a new frame with the flashes at their current brightness, fading linearly over their lifetime
+void ClusteredLights::BeginFrame()
+{
+	mLights.clear();
+	for (const Flash& flash : mFlashes)
+	{
+		float brightness = 1.0f - flash.age / flash.lifetime;
+		AddLight(flash.position, ColourRGB(flash.colour.r * brightness, flash.colour.g * brightness, flash.colour.b * brightness),
+		         flash.radius);
+	}
+	mStats.lights  = static_cast<uint32_t>(mLights.size());
+	mStats.flashes = static_cast<uint32_t>(mFlashes.size());
+}
+
+
+// Bin this frame's lights into the clusters of a view for the viewport currently set, and bind the results for the pixel shaders.
+// Each light is counted into the clusters it touches, the counts give each cluster its start in the index list, then the lights
+// are written into their clusters' ranges
+void ClusteredLights::Build(const Matrix4x4& viewMatrix, const Matrix4x4& projectionMatrix, float nearClip, float farClip)
+{
+	auto context = DX->Context();
+
+	// Unbound views read as zero in the shaders, so with nothing bound every cluster is empty
+	ID3D11ShaderResourceView* views[3] = {};
+	mStats.indices = mStats.maxClusterLights = 0;
+	if (!mEnabled || mLights.empty())
+	{
+		context->PSSetShaderResources(LIGHTS_SLOT, 3, views);
+		return;
+	}
+
+	D3D11_VIEWPORT viewport;
+	UINT numViewports = 1;
+	context->RSGetViewports(&numViewports, &viewport);
+	mConstants.origin     = { viewport.TopLeftX, viewport.TopLeftY };
+	mConstants.tileScale  = { CLUSTERS_X / viewport.Width, CLUSTERS_Y / viewport.Height };
+	mConstants.sliceScale = CLUSTERS_Z / std::log(farClip / nearClip);
+	mConstants.sliceBias  = -std::log(nearClip) * mConstants.sliceScale;
+	mConstants.numLights  = static_cast<uint32_t>(mLights.size());
+
+	// Count the lights in each cluster
+	auto clusterIndex = [](uint32_t x, uint32_t y, uint32_t z) { return (z * CLUSTERS_Y + y) * CLUSTERS_X + x; };
+	mClusters.assign(NUM_CLUSTERS * 2, 0);
+	mBounds.resize(mLights.size());
+	for (size_t i = 0; i < mLights.size(); ++i)
+	{
+		ClusterBounds& bounds = mBounds[i];
+		if (!FindClusterBounds(mLights[i], viewMatrix, projectionMatrix, nearClip, farClip, bounds))
+		{
+			bounds = { 1, 0, 1, 0, 1, 0 }; // Empty ranges
+			continue;
+		}
+		for (uint32_t z = bounds.z0; z <= bounds.z1; ++z)
+			for (uint32_t y = bounds.y0; y <= bounds.y1; ++y)
+				for (uint32_t x = bounds.x0; x <= bounds.x1; ++x)
+					++mClusters[clusterIndex(x, y, z) * 2 + 1];
+	}
+
+	// Start each cluster's range after the last, then write the lights into the ranges, counting each range up again as it fills
+	uint32_t numIndices = 0;
+	for (uint32_t cluster = 0; cluster < NUM_CLUSTERS; ++cluster)
+	{
+		uint32_t count = mClusters[cluster * 2 + 1];
+		mStats.maxClusterLights = std::max(mStats.maxClusterLights, count);
+		mClusters[cluster * 2]     = numIndices;
+		mClusters[cluster * 2 + 1] = 0;
+		numIndices += count;
+	}
+	mIndices.resize(numIndices);
+	for (size_t i = 0; i < mLights.size(); ++i)
+	{
+		const ClusterBounds& bounds = mBounds[i];
+		for (uint32_t z = bounds.z0; z <= bounds.z1; ++z)
+			for (uint32_t y = bounds.y0; y <= bounds.y1; ++y)
+				for (uint32_t x = bounds.x0; x <= bounds.x1; ++x)
+				{
+					uint32_t* cluster = &mClusters[clusterIndex(x, y, z) * 2];
+					mIndices[cluster[0] + cluster[1]++] = static_cast<uint32_t>(i);
+				}
+	}
+	mStats.indices = numIndices;
+
+	if (!UploadStructured(mLightBuffer, mLightSRV, mLightCapacity, mLights.data(), sizeof(GpuLight), mConstants.numLights) ||
+	    !UploadStructured(mClusterBuffer, mClusterSRV, mClusterCapacity, mClusters.data(), 2 * sizeof(uint32_t), NUM_CLUSTERS) ||
+	    !UploadStructured(mIndexBuffer, mIndexSRV, mIndexCapacity, mIndices.data(), sizeof(uint32_t), numIndices))
+	{
+		context->PSSetShaderResources(LIGHTS_SLOT, 3, views);
+		return;
+	}
+
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+	DX->CBuffers()->EnableCBuffer(mConstantBuffer, CBUFFER_SLOT);
+	views[0] = mLightSRV;
+	views[1] = mClusterSRV;
+	views[2] = mIndexSRV;
+	context->PSSetShaderResources(LIGHTS_SLOT, 3, views);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Find the clusters a light's sphere may touch in the view, using the depth slicing already in mConstants. The sphere's box in
+// view space is projected to the screen: its extent there lies within the projections of the box's corners at its nearest and
+// furthest depths (clipped to the view). Returns false if it is outside the view
+bool ClusteredLights::FindClusterBounds(const GpuLight& light, const Matrix4x4& viewMatrix, const Matrix4x4& projectionMatrix,
+                                        float nearClip, float farClip, ClusterBounds& bounds)
+{
+	Vector4 centre = viewMatrix.TransformPoint(light.position);
+	float zMin = std::max(centre.z - light.radius, nearClip);
+	float zMax = std::min(centre.z + light.radius, farClip);
+	if (zMin > zMax)  return false;
+
+	float left   = centre.x - light.radius;
+	float right  = centre.x + light.radius;
+	float bottom = centre.y - light.radius;
+	float top    = centre.y + light.radius;
+	float minX = std::min(left   / zMin, left   / zMax) * projectionMatrix.e00;
+	float maxX = std::max(right  / zMin, right  / zMax) * projectionMatrix.e00;
+	float minY = std::min(bottom / zMin, bottom / zMax) * projectionMatrix.e11;
+	float maxY = std::max(top    / zMin, top    / zMax) * projectionMatrix.e11;
+	if (minX > 1 || maxX < -1 || minY > 1 || maxY < -1)  return false;
+
+	// From -1 -> 1 across the view to clusters, y going down the screen as pixels do
+	auto toCluster = [](float value, uint32_t numClusters)
+	{
+		return static_cast<uint32_t>(std::clamp(value, 0.0f, static_cast<float>(numClusters - 1)));
+	};
+	bounds.x0 = toCluster((minX * 0.5f + 0.5f) * CLUSTERS_X, CLUSTERS_X);
+	bounds.x1 = toCluster((maxX * 0.5f + 0.5f) * CLUSTERS_X, CLUSTERS_X);
+	bounds.y0 = toCluster((0.5f - maxY * 0.5f) * CLUSTERS_Y, CLUSTERS_Y);
+	bounds.y1 = toCluster((0.5f - minY * 0.5f) * CLUSTERS_Y, CLUSTERS_Y);
+	bounds.z0 = toCluster(std::log(zMin) * mConstants.sliceScale + mConstants.sliceBias, CLUSTERS_Z);
+	bounds.z1 = toCluster(std::log(zMax) * mConstants.sliceScale + mConstants.sliceBias, CLUSTERS_Z);
+	return true;
+}
+
+
+// Make sure a dynamic structured buffer holds the given elements, growing it in powers of two, then copy them in. Returns false
+// on failure
+bool ClusteredLights::UploadStructured(CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11ShaderResourceView>& srv, unsigned int& capacity,
+                                       const void* elements, unsigned int elementSize, unsigned int numElements)
+{
+	if (numElements == 0)  return true;
+
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numElements > capacity)
+	{
+		unsigned int newCapacity = (capacity > 0) ? capacity : INITIAL_CAPACITY;
+		while (newCapacity < numElements)  newCapacity *= 2;
+		srv      = nullptr;
+		buffer   = nullptr;
+		capacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = newCapacity * elementSize;
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC; // Rewritten for every view
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = elementSize;
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &buffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = newCapacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(buffer, &srvDesc, &srv)))  { buffer = nullptr;  return false; }
+		capacity = newCapacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, elements, static_cast<size_t>(numElements) * elementSize);
+	DX->Context()->Unmap(buffer, 0);
+	return true;
+}
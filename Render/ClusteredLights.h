@@ -0,0 +1,171 @@
+//--------------------------------------------------------------------------------------
+// Clustered lights - many small point lights for the Blinn and PBR pixel shaders, each pixel lighting only with those near it
+//--------------------------------------------------------------------------------------
+// The per-frame constants hold the scene's main light. The extra lights here (missile glows, explosion flashes, reload station
+// lights) go in a structured buffer, and for each view the CPU bins them into clusters: the view is cut into CLUSTERS_X by
+// CLUSTERS_Y tiles on screen and CLUSTERS_Z slices of depth, the slices growing exponentially with view space depth so clusters
+// are roughly as deep as they are wide. A light goes into every cluster its sphere of influence (its radius) may touch, and each
+// cluster has a range of a light index list. A pixel shader finds its cluster from its pixel position and view depth and loops
+// over that cluster's lights only (LightCluster and the lighting helpers in Lights.hlsli), so hundreds of lights cost each pixel
+// about what the few lights near it do.
+//
+// The cluster data is bound to the pixel shader slots from LIGHTS_SLOT and the constants to CBUFFER_SLOT, outside the slots of
+// the material textures, so they stay bound for every draw and are inherited by the render queue's deferred contexts. Lights are
+// fixed for a frame and binned again for each view with the viewport set at the time:
+//
+//   clusteredLights.AddFlash(position, colour, radius, lifetime);  // Any number of times in the simulation steps
+//   clusteredLights.Advance(stepTime);                             // For each simulation step
+//   clusteredLights.BeginFrame();                                  // Once a frame, then...
+//   clusteredLights.AddLight(position, colour, radius);            // ...the lights of this frame
+//   clusteredLights.Build(viewMatrix, projectionMatrix, nearClip, farClip); // For each view, before it is drawn
+//
+// Lights are cosmetic, they are not saved in checkpoints or replays
+
+#ifndef _CLUSTERED_LIGHTS_H_INCLUDED_
+#define _CLUSTERED_LIGHTS_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+
+class ClusteredLights
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the cluster buffers and constants. Throws std::runtime_error on failure
+	ClusteredLights();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Clusters across, down and into each view, must match the values in Lights.hlsli
+	static constexpr uint32_t CLUSTERS_X   = 16;
+	static constexpr uint32_t CLUSTERS_Y   = 9;
+	static constexpr uint32_t CLUSTERS_Z   = 24;
+	static constexpr uint32_t NUM_CLUSTERS = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+	// Most lights in a frame, lights added beyond this are dropped
+	static constexpr uint32_t MAX_LIGHTS = 4096;
+
+	// Pixel shader slots of the lights, the clusters and the light indices (three in a row), and of the cluster constants. Must
+	// match the registers in Lights.hlsli
+	static constexpr unsigned int LIGHTS_SLOT  = 10;
+	static constexpr unsigned int CBUFFER_SLOT = 6;
+
+	// Add a light for this frame only. The colour is its brightness close to it, falling smoothly to nothing at the given radius
+	void AddLight(const Vector3& position, const ColourRGB& colour, float radius);
+
+	// Add a light that fades out over the given lifetime (in seconds of simulation time), e.g. an explosion. May be called from
+	// the simulation steps whichever thread they run on, as long as it is not during BeginFrame
+	void AddFlash(const Vector3& position, const ColourRGB& colour, float radius, float lifetime);
+
+	// Age the flashes by the time of a simulation step, removing those that have faded out. Flashes stay lit while the game is paused
+	void Advance(float stepTime);
+
+	// Start the lights of a new frame with the flashes at their current brightness
+	void BeginFrame();
+
+	// Bin this frame's lights into the clusters of a view, given its camera matrices and clip distances, for the viewport currently
+	// set on the context. Binds the results for the pixel shaders of the draws that follow
+	void Build(const Matrix4x4& viewMatrix, const Matrix4x4& projectionMatrix, float nearClip, float farClip);
+
+	// Whether the clustered lights are used, when off the pixel shaders find no lights in any cluster
+	bool& Enabled()  { return mEnabled; }
+
+	// Lights in this frame, and for the last view built the light indices in all clusters and the most lights in one cluster
+	struct Stats
+	{
+		uint32_t lights           = 0;
+		uint32_t flashes          = 0;
+		uint32_t indices          = 0;
+		uint32_t maxClusterLights = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A light as the shaders read it, must match the PointLight structure in Lights.hlsli
+	struct GpuLight
+	{
+		Vector3   position;
+		float     radius;
+		ColourRGB colour;
+		float     padding = 0;
+	};
+
+	// A light's range of clusters in a view, inclusive
+	struct ClusterBounds
+	{
+		uint32_t x0, x1, y0, y1, z0, z1;
+	};
+
+	struct Flash
+	{
+		Vector3   position;
+		ColourRGB colour;
+		float     radius;
+		float     age;
+		float     lifetime;
+	};
+
+	// Find the clusters a light's sphere may touch in the view. Returns false if it is outside the view
+	bool FindClusterBounds(const GpuLight& light, const Matrix4x4& viewMatrix, const Matrix4x4& projectionMatrix,
+	                       float nearClip, float farClip, ClusterBounds& bounds);
+
+	// Make sure a dynamic structured buffer holds the given elements, then copy them in. Returns false on failure
+	bool UploadStructured(CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11ShaderResourceView>& srv, unsigned int& capacity,
+	                      const void* elements, unsigned int elementSize, unsigned int numElements);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The light and index buffers start with space for this many elements, then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 256;
+
+	bool  mEnabled = true;
+	Stats mStats;
+
+	ID3D11Buffer*         mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	LightClusterConstants mConstants;
+
+	// This frame's lights and the flashes still lit
+	std::vector<GpuLight> mLights;
+	std::vector<Flash>    mFlashes;
+
+	// Scratch for binning, kept rather than recreated to keep the capacity. Each cluster is the start of its range of mIndices
+	// and the number of lights in it
+	std::vector<ClusterBounds> mBounds;
+	std::vector<uint32_t>      mClusters; // Pairs of start and count
+	std::vector<uint32_t>      mIndices;
+
+	CComPtr<ID3D11Buffer>             mLightBuffer;
+	CComPtr<ID3D11ShaderResourceView> mLightSRV;
+	unsigned int                      mLightCapacity = 0;
+	CComPtr<ID3D11Buffer>             mClusterBuffer;
+	CComPtr<ID3D11ShaderResourceView> mClusterSRV;
+	unsigned int                      mClusterCapacity = 0;
+	CComPtr<ID3D11Buffer>             mIndexBuffer;
+	CComPtr<ID3D11ShaderResourceView> mIndexSRV;
+	unsigned int                      mIndexCapacity = 0;
+};
+
+
+#endif //_CLUSTERED_LIGHTS_H_INCLUDED_
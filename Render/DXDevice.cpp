@@ -9,8 +9,33 @@
 #include "Shader.h"
 #include "Texture.h"
 #include "CBuffer.h"
+#include "Geometry.h"
+#include "MeshManager.h"
+#include "GpuProfiler.h"
+#include "BonePalette.h"
+#include "FrameCapture.h"
+#include "StartupProfile.h"
+#include "AssetFiles.h"
+#include "EventTrace.h"
 
 #include <stdexcept>
+#include <algorithm>
+
+
+//--------------------------------------------------------------------------------------
+// Render backends
+//--------------------------------------------------------------------------------------
+
+// Name of a backend for display, e.g. "Direct3D 11"
+const char* RenderBackendName(RenderBackend backend)
+{
+	switch (backend)
+	{
+		case RenderBackend::D3D11:  return "Direct3D 11";
+		case RenderBackend::D3D12:  return "Direct3D 12";
+	}
+	return "Unknown";
+}
 
 
 //--------------------------------------------------------------------------------------
@@ -19,15 +44,26 @@
 
 // Creates DirectX, a swap chain (front/back buffer) attached to given window, a depth buffer of matching size and 
 // manager classes for DirectX resources such as shaders or textures
-DXDevice::DXDevice(HWND window)
+DXDevice::DXDevice(HWND window, RenderBackend backend /*= RenderBackend::D3D11*/)
 {
+    StartupTimer startupTimer("Direct3D device");
     bool debug = true; // Set to true to emit DirectX warnings/errors to the output window
 
+    // Only the Direct3D 11 managers exist, another backend asked for falls back to it. A new backend is chosen here and gets its
+    // own device and managers below, the rest of the renderer reaches them through this class
+    if (backend != RenderBackend::D3D11)
+    {
+        mBackendNote = std::string(RenderBackendName(backend)) + " renderer is not built, using " + RenderBackendName(RenderBackend::D3D11);
+    }
+    mBackend = RenderBackend::D3D11;
+
     // Get the window size
     RECT rect;
     if (!GetClientRect(window, &rect))   throw std::runtime_error("Error querying window size");
     mBackbufferWidth  = rect.right - rect.left;
     mBackbufferHeight = rect.bottom - rect.top;
+    mSceneWidth  = mBackbufferWidth;
+    mSceneHeight = mBackbufferHeight;
 
 
     // Create a DXGI factory - allows us to query graphics hardware / monitors prior to initialising DirectX (although not doing that here)
@@ -40,9 +76,39 @@ DXDevice::DXDevice(HWND window)
     UINT flags = debug ? D3D11_CREATE_DEVICE_DEBUG : 0;
     hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, 0, flags, 0, 0, D3D11_SDK_VERSION, &mD3DDevice, nullptr, &mD3DContext);
     if (FAILED(hr))  throw std::runtime_error("Error creating Direct3D device");
+    mD3DContext->QueryInterface(__uuidof(ID3D11Multithread), (void**)(&mMultithread));
+
+    // The adapter the device was made on, to query its memory use
+    CComPtr<IDXGIDevice>  dxgiDevice;
+    CComPtr<IDXGIAdapter> adapter;
+    if (SUCCEEDED(mD3DDevice->QueryInterface(__uuidof(IDXGIDevice), (void**)(&dxgiDevice))) && SUCCEEDED(dxgiDevice->GetAdapter(&adapter)))
+        adapter->QueryInterface(__uuidof(IDXGIAdapter3), (void**)(&mAdapter));
+
+    // The OS signals an event when it changes the video memory budget, see UpdateVideoMemory
+    if (mAdapter)
+    {
+        mBudgetEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+        if (mBudgetEvent && FAILED(mAdapter->RegisterVideoMemoryBudgetChangeNotificationEvent(mBudgetEvent, &mBudgetCookie)))
+        {
+            CloseHandle(mBudgetEvent);
+            mBudgetEvent = nullptr;
+        }
+    }
+    UpdateVideoMemory();
+
+
+    // Presenting without vsync may tear only if the display supports it. Without tearing such presents still wait for a vertical blank
+    CComPtr<IDXGIFactory5> dxgiFactory5;
+    BOOL allowTearing = FALSE;
+    if (SUCCEEDED(dxgiFactory->QueryInterface(__uuidof(IDXGIFactory5), (void**)(&dxgiFactory5))) &&
+        SUCCEEDED(dxgiFactory5->CheckFeatureSupport(DXGI_FEATURE_PRESENT_ALLOW_TEARING, &allowTearing, sizeof(allowTearing))))
+    {
+        mTearingSupported = (allowTearing == TRUE);
+    }
 
 
     // Create a swap-chain (a back buffer / front buffer to render to) set up for the window passed to this constructor
+    // It has a waitable object to limit the frames queued for display, see WaitForSwapChain
     DXGI_SWAP_CHAIN_DESC1 scDesc = {};
     scDesc.Width  = mBackbufferWidth;
     scDesc.Height = mBackbufferHeight;
@@ -51,7 +117,15 @@ DXDevice::DXDevice(HWND window)
     scDesc.BufferCount = 2;
     scDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
     scDesc.SampleDesc.Count = 1;
-    hr = dxgiFactory->CreateSwapChainForHwnd(mD3DDevice, window, &scDesc, nullptr, nullptr, &mSwapChain);
+    scDesc.Flags = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT | (mTearingSupported ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0);
+    CComPtr<IDXGISwapChain1> swapChain1;
+    hr = dxgiFactory->CreateSwapChainForHwnd(mD3DDevice, window, &scDesc, nullptr, nullptr, &swapChain1);
+    if (SUCCEEDED(hr))  hr = swapChain1->QueryInterface(__uuidof(IDXGISwapChain2), (void**)(&mSwapChain));
+    if (FAILED(hr))  throw std::runtime_error("Error creating swap chain");
+
+    // Only one frame may wait to be displayed
+    mSwapChain->SetMaximumFrameLatency(1);
+    mFrameLatencyWaitable = mSwapChain->GetFrameLatencyWaitableObject();
 
 
     // Get the back buffer texture from the swap chain we just created - primarily needed for the next step
@@ -102,12 +176,25 @@ DXDevice::DXDevice(HWND window)
     if (FAILED(hr))  throw std::runtime_error("Error creating depth buffer shader resource view");
 
 
+    // The scene is rendered to the back buffer until a frame's render graph sets a scene texture (see SceneTarget)
+    mSceneTarget = mBackBufferRenderTarget;
+
+
     // Create DirectX resource managers - can only do this after DirectX has been successfully initialised.
     // These functions will throw std::runtime_error if they fail
     mStateManager   = std::make_unique<StateManager>  (mD3DDevice, mD3DContext);
     mShaderManager  = std::make_unique<ShaderManager> (mD3DDevice, mD3DContext);
+    if (gAssetFiles.Exists(SHADER_PACK_FILE))  mShaderManager->LoadShaderPack(SHADER_PACK_FILE); // Loose .cso files if it fails
     mTextureManager = std::make_unique<TextureManager>(mD3DDevice, mD3DContext);
     mCBufferManager = std::make_unique<CBufferManager>(mD3DDevice, mD3DContext);
+    mGeometryManager = std::make_unique<GeometryManager>(mD3DDevice, mD3DContext, mShaderManager.get());
+    mMeshManager = std::make_unique<MeshManager>();
+    mBonePalette = std::make_unique<BonePalette>(mD3DDevice, mD3DContext);
+
+    mGpuProfiler = std::make_unique<GpuProfiler>(mD3DDevice, mD3DContext);
+    mGpuProfiler->BeginFrame();
+
+    mFrameCapture = std::make_unique<FrameCapture>(mD3DDevice, mD3DContext);
 }
 
 
@@ -115,6 +202,12 @@ DXDevice::DXDevice(HWND window)
 DXDevice::~DXDevice()
 {
     if (mD3DContext)  mD3DContext->ClearState();
+    if (mFrameLatencyWaitable)  CloseHandle(mFrameLatencyWaitable);
+    if (mBudgetEvent)
+    {
+        mAdapter->UnregisterVideoMemoryBudgetChangeNotification(mBudgetCookie);
+        CloseHandle(mBudgetEvent);
+    }
 }
 
 
@@ -123,9 +216,80 @@ DXDevice::~DXDevice()
 -----------------------------------------------------------------------------------------*/
 
 // Tell DirectX that rendering to the back buffer is finished and it can be presented to the screen
-// Pass true to lock FPS to monitor refresh rate
+// Pass true to lock FPS to monitor refresh rate. Also ends the GPU profiler's frame and begins the next
+// Without vsync, presents tear if supported. DXGI_PRESENT_DO_NOT_WAIT is not used, it silently drops the frame if the GPU is busy
 void DXDevice::PresentFrame(bool vsync)
 {
+    TRACE_PHASE("Present");
+    mGpuProfiler->EndFrame();
+    if (mFrameCapture->IsCapturing())  mFrameCapture->CaptureFrame(mBackBufferTexture);
     DXGI_PRESENT_PARAMETERS presentParams = {};
-    mSwapChain->Present1(vsync ? 1 : 0, vsync ? 0 : DXGI_PRESENT_DO_NOT_WAIT, &presentParams);
+    HRESULT result = mSwapChain->Present1(vsync ? 1 : 0, (!vsync && mTearingSupported) ? DXGI_PRESENT_ALLOW_TEARING : 0, &presentParams);
+    mOccluded = (result == DXGI_STATUS_OCCLUDED);
+    mGpuProfiler->BeginFrame();
+
+    // Textures that have finished streaming are swapped in between frames
+    mTextureManager->UpdateStreaming();
+}
+
+
+// Whether the window can't be seen, from the last present. Once it can't, a test present (which shows nothing) finds when it
+// can be seen again
+bool DXDevice::IsOccluded()
+{
+    if (mOccluded)  mOccluded = (mSwapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED);
+    return mOccluded;
+}
+
+
+// Wait until the swap chain is ready for another frame. The wait is alertable and times out after a second, so a lost device or
+// hidden window can't hang the app
+void DXDevice::WaitForSwapChain()
+{
+    if (mFrameLatencyWaitable)  WaitForSingleObjectEx(mFrameLatencyWaitable, 1000, TRUE);
+}
+
+
+// Bytes of local video memory used by this process, 0 if the adapter can't tell
+uint64_t DXDevice::VideoMemoryUsage()
+{
+    DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+    if (mAdapter == nullptr || FAILED(mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))  return 0;
+    return info.CurrentUsage;
+}
+
+
+// Query the video memory use and budget. Returns true if the OS has signalled a change of budget since the last call
+bool DXDevice::UpdateVideoMemory()
+{
+    bool changed = mBudgetEvent != nullptr && WaitForSingleObject(mBudgetEvent, 0) == WAIT_OBJECT_0; // Auto-reset event
+    if (changed)  ++mVideoMemory.budgetChanges;
+
+    DXGI_QUERY_VIDEO_MEMORY_INFO info = {};
+    if (mAdapter != nullptr && SUCCEEDED(mAdapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &info)))
+    {
+        mVideoMemory.budget = info.Budget;
+        mVideoMemory.usage  = info.CurrentUsage;
+    }
+    return changed;
+}
+
+
+// Pass true while other threads load resources that use the immediate context, DirectX then locks around every context call.
+// Returns false if the context can't be made thread-safe, without ID3D11Multithread (before Windows 10)
+bool DXDevice::SetContextThreadSafe(bool threadSafe)
+{
+    if (mMultithread == nullptr)  return false;
+    mThreadSafeCount = std::max(mThreadSafeCount + (threadSafe ? 1 : -1), 0);
+    mMultithread->SetMultithreadProtected(mThreadSafeCount > 0 ? TRUE : FALSE);
+    return true;
+}
+
+
+// Set the render scale, clamped between MIN_RENDER_SCALE and 1. The scene size is rounded to whole pixels
+void DXDevice::SetRenderScale(float scale)
+{
+    mRenderScale = std::min(std::max(scale, MIN_RENDER_SCALE), 1.0f);
+    mSceneWidth  = std::max(static_cast<int>(mBackbufferWidth  * mRenderScale + 0.5f), 1);
+    mSceneHeight = std::max(static_cast<int>(mBackbufferHeight * mRenderScale + 0.5f), 1);
 }
@@ -9,11 +9,12 @@
 //#include "Common.h"
 
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
-#include <d3d11.h>
-#include <dxgi1_4.h>
+#include <d3d11_4.h>
+#include <dxgi1_5.h>
 #include <atlbase.h> // For CComPtr (see member variables)
 
 #include <memory>
+#include <string>
 
 
 // Forward declarations of Manager classes allows us to use Manager class pointers before those classes have been fully declared
@@ -25,6 +26,27 @@ class StateManager;
 class ShaderManager;
 class TextureManager;
 class CBufferManager;
+class GeometryManager;
+class MeshManager;
+class GpuProfiler;
+class BonePalette;
+class FrameCapture;
+
+
+//--------------------------------------------------------------------------------------
+// Render backends
+//--------------------------------------------------------------------------------------
+// The graphics API the device and its managers (StateManager, ShaderManager etc.) are built on, chosen at startup with
+// "-renderer d3d11|d3d12" (see Main.cpp). Only Direct3D 11 has managers at present, so it is also the fallback: asking for
+// another backend gives a Direct3D 11 device, and BackendNote says why
+enum class RenderBackend
+{
+	D3D11,
+	D3D12,
+};
+
+// Name of a backend for display, e.g. "Direct3D 11"
+const char* RenderBackendName(RenderBackend backend);
 
 
 //--------------------------------------------------------------------------------------
@@ -37,8 +59,9 @@ class DXDevice
 	-----------------------------------------------------------------------------------------*/
 public:
 	// Creates DirectX, a swap chain (front/back buffer) attached to given window, a depth buffer of matching size and 
-	// manager classes for DirectX resources such as shaders or textures
-	DXDevice(HWND window);
+	// manager classes for DirectX resources such as shaders or textures. The backend asked for is used if it is available,
+	// otherwise Direct3D 11 (see RenderBackend)
+	DXDevice(HWND window, RenderBackend backend = RenderBackend::D3D11);
 
 	// DirectX cleanup
 	~DXDevice();
@@ -51,16 +74,47 @@ public:
 	ID3D11Device*        Device()  { return mD3DDevice;  }
 	ID3D11DeviceContext* Context() { return mD3DContext; }
 
+	// The backend the device was created with, and why it isn't the one asked for (empty if it is)
+	RenderBackend      Backend()      { return mBackend; }
+	const std::string& BackendNote()  { return mBackendNote; }
+
 	ID3D11RenderTargetView*& BackBuffer()  { return mBackBufferRenderTarget.p; }
 	ID3D11DepthStencilView*& DepthBuffer() { return mDepthStencil.p;           }
 
+	// The depth buffer as a texture, for shaders reading the scene's depths. It can't be read while bound as the depth buffer
+	ID3D11ShaderResourceView* DepthShaderView()  { return mDepthShaderView; }
+
 	unsigned int GetBackbufferWidth()   { return mBackbufferWidth;  }
 	unsigned int GetBackbufferHeight()  { return mBackbufferHeight; }
 
+	// The 3D scene is rendered at the render scale times the back buffer size. At full scale it is rendered directly to the back
+	// buffer. At a reduced scale it is rendered to the top-left of a scene texture of SCENE_FORMAT, the size of the back buffer so
+	// the scale can change every frame without new targets, then upscaled to the back buffer (see DynamicResolution.h). The scene
+	// texture is transient, from the frame's render graph (see RenderGraph.h), and set here by the pass rendering to it so the
+	// rendering code can find it. The depth buffer is used the same way. UI is always drawn to the back buffer at full resolution
+	ID3D11RenderTargetView*& SceneTarget()  { return mSceneTarget; }
+	static constexpr DXGI_FORMAT SCENE_FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+	// Set the render target SceneTarget returns, null for the back buffer. Set back to null once the frame is rendered
+	void SetSceneTarget(ID3D11RenderTargetView* sceneTarget)  { mSceneTarget = (sceneTarget != nullptr) ? sceneTarget : mBackBufferRenderTarget.p; }
+
+	unsigned int GetSceneWidth()   { return mSceneWidth;  }
+	unsigned int GetSceneHeight()  { return mSceneHeight; }
+
+	// Set the render scale, clamped between MIN_RENDER_SCALE and 1. The scene size is rounded to whole pixels
+	float RenderScale()  { return mRenderScale; }
+	void  SetRenderScale(float scale);
+	static constexpr float MIN_RENDER_SCALE = 0.5f;
+
 	auto States()   { return mStateManager  .get(); }
 	auto Shaders()  { return mShaderManager .get(); }
 	auto Textures() { return mTextureManager.get(); }
 	auto CBuffers() { return mCBufferManager.get(); }
+	auto Geometry() { return mGeometryManager.get(); }
+	auto Meshes()   { return mMeshManager.get(); }
+	auto Profiler() { return mGpuProfiler.get(); }
+	auto Bones()    { return mBonePalette.get(); }
+	auto Capture()  { return mFrameCapture.get(); }
 
 
 	/*-----------------------------------------------------------------------------------------
@@ -68,38 +122,111 @@ public:
 	-----------------------------------------------------------------------------------------*/
 
 	// Tell DirectX that rendering to the back buffer is finished and it can be presented to the screen
-	// Pass true to lock FPS to monitor refresh rate
+	// Pass true to lock FPS to monitor refresh rate. Without vsync the frame is shown immediately, tearing if supported
+	// Captures the frame first if a video is being recorded (see FrameCapture.h)
+	// Then swaps in any streamed textures that have loaded (see TextureManager::UpdateStreaming)
 	void PresentFrame(bool vsync);
 
+	// Whether the window can't be seen at all (e.g. covered by other windows or on a locked screen), as reported by the last
+	// present. While it is, frames needn't be drawn. Once reported, each call tests the swap chain without presenting to see if
+	// the window can be seen again
+	bool IsOccluded();
+
+	// Wait until the swap chain is ready for another frame, i.e. the previous frame has been presented. Call before sampling input
+	// and updating the scene for the frame. The swap chain holds at most one frame waiting for display, so a frame shown on screen
+	// was started from input no more than a frame or so old. Without this call the CPU can run a frame or two ahead of the screen
+	void WaitForSwapChain();
+
+	// Whether presenting without vsync can tear, rather than waiting for the next vertical blank (requires display support)
+	bool IsTearingSupported()  { return mTearingSupported; }
+
+	// Bytes of the GPU's local (dedicated) video memory used by this process, 0 if the adapter can't tell (before Windows 10)
+	uint64_t VideoMemoryUsage();
+
+	// The process's use of the GPU's local video memory and the budget the OS gives it, which can change at any time (e.g.
+	// another app starts using the GPU). Going over the budget gets resources paged out to system memory and eventually the
+	// device removed, so better to use less, see MemoryBudget.h. Both 0 if the adapter can't tell (before Windows 10)
+	struct VideoMemoryInfo
+	{
+		uint64_t budget = 0;
+		uint64_t usage  = 0;
+		uint32_t budgetChanges = 0; // Budget change notifications from the OS since the device was created
+	};
+
+	// Query the video memory use and budget, call once a frame. Returns true if the OS has signalled a change of budget since
+	// the last call. The last values queried are kept in GetVideoMemory
+	bool UpdateVideoMemory();
+	const VideoMemoryInfo& GetVideoMemory()  { return mVideoMemory; }
+
+	// The device can create resources on any thread, but the immediate context is only safe to use from one thread at a time. Pass
+	// true while other threads load resources that use the context (e.g. textures generating mip-maps, geometry being copied to
+	// its buffers), then DirectX locks around every context call. Returns false if the context can't be made thread-safe, which
+	// needs ID3D11Multithread (Windows 10). Left off while rendering, since rendering is on one thread and the locks have a cost.
+	// Calls nest, the context stays thread-safe until every true has been matched by a false. Call on the main thread only
+	bool SetContextThreadSafe(bool threadSafe);
+
 
 	/*-----------------------------------------------------------------------------------------
 	   Private Data
 	-----------------------------------------------------------------------------------------*/
 private:
-	// Current viewport dimensions (not supporting "render scale" so this will be the size of the window and the back-buffer)
+	// Current viewport dimensions, the size of the window and the back-buffer
 	int mBackbufferWidth;
 	int mBackbufferHeight;
 
+	// Size the 3D scene is rendered at, see SceneTarget
+	float mRenderScale = 1.0f;
+	int   mSceneWidth;
+	int   mSceneHeight;
+
+	RenderBackend mBackend = RenderBackend::D3D11;
+	std::string   mBackendNote;
+
 	// The main Direct3D (D3D) variables
 	CComPtr<ID3D11Device>        mD3DDevice;  // D3D device for general GPU control
 	CComPtr<ID3D11DeviceContext> mD3DContext; // D3D context for specific rendering tasks
+	CComPtr<ID3D11Multithread>   mMultithread; // Controls locking of the context, see SetContextThreadSafe. Null if not supported
+	CComPtr<IDXGIAdapter3>       mAdapter;     // For video memory usage, null if not supported
+	HANDLE                       mBudgetEvent  = nullptr; // Signalled by the OS when the video memory budget changes
+	DWORD                        mBudgetCookie = 0;
+	VideoMemoryInfo              mVideoMemory;
+	int                          mThreadSafeCount = 0; // Calls to SetContextThreadSafe(true) not yet matched by a false
 
 	// Back buffer (where we render to) and swap chain (handles how the back buffer is presented to the screen)
 	CComPtr<ID3D11Texture2D>        mBackBufferTexture;
 	CComPtr<ID3D11RenderTargetView> mBackBufferRenderTarget;
-	CComPtr<IDXGISwapChain1>        mSwapChain;
+	CComPtr<IDXGISwapChain2>        mSwapChain;
+	HANDLE mFrameLatencyWaitable = nullptr; // Signalled when the swap chain can take another frame, see WaitForSwapChain
+	bool   mTearingSupported = false;
+	bool   mOccluded = false; // See IsOccluded
 
 	// Depth buffer
 	CComPtr<ID3D11Texture2D>          mDepthStencilTexture; // The texture holding the depth values
 	CComPtr<ID3D11DepthStencilView>   mDepthStencil;        // The depth buffer itself, that uses the above texture
 	CComPtr<ID3D11ShaderResourceView> mDepthShaderView;     // Allows access to the depth buffer as a texture in certain specialised shaders
 
+	// Scene target, the back buffer or the render graph's scene texture when the render scale is reduced (see SceneTarget)
+	ID3D11RenderTargetView* mSceneTarget = nullptr;
+
 	// Manager classes for DirectX resources. Each manager class creates DirectX resources of the given type
 	// and maintains pointers to them. When the manager is destroyed its DirectX resources are released
 	std::unique_ptr<StateManager>   mStateManager;
 	std::unique_ptr<ShaderManager>  mShaderManager;
 	std::unique_ptr<TextureManager> mTextureManager;
 	std::unique_ptr<CBufferManager> mCBufferManager;
+	std::unique_ptr<GeometryManager> mGeometryManager;
+
+	// Shares meshes between the entity templates that use them. It doesn't own the meshes, they are reference counted
+	std::unique_ptr<MeshManager> mMeshManager;
+
+	// Times scopes of GPU work in each frame, each frame is ended and the next begun in PresentFrame
+	std::unique_ptr<GpuProfiler> mGpuProfiler;
+
+	// The bone matrices of the skinned meshes drawn each frame, see BonePalette.h
+	std::unique_ptr<BonePalette> mBonePalette;
+
+	// Records the back buffer to a video when started, see FrameCapture.h. Last so it is finished first
+	std::unique_ptr<FrameCapture> mFrameCapture;
 };
 
 
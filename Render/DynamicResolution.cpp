@@ -0,0 +1,100 @@
+//--------------------------------------------------------------------------------------
+// Dynamic resolution, rendering the scene at a reduced size when the GPU is over its frame time budget
+//--------------------------------------------------------------------------------------
+
+#include "DynamicResolution.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the upscaling shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+DynamicResolution::DynamicResolution()
+{
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_fullscreen_uv");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_upscale");
+	if (mVertexShader == nullptr || mPixelShader == nullptr)  throw std::runtime_error("Dynamic resolution: " + DX->Shaders()->GetLastError());
+
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterBilinear, TextureAddressingMode::AddressingClamp });
+	if (mSampler == nullptr)  throw std::runtime_error("Dynamic resolution: " + DX->Textures()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(UpscaleConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Dynamic resolution: failure creating constant buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Adjust the render scale from the GPU time of a recent frame in milliseconds
+void DynamicResolution::Update(float gpuMilliseconds)
+{
+	if (!mEnabled)
+	{
+		DX->SetRenderScale(1.0f);
+		return;
+	}
+	if (gpuMilliseconds <= 0 || mBudget <= 0)  return; // No times yet
+
+	float ratio = mBudget / gpuMilliseconds;
+	if (std::abs(ratio - 1.0f) < TOLERANCE)  return;
+
+	float scale = DX->RenderScale();
+	float idealScale = scale * std::sqrt(ratio);
+	DX->SetRenderScale(scale + (idealScale - scale) * ADJUST_RATE);
+}
+
+
+// Stretch the scene texture over the back buffer if the scene was rendered to one at a reduced scale
+void DynamicResolution::Upscale(ID3D11ShaderResourceView* sceneTexture)
+{
+	auto context = DX->Context();
+	context->OMSetRenderTargets(1, &DX->BackBuffer(), nullptr);
+
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width    = static_cast<FLOAT>(DX->GetBackbufferWidth());
+	viewport.Height   = static_cast<FLOAT>(DX->GetBackbufferHeight());
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+
+	if (sceneTexture == nullptr)  return; // The scene is already in the back buffer
+
+	float sceneWidth  = static_cast<float>(DX->GetSceneWidth());
+	float sceneHeight = static_cast<float>(DX->GetSceneHeight());
+	mConstants.uvScale = { sceneWidth / viewport.Width, sceneHeight / viewport.Height };
+	mConstants.uvMax   = { (sceneWidth - 0.5f) / viewport.Width, (sceneHeight - 0.5f) / viewport.Height };
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOff);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+
+	// A single triangle covering the screen, generated in the vertex shader from the vertex IDs
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->PSSetShader(mPixelShader, nullptr, 0);
+	context->PSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->PSSetShaderResources(0, 1, &sceneTexture);
+	context->PSSetSamplers(0, 1, &mSampler);
+	context->Draw(3, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	// Unbind the scene texture so it can be a render target again, in the pool of the render graph
+	ID3D11ShaderResourceView* nullView = nullptr;
+	context->PSSetShaderResources(0, 1, &nullView);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
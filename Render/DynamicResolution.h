@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Dynamic resolution, rendering the scene at a reduced size when the GPU is over its frame time budget
+//--------------------------------------------------------------------------------------
+// Each frame the GPU time of a recent frame (from the GPU profiler, a few frames late) is compared with the budget. As the cost
+// of the scene is mostly per-pixel, the render scale is moved towards the square root of the budget over the time, i.e. the
+// scale at which the frame would fit the budget. It moves only part of the way each frame, since the times lag behind and a
+// jumpy scale would be more noticeable than the odd long frame. The scale is kept between DXDevice::MIN_RENDER_SCALE and 1
+//
+// The reduced scene is rendered to a scene texture from the frame's render graph (see DXDevice::SceneTarget). After the 3D scene
+// is rendered, Upscale stretches it over the back buffer before the UI is drawn, so text and ImGui stay sharp and positions on
+// the screen (e.g. the mouse, labels) are in back buffer pixels whatever the scale.
+//
+//   dynamicResolution.Update(DX->Profiler()->FrameTime().milliseconds);  // Before rendering
+//   ... render the scene to DX->SceneTarget() with a viewport of DX->GetSceneWidth() x DX->GetSceneHeight() ...
+//   dynamicResolution.Upscale(sceneTexture);  // Render target is the back buffer, with a full size viewport
+//   ... render the UI ...
+
+#ifndef _DYNAMIC_RESOLUTION_H_INCLUDED_
+#define _DYNAMIC_RESOLUTION_H_INCLUDED_
+
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+
+
+class DynamicResolution
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the upscaling shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+	DynamicResolution();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Adjust the render scale from the GPU time of a recent frame in milliseconds. When disabled the scale is returned to 1
+	void Update(float gpuMilliseconds);
+
+	// Stretch the scene texture over the back buffer if the scene was rendered to one at a reduced scale, pass null if it was
+	// rendered to the back buffer. Leaves the back buffer as the render target, with no depth buffer, and a viewport covering it
+	void Upscale(ID3D11ShaderResourceView* sceneTexture);
+
+	// Enable or disable dynamic resolution
+	bool& Enabled()  { return mEnabled; }
+
+	// GPU time per frame to aim for, in milliseconds
+	float& Budget()  { return mBudget; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Fraction of the way to move to the ideal scale each frame
+	static constexpr float ADJUST_RATE = 0.1f;
+
+	// Times this close to the budget (as a fraction) leave the scale alone, so it settles rather than always changing a little
+	static constexpr float TOLERANCE = 0.05f;
+
+	bool  mEnabled = false;
+	float mBudget  = 8.0f;
+
+	ID3D11VertexShader* mVertexShader   = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mPixelShader    = nullptr;
+	ID3D11SamplerState* mSampler        = nullptr; // Owned by the texture manager
+	ID3D11Buffer*       mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	UpscaleConstants    mConstants;
+};
+
+
+#endif //_DYNAMIC_RESOLUTION_H_INCLUDED_
@@ -0,0 +1,320 @@
+//--------------------------------------------------------------------------------------
+// Environment lighting - the environment cube map prefiltered for image-based lighting in the PBR shaders
+//--------------------------------------------------------------------------------------
+
+#include "EnvironmentLighting.h"
+
+#include "RenderGlobals.h"
+#include "Shader.h"
+#include "CBuffer.h"
+#include "Texture.h"
+#include "AssetFiles.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <system_error>
+
+
+// Size, mip-maps, faces and format of the specular, irradiance and BRDF lookup maps
+const EnvironmentLighting::MapLayout EnvironmentLighting::MAP_LAYOUTS[NUM_MAPS] =
+{
+	{ SPECULAR_SIZE,   SPECULAR_MIPS, 6, DXGI_FORMAT_R16G16B16A16_FLOAT, 8 },
+	{ IRRADIANCE_SIZE, 1,             6, DXGI_FORMAT_R16G16B16A16_FLOAT, 8 },
+	{ BRDF_LUT_SIZE,   1,             1, DXGI_FORMAT_R16G16_FLOAT,       4 },
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Prepare the image-based lighting for the given cube map file, from its cache or by prefiltering it. Throws std::runtime_error
+// on failure
+EnvironmentLighting::EnvironmentLighting(const std::filesystem::path& environmentFile)
+{
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterBilinear, TextureAddressingMode::AddressingClamp });
+	if (mSampler == nullptr)  throw std::runtime_error("Environment lighting: " + DX->Textures()->GetLastError());
+
+	auto cacheFile = environmentFile;
+	cacheFile += ".iblcache";
+	uint64_t sourceHash = 0;
+	bool canCache = HashFile(environmentFile, sourceHash);
+	if (canCache && ReadCache(cacheFile, sourceHash))
+	{
+		mFromCache = true;
+		return;
+	}
+
+	Prefilter(environmentFile);
+	if (canCache)  WriteCache(cacheFile, sourceHash);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// The maps for RenderState::SetEnvironmentMap
+EnvironmentMaps EnvironmentLighting::Maps()
+{
+	EnvironmentMaps maps;
+	maps.specular   = mViews[Specular];
+	maps.irradiance = mViews[Irradiance];
+	maps.brdfLUT    = mViews[BRDFLookup];
+	maps.sampler    = mSampler;
+	return maps;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Bytes of all the subresources of a map
+uint64_t EnvironmentLighting::MapBytes(const MapLayout& layout)
+{
+	uint64_t bytes = 0;
+	for (uint32_t mip = 0; mip < layout.mips; ++mip)
+	{
+		uint64_t mipSize = std::max(layout.size >> mip, 1u);
+		bytes += mipSize * mipSize * layout.texelBytes;
+	}
+	return bytes * layout.faces;
+}
+
+
+// Create a map's texture and view, immutable from the given subresources if there are any, otherwise for the compute shaders to
+// write. Returns false on failure
+bool EnvironmentLighting::CreateMap(Map map, const D3D11_SUBRESOURCE_DATA* initialData)
+{
+	const MapLayout& layout = MAP_LAYOUTS[map];
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = layout.size;
+	textureDesc.Height           = layout.size;
+	textureDesc.MipLevels        = layout.mips;
+	textureDesc.ArraySize        = layout.faces;
+	textureDesc.Format           = layout.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = (initialData != nullptr) ? D3D11_USAGE_IMMUTABLE : D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE | ((initialData != nullptr) ? 0 : D3D11_BIND_UNORDERED_ACCESS);
+	textureDesc.MiscFlags        = (layout.faces == 6) ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, initialData, &mTextures[map])))  return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = layout.format;
+	if (layout.faces == 6)
+	{
+		srvDesc.ViewDimension         = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MipLevels = layout.mips;
+	}
+	else
+	{
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = layout.mips;
+	}
+	if (FAILED(DX->Device()->CreateShaderResourceView(mTextures[map], &srvDesc, &mViews[map])))
+	{
+		mTextures[map] = nullptr;
+		return false;
+	}
+	return true;
+}
+
+
+// Read the maps from the cache file, if it was made from an environment map with the given hash. Returns false if not
+bool EnvironmentLighting::ReadCache(const std::filesystem::path& cacheFile, uint64_t sourceHash)
+{
+	if (!gAssetFiles.Exists(cacheFile))  return false;
+	AssetData data = gAssetFiles.Read(cacheFile);
+
+	uint64_t payloadSize = 0;
+	for (const MapLayout& layout : MAP_LAYOUTS)  payloadSize += MapBytes(layout);
+
+	CacheHeader expected;
+	expected.sourceHash  = sourceHash;
+	expected.payloadSize = payloadSize;
+	if (data.size() != sizeof(CacheHeader) + payloadSize || std::memcmp(data.data(), &expected, sizeof(CacheHeader)) != 0)  return false;
+
+	const uint8_t* texels = data.data() + sizeof(CacheHeader);
+	for (int map = 0; map < NUM_MAPS; ++map)
+	{
+		const MapLayout& layout = MAP_LAYOUTS[map];
+		std::vector<D3D11_SUBRESOURCE_DATA> subresources;
+		for (uint32_t face = 0; face < layout.faces; ++face)
+		{
+			for (uint32_t mip = 0; mip < layout.mips; ++mip)
+			{
+				uint32_t mipSize = std::max(layout.size >> mip, 1u);
+				subresources.push_back({ texels, mipSize * layout.texelBytes, 0 });
+				texels += static_cast<size_t>(mipSize) * mipSize * layout.texelBytes;
+			}
+		}
+		if (!CreateMap(static_cast<Map>(map), subresources.data()))
+		{
+			for (int i = 0; i < NUM_MAPS; ++i)  { mViews[i] = nullptr;  mTextures[i] = nullptr; }
+			return false;
+		}
+	}
+	return true;
+}
+
+
+// Load the environment map file and make the maps from it with the compute shaders. Throws std::runtime_error on failure
+void EnvironmentLighting::Prefilter(const std::filesystem::path& environmentFile)
+{
+	ID3D11ComputeShader* prefilterShader  = DX->Shaders()->LoadComputeShader("cs_ibl-prefilter");
+	ID3D11ComputeShader* irradianceShader = DX->Shaders()->LoadComputeShader("cs_ibl-irradiance");
+	ID3D11ComputeShader* brdfShader       = DX->Shaders()->LoadComputeShader("cs_ibl-brdf");
+	if (prefilterShader == nullptr || irradianceShader == nullptr || brdfShader == nullptr)
+		throw std::runtime_error("Environment lighting: " + DX->Shaders()->GetLastError());
+
+	ID3D11Buffer* constantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(IBLConstants));
+	if (constantBuffer == nullptr)  throw std::runtime_error("Environment lighting: failure creating constant buffer");
+
+	ID3D11ShaderResourceView* source;
+	std::tie(std::ignore, source) = DX->Textures()->LoadTexture(environmentFile.string(), true);
+	if (source == nullptr)  throw std::runtime_error("Environment lighting: " + DX->Textures()->GetLastError());
+
+	// The size of the source's faces sets the mip-map each sample reads from
+	CComPtr<ID3D11Resource> sourceResource;
+	source->GetResource(&sourceResource);
+	CComQIPtr<ID3D11Texture2D> sourceTexture(sourceResource);
+	if (!sourceTexture)  throw std::runtime_error("Environment lighting: environment map is not a cube map");
+	D3D11_TEXTURE2D_DESC sourceDesc;
+	sourceTexture->GetDesc(&sourceDesc);
+
+	for (int map = 0; map < NUM_MAPS; ++map)
+	{
+		if (!CreateMap(static_cast<Map>(map), nullptr))  throw std::runtime_error("Environment lighting: failure creating maps");
+	}
+
+	auto context = DX->Context();
+	context->CSSetShaderResources(0, 1, &source);
+	context->CSSetSamplers(0, 1, &mSampler);
+	context->CSSetConstantBuffers(0, 1, &constantBuffer);
+
+	// Run a shader over one mip-map of a map, a thread per texel on every face
+	IBLConstants constants;
+	constants.sourceSize = static_cast<float>(sourceDesc.Width);
+	auto dispatch = [&](ID3D11ComputeShader* shader, Map map, uint32_t mip, float roughness, uint32_t numSamples)
+	{
+		const MapLayout& layout = MAP_LAYOUTS[map];
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format = layout.format;
+		if (layout.faces == 6)
+		{
+			uavDesc.ViewDimension                  = D3D11_UAV_DIMENSION_TEXTURE2DARRAY;
+			uavDesc.Texture2DArray.MipSlice        = mip;
+			uavDesc.Texture2DArray.FirstArraySlice = 0;
+			uavDesc.Texture2DArray.ArraySize       = layout.faces;
+		}
+		else
+		{
+			uavDesc.ViewDimension      = D3D11_UAV_DIMENSION_TEXTURE2D;
+			uavDesc.Texture2D.MipSlice = mip;
+		}
+		CComPtr<ID3D11UnorderedAccessView> uav;
+		if (FAILED(DX->Device()->CreateUnorderedAccessView(mTextures[map], &uavDesc, &uav)))  return false;
+
+		constants.roughness  = roughness;
+		constants.outputSize = std::max(layout.size >> mip, 1u);
+		constants.numSamples = numSamples;
+		DX->CBuffers()->UpdateCBuffer(constantBuffer, constants);
+
+		UINT groups = (constants.outputSize + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE;
+		context->CSSetShader(shader, nullptr, 0);
+		context->CSSetUnorderedAccessViews(0, 1, &uav.p, nullptr);
+		context->Dispatch(groups, groups, layout.faces);
+		ID3D11UnorderedAccessView* nullUAV = nullptr;
+		context->CSSetUnorderedAccessViews(0, 1, &nullUAV, nullptr);
+		return true;
+	};
+
+	bool succeeded = true;
+	for (uint32_t mip = 0; mip < SPECULAR_MIPS; ++mip)
+	{
+		float roughness = static_cast<float>(mip) / (SPECULAR_MIPS - 1);
+		succeeded = succeeded && dispatch(prefilterShader, Specular, mip, roughness, SPECULAR_SAMPLES);
+	}
+	succeeded = succeeded && dispatch(irradianceShader, Irradiance, 0, 1.0f, IRRADIANCE_SAMPLES);
+	succeeded = succeeded && dispatch(brdfShader, BRDFLookup, 0, 0.0f, BRDF_SAMPLES);
+
+	ID3D11ShaderResourceView* nullView = nullptr;
+	context->CSSetShaderResources(0, 1, &nullView);
+	context->CSSetShader(nullptr, nullptr, 0);
+	if (!succeeded)  throw std::runtime_error("Environment lighting: failure creating map views");
+}
+
+
+// Read the maps back from the GPU and write them to the cache file, replacing any existing one. Waits for the GPU, it is only
+// done once for each new environment. Returns false on failure
+bool EnvironmentLighting::WriteCache(const std::filesystem::path& cacheFile, uint64_t sourceHash)
+{
+	CacheHeader header;
+	header.sourceHash = sourceHash;
+	for (const MapLayout& layout : MAP_LAYOUTS)  header.payloadSize += MapBytes(layout);
+
+	std::vector<uint8_t> bytes(sizeof(CacheHeader) + header.payloadSize);
+	std::memcpy(bytes.data(), &header, sizeof(header));
+	uint8_t* texels = bytes.data() + sizeof(CacheHeader);
+
+	auto context = DX->Context();
+	for (int map = 0; map < NUM_MAPS; ++map)
+	{
+		const MapLayout& layout = MAP_LAYOUTS[map];
+		D3D11_TEXTURE2D_DESC stagingDesc;
+		mTextures[map]->GetDesc(&stagingDesc);
+		stagingDesc.Usage          = D3D11_USAGE_STAGING;
+		stagingDesc.BindFlags      = 0;
+		stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		stagingDesc.MiscFlags      = 0;
+		CComPtr<ID3D11Texture2D> staging;
+		if (FAILED(DX->Device()->CreateTexture2D(&stagingDesc, nullptr, &staging)))  return false;
+
+		for (uint32_t face = 0; face < layout.faces; ++face)
+		{
+			for (uint32_t mip = 0; mip < layout.mips; ++mip)
+			{
+				UINT subresource = D3D11CalcSubresource(mip, face, layout.mips);
+				context->CopySubresourceRegion(staging, subresource, 0, 0, 0, mTextures[map], subresource, nullptr);
+
+				D3D11_MAPPED_SUBRESOURCE mapped;
+				if (FAILED(context->Map(staging, subresource, D3D11_MAP_READ, 0, &mapped)))  return false;
+				uint32_t mipSize  = std::max(layout.size >> mip, 1u);
+				size_t   rowBytes = static_cast<size_t>(mipSize) * layout.texelBytes;
+				for (uint32_t row = 0; row < mipSize; ++row)
+				{
+					std::memcpy(texels, static_cast<const uint8_t*>(mapped.pData) + row * mapped.RowPitch, rowBytes);
+					texels += rowBytes;
+				}
+				context->Unmap(staging, subresource);
+			}
+		}
+	}
+
+	// Write to a temporary file then rename it over the cache, as for mesh caches, so an interrupted write never leaves a partial
+	// cache
+	auto tempFile = cacheFile;
+	tempFile += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		if (!stream)  return false;
+		stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		if (!stream)  { stream.close();  std::remove(tempFile.string().c_str());  return false; }
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------------
+// Environment lighting - the environment cube map prefiltered for image-based lighting in the PBR shaders
+//--------------------------------------------------------------------------------------
+// The PBR shaders light each pixel with the environment as well as the lights. Done properly that is an integral over the whole
+// environment for each pixel, so it is split into three maps made once at load by compute shaders:
+//   specular    the environment convolved with the GGX distribution, a roughness for each mip-map from 0 (a mirror) at the
+//               top to 1 at the bottom. cs_ibl-prefilter, with the view direction assumed to be the normal (the "split sum"
+//               approximation), and each sample taken from the source mip-map matching its share of the sphere
+//   irradiance  a small cube map of the diffuse light arriving at a surface facing each direction, cs_ibl-irradiance
+//   BRDF LUT    the rest of the split sum: the specular BRDF integrated over the hemisphere as a scale and bias of the specular
+//               colour, by nDotV and roughness. cs_ibl-brdf, it is the same for every environment
+// so the shaders do one lookup for each term (see IBL.hlsli). The maps are saved in a cache file beside the environment map, read
+// back on later runs while the environment map has the same contents (its hash is kept in the cache), so the prefiltering and the
+// environment map itself are only loaded when the environment changes:
+//
+//   EnvironmentLighting environmentLighting("Media/sea-cube.dds");
+//   RenderState::SetEnvironmentMap(environmentLighting.Maps());
+//
+// Increase CACHE_VERSION whenever the maps' sizes, formats or filtering change, to replace all existing caches
+
+#ifndef _ENVIRONMENT_LIGHTING_H_INCLUDED_
+#define _ENVIRONMENT_LIGHTING_H_INCLUDED_
+
+#include "RenderMethod.h" // For EnvironmentMaps
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <filesystem>
+#include <vector>
+#include <stdint.h>
+
+
+class EnvironmentLighting
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Prepare the image-based lighting for the given cube map file: read from its cache if that is in date, otherwise load the
+	// cube map, prefilter it with the compute shaders and write the cache (a cache that can't be written is not an error).
+	// Throws std::runtime_error on failure, e.g. if the device doesn't support compute shaders and there is no cache
+	EnvironmentLighting(const std::filesystem::path& environmentFile);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Version of the cache file contents, see above
+	static constexpr uint32_t CACHE_VERSION = 1;
+
+	// Texels along each side of the specular map's top mip-map and its number of mip-maps (to 4x4), must match IBL.hlsli
+	static constexpr uint32_t SPECULAR_SIZE = 256;
+	static constexpr uint32_t SPECULAR_MIPS = 7;
+
+	// Texels along each side of the irradiance map and the BRDF lookup table
+	static constexpr uint32_t IRRADIANCE_SIZE = 32;
+	static constexpr uint32_t BRDF_LUT_SIZE   = 128;
+
+	// The maps for RenderState::SetEnvironmentMap
+	EnvironmentMaps Maps();
+
+	// Whether the maps were read from the cache rather than prefiltered
+	bool FromCache()  { return mFromCache; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	enum Map
+	{
+		Specular,
+		Irradiance,
+		BRDFLookup,
+		NUM_MAPS
+	};
+
+	// Size, mip-maps, faces (6 for a cube map) and format of each map, in the order above, which is also their order in the cache
+	struct MapLayout
+	{
+		uint32_t    size;
+		uint32_t    mips;
+		uint32_t    faces;
+		DXGI_FORMAT format;
+		uint32_t    texelBytes;
+	};
+	static const MapLayout MAP_LAYOUTS[NUM_MAPS];
+
+	// First part of the cache file, followed by every subresource of each map in D3D order (face by face, each with its mip-maps),
+	// rows packed with no padding
+	struct CacheHeader
+	{
+		char     magic[4]    = { 'I', 'B', 'L', 'C' };
+		uint32_t version     = CACHE_VERSION;
+		uint64_t sourceHash  = 0; // Of the contents of the environment map file
+		uint64_t payloadSize = 0; // Bytes after the header
+	};
+
+	// Bytes of all the subresources of a map
+	static uint64_t MapBytes(const MapLayout& layout);
+
+	// Create a map's texture and view, immutable from the given subresources if there are any, otherwise for the compute shaders
+	// to write. Returns false on failure
+	bool CreateMap(Map map, const D3D11_SUBRESOURCE_DATA* initialData);
+
+	// Read the maps from the cache file, if it was made from an environment map with the given hash. Returns false if not
+	bool ReadCache(const std::filesystem::path& cacheFile, uint64_t sourceHash);
+
+	// Load the environment map file and make the maps from it with the compute shaders. Throws std::runtime_error on failure
+	void Prefilter(const std::filesystem::path& environmentFile);
+
+	// Read the maps back from the GPU and write them to the cache file, replacing any existing one. Returns false on failure
+	bool WriteCache(const std::filesystem::path& cacheFile, uint64_t sourceHash);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Threads along each side of a group's square of texels, must match IBL_THREAD_GROUP_SIZE in the compute shaders
+	static constexpr unsigned int THREAD_GROUP_SIZE = 8;
+
+	// Samples taken for each texel of the maps
+	static constexpr uint32_t SPECULAR_SAMPLES   = 128;
+	static constexpr uint32_t IRRADIANCE_SAMPLES = 512;
+	static constexpr uint32_t BRDF_SAMPLES       = 1024;
+
+	CComPtr<ID3D11Texture2D>          mTextures[NUM_MAPS];
+	CComPtr<ID3D11ShaderResourceView> mViews[NUM_MAPS];
+	ID3D11SamplerState*               mSampler = nullptr; // Owned by the texture manager
+
+	bool mFromCache = false;
+};
+
+
+#endif //_ENVIRONMENT_LIGHTING_H_INCLUDED_
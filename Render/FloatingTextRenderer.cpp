@@ -0,0 +1,180 @@
+//--------------------------------------------------------------------------------------
+// Drawing floating text, popups that rise from a point in the world and fade, animated by the vertex shader
+//--------------------------------------------------------------------------------------
+
+#include "FloatingTextRenderer.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the floating text shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+FloatingTextRenderer::FloatingTextRenderer(const DirectX::DX11::SpriteFont& font)
+	: mFont(font)
+{
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_floating-text_uv");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_label-glyph");
+	if (mVertexShader == nullptr || mPixelShader == nullptr)  throw std::runtime_error("Floating text: " + DX->Shaders()->GetLastError());
+
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterBilinear, TextureAddressingMode::AddressingClamp });
+	if (mSampler == nullptr)  throw std::runtime_error("Floating text: " + DX->Textures()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(FloatingTextConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Floating text: failure creating constant buffer");
+
+	// Glyph rectangles are in texels, the shader needs the size of the sprite sheet to turn them into texture coordinates
+	mFont.GetSpriteSheet(&mSpriteSheet);
+	CComPtr<ID3D11Resource> resource;
+	mSpriteSheet->GetResource(&resource);
+	CComQIPtr<ID3D11Texture2D> texture(resource);
+	if (texture == nullptr)  throw std::runtime_error("Floating text: font sprite sheet is not a 2D texture");
+	D3D11_TEXTURE2D_DESC textureDesc;
+	texture->GetDesc(&textureDesc);
+	mConstants.texelsToUV = { 1.0f / textureDesc.Width, 1.0f / textureDesc.Height };
+	mConstants.lineHeight = mFont.GetLineSpacing();
+	mConstants.maxGlyphs  = MAX_GLYPHS;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Set the text with the given ID, laying it out and adding its glyphs to those sent to the GPU
+void FloatingTextRenderer::SetText(uint32_t id, std::string_view text)
+{
+	LabelRenderer::LayOut(mFont, text, mLayout);
+	if (id >= mTexts.size())  mTexts.resize(id + 1, { 0, 0, 0 });
+
+	uint32_t numGlyphs = std::min(static_cast<uint32_t>(mLayout.glyphs.size()), MAX_GLYPHS);
+	mTexts[id] = { static_cast<uint32_t>(mGlyphs.size()), numGlyphs, mLayout.width };
+	for (uint32_t i = 0; i < numGlyphs; ++i)
+	{
+		const LabelRenderer::TextLayout::Glyph& glyph = mLayout.glyphs[i];
+		GlyphEntry& entry = mGlyphs.emplace_back();
+		std::memcpy(entry.texels, glyph.texels, sizeof(entry.texels));
+		entry.x = glyph.x;
+		entry.y = glyph.y;
+	}
+	mTextsChanged = true;
+}
+
+
+// Start gathering the popups for a frame
+void FloatingTextRenderer::Begin()
+{
+	mPopups.clear();
+}
+
+
+// Add a popup of the given text rising from a world point
+void FloatingTextRenderer::Add(const Vector3& point, uint32_t text, float startTime, uint32_t line, ColourRGB colour)
+{
+	if (text >= mTexts.size() || mTexts[text].numGlyphs == 0)  return;
+
+	auto channel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	uint32_t packedColour = channel(colour.r) | (channel(colour.g) << 8) | (channel(colour.b) << 16) | 0xff000000;
+	mPopups.push_back({ point, startTime, text, line, packedColour });
+}
+
+
+// Draw the popups added since Begin with one instanced draw
+void FloatingTextRenderer::Render(const Matrix4x4& viewProjection, float viewportWidth, float viewportHeight, const Motion& motion)
+{
+	mLastNumPopups = static_cast<uint32_t>(mPopups.size());
+	if (mPopups.empty())  return;
+
+	// The texts only go to the GPU again when one has been set since they last did
+	if (mTextsChanged)
+	{
+		if (!Upload(mTextBuffer,  mTexts.data(),  sizeof(TextEntry),  static_cast<unsigned int>(mTexts.size())) ||
+		    !Upload(mGlyphBuffer, mGlyphs.data(), sizeof(GlyphEntry), static_cast<unsigned int>(mGlyphs.size())))  return;
+		mTextsChanged = false;
+	}
+	if (!Upload(mPopupBuffer, mPopups.data(), sizeof(PopupInstance), static_cast<unsigned int>(mPopups.size())))  return;
+
+	mConstants.viewProjectionMatrix = viewProjection;
+	mConstants.pixelsToClip = { 2.0f / viewportWidth, -2.0f / viewportHeight };
+	mConstants.time         = motion.time;
+	mConstants.lifetime     = motion.lifetime;
+	mConstants.fadeTime     = motion.fadeTime;
+	mConstants.startHeight  = motion.startHeight;
+	mConstants.riseHeight   = motion.riseHeight;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOff);
+	DX->States()->SetBlendState(BlendState::BlendAdditive);
+
+	// Two triangles for each possible glyph of each popup, generated in the vertex shader from the vertex and instance IDs
+	auto context = DX->Context();
+	ID3D11ShaderResourceView* vertexViews[] = { mPopupBuffer.srv, mTextBuffer.srv, mGlyphBuffer.srv };
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->VSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->VSSetShaderResources(0, 3, vertexViews);
+	context->PSSetShader(mPixelShader, nullptr, 0);
+	context->PSSetShaderResources(0, 1, &mSpriteSheet.p);
+	context->PSSetSamplers(0, 1, &mSampler);
+	context->DrawInstanced(6 * MAX_GLYPHS, static_cast<UINT>(mPopups.size()), 0, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	ID3D11ShaderResourceView* nullViews[3] = {};
+	context->VSSetShaderResources(0, 3, nullViews);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure a dynamic structured buffer holds the given elements, then copy them in. Returns false on failure
+bool FloatingTextRenderer::Upload(StructuredBuffer& buffer, const void* elements, unsigned int elementSize, unsigned int numElements)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numElements > buffer.capacity)
+	{
+		unsigned int capacity = (buffer.capacity > 0) ? buffer.capacity : INITIAL_CAPACITY;
+		while (capacity < numElements)  capacity *= 2;
+		buffer = {};
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = capacity * elementSize;
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = elementSize;
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &buffer.buffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = capacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(buffer.buffer, &srvDesc, &buffer.srv)))  { buffer = {};  return false; }
+		buffer.capacity = capacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(buffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, elements, static_cast<size_t>(numElements) * elementSize);
+	DX->Context()->Unmap(buffer.buffer, 0);
+	return true;
+}
@@ -0,0 +1,159 @@
+//--------------------------------------------------------------------------------------
+// Drawing floating text, popups that rise from a point in the world and fade, animated by the vertex shader
+//--------------------------------------------------------------------------------------
+// Each text that can be shown is given once, with an ID. It is laid out (see LabelRenderer::TextLayout) and its glyphs kept
+// in a structured buffer on the GPU with the other texts. A popup is then just the world point it rises from, its text ID,
+// when it started, its line in a stack of popups and its colour, so the CPU cost of a popup doesn't depend on its text or age.
+//
+// All the popups are drawn with one instanced draw, an instance per popup with 6 vertices for each of up to MAX_GLYPHS
+// glyphs. The vertex shader (vs_floating-text_uv) finds the popup's text and glyph from the instance and vertex IDs, collapses
+// the quads beyond the end of the text, raises the point by the popup's age, projects it with the camera's matrix and places
+// the glyph around it in pixels, centred with the text hanging below as for labels. Colours fade out at the end of the
+// popup's life. Texts are drawn with the same pixel shader and additive blending as labels
+//
+//   floatingTextRenderer.SetText(id, text);  // Once for each text, before any popup uses it
+//   floatingTextRenderer.Begin();
+//   floatingTextRenderer.Add(point, id, startTime, line, colour);  // For each popup
+//   floatingTextRenderer.Render(viewProjection, viewportWidth, viewportHeight, motion);
+
+#ifndef _FLOATING_TEXT_RENDERER_H_INCLUDED_
+#define _FLOATING_TEXT_RENDERER_H_INCLUDED_
+
+#include "LabelRenderer.h"
+#include "Matrix4x4.h"
+#include "Vector3.h"
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+#include <SpriteFont.h> // DirectXTK helper library for text drawing
+
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+
+class FloatingTextRenderer
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the floating text shaders and create their sampler and constant buffer, for text in the given font, which must exist
+	// for as long as the renderer. Throws std::runtime_error on failure
+	FloatingTextRenderer(const DirectX::DX11::SpriteFont& font);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Glyphs after this many in a text are not shown
+	static constexpr uint32_t MAX_GLYPHS = 32;
+
+	// How popups move, all distances in world units except the line height. Popups start at their point raised by startHeight,
+	// rise by riseHeight over their lifetime and fade over its last fadeTime. Each line is a line of the font higher
+	struct Motion
+	{
+		float time;         // Now, on the same clock as the popups' start times
+		float lifetime;
+		float fadeTime;
+		float startHeight;
+		float riseHeight;
+	};
+
+	// Set the text with the given ID. A text must be set before any popup using it is added, and can be set again
+	void SetText(uint32_t id, std::string_view text);
+
+	// The number of text IDs set, one more than the highest
+	uint32_t NumTexts()  { return static_cast<uint32_t>(mTexts.size()); }
+
+	// Start gathering the popups for a frame
+	void Begin();
+
+	// Add a popup of the given text rising from a world point
+	void Add(const Vector3& point, uint32_t text, float startTime, uint32_t line, ColourRGB colour);
+
+	// Draw the popups added since Begin as seen through the given view-projection matrix, with a viewport of the given size in
+	// pixels. Leaves the render target and viewport as they were
+	void Render(const Matrix4x4& viewProjection, float viewportWidth, float viewportHeight, const Motion& motion);
+
+	// Number of popups drawn in the last frame rendered
+	uint32_t NumPopups()  { return mLastNumPopups; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Structures as the vertex shader reads them, must match those in vs_floating-text_uv
+	struct TextEntry
+	{
+		uint32_t firstGlyph;
+		uint32_t numGlyphs;
+		float    width;
+		float    padding = 0;
+	};
+	struct GlyphEntry
+	{
+		float texels[4]; // Sprite sheet rectangle: left, top, right, bottom in texels
+		float x, y;      // Relative to the top-left of the text, in pixels
+		float padding[2] = {};
+	};
+	struct PopupInstance
+	{
+		Vector3  point;
+		float    startTime;
+		uint32_t text;
+		uint32_t line;
+		uint32_t colour; // RGBA, 8 bits each from the lowest
+		uint32_t padding = 0;
+	};
+
+	// A dynamic structured buffer rewritten when its contents change, replaced by a larger one when needed
+	struct StructuredBuffer
+	{
+		CComPtr<ID3D11Buffer>             buffer;
+		CComPtr<ID3D11ShaderResourceView> srv;
+		unsigned int                      capacity = 0; // In elements
+	};
+
+	// Make sure the buffer holds the given elements, then copy them in. Returns false on failure
+	static bool Upload(StructuredBuffer& buffer, const void* elements, unsigned int elementSize, unsigned int numElements);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Buffers start with space for this many elements, then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 256;
+
+	const DirectX::DX11::SpriteFont& mFont;
+	CComPtr<ID3D11ShaderResourceView> mSpriteSheet;
+
+	ID3D11VertexShader*    mVertexShader   = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*     mPixelShader    = nullptr;
+	ID3D11SamplerState*    mSampler        = nullptr; // Owned by the texture manager
+	ID3D11Buffer*          mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	FloatingTextConstants  mConstants;
+
+	// Every text's glyphs, in the order they were set. Setting a text again adds its new glyphs at the end
+	std::vector<TextEntry>  mTexts;
+	std::vector<GlyphEntry> mGlyphs;
+	bool mTextsChanged = false;
+	LabelRenderer::TextLayout mLayout;
+
+	std::vector<PopupInstance> mPopups; // Popups this frame, cleared rather than recreated to keep the capacity
+
+	StructuredBuffer mTextBuffer;
+	StructuredBuffer mGlyphBuffer;
+	StructuredBuffer mPopupBuffer;
+
+	uint32_t mLastNumPopups = 0;
+};
+
+
+#endif //_FLOATING_TEXT_RENDERER_H_INCLUDED_
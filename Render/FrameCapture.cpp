@@ -0,0 +1,292 @@
+//--------------------------------------------------------------------------------------
+// Frame capture - records the back buffer to an H.264 video without stalling the frame
+//--------------------------------------------------------------------------------------
+
+#include "FrameCapture.h"
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mfreadwrite.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+FrameCapture::FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context)
+	: mDevice(device), mContext(context)
+{
+}
+
+
+// Finishes any video being captured
+FrameCapture::~FrameCapture()
+{
+	Stop();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start capturing frames of the given back buffer size to an MP4 file, at most frameRate a second. Returns false with an error
+// if the staging textures or the video file can't be created
+bool FrameCapture::Start(const std::string& fileName, int width, int height, int frameRate, std::string& error)
+{
+	Stop();
+
+	// H.264 needs the frame size to be even, an odd last row or column of the back buffer is left out
+	mWidth  = width  & ~1;
+	mHeight = height & ~1;
+	frameRate = std::max(frameRate, 1);
+	if (mWidth <= 0 || mHeight <= 0)
+	{
+		error = "Nothing to capture";
+		return false;
+	}
+
+	D3D11_TEXTURE2D_DESC stagingDesc = {};
+	stagingDesc.Width            = width;
+	stagingDesc.Height           = height;
+	stagingDesc.MipLevels        = 1;
+	stagingDesc.ArraySize        = 1;
+	stagingDesc.Format           = BACK_BUFFER_FORMAT;
+	stagingDesc.SampleDesc.Count = 1;
+	stagingDesc.Usage            = D3D11_USAGE_STAGING;
+	stagingDesc.CPUAccessFlags   = D3D11_CPU_ACCESS_READ;
+	for (Slot& slot : mSlots)
+	{
+		slot.staging.Release();
+		if (FAILED(mDevice->CreateTexture2D(&stagingDesc, nullptr, &slot.staging)))
+		{
+			error = "Error creating frame capture staging textures";
+			for (Slot& created : mSlots)  created.staging.Release();
+			return false;
+		}
+		slot.state = SlotState::Free;
+	}
+
+	// The sink writer picks the H.264 encoder, a hardware one if there is one, and the colour conversion from RGB to its input
+	HRESULT hr = MFStartup(MF_VERSION, MFSTARTUP_LITE);
+	mMFStarted = SUCCEEDED(hr);
+	CComPtr<IMFAttributes> attributes;
+	if (SUCCEEDED(hr))  hr = MFCreateAttributes(&attributes, 1);
+	if (SUCCEEDED(hr))  hr = attributes->SetUINT32(MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE);
+	if (SUCCEEDED(hr))  hr = MFCreateSinkWriterFromURL(std::filesystem::path(fileName).wstring().c_str(), nullptr, attributes, &mSinkWriter);
+
+	auto setVideoType = [&](IMFMediaType* type, const GUID& subType)
+	{
+		HRESULT result = type->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+		if (SUCCEEDED(result))  result = type->SetGUID(MF_MT_SUBTYPE, subType);
+		if (SUCCEEDED(result))  result = type->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+		if (SUCCEEDED(result))  result = MFSetAttributeSize(type, MF_MT_FRAME_SIZE, mWidth, mHeight);
+		if (SUCCEEDED(result))  result = MFSetAttributeRatio(type, MF_MT_FRAME_RATE, frameRate, 1);
+		if (SUCCEEDED(result))  result = MFSetAttributeRatio(type, MF_MT_PIXEL_ASPECT_RATIO, 1, 1);
+		return result;
+	};
+	CComPtr<IMFMediaType> outputType;
+	if (SUCCEEDED(hr))  hr = MFCreateMediaType(&outputType);
+	if (SUCCEEDED(hr))  hr = setVideoType(outputType, MFVideoFormat_H264);
+	if (SUCCEEDED(hr))  hr = outputType->SetUINT32(MF_MT_AVG_BITRATE, BIT_RATE);
+	if (SUCCEEDED(hr))  hr = mSinkWriter->AddStream(outputType, &mStream);
+
+	// Frames are given top row first, a positive stride. Media Foundation takes RGB32 as bytes B, G, R, X
+	CComPtr<IMFMediaType> inputType;
+	if (SUCCEEDED(hr))  hr = MFCreateMediaType(&inputType);
+	if (SUCCEEDED(hr))  hr = setVideoType(inputType, MFVideoFormat_RGB32);
+	if (SUCCEEDED(hr))  hr = inputType->SetUINT32(MF_MT_DEFAULT_STRIDE, mWidth * 4);
+	if (SUCCEEDED(hr))  hr = mSinkWriter->SetInputMediaType(mStream, inputType, nullptr);
+	if (SUCCEEDED(hr))  hr = mSinkWriter->BeginWriting();
+	if (FAILED(hr))
+	{
+		char code[16];
+		std::snprintf(code, sizeof(code), "0x%08X", static_cast<unsigned int>(hr));
+		error = "Can't create video " + fileName + " (error " + code + ")";
+		if (mSinkWriter)  mSinkWriter->Release();
+		mSinkWriter = nullptr;
+		if (mMFStarted)  MFShutdown();
+		mMFStarted = false;
+		for (Slot& slot : mSlots)  slot.staging.Release();
+		return false;
+	}
+
+	mFrameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+	mFrameDuration = 10'000'000 / frameRate;
+	mStartTime     = std::chrono::steady_clock::now();
+	mNextFrameTime = mStartTime;
+	mNextCopy      = 0;
+	mOldestCopy    = 0;
+	mCopiesWaiting = 0;
+	mFramesEncoded = 0;
+	mFramesDropped = 0;
+	mEncodeFailed  = false;
+	mStopping      = false;
+	mEncoderThread = std::thread(&FrameCapture::EncoderLoop, this);
+	return true;
+}
+
+
+// Capture the back buffer if it is time for another frame and collect the frames the GPU has finished copying. Never waits
+// for the GPU or the encoder
+void FrameCapture::CaptureFrame(ID3D11Texture2D* backBuffer)
+{
+	if (!IsCapturing())  return;
+
+	ReleaseEncoded();
+	CollectCopies(false);
+
+	auto now = std::chrono::steady_clock::now();
+	if (now < mNextFrameTime)  return;
+	mNextFrameTime = std::max(mNextFrameTime + mFrameInterval, now); // A slow frame doesn't leave a burst of frames to catch up
+
+	// Slots are used and freed in order, so if the next is busy they all are
+	Slot& slot = mSlots[mNextCopy];
+	if (slot.state.load(std::memory_order_acquire) != SlotState::Free)
+	{
+		++mFramesDropped;
+		return;
+	}
+	mContext->CopyResource(slot.staging, backBuffer);
+	slot.time = std::chrono::duration_cast<std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>>(now - mStartTime).count();
+	slot.state.store(SlotState::Copying, std::memory_order_relaxed);
+	mNextCopy = (mNextCopy + 1) % RING_SIZE;
+	++mCopiesWaiting;
+}
+
+
+// Encode the frames still waiting and finish the file. Waits for the GPU and the encoder. Returns false if the video couldn't
+// be written
+bool FrameCapture::Stop()
+{
+	if (!IsCapturing())  return true;
+
+	CollectCopies(true);
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mFrameReady.notify_one();
+	mEncoderThread.join();
+	ReleaseEncoded();
+
+	HRESULT hr = mSinkWriter->Finalize();
+	mSinkWriter->Release();
+	mSinkWriter = nullptr;
+	MFShutdown();
+	mMFStarted = false;
+	for (Slot& slot : mSlots)  slot.staging.Release();
+	return SUCCEEDED(hr) && !mEncodeFailed;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Map the copies the GPU has finished, oldest first, and pass them to the encoder. With wait, waits for the GPU
+void FrameCapture::CollectCopies(bool wait)
+{
+	while (mCopiesWaiting > 0)
+	{
+		Slot& slot = mSlots[mOldestCopy];
+		HRESULT hr = mContext->Map(slot.staging, 0, D3D11_MAP_READ, wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &slot.mapped);
+		if (hr == DXGI_ERROR_WAS_STILL_DRAWING)  return;
+
+		mOldestCopy = (mOldestCopy + 1) % RING_SIZE;
+		--mCopiesWaiting;
+		if (FAILED(hr))
+		{
+			slot.state.store(SlotState::Free, std::memory_order_relaxed);
+			++mFramesDropped;
+			continue;
+		}
+
+		slot.state.store(SlotState::Mapped, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mEncodeQueue.push_back(static_cast<int>(&slot - mSlots));
+		}
+		mFrameReady.notify_one();
+	}
+}
+
+
+// Unmap and free the staging textures the encoder has finished with. The context can only be used on this thread
+void FrameCapture::ReleaseEncoded()
+{
+	for (Slot& slot : mSlots)
+	{
+		if (slot.state.load(std::memory_order_acquire) != SlotState::Encoded)  continue;
+		mContext->Unmap(slot.staging, 0);
+		slot.state.store(SlotState::Free, std::memory_order_release);
+	}
+}
+
+
+// Encode the frames passed to it until stopped, then any still queued
+void FrameCapture::EncoderLoop()
+{
+	HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (true)
+	{
+		mFrameReady.wait(lock, [this] { return mStopping || !mEncodeQueue.empty(); });
+		if (mEncodeQueue.empty())  break;
+		int slotIndex = mEncodeQueue.front();
+		mEncodeQueue.pop_front();
+		lock.unlock();
+
+		Slot& slot = mSlots[slotIndex];
+		if (!mEncodeFailed && !EncodeFrame(slot))  mEncodeFailed = true;
+		slot.state.store(SlotState::Encoded, std::memory_order_release);
+
+		lock.lock();
+	}
+	lock.unlock();
+
+	if (SUCCEEDED(comResult))  CoUninitialize();
+}
+
+
+// Convert one mapped frame and give it to the sink writer. Returns false on failure
+bool FrameCapture::EncodeFrame(Slot& slot)
+{
+	const DWORD frameBytes = mWidth * mHeight * 4;
+	CComPtr<IMFMediaBuffer> buffer;
+	HRESULT hr = MFCreateMemoryBuffer(frameBytes, &buffer);
+	BYTE* pixels = nullptr;
+	if (SUCCEEDED(hr))  hr = buffer->Lock(&pixels, nullptr, nullptr);
+	if (FAILED(hr))  return false;
+
+	// The back buffer is R, G, B, A in memory and Media Foundation wants B, G, R, X, so red and blue are swapped
+	for (int y = 0; y < mHeight; ++y)
+	{
+		const uint32_t* source = reinterpret_cast<const uint32_t*>(static_cast<const BYTE*>(slot.mapped.pData) + y * slot.mapped.RowPitch);
+		uint32_t*       dest   = reinterpret_cast<uint32_t*>(pixels) + y * mWidth;
+		for (int x = 0; x < mWidth; ++x)
+		{
+			uint32_t pixel = source[x];
+			dest[x] = (pixel & 0xFF00FF00) | ((pixel & 0x000000FF) << 16) | ((pixel >> 16) & 0x000000FF);
+		}
+	}
+	buffer->Unlock();
+
+	CComPtr<IMFSample> sample;
+	hr = buffer->SetCurrentLength(frameBytes);
+	if (SUCCEEDED(hr))  hr = MFCreateSample(&sample);
+	if (SUCCEEDED(hr))  hr = sample->AddBuffer(buffer);
+	if (SUCCEEDED(hr))  hr = sample->SetSampleTime(slot.time);
+	if (SUCCEEDED(hr))  hr = sample->SetSampleDuration(mFrameDuration);
+	if (SUCCEEDED(hr))  hr = mSinkWriter->WriteSample(mStream, sample);
+	if (FAILED(hr))  return false;
+
+	mFramesEncoded.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
@@ -0,0 +1,152 @@
+//--------------------------------------------------------------------------------------
+// Frame capture - records the back buffer to an H.264 video without stalling the frame
+//--------------------------------------------------------------------------------------
+// For recording matches in the engine rather than with a screen capture tool. Just before each present the back buffer is
+// copied on the GPU into the next of a ring of staging textures, which costs the GPU a copy and the CPU nothing. A few frames
+// later, when the GPU has finished the copy, the staging texture is mapped without waiting (D3D11_MAP_FLAG_DO_NOT_WAIT) and the
+// mapped memory handed as it is to the encoder thread, which converts it and passes it to a Media Foundation sink writer
+// (hardware encoders are used when the system has them). The frame is unmapped on the next present after the encoder has
+// finished with it, so the pixels are never copied on the main thread. If the GPU or the encoder falls behind and every
+// staging texture is busy the frame is dropped from the video, PresentFrame never waits for either.
+//
+// Frames are captured at most frameRate times a second, each stamped with the time it was presented, so the video plays at
+// the speed the game ran whatever the frame rate. The video is the size of the back buffer rounded down to even numbers.
+//
+//   DX->Capture()->Start("Match.mp4", DX->GetBackbufferWidth(), DX->GetBackbufferHeight(), 60, error);
+//   ... DX->PresentFrame(vsync);  // Captures the frame if it is time for one
+//   DX->Capture()->Stop();        // Waits for the encoder to finish the file
+
+#ifndef _FRAME_CAPTURE_H_INCLUDED_
+#define _FRAME_CAPTURE_H_INCLUDED_
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+struct IMFSinkWriter;
+
+
+class FrameCapture
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Number of staging textures. A frame is read back once the GPU has finished copying it, usually two or three frames
+	// later, and is kept mapped while the encoder works on it
+	static constexpr int RING_SIZE = 6;
+
+	// Bits per second of the video
+	static constexpr uint32_t BIT_RATE = 20'000'000;
+
+	// Format of the back buffer, see the swap chain in DXDevice.cpp. The staging textures must match it to be copied to
+	static constexpr DXGI_FORMAT BACK_BUFFER_FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	FrameCapture(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// Finishes any video being captured, see Stop
+	~FrameCapture();
+
+	// Prevent copying - the capture owns its thread
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start capturing frames of the given back buffer size to an MP4 file, at most frameRate a second. Returns false with an
+	// error if the staging textures or the video file can't be created
+	bool Start(const std::string& fileName, int width, int height, int frameRate, std::string& error);
+
+	// Capture the back buffer if it is time for another frame and collect the frames the GPU has finished copying. Called by
+	// DXDevice::PresentFrame before presenting. Never waits for the GPU or the encoder
+	void CaptureFrame(ID3D11Texture2D* backBuffer);
+
+	// Encode the frames still waiting and finish the file. Waits for the GPU and the encoder. Returns false if the video
+	// couldn't be written
+	bool Stop();
+
+	bool IsCapturing()  { return mSinkWriter != nullptr; }
+
+	// Frames encoded and dropped because the GPU or encoder was behind, since Start
+	uint32_t FramesEncoded()  { return mFramesEncoded.load(std::memory_order_relaxed); }
+	uint32_t FramesDropped()  { return mFramesDropped; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A staging texture goes Free -> Copying (waiting for the GPU) -> Mapped (waiting for or being encoded) -> Encoded, and is
+	// unmapped and freed by the main thread. Only the encoder thread moves a texture from Mapped to Encoded
+	enum class SlotState { Free, Copying, Mapped, Encoded };
+
+	struct Slot
+	{
+		CComPtr<ID3D11Texture2D> staging;
+		std::atomic<SlotState>   state = SlotState::Free;
+		D3D11_MAPPED_SUBRESOURCE mapped = {};
+		int64_t                  time   = 0; // Presentation time in 100ns units from the first frame, as Media Foundation uses
+	};
+
+	// Map the copies the GPU has finished, oldest first, and pass them to the encoder. With wait, waits for the GPU
+	void CollectCopies(bool wait);
+
+	// Unmap and free the staging textures the encoder has finished with
+	void ReleaseEncoded();
+
+	// Encode the frames passed to it until stopped
+	void EncoderLoop();
+
+	// Convert one mapped frame and give it to the sink writer. Returns false on failure
+	bool EncodeFrame(Slot& slot);
+
+	ID3D11Device*        mDevice;
+	ID3D11DeviceContext* mContext;
+
+	Slot mSlots[RING_SIZE];
+	int  mNextCopy   = 0; // Slot the next frame is copied into
+	int  mOldestCopy = 0; // Oldest slot waiting for the GPU
+	int  mCopiesWaiting = 0;
+
+	int  mWidth  = 0; // Of the video, the back buffer's size rounded down to even numbers
+	int  mHeight = 0;
+	std::chrono::steady_clock::duration   mFrameInterval = {};
+	std::chrono::steady_clock::time_point mStartTime;
+	std::chrono::steady_clock::time_point mNextFrameTime;
+	int64_t mFrameDuration = 0; // 100ns units
+
+	IMFSinkWriter* mSinkWriter = nullptr;
+	DWORD          mStream     = 0;
+	bool           mMFStarted  = false;
+
+	std::atomic<uint32_t> mFramesEncoded = 0;
+	uint32_t              mFramesDropped = 0;
+	std::atomic<bool>     mEncodeFailed  = false;
+
+	// Slots mapped and waiting for the encoder, in order
+	std::thread             mEncoderThread;
+	std::mutex              mMutex;
+	std::condition_variable mFrameReady;
+	std::deque<int>         mEncodeQueue;
+	bool                    mStopping = false;
+};
+
+
+#endif //_FRAME_CAPTURE_H_INCLUDED_
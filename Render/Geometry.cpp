@@ -0,0 +1,210 @@
+//--------------------------------------------------------------------------------------
+// GeometryManager class holds the vertex and index data of all meshes in shared GPU buffers
+//--------------------------------------------------------------------------------------
+
+#include "Geometry.h"
+
+#include "Shader.h" // For the input layouts
+#include "StartupProfile.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+// Create a GPU buffer that geometry can be copied into with UpdateSubresource
+static CComPtr<ID3D11Buffer> CreateGeometryBuffer(ID3D11Device* device, UINT bindFlags, unsigned int size)
+{
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags      = bindFlags;
+	bufferDesc.Usage          = D3D11_USAGE_DEFAULT; // Not a dynamic buffer, but geometry can be added to the unused part
+	bufferDesc.ByteWidth      = size;
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags      = 0;
+
+	CComPtr<ID3D11Buffer> buffer;
+	if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &buffer)))  throw std::runtime_error("Failure creating geometry buffer");
+	return buffer;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Add vertices, described by the given vertex elements, and indices in the given format to the pool for that vertex layout and format
+GeometryManager::Range GeometryManager::AddGeometry(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vertexElements, unsigned int vertexSize,
+                                                    const void* vertices, unsigned int numVertices, const void* indices, DXGI_FORMAT indexFormat,
+                                                    unsigned int numIndices)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// Find the pool for this layout and index format, described by every field of the elements
+	std::string layoutKey = std::to_string(indexFormat) + ";" + std::to_string(vertexSize);
+	for (auto& element : vertexElements)
+	{
+		layoutKey += std::string(";") + element.SemanticName + "," + std::to_string(element.SemanticIndex) + "," + std::to_string(element.Format) + "," +
+		             std::to_string(element.InputSlot) + "," + std::to_string(element.AlignedByteOffset) + "," + std::to_string(element.InputSlotClass);
+	}
+
+	auto& pool = mPools[layoutKey];
+	if (pool == nullptr)
+	{
+		// The element descriptions are kept for the instanced layout, with copies of the semantic names they point to
+		auto newPool = std::make_unique<Pool>();
+		newPool->vertexSize = vertexSize;
+		newPool->indexFormat = indexFormat;
+		newPool->indexSize   = (indexFormat == DXGI_FORMAT_R16_UINT) ? 2 : 4;
+		newPool->vertexElements = vertexElements;
+		for (auto& element : vertexElements)  newPool->semanticNames.push_back(element.SemanticName);
+		for (size_t i = 0; i < vertexElements.size(); ++i)  newPool->vertexElements[i].SemanticName = newPool->semanticNames[i].c_str();
+
+		// Pools of 16-bit and 32-bit indices with the same vertices share the layout
+		newPool->vertexLayout = mShaders->CreateInputLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+		if (newPool->vertexLayout == nullptr)  throw std::runtime_error("Failure creating input layout for geometry pool - " + mShaders->GetLastError());
+
+		pool = std::move(newPool);
+	}
+
+	// Start a new block if the geometry doesn't fit in the newest one, larger than usual for geometry bigger than a block
+	auto& block = pool->newestBlock;
+	unsigned int indexSize = pool->indexSize;
+	if (block == nullptr || block->numVertices + numVertices > block->vertexCapacity || block->numIndices + numIndices > block->indexCapacity)
+	{
+		auto newBlock = std::make_shared<Block>();
+		newBlock->vertexCapacity = std::max(BLOCK_VERTEX_BYTES / vertexSize, numVertices);
+		newBlock->indexCapacity  = std::max(BLOCK_INDICES, numIndices);
+		newBlock->vertexBuffer = CreateGeometryBuffer(mDXDevice, D3D11_BIND_VERTEX_BUFFER, newBlock->vertexCapacity * vertexSize);
+		newBlock->indexBuffer  = CreateGeometryBuffer(mDXDevice, D3D11_BIND_INDEX_BUFFER,  newBlock->indexCapacity * indexSize);
+		block = newBlock;
+	}
+
+	// Copy the geometry to the end of the used part of the block
+	Range range;
+	range.block      = block;
+	range.pool       = pool.get();
+	range.baseVertex = block->numVertices;
+	range.startIndex = block->numIndices;
+
+	D3D11_BOX box = { range.baseVertex * vertexSize, 0, 0, (range.baseVertex + numVertices) * vertexSize, 1, 1 };
+	mDXContext->UpdateSubresource(block->vertexBuffer, 0, &box, vertices, 0, 0);
+	box = { range.startIndex * indexSize, 0, 0, (range.startIndex + numIndices) * indexSize, 1, 1 };
+	mDXContext->UpdateSubresource(block->indexBuffer, 0, &box, indices, 0, 0);
+	gStartupProfile.AddBytesUploaded(static_cast<uint64_t>(numVertices) * vertexSize + static_cast<uint64_t>(numIndices) * indexSize);
+
+	block->numVertices += numVertices;
+	block->numIndices  += numIndices;
+	return range;
+}
+
+
+// Input layout for instanced rendering of the geometry in a range, created the first time it is needed for each pool
+ID3D11InputLayout* GeometryManager::InstancedVertexLayout(const Range& range)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	Pool& pool = *range.pool;
+	if (pool.instancedVertexLayout != nullptr || pool.instancedLayoutFailed)  return pool.instancedVertexLayout;
+
+	auto vertexElements = pool.vertexElements;
+	for (unsigned int row = 0; row < 4; ++row)
+		vertexElements.push_back({ "instanceWorld", row, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, row * 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 });
+
+	pool.instancedVertexLayout = mShaders->CreateInputLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+	pool.instancedLayoutFailed = (pool.instancedVertexLayout == nullptr);
+	return pool.instancedVertexLayout;
+}
+
+
+// Copy part of a GPU buffer into the given memory through a staging buffer. Returns false if the staging buffer can't be created
+// or mapped
+static bool ReadBuffer(ID3D11Device* device, ID3D11DeviceContext* context, ID3D11Buffer* buffer, unsigned int offset,
+                       unsigned int size, void* data)
+{
+	if (size == 0)  return true;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.Usage          = D3D11_USAGE_STAGING;
+	bufferDesc.ByteWidth      = size;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	CComPtr<ID3D11Buffer> staging;
+	if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &staging)))  return false;
+
+	D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+	context->CopySubresourceRegion(staging, 0, 0, 0, 0, buffer, 0, &box);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(staging, 0, D3D11_MAP_READ, 0, &mapped)))  return false;
+	std::memcpy(data, mapped.pData, size);
+	context->Unmap(staging, 0);
+	return true;
+}
+
+// Copy the vertices and indices of a range back from the GPU, with the indices widened to 32-bit
+bool GeometryManager::ReadGeometry(const Range& range, unsigned int numVertices, unsigned int numIndices,
+                                   std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices)
+{
+	if (range.block == nullptr)  return false;
+	unsigned int vertexSize = range.pool->vertexSize;
+	unsigned int indexSize  = range.pool->indexSize;
+
+	vertices.resize(static_cast<size_t>(numVertices) * vertexSize);
+	if (!ReadBuffer(mDXDevice, mDXContext, range.block->vertexBuffer, range.baseVertex * vertexSize, numVertices * vertexSize, vertices.data()))
+		return false;
+
+	indices.resize(numIndices);
+	if (indexSize == 4)
+		return ReadBuffer(mDXDevice, mDXContext, range.block->indexBuffer, range.startIndex * 4, numIndices * 4, indices.data());
+
+	std::vector<uint16_t> shortIndices(numIndices);
+	if (!ReadBuffer(mDXDevice, mDXContext, range.block->indexBuffer, range.startIndex * 2, numIndices * 2, shortIndices.data()))
+		return false;
+	std::copy(shortIndices.begin(), shortIndices.end(), indices.begin());
+	return true;
+}
+
+
+// Set the vertex buffer, index buffer and input layout for drawing from a range on the given context, only calling DirectX for
+// the ones that differ from its bindings
+void GeometryManager::Bind(ID3D11DeviceContext* context, Bindings& bindings, const Range& range, bool instanced /*= false*/)
+{
+	if (range.block->vertexBuffer != bindings.vertexBuffer)
+	{
+		UINT stride = range.pool->vertexSize;
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, &range.block->vertexBuffer.p, &stride, &offset);
+		bindings.vertexBuffer = range.block->vertexBuffer;
+		gRenderCounters.Add(RenderCounter::VertexBufferBinds);
+	}
+
+	// The index format belongs to the pool, so it only changes along with the index buffer
+	if (range.block->indexBuffer != bindings.indexBuffer)
+	{
+		context->IASetIndexBuffer(range.block->indexBuffer, range.pool->indexFormat, 0);
+		bindings.indexBuffer = range.block->indexBuffer;
+		gRenderCounters.Add(RenderCounter::IndexBufferBinds);
+	}
+
+	// Layouts are shared by every pool with the same vertex elements, so pointers are the same whenever the layouts are
+	ID3D11InputLayout* layout = instanced ? range.pool->instancedVertexLayout : range.pool->vertexLayout;
+	if (layout != bindings.layout)
+	{
+		context->IASetInputLayout(layout);
+		bindings.layout = layout;
+		gRenderCounters.Add(RenderCounter::InputLayoutBinds);
+	}
+
+	// Meshes only use triangle lists
+	if (!bindings.topologySet)
+	{
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		bindings.topologySet = true;
+	}
+}
+
+
+// Call if the input assembler state may have been changed outside this class - the next Bind will set everything again
+void GeometryManager::ResetBindings()
+{
+	mImmediateBindings = {};
+}
@@ -0,0 +1,176 @@
+//--------------------------------------------------------------------------------------
+// GeometryManager class holds the vertex and index data of all meshes in shared GPU buffers
+//--------------------------------------------------------------------------------------
+// Rather than each sub-mesh having its own vertex and index buffer, sub-meshes with the same vertex layout share a pool of large
+// buffers, with each sub-mesh being a range of vertices and indices within them. Each pool also has a single input layout object,
+// shared with other pools and other code using the same vertex elements (see ShaderManager::CreateInputLayout).
+// Consecutive draws from the same pool don't need to change the vertex buffer, index buffer or input layout, so Bind only calls
+// IASetVertexBuffers / IASetIndexBuffer / IASetInputLayout when one of them actually changes. Sorting draws (see RenderQueue.h)
+// puts draws with the same render state together, which usually means the same vertex layout too
+//
+//   auto geometry = DX->Geometry()->AddGeometry(vertexElements, vertexSize, vertices, numVertices, indices, numIndices);
+//   ...
+//   DX->Geometry()->Bind(geometry);
+//   DX->Context()->DrawIndexed(numIndices, geometry.startIndex, geometry.baseVertex);
+//
+// A pool is made of blocks, each a vertex and an index buffer. Geometry is added to the end of a pool's newest block, a new block
+// is created when that is full. Space is not reused when a mesh is destroyed, but older blocks are released when no mesh uses them.
+// Geometry with 16-bit indices is kept in separate pools from 32-bit, since the index format is set with the index buffer
+//
+// Bind records what it has set on the immediate context. Deferred contexts recording draws on other threads (see RenderQueue)
+// pass their own Bindings record instead
+
+#ifndef _GEOMETRY_H_INCLUDED_
+#define _GEOMETRY_H_INCLUDED_
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+class ShaderManager;
+
+
+//--------------------------------------------------------------------------------------
+// Geometry Manager Class
+//--------------------------------------------------------------------------------------
+class GeometryManager
+{
+	//--------------------------------------------------------------------------------------
+	// Types
+	//--------------------------------------------------------------------------------------
+public:
+	// A vertex and index buffer in a pool, see above
+	struct Block
+	{
+		CComPtr<ID3D11Buffer> vertexBuffer;
+		CComPtr<ID3D11Buffer> indexBuffer;
+		unsigned int vertexCapacity = 0; // Vertices and indices the buffers hold, and how many are in use
+		unsigned int indexCapacity  = 0;
+		unsigned int numVertices    = 0;
+		unsigned int numIndices     = 0;
+	};
+
+	// All the geometry with one vertex layout and index format
+	struct Pool
+	{
+		unsigned int vertexSize = 0; // in bytes
+		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements; // Semantic names point into semanticNames
+		std::vector<std::string>              semanticNames;
+		DXGI_FORMAT  indexFormat = DXGI_FORMAT_R32_UINT;
+		unsigned int indexSize   = 4;  // in bytes
+		ID3D11InputLayout* vertexLayout          = nullptr; // Owned by the shader manager
+		ID3D11InputLayout* instancedVertexLayout = nullptr; // Created when first needed, see InstancedVertexLayout
+		bool instancedLayoutFailed = false;
+		std::shared_ptr<Block> newestBlock;
+	};
+
+	// The input assembler state Bind has set on a device context. The buffers are held so they can't be released and another
+	// buffer created at the same address while they are still recorded here
+	struct Bindings
+	{
+		CComPtr<ID3D11Buffer> vertexBuffer;
+		CComPtr<ID3D11Buffer> indexBuffer;
+		ID3D11InputLayout*    layout      = nullptr;
+		bool                  topologySet = false;
+	};
+
+	// Where some geometry is held, returned by AddGeometry. Keeps its block alive. A default range holds no geometry
+	struct Range
+	{
+		std::shared_ptr<Block> block;
+		Pool*        pool       = nullptr;
+		unsigned int baseVertex = 0; // Add to the indices to get the vertex in the block's vertex buffer (BaseVertexLocation)
+		unsigned int startIndex = 0; // Position of the first index in the block's index buffer (StartIndexLocation)
+	};
+
+
+	//--------------------------------------------------------------------------------------
+	// Construction
+	//--------------------------------------------------------------------------------------
+public:
+	// Create the geometry manager, pass DirectX device and context, and the shader manager that creates the input layouts
+	GeometryManager(ID3D11Device* device, ID3D11DeviceContext* context, ShaderManager* shaders)
+		: mDXDevice(device), mDXContext(context), mShaders(shaders) {}
+
+
+	//--------------------------------------------------------------------------------------
+	// Usage
+	//--------------------------------------------------------------------------------------
+public:
+	// Add vertices, described by the given vertex elements, and 32-bit or 16-bit indices to the pool for that vertex layout and
+	// index size. The indices are relative to the first of the given vertices. Throws std::runtime_error if the buffers or layout
+	// can't be created. Can be called on several threads at once if the context is thread-safe (see DXDevice::SetContextThreadSafe)
+	Range AddGeometry(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vertexElements, unsigned int vertexSize,
+	                  const void* vertices, unsigned int numVertices, const uint32_t* indices, unsigned int numIndices)
+	{
+		return AddGeometry(vertexElements, vertexSize, vertices, numVertices, indices, DXGI_FORMAT_R32_UINT, numIndices);
+	}
+	Range AddGeometry(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vertexElements, unsigned int vertexSize,
+	                  const void* vertices, unsigned int numVertices, const uint16_t* indices, unsigned int numIndices)
+	{
+		return AddGeometry(vertexElements, vertexSize, vertices, numVertices, indices, DXGI_FORMAT_R16_UINT, numIndices);
+	}
+
+	// Input layout for instanced rendering of the geometry in a range - the pool's vertex layout with the per-instance world
+	// matrix added as four rows read from vertex buffer slot 1 (see InstanceBuffer.h). Returns nullptr if it can't be created
+	ID3D11InputLayout* InstancedVertexLayout(const Range& range);
+
+	// Copy the given number of vertices and indices of a range back from the GPU, e.g. to combine the geometry of several meshes
+	// (see StaticBatcher.h). The indices are returned as 32-bit whatever the pool holds. Waits for the GPU, so only use while
+	// loading. Returns false if the copy couldn't be made. Immediate context only
+	bool ReadGeometry(const Range& range, unsigned int numVertices, unsigned int numIndices,
+	                  std::vector<uint8_t>& vertices, std::vector<uint32_t>& indices);
+
+	// Set the vertex buffer, index buffer and input layout for drawing from a range, pass true to use the instanced layout. Only
+	// calls DirectX for the ones that aren't already set. Then draw with range.startIndex and range.baseVertex
+	void Bind(const Range& range, bool instanced = false)  { Bind(mDXContext, mImmediateBindings, range, instanced); }
+
+	// As above, but for the given device context, with what is already set on it in the given bindings. Can be used on other
+	// threads for deferred contexts, each with its own bindings
+	void Bind(ID3D11DeviceContext* context, Bindings& bindings, const Range& range, bool instanced = false);
+
+	// Call if the input assembler state may have been changed outside this class - the next Bind will set everything again.
+	// Called by RenderState::Reset
+	void ResetBindings();
+
+
+	//--------------------------------------------------------------------------------------
+	// Private functions
+	//--------------------------------------------------------------------------------------
+private:
+	// Shared by the public AddGeometry functions, indexFormat is DXGI_FORMAT_R32_UINT or DXGI_FORMAT_R16_UINT
+	Range AddGeometry(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vertexElements, unsigned int vertexSize,
+	                  const void* vertices, unsigned int numVertices, const void* indices, DXGI_FORMAT indexFormat, unsigned int numIndices);
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Data
+	//--------------------------------------------------------------------------------------
+private:
+	// Space in a new block, the block is made larger if some geometry is larger than this
+	static constexpr unsigned int BLOCK_VERTEX_BYTES = 4 * 1024 * 1024;
+	static constexpr unsigned int BLOCK_INDICES      = 1024 * 1024;
+
+	ID3D11Device*        mDXDevice;
+	ID3D11DeviceContext* mDXContext;
+	ShaderManager*       mShaders;
+
+	// Pools by a description of their vertex elements and index format. Pools are never destroyed so ranges can point to them
+	std::map<std::string, std::unique_ptr<Pool>> mPools;
+
+	// The input assembler state last set on the immediate context by Bind
+	Bindings mImmediateBindings;
+
+	// Guards the pools while geometry is added and instanced layouts created, so meshes can be loaded on several threads
+	std::mutex mMutex;
+};
+
+
+#endif //_GEOMETRY_H_INCLUDED_
@@ -0,0 +1,210 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling of instanced meshes on the GPU, drawn with indirect draw calls
+//--------------------------------------------------------------------------------------
+
+#include "GpuCuller.h"
+#include "Mesh.h"
+
+#include "Shader.h"
+#include "CBuffer.h"
+#include "RenderGlobals.h"
+
+#include <stdexcept>
+#include <cstring>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the culling compute shader and create its constant buffer and scene buffer. Throws std::runtime_error on failure
+GpuCuller::GpuCuller()
+{
+	mComputeShader = DX->Shaders()->LoadComputeShader("cs_cull-instances");
+	if (mComputeShader == nullptr)  throw std::runtime_error("GPU culling: " + DX->Shaders()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(CullConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("GPU culling: failure creating constant buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start gathering the batches for one camera view
+void GpuCuller::Begin()
+{
+	mBatches.clear();
+	mNumMatrices = 0;
+	mSlots.clear();
+	mArgs.clear();
+}
+
+
+// Add a batch of instances of a mesh, all with the same colour. Returns where to write the instances' scene buffer slots
+uint32_t* GpuCuller::AddBatch(Mesh& mesh, ColourRGBA colour, unsigned int numInstances)
+{
+	Batch batch;
+	batch.mesh         = &mesh;
+	batch.colour       = colour;
+	batch.firstMatrix  = mNumMatrices;
+	batch.numInstances = numInstances;
+	batch.firstArg     = static_cast<unsigned int>(mArgs.size());
+	batch.firstSlot    = static_cast<unsigned int>(mSlots.size());
+
+	mesh.WriteIndirectArgs(mArgs, batch.firstMatrix, numInstances);
+	batch.numArgs = static_cast<unsigned int>(mArgs.size()) - batch.firstArg;
+	mBatches.push_back(batch);
+
+	mNumMatrices += mesh.InstanceMatrixCount() * numInstances;
+	mSlots.resize(mSlots.size() + numInstances);
+	return mSlots.data() + batch.firstSlot;
+}
+
+
+// Cull the instances of all the batches against the frustum and render the visible ones. Returns false without rendering
+// anything on failure
+bool GpuCuller::CullAndRender(const Frustum& frustum)
+{
+	if (mBatches.empty())  return true;
+
+	// Describe the instances and batches for the compute shader. Instances of meshes without geometry (no draw arguments) are left
+	// out, they have no counts to add to. Instances with empty bounds are skipped by the shader
+	mGpuInstances.clear();
+	mGpuBatches.clear();
+	for (auto& batch : mBatches)
+	{
+		uint32_t batchIndex = static_cast<uint32_t>(mGpuBatches.size());
+		mGpuBatches.push_back({ batch.firstMatrix, batch.numInstances, batch.mesh->InstanceMatrixCount(), batch.firstArg, batch.numArgs });
+		if (batch.numArgs == 0)  continue;
+
+		for (unsigned int i = 0; i < batch.numInstances; ++i)  mGpuInstances.push_back({ mSlots[batch.firstSlot + i], batchIndex });
+	}
+	if (mArgs.empty())  return true;
+	unsigned int numInstances = static_cast<unsigned int>(mGpuInstances.size());
+	unsigned int argsBytes    = static_cast<unsigned int>(mArgs.size() * sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS));
+
+	// Send the scene buffer's changes and the batches to the GPU. The argument buffer is rewritten with instance counts of 0 for
+	// the shader to add to
+	if (numInstances > 0 &&
+	    (!mScene.Upload() ||
+	     !UploadStructured(mInstanceBuffer, mGpuInstances.data(), sizeof(GpuInstance), numInstances) ||
+	     !UploadStructured(mBatchBuffer,    mGpuBatches.data(),   sizeof(GpuBatch), static_cast<unsigned int>(mGpuBatches.size()))))  return false;
+	if (!ReserveRaw(mCulledMatrixBuffer, mNumMatrices * sizeof(Matrix4x4), D3D11_BIND_VERTEX_BUFFER, 0) ||
+	    !ReserveRaw(mArgsBuffer, argsBytes, 0, D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS))  return false;
+
+	auto context = DX->Context();
+	D3D11_BOX box = { 0, 0, 0, argsBytes, 1, 1 };
+	context->UpdateSubresource(mArgsBuffer.buffer, 0, &box, mArgs.data(), 0, 0);
+
+	if (numInstances > 0)
+	{
+		for (unsigned int plane = 0; plane < 6; ++plane)  mConstants.frustumPlanes[plane] = frustum.PlaneVector(plane);
+		mConstants.numInstances = numInstances;
+		DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+		// The culled matrices may still be bound as the instance vertex buffer from the last call, they can't be written while it is
+		ID3D11Buffer* nullBuffer = nullptr;
+		UINT zero = 0;
+		context->IASetVertexBuffers(1, 1, &nullBuffer, &zero, &zero);
+
+		ID3D11ShaderResourceView*  srvs[] = { mInstanceBuffer.srv, mBatchBuffer.srv, mScene.EntryView(), mScene.MatrixView() };
+		ID3D11UnorderedAccessView* uavs[] = { mCulledMatrixBuffer.uav, mArgsBuffer.uav };
+		context->CSSetShader(mComputeShader, nullptr, 0);
+		context->CSSetConstantBuffers(0, 1, &mConstantBuffer);
+		context->CSSetShaderResources(0, 4, srvs);
+		context->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+		context->Dispatch((numInstances + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE, 1, 1);
+
+		// Unbind the buffers so they can be used for drawing
+		ID3D11ShaderResourceView*  nullSrvs[4] = {};
+		ID3D11UnorderedAccessView* nullUavs[2] = {};
+		context->CSSetShaderResources(0, 4, nullSrvs);
+		context->CSSetUnorderedAccessViews(0, 2, nullUavs, nullptr);
+		context->CSSetShader(nullptr, nullptr, 0);
+	}
+
+	// Batches with no visible instances are still drawn, the GPU skips draws with an instance count of 0
+	for (auto& batch : mBatches)
+	{
+		if (batch.numArgs == 0)  continue;
+		batch.mesh->RenderInstancedIndirect(mCulledMatrixBuffer.buffer, mArgsBuffer.buffer, batch.firstArg, batch.colour);
+		mStats.instances += batch.numInstances;
+		mStats.draws     += batch.numArgs;
+		++mStats.batches;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure a dynamic structured buffer holds the given elements, then copy them in. Returns false on failure
+bool GpuCuller::UploadStructured(GrowableBuffer& buffer, const void* elements, unsigned int elementSize, unsigned int numElements)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numElements > buffer.capacity)
+	{
+		unsigned int capacity = (buffer.capacity > 0) ? buffer.capacity : INITIAL_CAPACITY;
+		while (capacity < numElements)  capacity *= 2;
+		buffer = {};
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = capacity * elementSize;
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC; // Rewritten for every camera view
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = elementSize;
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &buffer.buffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = capacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(buffer.buffer, &srvDesc, &buffer.srv)))  { buffer = {};  return false; }
+		buffer.capacity = capacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(buffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, elements, static_cast<size_t>(numElements) * elementSize);
+	DX->Context()->Unmap(buffer.buffer, 0);
+	return true;
+}
+
+
+// Make sure a raw buffer written by the compute shader has the given size in bytes, with the given extra bind and misc flags.
+// Returns false on failure
+bool GpuCuller::ReserveRaw(GrowableBuffer& buffer, unsigned int bytes, UINT bindFlags, UINT miscFlags)
+{
+	if (bytes <= buffer.capacity)  return true;
+
+	unsigned int capacity = (buffer.capacity > 0) ? buffer.capacity : INITIAL_CAPACITY * sizeof(Vector4); // In bytes
+	while (capacity < bytes)  capacity *= 2;
+	buffer = {};
+
+	// Written on the GPU only, by the compute shader and by UpdateSubresource for the arguments
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags      = D3D11_BIND_UNORDERED_ACCESS | bindFlags;
+	bufferDesc.ByteWidth      = capacity;
+	bufferDesc.Usage          = D3D11_USAGE_DEFAULT;
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags      = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | miscFlags;
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &buffer.buffer)))  return false;
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format              = DXGI_FORMAT_R32_TYPELESS;
+	uavDesc.ViewDimension       = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements  = capacity / 4;
+	uavDesc.Buffer.Flags        = D3D11_BUFFER_UAV_FLAG_RAW;
+	if (FAILED(DX->Device()->CreateUnorderedAccessView(buffer.buffer, &uavDesc, &buffer.uav)))  { buffer = {};  return false; }
+	buffer.capacity = capacity;
+	return true;
+}
@@ -0,0 +1,178 @@
+//--------------------------------------------------------------------------------------
+// Frustum culling of instanced meshes on the GPU, drawn with indirect draw calls
+//--------------------------------------------------------------------------------------
+// With instanced rendering (see InstanceBuffer.h) each entity is tested against the frustum on the CPU, and only the visible
+// ones are gathered into batches. Here every candidate is tested on the GPU instead. The world matrices and bounding sphere of
+// each instance are kept in the culler's scene buffer (see SceneBuffer.h) under its entity slot, only those that have changed
+// being uploaded, so each batch is just the slots of its instances. A compute shader (cs_cull-instances) tests each sphere
+// against the frustum planes and copies the matrices of the visible instances to the front of their batch's area in a second buffer, which the instanced vertex shaders read as their
+// per-instance vertex buffer. It also counts the visible instances into the DrawIndexedInstancedIndirect arguments of each of
+// the batch's sub-meshes. The CPU then draws each batch with one indirect draw per sub-mesh and never reads the counts back, so
+// the number of draw calls depends only on the meshes in use (and their levels of detail), not on how many props, mines and
+// crates are in the level or how many of them are visible
+//
+//   gpuCuller.Begin();
+//   uint32_t* slots = gpuCuller.AddBatch(mesh, colour, numInstances);
+//   ... for each instance i, gpuCuller.Scene().Write(slot, its drawn node matrices, mesh.InstanceMatrixCount(), its bounds)
+//       and slots[i] = slot ...
+//   if (!gpuCuller.CullAndRender(frustum))  ... render the instances some other way ...
+//
+// There is no hierarchical depth buffer in this app (occlusion culling uses predicates, see OcclusionCuller.h) so only the
+// frustum is tested. The visible instances of a batch are drawn in whichever order the GPU threads reach them
+
+#ifndef _GPU_CULLER_H_INCLUDED_
+#define _GPU_CULLER_H_INCLUDED_
+
+#include "Frustum.h"
+#include "Matrix4x4.h"
+#include "Vector4.h"
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+#include "SceneBuffer.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+
+
+class GpuCuller
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the culling compute shader and create its constant buffer and scene buffer. Throws std::runtime_error on failure, e.g. if the device
+	// doesn't support compute shaders
+	GpuCuller();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start gathering the batches for one camera view, removing those from the last CullAndRender
+	void Begin();
+
+	// Add a batch of instances of a mesh that can be rendered instanced (see Mesh::CanRenderInstanced), all with the same colour.
+	// Returns where to write the scene buffer slots of the instances, valid until the next AddBatch. Each slot's entry must be
+	// written with the mesh's drawn node matrices before CullAndRender
+	uint32_t* AddBatch(Mesh& mesh, ColourRGBA colour, unsigned int numInstances);
+
+	// The world matrices and bounds of the instances, kept between frames
+	SceneBuffer& Scene()  { return mScene; }
+
+	// Cull the instances of all the batches against the frustum and render the visible ones. Returns false without rendering
+	// anything if the GPU buffers can't be created or written, then the caller should render the instances another way
+	bool CullAndRender(const Frustum& frustum);
+
+	// Enable or disable GPU culling. The culler doesn't check this itself, it is for the code choosing to use it
+	bool& Enabled()  { return mEnabled; }
+
+	// Statistics for the control panel, totals since the last reset. Instances are the candidates sent to the GPU, draws are the
+	// indirect draw calls made for them. The number actually visible stays on the GPU. The scene buffer keeps its own, see Scene
+	struct Stats
+	{
+		uint32_t instances = 0;
+		uint32_t batches   = 0;
+		uint32_t draws     = 0;
+	};
+	const Stats& GetStats()    { return mStats; }
+	void         ResetStats()  { mStats = {};  mScene.ResetStats(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A batch added by AddBatch. Its culled matrices start at firstMatrix, its draw arguments at firstArg and its instances'
+	// scene slots at firstSlot
+	struct Batch
+	{
+		Mesh*        mesh;
+		ColourRGBA   colour;
+		unsigned int firstMatrix;
+		unsigned int numInstances;
+		unsigned int firstArg;
+		unsigned int numArgs;
+		unsigned int firstSlot;
+	};
+
+	// Per-instance and per-batch data read by the compute shader, must match the structures in cs_cull-instances.hlsl
+	struct GpuInstance
+	{
+		uint32_t sceneSlot;   // Of the instance's entry in the scene buffer
+		uint32_t batch;
+	};
+	struct GpuBatch
+	{
+		uint32_t firstMatrix;
+		uint32_t numInstances;
+		uint32_t numNodes;    // Matrices per instance
+		uint32_t firstArg;
+		uint32_t numArgs;
+		uint32_t padding[3] = {};
+	};
+
+	// A GPU buffer that is replaced by a larger one when more space is needed, with the view the compute shader uses it through
+	struct GrowableBuffer
+	{
+		CComPtr<ID3D11Buffer>              buffer;
+		CComPtr<ID3D11ShaderResourceView>  srv;
+		CComPtr<ID3D11UnorderedAccessView> uav;
+		unsigned int capacity = 0; // In elements for structured buffers, bytes for raw buffers
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Make sure a dynamic structured buffer, read by the compute shader, holds the given elements, then copy them in. Returns
+	// false on failure
+	bool UploadStructured(GrowableBuffer& buffer, const void* elements, unsigned int elementSize, unsigned int numElements);
+
+	// Make sure a raw buffer written by the compute shader has the given size in bytes, with the given extra bind and misc flags.
+	// Returns false on failure
+	bool ReserveRaw(GrowableBuffer& buffer, unsigned int bytes, UINT bindFlags, UINT miscFlags);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Threads in each group of the compute shader, must match numthreads in cs_cull-instances.hlsl
+	static constexpr unsigned int THREAD_GROUP_SIZE = 64;
+
+	// Buffers start with space for this many elements (or matrices), then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 1024;
+
+	bool  mEnabled = true;
+	Stats mStats;
+
+	ID3D11ComputeShader* mComputeShader;  // Owned by the shader manager
+	ID3D11Buffer*        mConstantBuffer; // Owned by the constant buffer manager
+	CullConstants        mConstants;
+
+	SceneBuffer mScene;
+
+	// Batches gathered since Begin, with the data to send to the GPU for them
+	std::vector<Batch>          mBatches;
+	unsigned int                mNumMatrices = 0; // Culled matrices for all the batches
+	std::vector<uint32_t>       mSlots;
+	std::vector<D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS> mArgs;
+	std::vector<GpuInstance>    mGpuInstances;
+	std::vector<GpuBatch>       mGpuBatches;
+
+	GrowableBuffer mInstanceBuffer;      // GpuInstance for every candidate
+	GrowableBuffer mBatchBuffer;         // GpuBatch for every batch
+	GrowableBuffer mCulledMatrixBuffer;  // World matrices of the visible instances, the per-instance vertex buffer for drawing
+	GrowableBuffer mArgsBuffer;          // DrawIndexedInstancedIndirect arguments for every sub-mesh of every batch
+};
+
+
+#endif //_GPU_CULLER_H_INCLUDED_
@@ -0,0 +1,306 @@
+//--------------------------------------------------------------------------------------
+// GPU missiles - ballistic missiles simulated and hit tested by compute shaders, for battles with thousands of boats
+//--------------------------------------------------------------------------------------
+
+#include "GpuMissiles.h"
+#include "Mesh.h"
+#include "Vector4.h"
+
+#include "RenderGlobals.h"
+#include "Shader.h"
+#include "CBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the missile shaders and create the missile slots, drawing missiles with the given mesh. Throws std::runtime_error on failure
+GpuMissiles::GpuMissiles(Mesh& mesh)
+	: mMesh(mesh)
+{
+	if (!mesh.CanRenderInstanced())  throw std::runtime_error("GPU missiles: the missile mesh can't be rendered instanced");
+
+	mLaunchShader   = DX->Shaders()->LoadComputeShader("cs_missiles-launch");
+	mSimulateShader = DX->Shaders()->LoadComputeShader("cs_missiles-simulate");
+	if (mLaunchShader == nullptr || mSimulateShader == nullptr)  throw std::runtime_error("GPU missiles: " + DX->Shaders()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(MissileConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("GPU missiles: failure creating constant buffer");
+
+	auto device = DX->Device();
+
+	// Missile slots, all zero so every slot starts dead. Must match the Missile structure in the shaders, 48 bytes
+	const UINT missileSize = 48;
+	std::vector<uint8_t> zeros(MAX_MISSILES * missileSize, 0);
+	D3D11_BUFFER_DESC missileDesc = {};
+	missileDesc.BindFlags           = D3D11_BIND_UNORDERED_ACCESS;
+	missileDesc.ByteWidth           = MAX_MISSILES * missileSize;
+	missileDesc.Usage               = D3D11_USAGE_DEFAULT;
+	missileDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	missileDesc.StructureByteStride = missileSize;
+	D3D11_SUBRESOURCE_DATA missileData = { zeros.data(), 0, 0 };
+	D3D11_UNORDERED_ACCESS_VIEW_DESC missileUAVDesc = {};
+	missileUAVDesc.Format              = DXGI_FORMAT_UNKNOWN;
+	missileUAVDesc.ViewDimension       = D3D11_UAV_DIMENSION_BUFFER;
+	missileUAVDesc.Buffer.NumElements  = MAX_MISSILES;
+	if (FAILED(device->CreateBuffer(&missileDesc, &missileData, &mMissileBuffer)) ||
+	    FAILED(device->CreateUnorderedAccessView(mMissileBuffer, &missileUAVDesc, &mMissileUAV)))
+		throw std::runtime_error("GPU missiles: failure creating missile buffer");
+
+	// Raw buffers written by the simulation: the hits, the matrices drawn (also the instance vertex buffer) and the draw arguments
+	auto createRaw = [&](UINT bytes, UINT bindFlags, UINT miscFlags, CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11UnorderedAccessView>& uav)
+	{
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | bindFlags;
+		bufferDesc.ByteWidth = bytes;
+		bufferDesc.Usage     = D3D11_USAGE_DEFAULT;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | miscFlags;
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format             = DXGI_FORMAT_R32_TYPELESS;
+		uavDesc.ViewDimension      = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.NumElements = bytes / 4;
+		uavDesc.Buffer.Flags       = D3D11_BUFFER_UAV_FLAG_RAW;
+		if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &buffer)) || FAILED(device->CreateUnorderedAccessView(buffer, &uavDesc, &uav)))
+			throw std::runtime_error("GPU missiles: failure creating buffer");
+	};
+	unsigned int numNodes = mesh.InstanceMatrixCount();
+	mesh.WriteIndirectArgs(mArgs, 0, MAX_MISSILES);
+	createRaw(HIT_BUFFER_BYTES, 0, 0, mHitBuffer, mHitUAV);
+	createRaw(numNodes * MAX_MISSILES * sizeof(Matrix4x4), D3D11_BIND_VERTEX_BUFFER, 0, mMatrixBuffer, mMatrixUAV);
+	createRaw(static_cast<UINT>(mArgs.size() * sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS)), 0, D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS,
+	          mArgsBuffer, mArgsUAV);
+
+	D3D11_BUFFER_DESC stagingDesc = {};
+	stagingDesc.ByteWidth      = HIT_BUFFER_BYTES;
+	stagingDesc.Usage          = D3D11_USAGE_STAGING;
+	stagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	for (auto& readback : mReadbacks)
+	{
+		if (FAILED(device->CreateBuffer(&stagingDesc, nullptr, &readback)))  throw std::runtime_error("GPU missiles: failure creating readback buffer");
+	}
+
+	// The mesh's nodes relative to its root, each from its default transform and its parent's, then just those that are drawn in
+	// the order the instance buffer holds them
+	std::vector<Matrix4x4> nodeMatrices(mesh.NodeCount());
+	nodeMatrices[0] = Matrix4x4::Identity;
+	for (unsigned int node = 1; node < mesh.NodeCount(); ++node)
+		nodeMatrices[node] = mesh.DefaultTransform(node) * nodeMatrices[mesh.ParentNode(node)];
+	std::vector<Matrix4x4> drawnMatrices(numNodes);
+	mesh.WriteInstanceMatrices(nodeMatrices.data(), drawnMatrices.data(), 0, 1);
+	unsigned int capacity = 0;
+	if (!UploadStructured(mNodeBuffer, mNodeSRV, capacity, drawnMatrices.data(), sizeof(Vector4), numNodes * 4))
+		throw std::runtime_error("GPU missiles: failure creating node buffer");
+
+	mSlots.resize(MAX_MISSILES);
+	mFreeSlots.resize(MAX_MISSILES);
+	for (uint32_t slot = 0; slot < MAX_MISSILES; ++slot)  mFreeSlots[slot] = MAX_MISSILES - 1 - slot; // Lowest slots used first
+
+	mConstants.gravity     = GRAVITY;
+	mConstants.floorHeight = FLOOR_HEIGHT;
+	mConstants.hitRadius   = HIT_RADIUS;
+	mConstants.numNodes    = numNodes;
+	mConstants.numArgs     = static_cast<uint32_t>(mArgs.size());
+	mConstants.maxHits     = MAX_HITS;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Launch a missile at the next Update. Returns false if every slot is in use
+bool GpuMissiles::Launch(const Vector3& position, const Vector3& velocity, uint32_t launchingBoat)
+{
+	if (mFreeSlots.empty())  return false;
+	uint32_t slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+
+	// The time to fall to the floor from y = y0 + vy t - g t^2 / 2. The next Update moves the missile by all the time gathered
+	// since the last one, so on the GPU's clock it was launched at the last Update, up to a frame before it was really launched.
+	// A missile launched below the floor is gone at once
+	float drop = position.y - FLOOR_HEIGHT;
+	float fallTime = (drop > 0) ? (velocity.y + std::sqrt(velocity.y * velocity.y + 2 * GRAVITY * drop)) / GRAVITY : 0;
+	Slot& info = mSlots[slot];
+	info.serial = mNextSerial++;
+	info.expiry = mClock + std::min(fallTime, MAX_LIFETIME);
+	info.used   = true;
+	mUsedSlots.push_back(slot);
+
+	mLaunches.push_back({ position, slot, velocity, launchingBoat, info.serial });
+	return true;
+}
+
+
+// Launch the missiles waiting, move every missile on and test them against the given boats, then collect the hits that have arrived
+void GpuMissiles::Update(const std::vector<Target>& targets)
+{
+	mStats = {};
+	mHits.clear();
+
+	unsigned int numLaunches = static_cast<unsigned int>(mLaunches.size());
+	unsigned int numTargets  = static_cast<unsigned int>(targets.size());
+	if (numLaunches > 0 && !UploadStructured(mLaunchBuffer, mLaunchSRV, mLaunchCapacity, mLaunches.data(), sizeof(GpuLaunch), numLaunches))
+	{
+		// The missiles can't be launched, give their slots back
+		for (auto& launch : mLaunches)  FreeSlot(launch.slot);
+		numLaunches = 0;
+	}
+	if (numTargets > 0 && !UploadStructured(mTargetBuffer, mTargetSRV, mTargetCapacity, targets.data(), sizeof(Target), numTargets))  numTargets = 0;
+	mLaunches.clear();
+	mStats.launched = numLaunches;
+
+	mConstants.frameTime   = mPendingTime;
+	mConstants.numLaunches = numLaunches;
+	mConstants.numTargets  = numTargets;
+	mClock      += mPendingTime;
+	mPendingTime = 0;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	auto context = DX->Context();
+	context->CSSetConstantBuffers(0, 1, &mConstantBuffer);
+
+	if (numLaunches > 0)
+	{
+		context->CSSetShaderResources(0, 1, &mLaunchSRV.p);
+		context->CSSetUnorderedAccessViews(0, 1, &mMissileUAV.p, nullptr);
+		context->CSSetShader(mLaunchShader, nullptr, 0);
+		context->Dispatch((numLaunches + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE, 1, 1);
+	}
+
+	// The matrices may still be bound as the instance vertex buffer from the last Render, they can't be written while they are
+	ID3D11Buffer* nullBuffer = nullptr;
+	UINT zero = 0;
+	context->IASetVertexBuffers(1, 1, &nullBuffer, &zero, &zero);
+
+	// Start the hit count and the draws' instance counts from 0 for the shader to add to
+	const uint32_t zeros[4] = {};
+	D3D11_BOX countBox = { 0, 0, 0, sizeof(zeros), 1, 1 };
+	context->UpdateSubresource(mHitBuffer, 0, &countBox, zeros, 0, 0);
+	context->UpdateSubresource(mArgsBuffer, 0, nullptr, mArgs.data(), 0, 0);
+
+	// Every slot is simulated, dead ones return at once. There is nothing for the GPU to read back to dispatch just the live ones
+	ID3D11ShaderResourceView*  srvs[] = { numTargets > 0 ? mTargetSRV.p : nullptr, mNodeSRV };
+	ID3D11UnorderedAccessView* uavs[] = { mMissileUAV, mHitUAV, mMatrixUAV, mArgsUAV };
+	context->CSSetShaderResources(0, 2, srvs);
+	context->CSSetUnorderedAccessViews(0, 4, uavs, nullptr);
+	context->CSSetShader(mSimulateShader, nullptr, 0);
+	context->Dispatch(MAX_MISSILES / THREAD_GROUP_SIZE, 1, 1);
+
+	ID3D11ShaderResourceView*  nullSrvs[2] = {};
+	ID3D11UnorderedAccessView* nullUavs[4] = {};
+	context->CSSetShaderResources(0, 2, nullSrvs);
+	context->CSSetUnorderedAccessViews(0, 4, nullUavs, nullptr);
+	context->CSSetShader(nullptr, nullptr, 0);
+
+	// Copy the hits for reading back. If the GPU is so far behind that every readback is still in flight, wait for the oldest
+	// rather than lose its hits
+	if (mReadbacksInFlight == NUM_READBACKS)  CollectHits(true);
+	context->CopyResource(mReadbacks[mNextReadback], mHitBuffer);
+	mNextReadback = (mNextReadback + 1) % NUM_READBACKS;
+	++mReadbacksInFlight;
+	CollectHits(false);
+
+	// Missiles that have fallen below the floor are gone, as are those whose hits have arrived
+	std::erase_if(mUsedSlots, [&](uint32_t slot)
+	{
+		if (mSlots[slot].used && mSlots[slot].expiry <= mClock)  FreeSlot(slot);
+		return !mSlots[slot].used;
+	});
+	mStats.inFlight = static_cast<uint32_t>(mUsedSlots.size());
+}
+
+
+// Draw the missiles in flight, as they were left by the last Update
+void GpuMissiles::Render()
+{
+	if (mUsedSlots.empty())  return;
+	mMesh.RenderInstancedIndirect(mMatrixBuffer, mArgsBuffer, 0);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Read each finished readback in the ring, oldest first, into mHits, freeing the missiles' slots
+void GpuMissiles::CollectHits(bool wait)
+{
+	while (mReadbacksInFlight > 0)
+	{
+		ID3D11Buffer* readback = mReadbacks[mOldestReadback];
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		UINT flags = wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT;
+		if (DX->Context()->Map(readback, 0, D3D11_MAP_READ, flags, &mapped) != S_OK)  return; // Still in use by the GPU
+		wait = false;
+
+		// The count may be more than were recorded, the shader counts every hit but stores no more than MAX_HITS
+		uint32_t numHits = std::min(*static_cast<const uint32_t*>(mapped.pData), MAX_HITS);
+		const GpuHit* hits = reinterpret_cast<const GpuHit*>(static_cast<const char*>(mapped.pData) + HITS_OFFSET);
+		for (uint32_t i = 0; i < numHits; ++i)
+		{
+			const GpuHit& hit = hits[i];
+			if (hit.slot >= MAX_MISSILES)  continue;
+			if (mSlots[hit.slot].used && mSlots[hit.slot].serial == hit.serial)  FreeSlot(hit.slot);
+			mHits.push_back({ hit.boat, hit.launchingBoat });
+		}
+		DX->Context()->Unmap(readback, 0);
+		mStats.hits += numHits;
+
+		mOldestReadback = (mOldestReadback + 1) % NUM_READBACKS;
+		--mReadbacksInFlight;
+	}
+}
+
+
+// Mark a slot free for the next launch
+void GpuMissiles::FreeSlot(uint32_t slot)
+{
+	mSlots[slot].used = false;
+	mFreeSlots.push_back(slot);
+}
+
+
+// Make sure a dynamic structured buffer holds the given elements, then copy them in. Returns false on failure
+bool GpuMissiles::UploadStructured(CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11ShaderResourceView>& srv, unsigned int& capacity,
+                                   const void* elements, unsigned int elementSize, unsigned int numElements)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numElements > capacity)
+	{
+		unsigned int newCapacity = (capacity > 0) ? capacity : INITIAL_CAPACITY;
+		while (newCapacity < numElements)  newCapacity *= 2;
+		srv      = nullptr;
+		buffer   = nullptr;
+		capacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = newCapacity * elementSize;
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC; // Rewritten every frame
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = elementSize;
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &buffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = newCapacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(buffer, &srvDesc, &srv)))  { buffer = nullptr;  return false; }
+		capacity = newCapacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, elements, static_cast<size_t>(numElements) * elementSize);
+	DX->Context()->Unmap(buffer, 0);
+	return true;
+}
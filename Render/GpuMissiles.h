@@ -0,0 +1,235 @@
+//--------------------------------------------------------------------------------------
+// GPU missiles - ballistic missiles simulated and hit tested by compute shaders, for battles with thousands of boats
+//--------------------------------------------------------------------------------------
+// A Missile entity costs an Update each step: gravity, FaceDirection, a sweep through the spatial grid, and a slot in the entity
+// manager. With thousands of boats firing, that is most of the CPU's time. Missiles launched here are not entities, their state
+// lives in a GPU buffer of MAX_MISSILES slots. Each frame two compute shaders run:
+//   cs_missiles-launch    one thread per missile launched since the last Update writes it into its slot
+//   cs_missiles-simulate  one thread per slot moves a live missile on under gravity and sweeps it against every boat position
+//                         (a tile of boats at a time in group shared memory). A missile that hits a boat records the hit and
+//                         dies, as does one that has fallen below the sea. The rest write their world matrices for drawing and
+//                         count themselves into the indirect draw arguments of the missile mesh
+// Hits are copied to a staging buffer that is read a frame or more later, when the GPU has finished with it, so the CPU never
+// waits. The scene turns them into Hit messages, so boats take their damage a frame or so later than from a Missile entity.
+//
+// The CPU picks each missile's slot and frees it again without reading the GPU's missiles back: a missile that hits nothing falls
+// below the sea at a time known from its launch (the flight is pure gravity), and one that hits is freed when its hit is read.
+// Missiles are drawn with the instanced shaders of the missile mesh, one DrawIndexedInstancedIndirect per sub-mesh, and are not
+// frustum culled
+//
+//   if (!gpuMissiles.Launch(position, velocity, boatID))  ... create a Missile entity instead ...
+//   gpuMissiles.Advance(stepTime);  // For each simulation step
+//   gpuMissiles.Update(targets);    // Once a frame, with the boats that can be hit
+//   for (auto& hit : gpuMissiles.Hits())  ... deliver a Hit message ...
+//   gpuMissiles.Render();           // In each view, with the opaque pass's states set
+//
+// GPU missiles are not saved in checkpoints or replays, and are only simulated when the scene is rendered
+
+#ifndef _GPU_MISSILES_H_INCLUDED_
+#define _GPU_MISSILES_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+
+
+class GpuMissiles
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the missile shaders and create the missile slots, drawing missiles with the given mesh, which must be one that can be
+	// rendered instanced (see Mesh::CanRenderInstanced). Throws std::runtime_error on failure, e.g. if the device doesn't support
+	// compute shaders
+	GpuMissiles(Mesh& mesh);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Most missiles in flight at once, and most hits recorded in a frame (more are lost, the missiles still die)
+	static constexpr uint32_t MAX_MISSILES = 64 * 1024;
+	static constexpr uint32_t MAX_HITS     = 4096;
+
+	// As for Missile entities: downward acceleration, the distance from a boat's position that counts as a hit, and the height
+	// below which a missile is gone
+	static constexpr float GRAVITY      = 9.81f;
+	static constexpr float HIT_RADIUS   = 15.0f;
+	static constexpr float FLOOR_HEIGHT = -15.0f;
+
+	// A boat that missiles can hit, by entity ID
+	struct Target
+	{
+		Vector3  position;
+		uint32_t id;
+	};
+
+	// A missile that hit a boat, read back from the GPU. Both are entity IDs
+	struct Hit
+	{
+		uint32_t boat;
+		uint32_t launchingBoat;
+	};
+
+	// Launch a missile at the next Update, it can't hit the boat that launched it. Returns false if every slot is in use, the
+	// missile is not launched. Must not be called during Update
+	bool Launch(const Vector3& position, const Vector3& velocity, uint32_t launchingBoat);
+
+	// Move the missile clock on by the time of a simulation step, the missiles move by the time gathered here at the next Update
+	void Advance(float stepTime)  { mPendingTime += stepTime; }
+
+	// Launch the missiles waiting, move every missile on by the time advanced since the last Update and test them against the
+	// given boats, then collect the hits of earlier frames that the GPU has finished with
+	void Update(const std::vector<Target>& targets);
+
+	// The hits collected by the last Update
+	const std::vector<Hit>& Hits()  { return mHits; }
+
+	// Draw the missiles in flight, as they were left by the last Update
+	void Render();
+
+	// Whether missiles should be launched here rather than as entities. The class doesn't check this itself, it is for the code
+	// choosing to use it. Missiles already in flight carry on either way
+	bool& Enabled()  { return mEnabled; }
+
+	// Missiles in flight (as far as the CPU knows, hits not yet read back are still counted), launched and hit in the last Update
+	struct Stats
+	{
+		uint32_t inFlight = 0;
+		uint32_t launched = 0;
+		uint32_t hits     = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A launch and a hit as the shaders read and write them, must match the structures in cs_missiles-launch and cs_missiles-simulate
+	struct GpuLaunch
+	{
+		Vector3  position;
+		uint32_t slot;
+		Vector3  velocity;
+		uint32_t launchingBoat;
+		uint32_t serial;
+		uint32_t padding[3] = {};
+	};
+	struct GpuHit
+	{
+		uint32_t slot;
+		uint32_t serial;
+		uint32_t boat;
+		uint32_t launchingBoat;
+	};
+
+	// What the CPU knows of a slot. The serial tells a hit on the missile now in the slot from a late hit on an earlier one
+	struct Slot
+	{
+		uint32_t serial = 0;
+		float    expiry = 0; // Missile clock time the missile falls below FLOOR_HEIGHT
+		bool     used   = false;
+	};
+
+	// Read each finished readback in the ring, oldest first, into mHits, freeing the missiles' slots. Stops at the first that the
+	// GPU hasn't finished with, unless wait is true when the oldest is read whatever (to make space in the ring)
+	void CollectHits(bool wait);
+
+	// Mark a slot free for the next launch
+	void FreeSlot(uint32_t slot);
+
+	// Make sure a dynamic structured buffer holds the given elements, then copy them in. Returns false on failure
+	bool UploadStructured(CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11ShaderResourceView>& srv, unsigned int& capacity,
+	                      const void* elements, unsigned int elementSize, unsigned int numElements);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Threads in each group of the compute shaders, must match numthreads in the missile compute shaders
+	static constexpr unsigned int THREAD_GROUP_SIZE = 256;
+
+	// The launch and boat buffers start with space for this many elements, then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 256;
+
+	// Hits are read from a ring of this many staging buffers, so the GPU can be this many frames behind before the CPU waits
+	static constexpr unsigned int NUM_READBACKS = 4;
+
+	// The hit buffer holds the number of hits in its first 16 bytes, then the hits
+	static constexpr UINT HITS_OFFSET      = 16;
+	static constexpr UINT HIT_BUFFER_BYTES = HITS_OFFSET + MAX_HITS * sizeof(GpuHit);
+
+	// Missiles live at most this long whatever their launch, in case one is launched upwards at great speed
+	static constexpr float MAX_LIFETIME = 60.0f;
+
+	bool  mEnabled = false;
+	Stats mStats;
+
+	ID3D11ComputeShader* mLaunchShader   = nullptr; // Owned by the shader manager
+	ID3D11ComputeShader* mSimulateShader = nullptr;
+	ID3D11Buffer*        mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	MissileConstants     mConstants;
+
+	Mesh& mMesh;
+
+	// The missile slots
+	CComPtr<ID3D11Buffer>              mMissileBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mMissileUAV;
+
+	// The hits recorded by the last simulation, and the copies being read back
+	CComPtr<ID3D11Buffer>              mHitBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mHitUAV;
+	CComPtr<ID3D11Buffer> mReadbacks[NUM_READBACKS]; // Staging copies of the hit buffer
+	unsigned int          mOldestReadback    = 0;
+	unsigned int          mNextReadback      = 0;
+	unsigned int          mReadbacksInFlight = 0;
+
+	// World matrices of the missiles drawn, as the per-instance vertex buffer of the mesh, and their indirect draw arguments. The
+	// arguments are rewritten with instance counts of 0 before each simulation for the shader to count into
+	CComPtr<ID3D11Buffer>              mMatrixBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mMatrixUAV;
+	CComPtr<ID3D11Buffer>              mArgsBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mArgsUAV;
+	std::vector<D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS> mArgs;
+
+	// The matrices of the mesh's drawn nodes relative to its root, read as rows (float4) by the simulation
+	CComPtr<ID3D11Buffer>             mNodeBuffer;
+	CComPtr<ID3D11ShaderResourceView> mNodeSRV;
+
+	// Launches since the last Update and the boats of the last Update, with the buffers they are copied to
+	std::vector<GpuLaunch>            mLaunches;
+	CComPtr<ID3D11Buffer>             mLaunchBuffer;
+	CComPtr<ID3D11ShaderResourceView> mLaunchSRV;
+	unsigned int                      mLaunchCapacity = 0;
+	CComPtr<ID3D11Buffer>             mTargetBuffer;
+	CComPtr<ID3D11ShaderResourceView> mTargetSRV;
+	unsigned int                      mTargetCapacity = 0;
+
+	// The slots, those free, and those in use in launch order
+	std::vector<Slot>     mSlots;
+	std::vector<uint32_t> mFreeSlots;
+	std::vector<uint32_t> mUsedSlots;
+	uint32_t              mNextSerial = 1;
+
+	// Missile clock, advanced by the simulation steps, and the time advanced since the last Update
+	float mClock       = 0;
+	float mPendingTime = 0;
+
+	std::vector<Hit> mHits;
+};
+
+
+#endif //_GPU_MISSILES_H_INCLUDED_
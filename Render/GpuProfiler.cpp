@@ -0,0 +1,224 @@
+//--------------------------------------------------------------------------------------
+// GPU profiler timing named scopes of each frame with timestamp queries
+//--------------------------------------------------------------------------------------
+
+#include "GpuProfiler.h"
+#include "RenderCounters.h"
+
+#include <stdexcept>
+#include <utility>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the frame queries. Throws std::runtime_error on failure
+GpuProfiler::GpuProfiler(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+	mDXDevice  = device;
+	mDXContext = context;
+	mFrameScope.name = "Frame";
+
+	D3D11_QUERY_DESC disjointDesc  = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+	D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+	for (auto& frame : mFrames)
+	{
+		if (FAILED(mDXDevice->CreateQuery(&disjointDesc,  &frame.disjoint)) ||
+		    FAILED(mDXDevice->CreateQuery(&timestampDesc, &frame.start))    ||
+		    FAILED(mDXDevice->CreateQuery(&timestampDesc, &frame.end)))
+		{
+			throw std::runtime_error("GPU profiler: failure creating queries");
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start a frame, collecting the results of earlier frames that are ready
+void GpuProfiler::BeginFrame()
+{
+	CollectResults();
+
+	// Skip this frame if profiling is off or every frame in the ring is still waiting for the GPU
+	mFrameActive = mEnabled && mFramesInFlight < RING_SIZE;
+	mOpenTimings.clear();
+	if (!mFrameActive)  return;
+
+	Frame& frame = mFrames[mNextFrame];
+	frame.numTimings = 0;
+	mDXContext->Begin(frame.disjoint);
+	mDXContext->End(frame.start); // Timestamps only have an End
+	frame.hasStatistics = BeginStatistics(frame.statistics);
+}
+
+
+// Finish a frame. Any scopes left open are ignored
+void GpuProfiler::EndFrame()
+{
+	if (!mFrameActive)  return;
+	mFrameActive = false;
+
+	Frame& frame = mFrames[mNextFrame];
+	for (unsigned int timing : mOpenTimings)
+	{
+		mDXContext->End(frame.timings[timing].end);
+		if (frame.timings[timing].hasStatistics)  mDXContext->End(frame.timings[timing].statistics);
+	}
+	mOpenTimings.clear();
+	if (frame.hasStatistics)  mDXContext->End(frame.statistics);
+	mDXContext->End(frame.end);
+	mDXContext->End(frame.disjoint);
+
+	mNextFrame = (mNextFrame + 1) % RING_SIZE;
+	++mFramesInFlight;
+}
+
+
+// Start timing a scope of GPU work within the frame
+void GpuProfiler::BeginScope(const std::string& name)
+{
+	gRenderCounters.BeginPass(name); // Scopes are also the passes render counters are split into, timed or not
+
+	if (!mFrameActive)  return;
+
+	// Scopes are few, a linear search by name is quicker than a map
+	unsigned int scope = 0;
+	while (scope < mScopes.size() && mScopes[scope].name != name)  ++scope;
+	if (scope == mScopes.size())  mScopes.push_back({ name });
+
+	// Reuse the frame's queries, creating more the first time a frame has this many scopes
+	Frame& frame = mFrames[mNextFrame];
+	if (frame.numTimings == frame.timings.size())
+	{
+		Timing timing;
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		if (FAILED(mDXDevice->CreateQuery(&timestampDesc, &timing.start)) ||
+		    FAILED(mDXDevice->CreateQuery(&timestampDesc, &timing.end)))  return; // Just not timed
+		frame.timings.push_back(std::move(timing));
+	}
+
+	Timing& timing = frame.timings[frame.numTimings];
+	timing.scope = scope;
+	mDXContext->End(timing.start);
+	timing.hasStatistics = BeginStatistics(timing.statistics);
+	mOpenTimings.push_back(frame.numTimings);
+	++frame.numTimings;
+}
+
+
+// Finish timing the innermost open scope
+void GpuProfiler::EndScope()
+{
+	gRenderCounters.EndPass();
+
+	if (!mFrameActive || mOpenTimings.empty())  return;
+
+	Timing& timing = mFrames[mNextFrame].timings[mOpenTimings.back()];
+	mDXContext->End(timing.end);
+	if (timing.hasStatistics)  mDXContext->End(timing.statistics);
+	mOpenTimings.pop_back();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Read each finished frame in the ring, oldest first, stopping at the first that the GPU hasn't finished
+void GpuProfiler::CollectResults()
+{
+	while (mFramesInFlight > 0)
+	{
+		// Don't flush the command buffer to get the results sooner, they arrive in a frame or two anyway. The disjoint query
+		// ends after every timestamp in the frame, so once it is ready they all are
+		Frame& frame = mFrames[mOldestFrame];
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (mDXContext->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  return; // Still in use by the GPU
+		mOldestFrame = (mOldestFrame + 1) % RING_SIZE;
+		--mFramesInFlight;
+
+		// The timestamps are meaningless if the GPU clock changed during the frame (e.g. power saving), skip the frame then
+		if (disjoint.Disjoint || disjoint.Frequency == 0)  continue;
+		double toMilliseconds = 1000.0 / static_cast<double>(disjoint.Frequency);
+
+		UINT64 start, end;
+		if (mDXContext->GetData(frame.start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		    mDXContext->GetData(frame.end,   &end,   sizeof(end),   D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  continue;
+		RecordTime(mFrameScope, static_cast<float>((end - start) * toMilliseconds));
+
+		// The statistics queries end before the disjoint query too. Scopes keep their last statistics if they had none this frame
+		D3D11_QUERY_DATA_PIPELINE_STATISTICS statistics;
+		if (frame.hasStatistics &&
+		    mDXContext->GetData(frame.statistics, &statistics, sizeof(statistics), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+		{
+			mFrameScope.statistics = statistics;
+		}
+
+		// Scopes not used in this frame record 0
+		mFrameTotals.assign(mScopes.size(), 0.0f);
+		mFrameStatistics.assign(mScopes.size(), {});
+		mHasStatistics.assign(mScopes.size(), false);
+		for (unsigned int i = 0; i < frame.numTimings; ++i)
+		{
+			Timing& timing = frame.timings[i];
+			if (timing.hasStatistics &&
+			    mDXContext->GetData(timing.statistics, &statistics, sizeof(statistics), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+			{
+				AddStatistics(mFrameStatistics[timing.scope], statistics);
+				mHasStatistics[timing.scope] = true;
+			}
+			if (mDXContext->GetData(timing.start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			    mDXContext->GetData(timing.end,   &end,   sizeof(end),   D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  continue;
+			mFrameTotals[timing.scope] += static_cast<float>((end - start) * toMilliseconds);
+		}
+		for (unsigned int scope = 0; scope < mScopes.size(); ++scope)
+		{
+			RecordTime(mScopes[scope], mFrameTotals[scope]);
+			if (mHasStatistics[scope])  mScopes[scope].statistics = mFrameStatistics[scope];
+		}
+	}
+}
+
+
+// Add a time to the history of a scope
+void GpuProfiler::RecordTime(Scope& scope, float milliseconds)
+{
+	scope.milliseconds = milliseconds;
+	scope.history[scope.historyStart] = milliseconds;
+	scope.historyStart = (scope.historyStart + 1) % HISTORY_SIZE;
+}
+
+
+// Start a timing's or frame's statistics query if pipeline statistics are enabled, creating it the first time
+bool GpuProfiler::BeginStatistics(CComPtr<ID3D11Query>& query)
+{
+	if (!mPipelineStatistics)  return false;
+	if (query == nullptr)
+	{
+		D3D11_QUERY_DESC statisticsDesc = { D3D11_QUERY_PIPELINE_STATISTICS, 0 };
+		if (FAILED(mDXDevice->CreateQuery(&statisticsDesc, &query)))  return false; // Just no statistics
+	}
+	mDXContext->Begin(query);
+	return true;
+}
+
+
+// Add pipeline statistics to a total
+void GpuProfiler::AddStatistics(D3D11_QUERY_DATA_PIPELINE_STATISTICS& total, const D3D11_QUERY_DATA_PIPELINE_STATISTICS& add)
+{
+	total.IAVertices    += add.IAVertices;
+	total.IAPrimitives  += add.IAPrimitives;
+	total.VSInvocations += add.VSInvocations;
+	total.GSInvocations += add.GSInvocations;
+	total.GSPrimitives  += add.GSPrimitives;
+	total.CInvocations  += add.CInvocations;
+	total.CPrimitives   += add.CPrimitives;
+	total.PSInvocations += add.PSInvocations;
+	total.HSInvocations += add.HSInvocations;
+	total.DSInvocations += add.DSInvocations;
+	total.CSInvocations += add.CSInvocations;
+}
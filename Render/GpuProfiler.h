@@ -0,0 +1,153 @@
+//--------------------------------------------------------------------------------------
+// GPU profiler timing named scopes of each frame with timestamp queries
+//--------------------------------------------------------------------------------------
+// Rendering code marks the work to time with BeginScope / EndScope. Each scope places a timestamp query at its start and end,
+// and each frame is enclosed in a disjoint query that gives the timestamp frequency (and reports if the GPU clock changed,
+// when the frame's times are thrown away). DXDevice::PresentFrame ends one frame and begins the next.
+//
+// The queries of each frame are read back a few frames later from a ring, without waiting for the GPU, so profiling never
+// stalls the pipeline. If the GPU falls so far behind that every frame in the ring is still waiting, frames are skipped. Each
+// scope keeps a history of its time in the most recent frames for the control panel's graphs. Scopes may be nested, and a scope
+// used more than once in a frame reports the total. Scopes also mark the passes that render counters are split into, see
+// RenderCounters.h
+//
+// Optionally each scope (and the frame) also has a pipeline statistics query, counting the vertices and primitives that went
+// into the pipeline, the vertex and pixel shader invocations and the primitives in and out of the clipper. They show where the
+// GPU does work that doesn't reach the screen: many more pixel shader invocations than pixels is overdraw, and far fewer
+// primitives out of the clipper than in means triangles culled or off screen that were still transformed
+//
+//   DX->Profiler()->BeginScope("Solid");
+//   ... rendering to time ...
+//   DX->Profiler()->EndScope();
+
+#ifndef _GPU_PROFILER_H_INCLUDED_
+#define _GPU_PROFILER_H_INCLUDED_
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <array>
+#include <string>
+#include <vector>
+
+
+class GpuProfiler
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the frame queries. Throws std::runtime_error on failure
+	GpuProfiler(ID3D11Device* device, ID3D11DeviceContext* context);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Number of frames of history kept for each scope
+	static constexpr int HISTORY_SIZE = 120;
+
+	// The results of a scope. The history is a ring of millisecond times, oldest at historyStart. The pipeline statistics are
+	// from the most recent frame collected with them, all zero if they have never been collected
+	struct Scope
+	{
+		std::string name;
+		float milliseconds = 0; // From the most recent frame collected
+		std::array<float, HISTORY_SIZE> history = {};
+		int historyStart = 0;
+		D3D11_QUERY_DATA_PIPELINE_STATISTICS statistics = {};
+	};
+
+	// Start and finish a frame, called by DXDevice. Starting a frame collects the results of any earlier frames that are ready
+	void BeginFrame();
+	void EndFrame();
+
+	// Start timing a scope of GPU work within the frame, on the immediate context. The name is kept by the profiler, so pass the
+	// same string for the same scope each frame. Every BeginScope must be matched by an EndScope in the same frame
+	void BeginScope(const std::string& name);
+	void EndScope();
+
+	// Enable or disable profiling. When disabled no queries are issued and the results stop changing
+	bool& Enabled()  { return mEnabled; }
+
+	// Enable or disable the pipeline statistics of each scope (see top of file), off by default as the queries cost a little
+	bool& PipelineStatistics()  { return mPipelineStatistics; }
+
+	// The scopes seen so far, in the order they were first used, and the time of the whole frame
+	const std::vector<Scope>& Scopes()     { return mScopes; }
+	const Scope&              FrameTime()  { return mFrameScope; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Read each finished frame in the ring, oldest first, stopping at the first that the GPU hasn't finished
+	void CollectResults();
+
+	// Add a time to the history of a scope
+	void RecordTime(Scope& scope, float milliseconds);
+
+	// Add pipeline statistics to a total
+	static void AddStatistics(D3D11_QUERY_DATA_PIPELINE_STATISTICS& total, const D3D11_QUERY_DATA_PIPELINE_STATISTICS& add);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Number of frames that can be waiting for the GPU
+	static constexpr int RING_SIZE = 5;
+
+	ID3D11Device*        mDXDevice;
+	ID3D11DeviceContext* mDXContext;
+
+	// A timed scope in a frame, the queries are reused each time the frame's place in the ring comes round. The statistics
+	// query is only created when pipeline statistics are first enabled
+	struct Timing
+	{
+		unsigned int scope = 0; // Index into mScopes
+		CComPtr<ID3D11Query> start;
+		CComPtr<ID3D11Query> end;
+		CComPtr<ID3D11Query> statistics;
+		bool hasStatistics = false; // The statistics query was used for this timing in this frame
+	};
+
+	// The queries of one frame. Only the first numTimings timings are in use
+	struct Frame
+	{
+		CComPtr<ID3D11Query> disjoint;
+		CComPtr<ID3D11Query> start;
+		CComPtr<ID3D11Query> end;
+		CComPtr<ID3D11Query> statistics;
+		bool hasStatistics = false;
+		std::vector<Timing> timings;
+		unsigned int numTimings = 0;
+	};
+
+	// Start a timing's or frame's statistics query if pipeline statistics are enabled, creating it the first time. Returns
+	// whether it was started
+	bool BeginStatistics(CComPtr<ID3D11Query>& query);
+
+	// Frames are started at mNextFrame and collected from mOldestFrame, the number waiting is mFramesInFlight
+	Frame mFrames[RING_SIZE];
+	int  mNextFrame = 0;
+	int  mOldestFrame = 0;
+	int  mFramesInFlight = 0;
+	bool mFrameActive = false;       // Between a BeginFrame that started a frame and its EndFrame
+	std::vector<unsigned int> mOpenTimings; // Timings of the current frame started but not yet ended, innermost last
+
+	bool mEnabled = true;
+	bool mPipelineStatistics = false;
+
+	std::vector<Scope> mScopes;
+	Scope mFrameScope;
+	std::vector<float> mFrameTotals; // Working space for CollectResults, the total time of each scope...
+	std::vector<D3D11_QUERY_DATA_PIPELINE_STATISTICS> mFrameStatistics; // ...and statistics
+	std::vector<bool> mHasStatistics; // Whether each scope had statistics in the frame
+};
+
+
+#endif //_GPU_PROFILER_H_INCLUDED_
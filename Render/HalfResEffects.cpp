@@ -0,0 +1,184 @@
+//--------------------------------------------------------------------------------------
+// Half resolution effects - the additive pass drawn into a half size target and composited over the scene
+//--------------------------------------------------------------------------------------
+
+#include "HalfResEffects.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "CBuffer.h"
+#include "RenderCounters.h"
+
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the downsample and composite shaders and create their constant buffer. Throws std::runtime_error on failure
+HalfResEffects::HalfResEffects()
+{
+	mVertexShader     = DX->Shaders()->LoadVertexShader("vs_fullscreen_uv");
+	mDownsampleShader = DX->Shaders()->LoadPixelShader ("ps_depth-downsample");
+	mCompositeShader  = DX->Shaders()->LoadPixelShader ("ps_half-res-composite");
+	if (mVertexShader == nullptr || mDownsampleShader == nullptr || mCompositeShader == nullptr)
+		throw std::runtime_error("Half resolution effects: " + DX->Shaders()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(HalfResConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Half resolution effects: failure creating constant buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Downsample the depth buffer and set the half size targets and viewport
+bool HalfResEffects::Begin(const Matrix4x4& projectionMatrix)
+{
+	if (!CreateTargets())  return false;
+	auto context = DX->Context();
+
+	// Keep what is set now to put it back in End
+	mPreviousTarget = nullptr;
+	mPreviousDepth  = nullptr;
+	context->OMGetRenderTargets(1, &mPreviousTarget, &mPreviousDepth);
+	UINT numViewports = 1;
+	context->RSGetViewports(&numViewports, &mPreviousViewport);
+	mPreviousRasterizerState = DX->States()->GetRasterizerState();
+	mPreviousDepthState      = DX->States()->GetDepthState();
+	mPreviousBlendState      = DX->States()->GetBlendState();
+
+	// View distance from depth is z = e32 / (depth - e22), see Camera::UpdateMatrices
+	mConstants.sceneWidth     = DX->GetSceneWidth();
+	mConstants.sceneHeight    = DX->GetSceneHeight();
+	mConstants.halfWidth      = (mConstants.sceneWidth  + 1) / 2;
+	mConstants.halfHeight     = (mConstants.sceneHeight + 1) / 2;
+	mConstants.depthScale     = projectionMatrix.e32;
+	mConstants.depthOffset    = projectionMatrix.e22;
+	mConstants.depthTolerance = DEPTH_TOLERANCE;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(mConstants.halfWidth), static_cast<float>(mConstants.halfHeight), 0.0f, 1.0f };
+	context->RSSetViewports(1, &viewport);
+
+	// The nearest of each 2x2 depths, written through the depth test as SV_Depth. Only the depth buffer is bound, the full size
+	// one can then be read. Texels of the sky stay at the cleared 1
+	const float black[4] = { 0, 0, 0, 0 };
+	context->ClearRenderTargetView(mColourTarget, black);
+	context->ClearDepthStencilView(mDepthTarget, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	context->OMSetRenderTargets(0, nullptr, mDepthTarget);
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOn);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+	ID3D11ShaderResourceView* depth = DX->DepthShaderView();
+	DrawFullscreen(mDownsampleShader, &depth, 1);
+
+	// The effects are drawn with the states set for them before Begin
+	context->OMSetRenderTargets(1, &mColourTarget.p, mDepthTarget);
+	DX->States()->SetRasterizerState(mPreviousRasterizerState);
+	DX->States()->SetDepthState(mPreviousDepthState);
+	DX->States()->SetBlendState(mPreviousBlendState);
+	return true;
+}
+
+
+// Add the effects drawn since Begin to the scene target, then put back the targets, viewport and states
+void HalfResEffects::End()
+{
+	auto context = DX->Context();
+
+	// The full size depth buffer is read to choose between the half size texels, so it isn't bound for rendering
+	context->OMSetRenderTargets(1, &mPreviousTarget.p, nullptr);
+	context->RSSetViewports(1, &mPreviousViewport);
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOff);
+	DX->States()->SetBlendState(BlendState::BlendAdditive);
+	ID3D11ShaderResourceView* textures[] = { mColourView, mDepthView, DX->DepthShaderView() };
+	DrawFullscreen(mCompositeShader, textures, 3);
+
+	context->OMSetRenderTargets(1, &mPreviousTarget.p, mPreviousDepth);
+	DX->States()->SetRasterizerState(mPreviousRasterizerState);
+	DX->States()->SetDepthState(mPreviousDepthState);
+	DX->States()->SetBlendState(mPreviousBlendState);
+	mPreviousTarget = nullptr;
+	mPreviousDepth  = nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure the targets are half the size of the back buffer (rounded up), recreating them if it has changed size
+bool HalfResEffects::CreateTargets()
+{
+	unsigned int width  = (DX->GetBackbufferWidth()  + 1) / 2;
+	unsigned int height = (DX->GetBackbufferHeight() + 1) / 2;
+	if (width == mWidth && height == mHeight && mColourTarget != nullptr)  return true;
+
+	mWidth = mHeight = 0;
+	mColourTarget = nullptr;
+	mColourView   = nullptr;
+	mDepthTarget  = nullptr;
+	mDepthView    = nullptr;
+	auto device = DX->Device();
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = width;
+	textureDesc.Height           = height;
+	textureDesc.MipLevels        = 1;
+	textureDesc.ArraySize        = 1;
+	textureDesc.Format           = COLOUR_FORMAT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	CComPtr<ID3D11Texture2D> colourTexture;
+	if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &colourTexture)) ||
+	    FAILED(device->CreateRenderTargetView(colourTexture, nullptr, &mColourTarget)) ||
+	    FAILED(device->CreateShaderResourceView(colourTexture, nullptr, &mColourView)))  return false;
+
+	textureDesc.Format    = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	CComPtr<ID3D11Texture2D> depthTexture;
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthDesc = {};
+	depthDesc.Format        = DXGI_FORMAT_D32_FLOAT;
+	depthDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format              = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &depthTexture)) ||
+	    FAILED(device->CreateDepthStencilView(depthTexture, &depthDesc, &mDepthTarget)) ||
+	    FAILED(device->CreateShaderResourceView(depthTexture, &srvDesc, &mDepthView)))
+	{
+		mColourTarget = nullptr;
+		return false;
+	}
+
+	mWidth  = width;
+	mHeight = height;
+	return true;
+}
+
+
+// Draw a triangle covering the viewport with the given pixel shader, reading the given textures from slot 0 on
+void HalfResEffects::DrawFullscreen(ID3D11PixelShader* pixelShader, ID3D11ShaderResourceView* const* textures, unsigned int numTextures)
+{
+	auto context = DX->Context();
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->PSSetShader(pixelShader, nullptr, 0);
+	context->PSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->PSSetShaderResources(0, numTextures, textures);
+	context->Draw(3, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	// Unbind the textures so they can be render targets again
+	ID3D11ShaderResourceView* nullViews[3] = {};
+	context->PSSetShaderResources(0, numTextures, nullViews);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
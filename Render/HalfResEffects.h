@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// Half resolution effects - the additive pass drawn into a half size target and composited over the scene
+//--------------------------------------------------------------------------------------
+// The additive entities (light meshes, shields) and particles are cheap to shade but can cover much of the screen, e.g. the
+// shield of the boat a chase camera follows, so their cost is mostly fill rate. When enabled they are drawn into a target half
+// the width and height of the scene instead, a quarter of the pixels:
+//  - Begin downsamples the scene's depth buffer into a half size depth buffer, each texel taking the nearest of the 2x2 depths
+//    it covers, so the effects are still hidden behind the solid entities but never drawn over the edge of a nearer one. The
+//    half size colour target is cleared to black, and both are set as the render targets with a half size viewport
+//  - the additive pass then draws as usual, blending into the black target
+//  - End adds the target to the scene with a depth-aware upsample (ps_half-res-composite). Where the four half size texels around
+//    a pixel have depths close to the pixel's own the effect is filtered bilinearly between them. At an edge between near and
+//    far surfaces it takes the texel whose depth is nearest the pixel's, so effects behind a boat don't bleed over its outline
+//
+// The depths are compared in view space distances, found from the camera's projection matrix. Needs the depth buffer's shader
+// resource view (see DXDevice::DepthShaderView), so the full size depth buffer is unbound while downsampling and compositing
+//
+//   if (halfRes.Enabled() && halfRes.Begin(camera->GetProjectionMatrix()))  { ... draw the additive pass ...  halfRes.End(); }
+//
+// Begin saves the render targets, viewport and render states, End puts them back. For the main view only, picture-in-picture views
+// draw their small viewports at full resolution
+
+#ifndef _HALF_RES_EFFECTS_H_INCLUDED_
+#define _HALF_RES_EFFECTS_H_INCLUDED_
+
+#include "Matrix4x4.h"
+#include "CBufferTypes.h"
+#include "State.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+
+class HalfResEffects
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Half size texels whose view distance differs from a pixel's by less than this fraction of it are filtered together
+	static constexpr float DEPTH_TOLERANCE = 0.05f;
+
+	// Format of the half size target, with the range and precision to add many effects together before compositing
+	static constexpr DXGI_FORMAT COLOUR_FORMAT = DXGI_FORMAT_R16G16B16A16_FLOAT;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the downsample and composite shaders and create their constant buffer. The targets are created on first use.
+	// Throws std::runtime_error on failure
+	HalfResEffects();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Downsample the depth buffer and set the half size targets and viewport, for a camera with the given projection matrix.
+	// Returns false, changing nothing, if the targets can't be created, then draw the effects at full resolution
+	bool Begin(const Matrix4x4& projectionMatrix);
+
+	// Add the effects drawn since Begin to the scene target, then put back the targets, viewport and states Begin found
+	void End();
+
+	// Enable or disable half resolution effects. The class doesn't check this itself, it is for the code choosing to use it
+	bool& Enabled()  { return mEnabled; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Make sure the targets are half the size of the back buffer (rounded up), recreating them if it has changed size. Returns
+	// false on failure
+	bool CreateTargets();
+
+	// Draw a triangle covering the viewport with the given pixel shader, reading the given textures from slot 0 on
+	void DrawFullscreen(ID3D11PixelShader* pixelShader, ID3D11ShaderResourceView* const* textures, unsigned int numTextures);
+
+	bool mEnabled = false;
+
+	ID3D11VertexShader* mVertexShader     = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mDownsampleShader = nullptr;
+	ID3D11PixelShader*  mCompositeShader  = nullptr;
+	ID3D11Buffer*       mConstantBuffer   = nullptr; // Owned by the constant buffer manager
+	HalfResConstants    mConstants;
+
+	// Half size colour target and depth buffer, the depth texture is typeless so it can be viewed both ways
+	unsigned int                      mWidth  = 0;
+	unsigned int                      mHeight = 0;
+	CComPtr<ID3D11RenderTargetView>   mColourTarget;
+	CComPtr<ID3D11ShaderResourceView> mColourView;
+	CComPtr<ID3D11DepthStencilView>   mDepthTarget;
+	CComPtr<ID3D11ShaderResourceView> mDepthView;
+
+	// What Begin found, put back by End
+	CComPtr<ID3D11RenderTargetView> mPreviousTarget;
+	CComPtr<ID3D11DepthStencilView> mPreviousDepth;
+	D3D11_VIEWPORT  mPreviousViewport = {};
+	RasterizerState mPreviousRasterizerState = RasterizerState::CullBack;
+	DepthState      mPreviousDepthState      = DepthState::DepthOn;
+	BlendState      mPreviousBlendState      = BlendState::BlendNone;
+};
+
+
+#endif //_HALF_RES_EFFECTS_H_INCLUDED_
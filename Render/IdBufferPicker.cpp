@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// Picking by rendering entity IDs into a GPU buffer
+//--------------------------------------------------------------------------------------
+
+#include "IdBufferPicker.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "State.h"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the shaders and create the staging textures. Throws std::runtime_error on failure
+IdBufferPicker::IdBufferPicker()
+{
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_p_p2c");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_entity-id");
+	if (mVertexShader == nullptr || mPixelShader == nullptr)  throw std::runtime_error("ID buffer picking: " + DX->Shaders()->GetLastError());
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width  = REGION_SIZE;
+	textureDesc.Height = REGION_SIZE;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = DXGI_FORMAT_R32_UINT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_STAGING;
+	textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	for (auto& copy : mCopies)
+	{
+		if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &copy.staging)))
+			throw std::runtime_error("ID buffer picking: failure creating staging texture");
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start rendering IDs into the given ID buffer, with the cursor at the given pixel
+void IdBufferPicker::BeginPass(ID3D11Texture2D* idTexture, ID3D11RenderTargetView* idRenderTarget, int cursorX, int cursorY)
+{
+	D3D11_TEXTURE2D_DESC textureDesc;
+	idTexture->GetDesc(&textureDesc);
+	mIdTexture      = idTexture;
+	mIdRenderTarget = idRenderTarget;
+	mIdWidth  = textureDesc.Width;
+	mIdHeight = textureDesc.Height;
+	mCursorX = cursorX;
+	mCursorY = cursorY;
+
+	// Keep the depth buffer from the main pass so only the nearest surfaces write their IDs
+	DX->Context()->OMSetRenderTargets(1, &mIdRenderTarget, DX->DepthBuffer());
+
+	DX->States()->SetRasterizerState(RasterizerState::CullBack);
+	DX->States()->SetDepthState(DepthState::DepthReadOnlyLessEqual);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+
+	DX->Context()->VSSetShader(mVertexShader, nullptr, 0);
+	DX->Context()->PSSetShader(mPixelShader, nullptr, 0);
+}
+
+
+// Finish rendering IDs, restore the scene target and start reading back the area around the cursor
+void IdBufferPicker::EndPass()
+{
+	DX->Context()->OMSetRenderTargets(1, &DX->SceneTarget(), DX->DepthBuffer());
+	RenderState::Reset(); // Shaders were changed outside of RenderState
+
+	// Start a copy of the area around the cursor, unless every staging texture is still waiting for the GPU
+	if (mCopiesInFlight < RING_SIZE)
+	{
+		Copy& copy = mCopies[mNextCopy];
+		copy.empty = mCursorX < 0 || mCursorY < 0 || mCursorX >= static_cast<int>(mIdWidth) || mCursorY >= static_cast<int>(mIdHeight);
+		if (!copy.empty)
+		{
+			D3D11_BOX area;
+			area.left   = std::max(mCursorX - REGION_SIZE / 2, 0);
+			area.top    = std::max(mCursorY - REGION_SIZE / 2, 0);
+			area.right  = std::min(mCursorX + REGION_SIZE / 2 + 1, static_cast<int>(mIdWidth));
+			area.bottom = std::min(mCursorY + REGION_SIZE / 2 + 1, static_cast<int>(mIdHeight));
+			area.front  = 0;
+			area.back   = 1;
+			DX->Context()->CopySubresourceRegion(copy.staging, 0, 0, 0, 0, mIdTexture, 0, &area);
+
+			copy.width   = area.right - area.left;
+			copy.height  = area.bottom - area.top;
+			copy.cursorX = mCursorX - area.left;
+			copy.cursorY = mCursorY - area.top;
+		}
+		mNextCopy = (mNextCopy + 1) % RING_SIZE;
+		++mCopiesInFlight;
+	}
+
+	CollectResults();
+}
+
+
+// Read each finished copy in the ring, oldest first, stopping at the first that the GPU hasn't finished
+void IdBufferPicker::CollectResults()
+{
+	while (mCopiesInFlight > 0)
+	{
+		Copy& copy = mCopies[mOldestCopy];
+		if (copy.empty)
+		{
+			mPickedId = 0;
+		}
+		else
+		{
+			D3D11_MAPPED_SUBRESOURCE mapped;
+			if (DX->Context()->Map(copy.staging, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped) != S_OK)  return; // Still in use by the GPU
+
+			// Use the ID under the cursor, or if there is none the nearest ID in the area
+			mPickedId = 0;
+			int nearestDistanceSquared = INT_MAX;
+			for (int y = 0; y < copy.height; ++y)
+			{
+				const uint32_t* row = reinterpret_cast<const uint32_t*>(static_cast<const char*>(mapped.pData) + y * mapped.RowPitch);
+				for (int x = 0; x < copy.width; ++x)
+				{
+					if (row[x] == 0)  continue;
+					int distanceSquared = (x - copy.cursorX) * (x - copy.cursorX) + (y - copy.cursorY) * (y - copy.cursorY);
+					if (distanceSquared < nearestDistanceSquared)
+					{
+						mPickedId = row[x];
+						nearestDistanceSquared = distanceSquared;
+					}
+				}
+			}
+			DX->Context()->Unmap(copy.staging, 0);
+		}
+
+		mOldestCopy = (mOldestCopy + 1) % RING_SIZE;
+		--mCopiesInFlight;
+	}
+}
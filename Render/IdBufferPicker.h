@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// Picking by rendering entity IDs into a GPU buffer
+//--------------------------------------------------------------------------------------
+// After the solid entities have been rendered, the pickable entities are drawn again into an R32_UINT render target, each
+// writing its own ID rather than a colour. The main pass's depth buffer is kept with a less-or-equal read-only test, so only
+// the front-most surface under each pixel is written and anything hidden behind other geometry can't be picked. Selection is
+// then exact to the pixel, whatever the number of entities, and the CPU does no per-entity picking work.
+//
+// Only a small square of the buffer around the cursor is needed. It is copied into one of a ring of small staging textures
+// and read back a few frames later when the GPU has finished with it, without waiting, so there is never a pipeline stall.
+// The picked ID therefore lags the cursor by a couple of frames.
+//
+// The ID buffer is an R32_UINT texture the size of the back buffer, transient in the frame's render graph (see RenderGraph.h),
+// which clears it to 0 (no ID) before the pass and only creates it on frames that pick.
+//
+//   idPicker.BeginPass(idTexture, idTarget, mouseX, mouseY);  // Render target is now the ID buffer
+//   for (each pickable entity)  entity->RenderGeometry(IdBufferPicker::IdColour(entity->GetID()));
+//   idPicker.EndPass();                  // Render target is the scene target again
+//   EntityID underCursor = idPicker.GetPickedId();
+
+#ifndef _ID_BUFFER_PICKER_H_INCLUDED_
+#define _ID_BUFFER_PICKER_H_INCLUDED_
+
+#include "ColourTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <bit>
+#include <stdint.h>
+
+
+class IdBufferPicker
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the shaders and create the staging textures. Throws std::runtime_error on failure
+	IdBufferPicker();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start rendering IDs into the given ID buffer, cleared to 0, with the cursor at the given pixel of the scene. Call after the
+	// solid entities have been rendered to the scene target and depth buffer. Sets the ID buffer as the render target, keeping the
+	// depth buffer, and sets the ID shaders and states
+	void BeginPass(ID3D11Texture2D* idTexture, ID3D11RenderTargetView* idRenderTarget, int cursorX, int cursorY);
+
+	// Finish rendering IDs. Restores the scene target (see DXDevice::SceneTarget) and depth buffer as the render targets, starts
+	// copying the area around the cursor back to the CPU and collects any earlier copy that has arrived
+	void EndPass();
+
+	// The colour to pass to Mesh::RenderGeometry / Entity::RenderGeometry to render the given ID. The ID is held in the bits of
+	// the red channel (see ps_entity-id.hlsl), so these are not real colour values
+	static ColourRGBA IdColour(uint32_t id)  { return { std::bit_cast<float>(id), 0, 0, 0 }; }
+
+	// The ID under the cursor from the most recent result that has arrived, or 0 (NO_ID) if there was nothing under the cursor.
+	// If the pixel exactly under the cursor is empty the nearest ID within a few pixels is used, to make small entities easier to pick
+	uint32_t GetPickedId()  { return mPickedId; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Read each finished copy in the ring, oldest first, stopping at the first that the GPU hasn't finished
+	void CollectResults();
+
+	// Size of the square copied around the cursor. Odd so the cursor is in the centre
+	static constexpr int REGION_SIZE = 15;
+
+	// Number of staging textures. Copies are skipped if all of them are still waiting for the GPU
+	static constexpr int RING_SIZE = 4;
+
+	// ID buffer of the current pass, owned by the render graph
+	ID3D11Texture2D*        mIdTexture      = nullptr;
+	ID3D11RenderTargetView* mIdRenderTarget = nullptr;
+	unsigned int mIdWidth  = 0;
+	unsigned int mIdHeight = 0;
+
+	// Ring of staging textures for reading back the area around the cursor. Copies are started at mNextCopy and collected from
+	// mOldestCopy, the number waiting is mCopiesInFlight
+	struct Copy
+	{
+		CComPtr<ID3D11Texture2D> staging;
+		int  width = 0, height = 0; // Size of the area copied, smaller than the region if it was clipped by the edge of the buffer
+		int  cursorX = 0, cursorY = 0; // Cursor position within the area copied
+		bool empty = false; // The cursor was outside the buffer, nothing was copied and the result is no ID
+	};
+	Copy mCopies[RING_SIZE];
+	int  mNextCopy = 0;
+	int  mOldestCopy = 0;
+	int  mCopiesInFlight = 0;
+
+	ID3D11VertexShader* mVertexShader = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mPixelShader  = nullptr;
+
+	int mCursorX = 0;
+	int mCursorY = 0;
+	uint32_t mPickedId = 0;
+};
+
+
+#endif //_ID_BUFFER_PICKER_H_INCLUDED_
@@ -0,0 +1,297 @@
+//--------------------------------------------------------------------------------------
+// Impostors - distant entities drawn as a single quad showing a view of their mesh taken from a texture atlas
+//--------------------------------------------------------------------------------------
+
+#include "ImpostorRenderer.h"
+
+#include "Mesh.h"
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Atlas layout
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	// The direction a cell of the atlas is baked from, in the mesh's root space, must match CellDirection in vs_impostor_uv. The
+	// cell centre is a point of the [-1,1] square, which folds onto the upper half of an octahedron
+	Vector3 CellDirection(uint32_t cellX, uint32_t cellY)
+	{
+		float squareX = (cellX + 0.5f) / ImpostorRenderer::GRID_SIZE * 2 - 1;
+		float squareY = (cellY + 0.5f) / ImpostorRenderer::GRID_SIZE * 2 - 1;
+		float x = (squareX + squareY) * 0.5f;
+		float z = (squareX - squareY) * 0.5f;
+		return Normalise(Vector3{ x, 1 - std::abs(x) - std::abs(z), z });
+	}
+
+	// The up vector of the view along a direction, as in vs_impostor_uv: the root Y axis unless looking straight down, then the Z axis
+	Vector3 CellUp(const Vector3& direction)
+	{
+		Vector3 up = (direction.y < 0.999f) ? Vector3{ 0, 1, 0 } : Vector3{ 0, 0, 1 };
+		return Normalise(up - direction * Dot(up, direction));
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the impostor shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+ImpostorRenderer::ImpostorRenderer()
+{
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_impostor_uv");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_impostor");
+	if (mVertexShader == nullptr || mPixelShader == nullptr)  throw std::runtime_error("Impostors: " + DX->Shaders()->GetLastError());
+
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterTrilinear, TextureAddressingMode::AddressingClamp });
+	if (mSampler == nullptr)  throw std::runtime_error("Impostors: " + DX->Textures()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(ImpostorConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Impostors: failure creating constant buffer");
+	mConstants.gridSize = GRID_SIZE;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add an entity to be drawn as an impostor by the next Render, baking the atlas of its mesh if this is its first use. Returns
+// false if the atlas couldn't be baked
+bool ImpostorRenderer::Add(ImpostorAtlas& atlas, Mesh& mesh, const Matrix4x4& worldMatrix, const BoundingSphere& worldBounds, ColourRGBA colour)
+{
+	if (!atlas.baked)  Bake(atlas, mesh);
+	if (atlas.texture == nullptr)  return false;
+
+	auto channel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	Pending& pending = mPending.emplace_back();
+	pending.atlas = &atlas;
+	pending.instance.centre = worldBounds.centre;
+	pending.instance.radius = worldBounds.radius;
+	pending.instance.xAxis  = Normalise(worldMatrix.XAxis());
+	pending.instance.yAxis  = Normalise(worldMatrix.YAxis());
+	pending.instance.zAxis  = Normalise(worldMatrix.ZAxis());
+	pending.instance.colour = channel(colour.r) | (channel(colour.g) << 8) | (channel(colour.b) << 16) | (channel(colour.a) << 24);
+	return true;
+}
+
+
+// Draw the impostors added since the last Render, one instanced draw for each atlas in use
+void ImpostorRenderer::Render()
+{
+	if (mPending.empty())  return;
+
+	// Group the impostors by atlas, stable sort so the order is the same each frame
+	std::stable_sort(mPending.begin(), mPending.end(), [](const Pending& a, const Pending& b)
+	{
+		return std::less<ImpostorAtlas*>()(a.atlas, b.atlas);
+	});
+	mInstances.clear();
+	for (auto& pending : mPending)  mInstances.push_back(pending.instance);
+	if (!Upload(mInstances.data(), static_cast<unsigned int>(mInstances.size())))
+	{
+		mPending.clear();
+		return;
+	}
+
+	// The quads face the camera with clockwise corners, so the pass's culling, depth and blending states are kept
+	auto context = DX->Context();
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->VSSetShaderResources(0, 1, &mInstanceView.p);
+	context->PSSetShader(mPixelShader, nullptr, 0);
+	context->PSSetSamplers(0, 1, &mSampler);
+
+	for (size_t first = 0; first < mPending.size(); )
+	{
+		size_t last = first + 1;
+		while (last < mPending.size() && mPending[last].atlas == mPending[first].atlas)  ++last;
+
+		mConstants.firstInstance = static_cast<uint32_t>(first);
+		DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+		context->VSSetConstantBuffers(5, 1, &mConstantBuffer);
+		context->PSSetShaderResources(0, 1, &mPending[first].atlas->texture.p);
+		context->DrawInstanced(4, static_cast<UINT>(last - first), 0, 0);
+		gRenderCounters.Add(RenderCounter::Draws);
+		++mStats.draws;
+		first = last;
+	}
+	mStats.impostors += static_cast<uint32_t>(mPending.size());
+	mPending.clear();
+
+	ID3D11ShaderResourceView* nullView = nullptr;
+	context->VSSetShaderResources(0, 1, &nullView);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Render the views of a mesh into a new atlas texture, one orthographic view of the mesh's bounding sphere in each cell
+void ImpostorRenderer::Bake(ImpostorAtlas& atlas, Mesh& mesh)
+{
+	atlas.baked = true;
+	const BoundingSphere& bounds = mesh.GetBoundingSphere();
+	if (bounds.IsEmpty() || bounds.radius <= 0)  return;
+
+	// Atlas with mip maps so distant impostors don't sparkle, and a depth buffer only needed while baking
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = GRID_SIZE * CELL_SIZE;
+	textureDesc.Height           = GRID_SIZE * CELL_SIZE;
+	textureDesc.MipLevels        = MIP_LEVELS;
+	textureDesc.ArraySize        = 1;
+	textureDesc.Format           = DXGI_FORMAT_R8G8B8A8_UNORM;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.MiscFlags        = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	CComPtr<ID3D11Texture2D>          texture;
+	CComPtr<ID3D11RenderTargetView>   renderTarget;
+	CComPtr<ID3D11ShaderResourceView> textureView;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &texture)) ||
+	    FAILED(DX->Device()->CreateRenderTargetView(texture, nullptr, &renderTarget)) ||
+	    FAILED(DX->Device()->CreateShaderResourceView(texture, nullptr, &textureView)))  return;
+
+	textureDesc.MipLevels = 1;
+	textureDesc.Format    = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	textureDesc.MiscFlags = 0;
+	CComPtr<ID3D11Texture2D>        depthTexture;
+	CComPtr<ID3D11DepthStencilView> depthView;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &depthTexture)) ||
+	    FAILED(DX->Device()->CreateDepthStencilView(depthTexture, nullptr, &depthView)))  return;
+
+	// Keep what is set now to put it back afterwards, baking can happen in the middle of rendering a view
+	auto context = DX->Context();
+	CComPtr<ID3D11RenderTargetView> previousTarget;
+	CComPtr<ID3D11DepthStencilView> previousDepth;
+	context->OMGetRenderTargets(1, &previousTarget, &previousDepth);
+	D3D11_VIEWPORT previousViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT numPreviousViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	context->RSGetViewports(&numPreviousViewports, previousViewports);
+	PerCameraConstants previousCamera = gPerCameraConstants;
+	bool            previousDepthOnly       = RenderState::DepthOnly();
+	RasterizerState previousRasterizerState = DX->States()->GetRasterizerState();
+	DepthState      previousDepthState      = DX->States()->GetDepthState();
+	BlendState      previousBlendState      = DX->States()->GetBlendState();
+
+	float clearColour[4] = { 0, 0, 0, 0 };
+	context->ClearRenderTargetView(renderTarget, clearColour);
+	context->ClearDepthStencilView(depthView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+	context->OMSetRenderTargets(1, &renderTarget.p, depthView);
+	RenderState::SetDepthOnly(false);
+	DX->States()->SetRasterizerState(RasterizerState::CullBack);
+	DX->States()->SetDepthState(DepthState::DepthOn);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+
+	// The mesh in its default pose with its root at the origin
+	std::vector<Matrix4x4> transforms(mesh.NodeCount());
+	transforms[0] = Matrix4x4::Identity;
+	for (unsigned int node = 1; node < mesh.NodeCount(); ++node)  transforms[node] = mesh.DefaultTransform(node);
+
+	// Each view is orthographic, just enclosing the bounding sphere from a camera two radii from its centre
+	float radius = bounds.radius;
+	Matrix4x4 projection = { 1 / radius, 0,          0,                  0,
+	                         0,          1 / radius, 0,                  0,
+	                         0,          0,          1 / (3 * radius),   0,
+	                         0,          0,          -1.0f / 6,          1 };
+	for (uint32_t cellY = 0; cellY < GRID_SIZE; ++cellY)
+	{
+		for (uint32_t cellX = 0; cellX < GRID_SIZE; ++cellX)
+		{
+			Vector3 direction = CellDirection(cellX, cellY);
+			Vector3 up        = CellUp(direction);
+			Vector3 forward   = direction * -1.0f;
+			Matrix4x4 cameraMatrix = Matrix4x4::Identity;
+			cameraMatrix.XAxis()    = Cross(up, forward);
+			cameraMatrix.YAxis()    = up;
+			cameraMatrix.ZAxis()    = forward;
+			cameraMatrix.Position() = bounds.centre + direction * (2 * radius);
+
+			gPerCameraConstants.cameraMatrix         = cameraMatrix;
+			gPerCameraConstants.viewMatrix           = InverseAffine(cameraMatrix);
+			gPerCameraConstants.projectionMatrix     = projection;
+			gPerCameraConstants.viewProjectionMatrix = gPerCameraConstants.viewMatrix * projection;
+			gPerCameraConstants.cameraPosition       = cameraMatrix.Position();
+			DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+
+			D3D11_VIEWPORT viewport = { static_cast<float>(cellX * CELL_SIZE), static_cast<float>(cellY * CELL_SIZE),
+			                            static_cast<float>(CELL_SIZE), static_cast<float>(CELL_SIZE), 0.0f, 1.0f };
+			context->RSSetViewports(1, &viewport);
+			mesh.Render(transforms);
+		}
+	}
+	context->OMSetRenderTargets(0, nullptr, nullptr);
+	context->GenerateMips(textureView);
+
+	context->OMSetRenderTargets(1, &previousTarget.p, previousDepth);
+	context->RSSetViewports(numPreviousViewports, previousViewports);
+	gPerCameraConstants = previousCamera;
+	DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+	RenderState::SetDepthOnly(previousDepthOnly);
+	DX->States()->SetRasterizerState(previousRasterizerState);
+	DX->States()->SetDepthState(previousDepthState);
+	DX->States()->SetBlendState(previousBlendState);
+
+	atlas.texture = textureView;
+	++mNumBaked;
+}
+
+
+// Make sure the instance buffer can hold the given number of instances, then copy them in. Returns false on failure
+bool ImpostorRenderer::Upload(const Instance* instances, unsigned int numInstances)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numInstances > mCapacity)
+	{
+		unsigned int capacity = (mCapacity > 0) ? mCapacity : INITIAL_CAPACITY;
+		while (capacity < numInstances)  capacity *= 2;
+		mInstanceView   = nullptr;
+		mInstanceBuffer = nullptr;
+		mCapacity       = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = capacity * sizeof(Instance);
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = sizeof(Instance);
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &mInstanceBuffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = capacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(mInstanceBuffer, &srvDesc, &mInstanceView)))
+		{
+			mInstanceBuffer = nullptr;
+			return false;
+		}
+		mCapacity = capacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(mInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, instances, static_cast<size_t>(numInstances) * sizeof(Instance));
+	DX->Context()->Unmap(mInstanceBuffer, 0);
+	return true;
+}
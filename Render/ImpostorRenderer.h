@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// Impostors - distant entities drawn as a single quad showing a view of their mesh taken from a texture atlas
+//--------------------------------------------------------------------------------------
+// An island or boat far from the camera covers a few pixels but still costs a draw call for each part of its mesh. An impostor
+// replaces it with one textured quad. The views come from an atlas baked the first time a mesh is drawn as an impostor: a grid
+// of GRID_SIZE x GRID_SIZE cells, each an orthographic view of the mesh in its default pose looking at the centre of its
+// bounding sphere. The cell directions cover the upper hemisphere of the mesh's root space in a hemi-octahedral layout, so
+// neighbouring cells are neighbouring directions and the nearest cell to any direction is found with a few adds.
+//
+// Impostors are gathered during a render pass and drawn together with one instanced draw for each atlas. The vertex shader
+// (vs_impostor_uv) finds the direction to the camera in the entity's root space, picks the nearest cell of the atlas and builds
+// the quad facing along that cell's direction, sized by the entity's world bounding sphere. The pixel shader cuts out the
+// background of the cell and tints the view with the entity's colour. Views from below the mesh use the cells on the horizon
+//
+//   if (!impostorRenderer.Add(atlas, mesh, worldMatrix, worldBounds, colour))  ... draw the mesh instead ...
+//   impostorRenderer.Render();  // After each list of entities, with the per-camera constants of the view set
+//
+// Baking renders to its own target and puts back the render target, viewport, camera constants and render states, so it can
+// happen in the middle of rendering a view. The atlases belong to the caller (see EntityTemplate::SetImpostor)
+
+#ifndef _IMPOSTOR_RENDERER_H_INCLUDED_
+#define _IMPOSTOR_RENDERER_H_INCLUDED_
+
+#include "Frustum.h"
+#include "Matrix4x4.h"
+#include "Vector3.h"
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+
+
+// The baked views of a mesh, see ImpostorRenderer::Add
+struct ImpostorAtlas
+{
+	CComPtr<ID3D11ShaderResourceView> texture;
+	bool baked = false; // Also set if baking failed, so it is only tried once. The atlas has no texture in that case
+};
+
+
+class ImpostorRenderer
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the impostor shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+	ImpostorRenderer();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Views along each side of an atlas, and the size of each view in texels
+	static constexpr uint32_t GRID_SIZE = 8;
+	static constexpr uint32_t CELL_SIZE = 64;
+
+	// Whether impostors are used, when off entities are always drawn with their meshes
+	bool& Enabled()  { return mEnabled; }
+
+	// Add an entity to be drawn as an impostor by the next Render, given the atlas of its mesh, its root world matrix and world
+	// bounding sphere. The atlas is baked from the mesh if this is its first use. Returns false if the atlas couldn't be baked,
+	// the entity should be drawn with its mesh instead
+	bool Add(ImpostorAtlas& atlas, Mesh& mesh, const Matrix4x4& worldMatrix, const BoundingSphere& worldBounds, ColourRGBA colour);
+
+	// Draw the impostors added since the last Render with the current per-camera constants and render states, one instanced draw
+	// for each atlas in use
+	void Render();
+
+	// Number of impostors drawn, in the given number of draws, since the last reset
+	struct Stats
+	{
+		uint32_t impostors = 0;
+		uint32_t draws     = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+	void ResetStats()  { mStats = {}; }
+
+	// Number of atlases baked since the renderer was created
+	uint32_t NumBaked()  { return mNumBaked; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// An instance as the vertex shader reads it, must match the structure in vs_impostor_uv. The axes are the unit axes of the
+	// entity's root world matrix
+	struct Instance
+	{
+		Vector3  centre;
+		float    radius;
+		Vector3  xAxis;
+		uint32_t colour; // RGBA, 8 bits each from the lowest
+		Vector3  yAxis;
+		float    padding0 = 0;
+		Vector3  zAxis;
+		float    padding1 = 0;
+	};
+
+	// An instance waiting for Render, with the atlas it is drawn from
+	struct Pending
+	{
+		ImpostorAtlas* atlas;
+		Instance       instance;
+	};
+
+	// Render the views of a mesh into a new atlas texture, see ImpostorRenderer.h. Leaves the atlas without a texture on failure
+	void Bake(ImpostorAtlas& atlas, Mesh& mesh);
+
+	// Make sure the instance buffer can hold the given number of instances, then copy them in. Returns false on failure
+	bool Upload(const Instance* instances, unsigned int numInstances);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Mip levels of an atlas, stopping while each cell is still several texels across so the views don't blur into each other
+	static constexpr uint32_t MIP_LEVELS = 4;
+
+	// The instance buffer starts with space for this many instances, then doubles in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 256;
+
+	bool mEnabled = true;
+
+	ID3D11VertexShader* mVertexShader   = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mPixelShader    = nullptr;
+	ID3D11SamplerState* mSampler        = nullptr; // Owned by the texture manager
+	ID3D11Buffer*       mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	ImpostorConstants   mConstants;
+
+	// Impostors added since the last Render, cleared rather than recreated to keep the capacity. Sorted by atlas for drawing
+	std::vector<Pending>  mPending;
+	std::vector<Instance> mInstances;
+
+	CComPtr<ID3D11Buffer>             mInstanceBuffer;
+	CComPtr<ID3D11ShaderResourceView> mInstanceView;
+	unsigned int                      mCapacity = 0; // In instances
+
+	Stats    mStats;
+	uint32_t mNumBaked = 0;
+};
+
+
+#endif //_IMPOSTOR_RENDERER_H_INCLUDED_
@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// InstanceBuffer class holds the per-instance world matrices for instanced rendering
+//--------------------------------------------------------------------------------------
+
+#include "InstanceBuffer.h"
+
+#include "RenderGlobals.h"
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Start writing the given number of matrices, replacing the previous contents. Returns nullptr on failure
+Matrix4x4* InstanceBuffer::Begin(unsigned int numMatrices)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numMatrices > mCapacity)
+	{
+		unsigned int capacity = (mCapacity > 0) ? mCapacity : INITIAL_CAPACITY;
+		while (capacity < numMatrices)  capacity *= 2;
+
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.BindFlags           = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.ByteWidth           = capacity * sizeof(Matrix4x4);
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC;    // Rewritten for every batch of instances
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = 0;
+		bufferDesc.StructureByteStride = 0;
+
+		mBuffer.Release();
+		mCapacity = 0;
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &mBuffer)))  return nullptr;
+		mCapacity = capacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(mBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return nullptr;
+	return static_cast<Matrix4x4*>(mapped.pData);
+}
+
+
+// Finish writing the matrices, they can then be used for rendering
+void InstanceBuffer::End()
+{
+	DX->Context()->Unmap(mBuffer, 0);
+}
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// InstanceBuffer class holds the per-instance world matrices for instanced rendering
+//--------------------------------------------------------------------------------------
+// Instanced rendering draws many copies of a sub-mesh with a single draw call (DrawIndexedInstanced). Each copy needs its
+// own world matrix, which the instanced vertex shaders (vs_*_ip2c*) read from this buffer as a second vertex buffer with
+// per-instance data. The buffer is rewritten each time a batch of instances is rendered:
+//
+//   Matrix4x4* matrices = instanceBuffer.Begin(numMatrices); // nullptr on failure
+//   ... write numMatrices matrices ...
+//   instanceBuffer.End();
+//   mesh.RenderInstanced(instanceBuffer.Buffer(), firstMatrix, numInstances, colour);
+//
+// The buffer is created on first use and grows when more matrices are needed than it holds
+
+#ifndef _INSTANCE_BUFFER_H_INCLUDED_
+#define _INSTANCE_BUFFER_H_INCLUDED_
+
+#include "Matrix4x4.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+
+//--------------------------------------------------------------------------------------
+// Instance Buffer Class
+//--------------------------------------------------------------------------------------
+class InstanceBuffer
+{
+	//--------------------------------------------------------------------------------------
+	// Usage
+	//--------------------------------------------------------------------------------------
+public:
+	// Start writing the given number of matrices, replacing the previous contents. Returns where to write them, or nullptr if
+	// the buffer can't be created or mapped. Call End when the matrices have been written
+	Matrix4x4* Begin(unsigned int numMatrices);
+
+	// Finish writing the matrices, they can then be used for rendering
+	void End();
+
+	// The DirectX buffer to bind as the per-instance vertex buffer, nullptr if it hasn't been created yet
+	ID3D11Buffer* Buffer()  { return mBuffer; }
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Data
+	//--------------------------------------------------------------------------------------
+private:
+	// Buffers start with space for this many matrices, then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 1024;
+
+	CComPtr<ID3D11Buffer> mBuffer;
+	unsigned int mCapacity = 0; // Number of matrices the buffer holds
+};
+
+
+#endif //_INSTANCE_BUFFER_H_INCLUDED_
@@ -0,0 +1,238 @@
+//--------------------------------------------------------------------------------------
+// Text labels at points on the screen, laid out once and drawn together in a single instanced draw
+//--------------------------------------------------------------------------------------
+
+#include "LabelRenderer.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cwctype>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the label shaders and create their sampler and constant buffer. Throws std::runtime_error on failure
+LabelRenderer::LabelRenderer(const DirectX::DX11::SpriteFont& font)
+	: mFont(font)
+{
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_label-glyphs_uv");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_label-glyph");
+	if (mVertexShader == nullptr || mPixelShader == nullptr)  throw std::runtime_error("Label renderer: " + DX->Shaders()->GetLastError());
+
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterBilinear, TextureAddressingMode::AddressingClamp });
+	if (mSampler == nullptr)  throw std::runtime_error("Label renderer: " + DX->Textures()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(LabelConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Label renderer: failure creating constant buffer");
+
+	// Glyph rectangles are in texels, the shader needs the size of the sprite sheet to turn them into texture coordinates
+	mFont.GetSpriteSheet(&mSpriteSheet);
+	CComPtr<ID3D11Resource> resource;
+	mSpriteSheet->GetResource(&resource);
+	CComQIPtr<ID3D11Texture2D> texture(resource);
+	if (texture == nullptr)  throw std::runtime_error("Label renderer: font sprite sheet is not a 2D texture");
+	D3D11_TEXTURE2D_DESC textureDesc;
+	texture->GetDesc(&textureDesc);
+	mConstants.texelsToUV = { 1.0f / textureDesc.Width, 1.0f / textureDesc.Height };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start gathering the labels for a frame, for a viewport of the given size in pixels
+void LabelRenderer::Begin(float viewportWidth, float viewportHeight)
+{
+	mViewportWidth  = viewportWidth;
+	mViewportHeight = viewportHeight;
+	mGlyphs.clear();
+	mStats = {};
+	++mFrame;
+}
+
+
+// Add a label with the given key, centred horizontally on a pixel position with the text hanging below it
+void LabelRenderer::Add(uint64_t key, float pixelX, float pixelY, std::string_view text, ColourRGB colour)
+{
+	// Labels whose text is unchanged keep their layout, comparing the text is much cheaper than laying it out again
+	CachedLabel& label = mLabels[key];
+	label.lastAdded = mFrame;
+	if (label.text != text)
+	{
+		label.text.assign(text);
+		LayOut(mFont, text, label.layout);
+		++mStats.laidOutLabels;
+	}
+
+	// Whole pixels so glyph texels land on screen pixels
+	const TextLayout& layout = label.layout;
+	float left = std::floor(pixelX - layout.width * 0.5f + 0.5f);
+	float top  = std::floor(pixelY + 0.5f);
+	if (left >= mViewportWidth || left + layout.width <= 0 || top >= mViewportHeight || top + layout.height <= 0)
+	{
+		++mStats.culledLabels;
+		return;
+	}
+	++mStats.visibleLabels;
+
+	auto channel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	uint32_t packedColour = channel(colour.r) | (channel(colour.g) << 8) | (channel(colour.b) << 16) | 0xff000000;
+	for (const TextLayout::Glyph& glyph : layout.glyphs)
+	{
+		GlyphInstance& instance = mGlyphs.emplace_back();
+		std::memcpy(instance.texels, glyph.texels, sizeof(instance.texels));
+		instance.x = left + glyph.x;
+		instance.y = top + glyph.y;
+		instance.colour = packedColour;
+	}
+}
+
+
+// Draw the labels added since Begin with one instanced draw, then forget labels that haven't been added for a while
+void LabelRenderer::Render()
+{
+	std::erase_if(mLabels, [this](const auto& label) { return mFrame - label.second.lastAdded > FORGET_FRAMES; });
+	mStats.glyphs = static_cast<uint32_t>(mGlyphs.size());
+	mStats.cachedLabels = static_cast<uint32_t>(mLabels.size());
+	mLastStats = mStats;
+
+	if (mGlyphs.empty() || !ReserveGlyphs(static_cast<unsigned int>(mGlyphs.size())))  return;
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	auto context = DX->Context();
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(mGlyphBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return;
+	std::memcpy(mapped.pData, mGlyphs.data(), mGlyphs.size() * sizeof(GlyphInstance));
+	context->Unmap(mGlyphBuffer, 0);
+
+	mConstants.pixelsToClip = { 2.0f / mViewportWidth, -2.0f / mViewportHeight };
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	// Glyph colours are added to the screen, as SpriteBatch's premultiplied blending did with the zero alpha labels used before
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOff);
+	DX->States()->SetBlendState(BlendState::BlendAdditive);
+
+	// A quad for each glyph, its corners generated in the vertex shader from the vertex ID and its data read by instance ID
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->VSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->VSSetShaderResources(0, 1, &mGlyphView.p);
+	context->PSSetShader(mPixelShader, nullptr, 0);
+	context->PSSetShaderResources(0, 1, &mSpriteSheet.p);
+	context->PSSetSamplers(0, 1, &mSampler);
+	context->DrawInstanced(4, static_cast<UINT>(mGlyphs.size()), 0, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	ID3D11ShaderResourceView* nullView = nullptr;
+	context->VSSetShaderResources(0, 1, &nullView);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
+
+
+// Lay out the text in the given font, following SpriteFont::DrawString (and MeasureString for the size). The layout's glyphs
+// are cleared rather than replaced so a label whose text keeps changing (e.g. a speed) reuses their memory
+void LabelRenderer::LayOut(const DirectX::DX11::SpriteFont& font, std::string_view text, TextLayout& layout)
+{
+	layout.glyphs.clear();
+	layout.width  = 0;
+	layout.height = 0;
+
+	// The font is indexed by UTF-16 characters, as SpriteFont's UTF-8 functions convert the text. Kept to reuse its memory
+	static std::wstring wideText;
+	int wideLength = text.empty() ? 0 : MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+	wideText.resize(wideLength);
+	if (wideLength > 0)  MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wideText.data(), wideLength);
+
+	float lineSpacing = font.GetLineSpacing();
+	float x = 0;
+	float y = 0;
+	for (wchar_t character : wideText)
+	{
+		if (character == L'\r')  continue;
+		if (character == L'\n')
+		{
+			x = 0;
+			y += lineSpacing;
+			continue;
+		}
+
+		// Characters the font doesn't have are drawn as its default character, or skipped if it has none
+		if (font.GetDefaultCharacter() == 0 && !font.ContainsCharacter(character))  continue;
+		const DirectX::DX11::SpriteFont::Glyph* glyph = font.FindGlyph(character);
+
+		x = std::max(x + glyph->XOffset, 0.0f);
+		float glyphWidth  = static_cast<float>(glyph->Subrect.right  - glyph->Subrect.left);
+		float glyphHeight = static_cast<float>(glyph->Subrect.bottom - glyph->Subrect.top);
+		bool  whitespace  = std::iswspace(character) != 0;
+
+		// Spaces have nothing to draw, but some fonts give them a visible glyph
+		if (!whitespace || glyphWidth > 1 || glyphHeight > 1)
+		{
+			TextLayout::Glyph& laidOut = layout.glyphs.emplace_back();
+			laidOut.texels[0] = static_cast<float>(glyph->Subrect.left);
+			laidOut.texels[1] = static_cast<float>(glyph->Subrect.top);
+			laidOut.texels[2] = static_cast<float>(glyph->Subrect.right);
+			laidOut.texels[3] = static_cast<float>(glyph->Subrect.bottom);
+			laidOut.x = x;
+			laidOut.y = y + glyph->YOffset;
+		}
+
+		layout.width  = std::max(layout.width,  x + glyphWidth);
+		layout.height = std::max(layout.height, y + (whitespace ? lineSpacing : std::max(glyphHeight + glyph->YOffset, lineSpacing)));
+		x += glyphWidth + glyph->XAdvance;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure the glyph buffer holds the given number of glyphs, replacing it with a larger one if not. Returns false on failure
+bool LabelRenderer::ReserveGlyphs(unsigned int numGlyphs)
+{
+	if (numGlyphs <= mGlyphCapacity)  return true;
+
+	unsigned int capacity = (mGlyphCapacity > 0) ? mGlyphCapacity : INITIAL_CAPACITY;
+	while (capacity < numGlyphs)  capacity *= 2;
+	mGlyphView = nullptr;
+	mGlyphBuffer = nullptr;
+	mGlyphCapacity = 0;
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.ByteWidth           = capacity * sizeof(GlyphInstance);
+	bufferDesc.Usage               = D3D11_USAGE_DYNAMIC; // Rewritten every frame
+	bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	bufferDesc.StructureByteStride = sizeof(GlyphInstance);
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &mGlyphBuffer)))  return false;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+	srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements  = capacity;
+	if (FAILED(DX->Device()->CreateShaderResourceView(mGlyphBuffer, &srvDesc, &mGlyphView)))
+	{
+		mGlyphBuffer = nullptr;
+		return false;
+	}
+	mGlyphCapacity = capacity;
+	return true;
+}
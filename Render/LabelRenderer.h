@@ -0,0 +1,152 @@
+//--------------------------------------------------------------------------------------
+// Text labels at points on the screen, laid out once and drawn together in a single instanced draw
+//--------------------------------------------------------------------------------------
+// Drawing a label with SpriteFont::DrawString looks up and positions every glyph of its text each time it is drawn, and
+// centring it needs the same again from MeasureString. Labels here are retained from frame to frame instead: each one is
+// given by the caller a key that stays the same while the label exists (e.g. made from an entity ID), and the glyphs of its
+// text are laid out (position and sprite sheet rectangle of each) the first time it is added and again only when its text
+// changes. The layout also gives the label's size, so labels entirely off the screen are skipped before any of their glyphs
+// are touched.
+//
+// The glyphs of all the visible labels are written to a structured buffer, one quad each, which is drawn with one instanced
+// draw of 4 vertices per glyph (vs_label-glyphs_uv generates the corners from the vertex ID). Labels not added for a while
+// are forgotten, so there is nothing to remove when an entity is destroyed. Glyphs come from a DirectXTK SpriteFont, laid out
+// as SpriteFont::DrawString does, but label positions are rounded to whole pixels so the text is not blurred by filtering
+//
+//   labelRenderer.Begin(viewportWidth, viewportHeight);
+//   labelRenderer.Add(key, pixelX, pixelY, text, colour);  // For each label, the text is centred on the point and hangs below it
+//   labelRenderer.Render();                                // Render target is the back buffer, with a full size viewport
+
+#ifndef _LABEL_RENDERER_H_INCLUDED_
+#define _LABEL_RENDERER_H_INCLUDED_
+
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+#include <SpriteFont.h> // DirectXTK helper library for text drawing
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class LabelRenderer
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the label shaders and create their sampler and constant buffer, for labels in the given font, which must exist for
+	// as long as the label renderer. Throws std::runtime_error on failure
+	LabelRenderer(const DirectX::DX11::SpriteFont& font);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start gathering the labels for a frame, for a viewport of the given size in pixels
+	void Begin(float viewportWidth, float viewportHeight);
+
+	// Add a label with the given key, centred horizontally on a pixel position with the text hanging below it. The text is only
+	// laid out again if it differs from the last time this key was added. Labels entirely outside the viewport are skipped
+	void Add(uint64_t key, float pixelX, float pixelY, std::string_view text, ColourRGB colour);
+
+	// Draw the labels added since Begin. Leaves the render target and viewport as they were
+	void Render();
+
+	// Statistics for the control panel, for the last frame rendered. Visible labels were drawn, culled ones were outside the
+	// viewport, laid out is how many had their text laid out again, and glyphs is the number of quads in the single draw
+	struct Stats
+	{
+		uint32_t visibleLabels = 0;
+		uint32_t culledLabels  = 0;
+		uint32_t laidOutLabels = 0;
+		uint32_t glyphs        = 0;
+		uint32_t cachedLabels  = 0;
+	};
+	const Stats& GetStats()  { return mLastStats; }
+
+	// Glyphs of a text, positioned as SpriteFont::DrawString would draw them relative to the top-left of the text, with the
+	// size SpriteFont::MeasureString gives. Also used for floating text (see FloatingTextRenderer.h)
+	struct TextLayout
+	{
+		struct Glyph
+		{
+			float texels[4]; // Sprite sheet rectangle: left, top, right, bottom in texels
+			float x, y;
+		};
+		std::vector<Glyph> glyphs;
+		float width  = 0;
+		float height = 0;
+	};
+
+	// Lay out the text in the given font, reusing the layout's memory. Main thread only
+	static void LayOut(const DirectX::DX11::SpriteFont& font, std::string_view text, TextLayout& layout);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// One glyph quad as the vertex shader reads it, must match GlyphInstance in vs_label-glyphs_uv
+	struct GlyphInstance
+	{
+		float    texels[4]; // Sprite sheet rectangle: left, top, right, bottom in texels
+		float    x, y;      // Top-left corner on the screen in pixels
+		uint32_t colour;    // RGBA, 8 bits each from the lowest
+		uint32_t padding = 0;
+	};
+
+	// The remembered layout of a label
+	struct CachedLabel
+	{
+		std::string text;
+		TextLayout  layout;
+		uint32_t    lastAdded = 0; // Frame number when the label was last added, it is forgotten when this is too long ago
+	};
+
+	// Make sure the glyph buffer holds the given number of glyphs. Returns false on failure
+	bool ReserveGlyphs(unsigned int numGlyphs);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Labels not added for this many frames are forgotten
+	static constexpr uint32_t FORGET_FRAMES = 120;
+
+	// The glyph buffer starts with space for this many glyphs, then doubles in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 4096;
+
+	const DirectX::DX11::SpriteFont& mFont;
+	CComPtr<ID3D11ShaderResourceView> mSpriteSheet;
+
+	ID3D11VertexShader* mVertexShader   = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mPixelShader    = nullptr;
+	ID3D11SamplerState* mSampler        = nullptr; // Owned by the texture manager
+	ID3D11Buffer*       mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	LabelConstants      mConstants;
+
+	CComPtr<ID3D11Buffer>             mGlyphBuffer;
+	CComPtr<ID3D11ShaderResourceView> mGlyphView;
+	unsigned int mGlyphCapacity = 0;
+
+	std::unordered_map<uint64_t, CachedLabel> mLabels;
+	std::vector<GlyphInstance> mGlyphs; // Glyphs of the visible labels this frame, cleared rather than recreated to keep the capacity
+
+	float    mViewportWidth  = 0;
+	float    mViewportHeight = 0;
+	uint32_t mFrame          = 0;
+	Stats    mStats;
+	Stats    mLastStats;
+};
+
+
+#endif //_LABEL_RENDERER_H_INCLUDED_
@@ -0,0 +1,57 @@
+//--------------------------------------------------------------------------------------
+// Memory budget, keeping GPU memory use within the budget the OS gives the process
+//--------------------------------------------------------------------------------------
+
+#include "MemoryBudget.h"
+
+#include "RenderGlobals.h"
+#include "Texture.h"
+
+#include <algorithm>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Read the memory use and budget and adjust the texture budget and LOD scale
+void MemoryBudget::Update(float frameTime)
+{
+	bool budgetChanged = DX->UpdateVideoMemory();
+	const DXDevice::VideoMemoryInfo& memory = DX->GetVideoMemory();
+	mSupported = memory.budget > 0;
+	mSinceAdjust += frameTime;
+	if (!mEnabled || !mSupported)
+	{
+		mLODScale = 1.0f;
+		return;
+	}
+
+	// Textures get what is left of the target after everything else. Textures that aren't streamed can't be dropped, so are
+	// always included
+	constexpr uint64_t MB = 1024 * 1024;
+	const TextureManager::Stats& textures = DX->Textures()->GetStats();
+	uint64_t target          = static_cast<uint64_t>(memory.budget * static_cast<double>(TARGET_FRACTION));
+	uint64_t otherBytes      = memory.usage > textures.bytes ? memory.usage - textures.bytes : 0;
+	uint64_t minTextureBytes = (textures.bytes - textures.streamedBytes) + MIN_STREAMED_MB * MB;
+	uint64_t textureBytes    = target > otherBytes ? target - otherBytes : 0;
+	bool texturesAtMinimum = textureBytes <= minTextureBytes;
+	if (texturesAtMinimum)  textureBytes = minTextureBytes;
+	DX->Textures()->BudgetMB() = static_cast<int>(textureBytes / MB);
+
+	// A change of budget is acted on straight away, otherwise the LOD scale changes gradually as the memory use takes a few
+	// frames to follow
+	if (budgetChanged)  mSinceAdjust = ADJUST_INTERVAL;
+	if (mSinceAdjust < ADJUST_INTERVAL)  return;
+
+	if (texturesAtMinimum && memory.usage > target)
+	{
+		mLODScale = std::max(mLODScale - LOD_STEP, MIN_LOD_SCALE);
+		mSinceAdjust = 0.0f;
+	}
+	else if (mLODScale < 1.0f && !texturesAtMinimum && memory.usage < memory.budget * static_cast<double>(RECOVER_FRACTION))
+	{
+		mLODScale = std::min(mLODScale + LOD_STEP, 1.0f);
+		mSinceAdjust = 0.0f;
+	}
+}
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Memory budget, keeping GPU memory use within the budget the OS gives the process
+//--------------------------------------------------------------------------------------
+// The OS gives each process a budget of the GPU's local video memory, and lowers it when others need more (another game starts,
+// the window moves to a smaller GPU...). A process over its budget has resources paged out to system memory, which is slow,
+// and one well over it risks the device being removed. Each frame the memory use and budget are read from DXGI (see
+// DXDevice::UpdateVideoMemory) and the texture budget is set to what is left of TARGET_FRACTION of the OS budget after
+// everything that isn't a texture, so the texture manager drops the top mip-maps of the textures not drawn recently straight
+// away when the OS budget falls, without waiting for the memory to run out (see TextureManager::BudgetMB).
+//
+// Only streamed textures can be dropped. If even the least the texture budget can be doesn't bring the use within the budget,
+// the LOD scale is lowered a step at a time. Entities then measure their size on screen as smaller, so they switch to their
+// lower levels of detail sooner and ask for smaller textures (see EntityManager::SetLODView), which the texture budget then
+// sheds. Once the use is well within the budget the LOD scale goes back up a step at a time. Does nothing if the adapter
+// can't report its memory (before Windows 10), leaving the texture budget as it was set
+//
+//   memoryBudget.Update(frameTime);
+//   gEntityManager->LODScale() = memoryBudget.LODScale();
+
+#ifndef _MEMORY_BUDGET_H_INCLUDED_
+#define _MEMORY_BUDGET_H_INCLUDED_
+
+#include <stdint.h>
+
+
+class MemoryBudget
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Fraction of the OS budget to aim to use, leaving room for what is created between updates
+	static constexpr float TARGET_FRACTION = 0.9f;
+
+	// Streamed textures always get at least this many megabytes
+	static constexpr uint64_t MIN_STREAMED_MB = 32;
+
+	// The LOD scale is lowered by LOD_STEP when over budget, and raised back by the same when the use is below RECOVER_FRACTION
+	// of the budget, at most once every ADJUST_INTERVAL seconds. It is kept between MIN_LOD_SCALE and 1
+	static constexpr float LOD_STEP         = 0.15f;
+	static constexpr float MIN_LOD_SCALE    = 0.25f;
+	static constexpr float RECOVER_FRACTION = 0.75f;
+	static constexpr float ADJUST_INTERVAL  = 0.5f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Read the memory use and budget and adjust the texture budget and LOD scale, call once a frame before rendering. When
+	// disabled the LOD scale is returned to 1 and the texture budget left as it is
+	void Update(float frameTime);
+
+	// Enable or disable keeping to the OS budget. On by default
+	bool& Enabled()  { return mEnabled; }
+
+	// Scale for the sizes on screen that levels of detail are chosen by, 1 with enough memory
+	float LODScale()  { return mLODScale; }
+
+	// Whether the adapter reports its memory use and budget
+	bool IsSupported()  { return mSupported; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	bool  mEnabled     = true;
+	bool  mSupported   = false;
+	float mLODScale    = 1.0f;
+	float mSinceAdjust = 0.0f; // Seconds since the LOD scale last changed
+};
+
+
+#endif //_MEMORY_BUDGET_H_INCLUDED_
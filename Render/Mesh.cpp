@@ -18,14 +18,22 @@
 
 #include "Mesh.h"
 #include "Assimp.h"
-
-#include "Shader.h"  // Needed for helper function CreateSignatureForVertexLayout
-#include "CBuffer.h" // Needed for helper function UpdateCBuffer
+#include "MeshOptimiser.h"
+#include "MeshCache.h"
+#include "AssetFiles.h"
+#include "StartupProfile.h"
+#include "CpuProfiler.h"
+#include "RenderCounters.h"
+
+#include "CBuffer.h" // Needed for helper function UpdateDrawCBuffer
 #include "CBufferTypes.h"
 #include "RenderGlobals.h"
+#include "BonePalette.h"
+#include "ShaderPrewarm.h"
 
 #include "Vector3.h" 
 #include "Vector2.h" 
+#include "TransformBatch.h"
 #include "Utility.h"  // For string utility functions 
 
 #include <assimp/Importer.hpp>
@@ -33,6 +41,14 @@
 #include <assimp/DefaultLogger.hpp>
 
 #include <stdexcept>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <cmath>
+#include <bit>
+#include <sstream>
+#include <iomanip>
+#include <mutex>
 
 
 //--------------------------------------------------------------------------------------
@@ -51,6 +67,7 @@
 //
 // Whilst assimp can provide information about shading model, pbr usage etc, it cannot be relied upon to correctly report these things since
 // many file formats simply don't contain that information. So most logic here is based on the names of the texture files in use
+// The files are looked for with gAssetFiles.ExistsIndexed, so trying the many possible names lists each texture folder only once
 //
 // To use textures one of these two maps must exist - the suffix on this base map (diffuse or albedo) is optional, but recommended
 // - Diffuse map: brick_diffuse.jpg or brick.jpg (Required for Blinn-Phong (2nd year style) lighting)
@@ -137,21 +154,21 @@ RenderMethod MaterialRenderMethod(AssimpMaterial& material, std::filesystem::pat
 
 	// Look for other textures required for PBR, if core ones are missing, quit looking (using goto since it is much more readable than the nested ifs that would otherwise be required)
 	secondaryPath = texturePath.parent_path() / (base + "roughness" + extension);
-	if (!std::filesystem::exists(secondaryPath))  goto FAIL_PBR1;
+	if (!gAssetFiles.ExistsIndexed(secondaryPath))  goto FAIL_PBR1;
 	renderMethod.textures.push_back({ TextureType::Roughness, secondaryPath.string(), { TextureFilter::FilterAnisotropic, mapModeState } });
 
 	secondaryPath = texturePath.parent_path() / (base + "normal" + extension);
-	if (!std::filesystem::exists(secondaryPath))  goto FAIL_PBR1;
+	if (!gAssetFiles.ExistsIndexed(secondaryPath))  goto FAIL_PBR1;
 	renderMethod.textures.push_back({ TextureType::Normal, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
 
 	// Metalness map is optional, will fall back to material metalness factor
 	secondaryPath = texturePath.parent_path() / (base + "metalness" + extension);
-	if (std::filesystem::exists(secondaryPath))
+	if (gAssetFiles.ExistsIndexed(secondaryPath))
 		renderMethod.textures.push_back({ TextureType::Metalness, secondaryPath.string(), { TextureFilter::FilterAnisotropic, mapModeState } });
 
 	// Displacement map is optional - determines if we have PBR normal or PBR parallax mapping
 	secondaryPath = texturePath.parent_path() / (base + "displacement" + extension);
-	if (std::filesystem::exists(secondaryPath))
+	if (gAssetFiles.ExistsIndexed(secondaryPath))
 	{
 		renderMethod.textures.push_back({ TextureType::Displacement, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
 		renderMethod.surfaceRenderMethod = SurfaceRenderMethod::PbrParallaxMapping;
@@ -174,20 +191,20 @@ FAIL_PBR1:
 
 	// Look for other textures required for alternate PBR approach, if core ones are missing, quit looking
 	secondaryPath = texturePath.parent_path() / (base + "specular" + extension);
-	if (!std::filesystem::exists(secondaryPath))  goto FAIL_PBR2;
+	if (!gAssetFiles.ExistsIndexed(secondaryPath))  goto FAIL_PBR2;
 	renderMethod.textures.push_back({ TextureType::Specular, secondaryPath.string() , { TextureFilter::FilterAnisotropic, mapModeState } });
 
 	secondaryPath = texturePath.parent_path() / (base + "gloss" + extension);
-	if (!std::filesystem::exists(secondaryPath))  goto FAIL_PBR2;
+	if (!gAssetFiles.ExistsIndexed(secondaryPath))  goto FAIL_PBR2;
 	renderMethod.textures.push_back({ TextureType::Gloss, secondaryPath.string(), { TextureFilter::FilterAnisotropic, mapModeState } });
 
 	secondaryPath = texturePath.parent_path() / (base + "normal" + extension);
-	if (!std::filesystem::exists(secondaryPath))  goto FAIL_PBR2;
+	if (!gAssetFiles.ExistsIndexed(secondaryPath))  goto FAIL_PBR2;
 	renderMethod.textures.push_back({ TextureType::Normal, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
 
 	// Once more displacement map is optional - determines if we have PBR normal or PBR parallax mapping
 	secondaryPath = texturePath.parent_path() / (base + "displacement" + extension);
-	if (std::filesystem::exists(secondaryPath))
+	if (gAssetFiles.ExistsIndexed(secondaryPath))
 	{
 		renderMethod.textures.push_back({ TextureType::Displacement, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
 		renderMethod.surfaceRenderMethod = SurfaceRenderMethod::PbrAltNormalMapping;
@@ -219,20 +236,20 @@ FAIL_PBR2:
 
 	// Specular map is optional, however shader will try and use it so if there is no map then force a null texture with "" filename (null texture returns black always)
 	secondaryPath = texturePath.parent_path() / (base + "specular" + extension);
-	if (std::filesystem::exists(secondaryPath))
+	if (gAssetFiles.ExistsIndexed(secondaryPath))
 		renderMethod.textures.push_back({ TextureType::Specular, secondaryPath.string(), { TextureFilter::FilterAnisotropic, mapModeState } });
 	else
 		renderMethod.textures.push_back({ TextureType::Specular, "", {TextureFilter::FilterAnisotropic, mapModeState}}); // Null specular texture, do set sampler or DirectX debugger issues warnings
 
 	// Look for support for normal and parallax mapping
 	secondaryPath = texturePath.parent_path() / (base + "normal" + extension);
-	if (std::filesystem::exists(secondaryPath))
+	if (gAssetFiles.ExistsIndexed(secondaryPath))
 	{
 		renderMethod.surfaceRenderMethod = SurfaceRenderMethod::BlinnNormalMapping;
 		renderMethod.textures.push_back({ TextureType::Normal, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
 
 		secondaryPath = texturePath.parent_path() / (base + "displacement" + extension);
-		if (std::filesystem::exists(secondaryPath))
+		if (gAssetFiles.ExistsIndexed(secondaryPath))
 		{
 			renderMethod.surfaceRenderMethod = SurfaceRenderMethod::BlinnParallaxMapping;
 			renderMethod.textures.push_back({ TextureType::Displacement, secondaryPath.string(), { TextureFilter::FilterTrilinear, mapModeState } });
@@ -255,7 +272,8 @@ GeometryTypes RenderMethodGeometryRequirements(const RenderMethod& renderMethod)
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrNormalMapping ||
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrParallaxMapping ||
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltNormalMapping ||
-		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltParallaxMapping)
+		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltParallaxMapping ||
+		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAlbedoOnly)
 		GeometryTypes |= GeometryTypes::Normal;
 
 	if (renderMethod.surfaceRenderMethod == SurfaceRenderMethod::BlinnNormalMapping ||
@@ -273,7 +291,8 @@ GeometryTypes RenderMethodGeometryRequirements(const RenderMethod& renderMethod)
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrNormalMapping ||
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrParallaxMapping ||
 		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltNormalMapping ||
-		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltParallaxMapping)
+		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltParallaxMapping ||
+		renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAlbedoOnly)
 		GeometryTypes |= GeometryTypes::UV;
 
 	if (renderMethod.geometryRenderMethod == GeometryRenderMethod::Skinned)
@@ -307,6 +326,91 @@ GeometryTypes SceneGeometryRequirements(const aiScene& scene, std::vector<Assimp
 
 
 
+//--------------------------------------------------------------------------------------
+// Vertex Compression Helper Functions
+//--------------------------------------------------------------------------------------
+// Used to store vertices in smaller formats when importing with ImportFlags::CompressVertices, the GPU or the "_q" vertex shaders
+// convert them back (see DecodeOctahedral in Common.hlsli)
+
+// Half-float UVs are only used if all the UVs of a submesh are within this range. Half-floats have 11 significant bits, so UVs up
+// to 8 are still accurate to 1/256, i.e. a few texels in typical textures. Larger UVs (e.g. a heavily tiled ground) stay 32-bit
+static const float MAX_HALF_FLOAT_UV = 8.0f;
+
+// Convert a float to a 16-bit half-float (DXGI_FORMAT_R16_FLOAT), rounding to nearest. Values too large become infinity
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits     = std::bit_cast<uint32_t>(value);
+	uint32_t sign     = (bits >> 16) & 0x8000;
+	int      exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15; // Rebias exponent for a half-float
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent >= 31)  return static_cast<uint16_t>(sign | 0x7C00);
+	if (exponent <= 0) // Too small for a normal half-float, store as denormal or zero
+	{
+		if (exponent < -10)  return static_cast<uint16_t>(sign);
+		mantissa |= 0x800000; // Implicit leading 1 becomes explicit
+		unsigned int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)  ++half;
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)  ++half; // Round to nearest, a carry into the exponent still gives the correct result
+	return static_cast<uint16_t>(half);
+}
+
+// Encode a unit vector in 32 bits as a point on an octahedron (|x|+|y|+|z| = 1), whose lower half is folded out so the whole
+// octahedron covers a square. The two coordinates are stored as 16-bit signed normalised values (DXGI_FORMAT_R16G16_SNORM)
+uint32_t OctahedralEncode(Vector3 v)
+{
+	float length = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if (length == 0)  return 0;
+	float x = v.x / length;
+	float y = v.y / length;
+	if (v.z < 0)
+	{
+		float foldedX = (1 - std::abs(y)) * (x >= 0 ? 1.0f : -1.0f);
+		y             = (1 - std::abs(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = foldedX;
+	}
+
+	auto toSnorm = [](float f) { return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(std::round(std::clamp(f, -1.0f, 1.0f) * 32767.0f)))); };
+	return toSnorm(x) | (toSnorm(y) << 16);
+}
+
+// Convert a value in the range min to min+range into a 16-bit unsigned normalised value (DXGI_FORMAT_R16_UNORM)
+uint16_t QuantiseToUnorm16(float value, float min, float range)
+{
+	if (range <= 0)  return 0;
+	return static_cast<uint16_t>(std::round(std::clamp((value - min) / range, 0.0f, 1.0f) * 65535.0f));
+}
+
+
+
+//--------------------------------------------------------------------------------------
+// Import Log
+//--------------------------------------------------------------------------------------
+// Assimp has a single global log, but meshes can be imported on several threads at once (see ParseLevel). The log is created
+// by the first import that starts using it and destroyed when the last one ends. Its severity is whichever the first asked for
+
+static std::mutex   gImportLogMutex;
+static unsigned int gImportLogUsers = 0;
+
+void StartImportLog(Assimp::Logger::LogSeverity severity)
+{
+	std::lock_guard<std::mutex> lock(gImportLogMutex);
+	if (gImportLogUsers++ == 0)  Assimp::DefaultLogger::create("", severity);
+}
+
+void EndImportLog()
+{
+	std::lock_guard<std::mutex> lock(gImportLogMutex);
+	if (--gImportLogUsers == 0)  Assimp::DefaultLogger::kill();
+}
+
+
+
 //--------------------------------------------------------------------------------------
 // Mesh Construction
 //--------------------------------------------------------------------------------------
@@ -314,19 +418,19 @@ GeometryTypes SceneGeometryRequirements(const aiScene& scene, std::vector<Assimp
 // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
 // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
 // Optionally pass extra import flags over and above the default. Available flags here are:
-//     OptimiseHierarchy, FlattenHierarchyExceptBones, FlattenHierarchy, UVAxisUp, SelectiveDebone and NoLighting
-Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {}*/)
+//     OptimiseHierarchy, FlattenHierarchyExceptBones, FlattenHierarchy, UVAxisUp, SelectiveDebone, NoLighting,
+//     CompressVertices, CompressPositions, OptimiseVertexOrder and TextureArrays
+// A detail less than 1 simplifies the mesh to about that fraction of its triangles
+Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {}*/, float detail /*= 1.0f*/)
 {
 	// Assimp provides a huge amount of control over how meshes are imported. All assimp import settings are in
 	// variables and constants prefixed by "ai" - hover on any of these, or right-click and "Peek Definition" to see the documention above it
 
+	StartupTimer startupTimer("Mesh " + fileName + (detail < 1.0f ? " (detail " + std::to_string(detail) + ")" : ""));
 	Assimp::Importer importer;
 
 	// Settings for import
-	ImportFlags importFlags = ImportFlags::SimpleUVMapping | ImportFlags::RemoveLinesPoints |
-		                      ImportFlags::RetainHierarchy | ImportFlags::RemoveDegenerates |
-					          ImportFlags::FixNormals      | ImportFlags::Validate;
-	importFlags |= additionalImportFlags;
+	ImportFlags importFlags = FullImportFlags(additionalImportFlags);
 	unsigned int maxVerticesPerMesh  = 65536;     // No submesh will have more than this many vertices, set to 0 for no limit
 	unsigned int maxTrianglesPerMesh = 1000000;   // No submesh will have more than this many triangles, set to 0 for no limit
 	unsigned int maxBonesPerVertex   = 4;         // In skinned meshes, no vertex will be affected by more than this number of bones
@@ -334,14 +438,21 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 	float creaseAngle        = 0.0f;  // Recalculating normals - the min angle between two faces that should look sharp, if this value is 0 the original normals will be retained
 	float tangentCreaseAngle = 45.0f; // Recalculating tangents and bitangents - same idea as above. Best to leave this value at 45 to recalculate, or 0 to keep original data
 
-	mFilepath = fileName;
-	if (mFilepath.is_relative())
-	{
-		mFilepath = std::filesystem::current_path() / "Media" / mFilepath;
-	}
+	mFilepath = MeshPath(fileName);
 	std::string stem      = mFilepath.stem().string();
 	std::string extension = mFilepath.extension().string();
 
+	// If this mesh has been imported before with the same settings, the result is in a cache file. Reading it skips all the work
+	// below (see MeshCache.h)
+	MeshCacheData cacheData;
+	if (ReadMeshCache(mFilepath, static_cast<uint32_t>(importFlags), detail, cacheData))
+	{
+		CreateFromCache(cacheData);
+		return;
+	}
+	cacheData = {};
+	StartupTimer importTimer("Import with assimp"); // The rest of the constructor
+
 
 	//-----------------------------------
 	// First pass at reading file - an analysis to decide how to properly import it
@@ -352,19 +463,32 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 	if (IsSet(importFlags & ImportFlags::Validate)) 
 	{
 		assimpFlags |= aiProcess_ValidateDataStructure;
-		Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
+		StartImportLog(Assimp::Logger::VERBOSE);
 	}
 
 	// Don't want unused materials affecting final geometry requirements (see next section)
 	assimpFlags |= aiProcess_RemoveRedundantMaterials; 
 
-	// First pass file reading
-	const aiScene* scene = importer.ReadFile(mFilepath.string(), assimpFlags);
+	// First pass file reading. A mesh that is only in the asset archive is imported from memory, assimp is given the extension
+	// to identify the format. That only works for formats that keep everything in one file, as all the meshes here do
+	const aiScene* scene = nullptr;
+	std::error_code fileError;
+	if (!std::filesystem::exists(mFilepath, fileError) && gAssetFiles.InArchive(mFilepath))
+	{
+		AssetData file = gAssetFiles.Read(mFilepath);
+		scene = importer.ReadFileFromMemory(file.data(), file.size(), assimpFlags, extension.c_str() + (extension.empty() ? 0 : 1));
+	}
+	else
+	{
+		scene = importer.ReadFile(mFilepath.string(), assimpFlags);
+		auto fileSize = std::filesystem::file_size(mFilepath, fileError);
+		if (!fileError)  gStartupProfile.AddBytesRead(fileSize);
+	}
 
 	// Disable logging again
 	if (IsSet(importFlags & ImportFlags::Validate)) 
 	{
-		Assimp::DefaultLogger::kill();
+		EndImportLog();
 	}
 
 	// Quit if any serious errors
@@ -558,12 +682,12 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 
 	if (IsSet(importFlags & ImportFlags::Validate))
 	{
-		Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
+		StartImportLog(Assimp::Logger::VERBOSE);
 	}
 	scene = importer.ApplyPostProcessing(assimpFlags);
 	if (IsSet(importFlags & ImportFlags::Validate))
 	{
-		Assimp::DefaultLogger::kill();
+		EndImportLog();
 	}
 
 	// Quit on serious errors
@@ -602,13 +726,38 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 	// or skinned objects will contain a tree of nodes, one for each controllable part of the mesh
 	bool filterEmptyNodes = ((importFlags & ImportFlags::HierarchyFlags) == ImportFlags::OptimiseHierarchy); // Can optionally remove nodes with no submeshes, but don't do this if you have dummy nodes
 	unsigned int numNodes = CountDescendantsOf(scene->mRootNode, filterEmptyNodes);
-	mNodes.resize(numNodes);
-	mAbsoluteTransforms.resize(numNodes);
+	ResizeNodes(numNodes);
 	ReadNodes(scene->mRootNode, filterEmptyNodes);
 
+	// Optimising the vertex order reports its results in the import log, so keep a log while processing submeshes
+	bool optimiseVertexOrder = IsSet(importFlags & ImportFlags::OptimiseVertexOrder);
+	if (optimiseVertexOrder)
+	{
+		StartImportLog(Assimp::Logger::NORMAL);
+	}
+
+	// The final vertex and index data of each submesh is kept until the end to write the cache file
+	cacheData.subMeshes.resize(scene->mNumMeshes);
+	std::vector<std::unique_ptr<unsigned char[]>> cacheVertices;
+	std::vector<std::vector<uint32_t>>            cacheIndices;
+	std::vector<std::vector<uint16_t>>            cacheShortIndices;
+
 	// Create collection of all submeshes (each node created above can contain one or more submeshes)
 	// Then loop through each submesh and create our structures / GPU data based on what was imported from assimp
 	mSubMeshes.resize(scene->mNumMeshes);
+	SetSubMeshNodes();
+
+	// If any submesh has bones the whole mesh is skinned. Submeshes without bones are given their own node as their only bone
+	// (see below), so every submesh is drawn with the skinning shaders from the bone palette. A vertex's bone indices are node
+	// numbers stored in 8 bits
+	mHasBones = false;
+	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+	{
+		if (scene->mMeshes[i]->HasBones())  mHasBones = true;
+	}
+	if (mHasBones && NodeCount() > MAX_BONES)
+		throw std::runtime_error("Mesh Import: more than " + std::to_string(MAX_BONES) + " nodes in skinned mesh " + mFilepath.string());
+
 	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
 	{
 		aiMesh* assimpMesh = scene->mMeshes[i];
@@ -616,7 +765,7 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 
 		// Each submesh is named, either with the name from assimp/original file, or a unique name based on the name of the node that contains it
 		subMesh.name = assimpMesh->mName.C_Str();
-		if (subMesh.name == "")  subMesh.name = mNodes[subMesh.nodeIndex].name + std::to_string(i);
+		if (subMesh.name == "")  subMesh.name = mNodeNames[subMesh.nodeIndex] + std::to_string(i);
 		subMesh.materialName = materials[assimpMesh->mMaterialIndex].name; // Each submesh uses just one material, so has just one material name
 
 
@@ -626,11 +775,34 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		// Get render method required for the material used by this submesh, then update it based on the geometry of the submesh
 		// This is now the final render method for this submesh
 		RenderMethod& renderMethod = materialRenderMethods[assimpMesh->mMaterialIndex];
-		renderMethod.geometryRenderMethod = assimpMesh->HasBones() ? GeometryRenderMethod::Skinned : GeometryRenderMethod::Rigid;
+		renderMethod.geometryRenderMethod = mHasBones ? GeometryRenderMethod::Skinned : GeometryRenderMethod::Rigid;
+
+		// Rigid submeshes can be stored in compressed vertex formats, which need vertex shaders that decode them. 16-bit positions
+		// cover the submesh bounding box, the scale and offset that restore them are material constants used by those shaders
+		bool isRigid = renderMethod.geometryRenderMethod == GeometryRenderMethod::Rigid;
+		bool compressPositions = isRigid && IsSet(importFlags & ImportFlags::CompressPositions) && assimpMesh->HasPositions();
+		bool compressVertices  = isRigid && IsSet(importFlags & (ImportFlags::CompressVertices | ImportFlags::CompressPositions));
+		renderMethod.compressedVertices = compressVertices;
+		renderMethod.textureArrays      = IsSet(importFlags & ImportFlags::TextureArrays);
+		renderMethod.constants.positionScale  = { 1, 1, 1 };
+		renderMethod.constants.positionOffset = { 0, 0, 0 };
+		if (compressPositions)
+		{
+			Vector3* assimpPosition = reinterpret_cast<Vector3*>(assimpMesh->mVertices);
+			Vector3 positionMin = assimpPosition[0];
+			Vector3 positionMax = assimpPosition[0];
+			for (unsigned int v = 1; v < assimpMesh->mNumVertices; ++v)
+			{
+				positionMin = { std::min(positionMin.x, assimpPosition[v].x), std::min(positionMin.y, assimpPosition[v].y), std::min(positionMin.z, assimpPosition[v].z) };
+				positionMax = { std::max(positionMax.x, assimpPosition[v].x), std::max(positionMax.y, assimpPosition[v].y), std::max(positionMax.z, assimpPosition[v].z) };
+			}
+			renderMethod.constants.positionScale  = positionMax - positionMin;
+			renderMethod.constants.positionOffset = positionMin;
+		}
 
-		// Create DirectX objects (shaders, texture objects etc.) to match the render method we have identified
+		// Create DirectX objects (shaders, texture objects etc.) to match the render method we have identified, unless headless
 		// Can throw std::runtime_error
-		try
+		if (DX != nullptr) try
 		{
 			subMesh.renderState = std::make_unique<RenderState>(renderMethod);
 		}
@@ -658,8 +830,9 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		{
 			if (!assimpMesh->HasPositions())
 				throw std::runtime_error("Mesh Import: missing positions for mesh/material: " + subMesh.name + "/" + subMesh.materialName + " in " + mFilepath.string());
-			vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 12;
+			DXGI_FORMAT format = compressPositions ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+			vertexElements.push_back({ "position", 0, format, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			offset += compressPositions ? 8 : 12;
 		}
 
 		// Submesh requires vertex normals
@@ -668,8 +841,9 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		{
 			if (!assimpMesh->HasNormals())
 				throw std::runtime_error("Mesh Import: missing normals for mesh/material: " + subMesh.name + "/" + subMesh.materialName + " in " + mFilepath.string());
-			vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 12;
+			DXGI_FORMAT format = compressVertices ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT; // Octahedral encoding when compressed
+			vertexElements.push_back({ "normal", 0, format, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			offset += compressVertices ? 4 : 12;
 		}
 
 		// Submesh requires vertex tangents (used for normal/parallax mapping)
@@ -678,8 +852,9 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		{
 			if (!assimpMesh->HasTangentsAndBitangents())
 				throw std::runtime_error("Mesh Import: missing tangents or bitangents for mesh/material: " + subMesh.name + "/" + subMesh.materialName + " in " + mFilepath.string());
-			vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 12;
+			DXGI_FORMAT format = compressVertices ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT; // Octahedral encoding when compressed
+			vertexElements.push_back({ "tangent", 0, format, 0, tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			offset += compressVertices ? 4 : 12;
 		}
 
 		// Submesh requires vertex bitangents (used for normal/parallax mapping, but often left out and calculated in the shader)
@@ -695,8 +870,20 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		// Submesh requires texture coordinates (UVs)
 		std::string uvName; // Careful - needs to stay in scope until vertexElements is converted to DirectX object below
 		unsigned int uvOffset = offset;
+		bool halfFloatUVs = false;
 		if (IsSet(subMesh.geometryTypes & GeometryTypes::UV))
 		{
+			// Compressed UVs are half-floats, if they are small enough to keep their accuracy
+			if (compressVertices && assimpMesh->HasTextureCoords(0))
+			{
+				halfFloatUVs = true;
+				for (unsigned int v = 0; v < assimpMesh->mNumVertices; ++v)
+				{
+					const aiVector3D& assimpUV = assimpMesh->mTextureCoords[0][v];
+					if (std::abs(assimpUV.x) > MAX_HALF_FLOAT_UV || std::abs(assimpUV.y) > MAX_HALF_FLOAT_UV)  halfFloatUVs = false;
+				}
+			}
+
 			unsigned int uvChannel = 0;
 			int numUVChannels = assimpMesh->GetNumUVChannels();
 			if (numUVChannels > 0)
@@ -708,9 +895,10 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 						if (assimpMesh->mNumUVComponents[j] != 2)  throw std::runtime_error("Unsupported number of texture coordinates in " + subMesh.name + "/" + subMesh.materialName + " in " + mFilepath.string());
 						uvName = "uv";
 						if (numUVChannels > 1)  uvName += std::to_string(uvChannel);
-						vertexElements.push_back({ uvName.c_str(), uvChannel, DXGI_FORMAT_R32G32_FLOAT, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0});
+						DXGI_FORMAT format = halfFloatUVs ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT;
+						vertexElements.push_back({ uvName.c_str(), uvChannel, format, 0, offset, D3D11_INPUT_PER_VERTEX_DATA, 0});
 						++uvChannel;
-						offset += 8;
+						offset += halfFloatUVs ? 4 : 8;
 						break; // Only supporting single UV channel
 					}
 				}
@@ -749,8 +937,6 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		unsigned int bonesOffset = offset;
 		if (IsSet(subMesh.geometryTypes & GeometryTypes::BoneData))
 		{
-			if (!assimpMesh->HasBones())
-				throw std::runtime_error("Mesh Import: missing bones for mesh: " + subMesh.name + " in " + mFilepath.string());
 			vertexElements.push_back({ "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, bonesOffset,     D3D11_INPUT_PER_VERTEX_DATA, 0 });
 			offset += 4;
 			vertexElements.push_back({ "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, bonesOffset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
@@ -761,13 +947,6 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		subMesh.vertexSize = offset;
 
 
-		// Create a "vertex layout" to describe to DirectX what data is in each vertex of this submesh
-		auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
-		HRESULT hr = DX->Device()->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
-			                                         shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(), &subMesh.vertexLayout);
-		if (shaderSignature)  shaderSignature->Release();
-		if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + mFilepath.string());
-
 
 
 		//-----------------------------------
@@ -778,7 +957,7 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		subMesh.numVertices = assimpMesh->mNumVertices;
 		subMesh.numIndices  = assimpMesh->mNumFaces * 3;
 		auto vertices = std::make_unique<unsigned char[]>(subMesh.numVertices * subMesh.vertexSize);
-		auto indices  = std::make_unique<unsigned char[]>(subMesh.numIndices * 4); // Always using 32 bit indexes (4 bytes) for each index here
+		std::vector<uint32_t> indices(subMesh.numIndices); // A vector for the mesh optimiser functions, small compared to the vertices
 
 
 		//-----------------------------------
@@ -791,9 +970,25 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 			Vector3* assimpPosition = reinterpret_cast<Vector3*>(assimpMesh->mVertices);
 			unsigned char* position = vertices.get() + positionOffset;
 			unsigned char* positionEnd = position + subMesh.numVertices * subMesh.vertexSize;
+			subMesh.boundsMin = subMesh.boundsMax = *assimpPosition; // Also find the bounding box of the positions for culling
+			Vector3 quantiseMin   = renderMethod.constants.positionOffset; // Bounding box for compressed positions
+			Vector3 quantiseRange = renderMethod.constants.positionScale;
 			while (position != positionEnd)
 			{
-				*(Vector3*)position = *assimpPosition;
+				if (compressPositions)
+				{
+					uint16_t* quantised = (uint16_t*)position;
+					quantised[0] = QuantiseToUnorm16(assimpPosition->x, quantiseMin.x, quantiseRange.x);
+					quantised[1] = QuantiseToUnorm16(assimpPosition->y, quantiseMin.y, quantiseRange.y);
+					quantised[2] = QuantiseToUnorm16(assimpPosition->z, quantiseMin.z, quantiseRange.z);
+					quantised[3] = 0xFFFF; // Unused by the shaders
+				}
+				else
+				{
+					*(Vector3*)position = *assimpPosition;
+				}
+				subMesh.boundsMin = { std::min(subMesh.boundsMin.x, assimpPosition->x), std::min(subMesh.boundsMin.y, assimpPosition->y), std::min(subMesh.boundsMin.z, assimpPosition->z) };
+				subMesh.boundsMax = { std::max(subMesh.boundsMax.x, assimpPosition->x), std::max(subMesh.boundsMax.y, assimpPosition->y), std::max(subMesh.boundsMax.z, assimpPosition->z) };
 				position += subMesh.vertexSize;
 				++assimpPosition;
 			}
@@ -807,7 +1002,8 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 			unsigned char* normalEnd = normal + subMesh.numVertices * subMesh.vertexSize;
 			while (normal != normalEnd)
 			{
-				*(Vector3*)normal = *assimpNormal;
+				if (compressVertices)  *(uint32_t*)normal = OctahedralEncode(*assimpNormal);
+				else                   *(Vector3*)normal = *assimpNormal;
 				normal += subMesh.vertexSize;
 				++assimpNormal;
 			}
@@ -821,7 +1017,8 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 			unsigned char* tangentEnd = tangent + subMesh.numVertices * subMesh.vertexSize;
 			while (tangent != tangentEnd)
 			{
-				*(Vector3*)tangent = *assimpTangent;
+				if (compressVertices)  *(uint32_t*)tangent = OctahedralEncode(*assimpTangent);
+				else                   *(Vector3*)tangent = *assimpTangent;
 				tangent += subMesh.vertexSize;
 				++assimpTangent;
 			}
@@ -851,7 +1048,15 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 				unsigned char* uvEnd = uv + subMesh.numVertices * subMesh.vertexSize;
 				while (uv != uvEnd)
 				{
-					*(Vector2*)uv = { assimpUV->x, assimpUV->y };
+					if (halfFloatUVs)
+					{
+						((uint16_t*)uv)[0] = FloatToHalf(assimpUV->x);
+						((uint16_t*)uv)[1] = FloatToHalf(assimpUV->y);
+					}
+					else
+					{
+						*(Vector2*)uv = { assimpUV->x, assimpUV->y };
+					}
 					uv += subMesh.vertexSize;
 					++assimpUV;
 				}
@@ -875,90 +1080,55 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 			}
 		}
 
-		// TODO
-		//if (mHasBones)
-		//{
-		//	if (assimpMesh->HasBones())
-		//	{
-		//		// Set all bones and weights to 0 to start with
-		//		unsigned char* bones = vertices.get() + bonesOffset;
-		//		unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-		//		while (bones != bonesEnd)
-		//		{
-		//			memset(bones, 0, 20);
-		//			bones += subMesh.vertexSize;
-		//		}
-
-		//		for (auto& node : mNodes)
-		//		{
-		//			node.offsetMatrix = Matrix4x4::Identity;
-		//		}
-
-		//		// Go through each assimp bone
-		//		bones = vertices.get() + bonesOffset;
-		//		for (unsigned int i = 0; i < assimpMesh->mNumBones; ++i)
-		//		{
-		//			// Get offset matrix for the bone (transform from skinned mesh root to bone root)
-		//			aiBone* assimpBone = assimpMesh->mBones[i];
-		//			std::string boneName = assimpBone->mName.C_Str();
-		//			unsigned int nodeIndex;
-		//			for (nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-		//			{
-		//				if (mNodes[nodeIndex].name == boneName)
-		//				{
-		//					mNodes[nodeIndex].offsetMatrix = Matrix4x4(&assimpBone->mOffsetMatrix.a1);
-		//					mNodes[nodeIndex].offsetMatrix.Transpose(); // Assimp stores matrices differently to this app
-		//					break;
-		//				}
-		//			}
-		//			if (nodeIndex == mNodes.size())  throw std::runtime_error("Bone with no matching node in " + mFilepath.string());
-
-		//			// Go through each weight of the bone and update the vertex it influences
-		//			// Find the first 0 weight on that vertex and put the new influence / weight there.
-		//			// A vertex can only have up to 4 influences
-		//			for (unsigned int j = 0; j < assimpBone->mNumWeights; ++j)
-		//			{
-		//				unsigned int vertexIndex = assimpBone->mWeights[j].mVertexId;
-		//				unsigned char* bone = bones + vertexIndex * subMesh.vertexSize;
-		//				float* weight = (float*)(bone + 4);
-		//				float* lastWeight = weight + 3;
-		//				while (*weight != 0.0f && weight != lastWeight)
-		//				{
-		//					bone++; weight++;
-		//				}
-		//				if (*weight == 0.0f)
-		//				{
-		//					*bone = static_cast<uint8_t>(nodeIndex);
-		//					*weight = assimpBone->mWeights[j].mWeight;
-		//				}
-		//			}
-		//		}
-		//	}
-		//	else
-		//	{
-		//		// In a mesh that uses skinning any sub-meshes that don't contain bones are given bones so the whole mesh can use one shader
-		//		unsigned int subMeshNode = 0;
-		//		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-		//		{
-		//			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
-		//			{
-		//				if (subMeshIndex == m)
-		//					subMeshNode = nodeIndex;
-		//			}
-		//		}
-
-		//		unsigned char* bones = vertices.get() + bonesOffset;
-		//		unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
-		//		while (bones != bonesEnd)
-		//		{
-		//			memset(bones, 0, 20);
-		//			bones[0] = static_cast<uint8_t>(subMeshNode);
-		//			*(float*)(bones + 4) = 1.0f;
-		//			bones += subMesh.vertexSize;
-		//		}
-		//	}
-		//}
+		// Copy bone indices and weights for skinning. Each bone is a node of the mesh, a vertex's bone indices are node numbers
+		if (IsSet(subMesh.geometryTypes & GeometryTypes::BoneData))
+		{
+			unsigned char* bones = vertices.get() + bonesOffset;
+			unsigned char* bonesEnd = bones + subMesh.numVertices * subMesh.vertexSize;
+			if (assimpMesh->HasBones())
+			{
+				// Start with no influences on any vertex
+				for (unsigned char* bone = bones; bone != bonesEnd; bone += subMesh.vertexSize)  memset(bone, 0, 20);
+
+				for (unsigned int b = 0; b < assimpMesh->mNumBones; ++b)
+				{
+					aiBone* assimpBone = assimpMesh->mBones[b];
+					auto node = std::find(mNodeNames.begin(), mNodeNames.end(), assimpBone->mName.C_Str());
+					if (node == mNodeNames.end())  throw std::runtime_error("Mesh Import: bone with no matching node in " + mFilepath.string());
+					unsigned int nodeIndex = static_cast<unsigned int>(node - mNodeNames.begin());
+
+					// The offset matrix transforms from the skinned mesh's space to the bone's (see WriteBones)
+					mOffsetMatrices[nodeIndex] = Matrix4x4(&assimpBone->mOffsetMatrix.a1);
+					mOffsetMatrices[nodeIndex].Transpose(); // Assimp stores matrices differently to this app
 
+					// Put each weight in the first unused influence of its vertex. aiProcess_LimitBoneWeights has left at most four
+					for (unsigned int w = 0; w < assimpBone->mNumWeights; ++w)
+					{
+						unsigned char* bone = bones + assimpBone->mWeights[w].mVertexId * subMesh.vertexSize;
+						float* weight = (float*)(bone + 4);
+						for (unsigned int influence = 0; influence < 4; ++influence)
+						{
+							if (weight[influence] == 0.0f)
+							{
+								bone[influence]   = static_cast<uint8_t>(nodeIndex);
+								weight[influence] = assimpBone->mWeights[w].mWeight;
+								break;
+							}
+						}
+					}
+				}
+			}
+			else
+			{
+				// A submesh without bones in a skinned mesh moves rigidly with the node holding it, its only bone
+				for (unsigned char* bone = bones; bone != bonesEnd; bone += subMesh.vertexSize)
+				{
+					memset(bone, 0, 20);
+					bone[0] = static_cast<uint8_t>(subMesh.nodeIndex);
+					*(float*)(bone + 4) = 1.0f;
+				}
+			}
+		}
 
 
 		//-----------------------------------
@@ -968,7 +1138,7 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 		if (!assimpMesh->HasFaces())  throw std::runtime_error("No face data in " + subMesh.name + " in " + mFilepath.string());
 
 		// Copy assimp faces to our index array
-		uint32_t* index = reinterpret_cast<uint32_t*>(indices.get()); // Will always use 4 byte indexes here (2-byte indexes are possible for some memory savings)
+		uint32_t* index = indices.data();
 		for (unsigned int face = 0; face < assimpMesh->mNumFaces; ++face)
 		{
 			*index++ = assimpMesh->mFaces[face].mIndices[0];
@@ -976,37 +1146,247 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 			*index++ = assimpMesh->mFaces[face].mIndices[2];
 		}
 
+		// For a lower level of detail, remove triangles by merging nearby vertices (see MeshOptimiser.h). The positions from
+		// assimp still match the vertex numbers at this point
+		bool simplify = detail < 1.0f;
+		if (simplify)
+		{
+			SimplifyMesh(indices, reinterpret_cast<Vector3*>(assimpMesh->mVertices), subMesh.numVertices, detail);
+			subMesh.numIndices = static_cast<unsigned int>(indices.size());
+		}
+
+		// Optionally reorder the triangles for the vertex cache then for overdraw, then reorder the vertices to match (see
+		// MeshOptimiser.h). Assimp's aiProcess_ImproveCacheLocality has already been applied, but this does better and also
+		// considers overdraw. The ACMR (vertices shaded per triangle) before and after is logged
+		float acmrBefore = 0;
+		if (optimiseVertexOrder)
+		{
+			acmrBefore = AverageCacheMissRatio(indices, subMesh.numVertices);
+			OptimiseVertexCache(indices, subMesh.numVertices);
+			OptimiseOverdraw(indices, reinterpret_cast<Vector3*>(assimpMesh->mVertices), subMesh.numVertices);
+		}
+
+		// Reordering the vertices by first use also puts the vertices a simplified mesh no longer uses at the end, where they can
+		// be dropped
+		if (optimiseVertexOrder || simplify)
+		{
+			auto oldVertices = OptimiseVertexFetch(indices, subMesh.numVertices);
+			if (simplify)
+			{
+				unsigned int usedVertices = 0;
+				for (uint32_t index : indices)  usedVertices = std::max(usedVertices, index + 1);
+				subMesh.numVertices = usedVertices;
+			}
+			auto reorderedVertices = std::make_unique<unsigned char[]>(subMesh.numVertices * subMesh.vertexSize);
+			for (unsigned int v = 0; v < subMesh.numVertices; ++v)
+			{
+				std::memcpy(reorderedVertices.get() + v * subMesh.vertexSize, vertices.get() + oldVertices[v] * subMesh.vertexSize, subMesh.vertexSize);
+			}
+			vertices = std::move(reorderedVertices);
+		}
+
+		if (optimiseVertexOrder)
+		{
+			float acmrAfter = AverageCacheMissRatio(indices, subMesh.numVertices);
+
+			std::ostringstream message;
+			message << std::fixed << std::setprecision(3) << "Mesh Import: optimised vertex order of " << subMesh.name << " in "
+			        << mFilepath.string() << ", ACMR " << acmrBefore << " -> " << acmrAfter;
+			Assimp::DefaultLogger::get()->info(message.str().c_str());
+		}
+
+		// 2-byte indexes if compressing and every vertex can be reached with them
+		bool shortIndices = IsSet(importFlags & (ImportFlags::CompressVertices | ImportFlags::CompressPositions)) && subMesh.numVertices <= 65536;
+		std::vector<uint16_t> shortIndexData;
+		if (shortIndices)
+		{
+			shortIndexData.resize(subMesh.numIndices);
+			for (unsigned int i = 0; i < subMesh.numIndices; ++i)  shortIndexData[i] = static_cast<uint16_t>(indices[i]);
+		}
+
 
 		//-----------------------------------
-		// Finally, with CPU-side vertex and index arrays complete for this submesh, create a matching DirectX
-		// vertex and index buffer GPU-side. Then loop for all other submeshes
+		// Finally, with CPU-side vertex and index arrays complete for this submesh, copy them into the GPU-side buffers shared
+		// by all geometry with this vertex layout. The vertex elements describe the layout to DirectX. Then loop for all other submeshes
+		// Headless meshes have no GPU side, the arrays above were only needed for the bounds and the cache
+		if (DX != nullptr) try
+		{
+			if (shortIndices)
+				subMesh.geometry = DX->Geometry()->AddGeometry(vertexElements, subMesh.vertexSize, vertices.get(), subMesh.numVertices,
+				                                               shortIndexData.data(), subMesh.numIndices);
+			else
+				subMesh.geometry = DX->Geometry()->AddGeometry(vertexElements, subMesh.vertexSize, vertices.get(), subMesh.numVertices,
+				                                               indices.data(), subMesh.numIndices);
+		}
+		catch (std::runtime_error e)
+		{
+			throw std::runtime_error(std::string(e.what()) + " for " + mFilepath.string());
+		}
 
-		D3D11_BUFFER_DESC bufferDesc    = {};
-		D3D11_SUBRESOURCE_DATA initData = {};
+		// A second layout for instanced rendering, if the material supports it
+		CreateInstancedLayout(subMesh);
 
-		// Create GPU-side vertex buffer and copy the vertices imported by assimp into it
-		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Indicate it is a vertex buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-		bufferDesc.ByteWidth = subMesh.numVertices * subMesh.vertexSize; // Size of the buffer in bytes
-		bufferDesc.CPUAccessFlags = 0;
-		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = vertices.get(); // Fill the new vertex buffer with CPU-side vertex data we created above
 
-		hr = DX->Device()->CreateBuffer(&bufferDesc, &initData, &subMesh.vertexBuffer);
-		if (FAILED(hr))  throw std::runtime_error("Failure creating vertex buffer for " + mFilepath.string());
+		//-----------------------------------
+		// Record the finished submesh for the cache. Moving the arrays doesn't move their contents, so the pointers stay valid
+		auto& cacheSubMesh = cacheData.subMeshes[i];
+		cacheSubMesh.name          = subMesh.name;
+		cacheSubMesh.materialName  = subMesh.materialName;
+		cacheSubMesh.geometryTypes = subMesh.geometryTypes;
+		cacheSubMesh.renderMethod  = renderMethod;
+		for (auto& element : vertexElements)
+		{
+			cacheSubMesh.vertexElements.push_back({ element.SemanticName, element.SemanticIndex, element.Format, element.AlignedByteOffset });
+		}
+		cacheSubMesh.vertexSize   = subMesh.vertexSize;
+		cacheSubMesh.numVertices  = subMesh.numVertices;
+		cacheSubMesh.numIndices   = subMesh.numIndices;
+		cacheSubMesh.shortIndices = shortIndices;
+		cacheSubMesh.boundsMin    = subMesh.boundsMin;
+		cacheSubMesh.boundsMax    = subMesh.boundsMax;
+		cacheSubMesh.vertices     = vertices.get();
+		cacheVertices.push_back(std::move(vertices));
+		if (shortIndices)
+		{
+			cacheSubMesh.indices = shortIndexData.data();
+			cacheShortIndices.push_back(std::move(shortIndexData));
+		}
+		else
+		{
+			cacheSubMesh.indices = indices.data();
+			cacheIndices.push_back(std::move(indices));
+		}
+	}
 
+	if (optimiseVertexOrder)
+	{
+		EndImportLog();
+	}
+
+	// With all the submeshes read, calculate the bounding volumes used to cull the mesh when it is off screen
+	CalculateBounds();
+	PrepareInstancing();
+
+	// Save the result so the next load doesn't need to import. A cache that can't be written only costs time. The cache keeps
+	// each node's children, found from the parents
+	cacheData.maxNodeDepth = mMaxNodeDepth;
+	cacheData.boundsMin    = mBoundsMin;
+	cacheData.boundsMax    = mBoundsMax;
+	cacheData.hasBounds    = mHasBoundingBox;
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		auto subMeshes = NodeSubMeshes(nodeIndex);
+		cacheData.nodes.push_back({ mNodeNames[nodeIndex], mDefaultTransforms[nodeIndex], mOffsetMatrices[nodeIndex], mParentIndices[nodeIndex],
+		                            mNodeDepths[nodeIndex], { subMeshes.begin(), subMeshes.end() }, {} });
+		if (nodeIndex > 0)  cacheData.nodes[mParentIndices[nodeIndex]].children.push_back(nodeIndex);
+	}
+	WriteMeshCache(mFilepath, static_cast<uint32_t>(importFlags), detail, cacheData);
+}
 
-		// Create GPU-side index buffer and copy the vertices imported by assimp into it
-		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER; // Indicate it is an index buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-		bufferDesc.ByteWidth = subMesh.numIndices * sizeof(uint32_t); // Size of the buffer in bytes, will always use 4 byte indexes here
-		bufferDesc.CPUAccessFlags = 0;
-		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = indices.get(); // Fill the new index buffer with CPU-side index data we created above
 
-		hr = DX->Device()->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer);
-		if (FAILED(hr))  throw std::runtime_error("Failure creating index buffer for " + mFilepath.string());
+// Read and check the cache file of a mesh ahead of constructing it with the same settings. Returns false if there is no up to
+// date cache
+bool Mesh::Preload(const std::string& fileName, ImportFlags additionalImportFlags /* = {}*/, float detail /*= 1.0f*/)
+{
+	return PreloadMeshCache(MeshPath(fileName), static_cast<uint32_t>(FullImportFlags(additionalImportFlags)), detail);
+}
+
+
+// Read the bounding box a mesh will have from its cache file's header, without constructing it. Returns false if the mesh has
+// no up to date cache or no bounding box
+bool Mesh::ReadBounds(const std::string& fileName, ImportFlags additionalImportFlags, float detail, Vector3& boundsMin, Vector3& boundsMax)
+{
+	return ReadMeshCacheBounds(MeshPath(fileName), static_cast<uint32_t>(FullImportFlags(additionalImportFlags)), detail, boundsMin, boundsMax);
+}
+
+
+// The full path of a mesh file, relative names are in the Media folder
+std::filesystem::path Mesh::MeshPath(const std::string& fileName)
+{
+	std::filesystem::path path = fileName;
+	if (path.is_relative())  path = std::filesystem::current_path() / "Media" / path;
+	return path;
+}
+
+
+// The import flags a mesh is imported with, the defaults plus the given ones
+ImportFlags Mesh::FullImportFlags(ImportFlags additionalImportFlags)
+{
+	return ImportFlags::SimpleUVMapping | ImportFlags::RemoveLinesPoints |
+	       ImportFlags::RetainHierarchy | ImportFlags::RemoveDegenerates |
+	       ImportFlags::FixNormals      | ImportFlags::Validate | additionalImportFlags;
+}
+
+
+// Create the nodes, sub-meshes and GPU data of a mesh read from a cache file rather than imported (see MeshCache.h). The data is
+// exactly what the import above created, so only the render states and the GPU geometry need to be made
+void Mesh::CreateFromCache(const MeshCacheData& data)
+{
+	mMaxNodeDepth = data.maxNodeDepth;
+	ResizeNodes(static_cast<unsigned int>(data.nodes.size()));
+	for (unsigned int i = 0; i < data.nodes.size(); ++i)
+	{
+		auto& cacheNode = data.nodes[i];
+		mNodeNames[i]         = cacheNode.name;
+		mDefaultTransforms[i] = cacheNode.transform;
+		mOffsetMatrices[i]    = cacheNode.offsetMatrix;
+		mParentIndices[i]     = cacheNode.parentIndex;
+		mNodeDepths[i]        = cacheNode.depth;
+		mNodeSubMeshes[i]     = { static_cast<uint32_t>(mNodeSubMeshIndices.size()), static_cast<uint32_t>(cacheNode.subMeshes.size()) };
+		mNodeSubMeshIndices.insert(mNodeSubMeshIndices.end(), cacheNode.subMeshes.begin(), cacheNode.subMeshes.end());
 	}
+
+	mSubMeshes.resize(data.subMeshes.size());
+	SetSubMeshNodes();
+	for (unsigned int i = 0; i < data.subMeshes.size(); ++i)
+	{
+		auto& cacheSubMesh = data.subMeshes[i];
+		SubMesh& subMesh = mSubMeshes[i];
+		subMesh.name          = cacheSubMesh.name;
+		subMesh.materialName  = cacheSubMesh.materialName;
+		subMesh.geometryTypes = cacheSubMesh.geometryTypes;
+		subMesh.vertexSize    = cacheSubMesh.vertexSize;
+		subMesh.numVertices   = cacheSubMesh.numVertices;
+		subMesh.numIndices    = cacheSubMesh.numIndices;
+		subMesh.boundsMin     = cacheSubMesh.boundsMin;
+		subMesh.boundsMax     = cacheSubMesh.boundsMax;
+		if (cacheSubMesh.renderMethod.geometryRenderMethod == GeometryRenderMethod::Skinned)  mHasBones = true;
+
+		if (DX != nullptr) try
+		{
+			subMesh.renderState = std::make_unique<RenderState>(cacheSubMesh.renderMethod);
+		}
+		catch (std::runtime_error e)
+		{
+			throw std::runtime_error("Mesh Import: cannot create render state for mesh / material: " + subMesh.name + " / " + subMesh.materialName + " in " + mFilepath.string() + " - " + std::string(e.what()));
+		}
+
+		// The semantic names point into the cache data, which outlives the call below
+		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+		for (auto& element : cacheSubMesh.vertexElements)
+		{
+			vertexElements.push_back({ element.semanticName.c_str(), element.semanticIndex, element.format, 0, element.offset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		}
+
+		if (DX != nullptr) try
+		{
+			if (cacheSubMesh.shortIndices)
+				subMesh.geometry = DX->Geometry()->AddGeometry(vertexElements, subMesh.vertexSize, cacheSubMesh.vertices, subMesh.numVertices,
+				                                               static_cast<const uint16_t*>(cacheSubMesh.indices), subMesh.numIndices);
+			else
+				subMesh.geometry = DX->Geometry()->AddGeometry(vertexElements, subMesh.vertexSize, cacheSubMesh.vertices, subMesh.numVertices,
+				                                               static_cast<const uint32_t*>(cacheSubMesh.indices), subMesh.numIndices);
+		}
+		catch (std::runtime_error e)
+		{
+			throw std::runtime_error(std::string(e.what()) + " for " + mFilepath.string());
+		}
+
+		CreateInstancedLayout(subMesh);
+	}
+
+	CalculateBounds();
+	PrepareInstancing();
 }
 
 
@@ -1020,12 +1400,20 @@ Mesh::Mesh(const std::string& fileName, ImportFlags additionalImportFlags /* = {
 // Optionally select whether to create normals (upwards), and/or UVs (0->1 square over the entire grid)
 // If UVs requested optionally indicate how many repeats of the texture are required in X and Z (defaults to 1)
 Mesh::Mesh(Vector3 minPt, Vector3 maxPt, int subDivX, int subDivZ, bool normals /*= false*/, bool uvs /*= true*/, float uvRepeatX /*= 1*/, float uvRepeatZ /*= 1*/)
-	: mNodes{ { "Grid", Matrix4x4::Identity, Matrix4x4::Identity, 0, 1, {0}, {} } },  // Create a single root node, using one submesh and no children
-	  mSubMeshes{ 1 }, mMaxNodeDepth{ 1 }, mHasBones{ false }, mFilepath{}
+	: mSubMeshes{ 1 }, mMaxNodeDepth{ 1 }, mHasBones{ false }, mFilepath{}
 {
+	// Create a single root node, using one submesh and no children
+	ResizeNodes(1);
+	mNodeNames[0] = "Grid";
+	mNodeSubMeshes[0] = { 0, 1 };
+	mNodeSubMeshIndices = { 0 };
+
 	mSubMeshes[0].nodeIndex = 0;
 	mSubMeshes[0].name = "Grid0";
 	mSubMeshes[0].materialName = "";
+	mSubMeshes[0].boundsMin = { std::min(minPt.x, maxPt.x), minPt.y, std::min(minPt.z, maxPt.z) };
+	mSubMeshes[0].boundsMax = { std::max(minPt.x, maxPt.x), minPt.y, std::max(minPt.z, maxPt.z) }; // Grid is flat at minPt.y
+	CalculateBounds();
 
 
 	//-----------------------------------
@@ -1082,13 +1470,6 @@ Mesh::Mesh(Vector3 minPt, Vector3 maxPt, int subDivX, int subDivZ, bool normals
 
 	mSubMeshes[0].vertexSize = offset;
 
-	// Create a vertex layout object from above array - used by DirectX to understand the data in each vertex of this mesh
-	auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
-	HRESULT hr = DX->Device()->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
-		                                         shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),	&mSubMeshes[0].vertexLayout);
-	if (shaderSignature)  shaderSignature->Release();
-	if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for grid mesh");
-
 
 	//-----------------------------------
 	// Create grid
@@ -1162,34 +1543,87 @@ Mesh::Mesh(Vector3 minPt, Vector3 maxPt, int subDivX, int subDivZ, bool normals
 
   
 	//-----------------------------------
-	// Create vertex / index buffer
+	// Copy vertices / indices to the GPU
+
+	// Added to the shared buffers for this vertex layout, the vertex elements describe the layout to DirectX
+	try
+	{
+		mSubMeshes[0].geometry = DX->Geometry()->AddGeometry(vertexElements, mSubMeshes[0].vertexSize, vertexData.get(), mSubMeshes[0].numVertices,
+		                                                     reinterpret_cast<uint32_t*>(indexData.get()), mSubMeshes[0].numIndices);
+	}
+	catch (std::runtime_error e)
+	{
+		throw std::runtime_error(std::string(e.what()) + " for grid mesh");
+	}
+	CreateInstancedLayout(mSubMeshes[0]);
+
+	PrepareInstancing();
+}
+
+
+// Special mesh constructor to create a box from minPt to maxPt in a plain unlit colour, a single node with positions only
+Mesh::Mesh(Vector3 minPt, Vector3 maxPt, ColourRGB colour)
+	: mSubMeshes{ 1 }, mMaxNodeDepth{ 1 }, mHasBones{ false }, mFilepath{}
+{
+	ResizeNodes(1);
+	mNodeNames[0] = "Box";
+	mNodeSubMeshes[0] = { 0, 1 };
+	mNodeSubMeshIndices = { 0 };
+
+	mSubMeshes[0].nodeIndex = 0;
+	mSubMeshes[0].name = "Box0";
+	mSubMeshes[0].materialName = "";
+	mSubMeshes[0].boundsMin = { std::min(minPt.x, maxPt.x), std::min(minPt.y, maxPt.y), std::min(minPt.z, maxPt.z) };
+	mSubMeshes[0].boundsMax = { std::max(minPt.x, maxPt.x), std::max(minPt.y, maxPt.y), std::max(minPt.z, maxPt.z) };
+	CalculateBounds();
 
-	// Create the vertex buffer and fill it with the loaded vertex data
-	D3D11_BUFFER_DESC bufferDesc = {};
-	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT; // Not a dynamic buffer
-	bufferDesc.ByteWidth = mSubMeshes[0].numVertices * mSubMeshes[0].vertexSize; // Buffer size
-	bufferDesc.CPUAccessFlags = 0;
-	bufferDesc.MiscFlags = 0;
-	D3D11_SUBRESOURCE_DATA initData = {}; // Initial data
-	initData.pSysMem = vertexData.get();   
-	if (FAILED(DX->Device()->CreateBuffer( &bufferDesc, &initData, &mSubMeshes[0].vertexBuffer)))
+	RenderMethod renderMethod;
+	renderMethod.geometryRenderMethod = GeometryRenderMethod::Rigid;
+	renderMethod.surfaceRenderMethod  = SurfaceRenderMethod::UnlitColour;
+	renderMethod.constants.diffuseColour = { colour.r, colour.g, colour.b, 1.0f };
+	try
+	{
+		mSubMeshes[0].renderState = std::make_unique<RenderState>(renderMethod);
+	}
+	catch (std::runtime_error e)
 	{
-		throw std::runtime_error("Failure creating vertex buffer for grid mesh");
+		throw std::runtime_error("Box Mesh: cannot create render state - " + std::string(e.what()));
 	}
 
+	std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+	vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+	mSubMeshes[0].geometryTypes = GeometryTypes::Position;
+	mSubMeshes[0].vertexSize = sizeof(Vector3);
+
+	// The eight corners, bit 0 of the index selects max x, bit 1 max y and bit 2 max z
+	const Vector3& boxMin = mSubMeshes[0].boundsMin;
+	const Vector3& boxMax = mSubMeshes[0].boundsMax;
+	Vector3 vertices[8];
+	for (int i = 0; i < 8; ++i)
+		vertices[i] = { (i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z };
+
+	// Two triangles for each face, clockwise seen from outside
+	uint32_t indices[] = { 0, 2, 3,  0, 3, 1,   // -z
+	                       4, 5, 7,  4, 7, 6,   // +z
+	                       0, 4, 6,  0, 6, 2,   // -x
+	                       1, 3, 7,  1, 7, 5,   // +x
+	                       0, 1, 5,  0, 5, 4,   // -y
+	                       2, 6, 7,  2, 7, 3 }; // +y
+	mSubMeshes[0].numVertices = 8;
+	mSubMeshes[0].numIndices  = static_cast<unsigned int>(std::size(indices));
 
-	// Create the index buffer
-	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	bufferDesc.ByteWidth = mSubMeshes[0].numIndices * 4;
-	bufferDesc.CPUAccessFlags = 0;
-	bufferDesc.MiscFlags = 0;
-	initData.pSysMem = indexData.get();   
-	if (FAILED(DX->Device()->CreateBuffer( &bufferDesc, &initData, &mSubMeshes[0].indexBuffer)))
+	try
+	{
+		mSubMeshes[0].geometry = DX->Geometry()->AddGeometry(vertexElements, mSubMeshes[0].vertexSize, vertices, mSubMeshes[0].numVertices,
+		                                                     indices, mSubMeshes[0].numIndices);
+	}
+	catch (std::runtime_error e)
 	{
-		throw std::runtime_error("Failure creating index buffer for grid mesh");
+		throw std::runtime_error(std::string(e.what()) + " for box mesh");
 	}
+	CreateInstancedLayout(mSubMeshes[0]);
+
+	PrepareInstancing();
 }
 
 
@@ -1199,38 +1633,55 @@ Mesh::Mesh(Vector3 minPt, Vector3 maxPt, int subDivX, int subDivZ, bool normals
 //--------------------------------------------------------------------------------------
 
 // Helper function for Render function - renders the given sub-mesh. Material RenderState mu
-void Mesh::RenderSubMesh(const SubMesh& subMesh)
+void Mesh::RenderSubMesh(const SubMesh& subMesh, bool applyMaterial /*= true*/)
 {
-	subMesh.renderState->Apply();
+	if (applyMaterial)  subMesh.renderState->Apply();
 
-	// Set vertex buffer as next data source for GPU
-	UINT stride = subMesh.vertexSize;
-	UINT offset = 0;
-	DX->Context()->IASetVertexBuffers(0, 1, &subMesh.vertexBuffer.p, &stride, &offset);
+	// Set the shared vertex and index buffers holding the sub-mesh, and its vertex layout, as the next data source for the GPU.
+	// Nothing is changed if they are already set, e.g. from drawing another sub-mesh with the same layout
+	DX->Geometry()->Bind(subMesh.geometry);
 
-	// Indicate the layout of vertex buffer
-	DX->Context()->IASetInputLayout(subMesh.vertexLayout);
+	// Render the sub-mesh's range of the buffers
+	DX->Context()->DrawIndexed(subMesh.numIndices, subMesh.geometry.startIndex, subMesh.geometry.baseVertex);
+	gRenderCounters.Add(RenderCounter::Draws);
+}
 
-	// Set index buffer as next data source for GPU, indicate it uses 32-bit integers
-	DX->Context()->IASetIndexBuffer(subMesh.indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+// Render a single sub-mesh with its material into the given device context, whose current state is in the given caches
+void Mesh::RenderQueuedSubMesh(unsigned int subMesh, ID3D11DeviceContext* context, RenderStateCache& stateCache,
+                               GeometryManager::Bindings& bindings)
+{
+	const SubMesh& queuedSubMesh = mSubMeshes[subMesh];
+	queuedSubMesh.renderState->Apply(context, stateCache);
+	DX->Geometry()->Bind(context, bindings, queuedSubMesh.geometry);
+	context->DrawIndexed(queuedSubMesh.numIndices, queuedSubMesh.geometry.startIndex, queuedSubMesh.geometry.baseVertex);
+	gRenderCounters.Add(RenderCounter::Draws);
+}
 
-	// Using triangle lists only in this class
-	DX->Context()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+// Helper function for RenderInstanced - renders the given number of instances of a sub-mesh, with world matrices from the
+// instance buffer starting at firstMatrix. The instance buffer must already be set on vertex buffer slot 1
+void Mesh::RenderSubMeshInstanced(const SubMesh& subMesh, unsigned int firstMatrix, unsigned int numInstances)
+{
+	subMesh.renderState->Apply(true);
+	DX->Geometry()->Bind(subMesh.geometry, true);
 
-	// Render mesh
-	DX->Context()->DrawIndexed(subMesh.numIndices, 0, 0);
+	// The start instance offsets the per-instance data only, so each draw reads its own range of the instance buffer
+	DX->Context()->DrawIndexedInstanced(subMesh.numIndices, numInstances, subMesh.geometry.startIndex, subMesh.geometry.baseVertex, firstMatrix);
+	gRenderCounters.Add(RenderCounter::Draws);
 }
 
 // Calculate the absolute matrix for given node given a set of mesh transforms 
 Matrix4x4 Mesh::AbsoluteMatrix(const std::vector<Matrix4x4>& transforms, unsigned int node)
+{
+	return AbsoluteMatrix(transforms[0], transforms.data() + 1, node);
+}
+
+// As above, but the root matrix is given separately from the matrices for nodes 1 onwards
+Matrix4x4 Mesh::AbsoluteMatrix(const Matrix4x4& root, const Matrix4x4* nodes, unsigned int node)
 {
 	// Mesh transformation matrices in child nodes are stored relative to their parent's matrix (recall animation in 2nd year Graphics)
-	mAbsoluteTransforms[0] = transforms[0]; // First matrix for a model is the root matrix, already in world space
-	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
-	{
-		// Multiply each model matrix by its parent's absolute world matrix
-		mAbsoluteTransforms[nodeIndex] = transforms[nodeIndex] * mAbsoluteTransforms[mNodes[nodeIndex].parentIndex];
-	}
+	// First matrix for a model is the root matrix, already in world space, then each model matrix is multiplied by its parent's
+	// absolute world matrix
+	MultiplyByParents(root, nodes, mParentIndices.data(), NodeCount(), mAbsoluteTransforms.data());
 	return mAbsoluteTransforms[node];
 }
 
@@ -1247,7 +1698,7 @@ void Mesh::Render(const std::vector<Matrix4x4>& transforms /*= {}*/, ColourRGBA
 	{
 		// World matrix is always identity matrix
 		gPerMeshConstants.worldMatrix = Matrix4x4::Identity;
-		DX->CBuffers()->UpdateCBuffer(gPerMeshConstantBuffer, gPerMeshConstants); // Send to GPU
+		DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants); // Send to GPU
 
 		// Render submeshes directly, no need to consider nodes
 		for (auto& subMesh : mSubMeshes)
@@ -1258,29 +1709,29 @@ void Mesh::Render(const std::vector<Matrix4x4>& transforms /*= {}*/, ColourRGBA
 
 	// Mesh transformation matrices in child nodes are stored relative to their parent's matrix (recall animation in 2nd year Graphics)
 	// This is good for animation but we need absolute world space matrices to render - so calculate all the absolute matrices first
-	mAbsoluteTransforms[0] = transforms[0]; // First matrix for a model is the root matrix, already in world space
-	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
-	{
-		// Multiply each model matrix by its parent's absolute world matrix
-		mAbsoluteTransforms[nodeIndex] = transforms[nodeIndex] * mAbsoluteTransforms[mNodes[nodeIndex].parentIndex];
-	}
+	AbsoluteMatrix(transforms, 0);
+	Render(mAbsoluteTransforms.data(), colour);
+}
+
+
+// Render the mesh given the world matrix of every node
+void Mesh::Render(const Matrix4x4* worldMatrices, ColourRGBA colour /*= { 1, 1, 1, 1 }*/, const Frustum* cullFrustum /*= nullptr*/)
+{
+	PROFILE_SCOPE("Mesh::Render");
+	gPerMeshConstants.meshColour = colour;
 
 	if (mHasBones) // Render a mesh that uses skinning
 	{
-		// Advanced point: the above loop will get the absolute world matrices **of the bones**. However, they are
+		// Advanced point: the world matrices given are the absolute world matrices **of the bones**. However, they are
 		// not actually rendered, they merely influence the skinned mesh, which has its origin at a particular node.
 		// So for each bone there is a fixed offset (transform) between where that bone is and where the root of the
-		// skinned mesh is. We need to apply that offset to each of the bone matrices calculated in the last loop to make
-		// the bone influences work on the skinned mesh.
+		// skinned mesh is. We need to apply that offset to each of the bone matrices to make the bone influences work
+		// on the skinned mesh.
 		// These offset matrices are fixed for the model and were already calculated when the mesh was imported
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-			mAbsoluteTransforms[nodeIndex] = mNodes[nodeIndex].offsetMatrix * mAbsoluteTransforms[nodeIndex];
-
-		// Send all matrices over to the GPU for skinning via a constant buffer - each matrix can represent a bone which influences nearby vertices
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
-			gPerMeshConstants.boneMatrices[nodeIndex] = mAbsoluteTransforms[nodeIndex];
-
-		DX->CBuffers()->UpdateCBuffer(gPerMeshConstantBuffer, gPerMeshConstants); // Send to GPU
+		// Send all matrices over to the GPU for skinning via the bone palette - each matrix can represent a bone which influences
+		// nearby vertices. Only the small skinning constants saying where the matrices are go in a constant buffer
+		if (!WriteBones(&worldMatrices, 1))  return;
+		DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants); // For the mesh colour
 
 		// All matrices for the entire mesh have been sent over to the GPU which makes this loop simple - we can
 		// render all submeshes directly and do not need to iterate through the nodes (unlike non-skinning code below)
@@ -1290,24 +1741,388 @@ void Mesh::Render(const std::vector<Matrix4x4>& transforms /*= {}*/, ColourRGBA
 	else
 	{
 		// Render a mesh without skinning. First iterate through each node
-		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
 		{
+			// Skip nodes with nothing to draw, and nodes that are off screen if a frustum was given
+			const BoundingSphere& bounds = mNodeSpheres[nodeIndex];
+			if (bounds.IsEmpty())  continue;
+			if (cullFrustum != nullptr && !cullFrustum->IsSphereVisible(bounds.Transformed(worldMatrices[nodeIndex])))  continue;
+
 			// Send this node's matrix to the GPU via a constant buffer
-			gPerMeshConstants.worldMatrix = mAbsoluteTransforms[nodeIndex];
-			DX->CBuffers()->UpdateCBuffer(gPerMeshConstantBuffer, gPerMeshConstants); // Send to GPU
+			gPerMeshConstants.worldMatrix = worldMatrices[nodeIndex];
+			DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants); // Send to GPU
 
 			// Render the sub-meshes attached to this node (no bones - rigid movement)
-			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+			for (auto subMeshIndex : NodeSubMeshes(nodeIndex))
 				RenderSubMesh(mSubMeshes[subMeshIndex]);
 		}
 	}
 }
 
 
+// Render only the geometry of the mesh using the shaders already set on the GPU rather than the mesh's own materials
+void Mesh::RenderGeometry(const Matrix4x4* worldMatrices, ColourRGBA colour /*= { 1, 1, 1, 1 }*/)
+{
+	PROFILE_SCOPE("Mesh::RenderGeometry");
+	if (mHasBones)  return; // Would need a skinning vertex shader
+
+	gPerMeshConstants.meshColour = colour;
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		if (mNodeSubMeshes[nodeIndex].count == 0)  continue;
+
+		gPerMeshConstants.worldMatrix = worldMatrices[nodeIndex];
+		DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+		for (auto subMeshIndex : NodeSubMeshes(nodeIndex))
+			RenderSubMesh(mSubMeshes[subMeshIndex], false);
+	}
+}
+
+
+// Add the draws needed to render the mesh to a render queue rather than rendering now
+void Mesh::QueueRender(RenderQueue& queue, const Matrix4x4* worldMatrices, ColourRGBA colour /*= { 1, 1, 1, 1 }*/,
+                       const Frustum* cullFrustum /*= nullptr*/)
+{
+	if (mHasBones)
+	{
+		Render(worldMatrices, colour, cullFrustum);
+		return;
+	}
+
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		// Skip nodes with nothing to draw, and nodes that are off screen if a frustum was given, as in Render
+		const BoundingSphere& bounds = mNodeSpheres[nodeIndex];
+		if (bounds.IsEmpty())  continue;
+		BoundingSphere worldBounds = bounds.Transformed(worldMatrices[nodeIndex]);
+		if (cullFrustum != nullptr && !cullFrustum->IsSphereVisible(worldBounds))  continue;
+
+		// All the node's sub-meshes share its world matrix
+		float distance = Distance(gPerCameraConstants.cameraPosition, worldBounds.centre);
+		unsigned int object = queue.AddObject(worldMatrices[nodeIndex], colour);
+		for (auto subMeshIndex : NodeSubMeshes(nodeIndex))
+			queue.AddDraw(this, subMeshIndex, mSubMeshes[subMeshIndex].renderState.get(), object, distance, worldBounds.radius);
+	}
+}
+
+
+// Write the world matrices of one instance of the mesh into the area of the instance buffer for a batch of instances
+void Mesh::WriteInstanceMatrices(const Matrix4x4* worldMatrices, Matrix4x4* batch, unsigned int instance, unsigned int numInstances)
+{
+	// The matrices for each drawn node are together, so each of the node's sub-meshes can be drawn with one call
+	for (unsigned int i = 0; i < mDrawnNodes.size(); ++i)
+		batch[i * numInstances + instance] = worldMatrices[mDrawnNodes[i]];
+}
+
+
+// Write the bone matrices of the given instances of a skinned mesh to the bone palette, one after another, and send the skinning
+// constants saying where they are. Returns false if the palette couldn't be written
+bool Mesh::WriteBones(const Matrix4x4* const* instanceWorldMatrices, unsigned int numInstances)
+{
+	unsigned int numBones = NodeCount();
+	BonePalette::BoneMatrix* bones = DX->Bones()->Begin(numBones * numInstances);
+	if (bones == nullptr)  return false;
+	for (unsigned int instance = 0; instance < numInstances; ++instance)
+	{
+		const Matrix4x4* worldMatrices = instanceWorldMatrices[instance];
+		for (unsigned int nodeIndex = 0; nodeIndex < numBones; ++nodeIndex)
+			(bones++)->Set(mOffsetMatrices[nodeIndex] * worldMatrices[nodeIndex]);
+	}
+	gSkinningConstants.boneOffset       = DX->Bones()->End();
+	gSkinningConstants.bonesPerInstance = numBones;
+	DX->CBuffers()->UpdateDrawCBuffer(gSkinningConstantBuffer, SKINNING_CBUFFER_SLOT, gSkinningConstants);
+	return true;
+}
+
+
+// Render several instances of a skinned mesh with one draw call per sub-mesh, given the world matrices of every node of each
+void Mesh::RenderSkinnedInstanced(const Matrix4x4* const* instanceWorldMatrices, unsigned int numInstances,
+                                  ColourRGBA colour /*= { 1, 1, 1, 1 }*/)
+{
+	PROFILE_SCOPE("Mesh::RenderSkinnedInstanced");
+	if (!mHasBones || numInstances == 0)  return;
+	if (!WriteBones(instanceWorldMatrices, numInstances))  return;
+	gPerMeshConstants.meshColour = colour;
+	DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+
+	// Skinned vertex shaders find each instance's bones from SV_InstanceID, so the usual layout and shaders are used, with no
+	// instance buffer
+	for (auto& subMesh : mSubMeshes)
+	{
+		subMesh.renderState->Apply();
+		DX->Geometry()->Bind(subMesh.geometry);
+		DX->Context()->DrawIndexedInstanced(subMesh.numIndices, numInstances, subMesh.geometry.startIndex, subMesh.geometry.baseVertex, 0);
+		gRenderCounters.Add(RenderCounter::Draws);
+	}
+}
+
+
+// Draw a few indices of each sub-mesh with every version of its material whose shaders and layout the pre-warm hasn't drawn yet.
+// Not counted in the render counters, they are not part of a frame
+void Mesh::Prewarm(ShaderPrewarm& prewarm)
+{
+	for (auto& subMesh : mSubMeshes)
+	{
+		if (subMesh.renderState == nullptr || subMesh.numIndices == 0)  continue; // No GPU data in headless mode
+
+		// Skinned instances use the usual shaders and layout (see RenderSkinnedInstanced), only rigid meshes have instanced ones
+		bool instancing = mCanRenderInstanced && subMesh.instancedVertexLayout != nullptr;
+		for (RenderState* renderState = subMesh.renderState.get(); renderState != nullptr; renderState = renderState->LowerShaderLOD())
+		{
+			for (bool instanced : { false, true })
+			{
+				if (instanced && !instancing)  continue;
+				auto [vertexShader, pixelShader] = renderState->Shaders(instanced);
+				auto layout = instanced ? subMesh.instancedVertexLayout : subMesh.geometry.pool->vertexLayout;
+				if (!prewarm.FirstUse(vertexShader, pixelShader, layout))  continue;
+
+				renderState->Apply(instanced);
+				DX->Geometry()->Bind(subMesh.geometry, instanced);
+				DX->Context()->DrawIndexed(std::min(subMesh.numIndices, 3u), subMesh.geometry.startIndex, subMesh.geometry.baseVertex);
+			}
+		}
+	}
+}
+
+
+// Render a batch of instances of the mesh in one draw call per sub-mesh, with the matrices written by WriteInstanceMatrices
+void Mesh::RenderInstanced(ID3D11Buffer* instanceBuffer, unsigned int firstMatrix, unsigned int numInstances, ColourRGBA colour /*= { 1, 1, 1, 1 }*/)
+{
+	PROFILE_SCOPE("Mesh::RenderInstanced");
+	PrepareInstancedRender(instanceBuffer, colour);
+	for (unsigned int i = 0; i < mDrawnNodes.size(); ++i)
+	{
+		for (auto subMeshIndex : NodeSubMeshes(mDrawnNodes[i]))
+			RenderSubMeshInstanced(mSubMeshes[subMeshIndex], firstMatrix + i * numInstances, numInstances);
+	}
+}
+
+
+// Append the indirect draw arguments for a batch of instances, one per sub-mesh in the order RenderInstancedIndirect draws them.
+// The instance counts start at 0, the culling compute shader adds one to each of them for every visible instance
+void Mesh::WriteIndirectArgs(std::vector<D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS>& args, unsigned int firstMatrix, unsigned int numInstances)
+{
+	for (unsigned int i = 0; i < mDrawnNodes.size(); ++i)
+	{
+		for (auto subMeshIndex : NodeSubMeshes(mDrawnNodes[i]))
+		{
+			auto& subMesh = mSubMeshes[subMeshIndex];
+			args.push_back({ subMesh.numIndices, 0, subMesh.geometry.startIndex, static_cast<INT>(subMesh.geometry.baseVertex),
+			                 firstMatrix + i * numInstances });
+		}
+	}
+}
+
+
+// Render a batch of instances with the indirect arguments written by WriteIndirectArgs, starting at firstArg in the argument buffer
+void Mesh::RenderInstancedIndirect(ID3D11Buffer* instanceBuffer, ID3D11Buffer* argsBuffer, unsigned int firstArg, ColourRGBA colour /*= { 1, 1, 1, 1 }*/)
+{
+	PROFILE_SCOPE("Mesh::RenderInstancedIndirect");
+	PrepareInstancedRender(instanceBuffer, colour);
+	unsigned int arg = firstArg;
+	for (auto nodeIndex : mDrawnNodes)
+	{
+		for (auto subMeshIndex : NodeSubMeshes(nodeIndex))
+		{
+			auto& subMesh = mSubMeshes[subMeshIndex];
+			subMesh.renderState->Apply(true);
+			DX->Geometry()->Bind(subMesh.geometry, true);
+			DX->Context()->DrawIndexedInstancedIndirect(argsBuffer, arg * sizeof(D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS));
+			gRenderCounters.Add(RenderCounter::Draws);
+			++arg;
+		}
+	}
+}
+
+
 //--------------------------------------------------------------------------------------
 // Helper functions
 //--------------------------------------------------------------------------------------
 
+// Bind the per-mesh constants with the given colour, and the instance buffer to vertex buffer slot 1, for instanced rendering
+void Mesh::PrepareInstancedRender(ID3D11Buffer* instanceBuffer, ColourRGBA colour)
+{
+	// The colour is the same for the whole batch so still comes from the per-mesh constants, the world matrix there is unused
+	gPerMeshConstants.meshColour = colour;
+	DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+
+	UINT stride = sizeof(Matrix4x4);
+	UINT offset = 0;
+	DX->Context()->IASetVertexBuffers(1, 1, &instanceBuffer, &stride, &offset);
+}
+
+
+// Get the input layout for instanced rendering of a sub-mesh from its geometry pool - its ordinary layout with the world matrix of
+// each instance added as four rows read from vertex buffer slot 1, once per instance. The layout is left empty if the sub-mesh's
+// material has no instanced vertex shader or the layout can't be created, then the mesh isn't rendered instanced
+void Mesh::CreateInstancedLayout(SubMesh& subMesh)
+{
+	if (subMesh.renderState == nullptr || !subMesh.renderState->CanRenderInstanced())  return; // No render state if headless
+	subMesh.instancedVertexLayout = DX->Geometry()->InstancedVertexLayout(subMesh.geometry);
+}
+
+
+// Find the nodes drawn by instanced rendering and whether the whole mesh can be rendered instanced, once all the sub-meshes
+// have been created. Skinned meshes don't use the instance buffer, see RenderSkinnedInstanced
+void Mesh::PrepareInstancing()
+{
+	mDrawnNodes.clear();
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		if (mNodeSubMeshes[nodeIndex].count > 0)  mDrawnNodes.push_back(nodeIndex);
+	}
+
+	mCanRenderInstanced = !mHasBones;
+	for (auto& subMesh : mSubMeshes)
+	{
+		if (subMesh.instancedVertexLayout == nullptr)  mCanRenderInstanced = false;
+	}
+}
+
+
+// Size the node arrays for the given number of nodes, with every node a root-level node with no sub-meshes until it is set
+void Mesh::ResizeNodes(unsigned int numNodes)
+{
+	mParentIndices.assign(numNodes, 0);
+	mDefaultTransforms.assign(numNodes, Matrix4x4::Identity);
+	mOffsetMatrices.assign(numNodes, Matrix4x4::Identity);
+	mNodeDepths.assign(numNodes, 1);
+	mNodeSubMeshes.assign(numNodes, {});
+	mNodeSubMeshIndices.clear();
+	mNodeSpheres.assign(numNodes, {});
+	mNodeBoxes.assign(numNodes, {});
+	mNodeNames.assign(numNodes, {});
+	mAbsoluteTransforms.resize(numNodes);
+}
+
+
+// Set each sub-mesh's node from the nodes' sub-mesh ranges
+void Mesh::SetSubMeshNodes()
+{
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		for (auto subMeshIndex : NodeSubMeshes(nodeIndex))
+		{
+			if (subMeshIndex < mSubMeshes.size())  mSubMeshes[subMeshIndex].nodeIndex = nodeIndex;
+		}
+	}
+}
+
+
+// Calculate the node and mesh bounds from the sub-mesh bounds once all the nodes and sub-meshes have been created
+void Mesh::CalculateBounds()
+{
+	// Each node's bounds enclose the boxes of all the sub-meshes it uses
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		BoundingSphere& sphere = mNodeSpheres[nodeIndex];
+		NodeBox& box = mNodeBoxes[nodeIndex];
+		sphere = {};
+		auto subMeshes = NodeSubMeshes(nodeIndex);
+		if (subMeshes.empty())  continue;
+
+		box.boundsMin = mSubMeshes[subMeshes[0]].boundsMin;
+		box.boundsMax = mSubMeshes[subMeshes[0]].boundsMax;
+		for (auto subMeshIndex : subMeshes)
+		{
+			const SubMesh& subMesh = mSubMeshes[subMeshIndex];
+			box.boundsMin = { std::min(box.boundsMin.x, subMesh.boundsMin.x), std::min(box.boundsMin.y, subMesh.boundsMin.y), std::min(box.boundsMin.z, subMesh.boundsMin.z) };
+			box.boundsMax = { std::max(box.boundsMax.x, subMesh.boundsMax.x), std::max(box.boundsMax.y, subMesh.boundsMax.y), std::max(box.boundsMax.z, subMesh.boundsMax.z) };
+		}
+		sphere.centre = (box.boundsMin + box.boundsMax) * 0.5f;
+		sphere.radius = (box.boundsMax - box.boundsMin).Length() * 0.5f;
+	}
+
+	// A skinned mesh's vertices are not in the space of the node that holds them, so its bounds are not known without the bone
+	// matrices. Use a sphere that is never culled
+	mHasBoundingBox = false;
+	if (mHasBones)
+	{
+		mBoundingSphere = { { 0, 0, 0 }, FLT_MAX };
+		return;
+	}
+
+	// The whole mesh bounds must still enclose the geometry when nodes are rotated, which is how the game animates them. So for
+	// each node find the distance from its origin that its geometry and all of its descendants' geometry can reach whatever
+	// the rotations. Nodes are stored depth-first so working backwards visits every child before its parent
+	std::vector<float> reach(NodeCount(), -1.0f);
+	for (unsigned int nodeIndex = NodeCount() - 1; nodeIndex > 0; --nodeIndex)
+	{
+		const BoundingSphere& sphere = mNodeSpheres[nodeIndex];
+		if (!sphere.IsEmpty())
+			reach[nodeIndex] = std::max(reach[nodeIndex], sphere.centre.Length() + sphere.radius);
+		if (reach[nodeIndex] < 0.0f)  continue;
+
+		// Distance the node's geometry can reach from the parent's origin
+		const Matrix4x4& t = mDefaultTransforms[nodeIndex];
+		float maxScale = std::max({ t.XAxis().Length(), t.YAxis().Length(), t.ZAxis().Length() });
+		float reachFromParent = Vector3{ t.e30, t.e31, t.e32 }.Length() + reach[nodeIndex] * maxScale;
+		unsigned int parentIndex = mParentIndices[nodeIndex];
+		if (parentIndex != 0)
+		{
+			reach[parentIndex] = std::max(reach[parentIndex], reachFromParent);
+		}
+		else
+		{
+			// Children of the root are rotated around their own origin in root space, which gives a tighter sphere than one
+			// around the root origin
+			mBoundingSphere.Merge({ { t.e30, t.e31, t.e32 }, reach[nodeIndex] * maxScale });
+		}
+	}
+
+	// Geometry in the root node itself is not affected by node animation
+	mBoundingSphere.Merge(mNodeSpheres[0]);
+
+	// The box of the whole mesh in root space encloses the corners of each node's box with the nodes in their default
+	// transforms. Parents come before their children so each node's matrix to root space is built from its parent's
+	std::vector<Matrix4x4> toRoot(NodeCount(), Matrix4x4::Identity);
+	for (unsigned int nodeIndex = 0; nodeIndex < NodeCount(); ++nodeIndex)
+	{
+		if (nodeIndex > 0)  toRoot[nodeIndex] = mDefaultTransforms[nodeIndex] * toRoot[mParentIndices[nodeIndex]];
+		if (mNodeSpheres[nodeIndex].IsEmpty())  continue;
+
+		const NodeBox& box = mNodeBoxes[nodeIndex];
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			Vector3 local = { (corner & 1) ? box.boundsMax.x : box.boundsMin.x,
+			                  (corner & 2) ? box.boundsMax.y : box.boundsMin.y,
+			                  (corner & 4) ? box.boundsMax.z : box.boundsMin.z };
+			Vector4 transformed = toRoot[nodeIndex].TransformPoint(local);
+			Vector3 point = { transformed.x, transformed.y, transformed.z };
+			if (!mHasBoundingBox)
+			{
+				mBoundsMin = mBoundsMax = point;
+				mHasBoundingBox = true;
+			}
+			mBoundsMin = { std::min(mBoundsMin.x, point.x), std::min(mBoundsMin.y, point.y), std::min(mBoundsMin.z, point.z) };
+			mBoundsMax = { std::max(mBoundsMax.x, point.x), std::max(mBoundsMax.y, point.y), std::max(mBoundsMax.z, point.z) };
+		}
+	}
+}
+
+
+// Add the memory used by this mesh to the given totals
+void Mesh::AddMemory(MeshMemory& memory)
+{
+	memory.cpuBytes += sizeof(Mesh) + mSubMeshes.capacity() * sizeof(SubMesh) +
+	                   (mAbsoluteTransforms.capacity() + mDefaultTransforms.capacity() + mOffsetMatrices.capacity()) * sizeof(Matrix4x4) +
+	                   (mParentIndices.capacity() + mNodeDepths.capacity()) * sizeof(uint32_t) +
+	                   mNodeSubMeshes.capacity() * sizeof(SubMeshRange) + mNodeSubMeshIndices.capacity() * sizeof(unsigned int) +
+	                   mNodeSpheres.capacity() * sizeof(BoundingSphere) + mNodeBoxes.capacity() * sizeof(NodeBox) +
+	                   mNodeNames.capacity() * sizeof(std::string) + mDrawnNodes.capacity() * sizeof(unsigned int);
+	for (const std::string& name : mNodeNames)  memory.cpuBytes += name.capacity();
+
+	for (SubMesh& subMesh : mSubMeshes)
+	{
+		unsigned int indexSize = (subMesh.geometry.pool != nullptr) ? subMesh.geometry.pool->indexSize : 4;
+		memory.vertexBytes += static_cast<uint64_t>(subMesh.numVertices) * subMesh.vertexSize;
+		memory.indexBytes  += static_cast<uint64_t>(subMesh.numIndices) * indexSize;
+		memory.cpuBytes    += subMesh.name.capacity() + subMesh.materialName.capacity();
+		if (subMesh.renderState != nullptr)  subMesh.renderState->AddMemory(memory);
+	}
+}
+
+
 // Read assimp node and its children and place in mNodes vector at position nodeIndex. Optionally filter out nodes with no submeshes (filterEmpty)
 // Recursive function, first call only needs first two parameters. Returns first nodeIndex into mNodes after the nodes inserted
 unsigned int Mesh::ReadNodes(aiNode* assimpNode, bool filterEmpty, unsigned int nodeIndex /*= 0*/, unsigned int parentIndex /*= 0*/,
@@ -1325,28 +2140,25 @@ unsigned int Mesh::ReadNodes(aiNode* assimpNode, bool filterEmpty, unsigned int
 	}
 	else
 	{
-		auto& node = mNodes[nodeIndex];
 		unsigned int thisIndex = nodeIndex;
 		++nodeIndex;
 
-		node.name = assimpNode->mName.C_Str(); // Note: in UTF-8 format
-		node.parentIndex = parentIndex;
-		node.depth = depth;
+		mNodeNames[thisIndex] = assimpNode->mName.C_Str(); // Note: in UTF-8 format
+		mParentIndices[thisIndex] = parentIndex;
+		mNodeDepths[thisIndex] = depth;
 
 		// Include any transforms passed in from filtered parent nodes
-		node.transform = filteredTransform * Matrix4x4(&assimpNode->mTransformation.a1).Transpose();
+		mDefaultTransforms[thisIndex] = filteredTransform * Matrix4x4(&assimpNode->mTransformation.a1).Transpose();
 
-		// Reference meshes controlled by this node
-		node.subMeshes.resize(assimpNode->mNumMeshes);
+		// Reference meshes controlled by this node. Nodes are read in order, so its range goes at the end of the shared array
+		mNodeSubMeshes[thisIndex] = { static_cast<uint32_t>(mNodeSubMeshIndices.size()), assimpNode->mNumMeshes };
 		for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
 		{
-			node.subMeshes[i] = assimpNode->mMeshes[i];
+			mNodeSubMeshIndices.push_back(assimpNode->mMeshes[i]);
 		}
 
-		node.children.resize(assimpNode->mNumChildren);
 		for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
 		{
-			node.children[i] = nodeIndex;
 			nodeIndex = ReadNodes(assimpNode->mChildren[i], filterEmpty, nodeIndex, thisIndex, depth + 1, Matrix4x4::Identity);
 		}
 	}
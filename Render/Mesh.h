@@ -10,8 +10,11 @@
 
 #include "MeshTypes.h"
 #include "RenderMethod.h"
+#include "RenderQueue.h"
+#include "Geometry.h"
 
 #include "Matrix4x4.h"
+#include "Frustum.h"
 #include "ColourTypes.h"
 #include "Utility.h"
 
@@ -23,6 +26,11 @@
 #include <filesystem>
 #include <string>
 #include <memory>
+#include <span>
+#include <vector>
+
+struct MeshCacheData;
+class ShaderPrewarm;
 
 
 /*-----------------------------------------------------------------------------------------
@@ -45,6 +53,10 @@ enum class ImportFlags : uint32_t
 	SelectiveDebone             = 0x80,  // Remove bones from meshes that are only affected by one bone (will be animated by node transforms only)
 	NoLighting                  = 0x100, // Do not use a lighting model for this mesh - will be plain colour or plain texture
 	Validate                    = 0x200, // Additional validation and logging of import and post-processing
+	CompressVertices            = 0x400, // Use 16-bit indices where a submesh has few enough vertices, half-float UVs and 32-bit octahedral normals/tangents (rigid submeshes only)
+	CompressPositions           = 0x800, // Also store positions as 16-bit values, scaled to each submesh's bounding box. Implies CompressVertices
+	OptimiseVertexOrder         = 0x1000, // Reorder triangles for the vertex cache and overdraw, and vertices for fetching, logging the ACMR (see MeshOptimiser.h)
+	TextureArrays               = 0x2000, // Share texture arrays with other materials that have textures of the same types, sizes and formats (metalness/roughness PBR materials only, see TextureManager::AddToTextureArrays)
 };
 // Use above enum as flags (adds bitwise operators)
 ENUM_FLAG_OPERATORS(ImportFlags)
@@ -62,8 +74,24 @@ public:
     // Pass the name of the mesh file to load. Uses assimp (https://github.com/assimp/assimp) to support many file types
     // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
 	// Optionally pass extra import flags over and above the default. Available flags here are:
-	//     OptimiseHierarchy, FlattenHierarchyExceptBones, FlattenHierarchy, UVAxisUp, SelectiveDebone and NoLighting
-	Mesh(const std::string& fileName, ImportFlags additionalImportFlags = {});
+	//     OptimiseHierarchy, FlattenHierarchyExceptBones, FlattenHierarchy, UVAxisUp, SelectiveDebone, NoLighting,
+	//     CompressVertices, CompressPositions and OptimiseVertexOrder
+	// Pass a detail less than 1 to simplify the mesh to about that fraction of its triangles, for a lower level of detail (see
+	// SimplifyMesh in MeshOptimiser.h). Unused vertices are removed too
+	// The imported mesh is saved in a cache file beside the mesh file, later loads read that instead of importing (see MeshCache.h)
+	// If there is no DX device (headless mode, see Main.cpp) only the nodes and bounds are kept. No GPU buffers or render states
+	// are created, so the mesh must not be rendered
+	Mesh(const std::string& fileName, ImportFlags additionalImportFlags = {}, float detail = 1.0f);
+
+	// Read and check the cache file of a mesh ahead of constructing it with the same settings, so the constructor only needs to
+	// create the render states and GPU data (see PreloadMeshCache in MeshCache.h). Needs no device, so can run before it exists,
+	// on any thread. Returns false if the mesh has no up to date cache, the constructor then imports it as usual
+	static bool Preload(const std::string& fileName, ImportFlags additionalImportFlags = {}, float detail = 1.0f);
+
+	// Read the bounding box a mesh will have from its cache file's header, without constructing it or reading the rest of the
+	// cache (see ReadMeshCacheBounds in MeshCache.h), e.g. to size a stand-in while it loads. Returns false if the mesh has no
+	// up to date cache or no bounding box
+	static bool ReadBounds(const std::string& fileName, ImportFlags additionalImportFlags, float detail, Vector3& boundsMin, Vector3& boundsMax);
 
 	
 	// Special mesh constructor to creates a grid mesh without needing a file
@@ -72,6 +100,10 @@ public:
 	// If UVs requested optionally indicate how many repeats of the texture are required in X and Z (defaults to same as subdivisions)
 	Mesh(Vector3 minPt, Vector3 maxPt, int subDivX, int subDivZ, bool normals = false, bool uvs = true, float uvRepeatX = 1, float uvRepeatZ = 1);
 
+	// Special mesh constructor to create a box from minPt to maxPt without needing a file, in the given plain unlit colour. A single
+	// node with positions only, e.g. a stand-in for a mesh still loading (see EntityManager::CreateEntity)
+	Mesh(Vector3 minPt, Vector3 maxPt, ColourRGB colour);
+
 
 	/*-----------------------------------------------------------------------------------------
 		Data Access
@@ -79,14 +111,61 @@ public:
 public:
 	// How many nodes are in the hierarchy for this mesh. Nodes can control individual parts (rigid body animation),
 	// or bones (skinned animation), or they can be dummy nodes to control child parts in a more convenient way
-	unsigned int NodeCount()  { return static_cast<unsigned int>(mNodes.size()); }
+	unsigned int NodeCount()  { return static_cast<unsigned int>(mParentIndices.size()); }
+
+	// The parent of a node, nodes are stored depth-first so the parent always comes before the node. The root's parent is itself
+	unsigned int ParentNode(unsigned int node)  { return mParentIndices[node]; }
+
+	// How many sub-meshes the mesh has, each is a separate draw call
+	unsigned int SubMeshCount()  { return static_cast<unsigned int>(mSubMeshes.size()); }
+
+	// Whether the mesh is skinned - its sub-meshes are moved by the bone matrices rather than by the matrices of their nodes
+	bool HasBones()  { return mHasBones; }
+
+	// The node, render state and GPU geometry of a sub-mesh, for code combining the geometry of several meshes into one (see
+	// StaticBatcher.h). The pointers are valid for as long as the mesh
+	struct SubMeshGeometry
+	{
+		unsigned int                  node;
+		RenderState*                  renderState;
+		const GeometryManager::Range* geometry;
+		unsigned int                  numVertices;
+		unsigned int                  numIndices;
+	};
+	SubMeshGeometry GetSubMeshGeometry(unsigned int subMesh)
+	{
+		const SubMesh& source = mSubMeshes[subMesh];
+		return { source.nodeIndex, source.renderState.get(), &source.geometry, source.numVertices, source.numIndices };
+	}
 
     // The default transformation matrix for a given node - used to set the initial position for a new model
-    Matrix4x4 DefaultTransform(unsigned int node) { return mNodes[node].transform; }
+    Matrix4x4 DefaultTransform(unsigned int node) { return mDefaultTransforms[node]; }
+
+	// The name of a node from the mesh file, e.g. to find a node by name. Not used when rendering
+	const std::string& NodeName(unsigned int node)  { return mNodeNames[node]; }
 
 	// Calculate the absolute matrix for given node given a set of mesh transforms 
 	Matrix4x4 AbsoluteMatrix(const std::vector<Matrix4x4>& transforms, unsigned int node);
 
+	// As above, but the root matrix is given separately from the (parent-relative) matrices for the other nodes. The nodes array
+	// must hold NodeCount()-1 matrices, for nodes 1 onwards. Can be nullptr if the mesh has only a root node
+	// The rendering functions below take the absolute (world) matrices of every node instead, so they can be calculated once
+	// and kept (see Entity::WorldTransforms). This function calculates them all into an array in the mesh, so is not thread-safe
+	Matrix4x4 AbsoluteMatrix(const Matrix4x4& root, const Matrix4x4* nodes, unsigned int node);
+
+	// Sphere enclosing the whole mesh in the space of the root matrix. It stays valid when nodes are rotated or scaled relative
+	// to their default transform (e.g. a turning gun turret), but not if nodes are moved away from their default positions
+	const BoundingSphere& GetBoundingSphere()  { return mBoundingSphere; }
+
+	// Box enclosing the whole mesh in the space of the root matrix with every node in its default transform, made from the
+	// vertex positions at import. Much tighter than the sphere for meshes whose nodes don't move (e.g. rocks and other
+	// obstacles). Returns false for a skinned mesh or one with no geometry, their box isn't known
+	bool GetBoundingBox(Vector3& boxMin, Vector3& boxMax)  { boxMin = mBoundsMin;  boxMax = mBoundsMax;  return mHasBoundingBox; }
+
+	// Add the memory used by this mesh to the given totals: the vertex and index data of each sub-mesh, its render states and
+	// their textures and constants, and the node hierarchy and other data kept on the CPU
+	void AddMemory(MeshMemory& memory);
+
 
 	/*-----------------------------------------------------------------------------------------
 		Usage
@@ -96,6 +175,65 @@ public:
 	// Handles rigid body meshes (including single part meshes) as well as skinned meshes
 	void Render(const std::vector<Matrix4x4>& transforms = {}, ColourRGBA colour = { 1, 1, 1, 1 });
 
+	// As above, but given the world matrix of every node, NodeCount() matrices (see AbsoluteMatrix)
+	// If a frustum is given, nodes whose geometry is entirely outside it are not rendered. Test the whole mesh against the
+	// frustum before calling this (see GetBoundingSphere), this only removes individual parts of a mesh that is partly visible
+	void Render(const Matrix4x4* worldMatrices, ColourRGBA colour = { 1, 1, 1, 1 }, const Frustum* cullFrustum = nullptr);
+
+	// Render only the geometry of the mesh using the shaders already set on the GPU rather than the mesh's own materials, e.g. to
+	// write entity IDs for picking. Set a vertex shader that only reads positions. Matrices as above. Skinned meshes are not rendered
+	void RenderGeometry(const Matrix4x4* worldMatrices, ColourRGBA colour = { 1, 1, 1, 1 });
+
+	// Add the draws needed to render the mesh to a render queue rather than rendering now, so they can be sorted by render state
+	// with the draws of other meshes (see RenderQueue.h). Matrices and frustum culling as for Render. Skinned meshes are rendered
+	// immediately instead, their bone matrices are not queued
+	void QueueRender(RenderQueue& queue, const Matrix4x4* worldMatrices, ColourRGBA colour = { 1, 1, 1, 1 }, const Frustum* cullFrustum = nullptr);
+
+	// Render a single sub-mesh with its material, for the render queue. The per-mesh constants must already be set
+	void RenderQueuedSubMesh(unsigned int subMesh)  { RenderSubMesh(mSubMeshes[subMesh]); }
+
+	// As above, but record the draw into the given device context, whose current state is in the given caches. Used by the render
+	// queue to record draws into deferred contexts on worker threads. Only reads the mesh, so safe while other threads do the same
+	void RenderQueuedSubMesh(unsigned int subMesh, ID3D11DeviceContext* context, RenderStateCache& stateCache, GeometryManager::Bindings& bindings);
+
+
+	// Instanced rendering draws many entities that share this mesh with one draw call per sub-mesh, with the world matrices of
+	// each entity's nodes taken from an instance buffer (see InstanceBuffer.h). Node frustum culling is not done for instances
+	//
+	// Whether the mesh can be rendered instanced - meshes without bones whose materials all have instanced vertex shaders. Skinned
+	// meshes are instanced with RenderSkinnedInstanced below instead
+	bool CanRenderInstanced()  { return mCanRenderInstanced; }
+
+	// Number of matrices each instance needs in the instance buffer, one for each node that has geometry
+	unsigned int InstanceMatrixCount()  { return static_cast<unsigned int>(mDrawnNodes.size()); }
+
+	// Write the matrices of one instance, given its world matrices as for Render, into the area of the instance buffer used by
+	// a batch of numInstances instances (InstanceMatrixCount() * numInstances matrices). Instance is from 0 to numInstances-1
+	void WriteInstanceMatrices(const Matrix4x4* worldMatrices, Matrix4x4* batch, unsigned int instance, unsigned int numInstances);
+
+	// Render a batch of instances whose matrices were written as above, starting at firstMatrix in the instance buffer. All the
+	// instances in a batch are given the same colour
+	void RenderInstanced(ID3D11Buffer* instanceBuffer, unsigned int firstMatrix, unsigned int numInstances, ColourRGBA colour = { 1, 1, 1, 1 });
+
+	// GPU culled instances (see GpuCuller.h) are drawn the same way, but with DrawIndexedInstancedIndirect so a compute shader can
+	// set the number of instances drawn. Append the arguments for drawing a batch, one per sub-mesh in the order RenderInstancedIndirect
+	// draws them, with an instance count of 0. The matrices are arranged as for WriteInstanceMatrices, from firstMatrix
+	void WriteIndirectArgs(std::vector<D3D11_DRAW_INDEXED_INSTANCED_INDIRECT_ARGS>& args, unsigned int firstMatrix, unsigned int numInstances);
+
+	// Render a batch of instances with the arguments written above, starting at firstArg in the given argument buffer
+	void RenderInstancedIndirect(ID3D11Buffer* instanceBuffer, ID3D11Buffer* argsBuffer, unsigned int firstArg, ColourRGBA colour = { 1, 1, 1, 1 });
+
+	// Skinned meshes don't use the instance buffer, their instances' bone matrices go one after another in the bone palette (see
+	// BonePalette.h). Render the given number of instances of a skinned mesh, given the world matrices of every node of each
+	// instance as for Render, in one draw call per sub-mesh. All the instances are given the same colour
+	void RenderSkinnedInstanced(const Matrix4x4* const* instanceWorldMatrices, unsigned int numInstances, ColourRGBA colour = { 1, 1, 1, 1 });
+
+
+	// Draw a few indices of each sub-mesh with every version of its material it may be drawn with - each shader level of detail,
+	// instanced and not - whose shaders and input layout the given pre-warm hasn't drawn yet, so the driver finishes compiling
+	// them now rather than the first time they are seen. Between ShaderPrewarm::Begin and End (see ShaderPrewarm.h)
+	void Prewarm(ShaderPrewarm& prewarm);
+
 
 	/*-----------------------------------------------------------------------------------------
 		Private data structures
@@ -107,27 +245,29 @@ private:
 	// A node can also have child nodes. The children will follow the motion of the parent node
 	// Each node has a default transformation matrix which is it's initial/default position/rotation/scale
 	// Entities using this mesh are given these default matrices as a starting position
-	struct Node
+	// The nodes are not objects of their own, each of their values is in an array indexed by node (see Private data), so walking
+	// the hierarchy to render reads a few contiguous arrays. A node's sub-meshes are a range of a single array of sub-mesh indices
+	struct SubMeshRange
 	{
-		std::string name = "";
-
-		Matrix4x4 transform    = Matrix4x4::Identity; // Default transform
-		Matrix4x4 offsetMatrix = Matrix4x4::Identity;
-
-		unsigned int parentIndex = 0;
-		unsigned int depth = 1; // Depth of node (root is depth 1)
+		uint32_t first = 0; // Position in mNodeSubMeshIndices
+		uint32_t count = 0;
+	};
 
-		std::vector<unsigned int> subMeshes;
-		std::vector<unsigned int> children;
+	// Box of the geometry in a node's sub-meshes in the node's own space, only used to calculate the bounds
+	struct NodeBox
+	{
+		Vector3 boundsMin = { 0, 0, 0 };
+		Vector3 boundsMax = { 0, 0, 0 };
 	};
 
 
 	// A mesh contains multiple submeshes with each submesh using a single material
 	// Each submesh is controlled by a single node in the mesh's hierarchy - see Node structure above
-	// Each submesh has a separate vertex / index buffer on the GPU (could share buffers for performance but that would be complex)
+	// Submesh vertices and indices are held in vertex / index buffers shared with all other geometry that has the same vertex layout
+	// (see Geometry.h), so drawing one submesh after another often doesn't need to change buffers
 	struct SubMesh
 	{
-		unsigned int nodeIndex;
+		unsigned int nodeIndex = 0; // Set from the nodes' sub-mesh ranges, see SetSubMeshNodes
 		std::string  name;
 		std::string  materialName;
 
@@ -136,16 +276,19 @@ private:
 		// GPU settings for the material used by this submesh (shaders, constant buffers texture objects etc.)
 		std::unique_ptr<RenderState> renderState;
     
-		// GPU specification of data held in a single vertex
+		// Size of a single vertex, the geometry pool holds the layout describing its contents
 		unsigned int vertexSize = 0; // in bytes
-		CComPtr<ID3D11InputLayout> vertexLayout;
 
-		// GPU-side vertex and index buffers
-		unsigned int  numVertices = 0;
-		CComPtr<ID3D11Buffer> vertexBuffer;
+		// Where the vertices and indices are in the shared GPU-side buffers. The pool's input layout for instanced rendering is
+		// only used if the material supports it, nullptr if not (owned by the pool)
+		unsigned int numVertices = 0;
+		unsigned int numIndices  = 0;
+		GeometryManager::Range geometry;
+		ID3D11InputLayout*     instancedVertexLayout = nullptr;
 
-		unsigned int  numIndices = 0;
-		CComPtr<ID3D11Buffer> indexBuffer;
+		// Bounding box of the vertex positions
+		Vector3 boundsMin = { 0, 0, 0 };
+		Vector3 boundsMax = { 0, 0, 0 };
 	};
 
 
@@ -154,14 +297,58 @@ private:
         Private helper functions
 	-----------------------------------------------------------------------------------------*/
 private:
-	// Read assimp node and its children and place in mNodes vector at position nodeIndex. Optionally filter out nodes with no submeshes (filterEmpty)
-	// Recursive function, first call only needs first two parameters. Returns first nodeIndex into mNodes after the nodes inserted
+	// Read assimp node and its children and place in the node arrays at position nodeIndex. Optionally filter out nodes with no submeshes (filterEmpty)
+	// Recursive function, first call only needs first two parameters. Returns first nodeIndex after the nodes inserted. The
+	// sub-meshes of each node are appended to mNodeSubMeshIndices, so nodes must be read in order
 	unsigned int ReadNodes(aiNode* assimpNode, bool filterEmpty, unsigned int nodeIndex = 0, unsigned int parentIndex = 0,
 			               unsigned int depth = 1, Matrix4x4 filteredTransform = Matrix4x4::Identity);
 
 
+	// The full path of a mesh file, relative names are in the Media folder, and the import flags it is imported with, the
+	// defaults plus the given ones. Shared by the constructor and Preload so both find the same cache
+	static std::filesystem::path MeshPath(const std::string& fileName);
+	static ImportFlags           FullImportFlags(ImportFlags additionalImportFlags);
+
+	// Create the nodes, sub-meshes and GPU data of a mesh read from a cache file rather than imported (see MeshCache.h)
+	void CreateFromCache(const MeshCacheData& data);
+
+	// Size the node arrays for the given number of nodes. The sub-mesh ranges are emptied, they are filled as nodes are added
+	void ResizeNodes(unsigned int numNodes);
+
+	// Set each sub-mesh's node from the nodes' sub-mesh ranges, once the nodes and sub-meshes have been created
+	void SetSubMeshNodes();
+
+	// The indices of the sub-meshes of a node, a range of mNodeSubMeshIndices
+	std::span<const unsigned int> NodeSubMeshes(unsigned int node)
+	{
+		const SubMeshRange& range = mNodeSubMeshes[node];
+		return { mNodeSubMeshIndices.data() + range.first, range.count };
+	}
+
+
+	// Calculate the node and mesh bounds from the sub-mesh bounds once all the nodes and sub-meshes have been created
+	void CalculateBounds();
+
+
 	// Helper function for Render function - renders a given sub-mesh. World matrices / textures / states etc. must already be set
-	void RenderSubMesh(const SubMesh& subMesh);
+	// The sub-mesh's material is applied first unless applyMaterial is false (see RenderGeometry)
+	void RenderSubMesh(const SubMesh& subMesh, bool applyMaterial = true);
+
+	// Helper function for RenderInstanced - renders a number of instances of a sub-mesh using matrices from the instance buffer
+	void RenderSubMeshInstanced(const SubMesh& subMesh, unsigned int firstMatrix, unsigned int numInstances);
+
+	// Write the bone matrices of the given instances of a skinned mesh to the bone palette and send the skinning constants that
+	// locate them. Returns false if the palette couldn't be written
+	bool WriteBones(const Matrix4x4* const* instanceWorldMatrices, unsigned int numInstances);
+
+	// Bind the per-mesh constants with the given colour, and the instance buffer to vertex buffer slot 1, for instanced rendering
+	void PrepareInstancedRender(ID3D11Buffer* instanceBuffer, ColourRGBA colour);
+
+	// Get the input layout for instanced rendering of a sub-mesh from its geometry pool, if its material supports instancing
+	void CreateInstancedLayout(SubMesh& subMesh);
+
+	// Find the nodes drawn by instanced rendering and whether the mesh can be rendered instanced, after all sub-meshes are created
+	void PrepareInstancing();
 
 
 
@@ -169,15 +356,38 @@ private:
 		Private data
 	-----------------------------------------------------------------------------------------*/
 private:
-	std::vector<Node>    mNodes;     // The mesh hierarchy. First entry is root. remainder are stored in depth-first order
+	// The mesh hierarchy, one entry per node in each array (see Node comments above). First node is root, remainder are stored
+	// in depth-first order
+	std::vector<uint32_t>       mParentIndices;      // Parent of each node, also read by MultiplyByParents
+	std::vector<Matrix4x4>      mDefaultTransforms;  // Default transform of each node, relative to its parent
+	std::vector<Matrix4x4>      mOffsetMatrices;     // Bone offset of each node, for skinning
+	std::vector<uint32_t>       mNodeDepths;         // Depth of each node (root is depth 1)
+	std::vector<SubMeshRange>   mNodeSubMeshes;      // Range of mNodeSubMeshIndices holding each node's sub-meshes
+	std::vector<unsigned int>   mNodeSubMeshIndices; // The sub-meshes of every node, node by node
+	std::vector<BoundingSphere> mNodeSpheres;        // Bounds of each node's geometry in its own space, empty if it has none
+	std::vector<NodeBox>        mNodeBoxes;
+	std::vector<std::string>    mNodeNames;          // Only for lookups and the mesh cache
+
 	std::vector<SubMesh> mSubMeshes; // The mesh geometry. Nodes refer to sub-meshes in this vector
 	
-	// Each node above has a transform relative to its parent. Each render we multiply these out to get every transform in world space
+	// Each node above has a transform relative to its parent. AbsoluteMatrix multiplies these out here to get every transform in
+	// world space. Entities keep their own world matrices instead (see Entity::WorldTransforms)
 	std::vector<Matrix4x4> mAbsoluteTransforms; 
 
 	unsigned int mMaxNodeDepth = 0; // Depth of deepest node in hierarchy (root is depth 1)
 
-	bool mHasBones; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
+	BoundingSphere mBoundingSphere; // Encloses the whole mesh in root space, see GetBoundingSphere
+
+	// Encloses the whole mesh in root space at its default pose, see GetBoundingBox
+	Vector3 mBoundsMin = { 0, 0, 0 };
+	Vector3 mBoundsMax = { 0, 0, 0 };
+	bool    mHasBoundingBox = false;
+
+	bool mHasBones = false; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
+
+	// Nodes that have sub-meshes, in order, and whether the mesh can be rendered instanced, see RenderInstanced
+	std::vector<unsigned int> mDrawnNodes;
+	bool mCanRenderInstanced = false;
 
 	std::filesystem::path mFilepath;  // Full pathname to mesh source file, or empty path if the mesh did not originate from a file
 };
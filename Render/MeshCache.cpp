@@ -0,0 +1,486 @@
+//--------------------------------------------------------------------------------------
+// Mesh cache functions - save imported meshes in a binary file so later runs don't need assimp
+//--------------------------------------------------------------------------------------
+
+#include "MeshCache.h"
+#include "Utility.h" // For StartsWith
+#include "AssetFiles.h"
+
+#include <assimp/version.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <functional>
+#include <system_error>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+
+//--------------------------------------------------------------------------------------
+// File layout
+//--------------------------------------------------------------------------------------
+// A cache file is a header identifying what it was made from, followed by the nodes then the sub-meshes. Each sub-mesh is its
+// description followed by its vertex and index data exactly as they are sent to the GPU. Strings and arrays are stored as a
+// 32-bit count then the contents. Everything is little-endian, as on every platform D3D11 runs on
+
+static const uint32_t MESH_CACHE_MAGIC = 0x4843534D; // "MSCH"
+
+struct MeshCacheHeader
+{
+	uint32_t magic         = MESH_CACHE_MAGIC;
+	uint32_t version       = MESH_CACHE_VERSION;
+	uint32_t assimpVersion[3] = {}; // Major, minor, revision - a different importer may produce different geometry
+	uint32_t importFlags   = 0;
+	float    detail        = 1.0f;
+	uint32_t padding       = 0;
+	uint64_t sourceSize    = 0;
+	int64_t  sourceTime    = 0;     // Modification time of the mesh file, when it is the same the contents are not hashed
+	uint64_t sourceHash    = 0;     // Of the contents of the mesh file
+	uint64_t payloadSize   = 0;     // Bytes after the header
+	Vector3  boundsMin     = { 0, 0, 0 }; // Of the whole mesh, see MeshCacheData
+	Vector3  boundsMax     = { 0, 0, 0 };
+	uint32_t hasBounds     = 0;
+	uint32_t padding2      = 0;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Helper functions
+//--------------------------------------------------------------------------------------
+
+// The header a cache of the given mesh file would have now, except for the hash and payload size. Returns false if the mesh
+// file can't be found
+bool CurrentHeader(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, MeshCacheHeader& header)
+{
+	AssetInfo info;
+	if (!gAssetFiles.GetInfo(meshFile, info))  return false;
+	header.sourceSize = info.size;
+	header.sourceTime = info.time;
+
+	header.assimpVersion[0] = aiGetVersionMajor();
+	header.assimpVersion[1] = aiGetVersionMinor();
+	header.assimpVersion[2] = aiGetVersionRevision();
+	header.importFlags = importFlags;
+	header.detail      = detail;
+	return true;
+}
+
+
+// Appends values to a byte array for WriteMeshCache
+class CacheWriter
+{
+public:
+	std::vector<uint8_t> bytes;
+
+	void Write(const void* data, size_t size)
+	{
+		auto start = bytes.size();
+		bytes.resize(start + size);
+		if (size > 0)  std::memcpy(bytes.data() + start, data, size);
+	}
+
+	template <typename T> void Write(const T& value)  { Write(&value, sizeof(T)); }
+
+	void Write(const std::string& string)
+	{
+		Write(static_cast<uint32_t>(string.size()));
+		Write(string.data(), string.size());
+	}
+
+	void Write(const std::vector<unsigned int>& values)
+	{
+		Write(static_cast<uint32_t>(values.size()));
+		for (auto value : values)  Write(static_cast<uint32_t>(value));
+	}
+};
+
+
+// Reads values from the bytes of a cache file for ReadMeshCache. Every read checks there is enough data left, once one has
+// failed the rest do too, so a damaged file is found with one check at the end
+class CacheReader
+{
+public:
+	CacheReader(const uint8_t* data, size_t size) : mPosition(data), mEnd(data + size) {}
+
+	bool Ok()  { return mOk; }
+
+	// Returns a pointer to the next size bytes and moves past them, nullptr if there aren't enough
+	const uint8_t* Skip(size_t size)
+	{
+		if (!mOk || static_cast<size_t>(mEnd - mPosition) < size)  { mOk = false;  return nullptr; }
+		auto data = mPosition;
+		mPosition += size;
+		return data;
+	}
+
+	template <typename T> void Read(T& value)
+	{
+		auto data = Skip(sizeof(T));
+		if (data != nullptr)  std::memcpy(&value, data, sizeof(T));
+	}
+
+	void Read(std::string& string)
+	{
+		uint32_t size = 0;
+		Read(size);
+		auto data = Skip(size);
+		if (data != nullptr)  string.assign(reinterpret_cast<const char*>(data), size);
+	}
+
+	void Read(std::vector<unsigned int>& values)
+	{
+		uint32_t size = 0;
+		Read(size);
+		auto data = Skip(static_cast<size_t>(size) * sizeof(uint32_t));
+		if (data == nullptr)  return;
+		values.resize(size);
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			uint32_t value;
+			std::memcpy(&value, data + i * sizeof(uint32_t), sizeof(uint32_t));
+			values[i] = value;
+		}
+	}
+
+private:
+	const uint8_t* mPosition;
+	const uint8_t* mEnd;
+	bool           mOk = true;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Cache files
+//--------------------------------------------------------------------------------------
+
+// Name of the cache file for the given mesh file imported with the given flags and detail, e.g. Boat.fbx.0271-1000.meshcache
+std::filesystem::path MeshCachePath(const std::filesystem::path& meshFile, uint32_t importFlags, float detail)
+{
+	std::ostringstream suffix;
+	suffix << "." << std::hex << std::setw(4) << std::setfill('0') << importFlags << "-"
+	       << std::dec << std::setw(4) << static_cast<int>(std::round(detail * 1000)) << ".meshcache";
+	auto path = meshFile;
+	path += suffix.str();
+	return path;
+}
+
+
+// Caches read by PreloadMeshCache that no mesh has taken yet, by mesh file, import flags and detail
+using PreloadKey = std::tuple<std::filesystem::path, uint32_t, float>;
+static std::map<PreloadKey, MeshCacheData> gPreloadedCaches;
+static std::mutex                          gPreloadedCachesMutex;
+
+// Read and check a cache file, see ReadMeshCache
+static bool ReadMeshCacheFile(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, MeshCacheData& data);
+
+
+// Read the cache for the given mesh file, import flags and detail into data. Returns false if there is no cache or it is out of
+// date, damaged or uses texture files that no longer exist
+bool ReadMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, MeshCacheData& data)
+{
+	{
+		std::lock_guard<std::mutex> lock(gPreloadedCachesMutex);
+		auto preloaded = gPreloadedCaches.find({ meshFile, importFlags, detail });
+		if (preloaded != gPreloadedCaches.end())
+		{
+			// The vertex and index pointers point into fileData, which moves with them
+			data = std::move(preloaded->second);
+			gPreloadedCaches.erase(preloaded);
+			return true;
+		}
+	}
+	return ReadMeshCacheFile(meshFile, importFlags, detail, data);
+}
+
+
+// Read the cache for the given mesh file, import flags and detail ahead of the mesh being constructed, e.g. on a worker thread
+// while the window and device are created. The next ReadMeshCache of the same cache takes the data without reading the file
+// again. Returns false if there is no up to date cache, the mesh will then be imported as usual
+bool PreloadMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail)
+{
+	{
+		std::lock_guard<std::mutex> lock(gPreloadedCachesMutex);
+		if (gPreloadedCaches.count({ meshFile, importFlags, detail }) != 0)  return true;
+	}
+
+	MeshCacheData data;
+	if (!ReadMeshCacheFile(meshFile, importFlags, detail, data))  return false;
+	std::lock_guard<std::mutex> lock(gPreloadedCachesMutex);
+	gPreloadedCaches.emplace(PreloadKey{ meshFile, importFlags, detail }, std::move(data));
+	return true;
+}
+
+
+// Drop the preloaded caches no mesh has taken, e.g. of meshes whose templates turned out not to be needed
+void ClearPreloadedMeshCaches()
+{
+	std::lock_guard<std::mutex> lock(gPreloadedCachesMutex);
+	gPreloadedCaches.clear();
+}
+
+
+// Read the bounding box of the given mesh file, import flags and detail from its cache's header only. Returns false if there is
+// no up to date cache or the mesh has no box. Unlike ReadMeshCache a touched mesh file isn't hashed, that would read it all
+bool ReadMeshCacheBounds(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, Vector3& boundsMin, Vector3& boundsMax)
+{
+	MeshCacheHeader current;
+	if (!CurrentHeader(meshFile, importFlags, detail, current))  return false;
+
+	auto fileData = gAssetFiles.ReadStart(MeshCachePath(meshFile, importFlags, detail), sizeof(MeshCacheHeader));
+	if (fileData.size() < sizeof(MeshCacheHeader))  return false;
+
+	MeshCacheHeader header;
+	std::memcpy(&header, fileData.data(), sizeof(header));
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+	    std::memcmp(header.assimpVersion, current.assimpVersion, sizeof(header.assimpVersion)) != 0 ||
+	    header.importFlags != importFlags || header.detail != detail ||
+	    header.sourceSize != current.sourceSize || header.sourceTime != current.sourceTime || header.hasBounds == 0)  return false;
+
+	boundsMin = header.boundsMin;
+	boundsMax = header.boundsMax;
+	return true;
+}
+
+
+static bool ReadMeshCacheFile(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, MeshCacheData& data)
+{
+	MeshCacheHeader current;
+	if (!CurrentHeader(meshFile, importFlags, detail, current))  return false;
+
+	// Read the whole file with one read, the vertex and index data is used where it lies. A cache in the asset archive isn't
+	// copied at all, the vertex and index data goes from the archive's mapping to the GPU
+	auto cacheFile = MeshCachePath(meshFile, importFlags, detail);
+	data.fileData = gAssetFiles.Read(cacheFile);
+	auto fileSize = data.fileData.size();
+	if (fileSize < sizeof(MeshCacheHeader))  return false;
+
+	// Check the cache was made from this mesh file by this version of the code
+	MeshCacheHeader header;
+	std::memcpy(&header, data.fileData.data(), sizeof(header));
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION ||
+	    std::memcmp(header.assimpVersion, current.assimpVersion, sizeof(header.assimpVersion)) != 0 ||
+	    header.importFlags != importFlags || header.detail != detail ||
+	    header.sourceSize != current.sourceSize || header.payloadSize != fileSize - sizeof(header))  return false;
+
+	// The mesh file may have been touched without changing, e.g. by checking it out again. Only then are its contents hashed
+	bool touched = header.sourceTime != current.sourceTime;
+	if (touched)
+	{
+		uint64_t hash;
+		if (!HashFile(meshFile, hash) || hash != header.sourceHash)  return false;
+	}
+	data.boundsMin = header.boundsMin;
+	data.boundsMax = header.boundsMax;
+	data.hasBounds = header.hasBounds != 0;
+
+
+	//-----------------------------------
+	// Nodes
+
+	CacheReader reader(data.fileData.data() + sizeof(header), static_cast<size_t>(header.payloadSize));
+	uint32_t numNodes = 0;
+	reader.Read(data.maxNodeDepth);
+	reader.Read(numNodes);
+	if (!reader.Ok() || numNodes == 0 || numNodes > header.payloadSize)  return false;
+	data.nodes.resize(numNodes);
+	for (auto& node : data.nodes)
+	{
+		reader.Read(node.name);
+		reader.Read(node.transform);
+		reader.Read(node.offsetMatrix);
+		reader.Read(node.parentIndex);
+		reader.Read(node.depth);
+		reader.Read(node.subMeshes);
+		reader.Read(node.children);
+	}
+
+
+	//-----------------------------------
+	// Sub-meshes
+
+	// Texture filenames are relative to the mesh file's folder so the media can be moved
+	auto meshFolder = meshFile.parent_path();
+
+	uint32_t numSubMeshes = 0;
+	reader.Read(numSubMeshes);
+	if (!reader.Ok() || numSubMeshes > header.payloadSize)  return false;
+	data.subMeshes.resize(numSubMeshes);
+	for (auto& subMesh : data.subMeshes)
+	{
+		reader.Read(subMesh.name);
+		reader.Read(subMesh.materialName);
+		reader.Read(subMesh.geometryTypes);
+
+		auto& renderMethod = subMesh.renderMethod;
+		uint32_t numTextures = 0;
+		reader.Read(renderMethod.geometryRenderMethod);
+		reader.Read(renderMethod.surfaceRenderMethod);
+		reader.Read(renderMethod.compressedVertices);
+		reader.Read(renderMethod.textureArrays);
+		reader.Read(renderMethod.constants);
+		reader.Read(numTextures);
+		if (!reader.Ok() || numTextures > NUM_TEXTURE_TYPES)  return false;
+		renderMethod.textures.resize(numTextures);
+		for (auto& texture : renderMethod.textures)
+		{
+			reader.Read(texture.type);
+			reader.Read(texture.filename);
+			reader.Read(texture.samplerState.filter);
+			reader.Read(texture.samplerState.addressingMode);
+
+			// An empty filename is a null texture
+			if (texture.filename.empty())  continue;
+			std::filesystem::path texturePath = texture.filename;
+			if (texturePath.is_relative())  texturePath = meshFolder / texturePath;
+			if (!gAssetFiles.ExistsIndexed(texturePath))  return false;
+			texture.filename = texturePath.string();
+		}
+
+		uint32_t numElements = 0;
+		reader.Read(numElements);
+		if (!reader.Ok() || numElements > D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT)  return false;
+		subMesh.vertexElements.resize(numElements);
+		for (auto& element : subMesh.vertexElements)
+		{
+			reader.Read(element.semanticName);
+			reader.Read(element.semanticIndex);
+			reader.Read(element.format);
+			reader.Read(element.offset);
+		}
+
+		reader.Read(subMesh.vertexSize);
+		reader.Read(subMesh.numVertices);
+		reader.Read(subMesh.numIndices);
+		reader.Read(subMesh.shortIndices);
+		reader.Read(subMesh.boundsMin);
+		reader.Read(subMesh.boundsMax);
+		if (!reader.Ok())  return false;
+		subMesh.vertices = reader.Skip(static_cast<size_t>(subMesh.numVertices) * subMesh.vertexSize);
+		subMesh.indices  = reader.Skip(static_cast<size_t>(subMesh.numIndices) * (subMesh.shortIndices ? 2 : 4));
+	}
+	if (!reader.Ok())  return false;
+
+	// Refresh the modification time stored in a cache that is still in date, so its mesh file isn't hashed again next time
+	if (touched)  WriteMeshCache(meshFile, importFlags, detail, data);
+	return true;
+}
+
+
+// Write the cache for the given mesh file, import flags and detail, replacing any existing one. Returns false if it can't be
+// written, e.g. the mesh is in a read-only folder
+bool WriteMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, const MeshCacheData& data)
+{
+	MeshCacheHeader header;
+	if (!CurrentHeader(meshFile, importFlags, detail, header) || !HashFile(meshFile, header.sourceHash))  return false;
+	header.boundsMin = data.boundsMin;
+	header.boundsMax = data.boundsMax;
+	header.hasBounds = data.hasBounds ? 1 : 0;
+
+	CacheWriter writer;
+	writer.Write(header); // Payload size is filled in at the end
+
+
+	//-----------------------------------
+	// Nodes
+
+	writer.Write(data.maxNodeDepth);
+	writer.Write(static_cast<uint32_t>(data.nodes.size()));
+	for (auto& node : data.nodes)
+	{
+		writer.Write(node.name);
+		writer.Write(node.transform);
+		writer.Write(node.offsetMatrix);
+		writer.Write(node.parentIndex);
+		writer.Write(node.depth);
+		writer.Write(node.subMeshes);
+		writer.Write(node.children);
+	}
+
+
+	//-----------------------------------
+	// Sub-meshes
+
+	auto meshFolder = meshFile.parent_path();
+
+	writer.Write(static_cast<uint32_t>(data.subMeshes.size()));
+	for (auto& subMesh : data.subMeshes)
+	{
+		writer.Write(subMesh.name);
+		writer.Write(subMesh.materialName);
+		writer.Write(subMesh.geometryTypes);
+
+		auto& renderMethod = subMesh.renderMethod;
+		writer.Write(renderMethod.geometryRenderMethod);
+		writer.Write(renderMethod.surfaceRenderMethod);
+		writer.Write(renderMethod.compressedVertices);
+		writer.Write(renderMethod.textureArrays);
+		writer.Write(renderMethod.constants);
+		writer.Write(static_cast<uint32_t>(renderMethod.textures.size()));
+		for (auto& texture : renderMethod.textures)
+		{
+			// Store textures in the mesh's folder (or below it) relative to it
+			std::string filename = texture.filename;
+			if (!filename.empty())
+			{
+				auto relative = std::filesystem::path(filename).lexically_relative(meshFolder);
+				if (!relative.empty() && !StartsWith(relative.string(), ".."))  filename = relative.string();
+			}
+
+			writer.Write(texture.type);
+			writer.Write(filename);
+			writer.Write(texture.samplerState.filter);
+			writer.Write(texture.samplerState.addressingMode);
+		}
+
+		writer.Write(static_cast<uint32_t>(subMesh.vertexElements.size()));
+		for (auto& element : subMesh.vertexElements)
+		{
+			writer.Write(element.semanticName);
+			writer.Write(element.semanticIndex);
+			writer.Write(element.format);
+			writer.Write(element.offset);
+		}
+
+		writer.Write(subMesh.vertexSize);
+		writer.Write(subMesh.numVertices);
+		writer.Write(subMesh.numIndices);
+		writer.Write(subMesh.shortIndices);
+		writer.Write(subMesh.boundsMin);
+		writer.Write(subMesh.boundsMax);
+		writer.Write(subMesh.vertices, static_cast<size_t>(subMesh.numVertices) * subMesh.vertexSize);
+		writer.Write(subMesh.indices,  static_cast<size_t>(subMesh.numIndices) * (subMesh.shortIndices ? 2 : 4));
+	}
+
+	header.payloadSize = writer.bytes.size() - sizeof(header);
+	std::memcpy(writer.bytes.data(), &header, sizeof(header));
+
+
+	//-----------------------------------
+	// Write to a temporary file then rename it over the cache, so an interrupted write or another thread importing the same mesh
+	// never leaves a partial cache
+
+	auto cacheFile = MeshCachePath(meshFile, importFlags, detail);
+	auto tempFile  = cacheFile;
+	tempFile += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		if (!stream)  return false;
+		stream.write(reinterpret_cast<const char*>(writer.bytes.data()), writer.bytes.size());
+		if (!stream)  { stream.close();  std::remove(tempFile.string().c_str());  return false; }
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempFile, cacheFile, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFile, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// Mesh cache functions - save imported meshes in a binary file so later runs don't need assimp
+//--------------------------------------------------------------------------------------
+// Importing a mesh file (see the Mesh constructor) reads it with assimp, post-processes it, chooses render methods from the
+// materials and the texture files that exist, then converts every sub-mesh to GPU vertex and index data. The result is saved
+// next to the mesh file in a cache file, so the next run reads it back with a single file read and sends it straight to the GPU:
+//
+//   MeshCacheData data;
+//   if (ReadMeshCache(meshFile, importFlags, detail, data))  ... create the mesh from data ...
+//   else  { ... import the mesh, filling in data as it goes ...;  WriteMeshCache(meshFile, importFlags, detail, data); }
+//
+// Each combination of import flags and detail has its own cache file, e.g. Boat.fbx.0271-1000.meshcache. A cache is only used
+// if it was made by the same cache format and assimp version from the same mesh file (same size and contents), otherwise the
+// mesh is imported again and the cache replaced. The contents are hashed only if the file's modification time has changed.
+// Render methods depend on which texture files exist beside the mesh, a cache is not used if one of its textures is missing,
+// but textures added since it was written won't be noticed - delete the .meshcache files to pick them up
+//
+// Increase MESH_CACHE_VERSION whenever the import code changes what it produces, to replace all existing caches
+
+#ifndef _MESH_CACHE_H_INCLUDED_
+#define _MESH_CACHE_H_INCLUDED_
+
+#include "MeshTypes.h"
+#include "RenderMethod.h"
+#include "AssetFiles.h"
+
+#include "Matrix4x4.h"
+#include "Vector3.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+// Version of the cache file contents, see above
+static const uint32_t MESH_CACHE_VERSION = 4;
+
+
+// A mesh as it is after import, ready to be sent to the GPU. Mirrors the nodes and sub-meshes of the Mesh class
+struct MeshCacheData
+{
+	struct Node
+	{
+		std::string               name;
+		Matrix4x4                 transform;
+		Matrix4x4                 offsetMatrix;
+		uint32_t                  parentIndex = 0;
+		uint32_t                  depth = 1;
+		std::vector<unsigned int> subMeshes;
+		std::vector<unsigned int> children;
+	};
+
+	// Element of a sub-mesh's vertex layout, as for D3D11_INPUT_ELEMENT_DESC, all in vertex buffer slot 0 and per-vertex
+	struct VertexElement
+	{
+		std::string semanticName;
+		uint32_t    semanticIndex = 0;
+		DXGI_FORMAT format        = DXGI_FORMAT_UNKNOWN;
+		uint32_t    offset        = 0;
+	};
+
+	// The vertices and indices are not owned. When writing a cache they point to the import's own arrays, after reading one
+	// they point into fileData below
+	struct SubMesh
+	{
+		std::string   name;
+		std::string   materialName;
+		GeometryTypes geometryTypes = GeometryTypes::Position;
+		RenderMethod  renderMethod;  // Final render method, including the geometry render method
+
+		std::vector<VertexElement> vertexElements;
+		uint32_t    vertexSize   = 0;
+		uint32_t    numVertices  = 0;
+		uint32_t    numIndices   = 0;
+		bool        shortIndices = false; // 16-bit indices rather than 32-bit
+		const void* vertices     = nullptr;
+		const void* indices      = nullptr;
+
+		Vector3 boundsMin = { 0, 0, 0 };
+		Vector3 boundsMax = { 0, 0, 0 };
+	};
+
+	std::vector<Node>    nodes;
+	std::vector<SubMesh> subMeshes;
+	uint32_t             maxNodeDepth = 0;
+
+	// Box of the whole mesh in root space at its default pose, as the mesh calculates it. Also kept in the file's header so it
+	// can be read without the rest of the cache, see ReadMeshCacheBounds. A skinned mesh has no box
+	Vector3 boundsMin = { 0, 0, 0 };
+	Vector3 boundsMax = { 0, 0, 0 };
+	bool    hasBounds = false;
+
+	AssetData fileData; // Whole cache file, when read by ReadMeshCache
+};
+
+
+// Name of the cache file for the given mesh file imported with the given flags and detail
+std::filesystem::path MeshCachePath(const std::filesystem::path& meshFile, uint32_t importFlags, float detail);
+
+// Read the cache for the given mesh file, import flags and detail into data. Returns false if there is no cache or it is out of
+// date, damaged or uses texture files that no longer exist
+bool ReadMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, MeshCacheData& data);
+
+// Read the cache for the given mesh file, import flags and detail ahead of the mesh being constructed, e.g. on a worker thread
+// during startup. The next ReadMeshCache of the same cache takes the data without reading the file again. Returns false if
+// there is no up to date cache. Can be called on several threads at once
+bool PreloadMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail);
+
+// Drop the preloaded caches no mesh has taken
+void ClearPreloadedMeshCaches();
+
+// Read the bounding box of the given mesh file, import flags and detail from its cache's header only, e.g. to size something
+// drawn in its place before it is constructed. Returns false if there is no up to date cache (the mesh file isn't hashed, a
+// changed modification time counts as out of date) or the mesh has no box
+bool ReadMeshCacheBounds(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, Vector3& boundsMin, Vector3& boundsMax);
+
+// Write the cache for the given mesh file, import flags and detail, replacing any existing one. Returns false if it can't be
+// written, e.g. the mesh is in a read-only folder. The mesh still loads, just by importing every time
+bool WriteMeshCache(const std::filesystem::path& meshFile, uint32_t importFlags, float detail, const MeshCacheData& data);
+
+
+#endif //_MESH_CACHE_H_INCLUDED_
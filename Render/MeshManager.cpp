@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// MeshManager class shares meshes between the code that uses them
+//--------------------------------------------------------------------------------------
+
+#include "MeshManager.h"
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Return the mesh loaded from the given file with the given import flags and detail, loading it if no one is using it already
+// Can throw std::runtime_error if the mesh fails to load
+std::shared_ptr<Mesh> MeshManager::LoadMesh(const std::string& fileName, ImportFlags importFlags /*= {}*/, float detail /*= 1.0f*/)
+{
+	// Find or add the entry for this mesh, and tidy away the entries of meshes no longer in use
+	std::shared_ptr<MeshEntry> entry;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (auto it = mMeshes.begin(); it != mMeshes.end(); )
+		{
+			// An entry with no mesh might be loading on another thread, which is holding the entry (use_count > 1)
+			if (it->second->mesh.expired() && it->second.use_count() == 1)  it = mMeshes.erase(it);
+			else                                                             ++it;
+		}
+
+		auto& mapEntry = mMeshes[{ fileName, importFlags, detail }];
+		if (mapEntry == nullptr)  mapEntry = std::make_shared<MeshEntry>();
+		entry = mapEntry;
+	}
+
+	// Return the existing mesh if it is still in use, otherwise load it. If another thread is loading it, this waits for that load
+	// Only this entry is locked, so other meshes can be loaded at the same time. If the load throws the entry is left empty
+	std::lock_guard<std::mutex> lock(entry->loadMutex);
+	auto mesh = entry->mesh.lock();
+	if (mesh == nullptr)
+	{
+		mesh = std::make_shared<Mesh>(fileName, importFlags, detail);
+		entry->mesh = mesh;
+	}
+	return mesh;
+}
+
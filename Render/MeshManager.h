@@ -0,0 +1,67 @@
+//--------------------------------------------------------------------------------------
+// MeshManager class shares meshes between the code that uses them
+//--------------------------------------------------------------------------------------
+// Several entity templates can use the same mesh file, e.g. different snow pieces or pillars sharing one model. Rather than
+// each importing its own copy, they get the mesh from the MeshManager, which returns the existing mesh if the same file has
+// already been loaded with the same import flags and detail:
+//
+//   std::shared_ptr<Mesh> mesh = DX->Meshes()->LoadMesh("Pillar.fbx", importFlags);
+//
+// The meshes are reference counted with std::shared_ptr. The manager only keeps a weak pointer to each mesh, so a mesh (and
+// its GPU buffers) is destroyed as soon as the last user releases it, e.g. when the last entity template using it is destroyed.
+// Loading it again after that imports it again
+//
+// Unlike the other managers, which return plain pointers to resources they own until they are destroyed, this manager never
+// owns the meshes. Meshes can use a lot of memory, so they are released when no longer in use
+
+#ifndef _MESH_MANAGER_H_INCLUDED_
+#define _MESH_MANAGER_H_INCLUDED_
+
+#include "Mesh.h"
+
+#include <string>
+#include <map>
+#include <tuple>
+#include <memory>
+#include <mutex>
+
+
+//--------------------------------------------------------------------------------------
+// Mesh Manager Class
+//--------------------------------------------------------------------------------------
+class MeshManager
+{
+	//--------------------------------------------------------------------------------------
+	// Usage
+	//--------------------------------------------------------------------------------------
+public:
+	// Return the mesh loaded from the given file with the given import flags and detail (see Mesh constructor), loading it if
+	// no one is using it already. Keep the returned pointer for as long as the mesh is in use.
+	// Can throw std::runtime_error if the mesh fails to load
+	// Can be called on several threads at once. If two threads ask for the same new mesh together one loads it while the
+	// other waits, different meshes load in parallel
+	std::shared_ptr<Mesh> LoadMesh(const std::string& fileName, ImportFlags importFlags = {}, float detail = 1.0f);
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Data
+	//--------------------------------------------------------------------------------------
+private:
+	// A mesh that has been loaded, along with a mutex held while it loads so only one thread loads each mesh
+	struct MeshEntry
+	{
+		std::mutex          loadMutex;
+		std::weak_ptr<Mesh> mesh;
+	};
+
+	// Map of file name, import flags and detail to the mesh loaded with them. Entries whose mesh has been destroyed are removed
+	// the next time a mesh is loaded. Entries are held by shared_ptr so a thread can wait on an entry's load without the map locked
+	using MeshKey = std::tuple<std::string, ImportFlags, float>;
+	std::map<MeshKey, std::shared_ptr<MeshEntry>> mMeshes;
+
+	// Guards the map above
+	std::mutex mMutex;
+};
+
+
+#endif // _MESH_MANAGER_H_INCLUDED_
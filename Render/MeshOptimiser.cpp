@@ -0,0 +1,447 @@
+//--------------------------------------------------------------------------------------
+// Mesh optimisation functions - reorder triangles and vertices for faster rendering
+//--------------------------------------------------------------------------------------
+
+#include "MeshOptimiser.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cfloat>
+#include <numeric>
+#include <set>
+#include <unordered_map>
+
+
+//--------------------------------------------------------------------------------------
+// Cache simulation
+//--------------------------------------------------------------------------------------
+
+// A FIFO cache simulated with a time stamp for each vertex, the time counts cache misses. A vertex is in the cache if it was
+// added less than cacheSize misses ago. Stepping the time on by more than the cache size empties the cache
+struct SimulatedCache
+{
+	SimulatedCache(unsigned int numVertices, unsigned int size)
+		: addedTime(numVertices, 0), time(size + 1), cacheSize(size) {}
+
+	// Draw a triangle, returns the number of its vertices that missed the cache
+	unsigned int DrawTriangle(const uint32_t* triangle)
+	{
+		unsigned int misses = 0;
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			if (time - addedTime[triangle[i]] > cacheSize)
+			{
+				addedTime[triangle[i]] = time++;
+				++misses;
+			}
+		}
+		return misses;
+	}
+
+	void Empty()  { time += cacheSize + 1; }
+
+	std::vector<unsigned int> addedTime;
+	unsigned int time;
+	unsigned int cacheSize;
+};
+
+
+// Average number of vertices that miss a FIFO cache of the given size per triangle, when drawing the given triangle list
+float AverageCacheMissRatio(const std::vector<uint32_t>& indices, unsigned int numVertices, unsigned int cacheSize /*= SIMULATED_CACHE_SIZE*/)
+{
+	size_t numTriangles = indices.size() / 3;
+	if (numTriangles == 0)  return 0;
+
+	SimulatedCache cache(numVertices, cacheSize);
+	unsigned int misses = 0;
+	for (size_t triangle = 0; triangle < numTriangles; ++triangle)  misses += cache.DrawTriangle(&indices[triangle * 3]);
+	return static_cast<float>(misses) / numTriangles;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Vertex cache optimisation
+//--------------------------------------------------------------------------------------
+// Each vertex has a score, higher if it is near the front of a simulated LRU cache, and higher if it has fewer triangles left
+// to draw (so isolated vertices are finished off rather than left behind). The next triangle drawn is the one with the highest
+// total vertex score of those using a vertex in the cache. Constants are the values suggested by Forsyth
+
+static const unsigned int FORSYTH_CACHE_SIZE  = 32;
+static const float        CACHE_DECAY_POWER   = 1.5f;
+static const float        LAST_TRIANGLE_SCORE = 0.75f;
+static const float        VALENCE_BOOST_SCALE = 2.0f;
+static const float        VALENCE_BOOST_POWER = 0.5f;
+
+static const uint32_t NO_TRIANGLE = ~0u;
+
+// Score of a vertex at the given position in the cache (-1 if not in it), with the given number of triangles still to draw
+static float VertexScore(int cachePosition, unsigned int remainingTriangles)
+{
+	if (remainingTriangles == 0)  return -1.0f; // Vertex is finished with
+
+	float score = 0;
+	if (cachePosition >= 0)
+	{
+		// The vertices of the last triangle drawn all get the same score, so the next triangle doesn't favour one of its edges
+		if (cachePosition < 3)  score = LAST_TRIANGLE_SCORE;
+		else                    score = std::pow(1.0f - (cachePosition - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	return score + VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+}
+
+
+// Reorder the triangles of a triangle list so vertices used by one triangle are soon used again, while they are still in the cache
+void OptimiseVertexCache(std::vector<uint32_t>& indices, unsigned int numVertices)
+{
+	uint32_t numTriangles = static_cast<uint32_t>(indices.size() / 3);
+	if (numTriangles == 0)  return;
+
+	// The triangles using each vertex, all in one array. The first remainingTriangles[v] of a vertex's list are the ones not yet drawn
+	std::vector<uint32_t> remainingTriangles(numVertices, 0);
+	for (uint32_t index : indices)  ++remainingTriangles[index];
+	std::vector<uint32_t> firstTriangle(numVertices + 1, 0);
+	std::partial_sum(remainingTriangles.begin(), remainingTriangles.end(), firstTriangle.begin() + 1);
+	std::vector<uint32_t> vertexTriangles(indices.size());
+	{
+		std::vector<uint32_t> filled(numVertices, 0);
+		for (uint32_t i = 0; i < indices.size(); ++i)  vertexTriangles[firstTriangle[indices[i]] + filled[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int>   cachePosition(numVertices, -1);
+	std::vector<float> vertexScores(numVertices);
+	for (unsigned int v = 0; v < numVertices; ++v)  vertexScores[v] = VertexScore(-1, remainingTriangles[v]);
+	std::vector<float> triangleScores(numTriangles);
+	for (uint32_t t = 0; t < numTriangles; ++t)
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	std::vector<bool> drawn(numTriangles, false);
+
+	std::vector<uint32_t> cache, newCache;
+	cache.reserve(FORSYTH_CACHE_SIZE + 3);
+	newCache.reserve(FORSYTH_CACHE_SIZE + 3);
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+
+	// Start with the best triangle overall. If no triangle using a cached vertex is left, continue with the next undrawn one in the
+	// original order - rather than searching every triangle, which would make this quadratic
+	uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+	uint32_t nextUndrawn = 0;
+	for (uint32_t numDrawn = 0; numDrawn < numTriangles; ++numDrawn)
+	{
+		if (bestTriangle == NO_TRIANGLE)
+		{
+			while (drawn[nextUndrawn])  ++nextUndrawn;
+			bestTriangle = nextUndrawn;
+		}
+
+		// Draw the triangle, removing it from the lists of its vertices, which go to the front of the cache
+		drawn[bestTriangle] = true;
+		const uint32_t* triangle = &indices[bestTriangle * 3];
+		newCache.clear();
+		for (unsigned int i = 0; i < 3; ++i)
+		{
+			uint32_t v = triangle[i];
+			output.push_back(v);
+			if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())  newCache.push_back(v);
+
+			uint32_t* liveTriangles = &vertexTriangles[firstTriangle[v]];
+			uint32_t* found = std::find(liveTriangles, liveTriangles + remainingTriangles[v], bestTriangle);
+			std::swap(*found, liveTriangles[remainingTriangles[v] - 1]);
+			--remainingTriangles[v];
+		}
+		for (uint32_t v : cache)
+		{
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2])  newCache.push_back(v);
+		}
+
+		// Vertices pushed off the end of the cache lose their cache score
+		for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); ++i)  cachePosition[newCache[i]] = -1;
+		for (size_t i = 0; i < std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE); ++i)  cachePosition[newCache[i]] = static_cast<int>(i);
+
+		// Update the scores of the vertices whose positions changed and of their undrawn triangles
+		for (uint32_t v : newCache)
+		{
+			float score = VertexScore(cachePosition[v], remainingTriangles[v]);
+			float change = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const uint32_t* liveTriangles = &vertexTriangles[firstTriangle[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; ++i)  triangleScores[liveTriangles[i]] += change;
+		}
+
+		// Then pick the best undrawn triangle using a vertex still in the cache
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = -FLT_MAX;
+		for (uint32_t v : newCache)
+		{
+			if (cachePosition[v] < 0)  continue;
+			const uint32_t* liveTriangles = &vertexTriangles[firstTriangle[v]];
+			for (uint32_t i = 0; i < remainingTriangles[v]; ++i)
+			{
+				if (triangleScores[liveTriangles[i]] > bestScore)
+				{
+					bestScore = triangleScores[liveTriangles[i]];
+					bestTriangle = liveTriangles[i];
+				}
+			}
+		}
+
+		newCache.resize(std::min<size_t>(newCache.size(), FORSYTH_CACHE_SIZE));
+		std::swap(cache, newCache);
+	}
+
+	indices = std::move(output);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Overdraw optimisation
+//--------------------------------------------------------------------------------------
+
+// Reorder clusters of triangles from OptimiseVertexCache so the outer parts of the mesh tend to be drawn first
+void OptimiseOverdraw(std::vector<uint32_t>& indices, const Vector3* positions, unsigned int numVertices, float threshold /*= 1.05f*/)
+{
+	uint32_t numTriangles = static_cast<uint32_t>(indices.size() / 3);
+	if (numTriangles == 0)  return;
+
+	// Hard cluster boundaries are where the cache order jumps to another part of the mesh, a triangle missing with all its vertices
+	SimulatedCache cache(numVertices, SIMULATED_CACHE_SIZE);
+	std::vector<uint32_t> hardClusters;
+	for (uint32_t t = 0; t < numTriangles; ++t)
+	{
+		if (cache.DrawTriangle(&indices[t * 3]) == 3)  hardClusters.push_back(t);
+	}
+	hardClusters.push_back(numTriangles);
+
+	// Split hard clusters further, each time the ACMR since the last split becomes nearly as good as the whole hard cluster's.
+	// Starting a cluster empties the cache, as the sort may put any cluster before it
+	std::vector<uint32_t> clusters;
+	for (size_t c = 0; c + 1 < hardClusters.size(); ++c)
+	{
+		uint32_t start = hardClusters[c];
+		uint32_t end   = hardClusters[c + 1];
+
+		cache.Empty();
+		unsigned int misses = 0;
+		for (uint32_t t = start; t < end; ++t)  misses += cache.DrawTriangle(&indices[t * 3]);
+		float targetACMR = threshold * misses / (end - start);
+
+		clusters.push_back(start);
+		cache.Empty();
+		unsigned int clusterMisses = 0;
+		unsigned int clusterTriangles = 0;
+		for (uint32_t t = start; t < end; ++t)
+		{
+			clusterMisses += cache.DrawTriangle(&indices[t * 3]);
+			++clusterTriangles;
+			if (static_cast<float>(clusterMisses) / clusterTriangles <= targetACMR)
+			{
+				clusters.push_back(t + 1);
+				cache.Empty();
+				clusterMisses = 0;
+				clusterTriangles = 0;
+			}
+		}
+
+		// The triangles after the last split are too few to have a good ACMR on their own, so merge them into the cluster before.
+		// This also removes the split at the end of the hard cluster if there is one
+		if (clusters.back() != start)  clusters.pop_back();
+	}
+	clusters.push_back(numTriangles);
+
+	// Centre of the mesh and the area weighted centre and normal of each cluster
+	Vector3 meshCentre = { 0, 0, 0 };
+	float   meshArea = 0;
+	size_t numClusters = clusters.size() - 1;
+	std::vector<Vector3> clusterCentres(numClusters, { 0, 0, 0 });
+	std::vector<Vector3> clusterNormals(numClusters, { 0, 0, 0 });
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		float clusterArea = 0;
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			const Vector3& p0 = positions[indices[t * 3]];
+			const Vector3& p1 = positions[indices[t * 3 + 1]];
+			const Vector3& p2 = positions[indices[t * 3 + 2]];
+			Vector3 normal = Cross(p1 - p0, p2 - p0); // Length is twice the triangle area
+			float area = normal.Length();
+			clusterCentres[c] += (p0 + p1 + p2) * (area / 3);
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCentre += clusterCentres[c];
+		meshArea += clusterArea;
+		if (clusterArea > 0)  clusterCentres[c] = clusterCentres[c] / clusterArea;
+	}
+	if (meshArea > 0)  meshCentre = meshCentre / meshArea;
+
+	// Clusters facing out from further from the centre are drawn first, they are most likely to be in front of the rest of the mesh
+	std::vector<float> sortKeys(numClusters);
+	for (size_t c = 0; c < numClusters; ++c)
+	{
+		float normalLength = clusterNormals[c].Length();
+		sortKeys[c] = (normalLength > 0) ? Dot(clusterCentres[c] - meshCentre, clusterNormals[c] / normalLength) : 0;
+	}
+	std::vector<uint32_t> clusterOrder(numClusters);
+	std::iota(clusterOrder.begin(), clusterOrder.end(), 0);
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (uint32_t c : clusterOrder)
+		output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	indices = std::move(output);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Vertex fetch optimisation
+//--------------------------------------------------------------------------------------
+
+static const uint32_t NO_VERTEX = ~0u;
+
+// Renumber vertices in the order the indices first use them. Returns the old vertex number of each new vertex
+std::vector<uint32_t> OptimiseVertexFetch(std::vector<uint32_t>& indices, unsigned int numVertices)
+{
+	std::vector<uint32_t> newVertex(numVertices, NO_VERTEX);
+	std::vector<uint32_t> oldVertex;
+	oldVertex.reserve(numVertices);
+	for (uint32_t& index : indices)
+	{
+		if (newVertex[index] == NO_VERTEX)
+		{
+			newVertex[index] = static_cast<uint32_t>(oldVertex.size());
+			oldVertex.push_back(index);
+		}
+		index = newVertex[index];
+	}
+
+	// Keep any unused vertices, so the vertex count doesn't change
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		if (newVertex[v] == NO_VERTEX)  oldVertex.push_back(v);
+	}
+	return oldVertex;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Simplification
+//--------------------------------------------------------------------------------------
+// Vertex clustering (Rossignac and Borrel): space is divided into a grid of cells and the vertices in each cell are merged into
+// the one nearest their average position. Triangles with two corners in the same cell collapse and are removed. Coarser grids
+// remove more triangles, so a binary search finds the finest grid that reaches the target. Much simpler than error metric
+// methods such as quadric edge collapse, and it makes no attempt to keep UV seams or thin parts, but it is fine for distant
+// levels of detail where those can't be seen
+
+static const unsigned int MAX_SIMPLIFY_GRID = 1024;
+
+// Merge the vertices of a triangle list within each cell of a grid with gridSize cells across the largest side of the given box,
+// writing the triangles that remain to output. Triangles that repeat another once merged are also removed
+static void ClusterVertices(const std::vector<uint32_t>& indices, const Vector3* positions, unsigned int numVertices,
+                            Vector3 boundsMin, float boundsSize, unsigned int gridSize, std::vector<uint32_t>& output)
+{
+	float cellScale = gridSize / boundsSize;
+	auto cellCoord = [&](float value, float min)
+	{
+		return std::min(static_cast<uint64_t>(std::max((value - min) * cellScale, 0.0f)), static_cast<uint64_t>(gridSize - 1));
+	};
+
+	// Find the cluster of each used vertex, numbering the clusters as they are found
+	std::vector<uint32_t> vertexClusters(numVertices, NO_VERTEX);
+	std::unordered_map<uint64_t, uint32_t> cellClusters;
+	std::vector<Vector3> clusterCentres;
+	std::vector<unsigned int> clusterSizes;
+	for (uint32_t index : indices)
+	{
+		if (vertexClusters[index] != NO_VERTEX)  continue;
+
+		const Vector3& position = positions[index];
+		uint64_t cell = cellCoord(position.x, boundsMin.x) +
+		                (cellCoord(position.y, boundsMin.y) + cellCoord(position.z, boundsMin.z) * gridSize) * gridSize;
+		auto [entry, isNew] = cellClusters.try_emplace(cell, static_cast<uint32_t>(clusterCentres.size()));
+		if (isNew)
+		{
+			clusterCentres.push_back({ 0, 0, 0 });
+			clusterSizes.push_back(0);
+		}
+		vertexClusters[index] = entry->second;
+		clusterCentres[entry->second] += position;
+		++clusterSizes[entry->second];
+	}
+	for (size_t c = 0; c < clusterCentres.size(); ++c)  clusterCentres[c] /= static_cast<float>(clusterSizes[c]);
+
+	// Each cluster is replaced by its vertex nearest the average position
+	std::vector<uint32_t> clusterVertices(clusterCentres.size(), NO_VERTEX);
+	std::vector<float> clusterDistances(clusterCentres.size(), FLT_MAX);
+	for (uint32_t v = 0; v < numVertices; ++v)
+	{
+		uint32_t cluster = vertexClusters[v];
+		if (cluster == NO_VERTEX)  continue;
+
+		float distance = Distance(positions[v], clusterCentres[cluster]);
+		if (distance < clusterDistances[cluster])
+		{
+			clusterDistances[cluster] = distance;
+			clusterVertices[cluster] = v;
+		}
+	}
+
+	// Keep the triangles that still have three different corners. Duplicates are found with the corners rotated so the lowest is
+	// first, which keeps the winding so a back face is not mistaken for a duplicate of its front
+	output.clear();
+	std::set<std::array<uint32_t, 3>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<uint32_t, 3> triangle = { clusterVertices[vertexClusters[indices[i]]], clusterVertices[vertexClusters[indices[i + 1]]],
+		                                     clusterVertices[vertexClusters[indices[i + 2]]] };
+		if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0])  continue;
+
+		auto lowest = std::min_element(triangle.begin(), triangle.end());
+		std::rotate(triangle.begin(), lowest, triangle.end());
+		if (!triangles.insert(triangle).second)  continue;
+
+		output.insert(output.end(), triangle.begin(), triangle.end());
+	}
+}
+
+
+// Reduce a triangle list to about the given fraction of its triangles by vertex clustering
+void SimplifyMesh(std::vector<uint32_t>& indices, const Vector3* positions, unsigned int numVertices, float detail)
+{
+	size_t numTriangles = indices.size() / 3;
+	size_t targetTriangles = static_cast<size_t>(numTriangles * std::clamp(detail, 0.0f, 1.0f));
+	if (targetTriangles >= numTriangles)  return;
+
+	// The grid covers the box around the used vertices
+	Vector3 boundsMin = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+	Vector3 boundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t index : indices)
+	{
+		const Vector3& position = positions[index];
+		boundsMin = { std::min(boundsMin.x, position.x), std::min(boundsMin.y, position.y), std::min(boundsMin.z, position.z) };
+		boundsMax = { std::max(boundsMax.x, position.x), std::max(boundsMax.y, position.y), std::max(boundsMax.z, position.z) };
+	}
+	float boundsSize = std::max({ boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z });
+	if (!(boundsSize > 0))  return;
+
+	// A grid of one cell merges everything, leaving no triangles, so some grid size always reaches the target. The triangle count
+	// grows with the grid size (nearly always), look for the largest size that doesn't exceed the target
+	std::vector<uint32_t> simplified, trial;
+	unsigned int low = 1, high = MAX_SIMPLIFY_GRID;
+	while (low <= high)
+	{
+		unsigned int gridSize = (low + high) / 2;
+		ClusterVertices(indices, positions, numVertices, boundsMin, boundsSize, gridSize, trial);
+		if (trial.size() / 3 <= targetTriangles)
+		{
+			std::swap(simplified, trial);
+			low = gridSize + 1;
+		}
+		else
+		{
+			high = gridSize - 1;
+		}
+	}
+	indices = std::move(simplified);
+}
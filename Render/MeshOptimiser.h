@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// Mesh optimisation functions - reorder triangles and vertices for faster rendering
+//--------------------------------------------------------------------------------------
+// Used by the Mesh import with ImportFlags::OptimiseVertexOrder, after assimp post-processing. Works on a triangle list of 32-bit
+// indices and is applied in three stages:
+//
+//   OptimiseVertexCache(indices, numVertices);             // Order triangles so vertices are reused from the post-transform cache
+//   OptimiseOverdraw(indices, positions, numVertices);      // Order groups of those triangles so outward facing ones are drawn first
+//   auto remap = OptimiseVertexFetch(indices, numVertices); // Order vertices by first use, then move the vertex data to match
+//
+// The overdraw stage only moves whole clusters of triangles, keeping the cache order within them, so it costs a little of the
+// cache improvement (see the threshold). AverageCacheMissRatio (ACMR) measures the vertex shader work: the number of vertices
+// transformed per triangle with a simulated FIFO cache. 3 is the worst, around 0.6-0.7 is typical of well ordered meshes
+//
+// The vertex cache stage is Tom Forsyth's "Linear-Speed Vertex Cache Optimisation", the overdraw stage is based on the
+// cluster sorting of Sander, Nehab and Barczak "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+//
+// SimplifyMesh removes triangles for the lower levels of detail of a mesh (see EntityTemplate::AddSimplifiedLOD). It leaves
+// vertices unused rather than removing them, OptimiseVertexFetch puts the used ones first so the rest can be dropped
+
+#ifndef _MESH_OPTIMISER_H_INCLUDED_
+#define _MESH_OPTIMISER_H_INCLUDED_
+
+#include "Vector3.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// Size of the FIFO vertex cache simulated when measuring and clustering. Modern GPUs don't have a simple cache like this, but
+// ordering for one still reduces the vertices shaded
+static const unsigned int SIMULATED_CACHE_SIZE = 16;
+
+
+// Average number of vertices that miss a FIFO cache of the given size per triangle, when drawing the given triangle list
+float AverageCacheMissRatio(const std::vector<uint32_t>& indices, unsigned int numVertices, unsigned int cacheSize = SIMULATED_CACHE_SIZE);
+
+// Reorder the triangles of a triangle list so vertices used by one triangle are soon used again, while they are still in the cache
+void OptimiseVertexCache(std::vector<uint32_t>& indices, unsigned int numVertices);
+
+// Reorder clusters of triangles from OptimiseVertexCache so the outer parts of the mesh tend to be drawn first, and hide what is
+// behind them. The threshold is how much worse the ACMR is allowed to become to make smaller clusters, which sort better
+void OptimiseOverdraw(std::vector<uint32_t>& indices, const Vector3* positions, unsigned int numVertices, float threshold = 1.05f);
+
+// Renumber vertices in the order the indices first use them, so vertex data is read from memory in order. Returns the old vertex
+// number of each new vertex, to reorder the vertex data with. Unused vertices are kept on the end
+std::vector<uint32_t> OptimiseVertexFetch(std::vector<uint32_t>& indices, unsigned int numVertices);
+
+// Reduce a triangle list to about the given fraction (detail) of its triangles by merging nearby vertices, see MeshOptimiser.cpp.
+// Only the indices change. Small parts of the mesh may disappear entirely at low detail
+void SimplifyMesh(std::vector<uint32_t>& indices, const Vector3* positions, unsigned int numVertices, float detail);
+
+
+#endif //_MESH_OPTIMISER_H_INCLUDED_
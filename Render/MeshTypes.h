@@ -15,8 +15,9 @@
 // Constants
 //--------------------------------------------------------------------------------------
 
-// Maximum bones allowed in a single mesh (across all its submeshes)
-static const int MAX_BONES = 64;
+// Maximum bones allowed in a single mesh (across all its submeshes). Bone matrices are read from the bone palette (see BonePalette.h)
+// so there is no shader limit, this is the most the 8-bit bone indices in a skinned vertex can address
+static const int MAX_BONES = 256;
 
 
 //--------------------------------------------------------------------------------------
@@ -43,4 +44,33 @@ enum class GeometryTypes : uint32_t
 ENUM_FLAG_OPERATORS(GeometryTypes)
 
 
+//--------------------------------------------------------------------------------------
+// Memory
+//--------------------------------------------------------------------------------------
+
+// Memory used by meshes and their materials, for the memory report (see Mesh::AddMemory and EntityManager::GetTemplateMemory).
+// GPU sizes are approximate, drivers add padding and alignment
+struct MeshMemory
+{
+	uint64_t vertexBytes   = 0; // GPU vertex and index data of the sub-meshes, in the shared geometry buffers
+	uint64_t indexBytes    = 0;
+	uint64_t textureBytes  = 0; // The texture versions in use, including mip-maps. Textures shared by materials count for each
+	uint64_t constantBytes = 0; // Material constant buffers
+	uint64_t cpuBytes      = 0; // Nodes, sub-meshes, matrices and render state objects kept on the CPU
+	uint32_t renderStates  = 0; // Including the cheaper shader levels of detail of each material
+
+	uint64_t GpuBytes() const  { return vertexBytes + indexBytes + textureBytes + constantBytes; }
+
+	void Add(const MeshMemory& other)
+	{
+		vertexBytes   += other.vertexBytes;
+		indexBytes    += other.indexBytes;
+		textureBytes  += other.textureBytes;
+		constantBytes += other.constantBytes;
+		cpuBytes      += other.cpuBytes;
+		renderStates  += other.renderStates;
+	}
+};
+
+
 #endif // _MESH_TYPES_H_INCLUDED_
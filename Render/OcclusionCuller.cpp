@@ -0,0 +1,166 @@
+//--------------------------------------------------------------------------------------
+// Occlusion culling of meshes hidden behind other geometry, using GPU predicates
+//--------------------------------------------------------------------------------------
+
+#include "OcclusionCuller.h"
+#include "Mesh.h"
+
+#include "Shader.h"
+#include "CBuffer.h"
+#include "CBufferTypes.h"
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the proxy geometry and shader. Throws std::runtime_error on failure
+OcclusionCuller::OcclusionCuller()
+{
+	// Proxies only need positions transformed to clip space, there is no pixel shader as nothing is written
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_p_p2c");
+	if (mVertexShader == nullptr)  throw std::runtime_error("Occlusion culling: " + DX->Shaders()->GetLastError());
+
+	D3D11_INPUT_ELEMENT_DESC vertexElements[] =
+	{
+		{ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+	mCubeLayout = DX->Shaders()->CreateInputLayout(vertexElements, 1);
+	if (mCubeLayout == nullptr)  throw std::runtime_error("Occlusion culling: " + DX->Shaders()->GetLastError());
+
+	// Cube from -1 to 1, which encloses a sphere of radius 1
+	const Vector3 vertices[8] =
+	{
+		{ -1, -1, -1 }, {  1, -1, -1 }, { -1,  1, -1 }, {  1,  1, -1 },
+		{ -1, -1,  1 }, {  1, -1,  1 }, { -1,  1,  1 }, {  1,  1,  1 },
+	};
+	const uint32_t indices[36] =
+	{
+		0, 2, 1,  1, 2, 3, // -Z
+		4, 5, 6,  5, 7, 6, // +Z
+		0, 1, 4,  1, 5, 4, // -Y
+		2, 6, 3,  3, 6, 7, // +Y
+		0, 4, 2,  2, 4, 6, // -X
+		1, 3, 5,  3, 7, 5, // +X
+	};
+
+	D3D11_BUFFER_DESC bufferDesc = {};
+	D3D11_SUBRESOURCE_DATA initData = {};
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.ByteWidth = sizeof(vertices);
+	initData.pSysMem = vertices;
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, &initData, &mCubeVertices)))
+		throw std::runtime_error("Occlusion culling: failure creating vertex buffer");
+
+	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	bufferDesc.ByteWidth = sizeof(indices);
+	initData.pSysMem = indices;
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, &initData, &mCubeIndices)))
+		throw std::runtime_error("Occlusion culling: failure creating index buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Call before rendering each camera view. Collects any results that have arrived from earlier frames for the statistics
+void OcclusionCuller::BeginFrame(const Vector3& cameraPosition, float nearClip)
+{
+	mCameraPosition = cameraPosition;
+	mNearClip = nearClip;
+
+	mStats = {};
+	std::erase_if(mPendingIds, [&](uint32_t id)
+	{
+		Query& query = mQueries[id];
+		BOOL visible;
+		if (DX->Context()->GetData(query.predicate, &visible, sizeof(visible), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  return false;
+
+		if (visible)  ++mStats.visible;
+		else          ++mStats.hidden;
+		query.resultPending = false;
+		return true;
+	});
+}
+
+
+// Set up an occlusion test for a mesh about to be rendered, with its bounding sphere in world space. Returns false if the mesh
+// should be rendered as normal without a test
+bool OcclusionCuller::BeginTest(uint32_t id, Mesh& mesh, const BoundingSphere& worldSphere)
+{
+	if (!WouldTest(mesh) || worldSphere.IsEmpty())  return false;
+
+	// If the camera is inside the proxy, or close enough for the near clip plane to cut into it, the proxy may not be drawn at
+	// all even though the mesh is visible. The farthest point of the cube is radius * sqrt(3) from its centre
+	if (Distance(mCameraPosition, worldSphere.centre) <= worldSphere.radius * 1.7321f + mNearClip)  return false;
+
+	if (id >= mQueries.size())  mQueries.resize(id + 1);
+	Query& query = mQueries[id];
+	if (query.predicate == nullptr)
+	{
+		D3D11_QUERY_DESC queryDesc = { D3D11_QUERY_OCCLUSION_PREDICATE, 0 };
+		if (FAILED(DX->Device()->CreatePredicate(&queryDesc, &query.predicate)))  return false;
+	}
+	if (!query.resultPending)
+	{
+		query.resultPending = true;
+		mPendingIds.push_back(id);
+	}
+
+	// Draw the proxy with depth testing but without writing depth. The rasterizer state is changed so the proxy is still drawn
+	// if the mesh is drawn with front face culling, the depth state is restored afterwards
+	RasterizerState previousRasterizerState = DX->States()->GetRasterizerState();
+	DepthState      previousDepthState      = DX->States()->GetDepthState();
+	DX->States()->SetRasterizerState(RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthReadOnly);
+
+	DX->Context()->VSSetShader(mVertexShader, nullptr, 0);
+	DX->Context()->PSSetShader(nullptr, nullptr, 0);
+	RenderState::Reset(); // Shaders have been changed outside of RenderState, so the mesh must set its own again
+
+	UINT stride = sizeof(Vector3);
+	UINT offset = 0;
+	DX->Context()->IASetVertexBuffers(0, 1, &mCubeVertices.p, &stride, &offset);
+	DX->Context()->IASetInputLayout(mCubeLayout);
+	DX->Context()->IASetIndexBuffer(mCubeIndices, DXGI_FORMAT_R32_UINT, 0);
+	DX->Context()->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	gPerMeshConstants.worldMatrix = MatrixScaling(worldSphere.radius) * MatrixTranslation(worldSphere.centre);
+	DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+
+	DX->Context()->Begin(query.predicate);
+	DX->Context()->DrawIndexed(36, 0, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+	DX->Context()->End(query.predicate);
+
+	DX->States()->SetRasterizerState(previousRasterizerState);
+	DX->States()->SetDepthState(previousDepthState);
+
+	// Draw calls from here until EndTest are skipped by the GPU if no pixel of the proxy passed the depth test
+	DX->Context()->SetPredication(query.predicate, FALSE);
+	++mStats.tests;
+	return true;
+}
+
+
+// Whether BeginTest may test the given mesh, meshes that would be tested must be rendered one at a time
+bool OcclusionCuller::WouldTest(Mesh& mesh)
+{
+	return mEnabled && mesh.SubMeshCount() >= MIN_SUBMESHES;
+}
+
+
+// Finish rendering a mesh whose test was started by BeginTest
+void OcclusionCuller::EndTest()
+{
+	DX->Context()->SetPredication(nullptr, FALSE);
+}
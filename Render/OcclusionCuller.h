@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// Occlusion culling of meshes hidden behind other geometry, using GPU predicates
+//--------------------------------------------------------------------------------------
+// Frustum culling (see Frustum.h) removes what is off screen, but in the chase camera views much of what is on screen is
+// hidden behind large obstacles. Before a mesh is rendered a cheap proxy is drawn for it - a box around its bounding sphere,
+// with depth testing but no depth or colour writes - inside a D3D11 occlusion predicate. The mesh is then rendered with
+// predication, so the GPU skips all of its draw calls if no pixel of the proxy passed the depth test. The test uses the depth
+// buffer as it is at that moment, so the occluders must be rendered first: in this app the static entities (obstacles, islands
+// etc.) are rendered before the moving ones, so they are the occluders and the moving entities are tested against them.
+//
+// The CPU never waits for a result, so there is no stall and no one-frame lag of the kind a test against the previous frame's
+// depth would have. The CPU still submits the draw calls of a hidden mesh, only the GPU work is saved. For that reason only
+// meshes with several parts are tested - for a single part mesh the proxy would cost about as much as the mesh.
+//
+// Results are read back a frame or more later, without waiting, just for the statistics shown in the control panel
+//
+//   occlusion.BeginFrame(cameraPosition, nearClip);
+//   bool tested = occlusion.BeginTest(EntityIndex(id), mesh, worldSphere);
+//   ... render the mesh ...
+//   if (tested)  occlusion.EndTest();
+
+#ifndef _OCCLUSION_CULLER_H_INCLUDED_
+#define _OCCLUSION_CULLER_H_INCLUDED_
+
+#include "Frustum.h"
+#include "Vector3.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+
+
+class OcclusionCuller
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the proxy geometry and shader. Throws std::runtime_error on failure
+	OcclusionCuller();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Call before rendering each camera view, with the camera position and near clip distance. Collects any results that have
+	// arrived from earlier frames for the statistics
+	void BeginFrame(const Vector3& cameraPosition, float nearClip);
+
+	// Set up an occlusion test for a mesh about to be rendered, with its bounding sphere in world space. The id identifies the
+	// thing being rendered (e.g. the entity's slot index) and must not be used twice in a frame. Returns false if the mesh is not
+	// worth testing or the camera is too close to its proxy, then the mesh should be rendered as normal and EndTest not called.
+	// If it returns true, render the mesh and then call EndTest. Render states must be set with the StateManager, they are
+	// restored after the proxy is drawn
+	bool BeginTest(uint32_t id, Mesh& mesh, const BoundingSphere& worldSphere);
+
+	// Whether BeginTest may test the given mesh, i.e. the culler is enabled and the mesh has enough parts to be worth testing.
+	// Meshes that would be tested must be rendered one at a time, the test covers a single draw
+	bool WouldTest(Mesh& mesh);
+
+	// Finish rendering a mesh whose test was started by BeginTest
+	void EndTest();
+
+	// Enable or disable occlusion culling, when disabled BeginTest always returns false
+	bool& Enabled()  { return mEnabled; }
+
+	// Statistics for the control panel. Tests is the number of meshes tested in the last frame. Results arrive later, hidden and
+	// visible are the counts of those results collected at the start of the last frame
+	struct Stats
+	{
+		uint32_t tests   = 0;
+		uint32_t hidden  = 0;
+		uint32_t visible = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Meshes with fewer parts than this are not tested
+	static constexpr unsigned int MIN_SUBMESHES = 2;
+
+	// Predicate for each id, created as needed. A predicate whose result has not been read yet is reused if its id is tested again,
+	// that result is then lost from the statistics
+	struct Query
+	{
+		CComPtr<ID3D11Predicate> predicate;
+		bool resultPending = false;
+	};
+	std::vector<Query> mQueries;
+	std::vector<uint32_t> mPendingIds; // Ids with results not yet read
+
+	// Unit cube from -1 to 1, drawn scaled to each bounding sphere
+	CComPtr<ID3D11Buffer>      mCubeVertices;
+	CComPtr<ID3D11Buffer>      mCubeIndices;
+	ID3D11InputLayout*         mCubeLayout   = nullptr; // Owned by the shader manager
+	ID3D11VertexShader*        mVertexShader = nullptr;
+
+	Vector3 mCameraPosition = { 0, 0, 0 };
+	float   mNearClip = 0;
+	bool    mEnabled  = true;
+
+	Stats mStats;
+};
+
+
+#endif //_OCCLUSION_CULLER_H_INCLUDED_
@@ -0,0 +1,271 @@
+//--------------------------------------------------------------------------------------
+// GPU particles - missile trails, explosions and mine blasts simulated and drawn without the CPU touching each particle
+//--------------------------------------------------------------------------------------
+
+#include "ParticleSystem.h"
+
+#include "RenderGlobals.h"
+#include "Shader.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <cstring>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	// Create a structured buffer of the given elements usable by the compute shaders and as a shader resource, with the given
+	// UAV flags (e.g. append / consume) and optional initial data. Throws std::runtime_error on failure
+	void CreateComputeBuffer(unsigned int elementSize, unsigned int numElements, UINT uavFlags, const void* initialData,
+	                         CComPtr<ID3D11Buffer>& buffer, CComPtr<ID3D11UnorderedAccessView>& uav, CComPtr<ID3D11ShaderResourceView>& srv)
+	{
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = numElements * elementSize;
+		bufferDesc.Usage               = D3D11_USAGE_DEFAULT;
+		bufferDesc.CPUAccessFlags      = 0;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = elementSize;
+		D3D11_SUBRESOURCE_DATA data = { initialData, 0, 0 };
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, initialData ? &data : nullptr, &buffer)))
+			throw std::runtime_error("Particles: failure creating buffer");
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+		uavDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		uavDesc.ViewDimension       = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.NumElements  = numElements;
+		uavDesc.Buffer.Flags        = uavFlags;
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = numElements;
+		if (FAILED(DX->Device()->CreateUnorderedAccessView(buffer, &uavDesc, &uav)) ||
+		    FAILED(DX->Device()->CreateShaderResourceView(buffer, &srvDesc, &srv)))
+			throw std::runtime_error("Particles: failure creating buffer views");
+	}
+}
+
+
+// Load the particle shaders and create the particle pool and lists. Throws std::runtime_error on failure
+ParticleSystem::ParticleSystem()
+{
+	mEmitShader     = DX->Shaders()->LoadComputeShader("cs_particles-emit");
+	mArgsShader     = DX->Shaders()->LoadComputeShader("cs_particles-args");
+	mSimulateShader = DX->Shaders()->LoadComputeShader("cs_particles-simulate");
+	mVertexShader   = DX->Shaders()->LoadVertexShader ("vs_particle_uv");
+	mPixelShader    = DX->Shaders()->LoadPixelShader  ("ps_particle");
+	if (mEmitShader == nullptr || mArgsShader == nullptr || mSimulateShader == nullptr || mVertexShader == nullptr || mPixelShader == nullptr)
+		throw std::runtime_error("Particles: " + DX->Shaders()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(ParticleConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Particles: failure creating constant buffer");
+
+	// Written only by CopyStructureCount, the dead list's count first then the alive list's
+	D3D11_BUFFER_DESC countDesc = {};
+	countDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	countDesc.ByteWidth = 16;
+	countDesc.Usage     = D3D11_USAGE_DEFAULT;
+	if (FAILED(DX->Device()->CreateBuffer(&countDesc, nullptr, &mCountBuffer)))
+		throw std::runtime_error("Particles: failure creating count buffer");
+
+	// The pool needs no initial data, a particle is only read once it has been emitted. Every slot starts in the dead list
+	CreateComputeBuffer(sizeof(GpuParticle), MAX_PARTICLES, 0, nullptr, mParticleBuffer, mParticleUAV, mParticleSRV);
+	std::vector<uint32_t> slots(MAX_PARTICLES);
+	std::iota(slots.begin(), slots.end(), 0);
+	CreateComputeBuffer(sizeof(uint32_t), MAX_PARTICLES, D3D11_BUFFER_UAV_FLAG_APPEND, slots.data(), mDeadList.buffer, mDeadList.uav, mDeadList.srv);
+	for (auto& aliveList : mAliveLists)
+		CreateComputeBuffer(sizeof(uint32_t), MAX_PARTICLES, D3D11_BUFFER_UAV_FLAG_APPEND, nullptr, aliveList.buffer, aliveList.uav, aliveList.srv);
+
+	// A raw buffer of both sets of indirect arguments. The draw is 4 vertices per particle, its instance count copied from the
+	// alive list each frame
+	const uint32_t args[] = { 0, 1, 1, 0,  4, 0, 0, 0 };
+	D3D11_BUFFER_DESC argsDesc = {};
+	argsDesc.BindFlags      = D3D11_BIND_UNORDERED_ACCESS;
+	argsDesc.ByteWidth      = sizeof(args);
+	argsDesc.Usage          = D3D11_USAGE_DEFAULT;
+	argsDesc.CPUAccessFlags = 0;
+	argsDesc.MiscFlags      = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS | D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
+	D3D11_SUBRESOURCE_DATA argsData = { args, 0, 0 };
+	D3D11_UNORDERED_ACCESS_VIEW_DESC argsUAVDesc = {};
+	argsUAVDesc.Format              = DXGI_FORMAT_R32_TYPELESS;
+	argsUAVDesc.ViewDimension       = D3D11_UAV_DIMENSION_BUFFER;
+	argsUAVDesc.Buffer.FirstElement = 0;
+	argsUAVDesc.Buffer.NumElements  = static_cast<UINT>(std::size(args));
+	argsUAVDesc.Buffer.Flags        = D3D11_BUFFER_UAV_FLAG_RAW;
+	if (FAILED(DX->Device()->CreateBuffer(&argsDesc, &argsData, &mArgsBuffer)) ||
+	    FAILED(DX->Device()->CreateUnorderedAccessView(mArgsBuffer, &argsUAVDesc, &mArgsUAV)))
+		throw std::runtime_error("Particles: failure creating argument buffer");
+
+	// The counters of append / consume buffers are only set by binding them, every slot starts dead and none alive
+	ID3D11UnorderedAccessView* listUAVs[] = { mDeadList.uav, mAliveLists[0].uav, mAliveLists[1].uav };
+	UINT listCounts[] = { MAX_PARTICLES, 0, 0 };
+	ID3D11UnorderedAccessView* nullUAVs[3] = {};
+	DX->Context()->CSSetUnorderedAccessViews(0, 3, listUAVs, listCounts);
+	DX->Context()->CSSetUnorderedAccessViews(0, 3, nullUAVs, nullptr);
+
+	mConstants.gravity = GRAVITY;
+	mConstants.drag    = DRAG;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start a burst of particles at the next Update
+void ParticleSystem::Emit(const ParticleBurst& burst)
+{
+	if (mEnabled && burst.numParticles > 0)  mPendingBursts.push_back(burst);
+}
+
+
+// Start the bursts emitted and move the particles on by the time advanced since the last Update
+void ParticleSystem::Update()
+{
+	mStats = {};
+
+	// Bursts are clipped to the pool, the emit shader also stops at the number of free slots
+	auto channel = [](float value) { return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	mGpuBursts.clear();
+	uint32_t numNew = 0;
+	for (auto& burst : mPendingBursts)
+	{
+		uint32_t numParticles = std::min(burst.numParticles, MAX_PARTICLES - numNew);
+		if (numParticles == 0)  break;
+		uint32_t colour = channel(burst.colour.r) | (channel(burst.colour.g) << 8) | (channel(burst.colour.b) << 16) | (channel(burst.colour.a) << 24);
+		mGpuBursts.push_back({ burst.position, burst.speed, burst.velocity, burst.lifetime, colour, burst.size, numNew, numParticles });
+		numNew += numParticles;
+	}
+	mPendingBursts.clear();
+	if (numNew > 0 && !UploadBursts(mGpuBursts.data(), static_cast<unsigned int>(mGpuBursts.size())))  numNew = 0;
+	mStats.bursts    = numNew > 0 ? static_cast<uint32_t>(mGpuBursts.size()) : 0;
+	mStats.particles = numNew;
+
+	mConstants.frameTime       = mPendingTime;
+	mConstants.numBursts       = mStats.bursts;
+	mConstants.numNewParticles = numNew;
+	++mConstants.randomSeed;
+	mPendingTime = 0;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	auto context = DX->Context();
+	SlotList& aliveIn  = mAliveLists[mCurrentAlive];
+	SlotList& aliveOut = mAliveLists[1 - mCurrentAlive];
+	ID3D11Buffer* constantBuffers[] = { mConstantBuffer, mCountBuffer };
+	context->CSSetConstantBuffers(0, 2, constantBuffers);
+
+	// The vertex shader of the last Render may still have the pool and an alive list bound, they can't be written while they are
+	ID3D11ShaderResourceView* nullViews[2] = {};
+	context->VSSetShaderResources(0, 2, nullViews);
+
+	// Emit, the shader stops at the number of free slots. A count of -1 keeps the count a list already has
+	const UINT KEEP = static_cast<UINT>(-1);
+	if (numNew > 0)
+	{
+		context->CopyStructureCount(mCountBuffer, 0, mDeadList.uav);
+		ID3D11UnorderedAccessView* uavs[] = { mParticleUAV, mDeadList.uav, aliveIn.uav };
+		UINT counts[] = { KEEP, KEEP, KEEP };
+		context->CSSetUnorderedAccessViews(0, 3, uavs, counts);
+		context->CSSetShaderResources(0, 1, &mBurstSRV.p);
+		context->CSSetShader(mEmitShader, nullptr, 0);
+		context->Dispatch((numNew + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE, 1, 1);
+		ID3D11ShaderResourceView* nullView = nullptr;
+		context->CSSetShaderResources(0, 1, &nullView);
+	}
+
+	// Thread groups for the particles alive, then simulate them into the other alive list, starting it from empty. With nothing
+	// alive the indirect dispatch is of no groups
+	context->CopyStructureCount(mCountBuffer, 4, aliveIn.uav);
+	context->CSSetUnorderedAccessViews(0, 1, &mArgsUAV.p, nullptr);
+	context->CSSetShader(mArgsShader, nullptr, 0);
+	context->Dispatch(1, 1, 1);
+
+	ID3D11UnorderedAccessView* uavs[] = { mParticleUAV, mDeadList.uav, aliveIn.uav, aliveOut.uav };
+	UINT counts[] = { KEEP, KEEP, KEEP, 0 };
+	context->CSSetUnorderedAccessViews(0, 4, uavs, counts);
+	context->CSSetShader(mSimulateShader, nullptr, 0);
+	context->DispatchIndirect(mArgsBuffer, DISPATCH_ARGS_OFFSET);
+
+	ID3D11UnorderedAccessView* nullUAVs[4] = {};
+	context->CSSetUnorderedAccessViews(0, 4, nullUAVs, nullptr);
+	context->CSSetShader(nullptr, nullptr, 0);
+
+	// The survivors are drawn this frame and simulated next frame
+	context->CopyStructureCount(mArgsBuffer, DRAW_INSTANCE_COUNT_OFFSET, aliveOut.uav);
+	mCurrentAlive = 1 - mCurrentAlive;
+}
+
+
+// Draw the live particles with the current per-camera constants and render states
+void ParticleSystem::Render()
+{
+	if (!mEnabled)  return;
+
+	auto context = DX->Context();
+	ID3D11ShaderResourceView* vertexViews[] = { mParticleSRV, mAliveLists[mCurrentAlive].srv };
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->VSSetShaderResources(0, 2, vertexViews);
+	context->PSSetShader(mPixelShader, nullptr, 0);
+	context->DrawInstancedIndirect(mArgsBuffer, DRAW_ARGS_OFFSET);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	ID3D11ShaderResourceView* nullViews[2] = {};
+	context->VSSetShaderResources(0, 2, nullViews);
+	RenderState::Reset(); // Shaders were changed outside of RenderState
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure the burst buffer holds the given bursts, then copy them in. Returns false on failure
+bool ParticleSystem::UploadBursts(const GpuBurst* bursts, unsigned int numBursts)
+{
+	// Replace the buffer with a larger one if it is too small. The old contents are not needed
+	if (numBursts > mBurstCapacity)
+	{
+		unsigned int capacity = (mBurstCapacity > 0) ? mBurstCapacity : INITIAL_BURST_CAPACITY;
+		while (capacity < numBursts)  capacity *= 2;
+		mBurstSRV      = nullptr;
+		mBurstBuffer   = nullptr;
+		mBurstCapacity = 0;
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = capacity * sizeof(GpuBurst);
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC; // Rewritten every frame there are bursts
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = sizeof(GpuBurst);
+		if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, nullptr, &mBurstBuffer)))  return false;
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format              = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements  = capacity;
+		if (FAILED(DX->Device()->CreateShaderResourceView(mBurstBuffer, &srvDesc, &mBurstSRV)))  { mBurstBuffer = nullptr;  return false; }
+		mBurstCapacity = capacity;
+	}
+
+	// Discard the previous contents, the GPU keeps any copy it is still using so this never waits for it
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(DX->Context()->Map(mBurstBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))  return false;
+	std::memcpy(mapped.pData, bursts, numBursts * sizeof(GpuBurst));
+	DX->Context()->Unmap(mBurstBuffer, 0);
+	return true;
+}
@@ -0,0 +1,192 @@
+//--------------------------------------------------------------------------------------
+// GPU particles - missile trails, explosions and mine blasts simulated and drawn without the CPU touching each particle
+//--------------------------------------------------------------------------------------
+// Particles live in a fixed pool of MAX_PARTICLES in a GPU buffer. The free slots of the pool are held in a dead list and the
+// slots in use in an alive list, both append / consume buffers of slot indices. Each frame three compute shaders run:
+//   cs_particles-emit      one thread per new particle consumes a slot from the dead list, starts the particle there from its
+//                          burst and appends the slot to the alive list. Bursts asking for more particles than are free get fewer
+//   cs_particles-args      turns the number of particles alive into the thread groups of an indirect dispatch
+//   cs_particles-simulate  one thread per live particle moves it on, then appends its slot to the other alive list, or back to
+//                          the dead list once it has had its lifetime. The two alive lists swap roles every frame
+// The counts of the lists are only copied between buffers on the GPU (CopyStructureCount), so the CPU never waits for them and a
+// frame's work on the CPU is just the bursts emitted, whatever number of particles are alive. The live particles are drawn with
+// one DrawInstancedIndirect in the additive pass, a camera facing quad for each, by vs_particle_uv and ps_particle
+//
+//   particleSystem.Emit(burst);  // Any number of times, e.g. for each game event of the simulation steps
+//   particleSystem.Advance(stepTime);
+//   particleSystem.Update();     // Once a frame, before the views are rendered
+//   particleSystem.Render();     // In each view, with the additive pass's states set
+//
+// The game decides what each event looks like, see Scene::EmitParticleEffects. Particles are cosmetic, they are not saved in
+// checkpoints or replays
+
+#ifndef _PARTICLE_SYSTEM_H_INCLUDED_
+#define _PARTICLE_SYSTEM_H_INCLUDED_
+
+#include "Vector3.h"
+#include "ColourTypes.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+
+// A number of particles started together at a point, e.g. an explosion or one puff of a missile trail. Each particle moves off
+// with the burst's velocity plus a random direction at up to the given speed, and is a quad of the given size (in world units)
+// that brightens then fades over the lifetime (in seconds, each particle lives from half to all of it)
+struct ParticleBurst
+{
+	Vector3      position;
+	Vector3      velocity     = { 0, 0, 0 };
+	float        speed        = 10.0f;
+	float        lifetime     = 1.0f;
+	float        size         = 2.0f;
+	ColourRGBA   colour       = { 1, 1, 1, 1 };
+	unsigned int numParticles = 16;
+};
+
+
+class ParticleSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the particle shaders and create the particle pool and lists. Throws std::runtime_error on failure, e.g. if the device
+	// doesn't support compute shaders
+	ParticleSystem();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Most particles alive at once
+	static constexpr uint32_t MAX_PARTICLES = 128 * 1024;
+
+	// Downward acceleration of the particles and the fraction of their speed they lose each second
+	static constexpr float GRAVITY = 9.81f;
+	static constexpr float DRAG    = 1.5f;
+
+	// Start a burst of particles at the next Update. Bursts wait on the CPU until then, so this may be called from the simulation
+	// steps whichever thread they run on, as long as it is not during Update
+	void Emit(const ParticleBurst& burst);
+
+	// Move the particle clock on by the time of a simulation step, the particles move by the time gathered here at the next Update.
+	// Particles stay still while the game is paused
+	void Advance(float stepTime)  { mPendingTime += stepTime; }
+
+	// Start the bursts emitted and move the particles on by the time advanced since the last Update
+	void Update();
+
+	// Draw the live particles with the current per-camera constants and render states (the additive pass's)
+	void Render();
+
+	// Whether particles are drawn and emitted, when off the bursts are dropped and particles already alive are left to die out
+	bool& Enabled()  { return mEnabled; }
+
+	// Bursts and particles started by the last Update. The number alive stays on the GPU
+	struct Stats
+	{
+		uint32_t bursts    = 0;
+		uint32_t particles = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A particle and a burst as the shaders read them, must match the structures in cs_particles-emit and cs_particles-simulate
+	struct GpuParticle
+	{
+		Vector3  position;
+		float    age;
+		Vector3  velocity;
+		float    lifetime;
+		uint32_t colour;   // RGBA, 8 bits each from the lowest
+		float    size;
+		float    padding[2];
+	};
+	struct GpuBurst
+	{
+		Vector3  position;
+		float    speed;
+		Vector3  velocity;
+		float    lifetime;
+		uint32_t colour;
+		float    size;
+		uint32_t firstParticle; // Of the particles started this frame, bursts are in order so a thread finds its burst by search
+		uint32_t numParticles;
+	};
+
+	// Make sure the burst buffer holds the given bursts, then copy them in. Returns false on failure
+	bool UploadBursts(const GpuBurst* bursts, unsigned int numBursts);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Threads in each group of the compute shaders, must match numthreads in the particle compute shaders
+	static constexpr unsigned int THREAD_GROUP_SIZE = 256;
+
+	// The burst buffer starts with space for this many bursts, then doubles in size as needed
+	static constexpr unsigned int INITIAL_BURST_CAPACITY = 256;
+
+	// Where the arguments of the indirect dispatch and the indirect draw are in the argument buffer, in bytes
+	static constexpr UINT DISPATCH_ARGS_OFFSET       = 0;
+	static constexpr UINT DRAW_ARGS_OFFSET           = 16;
+	static constexpr UINT DRAW_INSTANCE_COUNT_OFFSET = DRAW_ARGS_OFFSET + 4;
+
+	bool  mEnabled = true;
+	Stats mStats;
+
+	ID3D11ComputeShader* mEmitShader     = nullptr; // Owned by the shader manager
+	ID3D11ComputeShader* mArgsShader     = nullptr;
+	ID3D11ComputeShader* mSimulateShader = nullptr;
+	ID3D11VertexShader*  mVertexShader   = nullptr;
+	ID3D11PixelShader*   mPixelShader    = nullptr;
+	ID3D11Buffer*        mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	ParticleConstants    mConstants;
+
+	// The counts of the dead and alive lists for the compute shaders, written on the GPU by CopyStructureCount
+	CComPtr<ID3D11Buffer> mCountBuffer;
+
+	// The particle pool, with a view for each of the compute shaders and the vertex shader
+	CComPtr<ID3D11Buffer>              mParticleBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mParticleUAV;
+	CComPtr<ID3D11ShaderResourceView>  mParticleSRV;
+
+	// Slot lists, the alive list being drawn and emitted into this frame is mAliveLists[mCurrentAlive]
+	struct SlotList
+	{
+		CComPtr<ID3D11Buffer>              buffer;
+		CComPtr<ID3D11UnorderedAccessView> uav; // Append / consume
+		CComPtr<ID3D11ShaderResourceView>  srv;
+	};
+	SlotList     mDeadList;
+	SlotList     mAliveLists[2];
+	unsigned int mCurrentAlive = 0;
+
+	// The indirect dispatch and draw arguments, see the offsets above
+	CComPtr<ID3D11Buffer>              mArgsBuffer;
+	CComPtr<ID3D11UnorderedAccessView> mArgsUAV;
+
+	// Bursts emitted since the last Update, and the copy for the GPU. Cleared rather than recreated to keep the capacity
+	std::vector<ParticleBurst> mPendingBursts;
+	std::vector<GpuBurst>      mGpuBursts;
+	float                      mPendingTime = 0;
+
+	CComPtr<ID3D11Buffer>             mBurstBuffer;
+	CComPtr<ID3D11ShaderResourceView> mBurstSRV;
+	unsigned int                      mBurstCapacity = 0;
+};
+
+
+#endif //_PARTICLE_SYSTEM_H_INCLUDED_
@@ -0,0 +1,129 @@
+//--------------------------------------------------------------------------------------
+// Render counters - draw calls, state changes and uploads made by the render layer, frame by frame and pass by pass
+//--------------------------------------------------------------------------------------
+
+#include "RenderCounters.h"
+
+
+RenderCounters gRenderCounters;
+
+// The calling thread's counters, see CurrentThreadCounts
+static thread_local void* tRenderCounts = nullptr;
+
+
+/*-----------------------------------------------------------------------------------------
+   Types
+-----------------------------------------------------------------------------------------*/
+
+// Name of a counter for display
+const char* RenderCounters::Name(RenderCounter counter)
+{
+	static const char* NAMES[NUM_COUNTERS] =
+	{
+		"Draws",
+		"Shader Binds",
+		"Shader Binds Skipped",
+		"Texture Binds",
+		"Texture Binds Skipped",
+		"Sampler Binds",
+		"Sampler Binds Skipped",
+		"Rasterizer Changes",
+		"Depth Changes",
+		"Blend Changes",
+		"CBuffer Maps",
+		"CBuffer Bytes",
+		"Vertex Buffer Binds",
+		"Index Buffer Binds",
+		"Input Layout Binds",
+	};
+	return NAMES[static_cast<int>(counter)];
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add to a counter of the calling thread. Only this thread writes them, so a plain load and store is enough
+void RenderCounters::Add(RenderCounter counter, uint64_t amount /*= 1*/)
+{
+	std::atomic<uint64_t>& count = CurrentThreadCounts().counts[static_cast<int>(counter)];
+	count.store(count.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+
+// Start a pass. The frame's list of passes keeps every name seen, so its strings are only created the first time
+void RenderCounters::BeginPass(const std::string& name)
+{
+	size_t pass = 0;
+	while (pass < mPasses.size() && mPasses[pass].pass.name != name)  ++pass;
+	if (pass == mPasses.size())  mPasses.push_back({ { name } });
+
+	mPasses[pass].used = true;
+	mOpenPasses.push_back({ pass, Totals() });
+}
+
+
+// Finish the innermost open pass, adding everything counted since it started
+void RenderCounters::EndPass()
+{
+	if (mOpenPasses.empty())  return;
+
+	Counts totals = Totals();
+	const OpenPass& open = mOpenPasses.back();
+	Counts& counts = mPasses[open.pass].pass.counts;
+	for (int i = 0; i < NUM_COUNTERS; ++i)  counts[i] += totals[i] - open.start[i];
+	mOpenPasses.pop_back();
+}
+
+
+// Keep the counts since the last call as the last frame
+void RenderCounters::NextFrame()
+{
+	Counts totals = Totals();
+	for (int i = 0; i < NUM_COUNTERS; ++i)  mLastFrame.total[i] = totals[i] - mFrameStart[i];
+	mFrameStart = totals;
+
+	// Copied over the last frame's passes so their strings keep their memory
+	size_t numUsed = 0;
+	for (PassCounts& pass : mPasses)
+	{
+		if (!pass.used)  continue;
+		if (numUsed == mLastFrame.passes.size())  mLastFrame.passes.emplace_back();
+		mLastFrame.passes[numUsed] = pass.pass;
+		++numUsed;
+		pass.pass.counts = {};
+		pass.used = false;
+	}
+	mLastFrame.passes.resize(numUsed);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// The calling thread's counters, created the first time it counts anything. Counters are kept after their thread ends
+RenderCounters::ThreadCounts& RenderCounters::CurrentThreadCounts()
+{
+	if (tRenderCounts == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mThreadsMutex);
+		mThreads.push_back(std::make_unique<ThreadCounts>());
+		tRenderCounts = mThreads.back().get();
+	}
+	return *static_cast<ThreadCounts*>(tRenderCounts);
+}
+
+
+// Every thread's counters added up
+RenderCounters::Counts RenderCounters::Totals()
+{
+	Counts totals = {};
+	std::lock_guard<std::mutex> lock(mThreadsMutex);
+	for (const auto& thread : mThreads)
+	{
+		for (int i = 0; i < NUM_COUNTERS; ++i)  totals[i] += thread->counts[i].load(std::memory_order_relaxed);
+	}
+	return totals;
+}
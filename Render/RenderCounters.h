@@ -0,0 +1,140 @@
+//--------------------------------------------------------------------------------------
+// Render counters - draw calls, state changes and uploads made by the render layer, frame by frame and pass by pass
+//--------------------------------------------------------------------------------------
+// The places the renderer talks to D3D add to a counter for each call they make, and for each call their caches of the
+// current state saved them from making (RenderState::Apply skips shaders, textures and samplers already set). Counting may
+// happen on any thread, as draws are recorded into deferred contexts on the job system's threads, so each thread adds to
+// counters of its own and the totals are only summed when needed.
+//
+// Passes are the scopes marked for the GPU profiler (see GpuProfiler::BeginScope), everything counted between the start and
+// end of a pass is counted to it - including work on other threads, which always finishes within the pass that started it.
+// A pass used more than once in a frame reports the total, and nested passes are also counted in the pass enclosing them.
+// Once a frame, at the end of Scene::Render, NextFrame keeps the frame's counts for the control panel and the fly-through
+// benchmark's results
+//
+//   gRenderCounters.Add(RenderCounter::Draws);
+
+#ifndef _RENDER_COUNTERS_H_INCLUDED_
+#define _RENDER_COUNTERS_H_INCLUDED_
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+// What is counted
+enum class RenderCounter
+{
+	Draws,               // DrawIndexed and every other draw call
+	ShaderBinds,         // Vertex and pixel shaders set by RenderState::Apply...
+	ShaderBindsSkipped,  // ...and left as they were because they were already set
+	TextureBinds,
+	TextureBindsSkipped,
+	SamplerBinds,
+	SamplerBindsSkipped,
+	RasterizerChanges,   // Made by StateManager, which ignores requests for the current state
+	DepthChanges,
+	BlendChanges,
+	CBufferMaps,         // Constant buffer updates and the bytes written by them
+	CBufferBytes,
+	VertexBufferBinds,   // Made by GeometryManager::Bind, which ignores buffers already bound
+	IndexBufferBinds,
+	InputLayoutBinds,
+
+	Count
+};
+
+
+class RenderCounters
+{
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	static constexpr int NUM_COUNTERS = static_cast<int>(RenderCounter::Count);
+
+	using Counts = std::array<uint64_t, NUM_COUNTERS>;
+
+	// Name of a counter for display
+	static const char* Name(RenderCounter counter);
+
+	struct Pass
+	{
+		std::string name;
+		Counts      counts = {};
+	};
+
+	// A frame's counts in total and for each pass used in it, in the order passes were first used
+	struct Frame
+	{
+		Counts            total = {};
+		std::vector<Pass> passes;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add to a counter, on any thread
+	void Add(RenderCounter counter, uint64_t amount = 1);
+
+	// Start and finish a pass, on the main thread. Every BeginPass must be matched by an EndPass. Called by GpuProfiler's scopes
+	void BeginPass(const std::string& name);
+	void EndPass();
+
+	// Keep the counts since the last call as the last frame, call once a frame on the main thread
+	void NextFrame();
+
+	// The last frame collected
+	const Frame& LastFrame()  { return mLastFrame; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// One thread's counters, only ever added to and only by that thread, so reading them needs no lock
+	struct ThreadCounts
+	{
+		std::array<std::atomic<uint64_t>, NUM_COUNTERS> counts = {};
+	};
+
+	// The calling thread's counters, created the first time it counts anything
+	ThreadCounts& CurrentThreadCounts();
+
+	// Every thread's counters added up, since the start of the app
+	Counts Totals();
+
+	std::mutex                                 mThreadsMutex;
+	std::vector<std::unique_ptr<ThreadCounts>> mThreads;
+
+	// Passes seen so far with their counts this frame. The open passes are indices into it, innermost last, with the totals
+	// when each started
+	struct PassCounts
+	{
+		Pass pass;
+		bool used = false;
+	};
+	std::vector<PassCounts> mPasses;
+	struct OpenPass
+	{
+		size_t pass;
+		Counts start;
+	};
+	std::vector<OpenPass> mOpenPasses;
+
+	Counts mFrameStart = {};
+	Frame  mLastFrame;
+};
+
+
+// The counters the render layer adds to
+extern RenderCounters gRenderCounters;
+
+
+#endif //_RENDER_COUNTERS_H_INCLUDED_
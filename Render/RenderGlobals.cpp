@@ -14,6 +14,7 @@
 
 #include "RenderGlobals.h"
 #include "CBuffer.h"
+#include "MeshManager.h"
 
 
 //--------------------------------------------------------------------------------------
@@ -22,7 +23,14 @@
 // DX encapsulates the important D3DDevice and D3DContext objects used for almost all DirectX calls
 // as well as a few other useful global DirectX data such as backbuffer size
 
-std::unique_ptr<DXDevice> DX;
+std::unique_ptr<DXDevice>   DX;
+std::unique_ptr<MeshManager> gHeadlessMeshes;
+
+// The mesh manager to load meshes with - the DX device's, or gHeadlessMeshes if there is no device
+MeshManager* Meshes()
+{
+	return DX != nullptr ? DX->Meshes() : gHeadlessMeshes.get();
+}
 
 
 //--------------------------------------------------------------------------------------
@@ -39,9 +47,11 @@ ID3D11Buffer*      gPerCameraConstantBuffer;
 PerMeshConstants   gPerMeshConstants;       // As above, but constants (settings) that change per-mesh (e.g. world matrix)
 ID3D11Buffer*      gPerMeshConstantBuffer;
 
+SkinningConstants  gSkinningConstants;      // Where skinned meshes' bones are in the bone palette, only bound while rendering them
+ID3D11Buffer*      gSkinningConstantBuffer;
+
 // There are also per-material constants - settings that change to suit the material a submesh uses
-// However those constants are held in the MeshRenderState objects held in the submeshes, so no global here
-ID3D11Buffer* gPerMaterialConstantBuffer; // The GPU buffer that will receive per-material constants
+// However those constants and their buffers are held in the RenderState objects held in the submeshes, so no global here
 
 
 //--------------------------------------------------------------------------------------
@@ -56,11 +66,11 @@ bool CreateCBuffers()
 	// See the comments above where these variable are declared and also the UpdateScene function
 	gPerFrameConstantBuffer    = DX->CBuffers()->CreateCBuffer(sizeof(PerFrameConstants));
 	gPerCameraConstantBuffer   = DX->CBuffers()->CreateCBuffer(sizeof(PerCameraConstants));
-	gPerMaterialConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(PerMaterialConstants));
 	gPerMeshConstantBuffer     = DX->CBuffers()->CreateCBuffer(sizeof(PerMeshConstants));
+	gSkinningConstantBuffer    = DX->CBuffers()->CreateCBuffer(sizeof(SkinningConstants));
 
 	if (gPerFrameConstantBuffer == nullptr || gPerCameraConstantBuffer   == nullptr ||
-		gPerMeshConstantBuffer  == nullptr || gPerMaterialConstantBuffer == nullptr)
+		gPerMeshConstantBuffer  == nullptr || gSkinningConstantBuffer  == nullptr)
 	{
 		return false;
 	}
@@ -69,8 +79,9 @@ bool CreateCBuffers()
 	// buffer declaration in the shaders (see Common.hlsli)   e.g. cbuffer bufferName : register(b?)   where ? is the slot number
 	DX->CBuffers()->EnableCBuffer(gPerFrameConstantBuffer,    0);
 	DX->CBuffers()->EnableCBuffer(gPerCameraConstantBuffer,   1);
-	DX->CBuffers()->EnableCBuffer(gPerMeshConstantBuffer,     2);
-	DX->CBuffers()->EnableCBuffer(gPerMaterialConstantBuffer, 3);
+	DX->CBuffers()->EnableCBuffer(gPerMeshConstantBuffer,     PER_MESH_CBUFFER_SLOT);
+	// Slot 3 is for per-material constants, each RenderState binds its own buffer there (see RenderState::Apply)
+	// The skinning buffer is not enabled here, Mesh::Render binds it only for skinned meshes
 
 	return true;
 }
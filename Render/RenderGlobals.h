@@ -20,13 +20,22 @@
 
 #include <memory>
 
+class MeshManager;
+
 //--------------------------------------------------------------------------------------
 // DirectX Device
 //--------------------------------------------------------------------------------------
 // DX encapsulates the important D3DDevice and D3DContext objects used for almost all DirectX calls
 // as well as a few other useful global DirectX data such as backbuffer size
+//
+// When the app runs headless (a simulation only run from the command line) there is no device and DX is null. Meshes
+// are then loaded by gHeadlessMeshes, which keeps only their CPU-side data (nodes, bounds and geometry)
 
-extern std::unique_ptr<DXDevice> DX;
+extern std::unique_ptr<DXDevice>   DX;
+extern std::unique_ptr<MeshManager> gHeadlessMeshes;
+
+// The mesh manager to load meshes with - the DX device's, or gHeadlessMeshes if there is no device
+MeshManager* Meshes();
 
 
 //--------------------------------------------------------------------------------------
@@ -40,12 +49,16 @@ extern ID3D11Buffer*      gPerFrameConstantBuffer;  // The GPU buffer that will
 extern PerCameraConstants gPerCameraConstants;      // As above, but constants (settings) that change for each camera viewpoint
 extern ID3D11Buffer*      gPerCameraConstantBuffer;
 
-extern PerMeshConstants   gPerMeshConstants;        // As above, but constants (settings) that change per-mesh (e.g. world matrix)
-extern ID3D11Buffer*      gPerMeshConstantBuffer;
+extern PerMeshConstants   gPerMeshConstants;        // As above, but constants (settings) that change per-mesh (e.g. world matrix). Updated
+extern ID3D11Buffer*      gPerMeshConstantBuffer;   // with CBufferManager::UpdateDrawCBuffer, so may be in the per-draw ring instead
+static const unsigned int PER_MESH_CBUFFER_SLOT = 2;
+
+extern SkinningConstants  gSkinningConstants;       // Bone palette offsets for skinned meshes, the buffer is only bound on slot
+extern ID3D11Buffer*      gSkinningConstantBuffer;  // SKINNING_CBUFFER_SLOT while rendering them (see Mesh::Render)
+static const unsigned int SKINNING_CBUFFER_SLOT = 4;
 
 // There are also per-material constants - settings that change to suit the material a submesh uses
-// However those constants are held in the MeshRenderState objects held in the submeshes, so no global here
-extern ID3D11Buffer*      gPerMaterialConstantBuffer; // The GPU buffer that will receive per-material constants
+// However those constants and their buffers are held in the RenderState objects held in the submeshes, so no global here
 
 
 // Create all the global constant buffers. Returns true on success
@@ -0,0 +1,382 @@
+//--------------------------------------------------------------------------------------
+// Render graph - the passes of a frame, ordered and given their render targets from what each declares it reads and writes
+//--------------------------------------------------------------------------------------
+
+#include "RenderGraph.h"
+
+#include "RenderGlobals.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Pass builder / context
+-----------------------------------------------------------------------------------------*/
+
+void RenderGraph::PassBuilder::Read(Resource texture)
+{
+	mGraph.mPasses[mPass].accesses.push_back({ texture, false, {} });
+}
+
+void RenderGraph::PassBuilder::Write(Resource texture, const Clear& clear /*= {}*/)
+{
+	mGraph.mPasses[mPass].accesses.push_back({ texture, true, clear });
+}
+
+void RenderGraph::PassBuilder::SideEffect()
+{
+	mGraph.mPasses[mPass].sideEffect = true;
+}
+
+
+ID3D11DeviceContext* RenderGraph::PassContext::Context()
+{
+	return DX->Context();
+}
+
+// Null for imported textures
+ID3D11Texture2D* RenderGraph::PassContext::Texture(Resource texture)
+{
+	auto pooled = mGraph.mResources[texture].pooled;
+	return pooled != nullptr ? pooled->texture.p : nullptr;
+}
+
+ID3D11RenderTargetView* RenderGraph::PassContext::RenderTarget(Resource texture)
+{
+	return mGraph.mResources[texture].renderTarget;
+}
+
+ID3D11DepthStencilView* RenderGraph::PassContext::DepthStencil(Resource texture)
+{
+	return mGraph.mResources[texture].depthStencil;
+}
+
+ID3D11ShaderResourceView* RenderGraph::PassContext::ShaderResource(Resource texture)
+{
+	return mGraph.mResources[texture].shaderResource;
+}
+
+// Bind a texture the pass reads to a pixel shader slot, it is unbound before a later pass writes the texture
+void RenderGraph::PassContext::BindPixelTexture(unsigned int slot, Resource texture)
+{
+	auto& resource = mGraph.mResources[texture];
+	DX->Context()->PSSetShaderResources(slot, 1, &resource.shaderResource);
+	resource.boundSlots.push_back(slot);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Start building a new frame, forgetting the passes and resources of the last one
+void RenderGraph::BeginFrame()
+{
+	mResources.clear();
+	mPasses.clear();
+	++mFrame;
+}
+
+
+// Add a texture owned elsewhere, with whichever of its views exist
+RenderGraph::Resource RenderGraph::ImportTexture(const std::string& name, ID3D11RenderTargetView* renderTarget,
+                                                 ID3D11DepthStencilView* depthStencil, ID3D11ShaderResourceView* shaderResource,
+                                                 bool output /*= false*/)
+{
+	ResourceEntry resource;
+	resource.name           = name;
+	resource.imported       = true;
+	resource.output         = output;
+	resource.renderTarget   = renderTarget;
+	resource.depthStencil   = depthStencil;
+	resource.shaderResource = shaderResource;
+	mResources.push_back(std::move(resource));
+	return static_cast<Resource>(mResources.size() - 1);
+}
+
+
+// Add a texture that only exists for this frame
+RenderGraph::Resource RenderGraph::CreateTexture(const std::string& name, const TextureDesc& desc)
+{
+	ResourceEntry resource;
+	resource.name = name;
+	resource.desc = desc;
+	mResources.push_back(std::move(resource));
+	return static_cast<Resource>(mResources.size() - 1);
+}
+
+
+// Add a pass, calling its setup function now
+void RenderGraph::AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute)
+{
+	Pass pass;
+	pass.name    = name;
+	pass.execute = std::move(execute);
+	mPasses.push_back(std::move(pass));
+
+	PassBuilder builder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+	setup(builder);
+}
+
+
+// Order and cull the passes, give the transient textures their pooled textures, then run the passes
+void RenderGraph::Execute()
+{
+	const uint32_t numPasses = static_cast<uint32_t>(mPasses.size());
+	Stats stats; // Kept in locals until the end, the control panel can show the last frame's while this one runs
+	stats.passes = numPasses;
+	std::vector<std::string> passOrder;
+
+	// Cull, from the last pass back. A pass is run if it has side effects, writes an output, or an earlier run pass needs it. A
+	// run pass needs the earlier passes writing the textures it uses, back to one that clears (a write without a clear draws
+	// over what is there, so it needs the earlier writes too)
+	for (uint32_t i = numPasses; i-- > 0; )
+	{
+		Pass& pass = mPasses[i];
+		for (auto& access : pass.accesses)
+		{
+			if (access.write && mResources[access.resource].output)  pass.run = true;
+		}
+		pass.run = pass.run || pass.sideEffect;
+		if (!pass.run)  continue;
+
+		for (auto& access : pass.accesses)
+		{
+			if (access.write && access.clear.enabled)  continue; // This pass replaces the texture's contents
+			for (uint32_t j = i; j-- > 0; )
+			{
+				auto earlierWrite = std::find_if(mPasses[j].accesses.begin(), mPasses[j].accesses.end(),
+				                                 [&](const Access& a) { return a.write && a.resource == access.resource; });
+				if (earlierWrite == mPasses[j].accesses.end())  continue;
+				mPasses[j].run = true;
+				if (earlierWrite->clear.enabled)  break;
+			}
+		}
+	}
+
+	// Dependencies between the run passes: a pass must wait for each earlier pass it shares a texture with, if either writes it
+	std::vector<std::vector<uint32_t>> dependents(numPasses);
+	std::vector<uint32_t> waitingOn(numPasses, 0);
+	std::vector<uint32_t> usesLeft(mResources.size(), 0);
+	for (uint32_t i = 0; i < numPasses; ++i)
+	{
+		if (!mPasses[i].run)
+		{
+			++stats.culledPasses;
+			continue;
+		}
+		for (auto& access : mPasses[i].accesses)
+		{
+			++usesLeft[access.resource];
+			for (uint32_t j = 0; j < i; ++j)
+			{
+				if (!mPasses[j].run)  continue;
+				bool conflicts = std::any_of(mPasses[j].accesses.begin(), mPasses[j].accesses.end(),
+				                             [&](const Access& a) { return a.resource == access.resource && (a.write || access.write); });
+				if (conflicts && std::find(dependents[j].begin(), dependents[j].end(), i) == dependents[j].end())
+				{
+					dependents[j].push_back(i);
+					++waitingOn[i];
+				}
+			}
+		}
+	}
+
+	// Order the run passes, each time choosing from those with nothing left to wait on. Prefer one using a transient texture
+	// that is in use, so its last use comes sooner, then the first added
+	std::vector<uint32_t> order;
+	std::vector<bool> started(mResources.size(), false);
+	std::vector<bool> scheduled(numPasses, false);
+	for (;;)
+	{
+		uint32_t chosen = UINT32_MAX;
+		bool chosenUsesLive = false;
+		for (uint32_t i = 0; i < numPasses; ++i)
+		{
+			if (!mPasses[i].run || scheduled[i] || waitingOn[i] > 0)  continue;
+			bool usesLive = std::any_of(mPasses[i].accesses.begin(), mPasses[i].accesses.end(), [&](const Access& a)
+			                            { return !mResources[a.resource].imported && started[a.resource] && usesLeft[a.resource] > 0; });
+			if (chosen == UINT32_MAX || (usesLive && !chosenUsesLive))
+			{
+				chosen = i;
+				chosenUsesLive = usesLive;
+			}
+		}
+		if (chosen == UINT32_MAX)  break;
+
+		scheduled[chosen] = true;
+		for (auto& access : mPasses[chosen].accesses)
+		{
+			started[access.resource] = true;
+			--usesLeft[access.resource];
+		}
+		for (uint32_t dependent : dependents[chosen])  --waitingOn[dependent];
+		order.push_back(chosen);
+	}
+
+	// Lifetimes of the textures, as positions in the order
+	for (uint32_t position = 0; position < order.size(); ++position)
+	{
+		for (auto& access : mPasses[order[position]].accesses)
+		{
+			auto& resource = mResources[access.resource];
+			resource.firstUse = std::min(resource.firstUse, position);
+			resource.lastUse  = std::max(resource.lastUse,  position);
+		}
+	}
+
+	// Give each transient texture a pooled texture for its lifetime. A texture whose lifetime ended at an earlier position is free
+	// to be taken again, so its contents are undefined until the first pass writing the new resource clears or covers them
+	for (auto& pooled : mPool)  pooled->inUse = false;
+	for (uint32_t position = 0; position < order.size(); ++position)
+	{
+		for (auto& resource : mResources)
+		{
+			if (resource.imported || resource.firstUse != position)  continue;
+			resource.pooled = AcquireTexture(resource.desc);
+			resource.renderTarget   = resource.pooled->renderTarget;
+			resource.depthStencil   = resource.pooled->depthStencil;
+			resource.shaderResource = resource.pooled->shaderResource;
+			++stats.transients;
+			stats.transientBytes += TextureBytes(resource.desc);
+		}
+		for (auto& resource : mResources)
+		{
+			if (!resource.imported && resource.pooled != nullptr && resource.lastUse == position)  resource.pooled->inUse = false;
+		}
+	}
+
+	// Run the passes, unbinding textures between writes and reads of them and clearing them when first written
+	auto context = DX->Context();
+	for (uint32_t passIndex : order)
+	{
+		Pass& pass = mPasses[passIndex];
+		bool unbindTargets = false;
+		for (auto& access : pass.accesses)
+		{
+			auto& resource = mResources[access.resource];
+			if (!access.write && resource.lastAccessWrite)  unbindTargets = true;
+			if (access.write)
+			{
+				ID3D11ShaderResourceView* nullView = nullptr;
+				for (unsigned int slot : resource.boundSlots)  context->PSSetShaderResources(slot, 1, &nullView);
+				resource.boundSlots.clear();
+			}
+		}
+		if (unbindTargets)  context->OMSetRenderTargets(0, nullptr, nullptr);
+
+		for (auto& access : pass.accesses)
+		{
+			auto& resource = mResources[access.resource];
+			if (access.write && access.clear.enabled && !resource.written)
+			{
+				if      (resource.renderTarget != nullptr)  context->ClearRenderTargetView(resource.renderTarget, access.clear.colour);
+				else if (resource.depthStencil != nullptr)  context->ClearDepthStencilView(resource.depthStencil, D3D11_CLEAR_DEPTH, access.clear.depth, 0);
+			}
+		}
+
+		PassContext passContext(*this);
+		pass.execute(passContext);
+		passOrder.push_back(pass.name);
+
+		for (auto& access : pass.accesses)
+		{
+			auto& resource = mResources[access.resource];
+			resource.written = resource.written || access.write;
+			resource.lastAccessWrite = access.write;
+		}
+	}
+
+	// Nothing is left bound to a texture the pool might release or hand to another resource next frame
+	for (auto& resource : mResources)
+	{
+		ID3D11ShaderResourceView* nullView = nullptr;
+		for (unsigned int slot : resource.boundSlots)  context->PSSetShaderResources(slot, 1, &nullView);
+		resource.boundSlots.clear();
+	}
+
+	// Release pooled textures no frame has used for a while
+	mPool.erase(std::remove_if(mPool.begin(), mPool.end(), [&](const std::unique_ptr<PooledTexture>& pooled)
+	                           { return mFrame - pooled->lastUsedFrame > POOL_KEEP_FRAMES; }), mPool.end());
+
+	stats.pooledTextures = static_cast<uint32_t>(mPool.size());
+	for (auto& pooled : mPool)
+	{
+		uint64_t bytes = TextureBytes(pooled->desc);
+		stats.poolBytes += bytes;
+		if (pooled->lastUsedFrame == mFrame)  stats.pooledBytes += bytes;
+	}
+	mStats     = stats;
+	mPassOrder = std::move(passOrder);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Find a free pooled texture with the given description, creating one if there is none. Throws std::runtime_error on failure
+RenderGraph::PooledTexture* RenderGraph::AcquireTexture(const TextureDesc& desc)
+{
+	for (auto& pooled : mPool)
+	{
+		if (!pooled->inUse && pooled->desc == desc)
+		{
+			pooled->inUse = true;
+			pooled->lastUsedFrame = mFrame;
+			return pooled.get();
+		}
+	}
+
+	bool isDepth = desc.format == DXGI_FORMAT_D32_FLOAT || desc.format == DXGI_FORMAT_D24_UNORM_S8_UINT ||
+	               desc.format == DXGI_FORMAT_D16_UNORM || desc.format == DXGI_FORMAT_D32_FLOAT_S8X24_UINT;
+
+	auto pooled = std::make_unique<PooledTexture>();
+	pooled->desc = desc;
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width     = desc.width;
+	textureDesc.Height    = desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format    = desc.format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage     = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = isDepth ? D3D11_BIND_DEPTH_STENCIL : (D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+	HRESULT hr = DX->Device()->CreateTexture2D(&textureDesc, nullptr, &pooled->texture);
+	if (isDepth)
+	{
+		if (SUCCEEDED(hr))  hr = DX->Device()->CreateDepthStencilView(pooled->texture, nullptr, &pooled->depthStencil);
+	}
+	else
+	{
+		if (SUCCEEDED(hr))  hr = DX->Device()->CreateRenderTargetView  (pooled->texture, nullptr, &pooled->renderTarget);
+		if (SUCCEEDED(hr))  hr = DX->Device()->CreateShaderResourceView(pooled->texture, nullptr, &pooled->shaderResource);
+	}
+	if (FAILED(hr))  throw std::runtime_error("Render graph: failure creating texture");
+
+	pooled->inUse = true;
+	pooled->lastUsedFrame = mFrame;
+	mPool.push_back(std::move(pooled));
+	return mPool.back().get();
+}
+
+
+// Bytes of a texture with the given description
+uint64_t RenderGraph::TextureBytes(const TextureDesc& desc)
+{
+	uint64_t texelBytes;
+	switch (desc.format)
+	{
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_R8_UINT:              texelBytes = 1;   break;
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_D16_UNORM:            texelBytes = 2;   break;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R32G32_FLOAT:
+		case DXGI_FORMAT_D32_FLOAT_S8X24_UINT: texelBytes = 8;   break;
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:   texelBytes = 16;  break;
+		default:                               texelBytes = 4;   break; // The 8-bit RGBA formats, 32-bit single channel, D24S8 etc.
+	}
+	return texelBytes * desc.width * desc.height;
+}
@@ -0,0 +1,243 @@
+//--------------------------------------------------------------------------------------
+// Render graph - the passes of a frame, ordered and given their render targets from what each declares it reads and writes
+//--------------------------------------------------------------------------------------
+// Each frame the passes are added with the textures they read and write, then the graph is executed. Rather than each piece
+// of rendering code creating and setting its own targets, and relying on being called in the right order:
+//   - passes are run in an order that satisfies their reads and writes. A pass reading or writing a texture runs after the passes
+//     added before it that write it, and before the passes added after it that write it again. Where there is a choice, passes
+//     using a transient texture already in use go first, so it is finished with (and free to share, see below) sooner, then the
+//     order the passes were added in
+//   - passes whose results are never used are culled - a pass is only run if it writes an output texture (e.g. the back buffer),
+//     writes a texture read by a pass that is run, or is marked as having side effects (e.g. a copy read back to the CPU)
+//   - textures can be cleared when they are first written, and resources are unbound between a pass writing a texture and a pass
+//     reading it (and the other way round), as Direct3D 11 silently ignores a texture bound for reading and writing at once
+//   - transient textures, created by the graph for the frame, only exist from the first pass using them to the last. They are
+//     taken from a pool, and textures with the same description whose lifetimes don't overlap share one texture from it. Pooled
+//     textures no frame has used for a while are released, so a texture only needed now and then (e.g. the scene texture for
+//     dynamic resolution) doesn't hold its memory while it isn't
+//
+// Direct3D 11 has no placed resources, so aliasing is at the level of whole textures with matching descriptions rather than of
+// memory. Textures owned elsewhere, such as the back buffer, are imported:
+//
+//   renderGraph.BeginFrame();
+//   auto backBuffer = renderGraph.ImportTexture("Back buffer", DX->BackBuffer(), nullptr, nullptr, true);
+//   auto scene      = renderGraph.CreateTexture("Scene", { width, height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB });
+//   renderGraph.AddPass("Scene", [&](RenderGraph::PassBuilder& pass) { pass.Write(scene, RenderGraph::ClearColour({ 0, 0, 0, 1 })); },
+//                                [&](RenderGraph::PassContext& context) { ... draw to context.RenderTarget(scene) ... });
+//   renderGraph.AddPass("Copy", [&](RenderGraph::PassBuilder& pass) { pass.Read(scene);  pass.Write(backBuffer); },
+//                               [&](RenderGraph::PassContext& context) { ... read context.ShaderResource(scene) ... });
+//   renderGraph.Execute();
+//
+// The functions passed to AddPass are kept until Execute returns, so they can capture locals of the code building the frame
+
+#ifndef _RENDER_GRAPH_H_INCLUDED_
+#define _RENDER_GRAPH_H_INCLUDED_
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+
+class RenderGraph
+{
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// A texture in the graph, valid for the frame it was created or imported in
+	using Resource = uint32_t;
+	static constexpr Resource NO_RESOURCE = UINT32_MAX;
+
+	// Description of a transient texture. Render target and shader resource views are made for colour formats, a depth-stencil
+	// view for depth formats (a depth texture can't also be read in shaders)
+	struct TextureDesc
+	{
+		unsigned int width  = 0;
+		unsigned int height = 0;
+		DXGI_FORMAT  format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+		bool operator==(const TextureDesc& other) const  { return width == other.width && height == other.height && format == other.format; }
+	};
+
+	// Clear made before the first pass writing a texture each frame, if that pass asks for one
+	struct Clear
+	{
+		bool  enabled = false;
+		float colour[4] = {};
+		float depth = 1.0f;
+	};
+	static Clear ClearColour(const float (&colour)[4])  { Clear clear;  clear.enabled = true;  for (int i = 0; i < 4; ++i) clear.colour[i] = colour[i];  return clear; }
+	static Clear ClearDepth(float depth = 1.0f)          { Clear clear;  clear.enabled = true;  clear.depth = depth;  return clear; }
+
+
+	// Given to the setup function of a pass to declare what it reads and writes
+	class PassBuilder
+	{
+	public:
+		void Read(Resource texture);
+		void Write(Resource texture, const Clear& clear = {});
+
+		// The pass is run even if nothing it writes is used, e.g. because it starts a copy back to the CPU
+		void SideEffect();
+
+	private:
+		friend class RenderGraph;
+		PassBuilder(RenderGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+		RenderGraph& mGraph;
+		uint32_t     mPass;
+	};
+
+	// Given to the execute function of a pass to find the views of its textures
+	class PassContext
+	{
+	public:
+		ID3D11DeviceContext*      Context();
+		ID3D11Texture2D*          Texture(Resource texture);
+		ID3D11RenderTargetView*   RenderTarget(Resource texture);
+		ID3D11DepthStencilView*   DepthStencil(Resource texture);
+		ID3D11ShaderResourceView* ShaderResource(Resource texture);
+
+		// Bind a texture the pass reads to a pixel shader slot. It is unbound before a later pass writes the texture
+		void BindPixelTexture(unsigned int slot, Resource texture);
+
+	private:
+		friend class RenderGraph;
+		PassContext(RenderGraph& graph) : mGraph(graph) {}
+		RenderGraph& mGraph;
+	};
+
+	using SetupFunction   = std::function<void(PassBuilder&)>;
+	using ExecuteFunction = std::function<void(PassContext&)>;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	RenderGraph() = default;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start building a new frame, forgetting the passes and resources of the last one. Pooled textures are kept
+	void BeginFrame();
+
+	// Add a texture owned elsewhere, with whichever of its views exist. Output textures are a result of the frame (e.g. the back
+	// buffer), passes writing them are never culled
+	Resource ImportTexture(const std::string& name, ID3D11RenderTargetView* renderTarget, ID3D11DepthStencilView* depthStencil,
+	                       ID3D11ShaderResourceView* shaderResource, bool output = false);
+
+	// Add a texture that only exists for this frame, taken from the pool when the graph is executed
+	Resource CreateTexture(const std::string& name, const TextureDesc& desc);
+
+	// Add a pass, the setup function is called now to declare its reads and writes, the execute function when it is run
+	void AddPass(const std::string& name, const SetupFunction& setup, ExecuteFunction execute);
+
+	// Order and cull the passes, give the transient textures their pooled textures, then run the passes. Throws
+	// std::runtime_error if the pool can't create a texture
+	void Execute();
+
+
+	// Frames a pooled texture is kept for while no frame uses it
+	static constexpr uint32_t POOL_KEEP_FRAMES = 60;
+
+	// The last frame executed, and the pool
+	struct Stats
+	{
+		uint32_t passes           = 0; // Added
+		uint32_t culledPasses     = 0;
+		uint32_t transients       = 0; // Transient textures used by the passes run
+		uint32_t pooledTextures   = 0; // Textures in the pool, in use this frame or not
+		uint64_t transientBytes   = 0; // Size of the transient textures if each had its own
+		uint64_t pooledBytes      = 0; // Size of the textures used this frame, after aliasing
+		uint64_t poolBytes        = 0; // Size of the whole pool
+	};
+	const Stats& GetStats()  { return mStats; }
+
+	// Names of the passes run last frame in the order they were run, for the control panel
+	const std::vector<std::string>& PassOrder()  { return mPassOrder; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types / functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A texture in the pool, with the frame number it was last used in
+	struct PooledTexture
+	{
+		TextureDesc                       desc;
+		CComPtr<ID3D11Texture2D>          texture;
+		CComPtr<ID3D11RenderTargetView>   renderTarget;
+		CComPtr<ID3D11DepthStencilView>   depthStencil;
+		CComPtr<ID3D11ShaderResourceView> shaderResource;
+		uint64_t                          lastUsedFrame = 0;
+		bool                              inUse = false; // By a live resource in the frame being executed
+	};
+
+	struct ResourceEntry
+	{
+		std::string               name;
+		bool                      imported = false;
+		bool                      output   = false;
+		TextureDesc               desc;
+		ID3D11RenderTargetView*   renderTarget   = nullptr; // Of the imported texture, or the pooled one once executing
+		ID3D11DepthStencilView*   depthStencil   = nullptr;
+		ID3D11ShaderResourceView* shaderResource = nullptr;
+		PooledTexture*            pooled = nullptr;
+
+		// Positions in the run order of the first and last passes using the resource, and the pixel shader slots it is bound to
+		uint32_t                  firstUse = UINT32_MAX;
+		uint32_t                  lastUse  = 0;
+		std::vector<unsigned int> boundSlots;
+		bool                      written = false;         // This frame, so the first write can clear
+		bool                      lastAccessWrite = false; // So reads of it unbind the render targets first
+	};
+
+	struct Access
+	{
+		Resource resource;
+		bool     write;
+		Clear    clear;
+	};
+
+	struct Pass
+	{
+		std::string         name;
+		ExecuteFunction     execute;
+		std::vector<Access> accesses;
+		bool                sideEffect = false;
+		bool                run = false;
+	};
+
+	// Find a free pooled texture with the given description, creating one if there is none
+	PooledTexture* AcquireTexture(const TextureDesc& desc);
+
+	// Bytes of a texture with the given description
+	static uint64_t TextureBytes(const TextureDesc& desc);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	std::vector<ResourceEntry> mResources;
+	std::vector<Pass>          mPasses;
+
+	// Held by unique_ptr so resources can point to them as the pool grows
+	std::vector<std::unique_ptr<PooledTexture>> mPool;
+	uint64_t                                    mFrame = 0;
+
+	Stats                    mStats;
+	std::vector<std::string> mPassOrder;
+};
+
+
+#endif //_RENDER_GRAPH_H_INCLUDED_
@@ -14,12 +14,30 @@
 #include "Shader.h"
 #include "Texture.h"
 #include "CBuffer.h"
+#include "Geometry.h"
 #include "RenderGlobals.h"
+#include "RenderCounters.h"
 
 #include <stdexcept>
+#include <map>
+#include <mutex>
+#include <utility>
 
 
 
+// Name of a surface render method for display
+const char* SurfaceRenderMethodName(SurfaceRenderMethod method)
+{
+	static const char* const names[] = { "UnlitColour", "UnlitTexture", "BlinnColour", "BlinnTexture", "BlinnNormalMapping",
+	                                     "BlinnParallaxMapping", "PbrNormalMapping", "PbrParallaxMapping", "PbrAltNormalMapping",
+	                                     "PbrAltParallaxMapping", "PbrAlbedoOnly", "Unknown" };
+	static_assert(std::size(names) == NUM_SURFACE_RENDER_METHODS, "Add a name for each surface render method");
+
+	int index = static_cast<int>(method);
+	return (index >= 0 && index < NUM_SURFACE_RENDER_METHODS) ? names[index] : "Unknown";
+}
+
+
 //--------------------------------------------------------------------------------------
 // Construction
 //--------------------------------------------------------------------------------------
@@ -27,6 +45,8 @@
 // Construct GPU render states directly from the RenderMethod descriptor
 RenderState::RenderState(const RenderMethod& renderMethod)
 {
+	mSurfaceRenderMethod = renderMethod.surfaceRenderMethod;
+
 	// Get shaders required to support given render method
 	std::string vertexShaderName, pixelShaderName;
 	if (renderMethod.geometryRenderMethod == GeometryRenderMethod::Rigid) // Vertex and pixel shader name for each surface render method, assuming GeometryRenderMethod::Rigid
@@ -43,6 +63,7 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 			case SurfaceRenderMethod::PbrParallaxMapping:     vertexShaderName = "vs_pntuv_p2c_pnt2w_uv";    pixelShaderName = "ps_pbr1-1p";             break; 
 			case SurfaceRenderMethod::PbrAltNormalMapping:    vertexShaderName = "vs_pntuv_p2c_pnt2w_uv";    pixelShaderName = "ps_pbr2-1n";             break; // TODO ps
 			case SurfaceRenderMethod::PbrAltParallaxMapping:  vertexShaderName = "vs_pntuv_p2c_pnt2w_uv";    pixelShaderName = "ps_pbr2-1p";             break; // TODO ps
+			case SurfaceRenderMethod::PbrAlbedoOnly:          vertexShaderName = "vs_pnuv_p2c_pn2w_uv";      pixelShaderName = "ps_pbr1-1a";             break;
 			default: throw std::runtime_error("RenderState: Unsupported surface render method");
 		}
 	}
@@ -50,7 +71,7 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 	{
 		switch (renderMethod.surfaceRenderMethod)
 		{
-			case SurfaceRenderMethod::UnlitColour:            vertexShaderName = "vs_p_skp2c";                 pixelShaderName = "ps_colour-only";         break; // TODO all vs
+			case SurfaceRenderMethod::UnlitColour:            vertexShaderName = "vs_p_skp2c";                 pixelShaderName = "ps_colour-only";         break;
 			case SurfaceRenderMethod::UnlitTexture:           vertexShaderName = "vs_puv_skp2c_uv";            pixelShaderName = "ps_tex-only";            break;
 			case SurfaceRenderMethod::BlinnColour:            vertexShaderName = "vs_pn_skp2c_pn2w";           pixelShaderName = "ps_blinn-1";             break;
 			case SurfaceRenderMethod::BlinnTexture:           vertexShaderName = "vs_pnuv_skp2c_pn2w_uv";      pixelShaderName = "ps_blinn-1_tex-d";       break;
@@ -60,17 +81,94 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 			case SurfaceRenderMethod::PbrParallaxMapping:     vertexShaderName = "vs_pntuv_skp2c_pnt2w_uv";    pixelShaderName = "ps_pbr1-1p";             break;
 			case SurfaceRenderMethod::PbrAltNormalMapping:    vertexShaderName = "vs_pntuv_skp2c_pnt2w_uv";    pixelShaderName = "ps_pbr2-1n";             break;
 			case SurfaceRenderMethod::PbrAltParallaxMapping:  vertexShaderName = "vs_pntuv_skp2c_pnt2w_uv";    pixelShaderName = "ps_pbr2-1p";             break;
+			case SurfaceRenderMethod::PbrAlbedoOnly:          vertexShaderName = "vs_pnuv_skp2c_pn2w_uv";      pixelShaderName = "ps_pbr1-1a";             break;
 			default: throw std::runtime_error("RenderState: Unsupported surface render method");
 		}
 	}
 	else throw std::runtime_error("RenderState: Unsupported render method");
 
+	// Materials imported with ImportFlags::TextureArrays keep their textures in texture arrays shared with similar materials, and
+	// select theirs with the slice in the material constants. Only the metalness/roughness PBR pixel shaders have versions reading
+	// texture arrays, their names have "_arr" on the end. Other materials, or those whose textures can't go in arrays, use their
+	// textures as usual. The cheaper versions of the material below add the same textures again, so are given the same slice
+	PerMaterialConstants constants = renderMethod.constants;
+	std::array<TextureManager::StreamedTexture*, NUM_TEXTURE_TYPES> arrayTextures = {};
+	bool textureArrays = false;
+	if (renderMethod.textureArrays && (renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrNormalMapping   ||
+	                                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrParallaxMapping ||
+	                                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAlbedoOnly))
+	{
+		std::array<std::string, NUM_TEXTURE_TYPES> fileNames;
+		for (auto& texture : renderMethod.textures)
+		{
+			if (static_cast<int>(texture.type) < NUM_TEXTURE_TYPES)  fileNames[static_cast<int>(texture.type)] = texture.filename;
+		}
+		textureArrays = DX->Textures()->AddToTextureArrays(fileNames, arrayTextures, constants.materialSlice);
+		if (textureArrays)  pixelShaderName += "_arr";
+	}
+
+	// Compressed vertices need the version of a vertex shader that decodes them, its name has "_q" on the end (see ImportFlags::CompressVertices)
+	if (renderMethod.compressedVertices)
+	{
+		if (renderMethod.geometryRenderMethod != GeometryRenderMethod::Rigid)  throw std::runtime_error("RenderState: Compressed vertices are only supported for rigid geometry");
+		vertexShaderName += "_q";
+	}
+
 	// Load required shaders (shader manager will ensure the same shader isn't loaded twice)
 	mVertexShader = DX->Shaders()->LoadVertexShader(vertexShaderName);
 	if (mVertexShader == nullptr)  throw std::runtime_error("RenderState: " + DX->Shaders()->GetLastError());
 	mPixelShader  = DX->Shaders()->LoadPixelShader (pixelShaderName);
 	if (mPixelShader == nullptr)   throw std::runtime_error("RenderState: " + DX->Shaders()->GetLastError());
 
+	// Version of the pixel shader for weighted blended transparency (see WeightedOit.h), its name has "_oit" on the end. Every pixel
+	// shader has one with the same lighting, so a material looks the same whichever way the additive group is drawn
+	mOitPixelShader = DX->Shaders()->LoadPixelShader(pixelShaderName + "_oit");
+	if (mOitPixelShader == nullptr)  throw std::runtime_error("RenderState: " + DX->Shaders()->GetLastError());
+
+	// Rigid geometry can also be rendered instanced, with a vertex shader that reads the world matrix from the instance buffer.
+	// Its name has "ip2c" in place of "p2c", e.g. vs_pn_ip2c_pn2w. Not an error if it is missing, the material just can't be instanced
+	if (renderMethod.geometryRenderMethod == GeometryRenderMethod::Rigid)
+	{
+		std::string instancedShaderName = vertexShaderName;
+		instancedShaderName.replace(instancedShaderName.find("_p2c"), 4, "_ip2c");
+		mInstancedVertexShader = DX->Shaders()->LoadVertexShader(instancedShaderName);
+	}
+
+	// Depth-only shaders for a depth pre-pass (see SetDepthOnly). The PBR pixel shaders discard pixels with low albedo alpha, which
+	// mustn't enter the depth buffer, so those materials keep their UVs for a pixel shader making the same test. Skinned geometry
+	// uses its full vertex shader, there are no position-only skinning shaders
+	bool alphaTested = renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrNormalMapping    ||
+	                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrParallaxMapping  ||
+	                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltNormalMapping ||
+	                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAltParallaxMapping ||
+	                   renderMethod.surfaceRenderMethod == SurfaceRenderMethod::PbrAlbedoOnly;
+	if (renderMethod.geometryRenderMethod == GeometryRenderMethod::Rigid)
+	{
+		std::string depthShaderName = alphaTested ? "vs_puv_p2c_uv" : "vs_p_p2c";
+		if (renderMethod.compressedVertices)  depthShaderName += "_q";
+		mDepthVertexShader = DX->Shaders()->LoadVertexShader(depthShaderName);
+		if (mDepthVertexShader == nullptr)  throw std::runtime_error("RenderState: " + DX->Shaders()->GetLastError());
+
+		// Instanced rendering is used in both passes or neither, so the material can't be instanced without both shaders
+		if (mInstancedVertexShader != nullptr)
+		{
+			depthShaderName.replace(depthShaderName.find("_p2c"), 4, "_ip2c");
+			mDepthInstancedVertexShader = DX->Shaders()->LoadVertexShader(depthShaderName);
+			if (mDepthInstancedVertexShader == nullptr)  mInstancedVertexShader = nullptr;
+		}
+
+		if (alphaTested)
+		{
+			mDepthPixelShader = DX->Shaders()->LoadPixelShader(textureArrays ? "ps_depth-alpha-test_arr" : "ps_depth-alpha-test");
+			if (mDepthPixelShader == nullptr)  throw std::runtime_error("RenderState: " + DX->Shaders()->GetLastError());
+		}
+	}
+	else
+	{
+		mDepthVertexShader = mVertexShader;
+		if (alphaTested)  mDepthPixelShader = mPixelShader;
+	}
+
 
 	// Load all textures and samplers indicated by the render method. They are loaded into the array slot indicated by
 	// the texture type and will appear in shaders on that same slot (see comment on TextureType)
@@ -79,14 +177,17 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 	for (int i = 0; i < renderMethod.textures.size(); ++i)
 	{
 		// Support null textures (filename = ""). Set nullptr as texture, but set sampler as normal. DirectX debugger issues warnings if there are null samplers
-		if (renderMethod.textures[i].filename != "")
+		// Materials in texture arrays use the arrays holding their textures instead, nullptr for the null textures
+		if (textureArrays)
 		{
-			bool allowSRGB = renderMethod.textures[i].type != TextureType::Roughness && // Some data maps should not be in SRGB format 
-			                 renderMethod.textures[i].type != TextureType::Normal    &&
-			                 renderMethod.textures[i].type != TextureType::Displacement;
-			auto [texture, textureSRV] = DX->Textures()->LoadTexture(renderMethod.textures[i].filename, allowSRGB);
+			mTextures[static_cast<int>(renderMethod.textures[i].type)] = arrayTextures[static_cast<int>(renderMethod.textures[i].type)];
+		}
+		else if (renderMethod.textures[i].filename != "")
+		{
+			bool allowSRGB = AllowSRGB(renderMethod.textures[i].type);
+			auto texture = DX->Textures()->StreamTexture(renderMethod.textures[i].filename, allowSRGB, renderMethod.textures[i].type);
 			if (texture == nullptr)  throw std::runtime_error("RenderState: Failed to load texture: " + renderMethod.textures[i].filename + " - " + DX->Textures()->GetLastError());
-			mTextures[static_cast<int>(renderMethod.textures[i].type)] = textureSRV;
+			mTextures[static_cast<int>(renderMethod.textures[i].type)] = texture;
 		}
 		else
 		{
@@ -98,8 +199,61 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 	}
 
 	
-	// Initialise CPU-side constants (to be sent to GPU each time this material is used)
-	mConstants = renderMethod.constants;
+	// Create the GPU buffer for the constants. They never change so it is immutable, and is only bound when this material is applied
+	D3D11_BUFFER_DESC bufferDesc;
+	bufferDesc.BindFlags           = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.ByteWidth           = sizeof(PerMaterialConstants);
+	bufferDesc.Usage               = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.CPUAccessFlags      = 0;
+	bufferDesc.MiscFlags           = 0;
+	bufferDesc.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA initData = { &constants, 0, 0 };
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, &initData, &mConstantBuffer)))
+		throw std::runtime_error("RenderState: Failed to create material constant buffer");
+
+	// Give each distinct pair of shaders and each distinct set of textures an id, in the order they are first seen. The ids
+	// are only for sorting, so they can wrap around if there are more than fit in the key. Meshes can be loaded on several
+	// threads, then the ids depend on which thread gets here first, which only changes the order materials are drawn in
+	static std::map<std::pair<ID3D11VertexShader*, ID3D11PixelShader*>, uint64_t> shaderIds;
+	static std::map<std::array<TextureManager::StreamedTexture*, NUM_TEXTURE_TYPES>, uint64_t> textureIds;
+	static uint64_t nextMaterialId = 0;
+	static std::mutex idMutex;
+	{
+		std::lock_guard<std::mutex> lock(idMutex);
+		uint64_t shaderId  = shaderIds.try_emplace({ mVertexShader, mPixelShader }, shaderIds.size()).first->second;
+		uint64_t textureId = textureIds.try_emplace(mTextures, textureIds.size()).first->second;
+		mStateKey = ((shaderId & 0x3FF) << 30) | ((textureId & 0x3FFF) << 16) | (nextMaterialId++ & 0xFFFF);
+	}
+
+	// Cheaper version of a normal or parallax mapped material for when it is small on screen (see LowerShaderLOD). The same
+	// textures and constants with the next simpler surface method, which in turn makes its own cheaper version. The textures
+	// it doesn't use are still set, the texture manager shares them with this render state
+	SurfaceRenderMethod lowerSurfaceMethod = SurfaceRenderMethod::Unknown;
+	switch (renderMethod.surfaceRenderMethod)
+	{
+		case SurfaceRenderMethod::BlinnParallaxMapping:  mShaderLOD = ShaderLOD::ParallaxMapping;  lowerSurfaceMethod = SurfaceRenderMethod::BlinnNormalMapping;  break;
+		case SurfaceRenderMethod::BlinnNormalMapping:    mShaderLOD = ShaderLOD::NormalMapping;    lowerSurfaceMethod = SurfaceRenderMethod::BlinnTexture;        break;
+		case SurfaceRenderMethod::PbrParallaxMapping:    mShaderLOD = ShaderLOD::ParallaxMapping;  lowerSurfaceMethod = SurfaceRenderMethod::PbrNormalMapping;    break;
+		case SurfaceRenderMethod::PbrNormalMapping:      mShaderLOD = ShaderLOD::NormalMapping;    lowerSurfaceMethod = SurfaceRenderMethod::PbrAlbedoOnly;       break;
+		case SurfaceRenderMethod::PbrAltParallaxMapping: mShaderLOD = ShaderLOD::ParallaxMapping;  break; // No cheaper versions until there are specular/glossiness shaders
+		case SurfaceRenderMethod::PbrAltNormalMapping:   mShaderLOD = ShaderLOD::NormalMapping;    break;
+		default:                                         mShaderLOD = ShaderLOD::Basic;            break;
+	}
+	if (lowerSurfaceMethod != SurfaceRenderMethod::Unknown)
+	{
+		RenderMethod lowerMethod = renderMethod;
+		lowerMethod.surfaceRenderMethod = lowerSurfaceMethod;
+		mLowerShaderLOD = std::make_unique<RenderState>(lowerMethod);
+	}
+}
+
+static_assert(sizeof(PerMaterialConstants) % 16 == 0, "Constant buffers must be a multiple of 16 bytes");
+
+
+// Forgets this render state's constant buffer if it is the one on the GPU, so a new buffer at the same address is still bound
+RenderState::~RenderState()
+{
+	if (mImmediateCache.constantBuffer == mConstantBuffer)  mImmediateCache.constantBuffer = {};
 }
 
 
@@ -107,59 +261,112 @@ RenderState::RenderState(const RenderMethod& renderMethod)
 // Usage
 //--------------------------------------------------------------------------------------
 
-// Set up the GPU to use this render state
-void RenderState::Apply()
+// Set up the GPU to use this render state, with the instanced vertex shader if instanced is true (see CanRenderInstanced)
+void RenderState::Apply(bool instanced /*= false*/)
+{
+	Apply(DX->Context(), mImmediateCache, instanced);
+}
+
+
+// Set up the given device context to use this render state, its current state is in the given cache
+void RenderState::Apply(ID3D11DeviceContext* context, RenderStateCache& cache, bool instanced /*= false*/)
 {
 	// Set each shader on GPU, don't do anything if currently selected shader is already the correct one
 	// Note: the ShaderManager ensures that different meshes using the same shader get the same shader objects so this will work across different meshes
-	if (mVertexShader != mCurrentVertexShader)
+	auto [vertexShader, pixelShader] = Shaders(instanced);
+	// Binds made and skipped are counted for each kind of state, see RenderCounters.h
+	int shaderBinds = 0;
+	if (vertexShader != cache.vertexShader)
 	{
-		DX->Context()->VSSetShader(mVertexShader, nullptr, 0);
-		mCurrentVertexShader = mVertexShader;
+		context->VSSetShader(vertexShader, nullptr, 0);
+		cache.vertexShader = vertexShader;
+		++shaderBinds;
 	}
-	if (mPixelShader != mCurrentPixelShader)
+	if (pixelShader != cache.pixelShader)
 	{
-		DX->Context()->PSSetShader(mPixelShader, nullptr, 0);
-		mCurrentPixelShader = mPixelShader;
+		context->PSSetShader(pixelShader, nullptr, 0);
+		cache.pixelShader = pixelShader;
+		++shaderBinds;
 	}
+	gRenderCounters.Add(RenderCounter::ShaderBinds, shaderBinds);
+	gRenderCounters.Add(RenderCounter::ShaderBindsSkipped, 2 - shaderBinds);
 
-	// Set textures and samplers on GPU, don't change them if current ones are already correct
-	for (int i = 0; i < mTextures.size(); ++i)
-		if (mTextures[i] != mCurrentTextures[i])
+	// Set textures and samplers on GPU, don't change them if current ones are already correct. Not needed without a pixel shader
+	if (pixelShader != nullptr)
+	{
+		int textureBinds = 0;
+		for (int i = 0; i < mTextures.size(); ++i)
 		{
-			DX->Context()->PSSetShaderResources(i, 1, &mTextures[i]);
-			mCurrentTextures[i] = mTextures[i];
+			ID3D11ShaderResourceView* texture = (mTextures[i] != nullptr) ? mTextures[i]->View() : nullptr;
+			if (texture != cache.textures[i])
+			{
+				context->PSSetShaderResources(i, 1, &texture);
+				cache.textures[i] = texture;
+				++textureBinds;
+			}
 		}
+		gRenderCounters.Add(RenderCounter::TextureBinds, textureBinds);
+		gRenderCounters.Add(RenderCounter::TextureBindsSkipped, mTextures.size() - textureBinds);
+
+		int samplerBinds = 0;
+		for (int i = 0; i < mSamplers.size(); ++i)
+			if (mSamplers[i] != cache.samplers[i])
+			{
+				context->PSSetSamplers(i, 1, &mSamplers[i]);
+				cache.samplers[i] = mSamplers[i];
+				++samplerBinds;
+			}
+		gRenderCounters.Add(RenderCounter::SamplerBinds, samplerBinds);
+		gRenderCounters.Add(RenderCounter::SamplerBindsSkipped, mSamplers.size() - samplerBinds);
+	}
+
+	// Material constants are used by pixel shaders, and by vertex shaders for the position scale and offset of compressed vertices
+	if (mConstantBuffer != cache.constantBuffer)
+	{
+		context->VSSetConstantBuffers(3, 1, &mConstantBuffer.p);
+		context->PSSetConstantBuffers(3, 1, &mConstantBuffer.p);
+		cache.constantBuffer = mConstantBuffer;
+	}
+}
 
-	for (int i = 0; i < mSamplers.size(); ++i)
-		if (mSamplers[i] != mCurrentSamplers[i])
-		{
-			DX->Context()->PSSetSamplers(i, 1, &mSamplers[i]);
-			mCurrentSamplers[i] = mSamplers[i];
-		}
 
-	DX->CBuffers()->UpdateCBuffer(gPerMaterialConstantBuffer, mConstants);
+// Add the memory used by this render state and its cheaper versions to the given totals, counting each texture once
+void RenderState::AddMemory(MeshMemory& memory)
+{
+	for (auto texture : mTextures)
+	{
+		if (texture != nullptr)  memory.textureBytes += TextureManager::MemoryUsed(*texture);
+	}
+
+	for (RenderState* renderState = this; renderState != nullptr; renderState = renderState->mLowerShaderLOD.get())
+	{
+		memory.cpuBytes += sizeof(RenderState);
+		if (renderState->mConstantBuffer != nullptr)  memory.constantBytes += sizeof(PerMaterialConstants);
+		++memory.renderStates;
+	}
 }
 
 
-// Set an environment map for all RenderStates
-void RenderState::SetEnvironmentMap(ID3D11ShaderResourceView* environmentMap)
+// Set the environment maps for all RenderStates
+void RenderState::SetEnvironmentMap(const EnvironmentMaps& environmentMaps)
 {
-	if (mCurrentEnvironmentMap == environmentMap)  return;
+	if (mCurrentEnvironmentMaps == environmentMaps)  return;
 
-	DX->Context()->PSSetShaderResources(static_cast<int>(TextureType::Environment), 1, &environmentMap);
-	mCurrentEnvironmentMap = environmentMap;
+	auto context = DX->Context();
+	context->PSSetShaderResources(EnvironmentMaps::SPECULAR_SLOT,   1, &environmentMaps.specular);
+	context->PSSetShaderResources(EnvironmentMaps::IRRADIANCE_SLOT, 1, &environmentMaps.irradiance);
+	context->PSSetShaderResources(EnvironmentMaps::BRDF_LUT_SLOT,   1, &environmentMaps.brdfLUT);
+	context->PSSetSamplers(EnvironmentMaps::SAMPLER_SLOT, 1, &environmentMaps.sampler);
+	mCurrentEnvironmentMaps = environmentMaps;
 }
 
 
 // Call if DirectX state may have been changed by a 3rd party library call - resets internal tracking of state
 void RenderState::Reset()
 {
-	mCurrentVertexShader = {};
-	mCurrentPixelShader = {};
-	mCurrentTextures.fill(nullptr);
-	mCurrentSamplers.fill(nullptr);
-	mCurrentEnvironmentMap = {};
+	mImmediateCache = {};
+	mCurrentEnvironmentMaps = {};
+	DX->Geometry()->ResetBindings(); // Vertex and index buffers are likely to have been changed too
 }
 
 
@@ -167,13 +374,15 @@ void RenderState::Reset()
 // Static private data
 //--------------------------------------------------------------------------------------
 
-// Shaders, states, textures and samplers already set on the GPU
+// Shaders, states, textures and samplers already set on the immediate context
 // Use these values to avoid sending requests to the GPU when the current GPU setting is already correct
 // These are static members of the RenderState class (class global). Statics need to be initialised outside the class, here in the cpp file
-ID3D11VertexShader*   RenderState::mCurrentVertexShader = {};
-ID3D11PixelShader*    RenderState::mCurrentPixelShader  = {};
+RenderStateCache RenderState::mImmediateCache = {};
+
+EnvironmentMaps RenderState::mCurrentEnvironmentMaps = {};
+
+bool RenderState::mDepthOnly = false;
 
-std::array<ID3D11ShaderResourceView*, NUM_TEXTURE_TYPES> RenderState::mCurrentTextures = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
-std::array<ID3D11SamplerState*,       NUM_TEXTURE_TYPES> RenderState::mCurrentSamplers = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+ID3D11PixelShader* RenderState::mOverridePixelShader = nullptr;
 
-ID3D11ShaderResourceView* RenderState::mCurrentEnvironmentMap = {};
+bool RenderState::mWeightedOit = false;
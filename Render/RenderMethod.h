@@ -11,6 +11,18 @@
 // RenderState objects are constructed from RenderMethod objects. A RenderMethod is a readable description of the processes
 // and textures/constants needed to render a material. RenderMethods are created during the import process (see Mesh.h/cpp)
 // by looking at the materials used by submeshes in the 3D files. 
+//
+// Apply skips DirectX calls that would set what is already set, using a record of the state on the device context. The
+// immediate context has one record kept here. Deferred contexts recording draws on other threads (see RenderQueue) each pass
+// their own RenderStateCache to Apply
+//
+// Each render state also has a depth-only version for a depth pre-pass, which Apply sets instead while SetDepthOnly(true) is in
+// effect. Rigid geometry uses vertex shaders that only read the positions (vs_p_p2c etc.) and has no pixel shader, except that
+// materials whose pixel shaders cut out pixels with low alpha (the PBR shaders) keep the UVs and make the same test
+//
+// Render states for normal and parallax mapped materials also hold cheaper versions of themselves, shader levels of detail, for
+// draws too small on screen to show the mapping: parallax mapping -> normal mapping -> albedo / diffuse texture only. The render
+// queue picks one for each draw from its size on screen (see RenderQueue::ShaderLOD)
 
 #ifndef _RENDER_METHOD_H_INCLUDED_
 #define _RENDER_METHOD_H_INCLUDED_
@@ -18,10 +30,14 @@
 #include "MeshTypes.h"
 #include "CBufferTypes.h"
 #include "TextureTypes.h"
+#include "Texture.h" // For TextureManager::StreamedTexture
 
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
 #include <array>
+#include <memory>
+#include <utility>
 
 
 //--------------------------------------------------------------------------------------
@@ -63,8 +79,25 @@ enum class SurfaceRenderMethod
 	PbrAltNormalMapping,
 	PbrAltParallaxMapping, // If displacement map is present, parallax mapping is used
 
+	// Physically-based rendering with the albedo map and diffuse lighting only. Not chosen at import, it is the cheapest shader
+	// level of detail of the metalness/roughness methods above (see RenderState::LowerShaderLOD)
+	PbrAlbedoOnly,
+
 	Unknown,
 };
+constexpr int NUM_SURFACE_RENDER_METHODS = static_cast<int>(SurfaceRenderMethod::Unknown) + 1;
+
+// Name of a surface render method for display, e.g. "PbrParallaxMapping"
+const char* SurfaceRenderMethodName(SurfaceRenderMethod method);
+
+
+// Shader level of detail of a render state, from most to least expensive, see RenderState::LowerShaderLOD
+enum class ShaderLOD
+{
+	ParallaxMapping,
+	NormalMapping,
+	Basic,           // Neither normal nor parallax mapping
+};
 
 
 // A RenderMethod describes how the GPU will render a particular submesh with a particular material.
@@ -77,6 +110,42 @@ struct RenderMethod
 	SurfaceRenderMethod      surfaceRenderMethod = SurfaceRenderMethod::Unknown;
 	std::vector<TextureDesc> textures;
 	PerMaterialConstants     constants;
+	bool                     compressedVertices = false; // Vertices use the compressed formats of ImportFlags::CompressVertices, constants hold the position scale/offset
+	bool                     textureArrays      = false; // Textures go in texture arrays shared with similar materials if possible, see ImportFlags::TextureArrays
+};
+
+
+// The image-based lighting of the PBR shaders, set for all RenderStates together by RenderState::SetEnvironmentMap (see
+// EnvironmentLighting.h and IBL.hlsli). The slots are outside the material textures, so they stay bound for every draw
+struct EnvironmentMaps
+{
+	static constexpr unsigned int SPECULAR_SLOT   = static_cast<unsigned int>(TextureType::Environment);
+	static constexpr unsigned int IRRADIANCE_SLOT = 13;
+	static constexpr unsigned int BRDF_LUT_SLOT   = 14;
+	static constexpr unsigned int SAMPLER_SLOT    = static_cast<unsigned int>(TextureType::Environment);
+
+	ID3D11ShaderResourceView* specular   = nullptr; // Cube map prefiltered for a roughness at each mip-map
+	ID3D11ShaderResourceView* irradiance = nullptr; // Cube map of the diffuse light from each direction
+	ID3D11ShaderResourceView* brdfLUT    = nullptr; // Split-sum scale and bias of the specular colour
+	ID3D11SamplerState*       sampler    = nullptr;
+
+	bool operator==(const EnvironmentMaps& other) const
+	{
+		return specular == other.specular && irradiance == other.irradiance && brdfLUT == other.brdfLUT && sampler == other.sampler;
+	}
+};
+
+
+// The shaders, textures, samplers and constants RenderState::Apply has set on a device context
+struct RenderStateCache
+{
+	ID3D11VertexShader* vertexShader = nullptr;
+	ID3D11PixelShader*  pixelShader  = nullptr;
+
+	std::array<ID3D11ShaderResourceView*, NUM_TEXTURE_TYPES> textures = {};
+	std::array<ID3D11SamplerState*,       NUM_TEXTURE_TYPES> samplers = {};
+
+	ID3D11Buffer* constantBuffer = nullptr;
 };
 
 
@@ -92,23 +161,90 @@ public:
 	// Construct GPU render states directly from the RenderMethod descriptor
 	RenderState(const RenderMethod& renderMethod);
 
+	// Forgets this render state's constant buffer if it is the one on the GPU, so a new buffer at the same address is still bound
+	~RenderState();
+
 
 	//--------------------------------------------------------------------------------------
 	// Usage
 	//--------------------------------------------------------------------------------------
 public:
-	// Set up the GPU to use this render state
-	void Apply();
+	// Set up the GPU to use this render state. Pass true to use the instanced vertex shader, which takes the world matrix from the
+	// instance buffer rather than the per-mesh constants (see Mesh::RenderInstanced). Only if CanRenderInstanced returns true
+	void Apply(bool instanced = false);
+
+	// As above, but set up the given device context, whose current state is recorded in the given cache. For deferred contexts
+	// recording draws on another thread, each context must have its own cache and be used by one thread at a time
+	void Apply(ID3D11DeviceContext* context, RenderStateCache& cache, bool instanced = false);
+
+	// Whether this render state has an instanced vertex shader (and a depth-only one). Skinned geometry can't be rendered instanced
+	bool CanRenderInstanced()  { return mInstancedVertexShader != nullptr; }
+
+	// The vertex and pixel shaders Apply sets, the depth-only ones while SetDepthOnly(true) is in effect. The pixel shader is nullptr
+	// for depth-only draws of materials that aren't alpha tested, the weighted transparency one while SetWeightedOit(true) is in
+	// effect, and the override pixel shader if one is set (see below)
+	std::pair<ID3D11VertexShader*, ID3D11PixelShader*> Shaders(bool instanced = false)
+	{
+		if (mDepthOnly)  return { instanced ? mDepthInstancedVertexShader : mDepthVertexShader, mDepthPixelShader };
+		ID3D11PixelShader* pixelShader = mWeightedOit ? mOitPixelShader : mPixelShader;
+		return { instanced ? mInstancedVertexShader : mVertexShader, mOverridePixelShader != nullptr ? mOverridePixelShader : pixelShader };
+	}
+
+	// The shader level of detail of this render state, and the next cheaper version of it for draws that are small on screen,
+	// nullptr if there is none (see top of file). Each version is a complete render state with its own shaders and state key
+	ShaderLOD    GetShaderLOD()    { return mShaderLOD; }
+	RenderState* LowerShaderLOD()  { return mLowerShaderLOD.get(); }
+
+	// The surface render method this render state was made for, e.g. for attributing GPU time (see GpuTemplateCosts.h)
+	SurfaceRenderMethod GetSurfaceRenderMethod()  { return mSurfaceRenderMethod; }
+
+	// The most expensive version of this render state that is no more expensive than the given shader level of detail, which
+	// is this render state itself if it has no cheaper version
+	RenderState* ForShaderLOD(ShaderLOD lod)
+	{
+		RenderState* renderState = this;
+		while (renderState->mShaderLOD < lod && renderState->mLowerShaderLOD != nullptr)  renderState = renderState->mLowerShaderLOD.get();
+		return renderState;
+	}
+
+	// Ask for this render state's streamed textures to be loaded at least the given size across, e.g. the height in pixels of the
+	// object using it on screen (see RenderQueue::AddDraw). Can be called on any thread
+	void RequestTextureSize(unsigned int size)
+	{
+		for (auto texture : mTextures)  if (texture != nullptr)  texture->RequestSize(size);
+	}
+
+	// 40-bit key for sorting draws by render state (see RenderQueue.h). Render states using the same shaders have keys next to
+	// each other, and within those the ones using the same textures, so sorting by key minimises the GPU state changes
+	uint64_t StateKey()  { return mStateKey; }
+
+	// Add the memory used by this render state and its cheaper versions to the given totals: the objects themselves, the
+	// material constants and the textures. The cheaper versions use some of the same textures, so those are counted once
+	void AddMemory(MeshMemory& memory);
 
 
 	//--------------------------------------------------------------------------------------
 	// Static public methods
 	//--------------------------------------------------------------------------------------
 public:
-	// Set an environment map for all RenderStates
-	static void SetEnvironmentMap(ID3D11ShaderResourceView* environmentMap);
+	// Set the environment maps for all RenderStates, see EnvironmentMaps above
+	static void SetEnvironmentMap(const EnvironmentMaps& environmentMaps);
+
+	// Whether Apply sets the depth-only version of each render state, see above. Set before rendering a depth pre-pass with no
+	// render target, and back to false after it. Don't change while draws are being recorded on other threads
+	static void SetDepthOnly(bool depthOnly)  { mDepthOnly = depthOnly; }
+	static bool DepthOnly()                   { return mDepthOnly; }
 
-	// Call if DirectX state may have been changed by a 3rd party library call - resets internal tracking of state
+	// A pixel shader Apply sets instead of every render state's own while it isn't nullptr, e.g. for the overdraw heatmap (see
+	// Scene::RenderFromCamera). Depth-only draws keep their shaders. Don't change while draws are being recorded on other threads
+	static void SetOverridePixelShader(ID3D11PixelShader* pixelShader)  { mOverridePixelShader = pixelShader; }
+
+	// Whether Apply sets the version of each render state's pixel shader writing weighted blended transparency, see WeightedOit.h.
+	// Set by WeightedOit::Begin and End. Don't change while draws are being recorded on other threads
+	static void SetWeightedOit(bool weightedOit)  { mWeightedOit = weightedOit; }
+
+	// Call if DirectX state may have been changed by a 3rd party library call - resets internal tracking of state. Around library
+	// calls a StateBlock is cheaper, it restores the state instead so nothing needs to be set again (see StateBlock.h)
 	static void Reset();
 
 
@@ -120,29 +256,53 @@ private:
 	// This class does not have ownership of these objects, the ShaderManager does, so no need to release them
 	ID3D11VertexShader* mVertexShader = {};
 	ID3D11PixelShader*  mPixelShader  = {};
+	ID3D11VertexShader* mInstancedVertexShader = {}; // Version of the vertex shader for instanced rendering, see Apply
+
+	// Shaders for the depth-only version of this render state, the pixel shader is nullptr unless the material is alpha tested
+	ID3D11VertexShader* mDepthVertexShader          = {};
+	ID3D11VertexShader* mDepthInstancedVertexShader = {};
+	ID3D11PixelShader*  mDepthPixelShader           = {};
+
+	// Pixel shader writing the accumulation and revealage targets of weighted blended transparency, see SetWeightedOit
+	ID3D11PixelShader*  mOitPixelShader = {};
 
 	// Textures and samplers required by this render method, this class does not own these objects, the TextureManager does, so no need to release them
-	std::array<ID3D11ShaderResourceView*, NUM_TEXTURE_TYPES> mTextures = {};
+	// The textures are streamed, their views change as finer versions load (see TextureManager::StreamTexture)
+	std::array<TextureManager::StreamedTexture*, NUM_TEXTURE_TYPES> mTextures = {};
 	std::array<ID3D11SamplerState*,       NUM_TEXTURE_TYPES> mSamplers = {};
 
-	// Shader constants required by this render method (colours, transparency, parallax mapping depth etc.)
-	// Not all constants will be needed by all render methods (indeed, some methods require none)
-	PerMaterialConstants mConstants;
+	// Constant buffer holding the shader constants required by this render method (colours, transparency, parallax mapping depth etc.)
+	// Not all constants will be needed by all render methods (indeed, some methods require none). Immutable, the constants don't change
+	CComPtr<ID3D11Buffer> mConstantBuffer;
+
+	// Shader id (10 bits), texture set id (14 bits) and material id (16 bits), see StateKey
+	uint64_t mStateKey = 0;
+
+	SurfaceRenderMethod mSurfaceRenderMethod = SurfaceRenderMethod::Unknown;
+
+	// Shader level of detail of this render state and the cheaper version of it, see LowerShaderLOD
+	ShaderLOD                    mShaderLOD = ShaderLOD::Basic;
+	std::unique_ptr<RenderState> mLowerShaderLOD;
 
 
 	//--------------------------------------------------------------------------------------
 	// Static private data
 	//--------------------------------------------------------------------------------------
 private:
-	// Shaders, states, textures and samplers already set on the GPU
+	// Shaders, states, textures and samplers already set on the immediate context
 	// Uses these values to avoid sending requests to the GPU when the current GPU setting is already correct
-	static ID3D11VertexShader* mCurrentVertexShader;
-	static ID3D11PixelShader*  mCurrentPixelShader;
+	static RenderStateCache mImmediateCache;
+
+	static EnvironmentMaps mCurrentEnvironmentMaps;
+
+	// Apply sets the depth-only shaders, see SetDepthOnly
+	static bool mDepthOnly;
 
-	static std::array<ID3D11ShaderResourceView*, NUM_TEXTURE_TYPES> mCurrentTextures;
-	static std::array<ID3D11SamplerState*,       NUM_TEXTURE_TYPES> mCurrentSamplers;
+	// Set by Apply in place of each render state's pixel shader, see SetOverridePixelShader
+	static ID3D11PixelShader* mOverridePixelShader;
 
-	static ID3D11ShaderResourceView* mCurrentEnvironmentMap;
+	// Apply sets the weighted blended transparency pixel shaders, see SetWeightedOit
+	static bool mWeightedOit;
 };
 
 
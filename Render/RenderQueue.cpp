@@ -0,0 +1,321 @@
+//--------------------------------------------------------------------------------------
+// RenderQueue class collects draw calls and submits them sorted by render state
+//--------------------------------------------------------------------------------------
+
+#include "RenderQueue.h"
+
+#include "Mesh.h"
+#include "RenderMethod.h"
+#include "CBuffer.h"
+#include "RenderGlobals.h"
+#include "DXDevice.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+
+
+// Sort keys are the 40-bit render state key and a 24-bit distance
+static constexpr unsigned int DISTANCE_BITS = 24;
+static constexpr uint64_t     DISTANCE_MASK = (1ull << DISTANCE_BITS) - 1;
+
+// Distance as an integer that sorts in the same order. Positive floats sort the same as their bit patterns, the top 24 bits
+// below the (zero) sign bit are kept
+static uint64_t DistanceKey(float distance)
+{
+	return (std::bit_cast<uint32_t>(std::max(distance, 0.0f)) >> (31 - DISTANCE_BITS)) & DISTANCE_MASK;
+}
+
+// Fewest packets recorded by each deferred context, recording and executing a command list costs more than this saves below it
+static constexpr size_t MIN_PACKETS_PER_CONTEXT = 256;
+
+// Texture and sampler slots copied from the immediate context to the deferred contexts. Slots below NUM_TEXTURE_TYPES are left
+// empty, they are set by RenderState::Apply and its cache for each context starts empty
+static constexpr UINT INHERITED_SLOTS_END = 16;
+
+
+// The parts of the immediate context's state that queued draws rely on but don't set themselves, copied at the start of a
+// parallel flush so each deferred context can begin with them. The Get functions add references, released on destruction
+struct InheritedState
+{
+	ID3D11RenderTargetView*   renderTargets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT] = {};
+	ID3D11DepthStencilView*   depthStencil = nullptr;
+	D3D11_VIEWPORT            viewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE] = {};
+	UINT                      numViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	ID3D11RasterizerState*    rasterizerState = nullptr;
+	ID3D11BlendState*         blendState = nullptr;
+	FLOAT                     blendFactor[4] = {};
+	UINT                      sampleMask = 0;
+	ID3D11DepthStencilState*  depthState = nullptr;
+	UINT                      stencilRef = 0;
+	ID3D11Buffer*             vsConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+	ID3D11Buffer*             psConstantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT] = {};
+	ID3D11ShaderResourceView* psResources[INHERITED_SLOTS_END - NUM_TEXTURE_TYPES] = {};
+	ID3D11SamplerState*       psSamplers [INHERITED_SLOTS_END - NUM_TEXTURE_TYPES] = {};
+
+	InheritedState(ID3D11DeviceContext* context)
+	{
+		context->OMGetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, renderTargets, &depthStencil);
+		context->RSGetViewports(&numViewports, viewports);
+		context->RSGetState(&rasterizerState);
+		context->OMGetBlendState(&blendState, blendFactor, &sampleMask);
+		context->OMGetDepthStencilState(&depthState, &stencilRef);
+		context->VSGetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, vsConstantBuffers);
+		context->PSGetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, psConstantBuffers);
+		context->PSGetShaderResources(NUM_TEXTURE_TYPES, INHERITED_SLOTS_END - NUM_TEXTURE_TYPES, psResources);
+		context->PSGetSamplers(NUM_TEXTURE_TYPES, INHERITED_SLOTS_END - NUM_TEXTURE_TYPES, psSamplers);
+	}
+
+	// Set the copied state on a deferred context. The material constant buffer slot is left to RenderState::Apply
+	void SetOn(ID3D11DeviceContext* context) const
+	{
+		context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, renderTargets, depthStencil);
+		context->RSSetViewports(numViewports, viewports);
+		context->RSSetState(rasterizerState);
+		context->OMSetBlendState(blendState, blendFactor, sampleMask);
+		context->OMSetDepthStencilState(depthState, stencilRef);
+		context->VSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, vsConstantBuffers);
+		context->PSSetConstantBuffers(0, D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT, psConstantBuffers);
+		context->PSSetShaderResources(NUM_TEXTURE_TYPES, INHERITED_SLOTS_END - NUM_TEXTURE_TYPES, psResources);
+		context->PSSetSamplers(NUM_TEXTURE_TYPES, INHERITED_SLOTS_END - NUM_TEXTURE_TYPES, psSamplers);
+	}
+
+	~InheritedState()
+	{
+		auto release = [](auto& objects) { for (auto* object : objects)  if (object != nullptr)  object->Release(); };
+		release(renderTargets);
+		release(vsConstantBuffers);
+		release(psConstantBuffers);
+		release(psResources);
+		release(psSamplers);
+		if (depthStencil    != nullptr)  depthStencil->Release();
+		if (rasterizerState != nullptr)  rasterizerState->Release();
+		if (blendState      != nullptr)  blendState->Release();
+		if (depthState      != nullptr)  depthState->Release();
+	}
+
+	InheritedState(const InheritedState&) = delete;
+	InheritedState& operator=(const InheritedState&) = delete;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Add an object to the queue - the world matrix and colour shared by the sub-meshes of one mesh node
+unsigned int RenderQueue::AddObject(const Matrix4x4& worldMatrix, ColourRGBA colour)
+{
+	mObjects.push_back({ worldMatrix, colour });
+	return static_cast<unsigned int>(mObjects.size() - 1);
+}
+
+
+// Add a draw of a sub-mesh of a mesh with the given render state, using an object added above. The render state is replaced by
+// a cheaper version if the object is small on screen
+void RenderQueue::AddDraw(Mesh* mesh, unsigned int subMesh, RenderState* renderState, unsigned int object, float distance,
+                          float radius /*= 0*/)
+{
+	// Streamed textures are loaded at the size the object appears on screen, its diameter in pixels. Objects around the camera
+	// always get the full textures and shaders
+	if (mProjectionScale > 0 && radius > 0)
+	{
+		if (distance > radius)  renderState->RequestTextureSize(static_cast<unsigned int>(radius * mProjectionScale / distance * DX->GetSceneHeight()) + 1);
+		else                    renderState->RequestTextureSize(UINT_MAX);
+	}
+	if (mShaderLOD && mProjectionScale > 0 && renderState->LowerShaderLOD() != nullptr && distance > radius)
+	{
+		float screenSize = radius * mProjectionScale / distance;
+		ShaderLOD lod = (screenSize >= NORMAL_MAPPING_SCREEN_SIZE) ? ShaderLOD::ParallaxMapping :
+		                (screenSize >= BASIC_SHADING_SCREEN_SIZE)  ? ShaderLOD::NormalMapping : ShaderLOD::Basic;
+		RenderState* reducedState = renderState->ForShaderLOD(lod);
+		if (reducedState != renderState)
+		{
+			renderState = reducedState;
+			++mStats.reducedShaders;
+		}
+	}
+	mPackets.push_back({ mesh, renderState, subMesh, object, distance });
+}
+
+
+// Sort the queued packets in the given order and render them, then empty the queue
+void RenderQueue::Flush(DrawOrder order)
+{
+	if (mPackets.empty())  return;
+
+	mSortKeys.resize(mPackets.size());
+	RenderState* previousState = nullptr;
+	for (size_t i = 0; i < mPackets.size(); ++i)
+	{
+		const Packet& packet = mPackets[i];
+		uint64_t stateKey = packet.renderState->StateKey();
+		uint64_t distanceKey = DistanceKey(packet.distance);
+		if      (order == DrawOrder::FrontToBack)  mSortKeys[i] = (stateKey << DISTANCE_BITS) | distanceKey;
+		else if (order == DrawOrder::BackToFront)  mSortKeys[i] = ((DISTANCE_MASK - distanceKey) << (64 - DISTANCE_BITS)) | stateKey;
+		else                                       mSortKeys[i] = stateKey;
+
+		if (packet.renderState != previousState)  ++mStats.unsortedStateChanges;
+		previousState = packet.renderState;
+	}
+	SortPackets();
+
+	previousState = nullptr;
+	for (uint32_t index : mSortedIndices)
+	{
+		const Packet& packet = mPackets[index];
+		if (packet.renderState != previousState)  ++mStats.stateChanges;
+		previousState = packet.renderState;
+	}
+	mStats.draws += static_cast<uint32_t>(mPackets.size());
+
+	if (!SubmitPacketsInParallel())  SubmitPackets(0, mSortedIndices.size());
+
+	mPackets.clear();
+	mObjects.clear();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Private functions
+//--------------------------------------------------------------------------------------
+
+// Draw a range of the sorted packets on the immediate context, only sending the per-mesh constants when the object changes
+void RenderQueue::SubmitPackets(size_t begin, size_t end)
+{
+	unsigned int previousObject = ~0u;
+	for (size_t i = begin; i < end; ++i)
+	{
+		const Packet& packet = mPackets[mSortedIndices[i]];
+		if (packet.object != previousObject)
+		{
+			gPerMeshConstants.worldMatrix = mObjects[packet.object].worldMatrix;
+			gPerMeshConstants.meshColour  = mObjects[packet.object].meshColour;
+			DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+			previousObject = packet.object;
+		}
+		packet.mesh->RenderQueuedSubMesh(packet.subMesh);
+	}
+}
+
+
+// Record the sorted packets into deferred contexts on the job system's threads, then execute the command lists in order
+bool RenderQueue::SubmitPacketsInParallel()
+{
+	if (!mParallelRecording || mJobSystem == nullptr)  return false;
+
+	size_t numPackets  = mSortedIndices.size();
+	size_t numContexts = std::min<size_t>(mJobSystem->NumThreads(), numPackets / MIN_PACKETS_PER_CONTEXT);
+	if (numContexts < 2)  return false;
+
+	while (mRecorders.size() < numContexts)
+	{
+		Recorder recorder;
+		if (FAILED(DX->Device()->CreateDeferredContext(0, &recorder.context)))
+		{
+			mParallelRecording = false;
+			return false;
+		}
+		mRecorders.push_back(std::move(recorder));
+	}
+
+	// Each context records a consecutive range of the sorted packets, so executing them in order keeps the sorted order
+	InheritedState inheritedState(DX->Context());
+	size_t packetsPerContext = (numPackets + numContexts - 1) / numContexts;
+	mJobSystem->ParallelFor(numContexts, 1, [&](size_t chunk, size_t, size_t)
+	{
+		Recorder& recorder = mRecorders[chunk];
+		ID3D11DeviceContext* context = recorder.context;
+		inheritedState.SetOn(context);
+		recorder.stateCache = {};
+		recorder.bindings   = {};
+
+		// Other per-mesh constants keep their current values, as on the immediate context. The immediate context may have them in
+		// the per-draw ring (see CBuffer.h), which isn't used here, so bind the per-mesh buffer itself
+		PerMeshConstants perMeshConstants = gPerMeshConstants;
+		context->VSSetConstantBuffers(PER_MESH_CBUFFER_SLOT, 1, &gPerMeshConstantBuffer);
+		context->PSSetConstantBuffers(PER_MESH_CBUFFER_SLOT, 1, &gPerMeshConstantBuffer);
+		unsigned int previousObject = ~0u;
+		size_t end = std::min((chunk + 1) * packetsPerContext, numPackets);
+		for (size_t i = chunk * packetsPerContext; i < end; ++i)
+		{
+			const Packet& packet = mPackets[mSortedIndices[i]];
+			if (packet.object != previousObject)
+			{
+				perMeshConstants.worldMatrix = mObjects[packet.object].worldMatrix;
+				perMeshConstants.meshColour  = mObjects[packet.object].meshColour;
+				DX->CBuffers()->UpdateCBuffer(context, gPerMeshConstantBuffer, perMeshConstants);
+				previousObject = packet.object;
+			}
+			packet.mesh->RenderQueuedSubMesh(packet.subMesh, context, recorder.stateCache, recorder.bindings);
+		}
+
+		// The deferred context's state is cleared rather than kept, it is set again at the start of the next flush
+		if (FAILED(context->FinishCommandList(FALSE, &recorder.commandList)))  recorder.commandList.Release();
+	});
+
+	// The immediate context's state is restored after each command list, so its own state records stay correct. A range whose
+	// command list failed is drawn directly instead
+	for (size_t chunk = 0; chunk < numContexts; ++chunk)
+	{
+		Recorder& recorder = mRecorders[chunk];
+		if (recorder.commandList != nullptr)
+		{
+			DX->Context()->ExecuteCommandList(recorder.commandList, TRUE);
+			recorder.commandList.Release();
+			++mStats.commandLists;
+		}
+		else
+		{
+			SubmitPackets(chunk * packetsPerContext, std::min((chunk + 1) * packetsPerContext, numPackets));
+		}
+		recorder.bindings = {}; // Don't hold geometry buffers between flushes
+	}
+	return true;
+}
+
+
+// Radix sort the key of every packet, leaving the order of the packets in mSortedIndices. Least significant byte first, eight
+// passes of 256 buckets. The histograms for every pass are counted together first, then passes where every key has the same
+// byte (common in the high bytes) are skipped
+void RenderQueue::SortPackets()
+{
+	size_t numPackets = mSortKeys.size();
+	mSortKeysTemp.resize(numPackets);
+	mSortedIndices.resize(numPackets);
+	mSortedIndicesTemp.resize(numPackets);
+	for (uint32_t i = 0; i < numPackets; ++i)  mSortedIndices[i] = i;
+
+	std::array<std::array<uint32_t, 256>, 8> counts = {};
+	for (uint64_t key : mSortKeys)
+	{
+		for (unsigned int pass = 0; pass < 8; ++pass)  ++counts[pass][(key >> (pass * 8)) & 0xFF];
+	}
+
+	for (unsigned int pass = 0; pass < 8; ++pass)
+	{
+		unsigned int shift = pass * 8;
+		auto& passCounts = counts[pass];
+		if (passCounts[(mSortKeys[0] >> shift) & 0xFF] == numPackets)  continue;
+
+		// Turn the counts into the position of the first key in each bucket
+		uint32_t position = 0;
+		for (auto& count : passCounts)
+		{
+			uint32_t bucketSize = count;
+			count = position;
+			position += bucketSize;
+		}
+
+		for (size_t i = 0; i < numPackets; ++i)
+		{
+			uint32_t destination = passCounts[(mSortKeys[i] >> shift) & 0xFF]++;
+			mSortKeysTemp[destination]      = mSortKeys[i];
+			mSortedIndicesTemp[destination] = mSortedIndices[i];
+		}
+		std::swap(mSortKeys, mSortKeysTemp);
+		std::swap(mSortedIndices, mSortedIndicesTemp);
+	}
+}
@@ -0,0 +1,170 @@
+//--------------------------------------------------------------------------------------
+// RenderQueue class collects draw calls and submits them sorted by render state
+//--------------------------------------------------------------------------------------
+// Rendering entities in the order they are stored alternates between materials (e.g. a PBR rock, then a Blinn boat, then the
+// unlit sky), so RenderState::Apply has to change shaders and textures on almost every draw. Instead meshes can add a packet
+// for each sub-mesh they would draw to a render queue, which sorts the packets by a 64-bit key then submits them:
+//
+//   mesh.QueueRender(queue, root, nodes, colour, cullFrustum);   // For each visible mesh
+//   ...
+//   queue.Flush(DrawOrder::FrontToBack);
+//
+// For front-to-back order the key is the render state (shaders, then textures, then material, see RenderState::StateKey) with
+// the camera distance below it, so draws sharing state are together and nearest first within each state. Back-to-front order,
+// for blended geometry, puts the inverted distance above the render state instead. Blending that doesn't depend on the order
+// of the draws sorts by render state alone, so the depths don't matter. Packets are sorted with a radix sort
+//
+// With parallel recording on (and a job system set), a large flush is split into consecutive ranges of the sorted packets. Each
+// range is recorded on a job system thread into its own D3D11 deferred context, with its own record of the state set on it (see
+// RenderStateCache and GeometryManager::Bindings). The main thread then executes the command lists in order, so the result is
+// the same as drawing the packets directly. The deferred contexts start with the render targets, viewport, GPU states and
+// shared constant buffers and textures of the immediate context at the time of the flush
+//
+// With shader levels of detail on, AddDraw replaces the render state of a draw that is small on screen with a cheaper version
+// of it (see RenderState::LowerShaderLOD), so distant parallax mapped surfaces use normal mapping, and farther ones neither
+
+#ifndef _RENDER_QUEUE_H_INCLUDED_
+#define _RENDER_QUEUE_H_INCLUDED_
+
+#include "CBufferTypes.h"
+#include "RenderMethod.h"
+#include "Geometry.h"
+#include "Matrix4x4.h"
+#include "ColourTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <stdint.h>
+
+class Mesh;
+class RenderState;
+class JobSystem;
+
+
+// Order to submit the packets in a render queue
+enum class DrawOrder
+{
+	FrontToBack, // Grouped by render state, nearest first within each state. For opaque geometry
+	BackToFront, // Farthest first regardless of render state. For blended geometry that must be drawn in depth order
+	ByState,     // Grouped by render state only. For blending whose result doesn't depend on order (e.g. see WeightedOit.h)
+};
+
+
+//--------------------------------------------------------------------------------------
+// Render Queue Class
+//--------------------------------------------------------------------------------------
+class RenderQueue
+{
+	//--------------------------------------------------------------------------------------
+	// Usage
+	//--------------------------------------------------------------------------------------
+public:
+	// Add an object to the queue - the world matrix and colour shared by the sub-meshes of one mesh node. Returns the index
+	// to pass to AddDraw for each of those sub-meshes
+	unsigned int AddObject(const Matrix4x4& worldMatrix, ColourRGBA colour);
+
+	// Add a draw of a sub-mesh of a mesh with the given render state, using an object added above. Distance is from the camera,
+	// used to order the packets (see DrawOrder). Radius is of the object's world bounding sphere, used with the distance for its
+	// size on screen to choose the shader level of detail. Pass 0 to always use the given render state
+	void AddDraw(Mesh* mesh, unsigned int subMesh, RenderState* renderState, unsigned int object, float distance, float radius = 0);
+
+	// Sort the queued packets in the given order and render them, then empty the queue. The per-mesh constants are only sent
+	// to the GPU when the object changes between packets
+	void Flush(DrawOrder order);
+
+	// Whether the queue has any packets waiting
+	bool IsEmpty()  { return mPackets.empty(); }
+
+	// Set the job system used to record draws in parallel, nullptr to always draw on the calling thread
+	void SetJobSystem(JobSystem* jobSystem)  { mJobSystem = jobSystem; }
+
+	// Whether large flushes are recorded into deferred contexts on the job system's threads, see above. Turned off if the
+	// deferred contexts can't be created
+	bool& ParallelRecording()  { return mParallelRecording; }
+
+	// Whether AddDraw uses cheaper render states for draws that are small on screen, see above. Sizes are the radius as a fraction
+	// of half the viewport height, as for mesh levels of detail (see EntityTemplate::AddLOD), measured with the camera projection
+	// matrix's Y scale (e11) given to SetProjectionScale. Until it is set the full render states are used
+	bool& ShaderLOD()  { return mShaderLOD; }
+	void  SetProjectionScale(float projectionScale)  { mProjectionScale = projectionScale; }
+
+	// Counts from the flushes since the last reset. State changes are the number of times consecutive draws used a different
+	// render state, unsorted is how many there would have been in the order the packets were added. Command lists are the number
+	// recorded on worker threads and executed. Reduced shaders are the draws given a cheaper render state by AddDraw
+	struct Stats
+	{
+		uint32_t draws                = 0;
+		uint32_t stateChanges         = 0;
+		uint32_t unsortedStateChanges = 0;
+		uint32_t commandLists         = 0;
+		uint32_t reducedShaders       = 0;
+	};
+	const Stats& GetStats()    { return mStats; }
+	void         ResetStats()  { mStats = {}; }
+
+
+	//--------------------------------------------------------------------------------------
+	// Private functions
+	//--------------------------------------------------------------------------------------
+private:
+	// Radix sort the key of every packet, leaving the order of the packets in mSortedIndices. Stable, so packets with equal
+	// keys are submitted in the order they were added
+	void SortPackets();
+
+	// Draw a range of the sorted packets on the immediate context
+	void SubmitPackets(size_t begin, size_t end);
+
+	// Record the sorted packets into deferred contexts on the job system's threads, then execute them in order. Returns false
+	// without drawing anything if there are too few packets to be worth it or the deferred contexts can't be created
+	bool SubmitPacketsInParallel();
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Data
+	//--------------------------------------------------------------------------------------
+private:
+	struct Packet
+	{
+		Mesh*        mesh;
+		RenderState* renderState;
+		unsigned int subMesh;
+		unsigned int object;   // Index into mObjects
+		float        distance;
+	};
+	std::vector<Packet>           mPackets;
+	std::vector<PerMeshConstants> mObjects;
+
+	// Sort keys and the resulting packet order, with space for the radix sort's passes. Kept between frames to avoid reallocating
+	std::vector<uint64_t> mSortKeys;
+	std::vector<uint64_t> mSortKeysTemp;
+	std::vector<uint32_t> mSortedIndices;
+	std::vector<uint32_t> mSortedIndicesTemp;
+
+	// A deferred context for recording packets on a worker thread, with the state set on it and the command list it recorded
+	struct Recorder
+	{
+		CComPtr<ID3D11DeviceContext> context;
+		CComPtr<ID3D11CommandList>   commandList;
+		RenderStateCache             stateCache;
+		GeometryManager::Bindings    bindings;
+	};
+	std::vector<Recorder> mRecorders; // Created when first needed, one per job system thread at most
+
+	JobSystem* mJobSystem         = nullptr;
+	bool       mParallelRecording = true;
+
+	// Screen sizes below which draws of parallax mapped render states use normal mapping, and below which they use neither
+	static constexpr float NORMAL_MAPPING_SCREEN_SIZE = 0.15f;
+	static constexpr float BASIC_SHADING_SCREEN_SIZE  = 0.04f;
+
+	bool  mShaderLOD       = true;
+	float mProjectionScale = 0;
+
+	Stats mStats;
+};
+
+
+#endif //_RENDER_QUEUE_H_INCLUDED_
@@ -0,0 +1,231 @@
+//--------------------------------------------------------------------------------------
+// Scene buffer - entity world matrices and bounds kept on the GPU between frames, only the changes uploaded
+//--------------------------------------------------------------------------------------
+
+#include "SceneBuffer.h"
+
+#include "Shader.h"
+#include "CBuffer.h"
+#include "RenderGlobals.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the scatter compute shader and create its constant buffer. Throws std::runtime_error on failure
+SceneBuffer::SceneBuffer()
+{
+	mComputeShader = DX->Shaders()->LoadComputeShader("cs_scene-scatter");
+	if (mComputeShader == nullptr)  throw std::runtime_error("Scene buffer: " + DX->Shaders()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(SceneScatterConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Scene buffer: failure creating constant buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Bring a slot's entry up to date with the given drawn node matrices and world bounding sphere, queuing what has changed
+void SceneBuffer::Write(uint32_t slot, const Matrix4x4* matrices, unsigned int numMatrices, const BoundingSphere& bounds)
+{
+	if (slot >= mSlots.size())  mSlots.resize(slot + 1);
+	Slot& entry = mSlots[slot];
+
+	// A different number of matrices is a different mesh, it needs a new range and all its matrices sent
+	bool entryChanged = !entry.valid;
+	bool matricesValid = entry.valid;
+	if (entry.numMatrices != numMatrices)
+	{
+		if (entry.numMatrices > 0)  mFreeRanges[entry.numMatrices].push_back(entry.firstMatrix);
+		entry.firstMatrix = AllocateMatrices(numMatrices);
+		entry.numMatrices = numMatrices;
+		entryChanged  = true;
+		matricesValid = false;
+	}
+
+	for (unsigned int i = 0; i < numMatrices; ++i)
+	{
+		Matrix4x4& held = mMatrices[entry.firstMatrix + i];
+		if (matricesValid && std::memcmp(&held, &matrices[i], sizeof(Matrix4x4)) == 0)  continue;
+		held = matrices[i];
+		QueueUpdate(Target::Matrices, (entry.firstMatrix + i) * (MATRIX_BYTES / 16), 4, &held);
+	}
+
+	if (entryChanged || bounds.centre.x != entry.bounds.centre.x || bounds.centre.y != entry.bounds.centre.y ||
+	    bounds.centre.z != entry.bounds.centre.z || bounds.radius != entry.bounds.radius)
+	{
+		entry.bounds = bounds;
+		uint32_t rows[2][4] = { {}, { entry.firstMatrix, entry.numMatrices, 0, 0 } };
+		std::memcpy(&rows[0][0], &bounds.centre, sizeof(float) * 3);
+		std::memcpy(&rows[0][3], &bounds.radius, sizeof(float));
+		QueueUpdate(Target::Entries, slot * (ENTRY_BYTES / 16), 2, rows);
+	}
+	entry.valid = true;
+}
+
+
+// Send the queued changes to the GPU and scatter them into the buffers. Returns false on failure
+bool SceneBuffer::Upload()
+{
+	if (mUpdates.empty())  return mEntryBuffer.srv != nullptr;
+
+	// The buffers hold every slot and matrix range so far, growing on the GPU keeps what they already hold
+	unsigned int numUpdates = static_cast<unsigned int>(mUpdates.size());
+	if (!ReserveRaw(mEntryBuffer,  static_cast<unsigned int>(mSlots.size()) * ENTRY_BYTES) ||
+	    !ReserveRaw(mMatrixBuffer, static_cast<unsigned int>(std::max<size_t>(mMatrices.size(), 1)) * MATRIX_BYTES))
+	{
+		Invalidate();
+		return false;
+	}
+
+	// The update list is rewritten each time, replaced by a larger one if it is too small
+	auto device  = DX->Device();
+	auto context = DX->Context();
+	if (numUpdates > mUpdateBuffer.capacity)
+	{
+		unsigned int capacity = (mUpdateBuffer.capacity > 0) ? mUpdateBuffer.capacity : INITIAL_CAPACITY;
+		while (capacity < numUpdates)  capacity *= 2;
+		mUpdateBuffer = {};
+
+		D3D11_BUFFER_DESC bufferDesc = {};
+		bufferDesc.BindFlags           = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.ByteWidth           = capacity * sizeof(GpuUpdate);
+		bufferDesc.Usage               = D3D11_USAGE_DYNAMIC;
+		bufferDesc.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags           = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = sizeof(GpuUpdate);
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format             = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension      = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.NumElements = capacity;
+		if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &mUpdateBuffer.buffer)) ||
+		    FAILED(device->CreateShaderResourceView(mUpdateBuffer.buffer, &srvDesc, &mUpdateBuffer.srv)))
+		{
+			mUpdateBuffer = {};
+			Invalidate();
+			return false;
+		}
+		mUpdateBuffer.capacity = capacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(mUpdateBuffer.buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+	{
+		Invalidate();
+		return false;
+	}
+	std::memcpy(mapped.pData, mUpdates.data(), numUpdates * sizeof(GpuUpdate));
+	context->Unmap(mUpdateBuffer.buffer, 0);
+
+	mConstants.numUpdates = numUpdates;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	ID3D11UnorderedAccessView* uavs[] = { mEntryBuffer.uav, mMatrixBuffer.uav };
+	context->CSSetShader(mComputeShader, nullptr, 0);
+	context->CSSetConstantBuffers(0, 1, &mConstantBuffer);
+	context->CSSetShaderResources(0, 1, &mUpdateBuffer.srv.p);
+	context->CSSetUnorderedAccessViews(0, 2, uavs, nullptr);
+	context->Dispatch((numUpdates + THREAD_GROUP_SIZE - 1) / THREAD_GROUP_SIZE, 1, 1);
+
+	// Unbind the buffers so the culling shader can read them
+	ID3D11ShaderResourceView*  nullSrv = nullptr;
+	ID3D11UnorderedAccessView* nullUavs[2] = {};
+	context->CSSetShaderResources(0, 1, &nullSrv);
+	context->CSSetUnorderedAccessViews(0, 2, nullUavs, nullptr);
+	context->CSSetShader(nullptr, nullptr, 0);
+
+	for (auto& update : mUpdates)
+	{
+		if (update.target == Target::Entries)  ++mStats.entries;
+		else                                   ++mStats.matrices;
+	}
+	mStats.bytes += numUpdates * sizeof(GpuUpdate);
+	mUpdates.clear();
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Position for a slot's matrices, reusing a range freed by a slot with the same number if there is one
+uint32_t SceneBuffer::AllocateMatrices(uint32_t count)
+{
+	auto& free = mFreeRanges[count];
+	if (!free.empty())
+	{
+		uint32_t first = free.back();
+		free.pop_back();
+		return first;
+	}
+	uint32_t first = static_cast<uint32_t>(mMatrices.size());
+	mMatrices.resize(mMatrices.size() + count);
+	return first;
+}
+
+
+// Queue the given 16-byte rows to be written to a buffer at firstRow
+void SceneBuffer::QueueUpdate(Target target, uint32_t firstRow, uint32_t numRows, const void* rows)
+{
+	GpuUpdate& update = mUpdates.emplace_back();
+	update.target   = target;
+	update.firstRow = firstRow;
+	update.numRows  = numRows;
+	std::memcpy(update.rows, rows, numRows * 16);
+}
+
+
+// Make sure a raw buffer holds the given number of bytes, copying its contents to the new buffer on the GPU if it grows
+bool SceneBuffer::ReserveRaw(GrowableBuffer& buffer, unsigned int bytes)
+{
+	if (bytes <= buffer.capacity)  return true;
+
+	unsigned int capacity = (buffer.capacity > 0) ? buffer.capacity : INITIAL_CAPACITY * ENTRY_BYTES;
+	while (capacity < bytes)  capacity *= 2;
+
+	GrowableBuffer grown;
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+	bufferDesc.ByteWidth = capacity;
+	bufferDesc.Usage     = D3D11_USAGE_DEFAULT; // Written on the GPU only, by the scatter shader
+	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format               = DXGI_FORMAT_R32_TYPELESS;
+	srvDesc.ViewDimension        = D3D11_SRV_DIMENSION_BUFFEREX;
+	srvDesc.BufferEx.NumElements = capacity / 4;
+	srvDesc.BufferEx.Flags       = D3D11_BUFFEREX_SRV_FLAG_RAW;
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format             = DXGI_FORMAT_R32_TYPELESS;
+	uavDesc.ViewDimension      = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.NumElements = capacity / 4;
+	uavDesc.Buffer.Flags       = D3D11_BUFFER_UAV_FLAG_RAW;
+	auto device = DX->Device();
+	if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &grown.buffer)) ||
+	    FAILED(device->CreateShaderResourceView(grown.buffer, &srvDesc, &grown.srv)) ||
+	    FAILED(device->CreateUnorderedAccessView(grown.buffer, &uavDesc, &grown.uav)))  return false;
+	grown.capacity = capacity;
+
+	if (buffer.buffer != nullptr)
+	{
+		D3D11_BOX box = { 0, 0, 0, buffer.capacity, 1, 1 };
+		DX->Context()->CopySubresourceRegion(grown.buffer, 0, 0, 0, 0, buffer.buffer, 0, &box);
+	}
+	buffer = grown;
+	return true;
+}
+
+
+// Forget what the GPU holds so every entry is sent again when next written
+void SceneBuffer::Invalidate()
+{
+	for (auto& slot : mSlots)  slot.valid = false;
+	mUpdates.clear();
+}
@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// Scene buffer - entity world matrices and bounds kept on the GPU between frames, only the changes uploaded
+//--------------------------------------------------------------------------------------
+// The GPU culler (see GpuCuller.h) used to be sent the world matrices and bounding sphere of every candidate instance for
+// every view, although most instanced entities (props, mines, resting crates) don't move from one frame to the next. This
+// buffer keeps them on the GPU instead, in an entry for each entity slot (see EntityTypes.h): the entity's world bounding
+// sphere and the position of its drawn node matrices (as Mesh::WriteInstanceMatrices writes them for one instance) in a
+// second buffer of matrices. The culling shader reads the instances' data from here given just their slots.
+//
+// A copy of what the GPU holds is kept on the CPU. Writing an entity's matrices and bounds compares them with the copy and
+// queues only those that differ, then Upload sends the queue in one dynamic buffer and a compute shader (cs_scene-scatter)
+// scatters each change to its place. So the data uploaded each frame depends on how many entities moved, not how many are
+// drawn. Entries are written every time an entity is drawn, so a slot reused by a new entity, or one whose level of detail
+// has changed its mesh, is brought up to date before it is used
+//
+//   sceneBuffer.Write(EntityIndex(entity->GetID()), matrices, mesh.InstanceMatrixCount(), entity->GetWorldBoundingSphere());
+//   ... for every entity to be drawn ...
+//   if (sceneBuffer.Upload())  ... bind EntryView() and MatrixView() to read the entries on the GPU ...
+//
+// The buffers grow as needed, copying the old contents on the GPU, so nothing needs to be sent again when they do
+
+#ifndef _SCENE_BUFFER_H_INCLUDED_
+#define _SCENE_BUFFER_H_INCLUDED_
+
+#include "Frustum.h"
+#include "Matrix4x4.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class SceneBuffer
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the scatter compute shader and create its constant buffer. Throws std::runtime_error on failure
+	SceneBuffer();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Bring a slot's entry up to date with the given drawn node matrices and world bounding sphere, queuing whatever differs
+	// from what the GPU holds to be sent by the next Upload
+	void Write(uint32_t slot, const Matrix4x4* matrices, unsigned int numMatrices, const BoundingSphere& bounds);
+
+	// Send the queued changes to the GPU and scatter them into the buffers. Returns false on failure, then everything is sent
+	// again as the entries are next written
+	bool Upload();
+
+	// Raw views of the entries (32 bytes for each slot: the bounding sphere, then the first matrix and number of matrices) and
+	// of the matrices (64 bytes each) for the compute shaders, nullptr until the first Upload. Must match cs_cull-instances.hlsl
+	ID3D11ShaderResourceView* EntryView()   { return mEntryBuffer.srv; }
+	ID3D11ShaderResourceView* MatrixView()  { return mMatrixBuffer.srv; }
+
+	// Statistics for the control panel, totals since the last reset. Entries and matrices are those sent to the GPU
+	struct Stats
+	{
+		uint32_t entries  = 0;
+		uint32_t matrices = 0;
+		uint32_t bytes    = 0;
+	};
+	const Stats& GetStats()    { return mStats; }
+	void         ResetStats()  { mStats = {}; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types
+	-----------------------------------------------------------------------------------------*/
+private:
+	// What the GPU holds for a slot, if valid
+	struct Slot
+	{
+		uint32_t       firstMatrix = 0;
+		uint32_t       numMatrices = 0;
+		BoundingSphere bounds;
+		bool           valid = false;
+	};
+
+	// A change to copy to one of the buffers, must match the Update structure in cs_scene-scatter.hlsl
+	enum class Target : uint32_t { Entries, Matrices };
+	struct GpuUpdate
+	{
+		Target   target;
+		uint32_t firstRow;   // 16-byte row of the target buffer to write at
+		uint32_t numRows;
+		uint32_t padding = 0;
+		uint32_t rows[4][4]; // Copied unchanged
+	};
+
+	// A GPU buffer replaced by a larger one when more space is needed
+	struct GrowableBuffer
+	{
+		CComPtr<ID3D11Buffer>              buffer;
+		CComPtr<ID3D11ShaderResourceView>  srv;
+		CComPtr<ID3D11UnorderedAccessView> uav;
+		unsigned int capacity = 0; // In bytes for the raw buffers, elements for the update buffer
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Position for a slot's matrices, reusing a range freed by a slot with the same number if there is one
+	uint32_t AllocateMatrices(uint32_t count);
+
+	// Queue the given 16-byte rows to be written to a buffer at firstRow
+	void QueueUpdate(Target target, uint32_t firstRow, uint32_t numRows, const void* rows);
+
+	// Make sure a raw buffer holds the given number of bytes, copying its contents to the new buffer on the GPU if it grows.
+	// Returns false on failure
+	bool ReserveRaw(GrowableBuffer& buffer, unsigned int bytes);
+
+	// Forget what the GPU holds so every entry is sent again when next written, after a failure
+	void Invalidate();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Threads in each group of the compute shader, must match numthreads in cs_scene-scatter.hlsl
+	static constexpr unsigned int THREAD_GROUP_SIZE = 64;
+
+	// Buffers start with space for this many entries, matrices and updates, then double in size as needed
+	static constexpr unsigned int INITIAL_CAPACITY = 1024;
+
+	static constexpr unsigned int ENTRY_BYTES  = 32;
+	static constexpr unsigned int MATRIX_BYTES = sizeof(Matrix4x4);
+
+	Stats mStats;
+
+	ID3D11ComputeShader*  mComputeShader;  // Owned by the shader manager
+	ID3D11Buffer*         mConstantBuffer; // Owned by the constant buffer manager
+	SceneScatterConstants mConstants;
+
+	// The CPU's copy of what the GPU holds, the matrices of the slots in their ranges
+	std::vector<Slot>      mSlots;
+	std::vector<Matrix4x4> mMatrices;
+	std::unordered_map<uint32_t, std::vector<uint32_t>> mFreeRanges; // Free ranges of matrices by length
+
+	std::vector<GpuUpdate> mUpdates; // Queued for the next Upload
+
+	GrowableBuffer mEntryBuffer;
+	GrowableBuffer mMatrixBuffer;
+	GrowableBuffer mUpdateBuffer; // Dynamic, rewritten by each Upload
+};
+
+
+#endif //_SCENE_BUFFER_H_INCLUDED_
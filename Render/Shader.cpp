@@ -7,10 +7,36 @@
 // it is destroyed. Practically that means all shaders exist until the app closes, but that is fine as they are small.
 
 #include "Shader.h"
+#include "AssetFiles.h"
+#include "StartupProfile.h"
 
 #include <d3dcompiler.h>
-#include <fstream>
 #include <vector>
+#include <fstream>
+#include <cstring>
+
+
+//--------------------------------------------------------------------------------------
+// Shader pack file layout
+//--------------------------------------------------------------------------------------
+// Header, then for each shader a ShaderPackEntry followed by its name and its bytecode. Everything is little-endian
+
+static const uint32_t SHADER_PACK_MAGIC   = 0x4B415053; // "SPAK"
+static const uint32_t SHADER_PACK_VERSION = 1;
+
+struct ShaderPackHeader
+{
+	uint32_t magic      = SHADER_PACK_MAGIC;
+	uint32_t version    = SHADER_PACK_VERSION;
+	uint32_t numShaders = 0;
+	uint32_t padding    = 0;
+};
+
+struct ShaderPackEntry
+{
+	uint32_t nameLength;
+	uint32_t size; // Of the bytecode
+};
 
 
 //--------------------------------------------------------------------------------------
@@ -25,11 +51,14 @@
 // ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
 ID3D11VertexShader* ShaderManager::LoadVertexShader(std::string shaderName)
 {
+	std::lock_guard<std::mutex> lock(mMutex); // Shaders are small, so they are loaded with the lock held
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mVertexShaders.find(shaderName);
 	if (loadedShader != mVertexShaders.end())  return loadedShader->second;
 	
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -57,12 +86,15 @@ ID3D11VertexShader* ShaderManager::LoadVertexShader(std::string shaderName)
 // ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
 ID3D11HullShader* ShaderManager::LoadHullShader(std::string shaderName)
 {
+	std::lock_guard<std::mutex> lock(mMutex);
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mHullShaders.find(shaderName);
 	if (loadedShader != mHullShaders.end())  return loadedShader->second;
 
 
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -89,12 +121,15 @@ ID3D11HullShader* ShaderManager::LoadHullShader(std::string shaderName)
 // ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
 ID3D11DomainShader* ShaderManager::LoadDomainShader(std::string shaderName)
 {
+	std::lock_guard<std::mutex> lock(mMutex);
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mDomainShaders.find(shaderName);
 	if (loadedShader != mDomainShaders.end())  return loadedShader->second;
 
 
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -121,12 +156,15 @@ ID3D11DomainShader* ShaderManager::LoadDomainShader(std::string shaderName)
 // ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
 ID3D11GeometryShader* ShaderManager::LoadGeometryShader(std::string shaderName)
 {
+	std::lock_guard<std::mutex> lock(mMutex);
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mGeometryShaders.find(shaderName);
 	if (loadedShader != mGeometryShaders.end())  return loadedShader->second;
 
 
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -153,12 +191,15 @@ ID3D11GeometryShader* ShaderManager::LoadGeometryShader(std::string shaderName)
 // ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
 ID3D11PixelShader* ShaderManager::LoadPixelShader(std::string shaderName)
 {
+	std::lock_guard<std::mutex> lock(mMutex);
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mPixelShaders.find(shaderName);
 	if (loadedShader != mPixelShaders.end())  return loadedShader->second;
 
 
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -177,6 +218,41 @@ ID3D11PixelShader* ShaderManager::LoadPixelShader(std::string shaderName)
 	return shader;
 }
 
+// Load shader with given filename. Do not include the extension in the filename
+// Returns a DirectX shader object for use in d3dContext->?SSetShader. Returns nullptr on error
+// Do not release the returned pointer as the ShaderManager object manages the shader object lifetime.
+// If nullptr is returned, you can call GetLastError() for a string description of the error
+// The function reads the compiled .cso file not the .hlsl files. All shader names should be unique
+// ShaderManager stores previously loaded shaders and will return them if a shader is requested for a second time
+ID3D11ComputeShader* ShaderManager::LoadComputeShader(std::string shaderName)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// If this shader has been loaded before, return existing shader object
+	auto loadedShader = mComputeShaders.find(shaderName);
+	if (loadedShader != mComputeShaders.end())  return loadedShader->second;
+
+
+	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
+	std::vector<char> byteCode;
+	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
+
+	// Create compute shader object from loaded file
+	CComPtr<ID3D11ComputeShader> shader;
+	HRESULT hr = mDXDevice->CreateComputeShader(byteCode.data(), byteCode.size(), nullptr, &shader);
+	if (FAILED(hr))
+	{
+		mLastError = "Failure to create compute shader from: " + shaderName + ".cso. Possibly running on low spec machine?";
+		return nullptr;
+	}
+
+
+	// Enter shader object into map of existing shaders, then return to caller.
+	mComputeShaders[shaderName] = shader;
+	return shader;
+}
+
 //--------------------------------------------------------------------------------------
 // Special shaders
 //--------------------------------------------------------------------------------------
@@ -188,11 +264,14 @@ ID3D11PixelShader* ShaderManager::LoadPixelShader(std::string shaderName)
 ID3D11GeometryShader* ShaderManager::LoadStreamOutGeometryShader(std::string shaderName, D3D11_SO_DECLARATION_ENTRY* soDecl,
                                                                  unsigned int soNumEntries, unsigned int soStride)
 {
+	std::lock_guard<std::mutex> lock(mMutex);
+
 	// If this shader has been loaded before, return existing shader object
 	auto loadedShader = mGeometryShaders.find(shaderName);
 	if (loadedShader != mGeometryShaders.end())  return loadedShader->second;
 
 	// Load shader bytecode
+	StartupTimer startupTimer("Shader " + shaderName);
 	std::vector<char> byteCode;
 	if (!LoadShaderByteCode(shaderName, byteCode))  return nullptr;
 
@@ -213,33 +292,166 @@ ID3D11GeometryShader* ShaderManager::LoadStreamOutGeometryShader(std::string sha
 }
 
 
+//--------------------------------------------------------------------------------------
+// Input layout creation
+//--------------------------------------------------------------------------------------
+
+// Hash of every field of some vertex elements, including the text of the semantic names (FNV-1a)
+static uint64_t HashVertexElements(const D3D11_INPUT_ELEMENT_DESC vertexElements[], int numElements)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto add = [&](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+	for (int elt = 0; elt < numElements; ++elt)
+	{
+		for (const char* c = vertexElements[elt].SemanticName; *c != '\0'; ++c)  add(static_cast<unsigned char>(*c));
+		add(vertexElements[elt].SemanticIndex);
+		add(vertexElements[elt].Format);
+		add(vertexElements[elt].InputSlot);
+		add(vertexElements[elt].AlignedByteOffset);
+		add(vertexElements[elt].InputSlotClass);
+		add(vertexElements[elt].InstanceDataStepRate);
+	}
+	return hash;
+}
+
+// Whether two lists of vertex elements are the same, comparing the semantic names by their text
+static bool SameVertexElements(const std::vector<D3D11_INPUT_ELEMENT_DESC>& a, const D3D11_INPUT_ELEMENT_DESC b[], int numElements)
+{
+	if (a.size() != static_cast<size_t>(numElements))  return false;
+	for (int elt = 0; elt < numElements; ++elt)
+	{
+		if (std::strcmp(a[elt].SemanticName, b[elt].SemanticName) != 0 || a[elt].SemanticIndex != b[elt].SemanticIndex ||
+		    a[elt].Format != b[elt].Format || a[elt].InputSlot != b[elt].InputSlot || a[elt].AlignedByteOffset != b[elt].AlignedByteOffset ||
+		    a[elt].InputSlotClass != b[elt].InputSlotClass || a[elt].InstanceDataStepRate != b[elt].InstanceDataStepRate)  return false;
+	}
+	return true;
+}
+
+
+// Input layout for vertices with the given elements, for use in d3dContext->IASetInputLayout. Returns nullptr on error
+// Do not release the returned pointer as the ShaderManager object manages its lifetime.
+// ShaderManager stores previously created layouts and will return the existing one if identical elements are given again
+ID3D11InputLayout* ShaderManager::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC vertexElements[], int numElements)
+{
+	std::lock_guard<std::mutex> lock(mMutex); // Layouts are created rarely, so with the lock held as for shaders
+
+	// If a layout has been created for these elements before, return existing layout object
+	auto& entries = mInputLayouts[HashVertexElements(vertexElements, numElements)];
+	for (auto& entry : entries)
+	{
+		if (SameVertexElements(entry.vertexElements, vertexElements, numElements))  return entry.layout;
+	}
+
+	// Create the layout against a signature compiled to match the elements
+	InputLayoutEntry entry;
+	auto shaderSignature = CreateSignatureForVertexLayout(vertexElements, numElements);
+	if (shaderSignature == nullptr)
+	{
+		mLastError = "Failure to create shader signature for input layout";
+		return nullptr;
+	}
+	HRESULT hr = mDXDevice->CreateInputLayout(vertexElements, numElements, shaderSignature->GetBufferPointer(),
+	                                          shaderSignature->GetBufferSize(), &entry.layout);
+	shaderSignature->Release();
+	if (FAILED(hr))
+	{
+		mLastError = "Failure to create input layout";
+		return nullptr;
+	}
+
+	// The stored elements point to copies of the semantic names, the caller's may not last
+	entry.vertexElements.assign(vertexElements, vertexElements + numElements);
+	for (int elt = 0; elt < numElements; ++elt)  entry.semanticNames.push_back(vertexElements[elt].SemanticName);
+	for (int elt = 0; elt < numElements; ++elt)  entry.vertexElements[elt].SemanticName = entry.semanticNames[elt].c_str();
+	entries.push_back(std::move(entry));
+
+	return entries.back().layout;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shader pack
+//--------------------------------------------------------------------------------------
+
+// Read the given shader pack in a single read, the LoadXXShader functions then take shaders from it. Returns false if the pack
+// doesn't exist or is damaged
+bool ShaderManager::LoadShaderPack(const std::filesystem::path& packFile)
+{
+	StartupTimer startupTimer("Shader pack");
+	AssetData pack = gAssetFiles.Read(packFile);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (pack.empty())
+	{
+		mLastError = "Failure to open shader pack: " + packFile.string();
+		return false;
+	}
+
+	// Index every shader before using any, so a damaged pack is not used at all
+	std::unordered_map<std::string, std::pair<size_t, size_t>> packedShaders;
+	ShaderPackHeader header;
+	bool valid = pack.size() >= sizeof(header);
+	if (valid)
+	{
+		std::memcpy(&header, pack.data(), sizeof(header));
+		valid = header.magic == SHADER_PACK_MAGIC && header.version == SHADER_PACK_VERSION;
+	}
+	size_t position = sizeof(header);
+	for (uint32_t i = 0; i < header.numShaders && valid; ++i)
+	{
+		ShaderPackEntry entry;
+		valid = pack.size() - position >= sizeof(entry);
+		if (!valid)  break;
+		std::memcpy(&entry, pack.data() + position, sizeof(entry));
+		position += sizeof(entry);
+
+		valid = pack.size() - position >= static_cast<size_t>(entry.nameLength) + entry.size;
+		if (!valid)  break;
+		std::string name(reinterpret_cast<const char*>(pack.data() + position), entry.nameLength);
+		position += entry.nameLength;
+		packedShaders[name] = { position, entry.size };
+		position += entry.size;
+	}
+	if (!valid)
+	{
+		mLastError = "Shader pack is damaged: " + packFile.string();
+		return false;
+	}
+
+	mShaderPack    = std::move(pack);
+	mPackedShaders = std::move(packedShaders);
+	return true;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Helper functions
 //--------------------------------------------------------------------------------------
 
-// Load the cso (compiled shader object) file of the given shader (any type) and put the bytecode in the
-// given vector. Used by all the shader loading functions above. Returns true on success
+// Load the cso (compiled shader object) file of the given shader (any type), or its copy in the shader pack, and put the
+// bytecode in the given vector. Used by all the shader loading functions above. Returns true on success
 bool ShaderManager::LoadShaderByteCode(std::string shaderName, std::vector<char>& byteCode)
 {
-	// Open compiled shader object file
-	std::ifstream shaderFile(shaderName + ".cso", std::ios::in | std::ios::binary | std::ios::ate);
-	if (!shaderFile.is_open())
+	// Shaders in the pack are already in memory
+	auto packed = mPackedShaders.find(shaderName);
+	if (packed != mPackedShaders.end())
 	{
-		mLastError = "Failure to open file: " + shaderName + ".cso. Ensure the file exists in the working folder (typically with the exectable).";
-		return false;
+		const char* start = reinterpret_cast<const char*>(mShaderPack.data()) + packed->second.first;
+		byteCode.assign(start, start + packed->second.second);
+		return true;
 	}
 
-	// Read file into vector of chars
-	std::streamoff fileSize = shaderFile.tellg();
-	shaderFile.seekg(0, std::ios::beg);
-	byteCode.resize(fileSize);
-	shaderFile.read(&byteCode[0], fileSize);
-	if (shaderFile.fail())
+	// Otherwise read compiled shader object file, from the asset archive if it is in one
+	AssetData shaderFile = gAssetFiles.Read(shaderName + ".cso");
+	if (shaderFile.empty())
 	{
-		mLastError = "File read error in file: " + shaderName + ".cso. Possible corrupt file or disk space problem.";
+		mLastError = "Failure to open file: " + shaderName + ".cso. Ensure the file exists in the working folder (typically with the exectable).";
 		return false;
 	}
 
+	// Copy into vector of chars
+	byteCode.assign(reinterpret_cast<const char*>(shaderFile.data()), reinterpret_cast<const char*>(shaderFile.data()) + shaderFile.size());
+
 	return true;
 }
 
@@ -265,6 +477,9 @@ ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLa
 		else if (format == DXGI_FORMAT_R32_FLOAT)          shaderSource += "float";
 		else if (format == DXGI_FORMAT_R8G8B8A8_UINT)      shaderSource += "uint4";
 		else if (format == DXGI_FORMAT_R8G8B8A8_UNORM)     shaderSource += "float4"; // 4-byte colour in data mapped to 4 (0-1) floats in the shader (UNORM indicates this mapping)
+		else if (format == DXGI_FORMAT_R16G16B16A16_UNORM) shaderSource += "float4"; // Compressed vertex formats (see ImportFlags::CompressVertices), also converted to floats
+		else if (format == DXGI_FORMAT_R16G16_SNORM)       shaderSource += "float2";
+		else if (format == DXGI_FORMAT_R16G16_FLOAT)       shaderSource += "float2";
 		else return nullptr; // Unsupported type in layout
 
 		uint8_t index = static_cast<uint8_t>(vertexLayout[elt].SemanticIndex);
@@ -289,3 +504,56 @@ ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLa
 
 	return compiledShader;
 }
+
+
+// Write a shader pack holding every compiled shader (.cso file) in the given folder, replacing any existing pack. Returns false
+// on failure with a description in error. Shaders are read from disk, not from mounted archives
+bool BuildShaderPack(const std::filesystem::path& packFile, const std::filesystem::path& shaderFolder, std::string& error)
+{
+	// Written to a temporary file that replaces the pack when complete, so a failure never leaves a damaged pack
+	auto tempFile = packFile;
+	tempFile += ".tmp";
+	std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		error = "Failure to create shader pack: " + packFile.string();
+		return false;
+	}
+
+	ShaderPackHeader header;
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header)); // Rewritten with the number of shaders at the end
+
+	std::error_code fileError;
+	for (auto& entry : std::filesystem::directory_iterator(shaderFolder, fileError))
+	{
+		auto& path = entry.path();
+		if (!entry.is_regular_file() || path.extension() != ".cso")  continue;
+
+		std::ifstream shaderFile(path, std::ios::binary);
+		if (!shaderFile)
+		{
+			error = "Failure to read shader for shader pack: " + path.string();
+			return false;
+		}
+		std::vector<char> byteCode((std::istreambuf_iterator<char>(shaderFile)), std::istreambuf_iterator<char>());
+
+		auto name = path.stem().string();
+		ShaderPackEntry packEntry = { static_cast<uint32_t>(name.size()), static_cast<uint32_t>(byteCode.size()) };
+		stream.write(reinterpret_cast<const char*>(&packEntry), sizeof(packEntry));
+		stream.write(name.data(), static_cast<std::streamsize>(name.size()));
+		stream.write(byteCode.data(), static_cast<std::streamsize>(byteCode.size()));
+		++header.numShaders;
+	}
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.close();
+
+	if (!stream.fail() && !fileError)  std::filesystem::rename(tempFile, packFile, fileError);
+	if (stream.fail() || fileError)
+	{
+		std::filesystem::remove(tempFile, fileError);
+		error = "Failure to write shader pack: " + packFile.string();
+		return false;
+	}
+	return true;
+}
@@ -5,17 +5,35 @@
 // loaded that shader the existing pointer is returned, otherwise the shader is loaded. The calling code is not responsible 
 // for the lifetime of the shader and does not need to release it ever. The ShaderManager will release all shaders when
 // it is destroyed. Practically that means all shaders exist until the app closes but that is fine as they are small.
+//
+// Input layouts are shared the same way (see CreateInputLayout). Many sub-meshes have the same vertex elements, they all get the
+// same layout object, so binding a layout can be skipped whenever the one set is the same pointer
+//
+// Shaders can also come from a shader pack, a single file holding the compiled bytecode of every shader, read in one go rather
+// than a .cso file at a time. The pack is built by BuildShaderPack (see PackAssets in Main.cpp) and loaded before any shaders:
+//
+//   DX->Shaders()->LoadShaderPack(SHADER_PACK_FILE);  // Shaders not in it are still loaded from their .cso files
 
 #ifndef _SHADER_H_INCLUDED_
 #define _SHADER_H_INCLUDED_
 
+#include "AssetFiles.h" // For AssetData (see member variables)
+
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
 #include <atlbase.h> // For CComPtr (see member variables)
 
+#include <filesystem>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <stdint.h>
+
+
+// The shader pack built by PackAssets into the asset archive, loaded by DXDevice if it is there
+static const char* const SHADER_PACK_FILE = "Shaders.pack";
 
 
 class ShaderManager
@@ -43,6 +61,7 @@ public:
 	ID3D11DomainShader*   LoadDomainShader  (std::string shaderName);
 	ID3D11GeometryShader* LoadGeometryShader(std::string shaderName);
 	ID3D11PixelShader*    LoadPixelShader   (std::string shaderName);
+	ID3D11ComputeShader*  LoadComputeShader (std::string shaderName);
 
 	// Special method to load a geometry shader that can use the stream-out stage, Use like other shader loading functions 
 	// except also pass the stream out declaration, number of entries in the declaration and total size of the output data
@@ -51,17 +70,36 @@ public:
 	ID3D11GeometryShader* LoadStreamOutGeometryShader(std::string shaderName, D3D11_SO_DECLARATION_ENTRY* soDecl,
 	                                                  unsigned int soNumEntries, unsigned int soStride);
 
+	// Input layout for vertices with the given elements, for use in d3dContext->IASetInputLayout. Returns nullptr on error
+	// Do not release the returned pointer as the ShaderManager object manages its lifetime. The layout is created for a shader
+	// signature matching the elements (see CreateSignatureForVertexLayout), so it suits any vertex shader reading those elements.
+	// ShaderManager stores previously created layouts and will return the existing one if identical elements are given again
+	ID3D11InputLayout* CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC vertexElements[], int numElements);
+
 	// If LoadXXShader functions return nullptr to indicate an error, the text description
 	// of the (most recent) error can be fetched with this function
-	std::string GetLastError()  { return mLastError; }
+	std::string GetLastError()  { std::lock_guard<std::mutex> lock(mMutex);  return mLastError; }
+
+
+	//--------------------------------------------------------------------------------------
+	// Shader pack
+	//--------------------------------------------------------------------------------------
+public:
+	// Read the given shader pack (see BuildShaderPack) in a single read. Afterwards the LoadXXShader functions take shaders from
+	// the pack rather than from their .cso files, shaders not in it are still loaded from their files. Returns false if the pack
+	// doesn't exist or is damaged, then call GetLastError() - shaders are loaded from their files as before
+	bool LoadShaderPack(const std::filesystem::path& packFile);
+
+	// Number of shaders in the loaded shader pack, 0 if there is none
+	size_t PackedShaderCount()  { std::lock_guard<std::mutex> lock(mMutex);  return mPackedShaders.size(); }
 
 
 	//--------------------------------------------------------------------------------------
 	// Helper functions
 	//--------------------------------------------------------------------------------------
 private:
-	// Load the cso (compiled shader object) file of the given shader (any type) and put the bytecode in the
-	// given vector. Used by all the shader loading functions above. Returns true on success
+	// Load the cso (compiled shader object) file of the given shader (any type), or its copy in the shader pack, and put the
+	// bytecode in the given vector. Used by all the shader loading functions above. Returns true on success
 	bool LoadShaderByteCode(std::string shaderName, std::vector<char>& byteCode);
 
 
@@ -83,9 +121,27 @@ private:
 	std::map<std::string, CComPtr<ID3D11DomainShader  >> mDomainShaders;
 	std::map<std::string, CComPtr<ID3D11GeometryShader>> mGeometryShaders;
 	std::map<std::string, CComPtr<ID3D11PixelShader   >> mPixelShaders;
+	std::map<std::string, CComPtr<ID3D11ComputeShader >> mComputeShaders;
+
+	// Input layouts by a hash of their vertex elements, with copies of the elements (and the semantic names they point to) to
+	// tell apart different elements with the same hash
+	struct InputLayoutEntry
+	{
+		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+		std::vector<std::string>              semanticNames;
+		CComPtr<ID3D11InputLayout>            layout;
+	};
+	std::unordered_map<uint64_t, std::vector<InputLayoutEntry>> mInputLayouts;
+
+	// Contents of the loaded shader pack, and the position and size of each shader's bytecode in it by shader name
+	AssetData                                                  mShaderPack;
+	std::unordered_map<std::string, std::pair<size_t, size_t>> mPackedShaders;
 
 	// Description of the most recent error from the LoadXXShader functions
 	std::string mLastError;
+
+	// Guards the maps and error above, so shaders and layouts can be created on several threads (see ParseLevel)
+	std::mutex mMutex;
 };
 
 
@@ -98,5 +154,10 @@ private:
 // Advanced topic: see detailed comment in cpp file.
 ID3DBlob* CreateSignatureForVertexLayout(const D3D11_INPUT_ELEMENT_DESC vertexLayout[], int numElements);
 
+// Write a shader pack holding every compiled shader (.cso file) in the given folder, replacing any existing pack. Each shader is
+// named by its file name without the extension, as passed to the LoadXXShader functions. Returns false if a shader can't be
+// read or the pack can't be written, with a description in error
+bool BuildShaderPack(const std::filesystem::path& packFile, const std::filesystem::path& shaderFolder, std::string& error);
+
 
 #endif //_SHADER_H_INCLUDED_
@@ -0,0 +1,131 @@
+//--------------------------------------------------------------------------------------
+// Shader pre-warming - a tiny offscreen draw for each combination of shaders, input layout and states a level uses
+//--------------------------------------------------------------------------------------
+
+#include "ShaderPrewarm.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Mesh.h"
+#include "Matrix4x4.h"
+
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the render target, depth buffer and instance buffer. Throws std::runtime_error on failure
+ShaderPrewarm::ShaderPrewarm()
+{
+	// Drivers can compile shaders differently for different target formats, so these match the scene's targets
+	D3D11_RENDER_TARGET_VIEW_DESC sceneTargetDesc;
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthBufferDesc;
+	DX->SceneTarget()->GetDesc(&sceneTargetDesc);
+	DX->DepthBuffer()->GetDesc(&depthBufferDesc);
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width     = TARGET_SIZE;
+	textureDesc.Height    = TARGET_SIZE;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format    = sceneTargetDesc.Format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage     = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &mTargetTexture)) ||
+	    FAILED(DX->Device()->CreateRenderTargetView(mTargetTexture, nullptr, &mRenderTarget)))
+	{
+		throw std::runtime_error("Shader pre-warming: failure creating render target");
+	}
+
+	textureDesc.Format    = depthBufferDesc.Format;
+	textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+	dsvDesc.Format        = depthBufferDesc.Format;
+	dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &mDepthTexture)) ||
+	    FAILED(DX->Device()->CreateDepthStencilView(mDepthTexture, &dsvDesc, &mDepthBuffer)))
+	{
+		throw std::runtime_error("Shader pre-warming: failure creating depth buffer");
+	}
+
+	Matrix4x4 zeroMatrix = {};
+	D3D11_BUFFER_DESC bufferDesc = {};
+	bufferDesc.ByteWidth = sizeof(Matrix4x4);
+	bufferDesc.Usage     = D3D11_USAGE_IMMUTABLE;
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	D3D11_SUBRESOURCE_DATA initData = { &zeroMatrix, 0, 0 };
+	if (FAILED(DX->Device()->CreateBuffer(&bufferDesc, &initData, &mInstanceBuffer)))
+		throw std::runtime_error("Shader pre-warming: failure creating instance buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Set the tiny render target and depth buffer and their viewport, remembering the ones set now
+void ShaderPrewarm::Begin()
+{
+	auto context = DX->Context();
+	mPreviousRenderTarget = {};
+	mPreviousDepthBuffer  = {};
+	context->OMGetRenderTargets(1, &mPreviousRenderTarget, &mPreviousDepthBuffer);
+	UINT numViewports = 1;
+	context->RSGetViewports(&numViewports, &mPreviousViewport);
+
+	D3D11_VIEWPORT viewport = { 0, 0, static_cast<FLOAT>(TARGET_SIZE), static_cast<FLOAT>(TARGET_SIZE), 0, 1 };
+	context->RSSetViewports(1, &viewport);
+	context->ClearDepthStencilView(mDepthBuffer, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+	UINT stride = sizeof(Matrix4x4);
+	UINT offset = 0;
+	context->IASetVertexBuffers(1, 1, &mInstanceBuffer.p, &stride, &offset);
+}
+
+
+// Draw each combination of the mesh's render states and layouts not yet drawn with the pass's states
+void ShaderPrewarm::Warm(Mesh& mesh, const Pass& pass)
+{
+	mPassStates = static_cast<uint32_t>(pass.rasterizer) | static_cast<uint32_t>(pass.depth) << 8 |
+	              static_cast<uint32_t>(pass.blend) << 16 | static_cast<uint32_t>(pass.depthOnly) << 24;
+
+	// Set every time, setting a state that is already set does nothing (see StateManager)
+	DX->States()->SetRasterizerState(pass.rasterizer);
+	DX->States()->SetDepthState(pass.depth);
+	DX->States()->SetBlendState(pass.blend);
+	DX->Context()->OMSetRenderTargets(pass.depthOnly ? 0 : 1, pass.depthOnly ? nullptr : &mRenderTarget.p, mDepthBuffer);
+
+	RenderState::SetDepthOnly(pass.depthOnly);
+	mesh.Prewarm(*this);
+	RenderState::SetDepthOnly(false);
+}
+
+
+// Put back the render targets and viewport set at Begin, with the default states
+void ShaderPrewarm::End()
+{
+	auto context = DX->Context();
+	ID3D11Buffer* nullBuffer = nullptr;
+	UINT zero = 0;
+	context->IASetVertexBuffers(1, 1, &nullBuffer, &zero, &zero);
+
+	context->OMSetRenderTargets(mPreviousRenderTarget != nullptr ? 1 : 0, &mPreviousRenderTarget.p, mPreviousDepthBuffer);
+	context->RSSetViewports(1, &mPreviousViewport);
+	mPreviousRenderTarget = {};
+	mPreviousDepthBuffer  = {};
+
+	DX->States()->SetRasterizerState(RasterizerState::CullBack);
+	DX->States()->SetDepthState(DepthState::DepthOn);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+}
+
+
+// Returns true, and records the combination, if the shaders and layout haven't been drawn with the current pass's states
+bool ShaderPrewarm::FirstUse(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* layout)
+{
+	if (vertexShader == nullptr || layout == nullptr)  return false;
+	return mWarmed.emplace(vertexShader, pixelShader, layout, mPassStates).second;
+}
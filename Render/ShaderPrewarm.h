@@ -0,0 +1,101 @@
+//--------------------------------------------------------------------------------------
+// Shader pre-warming - a tiny offscreen draw for each combination of shaders, input layout and states a level uses
+//--------------------------------------------------------------------------------------
+// Creating a shader object doesn't finish compiling it, drivers do the last step (for the input layout, render target formats
+// and pipeline states it is used with) the first time it is drawn with. Without pre-warming that happens in the middle of the
+// frame a new material first appears in, e.g. the first crate or shield, and shows as a hitch. Here each mesh's sub-meshes are
+// drawn once, at every shader level of detail, instanced and not, into a 4x4 render target and depth buffer with the formats of
+// the scene's, with the states of each pass that will draw them. Only a few indices are drawn, nothing needs to be seen:
+//
+//   shaderPrewarm.Begin();                          // Sets the tiny targets, keeping the current ones
+//   shaderPrewarm.Warm(mesh, { RasterizerState::CullBack, DepthState::DepthOn, BlendState::BlendNone });
+//   shaderPrewarm.End();                            // Puts back the targets and the default states
+//
+// Each combination is only drawn once for as long as this object exists, so meshes can be warmed again whenever new ones load
+// and only the combinations not seen before are drawn
+
+#ifndef _SHADER_PREWARM_H_INCLUDED_
+#define _SHADER_PREWARM_H_INCLUDED_
+
+#include "State.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <set>
+#include <tuple>
+#include <stdint.h>
+
+class Mesh;
+
+
+class ShaderPrewarm
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the render target and depth buffer, with the formats of the scene target and depth buffer (see DXDevice), and the
+	// instance buffer for instanced draws. Throws std::runtime_error on failure
+	ShaderPrewarm();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The states a pass draws with. Depth-only passes have no render target and draw with the depth-only shaders of each render
+	// state (see RenderState::SetDepthOnly)
+	struct Pass
+	{
+		RasterizerState rasterizer;
+		DepthState      depth;
+		BlendState      blend;
+		bool            depthOnly = false;
+	};
+
+	// Set the tiny render target and depth buffer and their viewport, remembering the ones set now
+	void Begin();
+
+	// Draw each combination of the mesh's render states and layouts not yet drawn with the pass's states. Between Begin and End
+	void Warm(Mesh& mesh, const Pass& pass);
+
+	// Put back the render targets and viewport set at Begin, with the default states (CullBack, DepthOn, BlendNone)
+	void End();
+
+	// Called by Mesh::Prewarm for each draw it could make. Returns true, and records the combination, if the shaders and input
+	// layout haven't been drawn with the current pass's states before
+	bool FirstUse(ID3D11VertexShader* vertexShader, ID3D11PixelShader* pixelShader, ID3D11InputLayout* layout);
+
+	// Combinations drawn since this object was created
+	uint32_t CombinationCount()  { return static_cast<uint32_t>(mWarmed.size()); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Pixels across and down the render target
+	static constexpr unsigned int TARGET_SIZE = 4;
+
+	CComPtr<ID3D11Texture2D>        mTargetTexture;
+	CComPtr<ID3D11RenderTargetView> mRenderTarget;
+	CComPtr<ID3D11Texture2D>        mDepthTexture;
+	CComPtr<ID3D11DepthStencilView> mDepthBuffer;
+
+	// One zero world matrix on vertex buffer slot 1 for the instanced vertex shaders
+	CComPtr<ID3D11Buffer> mInstanceBuffer;
+
+	// Targets and viewport set at Begin
+	CComPtr<ID3D11RenderTargetView> mPreviousRenderTarget;
+	CComPtr<ID3D11DepthStencilView> mPreviousDepthBuffer;
+	D3D11_VIEWPORT                  mPreviousViewport = {};
+
+	// Each combination drawn, with the states of its pass packed in a byte each (see Warm)
+	std::set<std::tuple<ID3D11VertexShader*, ID3D11PixelShader*, ID3D11InputLayout*, uint32_t>> mWarmed;
+	uint32_t mPassStates = 0;
+};
+
+
+#endif //_SHADER_PREWARM_H_INCLUDED_
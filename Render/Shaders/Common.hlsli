@@ -58,16 +58,34 @@ cbuffer PerCameraConstants : register(b1) // The b1 gives this constant buffer t
     float    padding4;
 }
 
-static const int MAX_BONES = 64;
-
-
 // The constants (settings) that need to change for each mesh rendered, e.g. transformation matrices (see C++ PerMeshConstants declaration for contents)
 // These variables must match exactly the PerMeshConstants structure in the C++ code
 cbuffer PerMeshConstants : register(b2) // The b1 gives this constant buffer the number 1 - used in the C++ code
 {
     float4x4 gWorldMatrix;
     float4   gMeshColour;  // Per-mesh colour, typically used to tint it (e.g. tinting light meshes to the colour of the light they emit)
-	float4x4 gBoneMatrices[MAX_BONES];
+}
+
+
+// Where a skinned mesh's bones are in the bone palette (see C++ SkinningConstants declaration). Only bound to the vertex shader when
+// rendering a skinned mesh
+cbuffer SkinningConstants : register(b4)
+{
+    uint  gBoneOffset;
+    uint  gBonesPerInstance;
+    uint2 padding6;
+}
+
+// The bone matrices of every skinned mesh drawn this frame (see C++ BonePalette class), as the first three columns of each matrix
+StructuredBuffer<float4x3> gBonePalette : register(t9);
+
+// The blend of the bone matrices influencing a skinned vertex, for the given instance (SV_InstanceID, 0 if not instanced). Transform
+// with mul(float4(position, 1), matrix)
+float4x3 SkinningMatrix(uint4 bones, float4 weights, uint instance)
+{
+    uint first = gBoneOffset + instance * gBonesPerInstance;
+    return gBonePalette[first + bones.x] * weights.x + gBonePalette[first + bones.y] * weights.y +
+           gBonePalette[first + bones.z] * weights.z + gBonePalette[first + bones.w] * weights.w;
 }
 
 
@@ -79,6 +97,36 @@ cbuffer PerMaterialConstants : register(b3)
     float3  gMaterialSpecularColour;
     float   gMaterialSpecularPower;
     float   gParallaxDepth;
+    uint    gMaterialSlice; // Slice of the texture arrays holding the material's textures, for the "_arr" pixel shaders
+    float2  padding5;
+
+    float3  gPositionScale;  // Restores 16-bit vertex positions to model space (see ImportFlags::CompressPositions in the C++ code),
+    float   padding6;
+    float3  gPositionOffset; // position = stored position * scale + offset. Scale 1 and offset 0 for uncompressed positions
+    float   padding7;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Helper Functions
+//--------------------------------------------------------------------------------------
+
+// Decode a unit vector stored as a point on an octahedron unfolded onto a square (see OctahedralEncode in the C++ Mesh.cpp).
+// Points in the outer triangles of the square belong to the lower half of the octahedron, so they are folded back down
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 v = float3(encoded.x, encoded.y, 1 - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-v.z);
+    v.xy += (v.xy >= 0) ? -fold : fold;
+    return normalize(v);
+}
+
+// Tangent space normal from a normal map sample. Only x and y are used and z is rebuilt from them, so the same code works for
+// normal maps with all three channels and for two channel BC5 maps (see TextureCache.h in the C++ code)
+float3 DecodeNormalMap(float4 mapSample)
+{
+    float2 xy = mapSample.xy * 2.0f - 1.0f;
+    return normalize(float3(xy, sqrt(saturate(1.0f - dot(xy, xy)))));
 }
 
 #endif // _COMMON_HLSLI_DEFINED_
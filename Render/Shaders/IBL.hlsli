@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// Image-based lighting for the PBR pixel shaders (see EnvironmentLighting.h in the C++ code)
+//--------------------------------------------------------------------------------------
+// The environment is prefiltered at load, so each term of the lighting is a single lookup: the irradiance map for diffuse
+// light, and for specular light the prefiltered map at the mip-map for the roughness, scaled by the split-sum BRDF lookup table.
+// The maps are set for all render states by RenderState::SetEnvironmentMap. Include after Common.hlsli
+
+
+// Mip-maps of the prefiltered specular map, roughness 0 at the top and 1 at the bottom. Must match EnvironmentLighting
+#define IBL_SPECULAR_MIPS 7
+
+
+TextureCube  SpecularIBLMap   : register(t8);  // Environment prefiltered with the GGX distribution, a roughness for each mip-map
+TextureCube  IrradianceIBLMap : register(t13); // Diffuse light arriving at a surface facing each direction
+Texture2D    BRDFLookup       : register(t14); // Scale and bias of the specular colour, by nDotV (u) and roughness (v)
+SamplerState IBLSampler       : register(s8);  // Bilinear, clamped
+
+
+// Diffuse environment light for a surface normal
+float3 DiffuseIBL(float3 n)
+{
+    float3 diffuseIBL = IrradianceIBLMap.SampleLevel(IBLSampler, n, 0).rgb;
+    return (diffuseIBL - 0.5f) * 0.333f + 0.2f; // Adjust contrast of environment map
+}
+
+// Specular environment light reflected along r by a surface of the given roughness and specular colour, nDotV as in the BRDF
+float3 SpecularIBL(float3 r, float nDotV, float3 specularColour, float roughness)
+{
+    float3 prefiltered = SpecularIBLMap.SampleLevel(IBLSampler, r, roughness * (IBL_SPECULAR_MIPS - 1)).rgb;
+    float2 brdf = BRDFLookup.SampleLevel(IBLSampler, float2(nDotV, roughness), 0).rg;
+    return prefiltered * (specularColour * brdf.x + brdf.y);
+}
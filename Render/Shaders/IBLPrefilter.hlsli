@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Constants and sampling functions shared by the image-based lighting compute shaders (see EnvironmentLighting.h)
+//--------------------------------------------------------------------------------------
+
+
+// Threads along each side of a group's square of texels, must match EnvironmentLighting
+#define IBL_THREAD_GROUP_SIZE 8
+
+static const float PI = 3.14159265f;
+
+
+// Must match IBLConstants in the C++ code
+cbuffer IBLConstants : register(b0)
+{
+    float gRoughness;  // Of the mip-map being prefiltered
+    uint  gOutputSize; // Texels along each side of the output (face)
+    float gSourceSize; // Texels along each side of the top mip-map of the source cube map faces
+    uint  gNumSamples;
+}
+
+
+// World direction through the centre of a texel of a cube map face (D3D face order +X -X +Y -Y +Z -Z), from a thread ID of
+// x, y and face
+float3 CubeDirection(uint3 id, uint size)
+{
+    float2 uv = (id.xy + 0.5f) / size * 2 - 1;
+    float3 direction;
+    switch (id.z)
+    {
+        case 0:  direction = float3( 1,    -uv.y, -uv.x); break;
+        case 1:  direction = float3(-1,    -uv.y,  uv.x); break;
+        case 2:  direction = float3( uv.x,  1,     uv.y); break;
+        case 3:  direction = float3( uv.x, -1,    -uv.y); break;
+        case 4:  direction = float3( uv.x, -uv.y,  1   ); break;
+        default: direction = float3(-uv.x, -uv.y, -1   ); break;
+    }
+    return normalize(direction);
+}
+
+// The i-th of n points of the Hammersley sequence, spread evenly over the unit square
+float2 Hammersley(uint i, uint n)
+{
+    return float2(float(i) / n, reversebits(i) * 2.3283064365386963e-10f);
+}
+
+// Turn a direction about +Z into the same direction about the given normal
+float3 TangentToWorld(float3 direction, float3 n)
+{
+    float3 up = abs(n.z) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
+    float3 tangent   = normalize(cross(up, n));
+    float3 bitangent = cross(n, tangent);
+    return tangent * direction.x + bitangent * direction.y + n * direction.z;
+}
+
+// A halfway normal about n picked with the probability of the GGX distribution for the given alpha (roughness squared)
+float3 ImportanceSampleGGX(float2 xi, float alpha, float3 n)
+{
+    float phi = 2 * PI * xi.x;
+    float cosTheta = sqrt((1 - xi.y) / (1 + (alpha * alpha - 1) * xi.y));
+    float sinTheta = sqrt(1 - cosTheta * cosTheta);
+    return TangentToWorld(float3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta), n);
+}
+
+// Mip-map of the source to sample for a sample direction picked with the given probability density, so each sample covers its
+// share of the sphere and a few samples give a smooth result (filtered importance sampling)
+float SourceMip(float pdf)
+{
+    float sampleSolidAngle = 1 / (gNumSamples * pdf + 1e-4f);
+    float texelSolidAngle  = 4 * PI / (6 * gSourceSize * gSourceSize);
+    return max(0.5f * log2(sampleSolidAngle / texelSolidAngle) + 1, 0);
+}
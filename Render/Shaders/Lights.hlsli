@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------------------
+// Clustered point lights for the Blinn and PBR pixel shaders (see ClusteredLights.h in the C++ code)
+//--------------------------------------------------------------------------------------
+// Include after Common.hlsli. The lights of the pixel's cluster are added to the main light of the per-frame constants:
+//   uint2 cluster = LightCluster(input.clipPosition, input.worldPosition);
+//   for (uint i = 0; i < cluster.y; ++i)  ... ClusterLight(cluster, i) ...
+// or just call one of the lighting helpers at the end of this file
+
+
+// Clusters across, down and into the view, must match the values in ClusteredLights
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+
+
+// Finding a pixel's cluster, must match LightClusterConstants in the C++ code
+cbuffer LightClusterConstants : register(b6)
+{
+    float2 gClusterOrigin;     // Top-left of the viewport, in pixels
+    float2 gClusterTileScale;  // Clusters per pixel
+    float  gClusterSliceScale; // Depth slice is log(view depth) * gClusterSliceScale + gClusterSliceBias
+    float  gClusterSliceBias;
+    uint   gNumClusterLights;
+    float  padding14;
+}
+
+// Must match the GpuLight structure in ClusteredLights in the C++ code
+struct PointLight
+{
+    float3 position;
+    float  radius;
+    float3 colour;
+    float  padding;
+};
+
+// The lights, each cluster's start in the light indices and number of lights, and the indices. When the C++ code has bound
+// nothing here every cluster reads as empty
+StructuredBuffer<PointLight> gPointLights  : register(t10);
+StructuredBuffer<uint2>      gLightClusters : register(t11);
+StructuredBuffer<uint>       gLightIndices  : register(t12);
+
+
+// Start and number of the lights in the cluster of a pixel, given its SV_Position and world position
+uint2 LightCluster(float4 pixelPosition, float3 worldPosition)
+{
+    float viewDepth = mul(gViewMatrix, float4(worldPosition, 1)).z;
+    uint2 tile  = min((uint2)max((pixelPosition.xy - gClusterOrigin) * gClusterTileScale, 0), uint2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+    uint  slice = (uint)clamp(log(max(viewDepth, 1e-4f)) * gClusterSliceScale + gClusterSliceBias, 0, LIGHT_CLUSTERS_Z - 1);
+    return gLightClusters[(slice * LIGHT_CLUSTERS_Y + tile.y) * LIGHT_CLUSTERS_X + tile.x];
+}
+
+// The i-th light of a cluster
+PointLight ClusterLight(uint2 cluster, uint i)
+{
+    return gPointLights[gLightIndices[cluster.x + i]];
+}
+
+// A light's colour reaching a world position, and the normal from there to the light. The colour is the light's brightness
+// close to it, falling smoothly to nothing at its radius (unlike the main light, which has no radius)
+float3 PointLightColour(PointLight light, float3 worldPosition, out float3 lightNormal)
+{
+    float3 lightVector = light.position - worldPosition;
+    float  distance2   = dot(lightVector, lightVector);
+    lightNormal = lightVector * rsqrt(max(distance2, 1e-6f));
+    float falloff = saturate(1 - distance2 / (light.radius * light.radius));
+    return light.colour * falloff * falloff;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Lighting helpers
+//--------------------------------------------------------------------------------------
+
+// Add the Blinn-Phong diffuse and specular light of the pixel's cluster, as the shaders calculate them for the main light
+void AddClusterLightsBlinn(float4 pixelPosition, float3 worldPosition, float3 worldNormal, float3 cameraNormal, float specularPower,
+                           inout float3 diffuseColour, inout float3 specularColour)
+{
+    uint2 cluster = LightCluster(pixelPosition, worldPosition);
+    for (uint i = 0; i < cluster.y; ++i)
+    {
+        float3 lightNormal;
+        float3 lightColour   = PointLightColour(ClusterLight(cluster, i), worldPosition, lightNormal);
+        float3 lightDiffuse  = lightColour * saturate(dot(worldNormal, lightNormal));
+        float3 halfwayNormal = normalize(cameraNormal + lightNormal);
+        diffuseColour  += lightDiffuse;
+        specularColour += lightDiffuse * pow(saturate(dot(worldNormal, halfwayNormal)), specularPower);
+    }
+}
+
+// The Lambert diffuse light of the pixel's cluster (nDotL * light colour, summed), for the albedo-only PBR shaders
+float3 ClusterLightsLambert(float4 pixelPosition, float3 worldPosition, float3 n)
+{
+    float3 light = 0;
+    uint2 cluster = LightCluster(pixelPosition, worldPosition);
+    for (uint i = 0; i < cluster.y; ++i)
+    {
+        float3 l;
+        float3 lc = PointLightColour(ClusterLight(cluster, i), worldPosition, l);
+        light += max(dot(n, l), 0.001f) * lc;
+    }
+    return light;
+}
+
+// The PBR light (punctual light equation with the same BRDF as the main light) of the pixel's cluster
+float3 ClusterLightsPBR(float4 pixelPosition, float3 worldPosition, float3 n, float3 v, float nDotV,
+                        float3 albedo, float3 baseDiffuse, float3 specularColour, float roughness)
+{
+    float3 light = 0;
+    float3 lambert = albedo / PI;
+    float alpha  = max(roughness * roughness, 2.0e-3f);
+    float alpha2 = alpha * alpha;
+    float k = (roughness + 1);
+    k = k * k / 8;
+    float gV = nDotV / (nDotV * (1 - k) + k);
+
+    uint2 cluster = LightCluster(pixelPosition, worldPosition);
+    for (uint i = 0; i < cluster.y; ++i)
+    {
+        float3 l;
+        float3 lc = PointLightColour(ClusterLight(cluster, i), worldPosition, l);
+        float3 h = normalize(l + v);
+
+        float nDotL = max(dot(n, l), 0.001f);
+        float nDotH = max(dot(n, h), 0.001f);
+        float vDotH = max(dot(v, h), 0.001f);
+
+        float3 F = specularColour + (1 - specularColour) * pow(max(1.0f - vDotH, 0.0f), 5.0f);
+        float dn = nDotH * nDotH * (alpha2 - 1) + 1;
+        float D = alpha2 / (PI * dn * dn);
+        float G = gV * nDotL / (nDotL * (1 - k) + k);
+
+        float3 brdf = baseDiffuse * lambert + F * G * D / (4 * nDotL * nDotV);
+        light += PI * nDotL * lc * brdf;
+    }
+    return light;
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Missile structures and constants shared by the GPU missile compute shaders (see GpuMissiles.h)
+//--------------------------------------------------------------------------------------
+
+
+// Must match the GpuLaunch structure in GpuMissiles in the C++ code
+struct Launch
+{
+    float3 position;
+    uint   slot;
+    float3 velocity;
+    uint   launchingBoat;
+    uint   serial;
+    uint3  padding;
+};
+
+// A missile slot, 48 bytes as GpuMissiles expects. A slot is in use while alive is non-zero
+struct Missile
+{
+    float3 position;
+    uint   serial;
+    float3 velocity;
+    uint   launchingBoat;
+    uint   alive;
+    uint3  padding;
+};
+
+// Must match the Target structure in GpuMissiles in the C++ code
+struct Target
+{
+    float3 position;
+    uint   id;
+};
+
+
+// Must match the MissileConstants structure in the C++ code. Compute shaders have their own slots, so this is b0
+cbuffer MissileConstants : register(b0)
+{
+    float gFrameTime;
+    float gGravity;
+    float gFloorHeight;
+    float gHitRadius;
+    uint  gNumLaunches;
+    uint  gNumTargets;
+    uint  gNumNodes;
+    uint  gNumArgs;
+    uint  gMaxHits;
+    uint3 padding13;
+}
+
+
+// Threads in each group of the compute shaders, must match GpuMissiles::THREAD_GROUP_SIZE
+#define MISSILE_THREAD_GROUP_SIZE 256
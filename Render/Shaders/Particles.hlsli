@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Particle structures and constants shared by the particle shaders (see ParticleSystem.h)
+//--------------------------------------------------------------------------------------
+// The constant buffers are for the compute shaders. Outside compute shaders their slots are used by the buffers in Common.hlsli,
+// so the vertex shader defines PARTICLE_STRUCTURES_ONLY before including this
+
+
+// Must match the GpuParticle structure in ParticleSystem in the C++ code
+struct Particle
+{
+    float3 position;
+    float  age;
+    float3 velocity;
+    float  lifetime;
+    uint   colour;    // RGBA, 8 bits each from the lowest
+    float  size;
+    float2 padding;
+};
+
+// Must match the GpuBurst structure in ParticleSystem in the C++ code
+struct Burst
+{
+    float3 position;
+    float  speed;
+    float3 velocity;
+    float  lifetime;
+    uint   colour;
+    float  size;
+    uint   firstParticle; // Of the particles started this frame
+    uint   numParticles;
+};
+
+
+#ifndef PARTICLE_STRUCTURES_ONLY
+
+// Must match the ParticleConstants structure in the C++ code. Compute shaders have their own slots, so this is b0
+cbuffer ParticleConstants : register(b0)
+{
+    float gFrameTime;
+    float gGravity;
+    float gDrag;
+    uint  gRandomSeed;
+    uint  gNumBursts;
+    uint  gNumNewParticles;
+    float2 padding11;
+}
+
+// The counts of the particle lists, copied into this buffer on the GPU with CopyStructureCount
+cbuffer ParticleCounts : register(b1)
+{
+    uint  gDeadCount;  // Free slots before this frame's particles are emitted
+    uint  gAliveCount; // Particles to simulate this frame
+    uint2 padding12;
+}
+
+#endif
+
+
+// Threads in each group of the compute shaders, must match ParticleSystem::THREAD_GROUP_SIZE
+#define PARTICLE_THREAD_GROUP_SIZE 256
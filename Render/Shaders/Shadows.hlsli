@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// Shadows of the main light for the Blinn, PBR and water pixel shaders (see ShadowMap.h in the C++ code)
+//--------------------------------------------------------------------------------------
+// Include after Common.hlsli. Scale the main light's colour by how much of it reaches the pixel:
+//   float3 lightColour = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition);
+
+
+// The light's view of the shadowed area, must match ShadowConstants in the C++ code
+cbuffer ShadowConstants : register(b7)
+{
+    float4x4 gShadowViewProjection; // World to the shadow map's clip space, depth 0 nearest the light
+    float    gShadowTexelSize;      // Of the map in UV units
+    float    gShadowDepthBias;      // In clip space depth
+    uint     gShadowsEnabled;       // Zero when the C++ code has bound nothing here, then everything is lit
+    float    padding15;
+}
+
+// Depths of the nearest casters from the light, and a sampler comparing against them (1 where lit, outside the map too)
+Texture2D              ShadowMap     : register(t15);
+SamplerComparisonState ShadowSampler : register(s9);
+
+
+// How much of the main light reaches a world position, from 0 in shadow to 1 lit. Percentage closer filtering of 3x3 bilinear
+// comparisons softens the edges of the shadows over a few texels
+float SunShadow(float3 worldPosition)
+{
+    if (gShadowsEnabled == 0)  return 1;
+
+    float4 shadowPosition = mul(gShadowViewProjection, float4(worldPosition, 1));
+    float2 uv    = float2(shadowPosition.x * 0.5f + 0.5f, 0.5f - shadowPosition.y * 0.5f);
+    float  depth = shadowPosition.z - gShadowDepthBias;
+    if (depth >= 1)  return 1; // Beyond the far side of the shadowed area
+
+    float lit = 0;
+    [unroll] for (int y = -1; y <= 1; ++y)
+    {
+        [unroll] for (int x = -1; x <= 1; ++x)
+        {
+            lit += ShadowMap.SampleCmpLevelZero(ShadowSampler, uv + float2(x, y) * gShadowTexelSize, depth);
+        }
+    }
+    return lit / 9;
+}
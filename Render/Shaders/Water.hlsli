@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// Water surface constants and waves shared by the water shaders (see WaterRenderer.h)
+//--------------------------------------------------------------------------------------
+// Include after Common.hlsli. The surface is a grid of square patches centred on the camera, drawn with no vertex buffer as a
+// 4 control point patch list. Each patch is tessellated by distance in the hull shader and the waves are added in the domain
+// shader, so the vertex cost stays the same wherever the camera goes
+
+#ifndef _WATER_HLSLI_DEFINED_
+#define _WATER_HLSLI_DEFINED_
+
+
+// Waves summed over the surface, must match WaterConstants::NUM_WAVES in the C++ code
+#define WATER_WAVES 4
+
+// Must match the WaterConstants structure in the C++ code. Slot 5, only bound while drawing the water
+cbuffer WaterConstants : register(b5)
+{
+    float3 gGridCentre;        // Camera position snapped to the innermost patches, at water height
+    float  gGridExtent;        // From the centre to the edge of the grid
+    uint   gGridPatches;       // Along each side
+    float  gTessellationScale; // Edge tessellation factor is this times its length over its distance from the camera
+    float  gMaxTessellation;
+    float  gWaterTime;
+    float4 gWaves[WATER_WAVES]; // Direction x and z, wavelength, amplitude
+    float4 gWaterDiffuseColour;
+    float3 gWaterSpecularColour;
+    float  gWaterSpecularPower;
+    float  gWaterUVScale;
+    float  gWaveFadeDistance;
+    float  gWaveSteepness;
+    float  padding15;
+}
+
+
+// Control point of a patch corner, from the vertex shader to the hull and domain shaders
+struct WaterControlPoint
+{
+    float3 worldPosition : worldPosition; // On the flat water plane
+};
+
+
+// World position of a corner of the grid, given as whole patches from the grid's top-left. The grid is warped so patches are
+// smallest at the centre and grow towards the edge, as far away fewer vertices are needed. The warp only depends on the corner,
+// so patches sharing an edge compute exactly the same positions for it, and so the same tessellation factors - no cracks
+float3 WaterGridPosition(uint2 corner)
+{
+    float2 grid = corner / (float)gGridPatches * 2 - 1; // -1 to 1 across the grid
+    float2 warped = grid * (abs(grid) * 0.9f + 0.1f);    // Patches at the edge are 19 times the size of those at the centre
+    return gGridCentre + float3(warped.x, 0, warped.y) * gGridExtent;
+}
+
+
+// Move a point of the flat surface by the waves (Gerstner waves, each point moving in a circle as the wave passes, which gives
+// sharp crests and flat troughs), giving its world normal. The waves flatten out towards gWaveFadeDistance from the camera
+float3 WaterWaves(float3 position, out float3 worldNormal)
+{
+    float fade = saturate(2 - 2 * distance(position.xz, gCameraPosition.xz) / gWaveFadeDistance);
+    float3 displaced = position;
+    float3 normal = float3(0, 1, 0);
+    for (uint i = 0; i < WATER_WAVES; ++i)
+    {
+        float2 direction  = gWaves[i].xy;
+        float  wavelength = gWaves[i].z;
+        float  amplitude  = gWaves[i].w * fade;
+
+        // Deep water waves travel at sqrt(g / k), each wave's speed set by its length
+        float k = 2 * PI / wavelength;
+        float speed = sqrt(9.81f / k);
+        float phase = k * (dot(direction, position.xz) - speed * gWaterTime);
+        float s, c;
+        sincos(phase, s, c);
+
+        // Sharpness shared between the waves, so together they can't loop over themselves
+        float q = gWaveSteepness / (k * max(amplitude, 0.0001f) * WATER_WAVES);
+        displaced.xz += direction * (q * amplitude * c);
+        displaced.y  += amplitude * s;
+
+        float ka = k * amplitude;
+        normal.xz -= direction * (ka * c);
+        normal.y  -= q * ka * s;
+    }
+    worldNormal = normalize(normal);
+    return displaced;
+}
+
+#endif // _WATER_HLSLI_DEFINED_
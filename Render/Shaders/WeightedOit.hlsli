@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// Weighted blended transparency outputs for the "_oit" pixel shaders (see WeightedOit.h in the C++ code)
+//--------------------------------------------------------------------------------------
+// Include after Common.hlsli. A pixel shader shades its colour as usual then returns it through WeightedOit:
+//   OitOutput main(Input input)  { ... return WeightedOit(colour, input.clipPosition.z); }
+// Drawn with BlendState::BlendWeightedOit, which adds up the first target and multiplies the second
+
+#ifndef _WEIGHTED_OIT_HLSLI_DEFINED_
+#define _WEIGHTED_OIT_HLSLI_DEFINED_
+
+
+// The two render targets of weighted blended transparency
+struct OitOutput
+{
+    float4 accumulation : SV_Target0; // Colour premultiplied by alpha, and alpha, both times the weight
+    float  revealage    : SV_Target1; // Alpha, the target holds the product of (1 - alpha) of every layer
+};
+
+
+// Outputs for a pixel of the given colour and alpha with the given depth buffer value. Nearer layers are given more weight so
+// they cover those behind them, using McGuire and Bavoil's weight from view distance (equation 9 of their paper)
+OitOutput WeightedOit(float4 colour, float depth)
+{
+    float distance = gProjectionMatrix._43 / (depth - gProjectionMatrix._33); // As Camera::UpdateMatrices sets the matrix up
+    float weight = colour.a * clamp(10.0f / (1e-5f + pow(distance / 5, 2) + pow(distance / 200, 6)), 1e-2f, 3e3f);
+
+    OitOutput output;
+    output.accumulation = float4(colour.rgb * colour.a, colour.a) * weight;
+    output.revealage    = colour.a;
+    return output;
+}
+
+#endif // _WEIGHTED_OIT_HLSLI_DEFINED_
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Frustum cull instances and write the indirect draw arguments for the visible ones
+//--------------------------------------------------------------------------------------
+// One thread for each candidate instance (see GpuCuller.h), whose bounds and world matrices are read from its entity slot's
+// entry in the scene buffer (see SceneBuffer.h). A visible instance takes the next slot in its batch by adding one to
+// the instance count of the batch's first draw, adds one to the counts of its other draws, then copies its world matrices to
+// that slot in the culled matrix buffer. The culled matrices are laid out as for CPU instancing (see Mesh::WriteInstanceMatrices),
+// so the instanced vertex shaders read them unchanged
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Buffers
+//--------------------------------------------------------------------------------------
+
+// Must match the CullConstants structure in the C++ code. Compute shaders have their own slots, so this is b0
+cbuffer CullConstants : register(b0)
+{
+    float4 gFrustumPlanes[6]; // Normal pointing into the frustum and distance, see Frustum.h
+    uint   gNumInstances;
+    uint3  padding8;
+}
+
+// Must match the GpuInstance and GpuBatch structures in the C++ code
+struct Instance
+{
+    uint sceneSlot;   // Of the instance's entry in the scene buffer
+    uint batch;
+};
+
+struct Batch
+{
+    uint  firstMatrix;
+    uint  numInstances;
+    uint  numNodes;
+    uint  firstArg;
+    uint  numArgs;
+    uint3 padding;
+};
+
+StructuredBuffer<Instance> gInstances  : register(t0);
+StructuredBuffer<Batch>    gBatches    : register(t1);
+ByteAddressBuffer          gSceneEntries  : register(t2); // World bounding sphere, first matrix and number of matrices of each slot
+ByteAddressBuffer          gSceneMatrices : register(t3); // World matrices of every slot's drawn nodes
+
+RWByteAddressBuffer gCulledMatrices : register(u0); // Per-instance vertex buffer
+RWByteAddressBuffer gDrawArgs       : register(u1); // DrawIndexedInstancedIndirect arguments, five uints each
+
+
+static const uint DRAW_ARGS_SIZE        = 20; // In bytes
+static const uint INSTANCE_COUNT_OFFSET = 4;  // Of the instance count within a draw's arguments
+static const uint MATRIX_SIZE           = 64;
+static const uint SCENE_ENTRY_SIZE      = 32;
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[numthreads(64, 1, 1)] // Must match GpuCuller::THREAD_GROUP_SIZE
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x >= gNumInstances)  return;
+    Instance instance = gInstances[threadId.x];
+    uint   entryAddress = instance.sceneSlot * SCENE_ENTRY_SIZE;
+    float4 sphere       = asfloat(gSceneEntries.Load4(entryAddress));
+    uint   firstMatrix  = gSceneEntries.Load(entryAddress + 16);
+    if (sphere.w < 0)  return; // Empty bounds, nothing to draw
+
+    // Same test as Frustum::IsSphereVisible - outside if entirely behind any plane
+    for (uint plane = 0; plane < 6; ++plane)
+    {
+        if (dot(gFrustumPlanes[plane].xyz, sphere.xyz) + gFrustumPlanes[plane].w < -sphere.w)  return;
+    }
+
+    // Every draw of the batch gets the same count, the first one hands out the slots
+    Batch batch = gBatches[instance.batch];
+    uint slot;
+    gDrawArgs.InterlockedAdd(batch.firstArg * DRAW_ARGS_SIZE + INSTANCE_COUNT_OFFSET, 1, slot);
+    for (uint arg = 1; arg < batch.numArgs; ++arg)
+    {
+        uint unused;
+        gDrawArgs.InterlockedAdd((batch.firstArg + arg) * DRAW_ARGS_SIZE + INSTANCE_COUNT_OFFSET, 1, unused);
+    }
+
+    // The matrices of each node are together for the whole batch in the culled buffer, and together for each slot in the scene
+    for (uint node = 0; node < batch.numNodes; ++node)
+    {
+        uint source = firstMatrix + node;
+        uint dest   = batch.firstMatrix + node * batch.numInstances + slot;
+        for (uint row = 0; row < 4; ++row)
+        {
+            gCulledMatrices.Store4(dest * MATRIX_SIZE + row * 16, gSceneMatrices.Load4(source * MATRIX_SIZE + row * 16));
+        }
+    }
+}
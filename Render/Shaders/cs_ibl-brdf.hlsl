@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Split-sum BRDF lookup table for specular image-based lighting
+//--------------------------------------------------------------------------------------
+// One thread per texel (see EnvironmentLighting.h). For nDotV across (u) and roughness down (v), the specular BRDF with the
+// PBR shaders' GGX distribution and Smith geometry term integrated over the hemisphere, as a scale and a bias of the specular
+// colour. It doesn't depend on the environment so is the same for every environment map
+
+#include "IBLPrefilter.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+RWTexture2D<float2> gOutput : register(u0);
+
+
+//--------------------------------------------------------------------------------------
+// Compute Shader Code
+//--------------------------------------------------------------------------------------
+
+[numthreads(IBL_THREAD_GROUP_SIZE, IBL_THREAD_GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gOutputSize || id.y >= gOutputSize)  return;
+    float nDotV     = (id.x + 0.5f) / gOutputSize;
+    float roughness = (id.y + 0.5f) / gOutputSize;
+
+    float3 n = float3(0, 0, 1);
+    float3 v = float3(sqrt(1 - nDotV * nDotV), 0, nDotV);
+    float alpha = roughness * roughness;
+    float k = alpha / 2; // Geometry term remapping for image-based lighting
+
+    float2 scaleBias = 0;
+    for (uint i = 0; i < gNumSamples; ++i)
+    {
+        float3 h = ImportanceSampleGGX(Hammersley(i, gNumSamples), alpha, n);
+        float3 l = 2 * dot(v, h) * h - v;
+        float nDotL = saturate(l.z);
+        if (nDotL <= 0)  continue;
+
+        float nDotH = saturate(h.z);
+        float vDotH = saturate(dot(v, h));
+        float G = (nDotV / (nDotV * (1 - k) + k)) * (nDotL / (nDotL * (1 - k) + k));
+        float visibility = G * vDotH / (nDotH * nDotV + 1e-4f);
+        float Fc = pow(1 - vDotH, 5);
+        scaleBias += float2((1 - Fc) * visibility, Fc * visibility);
+    }
+    gOutput[id.xy] = scaleBias / gNumSamples;
+}
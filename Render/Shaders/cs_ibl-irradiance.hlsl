@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Irradiance map of the environment, for diffuse image-based lighting
+//--------------------------------------------------------------------------------------
+// One thread per texel of the irradiance map, for all six faces (see EnvironmentLighting.h). Each texel is the environment
+// averaged over the hemisphere about its direction, weighted by the cosine of the angle, so it is the light a Lambert surface
+// facing that way receives (divided by PI)
+
+#include "IBLPrefilter.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+TextureCube              gSource  : register(t0);
+SamplerState             gSampler : register(s0);
+RWTexture2DArray<float4> gOutput  : register(u0);
+
+
+//--------------------------------------------------------------------------------------
+// Compute Shader Code
+//--------------------------------------------------------------------------------------
+
+[numthreads(IBL_THREAD_GROUP_SIZE, IBL_THREAD_GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gOutputSize || id.y >= gOutputSize)  return;
+    float3 n = CubeDirection(id, gOutputSize);
+
+    // Directions are picked with the cosine weighting itself (probability cosTheta / PI), so the result is a plain average
+    float3 colour = 0;
+    for (uint i = 0; i < gNumSamples; ++i)
+    {
+        float2 xi = Hammersley(i, gNumSamples);
+        float phi = 2 * PI * xi.x;
+        float cosTheta = sqrt(1 - xi.y);
+        float sinTheta = sqrt(xi.y);
+        float3 l = TangentToWorld(float3(sinTheta * cos(phi), sinTheta * sin(phi), cosTheta), n);
+        colour += gSource.SampleLevel(gSampler, l, SourceMip(cosTheta / PI)).rgb;
+    }
+    gOutput[id] = float4(colour / gNumSamples, 1);
+}
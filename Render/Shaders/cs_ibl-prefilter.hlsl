@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Prefilter a mip-map of the specular environment map for a roughness
+//--------------------------------------------------------------------------------------
+// One thread per texel of the mip-map, for all six faces (see EnvironmentLighting.h). The environment is convolved with the GGX
+// distribution assuming the view direction is the normal, the split-sum approximation. The BRDF lookup table holds the rest
+
+#include "IBLPrefilter.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+TextureCube              gSource  : register(t0);
+SamplerState             gSampler : register(s0);
+RWTexture2DArray<float4> gOutput  : register(u0);
+
+
+//--------------------------------------------------------------------------------------
+// Compute Shader Code
+//--------------------------------------------------------------------------------------
+
+[numthreads(IBL_THREAD_GROUP_SIZE, IBL_THREAD_GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= gOutputSize || id.y >= gOutputSize)  return;
+    float3 n = CubeDirection(id, gOutputSize);
+
+    // A perfect mirror just reflects the environment
+    if (gRoughness <= 0)
+    {
+        gOutput[id] = float4(gSource.SampleLevel(gSampler, n, 0).rgb, 1);
+        return;
+    }
+
+    float alpha = gRoughness * gRoughness;
+    float3 colour = 0;
+    float  weight = 0;
+    for (uint i = 0; i < gNumSamples; ++i)
+    {
+        float3 h = ImportanceSampleGGX(Hammersley(i, gNumSamples), alpha, n);
+        float3 l = 2 * dot(n, h) * h - n;
+        float nDotL = dot(n, l);
+        if (nDotL <= 0)  continue;
+
+        // Probability of the sample is D * nDotH / (4 * vDotH), which is D / 4 with the view along the normal
+        float nDotH = saturate(dot(n, h));
+        float dn = nDotH * nDotH * (alpha * alpha - 1) + 1;
+        float D = alpha * alpha / (PI * dn * dn);
+        colour += gSource.SampleLevel(gSampler, l, SourceMip(D / 4)).rgb * nDotL;
+        weight += nDotL;
+    }
+    gOutput[id] = float4(colour / max(weight, 1e-4f), 1);
+}
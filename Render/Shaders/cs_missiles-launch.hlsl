@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Start the missiles launched since the last frame in their slots
+//--------------------------------------------------------------------------------------
+// One thread for each launch (see GpuMissiles.h). The CPU has already picked a free slot for each missile
+
+#include "Missiles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+StructuredBuffer<Launch>   gLaunches : register(t0);
+RWStructuredBuffer<Missile> gMissiles : register(u0);
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[numthreads(MISSILE_THREAD_GROUP_SIZE, 1, 1)]
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x >= gNumLaunches)  return;
+    Launch launch = gLaunches[threadId.x];
+
+    Missile missile;
+    missile.position      = launch.position;
+    missile.serial        = launch.serial;
+    missile.velocity      = launch.velocity;
+    missile.launchingBoat = launch.launchingBoat;
+    missile.alive         = 1;
+    missile.padding       = 0;
+    gMissiles[launch.slot] = missile;
+}
@@ -0,0 +1,142 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Move the missiles on, test them against the boats and gather the survivors for drawing
+//--------------------------------------------------------------------------------------
+// One thread for each missile slot (see GpuMissiles.h). A live missile moves under gravity (exactly, the path is a parabola
+// whatever the frame time) and the straight line it moved along is swept against a sphere around every boat that can be hit,
+// as Missile::Update does through the spatial grid. The boats are read a tile at a time into group shared memory, so each boat
+// position is read from memory once per group rather than once per missile. The first boat along the path is hit: the hit
+// is recorded for the CPU to read back and the missile dies. A missile that falls below the floor dies too. Survivors take the
+// next instance of the missile mesh's indirect draws and write their world matrices there, laid out as for CPU instancing
+// (see Mesh::WriteInstanceMatrices)
+
+#include "Missiles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+StructuredBuffer<Target> gTargets    : register(t0);
+StructuredBuffer<float4> gNodeMatrix : register(t1); // Rows of each drawn node's matrix relative to the mesh root
+
+RWStructuredBuffer<Missile> gMissiles : register(u0);
+RWByteAddressBuffer         gHits     : register(u1); // Hit count, then a hit (slot, serial, boat, launching boat) per 16 bytes
+RWByteAddressBuffer         gMatrices : register(u2); // Per-instance vertex buffer
+RWByteAddressBuffer         gDrawArgs : register(u3); // DrawIndexedInstancedIndirect arguments, five uints each
+
+
+static const uint HITS_OFFSET           = 16; // In bytes, must match GpuMissiles::HITS_OFFSET
+static const uint HIT_SIZE              = 16;
+static const uint DRAW_ARGS_SIZE        = 20;
+static const uint INSTANCE_COUNT_OFFSET = 4;  // Of the instance count within a draw's arguments
+static const uint MATRIX_SIZE           = 64;
+static const uint MAX_MISSILES          = 64 * 1024; // Must match GpuMissiles::MAX_MISSILES, the instances of each node are this far apart
+
+groupshared Target sTargets[MISSILE_THREAD_GROUP_SIZE];
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Fraction of the way along the line from start to start + path where it first comes within the given radius of the centre, or
+// a value over 1 if it doesn't. 0 if the start is already within the radius
+float SweepSphere(float3 start, float3 path, float3 centre, float radius)
+{
+    float3 offset = start - centre;
+    float c = dot(offset, offset) - radius * radius;
+    if (c <= 0)  return 0;
+
+    float a = dot(path, path);
+    float b = dot(offset, path);
+    float discriminant = b * b - a * c;
+    if (a == 0 || b >= 0 || discriminant < 0)  return 2;
+    return (-b - sqrt(discriminant)) / a;
+}
+
+[numthreads(MISSILE_THREAD_GROUP_SIZE, 1, 1)]
+void main(uint3 threadId : SV_DispatchThreadID, uint3 groupThreadId : SV_GroupThreadID)
+{
+    Missile missile = gMissiles[threadId.x];
+    bool alive = missile.alive != 0;
+
+    // Gravity only, so the new position and velocity are exact for any frame time
+    float3 start = missile.position;
+    if (alive)
+    {
+        float3 gravity = float3(0, -gGravity, 0);
+        missile.position += missile.velocity * gFrameTime + 0.5f * gravity * gFrameTime * gFrameTime;
+        missile.velocity += gravity * gFrameTime;
+    }
+    float3 path = missile.position - start;
+
+    // Every thread in the group loads the tiles, dead or not, as the barriers need the whole group. Nothing is hit while paused
+    float nearest = 2;
+    uint  hitBoat = 0;
+    for (uint tileStart = 0; tileStart < gNumTargets; tileStart += MISSILE_THREAD_GROUP_SIZE)
+    {
+        uint load = tileStart + groupThreadId.x;
+        if (load < gNumTargets)  sTargets[groupThreadId.x] = gTargets[load];
+        GroupMemoryBarrierWithGroupSync();
+
+        uint tileSize = min(MISSILE_THREAD_GROUP_SIZE, gNumTargets - tileStart);
+        if (alive && gFrameTime > 0)
+        {
+            for (uint i = 0; i < tileSize; ++i)
+            {
+                Target target = sTargets[i];
+                if (target.id == missile.launchingBoat)  continue;
+                float t = SweepSphere(start, path, target.position, gHitRadius);
+                if (t <= 1 && t < nearest)
+                {
+                    nearest = t;
+                    hitBoat = target.id;
+                }
+            }
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+    if (!alive)  return;
+
+    if (nearest <= 1)
+    {
+        uint hit;
+        gHits.InterlockedAdd(0, 1, hit);
+        if (hit < gMaxHits)  gHits.Store4(HITS_OFFSET + hit * HIT_SIZE, uint4(threadId.x, missile.serial, hitBoat, missile.launchingBoat));
+        missile.alive = 0;
+    }
+    else if (missile.position.y < gFloorHeight)
+    {
+        missile.alive = 0;
+    }
+    gMissiles[threadId.x] = missile;
+    if (missile.alive == 0)  return;
+
+    // Every draw of the mesh gets the same count, the first one hands out the instances
+    uint instance;
+    gDrawArgs.InterlockedAdd(INSTANCE_COUNT_OFFSET, 1, instance);
+    for (uint arg = 1; arg < gNumArgs; ++arg)
+    {
+        uint unused;
+        gDrawArgs.InterlockedAdd(arg * DRAW_ARGS_SIZE + INSTANCE_COUNT_OFFSET, 1, unused);
+    }
+
+    // Face along the velocity as Missile::Update does (see TRS::FaceDirection), rows are the axes then the position
+    float3 zAxis = normalize(length(missile.velocity) > 0.01f ? missile.velocity : float3(0, 0, 1));
+    float3 xAxis = cross(float3(0, 1, 0), zAxis);
+    xAxis = (dot(xAxis, xAxis) > 0.0001f) ? normalize(xAxis) : float3(1, 0, 0);
+    float3 yAxis = cross(zAxis, xAxis);
+    float4 rootRows[4] = { float4(xAxis, 0), float4(yAxis, 0), float4(zAxis, 0), float4(missile.position, 1) };
+
+    // Each drawn node's world matrix is its matrix relative to the root times the root's, the instances of each node together
+    for (uint node = 0; node < gNumNodes; ++node)
+    {
+        uint dest = node * MAX_MISSILES + instance;
+        for (uint row = 0; row < 4; ++row)
+        {
+            float4 relative = gNodeMatrix[node * 4 + row];
+            float4 world = relative.x * rootRows[0] + relative.y * rootRows[1] + relative.z * rootRows[2] + relative.w * rootRows[3];
+            gMatrices.Store4(dest * MATRIX_SIZE + row * 16, asuint(world));
+        }
+    }
+}
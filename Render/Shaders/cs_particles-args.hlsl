@@ -0,0 +1,25 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Thread groups for simulating the particles alive
+//--------------------------------------------------------------------------------------
+// A single thread, run after the alive list's count has been copied into the counts buffer. Writes the thread groups of the
+// indirect dispatch of cs_particles-simulate (see ParticleSystem.h)
+
+#include "Particles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+RWByteAddressBuffer gArgs : register(u0); // Dispatch arguments at the start, three uints
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[numthreads(1, 1, 1)]
+void main()
+{
+    gArgs.Store3(0, uint3((gAliveCount + PARTICLE_THREAD_GROUP_SIZE - 1) / PARTICLE_THREAD_GROUP_SIZE, 1, 1));
+}
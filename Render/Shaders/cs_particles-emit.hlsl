@@ -0,0 +1,78 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Start this frame's particles from their bursts
+//--------------------------------------------------------------------------------------
+// One thread for each new particle (see ParticleSystem.h). The thread finds the burst it belongs to, takes a free slot from the
+// dead list and starts a particle there moving off from the burst's point in a random direction, then adds the slot to the alive
+// list. Threads beyond the number of free slots start nothing, so the last bursts of a frame lose particles when the pool is full
+
+#include "Particles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+StructuredBuffer<Burst> gBursts : register(t0);
+
+RWStructuredBuffer<Particle>   gParticles : register(u0);
+ConsumeStructuredBuffer<uint>  gDeadList  : register(u1);
+AppendStructuredBuffer<uint>   gAliveList : register(u2);
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Hash of an integer to a well mixed integer (PCG), for random numbers without any state
+uint Hash(uint value)
+{
+    uint state = value * 747796405u + 2891336453u;
+    uint word  = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Random number from 0 to 1, moving the seed on
+float Random(inout uint seed)
+{
+    seed = Hash(seed);
+    return seed / 4294967295.0f;
+}
+
+[numthreads(PARTICLE_THREAD_GROUP_SIZE, 1, 1)]
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x >= gNumNewParticles || threadId.x >= gDeadCount)  return;
+
+    // The last burst starting at or before this particle
+    uint first = 0;
+    uint last  = gNumBursts - 1;
+    while (first < last)
+    {
+        uint middle = (first + last + 1) / 2;
+        if (gBursts[middle].firstParticle <= threadId.x)  first = middle;
+        else                                              last  = middle - 1;
+    }
+    Burst burst = gBursts[first];
+
+    // A random direction (uniform over the sphere) and a random speed up to the burst's, weighted towards the faster end so
+    // bursts are hollow rather than clumped at their centre
+    uint seed = Hash(threadId.x ^ Hash(gRandomSeed));
+    float z     = Random(seed) * 2 - 1;
+    float angle = Random(seed) * 6.2831853f;
+    float ring  = sqrt(1 - z * z);
+    float3 direction = float3(ring * cos(angle), z, ring * sin(angle));
+    float  speed     = burst.speed * sqrt(Random(seed));
+
+    Particle particle;
+    particle.position = burst.position;
+    particle.age      = 0;
+    particle.velocity = burst.velocity + direction * speed;
+    particle.lifetime = burst.lifetime * (0.5f + 0.5f * Random(seed));
+    particle.colour   = burst.colour;
+    particle.size     = burst.size;
+    particle.padding  = 0;
+
+    uint slot = gDeadList.Consume();
+    gParticles[slot] = particle;
+    gAliveList.Append(slot);
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Move the live particles on and let go of those that have had their lifetime
+//--------------------------------------------------------------------------------------
+// One thread for each particle in this frame's alive list (see ParticleSystem.h). A particle still alive after moving goes into
+// the other alive list, to be drawn this frame and simulated next frame, otherwise its slot goes back in the dead list
+
+#include "Particles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+RWStructuredBuffer<Particle>  gParticles    : register(u0);
+AppendStructuredBuffer<uint>  gDeadList     : register(u1);
+ConsumeStructuredBuffer<uint> gAliveList    : register(u2);
+AppendStructuredBuffer<uint>  gNewAliveList : register(u3);
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[numthreads(PARTICLE_THREAD_GROUP_SIZE, 1, 1)]
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x >= gAliveCount)  return;
+
+    uint slot = gAliveList.Consume();
+    Particle particle = gParticles[slot];
+    particle.age += gFrameTime;
+    if (particle.age >= particle.lifetime)
+    {
+        gDeadList.Append(slot);
+        return;
+    }
+
+    // Drag slows the particle in proportion to its speed, and stays stable however long the frame
+    particle.velocity.y -= gGravity * gFrameTime;
+    particle.velocity   *= 1 / (1 + gDrag * gFrameTime);
+    particle.position   += particle.velocity * gFrameTime;
+    gParticles[slot] = particle;
+    gNewAliveList.Append(slot);
+}
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Compute Shader - Scatter the changed entries and matrices of the scene buffer to their places
+//--------------------------------------------------------------------------------------
+// One thread for each change queued since the last upload (see SceneBuffer.h). Each change is a few 16-byte rows copied
+// unchanged to one of the two buffers, an entity slot's entry or one of its matrices
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Buffers
+//--------------------------------------------------------------------------------------
+
+// Must match the SceneScatterConstants structure in the C++ code. Compute shaders have their own slots, so this is b0
+cbuffer SceneScatterConstants : register(b0)
+{
+    uint  gNumUpdates;
+    uint3 padding8;
+}
+
+// Must match the GpuUpdate structure in the C++ code
+struct Update
+{
+    uint  target;   // 0 for the entries, 1 for the matrices
+    uint  firstRow; // 16-byte row of the target buffer to write at
+    uint  numRows;
+    uint  padding;
+    uint4 rows[4];
+};
+
+StructuredBuffer<Update> gUpdates : register(t0);
+
+RWByteAddressBuffer gSceneEntries  : register(u0);
+RWByteAddressBuffer gSceneMatrices : register(u1);
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[numthreads(64, 1, 1)] // Must match SceneBuffer::THREAD_GROUP_SIZE
+void main(uint3 threadId : SV_DispatchThreadID)
+{
+    if (threadId.x >= gNumUpdates)  return;
+    Update update = gUpdates[threadId.x];
+
+    for (uint row = 0; row < update.numRows; ++row)
+    {
+        uint address = (update.firstRow + row) * 16;
+        if (update.target == 0)  gSceneEntries.Store4(address, update.rows[row]);
+        else                     gSceneMatrices.Store4(address, update.rows[row]);
+    }
+}
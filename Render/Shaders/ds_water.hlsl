@@ -0,0 +1,49 @@
+//--------------------------------------------------------------------------------------
+// Domain Shader - Water surface, each tessellated vertex moved by the waves
+//--------------------------------------------------------------------------------------
+// The vertex is placed on the flat patch from its (u,v), then the waves are added and it is projected to clip space. The pixel
+// shader gets the same data as the Blinn pixel shaders, with the texture coordinates taken from the world position
+
+#include "Common.hlsli"
+#include "Water.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Domain Shader Input/Output
+//--------------------------------------------------------------------------------------
+
+// Tessellation factors from the hull shader, not used here
+struct PatchConstants
+{
+    float edges[4]  : SV_TessFactor;
+    float inside[2] : SV_InsideTessFactor;
+};
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space
+    float3 worldPosition : worldPosition; // 3D position of vertex in world space, after the waves
+    float3 worldNormal   : worldNormal;   // Normal of the waves at this vertex
+    float2 uv            : uv;            // From the flat position, so the texture doesn't stretch with the waves
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+[domain("quad")]
+Output main(PatchConstants patchConstants, float2 uv : SV_DomainLocation, const OutputPatch<WaterControlPoint, 4> patch)
+{
+    Output output;
+
+    float3 flatPosition = lerp(lerp(patch[0].worldPosition, patch[1].worldPosition, uv.x),
+                               lerp(patch[2].worldPosition, patch[3].worldPosition, uv.x), uv.y);
+    float3 worldPosition = WaterWaves(flatPosition, output.worldNormal);
+
+    output.clipPosition  = mul(gViewProjectionMatrix, float4(worldPosition, 1));
+    output.worldPosition = worldPosition;
+    output.uv            = flatPosition.xz * gWaterUVScale;
+    return output;
+}
@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// Hull Shader - Water surface, tessellation factors of each patch by distance from the camera
+//--------------------------------------------------------------------------------------
+// Each edge is split in proportion to its length over its distance from the camera, so triangles are about the same size on
+// screen wherever they are. An edge's factor only depends on its two corners, so the patches either side agree on it and the
+// surface has no cracks. Patches outside the view, allowing for the height of the waves, get factors of 0 and are not drawn
+
+#include "Common.hlsli"
+#include "Water.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Hull Shader Output
+//--------------------------------------------------------------------------------------
+
+// Tessellation factors of a quad patch. Edges are the u = 0, v = 0, u = 1 and v = 1 sides of the patch in that order
+struct PatchConstants
+{
+    float edges[4]  : SV_TessFactor;
+    float inside[2] : SV_InsideTessFactor;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Factor for the edge between two corners
+float EdgeFactor(float3 a, float3 b)
+{
+    float3 middle = (a + b) * 0.5f;
+    float  factor = gTessellationScale * distance(a, b) / max(distance(middle, gCameraPosition), 1.0f);
+    return clamp(factor, 1.0f, gMaxTessellation);
+}
+
+// Whether all of the points are outside the same side of the view
+bool OutsideView(float4 clip[8])
+{
+    bool4 allOutside = true;
+    bool  allBehind  = true;
+    for (uint i = 0; i < 8; ++i)
+    {
+        allOutside = allOutside && (float4(clip[i].x, -clip[i].x, clip[i].y, -clip[i].y) > clip[i].w);
+        allBehind  = allBehind && (clip[i].w <= 0);
+    }
+    return any(allOutside) || allBehind;
+}
+
+// Once per patch
+PatchConstants PatchConstantFunction(InputPatch<WaterControlPoint, 4> patch)
+{
+    PatchConstants output;
+
+    // The patch's corners raised and lowered by the most the waves can move them
+    float waveHeight = 0;
+    for (uint wave = 0; wave < WATER_WAVES; ++wave)  waveHeight += gWaves[wave].w;
+    float4 clip[8];
+    for (uint i = 0; i < 4; ++i)
+    {
+        clip[i]     = mul(gViewProjectionMatrix, float4(patch[i].worldPosition + float3(0, waveHeight, 0), 1));
+        clip[i + 4] = mul(gViewProjectionMatrix, float4(patch[i].worldPosition - float3(0, waveHeight, 0), 1));
+    }
+    if (OutsideView(clip))
+    {
+        output.edges[0] = output.edges[1] = output.edges[2] = output.edges[3] = 0;
+        output.inside[0] = output.inside[1] = 0;
+        return output;
+    }
+
+    // Corners are (0,0) (1,0) (0,1) (1,1) in (u,v)
+    output.edges[0] = EdgeFactor(patch[0].worldPosition, patch[2].worldPosition);
+    output.edges[1] = EdgeFactor(patch[0].worldPosition, patch[1].worldPosition);
+    output.edges[2] = EdgeFactor(patch[1].worldPosition, patch[3].worldPosition);
+    output.edges[3] = EdgeFactor(patch[2].worldPosition, patch[3].worldPosition);
+    output.inside[0] = max(output.edges[1], output.edges[3]); // Splits along u
+    output.inside[1] = max(output.edges[0], output.edges[2]);
+    return output;
+}
+
+// Once per control point, which are passed straight on
+[domain("quad")]
+[partitioning("fractional_odd")]
+[outputtopology("triangle_cw")]
+[outputcontrolpoints(4)]
+[patchconstantfunc("PatchConstantFunction")]
+[maxtessfactor(64.0f)]
+WaterControlPoint main(InputPatch<WaterControlPoint, 4> patch, uint i : SV_OutputControlPointID)
+{
+    return patch[i];
+}
@@ -5,6 +5,8 @@
 // diffuse / specular colour settings from per-material constant buffer (see include file)
 
 #include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
 
 
 //--------------------------------------------------------------------------------------
@@ -38,7 +40,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3 halfwayNormal = normalize(cameraNormal + lightNormal);            // Halfway normal is halfway between camera and light normal - used for specular lighting
 
 	// Attenuate light colour (reduce strength based on its distance)
-	float3  attenuatedLightColour = gLight1Colour.rgb / lightDistance;
+	float3  attenuatedLightColour = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
 
 	// Diffuse lighting
 	float  lightDiffuseLevel = saturate(dot(worldNormal, lightNormal));
@@ -48,6 +50,9 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float  lightSpecularLevel = pow(saturate(dot(worldNormal, halfwayNormal)), gMaterialSpecularPower);
 	float3 lightSpecularColour = lightDiffuseColour * lightSpecularLevel; // Using diffuse light colour rather than plain attenuated colour - own adjustment to Blinn-Phong model
 
+	// Add the clustered lights near this pixel, e.g. missile glows and explosions (see Lights.hlsli)
+	AddClusterLightsBlinn(input.clipPosition, input.worldPosition, worldNormal, cameraNormal, gMaterialSpecularPower, lightDiffuseColour, lightSpecularColour);
+
 
 	// Diffuse colour combines material colour with per-mesh colour - alpha will also be combined here and used for output pixel alpha
 	float4 materialDiffuseColour  = gMaterialDiffuseColour * gMeshColour;
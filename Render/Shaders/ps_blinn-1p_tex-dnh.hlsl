@@ -5,6 +5,8 @@
 // Combines with diffuse / specular colour settings from per-material constant buffer (see include file)
 
 #include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
 
 
 //--------------------------------------------------------------------------------------
@@ -64,7 +66,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	                                                                          // this by parallaxOffset.z to remove limiting (stronger effect, prone to artefacts)
 
 	// Sample the normal map - including conversion from 0->1 RGB values to -1 -> 1 XYZ values
-	float3 tangentNormal = normalize(NormalMap.Sample(NormalFilter, uv).xyz * 2.0f - 1.0f);
+	float3 tangentNormal = DecodeNormalMap(NormalMap.Sample(NormalFilter, uv));
 
 	// Convert the sampled normal from tangent space (as it was stored) into world space. This now replaces the world normal for lighting
 	worldNormal = mul(tangentNormal, tangentMatrix);
@@ -77,7 +79,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3 halfwayNormal = normalize(cameraNormal + lightNormal); // Halfway normal is halfway between camera and light normal - used for specular lighting
 
 	// Attenuate light colour (reduce strength based on its distance)
-	float3  attenuatedLightColour = gLight1Colour.rgb / lightDistance;
+	float3  attenuatedLightColour = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
 
 	// Diffuse lighting
 	float  lightDiffuseLevel = saturate(dot(worldNormal, lightNormal));
@@ -87,6 +89,9 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float  lightSpecularLevel = pow(saturate(dot(worldNormal, halfwayNormal)), gMaterialSpecularPower);
 	float3 lightSpecularColour = lightDiffuseColour * lightSpecularLevel; // Using diffuse light colour rather than plain attenuated colour - own adjustment to Blinn-Phong model
 
+	// Add the clustered lights near this pixel, e.g. missile glows and explosions (see Lights.hlsli)
+	AddClusterLightsBlinn(input.clipPosition, input.worldPosition, worldNormal, cameraNormal, gMaterialSpecularPower, lightDiffuseColour, lightSpecularColour);
+
 
 	// Material colours are taken from material colours combined with texture colours
 	// Diffuse colour combines alpha from material, texture and mesh colour, and the result will be the alpha of the rendered pixel
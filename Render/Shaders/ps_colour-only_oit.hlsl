@@ -0,0 +1,29 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Unlit plain colour, weighted blended transparency version
+//--------------------------------------------------------------------------------------
+// As ps_colour-only but writes the targets of weighted blended transparency (see WeightedOit.hlsli)
+
+#include "Common.hlsli"
+#include "WeightedOit.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space, the z is the depth buffer value
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+OitOutput main(Input input)
+{
+    // Combines colour *and* alpha value from material diffuse colour and per-mesh colour
+    return WeightedOit(gMaterialDiffuseColour * gMeshColour, input.clipPosition.z);
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Depth pre-pass for alpha tested materials
+//--------------------------------------------------------------------------------------
+// Writes no colour. Discards the pixels that the PBR pixel shaders cut out (albedo alpha below 0.25) so they don't enter the
+// depth buffer, the rest of the depth pre-pass has no pixel shader at all (see RenderState::SetDepthOnly)
+// Version of ps_depth-alpha-test reading the material's textures from texture arrays shared with similar materials, at the
+// slice given in the material constants (see ImportFlags::TextureArrays in the C++ code)
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+// Textures - order of indexes (t0, t1 etc.) is specified in MeshTypes.h : TextureTypes
+Texture2DArray AlbedoMap : register(t0);
+
+// Samplers used for above textures
+SamplerState MapSampler : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float2 uv            : uv;            // Texture coordinate for this pixel, used to sample textures
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+// Pixel shader gets input from pixel shader output, see structure above. Only the depth is written, so there is no output
+void main(Input input)
+{
+	// Same test as the PBR pixel shaders, at the same UVs
+	if (AlbedoMap.Sample(MapSampler, float3(input.uv, gMaterialSlice)).a < 0.25f)  discard;
+}
@@ -0,0 +1,56 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Downsample the depth buffer to half size
+//--------------------------------------------------------------------------------------
+// Each pixel of the half size depth buffer takes the nearest of the 2x2 depths it covers, written as SV_Depth (see
+// HalfResEffects.h). Drawn with a half size viewport and no render target
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Textures
+//--------------------------------------------------------------------------------------
+
+// Must match the HalfResConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer HalfResConstants : register(b5)
+{
+    uint2  gSceneSize;      // Pixels of the scene in the full size depth buffer
+    uint2  gHalfSize;       // Pixels of the half size targets in use
+    float  gDepthScale;     // View distance is gDepthScale / (depth - gDepthOffset)
+    float  gDepthOffset;
+    float  gDepthTolerance;
+    float  padding16;
+}
+
+Texture2D<float> SceneDepth : register(t0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate across the screen
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float main(Input input) : SV_Depth
+{
+    // Clamped to the scene, the last column or row of an odd size covers only one full size pixel
+    int2 topLeft = int2(input.clipPosition.xy) * 2;
+    int2 maxPixel = int2(gSceneSize) - 1;
+    float depth = 1;
+    [unroll] for (int y = 0; y < 2; ++y)
+    {
+        [unroll] for (int x = 0; x < 2; ++x)
+        {
+            depth = min(depth, SceneDepth.Load(int3(min(topLeft + int2(x, y), maxPixel), 0)));
+        }
+    }
+    return depth;
+}
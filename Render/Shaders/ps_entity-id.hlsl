@@ -0,0 +1,17 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Entity ID
+//--------------------------------------------------------------------------------------
+// Writes the ID of the entity being rendered into an R32_UINT render target, used for picking (see IdBufferPicker.h)
+// The ID is passed in the bits of the red channel of the per-mesh colour, it is not a colour value
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+uint main() : SV_Target
+{
+	return asuint(gMeshColour.r);
+}
@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Add the half size effects target to the scene with a depth-aware upsample
+//--------------------------------------------------------------------------------------
+// Drawn over the full size scene with additive blending (see HalfResEffects.h). The four half size texels around the pixel
+// are filtered bilinearly if their view distances are all close to the pixel's own, otherwise the texel at the nearest
+// distance to the pixel's is taken alone, so effects don't bleed across the edges of nearer or further surfaces
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Textures
+//--------------------------------------------------------------------------------------
+
+// Must match the HalfResConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer HalfResConstants : register(b5)
+{
+    uint2  gSceneSize;      // Pixels of the scene in the full size depth buffer
+    uint2  gHalfSize;       // Pixels of the half size targets in use
+    float  gDepthScale;     // View distance is gDepthScale / (depth - gDepthOffset)
+    float  gDepthOffset;
+    float  gDepthTolerance; // Fraction of the pixel's distance that texels may differ by and still be filtered
+    float  padding16;
+}
+
+Texture2D<float4> EffectsColour : register(t0);
+Texture2D<float>  EffectsDepth  : register(t1);
+Texture2D<float>  SceneDepth    : register(t2);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate across the screen
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+// View space distance of a depth buffer value
+float ViewDistance(float depth)
+{
+    return gDepthScale / (depth - gDepthOffset);
+}
+
+
+float4 main(Input input) : SV_Target
+{
+    int2 pixel = int2(input.clipPosition.xy);
+    float pixelDistance = ViewDistance(SceneDepth.Load(int3(pixel, 0)));
+
+    // The four half size texels whose centres surround this pixel's centre, and the bilinear weights between them
+    float2 halfPosition = (input.clipPosition.xy * 0.5f) - 0.5f;
+    int2   topLeft  = int2(floor(halfPosition));
+    float2 fraction = halfPosition - topLeft;
+    int2   maxTexel = int2(gHalfSize) - 1;
+
+    float4 colours[4];
+    float  weights[4] = { (1 - fraction.x) * (1 - fraction.y), fraction.x * (1 - fraction.y), (1 - fraction.x) * fraction.y, fraction.x * fraction.y };
+    float  tolerance = pixelDistance * gDepthTolerance;
+    bool   allClose = true;
+    float  nearestDifference = 1e30f;
+    int    nearest = 0;
+    [unroll] for (int i = 0; i < 4; ++i)
+    {
+        int3 texel = int3(clamp(topLeft + int2(i & 1, i >> 1), 0, maxTexel), 0);
+        colours[i] = EffectsColour.Load(texel);
+        float difference = abs(ViewDistance(EffectsDepth.Load(texel)) - pixelDistance);
+        allClose = allClose && difference < tolerance;
+        if (difference < nearestDifference)
+        {
+            nearestDifference = difference;
+            nearest = i;
+        }
+    }
+
+    if (!allClose)  return colours[nearest];
+    return colours[0] * weights[0] + colours[1] * weights[1] + colours[2] * weights[2] + colours[3] * weights[3];
+}
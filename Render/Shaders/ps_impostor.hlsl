@@ -0,0 +1,38 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Impostors, a baked view of a mesh from an atlas
+//--------------------------------------------------------------------------------------
+// Cuts out the background of the view and tints it by the colour of the entity (see ImpostorRenderer.h)
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+Texture2D    AtlasTexture : register(t0);
+SamplerState AtlasFilter  : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float2 uv            : uv;            // Texture coordinate in the atlas
+	float4 colour        : colour;        // Tint of the entity
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+	// The atlas background is clear black, so filtered texels at the edge of the mesh are darkened by their alpha, undo that
+	float4 texel = AtlasTexture.Sample(AtlasFilter, input.uv);
+	clip(texel.a - 0.5f);
+	return float4(texel.rgb / texel.a * input.colour.rgb, 1);
+}
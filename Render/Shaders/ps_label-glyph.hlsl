@@ -0,0 +1,35 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Glyphs of text labels
+//--------------------------------------------------------------------------------------
+// Tints the font's sprite sheet, which is white with premultiplied alpha, by the colour of the label (see LabelRenderer.h)
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+Texture2D    FontTexture : register(t0);
+SamplerState FontFilter  : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float2 uv            : uv;            // Texture coordinate in the font's sprite sheet
+	float4 colour        : colour;        // Colour of the label
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+	return FontTexture.Sample(FontFilter, input.uv) * input.colour;
+}
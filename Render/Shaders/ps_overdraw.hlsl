@@ -0,0 +1,17 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Overdraw heatmap
+//--------------------------------------------------------------------------------------
+// Replaces the pixel shader of every entity draw while the overdraw heatmap is shown (see Scene::RenderFromCamera). Each time
+// a pixel is shaded it adds a little to the render target with additive blending. The channels fill at different rates, so a
+// pixel shaded once is dark red, a few times orange to yellow and many times white
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main() : SV_Target
+{
+	// Red fills after 8 layers, green after 24 and blue after 64
+	return float4(1.0f / 8, 1.0f / 24, 1.0f / 64, 1);
+}
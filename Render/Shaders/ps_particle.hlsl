@@ -0,0 +1,28 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - GPU particles, a soft round spot of the particle's colour
+//--------------------------------------------------------------------------------------
+// Drawn with additive blending and no texture, the spot falls off smoothly from the centre of the quad (see ParticleSystem.h)
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float2 uv            : uv;            // Position in the quad, -1 to 1 across it
+	float4 colour        : colour;        // Colour of the particle at its age, already faded
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+	float falloff = saturate(1 - dot(input.uv, input.uv));
+	return float4(input.colour.rgb * falloff * falloff, 1);
+}
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - PBR lighting (metalness/roughness) with albedo only - 1 light source.
+//--------------------------------------------------------------------------------------
+// Cheapest shader level of detail for the PBR materials, used for surfaces too small on screen to show their normal or
+// parallax mapping (see RenderState::LowerShaderLOD). Uses the vertex normal and the albedo map only, with the diffuse parts
+// of the full shaders' lighting: diffuse IBL and Lambert diffuse for the light. No specular
+// Combines with diffuse colour setting from per-material constant buffer (see include file)
+// Version of ps_pbr1-1a reading the material's textures from texture arrays shared with similar materials, at the
+// slice given in the material constants (see ImportFlags::TextureArrays in the C++ code)
+
+#include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
+#include "IBL.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+// Textures - order of indexes (t0, t1 etc.) is specified in MeshTypes.h : TextureTypes
+Texture2DArray AlbedoMap : register(t0); // Base colour for surface - diffuse colour where non-metal, specular colour where metal
+
+// Samplers used for above textures
+SamplerState MapSampler : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float3 worldPosition : worldPosition; // 3D position of pixel in world space - used for lighting
+	float3 worldNormal   : worldNormal;   // The surface normal (in world space) for this pixel - used for lighting
+	float2 uv            : uv;            // Texture coordinate for this pixel, used to sample textures
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+// Pixel shader gets input from pixel shader output, see structure above
+float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a special semantic SV_Target to indicate it goes to the render target
+{
+	// Renormalise pixel normal because interpolation from the vertex shader can introduce scaling
+	float3 n = normalize(input.worldNormal);
+
+	// Same alpha test as the other PBR shaders, so changing shader level of detail doesn't change which pixels are cut out
+    float4 albedo4 = AlbedoMap.Sample(MapSampler, float3(input.uv, gMaterialSlice)).rgba;
+    if (albedo4.a < 0.25f)  discard;
+    float3 albedo = albedo4.rgb;
+
+	// Diffuse colour from material/mesh
+	float4 baseDiffuse = gMaterialDiffuseColour * gMeshColour;
+
+	// Diffuse environment light, adjusted as in the full shaders
+	float3 diffuseIBL = DiffuseIBL(n);
+
+	// Lambert diffuse for the light, attenuated by its distance. PI * lambert in the full shaders' BRDF is just the albedo
+	float3 lightVector = gLight1Position - input.worldPosition;
+	float  lightDistance = length(lightVector);
+	float3 lc = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
+	float  nDotL = max(dot(n, lightVector / lightDistance), 0.001f);
+
+	// The clustered lights near this pixel are added in the same way (see Lights.hlsli)
+	float3 clusterLight = ClusterLightsLambert(input.clipPosition, input.worldPosition, n);
+	float3 colour = baseDiffuse.rgb * albedo * (diffuseIBL + nDotL * lc + clusterLight);
+	return float4(colour, baseDiffuse.a);
+}
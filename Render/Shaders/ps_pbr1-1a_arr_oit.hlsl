@@ -0,0 +1,21 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - PBR lighting (metalness/roughness) with albedo only - 1 light source, weighted blended transparency version
+//--------------------------------------------------------------------------------------
+// ps_pbr1-1a_arr with the same lighting, writing the targets of weighted blended transparency (see WeightedOit.hlsli). The lit shader is
+// included with its main function renamed, so the two can't drift apart
+
+#define main ShadePixel
+#include "ps_pbr1-1a_arr.hlsl"
+#undef main
+
+#include "WeightedOit.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+OitOutput main(Input input)
+{
+    return WeightedOit(ShadePixel(input), input.clipPosition.z);
+}
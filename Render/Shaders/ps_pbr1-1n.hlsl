@@ -6,6 +6,9 @@
 // Combines with diffuse colour setting from per-material constant buffer (see include file)
 
 #include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
+#include "IBL.hlsli"
 
 
 //--------------------------------------------------------------------------------------
@@ -21,10 +24,6 @@ Texture2D NormalMap    : register(t3); // Standard normal map
 // Samplers used for above textures
 SamplerState MapSampler : register(s0);
 
-// Image-based lighting - additional texture for environment reflections, doesn't come from mesh but set globally at scene level instead
-TextureCube  IBLMap     : register(t8); // A cube map is made of six internal images, but is can be sampled as one
-SamplerState IBLSampler : register(s8);
-
 
 //--------------------------------------------------------------------------------------
 // Pixel Shader Input
@@ -59,7 +58,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3x3 tangentMatrix = float3x3(worldTangent, worldBitangent, worldNormal);
 
 	// Sample the normal map - including conversion from 0->1 RGB values to -1 -> 1 XYZ values
-	float3 tangentNormal = normalize(NormalMap.Sample(MapSampler, input.uv).xyz * 2.0f - 1.0f);
+	float3 tangentNormal = DecodeNormalMap(NormalMap.Sample(MapSampler, input.uv));
 
 	// Convert the sampled normal from tangent space (as it was stored) into world space. This becomes the n, the world normal for the PBR equations below
 	float3 n = mul(tangentNormal, tangentMatrix);
@@ -92,17 +91,13 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	// Reflection vector for sampling the cubemap for specular reflections
 	float3 r = reflect(-v, n);
 
-	// Sample environment cubemap, use small mipmap for diffuse, use mipmap based on roughness for specular
-	float3 diffuseIBL = IBLMap.SampleLevel(MapSampler, n, 9).rgb;             // Surface normal to sample diffuse environment light
-	diffuseIBL = (diffuseIBL - 0.5f) * 0.333f + 0.2f;                         // Adjust contrast of environment map
-	float roughnessMip = 8 * log2(roughness + 1);                             // Heuristic to convert roughness to mip-map. Rougher surfaces will use smaller (blurrier) mip-maps
-	float3 specularIBL = IBLMap.SampleLevel(MapSampler, r, roughnessMip).rgb; // Reflected vector to sample specular environment light
-
-	// Fresnel for IBL: when surface is at more of a glancing angle reflection of the scene increases
-	float3 F_IBL = specularColour + (1 - specularColour) * pow(max(1.0f - nDotV, 0.0f), 5.0f);
+	// Environment light from the maps prefiltered at load: irradiance for diffuse, and for specular the prefiltered map for the
+	// roughness scaled by the split-sum lookup table (see IBL.hlsli)
+	float3 diffuseIBL  = DiffuseIBL(n);
+	float3 specularIBL = SpecularIBL(r, nDotV, specularColour, roughness);
 
-	// Overall global illumination - rough approximation
-	float3 colour = baseDiffuse.rgb * albedo *  diffuseIBL + (1 - roughness) * specularIBL * F_IBL;
+	// Overall global illumination
+	float3 colour = baseDiffuse.rgb * albedo * diffuseIBL + specularIBL;
 
 
 	///////////////////////
@@ -114,7 +109,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3 h = normalize(l + v);                // Halfway normal is halfway between camera and light normals
 
 	// Attenuate light colour (reduce strength based on its distance)
-	float3 lc = gLight1Colour.rgb / lightDistance;
+	float3 lc = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
 
 	// Various dot products used throughout
 	float nDotL = max(dot(n, l), 0.001f);
@@ -147,5 +142,8 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	// Accumulate punctual light equation for this light
 	colour += PI * nDotL * lc * brdf;
 
+	// Then for the clustered lights near this pixel, e.g. missile glows and explosions (see Lights.hlsli)
+	colour += ClusterLightsPBR(input.clipPosition, input.worldPosition, n, v, nDotV, albedo, baseDiffuse.rgb, specularColour, roughness);
+
 	return float4(colour, baseDiffuse.a);
 }
@@ -6,6 +6,9 @@
 // Combines with diffuse colour setting from per-material constant buffer (see include file)
 
 #include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
+#include "IBL.hlsli"
 
 
 //--------------------------------------------------------------------------------------
@@ -22,10 +25,6 @@ Texture2D DisplacementMap : register(t4); // Standard displacement (or height) m
 // Samplers used for above textures
 SamplerState MapSampler : register(s0);
 
-// Image-based lighting - additional texture for environment reflections, doesn't come from mesh but set globally at scene level instead
-TextureCube  IBLMap     : register(t8); // A cube map is made of six internal images, but is can be sampled as one
-SamplerState IBLSampler : register(s8);
-
 
 //--------------------------------------------------------------------------------------
 // Pixel Shader Input
@@ -64,6 +63,10 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3 vt = mul(tangentMatrix, v);                           // Transform camera normal into tangent space (so it is local to texture)
     float2 uv = input.uv;
 
+    // Alpha test at the surface UVs, before the parallax search so cut out pixels skip it. The depth pre-pass makes the same test
+    // (see ps_depth-alpha-test), so both agree on which pixels are cut out
+    if (AlbedoMap.Sample(MapSampler, uv).a < 0.25f)  discard;
+
 	/////////////////////////////
     // Linear search for parallax occlusion mapping
 
@@ -78,6 +81,11 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
     float numSamples = lerp(maxSamples, minSamples, abs(vt.z)); // The view vector is in tangent space, so its z value indicates
                                                                 // how much it is pointing directly away from the polygon
 
+    // Distant surfaces use smaller mip-maps of the height map, which have less detail for the ray to find, so halve the samples
+    // for each mip-map level down. Surfaces smaller still use a shader without parallax mapping (see RenderQueue::ShaderLOD)
+    float heightMapLevel = max(DisplacementMap.CalculateLevelOfDetail(MapSampler, uv), 0.0f);
+    numSamples = max(numSamples * exp2(-heightMapLevel), minSamples);
+
     // For each step along the ray direction, find the amount to move the UVs and the amount to descend in the height layer
     float rayHeight = 0.5f; // Current height of ray, 0->1 in the height map layer. Start at the top of the layer
     float heightStep = 1.0 / numSamples; // Amount the ray descends for each step
@@ -130,7 +138,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	// Get normal from normal map
 
 	// Sample the normal map - including conversion from 0->1 RGB values to -1 -> 1 XYZ values
-	float3 tangentNormal = normalize(NormalMap.Sample(MapSampler, uv).xyz * 2.0f - 1.0f);
+	float3 tangentNormal = DecodeNormalMap(NormalMap.Sample(MapSampler, uv));
 
 	// Convert the sampled normal from tangent space (as it was stored) into world space. This becomes the n, the world normal for the PBR equations below
 	float3 n = mul(tangentNormal, tangentMatrix);
@@ -139,9 +147,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	///////////////////////
 	// Sample PBR textures
 
-	float4 albedo4 = AlbedoMap.Sample(MapSampler, uv).rgba;
-    if (albedo4.a < 0.25f)  discard;
-    float3 albedo = albedo4.rgb;
+	float3 albedo = AlbedoMap.Sample(MapSampler, uv).rgb;
 
 	float  roughness = RoughnessMap.Sample(MapSampler, uv).r;
 	float  metalness = MetalnessMap.Sample(MapSampler, uv).r;
@@ -162,17 +168,13 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	// Reflection vector for sampling the cubemap for specular reflections
 	float3 r = reflect(-v, n);
 
-	// Sample environment cubemap, use small mipmap for diffuse, use mipmap based on roughness for specular
-	float3 diffuseIBL = IBLMap.SampleLevel(MapSampler, n, 9).rgb;             // Surface normal to sample diffuse environment light
-	diffuseIBL = (diffuseIBL - 0.5f) * 0.333f + 0.2f;                         // Adjust contrast of environment map
-	float roughnessMip = 8 * log2(roughness + 1);                             // Heuristic to convert roughness to mip-map. Rougher surfaces will use smaller (blurrier) mip-maps
-	float3 specularIBL = IBLMap.SampleLevel(MapSampler, r, roughnessMip).rgb; // Reflected vector to sample specular environment light
+	// Environment light from the maps prefiltered at load: irradiance for diffuse, and for specular the prefiltered map for the
+	// roughness scaled by the split-sum lookup table (see IBL.hlsli)
+	float3 diffuseIBL  = DiffuseIBL(n);
+	float3 specularIBL = SpecularIBL(r, nDotV, specularColour, roughness);
 
-	// Fresnel for IBL: when surface is at more of a glancing angle reflection of the scene increases
-	float3 F_IBL = specularColour + (1 - specularColour) * pow(max(1.0f - nDotV, 0.0f), 5.0f);
-
-	// Overall global illumination - rough approximation
-	float3 colour = baseDiffuse.rgb * albedo * diffuseIBL + (1 - roughness) * specularIBL * F_IBL;
+	// Overall global illumination
+	float3 colour = baseDiffuse.rgb * albedo * diffuseIBL + specularIBL;
 
 
 	///////////////////////
@@ -184,7 +186,7 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	float3 h = normalize(l + v);                // Halfway normal is halfway between camera and light normals
 
 	// Attenuate light colour (reduce strength based on its distance)
-	float3 lc = gLight1Colour.rgb / lightDistance;
+	float3 lc = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
 
 	// Various dot products used throughout
 	float nDotL = max(dot(n, l), 0.001f);
@@ -217,5 +219,8 @@ float4 main(Input input) : SV_Target // Output is a float4 RGBA - which has a sp
 	// Accumulate punctual light equation for this light
 	colour += PI * nDotL * lc * brdf;
 
+	// Then for the clustered lights near this pixel, e.g. missile glows and explosions (see Lights.hlsli)
+	colour += ClusterLightsPBR(input.clipPosition, input.worldPosition, n, v, nDotV, albedo, baseDiffuse.rgb, specularColour, roughness);
+
 	return float4(colour, baseDiffuse.a);
 }
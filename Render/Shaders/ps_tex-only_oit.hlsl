@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Unlit texture, weighted blended transparency version
+//--------------------------------------------------------------------------------------
+// As ps_tex-only but writes the targets of weighted blended transparency (see WeightedOit.hlsli)
+
+#include "Common.hlsli"
+#include "WeightedOit.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+// Textures - order of indexes (t0, t1 etc.) is specified in MeshTypes.h : TextureTypes
+Texture2D DiffuseMap : register(t0);
+
+// Samplers used for above textures
+SamplerState DiffuseFilter : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space, the z is the depth buffer value
+    float2 uv            : uv;            // Texture coordinate for this pixel, used to sample textures
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+OitOutput main(Input input)
+{
+    // Combines colour *and* alpha value from material diffuse colour, diffuse map and per-mesh colour
+    float4 colour = gMaterialDiffuseColour * DiffuseMap.Sample(DiffuseFilter, input.uv) * gMeshColour;
+    return WeightedOit(colour, input.clipPosition.z);
+}
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Upscale the scene
+//--------------------------------------------------------------------------------------
+// Stretches the scene, rendered to the top-left area of the scene texture at a reduced resolution, over the whole back buffer
+// with bilinear filtering (see DynamicResolution.h)
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Textures
+//--------------------------------------------------------------------------------------
+
+// Must match the UpscaleConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer UpscaleConstants : register(b5)
+{
+    float2 gUVScale;  // Fraction of the scene texture covered by the scene
+    float2 gUVMax;    // Centre of the last texel of the scene
+}
+
+Texture2D    SceneTexture : register(t0);
+SamplerState SceneFilter  : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+	float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+	float2 uv            : uv;            // Texture coordinate across the screen
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+	// Clamp so the filter never reads the unused part of the scene texture beyond the scene's edges
+	float2 uv = min(input.uv * gUVScale, gUVMax);
+	return float4(SceneTexture.SampleLevel(SceneFilter, uv, 0).rgb, 1);
+}
@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Water surface, Blinn-Phong lighting of the water texture with the normals of the waves
+//--------------------------------------------------------------------------------------
+// As ps_blinn-1_tex-d, with the colours from the water constants rather than a material. The texture drifts slowly across the
+// surface so the water looks to be moving between the waves too
+
+#include "Common.hlsli"
+#include "Lights.hlsli"
+#include "Shadows.hlsli"
+#include "Water.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+Texture2D    DiffuseMap    : register(t0);
+SamplerState DiffuseFilter : register(s0);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the domain shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;
+    float3 worldPosition : worldPosition;
+    float3 worldNormal   : worldNormal;
+    float2 uv            : uv;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+    float3 worldNormal = normalize(input.worldNormal);
+
+    // Blinn-Phong lighting using the single main light
+    float3 lightVector   = gLight1Position - input.worldPosition;
+    float  lightDistance = length(lightVector);
+    float3 lightNormal   = lightVector / lightDistance;
+    float3 cameraNormal  = normalize(gCameraPosition - input.worldPosition);
+    float3 halfwayNormal = normalize(cameraNormal + lightNormal);
+
+    float3 attenuatedLightColour = gLight1Colour.rgb / lightDistance * SunShadow(input.worldPosition); // Darkened in the shadows of the main light (see Shadows.hlsli)
+    float3 lightDiffuseColour    = attenuatedLightColour * saturate(dot(worldNormal, lightNormal));
+    float3 lightSpecularColour   = lightDiffuseColour * pow(saturate(dot(worldNormal, halfwayNormal)), gWaterSpecularPower);
+
+    // Missile glows and explosions light the water too (see Lights.hlsli)
+    AddClusterLightsBlinn(input.clipPosition, input.worldPosition, worldNormal, cameraNormal, gWaterSpecularPower, lightDiffuseColour, lightSpecularColour);
+
+    float2 drift = float2(0.013f, 0.007f) * gWaterTime;
+    float4 diffuseColour = gWaterDiffuseColour * DiffuseMap.Sample(DiffuseFilter, input.uv + drift);
+    float3 finalColour = diffuseColour.rgb * (gAmbientColour + lightDiffuseColour) + gWaterSpecularColour * lightSpecularColour;
+    return float4(finalColour, 1);
+}
@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// Pixel Shader - Composite weighted blended transparency over the scene
+//--------------------------------------------------------------------------------------
+// Drawn over the scene with alpha blending (see WeightedOit.h). The accumulated colour divided by the accumulated alpha is
+// the weighted average colour of the layers, covering the scene by (1 - revealage), how much the layers together hide it
+
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+
+Texture2D<float4> Accumulation : register(t0);
+Texture2D<float>  Revealage    : register(t1);
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Input
+//--------------------------------------------------------------------------------------
+
+// Data coming in from the vertex shader
+struct Input
+{
+    float4 clipPosition  : SV_Position;   // 2D position of pixel in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate across the screen
+};
+
+
+//--------------------------------------------------------------------------------------
+// Pixel Shader Code
+//--------------------------------------------------------------------------------------
+
+float4 main(Input input) : SV_Target
+{
+    int3 pixel = int3(input.clipPosition.xy, 0);
+    float revealage = Revealage.Load(pixel);
+    if (revealage >= 1.0f)  discard; // No transparent layers here
+
+    // Half floats can overflow to infinity where many near layers are added up
+    float4 accumulation = Accumulation.Load(pixel);
+    if (any(isinf(accumulation)))  accumulation.rgb = accumulation.aaa;
+
+    return float4(accumulation.rgb / max(accumulation.a, 1e-5f), 1 - revealage);
+}
@@ -0,0 +1,123 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - Floating text popups rising from points in the world
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer as a triangle list, DrawInstanced(6 * gMaxGlyphs, numPopups), one instance per popup. The vertex
+// ID selects a glyph of the popup's text and a corner of its quad, quads past the end of the text are collapsed to a point so
+// they draw nothing. The popup's point is raised by its age and projected, then the glyph is placed around it in pixels,
+// centred on the point with the text hanging below it (see FloatingTextRenderer.h)
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Popups
+//--------------------------------------------------------------------------------------
+
+// Must match the FloatingTextConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer FloatingTextConstants : register(b5)
+{
+    float4x4 gViewProjection;
+    float2   gPixelsToClip;   // 2 / viewport width, -2 / viewport height
+    float2   gTexelsToUV;     // 1 / sprite sheet size
+    float    gTime;           // Now, on the clock of the popups' start times
+    float    gLifetime;
+    float    gFadeTime;       // Popups fade out over the end of their lifetime
+    float    gStartHeight;    // Above the popup's point when it starts...
+    float    gRiseHeight;     // ...rising this far over its lifetime
+    float    gLineHeight;     // Pixels between the lines of a stack of popups
+    uint     gMaxGlyphs;
+    float    padding;
+}
+
+// These must match the structures in FloatingTextRenderer in the C++ code
+struct Popup
+{
+    float3 position;
+    float  startTime;
+    uint   text;
+    uint   line;
+    uint   colour;    // RGBA, 8 bits each from the lowest
+    uint   padding;
+};
+
+struct Text
+{
+    uint  firstGlyph;
+    uint  numGlyphs;
+    float width;      // In pixels
+    float padding;
+};
+
+struct Glyph
+{
+    float4 texels;    // Sprite sheet rectangle: left, top, right, bottom in texels
+    float2 offset;    // Relative to the top-left of the text, in pixels
+    float2 padding;
+};
+
+StructuredBuffer<Popup> Popups : register(t0);
+StructuredBuffer<Text>  Texts  : register(t1);
+StructuredBuffer<Glyph> Glyphs : register(t2);
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Output
+//--------------------------------------------------------------------------------------
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate in the font's sprite sheet
+    float4 colour        : colour;        // Colour of the popup, faded by its age
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Corners of the two triangles of a quad, from (0,0) top-left to (1,1) bottom-right
+static const float2 CORNERS[6] = { float2(0, 0), float2(1, 0), float2(0, 1), float2(0, 1), float2(1, 0), float2(1, 1) };
+
+Output main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    Output output;
+    Popup popup = Popups[instanceId];
+    Text  text  = Texts[popup.text];
+
+    // Quads beyond the end of the text all go to the same point, which gives triangles with no area
+    uint glyphIndex = vertexId / 6;
+    if (glyphIndex >= text.numGlyphs)
+    {
+        output.clipPosition = float4(0, 0, 0, 1);
+        output.uv = 0;
+        output.colour = 0;
+        return output;
+    }
+    Glyph glyph = Glyphs[text.firstGlyph + glyphIndex];
+    float2 corner = CORNERS[vertexId % 6];
+
+    // Raise the popup by its age, behind the camera the whole popup is collapsed the same way as the unused quads
+    float age = gTime - popup.startTime;
+    float3 position = popup.position + float3(0, gStartHeight + gRiseHeight * saturate(age / gLifetime), 0);
+    float4 clipPosition = mul(gViewProjection, float4(position, 1));
+    if (clipPosition.w <= 0)
+    {
+        output.clipPosition = float4(0, 0, 0, 1);
+        output.uv = 0;
+        output.colour = 0;
+        return output;
+    }
+
+    // Whole pixels from the projected point, so glyph texels land on screen pixels. Lines of a stack go up the screen
+    float2 pixel = (clipPosition.xy / clipPosition.w - float2(-1, 1)) / gPixelsToClip;
+    pixel = floor(pixel - float2(text.width * 0.5f, popup.line * gLineHeight) + 0.5f);
+    pixel += glyph.offset + corner * (glyph.texels.zw - glyph.texels.xy);
+
+    output.clipPosition = float4(pixel * gPixelsToClip + float2(-1, 1), 0, 1);
+    output.uv = lerp(glyph.texels.xy, glyph.texels.zw, corner) * gTexelsToUV;
+
+    float4 colour = float4(popup.colour & 0xff, (popup.colour >> 8) & 0xff, (popup.colour >> 16) & 0xff, popup.colour >> 24) / 255.0f;
+    output.colour = colour * saturate((gLifetime - age) / gFadeTime); // Additive blending, so a fade is a darker colour
+
+    return output;
+}
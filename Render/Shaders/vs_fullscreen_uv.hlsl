@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - Triangle covering the whole viewport
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer, Draw(3, 0), the vertex ID selects the corner. The triangle extends past the viewport so its
+// visible part is exactly the screen, with UVs from (0,0) top-left to (1,1) bottom-right. Used to copy a texture onto the
+// render target, e.g. upscaling the scene (see DynamicResolution.h)
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Output
+//--------------------------------------------------------------------------------------
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate across the screen
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+Output main(uint vertexId : SV_VertexID)
+{
+    Output output;
+
+    // UVs (0,0), (2,0), (0,2) give a triangle twice the width and height of the screen
+    output.uv = float2((vertexId << 1) & 2, vertexId & 2);
+    output.clipPosition = float4(output.uv.x * 2 - 1, 1 - output.uv.y * 2, 0, 1);
+
+    return output;
+}
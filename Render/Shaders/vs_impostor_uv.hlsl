@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - Impostors, distant entities drawn as a quad showing a baked view of their mesh
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer as a triangle strip, DrawInstanced(4, numImpostors), one instance per impostor. The direction to
+// the camera is taken into the entity's root space and the nearest view in the hemi-octahedral atlas chosen, then the quad is
+// built facing along that view's direction so it lines up with the view as it was baked (see ImpostorRenderer.h)
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Instances
+//--------------------------------------------------------------------------------------
+
+// Must match the ImpostorConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer ImpostorConstants : register(b5)
+{
+    uint  gGridSize;      // Views along each side of the atlas
+    uint  gFirstInstance; // Of this draw in the instance buffer
+    float2 padding;
+}
+
+// Must match the Instance structure in ImpostorRenderer in the C++ code
+struct Instance
+{
+    float3 centre;     // World bounding sphere
+    float  radius;
+    float3 xAxis;      // Unit axes of the entity's root world matrix
+    uint   colour;     // RGBA, 8 bits each from the lowest
+    float3 yAxis;
+    float  padding0;
+    float3 zAxis;
+    float  padding1;
+};
+
+StructuredBuffer<Instance> Instances : register(t0);
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Output
+//--------------------------------------------------------------------------------------
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate in the atlas
+    float4 colour        : colour;        // Tint of the entity
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// The direction a cell of the atlas was baked from, in root space, must match CellDirection in ImpostorRenderer.cpp. The cell
+// centre is a point of the [-1,1] square, which folds onto the upper half of an octahedron
+float3 CellDirection(uint2 cell)
+{
+    float2 square = (cell + 0.5f) / gGridSize * 2 - 1;
+    float2 xz = float2(square.x + square.y, square.x - square.y) * 0.5f;
+    return normalize(float3(xz.x, 1 - abs(xz.x) - abs(xz.y), xz.y));
+}
+
+// The up vector of the view along a direction, as in CellBasis in ImpostorRenderer.cpp: the root Y axis unless looking
+// straight down, then the Z axis
+float3 CellUp(float3 direction)
+{
+    float3 up = (direction.y < 0.999f) ? float3(0, 1, 0) : float3(0, 0, 1);
+    return normalize(up - direction * dot(up, direction));
+}
+
+Output main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    Output output;
+    Instance instance = Instances[gFirstInstance + instanceId];
+
+    // The direction to the camera in root space, views from below use the horizon
+    float3 toCamera = gCameraPosition - instance.centre;
+    float3 local = float3(dot(toCamera, instance.xAxis), dot(toCamera, instance.yAxis), dot(toCamera, instance.zAxis));
+    local.y = max(local.y, 0);
+
+    // Nearest cell of the hemi-octahedral grid
+    float2 xz = local.xz / max(abs(local.x) + local.y + abs(local.z), 1e-6f);
+    float2 square = float2(xz.x + xz.y, xz.x - xz.y);
+    uint2 cell = min(uint2(saturate(square * 0.5f + 0.5f) * gGridSize), gGridSize - 1);
+
+    // The quad faces along the cell's direction, with its right and up as when the cell was baked
+    float3 direction = CellDirection(cell);
+    float3 up        = CellUp(direction);
+    float3 right     = cross(up, -direction);
+    float3x3 rootToWorld = float3x3(instance.xAxis, instance.yAxis, instance.zAxis);
+    up    = mul(up,    rootToWorld);
+    right = mul(right, rootToWorld);
+
+    // Strip corners from (0,0) top-left to (1,1) bottom-right
+    float2 corner = float2(vertexId & 1, vertexId >> 1);
+    float3 position = instance.centre + (right * (corner.x * 2 - 1) + up * (1 - corner.y * 2)) * instance.radius;
+    output.clipPosition = mul(gViewProjectionMatrix, float4(position, 1));
+    output.uv = (cell + corner) / gGridSize;
+
+    output.colour = float4(instance.colour & 0xff, (instance.colour >> 8) & 0xff, (instance.colour >> 16) & 0xff, instance.colour >> 24) / 255.0f;
+    return output;
+}
@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - Glyph quads of text labels
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer as a triangle strip, DrawInstanced(4, numGlyphs), one instance per glyph. The instance ID selects
+// the glyph from a structured buffer and the vertex ID the corner of its quad. Glyphs are positioned in pixels and their sprite
+// sheet rectangles are in texels, the constants convert both (see LabelRenderer.h)
+
+
+//--------------------------------------------------------------------------------------
+// Constant Buffers and Glyphs
+//--------------------------------------------------------------------------------------
+
+// Must match the LabelConstants structure in the C++ code. Slot 5 keeps clear of the buffers in Common.hlsli
+cbuffer LabelConstants : register(b5)
+{
+    float2 gPixelsToClip;  // 2 / viewport width, -2 / viewport height
+    float2 gTexelsToUV;    // 1 / sprite sheet size
+}
+
+// Must match LabelRenderer::GlyphInstance in the C++ code
+struct GlyphInstance
+{
+    float4 texels;    // Sprite sheet rectangle: left, top, right, bottom in texels
+    float2 position;  // Top-left corner on the screen in pixels
+    uint   colour;    // RGBA, 8 bits each from the lowest
+    uint   padding;
+};
+
+StructuredBuffer<GlyphInstance> Glyphs : register(t0);
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Output
+//--------------------------------------------------------------------------------------
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Texture coordinate in the font's sprite sheet
+    float4 colour        : colour;        // Colour of the label
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+Output main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    GlyphInstance glyph = Glyphs[instanceId];
+    Output output;
+
+    // Corners (0,0), (1,0), (0,1), (1,1) in strip order
+    float2 corner = float2(vertexId & 1, vertexId >> 1);
+    float2 texels = lerp(glyph.texels.xy, glyph.texels.zw, corner);
+    float2 pixel  = glyph.position + corner * (glyph.texels.zw - glyph.texels.xy);
+
+    output.clipPosition = float4(pixel * gPixelsToClip + float2(-1, 1), 0, 1);
+    output.uv = texels * gTexelsToUV;
+    output.colour = float4(glyph.colour & 0xff, (glyph.colour >> 8) & 0xff, (glyph.colour >> 16) & 0xff, glyph.colour >> 24) / 255.0f;
+
+    return output;
+}
@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Instanced Vertex Shader - Transform position into clip space only
+//--------------------------------------------------------------------------------------
+// Version of vs_p_p2c for instanced rendering: the world matrix comes from the instance buffer (see Mesh::RenderInstanced)
+// rather than the per-mesh constants, so one draw call renders many copies of a sub-mesh
+// Version of vs_p_ip2c for meshes imported with ImportFlags::CompressVertices (see Mesh.h). Positions may be 16-bit values
+// that are restored with the material's position scale and offset
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Input/Output
+//--------------------------------------------------------------------------------------
+
+// Input to shader - each vertex has this data, along with the data for the instance being rendered
+struct Input
+{
+    float3 position : position; // XYZ position of vertex in model space, before the position scale and offset
+    float4 worldRow0 : instanceWorld0; // World matrix of this instance, one row at a time
+    float4 worldRow1 : instanceWorld1;
+    float4 worldRow2 : instanceWorld2;
+    float4 worldRow3 : instanceWorld3;
+};
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Vertex shader gets vertices from the mesh one at a time, processes each one and passes the resultant data on to the pixel shader
+Output main(Input modelVertex)
+{
+    Output output; // Output data expected from this shader
+
+    // Decode the compressed vertex: the position scale and offset are 1 and 0 if positions weren't compressed
+    // Input vertex position is x,y,z only - need a 4th element to multiply by a 4x4 matrix. Use 1 for a point, 0 for a vector - recall lectures
+    float4 modelPosition = float4(modelVertex.position * gPositionScale + gPositionOffset, 1);
+
+    // The rows are in the same layout as in the C++ Matrix4x4, so the matrix is used with the vector on the left. The opposite
+    // way round from gWorldMatrix, which arrives transposed through the constant buffer
+    float4x4 worldMatrix = float4x4(modelVertex.worldRow0, modelVertex.worldRow1, modelVertex.worldRow2, modelVertex.worldRow3);
+
+    // Multiply position and normal by the world matrix to transform vertex into world space
+    float4 worldPosition = mul(modelPosition, worldMatrix);
+
+    // Use combined view-projection matrix (camera matrices) to transform vertex into 2D clip space, pass on to pixel shader
+    // Precise so every shader gives exactly the same depth for a vertex, needed by the depth pre-pass (see DepthState::DepthEqual)
+    precise float4 clipPosition = mul(gViewProjectionMatrix, worldPosition);
+    output.clipPosition = clipPosition;
+
+    return output; // Ouput data sent down the pipeline (to the pixel shader)
+}
@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - GPU particles, a camera facing quad for each live particle
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer as a triangle strip, DrawInstancedIndirect with 4 vertices and one instance per live particle, the
+// instance count having been copied from the alive list on the GPU (see ParticleSystem.h). The quad lies in the camera's plane,
+// growing a little over the particle's life while its colour brightens in quickly and fades out
+
+#include "Common.hlsli"
+#define PARTICLE_STRUCTURES_ONLY
+#include "Particles.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+
+StructuredBuffer<Particle> gParticles : register(t0);
+StructuredBuffer<uint>     gAliveList : register(t1);
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Output
+//--------------------------------------------------------------------------------------
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float2 uv            : uv;            // Position in the quad, -1 to 1 across it
+    float4 colour        : colour;        // Colour of the particle at its age, already faded
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+Output main(uint vertexId : SV_VertexID, uint instanceId : SV_InstanceID)
+{
+    Output output;
+    Particle particle = gParticles[gAliveList[instanceId]];
+
+    // The camera's right and up axes, the X and Y axes of its world matrix
+    float3 right = gCameraMatrix._11_21_31;
+    float3 up    = gCameraMatrix._12_22_32;
+
+    // Strip corners from (-1,1) top-left to (1,-1) bottom-right
+    float2 corner = float2((vertexId & 1) * 2.0f - 1, 1 - (vertexId >> 1) * 2.0f);
+    float  life   = saturate(particle.age / particle.lifetime);
+    float  size   = particle.size * (0.5f + life);
+    float3 position = particle.position + (right * corner.x + up * corner.y) * size;
+    output.clipPosition = mul(gViewProjectionMatrix, float4(position, 1));
+    output.uv = corner;
+
+    float4 colour = float4(particle.colour & 0xff, (particle.colour >> 8) & 0xff, (particle.colour >> 16) & 0xff, particle.colour >> 24) / 255.0f;
+    float  fade   = saturate(life * 10) * (1 - life);
+    output.colour = float4(colour.rgb * colour.a * fade, 1);
+    return output;
+}
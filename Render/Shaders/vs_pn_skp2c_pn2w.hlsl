@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Skinned Vertex Shader - Transform position into clip space; position and normal into world space
+//--------------------------------------------------------------------------------------
+// Version of vs_pn_p2c_pn2w for skinned meshes: each vertex is transformed by the blend of the bone matrices that influence it,
+// read from the bone palette (see SkinningMatrix in Common.hlsli and Mesh::WriteBones) rather than by gWorldMatrix. Instances of
+// a skinned mesh drawn together find their own bones from SV_InstanceID (see Mesh::RenderSkinnedInstanced)
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Vertex Shader Input/Output
+//--------------------------------------------------------------------------------------
+
+// Input to shader - each vertex has this data
+struct Input
+{
+    float3 position : position; // XYZ position of vertex in model space
+    float3 normal   : normal;   // XYZ normal at vertex in model space
+    uint4  bones    : bones;    // Indices of up to four bones influencing this vertex
+    float4 weights  : weights;  // How much each of those bones influences the vertex, adding up to 1
+    uint   instance : SV_InstanceID;
+};
+
+// Output from shader - passed on to pixel shader
+struct Output
+{
+    float4 clipPosition  : SV_Position;   // 2D position of vertex in clip space - this key field is identified by the special semantic "SV_Position" (SV = System Value)
+    float3 worldPosition : worldPosition; // 3D position of vertex in world space - used for lighting
+    float3 worldNormal   : worldNormal;   // The surface normal (in world space) for vertex pixel - used for lighting
+};
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Vertex shader gets vertices from the mesh one at a time, processes each one and passes the resultant data on to the pixel shader
+Output main(Input modelVertex)
+{
+    Output output; // Output data expected from this shader
+
+    // The blended bone matrix goes from model space straight to world space. It is a row-vector matrix like the C++ ones, so
+    // the vector goes on the left, the opposite way round from gWorldMatrix
+    float4x3 skinMatrix = SkinningMatrix(modelVertex.bones, modelVertex.weights, modelVertex.instance);
+
+    // Input vertex position and normal are x,y,z only - need a 4th element to multiply by the matrix. Use 1 for a point, 0 for a vector - recall lectures
+    // Transform position and normal into world space - pass this data on the the pixel shader for lighting calculations
+    float4 worldPosition = float4(mul(float4(modelVertex.position, 1), skinMatrix), 1);
+    output.worldPosition = worldPosition.xyz;
+    output.worldNormal   = mul(float4(modelVertex.normal, 0), skinMatrix);
+
+    // Use combined view-projection matrix (camera matrices) to transform vertex into 2D clip space, also pass on to pixel shader
+    // Precise so every shader gives exactly the same depth for a vertex, needed by the depth pre-pass (see DepthState::DepthEqual)
+    precise float4 clipPosition = mul(gViewProjectionMatrix, worldPosition);
+    output.clipPosition = clipPosition;
+
+    return output; // Ouput data sent down the pipeline (to the pixel shader)
+}
@@ -46,7 +46,9 @@ Output main(Input modelVertex)
     output.worldNormal   = mul(gWorldMatrix, modelNormal).xyz;
 
     // Use combined view-projection matrix (camera matrices) to transform vertex into 2D clip space, also pass on to pixel shader
-    output.clipPosition = mul(gViewProjectionMatrix, worldPosition);
+    // Precise so every shader gives exactly the same depth for a vertex, needed by the depth pre-pass (see DepthState::DepthEqual)
+    precise float4 clipPosition = mul(gViewProjectionMatrix, worldPosition);
+    output.clipPosition = clipPosition;
 
     // Pass texture coordinates (UVs) straigh on to the pixel shader, the vertex shader doesn't need them
     output.uv = modelVertex.uv;
@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------------------------
+// Vertex Shader - Water surface, the corners of the camera-centred grid of patches
+//--------------------------------------------------------------------------------------
+// Drawn with no vertex buffer as a 4 control point patch list, 4 vertices per patch (see WaterRenderer.h). Each vertex is a patch
+// corner on the flat water plane, the hull shader tessellates the patch and the domain shader adds the waves
+
+#include "Common.hlsli"
+#include "Water.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+WaterControlPoint main(uint vertexId : SV_VertexID)
+{
+    WaterControlPoint output;
+
+    // Corners of each patch in the order (0,0) (1,0) (0,1) (1,1), patches row by row
+    uint patch = vertexId / 4;
+    uint2 corner = uint2(patch % gGridPatches, patch / gGridPatches) + uint2(vertexId & 1, (vertexId >> 1) & 1);
+    output.worldPosition = WaterGridPosition(corner);
+    return output;
+}
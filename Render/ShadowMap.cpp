@@ -0,0 +1,197 @@
+//--------------------------------------------------------------------------------------
+// Shadow map - shadows of the main light, with the static scenery's shadows cached between frames
+//--------------------------------------------------------------------------------------
+
+#include "ShadowMap.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "CBuffer.h"
+#include "State.h"
+
+#include <cmath>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the maps, sampler and constants. Throws std::runtime_error on failure
+ShadowMap::ShadowMap()
+{
+	if (!CreateMap(mStaticTexture, mStaticDepth, nullptr) || !CreateMap(mDynamicTexture, mDynamicDepth, &mDynamicView))
+		throw std::runtime_error("Shadow map: failure creating shadow maps");
+
+	// Bilinear comparison filtering, the four texels around a point each compared and the results blended. Outside the map is lit
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.Filter         = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+	samplerDesc.AddressU       = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressV       = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.AddressW       = D3D11_TEXTURE_ADDRESS_BORDER;
+	samplerDesc.BorderColor[0] = 1.0f;
+	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+	samplerDesc.MaxLOD         = D3D11_FLOAT32_MAX;
+	if (FAILED(DX->Device()->CreateSamplerState(&samplerDesc, &mSampler)))
+		throw std::runtime_error("Shadow map: failure creating sampler");
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(ShadowConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Shadow map: failure creating constant buffer");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Update the shadow map for a frame, rendering the static map first if it is out of date, then copying it to the dynamic map
+// and rendering the moving casters over it
+void ShadowMap::Render(const Vector3& lightPosition, const Vector3& focus, uint64_t staticVersion, const RenderCasters& renderCasters)
+{
+	auto context = DX->Context();
+
+	// The dynamic map is rendered to below, so it can't stay bound for the pixel shaders meanwhile
+	ID3D11ShaderResourceView* noView = nullptr;
+	context->PSSetShaderResources(SHADOW_MAP_SLOT, 1, &noView);
+	if (!mEnabled)
+	{
+		mStaticValid = false;
+		mStats.dynamicCasters = 0;
+		Bind();
+		return;
+	}
+
+	Vector3 centre = { std::round(focus.x / SNAP_DISTANCE) * SNAP_DISTANCE, 0, std::round(focus.z / SNAP_DISTANCE) * SNAP_DISTANCE };
+	auto samePoint = [](const Vector3& a, const Vector3& b) { return a.x == b.x && a.y == b.y && a.z == b.z; };
+	bool renderStatic = !mStaticValid || staticVersion != mStaticVersion ||
+	                    !samePoint(centre, mCentre) || !samePoint(lightPosition, mLightPosition);
+	if (renderStatic)  SetLightView(lightPosition, centre);
+
+	// Keep what is set now to put it back afterwards
+	CComPtr<ID3D11RenderTargetView> previousTarget;
+	CComPtr<ID3D11DepthStencilView> previousDepth;
+	context->OMGetRenderTargets(1, &previousTarget, &previousDepth);
+	D3D11_VIEWPORT previousViewports[D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE];
+	UINT numPreviousViewports = D3D11_VIEWPORT_AND_SCISSORRECT_OBJECT_COUNT_PER_PIPELINE;
+	context->RSGetViewports(&numPreviousViewports, previousViewports);
+	PerCameraConstants previousCamera = gPerCameraConstants;
+	bool            previousDepthOnly       = RenderState::DepthOnly();
+	RasterizerState previousRasterizerState = DX->States()->GetRasterizerState();
+	DepthState      previousDepthState      = DX->States()->GetDepthState();
+	BlendState      previousBlendState      = DX->States()->GetBlendState();
+
+	gPerCameraConstants.cameraMatrix         = mLightMatrix;
+	gPerCameraConstants.viewMatrix           = mViewMatrix;
+	gPerCameraConstants.projectionMatrix     = mProjectionMatrix;
+	gPerCameraConstants.viewProjectionMatrix = mConstants.viewProjectionMatrix;
+	gPerCameraConstants.cameraPosition       = mLightMatrix.Position();
+	DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, static_cast<float>(MAP_SIZE), static_cast<float>(MAP_SIZE), 0.0f, 1.0f };
+	context->RSSetViewports(1, &viewport);
+	RenderState::SetDepthOnly(true);
+	DX->States()->SetRasterizerState(RasterizerState::CullBack);
+	DX->States()->SetDepthState(DepthState::DepthOn);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+
+	if (renderStatic)
+	{
+		context->ClearDepthStencilView(mStaticDepth, D3D11_CLEAR_DEPTH, 1.0f, 0);
+		context->OMSetRenderTargets(0, nullptr, mStaticDepth);
+		mStats.staticCasters = renderCasters(mFrustum, true);
+		++mStats.staticRenders;
+
+		mStaticValid   = true;
+		mStaticVersion = staticVersion;
+		mCentre        = centre;
+		mLightPosition = lightPosition;
+	}
+
+	// Start from the static casters' depths, a copy on the GPU, and add the moving casters
+	context->OMSetRenderTargets(0, nullptr, nullptr);
+	context->CopyResource(mDynamicTexture, mStaticTexture);
+	context->OMSetRenderTargets(0, nullptr, mDynamicDepth);
+	mStats.dynamicCasters = renderCasters(mFrustum, false);
+
+	context->OMSetRenderTargets(1, &previousTarget.p, previousDepth);
+	context->RSSetViewports(numPreviousViewports, previousViewports);
+	gPerCameraConstants = previousCamera;
+	DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+	RenderState::SetDepthOnly(previousDepthOnly);
+	DX->States()->SetRasterizerState(previousRasterizerState);
+	DX->States()->SetDepthState(previousDepthState);
+	DX->States()->SetBlendState(previousBlendState);
+
+	Bind();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Create a depth texture with a depth stencil view and optionally a shader resource view on it. The texture is typeless so it
+// can be viewed both ways. Returns false on failure
+bool ShadowMap::CreateMap(CComPtr<ID3D11Texture2D>& texture, CComPtr<ID3D11DepthStencilView>& depthView,
+                          CComPtr<ID3D11ShaderResourceView>* shaderView)
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = MAP_SIZE;
+	textureDesc.Height           = MAP_SIZE;
+	textureDesc.MipLevels        = 1;
+	textureDesc.ArraySize        = 1;
+	textureDesc.Format           = DXGI_FORMAT_R32_TYPELESS;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+	if (FAILED(DX->Device()->CreateTexture2D(&textureDesc, nullptr, &texture)))  return false;
+
+	D3D11_DEPTH_STENCIL_VIEW_DESC depthDesc = {};
+	depthDesc.Format        = DXGI_FORMAT_D32_FLOAT;
+	depthDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+	if (FAILED(DX->Device()->CreateDepthStencilView(texture, &depthDesc, &depthView)))  return false;
+
+	if (shaderView == nullptr)  return true;
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format              = DXGI_FORMAT_R32_FLOAT;
+	srvDesc.ViewDimension       = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = 1;
+	return SUCCEEDED(DX->Device()->CreateShaderResourceView(texture, &srvDesc, &*shaderView));
+}
+
+
+// Set the light's view and the shadow constants for an area centred at the given point. The view looks from the light's
+// direction, SHADOW_DEPTH back from the centre, and is orthographic as the light is far enough away for its rays to be parallel
+// across the area
+void ShadowMap::SetLightView(const Vector3& lightPosition, const Vector3& centre)
+{
+	Vector3 direction = Normalise(centre - lightPosition);
+	mLightMatrix = Matrix4x4(centre - direction * SHADOW_DEPTH);
+	mLightMatrix.FaceDirection(direction);
+	mViewMatrix = InverseAffine(mLightMatrix);
+
+	// Depth is linear from 0 at the view to 1 at twice SHADOW_DEPTH, so the bias is the same everywhere in the map
+	float depthRange = 2 * SHADOW_DEPTH;
+	mProjectionMatrix = { 1 / SHADOW_RANGE, 0.0f,             0.0f,              0.0f,
+	                      0.0f,             1 / SHADOW_RANGE, 0.0f,              0.0f,
+	                      0.0f,             0.0f,             1 / depthRange,    0.0f,
+	                      0.0f,             0.0f,             0.0f,              1.0f };
+	mConstants.viewProjectionMatrix = mViewMatrix * mProjectionMatrix;
+	mConstants.texelSize = 1.0f / MAP_SIZE;
+	mConstants.depthBias = DEPTH_BIAS / depthRange;
+	mFrustum = Frustum(mConstants.viewProjectionMatrix);
+}
+
+
+// Bind the dynamic map, sampler and constants for the pixel shaders. Nothing is bound to the map's slot when shadows are off,
+// the constants then tell the shaders not to read it
+void ShadowMap::Bind()
+{
+	auto context = DX->Context();
+	mConstants.enabled = mEnabled ? 1 : 0;
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+	DX->CBuffers()->EnableCBuffer(mConstantBuffer, CBUFFER_SLOT);
+	ID3D11ShaderResourceView* view = mEnabled ? mDynamicView.p : nullptr;
+	context->PSSetShaderResources(SHADOW_MAP_SLOT, 1, &view);
+	context->PSSetSamplers(SAMPLER_SLOT, 1, &mSampler.p);
+}
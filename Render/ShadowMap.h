@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// Shadow map - shadows of the main light, with the static scenery's shadows cached between frames
+//--------------------------------------------------------------------------------------
+// The main light is the sun, far from the play area, so its shadows are rendered with an orthographic view looking from it at a
+// square SHADOW_RANGE either side of the camera. Most shadow casters are islands, pillars and other scenery that never move, and
+// rendering them every frame would cost as much as the main view's depth pre-pass. So they are rendered into a static map that
+// is kept, and each frame that map is copied on the GPU into the dynamic map and only the moving entities (boats, missiles,
+// crates) are rendered on top of it. The static map is rendered again only when it is out of date: the camera has moved into
+// another square of SNAP_DISTANCE (the area is centred on that square so it doesn't follow the camera every frame, which would
+// also make the shadow edges crawl), the light has moved, or static entities have been added or removed (see
+// EntityManager::GetStaticVersion).
+//
+// The dynamic map is bound to the pixel shader slot SHADOW_MAP_SLOT with a comparison sampler and the constants to CBUFFER_SLOT,
+// outside the slots of the material textures, so they stay bound for every draw and are inherited by the render queue's deferred
+// contexts. The Blinn, PBR and water pixel shaders darken the main light by SunShadow (see Shadows.hlsli) with 3x3 percentage
+// closer filtering. The casters are drawn by the caller with the light's view set, depth only:
+//
+//   shadowMap.Render(lightPosition, camera->Transform().Position(), gEntityManager->GetStaticVersion(),
+//       [&](const Frustum& frustum, bool staticCasters) { ...render static or moving entities in the frustum... });
+//
+// Once a frame, before the views that show the shadows. Render puts back the render targets, viewport, camera constants and
+// render states it changes
+
+#ifndef _SHADOW_MAP_H_INCLUDED_
+#define _SHADOW_MAP_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Matrix4x4.h"
+#include "Frustum.h"
+#include "CBufferTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <functional>
+#include <stdint.h>
+
+
+class ShadowMap
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Texels along each side of the maps
+	static constexpr uint32_t MAP_SIZE = 2048;
+
+	// World units from the centre of the shadowed area to its sides, and the step the centre moves in as the camera moves
+	static constexpr float SHADOW_RANGE  = 1500.0f;
+	static constexpr float SNAP_DISTANCE = SHADOW_RANGE / 4;
+
+	// World units from the centre of the area back towards the light to the light's view, its depth range is twice this. Casters
+	// further towards the light than this cast no shadow
+	static constexpr float SHADOW_DEPTH = 4000.0f;
+
+	// World units a surface must be behind the nearest caster to be in shadow, so surfaces don't shadow themselves
+	static constexpr float DEPTH_BIAS = 1.0f;
+
+	// Pixel shader slots of the shadow map and its sampler, and of the shadow constants. Must match the registers in Shadows.hlsli
+	static constexpr unsigned int SHADOW_MAP_SLOT = 15;
+	static constexpr unsigned int SAMPLER_SLOT    = 9;
+	static constexpr unsigned int CBUFFER_SLOT    = 7;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the maps, sampler and constants. Throws std::runtime_error on failure
+	ShadowMap();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Draws the shadow casters into the current depth target, depth only, with the light's view set. Given the light's frustum and
+	// whether to draw the static casters or the moving ones. Returns the number of entities drawn, for the stats
+	using RenderCasters = std::function<uint32_t(const Frustum& frustum, bool staticCasters)>;
+
+	// Update the shadow map for a frame, for the given light position and the point the shadowed area is centred around (the
+	// camera). The static casters are drawn only if the static map is out of date (see top of file), the moving casters every
+	// time. Binds the map and constants for the pixel shaders of the draws that follow
+	void Render(const Vector3& lightPosition, const Vector3& focus, uint64_t staticVersion, const RenderCasters& renderCasters);
+
+	// Whether shadows are rendered, when off the pixel shaders treat everything as lit. Turning them on renders the static map again
+	bool& Enabled()  { return mEnabled; }
+
+	// Render the static map again next frame, e.g. after the static entities have been changed in a way their version doesn't show
+	void Invalidate()  { mStaticValid = false; }
+
+	// Times the static map has been rendered, and the entities drawn into it the last time, and the moving entities drawn over it
+	// in the last frame
+	struct Stats
+	{
+		uint32_t staticRenders  = 0;
+		uint32_t staticCasters  = 0;
+		uint32_t dynamicCasters = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Create a depth texture with a depth stencil view and a shader resource view on it. Returns false on failure
+	bool CreateMap(CComPtr<ID3D11Texture2D>& texture, CComPtr<ID3D11DepthStencilView>& depthView,
+	               CComPtr<ID3D11ShaderResourceView>* shaderView);
+
+	// Set the light's view and the shadow constants for an area centred at the given point
+	void SetLightView(const Vector3& lightPosition, const Vector3& centre);
+
+	// Bind the dynamic map, sampler and constants for the pixel shaders, the map only if shadows are enabled
+	void Bind();
+
+	bool  mEnabled = true;
+	Stats mStats;
+
+	// The static map shows the static casters for this light position, area centre and static version when valid
+	bool     mStaticValid   = false;
+	Vector3  mLightPosition = { 0, 0, 0 };
+	Vector3  mCentre        = { 0, 0, 0 };
+	uint64_t mStaticVersion = 0;
+
+	// The light's view of the area
+	Matrix4x4 mLightMatrix;    // World matrix of the light's view
+	Matrix4x4 mViewMatrix;
+	Matrix4x4 mProjectionMatrix;
+	Frustum   mFrustum = Frustum(Matrix4x4::Identity);
+
+	ID3D11Buffer*   mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	ShadowConstants mConstants;
+
+	CComPtr<ID3D11Texture2D>          mStaticTexture;
+	CComPtr<ID3D11DepthStencilView>   mStaticDepth;
+	CComPtr<ID3D11Texture2D>          mDynamicTexture;
+	CComPtr<ID3D11DepthStencilView>   mDynamicDepth;
+	CComPtr<ID3D11ShaderResourceView> mDynamicView;
+	CComPtr<ID3D11SamplerState>       mSampler;
+};
+
+
+#endif //_SHADOW_MAP_H_INCLUDED_
@@ -10,6 +10,7 @@
 // States can be set at render time with a simple call specifying an enum value RenderState.
 
 #include "State.h"
+#include "RenderCounters.h"
 
 #include <stdexcept>
 
@@ -137,6 +138,34 @@ StateManager::StateManager(ID3D11Device* device, ID3D11DeviceContext* context)
     mDepthStates[DepthState::DepthReadOnly] = newDepthState;
 
 
+    ////-------- Enable depth buffer reads only, passing at equal depth --------////
+    // As above but pixels at exactly the depth already in the buffer pass, used to draw geometry that is already in the depth buffer again
+    newDepthState = {};
+    depthStencilDesc.DepthEnable = TRUE;
+    depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+    depthStencilDesc.StencilEnable = FALSE;
+    if (FAILED(mDXDevice->CreateDepthStencilState(&depthStencilDesc, &newDepthState)))
+    {
+        throw std::runtime_error("Error creating depth-read-only-less-equal state");
+    }
+    mDepthStates[DepthState::DepthReadOnlyLessEqual] = newDepthState;
+
+
+    ////-------- Enable depth buffer reads only, passing only at equal depth --------////
+    // Only the nearest surface at each pixel passes once a depth pre-pass has filled the buffer, so each pixel is shaded once
+    newDepthState = {};
+    depthStencilDesc.DepthEnable = TRUE;
+    depthStencilDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+    depthStencilDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+    depthStencilDesc.StencilEnable = FALSE;
+    if (FAILED(mDXDevice->CreateDepthStencilState(&depthStencilDesc, &newDepthState)))
+    {
+        throw std::runtime_error("Error creating depth-equal state");
+    }
+    mDepthStates[DepthState::DepthEqual] = newDepthState;
+
+
     ////-------- Disable depth buffer --------////
     // Entirely disable depth buffer, rendering will draw over everything
     newDepthState = {};
@@ -220,6 +249,29 @@ StateManager::StateManager(ID3D11Device* device, ID3D11DeviceContext* context)
         throw std::runtime_error("Error creating alpha blending state");
     }
     mBlendStates[BlendState::BlendAlpha] = newBlendState;
+
+
+    ////-------- Weighted Blended Transparency State --------////
+    // Each render target is blended differently (see WeightedOit.h). The first ADDs up the weighted colours *and* alphas, so its
+    // alpha is blended too. The second multiplies what is on screen by (1 - the source), the product of (1 - alpha) of every layer
+    newBlendState = {};
+    blendDesc.IndependentBlendEnable = TRUE;
+    blendDesc.RenderTarget[0].BlendEnable    = TRUE;
+    blendDesc.RenderTarget[0].SrcBlend       = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].DestBlend      = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].BlendOp        = D3D11_BLEND_OP_ADD;
+    blendDesc.RenderTarget[0].SrcBlendAlpha  = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+    blendDesc.RenderTarget[1] = blendDesc.RenderTarget[0];
+    blendDesc.RenderTarget[1].SrcBlend       = D3D11_BLEND_ZERO;
+    blendDesc.RenderTarget[1].DestBlend      = D3D11_BLEND_INV_SRC_COLOR;
+    blendDesc.RenderTarget[1].SrcBlendAlpha  = D3D11_BLEND_ZERO;
+    blendDesc.RenderTarget[1].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+    if (FAILED(mDXDevice->CreateBlendState(&blendDesc, &newBlendState)))
+    {
+        throw std::runtime_error("Error creating weighted blended transparency state");
+    }
+    mBlendStates[BlendState::BlendWeightedOit] = newBlendState;
 }
 
 
@@ -239,6 +291,7 @@ bool StateManager::SetRasterizerState(RasterizerState state)
     auto newState = mRasterizerStates[state];
     mDXContext->RSSetState(newState);
     mCurrentRasterizerState = state;
+    gRenderCounters.Add(RenderCounter::RasterizerChanges);
     return true;
 }
 
@@ -254,12 +307,15 @@ bool StateManager::SetDepthState(DepthState state)
     auto newState = mDepthStates[state];
     mDXContext->OMSetDepthStencilState(newState, 0);
     mCurrentDepthState = state;
+    gRenderCounters.Add(RenderCounter::DepthChanges);
     return true;
 }
 
 // Enable the given blend state. Returns true on success. If it fails, use GetLastError to get a description of the error
 bool StateManager::SetBlendState(BlendState state)
 {
+    mRequestedBlendState = state;
+    if (mBlendOverride)  state = *mBlendOverride;
     if (mCurrentBlendState == state)   return true;
     if (!mBlendStates.contains(state))
     {
@@ -269,10 +325,20 @@ bool StateManager::SetBlendState(BlendState state)
     auto newState = mBlendStates[state];
     mDXContext->OMSetBlendState(newState, nullptr, 0xffffff);
     mCurrentBlendState = state;
+    gRenderCounters.Add(RenderCounter::BlendChanges);
     return true;
 }
 
 
+// Keep the given blend state whatever SetBlendState is asked for, until called with std::nullopt
+void StateManager::OverrideBlendState(std::optional<BlendState> state)
+{
+    if (!mBlendOverride)  mRequestedBlendState = mCurrentBlendState; // Without an override the state set is the one asked for
+    mBlendOverride = state;
+    SetBlendState(mRequestedBlendState); // Sets the override if there is one
+}
+
+
 //--------------------------------------------------------------------------------------
 // Static private data
 //--------------------------------------------------------------------------------------
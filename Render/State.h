@@ -17,6 +17,7 @@
 #include <atlbase.h> // For CComPtr (see member variables)
 
 #include <map>
+#include <optional>
 #include <string>
 
 
@@ -44,6 +45,8 @@ enum class DepthState
 	//// Depth Stencil states
 	DepthOn, // Default
 	DepthReadOnly,
+	DepthReadOnlyLessEqual, // As above but also passes at equal depth, to draw geometry again over itself (e.g. entity IDs for picking)
+	DepthEqual,             // Read only and passes only at exactly the depth in the buffer, for the colour pass after a depth pre-pass
 	DepthOff,
 };
 
@@ -54,6 +57,7 @@ enum class BlendState
 	BlendAdditive,
 	BlendMultiplicative,
 	BlendAlpha,
+	BlendWeightedOit, // Two render targets, the accumulation and revealage of weighted blended transparency (see WeightedOit.h)
 };
 
 
@@ -83,6 +87,15 @@ public:
 	// Enable the given blend state. Returns true on success. If it fails, use GetLastError to get a description of the error
 	bool SetBlendState(BlendState state);
 
+	// Keep the given blend state whatever SetBlendState is asked for until it is called again with std::nullopt, e.g. so every
+	// draw adds to the overdraw heatmap. The state is set straight away, and the state asked for last is set when it ends
+	void OverrideBlendState(std::optional<BlendState> state);
+
+	// Get the states currently set, e.g. to restore them after a temporary change
+	RasterizerState GetRasterizerState()  { return mCurrentRasterizerState; }
+	DepthState      GetDepthState()       { return mCurrentDepthState;      }
+	BlendState      GetBlendState()       { return mCurrentBlendState;      }
+
 	// If the SetXXXState functions return false, the text description of the (most recent) error can be fetched with this function
 	std::string GetLastError() { return mLastError; }
 
@@ -109,6 +122,10 @@ private:
 	// Description of the most recent error from LoadTexture or CreateSampler
 	std::string mLastError;
 
+	// See OverrideBlendState. The state last asked for while the override is in effect is set when it ends
+	std::optional<BlendState> mBlendOverride;
+	BlendState mRequestedBlendState = BlendState::BlendNone;
+
 
 	//--------------------------------------------------------------------------------------
 	// Static private data
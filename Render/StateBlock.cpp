@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Snapshot of the device context state that third-party rendering code changes
+//--------------------------------------------------------------------------------------
+
+#include "StateBlock.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Take a snapshot of the given context's state. The Get functions add a reference to each object, released by the CComPtrs
+StateBlock::StateBlock(ID3D11DeviceContext* context)
+	: mContext(context)
+{
+	mContext->IAGetInputLayout(&mInputLayout);
+	mContext->IAGetPrimitiveTopology(&mTopology);
+	mContext->IAGetVertexBuffers(0, 1, &mVertexBuffer, &mVertexStride, &mVertexOffset);
+	mContext->IAGetIndexBuffer(&mIndexBuffer, &mIndexFormat, &mIndexOffset);
+
+	mContext->VSGetShader(&mVertexShader, nullptr, nullptr);
+	mContext->PSGetShader(&mPixelShader,  nullptr, nullptr);
+	mContext->PSGetShaderResources(0, NUM_SLOTS, &mTextures[0]);
+	mContext->PSGetSamplers       (0, NUM_SLOTS, &mSamplers[0]);
+	mContext->VSGetConstantBuffers(0, 1, &mVSConstantBuffer);
+	mContext->PSGetConstantBuffers(0, 1, &mPSConstantBuffer);
+
+	mContext->RSGetState(&mRasterizerState);
+	mContext->OMGetBlendState(&mBlendState, mBlendFactor, &mSampleMask);
+	mContext->OMGetDepthStencilState(&mDepthState, &mStencilRef);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Set the snapshot's state on the context again
+void StateBlock::Restore()
+{
+	mContext->IASetInputLayout(mInputLayout);
+	mContext->IASetPrimitiveTopology(mTopology);
+	mContext->IASetVertexBuffers(0, 1, &mVertexBuffer.p, &mVertexStride, &mVertexOffset);
+	mContext->IASetIndexBuffer(mIndexBuffer, mIndexFormat, mIndexOffset);
+
+	mContext->VSSetShader(mVertexShader, nullptr, 0);
+	mContext->PSSetShader(mPixelShader,  nullptr, 0);
+
+	// CComPtr holds only the pointer, so an array of them can be passed as an array of pointers
+	static_assert(sizeof(CComPtr<ID3D11ShaderResourceView>) == sizeof(ID3D11ShaderResourceView*));
+	mContext->PSSetShaderResources(0, NUM_SLOTS, &mTextures[0].p);
+	mContext->PSSetSamplers       (0, NUM_SLOTS, &mSamplers[0].p);
+	mContext->VSSetConstantBuffers(0, 1, &mVSConstantBuffer.p);
+	mContext->PSSetConstantBuffers(0, 1, &mPSConstantBuffer.p);
+
+	mContext->RSSetState(mRasterizerState);
+	mContext->OMSetBlendState(mBlendState, mBlendFactor, mSampleMask);
+	mContext->OMSetDepthStencilState(mDepthState, mStencilRef);
+}
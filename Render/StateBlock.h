@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------
+// Snapshot of the device context state that third-party rendering code changes
+//--------------------------------------------------------------------------------------
+// Libraries such as DirectXTK's SpriteBatch set their own shaders, textures, input layout and GPU states on the immediate context.
+// Afterwards the app's caches of what is set (RenderState, GeometryManager and StateManager) would be wrong. A state block taken
+// before the library call and restored after puts back everything those caches track, so they stay correct and nothing needs
+// setting again, rather than calling RenderState::Reset and having every following draw rebind its shaders, textures, samplers,
+// buffers and states from scratch
+//
+//   StateBlock stateBlock(DX->Context());  // Snapshot
+//   ... DirectXTK calls ...
+//   stateBlock.Restore();
+//
+// Render targets and viewports are not included, the libraries in use don't change them. Dear ImGui's DirectX 11 backend
+// already saves and restores the state itself in ImGui_ImplDX11_RenderDrawData
+
+#ifndef _STATE_BLOCK_H_INCLUDED_
+#define _STATE_BLOCK_H_INCLUDED_
+
+#include "TextureTypes.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+
+class StateBlock
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Take a snapshot of the given context's state
+	StateBlock(ID3D11DeviceContext* context);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Set the snapshot's state on the context again
+	void Restore();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Texture and sampler slots used by RenderState, including the environment map after the material textures
+	static constexpr unsigned int NUM_SLOTS = NUM_TEXTURE_TYPES + 1;
+
+	ID3D11DeviceContext* mContext;
+
+	// Input assembler, for the GeometryManager's bindings
+	CComPtr<ID3D11InputLayout> mInputLayout;
+	D3D11_PRIMITIVE_TOPOLOGY   mTopology;
+	CComPtr<ID3D11Buffer>      mVertexBuffer;
+	UINT                       mVertexStride;
+	UINT                       mVertexOffset;
+	CComPtr<ID3D11Buffer>      mIndexBuffer;
+	DXGI_FORMAT                mIndexFormat;
+	UINT                       mIndexOffset;
+
+	// Shaders, textures and samplers for RenderState, and the per-frame constants which the libraries replace
+	CComPtr<ID3D11VertexShader>       mVertexShader;
+	CComPtr<ID3D11PixelShader>        mPixelShader;
+	CComPtr<ID3D11ShaderResourceView> mTextures[NUM_SLOTS];
+	CComPtr<ID3D11SamplerState>       mSamplers[NUM_SLOTS];
+	CComPtr<ID3D11Buffer>             mVSConstantBuffer;
+	CComPtr<ID3D11Buffer>             mPSConstantBuffer;
+
+	// GPU states for the StateManager
+	CComPtr<ID3D11RasterizerState>   mRasterizerState;
+	CComPtr<ID3D11BlendState>        mBlendState;
+	FLOAT                            mBlendFactor[4];
+	UINT                             mSampleMask;
+	CComPtr<ID3D11DepthStencilState> mDepthState;
+	UINT                             mStencilRef;
+};
+
+
+#endif //_STATE_BLOCK_H_INCLUDED_
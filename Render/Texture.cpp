@@ -10,13 +10,91 @@
 // mesh class could handle that (when meshes are destroyed, they release their textures and this class keeps count)
 
 #include "Texture.h"
+#include "TextureCache.h"
+#include "Utility.h" // For EndsWithCI
+#include "AssetFiles.h"
+#include "StartupProfile.h"
 
 #include <WICTextureLoader.h>
 #include <DDSTextureLoader.h>
-#include <filesystem>
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include <cmath>
 
 
+//--------------------------------------------------------------------------------------
+// Helper functions
+//--------------------------------------------------------------------------------------
+
+// GPU memory used by a 2D texture with all its mip-maps and array slices. Approximate, drivers add padding and alignment
+static uint64_t TextureBytes(ID3D11Resource* resource)
+{
+    CComQIPtr<ID3D11Texture2D> texture(resource);
+    if (texture == nullptr)  return 0;
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+
+    // Block compressed formats store 4x4 texels in 8 or 16 bytes, others are given in bytes per texel
+    unsigned int blockBytes = 0, texelBytes = 4;
+    switch (desc.Format)
+    {
+        case DXGI_FORMAT_BC1_TYPELESS: case DXGI_FORMAT_BC1_UNORM: case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC4_TYPELESS: case DXGI_FORMAT_BC4_UNORM: case DXGI_FORMAT_BC4_SNORM:
+            blockBytes = 8;  break;
+        case DXGI_FORMAT_BC2_TYPELESS: case DXGI_FORMAT_BC2_UNORM: case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_TYPELESS: case DXGI_FORMAT_BC3_UNORM: case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC5_TYPELESS: case DXGI_FORMAT_BC5_UNORM: case DXGI_FORMAT_BC5_SNORM:
+        case DXGI_FORMAT_BC6H_TYPELESS: case DXGI_FORMAT_BC6H_UF16: case DXGI_FORMAT_BC6H_SF16:
+        case DXGI_FORMAT_BC7_TYPELESS: case DXGI_FORMAT_BC7_UNORM: case DXGI_FORMAT_BC7_UNORM_SRGB:
+            blockBytes = 16;  break;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT: case DXGI_FORMAT_R32G32B32A32_UINT: texelBytes = 16;  break;
+        case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R16G16B16A16_UNORM:
+        case DXGI_FORMAT_R32G32_FLOAT:       case DXGI_FORMAT_R32G32_UINT:       texelBytes = 8;   break;
+        case DXGI_FORMAT_R8G8_UNORM:         case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R16_UNORM:          case DXGI_FORMAT_B5G6R5_UNORM:      texelBytes = 2;   break;
+        case DXGI_FORMAT_R8_UNORM:           case DXGI_FORMAT_A8_UNORM:          texelBytes = 1;   break;
+        default: break; // 8-bit RGBA/BGRA, 10-bit RGB and 32-bit single channel formats
+    }
+
+    uint64_t bytes = 0;
+    for (unsigned int mip = 0; mip < desc.MipLevels; ++mip)
+    {
+        uint64_t width  = std::max(desc.Width  >> mip, 1u);
+        uint64_t height = std::max(desc.Height >> mip, 1u);
+        if (blockBytes != 0)  bytes += ((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+        else                  bytes += width * height * texelBytes;
+    }
+    return bytes * desc.ArraySize;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+// Create the texture manager, pass DirectX device and context
+TextureManager::TextureManager(ID3D11Device* device, ID3D11DeviceContext* context)
+    : mDXDevice(device), mDXContext(context)
+{
+    // The texture cache still works without WIC, just by never building any caches, so failure is ignored
+    CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&mWICFactory));
+
+    mStreamThread = std::thread(&TextureManager::StreamingLoop, this);
+}
+
+// Stops the streaming thread, it finishes the texture it is loading first
+TextureManager::~TextureManager()
+{
+    {
+        std::lock_guard<std::mutex> lock(mStreamMutex);
+        mStopStreaming = true;
+    }
+    mStreamWork.notify_all();
+    if (mStreamThread.joinable())  mStreamThread.join();
+}
+
+
 //--------------------------------------------------------------------------------------
 // Texture Loading
 //--------------------------------------------------------------------------------------
@@ -31,47 +109,658 @@
 // Do not release the returned pointers as the TextureManager object manages their lifetimes.
 // If nullptr is returned, you can call GetLastError() for a string description of the error.
 // TextureManager stores previously loaded textures and will return the existing one if the same texture is requested for a second time
-std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> TextureManager::LoadTexture(std::string textureName, bool allowSRGB /*= true*/)
+std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> TextureManager::LoadTexture(std::string textureName, bool allowSRGB /*= true*/,
+                                                                                  TextureType type /*= TextureType::Unknown*/)
 {
-    // If this texture has been loaded before, return existing texture objects
-    auto loadedTexture = mTextures.find(textureName);
-    if (loadedTexture != mTextures.end())  return loadedTexture->second;
+    // If this texture has been loaded before, return existing texture objects. If another thread is loading it, wait for
+    // that load (without the lock held), otherwise this thread loads it and the others wait on it
+    std::promise<std::pair<ID3D11Resource*, ID3D11ShaderResourceView*>> loadResult;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        auto loadedTexture = mTextures.find(textureName);
+        if (loadedTexture != mTextures.end())  return loadedTexture->second;
 
+        auto loading = mTexturesLoading.find(textureName);
+        if (loading != mTexturesLoading.end())
+        {
+            TextureLoad load = loading->second;
+            lock.unlock();
+            return load.get(); // If that load failed the last error is already set
+        }
+        mTexturesLoading.emplace(textureName, loadResult.get_future().share());
+    }
+    StartupTimer startupTimer("Texture " + textureName);
 
     CComPtr<ID3D11Resource>           textureResource;
     CComPtr<ID3D11ShaderResourceView> textureSRV;
+    HRESULT hr = CreateTexture(textureName, allowSRGB, type, textureResource, textureSRV);
+
+    // Enter DirectX objects into map of loaded textures, then return to caller and any threads waiting for this texture
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> result = { nullptr, nullptr };
+    if (FAILED(hr))
+    {
+        mLastError = "Failure to load texture: " + textureName;
+    }
+    else
+    {
+        result = mTextures.try_emplace(textureName, textureResource, textureSRV).first->second;
+        auto bytes = TextureBytes(textureResource);
+        gStartupProfile.AddBytesUploaded(bytes);
+        mLoadedBytes += bytes;
+    }
+    mTexturesLoading.erase(textureName);
+    loadResult.set_value(result);
+    return result;
+}
 
-    // The functions used below require a std::wstring filename (wstring uses "wide characters" - a different variation of character
-    // encoding and not a good one, so don't use them). This line converts an ordinary std::string filename to std::wstring (C++17)
-    auto wTextureName = std::filesystem::path(textureName).wstring();
 
+// Load a texture into new DirectX objects, as LoadTexture but without looking in or adding to the map of loaded textures.
+// Returns the DirectX error code
+HRESULT TextureManager::CreateTexture(const std::string& textureName, bool allowSRGB, TextureType type,
+                                      CComPtr<ID3D11Resource>& textureResource, CComPtr<ID3D11ShaderResourceView>& textureSRV)
+{
+    // Files are read through gAssetFiles and created from memory. Files in the asset archive are passed straight from its mapping
     // DDS files need a different function from other files so check the filename extension (case insensitive)
     HRESULT hr;
-    std::string dds = ".dds";
-    if (textureName.size() >= 4 &&
-        std::equal(dds.rbegin(), dds.rend(), textureName.rbegin(), [](unsigned char a, unsigned char b) { return std::tolower(a) == std::tolower(b); })) // Case insensitive check
+    if (EndsWithCI(textureName, ".dds"))
+    {
+        AssetData file = gAssetFiles.Read(textureName);
+        hr = file.empty() ? E_FAIL :
+             DirectX::CreateDDSTextureFromMemoryEx(mDXDevice, file.data(), file.size(), 0,
+                                                   D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+                                                   (DirectX::DX11::DDS_LOADER_FLAGS)(allowSRGB ? DirectX::DX11::DDS_LOADER_DEFAULT : DirectX::DX11::DDS_LOADER_IGNORE_SRGB),
+                                                   &textureResource, &textureSRV);
+    }
+    else
+    {
+        // Other files use the block compressed cache for the texture's type, if it has one. If the cache is missing or out of
+        // date it is built from the file. The cache already has its mip-maps, so the context isn't needed
+        hr = E_FAIL;
+        DXGI_FORMAT cacheFormat = TextureCacheFormat(type, allowSRGB);
+        if (cacheFormat != DXGI_FORMAT_UNKNOWN)
+        {
+            AssetData dds = ReadTextureCache(textureName, cacheFormat);
+            for (int attempt = 0; attempt < 2 && FAILED(hr); ++attempt)
+            {
+                if (attempt == 1) // Cache missing or unusable
+                {
+                    StartupTimer buildTimer("Build texture cache");
+                    dds = AssetData(BuildTextureCache(mWICFactory, textureName, cacheFormat));
+                }
+                if (dds.empty())  continue;
+                hr = DirectX::CreateDDSTextureFromMemoryEx(mDXDevice, dds.data(), dds.size(), 0,
+                                                           D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+                                                           DirectX::DX11::DDS_LOADER_DEFAULT, &textureResource, &textureSRV);
+            }
+        }
+
+        // Textures that aren't cached or can't be compressed (e.g. their size isn't a multiple of 4) are loaded from the file
+        if (FAILED(hr))
+        {
+            StartupTimer decodeTimer("WIC decode");
+            AssetData file = gAssetFiles.Read(textureName);
+            hr = file.empty() ? E_FAIL :
+                 DirectX::CreateWICTextureFromMemoryEx(mDXDevice, mDXContext, file.data(), file.size(), 0,
+                                                       D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+                                                       (DirectX::DX11::WIC_LOADER_FLAGS)(allowSRGB ? DirectX::DX11::WIC_LOADER_SRGB_DEFAULT : DirectX::DX11::WIC_LOADER_IGNORE_SRGB),
+                                                       &textureResource, &textureSRV );
+        }
+    }
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Texture Streaming
+//--------------------------------------------------------------------------------------
+
+// As LoadTexture, but returns straight away with a placeholder while the texture is loaded in the background. Textures that
+// can't be streamed are loaded before returning. Returns nullptr if the file doesn't exist or can't be loaded
+TextureManager::StreamedTexture* TextureManager::StreamTexture(std::string textureName, bool allowSRGB /*= true*/,
+                                                               TextureType type /*= TextureType::Unknown*/)
+{
+    // DDS files are streamed as they are, other files through the texture cache if their type has a cache format
+    bool ddsFile = EndsWithCI(textureName, ".dds");
+    DXGI_FORMAT cacheFormat = ddsFile ? DXGI_FORMAT_UNKNOWN : TextureCacheFormat(type, allowSRGB);
+    bool streamed = ddsFile || cacheFormat != DXGI_FORMAT_UNKNOWN;
+
+    std::unique_lock<std::mutex> lock(mStreamMutex);
+    auto existing = mStreamedTextures.find(textureName);
+    if (existing != mStreamedTextures.end())  return &existing->second->texture;
+
+    auto entry = std::make_unique<StreamEntry>();
+    entry->fileName    = textureName;
+    entry->allowSRGB   = allowSRGB;
+    entry->cacheFormat = cacheFormat;
+    entry->placeholder = (type == TextureType::Normal) ? 0xFFFF8080 : 0xFF808080; // Flat normals for normal maps, mid-grey otherwise
+    entry->lastUsed    = mFrame;
+    if (streamed)
     {
-        hr = DirectX::CreateDDSTextureFromFileEx(mDXDevice, wTextureName.c_str(), 0,
-                                                 D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
-                                                 (DirectX::DX11::DDS_LOADER_FLAGS)(allowSRGB ? DirectX::DX11::DDS_LOADER_DEFAULT : DirectX::DX11::DDS_LOADER_IGNORE_SRGB),
-                                                 &textureResource, &textureSRV);
+        // Missing files are still reported straight away, so callers can fail as they did when textures were loaded here
+        if (!gAssetFiles.Exists(textureName))
+        {
+            std::lock_guard<std::mutex> errorLock(mMutex);
+            mLastError = "Failure to load texture: " + textureName;
+            return nullptr;
+        }
+
+        entry->texture.view = Placeholder(entry->placeholder);
+        if (entry->texture.view == nullptr)
+        {
+            std::lock_guard<std::mutex> errorLock(mMutex);
+            mLastError = "Failure creating placeholder texture";
+            return nullptr;
+        }
+
+        // Queue the coarsest version, finer ones are queued by UpdateStreaming as draws need them
+        entry->loading = true;
+        mStreamRequests.push_back({ entry.get(), 0 });
+        mStreamWork.notify_one();
     }
     else
     {
-        hr = DirectX::CreateWICTextureFromFileEx(mDXDevice, mDXContext, wTextureName.c_str(), 0,
-                                                 D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
-                                                 (DirectX::DX11::WIC_LOADER_FLAGS)(allowSRGB ? DirectX::DX11::WIC_LOADER_SRGB_DEFAULT : DirectX::DX11::WIC_LOADER_IGNORE_SRGB),
-                                                 &textureResource, &textureSRV );
+        // Load the texture now, without the streaming lock so other threads can stream textures meanwhile
+        lock.unlock();
+        auto [resource, srv] = LoadTexture(textureName, allowSRGB, type);
+        if (srv == nullptr)  return nullptr;
+        entry->resource     = resource;
+        entry->srv          = srv;
+        entry->texture.view = srv;
+        entry->complete     = true;
+        entry->evictable    = false;
+        lock.lock();
+
+        // Another thread may have added the same texture meanwhile, if so return that one
+        existing = mStreamedTextures.find(textureName);
+        if (existing != mStreamedTextures.end())  return &existing->second->texture;
+    }
+
+    return &mStreamedTextures.emplace(textureName, std::move(entry)).first->second->texture;
+}
+
+
+// Swap in the streamed textures that have finished loading and request finer versions of those drawn larger than their
+// current version, then evict textures if over the memory budget. Call once a frame while nothing is rendering, on the thread
+// that uses the immediate context
+void TextureManager::UpdateStreaming()
+{
+    ++mFrame;
+
+    std::vector<StreamResult> results;
+    {
+        std::lock_guard<std::mutex> lock(mStreamMutex);
+        results.swap(mStreamResults);
+    }
+
+    // Swap in the versions that have loaded. The version they replace is released, DirectX keeps it until the GPU is done with it
+    for (auto& result : results)
+    {
+        StreamEntry& entry = *result.entry;
+        if (result.loadOnMainThread)
+        {
+            // E.g. a texture whose size isn't a multiple of 4 can't be cached, WIC needs the context to make its mip-maps
+            std::tie(result.resource, result.srv) = LoadTexture(entry.fileName, entry.allowSRGB);
+            result.complete = true;
+            entry.evictable = false;
+        }
+
+        if (result.srv != nullptr)
+        {
+            entry.resource     = result.resource;
+            entry.srv          = result.srv;
+            entry.texture.view = entry.srv;
+            entry.loadedSize   = result.size;
+            entry.complete     = result.complete;
+            entry.bytes        = entry.evictable ? TextureBytes(entry.resource) : 0;
+        }
+        else
+        {
+            // Keep the version in use, there is no point trying finer ones. LoadTexture has already set the error
+            entry.complete = true;
+            if (!result.loadOnMainThread)
+            {
+                std::lock_guard<std::mutex> errorLock(mMutex);
+                mLastError = "Failure to load texture: " + entry.fileName;
+            }
+        }
+        entry.loading = false;
+    }
+
+    // Request finer versions of the textures used since the last update that are drawn larger than the version they have
+    std::lock_guard<std::mutex> lock(mStreamMutex);
+    bool requested = false;
+    for (auto& [name, entry] : mStreamedTextures)
+    {
+        unsigned int requestedSize = entry->texture.requestedSize.exchange(0, std::memory_order_relaxed);
+        bool used = entry->texture.used.exchange(false, std::memory_order_relaxed);
+        if (used || requestedSize > 0)  entry->lastUsed = mFrame;
+        if (entry->complete || entry->loading || (!used && requestedSize == 0))  continue;
+
+        // A texture bound by draws that don't give their size on screen gets the full texture
+        unsigned int wantedSize = (requestedSize > 0) ? requestedSize : UINT_MAX;
+        if (wantedSize <= entry->loadedSize)  continue;
+
+        // Go straight to the smallest version that is large enough
+        unsigned int stage = 0;
+        while (stage < NUM_STREAM_STAGES - 1 && STREAM_STAGE_SIZES[stage] < wantedSize)  ++stage;
+
+        entry->loading = true;
+        mStreamRequests.push_back({ entry.get(), stage });
+        requested = true;
+    }
+    if (requested)  mStreamWork.notify_one();
+
+    // Draws recorded since the texture arrays last grew have been submitted, so the views they replaced can go
+    {
+        std::lock_guard<std::mutex> arrayLock(mArrayMutex);
+        mRetiredArrayViews.clear();
+    }
+
+    ApplyBudget();
+}
+
+
+// Evict the least recently drawn streamed textures until the total memory used is within the budget. A step at a time: a
+// texture loses its largest mip-map, and once down to the coarsest streamed size it goes back to its placeholder. Textures
+// drawn recently or still loading are left alone. Also updates the stats. Called by UpdateStreaming with mStreamMutex held
+void TextureManager::ApplyBudget()
+{
+    Stats stats;
+    stats.evictedMips     = mStats.evictedMips;
+    stats.evictedTextures = mStats.evictedTextures;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        stats.textures = static_cast<unsigned int>(mTextures.size());
+        stats.bytes    = mLoadedBytes;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mArrayMutex);
+        for (auto& [key, set] : mTextureArraySets)
+        {
+            for (auto& array : set->arrays)  if (array != nullptr && array->resource != nullptr)  ++stats.textureArrays;
+            stats.arrayMaterials += set->numSlices;
+        }
+        stats.bytes += mArrayBytes;
+    }
+
+    std::vector<StreamEntry*> candidates;
+    for (auto& [name, entry] : mStreamedTextures)
+    {
+        if (!entry->evictable)  continue;
+        ++stats.textures;
+        ++stats.streamed;
+        if (entry->loading)  ++stats.streaming;
+        stats.streamedBytes += entry->bytes;
+        if (!entry->loading && entry->resource != nullptr && mFrame - entry->lastUsed >= EVICTION_AGE)  candidates.push_back(entry.get());
+    }
+    stats.bytes += stats.streamedBytes;
+
+    uint64_t budget = static_cast<uint64_t>(std::max(mBudgetMB, 0)) * 1024 * 1024;
+    if (budget > 0 && stats.bytes > budget && !candidates.empty())
+    {
+        // Least recently drawn first. Each pass takes one step from each texture, so large textures aren't emptied before
+        // the others lose anything
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const StreamEntry* a, const StreamEntry* b) { return a->lastUsed < b->lastUsed; });
+        bool evicted = true;
+        while (stats.bytes > budget && evicted)
+        {
+            evicted = false;
+            for (auto entry : candidates)
+            {
+                if (stats.bytes <= budget)  break;
+                if (entry->resource == nullptr)  continue;
+
+                uint64_t oldBytes = entry->bytes;
+                if (entry->loadedSize > STREAM_STAGE_SIZES[0] && DropTopMip(*entry))
+                {
+                    ++stats.evictedMips;
+                }
+                else
+                {
+                    entry->resource     = nullptr;
+                    entry->srv          = nullptr;
+                    entry->texture.view = Placeholder(entry->placeholder);
+                    entry->loadedSize   = 0;
+                    entry->bytes        = 0;
+                    ++stats.evictedTextures;
+                }
+                entry->complete = false; // Stream it back in if it is drawn again
+                stats.bytes         -= oldBytes - entry->bytes;
+                stats.streamedBytes -= oldBytes - entry->bytes;
+                evicted = true;
+            }
+        }
+    }
+    mStats = stats;
+}
+
+
+// Replace the version of a streamed texture in use with a copy without its largest mip-map, copied on the GPU. Returns false
+// if that can't be done (a texture array, a single mip-map or a size that can't be halved), then the caller evicts it entirely
+bool TextureManager::DropTopMip(StreamEntry& entry)
+{
+    CComQIPtr<ID3D11Texture2D> texture(entry.resource);
+    if (texture == nullptr)  return false;
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    if (desc.ArraySize != 1 || desc.MipLevels < 2 || desc.Width < 8 || desc.Height < 8)  return false;
+
+    // Block compressed textures must stay a multiple of 4 in size, halving a multiple of 8 does that
+    desc.Width     /= 2;
+    desc.Height    /= 2;
+    desc.MipLevels -= 1;
+    CComPtr<ID3D11Texture2D> smaller;
+    if (FAILED(mDXDevice->CreateTexture2D(&desc, nullptr, &smaller)))  return false;
+    for (unsigned int mip = 0; mip < desc.MipLevels; ++mip)
+    {
+        mDXContext->CopySubresourceRegion(smaller, mip, 0, 0, 0, texture, mip + 1, nullptr);
+    }
+
+    // Same view settings as the old one, except the mip-maps
+    D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+    entry.srv->GetDesc(&srvDesc);
+    if (srvDesc.ViewDimension != D3D11_SRV_DIMENSION_TEXTURE2D)  return false;
+    srvDesc.Texture2D.MostDetailedMip = 0;
+    srvDesc.Texture2D.MipLevels       = static_cast<UINT>(-1);
+    CComPtr<ID3D11ShaderResourceView> srv;
+    if (FAILED(mDXDevice->CreateShaderResourceView(smaller, &srvDesc, &srv)))  return false;
+
+    entry.resource     = smaller;
+    entry.srv          = srv;
+    entry.texture.view = srv;
+    entry.loadedSize   = std::max(entry.loadedSize / 2, 1u);
+    entry.bytes        = TextureBytes(smaller);
+    return true;
+}
+
+
+// Function run by the streaming thread - waits for requests then loads them, coarsest first
+void TextureManager::StreamingLoop()
+{
+    // WIC is used to build texture caches on this thread
+    HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+    std::unique_lock<std::mutex> lock(mStreamMutex);
+    while (true)
+    {
+        mStreamWork.wait(lock, [&] { return mStopStreaming || !mStreamRequests.empty(); });
+        if (mStopStreaming)  break;
+
+        // The coarsest request first, so every texture has a rough version before any get fine ones. Same stages in request order
+        auto next = std::min_element(mStreamRequests.begin(), mStreamRequests.end(),
+                                     [](const StreamRequest& a, const StreamRequest& b) { return a.stage < b.stage; });
+        StreamRequest request = *next;
+        mStreamRequests.erase(next);
+
+        lock.unlock();
+        StreamResult result = LoadStreamStage(request);
+        lock.lock();
+        mStreamResults.push_back(std::move(result));
+    }
+    lock.unlock();
+
+    if (SUCCEEDED(comResult))  CoUninitialize();
+}
+
+
+// Load one version of a streamed texture, on the streaming thread. Only uses the device (which is thread-safe), not the context
+TextureManager::StreamResult TextureManager::LoadStreamStage(const StreamRequest& request)
+{
+    const StreamEntry& entry = *request.entry;
+    StreamResult result = { request.entry, 0, true, false };
+
+    // Get the texture as DDS data - DDS files as they are, others from the texture cache, which has every mip-map already
+    AssetData dds;
+    if (entry.cacheFormat == DXGI_FORMAT_UNKNOWN)
+    {
+        dds = gAssetFiles.Read(entry.fileName);
+    }
+    else
+    {
+        dds = ReadTextureCache(entry.fileName, entry.cacheFormat);
+        if (dds.empty())  dds = AssetData(BuildTextureCache(mWICFactory, entry.fileName, entry.cacheFormat));
+        if (dds.empty())
+        {
+            result.loadOnMainThread = true;
+            return result;
+        }
+    }
+    if (dds.size() < 20)  return result; // Failed, no texture
+
+    // Width and height are at the same place in all DDS headers, after the magic number, header size and flags
+    uint32_t height, width;
+    std::memcpy(&height, dds.data() + 12, sizeof(height));
+    std::memcpy(&width,  dds.data() + 16, sizeof(width));
+    unsigned int fullSize = std::max(width, height);
+
+    // The loader leaves out the mip-maps larger than maxSize. Coarse versions of DDS files without mip-maps can't be made, so
+    // those load in full straight away
+    unsigned int maxSize = STREAM_STAGE_SIZES[request.stage];
+    if (fullSize <= maxSize)  maxSize = 0;
+    auto loadFlags = (DirectX::DX11::DDS_LOADER_FLAGS)(entry.allowSRGB ? DirectX::DX11::DDS_LOADER_DEFAULT : DirectX::DX11::DDS_LOADER_IGNORE_SRGB);
+    HRESULT hr = DirectX::CreateDDSTextureFromMemoryEx(mDXDevice, dds.data(), dds.size(), maxSize,
+                                                       D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, loadFlags,
+                                                       &result.resource, &result.srv);
+    if (FAILED(hr) && maxSize != 0)
+    {
+        maxSize = 0;
+        hr = DirectX::CreateDDSTextureFromMemoryEx(mDXDevice, dds.data(), dds.size(), 0,
+                                                   D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, loadFlags,
+                                                   &result.resource, &result.srv);
     }
     if (FAILED(hr))
     {
-        mLastError = "Failure to load texture: " + textureName;
-        return { nullptr, nullptr };
+        result.resource = nullptr;
+        result.srv      = nullptr;
+        return result;
     }
 
-    // Enter DirectX objects into map of loaded textures, then return to caller.
-    mTextures[textureName] = { textureResource, textureSRV };
-    return { textureResource, textureSRV };
+    // Size of the top mip-map that was loaded
+    result.size = fullSize;
+    while (maxSize != 0 && result.size > maxSize)  result.size = std::max(result.size / 2, 1u);
+    result.complete = (maxSize == 0);
+    return result;
+}
+
+
+// 1x1 texture of the given colour (RGBA, 8 bits each, red in the lowest bits) to stand in for textures until they load
+ID3D11ShaderResourceView* TextureManager::Placeholder(uint32_t colour)
+{
+    auto existing = mPlaceholders.find(colour);
+    if (existing != mPlaceholders.end())  return existing->second;
+
+    D3D11_TEXTURE2D_DESC textureDesc = {};
+    textureDesc.Width            = 1;
+    textureDesc.Height           = 1;
+    textureDesc.MipLevels        = 1;
+    textureDesc.ArraySize        = 1;
+    textureDesc.Format           = DXGI_FORMAT_R8G8B8A8_UNORM;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage            = D3D11_USAGE_IMMUTABLE;
+    textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+    D3D11_SUBRESOURCE_DATA initData = { &colour, sizeof(colour), 0 };
+
+    CComPtr<ID3D11Texture2D>          texture;
+    CComPtr<ID3D11ShaderResourceView> srv;
+    if (FAILED(mDXDevice->CreateTexture2D(&textureDesc, &initData, &texture)))     return nullptr;
+    if (FAILED(mDXDevice->CreateShaderResourceView(texture, nullptr, &srv)))      return nullptr;
+
+    mPlaceholders[colour] = srv;
+    return srv;
+}
+
+
+// GPU memory used by the version of a texture in use, with its mip-maps. A texture array counts the share of one slice
+uint64_t TextureManager::MemoryUsed(const StreamedTexture& texture)
+{
+    if (texture.view == nullptr)  return 0;
+    CComPtr<ID3D11Resource> resource;
+    texture.view->GetResource(&resource);
+    CComQIPtr<ID3D11Texture2D> texture2D(resource);
+    if (texture2D == nullptr)  return 0;
+
+    D3D11_TEXTURE2D_DESC desc;
+    texture2D->GetDesc(&desc);
+    return TextureBytes(resource) / std::max(desc.ArraySize, 1u);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Texture Arrays
+//--------------------------------------------------------------------------------------
+
+// Load the textures of a material into a slice of texture arrays shared with other materials whose textures match, giving the
+// array for each texture type and the slice. A material added before gets its existing slice. Returns false on failure
+bool TextureManager::AddToTextureArrays(const std::array<std::string, NUM_TEXTURE_TYPES>& fileNames,
+                                        std::array<StreamedTexture*, NUM_TEXTURE_TYPES>& arrays, uint32_t& slice)
+{
+    auto giveSlice = [&](const TextureArraySet& set, uint32_t materialSlice)
+    {
+        for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)  arrays[i] = (set.arrays[i] != nullptr) ? &set.arrays[i]->texture : nullptr;
+        slice = materialSlice;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mArrayMutex);
+        auto existing = mArrayMaterials.find(fileNames);
+        if (existing != mArrayMaterials.end())
+        {
+            giveSlice(*existing->second.first, existing->second.second);
+            return true;
+        }
+    }
+
+    // Load the textures without the lock, so other threads can add materials meanwhile. Each is loaded as it would be on its
+    // own (including the texture cache) then copied into the arrays. The key of the set to hold them describes every texture
+    std::array<CComPtr<ID3D11Texture2D>, NUM_TEXTURE_TYPES> textures;
+    std::string setKey;
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)
+    {
+        setKey += '|';
+        if (fileNames[i].empty())  continue;
+
+        TextureType type = static_cast<TextureType>(i);
+        CComPtr<ID3D11Resource>           resource;
+        CComPtr<ID3D11ShaderResourceView> srv;
+        D3D11_TEXTURE2D_DESC desc = {};
+        if (SUCCEEDED(CreateTexture(fileNames[i], AllowSRGB(type), type, resource, srv)))  textures[i] = CComQIPtr<ID3D11Texture2D>(resource);
+        if (textures[i] != nullptr)  textures[i]->GetDesc(&desc);
+        if (textures[i] == nullptr || desc.ArraySize != 1 || (desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE) != 0)
+        {
+            std::lock_guard<std::mutex> errorLock(mMutex);
+            mLastError = "Failure to load texture for texture array: " + fileNames[i];
+            return false;
+        }
+        setKey += std::to_string(desc.Format) + ' ' + std::to_string(desc.Width) + 'x' + std::to_string(desc.Height) + ' ' +
+                  std::to_string(desc.MipLevels);
+    }
+
+    std::lock_guard<std::mutex> lock(mArrayMutex);
+
+    // Another thread may have added the same material meanwhile, if so use that one
+    auto existing = mArrayMaterials.find(fileNames);
+    if (existing != mArrayMaterials.end())
+    {
+        giveSlice(*existing->second.first, existing->second.second);
+        return true;
+    }
+
+    // The arrays of a new set copy the description of the first material's textures, with the array size set as they grow
+    auto& set = mTextureArraySets[setKey];
+    if (set == nullptr)
+    {
+        set = std::make_unique<TextureArraySet>();
+        for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)
+        {
+            if (textures[i] == nullptr)  continue;
+            set->arrays[i] = std::make_unique<TextureArray>();
+            D3D11_TEXTURE2D_DESC& desc = set->arrays[i]->desc;
+            textures[i]->GetDesc(&desc);
+            desc.Usage          = D3D11_USAGE_DEFAULT;
+            desc.BindFlags      = D3D11_BIND_SHADER_RESOURCE;
+            desc.CPUAccessFlags = 0;
+            desc.MiscFlags      = 0;
+        }
+    }
+    if (set->numSlices == set->capacity && !GrowTextureArrays(*set, std::max(set->capacity * 2, INITIAL_ARRAY_SLICES)))
+    {
+        std::lock_guard<std::mutex> errorLock(mMutex);
+        mLastError = "Failure creating texture array for: " + setKey;
+        return false;
+    }
+
+    // Copy every mip-map of each texture into the new slice of its array on the GPU
+    uint32_t materialSlice = set->numSlices++;
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)
+    {
+        if (textures[i] == nullptr)  continue;
+        TextureArray& array = *set->arrays[i];
+        for (unsigned int mip = 0; mip < array.desc.MipLevels; ++mip)
+        {
+            mDXContext->CopySubresourceRegion(array.resource, D3D11CalcSubresource(mip, materialSlice, array.desc.MipLevels), 0, 0, 0,
+                                              textures[i], mip, nullptr);
+        }
+        gStartupProfile.AddBytesUploaded(TextureBytes(textures[i]));
+    }
+
+    mArrayMaterials.emplace(fileNames, std::make_pair(set.get(), materialSlice));
+    giveSlice(*set, materialSlice);
+    return true;
+}
+
+
+// Recreate every array of a set with the given number of slices, copying the slices already added on the GPU. The views of
+// the old arrays are kept until the next UpdateStreaming. Returns false on failure. Called with mArrayMutex held
+bool TextureManager::GrowTextureArrays(TextureArraySet& set, uint32_t capacity)
+{
+    // Create all the new arrays before replacing any, so the set is left as it was on failure
+    std::array<CComPtr<ID3D11Texture2D>,          NUM_TEXTURE_TYPES> resources;
+    std::array<CComPtr<ID3D11ShaderResourceView>, NUM_TEXTURE_TYPES> srvs;
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)
+    {
+        if (set.arrays[i] == nullptr)  continue;
+        D3D11_TEXTURE2D_DESC desc = set.arrays[i]->desc;
+        desc.ArraySize = capacity;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format                         = desc.Format;
+        srvDesc.ViewDimension                  = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MostDetailedMip = 0;
+        srvDesc.Texture2DArray.MipLevels       = desc.MipLevels;
+        srvDesc.Texture2DArray.FirstArraySlice = 0;
+        srvDesc.Texture2DArray.ArraySize       = capacity;
+        if (FAILED(mDXDevice->CreateTexture2D(&desc, nullptr, &resources[i])))              return false;
+        if (FAILED(mDXDevice->CreateShaderResourceView(resources[i], &srvDesc, &srvs[i])))  return false;
+    }
+
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i)
+    {
+        if (set.arrays[i] == nullptr)  continue;
+        TextureArray& array = *set.arrays[i];
+        if (array.resource != nullptr)
+        {
+            // Slices have the same subresource numbers in both arrays, they have the same mip-maps
+            for (uint32_t slice = 0; slice < set.numSlices; ++slice)
+            {
+                for (unsigned int mip = 0; mip < array.desc.MipLevels; ++mip)
+                {
+                    unsigned int subresource = D3D11CalcSubresource(mip, slice, array.desc.MipLevels);
+                    mDXContext->CopySubresourceRegion(resources[i], subresource, 0, 0, 0, array.resource, subresource, nullptr);
+                }
+            }
+            mArrayBytes -= TextureBytes(array.resource);
+            mRetiredArrayViews.push_back(array.srv);
+        }
+        array.desc.ArraySize = capacity;
+        array.resource       = resources[i];
+        array.srv            = srvs[i];
+        array.texture.view   = array.srv;
+        mArrayBytes += TextureBytes(array.resource);
+    }
+    set.capacity = capacity;
+    return true;
 }
 
 
@@ -85,6 +774,8 @@ std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> TextureManager::LoadTextur
 // TextureManager stores previously created samplers and will return the existing one if the same sampler type is requested
 ID3D11SamplerState* TextureManager::CreateSampler(const SamplerState& samplerState)
 {
+    std::lock_guard<std::mutex> lock(mMutex);
+
     // If this texture has been loaded before, return existing texture objects
     auto existingSampler = mSamplers.find(samplerState);
     if (existingSampler != mSamplers.end())  return existingSampler->second;
@@ -8,6 +8,20 @@
 // all textures and samplers exist until the app closes. That is fine for samplers (they are small), but a production
 // app would need a way to release textures that are no longer in use. Some reference counting connected with the
 // mesh class could handle that (when meshes are destroyed, they release their textures and this class keeps count)
+//
+// Material textures are streamed (see StreamTexture). Rather than waiting for the texture to load, the caller gets a small
+// placeholder straight away while a background thread loads the texture, coarse mip-maps first. Each frame UpdateStreaming swaps
+// in the versions that have finished loading and asks for finer ones for the textures that need them. How fine depends on the
+// size draws using the texture appear on screen (see StreamedTexture::RequestSize), textures that are never drawn stay coarse
+//
+// The GPU memory used by textures is tracked against a budget (see BudgetMB). When over budget, the streamed textures that
+// haven't been drawn for the longest lose their finest mip-map, one at a time, then go back to their placeholder. They stream
+// back in if they are drawn again. Textures loaded with LoadTexture are counted but never evicted
+//
+// Materials of similar meshes can also keep their textures in texture arrays (see AddToTextureArrays). Materials whose textures
+// have the same types, sizes and formats share a set of arrays, one for each texture type, each material at the same slice of
+// every array. The materials then bind the same textures and select theirs with the slice, so draws of different meshes don't
+// change any texture bindings between them. Arrays are loaded in full and never evicted
 
 #ifndef _TEXTURE_H_INCLUDED_
 #define _TEXTURE_H_INCLUDED_
@@ -17,10 +31,19 @@
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
 #include <atlbase.h> // For CComPtr (see member variables)
+#include <wincodec.h> // For IWICImagingFactory
 
 #include <string>
+#include <array>
 #include <map>
+#include <memory>
 #include <vector>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <stdint.h>
 
 
 //--------------------------------------------------------------------------------------
@@ -28,13 +51,54 @@
 //--------------------------------------------------------------------------------------
 class TextureManager
 {
+	//--------------------------------------------------------------------------------------
+	// Types
+	//--------------------------------------------------------------------------------------
+public:
+	// A texture returned by StreamTexture. Its view starts as a placeholder and is replaced by finer versions of the texture as
+	// they load, only in UpdateStreaming. So read the view each time it is bound rather than keeping it
+	struct StreamedTexture
+	{
+		// The view of the texture's current version, use View below when binding it
+		ID3D11ShaderResourceView* view = nullptr;
+
+		// Largest size (in texels across) that draws using this texture asked for since the last UpdateStreaming, 0 if none
+		std::atomic<unsigned int> requestedSize = 0;
+
+		// Whether the texture has been bound since the last UpdateStreaming. Textures that are bound but have no requested size
+		// are loaded in full (e.g. for draws that don't know their size on screen)
+		std::atomic<bool> used = false;
+
+		// Ask for the texture to be at least the given size across, e.g. the height in pixels of an object using it on screen.
+		// Can be called on any thread
+		void RequestSize(unsigned int size)
+		{
+			unsigned int current = requestedSize.load(std::memory_order_relaxed);
+			while (current < size && !requestedSize.compare_exchange_weak(current, size, std::memory_order_relaxed)) {}
+		}
+
+		// The view to bind, and note that the texture is in use. Can be called on any thread while rendering
+		ID3D11ShaderResourceView* View()
+		{
+			if (!used.load(std::memory_order_relaxed))  used.store(true, std::memory_order_relaxed);
+			return view;
+		}
+	};
+
+
 	//--------------------------------------------------------------------------------------
 	// Construction
 	//--------------------------------------------------------------------------------------
 public:
-	// Create the texture manager, pass DirectX device and context
-	TextureManager(ID3D11Device* device, ID3D11DeviceContext* context)
-		: mDXDevice(device), mDXContext(context) {}
+	// Create the texture manager, pass DirectX device and context. Starts the streaming thread
+	TextureManager(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// Stops the streaming thread
+	~TextureManager();
+
+	// Prevent copying - the manager owns the streaming thread
+	TextureManager(const TextureManager&) = delete;
+	TextureManager& operator=(const TextureManager&) = delete;
 
 
 	//--------------------------------------------------------------------------------------
@@ -51,7 +115,59 @@ public:
 	// Do not release the returned pointers as the TextureManager object manages their lifetimes.
 	// If nullptr is returned, you can call GetLastError() for a string description of the error.
 	// TextureManager stores previously loaded textures and will return the existing one if the same texture is requested for a second time
-	std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> LoadTexture(std::string textureName, bool allowSRGB = true);
+	// Texture files are read through gAssetFiles (see AssetFiles.h), so can come from the asset archive
+	// Pass the type of texture to store a JPG/PNG texture in a block compressed cache file the first time it is loaded and load that
+	// from then on, see TextureCache.h. Textures loaded without a type (TextureType::Unknown) are always loaded from the file given
+	// Can be called on several threads at once, different files are decoded in parallel. A thread asking for a texture another
+	// thread is loading waits for that load rather than loading it again. Make the context thread-safe first, it is used to
+	// generate mip-maps (see DXDevice::SetContextThreadSafe)
+	std::pair<ID3D11Resource*, ID3D11ShaderResourceView*> LoadTexture(std::string textureName, bool allowSRGB = true,
+	                                                                  TextureType type = TextureType::Unknown);
+
+	// As LoadTexture, but returns straight away with a placeholder while the texture is loaded in the background (see top of file).
+	// Only DDS files and textures of a type with a cache format (see TextureCache.h) are streamed, others are loaded with
+	// LoadTexture before returning. Returns nullptr if the file doesn't exist or can't be loaded, then call GetLastError(). A
+	// texture that exists but fails to load later keeps its placeholder and sets the last error.
+	// Do not delete the returned pointer, the TextureManager object manages its lifetime. Can be called on several threads at once
+	StreamedTexture* StreamTexture(std::string textureName, bool allowSRGB = true, TextureType type = TextureType::Unknown);
+
+	// Load the textures of a material (file names indexed by texture type, "" for none) into a slice of texture arrays shared
+	// with other materials whose textures have the same types, sizes, formats and mip-maps (see top of file). Gives the array for
+	// each texture type, nullptr for the types the material hasn't got, and the slice of the arrays holding the material. A
+	// material added before gets the slice it was given then. Returns false if a texture can't be loaded or isn't a plain 2D
+	// texture, then call GetLastError(). The arrays are recreated larger as materials are added, as with streamed textures read
+	// each array's view when binding it, and add materials while loading rather than while they may be rendering.
+	// Do not delete the returned pointers. Can be called on several threads at once, make the context thread-safe first, it is
+	// used to copy the textures into the arrays (see DXDevice::SetContextThreadSafe)
+	bool AddToTextureArrays(const std::array<std::string, NUM_TEXTURE_TYPES>& fileNames,
+	                        std::array<StreamedTexture*, NUM_TEXTURE_TYPES>& arrays, uint32_t& slice);
+
+	// Swap in the streamed textures that have finished loading and request finer versions of those drawn larger than their
+	// current version. Call once a frame, while nothing is rendering (e.g. after presenting). Must be called on the thread that
+	// uses the immediate context, textures that can't be streamed by the background thread are loaded here
+	void UpdateStreaming();
+
+	// GPU memory budget for textures in megabytes, 0 for no limit. Change it at any time, it is applied by UpdateStreaming
+	int& BudgetMB() { return mBudgetMB; }
+
+	// Texture memory use and streaming activity, as of the last UpdateStreaming
+	struct Stats
+	{
+		unsigned int textures        = 0; // All textures loaded, streamed or not (not counting placeholders)
+		unsigned int streamed        = 0; // Streamed textures, which can be evicted
+		unsigned int streaming       = 0; // Streamed textures loading a finer version
+		uint64_t     bytes           = 0; // GPU memory used by all textures
+		uint64_t     streamedBytes   = 0; // The part of that used by streamed textures
+		unsigned int evictedMips     = 0; // Mip-maps dropped to stay in budget, since the start
+		unsigned int evictedTextures = 0; // Textures returned to their placeholder to stay in budget, since the start
+		unsigned int textureArrays   = 0; // Texture arrays from AddToTextureArrays, their memory is included in bytes
+		unsigned int arrayMaterials  = 0; // Materials held in them
+	};
+	const Stats& GetStats() { return mStats; }
+
+	// GPU memory used by the version of a streamed texture in use, including its mip-maps, e.g. for a report of the memory each
+	// template uses. For a texture array (see AddToTextureArrays) it is the share of one material's slice. Approximate, as above
+	static uint64_t MemoryUsed(const StreamedTexture& texture);
 
 
 	// Create a DirectX sampler object from the given sampler definition
@@ -63,7 +179,7 @@ public:
 
 	// If the LoadTexture or CreateSampler functions return nullptr to indicate an error, the text description
 	// of the (most recent) error can be fetched with this function
-	std::string GetLastError() { return mLastError; }
+	std::string GetLastError() { std::lock_guard<std::mutex> lock(mMutex);  return mLastError; }
 
 
 	//--------------------------------------------------------------------------------------
@@ -73,6 +189,10 @@ private:
 	ID3D11Device*        mDXDevice;
 	ID3D11DeviceContext* mDXContext;
 
+	// Decodes textures to build the texture cache. Can be used on any thread. nullptr if it couldn't be created, then textures
+	// are loaded without the cache
+	CComPtr<IWICImagingFactory> mWICFactory;
+
 	// Map of texture filenames to a pair of DirectX texture objects - the texture resource (the texture data) & shader
 	// resource view (object required for shaders to access a texture). Given a new texture filename to load, can quickly
 	// check to see if it has already been loaded and if so return the existing pointer.
@@ -88,6 +208,148 @@ private:
 
 	// Description of the most recent error from LoadTexture or CreateSampler
 	std::string mLastError;
+
+	// Textures being loaded by LoadTexture, each with the result the threads asking for it meanwhile wait on. Removed once
+	// the texture is in the map above (or failed to load)
+	using TextureLoad = std::shared_future<std::pair<ID3D11Resource*, ID3D11ShaderResourceView*>>;
+	std::map<std::string, TextureLoad> mTexturesLoading;
+
+	// Guards the maps and error above, so textures and samplers can be created on several threads. Not held while a texture is
+	// loaded, so different textures load in parallel
+	std::mutex mMutex;
+
+	// Load a texture into new DirectX objects, as LoadTexture but without looking in or adding to the map of loaded textures.
+	// Returns the DirectX error code
+	HRESULT CreateTexture(const std::string& textureName, bool allowSRGB, TextureType type,
+	                      CComPtr<ID3D11Resource>& resource, CComPtr<ID3D11ShaderResourceView>& srv);
+
+
+	//--------------------------------------------------------------------------------------
+	// Streaming
+	//--------------------------------------------------------------------------------------
+
+	// Largest size across of each version of a streamed texture, coarse to fine. 0 is the full size texture
+	static constexpr unsigned int STREAM_STAGE_SIZES[] = { 64, 256, 1024, 0 };
+	static constexpr unsigned int NUM_STREAM_STAGES = sizeof(STREAM_STAGE_SIZES) / sizeof(STREAM_STAGE_SIZES[0]);
+
+	// Textures drawn within this many updates are never evicted, so the textures in view don't keep reloading when over budget
+	static constexpr uint32_t EVICTION_AGE = 120;
+
+	// A streamed texture with what is known about it. Only changed by UpdateStreaming, except the StreamedTexture's atomics
+	struct StreamEntry
+	{
+		StreamedTexture texture; // Handed out by StreamTexture
+		std::string  fileName;
+		bool         allowSRGB;
+		DXGI_FORMAT  cacheFormat;            // Format of the texture cache, DXGI_FORMAT_UNKNOWN for DDS files
+		uint32_t     placeholder;            // Colour of the placeholder, see Placeholder
+		unsigned int loadedSize   = 0;       // Size across of the version in use, 0 for the placeholder
+		bool         complete     = false;   // Full size texture loaded, or loading failed
+		bool         loading      = false;   // A version is queued or being loaded
+		bool         evictable    = true;    // False if the texture came from LoadTexture, which keeps it loaded anyway
+		uint64_t     bytes        = 0;       // GPU memory used by the version in use, 0 if not evictable
+		uint32_t     lastUsed     = 0;       // Value of mFrame when the texture was last drawn (or streamed)
+		CComPtr<ID3D11Resource>           resource; // Version in use, nullptr for the placeholder
+		CComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	// A version of a texture for the streaming thread to load, and the result
+	struct StreamRequest
+	{
+		StreamEntry* entry;
+		unsigned int stage;
+	};
+	struct StreamResult
+	{
+		StreamEntry* entry;
+		unsigned int size;     // Size across of the version loaded
+		bool         complete; // Whether the version is the full texture
+		bool         loadOnMainThread; // The streaming thread couldn't load this texture, it must be loaded with LoadTexture
+		CComPtr<ID3D11Resource>           resource; // nullptr if loading failed
+		CComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	// Function run by the streaming thread - waits for requests then loads them, coarsest first
+	void StreamingLoop();
+
+	// Load one version of a streamed texture, on the streaming thread
+	StreamResult LoadStreamStage(const StreamRequest& request);
+
+	// 1x1 texture of the given colour (RGBA, 8 bits each) to stand in for textures until they load
+	ID3D11ShaderResourceView* Placeholder(uint32_t colour);
+
+	// Evict the least recently drawn streamed textures until the total memory used is within the budget, on the main thread
+	void ApplyBudget();
+
+	// Replace the version of a streamed texture in use with a copy without its largest mip-map. Returns false if that can't be done
+	bool DropTopMip(StreamEntry& entry);
+
+	// Streamed textures by file name. The entries never move so StreamedTexture pointers can be handed out
+	std::map<std::string, std::unique_ptr<StreamEntry>> mStreamedTextures;
+	std::map<uint32_t, CComPtr<ID3D11ShaderResourceView>> mPlaceholders;
+
+	std::vector<StreamRequest> mStreamRequests; // Waiting for the streaming thread
+	std::vector<StreamResult>  mStreamResults;  // Loaded, waiting for UpdateStreaming
+
+	std::thread               mStreamThread;
+	std::condition_variable   mStreamWork; // Signalled when a request is added or on shutdown
+	bool                      mStopStreaming = false;
+
+	// Guards all the streaming data above. Separate from mMutex so StreamTexture can call LoadTexture
+	std::mutex mStreamMutex;
+
+
+	//--------------------------------------------------------------------------------------
+	// Texture Arrays
+	//--------------------------------------------------------------------------------------
+
+	// Texture arrays start with space for this many materials, then double in size as needed
+	static constexpr uint32_t INITIAL_ARRAY_SLICES = 4;
+
+	// One texture array of a set, holding one texture type
+	struct TextureArray
+	{
+		StreamedTexture      texture;   // Handed out by AddToTextureArrays, its view is replaced when the array grows
+		D3D11_TEXTURE2D_DESC desc = {}; // Of the array, the ArraySize is its capacity
+		CComPtr<ID3D11Texture2D>          resource; // nullptr until the first material is added
+		CComPtr<ID3D11ShaderResourceView> srv;
+	};
+
+	// The texture arrays of materials with matching textures, one for each texture type the materials have
+	struct TextureArraySet
+	{
+		std::array<std::unique_ptr<TextureArray>, NUM_TEXTURE_TYPES> arrays;
+		uint32_t numSlices = 0; // Materials added
+		uint32_t capacity  = 0; // Slices in each array
+	};
+
+	// Recreate every array of a set with the given number of slices, copying the slices already added. Returns false on failure,
+	// leaving the set as it was
+	bool GrowTextureArrays(TextureArraySet& set, uint32_t capacity);
+
+	// Sets by a description of the textures they hold: the format, size and mip-maps of each texture type. The sets never move
+	std::map<std::string, std::unique_ptr<TextureArraySet>> mTextureArraySets;
+
+	// Materials added, by their texture file names, with the set and slice holding them
+	std::map<std::array<std::string, NUM_TEXTURE_TYPES>, std::pair<TextureArraySet*, uint32_t>> mArrayMaterials;
+
+	// Views of arrays that have been replaced by larger ones, kept until the next UpdateStreaming as draws may still refer to them
+	std::vector<CComPtr<ID3D11ShaderResourceView>> mRetiredArrayViews;
+
+	uint64_t mArrayBytes = 0; // GPU memory used by the texture arrays
+
+	// Guards the texture array data above. Not held while the textures of a material are loaded
+	std::mutex mArrayMutex;
+
+
+	//--------------------------------------------------------------------------------------
+	// Memory Budget
+	//--------------------------------------------------------------------------------------
+
+	int      mBudgetMB    = 0;
+	uint64_t mLoadedBytes = 0; // GPU memory used by the textures in mTextures, guarded by mMutex
+	uint32_t mFrame       = 0; // Number of calls to UpdateStreaming, for the least recently used order
+	Stats    mStats;
 };
 
 
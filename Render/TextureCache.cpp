@@ -0,0 +1,568 @@
+//--------------------------------------------------------------------------------------
+// Texture cache functions - save JPG/PNG textures as block compressed DDS files with full mip chains
+//--------------------------------------------------------------------------------------
+
+#include "TextureCache.h"
+#include "AssetFiles.h"
+
+#include <atlbase.h> // For CComPtr
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <functional>
+#include <system_error>
+
+
+//--------------------------------------------------------------------------------------
+// File layout
+//--------------------------------------------------------------------------------------
+// A cache file is an ordinary DDS file with the extended (DX10) header, so it can be opened in texture tools. The identifier and
+// version of the cache are kept in the reserved part of the header, which tools ignore
+
+static const uint32_t DDS_MAGIC           = 0x20534444; // "DDS "
+static const uint32_t DDS_FOURCC_DX10     = 0x30315844; // "DX10"
+static const uint32_t TEXTURE_CACHE_MAGIC = 0x48435854; // "TXCH"
+
+struct DDSPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t bitMasks[4];
+};
+
+struct DDSHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11]; // [0] is TEXTURE_CACHE_MAGIC and [1] is TEXTURE_CACHE_VERSION
+	DDSPixelFormat pixelFormat;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct DDSHeaderDX10
+{
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static_assert(sizeof(DDSHeader) == 124 && sizeof(DDSHeaderDX10) == 20, "DDS headers must match the file format");
+
+static const size_t DDS_DATA_OFFSET = sizeof(uint32_t) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10);
+
+
+// Short name of each cached format, used in the file name. nullptr for formats that aren't used
+static const char* FormatTag(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+		case DXGI_FORMAT_BC7_UNORM_SRGB: return "bc7-srgb";
+		case DXGI_FORMAT_BC7_UNORM:      return "bc7";
+		case DXGI_FORMAT_BC5_UNORM:      return "bc5";
+		case DXGI_FORMAT_BC4_UNORM:      return "bc4";
+		default:                         return nullptr;
+	}
+}
+
+// Bytes in each 4x4 block of a cached format
+static unsigned int BlockSize(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_BC4_UNORM ? 8 : 16;
+}
+
+// Number of mip-map levels in a full chain down to 1x1
+static unsigned int MipCount(unsigned int width, unsigned int height)
+{
+	unsigned int count = 1;
+	while (width > 1 || height > 1)
+	{
+		width  = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+		++count;
+	}
+	return count;
+}
+
+// Bytes of texel data in a full mip chain for the given size and format
+static size_t DataSize(unsigned int width, unsigned int height, DXGI_FORMAT format)
+{
+	size_t size = 0;
+	for (unsigned int level = MipCount(width, height); level > 0; --level)
+	{
+		size += static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+		width  = std::max(width / 2, 1u);
+		height = std::max(height / 2, 1u);
+	}
+	return size;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Block compression
+//--------------------------------------------------------------------------------------
+
+// Set the given number of bits in a block from the given position onwards, lowest bit first. The block must start cleared
+static void WriteBits(uint8_t* block, unsigned int& position, uint32_t value, unsigned int bits)
+{
+	for (unsigned int bit = 0; bit < bits; ++bit, ++position)
+	{
+		if ((value >> bit) & 1)  block[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+	}
+}
+
+
+// Compress 16 single channel values to a BC4 block (8 bytes). The block's endpoints are the highest and lowest values, with the
+// six values between them, and each texel picks the nearest of those eight
+static void EncodeBC4(const uint8_t values[16], uint8_t* block)
+{
+	uint8_t low = 255, high = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		low  = std::min(low,  values[i]);
+		high = std::max(high, values[i]);
+	}
+
+	std::memset(block, 0, 8);
+	block[0] = high;
+	block[1] = low;
+	if (high == low)  return; // All indices 0
+
+	// Decoders use eight values when the first endpoint is greater than the second
+	int palette[8] = { high, low };
+	for (int i = 2; i < 8; ++i)  palette[i] = ((8 - i) * high + (i - 1) * low + 3) / 7;
+
+	unsigned int position = 16;
+	for (int i = 0; i < 16; ++i)
+	{
+		int best = 0;
+		for (int p = 1; p < 8; ++p)
+		{
+			if (std::abs(palette[p] - values[i]) < std::abs(palette[best] - values[i]))  best = p;
+		}
+		WriteBits(block, position, best, 3);
+	}
+}
+
+
+// Compress 16 RGBA texels to a BC7 block (16 bytes) using mode 6 - one pair of RGBA endpoints with 7 bits per channel and a low
+// bit shared by each endpoint's channels, and a 4-bit index for each texel choosing one of 16 colours between the endpoints
+static void EncodeBC7(const uint8_t texels[16][4], uint8_t* block)
+{
+	// Find the line the texels lie closest to - through their mean along the principal axis of their covariance (power iteration)
+	float mean[4] = {};
+	for (int i = 0; i < 16; ++i)
+		for (int c = 0; c < 4; ++c)  mean[c] += texels[i][c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; ++i)
+		for (int a = 0; a < 4; ++a)
+			for (int b = 0; b < 4; ++b)  covariance[a][b] += (texels[i][a] - mean[a]) * (texels[i][b] - mean[b]);
+
+	// Start from the row of the channel that varies most, which can't be at right angles to the principal axis
+	int widest = 0;
+	for (int c = 1; c < 4; ++c)  if (covariance[c][c] > covariance[widest][widest])  widest = c;
+	float axis[4];
+	for (int c = 0; c < 4; ++c)  axis[c] = covariance[widest][c];
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[4] = {};
+		float largest = 0;
+		for (int a = 0; a < 4; ++a)
+		{
+			for (int b = 0; b < 4; ++b)  next[a] += covariance[a][b] * axis[b];
+			largest = std::max(largest, std::abs(next[a]));
+		}
+		if (largest == 0)  break;
+		for (int c = 0; c < 4; ++c)  axis[c] = next[c] / largest;
+	}
+	float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3]);
+	if (length > 0)  for (int c = 0; c < 4; ++c)  axis[c] /= length;
+
+	// Endpoints are the extremes of the texels along that line
+	float tMin = 0, tMax = 0;
+	if (length > 0)
+	{
+		tMin = FLT_MAX;
+		tMax = -FLT_MAX;
+		for (int i = 0; i < 16; ++i)
+		{
+			float t = 0;
+			for (int c = 0; c < 4; ++c)  t += (texels[i][c] - mean[c]) * axis[c];
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+	}
+
+	// Quantise each endpoint to 7 bits per channel plus the shared low bit, choosing the low bit that fits best
+	int endpoint7[2][4], lowBit[2];
+	for (int e = 0; e < 2; ++e)
+	{
+		float t = (e == 0) ? tMin : tMax;
+		float bestError = FLT_MAX;
+		for (int bit = 0; bit < 2; ++bit)
+		{
+			int candidate[4];
+			float error = 0;
+			for (int c = 0; c < 4; ++c)
+			{
+				float value = std::clamp(mean[c] + axis[c] * t, 0.0f, 255.0f);
+				candidate[c] = std::clamp(static_cast<int>((value - bit) / 2 + 0.5f), 0, 127);
+				float difference = ((candidate[c] << 1) | bit) - value;
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				std::memcpy(endpoint7[e], candidate, sizeof(candidate));
+				lowBit[e] = bit;
+			}
+		}
+	}
+
+	// The colours between the endpoints, as decoders calculate them
+	static const int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	int palette[16][4];
+	for (int p = 0; p < 16; ++p)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			int endpoint0 = (endpoint7[0][c] << 1) | lowBit[0];
+			int endpoint1 = (endpoint7[1][c] << 1) | lowBit[1];
+			palette[p][c] = ((64 - WEIGHTS[p]) * endpoint0 + WEIGHTS[p] * endpoint1 + 32) >> 6;
+		}
+	}
+
+	// Each texel picks the nearest colour
+	int indices[16];
+	for (int i = 0; i < 16; ++i)
+	{
+		int bestError = INT_MAX;
+		for (int p = 0; p < 16; ++p)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; ++c)  error += (palette[p][c] - texels[i][c]) * (palette[p][c] - texels[i][c]);
+			if (error < bestError)  { bestError = error;  indices[i] = p; }
+		}
+	}
+
+	// The top bit of the first texel's index isn't stored and must be 0, if it isn't then swap the endpoints
+	if (indices[0] & 8)
+	{
+		std::swap(endpoint7[0], endpoint7[1]);
+		std::swap(lowBit[0], lowBit[1]);
+		for (int i = 0; i < 16; ++i)  indices[i] = 15 - indices[i];
+	}
+
+	std::memset(block, 0, 16);
+	unsigned int position = 0;
+	WriteBits(block, position, 1 << 6, 7); // Mode 6
+	for (int c = 0; c < 4; ++c)
+	{
+		WriteBits(block, position, endpoint7[0][c], 7);
+		WriteBits(block, position, endpoint7[1][c], 7);
+	}
+	WriteBits(block, position, lowBit[0], 1);
+	WriteBits(block, position, lowBit[1], 1);
+	WriteBits(block, position, indices[0], 3);
+	for (int i = 1; i < 16; ++i)  WriteBits(block, position, indices[i], 4);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Mip-maps
+//--------------------------------------------------------------------------------------
+// Mip-maps are made from float RGBA texels. sRGB colours are converted to linear before they are averaged, as the GPU does when
+// generating mip-maps for an sRGB texture. Normals are renormalised after averaging
+
+struct MipLevel
+{
+	unsigned int width;
+	unsigned int height;
+	std::vector<float> texels; // RGBA, 0 to 1
+};
+
+static float SRGBToLinear(float c)
+{
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float c)
+{
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1 / 2.4f) - 0.055f;
+}
+
+
+// Half the size of a mip level with a box filter. Odd sized levels repeat their last row or column
+static MipLevel Downsample(const MipLevel& source, bool normals)
+{
+	MipLevel level;
+	level.width  = std::max(source.width  / 2, 1u);
+	level.height = std::max(source.height / 2, 1u);
+	level.texels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+	for (unsigned int y = 0; y < level.height; ++y)
+	{
+		unsigned int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+		for (unsigned int x = 0; x < level.width; ++x)
+		{
+			unsigned int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+			float* texel = &level.texels[(static_cast<size_t>(y) * level.width + x) * 4];
+			for (int c = 0; c < 4; ++c)
+			{
+				texel[c] = (source.texels[(static_cast<size_t>(y0) * source.width + x0) * 4 + c] +
+				            source.texels[(static_cast<size_t>(y0) * source.width + x1) * 4 + c] +
+				            source.texels[(static_cast<size_t>(y1) * source.width + x0) * 4 + c] +
+				            source.texels[(static_cast<size_t>(y1) * source.width + x1) * 4 + c]) * 0.25f;
+			}
+
+			if (normals)
+			{
+				float n[3] = { texel[0] * 2 - 1, texel[1] * 2 - 1, texel[2] * 2 - 1 };
+				float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length > 0)  for (int c = 0; c < 3; ++c)  texel[c] = n[c] / length * 0.5f + 0.5f;
+			}
+		}
+	}
+	return level;
+}
+
+
+// Block compress a mip level to the given format, adding the blocks to the end of data. Levels smaller than a block repeat
+// their last row or column to fill it
+static void CompressLevel(const MipLevel& level, DXGI_FORMAT format, std::vector<uint8_t>& data)
+{
+	bool sRGB = (format == DXGI_FORMAT_BC7_UNORM_SRGB);
+	auto toByte = [&](float value, int channel)
+	{
+		if (sRGB && channel < 3)  value = LinearToSRGB(value);
+		return static_cast<uint8_t>(std::clamp(value * 255.0f + 0.5f, 0.0f, 255.0f));
+	};
+
+	unsigned int blockSize = BlockSize(format);
+	for (unsigned int blockY = 0; blockY < (level.height + 3) / 4; ++blockY)
+	{
+		for (unsigned int blockX = 0; blockX < (level.width + 3) / 4; ++blockX)
+		{
+			uint8_t texels[16][4];
+			for (unsigned int i = 0; i < 16; ++i)
+			{
+				unsigned int x = std::min(blockX * 4 + i % 4, level.width  - 1);
+				unsigned int y = std::min(blockY * 4 + i / 4, level.height - 1);
+				const float* texel = &level.texels[(static_cast<size_t>(y) * level.width + x) * 4];
+				for (int c = 0; c < 4; ++c)  texels[i][c] = toByte(texel[c], c);
+			}
+
+			size_t offset = data.size();
+			data.resize(offset + blockSize);
+			if (format == DXGI_FORMAT_BC4_UNORM || format == DXGI_FORMAT_BC5_UNORM)
+			{
+				uint8_t values[2][16];
+				for (int i = 0; i < 16; ++i)  { values[0][i] = texels[i][0];  values[1][i] = texels[i][1]; }
+				EncodeBC4(values[0], &data[offset]);
+				if (format == DXGI_FORMAT_BC5_UNORM)  EncodeBC4(values[1], &data[offset + 8]);
+			}
+			else
+			{
+				EncodeBC7(texels, &data[offset]);
+			}
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Cache files
+//--------------------------------------------------------------------------------------
+
+// Block compressed format a texture of the given type is cached in. Several texture types share each value (see TextureType), so
+// each case is named by its PBR use
+DXGI_FORMAT TextureCacheFormat(TextureType type, bool sRGB)
+{
+	switch (type)
+	{
+		case TextureType::Normal:
+			return DXGI_FORMAT_BC5_UNORM;
+
+		case TextureType::Roughness:    // Also gloss and specular power
+		case TextureType::Displacement:
+		case TextureType::AO:
+		case TextureType::Cavity:
+			// Only data maps are single channel. One loaded as sRGB keeps its colour space, so it is stored as colour
+			if (!sRGB)  return DXGI_FORMAT_BC4_UNORM;
+			return DXGI_FORMAT_BC7_UNORM_SRGB;
+
+		case TextureType::Albedo:       // Also diffuse
+		case TextureType::Metalness:    // Also specular, which can be coloured
+		case TextureType::Emissive:
+			return sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+
+		default:
+			return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+
+// Name of the cache file for the given texture file in the given format, e.g. Snow1_Albedo.jpg.bc7-srgb.texcache.dds
+std::filesystem::path TextureCachePath(const std::filesystem::path& textureFile, DXGI_FORMAT format)
+{
+	auto tag = FormatTag(format);
+	auto cacheFile = textureFile;
+	cacheFile += std::string(".") + (tag ? tag : "unknown") + ".texcache.dds";
+	return cacheFile;
+}
+
+
+// Read the cache for the given texture file and format. Returns the contents of the DDS file, or empty data if there is no
+// cache or it is older than the texture file or from a different version. A cache in the asset archive is used in place
+AssetData ReadTextureCache(const std::filesystem::path& textureFile, DXGI_FORMAT format)
+{
+	if (FormatTag(format) == nullptr)  return {};
+
+	// Only use the cache if the texture hasn't changed since it was made. Archives keep the times of the files packed in them
+	auto cacheFile = TextureCachePath(textureFile, format);
+	AssetInfo sourceInfo, cacheInfo;
+	if (!gAssetFiles.GetInfo(textureFile, sourceInfo) || !gAssetFiles.GetInfo(cacheFile, cacheInfo) ||
+	    cacheInfo.time < sourceInfo.time)  return {};
+
+	AssetData data = gAssetFiles.Read(cacheFile);
+	size_t fileSize = data.size();
+	if (fileSize < DDS_DATA_OFFSET)  return {};
+
+	// Check the cache was made by this version of the code, in this format, and is complete
+	uint32_t magic;
+	DDSHeader header;
+	DDSHeaderDX10 header10;
+	std::memcpy(&magic,    data.data(), sizeof(magic));
+	std::memcpy(&header,   data.data() + sizeof(magic), sizeof(header));
+	std::memcpy(&header10, data.data() + sizeof(magic) + sizeof(header), sizeof(header10));
+	if (magic != DDS_MAGIC || header.reserved1[0] != TEXTURE_CACHE_MAGIC || header.reserved1[1] != TEXTURE_CACHE_VERSION ||
+	    header10.dxgiFormat != static_cast<uint32_t>(format) || header.mipMapCount != MipCount(header.width, header.height) ||
+	    fileSize != DDS_DATA_OFFSET + DataSize(header.width, header.height, format))  return {};
+
+	return data;
+}
+
+
+// Decode the given texture file with WIC, make its full mip chain, compress every level to the given format and write the cache,
+// replacing any existing one. Returns the contents of the DDS file, or an empty vector if the texture can't be converted
+std::vector<uint8_t> BuildTextureCache(IWICImagingFactory* wicFactory, const std::filesystem::path& textureFile, DXGI_FORMAT format)
+{
+	if (wicFactory == nullptr || FormatTag(format) == nullptr)  return {};
+
+	//-----------------------------------
+	// Decode the texture to 8-bit RGBA
+
+	// The file is decoded from memory so textures in the asset archive can be converted too
+	AssetData file = gAssetFiles.Read(textureFile);
+	if (file.empty() || file.size() > UINT_MAX)  return {};
+
+	CComPtr<IWICStream>            stream;
+	CComPtr<IWICBitmapDecoder>     decoder;
+	CComPtr<IWICBitmapFrameDecode> frame;
+	CComPtr<IWICFormatConverter>   converter;
+	UINT width = 0, height = 0;
+	HRESULT hr = wicFactory->CreateStream(&stream);
+	if (SUCCEEDED(hr))  hr = stream->InitializeFromMemory(const_cast<BYTE*>(file.data()), static_cast<DWORD>(file.size()));
+	if (SUCCEEDED(hr))  hr = wicFactory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+	if (SUCCEEDED(hr))  hr = decoder->GetFrame(0, &frame);
+	if (SUCCEEDED(hr))  hr = wicFactory->CreateFormatConverter(&converter);
+	if (SUCCEEDED(hr))  hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0, WICBitmapPaletteTypeCustom);
+	if (SUCCEEDED(hr))  hr = converter->GetSize(&width, &height);
+
+	// Block compressed textures must be a whole number of blocks across and down
+	if (FAILED(hr) || width == 0 || height == 0 || width % 4 != 0 || height % 4 != 0)  return {};
+
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+	hr = converter->CopyPixels(nullptr, width * 4, static_cast<UINT>(pixels.size()), pixels.data());
+	if (FAILED(hr))  return {};
+
+
+	//-----------------------------------
+	// Header
+
+	unsigned int mipCount = MipCount(width, height);
+	std::vector<uint8_t> data(DDS_DATA_OFFSET);
+	data.reserve(DDS_DATA_OFFSET + DataSize(width, height, format));
+
+	DDSHeader header = {};
+	header.size              = sizeof(DDSHeader);
+	header.flags             = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; // Caps, height, width, pixel format, mip count, linear size
+	header.height            = height;
+	header.width             = width;
+	header.pitchOrLinearSize = ((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+	header.mipMapCount       = mipCount;
+	header.reserved1[0]      = TEXTURE_CACHE_MAGIC;
+	header.reserved1[1]      = TEXTURE_CACHE_VERSION;
+	header.pixelFormat.size   = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags  = 0x4; // Four CC
+	header.pixelFormat.fourCC = DDS_FOURCC_DX10;
+	header.caps              = 0x1000 | 0x8 | 0x400000; // Texture, complex, mip-map
+
+	DDSHeaderDX10 header10 = {};
+	header10.dxgiFormat        = format;
+	header10.resourceDimension = D3D11_RESOURCE_DIMENSION_TEXTURE2D;
+	header10.arraySize         = 1;
+
+	std::memcpy(data.data(), &DDS_MAGIC, sizeof(DDS_MAGIC));
+	std::memcpy(data.data() + sizeof(DDS_MAGIC), &header, sizeof(header));
+	std::memcpy(data.data() + sizeof(DDS_MAGIC) + sizeof(header), &header10, sizeof(header10));
+
+
+	//-----------------------------------
+	// Mip chain
+
+	bool sRGB    = (format == DXGI_FORMAT_BC7_UNORM_SRGB);
+	bool normals = (format == DXGI_FORMAT_BC5_UNORM);
+
+	MipLevel level = { width, height };
+	level.texels.resize(pixels.size());
+	float toLinear[256];
+	for (int i = 0; i < 256; ++i)  toLinear[i] = sRGB ? SRGBToLinear(i / 255.0f) : i / 255.0f;
+	for (size_t i = 0; i < pixels.size(); ++i)  level.texels[i] = (i % 4 == 3) ? pixels[i] / 255.0f : toLinear[pixels[i]];
+
+	for (unsigned int mip = 0; mip < mipCount; ++mip)
+	{
+		if (mip > 0)  level = Downsample(level, normals);
+		CompressLevel(level, format, data);
+	}
+
+
+	//-----------------------------------
+	// Write to a temporary file then rename it over the cache, so an interrupted write or another thread converting the same
+	// texture never leaves a partial cache. The texture is still used if the cache can't be written
+
+	auto cacheFile = TextureCachePath(textureFile, format);
+	auto tempFile  = cacheFile;
+	tempFile += "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	bool written;
+	{
+		std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+		stream.write(reinterpret_cast<const char*>(data.data()), data.size());
+		written = static_cast<bool>(stream);
+	}
+
+	std::error_code error;
+	if (written)  std::filesystem::rename(tempFile, cacheFile, error);
+	if (!written || error)  std::filesystem::remove(tempFile, error);
+	return data;
+}
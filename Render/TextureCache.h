@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Texture cache functions - save JPG/PNG textures as block compressed DDS files with full mip chains
+//--------------------------------------------------------------------------------------
+// JPG and PNG textures must be decoded on the CPU every time they are loaded, then are sent to the GPU uncompressed (4 bytes
+// per texel) and their mip-maps generated there. Instead, the first time a texture is loaded it is decoded, its mip-maps are
+// made and every level is block compressed, then the result is saved next to the texture file in a DDS file. Later runs load
+// the DDS file directly, which is quicker and uses 4 to 8 times less GPU memory:
+//
+//   auto format = TextureCacheFormat(type, sRGB);
+//   AssetData dds = ReadTextureCache(textureFile, format);
+//   if (dds.empty())  dds = AssetData(BuildTextureCache(wicFactory, textureFile, format));
+//   if (!dds.empty())  ... create the texture from the DDS data ...
+//
+// The format depends on what the texture is used for:
+// - BC7 for colour maps (albedo, diffuse, specular, emissive), in sRGB if the texture is. Supports alpha
+// - BC5 for normal maps, which only stores x and y, the shaders rebuild z (see DecodeNormalMap in Common.hlsli)
+// - BC4 for single channel data maps (roughness, displacement etc.), the shaders only read their red channel
+// Each format has its own cache file, e.g. Snow1_Albedo.jpg.bc7-srgb.texcache.dds. A cache is only used if it was written by the
+// same version of this code and is at least as new as the texture file. Textures whose size is not a multiple of 4 can't be
+// block compressed and are always loaded from the source file
+//
+// The BC7 encoder only uses mode 6 (a single pair of colour+alpha endpoints per 4x4 block), which is fast and works well for
+// most textures. Increase TEXTURE_CACHE_VERSION whenever the conversion changes, to replace all existing caches
+
+#ifndef _TEXTURE_CACHE_H_INCLUDED_
+#define _TEXTURE_CACHE_H_INCLUDED_
+
+#include "TextureTypes.h"
+#include "AssetFiles.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <wincodec.h> // For IWICImagingFactory
+
+#include <filesystem>
+#include <vector>
+#include <stdint.h>
+
+
+// Version of the cache file contents, see above
+static const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+
+// Block compressed format a texture of the given type is cached in. Pass whether the texture is in sRGB colour space.
+// Returns DXGI_FORMAT_UNKNOWN for types that aren't cached (TextureType::Unknown, which is used for other textures)
+DXGI_FORMAT TextureCacheFormat(TextureType type, bool sRGB);
+
+// Name of the cache file for the given texture file in the given format
+std::filesystem::path TextureCachePath(const std::filesystem::path& textureFile, DXGI_FORMAT format);
+
+// Read the cache for the given texture file and format, through gAssetFiles so caches packed in the asset archive are used
+// without a copy. Returns the contents of the DDS file, or empty data if there is no cache or it is older than the texture file
+// or from a different version
+AssetData ReadTextureCache(const std::filesystem::path& textureFile, DXGI_FORMAT format);
+
+// Decode the given texture file (read through gAssetFiles) with WIC, make its full mip chain, compress every level to the given format and write the cache,
+// replacing any existing one. Returns the contents of the DDS file, even if it couldn't be written (e.g. a read-only folder).
+// Returns an empty vector if the texture can't be decoded or its size isn't a multiple of 4
+std::vector<uint8_t> BuildTextureCache(IWICImagingFactory* wicFactory, const std::filesystem::path& textureFile, DXGI_FORMAT format);
+
+
+#endif //_TEXTURE_CACHE_H_INCLUDED_
@@ -54,6 +54,12 @@ enum class TextureType
 };
 const int NUM_TEXTURE_TYPES = 8; // Total number of slots used in enum above - maximum number of texture slots that will be used in shaders
 
+// Whether textures of the given type may be loaded in SRGB format. Some data maps should not be
+inline bool AllowSRGB(TextureType type)
+{
+	return type != TextureType::Roughness && type != TextureType::Normal && type != TextureType::Displacement;
+}
+
 
 //--------------------------------------------------------------------------------------
 // Samplers
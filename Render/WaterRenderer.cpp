@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------------------
+// Water renderer - the sea as a camera-centred grid of patches tessellated by distance, with waves added on the GPU
+//--------------------------------------------------------------------------------------
+
+#include "WaterRenderer.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "Texture.h"
+#include "CBuffer.h"
+#include "State.h"
+#include "RenderCounters.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+
+// A long swell and three shorter waves across it. Directions are normalised
+const Vector4 WaterRenderer::WAVES[WaterConstants::NUM_WAVES] =
+{
+	{  0.800f, 0.600f, 60.0f, 0.55f },
+	{  0.196f, 0.981f, 31.0f, 0.30f },
+	{ -0.600f, 0.800f, 17.0f, 0.16f },
+	{  0.970f,-0.243f,  9.0f, 0.08f },
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the water shaders, texture and sampler and create the constant buffer. Throws std::runtime_error on failure
+WaterRenderer::WaterRenderer()
+{
+	if (DX->Device()->GetFeatureLevel() < D3D_FEATURE_LEVEL_11_0)  throw std::runtime_error("Water renderer: tessellation not supported");
+
+	mVertexShader = DX->Shaders()->LoadVertexShader("vs_water");
+	mHullShader   = DX->Shaders()->LoadHullShader  ("hs_water");
+	mDomainShader = DX->Shaders()->LoadDomainShader("ds_water");
+	mPixelShader  = DX->Shaders()->LoadPixelShader ("ps_water");
+	if (mVertexShader == nullptr || mHullShader == nullptr || mDomainShader == nullptr || mPixelShader == nullptr)
+		throw std::runtime_error("Water renderer: " + DX->Shaders()->GetLastError());
+
+	mTexture = DX->Textures()->LoadTexture("Media/Water_Albedo.png").second;
+	if (mTexture == nullptr)  throw std::runtime_error("Water renderer: " + DX->Textures()->GetLastError());
+
+	mSampler = DX->Textures()->CreateSampler({ TextureFilter::FilterAnisotropic, TextureAddressingMode::AddressingWrap });
+	if (mSampler == nullptr)  throw std::runtime_error("Water renderer: " + DX->Textures()->GetLastError());
+
+	mConstantBuffer = DX->CBuffers()->CreateCBuffer(sizeof(WaterConstants));
+	if (mConstantBuffer == nullptr)  throw std::runtime_error("Water renderer: failure creating constant buffer");
+
+	// The colours of the old water meshes' material
+	mConstants.diffuseColour  = { 0.8f, 0.8f, 0.8f, 1.0f };
+	mConstants.specularColour = { 0.2f, 0.2f, 0.2f };
+	mConstants.specularPower  = 25;
+	mConstants.uvScale        = 1.0f / 40.0f;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Draw the water around the given camera position with the current per-camera constants
+void WaterRenderer::Render(const Vector3& cameraPosition, float lodScale /*= 1.0f*/)
+{
+	if (!mSettings.enabled)  return;
+
+	// Snap the grid to whole patches at the centre (where they are smallest, see Water.hlsli) so vertices don't slide over the
+	// waves as the camera moves. The outer patches move by the same small steps, they are too far away to show it
+	const float innerPatchSize = 2 * GRID_EXTENT / GRID_PATCHES * 0.1f;
+	mConstants.gridCentre  = { std::floor(cameraPosition.x / innerPatchSize) * innerPatchSize, mSettings.height,
+	                           std::floor(cameraPosition.z / innerPatchSize) * innerPatchSize };
+	mConstants.gridExtent  = GRID_EXTENT;
+	mConstants.gridPatches = GRID_PATCHES;
+	mConstants.tessellationScale = mSettings.tessellationScale * lodScale;
+	mConstants.maxTessellation   = std::clamp(mSettings.maxTessellation, 1.0f, 64.0f);
+	mConstants.time              = mTime;
+	for (unsigned int i = 0; i < WaterConstants::NUM_WAVES; ++i)
+	{
+		mConstants.waves[i] = { WAVES[i].x, WAVES[i].y, WAVES[i].z, WAVES[i].w * mSettings.waveScale };
+	}
+	mConstants.waveFadeDistance = WAVE_FADE_DISTANCE;
+	mConstants.steepness        = std::clamp(mSettings.steepness, 0.0f, 1.0f);
+	DX->CBuffers()->UpdateCBuffer(mConstantBuffer, mConstants);
+
+	// The surface is only seen from above, so culling would save nothing and would depend on the tessellator's winding
+	DX->States()->SetRasterizerState(mSettings.wireframe ? RasterizerState::CullNoneWireframe : RasterizerState::CullNone);
+	DX->States()->SetDepthState(DepthState::DepthOn);
+	DX->States()->SetBlendState(BlendState::BlendNone);
+
+	auto context = DX->Context();
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_4_CONTROL_POINT_PATCHLIST);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->HSSetShader(mHullShader,   nullptr, 0);
+	context->DSSetShader(mDomainShader, nullptr, 0);
+	context->PSSetShader(mPixelShader,  nullptr, 0);
+	context->VSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->HSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->DSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->PSSetConstantBuffers(5, 1, &mConstantBuffer);
+	context->PSSetShaderResources(0, 1, &mTexture);
+	context->PSSetSamplers(0, 1, &mSampler);
+	context->Draw(GRID_PATCHES * GRID_PATCHES * 4, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	// The other renderers don't use tessellation, so take the hull and domain shaders off again
+	context->HSSetShader(nullptr, nullptr, 0);
+	context->DSSetShader(nullptr, nullptr, 0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+}
@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// Water renderer - the sea as a camera-centred grid of patches tessellated by distance, with waves added on the GPU
+//--------------------------------------------------------------------------------------
+// Rather than large static water meshes with the same density everywhere, the surface is a grid of GRID_PATCHES x GRID_PATCHES
+// square patches following the camera, drawn with no vertex buffer. The grid is warped so the patches are small near the
+// camera and large towards the edge (see Water.hlsli), then the hull shader splits each edge by its length over its distance
+// from the camera (hs_water), so triangles are roughly the same size on screen near and far. The domain shader adds a few
+// Gerstner waves to each vertex (ds_water), so nearby waves are detailed while the vertex cost stays the same wherever the
+// camera is. The grid centre is snapped to whole inner patches so the vertices don't slide over the waves as the camera moves.
+//
+//   waterRenderer.Advance(stepTime);                           // With each simulation step, the waves stay still while paused
+//   waterRenderer.Render(camera->Transform().Position());      // In the opaque pass of each view, with its camera constants set
+//
+// Needs hardware feature level 11 for tessellation, the constructor throws without it and the water meshes are drawn instead
+
+#ifndef _WATER_RENDERER_H_INCLUDED_
+#define _WATER_RENDERER_H_INCLUDED_
+
+#include "CBufferTypes.h"
+#include "Vector3.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+
+
+class WaterRenderer
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the water shaders, texture and sampler and create the constant buffer. Throws std::runtime_error on failure, e.g. if
+	// the device doesn't support tessellation
+	WaterRenderer();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Patches along each side of the grid, and the distance from the centre of the grid to its edge
+	static constexpr uint32_t GRID_PATCHES = 32;
+	static constexpr float    GRID_EXTENT  = 2000.0f;
+
+	// Move the waves on by the time of a simulation step
+	void Advance(float stepTime)  { mTime += stepTime; }
+
+	// Draw the water around the given camera position with the current per-camera constants, in the opaque pass. Pass a level of
+	// detail scale below 1 for views smaller than the main view, to tessellate less. Sets its own render states
+	void Render(const Vector3& cameraPosition, float lodScale = 1.0f);
+
+	// Adjustable settings, see the control panel
+	struct Settings
+	{
+		bool  enabled           = true;
+		bool  wireframe         = false;
+		float height            = 0.0f;  // Of the water plane, before the waves
+		float waveScale         = 1.0f;  // Multiplies the height of every wave
+		float steepness         = 0.6f;  // 0 for rounded waves, 1 for the sharpest crests
+		float tessellationScale = 24.0f; // Edge factor is this times its length over its distance from the camera
+		float maxTessellation   = 64.0f; // At most 64, D3D11's limit
+	};
+	Settings& GetSettings()  { return mSettings; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Distance over which the waves flatten out, where the tessellation is too coarse to show them
+	static constexpr float WAVE_FADE_DISTANCE = 600.0f;
+
+	// Direction (x, z), wavelength and amplitude of each wave, in world units. Scaled by Settings::waveScale
+	static const Vector4 WAVES[WaterConstants::NUM_WAVES];
+
+	Settings mSettings;
+	float    mTime = 0;
+
+	ID3D11VertexShader*       mVertexShader   = nullptr; // Owned by the shader manager
+	ID3D11HullShader*         mHullShader     = nullptr;
+	ID3D11DomainShader*       mDomainShader   = nullptr;
+	ID3D11PixelShader*        mPixelShader    = nullptr;
+	ID3D11ShaderResourceView* mTexture        = nullptr; // Owned by the texture manager
+	ID3D11SamplerState*       mSampler        = nullptr;
+	ID3D11Buffer*             mConstantBuffer = nullptr; // Owned by the constant buffer manager
+	WaterConstants            mConstants;
+};
+
+
+#endif //_WATER_RENDERER_H_INCLUDED_
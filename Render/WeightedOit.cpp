@@ -0,0 +1,138 @@
+//--------------------------------------------------------------------------------------
+// Weighted blended order-independent transparency for the additive render group
+//--------------------------------------------------------------------------------------
+
+#include "WeightedOit.h"
+
+#include "RenderGlobals.h"
+#include "RenderMethod.h"
+#include "Shader.h"
+#include "RenderCounters.h"
+
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Load the composite shaders. Throws std::runtime_error on failure
+WeightedOit::WeightedOit()
+{
+	mVertexShader    = DX->Shaders()->LoadVertexShader("vs_fullscreen_uv");
+	mCompositeShader = DX->Shaders()->LoadPixelShader ("ps_weighted-oit-composite");
+	if (mVertexShader == nullptr || mCompositeShader == nullptr)
+		throw std::runtime_error("Weighted blended transparency: " + DX->Shaders()->GetLastError());
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Clear and set the accumulation and revealage targets, and the weighted transparency blend state and shaders
+bool WeightedOit::Begin()
+{
+	if (!CreateTargets())  return false;
+	auto context = DX->Context();
+
+	// Keep what is set now to put it back in End
+	mPreviousTarget = nullptr;
+	mPreviousDepth  = nullptr;
+	context->OMGetRenderTargets(1, &mPreviousTarget, &mPreviousDepth);
+	mPreviousBlendState = DX->States()->GetBlendState();
+	mPreviousDepthState = DX->States()->GetDepthState();
+
+	const float accumulationClear[4] = { 0, 0, 0, 0 };
+	const float revealageClear[4]    = { 1, 1, 1, 1 };
+	context->ClearRenderTargetView(mAccumulationTarget, accumulationClear);
+	context->ClearRenderTargetView(mRevealageTarget,    revealageClear);
+
+	// The layers are hidden behind the solid entities but mustn't hide each other
+	ID3D11RenderTargetView* targets[] = { mAccumulationTarget, mRevealageTarget };
+	context->OMSetRenderTargets(2, targets, mPreviousDepth);
+	DX->States()->SetDepthState(DepthState::DepthReadOnly);
+	DX->States()->SetBlendState(BlendState::BlendWeightedOit);
+	RenderState::SetWeightedOit(true);
+	return true;
+}
+
+
+// Composite what was drawn since Begin over the scene target, then put back the targets and blend state Begin found
+void WeightedOit::End()
+{
+	RenderState::SetWeightedOit(false);
+	auto context = DX->Context();
+	context->OMSetRenderTargets(1, &mPreviousTarget.p, nullptr);
+	DX->States()->SetDepthState(DepthState::DepthOff);
+	DX->States()->SetBlendState(BlendState::BlendAlpha);
+
+	// A triangle covering the viewport, the targets are at the same pixels as the scene target
+	ID3D11ShaderResourceView* textures[] = { mAccumulationView, mRevealageView };
+	context->IASetInputLayout(nullptr);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->VSSetShader(mVertexShader, nullptr, 0);
+	context->PSSetShader(mCompositeShader, nullptr, 0);
+	context->PSSetShaderResources(0, 2, textures);
+	context->Draw(3, 0);
+	gRenderCounters.Add(RenderCounter::Draws);
+
+	// Unbind the targets' views so they can be render targets again
+	ID3D11ShaderResourceView* nullViews[2] = {};
+	context->PSSetShaderResources(0, 2, nullViews);
+	RenderState::Reset(); // Shaders and textures were changed outside of RenderState
+
+	context->OMSetRenderTargets(1, &mPreviousTarget.p, mPreviousDepth);
+	DX->States()->SetDepthState(mPreviousDepthState);
+	DX->States()->SetBlendState(mPreviousBlendState);
+	mPreviousTarget = nullptr;
+	mPreviousDepth  = nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Make sure the targets are the size of the back buffer, recreating them if it has changed size
+bool WeightedOit::CreateTargets()
+{
+	unsigned int width  = DX->GetBackbufferWidth();
+	unsigned int height = DX->GetBackbufferHeight();
+	if (width == mWidth && height == mHeight && mAccumulationTarget != nullptr)  return true;
+
+	mWidth = mHeight = 0;
+	mAccumulationTarget = nullptr;
+	mAccumulationView   = nullptr;
+	mRevealageTarget    = nullptr;
+	mRevealageView      = nullptr;
+	auto device = DX->Device();
+
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = width;
+	textureDesc.Height           = height;
+	textureDesc.MipLevels        = 1;
+	textureDesc.ArraySize        = 1;
+	textureDesc.Format           = ACCUMULATION_FORMAT;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	CComPtr<ID3D11Texture2D> accumulationTexture;
+	if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &accumulationTexture)) ||
+	    FAILED(device->CreateRenderTargetView(accumulationTexture, nullptr, &mAccumulationTarget)) ||
+	    FAILED(device->CreateShaderResourceView(accumulationTexture, nullptr, &mAccumulationView)))  return false;
+
+	textureDesc.Format = REVEALAGE_FORMAT;
+	CComPtr<ID3D11Texture2D> revealageTexture;
+	if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &revealageTexture)) ||
+	    FAILED(device->CreateRenderTargetView(revealageTexture, nullptr, &mRevealageTarget)) ||
+	    FAILED(device->CreateShaderResourceView(revealageTexture, nullptr, &mRevealageView)))
+	{
+		mAccumulationTarget = nullptr;
+		return false;
+	}
+
+	mWidth  = width;
+	mHeight = height;
+	return true;
+}
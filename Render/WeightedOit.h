@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// Weighted blended order-independent transparency for the additive render group
+//--------------------------------------------------------------------------------------
+// Blended entities are drawn back to front so nearer layers cover those behind, which needs their draws sorted by distance
+// every frame, and is still wrong where objects overlap each other. Weighted blended transparency (McGuire and Bavoil 2013)
+// gives a result that doesn't depend on the order at all, so the draws can be grouped by render state (DrawOrder::ByState):
+//  - Begin clears two targets, the accumulation (to 0) and revealage (to 1), and sets them with the scene's depth buffer, which
+//    is only read. Each render state draws with its "_oit" pixel shader (see RenderState::SetWeightedOit) and
+//    BlendState::BlendWeightedOit. The shaders add the colour and alpha of each layer, weighted by alpha and nearness, to the
+//    accumulation target and multiply the revealage target by (1 - alpha), see WeightedOit.hlsli
+//  - End composites the average colour of the layers (accumulation colour / accumulation alpha) over the scene, with alpha
+//    blending by how much of it the layers together hide (1 - revealage), see ps_weighted-oit-composite
+//
+// The cost is fixed for each pixel drawn whatever the order. It is an approximation: layers of similar weight blend as if at
+// the same depth, so a far opaque-looking layer shows a little through a near one. Every pixel shader has an "_oit" version, the
+// lit ones include their usual shader and pass its result on, so lit materials are shaded the same as when sorted
+//
+//   if (oit.Enabled() && oit.Begin())  { ... draw the blended entities with DrawOrder::ByState ...  oit.End(); }
+//
+// Begin saves the render target, depth buffer and blend state, End puts them back. The draws in between must not use other
+// render targets or blend states
+
+#ifndef _WEIGHTED_OIT_H_INCLUDED_
+#define _WEIGHTED_OIT_H_INCLUDED_
+
+#include "State.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+
+class WeightedOit
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Formats of the targets. The accumulation needs range and precision to add many weighted layers, the revealage only a fraction
+	static constexpr DXGI_FORMAT ACCUMULATION_FORMAT = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	static constexpr DXGI_FORMAT REVEALAGE_FORMAT    = DXGI_FORMAT_R16_FLOAT;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the composite shaders. The targets are created on first use. Throws std::runtime_error on failure
+	WeightedOit();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Clear and set the accumulation and revealage targets, and the weighted transparency blend state and shaders. Returns false,
+	// changing nothing, if the targets can't be created, then draw the entities with the usual blending
+	bool Begin();
+
+	// Composite what was drawn since Begin over the scene target, then put back the targets and blend state Begin found
+	void End();
+
+	// Enable or disable weighted blended transparency. The class doesn't check this itself, it is for the code choosing to use it
+	bool& Enabled()  { return mEnabled; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Make sure the targets are the size of the back buffer, recreating them if it has changed size. Returns false on failure
+	bool CreateTargets();
+
+	bool mEnabled = false;
+
+	ID3D11VertexShader* mVertexShader    = nullptr; // Owned by the shader manager
+	ID3D11PixelShader*  mCompositeShader = nullptr;
+
+	unsigned int                      mWidth  = 0;
+	unsigned int                      mHeight = 0;
+	CComPtr<ID3D11RenderTargetView>   mAccumulationTarget;
+	CComPtr<ID3D11ShaderResourceView> mAccumulationView;
+	CComPtr<ID3D11RenderTargetView>   mRevealageTarget;
+	CComPtr<ID3D11ShaderResourceView> mRevealageView;
+
+	// What Begin found, put back by End
+	CComPtr<ID3D11RenderTargetView> mPreviousTarget;
+	CComPtr<ID3D11DepthStencilView> mPreviousDepth;
+	BlendState mPreviousBlendState = BlendState::BlendNone;
+	DepthState mPreviousDepthState = DepthState::DepthReadOnly;
+};
+
+
+#endif //_WEIGHTED_OIT_H_INCLUDED_
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// AI scheduler - level of detail for boat behaviour
+//--------------------------------------------------------------------------------------
+
+#include "AIScheduler.h"
+#include "Boat.h"
+#include "EntityManager.h"
+#include "SceneGlobals.h"
+
+#include <algorithm>
+
+
+// Choose which boats think in the coming update of the given length. Call once just before each entity update
+void AIScheduler::Schedule(float updateTime)
+{
+	mDue.clear();
+	for (Boat* boat : gEntityManager->View<Boat>())
+	{
+		boat->SetThinkThisUpdate(false);
+
+		// Seconds between thinks wanted for this boat, 0 for every update
+		float interval = 0.0f;
+		if (mEnabled && mHasFocus && !boat->IsInCombat())
+		{
+			float distance = Distance(boat->Transform().Position(), mFocus);
+			if (distance > NEAR_DISTANCE)
+			{
+				float farness = std::min((distance - NEAR_DISTANCE) / (FAR_DISTANCE - NEAR_DISTANCE), 1.0f);
+				interval = 1.0f / (NEAR_TICK_RATE + (FAR_TICK_RATE - NEAR_TICK_RATE) * farness);
+			}
+		}
+
+		// Due if it will have waited at least the interval by the end of the update
+		float waited = boat->TimeSinceThought() + updateTime;
+		if (waited >= interval)  mDue.push_back({ boat, interval == 0.0f, waited - interval });
+	}
+
+	// Over budget, keep the boats thinking every update then the longest overdue
+	size_t thinking = mDue.size();
+	if (mEnabled && thinking > static_cast<size_t>(mThinkBudget))
+	{
+		thinking = mThinkBudget;
+		std::nth_element(mDue.begin(), mDue.begin() + thinking, mDue.end(), [](const DueBoat& a, const DueBoat& b)
+		{
+			if (a.everyUpdate != b.everyUpdate)  return a.everyUpdate;
+			return a.overdue > b.overdue;
+		});
+	}
+	for (size_t i = 0; i < thinking; ++i)  mDue[i].boat->SetThinkThisUpdate(true);
+
+	mThinkingCount = static_cast<int>(thinking);
+	mDeferredCount = static_cast<int>(mDue.size() - thinking);
+}
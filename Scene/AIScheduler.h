@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// AI scheduler - level of detail for boat behaviour
+//--------------------------------------------------------------------------------------
+// A boat's behaviour (its state machine, steering, collision avoidance and enemy checks) is the most expensive part of its
+// update, but it doesn't need to run every update for boats the player can barely see. Before each entity update the
+// scheduler picks which boats think in it:
+//  - Boats near the focus point (the camera) or in combat (see Boat::IsInCombat) think every update
+//  - Further away, patrolling boats think less often, from NEAR_TICK_RATE down to FAR_TICK_RATE times a second
+//  - No more than the think budget of boats think in one update, so the AI cost of an update is capped whatever the number
+//    of boats. Boats left over wait for the next update, those thinking every update first, then the longest overdue
+// A boat that isn't thinking still moves on its current heading and speed and handles its messages, and the next time it
+// thinks its behaviour is run with all the time since it last did (see Boat::Update). Without a focus point, e.g. a headless
+// battle, every boat thinks every update so results don't depend on where a camera was
+//
+//   mAIScheduler.SetFocus(camera->Transform().Position());
+//   mAIScheduler.Schedule(stepTime);  // Just before gEntityManager->UpdateAll(stepTime)
+
+#ifndef _AI_SCHEDULER_H_INCLUDED_
+#define _AI_SCHEDULER_H_INCLUDED_
+
+#include "Vector3.h"
+
+#include <vector>
+
+
+class Boat;
+
+class AIScheduler
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Distances from the focus where the think rate starts to drop and where it reaches its lowest
+	static constexpr float NEAR_DISTANCE = 200.0f;
+	static constexpr float FAR_DISTANCE  = 500.0f;
+
+	// Thinks per second of a boat just beyond NEAR_DISTANCE and of one at FAR_DISTANCE or further
+	static constexpr float NEAR_TICK_RATE = 20.0f;
+	static constexpr float FAR_TICK_RATE  = 10.0f;
+
+	// The level of detail can be turned off, so every boat thinks every update
+	void SetEnabled(bool enabled)  { mEnabled = enabled; }
+	bool IsEnabled()               { return mEnabled; }
+
+	// Boats near this point get full rate AI. Without a focus every boat thinks every update
+	void SetFocus(const Vector3& focus)  { mFocus = focus;  mHasFocus = true; }
+	void ClearFocus()                    { mHasFocus = false; }
+
+	// The most boats that think in one update, at least 1
+	void SetThinkBudget(int boats)  { mThinkBudget = boats < 1 ? 1 : boats; }
+	int  GetThinkBudget()           { return mThinkBudget; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Choose which boats think in the coming update of the given length. Call once just before each entity update
+	void Schedule(float updateTime);
+
+	// Boats thinking in the coming update and boats that were due but left over for the budget, for display
+	int ThinkingCount()  { return mThinkingCount; }
+	int DeferredCount()  { return mDeferredCount; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A boat due to think, and how it ranks for the budget
+	struct DueBoat
+	{
+		Boat* boat;
+		bool  everyUpdate; // Near or in combat, ranked first
+		float overdue;     // Seconds past when it should have thought
+	};
+	std::vector<DueBoat> mDue; // Kept to reuse its capacity
+
+	bool    mEnabled     = true;
+	bool    mHasFocus    = false;
+	Vector3 mFocus       = { 0, 0, 0 };
+	int     mThinkBudget = 32;
+
+	int mThinkingCount = 0;
+	int mDeferredCount = 0;
+};
+
+
+#endif //_AI_SCHEDULER_H_INCLUDED_
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// Ballistic solver - launch velocities for missiles to hit moving targets under gravity
+//--------------------------------------------------------------------------------------
+
+#include "BallisticSolver.h"
+#include "EntityManager.h"
+#include "Boat.h"
+
+#include <emmintrin.h> // SSE2, always available on x64
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add a request to the batch, returns its index in the results
+size_t BallisticSolver::AddRequest(const Request& request)
+{
+	Vector3 offset = request.target - request.launch;
+	mX.push_back(offset.x);
+	mY.push_back(offset.y);
+	mZ.push_back(offset.z);
+	mVX.push_back(request.targetVelocity.x);
+	mVY.push_back(request.targetVelocity.y);
+	mVZ.push_back(request.targetVelocity.z);
+	mSpeed.push_back(request.speed);
+	return mSpeed.size() - 1;
+}
+
+void BallisticSolver::Clear()
+{
+	mX.clear();   mY.clear();   mZ.clear();
+	mVX.clear();  mVY.clear();  mVZ.clear();
+	mSpeed.clear();
+}
+
+
+// Solve every request in the batch for missiles that are updated in steps of the given length
+void BallisticSolver::Solve(float step)
+{
+	// Pad with stationary targets one unit away, which give ordinary results that are never read
+	size_t count  = mSpeed.size();
+	size_t padded = (count + 3) & ~size_t(3);
+	mX.resize(padded, 1.0f);   mY.resize(padded, 0.0f);   mZ.resize(padded, 0.0f);
+	mVX.resize(padded, 0.0f);  mVY.resize(padded, 0.0f);  mVZ.resize(padded, 0.0f);
+	mSpeed.resize(padded, 1.0f);
+	mResults.resize(padded);
+
+	// Flight times are kept above a minimum so a target at the launch point doesn't divide by zero
+	const __m128 minimumTime = _mm_set1_ps(0.001f);
+	const __m128 fall        = _mm_set1_ps(0.5f * GRAVITY);
+	const __m128 stepTime    = _mm_set1_ps(step);
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		__m128 x  = _mm_loadu_ps(&mX[i]);
+		__m128 y  = _mm_loadu_ps(&mY[i]);
+		__m128 z  = _mm_loadu_ps(&mZ[i]);
+		__m128 vx = _mm_loadu_ps(&mVX[i]);
+		__m128 vy = _mm_loadu_ps(&mVY[i]);
+		__m128 vz = _mm_loadu_ps(&mVZ[i]);
+		__m128 speed = _mm_loadu_ps(&mSpeed[i]);
+
+		// Time to reach the target where it is now, then refine with where it will be
+		__m128 distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		__m128 time = _mm_max_ps(_mm_div_ps(_mm_sqrt_ps(distSquared), speed), minimumTime);
+		__m128 px, py, pz;
+		for (int iteration = 0; ; ++iteration)
+		{
+			px = _mm_add_ps(x, _mm_mul_ps(vx, time));
+			py = _mm_add_ps(y, _mm_mul_ps(vy, time));
+			pz = _mm_add_ps(z, _mm_mul_ps(vz, time));
+			if (iteration == ITERATIONS)  break;
+			distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)), _mm_mul_ps(pz, pz));
+			time = _mm_max_ps(_mm_div_ps(_mm_sqrt_ps(distSquared), speed), minimumTime);
+		}
+
+		// Missiles add gravity to their velocity before moving each step, so by time t they have fallen by
+		// 0.5 * g * t * (t + step) rather than 0.5 * g * t^2. Raise the vertical velocity to make up for it
+		__m128 invTime = _mm_div_ps(_mm_set1_ps(1.0f), time);
+		__m128 drop    = _mm_mul_ps(_mm_mul_ps(fall, time), _mm_add_ps(time, stepTime));
+		alignas(16) float results[3][4];
+		_mm_store_ps(results[0], _mm_mul_ps(px, invTime));
+		_mm_store_ps(results[1], _mm_mul_ps(_mm_sub_ps(py, drop), invTime));
+		_mm_store_ps(results[2], _mm_mul_ps(pz, invTime));
+		for (int lane = 0; lane < 4; ++lane)  mResults[i + lane] = { results[0][lane], results[1][lane], results[2][lane] };
+	}
+
+	// Leave the batch as it was given so more requests can be added
+	mX.resize(count);   mY.resize(count);   mZ.resize(count);
+	mVX.resize(count);  mVY.resize(count);  mVZ.resize(count);
+	mSpeed.resize(count);
+	mResults.resize(count);
+}
+
+
+// Solve a single request on its own, in the same way as Solve
+Vector3 BallisticSolver::SolveOne(const Request& request, float step)
+{
+	Vector3 offset = request.target - request.launch;
+	float time = std::max(offset.Length() / request.speed, 0.001f);
+	Vector3 predicted;
+	for (int iteration = 0; ; ++iteration)
+	{
+		predicted = offset + request.targetVelocity * time;
+		if (iteration == ITERATIONS)  break;
+		time = std::max(predicted.Length() / request.speed, 0.001f);
+	}
+	predicted.y -= 0.5f * GRAVITY * time * (time + step);
+	return predicted * (1.0f / time);
+}
+
+
+// Give every aiming boat its launch velocity at its target. Called by the EntityManager at the start of UpdateAll
+void BallisticSolver::UpdateAimingBoats(EntityManager& entities, float frameTime)
+{
+	Clear();
+	mAimingBoats.clear();
+	for (Boat* boat : entities.View<Boat>())
+	{
+		if (boat->GetState() != Boat::State::Aim)  continue;
+		Boat* target = entities.GetEntity<Boat>(boat->GetTargetBoat());
+		if (target == nullptr)  continue;
+
+		mAimingBoats.push_back(boat);
+		AddRequest(boat->AimRequest(target));
+	}
+
+	Solve(frameTime);
+	for (size_t i = 0; i < mAimingBoats.size(); ++i)  mAimingBoats[i]->SetLaunchVelocity(mResults[i], mAimingBoats[i]->GetTargetBoat());
+	mAimingCount = static_cast<int>(mAimingBoats.size());
+}
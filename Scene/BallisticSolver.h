@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Ballistic solver - launch velocities for missiles to hit moving targets under gravity
+//--------------------------------------------------------------------------------------
+// Each request is a launch point, a target point, the target's velocity and the missile's launch speed. The flight time is
+// found by iterating: the time to reach the target where it is, then the time to reach where the target will be after that
+// time, and so on, which settles within a few iterations while the target is slower than the missile. The launch
+// velocity then reaches that point in that time, with the vertical part raised to make up for the fall under gravity, as
+// the missile applies it (see Missile::Update) each simulation step.
+//
+// Requests are solved four at a time with SSE. Once per UpdateAll, before any entity is updated, the EntityManager has the
+// solver work out the launch velocity of every aiming boat at its target in one batch (see UpdateAimingBoats), which the
+// boat uses when it fires. The solver can also be given batches of its own (AddRequest / Solve) or solve a single request
+
+#ifndef _BALLISTIC_SOLVER_H_INCLUDED_
+#define _BALLISTIC_SOLVER_H_INCLUDED_
+
+#include "Vector3.h"
+
+#include <vector>
+
+
+class EntityManager;
+class Boat;
+
+class BallisticSolver
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	static constexpr float GRAVITY    = -9.81f; // Must match Missile::Update
+	static constexpr int   ITERATIONS = 4;      // Refinements of the flight time
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	struct Request
+	{
+		Vector3 launch;
+		Vector3 target;
+		Vector3 targetVelocity;
+		float   speed;
+	};
+
+	// Add a request to the batch, returns its index in the results. Clear empties the batch
+	size_t AddRequest(const Request& request);
+	void   Clear();
+
+	// Solve every request in the batch for missiles that are updated in steps of the given length
+	void Solve(float step);
+
+	// Launch velocity for a request from the last Solve
+	const Vector3& Result(size_t request)  { return mResults[request]; }
+
+	// Solve a single request on its own, in the same way as Solve
+	static Vector3 SolveOne(const Request& request, float step);
+
+	// Give every aiming boat its launch velocity at its target (see Boat::SetLaunchVelocity). Called by the EntityManager at
+	// the start of UpdateAll with the length of the update
+	void UpdateAimingBoats(EntityManager& entities, float frameTime);
+
+	// Requests solved in the last UpdateAimingBoats, for display
+	int AimingCount()  { return mAimingCount; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Structure of arrays, one element per request, padded to a multiple of four with harmless requests so the SSE loop
+	// needs no special case for the last few
+	std::vector<float> mX,  mY,  mZ;   // Target relative to launch point
+	std::vector<float> mVX, mVY, mVZ;  // Target velocity
+	std::vector<float> mSpeed;
+	std::vector<Vector3> mResults;
+
+	std::vector<Boat*> mAimingBoats;
+	int mAimingCount = 0;
+};
+
+
+#endif //_BALLISTIC_SOLVER_H_INCLUDED_
@@ -0,0 +1,182 @@
+//--------------------------------------------------------------------------------------
+// Behaviours - entity scripts written as C++20 coroutines, resumed only when what they wait for has happened
+//--------------------------------------------------------------------------------------
+
+#include "Behaviour.h"
+#include "EntityManager.h"
+
+#include "SceneGlobals.h" // For gMessenger
+
+
+/*-----------------------------------------------------------------------------------------
+   Waits
+-----------------------------------------------------------------------------------------*/
+
+void WaitSeconds::await_suspend(Behaviour::Handle handle)
+{
+	handle.promise().scheduler->WaitTime(handle, seconds);
+}
+
+void WaitForMessage::await_suspend(Behaviour::Handle handle)
+{
+	mHandle = handle;
+	handle.promise().scheduler->WaitMessage(handle, type);
+}
+
+Message WaitForMessage::await_resume()
+{
+	return mHandle.promise().message;
+}
+
+void Arrive::await_suspend(Behaviour::Handle handle)
+{
+	handle.promise().scheduler->WaitArrive(handle, point, range);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Scheduler
+-----------------------------------------------------------------------------------------*/
+
+BehaviourScheduler::~BehaviourScheduler()
+{
+	for (auto& [owner, run] : mRuns)  run.handle.destroy();
+}
+
+
+// Start a behaviour for the given entity, stopping any it is running, and run it up to its first wait
+void BehaviourScheduler::Start(EntityID owner, Behaviour behaviour)
+{
+	Stop(owner);
+	Behaviour::Handle handle = behaviour.Release();
+	if (!handle)  return;
+
+	uint64_t run = mNextRun++;
+	handle.promise().scheduler = this;
+	handle.promise().owner     = owner;
+	handle.promise().run       = run;
+	mRuns[owner] = { handle, run };
+	Resume(owner, run);
+}
+
+
+// Stop the entity's behaviour. A behaviour stopped while it is running (e.g. by itself) is destroyed once it next waits or
+// ends, by Resume
+void BehaviourScheduler::Stop(EntityID owner)
+{
+	auto found = mRuns.find(owner);
+	if (found == mRuns.end())  return;
+
+	if (owner == mResuming)  mStopResuming = true;
+	else                     found->second.handle.destroy();
+	mRuns.erase(found);
+}
+
+
+// Seconds until the entity's behaviour is due to resume if it is waiting for time
+float BehaviourScheduler::TimeLeft(EntityID owner) const
+{
+	auto found = mRuns.find(owner);
+	if (found == mRuns.end() || found->second.resumeTime <= mTime)  return 0;
+	return static_cast<float>(found->second.resumeTime - mTime);
+}
+
+
+// Resume the behaviours whose waits are over: time first, then messages then arrivals, each in the order the waits began
+void BehaviourScheduler::Update(EntityManager& entities, float frameTime)
+{
+	mResumed = 0;
+	mTime += frameTime;
+
+	// Waits begun by the behaviours resumed here are left for the next update, even if they are already due
+	uint64_t endSequence = mNextSequence;
+	while (!mTimeWaits.empty() && mTimeWaits.top().due <= mTime && mTimeWaits.top().sequence < endSequence)
+	{
+		TimeWait wait = mTimeWaits.top();
+		mTimeWaits.pop();
+		Resume(wait.owner, wait.run);
+	}
+
+	// Behaviours resumed here may begin new waits, which are first checked in the next update
+	mMessageWaitsNow.clear();
+	mMessageWaitsNow.swap(mMessageWaits);
+	for (const MessageWait& wait : mMessageWaitsNow)
+	{
+		auto found = mRuns.find(wait.owner);
+		if (found == mRuns.end() || found->second.run != wait.run)  continue; // Stopped, forget the wait
+
+		bool arrived = false;
+		for (const Message& message : gMessenger->ReceiveAll(wait.owner))
+		{
+			if (message.type != wait.type)  continue;
+			found->second.handle.promise().message = message;
+			arrived = true;
+			break;
+		}
+		if (arrived)  Resume(wait.owner, wait.run);
+		else          mMessageWaits.push_back(wait);
+	}
+
+	mArriveWaitsNow.clear();
+	mArriveWaitsNow.swap(mArriveWaits);
+	for (const ArriveWait& wait : mArriveWaitsNow)
+	{
+		auto found = mRuns.find(wait.owner);
+		if (found == mRuns.end() || found->second.run != wait.run)  continue;
+
+		Entity* entity = entities.GetEntity(wait.owner);
+		if (entity == nullptr)  continue;
+		if ((entity->Transform().Position() - wait.point).Length() < wait.range)  Resume(wait.owner, wait.run);
+		else                                                                      mArriveWaits.push_back(wait);
+	}
+}
+
+
+void BehaviourScheduler::WaitTime(Behaviour::Handle handle, float seconds)
+{
+	double due = mTime + (seconds > 0 ? seconds : 0);
+	mTimeWaits.push({ due, mNextSequence++, handle.promise().owner, handle.promise().run });
+	auto found = mRuns.find(handle.promise().owner);
+	if (found != mRuns.end())  found->second.resumeTime = due;
+}
+
+void BehaviourScheduler::WaitMessage(Behaviour::Handle handle, MessageType type)
+{
+	mMessageWaits.push_back({ handle.promise().owner, handle.promise().run, type });
+}
+
+void BehaviourScheduler::WaitArrive(Behaviour::Handle handle, const Vector3& point, float range)
+{
+	mArriveWaits.push_back({ handle.promise().owner, handle.promise().run, point, range });
+}
+
+
+// Resume a behaviour if the wait is still its current one. Behaviours can start and stop others while running, so the
+// behaviour being resumed is kept for the nested case
+void BehaviourScheduler::Resume(EntityID owner, uint64_t run)
+{
+	auto found = mRuns.find(owner);
+	if (found == mRuns.end() || found->second.run != run)  return;
+
+	Behaviour::Handle handle = found->second.handle;
+	found->second.resumeTime = 0;
+	EntityID outerResuming = mResuming;
+	bool     outerStop     = mStopResuming;
+	mResuming = owner;
+	mStopResuming = false;
+
+	handle.resume();
+	++mResumed;
+
+	if (mStopResuming)
+	{
+		handle.destroy(); // Already removed from mRuns by Stop
+	}
+	else if (handle.done())
+	{
+		handle.destroy();
+		mRuns.erase(owner);
+	}
+	mResuming = outerResuming;
+	mStopResuming = outerStop;
+}
@@ -0,0 +1,218 @@
+//--------------------------------------------------------------------------------------
+// Behaviours - entity scripts written as C++20 coroutines, resumed only when what they wait for has happened
+//--------------------------------------------------------------------------------------
+// A behaviour is a member function of an entity returning Behaviour, which reads as a sequence of steps and waits rather
+// than a state polled every update with timers kept by hand:
+//
+//   Behaviour Boat::ReloadBehaviour(Vector3 station)
+//   {
+//       co_await Arrive(station, DOCK_RANGE);        // Resumed once the boat is within range of the station
+//       ...
+//       co_await WaitSeconds(RELOAD_TIME);           // Resumed once the time has passed
+//       Message turn = co_await WaitForMessage(MessageType::Reload);  // Resumed in the update the message arrives
+//   }
+//   gEntityManager->Behaviours().Start(GetID(), ReloadBehaviour(station));
+//
+// The entity manager's BehaviourScheduler resumes behaviours once per UpdateAll, when the messages for the update have
+// arrived and before any entity is updated. Waits for time are kept in order of when they are due, so behaviours waiting
+// for time cost nothing until they are due. Waits for messages look at the waiting entity's messages, and waits for
+// arrival at its position, so each costs a lookup per update rather than running the entity's code. An entity whose
+// behaviour is waiting can skip its own update's work (see Boat::Update), so idle entities cost next to nothing.
+//
+// Each entity runs at most one behaviour, starting another stops the first. A behaviour is stopped when its entity is
+// destroyed, and can be stopped from anywhere including from within itself (it is then destroyed once it next waits or
+// ends). Behaviours run on the main thread. They can't be saved as they are, so an entity saves what its behaviour
+// has done so far and starts it again from there when loaded (see Boat::RestoreState)
+
+#ifndef _BEHAVIOUR_H_INCLUDED_
+#define _BEHAVIOUR_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "Messenger.h"
+#include "Vector3.h"
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class EntityManager;
+class BehaviourScheduler;
+
+/*-----------------------------------------------------------------------------------------
+   Behaviour coroutine
+-----------------------------------------------------------------------------------------*/
+
+// The return type of behaviour coroutines. Owns the coroutine until handed to BehaviourScheduler::Start. A behaviour
+// doesn't run until it is started
+class Behaviour
+{
+public:
+	struct promise_type
+	{
+		BehaviourScheduler* scheduler = nullptr;
+		EntityID            owner     = NO_ID;
+		uint64_t            run       = 0; // Numbers each start, so waits of a stopped behaviour are ignored
+		Message             message   = {}; // Set when a wait for a message is resumed
+
+		Behaviour get_return_object()  { return Behaviour(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept  { return {}; }
+		std::suspend_always final_suspend()   noexcept  { return {}; } // Destroyed by the scheduler
+		void return_void() {}
+		void unhandled_exception()  { std::terminate(); }
+	};
+	using Handle = std::coroutine_handle<promise_type>;
+
+	Behaviour() = default;
+	Behaviour(Behaviour&& other) noexcept : mHandle(other.mHandle)  { other.mHandle = nullptr; }
+	Behaviour& operator=(Behaviour&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (mHandle)  mHandle.destroy();
+			mHandle = other.mHandle;
+			other.mHandle = nullptr;
+		}
+		return *this;
+	}
+	~Behaviour()  { if (mHandle)  mHandle.destroy(); }
+
+	// Give up ownership of the coroutine, for the scheduler
+	Handle Release()  { Handle handle = mHandle;  mHandle = nullptr;  return handle; }
+
+private:
+	explicit Behaviour(Handle handle) : mHandle(handle) {}
+	Handle mHandle = nullptr;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Waits
+-----------------------------------------------------------------------------------------*/
+// co_await one of these in a behaviour. Only for behaviours started with BehaviourScheduler::Start
+
+// Resume once the given number of seconds of game time has passed. Waits of 0 or less resume in the next update
+struct WaitSeconds
+{
+	float seconds;
+
+	bool await_ready()  { return false; }
+	void await_suspend(Behaviour::Handle handle);
+	void await_resume() {}
+};
+
+// Resume in the update the owner receives a message of the given type, co_await gives the message
+struct WaitForMessage
+{
+	MessageType type;
+
+	bool await_ready()  { return false; }
+	void await_suspend(Behaviour::Handle handle);
+	Message await_resume();
+
+	Behaviour::Handle mHandle = nullptr;
+};
+
+// Resume once the owner's position is within range of the point. Moving there is up to the owner's own update
+struct Arrive
+{
+	Vector3 point;
+	float   range;
+
+	bool await_ready()  { return false; }
+	void await_suspend(Behaviour::Handle handle);
+	void await_resume() {}
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Scheduler
+-----------------------------------------------------------------------------------------*/
+
+class BehaviourScheduler
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	BehaviourScheduler() = default;
+	~BehaviourScheduler();
+	BehaviourScheduler(const BehaviourScheduler&) = delete;
+	BehaviourScheduler& operator=(const BehaviourScheduler&) = delete;
+
+	// Start a behaviour for the given entity, stopping any it is running. It runs straight away up to its first wait
+	void Start(EntityID owner, Behaviour behaviour);
+
+	// Stop the entity's behaviour, does nothing if it isn't running one. The EntityManager does this when the entity is destroyed
+	void Stop(EntityID owner);
+
+	// Whether the entity is running a behaviour that hasn't ended
+	bool IsRunning(EntityID owner) const  { return mRuns.count(owner) != 0; }
+
+	// Seconds until the entity's behaviour is due to resume if it is waiting for time, otherwise 0. For saving (see Boat::SaveState)
+	float TimeLeft(EntityID owner) const;
+
+	// Resume the behaviours whose waits are over. Called by the EntityManager in UpdateAll, after the messenger's
+	// BeginFrame and before any entity is updated
+	void Update(EntityManager& entities, float frameTime);
+
+	// Behaviours running and resumed in the last update, for display
+	size_t Running()           { return mRuns.size(); }
+	int    ResumedLastUpdate() { return mResumed; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	friend struct WaitSeconds;
+	friend struct WaitForMessage;
+	friend struct Arrive;
+
+	// A wait, ignored when resuming if its behaviour has been stopped or restarted since (the run number differs)
+	struct TimeWait
+	{
+		double   due;
+		uint64_t sequence; // Waits due at the same time resume in the order they began
+		EntityID owner;
+		uint64_t run;
+		bool operator>(const TimeWait& other) const  { return due > other.due || (due == other.due && sequence > other.sequence); }
+	};
+	struct MessageWait { EntityID owner; uint64_t run; MessageType type; };
+	struct ArriveWait  { EntityID owner; uint64_t run; Vector3 point; float range; };
+
+	struct Run
+	{
+		Behaviour::Handle handle;
+		uint64_t          run;
+		double            resumeTime = 0; // When a wait for time is due, for TimeLeft
+	};
+
+	void WaitTime   (Behaviour::Handle handle, float seconds);
+	void WaitMessage(Behaviour::Handle handle, MessageType type);
+	void WaitArrive (Behaviour::Handle handle, const Vector3& point, float range);
+
+	// Resume a behaviour if the wait is still its current one, destroying it if it ends or was stopped while running
+	void Resume(EntityID owner, uint64_t run);
+
+	// Behaviours being run, by owner
+	std::unordered_map<EntityID, Run> mRuns;
+	uint64_t mNextRun = 1;
+	EntityID mResuming = NO_ID; // Owner of the behaviour running now, see Stop
+	bool     mStopResuming = false;
+
+	std::priority_queue<TimeWait, std::vector<TimeWait>, std::greater<TimeWait>> mTimeWaits;
+	std::vector<MessageWait> mMessageWaits;
+	std::vector<ArriveWait>  mArriveWaits;
+	std::vector<MessageWait> mMessageWaitsNow; // Working copies for Update, kept to avoid reallocating them
+	std::vector<ArriveWait>  mArriveWaitsNow;
+	double   mTime = 0;
+	uint64_t mNextSequence = 0;
+	int      mResumed = 0;
+};
+
+
+#endif //_BEHAVIOUR_H_INCLUDED_
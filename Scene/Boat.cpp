@@ -7,6 +7,9 @@
 #include "Messenger.h"
 #include "Missile.h"
 #include "Shield.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include "FloatingText.h"
 
 #include "SceneGlobals.h" // For gEntityManager and gMessenger
 #include "MathHelpers.h"
@@ -17,6 +20,146 @@
 #include <limits>
 #include <iostream>
 #include <numbers> // C++20 finally provides the value of PI from the <numbers> header (pi)
+#include <cstdio>
+
+/*-----------------------------------------------------------------------------------------
+   Constructor
+-----------------------------------------------------------------------------------------*/
+// The boat's health, weapon, movement, shield and team go in the boat components, the rest stays here
+Boat::Boat(EntityTemplate& entityTemplate, EntityID ID, float initSpeed, const Matrix4x4& transform, Atom name /*= {}*/)
+    : Entity(entityTemplate, ID, transform, name),
+    mBoatTemplate(static_cast<BoatTemplate&>(entityTemplate)),
+    mComponents(gEntityManager->BoatData())
+{
+    BoatHealth health;
+    health.hp    = mBoatTemplate.mMaxHP;
+    health.maxHP = mBoatTemplate.mMaxHP;
+
+    BoatWeapon weapon;
+    weapon.missileDamage     = mBoatTemplate.mMissileDamage;
+    weapon.missilesRemaining = mBoatTemplate.mMissiles;
+    weapon.maxMissiles       = mBoatTemplate.mMissiles;
+    weapon.gunTurret = TRSFromMatrix(Transform(3));
+    weapon.gunBarrel = TRSFromMatrix(Transform(4));
+
+    BoatNavigation navigation;
+    navigation.speed       = std::min(initSpeed, mBoatTemplate.mMaxSpeed);
+    navigation.doubleSpeed = mBoatTemplate.mMaxSpeed * 2;
+
+    mComponents.Add(ID, this, health, weapon, navigation, BoatShield{}, BoatLabel{ mBoatTemplate.mTeam });
+
+    mState = State::Inactive;
+    mTimer = 0.0f;
+    mRandom.Seed(RandomSeed(), ID);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Checkpoints
+-----------------------------------------------------------------------------------------*/
+// Everything about the boat except its template, ID, name and matrices, see Checkpoint.h
+Boat::SavedState Boat::SaveState()
+{
+    SavedState saved = {};
+    saved.speed = NavigationData().speed;
+    saved.doubleSpeed = NavigationData().doubleSpeed;
+    saved.hp = HealthData().hp;
+    saved.timer = mTimer;
+    saved.gunTurret = WeaponData().gunTurret;
+    saved.gunBarrel = WeaponData().gunBarrel;
+    saved.timerToken = mTimerToken;
+    saved.missileDamage = WeaponData().missileDamage;
+    saved.missilesFired = WeaponData().missilesFired;
+    saved.state = mState;
+    saved.team = LabelData().team;
+    saved.missilesRemaining = WeaponData().missilesRemaining;
+    saved.reloading = WeaponData().reloading;
+    saved.wigglePhase = mWigglePhase;
+    saved.lastWiggleAngle = mLastWiggleAngle;
+    saved.sinkingAnimationTime = mSinkingAnimationTime;
+    saved.patrolPoint = mPatrolPoint;
+    saved.evadePoint = mEvadePoint;
+    saved.targetPoint = mTargetPoint;
+    saved.targetRange = mTargetRange;
+    saved.targetCrateID = mTargetCrateID;
+    saved.shieldEntityID = ShieldData().entity;
+    saved.shieldTimer = ShieldData().timer;
+    saved.random = mRandom;
+    saved.moveToEnemyBoatID = mMoveToEnemyBoatID;
+    saved.targetBoat = mTargetBoat;
+    saved.avoidance = mAvoidance;
+    saved.launchVelocity = mLaunchVelocity;
+    saved.launchTarget = mLaunchTarget;
+    saved.thinkThisUpdate = mThinkThisUpdate;
+    saved.timeSinceThought = mTimeSinceThought;
+    saved.thinkRate = mThinkRate;
+    saved.reloadPoint = mReloadPoint;
+    saved.docked = mDocked;
+    saved.reloadTimeLeft = mDocked ? gEntityManager->Behaviours().TimeLeft(GetID()) : RELOAD_TIME;
+    saved.targetCratePoint = mTargetCratePoint;
+    saved.targetCrateRadius = mTargetCrateRadius;
+    return saved;
+}
+
+// Carry on from a saved state. The state is set directly, it isn't a change the boat made so isn't added to StateChanges
+void Boat::RestoreState(const SavedState& saved)
+{
+    NavigationData().speed = saved.speed;
+    NavigationData().doubleSpeed = saved.doubleSpeed;
+    HealthData().hp = saved.hp;
+    mTimer = saved.timer;
+    WeaponData().gunTurret = saved.gunTurret;
+    WeaponData().gunBarrel = saved.gunBarrel;
+    mTimerToken = saved.timerToken;
+    WeaponData().missileDamage = saved.missileDamage;
+    WeaponData().missilesFired = saved.missilesFired;
+    mState = saved.state;
+    LabelData().team = saved.team;
+    WeaponData().missilesRemaining = saved.missilesRemaining;
+    WeaponData().reloading = saved.reloading;
+    mWigglePhase = saved.wigglePhase;
+    mLastWiggleAngle = saved.lastWiggleAngle;
+    mSinkingAnimationTime = saved.sinkingAnimationTime;
+    mPatrolPoint = saved.patrolPoint;
+    mEvadePoint = saved.evadePoint;
+    mTargetPoint = saved.targetPoint;
+    mTargetRange = saved.targetRange;
+    mTargetCrateID = saved.targetCrateID;
+    ShieldData().entity = saved.shieldEntityID;
+    ShieldData().timer = saved.shieldTimer;
+    mRandom = saved.random;
+    mMoveToEnemyBoatID = saved.moveToEnemyBoatID;
+    mTargetBoat = saved.targetBoat;
+    mAvoidance = saved.avoidance;
+    mLaunchVelocity = saved.launchVelocity;
+    mLaunchTarget = saved.launchTarget;
+    mThinkThisUpdate = saved.thinkThisUpdate;
+    mTimeSinceThought = saved.timeSinceThought;
+    mThinkRate = saved.thinkRate;
+    mReloadPoint = saved.reloadPoint;
+    mDocked = saved.docked;
+    mTargetCratePoint = saved.targetCratePoint;
+    mTargetCrateRadius = saved.targetCrateRadius;
+
+    // Crate reservations aren't saved, so a boat going for a crate reserves it again
+    if (mState == State::PickupCrate && mTargetCrateID != NO_ID)
+    {
+        float travelTime = (mTargetCratePoint - Transform().Position()).Length() / std::max(mBoatTemplate.mMaxSpeed, 1.0f);
+        gEntityManager->Reservations().Reserve(mTargetCrateID, GetID(), travelTime);
+    }
+
+    // A reload behaviour can't be saved, so it is started again from where it had got to. Station queues aren't saved
+    // either, so the boat joins the station it was going to again, docked boats ahead of those waiting
+    gEntityManager->Behaviours().Stop(GetID());
+    gEntityManager->Reloads().Leave(GetID());
+    if (mState == State::Reloading)
+    {
+        Entity* station = gEntityManager->Reloads().Join(gEntityManager->Spatial(), GetID(), mReloadPoint, mDocked);
+        if (station != nullptr)  mReloadPoint = station->Transform().Position();
+        gEntityManager->Behaviours().Start(GetID(), ReloadBehaviour(saved.reloadTimeLeft));
+    }
+}
+
 
 /*-----------------------------------------------------------------------------------------
    Update / Render
@@ -25,22 +168,26 @@
 // ***Entity Update functions should return false if the entity is to be destroyed***
 bool Boat::Update(float frameTime)
 {
+    ALLOCATION_SCOPE("Boats");
     bool shouldDestroy = false;
+    State stateBeforeMessages = mState;
+    NavigationData().moving = false;
 
     //********************************************************/
     // Message handling
     //********************************************************/
-    // Fetch any messages. The Messenger class handles the collection and delivery - we just enter
-    // a loop collecting any pending messages, acting accordingly
-    Message message;
-    while (gMessenger->ReceiveMessage(GetID(), &message))
+    // Fetch any messages. The Messenger class handles the collection and delivery - we just loop
+    // through the messages sent to us last frame, acting accordingly. The damage system has already applied the hits and
+    // repairs to the boat's health (see DamageSystem.h), the boat reacts to each hit from its result
+    uint32_t hit = 0;
+    for (const Message& message : gMessenger->ReceiveAll(GetID()))
     {
         switch (message.type)
         {
         case MessageType::Start:
             if (mState == State::Inactive)
             {
-                mState = State::Patrol;
+                SetState(State::Patrol);
                 mPatrolPoint = ChooseRandomPointInArea();
             }
             break;
@@ -48,80 +195,71 @@ bool Boat::Update(float frameTime)
         case MessageType::Evade:
             if (mState != State::Inactive && mState != State::Destroyed) 
             {
-                mState = State::Evade;
+                SetState(State::Evade);
+                ScheduleWakeUp(5.0f, MessageType::EvadeComplete);
             }
             break;
 
         case MessageType::Stop:
-            mState = State::Inactive;
-            mSpeed = 0.0f;
+            SetState(State::Inactive);
+            NavigationData().speed = 0.0f;
             break;
 
         case MessageType::Hit:
         {
-            if (mShieldEntityID == NO_ID) {
-                MissileHitData hitData = std::get<MissileHitData>(message.data);
-                EntityID lastHitByBoatID = hitData.launchingBoatID;
-                Boat* hitByBoat = gEntityManager->GetEntity<Boat>(lastHitByBoatID);
-                float damage = (hitByBoat) ? hitByBoat->GetMissileDamage() : 20.0f;
-                mHP -= damage;
+            const DamageSystem::Result& result = gEntityManager->Damage().GetResult(GetID(), hit++);
+            if (!result.shielded) {
+                char text[32];
+                snprintf(text, sizeof(text), "-%d Health", static_cast<int>(result.damage));
+                ShowText(text);
 
-                SetBoatText("-" + std::to_string(static_cast<int>(damage)) + " Health");
-
-                if (mHP <= 0.0f)
-                {
-                    mState = State::Destroyed;
-                }
-                if (Random(0.0f, 1.0f) < 0.5f)
+                if (result.fatal)
                 {
-                    BroadcastHelpMessage(hitByBoat);
+                    SetState(State::Destroyed);
                 }
             }
             else {
-                SetBoatText("0 Damage");
+                ShowText("0 Damage");
             }
 
             break;
         }
 
         case MessageType::MineHit:
-            if (mShieldEntityID == NO_ID) {
-                mHP -= 50.0f;
-                SetBoatText("-50 Health");
-            }
-            else {
-                mHP -= 25.0f;
-                SetBoatText("-25 Health");
-            }
+        {
+            const DamageSystem::Result& result = gEntityManager->Damage().GetResult(GetID(), hit++);
+            char text[32];
+            snprintf(text, sizeof(text), "-%d Health", static_cast<int>(result.damage));
+            ShowText(text);
 
-            if (mHP <= 0.0f)
+            if (result.fatal)
             {
-                mState = State::Destroyed;
+                SetState(State::Destroyed);
             }
             else
             {
                 mTimer = 2.0f;
                 mWigglePhase = 0.0f;
                 mLastWiggleAngle = 0.0f;
-                mState = State::Wiggle;
+                SetState(State::Wiggle);
             }
             break;
+        }
 
         case MessageType::Help:
             if (mState == State::Patrol || mState == State::Evade) {
                 HelpMessageData helpData = std::get<HelpMessageData>(message.data);
                 EntityID enemyBoatID = helpData.enemyBoatID;
-                moveToEnemyBoat = gEntityManager->GetEntity<Boat>(enemyBoatID);
-
-                if (moveToEnemyBoat)
+                if (gEntityManager->GetEntity<Boat>(enemyBoatID))
                 {
-                    mState = State::MoveToAssist;
+                    mMoveToEnemyBoatID = enemyBoatID;
+                    SetState(State::MoveToAssist);
                 }
             }
             break;
 
         case MessageType::Reload:
-            mState = State::Reloading;
+            SetState(State::Reloading);
             break;
 
         case MessageType::CrateCollected:
@@ -131,28 +269,29 @@ bool Boat::Update(float frameTime)
             if (crateData.type == CrateType::Missile)
             {
                 AddMissiles(2);
-                SetBoatText("+2 Missiles");
+                ShowText("+2 Missiles");
             }
             else if (crateData.type == CrateType::Health)
             {
-                SetHP(GetHP() + 20.0f);
-                SetBoatText("+20 Health");
+                ShowText("+20 Health"); // Repaired by the damage system
             }
             else if (crateData.type == CrateType::Shield)
             {
                 // If there is already a shield, remove it first.
-                if (mShieldEntityID != NO_ID)
+                if (ShieldData().entity != NO_ID)
                 {
-                    gEntityManager->DestroyEntity(mShieldEntityID);
-                    mShieldEntityID = NO_ID;
+                    gEntityManager->DestroyEntity(ShieldData().entity);
+                    ShieldData().entity = NO_ID;
                 }
                 // Attach the new shield.
                 AttachShieldMesh();
-                mShieldTimer = Random(7.0f, 15.0f);
-                SetBoatText("+Shield");
+                ShieldData().timer = mRandom.Range(7.0f, 15.0f);
+                ShowText("+Shield");
             }
 
-            mTargetCrate = nullptr;
+            // The crate picked up may not be the one the boat was going for, let others have that one
+            gEntityManager->Reservations().Release(mTargetCrateID, GetID());
+            mTargetCrateID = NO_ID;
         }
         break;
 
@@ -161,16 +300,32 @@ bool Boat::Update(float frameTime)
             TargetPointData targetData = std::get<TargetPointData>(message.data);
             mTargetPoint = targetData.target;
             mTargetRange = targetData.range;
-            mState = State::TargetPoint;
+            SetState(State::TargetPoint);
         }
         break;
 
         case MessageType::ShieldDestroyed:
-            mShieldEntityID = NO_ID;
+            ShieldData().entity = NO_ID;
             break;
 
         case MessageType::Die:
-            mState = State::Destroyed;
+            SetState(State::Destroyed);
+            break;
+
+        // Wake-ups scheduled by this boat. Ignored if the boat has left the state or scheduled another wake-up since
+        case MessageType::AimComplete:
+            if (mState == State::Aim && std::get<TimerData>(message.data).token == mTimerToken)
+            {
+                Boat* enemyPtr = gEntityManager->GetEntity<Boat>(mTargetBoat);
+                if (enemyPtr != nullptr)  FireAtTarget(enemyPtr, frameTime);
+            }
+            break;
+
+        case MessageType::EvadeComplete:
+            if (mState == State::Evade && std::get<TimerData>(message.data).token == mTimerToken)
+            {
+                EndEvade();
+            }
             break;
 
         default:
@@ -178,69 +333,119 @@ bool Boat::Update(float frameTime)
         }
     }
 
+    // Let the team know who hit us and for how much, once for each attacker however many of its missiles hit. Half the
+    // time teammates nearby are asked for help, with the attacker that did the most damage
+    auto attacks = gEntityManager->Damage().Attacks(GetID());
+    if (!attacks.empty())
+    {
+        size_t worst = 0;
+        for (size_t i = 1; i < attacks.size(); ++i)
+        {
+            if (attacks[i].damage > attacks[worst].damage)  worst = i;
+        }
+        bool askForHelp = mRandom.Range(0.0f, 1.0f) < 0.5f;
+        for (size_t i = 0; i < attacks.size(); ++i)
+        {
+            Boat* attacker = gEntityManager->GetEntity<Boat>(attacks[i].attacker);
+            gEntityManager->Blackboard().ReportAttack(this, attacker, attacks[i].damage, askForHelp && i == worst);
+        }
+    }
+
+    // A docked boat waits for its reload behaviour, which the behaviour scheduler resumes when its time is up (see
+    // Behaviour.h), so there is nothing to do until a message changes its state
+    if (mDocked && mState == stateBeforeMessages)
+    {
+        mTimeSinceThought = 0.0f;
+        return true;
+    }
+
+    // The behaviour is only run when the AI scheduler says to, with all the time since it last ran (see AIScheduler), or
+    // straight away if a message changed the state. In between, the boat carries on at its current speed and heading
+    mTimeSinceThought += frameTime;
+    if (!mThinkThisUpdate && mState == stateBeforeMessages)
+    {
+        NavigationData().moving = (mState != State::Aim); // Moved by the navigation system, see NavigationSystem.h
+        return true;
+    }
+    float thinkTime = mTimeSinceThought;
+    mTimeSinceThought = 0.0f;
+    if (thinkTime > 0.0f)  mThinkRate += (1.0f / thinkTime - mThinkRate) * 0.1f;
+
+    // With the utility AI on, the decision system chooses when to change between patrolling, aiming, evading, picking up
+    // crates, reloading and assisting (see DecisionSystem.h), in place of the checks for those changes in the states below
+    bool useDecisions = gEntityManager->Decisions().IsEnabled();
+    if (useDecisions)  ApplyDecision();
+
     // Execute behavior based on state.
     switch (mState)
     {
     case State::Inactive:
-        mSpeed = 0.0f;
+        NavigationData().speed = 0.0f;
         break;
 
     case State::Patrol:
-        mSpeed = mBoatTemplate.mMaxSpeed;
-        UpdatePatrol(frameTime);
+        NavigationData().speed = mBoatTemplate.mMaxSpeed;
+        UpdatePatrol(thinkTime);
+        if (!useDecisions)
         {
             EntityID enemyID = CheckForEnemy();
             if (enemyID != NO_ID)
             {
-                mTimer = 2.0f;
-                mSpeed = 0.0f;
+                NavigationData().speed = 0.0f;
                 mTargetBoat = enemyID;
-                mState = State::Aim;
+                SetState(State::Aim);
+                ScheduleWakeUp(2.0f, MessageType::AimComplete);
+            }
+            else if (mState == State::Patrol) // Not if it has run out of missiles
+            {
+                StartAssisting();
             }
         }
         break;
 
     case State::Aim:
-        mSpeed = 0.0f;
-        UpdateAim(frameTime);
+        NavigationData().speed = 0.0f;
+        UpdateAim(thinkTime);
         break;
 
     case State::Evade:
-        UpdateEvade(frameTime);
+        if (useDecisions || !StartAssisting())  UpdateEvade(thinkTime);
         break;
 
     case State::Reloading:
-        UpdateReloading(frameTime);
+        UpdateReloading(thinkTime);
         break;
 
     case State::TargetPoint:
-        UpdateTargetPoint(frameTime);
+        UpdateTargetPoint(thinkTime);
         break;
 
     case State::PickupCrate:
-        UpdatePickupCrate(frameTime);
+        UpdatePickupCrate(thinkTime);
         break;
 
     case State::Wiggle:
-        UpdateWiggle(frameTime);
+        UpdateWiggle(thinkTime);
         break;
 
     case State::MoveToAssist:
-        UpdateMoveToAssist(frameTime);
+        UpdateMoveToAssist(thinkTime);
         break;
 
     case State::Destroyed:
-        DestructionBehaviour(frameTime, shouldDestroy);
+        DestructionBehaviour(thinkTime, shouldDestroy);
 
         return !shouldDestroy;
     }
 
+    // The gun parts were turned in TRS form by the state updates, the weapon system rebuilds their matrices (see WeaponSystem.h)
+    WeaponData().gunsTurned = true;
+
     if (mState != State::Aim)
     {
-        HandleCollisionAvoidance(frameTime);
-        Transform().MoveLocalZ(mSpeed * frameTime);
+        HandleCollisionAvoidance(thinkTime);
+        NavigationData().moving = true;
     }
-    UpdateBoatTextTimer(frameTime);
 
     return true;
 }
@@ -249,16 +454,17 @@ bool Boat::Update(float frameTime)
 // Update patrol behavior.
 void Boat::UpdatePatrol(float frameTime)
 {
+    PROFILE_SCOPE("Boat::UpdatePatrol");
     // If missiles are exhausted, switch to reloading.
-    if (mMissilesRemaining <= 0 && !mReloading)
+    if (WeaponData().missilesRemaining <= 0 && !WeaponData().reloading)
     {
-        mState = State::Reloading;
+        SetState(State::Reloading);
         return;
     }
 
     // Update gun parts for visual effect.
-    Transform(3) = MatrixRotationY(mBoatTemplate.mGunTurnSpeed * frameTime) * Transform(3);
-    Transform(4) = MatrixRotationX(std::sin(mTimer * 3.0f) * frameTime) * Transform(4);
+    WeaponData().gunTurret.RotateLocalY(mBoatTemplate.mGunTurnSpeed * frameTime);
+    WeaponData().gunBarrel.RotateLocalX(FastSin(mTimer * 3.0f) * frameTime);
 
     // Move toward the patrol point.
     Vector3 toPatrol = mPatrolPoint - Transform().Position();
@@ -269,196 +475,228 @@ void Boat::UpdatePatrol(float frameTime)
     }
     else
     {
-        float derivedTurnSpeed = mSpeed * 0.2f;
+        float derivedTurnSpeed = NavigationData().speed * 0.2f;
         derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
-        FaceDirection(toPatrol, frameTime, derivedTurnSpeed);
-        if (mSpeed < mBoatTemplate.mMaxSpeed)
+        FaceDirection(RouteTowards(mPatrolPoint), frameTime, derivedTurnSpeed);
+        if (NavigationData().speed < mBoatTemplate.mMaxSpeed)
         {
-            mSpeed += mBoatTemplate.mAcceleration * frameTime;
-            if (mSpeed > mBoatTemplate.mMaxSpeed)
-                mSpeed = mBoatTemplate.mMaxSpeed;
+            NavigationData().speed += mBoatTemplate.mAcceleration * frameTime;
+            if (NavigationData().speed > mBoatTemplate.mMaxSpeed)
+                NavigationData().speed = mBoatTemplate.mMaxSpeed;
         }
     }
     mTimer += frameTime;
 }
 
 //------------------------------------------------------------------------------
-// Update aim behavior.
+// Update aim behavior. The missile is fired when the AimComplete wake-up arrives, see FireAtTarget
 void Boat::UpdateAim(float frameTime)
 {
-    mTimer -= frameTime;
+    PROFILE_SCOPE("Boat::UpdateAim");
     Boat* enemyPtr = gEntityManager->GetEntity<Boat>(mTargetBoat);
     if (enemyPtr != nullptr)
     {
         Vector3 enemyPos = enemyPtr->Transform().Position();
-        Vector3 directionToEnemy = enemyPos - Transform(3).Position();
+        Vector3 directionToEnemy = enemyPos - WeaponData().gunTurret.position;
         Vector3 desiredDirection = Normalise(directionToEnemy);
-        Transform(3).FaceDirection(desiredDirection);
-
-        if (mTimer <= 0.0f)
-        {
-            Vector3 enemyForward = enemyPtr->Transform().ZAxis();
-            enemyForward = Normalise(enemyForward);
-
-            float enemySpeed = enemyPtr->Template<BoatTemplate>().mMaxSpeed;
-            Vector3 enemyVelocity = enemyForward * enemySpeed;
-
-            float enemyHeight = 10.0f;
-            enemyPos.y += enemyHeight;
-
-            Vector3 relativePos = enemyPos - Transform().Position();
-            float missileSpeed = 45.0f;
-
-            float interceptTime = relativePos.Length() / missileSpeed;
-            Vector3 predictedPos = enemyPos + enemyVelocity * interceptTime;
-
-            Vector3 displacement = predictedPos - Transform().Position();
-
-            float timeToTarget = interceptTime;
-            Vector3 initialVelocity;
-
-            if (timeToTarget > 0.0f)
-            {
-                initialVelocity.x = displacement.x / timeToTarget;
-                initialVelocity.y = (displacement.y - 0.5f * -9.81f * timeToTarget * timeToTarget) / timeToTarget;
-                initialVelocity.z = displacement.z / timeToTarget;
-            }
-            else
-            {
-                initialVelocity = Normalise(displacement) * missileSpeed;
-            }
-
-            // Create the missile with the calculated velocity
-            Vector3 normalizedVelocity = Normalise(initialVelocity);
-            Matrix4x4 initialTransform = Matrix4x4(Transform().Position(), Transform().GetRotation(), 1.0f);
-            initialTransform.FaceDirection(normalizedVelocity);
-
-            gEntityManager->CreateEntity<Missile>("Missile", initialTransform, missileSpeed, initialVelocity, GetID());
- 
-            mEvadePoint = ChooseEvadePoint(enemyPos);
-            UseMissile();
-            mState = State::Evade;
-        }
+        WeaponData().gunTurret.FaceDirection(desiredDirection);
     }
     else {
         mPatrolPoint = ChooseRandomPointInArea();
-        mState = State::Patrol;
+        SetState(State::Patrol);
     }
 }
 
 //------------------------------------------------------------------------------
-// Update evade behavior.
+// Request for a missile from this boat to hit the given enemy, aiming a little above its waterline and leading it by
+// its actual velocity
+BallisticSolver::Request Boat::AimRequest(Boat* enemy)
+{
+    float enemyHeight = 10.0f;
+    float missileSpeed = 45.0f;
+
+    Vector3 enemyPos = enemy->Transform().Position();
+    enemyPos.y += enemyHeight;
+    return { Transform().Position(), enemyPos, enemy->GetVelocity(), missileSpeed };
+}
+
+//------------------------------------------------------------------------------
+// Fire a missile at the given enemy, leading it by its velocity, then evade.
+void Boat::FireAtTarget(Boat* enemyPtr, float frameTime)
+{
+    // The launch velocity was solved with all the other aiming boats' at the start of this update (see BallisticSolver).
+    // If it was solved for a different enemy, solve it here
+    BallisticSolver::Request request = AimRequest(enemyPtr);
+    Vector3 initialVelocity = mLaunchVelocity;
+    if (mLaunchTarget != enemyPtr->GetID())  initialVelocity = BallisticSolver::SolveOne(request, frameTime);
+
+    // Create the missile with the calculated velocity
+    Vector3 normalizedVelocity = Normalise(initialVelocity);
+    TRS initialTransform;
+    initialTransform.position = Transform().Position();
+    initialTransform.FaceDirection(normalizedVelocity);
+
+    gScene->LaunchMissile(initialTransform.ToMatrix(), request.speed, initialVelocity, GetID());
+
+    mEvadePoint = ChooseEvadePoint(request.target);
+    UseMissile();
+    SetState(State::Evade);
+    ScheduleWakeUp(5.0f, MessageType::EvadeComplete);
+}
+
+//------------------------------------------------------------------------------
+// Update evade behavior. Evading ends on reaching the evade point or when the EvadeComplete wake-up arrives
 void Boat::UpdateEvade(float frameTime)
 {
+    PROFILE_SCOPE("Boat::UpdateEvade");
     mTimer += frameTime;
-    static float mEvadeTimer = 5.0f;
-    mEvadeTimer -= frameTime;
 
     // Rotate gun parts for visual effect.
-    Transform(3) = MatrixRotationY(mBoatTemplate.mGunTurnSpeed * frameTime) * Transform(3);
+    WeaponData().gunTurret.RotateLocalY(mBoatTemplate.mGunTurnSpeed * frameTime);
 
     // Move toward the evade point.
     Vector3 toEvade = mEvadePoint - Transform().Position();
-    if (toEvade.Length() < 5.0f || mEvadeTimer <= 0.0f)
+    if (toEvade.Length() < 5.0f)
     {
-        mTargetCrate = FindNearestCrate(75.0f);
-        mEvadeTimer = 5.0f;
-        mSpeed = mBoatTemplate.mMaxSpeed;
-        mState = State::PickupCrate;
+        EndEvade();
     }
     else
     {
-        float derivedTurnSpeed = mSpeed * 0.2f;
+        float derivedTurnSpeed = NavigationData().speed * 0.2f;
         derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
-        FaceDirection(toEvade, frameTime, derivedTurnSpeed);
-        if (mSpeed < mDoubleSpeed)
+        FaceDirection(RouteTowards(mEvadePoint), frameTime, derivedTurnSpeed);
+        if (NavigationData().speed < NavigationData().doubleSpeed)
         {
-            mSpeed += mBoatTemplate.mAcceleration * 2.0f * frameTime;
-            if (mSpeed > mDoubleSpeed)
-                mSpeed = mDoubleSpeed;
+            NavigationData().speed += mBoatTemplate.mAcceleration * 2.0f * frameTime;
+            if (NavigationData().speed > NavigationData().doubleSpeed)
+                NavigationData().speed = NavigationData().doubleSpeed;
         }
     }
 }
 
+//------------------------------------------------------------------------------
+// Stop evading and head for the nearest crate no other boat is going for, if any.
+void Boat::EndEvade()
+{
+    RandomCrate* nearestCrate = FindNearestCrate(75.0f);
+    if (nearestCrate == nullptr || !ReserveCrate(nearestCrate))  mTargetCrateID = NO_ID;
+    NavigationData().speed = mBoatTemplate.mMaxSpeed;
+    SetState(State::PickupCrate);
+}
+
+//------------------------------------------------------------------------------
+// Change state, recording the change. The reload behaviour and the place in a station's queue belong to the Reloading
+// state, so leaving the state stops the behaviour (destroyed once it next waits or ends, if it is the one making the
+// change) and gives the next boat in the queue its turn. Likewise leaving the PickupCrate state lets go of the crate
+void Boat::SetState(State newState)
+{
+    if (newState == mState)  return;
+    sStateChanges.push_back({ GetID(), mState, newState });
+    if (mState == State::Reloading)
+    {
+        gEntityManager->Behaviours().Stop(GetID());
+        gEntityManager->Reloads().Leave(GetID());
+        mDocked = false;
+    }
+    if (mState == State::PickupCrate)  gEntityManager->Reservations().Release(mTargetCrateID, GetID());
+    mState = newState;
+}
+
+//------------------------------------------------------------------------------
+// Schedule a wake-up message of the given type to this boat after the given delay. Any earlier wake-up still on its way
+// will be ignored when it arrives, as its token no longer matches.
+void Boat::ScheduleWakeUp(float delay, MessageType type)
+{
+    ++mTimerToken;
+    gMessenger->DeliverAt(delay, GetID(), GetID(), type, TimerData{ mTimerToken });
+}
+
 //------------------------------------------------------------------------------
 // Update reloading behavior.
 void Boat::UpdateReloading(float frameTime)
 {
-    std::vector<ReloadStation*> reloadStations = gEntityManager->GetAllReloadStationEntities();
-    ReloadStation* nearestStation = nullptr;
-    float nearestDistance = std::numeric_limits<float>::max();
-
-    // Find the nearest reload station.
-    for (ReloadStation* station : reloadStations)
+    PROFILE_SCOPE("Boat::UpdateReloading");
+    // The boat joins a station's queue once, on entering the state (see ReloadService), then the reload behaviour waits
+    // for its turn and for it to arrive, and times the reload. Until it docks the boat is steered towards the station here
+    ReloadService& reloads = gEntityManager->Reloads();
+    if (!gEntityManager->Behaviours().IsRunning(GetID()))
     {
-        float distance = (station->Transform().Position() - Transform().Position()).Length();
-        if (distance < nearestDistance)
+        Entity* station = reloads.Join(gEntityManager->Spatial(), GetID(), Transform().Position());
+        if (station == nullptr)
         {
-            nearestDistance = distance;
-            nearestStation = station;
+            // If no reload station is found, simply stop and resume patrol.
+            NavigationData().speed = 0.0f;
+            SetState(State::Patrol);
+            WeaponData().reloading = false;
+            return;
         }
+        mReloadPoint = station->Transform().Position();
+        mDocked = false;
+        gEntityManager->Behaviours().Start(GetID(), ReloadBehaviour(RELOAD_TIME));
     }
+    if (mDocked)  return;
 
-    if (nearestStation)
+    // Boats waiting their turn stop short of the station rather than crowding the boats reloading there
+    if (reloads.IsWaiting(GetID()) && (mReloadPoint - Transform().Position()).Length() < WAIT_RANGE)
     {
-        if (nearestDistance < 40.0f)
-        {
-            // We are close to the reload station.
-            mSpeed = 0.0f;
-            mTimer += frameTime;
-            if (mTimer >= 5.0f)
-            {
-                // After waiting 5 seconds, reload missiles.
-                ReloadMissiles();
-                mState = State::Patrol;
-                mTimer = 0.0f;
-                mReloading = false;
-            }
-        }
-        else
-        {
-            Vector3 toStation = nearestStation->Transform().Position() - Transform().Position();
-            float derivedTurnSpeed = mSpeed * 0.2f;
-            derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
-            FaceDirection(toStation, frameTime, derivedTurnSpeed);
-            if (mSpeed < mBoatTemplate.mMaxSpeed)
-            {
-                mSpeed += mBoatTemplate.mAcceleration * frameTime;
-                if (mSpeed > mBoatTemplate.mMaxSpeed)
-                    mSpeed = mBoatTemplate.mMaxSpeed;
-            }
-            mTimer = 0.0f;
-        }
+        NavigationData().speed = 0.0f;
+        return;
     }
-    else
+
+    float derivedTurnSpeed = NavigationData().speed * 0.2f;
+    derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
+    FaceDirection(RouteTowards(mReloadPoint), frameTime, derivedTurnSpeed);
+    if (NavigationData().speed < mBoatTemplate.mMaxSpeed)
     {
-        // If no reload station is found, simply stop and resume patrol.
-        mSpeed = 0.0f;
-        mState = State::Patrol;
-        mReloading = false;
-        mTimer = 0.0f;
+        NavigationData().speed += mBoatTemplate.mAcceleration * frameTime;
+        if (NavigationData().speed > mBoatTemplate.mMaxSpeed)
+            NavigationData().speed = mBoatTemplate.mMaxSpeed;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Reload at the station at mReloadPoint: unless already docked, wait for the boat's turn at the station and to arrive,
+// then stop and reload after the given time and go back to patrolling. The boat's update does nothing while it is docked
+// (see Update). Turns are checked again on arriving, a boat can lose its turn to a docked boat restored from a checkpoint
+Behaviour Boat::ReloadBehaviour(float reloadTime)
+{
+    ReloadService& reloads = gEntityManager->Reloads();
+    while (!mDocked)
+    {
+        while (reloads.IsWaiting(GetID()))  co_await WaitForMessage(MessageType::ReloadTurn);
+        co_await Arrive(mReloadPoint, DOCK_RANGE);
+        if (reloads.IsWaiting(GetID()))  continue;
+        mDocked = true;
+        NavigationData().speed = 0.0f;
     }
+
+    co_await WaitSeconds(reloadTime);
+    ReloadMissiles();
+    WeaponData().reloading = false;
+    mDocked = false;
+    SetState(State::Patrol);
 }
 
 //------------------------------------------------------------------------------
 // Update target point behavior.
 void Boat::UpdateTargetPoint(float frameTime)
 {
+    PROFILE_SCOPE("Boat::UpdateTargetPoint");
     Vector3 toTarget = mTargetPoint - Transform().Position();
     if (toTarget.Length() <= mTargetRange)
     {
-        mState = State::Patrol;
+        SetState(State::Patrol);
     }
     else
     {
-        float derivedTurnSpeed = mSpeed * 0.2f;
+        float derivedTurnSpeed = NavigationData().speed * 0.2f;
         derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
-        FaceDirection(toTarget, frameTime, derivedTurnSpeed);
-        if (mSpeed < mDoubleSpeed)
+        FaceDirection(RouteTowards(mTargetPoint), frameTime, derivedTurnSpeed);
+        if (NavigationData().speed < NavigationData().doubleSpeed)
         {
-            mSpeed += mBoatTemplate.mAcceleration * frameTime;
-            if (mSpeed > mDoubleSpeed)
-                mSpeed = mDoubleSpeed;
+            NavigationData().speed += mBoatTemplate.mAcceleration * frameTime;
+            if (NavigationData().speed > NavigationData().doubleSpeed)
+                NavigationData().speed = NavigationData().doubleSpeed;
         }
     }
 }
@@ -467,48 +705,44 @@ void Boat::UpdateTargetPoint(float frameTime)
 // Update pickup crate behavior.
 void Boat::UpdatePickupCrate(float frameTime)
 {
-    if (mTargetCrate && gEntityManager->GetEntity<RandomCrate>(mTargetCrate->GetID()))
+    PROFILE_SCOPE("Boat::UpdatePickupCrate");
+    // The reservation is lost if the crate has been collected by another boat or the boat has taken too long to get there
+    if (gEntityManager->Reservations().IsReservedBy(mTargetCrateID, GetID()))
     {
         // Calculate the distance to the crate.
-        Vector3 cratePos = mTargetCrate->Transform().Position();
+        Vector3 cratePos = mTargetCratePoint;
         Vector3 toCrate = cratePos - Transform().Position();
         float distance = toCrate.Length();
 
         // If close enough, pick up the crate.
-        if (distance < mTargetCrate->collisionRadius)
+        if (distance < mTargetCrateRadius)
         {
-            mState = State::Patrol;
+            SetState(State::Patrol);
         }
         else
         {
-            float derivedTurnSpeed = mSpeed * 0.2f;
+            float derivedTurnSpeed = NavigationData().speed * 0.2f;
             derivedTurnSpeed = std::min(derivedTurnSpeed, mBoatTemplate.mTurnSpeed);
-            FaceDirection(toCrate, frameTime, derivedTurnSpeed);
-            if (mSpeed < mBoatTemplate.mMaxSpeed)
+            FaceDirection(RouteTowards(cratePos), frameTime, derivedTurnSpeed);
+            if (NavigationData().speed < mBoatTemplate.mMaxSpeed)
             {
-                mSpeed += mBoatTemplate.mAcceleration * frameTime;
-                if (mSpeed > mBoatTemplate.mMaxSpeed)
-                    mSpeed = mBoatTemplate.mMaxSpeed;
+                NavigationData().speed += mBoatTemplate.mAcceleration * frameTime;
+                if (NavigationData().speed > mBoatTemplate.mMaxSpeed)
+                    NavigationData().speed = mBoatTemplate.mMaxSpeed;
             }
         }
     }
     else {
         // If none is found, return to patrol.
-        mState = State::Patrol;
+        SetState(State::Patrol);
         return;
     }
 }
 
-void Boat::UpdateBoatTextTimer(float frameTime)
+// Show a text rising above the boat for a few seconds. Texts are interned, so showing one seen before makes no string
+void Boat::ShowText(std::string_view text)
 {
-    if (mBoatTextTimer > 0.0f)
-    {
-        mBoatTextTimer -= frameTime;
-        if (mBoatTextTimer <= 0.0f)
-        {
-            mBoatText.clear();
-        }
-    }
+    gFloatingText.Emit(GetID(), gFloatingText.Intern(text));
 }
 
 void Boat::UpdateWiggle(float frameTime)
@@ -517,7 +751,7 @@ void Boat::UpdateWiggle(float frameTime)
 
     if (mTimer <= 0.0f)
     {
-        mState = State::Patrol;
+        SetState(State::Patrol);
         Transform().RotateLocalZ(-mLastWiggleAngle);
         mLastWiggleAngle = 0.0f;
 
@@ -529,23 +763,25 @@ void Boat::UpdateWiggle(float frameTime)
     mWigglePhase += wiggleSpeed * frameTime;
 
     float amplitude = 0.1f;
-    float newAngle = std::sin(mWigglePhase) * amplitude;
+    float newAngle = FastSin(mWigglePhase) * amplitude;
 
     // Delta is how much we need to rotate this frame
     float deltaAngle = newAngle - mLastWiggleAngle;
     Transform().RotateLocalZ(deltaAngle);
 
     mLastWiggleAngle = newAngle;
-    mSpeed = mBoatTemplate.mMaxSpeed * 0.2f;
+    NavigationData().speed = mBoatTemplate.mMaxSpeed * 0.2f;
 }
 
 //------------------------------------------------------------------------------
 // Move towards the enemy boat that attacked a teammate.
 void Boat::UpdateMoveToAssist(float frameTime)
 {
-    if (!moveToEnemyBoat || moveToEnemyBoat->GetState() == "Destroyed")
+    PROFILE_SCOPE("Boat::UpdateMoveToAssist");
+    Boat* moveToEnemyBoat = gEntityManager->GetEntity<Boat>(mMoveToEnemyBoatID);
+    if (!moveToEnemyBoat || moveToEnemyBoat->IsDestroyed())
     {
-        mState = State::Patrol; // If the enemy boat is destroyed, revert to patrol
+        SetState(State::Patrol); // If the enemy boat is destroyed, revert to patrol
         return;
     }
 
@@ -556,20 +792,20 @@ void Boat::UpdateMoveToAssist(float frameTime)
     // If within engagement range, switch to Aim state
     if (distance <= 120.0f)
     {
-        mTimer = 2.0f;
-        mState = State::Aim;
+        SetState(State::Aim);
+        ScheduleWakeUp(2.0f, MessageType::AimComplete);
     }
     else
     {
         // Move towards the enemy boat
-        float turnSpeed = std::min(mSpeed * 0.2f, mBoatTemplate.mTurnSpeed);
-        FaceDirection(toEnemy, frameTime, turnSpeed);
+        float turnSpeed = std::min(NavigationData().speed * 0.2f, mBoatTemplate.mTurnSpeed);
+        FaceDirection(RouteTowards(enemyPos), frameTime, turnSpeed);
 
-        if (mSpeed < mBoatTemplate.mMaxSpeed)
+        if (NavigationData().speed < mBoatTemplate.mMaxSpeed)
         {
-            mSpeed += mBoatTemplate.mAcceleration * frameTime;
-            if (mSpeed > mBoatTemplate.mMaxSpeed)
-                mSpeed = mBoatTemplate.mMaxSpeed;
+            NavigationData().speed += mBoatTemplate.mAcceleration * frameTime;
+            if (NavigationData().speed > mBoatTemplate.mMaxSpeed)
+                NavigationData().speed = mBoatTemplate.mMaxSpeed;
         }
     }
 }
@@ -578,6 +814,13 @@ void Boat::UpdateMoveToAssist(float frameTime)
 // Destruction behavior: animate sinking before destruction.
 void Boat::DestructionBehaviour(float frameTime, bool& shouldDestroy)
 {
+    // The shield goes as soon as the boat starts sinking, rather than with the boat at the end
+    if (ShieldData().entity != NO_ID)
+    {
+        gEntityManager->DestroyEntity(ShieldData().entity);
+        ShieldData().entity = NO_ID;
+    }
+
     if (mSinkingAnimationTime > 0.0f)
     {
         mSinkingAnimationTime -= frameTime;
@@ -597,113 +840,57 @@ void Boat::DestructionBehaviour(float frameTime, bool& shouldDestroy)
 // Collision avoidance: adjust heading if another boat is too close.
 void Boat::HandleCollisionAvoidance(float frameTime)
 {
-    static float kSafeBoatDistance = 40.0f; // If another boat is within 40 units, we steer away
-    static float kThreatAngleDeg = 50.0f; // If boat is in front within (+/-)60°, treat as immediate threat
-
-    static float kSafeObstacleDistance = 50.0f; // Avoidance radius for obstacles
-    static float kThreatSpeedCap = 12.0f; // Speed limit if avoidance required
-
-    static float kAvoidStrength = 2.5f; // Steering strength for avoidance
-    static float kAvoidWeight = 0.60f; // Weight of avoidance direction
-    static float kForwardWeight = 0.40f; // Forward movement weight
-    static float kTurnMultiplier = 1.8f; // Boost turn speed when avoiding
-    static float kDirectionLerpFactor = 0.3f; // Smooth blending factor (30%)
+    // The pushes away from nearby boats and obstacles were summed for all boats at once by the SteeringSystem
+    if (mAvoidance.Length() <= 0.0001f)  return;
+    const SteeringSettings& steering = mBoatTemplate.mSteering;
 
-    // Get boats and obstacles
-    std::vector<Boat*> allBoats = gEntityManager->GetAllBoatEntities(GetID());
-    std::vector<Obstacle*> obstacles = gEntityManager->GetAllObstacleEntities();
-
-    Vector3 myPos = Transform().Position();
     Vector3 myForward = Transform().ZAxis();
     myForward.y = 0.0f;
     myForward = Normalise(myForward);
 
-    Vector3 avoidanceDirection(0.0f, 0.0f, 0.0f);
-
-    for (Boat* otherBoat : allBoats)
-    {
-        Vector3 offset = otherBoat->Transform().Position() - myPos;
-        float dist = offset.Length();
-        if (dist < 0.0001f) continue;
+    // Blend avoidance with forward direction
+    Vector3 avoidanceDirection = Normalise(mAvoidance) * steering.avoidStrength;
+    Vector3 desiredDir = (myForward * steering.forwardWeight) + (avoidanceDirection * steering.avoidWeight);
+    desiredDir.y = 0.0f;
+    desiredDir = Normalise(desiredDir);
 
-        // Regular Avoidance if boat is within
-        if (dist < kSafeBoatDistance)
-        {
-            // Steer away from the other boat
-            Vector3 awayFromOther = -OffsetNorm(offset, dist);
-            float proximityFactor = 1.0f - (dist / kSafeBoatDistance);
-            avoidanceDirection += awayFromOther * proximityFactor;
-        }
-    }
+    Vector3 smoothedDir = Lerp(myForward, desiredDir, steering.directionBlend);
+    smoothedDir = Normalise(smoothedDir);
 
-    // Handle obstacle avoidance
-    for (Obstacle* obs : obstacles)
-    {
-        const AABB& box = obs->GetAABB();
-        Vector3 obsCenter = (box.min + box.max) * 0.5f; // Compute the AABB center
-
-        Vector3 offset = myPos - obsCenter;
-        float dist = offset.Length();
-        if (dist > kSafeObstacleDistance) continue; // Skip obstacles that are far away
-
-        // The closer the boat is to the obstacle, the stronger the repulsion
-        float factor = 1.0f - (dist / kSafeObstacleDistance);
-        avoidanceDirection += Normalise(offset) * factor;
-    }
-
-    // Apply avoidance behavior
-    if (avoidanceDirection.Length() > 0.0001f)
-    {
-        avoidanceDirection = (avoidanceDirection / avoidanceDirection.Length()) * kAvoidStrength;
+    float finalTurnSpeed = mBoatTemplate.mTurnSpeed * steering.turnMultiplier;
+    NavigationData().speed = std::min(NavigationData().speed, steering.threatSpeedCap); // Reduce speed for sharp turns
 
-        // Blend avoidance with forward direction
-        Vector3 desiredDir = (myForward * kForwardWeight) + (avoidanceDirection * kAvoidWeight);
-        desiredDir.y = 0.0f;
-        desiredDir = Normalise(desiredDir);
-
-        Vector3 smoothedDir = Lerp(myForward, desiredDir, kDirectionLerpFactor);
-        smoothedDir = Normalise(smoothedDir);
-
-        float finalTurnSpeed = mBoatTemplate.mTurnSpeed * kTurnMultiplier;
-        mSpeed = std::min(mSpeed, kThreatSpeedCap); // Reduce speed for sharp turns
-
-        FaceDirection(smoothedDir, frameTime, finalTurnSpeed);
-    }
+    FaceDirection(smoothedDir, frameTime, finalTurnSpeed);
 }
 
 RandomCrate* Boat::FindNearestCrate(float maxDistance)
 {
-    std::vector<RandomCrate*> crates = gEntityManager->GetAllCratesEntities();
     Vector3 boatPos = Transform().Position();
-    RandomCrate* nearestCrate = nullptr;
-
-    for (RandomCrate* crate : crates)
+    CrateReservations& reservations = gEntityManager->Reservations();
+    return static_cast<RandomCrate*>(gEntityManager->Spatial().QueryNearest(boatPos, SPATIAL_CRATE, maxDistance, [&](Entity* crate)
     {
-        Vector3 cratePos = crate->Transform().Position();
-        float distance = (cratePos - boatPos).Length();
-        if (distance <= maxDistance)
-        {
-            maxDistance = distance;
-            nearestCrate = crate;
-        }
-    }
-
-    return nearestCrate;
+        return !reservations.IsReservedByOther(crate->GetID(), GetID());
+    }));
 }
 
-bool Boat::IsLineOfSightBlocked(const Vector3& start, const Vector3& end)
+// Reserve the crate for the time the boat expects to take getting there and make it the target. Returns false, leaving the
+// target as it is, if another boat has reserved it
+bool Boat::ReserveCrate(RandomCrate* crate)
 {
-    std::vector<Obstacle*> obstacles = gEntityManager->GetAllObstacleEntities(); // Get all obstacles
-
-    for (Obstacle* obs : obstacles)
-    {
-        if (!obs) continue;
+    Vector3 cratePos = crate->Transform().Position();
+    float travelTime = (cratePos - Transform().Position()).Length() / std::max(mBoatTemplate.mMaxSpeed, 1.0f);
+    if (!gEntityManager->Reservations().Reserve(crate->GetID(), GetID(), travelTime))  return false;
 
-        // If line from start to end intersects with the obstacle's bounding box, LoS is blocked
-        if (obs->IntersectsLineSegment(start, end)) return true;
-    }
+    mTargetCrateID = crate->GetID();
+    mTargetCratePoint = cratePos;
+    mTargetCrateRadius = crate->collisionRadius;
+    return true;
+}
 
-    return false;
+bool Boat::IsLineOfSightBlocked(const Vector3& start, const Vector3& end)
+{
+    // If line from start to end intersects with any obstacle's bounding box, LoS is blocked
+    return gEntityManager->ObstacleTree().IsSegmentBlocked(start, end);
 }
 
 //------------------------------------------------------------------------------
@@ -730,19 +917,29 @@ void Boat::FaceDirection(const Vector3& dir, float dt, float turnSpeed)
         angle = maxTurn;
     }
 
-    Matrix4x4 partialRot = MatrixRotationY(turnDir * angle);
-    Vector3 newForward = partialRot.TransformVector(forward);
+    Vector3 newForward = QuaternionRotationY(turnDir * angle).Rotate(forward);
     Transform().FaceDirection(newForward);
 }
 
 //------------------------------------------------------------------------------
-// Choose a random patrol point (for example, within a 500x500 area at water level).
+// Head towards the target by the shortest route around the obstacles, using the navigation flow fields.
+Vector3 Boat::RouteTowards(const Vector3& target)
+{
+    Vector3 direction = gEntityManager->Navigation().DirectionToGoal(Transform().Position(), target);
+    return (direction.Length() > 0.0f) ? direction : target - Transform().Position();
+}
+
+//------------------------------------------------------------------------------
+// Choose a random patrol point within the patrol area, one of the navigation points spread over the open water so it is
+// never inside an obstacle (see NavigationPoints.h). Anywhere in the area if the whole area is blocked
 Vector3 Boat::ChooseRandomPointInArea()
 {
-    float x = Random(-500.0f, 500.0f);
-    float z = Random(-500.0f, 500.0f);
+    Vector3 point;
+    if (gEntityManager->Navigation().Points().RandomPoint(mRandom, point))  return point;
 
-    return Vector3(x, -1.5f, z);
+    const Vector3& areaMin = NavigationPoints::AREA_MIN;
+    const Vector3& areaMax = NavigationPoints::AREA_MAX;
+    return { mRandom.Range(areaMin.x, areaMax.x), areaMin.y, mRandom.Range(areaMin.z, areaMax.z) };
 }
 
 //------------------------------------------------------------------------------
@@ -758,103 +955,103 @@ Vector3 Boat::ChooseEvadePoint(const Vector3& enemyPos)
     toEnemy.y = 0.0f;
     toEnemy = Normalise(toEnemy);
 
-    Vector3 chosenOffset;
-    bool acceptable = false;
-    for (int i = 0; i < 10; ++i)
-    {
-        float angle = Random(0.0f, 2.0f * std::numbers::pi_v<float>);
-        float dist = Random(minDist, maxDist);
-
-        Vector3 offset{ dist * std::cos(angle), 0.0f, dist * std::sin(angle) };
-        Vector3 offsetDir = Normalise(offset);
-
-        float angleDeg = static_cast<float>(std::acos(std::clamp(Dot(offsetDir, toEnemy), -1.0f, 1.0f)) * (180.0f / std::numbers::pi_v<float>));
-        
-        if (angleDeg < avoidCone) continue;
-
-        chosenOffset = offset;
-        acceptable = true;
-        break;
-    }
-    if (!acceptable)
-    {
-        float angle = Random(0.0f, 2.0f * std::numbers::pi_v<float>);
-        float dist = Random(minDist, maxDist);
-        chosenOffset = { dist * std::cos(angle), 0.0f, dist * std::sin(angle) };
-    }
-
-    return myPos + chosenOffset;
+    // One of the navigation points in the ring around the boat that isn't towards the enemy, so never inside an obstacle
+    // (see NavigationPoints.h). If the obstacles leave none, any point in the ring, and if there are none of those either
+    // (the boat is hemmed in) anywhere in the ring
+    const NavigationPoints& points = gEntityManager->Navigation().Points();
+    Vector3 point;
+    if (points.RandomPointInRing(myPos, minDist, maxDist, toEnemy, ToRadians(avoidCone), mRandom, point))  return point;
+    if (points.RandomPointInRing(myPos, minDist, maxDist, toEnemy, 0.0f, mRandom, point))  return point;
+
+    float angle = mRandom.Range(0.0f, 2.0f * std::numbers::pi_v<float>);
+    float dist = mRandom.Range(minDist, maxDist);
+    return myPos + Vector3{ dist * std::cos(angle), 0.0f, dist * std::sin(angle) };
 }
 
 //------------------------------------------------------------------------------
 // Check for an enemy boat (from a different team) in front within a given angle and distance.
 EntityID Boat::CheckForEnemy()
 {
-    // Retrieve all Boat entities except self
-    std::vector<Boat*> otherBoats = gEntityManager->GetAllBoatEntities(GetID());
-
-    // Get this boat's forward direction in XZ plane
-    Vector3 forward = Transform().ZAxis();
-    forward.y = 0.0f;
-    forward = Normalise(forward);
-
-    Vector3 boatPos = Transform().Position();
-
-    for (Boat* enemyBoat : otherBoats)
-    {
-        // Skip if boat is null, from same team, or destroyed
-        if (!enemyBoat || enemyBoat->GetTeam() == GetTeam() || enemyBoat->GetState() == "Destroyed") continue;
-
-        Vector3 enemyBoatPos = enemyBoat->Transform().Position();
-        Vector3 toEnemy = enemyBoatPos - boatPos;
-        float distance = toEnemy.Length();
-
-        // Check distance
-        if (distance > 140.0f) continue;
-
-        // Check angle
-        Vector3 toEnemyNorm = Normalise(toEnemy);
-        float dotProduct = Dot(forward, toEnemyNorm);
-        dotProduct = std::clamp(dotProduct, -1.0f, 1.0f);
-        float angle = static_cast<float>(std::acos(dotProduct) * (180.0f / std::numbers::pi_v<float>));
-
-        if (angle > 70.0f) continue;
+    // The sensor system looks for enemies within 140 units and 70 degrees of the heading that aren't hidden behind an
+    // obstacle (see SensorSystem.h), and the team blackboard shares out the ones seen between the boats that saw them
+    // (see TeamBlackboard.h). Take the one this boat has been given if it is still afloat
+    EntityID enemyID = gEntityManager->Blackboard().AssignmentOf(this).target;
+    Boat* enemyBoat = gEntityManager->GetEntity<Boat>(enemyID);
+
+    // NO_ID if no enemy detected
+    return enemyBoat != nullptr && !enemyBoat->IsDestroyed() ? enemyID : NO_ID;
+}
 
-        // Check line of sight
-        if (!IsLineOfSightBlocked(boatPos, enemyBoatPos))
-        {
-            return enemyBoat->GetID();
-        }
-    }
+//------------------------------------------------------------------------------
+// Go to help a teammate if the team blackboard has sent this boat to, returns whether it has
+bool Boat::StartAssisting()
+{
+    EntityID enemyID = gEntityManager->Blackboard().AssignmentOf(this).assist;
+    Boat* enemyBoat = gEntityManager->GetEntity<Boat>(enemyID);
+    if (enemyBoat == nullptr || enemyBoat->IsDestroyed())  return false;
 
-    // No enemy detected
-    return NO_ID;
+    mMoveToEnemyBoatID = enemyID;
+    SetState(State::MoveToAssist);
+    return true;
 }
 
 //------------------------------------------------------------------------------
-// Broadcast a help message to team-mates.
-void Boat::BroadcastHelpMessage(Boat* enemyEntity)
+// Take the action chosen by the decision system, setting up the new state as the state machine does. Decisions made in an
+// earlier state are not returned by DecisionOf, so a boat never acts on one made before its last change of state
+void Boat::ApplyDecision()
 {
-    if (!enemyEntity || enemyEntity->GetState() == "Destroyed") return;
+    const DecisionSystem::Decision& decision = gEntityManager->Decisions().DecisionOf(this);
+    switch (decision.action)
+    {
+    case DecisionSystem::Action::Patrol:
+        if (mState == State::Patrol)  return;
+        mPatrolPoint = ChooseRandomPointInArea();
+        SetState(State::Patrol);
+        break;
 
-    Vector3 enemyPos = enemyEntity->Transform().Position();
-    static float kHelpDistance = Random(100.0f, 300.0f);
+    case DecisionSystem::Action::Aim:
+        if (mState == State::Aim || gEntityManager->GetEntity<Boat>(decision.target) == nullptr)  return;
+        NavigationData().speed = 0.0f;
+        mTargetBoat = decision.target;
+        SetState(State::Aim);
+        ScheduleWakeUp(2.0f, MessageType::AimComplete);
+        break;
 
-    // Get all teammate boats (excluding self)
-    std::vector<Boat*> teammates = gEntityManager->GetAllBoatEntities(GetID());
+    case DecisionSystem::Action::Evade:
+    {
+        if (mState == State::Evade)  return;
+        Boat* enemy = gEntityManager->GetEntity<Boat>(decision.target);
+        if (enemy == nullptr)  return;
+        mEvadePoint = ChooseEvadePoint(enemy->Transform().Position());
+        SetState(State::Evade);
+        ScheduleWakeUp(5.0f, MessageType::EvadeComplete);
+        break;
+    }
 
-    for (Boat* mate : teammates)
+    case DecisionSystem::Action::PickupCrate:
     {
-        if (!mate || mate->GetTeam() != mTeam) continue;
+        if (mState == State::PickupCrate)  return;
+        RandomCrate* crate = gEntityManager->GetEntity<RandomCrate>(decision.target);
+        if (crate == nullptr || !ReserveCrate(crate))  return; // Another boat got there first since the decision
+        NavigationData().speed = std::min(NavigationData().speed, mBoatTemplate.mMaxSpeed);
+        SetState(State::PickupCrate);
+        break;
+    }
 
-        Vector3 matePos = mate->Transform().Position();
-        Vector3 toEnemy = enemyPos - matePos;
-        float distanceToEnemy = toEnemy.Length();
+    case DecisionSystem::Action::Reload:
+        if (mState == State::Reloading)  return;
+        mTimer = 0.0f;
+        SetState(State::Reloading);
+        break;
 
-        if (distanceToEnemy > kHelpDistance) continue;
+    case DecisionSystem::Action::MoveToAssist:
+        if (mState == State::MoveToAssist)  return;
+        mMoveToEnemyBoatID = decision.target;
+        SetState(State::MoveToAssist);
+        break;
 
-        HelpMessageData helpData{ enemyEntity->GetID() };
-        gMessenger->DeliverMessage(GetID(), mate->GetID(), MessageType::Help, helpData);
+    case DecisionSystem::Action::None:
+        break;
     }
 }
 
@@ -862,8 +1059,10 @@ void Boat::AttachShieldMesh()
 {
     // Create a shield transform slightly above the boat
     Matrix4x4 shieldTransform = Transform();
-    shieldTransform.MoveLocalY(2.0f);
+    shieldTransform.MoveLocalY(Shield::HEIGHT);
 
-    // Create the shield entity with this boat's ID
-    mShieldEntityID = gEntityManager->CreateEntity<Shield>("Shield", shieldTransform, GetID());
+    // Create the shield entity with this boat's ID and attach it, so it follows the boat and is destroyed with it
+    static TemplateHandle shieldTemplate{ Atom("Shield") }; // Kept between shields, see TemplateHandle in EntityManager.h
+    ShieldData().entity = gEntityManager->CreateEntity<Shield>(shieldTemplate, shieldTransform, GetID());
+    if (ShieldData().entity != NO_ID)  gEntityManager->Attach(ShieldData().entity, GetID(), Matrix4x4(Vector3{ 0.0f, Shield::HEIGHT, 0.0f }));
 }
\ No newline at end of file
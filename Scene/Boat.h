@@ -50,6 +50,13 @@
 #include "RandomCrate.h"
 #include "Vector3.h"
 #include "Matrix4x4.h"
+#include "TRS.h"
+#include "Random.h"
+#include "BallisticSolver.h"
+#include "BoatComponents.h"
+#include "Behaviour.h"
+
+#include <string_view>
 
 struct AABB;
 
@@ -62,10 +69,24 @@ enum class Team : int
 
 inline const char* const teamNames[] = { "Team A", "Team B", "Team C" };
 
+// How a type of boat steers away from other boats and obstacles, see Boat::HandleCollisionAvoidance. Optional attributes of
+// a BoatTemplate in the level file, with these defaults
+struct SteeringSettings
+{
+    float safeBoatDistance = 40.0f; // Steer away from other boats closer than this
+    float threatSpeedCap   = 12.0f; // Speed limit while avoiding
+    float avoidStrength    = 2.5f;  // Length of the avoidance direction before blending with the forward direction
+    float avoidWeight      = 0.6f;  // Blend of the avoidance direction...
+    float forwardWeight    = 0.4f;  // ...and forward direction for the direction wanted
+    float turnMultiplier   = 1.8f;  // Boost to turn speed while avoiding
+    float directionBlend   = 0.3f;  // Fraction of the way from forward to the direction wanted turned towards each update
+};
+
+
 /*-----------------------------------------------------------------------------------------
 	Boat Entity Template Class
 -----------------------------------------------------------------------------------------*/
-class BoatTemplate : public EntityTemplate // entity templates must inherit from EntityTemplate class
+class BoatTemplate : public EntityTemplate, public TaggedType<BoatTemplate, TypeTag::BoatTemplate> // entity templates must inherit from EntityTemplate class
 {
 	friend class Boat; // Allow Boat entity class access to private BoatTemplate data - use friend sparingly, but justified here for related classes
 	                   // Do the same in any entity template classes you create
@@ -79,11 +100,11 @@ public:
 	// Must include importFlags as last parameter regardless
     BoatTemplate(const std::string& type, const std::string& meshFilename,
         float maxSpeed, float acceleration, float turnSpeed, float gunTurnSpeed,
-        float maxHP, int missiles, float missileDamage, Team team, ImportFlags importFlags = {})
+        float maxHP, int missiles, float missileDamage, Team team, const SteeringSettings& steering = {}, ImportFlags importFlags = {})
         : EntityTemplate(type, meshFilename, importFlags),
         mMaxSpeed(maxSpeed), mAcceleration(acceleration), mTurnSpeed(turnSpeed),
         mGunTurnSpeed(gunTurnSpeed), mMaxHP(maxHP), mMissiles(missiles),
-        mMissileDamage(missileDamage), mTeam(team)
+        mMissileDamage(missileDamage), mTeam(team), mSteering(steering)
     {}
 
 
@@ -101,6 +122,7 @@ private:
     int mMissiles;
     float mMissileDamage;
     Team mTeam;
+    SteeringSettings mSteering;
 };
 
 
@@ -108,7 +130,7 @@ private:
 /*-----------------------------------------------------------------------------------------
 	Boat Entity Class 
 -----------------------------------------------------------------------------------------*/
-class Boat : public Entity // entity classes must inherit from Entity
+class Boat : public Entity, public TaggedType<Boat, TypeTag::Boat> // entity classes must inherit from Entity
 {
 	/*-----------------------------------------------------------------------------------------
 	   Constructor
@@ -118,38 +140,100 @@ public:
 	// Further parameters are allowed if required. Here we set an initial speed for the new boat.
 	// Since the base class also has optional transform and name parameters you should also add those two parameters at the end
 	// at the end also even though not strictly required
+	// The boat's health, weapon, movement, shield and team are added to the entity manager's boat components (see
+	// BoatComponents.h), this class is the way to them
     Boat(EntityTemplate& entityTemplate, EntityID ID, float initSpeed,
-        const Matrix4x4& transform, const std::string& name = "")
-        : Entity(entityTemplate, ID, transform, name),
-        mBoatTemplate(static_cast<BoatTemplate&>(entityTemplate)),
-        mTeam(mBoatTemplate.mTeam)
+        const Matrix4x4& transform, Atom name = {});
+
+
+    /*-----------------------------------------------------------------------------------------
+       Types
+    -----------------------------------------------------------------------------------------*/
+public:
+    // States available for boats
+    enum class State
     {
-        mHP = mBoatTemplate.mMaxHP;
-        mSpeed = initSpeed;
-        if (mSpeed > mBoatTemplate.mMaxSpeed)  mSpeed = mBoatTemplate.mMaxSpeed;
-
-        mDoubleSpeed = mBoatTemplate.mMaxSpeed * 2;
-        mState = State::Inactive;
-        mTimer = 0.0f;
-        mMissileDamage = mBoatTemplate.mMissileDamage;
-        mMissilesRemaining = mBoatTemplate.mMissiles;
-        mReloading = false;
-    }
+        Inactive,
+        Patrol,
+        Aim,
+        Evade,
+        Reloading,
+        Destroyed,
+        TargetPoint,
+        PickupCrate,
+        Wiggle,
+        MoveToAssist
+    };
+
+    // A change in a boat's state, see StateChanges below
+    struct StateChange
+    {
+        EntityID boat;
+        State    from;
+        State    to;
+    };
 
 
     /*-----------------------------------------------------------------------------------------
        Getters
     -----------------------------------------------------------------------------------------*/
 public:
-    int GetMissilesFired() { return mMissilesFired; }
-    float GetHP() { return mHP; }
-    float GetSpeed() { return mSpeed; }
-    float GetDoubleSpeed() { return mDoubleSpeed; }
-    float GetMissileDamage() { return mMissileDamage; }
-    Team GetTeam() { return mTeam; }
-    std::string GetState()
+    int GetMissilesFired() { return WeaponData().missilesFired; }
+    float GetHP() { return HealthData().hp; }
+    float GetMaxHP() { return HealthData().maxHP; }
+    float GetSpeed() { return NavigationData().speed; }
+    float GetDoubleSpeed() { return NavigationData().doubleSpeed; }
+    float GetMissileDamage() { return WeaponData().missileDamage; }
+    const SteeringSettings& GetSteering() { return mBoatTemplate.mSteering; }
+    Team GetTeam() { return LabelData().team; }
+    State GetState() { return mState; }
+
+    // The boat's components, see BoatComponents.h. Looked up each time as they move when other boats are destroyed
+    BoatHealth&     HealthData()      { return mComponents.Health(GetID()); }
+    BoatWeapon&     WeaponData()      { return mComponents.Weapon(GetID()); }
+    BoatNavigation& NavigationData()  { return mComponents.Navigation(GetID()); }
+    BoatShield&     ShieldData()      { return mComponents.Shield(GetID()); }
+    BoatLabel&      LabelData()       { return mComponents.Label(GetID()); }
+
+    // Cheap state checks for use every frame. A boat is active once it has been started, including while it is sinking
+    bool IsDestroyed() { return mState == State::Destroyed; }
+    bool IsActive() { return mState != State::Inactive; }
+
+    // In combat or otherwise doing something that needs a quick response: aiming, evading, going to help, hit by a mine,
+    // following an order or sinking. The AI scheduler always lets these boats think every update
+    bool IsInCombat()
+    {
+        return mState == State::Aim || mState == State::Evade || mState == State::MoveToAssist || mState == State::Wiggle ||
+               mState == State::TargetPoint || mState == State::Destroyed;
+    }
+
+    // The sum of the pushes away from nearby boats and obstacles, set by the SteeringSystem before each update
+    void SetAvoidance(const Vector3& avoidance) { mAvoidance = avoidance; }
+
+    // The boat's velocity over the water, zero while aiming or sinking as it isn't moved then
+    Vector3 GetVelocity()
+    {
+        if (mState == State::Aim || mState == State::Destroyed)  return { 0, 0, 0 };
+        return Normalise(Transform().ZAxis()) * GetSpeed();
+    }
+
+    // Aiming, see BallisticSolver. The enemy being aimed at, the request for a missile from this boat to hit the given enemy,
+    // and the launch velocity solved for it at the given enemy, set by the solver before each update
+    EntityID GetTargetBoat() { return mTargetBoat; }
+    BallisticSolver::Request AimRequest(Boat* enemy);
+    void SetLaunchVelocity(const Vector3& velocity, EntityID enemyID) { mLaunchVelocity = velocity; mLaunchTarget = enemyID; }
+
+    // AI level of detail, see AIScheduler. Whether the boat's behaviour runs in its next update, the time since it last ran
+    // and the number of times a second it has been running recently
+    void  SetThinkThisUpdate(bool think) { mThinkThisUpdate = think; }
+    float TimeSinceThought() { return mTimeSinceThought; }
+    float GetThinkRate() { return mThinkRate; }
+
+    // Name of the state for display, no string is built
+    const char* GetStateName() { return GetStateName(mState); }
+    static const char* GetStateName(State state)
     {
-        switch (mState)
+        switch (state)
         {
         case State::Inactive: return "Inactive";
         case State::Patrol:   return "Patrol";
@@ -165,36 +249,77 @@ public:
         return "?";
     }
 
+    // Every boat state change since ClearStateChanges was last called, in the order they happened. Lets UI and AI code react
+    // to changes rather than checking the state of every boat each frame. The scene clears the list at the start of each update
+    // so it holds the changes from the most recent frame. Boats are always updated on the main thread so no locking is needed
+    static const std::vector<StateChange>& StateChanges() { return sStateChanges; }
+    static void ClearStateChanges() { sStateChanges.clear(); }
+
     inline const char* GetTeamName() {
-        return teamNames[static_cast<int>(mTeam)];
+        return teamNames[static_cast<int>(GetTeam())];
     }
 
     // Setters
-    void SetTeam(Team team) { mTeam = team; }
-    void SetHP(float HP) { mHP = HP; }
-    void SetSpeed(float speed) { mSpeed = speed; }
+    void SetTeam(Team team) { LabelData().team = team; }
+    void SetHP(float HP) { HealthData().hp = HP; }
+    void SetSpeed(float speed) { NavigationData().speed = speed; }
 
     // Missile operations
     void UseMissile()
     {
-        if (mMissilesRemaining > 0)
+        BoatWeapon& weapon = WeaponData();
+        if (weapon.missilesRemaining > 0)
         {
-            --mMissilesRemaining;
-            ++mMissilesFired;
+            --weapon.missilesRemaining;
+            ++weapon.missilesFired;
         }
     }
-    int GetMissilesRemaining() const { return mMissilesRemaining; }
-    void ReloadMissiles() { mMissilesRemaining = 10; }
-    void AddMissiles(unsigned int missiles) { mMissilesRemaining += missiles; }
+    int GetMissilesRemaining() { return WeaponData().missilesRemaining; }
+    int GetMaxMissiles() { return WeaponData().maxMissiles; }
+    void ReloadMissiles() { WeaponData().missilesRemaining = 10; }
+    void AddMissiles(unsigned int missiles) { WeaponData().missilesRemaining += missiles; }
+
+    // Show a text rising above the boat for a few seconds, see FloatingText.h
+    void ShowText(std::string_view text);
 
-    void SetBoatText(const std::string& text)
+    /*-----------------------------------------------------------------------------------------
+       Checkpoints
+    -----------------------------------------------------------------------------------------*/
+public:
+    // Everything about the boat except its template, ID, name and matrices, as plain data so a checkpoint can copy it as bytes
+    // (see Checkpoint.h). A boat created again with the same template, ID and matrices then given this state carries on as the
+    // saved boat would have. Text floating above the boat is not saved, it is only for show
+    struct SavedState
     {
-        mBoatText = text;
-        mBoatTextTimer = 3.0f;
-    }
+        float    speed, doubleSpeed, hp, timer;
+        TRS      gunTurret, gunBarrel;
+        uint32_t timerToken;
+        float    missileDamage;
+        int      missilesFired;
+        State    state;
+        Team     team;
+        int      missilesRemaining;
+        bool     reloading;
+        float    wigglePhase, lastWiggleAngle, sinkingAnimationTime;
+        Vector3  patrolPoint, evadePoint, targetPoint;
+        float    targetRange;
+        EntityID targetCrateID, shieldEntityID;
+        float    shieldTimer;
+        RandomStream random;
+        EntityID moveToEnemyBoatID, targetBoat;
+        Vector3  avoidance, launchVelocity;
+        EntityID launchTarget;
+        bool     thinkThisUpdate;
+        float    timeSinceThought, thinkRate;
+        Vector3  reloadPoint;
+        bool     docked;
+        float    reloadTimeLeft;
+        Vector3  targetCratePoint;
+        float    targetCrateRadius;
+    };
+    SavedState SaveState();
+    void RestoreState(const SavedState& saved); // Doesn't add to StateChanges
 
-    const std::string& GetBoatText() const { return mBoatText; }
-    float GetBoatTextTimer() const { return mBoatTextTimer; }
 
     /*-----------------------------------------------------------------------------------------
        Update / Render
@@ -206,64 +331,54 @@ public:
 
 
 	/*-----------------------------------------------------------------------------------------
-	   Private types
+	   Private helpers
 	-----------------------------------------------------------------------------------------*/
 private:
-	// States available for boats
-    enum class State
-    {
-        Inactive,
-        Patrol,
-        Aim,
-        Evade,
-        Reloading,
-        Destroyed,
-        TargetPoint,
-        PickupCrate,
-        Wiggle,
-        MoveToAssist
-    };
+    // Change state, recording the change in StateChanges if the state is different. A behaviour running for the state
+    // being left is stopped (see Behaviour.h)
+    void SetState(State newState);
 
     // Helper functions for state behavior.
     void UpdatePatrol(float frameTime);
     void UpdateAim(float frameTime);
     void UpdateEvade(float frameTime);
     void UpdateReloading(float frameTime);
+    Behaviour ReloadBehaviour(float reloadTime);
     void UpdateTargetPoint(float frameTime);
     void UpdatePickupCrate(float frameTime);
-    void UpdateBoatTextTimer(float frameTime);
     void UpdateWiggle(float frameTime);
     void UpdateMoveToAssist(float frameTime);
+    void FireAtTarget(Boat* enemyPtr, float frameTime);
+    void EndEvade();
 
     // Internal helpers
     Vector3 ChooseRandomPointInArea();
     Vector3 ChooseEvadePoint(const Vector3& enemyPos);
     void FaceDirection(const Vector3& dir, float dt, float turnSpeed);
+    Vector3 RouteTowards(const Vector3& target); // Direction to head in to reach the target around any obstacles
     EntityID CheckForEnemy(); // Return first boat ID seen
-    void BroadcastHelpMessage(Boat* enemyEntity);
+    bool StartAssisting(); // Go to help a teammate if the team blackboard says to
+    void ApplyDecision(); // Take the action chosen by the decision system, if it is for the current state (see DecisionSystem.h)
     void DestructionBehaviour(float frameTime, bool& shouldDestroy);
     void HandleCollisionAvoidance(float frameTime);
-    RandomCrate* FindNearestCrate(float maxDistance);
+    RandomCrate* FindNearestCrate(float maxDistance); // Nearest crate not reserved by another boat
+    bool ReserveCrate(RandomCrate* crate); // Reserve the crate and make it the target, false if another boat has it (see CrateReservations)
     bool IsLineOfSightBlocked(const Vector3& start, const Vector3& end);
     void AttachShieldMesh();
+    void ScheduleWakeUp(float delay, MessageType type); // Deliver a TimerData message of the given type to this boat after the delay
 
 
     /*-----------------------------------------------------------------------------------------
    Private data
     -----------------------------------------------------------------------------------------*/
 private:
-    // Boat state
+    // Boat state. The speed, health, missiles, guns, shield and team are in the boat components, see HealthData etc.
     BoatTemplate& mBoatTemplate; // Reference to the boat template
-    float mSpeed; // Current speed (in facing direction)
-    float mDoubleSpeed; // Speed multiplier
-    float mHP; // Current hit points for the boat
+    BoatComponents& mComponents;
     float mTimer; // General-purpose timer for updates
-    float mMissileDamage; // Damage dealt per missile
-    int mMissilesFired = 0; // Count of fired missiles
+
+    uint32_t mTimerToken = 0; // Token of the latest wake-up scheduled with ScheduleWakeUp, earlier ones are ignored
     State mState; // Current state affecting behavior in Update function
-    Team mTeam; // Team affiliation of the boat
-    int mMissilesRemaining; // Number of missiles left
-    bool mReloading; // Flag indicating if the boat is reloading
     float mWigglePhase = 0.0f; // Controls movement oscillation
     float mLastWiggleAngle = 0.0f; // Stores last wiggle angle
     float mSinkingAnimationTime = 4.0f;
@@ -272,16 +387,35 @@ private:
     Vector3 mEvadePoint; // Destination point for evasion
     Vector3 mTargetPoint; // Current target position
     float mTargetRange = 5.0f; // Distance within which the target is considered reached
-    std::string mBoatText; // Text displayed for the boat
-    float mBoatTextTimer = 0.0f; // Timer controlling boat text display
 
-    RandomCrate* mTargetCrate = nullptr; // Pointer to the crate being targeted
-    EntityID mShieldEntityID = NO_ID; // ID of the shield entity (if applicable)
-    float mShieldTimer = 0.0f; // Duration for which the shield remains active
+    // Reloading, see ReloadBehaviour. Boats within DOCK_RANGE of the station stop and reload after RELOAD_TIME seconds
+    static constexpr float DOCK_RANGE  = 40.0f;
+    static constexpr float RELOAD_TIME = 5.0f;
+    static constexpr float WAIT_RANGE  = 100.0f; // Boats waiting their turn at a station stop this far away (see ReloadService)
+    Vector3 mReloadPoint = { 0, 0, 0 }; // Position of the station being reloaded at
+    bool    mDocked = false;            // Stopped at the station waiting for the reload, the update does nothing meanwhile
+
+    EntityID mTargetCrateID = NO_ID; // ID of the crate being targeted, reserved for this boat while in the PickupCrate state
+    Vector3  mTargetCratePoint = { 0, 0, 0 }; // Where it is, crates don't move across the water
+    float    mTargetCrateRadius = 0.0f;       // Its pickup radius
 
-    Boat* moveToEnemyBoat = nullptr;
+    // This boat's own random numbers, a stream numbered by its ID. A shared stream would give each boat different choices
+    // whenever other entities are created, destroyed or updated in a different order, this keeps a boat's choices repeatable
+    RandomStream mRandom;
+
+    EntityID mMoveToEnemyBoatID = NO_ID; // ID of the enemy boat a teammate asked for help with
 
     EntityID mTargetBoat = NO_ID; // ID of the enemy boat being targeted
+    Vector3 mAvoidance = { 0, 0, 0 }; // See SetAvoidance
+    Vector3 mLaunchVelocity = { 0, 0, 0 }; // See SetLaunchVelocity
+    EntityID mLaunchTarget = NO_ID;
+
+    // AI level of detail, see AIScheduler. Boats think every update unless the scheduler says otherwise
+    bool  mThinkThisUpdate  = true;
+    float mTimeSinceThought = 0.0f;
+    float mThinkRate        = 0.0f; // Thinks per second, smoothed
+
+    inline static std::vector<StateChange> sStateChanges; // See StateChanges()
 };
 
 
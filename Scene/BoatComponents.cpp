@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// Boat components - the data of every boat kept in one packed array per kind of data
+//--------------------------------------------------------------------------------------
+
+#include "BoatComponents.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add the components of the boat with the given ID at the end of the arrays, replacing any it already has
+void BoatComponents::Add(EntityID id, Boat* boat, const BoatHealth& health, const BoatWeapon& weapon, const BoatNavigation& navigation,
+                         const BoatShield& shield, const BoatLabel& label)
+{
+	uint32_t index = EntityIndex(id);
+	if (index >= mBoatIndex.size())  mBoatIndex.resize(index + 1, NO_BOAT);
+
+	uint32_t position = mBoatIndex[index];
+	if (position == NO_BOAT)
+	{
+		mBoatIndex[index] = static_cast<uint32_t>(mBoats.size());
+		mIds       .push_back(id);
+		mBoats     .push_back(boat);
+		mHealth    .push_back(health);
+		mWeapons   .push_back(weapon);
+		mNavigation.push_back(navigation);
+		mShields   .push_back(shield);
+		mLabels    .push_back(label);
+		return;
+	}
+	mIds       [position] = id;
+	mBoats     [position] = boat;
+	mHealth    [position] = health;
+	mWeapons   [position] = weapon;
+	mNavigation[position] = navigation;
+	mShields   [position] = shield;
+	mLabels    [position] = label;
+}
+
+
+// Remove a boat's components, does nothing if it has none
+void BoatComponents::Remove(EntityID id)
+{
+	uint32_t index = EntityIndex(id);
+	if (index >= mBoatIndex.size() || mBoatIndex[index] == NO_BOAT)  return;
+
+	// Move the last boat's components into the gap
+	uint32_t position = mBoatIndex[index];
+	uint32_t last = static_cast<uint32_t>(mBoats.size() - 1);
+	if (position != last)
+	{
+		mIds       [position] = mIds       [last];
+		mBoats     [position] = mBoats     [last];
+		mHealth    [position] = mHealth    [last];
+		mWeapons   [position] = mWeapons   [last];
+		mNavigation[position] = mNavigation[last];
+		mShields   [position] = mShields   [last];
+		mLabels    [position] = mLabels    [last];
+		mBoatIndex[EntityIndex(mIds[position])] = position;
+	}
+	mIds       .pop_back();
+	mBoats     .pop_back();
+	mHealth    .pop_back();
+	mWeapons   .pop_back();
+	mNavigation.pop_back();
+	mShields   .pop_back();
+	mLabels    .pop_back();
+	mBoatIndex[index] = NO_BOAT;
+}
@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------------
+// Boat components - the data of every boat kept in one packed array per kind of data
+//--------------------------------------------------------------------------------------
+// A boat's health, weapon, movement, shield and label data live here rather than in the Boat object, one element per boat
+// in each array, in the same position in every array. Systems that work on one kind of data for all the boats walk just
+// that array without touching the boats or their other data:
+//  - the DamageSystem applies the damage in the boats' messages to the health array before the boats are updated
+//  - the NavigationSystem moves every boat along its heading by its speed, once the boats have been updated
+//  - the WeaponSystem rebuilds the matrices of the guns the boats turned
+// The Boat class keeps its state machine and is the way everything else reaches the data, e.g. boat->GetHP() reads the
+// boat's element of the health array, so code using boats doesn't change.
+//
+// Each boat adds its components when it is created, and the EntityManager removes them when it is destroyed. Positions in
+// the arrays change as boats are removed, so look a boat's data up by its ID each time rather than keeping a reference:
+//   BoatHealth& health = gEntityManager->BoatData().Health(boat->GetID());
+//   for (BoatHealth& health : gEntityManager->BoatData().HealthArray())  ...  // Every boat, in no particular order
+
+#ifndef _BOAT_COMPONENTS_H_INCLUDED_
+#define _BOAT_COMPONENTS_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "TRS.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class Boat;
+enum class Team : int;
+
+/*-----------------------------------------------------------------------------------------
+   Components
+-----------------------------------------------------------------------------------------*/
+
+struct BoatHealth
+{
+	float hp    = 0;
+	float maxHP = 0;
+};
+
+struct BoatWeapon
+{
+	float missileDamage     = 0; // Damage dealt per missile
+	int   missilesRemaining = 0;
+	int   maxMissiles       = 0;
+	int   missilesFired     = 0;
+	bool  reloading         = false;
+
+	// Parent-relative transforms of the gun turret (node 3) and barrel (node 4), which are turned a little every update. Kept
+	// in TRS form so the turns don't build up errors in the matrices, which the WeaponSystem rebuilds when gunsTurned is set
+	TRS  gunTurret;
+	TRS  gunBarrel;
+	bool gunsTurned = false;
+};
+
+struct BoatNavigation
+{
+	float speed       = 0; // Current speed in the facing direction
+	float doubleSpeed = 0; // Speed while evading
+	bool  moving      = false; // Whether the NavigationSystem moves the boat at the end of this update
+};
+
+struct BoatShield
+{
+	EntityID entity = NO_ID; // The shield entity, NO_ID without a shield
+	float    timer  = 0;
+};
+
+// What the labels above boats and checks of which side a boat is on need
+struct BoatLabel
+{
+	Team team;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Component store
+-----------------------------------------------------------------------------------------*/
+
+class BoatComponents
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add the components of the boat with the given ID, called from the Boat constructor
+	void Add(EntityID id, Boat* boat, const BoatHealth& health, const BoatWeapon& weapon, const BoatNavigation& navigation,
+	         const BoatShield& shield, const BoatLabel& label);
+
+	// Remove a boat's components, does nothing if it has none. The EntityManager does this when the boat is destroyed
+	void Remove(EntityID boat);
+
+	// Position of a boat's components in the arrays, NO_BOAT if it has none (including an ID of a boat that has gone, whose
+	// slot has been reused). Changes when other boats are removed
+	static constexpr uint32_t NO_BOAT = UINT32_MAX;
+	uint32_t IndexOf(EntityID boat) const
+	{
+		uint32_t index = EntityIndex(boat);
+		if (index >= mBoatIndex.size())  return NO_BOAT;
+		uint32_t position = mBoatIndex[index];
+		return (position != NO_BOAT && mIds[position] == boat) ? position : NO_BOAT;
+	}
+
+	// A boat's components. The boat must have been added
+	BoatHealth&     Health    (EntityID boat)  { return mHealth    [IndexOf(boat)]; }
+	BoatWeapon&     Weapon    (EntityID boat)  { return mWeapons   [IndexOf(boat)]; }
+	BoatNavigation& Navigation(EntityID boat)  { return mNavigation[IndexOf(boat)]; }
+	BoatShield&     Shield    (EntityID boat)  { return mShields   [IndexOf(boat)]; }
+	BoatLabel&      Label     (EntityID boat)  { return mLabels    [IndexOf(boat)]; }
+
+	// The whole arrays for the systems, all the same size with a boat's components at the same position in each
+	size_t Count()  { return mBoats.size(); }
+	std::vector<EntityID>&       Ids()              { return mIds; }
+	std::vector<Boat*>&          Boats()            { return mBoats; }
+	std::vector<BoatHealth>&     HealthArray()      { return mHealth; }
+	std::vector<BoatWeapon>&     WeaponArray()      { return mWeapons; }
+	std::vector<BoatNavigation>& NavigationArray()  { return mNavigation; }
+	std::vector<BoatShield>&     ShieldArray()      { return mShields; }
+	std::vector<BoatLabel>&      LabelArray()       { return mLabels; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	std::vector<EntityID>       mIds;
+	std::vector<Boat*>          mBoats;
+	std::vector<BoatHealth>     mHealth;
+	std::vector<BoatWeapon>     mWeapons;
+	std::vector<BoatNavigation> mNavigation;
+	std::vector<BoatShield>     mShields;
+	std::vector<BoatLabel>      mLabels;
+
+	// Position of each boat's components in the arrays above, indexed by the boat's slot index (see EntityTypes.h)
+	std::vector<uint32_t> mBoatIndex;
+};
+
+
+#endif //_BOAT_COMPONENTS_H_INCLUDED_
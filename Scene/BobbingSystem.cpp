@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// Bobbing system - moves floating props such as mines and crates up and down on the water
+//--------------------------------------------------------------------------------------
+
+#include "BobbingSystem.h"
+#include "MathHelpers.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Give an entity a bobbing motion, replacing any it already has
+void BobbingSystem::Add(Entity* owner, const BobbingMotion& motion)
+{
+	uint32_t index = EntityIndex(owner->GetID());
+	if (index >= mMotionIndex.size())  mMotionIndex.resize(index + 1, NO_MOTION);
+
+	uint32_t position = mMotionIndex[index];
+	if (position == NO_MOTION)
+	{
+		position = static_cast<uint32_t>(mOwners.size());
+		mMotionIndex[index] = position;
+		mOwners.push_back(owner);
+		mBaseY.push_back(0);
+		mAmplitude.push_back(0);
+		mRate.push_back(0);
+		mPhase.push_back(0);
+		mTime.push_back(0);
+	}
+	mBaseY    [position] = motion.baseY;
+	mAmplitude[position] = motion.amplitude;
+	mRate     [position] = motion.rate;
+	mPhase    [position] = motion.phase;
+	mTime     [position] = -motion.delay;
+}
+
+
+// Remove an entity's bobbing motion, does nothing if it doesn't have one
+void BobbingSystem::Remove(Entity* owner)
+{
+	uint32_t index = EntityIndex(owner->GetID());
+	if (index >= mMotionIndex.size() || mMotionIndex[index] == NO_MOTION)  return;
+
+	// Move the last motion into the gap
+	uint32_t position = mMotionIndex[index];
+	uint32_t last = static_cast<uint32_t>(mOwners.size() - 1);
+	if (position != last)
+	{
+		mOwners   [position] = mOwners   [last];
+		mBaseY    [position] = mBaseY    [last];
+		mAmplitude[position] = mAmplitude[last];
+		mRate     [position] = mRate     [last];
+		mPhase    [position] = mPhase    [last];
+		mTime     [position] = mTime     [last];
+		mMotionIndex[EntityIndex(mOwners[position]->GetID())] = position;
+	}
+	mOwners.pop_back();
+	mBaseY.pop_back();
+	mAmplitude.pop_back();
+	mRate.pop_back();
+	mPhase.pop_back();
+	mTime.pop_back();
+	mMotionIndex[index] = NO_MOTION;
+}
+
+
+// Move every owner to its height at this time
+void BobbingSystem::Update(float frameTime)
+{
+	size_t count = mOwners.size();
+	if (count == 0)  return;
+	mSines.resize(count);
+
+	// Advance the times and find the angles, simple loops over packed arrays that the compiler vectorises, then all the sines
+	// in one batch
+	float* times = mTime.data();
+	float* sines = mSines.data();
+	for (size_t i = 0; i < count; ++i)  times[i] += frameTime;
+	for (size_t i = 0; i < count; ++i)  sines[i] = times[i] * mRate[i] + mPhase[i];
+	FastSin(sines, sines, count);
+
+	// Matrices are spread through the transform store so are written one at a time
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (times[i] < 0)  continue;
+		mOwners[i]->Transform().Position().y = mBaseY[i] + mAmplitude[i] * sines[i];
+	}
+}
@@ -0,0 +1,75 @@
+//--------------------------------------------------------------------------------------
+// Bobbing system - moves floating props such as mines and crates up and down on the water
+//--------------------------------------------------------------------------------------
+// Rather than each floating entity calling sin in its own Update, an entity can register a bobbing motion and the
+// EntityManager moves all of them together once per UpdateAll, after every entity has been updated. The heights are worked
+// out in one pass over tightly packed arrays with the batched FastSin (see MathHelpers.h), four props at a time. The
+// entity's matrix then has its position y set, so the entity's Update should leave the height alone while bobbing and can
+// keep any other animation (e.g. spinning) of its own.
+//
+// The motion can start after a delay, so an entity can do something else with its height first (e.g. rise out of the water).
+// Motions are added by the owning entity, usually in its constructor, and are removed automatically when it is destroyed:
+//     BobbingMotion bobbing;
+//     bobbing.baseY     = mBaseY;
+//     bobbing.amplitude = 0.7f;
+//     bobbing.delay     = mRiseDuration;
+//     gEntityManager->Bobbing().Add(this, bobbing);
+
+#ifndef _BOBBING_SYSTEM_H_INCLUDED_
+#define _BOBBING_SYSTEM_H_INCLUDED_
+
+#include "Entity.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// Settings for a bobbing motion: the height is baseY + amplitude * sin(rate * t + phase), t being the time since the delay
+struct BobbingMotion
+{
+	float baseY     = 0.0f;
+	float amplitude = 1.0f;
+	float rate      = 1.0f; // Radians per second
+	float phase     = 0.0f; // Radians
+	float delay     = 0.0f; // Seconds before the motion starts, the owner's height is not touched until then
+};
+
+
+class BobbingSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Give an entity a bobbing motion, replacing any it already has
+	void Add(Entity* owner, const BobbingMotion& motion);
+
+	// Remove an entity's bobbing motion, does nothing if it doesn't have one. The EntityManager does this when the owner is destroyed
+	void Remove(Entity* owner);
+
+	// Move every owner to its height at this time. Called by the EntityManager once all entities have been updated
+	void Update(float frameTime);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Structure of arrays, one element per motion, so the update reads only what it needs in order
+	std::vector<Entity*> mOwners;
+	std::vector<float>   mBaseY;
+	std::vector<float>   mAmplitude;
+	std::vector<float>   mRate;
+	std::vector<float>   mPhase;
+	std::vector<float>   mTime; // Negative during the delay
+
+	// Position of each owner's motion in the arrays above, indexed by the owner's slot index (see EntityTypes.h)
+	static constexpr uint32_t NO_MOTION = UINT32_MAX;
+	std::vector<uint32_t> mMotionIndex;
+
+	// Working array for Update, kept to avoid reallocating it every frame
+	std::vector<float> mSines;
+};
+
+
+#endif //_BOBBING_SYSTEM_H_INCLUDED_
@@ -6,6 +6,7 @@
 #include "Camera.h"
 
 #include <cmath>
+#include <cstring>
 
 // Control the camera's position and rotation using keys provided
 void Camera::Control(float frameTime, KeyCode turnUp,      KeyCode turnDown,     KeyCode turnLeft, KeyCode turnRight,
@@ -74,9 +75,13 @@ void Camera::Control(float frameTime, KeyCode turnUp,      KeyCode turnDown,
 }
 
 
-// Update the matrices used for the camera in the rendering pipeline
+// Update the matrices used for the camera in the rendering pipeline if the camera has changed since they were last updated
 void Camera::UpdateMatrices()
 {
+    if (mMatricesValid && std::memcmp(&mTransform, &mMatricesTransform, sizeof(Matrix4x4)) == 0)  return;
+    mMatricesValid = true;
+    mMatricesTransform = mTransform;
+
     // View matrix is the usual matrix used for the camera in shaders, it is the inverse of the world matrix (see lectures)
     mViewMatrix = InverseAffine(mTransform);
 
@@ -94,6 +99,8 @@ void Camera::UpdateMatrices()
 
     // The view-projection matrix combines the two matrices above into one, which can save a multiply in the shaders (optional)
     mViewProjectionMatrix = mViewMatrix * mProjectionMatrix;
+    mInverseViewProjection = Inverse(mViewProjectionMatrix);
+    mFrustum = Frustum(mViewProjectionMatrix);
 }
 
 
@@ -132,6 +139,13 @@ Vector3 Camera::PixelFromWorldPt(Vector3 worldPoint, float viewportWidth, float
 	return { x, y, cameraPt.z };
 }
 
+// As above for a whole set of world points in one pass. The view-projection matrix is used directly, its w is the camera space Z
+void Camera::PixelsFromWorldPts(const PointsSoA& worldPoints, float viewportWidth, float viewportHeight, PointsSoA& outPixels)
+{
+	UpdateMatrices();
+	ProjectToPixels(mViewProjectionMatrix, mNearClip, viewportWidth, viewportHeight, worldPoints, outPixels);
+}
+
 
 // Return the size of a pixel in world space at the given Z distance. Allows us to convert the 2D size of areas on the screen to actualy sizes in the world
 // Pass the viewport width and height
@@ -162,7 +176,7 @@ void Camera::GetPickRay(int pixelX, int pixelY, float viewportWidth, float viewp
 	float ndcY = 1.0f - ((2.0f * pixelY) / static_cast<float>(viewportHeight));
 
 	// Transform these two points by the inverse of the ViewProjection matrix
-	Matrix4x4 invViewProj = Inverse(mViewProjectionMatrix);
+	const Matrix4x4& invViewProj = mInverseViewProjection;
 
 	// Create two points in clip space: one at the near plane (z=0 in [0..1]) and one at the far plane (z=1).
 	Vector4 nearClip = { ndcX, ndcY, -1.0f, 1.0f };
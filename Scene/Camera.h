@@ -12,6 +12,8 @@
 #include "Vector2.h"
 #include "Vector3.h"
 #include "Matrix4x4.h"
+#include "Frustum.h"
+#include "TransformBatch.h"
 #include "Input.h"
 #include <numbers>
 
@@ -52,15 +54,20 @@ public:
 	float GetNearClip()    { return mNearClip;    }
 	float GetFarClip()     { return mFarClip;     }
 
-	void SetAspectRatio (float aspectRatio)  { mAspectRatio = aspectRatio;}
-	void SetFOV         (float fov        )  { mFOVx        = fov;        }
-	void SetNearClip    (float nearClip   )  { mNearClip    = nearClip;   }
-	void SetFarClip     (float farClip    )  { mFarClip     = farClip;    }
+	void SetAspectRatio (float aspectRatio)  { mAspectRatio = aspectRatio;  mMatricesValid = false; }
+	void SetFOV         (float fov        )  { mFOVx        = fov;          mMatricesValid = false; }
+	void SetNearClip    (float nearClip   )  { mNearClip    = nearClip;     mMatricesValid = false; }
+	void SetFarClip     (float farClip    )  { mFarClip     = farClip;      mMatricesValid = false; }
 
-	// Camera matrices used for rendering. These getters use "lazy evaluation" - they only update the member variables when they are requested
-	Matrix4x4 GetViewMatrix()            { UpdateMatrices(); return mViewMatrix;           }
-	Matrix4x4 GetProjectionMatrix()      { UpdateMatrices(); return mProjectionMatrix;     }
-	Matrix4x4 GetViewProjectionMatrix()  { UpdateMatrices(); return mViewProjectionMatrix; }
+	// Camera matrices used for rendering. These getters use "lazy evaluation" - the matrices are only recalculated when they
+	// are requested and the camera has changed since they were last calculated, so they can be asked for any number of times
+	const Matrix4x4& GetViewMatrix()            { UpdateMatrices(); return mViewMatrix;           }
+	const Matrix4x4& GetProjectionMatrix()      { UpdateMatrices(); return mProjectionMatrix;     }
+	const Matrix4x4& GetViewProjectionMatrix()  { UpdateMatrices(); return mViewProjectionMatrix; }
+
+	// The volume visible from the camera, used to skip rendering entities that are off screen (see Frustum.h). Kept with the
+	// matrices above
+	const Frustum& GetFrustum()  { UpdateMatrices(); return mFrustum; }
 
 
 	/*-----------------------------------------------------------------------------------------
@@ -75,6 +82,10 @@ public:
 	// point is behind the camera and the 2D x and y coordinates are to be ignored.
 	Vector3 PixelFromWorldPt(Vector3 worldPoint, float viewportWidth, float viewportHeight);
 
+	// As above for a whole set of world points in one pass (see ProjectToPixels), e.g. all the text labels in a frame. Pixel
+	// coordinates go in outPixels.x and outPixels.y and the Z distances in outPixels.z, each is to be ignored if less than the near clip
+	void PixelsFromWorldPts(const PointsSoA& worldPoints, float viewportWidth, float viewportHeight, PointsSoA& outPixels);
+
 	void GetPickRay(int pixelX, int pixelY, float viewportWidth, float viewportHeight, Vector3& outRayStart, Vector3& outRayDir);
 
 	bool WorldPtFromPixel(int pixelX, int pixelY, float viewportWidth, float viewportHeight, Vector3& outWorldPos);
@@ -88,7 +99,7 @@ public:
 	   Private data
 	-----------------------------------------------------------------------------------------*/
 private:
-	// Update the matrices used for the camera in the rendering pipeline
+	// Update the matrices used for the camera in the rendering pipeline if the camera has changed since they were last updated
 	void UpdateMatrices();
 
 	// Camera settings: field of view, aspect ratio, near and far clip plane distances.
@@ -104,6 +115,13 @@ private:
 	Matrix4x4 mProjectionMatrix;     // Projection matrix holds the field of view and near/far clip distances
 	Matrix4x4 mViewProjectionMatrix; // Combine (multiply) the view and projection matrices together, which
 	                                 // can sometimes save a matrix multiply in the shader (optional)
+	Matrix4x4 mInverseViewProjection; // For picking, turning pixels back into world space
+	Frustum   mFrustum = Frustum(Matrix4x4::Identity);
+
+	// The matrices above are up to date if this is set and the transform is still the one they were made from. Transform
+	// returns a reference that can be written at any time, so changes to it are found by comparing with this copy
+	bool      mMatricesValid = false;
+	Matrix4x4 mMatricesTransform;
 };
 
 
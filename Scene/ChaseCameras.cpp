@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// Chase cameras - a camera behind and above each boat that is being watched, found by the boat's ID
+//--------------------------------------------------------------------------------------
+
+#include "ChaseCameras.h"
+
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// The aspect ratio of every chase camera, those already created and those created later
+void ChaseCameras::SetAspectRatio(float aspectRatio)
+{
+	mAspectRatio = aspectRatio;
+	for (auto& camera : mCameras)  camera->SetAspectRatio(aspectRatio);
+}
+
+
+// Move the camera of the given boat towards its place behind it, creating the camera if the boat doesn't have one
+Camera& ChaseCameras::Follow(EntityID boat, const Vector3& position, const Vector3& facing, float frameTime)
+{
+	auto [chase, isNew] = mChases.try_emplace(boat);
+	if (isNew)
+	{
+		if (mFreeCameras.empty())
+		{
+			mFreeCameras.push_back(static_cast<uint32_t>(mCameras.size()));
+			mCameras.push_back(std::make_unique<Camera>(Vector3{ 0, 0, 0 }, Vector3{ 0, 0, 0 }, FOV, mAspectRatio, NEAR_CLIP, FAR_CLIP));
+		}
+		chase->second.camera = mFreeCameras.back();
+		mFreeCameras.pop_back();
+	}
+	Camera& camera = *mCameras[chase->second.camera];
+
+	// A camera that has been left behind (or is new to this boat) jumps to its place, otherwise it is smoothed towards it.
+	// It looks the way the boat faces with a fixed downward pitch
+	bool jump = isNew || chase->second.lastFollowed + 1 != mFrame;
+	chase->second.lastFollowed = mFrame;
+	Vector3 desiredPos = position - facing * DISTANCE + HEIGHT;
+	Matrix4x4& transform = camera.Transform();
+	transform.Position() = jump ? desiredPos : Lerp(transform.Position(), desiredPos, SMOOTH_SPEED * frameTime);
+	transform.SetRotation({ PITCH, std::atan2(facing.x, facing.z), 0 });
+	return camera;
+}
+
+
+// Give back the camera of the given boat to be reused, if it has one
+void ChaseCameras::Release(EntityID boat)
+{
+	auto chase = mChases.find(boat);
+	if (chase == mChases.end())  return;
+	mFreeCameras.push_back(chase->second.camera);
+	mChases.erase(chase);
+}
+
+
+// Give back every camera
+void ChaseCameras::Clear()
+{
+	ReleaseIf([](EntityID) { return true; });
+}
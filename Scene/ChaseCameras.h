@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------
+// Chase cameras - a camera behind and above each boat that is being watched, found by the boat's ID
+//--------------------------------------------------------------------------------------
+// A boat only has a chase camera once something asks to follow it, and the camera is looked up by the boat's entity ID in a
+// hash map, so finding the camera for a boat doesn't depend on the number of boats or on their order. Cameras are kept in
+// a pool, the camera of a boat that has gone is given back with Release / ReleaseIf and reused for the next boat followed.
+//
+// Only the cameras being viewed follow their boats each frame. A camera that wasn't followed last frame has fallen behind, so
+// the next Follow places it behind its boat straight away rather than smoothing it in from wherever it was left
+//
+//   chaseCameras.NextFrame();
+//   Camera& camera = chaseCameras.Follow(boatID, boatPosition, boatFacing, frameTime);  // Only for the camera(s) being viewed
+
+#ifndef _CHASE_CAMERAS_H_INCLUDED_
+#define _CHASE_CAMERAS_H_INCLUDED_
+
+#include "Camera.h"
+#include "EntityTypes.h"
+#include "Vector3.h"
+#include "MathHelpers.h"
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class ChaseCameras
+{
+	/*-----------------------------------------------------------------------------------------
+	   Types / constants
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Placement behind and above the boat, and the camera settings
+	static constexpr float   DISTANCE  = 40.0f;
+	static constexpr Vector3 HEIGHT    = { 0, 20.0f, 0 };
+	static constexpr float   PITCH     = ToRadians(15.0f);
+	static constexpr float   FOV       = ToRadians(60.0f); // Slightly narrower than the main camera
+	static constexpr float   NEAR_CLIP = 0.1f;
+	static constexpr float   FAR_CLIP  = 10000.0f;
+
+	// How quickly a followed camera closes on its place behind the boat, fraction of the distance per second
+	static constexpr float SMOOTH_SPEED = 5.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The aspect ratio of every chase camera, those already created and those created later
+	void SetAspectRatio(float aspectRatio);
+
+	// Start a new frame, cameras not followed in the last frame are placed straight behind their boat when next followed
+	void NextFrame()  { ++mFrame; }
+
+	// Move the camera of the given boat towards its place behind it, creating the camera if the boat doesn't have one. The
+	// position and facing (Z axis of the world matrix) are the boat's as drawn this frame
+	Camera& Follow(EntityID boat, const Vector3& position, const Vector3& facing, float frameTime);
+
+	// The camera of the given boat, nullptr if it has none
+	Camera* Find(EntityID boat)
+	{
+		auto chase = mChases.find(boat);
+		return chase != mChases.end() ? mCameras[chase->second.camera].get() : nullptr;
+	}
+
+	// Give back the camera of the given boat to be reused, if it has one
+	void Release(EntityID boat);
+
+	// Give back the cameras of all the boats for which the given function returns true: function(EntityID) -> bool
+	template <typename Function>
+	void ReleaseIf(Function function)
+	{
+		for (auto chase = mChases.begin(); chase != mChases.end(); )
+		{
+			if (function(chase->first))
+			{
+				mFreeCameras.push_back(chase->second.camera);
+				chase = mChases.erase(chase);
+			}
+			else  ++chase;
+		}
+	}
+
+	// Give back every camera
+	void Clear();
+
+	// Boats with a camera, and cameras created in all (in use or waiting to be reused)
+	size_t NumInUse()    { return mChases.size(); }
+	size_t NumCameras()  { return mCameras.size(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct Chase
+	{
+		uint32_t camera;       // Index in mCameras
+		uint32_t lastFollowed; // Frame number of the last Follow
+	};
+
+	std::vector<std::unique_ptr<Camera>> mCameras; // Pointers to cameras stay valid while they are reused
+	std::vector<uint32_t>                mFreeCameras;
+	std::unordered_map<EntityID, Chase>  mChases;
+
+	float    mAspectRatio = 16.0f / 9.0f;
+	uint32_t mFrame       = 0;
+};
+
+
+#endif //_CHASE_CAMERAS_H_INCLUDED_
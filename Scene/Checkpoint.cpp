@@ -0,0 +1,384 @@
+//--------------------------------------------------------------------------------------
+// Checkpoint - a copy of the whole simulation that can be written to a file and restored
+//--------------------------------------------------------------------------------------
+
+#include "Checkpoint.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+
+
+// Start of every checkpoint file, followed by the version. Change the version if the layout changes
+static const char     CHECKPOINT_MAGIC[4] = { 'C', 'K', 'P', 'T' };
+static const uint32_t CHECKPOINT_VERSION  = 3; // 2: shields save their transform relative to their boat, 3: boats don't save their text
+
+// Sizes of the records held as bytes, written after the version. A file from a build where any of them differ is rejected,
+// which catches the usual reason for the layout changing, a member added to one of the states
+static const uint32_t RECORD_SIZES[] =
+{
+	sizeof(Message), sizeof(Messenger::SavedDelayed), sizeof(Matrix4x4), sizeof(RandomStream), sizeof(Checkpoint::SceneState),
+	sizeof(Boat::SavedState), sizeof(Missile::SavedState), sizeof(RandomCrate::SavedState), sizeof(SeaMine::SavedState),
+	sizeof(Shield::SavedState),
+};
+
+// Largest array and string accepted when reading, so a damaged count can't cause a huge allocation
+static constexpr uint64_t MAX_ARRAY_BYTES  = 256 * 1024 * 1024;
+static constexpr uint32_t MAX_STRING_BYTES = 4096;
+
+
+/*-----------------------------------------------------------------------------------------
+   File helpers
+-----------------------------------------------------------------------------------------*/
+// Values are written as their bytes, arrays as their number of elements followed by the elements
+
+template <typename T>
+static bool WriteValue(std::FILE* file, const T& value)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Checkpoint values are written as bytes");
+	return std::fwrite(&value, sizeof(T), 1, file) == 1;
+}
+
+template <typename T>
+static bool ReadValue(std::FILE* file, T& value)
+{
+	return std::fread(&value, sizeof(T), 1, file) == 1;
+}
+
+template <typename T>
+static bool WriteArray(std::FILE* file, const std::vector<T>& array)
+{
+	static_assert(std::is_trivially_copyable_v<T>, "Checkpoint arrays are written as bytes");
+	uint64_t count = array.size();
+	return WriteValue(file, count) && (count == 0 || std::fwrite(array.data(), sizeof(T), array.size(), file) == array.size());
+}
+
+template <typename T>
+static bool ReadArray(std::FILE* file, std::vector<T>& array)
+{
+	uint64_t count;
+	if (!ReadValue(file, count) || count > MAX_ARRAY_BYTES / sizeof(T))  return false;
+	array.resize(static_cast<size_t>(count));
+	return count == 0 || std::fread(array.data(), sizeof(T), array.size(), file) == array.size();
+}
+
+static bool WriteStrings(std::FILE* file, const std::vector<std::string>& strings)
+{
+	if (!WriteValue(file, static_cast<uint64_t>(strings.size())))  return false;
+	for (const std::string& text : strings)
+	{
+		uint32_t length = static_cast<uint32_t>(text.size());
+		if (!WriteValue(file, length) || (length > 0 && std::fwrite(text.data(), 1, length, file) != length))  return false;
+	}
+	return true;
+}
+
+static bool ReadStrings(std::FILE* file, std::vector<std::string>& strings)
+{
+	uint64_t count;
+	if (!ReadValue(file, count) || count > MAX_ARRAY_BYTES / MAX_STRING_BYTES)  return false;
+	strings.resize(static_cast<size_t>(count));
+	for (std::string& text : strings)
+	{
+		uint32_t length;
+		if (!ReadValue(file, length) || length > MAX_STRING_BYTES)  return false;
+		text.resize(length);
+		if (length > 0 && std::fread(text.data(), 1, length, file) != length)  return false;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Copy the state of the game, replacing anything already held. Call on the main thread between updates
+void Checkpoint::Capture(EntityManager& entities, Messenger& messenger, const SceneState& scene)
+{
+	mEntities.clear();
+	mMatrices.clear();
+	mStrings.clear();
+	mBoats.clear();
+	mMissiles.clear();
+	mCrates.clear();
+	mMines.clear();
+	mShields.clear();
+
+	// Boats, crates and mines are saved in the order of their registries, so they are created again in that order and code
+	// going through View<T> visits them in the same order after a restore
+	for (Boat* boat : entities.View<Boat>())  SaveEntity(boat, Kind::Boat, mBoats);
+	for (RandomCrate* crate : entities.View<RandomCrate>())  SaveEntity(crate, Kind::RandomCrate, mCrates);
+	for (SeaMine* mine : entities.View<SeaMine>())  SaveEntity(mine, Kind::SeaMine, mMines);
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		if      (Missile* missile = TypeCast<Missile>(entity))  SaveEntity(missile, Kind::Missile, mMissiles);
+		else if (Shield*  shield  = TypeCast<Shield>(entity))   SaveEntity(shield, Kind::Shield, mShields);
+	}
+
+	mLevelEntities = LevelEntities(entities);
+	mSlots = entities.GetSlotTable();
+	messenger.SaveState(mMessages);
+	mRandom = ThreadRandom();
+	mScene = scene;
+}
+
+
+// Write the checkpoint to the given file. Only reads the checkpoint, so can be called on another thread
+bool Checkpoint::Write(const std::string& fileName) const
+{
+	std::FILE* file = std::fopen(fileName.c_str(), "wb");
+	if (file == nullptr)  return false;
+
+	bool written = std::fwrite(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC), 1, file) == 1 &&
+	               WriteValue(file, CHECKPOINT_VERSION) && WriteValue(file, RECORD_SIZES) &&
+	               WriteArray(file, mEntities) && WriteArray(file, mMatrices) && WriteStrings(file, mStrings) &&
+	               WriteArray(file, mBoats) && WriteArray(file, mMissiles) && WriteArray(file, mCrates) &&
+	               WriteArray(file, mMines) && WriteArray(file, mShields) &&
+	               WriteArray(file, mLevelEntities) && WriteArray(file, mSlots.generations) && WriteArray(file, mSlots.freeSlots) &&
+	               WriteArray(file, mMessages.messages) && WriteArray(file, mMessages.sentFrames) &&
+	               WriteArray(file, mMessages.addresses) && WriteArray(file, mMessages.arena) &&
+	               WriteArray(file, mMessages.delayed) && WriteArray(file, mMessages.delayedPayloads) &&
+	               WriteValue(file, mMessages.frame) && WriteValue(file, mMessages.unusedTime) &&
+	               WriteValue(file, mRandom) && WriteValue(file, mScene);
+
+	if (std::fclose(file) != 0)  written = false;
+	return written;
+}
+
+
+// Read a checkpoint from the given file, replacing anything already held. Returns false with a description of the problem if
+// the file can't be read or was written by a different build
+bool Checkpoint::Read(const std::string& fileName, std::string& error)
+{
+	std::FILE* file = std::fopen(fileName.c_str(), "rb");
+	if (file == nullptr)
+	{
+		error = "Can't open " + fileName;
+		return false;
+	}
+
+	char     magic[sizeof(CHECKPOINT_MAGIC)];
+	uint32_t version;
+	uint32_t recordSizes[std::size(RECORD_SIZES)];
+	bool isCheckpoint = ReadValue(file, magic) && std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0 &&
+	                    ReadValue(file, version) && version == CHECKPOINT_VERSION;
+	if (!isCheckpoint || !ReadValue(file, recordSizes) || std::memcmp(recordSizes, RECORD_SIZES, sizeof(recordSizes)) != 0)
+	{
+		std::fclose(file);
+		error = isCheckpoint ? fileName + " was saved by a different build" : fileName + " is not a checkpoint";
+		return false;
+	}
+
+	bool read = ReadArray(file, mEntities) && ReadArray(file, mMatrices) && ReadStrings(file, mStrings) &&
+	            ReadArray(file, mBoats) && ReadArray(file, mMissiles) && ReadArray(file, mCrates) &&
+	            ReadArray(file, mMines) && ReadArray(file, mShields) &&
+	            ReadArray(file, mLevelEntities) && ReadArray(file, mSlots.generations) && ReadArray(file, mSlots.freeSlots) &&
+	            ReadArray(file, mMessages.messages) && ReadArray(file, mMessages.sentFrames) &&
+	            ReadArray(file, mMessages.addresses) && ReadArray(file, mMessages.arena) &&
+	            ReadArray(file, mMessages.delayed) && ReadArray(file, mMessages.delayedPayloads) &&
+	            ReadValue(file, mMessages.frame) && ReadValue(file, mMessages.unusedTime) &&
+	            ReadValue(file, mRandom) && ReadValue(file, mScene);
+	std::fclose(file);
+
+	if (!read || !IsValid())
+	{
+		error = fileName + " is damaged";
+		return false;
+	}
+	return true;
+}
+
+
+// Put the game back to the state held. Call on the main thread between updates
+bool Checkpoint::Restore(EntityManager& entities, Messenger& messenger, SceneState& scene, std::string& error)
+{
+	// Check everything needed first, so nothing is changed if the checkpoint can't be restored
+	if (LevelEntities(entities) != mLevelEntities)
+	{
+		error = "Checkpoint was saved in a different level";
+		return false;
+	}
+	for (const SavedEntity& saved : mEntities)
+	{
+		if (entities.GetTemplate(mStrings[saved.templateName]) == nullptr)
+		{
+			error = "Checkpoint uses a missing template: " + mStrings[saved.templateName];
+			return false;
+		}
+	}
+
+	// Replace the entities of the saved kinds. Outside UpdateAll they are destroyed straight away, freeing their slots. The
+	// slot table holds the level's entities in the same slots as now (checked in IsValid), so it always fits
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		if (IsSavedKind(entity))  entities.DestroyEntity(entity->GetID());
+	}
+	entities.RestoreSlotTable(mSlots);
+
+	for (const SavedEntity& saved : mEntities)
+	{
+		const Matrix4x4& root = mMatrices[saved.firstMatrix];
+		bool created = false;
+		switch (saved.kind)
+		{
+		case Kind::Boat:
+			created = RestoreEntity<Boat>(entities, saved, mBoats[saved.state], 0.0f, root, mStrings[saved.name]);
+			break;
+		case Kind::Missile:
+			created = RestoreEntity<Missile>(entities, saved, mMissiles[saved.state], root);
+			break;
+		case Kind::RandomCrate:
+			created = RestoreEntity<RandomCrate>(entities, saved, mCrates[saved.state], root, mCrates[saved.state].crateType);
+			break;
+		case Kind::SeaMine:
+			created = RestoreEntity<SeaMine>(entities, saved, mMines[saved.state], root);
+			break;
+		case Kind::Shield:
+			created = RestoreEntity<Shield>(entities, saved, mShields[saved.state], root, mShields[saved.state].parentBoatID);
+			break;
+		}
+		if (!created)
+		{
+			error = "Checkpoint entity could not be created: " + entities.GetLastError();
+			return false;
+		}
+	}
+
+	// Shields are attached to their boats once all the boats exist. Attachments are not saved, the shield holds all it needs
+	for (const SavedEntity& saved : mEntities)
+	{
+		if (saved.kind != Kind::Shield)  continue;
+		const Shield::SavedState& shield = mShields[saved.state];
+		if (!entities.Attach(saved.id, shield.parentBoatID, shield.local.ToMatrix()))  entities.DestroyEntity(saved.id);
+	}
+
+	// The messenger goes last, replacing the messages the entities' constructors sent (e.g. the shield's Die message)
+	entities.ResetAISystems();
+	messenger.RestoreState(mMessages);
+	ThreadRandom() = mRandom;
+	scene = mScene;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Save an entity of a kind with its state
+template <typename T>
+void Checkpoint::SaveEntity(T* entity, Kind kind, std::vector<typename T::SavedState>& states)
+{
+	SavedEntity saved;
+	saved.id           = entity->GetID();
+	saved.kind         = kind;
+	saved.templateName = AddString(entity->Template().GetType().str());
+	saved.name         = AddString(entity->GetName());
+	saved.firstMatrix  = static_cast<uint32_t>(mMatrices.size());
+	saved.numMatrices  = entity->NodeCount();
+	saved.state        = static_cast<uint32_t>(states.size());
+	for (unsigned int node = 0; node < saved.numMatrices; ++node)  mMatrices.push_back(entity->Transform(node));
+	states.push_back(entity->SaveState());
+	mEntities.push_back(saved);
+}
+
+
+// Create an entity saved, with its saved ID and matrices, then give it its state. Returns false if it can't be created
+template <typename T, typename ...ConstructorTypes>
+bool Checkpoint::RestoreEntity(EntityManager& entities, const SavedEntity& saved, const typename T::SavedState& state,
+                               ConstructorTypes&&... constructorValues)
+{
+	EntityID id = entities.CreateEntityWithID<T>(saved.id, mStrings[saved.templateName], std::forward<ConstructorTypes>(constructorValues)...);
+	if (id == NO_ID)  return false;
+
+	// The template's mesh may have changed since the checkpoint was saved, only the nodes both have are set
+	T* entity = entities.GetEntity<T>(id);
+	unsigned int numNodes = std::min(entity->NodeCount(), saved.numMatrices);
+	for (unsigned int node = 0; node < numNodes; ++node)  entity->Transform(node) = mMatrices[saved.firstMatrix + node];
+	entities.Transforms().ResetPreviousRoot(EntityIndex(id));
+	entity->RestoreState(state);
+	return true;
+}
+
+
+// Index of the given string in mStrings, added if it isn't there. Template names repeat but there are few in all, so a
+// search is fine
+uint32_t Checkpoint::AddString(const std::string& text)
+{
+	auto found = std::find(mStrings.begin(), mStrings.end(), text);
+	if (found != mStrings.end())  return static_cast<uint32_t>(found - mStrings.begin());
+	mStrings.push_back(text);
+	return static_cast<uint32_t>(mStrings.size() - 1);
+}
+
+
+// Whether an entity is one of the kinds saved, rather than part of the level
+bool Checkpoint::IsSavedKind(Entity* entity)
+{
+	constexpr TypeMask SAVED_KINDS = Boat::TYPE_BIT | Missile::TYPE_BIT | RandomCrate::TYPE_BIT | SeaMine::TYPE_BIT | Shield::TYPE_BIT;
+	return (entity->GetTypeMask() & SAVED_KINDS) != 0;
+}
+
+
+// Sorted IDs of the level's entities, those not of a saved kind
+std::vector<EntityID> Checkpoint::LevelEntities(EntityManager& entities)
+{
+	std::vector<EntityID> ids;
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		if (!IsSavedKind(entity))  ids.push_back(entity->GetID());
+	}
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+
+// Check the indexes in the entity records and messages are all within the arrays read, and that every entity has a slot of
+// its own that the slot table doesn't list as free
+bool Checkpoint::IsValid() const
+{
+	constexpr uint8_t SLOT_FREE = 1, SLOT_USED = 2;
+	size_t numSlots = mSlots.generations.size();
+	std::vector<uint8_t> slots(numSlots, 0);
+	for (uint32_t index : mSlots.freeSlots)
+	{
+		if (index < FIRST_ENTITY_ID || index >= numSlots)  return false;
+		slots[index] = SLOT_FREE;
+	}
+	auto takeSlot = [&](EntityID id)
+	{
+		uint32_t index = EntityIndex(id);
+		if (index < FIRST_ENTITY_ID || index >= numSlots || slots[index] != 0)  return false;
+		slots[index] = SLOT_USED;
+		return true;
+	};
+	for (EntityID id : mLevelEntities)
+	{
+		if (!takeSlot(id))  return false;
+	}
+
+	const size_t numStates[] = { mBoats.size(), mMissiles.size(), mCrates.size(), mMines.size(), mShields.size() };
+	for (const SavedEntity& saved : mEntities)
+	{
+		uint32_t kind = static_cast<uint32_t>(saved.kind);
+		if (!takeSlot(saved.id) || kind >= std::size(numStates) || saved.state >= numStates[kind] ||
+		    saved.templateName >= mStrings.size() || saved.name >= mStrings.size() || saved.numMatrices == 0 ||
+		    saved.firstMatrix > mMatrices.size() || saved.numMatrices > mMatrices.size() - saved.firstMatrix)  return false;
+	}
+
+	if (mMessages.sentFrames.size() != mMessages.messages.size())  return false;
+	for (const auto& address : mMessages.addresses)
+	{
+		if (address.message >= mMessages.messages.size())  return false;
+	}
+	for (const auto& delayed : mMessages.delayed)
+	{
+		if (delayed.payloadOffset > mMessages.delayedPayloads.size() ||
+		    delayed.payloadSize > mMessages.delayedPayloads.size() - delayed.payloadOffset)  return false;
+	}
+	return true;
+}
@@ -0,0 +1,145 @@
+//--------------------------------------------------------------------------------------
+// Checkpoint - a copy of the whole simulation that can be written to a file and restored
+//--------------------------------------------------------------------------------------
+// A checkpoint holds everything that changes as the game runs: the boats, missiles, crates, mines and shields with their
+// matrices and the state of each (see the SavedState of each class), the entity slot table so IDs stay the same, the messages
+// waiting in the messenger including delayed ones (see Messenger::SaveState), the main thread's random numbers and the
+// scene's spawn timers. All other entities (obstacles, reload stations, scenery) are part of the level and aren't saved, only
+// their IDs, and a checkpoint can only be restored into the level it was saved from.
+//
+// Everything is held as arrays of plain data. Capture copies them from the game between updates, which is quick as nothing
+// is converted, and Write only reads the copy so it can run on a background thread while the game carries on:
+//     auto checkpoint = std::make_unique<Checkpoint>();
+//     checkpoint->Capture(*gEntityManager, *gMessenger, sceneState);
+//     auto saved = std::async(std::launch::async, [c = std::move(checkpoint)]() { return c->Write("Checkpoint.bin"); });
+// Read loads each array in a single read, and Restore recreates the entities with their saved IDs and copies their states
+// back. The file holds the arrays as they are in memory, so it can only be read by the same build of the game that wrote it.
+//
+// What the AI systems have worked out from earlier updates (what each boat can see, each team's knowledge of its enemies, the
+// utility AI's decisions) is not saved. It is forgotten on restore and rebuilt over the next few updates, so a restored game
+// can take slightly different decisions in its first second than the saved game went on to take
+
+#ifndef _CHECKPOINT_H_INCLUDED_
+#define _CHECKPOINT_H_INCLUDED_
+
+#include "EntityManager.h"
+#include "Messenger.h"
+#include "Boat.h"
+#include "Missile.h"
+#include "RandomCrate.h"
+#include "SeaMine.h"
+#include "Shield.h"
+#include "Matrix4x4.h"
+#include "Random.h"
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+
+class Checkpoint
+{
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Values kept by the scene that change as the game runs
+	struct SceneState
+	{
+		float randomCrateTimer;
+		float randomMineTimer;
+		float stepAccumulator;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Copy the state of the game, replacing anything already held. Call on the main thread between updates
+	void Capture(EntityManager& entities, Messenger& messenger, const SceneState& scene);
+
+	// Write the checkpoint to the given file, replacing any existing one. Only reads the checkpoint, so can be called on
+	// another thread. Returns false if the file can't be written
+	bool Write(const std::string& fileName) const;
+
+	// Read a checkpoint from the given file, replacing anything already held. Returns false with a description of the
+	// problem if the file can't be read or was written by a different build
+	bool Read(const std::string& fileName, std::string& error);
+
+	// Put the game back to the state held. Call on the main thread between updates. The level's entities must be the ones
+	// the checkpoint was saved with and the templates must all exist, otherwise nothing is changed and false is returned with
+	// the error. The saved kinds of entity that exist now are destroyed, so any pointers held to them are no longer valid. If
+	// a saved entity fails to be created the error is returned and the game is left without the entities not yet created
+	bool Restore(EntityManager& entities, Messenger& messenger, SceneState& scene, std::string& error);
+
+	// Number of entities saved, for display
+	size_t EntityCount() const  { return mEntities.size(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Kinds of entity saved, the state of each is in the array for its kind
+	enum class Kind : uint32_t
+	{
+		Boat,
+		Missile,
+		RandomCrate,
+		SeaMine,
+		Shield,
+	};
+
+	// An entity saved, its matrices are mMatrices[firstMatrix] onwards (root first) and its state is in the array for its kind
+	struct SavedEntity
+	{
+		EntityID id;
+		Kind     kind;
+		uint32_t templateName; // Index in mStrings
+		uint32_t name;         // Index in mStrings
+		uint32_t firstMatrix;
+		uint32_t numMatrices;
+		uint32_t state;
+	};
+
+	// Save an entity of a kind with its state
+	template <typename T>
+	void SaveEntity(T* entity, Kind kind, std::vector<typename T::SavedState>& states);
+
+	// Create an entity saved, with its saved ID and matrices, then give it its state. Returns false if it can't be created
+	template <typename T, typename ...ConstructorTypes>
+	bool RestoreEntity(EntityManager& entities, const SavedEntity& saved, const typename T::SavedState& state,
+	                   ConstructorTypes&&... constructorValues);
+
+	// Index of the given string in mStrings, added if it isn't there
+	uint32_t AddString(const std::string& text);
+
+	// Whether an entity is one of the kinds saved, rather than part of the level
+	static bool IsSavedKind(Entity* entity);
+
+	// Sorted IDs of the level's entities, those not of a saved kind
+	static std::vector<EntityID> LevelEntities(EntityManager& entities);
+
+	// Check the indexes in the entity records and messages are all within the arrays read, for Read
+	bool IsValid() const;
+
+	std::vector<SavedEntity> mEntities;
+	std::vector<Matrix4x4>   mMatrices;
+	std::vector<std::string> mStrings;
+
+	std::vector<Boat::SavedState>        mBoats;
+	std::vector<Missile::SavedState>     mMissiles;
+	std::vector<RandomCrate::SavedState> mCrates;
+	std::vector<SeaMine::SavedState>     mMines;
+	std::vector<Shield::SavedState>      mShields;
+
+	std::vector<EntityID>    mLevelEntities;
+	EntityManager::SlotTable mSlots;
+	Messenger::SavedState    mMessages;
+	RandomStream             mRandom;
+	SceneState               mScene = {};
+};
+
+
+#endif //_CHECKPOINT_H_INCLUDED_
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// Crate reservations - which boat is going for each crate, so others look for a different one
+//--------------------------------------------------------------------------------------
+
+#include "CrateReservations.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Reserve a crate for a boat that expects to reach it in the given number of seconds. Returns false if another boat has
+// reserved the crate
+bool CrateReservations::Reserve(EntityID crate, EntityID boat, float travelTime)
+{
+	Reservation* reservation = Find(crate);
+	if (reservation != nullptr && reservation->boat != boat)  return false;
+
+	uint32_t index = EntityIndex(crate);
+	if (index >= mReservations.size())  mReservations.resize(index + 1);
+	mReservations[index] = { crate, boat, mTime + travelTime * TRAVEL_FACTOR + EXTRA_TIME };
+	return true;
+}
+
+
+// Let go of a crate the boat has reserved
+void CrateReservations::Release(EntityID crate, EntityID boat)
+{
+	Reservation* reservation = Find(crate);
+	if (reservation != nullptr && reservation->boat == boat)  *reservation = {};
+}
+
+
+// Whether a boat other than the given one holds an unexpired reservation for the crate
+bool CrateReservations::IsReservedByOther(EntityID crate, EntityID boat)
+{
+	Reservation* reservation = Find(crate);
+	return reservation != nullptr && reservation->boat != boat;
+}
+
+
+// Whether the boat holds an unexpired reservation for the crate
+bool CrateReservations::IsReservedBy(EntityID crate, EntityID boat)
+{
+	Reservation* reservation = Find(crate);
+	return reservation != nullptr && reservation->boat == boat;
+}
+
+
+// Forget the reservation of a crate that is being destroyed
+void CrateReservations::Remove(EntityID entity)
+{
+	Reservation* reservation = Find(entity);
+	if (reservation != nullptr)  *reservation = {};
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// The reservation in the crate's slot, if it is for the given crate and hasn't expired
+CrateReservations::Reservation* CrateReservations::Find(EntityID crate)
+{
+	if (crate == NO_ID)  return nullptr;
+	uint32_t index = EntityIndex(crate);
+	if (index >= mReservations.size())  return nullptr;
+
+	Reservation& reservation = mReservations[index];
+	if (reservation.crate != crate || reservation.boat == NO_ID || reservation.expires <= mTime)  return nullptr;
+	return &reservation;
+}
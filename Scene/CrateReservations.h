@@ -0,0 +1,82 @@
+//--------------------------------------------------------------------------------------
+// Crate reservations - which boat is going for each crate, so others look for a different one
+//--------------------------------------------------------------------------------------
+// A boat heading for a crate reserves it, and other boats looking for a crate pass over the reserved ones, so a group of
+// boats spreads out over the crates rather than all chasing the nearest one while only the first gets it:
+//   RandomCrate* crate = FindNearestCrate(75.0f); // Only finds crates not reserved by other boats
+//   if (crate && gEntityManager->Reservations().Reserve(crate->GetID(), GetID(), travelTime))  ...
+//
+// A reservation is let go when the boat gives up on the crate (see Boat::SetState), when the crate is picked up (the crate's
+// trigger destroys it and the EntityManager removes it from here) or when it expires. Reservations last a multiple of the
+// time the boat expects the journey to take, so one held by a boat that has been held up or has gone elsewhere runs out.
+// The boat checks its reservation each time it thinks rather than looking the crate up, a lost reservation means the crate
+// has gone or the boat has run out of time.
+//
+// Reservations are changed only from boat updates, which always run on the main thread, so nothing here locks. They aren't
+// saved, boats reserve their crates again when restored (see Boat::RestoreState)
+
+#ifndef _CRATE_RESERVATIONS_H_INCLUDED_
+#define _CRATE_RESERVATIONS_H_INCLUDED_
+
+#include "EntityTypes.h"
+
+#include <vector>
+
+
+class CrateReservations
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// A reservation lasts the expected travel time times TRAVEL_FACTOR, plus EXTRA_TIME
+	static constexpr float TRAVEL_FACTOR = 2.0f;
+	static constexpr float EXTRA_TIME    = 3.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Reserve a crate for a boat that expects to reach it in the given number of seconds, renewing the boat's reservation if
+	// it already has one. Returns false if another boat has reserved the crate
+	bool Reserve(EntityID crate, EntityID boat, float travelTime);
+
+	// Let go of a crate the boat has reserved. Does nothing if the boat doesn't hold the crate's reservation
+	void Release(EntityID crate, EntityID boat);
+
+	// Whether a boat other than the given one holds an unexpired reservation for the crate
+	bool IsReservedByOther(EntityID crate, EntityID boat);
+
+	// Whether the boat holds an unexpired reservation for the crate
+	bool IsReservedBy(EntityID crate, EntityID boat);
+
+	// Forget the reservation of a crate that is being destroyed, e.g. picked up. The EntityManager does this when an entity
+	// is destroyed, it does nothing for other entities
+	void Remove(EntityID entity);
+
+	// Move the reservation clock on, called by the EntityManager in UpdateAll
+	void Update(float frameTime)  { mTime += frameTime; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct Reservation
+	{
+		EntityID crate   = NO_ID; // Shows whether the reservation belongs to the crate now in this slot
+		EntityID boat    = NO_ID;
+		float    expires = 0;     // On the reservation clock
+	};
+
+	// The reservation in the slot, if it is for the given crate and hasn't expired
+	Reservation* Find(EntityID crate);
+
+	// Indexed by the crate's slot index (see EntityTypes.h)
+	std::vector<Reservation> mReservations;
+	float mTime = 0.0f;
+};
+
+
+#endif //_CRATE_RESERVATIONS_H_INCLUDED_
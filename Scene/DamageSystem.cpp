@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// Damage system - applies the damage and repairs in every boat's messages to the boats' health, before they are updated
+//--------------------------------------------------------------------------------------
+
+#include "DamageSystem.h"
+#include "BoatComponents.h"
+#include "Messenger.h"
+
+#include "SceneGlobals.h" // For gEntityManager and gMessenger
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Apply the hits and repairs in every boat's messages this update, in the order each boat received them
+void DamageSystem::Update(BoatComponents& boats)
+{
+	mBoats = &boats;
+	mResults.clear();
+	mFirstResult.resize(boats.Count());
+	mAttacks.clear();
+	mFirstAttack.resize(boats.Count() + 1);
+
+	const auto& ids     = boats.Ids();
+	auto&       health  = boats.HealthArray();
+	auto&       shields = boats.ShieldArray();
+	for (size_t boat = 0; boat < ids.size(); ++boat)
+	{
+		mFirstResult[boat] = static_cast<uint32_t>(mResults.size());
+		mFirstAttack[boat] = static_cast<uint32_t>(mAttacks.size());
+		bool shielded = (shields[boat].entity != NO_ID);
+		for (const Message& message : gMessenger->ReceiveAll(ids[boat]))
+		{
+			switch (message.type)
+			{
+			case MessageType::Hit:
+			{
+				EntityID attacker = std::get<MissileHitData>(message.data).launchingBoatID;
+				float damage = 0;
+				if (!shielded)
+				{
+					uint32_t attackerIndex = boats.IndexOf(attacker);
+					damage = (attackerIndex != BoatComponents::NO_BOAT) ? boats.WeaponArray()[attackerIndex].missileDamage : MISSILE_DAMAGE;
+					health[boat].hp -= damage;
+					AddAttack(mFirstAttack[boat], attacker, damage);
+				}
+				mResults.push_back({ damage, attacker, shielded, health[boat].hp <= 0.0f });
+				break;
+			}
+
+			case MessageType::MineHit:
+			{
+				float damage = shielded ? SHIELDED_MINE_DAMAGE : MINE_DAMAGE;
+				health[boat].hp -= damage;
+				mResults.push_back({ damage, NO_ID, shielded, health[boat].hp <= 0.0f });
+				break;
+			}
+
+			case MessageType::CrateCollected:
+			{
+				CrateType type = std::get<CratePickupData>(message.data).type;
+				if      (type == CrateType::Health)  health[boat].hp += HEALTH_CRATE_REPAIR;
+				else if (type == CrateType::Shield)  shielded = true; // The boat puts a shield on as it reads this
+				break;
+			}
+
+			case MessageType::ShieldDestroyed:
+				shielded = false;
+				break;
+
+			default:
+				break;
+			}
+		}
+	}
+	mFirstAttack[ids.size()] = static_cast<uint32_t>(mAttacks.size());
+}
+
+
+// The result of the given hit on a boat this update
+const DamageSystem::Result& DamageSystem::GetResult(EntityID boat, uint32_t hit) const
+{
+	return mResults[mFirstResult[mBoats->IndexOf(boat)] + hit];
+}
+
+
+// The attackers whose missiles damaged a boat this update, each once
+std::span<const DamageSystem::Attack> DamageSystem::Attacks(EntityID boat) const
+{
+	// A boat added since the update began has had no hits
+	uint32_t index = mBoats->IndexOf(boat);
+	if (index == BoatComponents::NO_BOAT || index + 1 >= mFirstAttack.size())  return {};
+	return { mAttacks.data() + mFirstAttack[index], mAttacks.data() + mFirstAttack[index + 1] };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Add damage from an attacker to the current boat's attacks, which start at firstAttack. A boat is hit by a handful of
+// boats at most in an update so a linear search is fine
+void DamageSystem::AddAttack(uint32_t firstAttack, EntityID attacker, float damage)
+{
+	for (size_t i = firstAttack; i < mAttacks.size(); ++i)
+	{
+		if (mAttacks[i].attacker == attacker)
+		{
+			mAttacks[i].damage += damage;
+			return;
+		}
+	}
+	mAttacks.push_back({ attacker, damage });
+}
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// Damage system - applies the damage and repairs in every boat's messages to the boats' health, before they are updated
+//--------------------------------------------------------------------------------------
+// Once the messenger has begun the frame's messages in UpdateAll, and before any entity is updated, the EntityManager has
+// this system read each boat's messages and apply the missile hits, mine hits and health crates to the health components
+// (see BoatComponents.h) in the order they arrived. Whether the boat was shielded at each message is followed through the
+// shield crates and ShieldDestroyed messages, as the boat would have when reading them. Only the health, shield and weapon
+// data is touched, a missile hit's damage coming from the launching boat's weapon.
+//
+// Each boat still reacts to the hits itself when it reads its messages - showing the damage, telling its team and changing
+// state - from the results recorded here, the nth result being for the boat's nth Hit or MineHit message:
+//   const DamageSystem::Result& result = gEntityManager->Damage().GetResult(GetID(), hit++);
+//   if (result.fatal)  SetState(State::Destroyed);
+//
+// The missile hits are also totalled for each attacker, so a boat hit several times in an update tells its team about each
+// attacker once, and asks for help at most once, after reading its messages:
+//   for (const DamageSystem::Attack& attack : gEntityManager->Damage().Attacks(GetID()))  ...
+
+#ifndef _DAMAGE_SYSTEM_H_INCLUDED_
+#define _DAMAGE_SYSTEM_H_INCLUDED_
+
+#include "EntityTypes.h"
+
+#include <vector>
+#include <span>
+#include <stdint.h>
+
+
+class BoatComponents;
+
+class DamageSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	static constexpr float MISSILE_DAMAGE       = 20.0f; // Of a missile whose launching boat has gone
+	static constexpr float MINE_DAMAGE          = 50.0f;
+	static constexpr float SHIELDED_MINE_DAMAGE = 25.0f; // Shields stop missiles, but only half a mine's damage
+	static constexpr float HEALTH_CRATE_REPAIR  = 20.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Apply the hits and repairs in every boat's messages this update. Called by the EntityManager in UpdateAll, after the
+	// messenger's BeginFrame and before any entity is updated
+	void Update(BoatComponents& boats);
+
+	// The result of a hit on a boat this update
+	struct Result
+	{
+		float    damage;   // Taken, 0 if it was stopped by a shield
+		EntityID attacker; // Boat that launched the missile, NO_ID for a mine
+		bool     shielded; // Whether the boat was shielded when hit
+		bool     fatal;    // Whether the boat had no health left after the hit
+	};
+
+	// The result of the given hit on a boat this update, numbering its Hit and MineHit messages from 0 in the order
+	// they were received. Only for boats that were in play when the update began
+	const Result& GetResult(EntityID boat, uint32_t hit) const;
+
+	// The total damage a boat has taken from one attacker's missiles this update, after shields
+	struct Attack
+	{
+		EntityID attacker;
+		float    damage;
+	};
+
+	// The attackers whose missiles damaged a boat this update, each once, in the order they first hit it. None for a boat
+	// added since the update began
+	std::span<const Attack> Attacks(EntityID boat) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Add damage from an attacker to the current boat's attacks, which start at firstAttack
+	void AddAttack(uint32_t firstAttack, EntityID attacker, float damage);
+
+	BoatComponents* mBoats = nullptr;
+
+	// Every boat's results together, each boat's starting at its entry in mFirstResult (indexed as the components are)
+	std::vector<Result>   mResults;
+	std::vector<uint32_t> mFirstResult;
+
+	// Likewise every boat's attacks together, with one more entry at the end of mFirstAttack to give the last boat's count
+	std::vector<Attack>   mAttacks;
+	std::vector<uint32_t> mFirstAttack;
+};
+
+
+#endif //_DAMAGE_SYSTEM_H_INCLUDED_
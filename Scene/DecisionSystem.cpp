@@ -0,0 +1,238 @@
+//--------------------------------------------------------------------------------------
+// Decision system - utility scored choice of what each boat does next
+//--------------------------------------------------------------------------------------
+
+#include "DecisionSystem.h"
+#include "EntityManager.h"
+#include "Boat.h"
+#include "RandomCrate.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Evaluate the boats that are due, up to the budget. Called by the EntityManager at the start of UpdateAll
+void DecisionSystem::Update(EntityManager& entities, float frameTime)
+{
+	mEvaluatedCount = 0;
+	mChangedCount   = 0;
+	mDeferredCount  = 0;
+	if (!mEnabled)  return;
+
+	// Look for changes in what each boat's decision depends on, all cheap to compare. A boat new to its slot counts as changed
+	mDue.clear();
+	const TeamBlackboard& blackboard = entities.Blackboard();
+	for (Boat* boat : entities.View<Boat>())
+	{
+		uint32_t index = EntityIndex(boat->GetID());
+		if (index >= mEntries.size())  mEntries.resize(index + 1);
+		BoatEntry& entry = mEntries[index];
+		if (entry.decision.owner != boat->GetID())
+		{
+			entry = BoatEntry();
+			entry.decision.owner = boat->GetID();
+		}
+
+		const TeamBlackboard::Assignment& assignment = blackboard.AssignmentOf(boat);
+		if (boat->GetState() != entry.state || boat->GetHP() != entry.hp || boat->GetMissilesRemaining() != entry.missiles ||
+		    assignment.target != entry.enemy || assignment.assist != entry.assist)
+		{
+			entry.changed  = true;
+			entry.state    = boat->GetState();
+			entry.hp       = boat->GetHP();
+			entry.missiles = boat->GetMissilesRemaining();
+			entry.enemy    = assignment.target;
+			entry.assist   = assignment.assist;
+		}
+
+		entry.timer -= frameTime;
+		if (!IsDecidable(entry.state))
+		{
+			entry.decision.action = Action::None;
+			continue;
+		}
+		if (entry.changed || entry.timer <= 0.0f)  mDue.push_back({ boat, index, entry.changed, -entry.timer });
+	}
+
+	// Boats with changes go first, then the longest overdue. The slot index settles ties so the order is the same each run
+	int budget = std::min(mBudget, static_cast<int>(mDue.size()));
+	std::partial_sort(mDue.begin(), mDue.begin() + budget, mDue.end(), [](const DueBoat& a, const DueBoat& b)
+	{
+		if (a.changed != b.changed)  return a.changed;
+		if (a.overdue != b.overdue)  return a.overdue > b.overdue;
+		return a.index < b.index;
+	});
+	for (int i = 0; i < budget; ++i)
+	{
+		BoatEntry& entry = mEntries[mDue[i].index];
+		if (entry.changed)  ++mChangedCount;
+		Evaluate(entities, mDue[i].boat, entry);
+
+		// Each boat is given its own point in the interval, so boats that changed together aren't all evaluated together
+		// from then on
+		float stagger = std::fmod(mDue[i].index * 0.618034f, 1.0f);
+		entry.timer   = EVALUATION_TIME * (0.75f + 0.5f * stagger);
+		entry.changed = false;
+	}
+	mEvaluatedCount = budget;
+	mDeferredCount  = static_cast<int>(mDue.size()) - budget;
+}
+
+
+// The given boat's latest decision. Action::None if it hasn't been evaluated in its current state
+const DecisionSystem::Decision& DecisionSystem::DecisionOf(Boat* boat) const
+{
+	static const Decision NONE;
+	uint32_t index = EntityIndex(boat->GetID());
+	if (index >= mEntries.size())  return NONE;
+	const Decision& decision = mEntries[index].decision;
+	return decision.owner == boat->GetID() && decision.from == boat->GetState() ? decision : NONE;
+}
+
+
+// Name of an action for display
+const char* DecisionSystem::GetActionName(Action action)
+{
+	switch (action)
+	{
+	case Action::None:         return "None";
+	case Action::Patrol:       return "Patrol";
+	case Action::Aim:          return "Aim";
+	case Action::Evade:        return "Evade";
+	case Action::PickupCrate:  return "PickupCrate";
+	case Action::Reload:       return "Reload";
+	case Action::MoveToAssist: return "MoveToAssist";
+	}
+	return "?";
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Whether decisions can move a boat out of the given state
+bool DecisionSystem::IsDecidable(Boat::State state)
+{
+	return ActionOf(state) != Action::None && state != Boat::State::Aim;
+}
+
+
+// Action a boat is taking in the given state, Action::None if it isn't one of the candidates
+DecisionSystem::Action DecisionSystem::ActionOf(Boat::State state)
+{
+	switch (state)
+	{
+	case Boat::State::Patrol:       return Action::Patrol;
+	case Boat::State::Aim:          return Action::Aim;
+	case Boat::State::Evade:        return Action::Evade;
+	case Boat::State::PickupCrate:  return Action::PickupCrate;
+	case Boat::State::Reloading:    return Action::Reload;
+	case Boat::State::MoveToAssist: return Action::MoveToAssist;
+	default:                        return Action::None;
+	}
+}
+
+
+// Gather the inputs for the given boat and choose its best action
+void DecisionSystem::Evaluate(EntityManager& entities, Boat* boat, BoatEntry& entry)
+{
+	Inputs inputs;
+	inputs.state    = entry.state;
+	inputs.health   = std::clamp(entry.hp / boat->GetMaxHP(), 0.0f, 1.0f);
+	inputs.missiles = std::clamp(static_cast<float>(entry.missiles) / std::max(boat->GetMaxMissiles(), 1), 0.0f, 1.0f);
+	inputs.enemy    = entry.enemy;
+	inputs.assist   = entry.assist;
+
+	Vector3 boatPos = boat->Transform().Position();
+	const SpatialGrid& spatial = entities.Spatial();
+	CrateReservations& reservations = entities.Reservations();
+	auto crate = static_cast<RandomCrate*>(spatial.QueryNearest(boatPos, SPATIAL_CRATE, CRATE_RANGE, [&](Entity* candidate)
+	{
+		return !reservations.IsReservedByOther(candidate->GetID(), boat->GetID()); // Skip crates other boats are going for
+	}));
+	inputs.crate         = crate != nullptr ? crate->GetID() : NO_ID;
+	inputs.crateType     = crate != nullptr ? crate->GetCrateType() : CrateType::Missile;
+	inputs.crateDistance = crate != nullptr ? Distance(boatPos, crate->Transform().Position()) : CRATE_RANGE;
+	Entity* station = spatial.QueryNearest(boatPos, SPATIAL_RELOAD_STATION, STATION_RANGE);
+	inputs.stationDistance = station != nullptr ? Distance(boatPos, station->Transform().Position()) : STATION_RANGE;
+
+	// The highest score wins, the current action with its bonus
+	static constexpr Action CANDIDATES[] =
+		{ Action::Patrol, Action::Aim, Action::Evade, Action::PickupCrate, Action::Reload, Action::MoveToAssist };
+	Action current = ActionOf(inputs.state);
+	Decision& decision = entry.decision;
+	decision.from   = inputs.state;
+	decision.action = current;
+	decision.score  = -1;
+	for (Action action : CANDIDATES)
+	{
+		float score = Score(action, inputs);
+		if (score <= 0.0f)  continue;
+		if (action == current)  score += COMMITMENT_BONUS;
+		if (score > decision.score)
+		{
+			decision.action = action;
+			decision.score  = score;
+		}
+	}
+
+	switch (decision.action)
+	{
+	case Action::Aim:
+	case Action::Evade:        decision.target = inputs.enemy;  break;
+	case Action::PickupCrate:  decision.target = inputs.crate;  break;
+	case Action::MoveToAssist: decision.target = inputs.assist; break;
+	default:                   decision.target = NO_ID;         break;
+	}
+}
+
+
+// Score of an action from the inputs, 0 if it can't be taken. The scores are on the same scale so they can be compared: an
+// enemy in view beats everything but running out of missiles or very low health, and patrolling is the fallback
+float DecisionSystem::Score(Action action, const Inputs& in)
+{
+	switch (action)
+	{
+	case Action::Patrol:
+		return 0.25f;
+
+	case Action::Aim:
+		if (in.enemy == NO_ID || in.missiles <= 0.0f)  return 0.0f;
+		return 0.6f + 0.3f * in.health;
+
+	case Action::Evade:
+		// Evading after a shot carries on until it ends as before, otherwise a boat runs from an enemy it can see when its
+		// health is low
+		if (in.state == Boat::State::Evade)  return 0.5f;
+		if (in.enemy == NO_ID || in.health >= LOW_HEALTH)  return 0.0f;
+		return 0.95f - in.health;
+
+	case Action::PickupCrate:
+	{
+		if (in.crate == NO_ID)  return 0.0f;
+		float need = in.crateType == CrateType::Health  ? 1.0f - in.health :
+		             in.crateType == CrateType::Missile ? 1.0f - in.missiles : 0.5f;
+		return 0.8f * need * (1.0f - in.crateDistance / CRATE_RANGE);
+	}
+
+	case Action::Reload:
+	{
+		// Out of missiles is urgent wherever the station is, running low is worth a trip to a station nearby
+		if (in.missiles <= 0.0f)  return 0.95f;
+		float shortage = 1.0f - in.missiles;
+		return 0.5f * shortage * shortage * (1.0f - in.stationDistance / STATION_RANGE);
+	}
+
+	case Action::MoveToAssist:
+		if (in.assist == NO_ID || in.missiles <= 0.0f)  return 0.0f;
+		return 0.45f + 0.3f * in.health;
+
+	default:
+		return 0.0f;
+	}
+}
@@ -0,0 +1,172 @@
+//--------------------------------------------------------------------------------------
+// Decision system - utility scored choice of what each boat does next
+//--------------------------------------------------------------------------------------
+// An alternative to the transition checks in the boat state machine (see Boat::Update). Each candidate action - patrol, aim,
+// evade, pick up a crate, reload or move to assist a teammate - is given a score from 0 to 1 from a few inputs about the boat
+// (its health and missiles, the enemy and assist assignments from the team blackboard, the nearest crate and reload station),
+// and the boat takes the action with the highest score. The action the boat is taking already gets COMMITMENT_BONUS, so a
+// boat doesn't switch back and forth between actions that score about the same.
+//
+// Rather than every boat scoring every action every update, the EntityManager has this system choose for the boats that need
+// it at the start of UpdateAll, after the team blackboard. A boat's choice is made again when something it depends on changes
+// (its state, health, missiles or assignments, which are cheap to compare), and otherwise every EVALUATION_TIME. No more than
+// the budget of boats are evaluated in one update, those with changes first, then the longest overdue, so the cost of the
+// decisions in an update is capped whatever the number of boats. The inputs that need spatial queries are only gathered when
+// a boat is evaluated.
+//
+// Only boats in a state the decisions can move them out of are evaluated: patrolling, evading, picking up a crate, reloading
+// or going to assist. Aiming runs to the shot, and being hit by a mine, following an order and sinking end on their own as
+// before. A boat acts on its decision in its next update if it is still in the state the decision was made in
+//
+//   gEntityManager->Decisions().SetEnabled(true);
+//   ... in Boat::Update: const DecisionSystem::Decision& decision = gEntityManager->Decisions().DecisionOf(this);
+
+#ifndef _DECISION_SYSTEM_H_INCLUDED_
+#define _DECISION_SYSTEM_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "Boat.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class EntityManager;
+
+class DecisionSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Seconds between a boat's evaluations when nothing it depends on has changed
+	static constexpr float EVALUATION_TIME = 0.5f;
+
+	// Added to the score of the action the boat is already taking
+	static constexpr float COMMITMENT_BONUS = 0.1f;
+
+	// Crates and reload stations further than these are not considered
+	static constexpr float CRATE_RANGE   = 150.0f;
+	static constexpr float STATION_RANGE = 400.0f;
+
+	// Health fraction below which a boat that can see an enemy considers running from it
+	static constexpr float LOW_HEALTH = 0.3f;
+
+	// Off by default, the state machine's own checks are used
+	void SetEnabled(bool enabled)  { mEnabled = enabled; }
+	bool IsEnabled()               { return mEnabled; }
+
+	// The most boats evaluated in one update, at least 1
+	void SetBudget(int boats)  { mBudget = boats < 1 ? 1 : boats; }
+	int  GetBudget()           { return mBudget; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	enum class Action
+	{
+		None, // Not evaluated, the boat carries on as it is
+		Patrol,
+		Aim,
+		Evade,
+		PickupCrate,
+		Reload,
+		MoveToAssist,
+	};
+	static const char* GetActionName(Action action);
+
+	// What a boat has decided to do. Only valid while the boat is still in the state it was decided in
+	struct Decision
+	{
+		EntityID    owner  = NO_ID; // Shows whether the decision belongs to the boat now in this slot
+		Boat::State from   = Boat::State::Inactive;
+		Action      action = Action::None;
+		EntityID    target = NO_ID; // Enemy to aim at or evade, crate to pick up or enemy to assist against
+		float       score  = 0;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Evaluate the boats that are due, up to the budget. Called by the EntityManager at the start of UpdateAll, after the team
+	// blackboard. Does nothing while disabled
+	void Update(EntityManager& entities, float frameTime);
+
+	// The given boat's latest decision. Action::None if it hasn't been evaluated in its current state
+	const Decision& DecisionOf(Boat* boat) const;
+
+	// Boats evaluated in the last update, how many of those were for a change rather than the schedule, and boats that were
+	// due but left over for the budget, for display
+	int EvaluatedCount()  { return mEvaluatedCount; }
+	int ChangedCount()    { return mChangedCount; }
+	int DeferredCount()   { return mDeferredCount; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// What the scores are worked out from, gathered when a boat is evaluated
+	struct Inputs
+	{
+		Boat::State state;
+		float       health;        // Fractions of the boat's maximum, 0 to 1
+		float       missiles;
+		EntityID    enemy;         // Blackboard assignments
+		EntityID    assist;
+		EntityID    crate;         // Nearest within CRATE_RANGE, NO_ID if none
+		CrateType   crateType;
+		float       crateDistance;
+		float       stationDistance; // Nearest reload station, STATION_RANGE if none nearer
+	};
+
+	// A boat's decision with what it was made from. Indexed by the boat's slot index (see EntityTypes.h)
+	struct BoatEntry
+	{
+		Decision    decision;
+		float       timer   = 0;     // Until the next scheduled evaluation
+		bool        changed = true;  // Something the decision depends on has changed since it was made
+		Boat::State state   = Boat::State::Inactive;
+		float       hp      = 0;
+		int         missiles = 0;
+		EntityID    enemy   = NO_ID;
+		EntityID    assist  = NO_ID;
+	};
+
+	// Whether decisions can move a boat out of the given state
+	static bool IsDecidable(Boat::State state);
+
+	// Gather the inputs for the given boat and choose its best action
+	void Evaluate(EntityManager& entities, Boat* boat, BoatEntry& entry);
+
+	// Score of an action from the inputs, 0 if it can't be taken
+	static float Score(Action action, const Inputs& inputs);
+
+	// Action a boat is taking in the given state, Action::None if it isn't one of the candidates
+	static Action ActionOf(Boat::State state);
+
+	std::vector<BoatEntry> mEntries;
+
+	// Boats due in this update and how they rank for the budget, kept to reuse its capacity
+	struct DueBoat
+	{
+		Boat*    boat;
+		uint32_t index;
+		bool     changed;
+		float    overdue;
+	};
+	std::vector<DueBoat> mDue;
+
+	bool mEnabled = false;
+	int  mBudget  = 32;
+	int  mEvaluatedCount = 0;
+	int  mChangedCount   = 0;
+	int  mDeferredCount  = 0;
+};
+
+
+#endif //_DECISION_SYSTEM_H_INCLUDED_
@@ -10,7 +10,15 @@
 
 #include "Entity.h"
 #include "Mesh.h"
+#include "MeshManager.h"
+#include "DXDevice.h"
+#include "RenderGlobals.h"
 #include "SceneGlobals.h" // For entity manager and messenger
+#include "TransformStore.h"
+#include "ImpostorRenderer.h" // For ImpostorAtlas
+
+#include <stdexcept>
+#include <cstring>
 
 
 /*-----------------------------------------------------------------------------------------
@@ -18,32 +26,142 @@
 -----------------------------------------------------------------------------------------*/
 
 // Base entity template constructor needs template type (e.g. "Green GunBoat") and the associated mesh (e.g. "gunboat_green.fbx")
+// The mesh is shared with any other template using the same file and import flags
 // Can throw std::runtime_error if the mesh fails to load
 EntityTemplate::EntityTemplate(const std::string& type, const std::string& meshFilename, ImportFlags importFlags /* = {}*/)
+	: mType(type), mMeshFilename(meshFilename), mImportFlags(importFlags)
+{
+	mMeshes.push_back(Meshes()->LoadMesh(meshFilename, importFlags));
+}
+
+// Entity template using a mesh made in code, e.g. the stand-in for a template still loading
+EntityTemplate::EntityTemplate(const std::string& type, std::shared_ptr<Mesh> mesh)
 	: mType(type)
 {
-	mMesh = std::make_unique<Mesh>(meshFilename, importFlags);
+	mMeshes.push_back(std::move(mesh));
 }
 
 // Destructor - nothing to do, only required because polymorphic base classes must always have one. Also see comment on forward declarations in header file
 EntityTemplate::~EntityTemplate() {}
 
 
+
+/*-----------------------------------------------------------------------------------------
+	Entity Template Levels of Detail
+-----------------------------------------------------------------------------------------*/
+
+// Add a lower level of detail loaded from another mesh file, used when an entity's size on screen is below screenSize
+// Can throw std::runtime_error if the mesh fails to load, or if it doesn't match the main mesh
+void EntityTemplate::AddLOD(const std::string& meshFilename, float screenSize)
+{
+	AddLODMesh(Meshes()->LoadMesh(meshFilename, mImportFlags), screenSize);
+}
+
+// As AddLOD, but the mesh is made by simplifying the main mesh file to about the given fraction of its triangles
+void EntityTemplate::AddSimplifiedLOD(float detail, float screenSize)
+{
+	AddLODMesh(Meshes()->LoadMesh(mMeshFilename, mImportFlags, detail), screenSize);
+}
+
+// Shared by AddLOD and AddSimplifiedLOD, checks the mesh and screen size, then adds them
+void EntityTemplate::AddLODMesh(std::shared_ptr<Mesh> mesh, float screenSize)
+{
+	// Entities allocate node matrices for the main mesh, a LOD can use all of them or just the root
+	if (mesh->NodeCount() != GetMesh().NodeCount() && mesh->NodeCount() != 1)
+		throw std::runtime_error("Level of detail mesh for " + mType.str() + " does not have the same nodes as the main mesh");
+	if (screenSize <= 0 || (!mLODScreenSizes.empty() && screenSize >= mLODScreenSizes.back()))
+		throw std::runtime_error("Levels of detail for " + mType.str() + " must be added in order of decreasing screen size");
+
+	mMeshes.push_back(std::move(mesh));
+	mLODScreenSizes.push_back(screenSize);
+}
+
+
+// The level of detail to use for an entity of the given size on screen that currently uses currentLOD. A LOD is entered when
+// the size is a little below its screen size and left when it is a little above, so small changes near a threshold are ignored
+unsigned int EntityTemplate::SelectLOD(float screenSize, unsigned int currentLOD)
+{
+	unsigned int lod = 0;
+	for (unsigned int i = 0; i < mLODScreenSizes.size(); ++i)
+	{
+		float threshold = mLODScreenSizes[i] * (i < currentLOD ? (1 + LOD_HYSTERESIS) : (1 - LOD_HYSTERESIS));
+		if (screenSize >= threshold)  break;
+		lod = i + 1;
+	}
+	return lod;
+}
+
+
+// Draw entities as impostors when their size on screen is below the given screen size, 0 for no impostor. Throws
+// std::runtime_error if the screen size isn't below that of every LOD
+void EntityTemplate::SetImpostor(float screenSize)
+{
+	if (screenSize < 0 || (screenSize > 0 && !mLODScreenSizes.empty() && screenSize >= mLODScreenSizes.back()))
+		throw std::runtime_error("Impostor screen size for " + mType.str() + " must be below the screen sizes of its levels of detail");
+
+	mImpostorScreenSize = screenSize;
+	if (screenSize > 0 && mImpostorAtlas == nullptr)  mImpostorAtlas = std::make_unique<ImpostorAtlas>();
+	else if (screenSize == 0)                         mImpostorAtlas.reset();
+}
+
+
+// Whether an entity of the given size on screen should be drawn as an impostor, with the same margin around the threshold as SelectLOD
+bool EntityTemplate::UseImpostor(float screenSize, bool currentlyImpostor)
+{
+	if (mImpostorScreenSize <= 0)  return false;
+	return screenSize < mImpostorScreenSize * (currentlyImpostor ? (1 + LOD_HYSTERESIS) : (1 - LOD_HYSTERESIS));
+}
+
+
+
 // Entity constructor, needs pointer to common template data and ID, may also pass 
 // May also pass a name and initial transformation for root (defaults are empty named entity at origin)
-Entity::Entity(EntityTemplate& entityTemplate, EntityID ID, const Matrix4x4& transform /*= Matrix4x4::Identity*/, const std::string& name /*= ""*/)
-    : mTemplate(entityTemplate), mID(ID), mTransforms(mTemplate.GetMesh().NodeCount()), mName(name)
+Entity::Entity(EntityTemplate& entityTemplate, EntityID ID, const Matrix4x4& transform /*= Matrix4x4::Identity*/, Atom name /*= {}*/)
+    : mTemplate(&entityTemplate), mID(ID), mName(name), mTransformStore(gEntityManager->Transforms())
 {
-	// Set initial matrices from mesh defaults
-	for (int i = 0; i < mTransforms.size(); ++i)
-		mTransforms[i] = mTemplate.GetMesh().DefaultTransform(i);
+	// Get space for the matrices from the entity manager's transform store. The root matrix is at this entity's slot index
+	mRootTransform = &mTransformStore.Root(EntityIndex(ID));
+	AllocateNodeTransforms();
 
 	// Override default root matrix (which should be the identity matrix) with constructor parameters
-	mTransforms[0] = transform;
+	*mRootTransform = transform;
 }
 
-// Destructor - nothing to do, only required because polymorphic base classes must always have one
-Entity::~Entity() {}
+// Destructor - return the node matrices to the transform store. The root matrix belongs to the entity's slot so is reused with it
+Entity::~Entity()
+{
+	mTransformStore.FreeNodes(mNodeTransforms, mNumNodeTransforms);
+	if (mWorldTransforms != nullptr)  mTransformStore.FreeNodes(mWorldTransforms, 2 * (mNumNodeTransforms + 1));
+}
+
+
+// Move the entity to another template of the same type, making its node matrices again for the new mesh. The root matrix is kept
+void Entity::ReplaceTemplate(EntityTemplate& entityTemplate)
+{
+	mTransformStore.FreeNodes(mNodeTransforms, mNumNodeTransforms);
+	if (mWorldTransforms != nullptr)  mTransformStore.FreeNodes(mWorldTransforms, 2 * (mNumNodeTransforms + 1));
+
+	mTemplate = &entityTemplate;
+	mWorldTransformsValid = false;
+	ResetLOD();
+	AllocateNodeTransforms();
+}
+
+
+// Get space for the node matrices of the template's main mesh from the transform store and set them to the mesh's defaults
+void Entity::AllocateNodeTransforms()
+{
+	mNumNodeTransforms = mTemplate->GetMesh().NodeCount() - 1;
+	mNodeTransforms    = mTransformStore.AllocateNodes(mNumNodeTransforms);
+
+	// Entities with more than a root node keep their world matrices, see WorldTransforms
+	mWorldTransforms = (mNumNodeTransforms > 0) ? mTransformStore.AllocateNodes(2 * (mNumNodeTransforms + 1)) : nullptr;
+	mChangedNodes.assign(mNumNodeTransforms > 0 ? mNumNodeTransforms + 1 : 0, 0);
+
+	// Set initial matrices from mesh defaults
+	for (unsigned int i = 0; i < mNumNodeTransforms; ++i)
+		mNodeTransforms[i] = mTemplate->GetMesh().DefaultTransform(i + 1);
+}
 
 
 
@@ -55,13 +173,92 @@ Entity::~Entity() {}
 // ***Entity Update functions should return false if the entity is to be destroyed***
 bool Entity::Update([[maybe_unused]] float frameTime)
 {
-	// Could add common processing that applies to *all* entities here, but typically there is nothing common for everything so this method does nothing
+	// This method does nothing and the EntityManager relies on that - entities that use this version of Update are never updated
+	// (see EntityManager::CreateEntity). Add processing in inherited classes instead
 	return true;
 }
 
 
-// Render the entity's geometry
-void Entity::Render()
+// Render the entity's geometry, optionally skipping parts that are outside the given frustum
+void Entity::Render(const Frustum* cullFrustum /*= nullptr*/)
 {
-	mTemplate.GetMesh().Render(mTransforms, mRenderColour);
+	LODMesh().Render(WorldTransforms(), mRenderColour, cullFrustum);
+}
+
+
+// Render only the entity's geometry with the shaders already set on the GPU
+void Entity::RenderGeometry(ColourRGBA colour)
+{
+	LODMesh().RenderGeometry(WorldTransforms(), colour);
+}
+
+
+// As Render, but the draws are added to a render queue to be sorted and rendered later
+void Entity::QueueRender(RenderQueue& queue, const Frustum* cullFrustum /*= nullptr*/)
+{
+	LODMesh().QueueRender(queue, WorldTransforms(), mRenderColour, cullFrustum);
+}
+
+
+// Write the entity's world matrices into a batch of instances of its mesh for instanced rendering
+void Entity::WriteInstanceMatrices(Matrix4x4* batch, unsigned int instance, unsigned int numInstances)
+{
+	LODMesh().WriteInstanceMatrices(WorldTransforms(), batch, instance, numInstances);
+}
+
+
+// The world-space matrices of every node of the entity's mesh, only recalculating nodes that have changed since the last call
+const Matrix4x4* Entity::WorldTransforms()
+{
+	if (mWorldTransforms == nullptr)  return mRootTransform;
+
+	// A node has changed if its matrix differs from the one its world matrix was calculated from, or if its parent has changed.
+	// Nodes are stored depth-first, so a parent is always visited before its children
+	unsigned int numNodes = mNumNodeTransforms + 1;
+	Matrix4x4* usedTransforms = mWorldTransforms + numNodes;
+	auto hasChanged = [&](const Matrix4x4& transform, Matrix4x4& usedTransform)
+	{
+		if (mWorldTransformsValid && std::memcmp(&transform, &usedTransform, sizeof(Matrix4x4)) == 0)  return false;
+		usedTransform = transform;
+		return true;
+	};
+
+	Mesh& mesh = mTemplate->GetMesh();
+	mChangedNodes[0] = hasChanged(*mRootTransform, usedTransforms[0]);
+	if (mChangedNodes[0])  mWorldTransforms[0] = *mRootTransform;
+	for (unsigned int node = 1; node < numNodes; ++node)
+	{
+		unsigned int parent = mesh.ParentNode(node);
+		mChangedNodes[node] = hasChanged(mNodeTransforms[node - 1], usedTransforms[node]) || mChangedNodes[parent];
+		if (mChangedNodes[node])  mWorldTransforms[node] = mNodeTransforms[node - 1] * mWorldTransforms[parent];
+	}
+	mWorldTransformsValid = true;
+	return mWorldTransforms;
+}
+
+
+// Sphere enclosing the entity in world space
+BoundingSphere Entity::GetWorldBoundingSphere()
+{
+	return mTemplate->GetMesh().GetBoundingSphere().Transformed(*mRootTransform);
+}
+
+
+// Choose the level of detail to render the entity with, and whether to draw it as an impostor, from its size on screen when seen
+// from the given camera position. The size is the radius of the bounding sphere as a fraction of half the viewport height, the
+// main mesh is used when the camera is inside the sphere
+void Entity::SelectLOD(const Vector3& cameraPosition, float projectionScale)
+{
+	if (mTemplate->LODCount() < 2 && mTemplate->ImpostorScreenSize() <= 0)  return;
+
+	BoundingSphere bounds = GetWorldBoundingSphere();
+	float distance = Distance(cameraPosition, bounds.centre);
+	if (distance <= bounds.radius)
+	{
+		ResetLOD();
+		return;
+	}
+	float screenSize = bounds.radius * projectionScale / distance;
+	mLOD      = mTemplate->SelectLOD(screenSize, mLOD);
+	mImpostor = mTemplate->UseImpostor(screenSize, mImpostor);
 }
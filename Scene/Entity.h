@@ -17,6 +17,11 @@
 // this class is only suitable for static scene objects. More complex entities will have other gameplay data
 // and code so they will need new classes inherited from the base Entity
 // 
+// A template can also hold lower levels of detail (LODs) of its mesh, either loaded from other files or simplified from the main
+// mesh at import. Each LOD has the screen size below which it is used, and each entity picks its LOD as it is rendered (see
+// Entity::SelectLOD). The first "LOD" is the main mesh, which is used for everything except rendering (e.g. bounds, nodes).
+// Beyond the last LOD a template can switch to an impostor, a single quad showing a baked view of the main mesh (see SetImpostor)
+//
 // An EntityTemplate can return the collection of entities currently using it so the game code may not need
 // to maintain the same data. E.g. if you need to do something with all tank entities, you could use the tank
 // template's list of current tank entities rather than hold your own. However, the template holds pointers to
@@ -28,15 +33,18 @@
 #define _ENTITY_H_INCLUDED_
 
 #include "EntityTypes.h"
+#include "TypeTag.h"
 
 #include "Mesh.h"
 #include "Matrix4x4.h"
 #include "Vector3.h"
 #include "ColourTypes.h"
+#include "Atom.h"
 
 #include <vector>
 #include <string>
 #include <memory>
+#include <typeinfo>
 
 // Forward declaration of Mesh class allows us to use Mesh pointers before that class has been fully declared
 // This reduces the number of include files needed here, which in turn minimises dependencies and speeds up compilation
@@ -44,6 +52,8 @@
 // Note: if you have a class containing a unique_ptr to a forward declaration (that is the case here) then this class must also have a destructor
 // signature here and declaration in the cpp file - this is required even if the destructor is default/empty. Otherwise you get compile errors.
 class Mesh;
+class TransformStore;
+struct ImpostorAtlas;
 
 
 /*-----------------------------------------------------------------------------------------
@@ -52,6 +62,7 @@ class Mesh;
 class EntityTemplate
 {
 	friend class EntityManager; // Manager is a friend class so it can update which entities use this template without needing to expose a public function to do that
+	template <typename Derived, TypeTag Tag> friend class TaggedType; // Sets the type mask
 
 	/*-----------------------------------------------------------------------------------------
 	   Construction / Destruction
@@ -61,6 +72,10 @@ public:
 	// Can throw std::runtime_error if the mesh fails to load
 	EntityTemplate(const std::string& type, const std::string& meshFilename, ImportFlags importFlags = {});
 
+	// Entity template using a mesh made in code rather than loaded from a file, e.g. the stand-in for a template still loading
+	// (see EntityManager::CreateEntity). It has no file to make simplified levels of detail from
+	EntityTemplate(const std::string& type, std::shared_ptr<Mesh> mesh);
+
 	// Destructor - polymorphic base class destructors should always be virtual, also see comment on forward declarations above
 	virtual ~EntityTemplate();
 
@@ -69,16 +84,38 @@ public:
 	   Data Access
 	-----------------------------------------------------------------------------------------*/
 public:
-	// The name of the type of entity this template is a blueprint for
-	std::string GetType()
+	// The name of the type of entity this template is a blueprint for, the atom it is found by (see Atom.h). Use .str() for the text
+	Atom GetType()
 	{
 		return mType;
 	}
 
+	// Bits of the tagged classes this template is, see TypeTag.h. Test with TypeCast
+	TypeMask GetTypeMask()  { return mTypeMask; }
+
+	// Box enclosing the main mesh in the space of an entity's root matrix, for tight collision bounds (see Mesh::GetBoundingBox).
+	// Returns false if the mesh's box isn't known (skinned or empty meshes)
+	bool GetBoundingBox(Vector3& boxMin, Vector3& boxMax)
+	{
+		return mMeshes[0]->GetBoundingBox(boxMin, boxMax);
+	}
+
 	// Returns reference to the mesh used by enities based on this template
 	Mesh& GetMesh() // Would prefer the function to be just called "Mesh" as it returns a reference but that would clash with the class name 'Mesh'
 	{
-		return *mMesh;
+		return *mMeshes[0];
+	}
+
+	// Number of levels of detail of the mesh, including the main mesh (LOD 0). Always at least 1
+	unsigned int LODCount()
+	{
+		return static_cast<unsigned int>(mMeshes.size());
+	}
+
+	// Returns reference to the mesh for the given level of detail, 0 is the main mesh (same as GetMesh)
+	Mesh& GetLODMesh(unsigned int lod)
+	{
+		return *mMeshes[lod];
 	}
 
 	// Return a vector of entity IDs using this template. The vector is const, you cannot change its contents, but you can change the entities themselves
@@ -88,15 +125,71 @@ public:
 	}
 
 
+	/*-----------------------------------------------------------------------------------------
+	   Levels of Detail
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add a lower level of detail loaded from another mesh file, with the same import flags as the main mesh. It is used when an
+	// entity's size on screen is below screenSize, which is the radius of its bounding sphere as a fraction of half the viewport
+	// height. LODs must be added in order of decreasing screen size. The mesh must have the same nodes as the main mesh, or just
+	// a root node. Can throw std::runtime_error if the mesh fails to load or doesn't fit these rules
+	void AddLOD(const std::string& meshFilename, float screenSize);
+
+	// As AddLOD, but the mesh is made by simplifying the main mesh file to about the given fraction (detail) of its triangles
+	void AddSimplifiedLOD(float detail, float screenSize);
+
+	// The level of detail to use for an entity of the given size on screen (see AddLOD), that currently uses currentLOD. To stop
+	// entities near a threshold switching back and forth every frame, the size must be a little past the threshold to change LOD
+	unsigned int SelectLOD(float screenSize, unsigned int currentLOD);
+
+	// Draw entities as impostors (see ImpostorRenderer.h) when their size on screen is below the given screen size, which must be
+	// below that of every LOD. Pass 0 for no impostor (the default). The views of the main mesh are baked the first time an
+	// entity is drawn as an impostor
+	void  SetImpostor(float screenSize);
+	float ImpostorScreenSize()  { return mImpostorScreenSize; }
+
+	// Whether an entity of the given size on screen, currently drawn as an impostor or not, should be drawn as one. Uses the
+	// same margin around the threshold as SelectLOD
+	bool UseImpostor(float screenSize, bool currentlyImpostor);
+
+	// The baked views of the main mesh for impostors, nullptr if the template has no impostor
+	ImpostorAtlas* Impostor()  { return mImpostorAtlas.get(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Shared by AddLOD and AddSimplifiedLOD, checks the mesh and screen size, then adds them
+	void AddLODMesh(std::shared_ptr<Mesh> mesh, float screenSize);
+
+
 	/*-----------------------------------------------------------------------------------------
 	   Private data
 	-----------------------------------------------------------------------------------------*/
 private:
+	// How far past a LOD's screen size an entity must be to change to or from that LOD, as a fraction of the screen size
+	static constexpr float LOD_HYSTERESIS = 0.1f;
+
 	// Type of the template
-	std::string mType;
+	Atom mType;
 
-	// The mesh representing this entity
-	std::unique_ptr<Mesh> mMesh;
+	// Set by the TaggedType bases of the template's class, see TypeTag.h
+	TypeMask mTypeMask = 0;
+
+	// The mesh file and import flags the main mesh was loaded with, simplified LODs are made from the same file
+	std::string mMeshFilename;
+	ImportFlags mImportFlags;
+
+	// The meshes representing this entity, the main mesh then the lower levels of detail. Each LOD except the main mesh has the
+	// screen size below which it is used, mLODScreenSizes[0] is for LOD 1. Templates using the same mesh file share the mesh, it is
+	// destroyed along with the last template using it (see MeshManager)
+	std::vector<std::shared_ptr<Mesh>> mMeshes;
+	std::vector<float> mLODScreenSizes;
+
+	// Screen size below which entities are drawn as impostors (0 for none), and the views they are drawn with once baked
+	float mImpostorScreenSize = 0;
+	std::unique_ptr<ImpostorAtlas> mImpostorAtlas;
 
 	// Pointers to entities based on this template
 	std::vector<EntityID> mEntities;
@@ -110,17 +203,24 @@ private:
 -----------------------------------------------------------------------------------------*/
 class Entity
 {
+	friend class EntityManager; // Manager is a friend class so it can rename entities and change their render groups, keeping its lookups up to date
+	template <typename Derived, TypeTag Tag> friend class TaggedType; // Sets the type mask
+
 	/*-----------------------------------------------------------------------------------------
 	   Construction
 	-----------------------------------------------------------------------------------------*/
 public:
 	// Base entity constructor, needs pointer to common template data and unique ID (UID)
 	// May also pass a name and initial transformation for root (defaults are empty named entity at origin)
-    Entity(EntityTemplate& entityTemplate, EntityID UID, const Matrix4x4& transform = Matrix4x4::Identity, const std::string& name = "");
+    Entity(EntityTemplate& entityTemplate, EntityID UID, const Matrix4x4& transform = Matrix4x4::Identity, Atom name = {});
 
 	// Destructor - polymorphic base class destructors should always be virtual
 	virtual ~Entity();
 
+	// Prevent copying - the entity's matrices are held in the entity manager's transform store and belong to this entity only
+	Entity(const Entity&) = delete;
+	Entity& operator=(const Entity&) = delete;
+
 
 	/*-----------------------------------------------------------------------------------------
 	   Data Access
@@ -128,33 +228,65 @@ public:
 public:
 	// Direct access to entity's template, can access base or inherited template classes:
 	// 
-	//   string templateType = entity->Template().GetType();                    // No template parameter - gets base class template
+	//   string templateType = entity->Template().GetType().str();                    // No template parameter - gets base class template
 	//   float vehicleMaxSpeed = entity->Template<VehicleTemplate>().mMaxSpeed; // Template parameter <VehicleTemplate>, so returns VehicleTemplate
 	template<typename T = EntityTemplate>
-	T& Template() { return dynamic_cast<T&>(mTemplate); }
+	T& Template()
+	{
+		T* entityTemplate = TypeCast<T>(mTemplate);
+		if (entityTemplate == nullptr)  throw std::bad_cast();
+		return *entityTemplate;
+	}
+
+	// Bits of the tagged classes this entity is, see TypeTag.h. Test with TypeCast or Is
+	TypeMask GetTypeMask()  { return mTypeMask; }
+
+	// Whether this entity is of the given class or one derived from it, a single mask test for tagged classes (see TypeTag.h)
+	template <typename T>
+	bool Is()  { return TypeCast<T>(this) != nullptr; }
 
 	// Entity identity getters
-	EntityID           GetID()    { return mID; }
-	const std::string& GetName()  { return mName; }
+	EntityID           GetID()       { return mID; }
+	const std::string& GetName()     { return mName.str(); }
+	Atom               GetNameAtom() { return mName; } // To compare or look up names without touching the text
 
 	// Direct access to the transformation matrix of the given node of the entity's mesh.
 	// Root matrix (node=0) is in world space, all other nodes are parent-relative.
 	// Matrix4x4 supports many functions for model manipulation - see Matrix4x4.h for details.
 	// Examples: entity.Transform().Position() = {0,0,0};    entity.Transform(2).SetScale(10);    Vector3 facing = entity.Transform().ZAxis();
 	//           entity.Transform().FaceTarget(enemyPosition);    Vector3 angles = entity.Transform(1).GetRotation();
-	Matrix4x4& Transform(int node = 0)  { return mTransforms[node]; }
+	Matrix4x4& Transform(int node = 0)  { return node == 0 ? *mRootTransform : mNodeTransforms[node - 1]; }
+
+	// Number of nodes in the entity's mesh including the root, so Transform can be used with nodes 0 to NodeCount() - 1
+	unsigned int NodeCount()  { return mNumNodeTransforms + 1; }
 
 	// Calculate the absolute transformation matrix of a given node. All nodes except the root 0 store their transformations
 	// relative to their parent. Use this method if you want the real world-space transformation of a node (not relative to parent)
-	Matrix4x4 AbsoluteTransform(int node) { return mTemplate.GetMesh().AbsoluteMatrix(mTransforms, node); }
+	// Uses the same kept matrices as rendering, see WorldTransforms
+	Matrix4x4 AbsoluteTransform(int node) { return WorldTransforms()[node]; }
+
+	// The world-space matrices of every node of the entity's mesh (NodeCount() matrices), used for rendering, picking and the
+	// function above. They are kept between calls, and only nodes whose matrix or an ancestor's matrix has changed since the last
+	// call are recalculated. Changes are found by comparing with the matrices last used, since Transform returns references that
+	// can be written at any time. This updates the kept matrices, so during a parallel Update (see CanUpdateInParallel) only call
+	// it for the entity being updated
+	const Matrix4x4* WorldTransforms();
 
+	// The level of detail the entity is currently rendered with (see EntityTemplate), and the mesh for it
+	unsigned int LOD()      { return mLOD; }
+	Mesh&        LODMesh()  { return mTemplate->GetLODMesh(mLOD); }
 
-	// Direct access to the render group value for this entity. Value can be get or set. Default is 0
+	// Whether the entity is far enough away to be drawn as an impostor rather than with a mesh, see EntityTemplate::SetImpostor
+	bool UsesImpostor()  { return mImpostor; }
+
+
+	// The render group value for this entity. Default is 0. Change it with EntityManager::SetRenderGroup, which keeps the
+	// manager's list of each group's entities up to date
 	// Each entity has a render group value and the groups of entities with the same value can be rendered seperately.
 	// The meanings of the group values are for the caller to decide.
 	// An example would be to give index 0 to entities rendered with no blending and give index 1 to entities 
 	// rendered with additive blending. Then render group 0 and group 1 seperately, changing render states between
-	unsigned int& RenderGroup()   { return mRenderGroup;  }
+	unsigned int RenderGroup()   { return mRenderGroup;  }
 
 	// Direct access to the render colour for this entity. Value can be get or set.
 	ColourRGBA& RenderColour()  { return mRenderColour; }
@@ -167,34 +299,95 @@ public:
 	// Update the entity including message processing for each entity
 	// Virtual function, inherited classes should override this with their own processing
 	// ***Entity Update functions should return false if the entity is to be destroyed***
+	// Entity classes that don't override this function are treated as static by the EntityManager and never updated
 	virtual bool Update(float frameTime);
 
-	// Render the entity's geometry
-	void Render();
+	// Return true if this entity's Update function is safe to run on a worker thread at the same time as other entities of
+	// this kind (see EntityManager::SetJobSystem). Such an Update function may only:
+	//   - change this entity's own data
+	//   - read other entities (including looking them up by ID or using EntityManager::View), but not change them
+	//   - send messages with gMessenger->DeliverMessage, and return false to be destroyed
+	// It must not create or destroy entities, receive messages, use Random or use any static/global state that can change.
+	// The EntityManager checks this once when the entity is created. Default is false - update on the main thread
+	virtual bool CanUpdateInParallel()  { return false; }
+
+	// Render the entity's geometry. If a frustum is given then parts of the mesh outside it are skipped. Test the whole entity
+	// with GetWorldBoundingSphere first to skip entities that are entirely outside it
+	void Render(const Frustum* cullFrustum = nullptr);
+
+	// Render only the entity's geometry with the shaders already set on the GPU, passing the given colour to them as the per-mesh
+	// colour (see Mesh::RenderGeometry)
+	void RenderGeometry(ColourRGBA colour);
+
+	// As Render, but the draws are added to a render queue to be sorted and rendered later, see Mesh::QueueRender
+	void QueueRender(RenderQueue& queue, const Frustum* cullFrustum = nullptr);
+
+	// Write the entity's world matrices into a batch of instances of its mesh for instanced rendering, see Mesh::WriteInstanceMatrices
+	void WriteInstanceMatrices(Matrix4x4* batch, unsigned int instance, unsigned int numInstances);
+
+	// Sphere enclosing the entity in world space, from its mesh's bounding sphere and its root matrix, see Mesh::GetBoundingSphere
+	BoundingSphere GetWorldBoundingSphere();
+
+	// Choose the level of detail to render the entity with, from its size on screen when seen from the given camera position.
+	// The projection scale is the camera projection matrix's Y scale (e11), relating distance to size on screen. Also chooses
+	// whether to draw the entity as an impostor. Call ResetLOD to return to the main mesh
+	void SelectLOD(const Vector3& cameraPosition, float projectionScale);
+	void ResetLOD()  { mLOD = 0;  mImpostor = false; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Move the entity to another template of the same type, when the one it was created with was a stand-in for a template still
+	// loading (see EntityManager::CreateEntity). The node matrices are made again for the new mesh, from its defaults. Only the
+	// entity manager calls this, it moves the entity between the templates' lists
+	void ReplaceTemplate(EntityTemplate& entityTemplate);
+
+	// Get space for the node matrices of the template's main mesh from the transform store and set them to the mesh's defaults
+	void AllocateNodeTransforms();
 
 
 	/*-----------------------------------------------------------------------------------------
 	   Private Data
 	-----------------------------------------------------------------------------------------*/
 private:
-	// The template used by this entity - the common data for all entities of this type
-	EntityTemplate& mTemplate;
+	// The template used by this entity - the common data for all entities of this type. Only changes in ReplaceTemplate
+	EntityTemplate* mTemplate;
 
 	// Unique identifier for the entity
 	EntityID mID;
 
-	// Name for the entity, can be empty "" and does not need to be unique
-	std::string mName;
+	// Set by the TaggedType bases of the entity's class, see TypeTag.h
+	TypeMask mTypeMask = 0;
+
+	// Name for the entity, can be empty "" and does not need to be unique. An atom so the name lookup never hashes the text
+	Atom mName;
 
-	// Transformation matrices that position this entity. mTransforms[0] is the world matrix for the entire model. The remaining transforms position sub-parts of
+	// Transformation matrices that position this entity. The root transform is the world matrix for the entire model. The node transforms position sub-parts of
 	// the model with each matrix relative to the parent part (recall animation material in 2nd year Graphics). The hierarchy tree is defined in the entity template -> mesh
-	std::vector<Matrix4x4> mTransforms;
+	// The matrices are held in the entity manager's transform store (see TransformStore.h), mNodeTransforms[0] is node 1 and so on. It is nullptr if the mesh has
+	// only a root node
+	TransformStore& mTransformStore;
+	Matrix4x4*      mRootTransform;
+	Matrix4x4*      mNodeTransforms;
+	unsigned int    mNumNodeTransforms;
+
+	// The world matrices of every node, followed by the matrices they were calculated from, see WorldTransforms. Also held in the
+	// transform store, nullptr if the mesh has only a root node - then the root matrix is the only world matrix
+	Matrix4x4*           mWorldTransforms;
+	bool                 mWorldTransformsValid = false;
+	std::vector<uint8_t> mChangedNodes; // Whether each node's world matrix changed in the current WorldTransforms call
 
 	// Each entity has a render group value and the groups of entities with the same value can be rendered seperately.
 	unsigned int mRenderGroup = 0;
 
 	// Each entity can have a custom colour
 	ColourRGBA mRenderColour = { 1, 1, 1, 1 };
+
+	// The template level of detail the entity is rendered with, see SelectLOD
+	unsigned int mLOD = 0;
+	bool mImpostor = false;
 };
 
 
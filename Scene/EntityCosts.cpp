@@ -0,0 +1,130 @@
+//--------------------------------------------------------------------------------------
+// Entity costs - CPU time of updating and rendering each type of entity, frame by frame
+//--------------------------------------------------------------------------------------
+
+#include "EntityCosts.h"
+#include "EntityManager.h"
+#include "CpuProfiler.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+
+
+// Name of a cost type for display
+const char* CostTypeName(CostType type)
+{
+	static const char* const names[] = { "Boat", "Missile", "SeaMine", "Crate", "Shield", "Other" };
+	static_assert(std::size(names) == NUM_COST_TYPES, "Add a name for each cost type");
+
+	int index = static_cast<int>(type);
+	return (index >= 0 && index < NUM_COST_TYPES) ? names[index] : "Unknown";
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Keep the costs added since the last call as the last frame
+void EntityCosts::NextFrame()
+{
+	auto mostExpensiveFirst = [](const EntityCost& a, const EntityCost& b) { return a.ticks > b.ticks; };
+	std::sort(mCollecting.topUpdate.begin(), mCollecting.topUpdate.end(), mostExpensiveFirst);
+	std::sort(mCollecting.topRender.begin(), mCollecting.topRender.end(), mostExpensiveFirst);
+	std::swap(mLastFrame, mCollecting);
+
+	// Start again, keeping the capacity of the top lists
+	mCollecting.update = {};
+	mCollecting.render = {};
+	mCollecting.topUpdate.clear();
+	mCollecting.topRender.clear();
+	mCollecting.batchedRender = 0;
+}
+
+
+// Draw the last frame in the current ImGui window: the types with their update and render times, then the most expensive
+// entities by name
+void EntityCosts::Draw(EntityManager& entities)
+{
+	bool enabled = IsEnabled();
+	if (ImGui::Checkbox("Time Entities", &enabled))  SetEnabled(enabled);
+	if (!enabled)  return;
+
+	const Frame& frame = mLastFrame;
+	auto ms = [](int64_t ticks) { return CpuProfiler::TicksToMilliseconds(ticks); };
+	if (ImGui::BeginTable("Entity Costs", 9, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		for (const char* heading : { "Type", "Updates", "Update ms", "Avg us", "Max us", "Renders", "Render ms", "Avg us", "Max us" })
+			ImGui::TableSetupColumn(heading);
+		ImGui::TableHeadersRow();
+
+		TypeCost updateTotal, renderTotal;
+		auto row = [&](const char* name, const TypeCost& update, const TypeCost& render)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();  ImGui::TextUnformatted(name);
+			for (const TypeCost* cost : { &update, &render })
+			{
+				ImGui::TableNextColumn();  ImGui::Text("%u", cost->count);
+				ImGui::TableNextColumn();  ImGui::Text("%.3f", ms(cost->total));
+				ImGui::TableNextColumn();  ImGui::Text("%.1f", cost->count > 0 ? ms(cost->total) * 1000 / cost->count : 0.0);
+				ImGui::TableNextColumn();  ImGui::Text("%.1f", ms(cost->max) * 1000);
+			}
+		};
+		for (int type = 0; type < NUM_COST_TYPES; ++type)
+		{
+			row(CostTypeName(static_cast<CostType>(type)), frame.update[type], frame.render[type]);
+			for (auto [total, cost] : { std::pair{ &updateTotal, &frame.update[type] }, std::pair{ &renderTotal, &frame.render[type] } })
+			{
+				total->count += cost->count;
+				total->total += cost->total;
+				total->max = std::max(total->max, cost->max);
+			}
+		}
+		row("All", updateTotal, renderTotal);
+		ImGui::EndTable();
+	}
+	ImGui::Text("Batched draws: %.3fms", ms(frame.batchedRender));
+
+	// Entities destroyed since the frame are listed by ID
+	auto drawTop = [&](const char* title, const std::vector<EntityCost>& top)
+	{
+		ImGui::TextUnformatted(title);
+		for (const EntityCost& cost : top)
+		{
+			Entity* entity = entities.GetEntity(cost.id);
+			if (entity != nullptr)  ImGui::Text("  %7.1fus  %-8s %s", ms(cost.ticks) * 1000, CostTypeName(cost.type), entity->GetName().c_str());
+			else                    ImGui::Text("  %7.1fus  %-8s #%u", ms(cost.ticks) * 1000, CostTypeName(cost.type), cost.id);
+		}
+	};
+	drawTop("Most expensive updates:", frame.topUpdate);
+	drawTop("Most expensive renders:", frame.topRender);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Add a cost to the type totals and to the most expensive entities if it is among them
+void EntityCosts::Add(std::array<TypeCost, NUM_COST_TYPES>& types, std::vector<EntityCost>& top, const EntityCost& cost)
+{
+	TypeCost& type = types[static_cast<int>(cost.type)];
+	++type.count;
+	type.total += cost.ticks;
+	type.max = std::max(type.max, cost.ticks);
+
+	auto moreExpensive = [](const EntityCost& a, const EntityCost& b) { return a.ticks > b.ticks; }; // Heap with the cheapest at the front
+	if (top.size() < static_cast<size_t>(TOP_COUNT))
+	{
+		top.push_back(cost);
+		std::push_heap(top.begin(), top.end(), moreExpensive);
+	}
+	else if (cost.ticks > top.front().ticks)
+	{
+		std::pop_heap(top.begin(), top.end(), moreExpensive);
+		top.back() = cost;
+		std::push_heap(top.begin(), top.end(), moreExpensive);
+	}
+}
@@ -0,0 +1,121 @@
+//--------------------------------------------------------------------------------------
+// Entity costs - CPU time of updating and rendering each type of entity, frame by frame
+//--------------------------------------------------------------------------------------
+// While enabled, the EntityManager times each entity's Update in UpdateAll (on whichever thread updates it) and the work of
+// each entity in RenderGroup and RenderView: level of detail, culling, occlusion testing and its draw, or queueing the draw
+// if it is instanced or sorted. The queued draws are submitted together for many entities at once, so their time is kept
+// as a whole rather than split by type (see Frame::batchedRender).
+//
+// The times are added up by type of entity and the most expensive single entities are kept. Once a frame the main thread
+// calls NextFrame, which keeps the frame just finished for display (see Draw) and for the trace capture (see
+// Scene::UpdateTraceCapture) and starts again. A frame holds every simulation step and every view rendered since the last
+// call. Off by default, while off the update and render loops only check a flag
+//
+//   gEntityManager->Costs().SetEnabled(true);
+//   ...
+//   const EntityCosts::Frame& costs = gEntityManager->Costs().LastFrame();
+//   double boatUpdate = CpuProfiler::TicksToMilliseconds(costs.update[int(CostType::Boat)].total);
+
+#ifndef _ENTITY_COSTS_H_INCLUDED_
+#define _ENTITY_COSTS_H_INCLUDED_
+
+#include "EntityTypes.h"
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+
+class EntityManager;
+
+// The types of entity costs are added up by. Entities of other types (scenery, obstacles, reload stations...) are Other
+enum class CostType : uint8_t
+{
+	Boat,
+	Missile,
+	SeaMine,
+	Crate,
+	Shield,
+	Other,
+};
+constexpr int NUM_COST_TYPES = 6;
+
+// Name of a cost type for display, e.g. "SeaMine"
+const char* CostTypeName(CostType type);
+
+
+class EntityCosts
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Most expensive entities kept for each of update and render
+	static constexpr int TOP_COUNT = 8;
+
+	// The cost of one type of entity in a frame. Times are clock ticks, see CpuProfiler::TicksToMilliseconds
+	struct TypeCost
+	{
+		uint32_t count = 0; // Updates or renders, an entity rendered in two views counts twice
+		int64_t  total = 0;
+		int64_t  max   = 0;
+	};
+
+	struct EntityCost
+	{
+		EntityID id;
+		CostType type;
+		int64_t  ticks;
+	};
+
+	struct Frame
+	{
+		std::array<TypeCost, NUM_COST_TYPES> update;
+		std::array<TypeCost, NUM_COST_TYPES> render;
+		std::vector<EntityCost> topUpdate; // Most expensive first
+		std::vector<EntityCost> topRender;
+		int64_t batchedRender = 0;         // Submitting instanced and sorted draws
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether entities are timed. Off by default. Change outside UpdateAll and rendering
+	void SetEnabled(bool enabled)  { mEnabled = enabled; }
+	bool IsEnabled() const         { return mEnabled; }
+
+	// Add the time of one entity's update or render. Called by the EntityManager on the thread running UpdateAll or rendering,
+	// times from worker threads are gathered and added once the workers have finished
+	void AddUpdate(EntityID id, CostType type, int64_t ticks)  { Add(mCollecting.update, mCollecting.topUpdate, { id, type, ticks }); }
+	void AddRender(EntityID id, CostType type, int64_t ticks)  { Add(mCollecting.render, mCollecting.topRender, { id, type, ticks }); }
+	void AddBatchedRender(int64_t ticks)                       { mCollecting.batchedRender += ticks; }
+
+	// Keep the costs added since the last call as the last frame, call once a frame on the main thread outside UpdateAll and
+	// rendering
+	void NextFrame();
+
+	// The last frame kept
+	const Frame& LastFrame() const  { return mLastFrame; }
+
+	// Draw the last frame in the current ImGui window: a table of the types with their update and render times, then the
+	// most expensive entities by name
+	void Draw(EntityManager& entities);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Add a cost to the type totals and to the most expensive entities if it is among them. The top list is kept as a
+	// min-heap while collecting, so the cheapest of them is the one replaced
+	static void Add(std::array<TypeCost, NUM_COST_TYPES>& types, std::vector<EntityCost>& top, const EntityCost& cost);
+
+	bool  mEnabled = false;
+	Frame mCollecting;
+	Frame mLastFrame;
+};
+
+
+#endif //_ENTITY_COSTS_H_INCLUDED_
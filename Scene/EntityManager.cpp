@@ -8,6 +8,295 @@
 // Certain rendering settings can be applied at a per-entity level, e.g. transparency, or tint colour
 
 #include "EntityManager.h"
+#include "SceneGlobals.h"
+#include "JobSystem.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include "OcclusionCuller.h"
+#include "GpuCuller.h"
+#include "ImpostorRenderer.h"
+#include "DXDevice.h"
+#include "RenderGlobals.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <limits>
+#include <functional>
+#include <tuple>
+#include <chrono>
+#include <fstream>
+
+
+//--------------------------------------------------------------------------------------
+// Templates Loaded When Needed
+//--------------------------------------------------------------------------------------
+
+// Register an entity template that is only constructed when it is first needed (by CreateEntity or GetTemplate), or in the
+// background after PrefetchTemplate. Replaces any template of the same type that hasn't been constructed yet. The bounds, if
+// known, size the template's stand-in
+void EntityManager::RegisterEntityTemplate(Atom type, TemplateFactory create, TemplateBounds bounds)
+{
+	CancelPendingTemplate(type);
+	auto& pending = mPendingTemplates[type];
+	pending.create   = std::move(create);
+	pending.bounds   = bounds;
+	pending.streamed = mProxyTemplates.contains(type); // Entities are still waiting with a stand-in from an earlier registration
+}
+
+
+// Start constructing the given registered template on a background thread. The meshes and textures are created with the
+// device, which is thread-safe, but some texture loading uses the immediate context, so that is made thread-safe while the
+// template loads. Rendering carries on meanwhile
+void EntityManager::PrefetchTemplate(Atom type)
+{
+	auto pending = mPendingTemplates.find(type);
+	if (pending == mPendingTemplates.end() || pending->second.load.valid())  return;
+	if (DX != nullptr && !DX->SetContextThreadSafe(true))  return;
+
+	pending->second.load = std::async(std::launch::async, [create = pending->second.create]()
+	{
+		TemplateLoadResult result;
+		try
+		{
+			result.entityTemplate = create();
+		}
+		catch (const std::runtime_error& e)
+		{
+			result.error = e.what();
+		}
+		return result;
+	});
+}
+
+
+// Returns true while the given template is being constructed on a background thread after PrefetchTemplate
+bool EntityManager::IsTemplateLoading(Atom type)
+{
+	auto pending = mPendingTemplates.find(type);
+	if (pending == mPendingTemplates.end() || !pending->second.load.valid())  return false;
+	return pending->second.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+
+// Construct a registered template and add it to the templates, waiting for it if it is being prefetched. Returns false if there
+// is no such template or it fails to load, with the last error set
+bool EntityManager::LoadPendingTemplate(Atom type)
+{
+	auto pending = mPendingTemplates.find(type);
+	if (pending == mPendingTemplates.end())
+	{
+		mLastError = "Entity Manager: Cannot find entity template '" + type.str() + "'";
+		return false;
+	}
+
+	TemplateLoadResult result;
+	if (pending->second.load.valid())
+	{
+		result = pending->second.load.get();
+		if (DX != nullptr)  DX->SetContextThreadSafe(false);
+	}
+	else
+	{
+		try
+		{
+			result.entityTemplate = pending->second.create();
+		}
+		catch (const std::runtime_error& e)
+		{
+			result.error = e.what();
+		}
+	}
+	mPendingTemplates.erase(pending);
+
+	// A template that fails to load is forgotten, as if it had failed when the level was loaded. Entities waiting for it with
+	// a stand-in are moved to it, or destroyed if it failed
+	if (result.entityTemplate == nullptr)
+	{
+		mLastError = result.error;
+		ReplaceProxyTemplate(type);
+		return false;
+	}
+	AddEntityTemplate(type, std::move(result.entityTemplate));
+	ReplaceProxyTemplate(type);
+	return true;
+}
+
+
+// Remove a registered template that hasn't been constructed, waiting for it first if it is being prefetched
+void EntityManager::CancelPendingTemplate(Atom type)
+{
+	auto pending = mPendingTemplates.find(type);
+	if (pending == mPendingTemplates.end())  return;
+	if (pending->second.load.valid())
+	{
+		pending->second.load.wait();
+		if (DX != nullptr)  DX->SetContextThreadSafe(false);
+	}
+	mPendingTemplates.erase(pending);
+}
+
+
+// Construct every registered template that hasn't been yet, prefetching them all so they load in parallel. Returns the number
+// that failed to load
+size_t EntityManager::ConstructAllTemplates()
+{
+	std::vector<Atom> types;
+	for (auto& [type, pending] : mPendingTemplates)  types.push_back(type);
+	for (Atom type : types)  PrefetchTemplate(type);
+
+	size_t failed = 0;
+	for (Atom type : types)
+	{
+		if (!LoadPendingTemplate(type))  ++failed;
+	}
+	return failed;
+}
+
+
+// Add the templates whose prefetch has finished, so the context stops being thread-safe as soon as possible
+void EntityManager::CollectPrefetchedTemplates()
+{
+	for (auto pending = mPendingTemplates.begin(); pending != mPendingTemplates.end(); )
+	{
+		auto& load = pending->second.load;
+		bool finished = load.valid() && load.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		auto type = (pending++)->first; // Move on first, loading the template removes it from the map
+		if (finished)  LoadPendingTemplate(type);
+	}
+
+	StartStreamingLoads();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Template Streaming
+//--------------------------------------------------------------------------------------
+
+// The stand-in template for a registered template that hasn't been constructed, so an entity can be created without waiting for
+// it. Returns nullptr if the template is constructed or not registered, or if streaming is off (always without a D3D device, so
+// headless runs stay deterministic). The template is loaded by StartStreamingLoads
+EntityTemplate* EntityManager::ProxyTemplate(Atom type)
+{
+	if (!mTemplateStreaming || DX == nullptr || mEntityTemplates.contains(type))  return nullptr;
+	auto pending = mPendingTemplates.find(type);
+	if (pending == mPendingTemplates.end())  return nullptr;
+
+	auto& proxy = mProxyTemplates[type];
+	if (proxy == nullptr)
+	{
+		// A box the size of the template's mesh if its bounds were given when it was registered (read from its mesh cache),
+		// otherwise the real bounds aren't known until the mesh is imported and the stand-in is the same small box as others
+		try
+		{
+			const TemplateBounds& bounds = pending->second.bounds;
+			if (bounds.known)
+			{
+				proxy = std::make_unique<EntityTemplate>(type.str(), std::make_shared<Mesh>(bounds.boundsMin, bounds.boundsMax, PROXY_COLOUR));
+			}
+			else
+			{
+				if (mProxyMesh == nullptr)
+				{
+					mProxyMesh = std::make_shared<Mesh>(Vector3{ -PROXY_HALF_SIZE, -PROXY_HALF_SIZE, -PROXY_HALF_SIZE },
+					                                    Vector3{  PROXY_HALF_SIZE,  PROXY_HALF_SIZE,  PROXY_HALF_SIZE }, PROXY_COLOUR);
+				}
+				proxy = std::make_unique<EntityTemplate>(type.str(), mProxyMesh);
+			}
+		}
+		catch (const std::runtime_error&)
+		{
+			mProxyTemplates.erase(type);
+			return nullptr; // Wait for the real template instead
+		}
+	}
+	pending->second.streamed = true;
+	return proxy.get();
+}
+
+
+// Move the entities of a type's stand-in template to the template now it has been constructed, or destroy them if there is still
+// no template (it failed to load or was removed). Then the stand-in is deleted
+void EntityManager::ReplaceProxyTemplate(Atom type)
+{
+	auto proxy = mProxyTemplates.find(type);
+	if (proxy == mProxyTemplates.end())  return;
+	auto proxyTemplate = proxy->second.get();
+
+	auto found = mEntityTemplates.find(type);
+	if (found == mEntityTemplates.end())
+	{
+		// Flush immediately, as DestroyEntityTemplate does, since the entities can't outlive their template. During the update
+		// phase or a flush (a template constructed when first used by an update) they are destroyed with the rest of the kill
+		// list instead, and the stand-in is kept until then (see FlushDestroyedEntities)
+		for (auto id : proxyTemplate->mEntities)  QueueDestroy(id);
+		if (mUpdating || mFlushing)
+		{
+			mDeferredProxies.push_back(type);
+			return;
+		}
+		FlushDestroyedEntities();
+	}
+	else
+	{
+		// The entity keeps its slot and lists, its template and node matrices are changed (see Entity::ReplaceTemplate). It is
+		// taken out of its render group and put back so static lists and batches see the new mesh
+		EntityTemplate& entityTemplate = *found->second;
+		for (auto id : proxyTemplate->mEntities)
+		{
+			EntitySlot& slot = mSlots[EntityIndex(id)];
+			Entity* entity = slot.entity.get();
+			RemoveFromRenderGroup(entity);
+			entity->ReplaceTemplate(entityTemplate);
+			slot.templateIndex = static_cast<uint32_t>(entityTemplate.mEntities.size());
+			entityTemplate.mEntities.push_back(id);
+			AddToRenderGroup(entity);
+		}
+		proxyTemplate->mEntities.clear();
+	}
+	mProxyTemplates.erase(proxy);
+}
+
+
+// Start loading the templates that entities are waiting for with a stand-in, those with an entity nearest the LOD camera first,
+// with at most MAX_STREAMING_LOADS running at once. Prefetches that were hinted (see PrefetchTemplate) count towards the limit
+void EntityManager::StartStreamingLoads()
+{
+	if (mProxyTemplates.empty())  return;
+
+	unsigned int numLoading = 0;
+	std::vector<std::pair<float, Atom>> waiting;
+	for (auto& [type, pending] : mPendingTemplates)
+	{
+		if (pending.load.valid())
+		{
+			++numLoading;
+		}
+		else if (pending.streamed)
+		{
+			float nearest = std::numeric_limits<float>::max();
+			auto proxy = mProxyTemplates.find(type);
+			if (proxy != mProxyTemplates.end())
+			{
+				for (auto id : proxy->second->mEntities)
+				{
+					Entity* entity = FindEntity(id);
+					if (entity != nullptr)  nearest = std::min(nearest, Distance(entity->Transform().Position(), mLODCameraPosition));
+				}
+			}
+			waiting.emplace_back(nearest, type);
+		}
+	}
+	std::sort(waiting.begin(), waiting.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+	for (auto& [distance, type] : waiting)
+	{
+		if (numLoading >= MAX_STREAMING_LOADS)  break;
+		PrefetchTemplate(type);
+		if (mPendingTemplates[type].load.valid())  ++numLoading;
+		else                                       LoadPendingTemplate(type); // The context can't be made thread-safe, load it now
+	}
+}
 
 
 //--------------------------------------------------------------------------------------
@@ -18,73 +307,1159 @@
 // Entity templates can use a lot of memory (meshes and textures) so they should be released when possible, but watch out
 // for the implications of all their entities being destroyed
 // Returns true on success, false if there is no entity template with the given type
-bool EntityManager::DestroyEntityTemplate(std::string type)
+bool EntityManager::DestroyEntityTemplate(Atom type)
 {
-	// Check that requested entity template exists
-	if (!mEntityTemplates.contains(type))  return false;
+	// During the update phase or a flush the template's entities may be in the middle of being updated or destroyed, so the
+	// template is destroyed once the update and flush have finished (see FlushDestroyedEntities)
+	if (mUpdating || mFlushing)
+	{
+		if (!mPendingTemplates.contains(type) && !mEntityTemplates.contains(type))  return false;
+		mDeferredTemplates.push_back(type);
+		return true;
+	}
 
-	// Destroy all the entities referring to this template
-	auto entityTemplate = mEntityTemplates[type].get();
-	while (entityTemplate->mEntities.size() > 0) // Can't use a for loop as we are destroying the container we are looping through, instead repeatedly remove last item
+	// A template that hasn't been constructed has no entities of its own, it just needs to be removed
+	if (mPendingTemplates.contains(type))
 	{
-		DestroyEntity(entityTemplate->mEntities.back());
-		entityTemplate->mEntities.pop_back();
+		CancelPendingTemplate(type);
+		ReplaceProxyTemplate(type); // Destroys any entities waiting for it with a stand-in
+		return true;
 	}
 
-	// Destroy the template
+	// Check that requested entity template exists
+	auto found = mEntityTemplates.find(type);
+	if (found == mEntityTemplates.end())  return false;
+
+	// Destroy all the entities referring to this template. Flush the destruction immediately since the entities can't outlive
+	// their template
+	auto entityTemplate = found->second.get();
+	for (auto id : entityTemplate->mEntities)  QueueDestroy(id);
+	FlushDestroyedEntities();
+
+	// Destroy the template. Its meshes are only destroyed if no other template shares them (see MeshManager)
 	mEntityTemplates.erase(type);
+	mTemplatesVersion = NextTemplatesVersion();
 	return true;
 }
 
-// Destroy the entity with the given ID. Returns true on success, false if there isn't an entity with this ID
+// Destroy the entity with the given ID. Returns true on success, false if there isn't an entity with this ID (or it is already
+// due to be destroyed). During UpdateAll the destruction is deferred until all entities have been updated, see header file
 bool EntityManager::DestroyEntity(EntityID id)
 {
-	// Check that requested entity exists
-	if (!mEntities.contains(id))  return false;
+	if (!QueueDestroy(id))  return false;
+
+	if (!mUpdating)  FlushDestroyedEntities();
+	return true;
+}
+
+
+// Destroy all entities on the kill list. Called at the end of the update phase, or immediately when outside the update phase.
+// Then destroy any templates whose destruction was put off until after the update phase or flush
+void EntityManager::FlushDestroyedEntities()
+{
+	// A flush started while destroying the batch (e.g. from an entity destructor) leaves its entities on the kill list for
+	// the loop below, so the batch isn't swapped out while it is being destroyed
+	if (mFlushing)  return;
+	mFlushing = true;
+
+	// Entity destructors might destroy other entities, which adds them to the kill list. So swap the list out and repeat
+	// until it stays empty. The two lists are swapped rather than copied so neither loses its allocated capacity
+	while (!mKillList.empty())
+	{
+		std::swap(mKillList, mKillBatch);
+
+		// Remove the entire batch from the typed registries first, a single pass over each registry however many entities are
+		// being destroyed (which also keeps the registries in creation order)
+		RemoveDestroyedFromRegistries();
+
+		for (auto id : mKillBatch)  DestroyEntityNow(id);
+		mKillBatch.clear();
+	}
+	mFlushing = false;
+
+	if (mUpdating)  return;
+	while (!mDeferredTemplates.empty())
+	{
+		Atom type = mDeferredTemplates.back();
+		mDeferredTemplates.pop_back();
+		DestroyEntityTemplate(type); // Returns false if it was already destroyed by an earlier request
+	}
+	while (!mDeferredProxies.empty())
+	{
+		Atom type = mDeferredProxies.back();
+		mDeferredProxies.pop_back();
+		if (!mPendingTemplates.contains(type))  ReplaceProxyTemplate(type); // Kept if the template was registered again
+	}
+}
+
+
+// Mark an entity for destruction and add it to the kill list. Returns false if the entity doesn't exist or is already marked
+bool EntityManager::QueueDestroy(EntityID id)
+{
+	Entity* entity = FindEntity(id);
+	if (entity == nullptr)  return false;
+
+	EntitySlot& slot = mSlots[EntityIndex(id)];
+	if (slot.destroyPending)  return false;
 
-	// Remove entity from template collection of entities *UPDATE*
-	auto& templateEntities = GetEntity(id)->Template().mEntities;
-	auto removeEnd = std::remove(templateEntities.begin(), templateEntities.end(), id);
-	templateEntities.erase(removeEnd, templateEntities.end());
+	slot.destroyPending = true;
+	mKillList.push_back(id);
 
-	mEntities.erase(id);
+	// Attached children go with their parent, and their own children with them. Queueing doesn't change the attachment list
+	for (size_t i = 0; i < mAttachOrder.size(); ++i)
+	{
+		const Attachment& attachment = mAttachments[mAttachOrder[i]];
+		if (attachment.parent == id)  QueueDestroy(attachment.owner);
+	}
 	return true;
 }
 
 
+// Remove an entity from all the manager's lists and delete it. The entity must already have been removed from the typed registries
+void EntityManager::DestroyEntityNow(EntityID id)
+{
+	EntitySlot& slot = mSlots[EntityIndex(id)];
+	Entity* entity = slot.entity.get();
+
+	RemoveFromNameIndex(entity);
+	mSpatialGrid.Remove(entity);
+	mTriggers.Remove(entity);
+	mBobbing.Remove(entity);
+	mBoatData.Remove(id);
+	mBehaviours.Stop(id);
+	mReloads.Remove(id);
+	mReservations.Remove(id);
+	Detach(id);
+
+	// Remove entity from template collection of entities by moving the template's last entity into the gap *UPDATE*
+	auto& templateEntities = entity->Template().mEntities;
+	EntityID lastTemplateEntity = templateEntities.back();
+	templateEntities[slot.templateIndex] = lastTemplateEntity;
+	mSlots[EntityIndex(lastTemplateEntity)].templateIndex = slot.templateIndex;
+	templateEntities.pop_back();
+
+	// Remove from the live entity list in the same way
+	Entity* lastEntity = mLiveEntities.back();
+	mLiveEntities[slot.liveIndex] = lastEntity;
+	mSlots[EntityIndex(lastEntity->GetID())].liveIndex = slot.liveIndex;
+	mLiveEntities.pop_back();
+
+	// And from the update list if it has one
+	if (!slot.isStatic)
+	{
+		Entity* lastUpdateEntity = mUpdateEntities.back();
+		mUpdateEntities[slot.updateIndex] = lastUpdateEntity;
+		mSlots[EntityIndex(lastUpdateEntity->GetID())].updateIndex = slot.updateIndex;
+		mUpdateEntities.pop_back();
+	}
+	RemoveFromRenderGroup(entity);
+
+	// Free the slot before the entity is deleted (at the end of this function), in case its destructor uses the entity manager
+	std::unique_ptr<Entity> destroyedEntity = std::move(slot.entity);
+	slot.destroyPending = false;
+	ReleaseSlot(EntityIndex(id));
+	++mNumDestroyed;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Memory Report
+//--------------------------------------------------------------------------------------
+
+// The memory used by every constructed template's meshes (all levels of detail) and their materials
+std::vector<EntityManager::TemplateMemory> EntityManager::GetTemplateMemory()
+{
+	std::vector<TemplateMemory> report;
+	report.reserve(mEntityTemplates.size());
+	for (auto& [type, entityTemplate] : mEntityTemplates)
+	{
+		TemplateMemory& templateMemory = report.emplace_back();
+		templateMemory.type     = type.str();
+		templateMemory.entities = static_cast<uint32_t>(entityTemplate->Entities().size());
+		templateMemory.lods     = entityTemplate->LODCount();
+		for (unsigned int lod = 0; lod < entityTemplate->LODCount(); ++lod)  entityTemplate->GetLODMesh(lod).AddMemory(templateMemory.memory);
+	}
+	return report;
+}
+
+
+// Write a template memory report to a CSV file, one row for each template
+bool EntityManager::ExportTemplateMemory(const std::vector<TemplateMemory>& report, const std::string& fileName)
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << "Template,Entities,LODs,VertexBytes,IndexBytes,TextureBytes,ConstantBytes,GpuBytes,CpuBytes,RenderStates\n";
+	for (const TemplateMemory& row : report)
+	{
+		const MeshMemory& memory = row.memory;
+		file << '"' << row.type << "\"," << row.entities << ',' << row.lods << ',' << memory.vertexBytes << ',' << memory.indexBytes << ','
+		     << memory.textureBytes << ',' << memory.constantBytes << ',' << memory.GpuBytes() << ',' << memory.cpuBytes << ','
+		     << memory.renderStates << '\n';
+	}
+	return static_cast<bool>(file);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Access
+//--------------------------------------------------------------------------------------
+
+// Change the name of the given entity, keeping the name lookup table up to date. Returns false if there is no entity with this ID
+bool EntityManager::RenameEntity(EntityID id, Atom newName)
+{
+	Entity* entity = FindEntity(id);
+	if (entity == nullptr)  return false;
+
+	RemoveFromNameIndex(entity);
+	entity->mName = newName;
+	AddToNameIndex(entity);
+	++mBoatListVersion; // Boat names are held by lists of boats
+	return true;
+}
+
+
+// Change the render group of the given entity, moving it to the new group's list. Returns false if there is no entity with this ID
+bool EntityManager::SetRenderGroup(EntityID id, unsigned int group)
+{
+	Entity* entity = FindEntity(id);
+	if (entity == nullptr)  return false;
+	if (entity->mRenderGroup == group)  return true;
+
+	RemoveFromRenderGroup(entity);
+	entity->mRenderGroup = group;
+	AddToRenderGroup(entity);
+	return true;
+}
+
+
+// The templates of the entities in the given render group, each once
+std::vector<EntityTemplate*> EntityManager::GroupTemplates(unsigned int group)
+{
+	std::vector<EntityTemplate*> templates;
+	if (group >= mRenderGroups.size())  return templates;
+
+	std::unordered_set<EntityTemplate*> found;
+	for (auto entities : { &mRenderGroups[group].staticEntities, &mRenderGroups[group].movingEntities })
+	{
+		for (Entity* entity : *entities)
+		{
+			if (found.insert(&entity->Template()).second)  templates.push_back(&entity->Template());
+		}
+	}
+	return templates;
+}
+
+
+// Put every static entity back in the grid cell it is now in and rebuild all the static batches before the next render
+void EntityManager::RebuildStaticBatches()
+{
+	for (auto& groupList : mRenderGroups)  groupList.batches.Rebuild();
+}
+
+
+// Number of static entities drawn by the static batches, across all render groups
+uint32_t EntityManager::GetNumStaticBatched()
+{
+	uint32_t numBatched = 0;
+	for (auto& groupList : mRenderGroups)  numBatched += groupList.batches.NumBatchedEntities();
+	return numBatched;
+}
+
+
+// Attach an entity to another, see the header. Returns false if either doesn't exist or the attachment would make a loop
+bool EntityManager::Attach(EntityID child, EntityID parent, const Matrix4x4& local)
+{
+	if (child == parent || FindEntity(child) == nullptr || FindEntity(parent) == nullptr)  return false;
+	for (EntityID ancestor = GetParent(parent); ancestor != NO_ID; ancestor = GetParent(ancestor))
+	{
+		if (ancestor == child)  return false;
+	}
+
+	uint32_t index = EntityIndex(child);
+	if (index >= mAttachments.size())  mAttachments.resize(index + 1);
+	Attachment& attachment = mAttachments[index];
+	if (attachment.owner != child)  mAttachOrder.push_back(index);
+	attachment = { child, parent, local };
+	mAttachOrderChanged = true; // A new child or a change of parent can change the depths
+
+	// An attached static entity moves with its parent so can't stay in the static batches
+	Entity* entity = FindEntity(child);
+	if (entity->mRenderGroup < mRenderGroups.size())  mRenderGroups[entity->mRenderGroup].batches.Refresh(entity);
+	return true;
+}
+
+
+// Detach an entity from its parent, leaving it where it is. Returns false if it isn't attached
+bool EntityManager::Detach(EntityID child)
+{
+	uint32_t index = EntityIndex(child);
+	if (index >= mAttachments.size() || mAttachments[index].owner != child)  return false;
+
+	// Removing an entry keeps the rest in order. Its own children (if any) are now children of an unattached entity, so the
+	// depths have changed
+	mAttachments[index] = Attachment();
+	mAttachOrder.erase(std::find(mAttachOrder.begin(), mAttachOrder.end(), index));
+	mAttachOrderChanged = true;
+
+	Entity* entity = FindEntity(child);
+	if (entity != nullptr && entity->mRenderGroup < mRenderGroups.size())  mRenderGroups[entity->mRenderGroup].batches.Refresh(entity);
+	return true;
+}
+
+
+// The parent an entity is attached to, NO_ID if it isn't attached
+EntityID EntityManager::GetParent(EntityID child)
+{
+	uint32_t index = EntityIndex(child);
+	if (index >= mAttachments.size() || mAttachments[index].owner != child)  return NO_ID;
+	return mAttachments[index].parent;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Private Helpers
+//--------------------------------------------------------------------------------------
+
+// Set the matrices of all attached entities from their parents. Called at the end of UpdateAll once every entity (parents
+// included) has been updated, so each child is placed from its parent's final matrix this frame
+void EntityManager::ResolveAttachments()
+{
+	// Sort parents before children. An attachment's depth is the number of attachments above it, found by following the
+	// parents - chains are short, and this is only done after attachments change
+	if (mAttachOrderChanged)
+	{
+		auto depthOf = [&](uint32_t index)
+		{
+			int depth = 0;
+			for (EntityID ancestor = GetParent(mAttachments[index].parent); ancestor != NO_ID; ancestor = GetParent(ancestor))  ++depth;
+			return depth;
+		};
+		std::sort(mAttachOrder.begin(), mAttachOrder.end(), [&](uint32_t a, uint32_t b)
+		{
+			int depthA = depthOf(a);
+			int depthB = depthOf(b);
+			return depthA != depthB ? depthA < depthB : a < b;
+		});
+		mAttachOrderChanged = false;
+	}
+
+	for (uint32_t index : mAttachOrder)
+	{
+		EntitySlot& slot = mSlots[index];
+		if (slot.destroyPending)  continue;
+
+		const Attachment& attachment = mAttachments[index];
+		Entity* parent = FindEntity(attachment.parent);
+		if (parent == nullptr)  continue;
+
+		slot.entity->Transform() = attachment.local * parent->Transform();
+		mSpatialGrid.Move(slot.entity.get());
+	}
+}
+
+
+// Add an entity to the name lookup table, unnamed entities are not added
+void EntityManager::AddToNameIndex(Entity* entity)
+{
+	if (!entity->mName.empty())  mNameIndex.emplace(entity->mName, entity->GetID());
+}
+
+// Remove an entity from the name lookup table. There may be several entities with the same name so find the one with the matching ID
+void EntityManager::RemoveFromNameIndex(Entity* entity)
+{
+	if (entity->mName.empty())  return;
+
+	auto [first, last] = mNameIndex.equal_range(entity->mName);
+	for (auto it = first; it != last; ++it)
+	{
+		if (it->second == entity->GetID())
+		{
+			mNameIndex.erase(it);
+			return;
+		}
+	}
+}
+
+// Grow the entity lists once for a batch of new entities, see the header
+void EntityManager::ReserveEntities(size_t count)
+{
+	size_t newSlots = count > mFreeSlots.size() ? count - mFreeSlots.size() : 0;
+	mSlots.reserve(mSlots.size() + newSlots);
+	mLiveEntities.reserve(mLiveEntities.size() + count);
+	mNameIndex.reserve(mNameIndex.size() + count);
+}
+
+// Get a free slot for a new entity and return the ID that refers to it. Returns NO_ID if all slots are in use
+EntityID EntityManager::AllocateID()
+{
+	uint32_t index;
+	if (!mFreeSlots.empty())
+	{
+		index = mFreeSlots.front();
+		mFreeSlots.pop_front();
+	}
+	else
+	{
+		if (mSlots.size() > ENTITY_INDEX_MASK)  return NO_ID;
+		index = static_cast<uint32_t>(mSlots.size());
+		mSlots.emplace_back();
+	}
+	return MakeEntityID(index, mSlots[index].generation);
+}
+
+// Return a slot to the free list, increasing its generation so existing IDs for the slot become stale
+void EntityManager::ReleaseSlot(uint32_t index)
+{
+	mSlots[index].generation = (mSlots[index].generation + 1) & (UINT32_MAX >> ENTITY_INDEX_BITS);
+	mFreeSlots.push_back(index);
+}
+
+// Take the slot of the given ID off the free list for an entity with that ID. Returns false if the slot is in use or reserved
+bool EntityManager::ClaimID(EntityID id)
+{
+	uint32_t index = EntityIndex(id);
+	if (index < FIRST_ENTITY_ID)  return false;
+
+	// Any slots added to reach the ID's slot are free, in the order AllocateID would have added them
+	while (mSlots.size() <= index)
+	{
+		mFreeSlots.push_back(static_cast<uint32_t>(mSlots.size()));
+		mSlots.emplace_back();
+	}
+	if (mSlots[index].entity != nullptr)  return false;
+
+	// The free list only needs searching when the slot wasn't set aside by RestoreSlotTable, which is rare
+	auto freeSlot = std::find(mFreeSlots.begin(), mFreeSlots.end(), index);
+	if (freeSlot != mFreeSlots.end())  mFreeSlots.erase(freeSlot);
+	mSlots[index].generation = EntityGeneration(id);
+	return true;
+}
+
+
+// The generation of every slot and the order free slots will be reused in, see header
+EntityManager::SlotTable EntityManager::GetSlotTable()
+{
+	SlotTable table;
+	table.generations.reserve(mSlots.size());
+	for (const EntitySlot& slot : mSlots)  table.generations.push_back(slot.generation);
+	table.freeSlots.assign(mFreeSlots.begin(), mFreeSlots.end());
+	return table;
+}
+
+// Put back the slots of a slot table. Returns false (changing nothing) if a live entity's slot is free or beyond the table
+bool EntityManager::RestoreSlotTable(const SlotTable& table)
+{
+	size_t numSlots = table.generations.size();
+	if (numSlots < FIRST_ENTITY_ID || numSlots > ENTITY_INDEX_MASK + 1)  return false;
+
+	std::vector<uint8_t> isFree(numSlots, 0);
+	for (uint32_t index : table.freeSlots)
+	{
+		if (index < FIRST_ENTITY_ID || index >= numSlots)  return false;
+		isFree[index] = 1;
+	}
+	for (Entity* entity : mLiveEntities)
+	{
+		uint32_t index = EntityIndex(entity->GetID());
+		if (index >= numSlots || isFree[index])  return false;
+	}
+
+	// Slots beyond the table are empty, as every live entity is within it
+	mSlots.resize(numSlots);
+	for (size_t index = FIRST_ENTITY_ID; index < numSlots; ++index)
+	{
+		if (mSlots[index].entity == nullptr)  mSlots[index].generation = table.generations[index];
+	}
+	mFreeSlots.assign(table.freeSlots.begin(), table.freeSlots.end());
+	return true;
+}
+
+// Add an entity to the list of its render group, creating the lists up to its group if needed
+void EntityManager::AddToRenderGroup(Entity* entity)
+{
+	if (entity->mRenderGroup >= mRenderGroups.size())  mRenderGroups.resize(entity->mRenderGroup + 1);
+	RenderGroupList& groupList = mRenderGroups[entity->mRenderGroup];
+
+	EntitySlot& slot = mSlots[EntityIndex(entity->GetID())];
+	if (slot.isStatic)
+	{
+		groupList.staticEntities.push_back(entity);
+		groupList.staticDirty = true;
+		groupList.batches.Add(entity);
+		++mStaticVersion;
+	}
+	else
+	{
+		slot.groupIndex = static_cast<uint32_t>(groupList.movingEntities.size());
+		groupList.movingEntities.push_back(entity);
+	}
+}
+
+// Remove an entity from the list of its render group. Moving entities are replaced by the last in the list, static entities are
+// erased keeping the others in order, which is rare enough (obstacles, scenery) not to need an index
+void EntityManager::RemoveFromRenderGroup(Entity* entity)
+{
+	RenderGroupList& groupList = mRenderGroups[entity->mRenderGroup];
+
+	EntitySlot& slot = mSlots[EntityIndex(entity->GetID())];
+	if (slot.isStatic)
+	{
+		std::erase(groupList.staticEntities, entity);
+		groupList.batches.Remove(entity);
+		++mStaticVersion;
+	}
+	else
+	{
+		Entity* lastEntity = groupList.movingEntities.back();
+		groupList.movingEntities[slot.groupIndex] = lastEntity;
+		mSlots[EntityIndex(lastEntity->GetID())].groupIndex = slot.groupIndex;
+		groupList.movingEntities.pop_back();
+	}
+}
+
+// Sort the static entities of a render group by template if any have been added since they were last sorted
+void EntityManager::SortStaticEntities(unsigned int group)
+{
+	RenderGroupList& groupList = mRenderGroups[group];
+	if (!groupList.staticDirty)  return;
+
+	// Stable sort so entities sharing a template keep the same order each time
+	std::stable_sort(groupList.staticEntities.begin(), groupList.staticEntities.end(), [](Entity* a, Entity* b)
+	{
+		return std::less<EntityTemplate*>()(&a->Template(), &b->Template());
+	});
+	groupList.staticDirty = false;
+}
+
+// The static entities of a render group to render one at a time, rebuilding the group's batches that have changed first
+const std::vector<Entity*>& EntityManager::UnbatchedStaticEntities(unsigned int group)
+{
+	RenderGroupList& groupList = mRenderGroups[group];
+	bool resorted = groupList.staticDirty;
+	SortStaticEntities(group);
+	if (!mStaticBatching)  return groupList.staticEntities;
+
+	// The batcher waits for the GPU the first time it reads each mesh, which happens in the first render after a level loads
+	auto canBatch = [this](Entity* entity) { return GetParent(entity->GetID()) == NO_ID; };
+	if (groupList.batches.Update(mTemplatesVersion, canBatch) || resorted)
+	{
+		groupList.unbatchedEntities.clear();
+		for (Entity* entity : groupList.staticEntities)
+		{
+			if (!groupList.batches.IsBatched(entity))  groupList.unbatchedEntities.push_back(entity);
+		}
+	}
+	return groupList.unbatchedEntities;
+}
+
+// Draw the static batches of a render group visible in the frustum, if static batching is on
+void EntityManager::RenderStaticBatches(unsigned int group, const Frustum* cullFrustum)
+{
+	if (!mStaticBatching)  return;
+
+	// The batches merge many templates, so the GPU costs time them as a whole
+	bool measured = mGpuCosts.IsEnabled() && mGpuCosts.IsMeasured(nullptr);
+	if (measured)  mGpuCosts.BeginTemplate(nullptr);
+	int64_t start = mCosts.IsEnabled() ? CpuProfiler::Now() : 0;
+	auto stats = mRenderGroups[group].batches.Render(cullFrustum, mLODCameraPosition, mLODProjectionScale);
+	if (measured)  mGpuCosts.EndTemplate();
+	mRenderStats.staticBatchDraws    += stats.draws;
+	mRenderStats.staticBatchesCulled += stats.culled;
+	if (mCosts.IsEnabled())  mCosts.AddBatchedRender(CpuProfiler::Now() - start);
+}
+
+// Rebuild the obstacle tree and navigation grid if any obstacles have been created or destroyed since they were last built
+void EntityManager::RebuildObstacleTree()
+{
+	if (!mObstacleTreeDirty)  return;
+
+	mObstacleTree.Build(mObstacles);
+	mNavigation.Build(mObstacles);
+	mSensors.ClearLineOfSight();
+	mObstacleTreeDirty = false;
+}
+
+// Remove all entities that are marked for destruction from the typed registries, keeping the remaining entities in creation order
+void EntityManager::RemoveDestroyedFromRegistries()
+{
+	auto isPending = [this](Entity* entity) { return mSlots[EntityIndex(entity->GetID())].destroyPending; };
+	if (std::erase_if(mBoats,      isPending) > 0)  ++mBoatListVersion;
+	if (std::erase_if(mObstacles,  isPending) > 0)  mObstacleTreeDirty = true;
+	std::erase_if(mReloadStations, isPending);
+	std::erase_if(mCrates,         isPending);
+	std::erase_if(mMines,          isPending);
+	std::erase_if(mMissiles,       isPending);
+}
+
+
 //--------------------------------------------------------------------------------------
 // Entity Usage
 //--------------------------------------------------------------------------------------
 
 // Render all entities in a particular render group (see render group comments in Entity.h)
-void EntityManager::RenderGroup(unsigned int group)
+// If a frustum is given entities outside it are skipped, and if an occlusion culler is given moving entities hidden behind
+// static entities are skipped by the GPU
+void EntityManager::RenderGroup(unsigned int group, const Frustum* cullFrustum /*= nullptr*/, OcclusionCuller* occlusion /*= nullptr*/,
+                                DrawOrder order /*= DrawOrder::FrontToBack*/, RenderSet set /*= RenderSet::All*/)
+{
+	PROFILE_SCOPE("RenderGroup");
+	if (group < mRenderGroups.size())  RenderGroupEntities(group, cullFrustum, occlusion, order, set);
+}
+
+
+// Render all entities regardless of group, optionally culling them as above. The static entities of every group are drawn
+// before any moving entity so they are all there for the occlusion tests
+void EntityManager::RenderAll(const Frustum* cullFrustum /*= nullptr*/, OcclusionCuller* occlusion /*= nullptr*/,
+                              DrawOrder order /*= DrawOrder::FrontToBack*/)
+{
+	for (unsigned int group = 0; group < mRenderGroups.size(); ++group)
+		RenderGroupEntities(group, cullFrustum, occlusion, order, RenderSet::StaticOnly);
+	for (unsigned int group = 0; group < mRenderGroups.size(); ++group)
+		RenderGroupEntities(group, cullFrustum, occlusion, order, RenderSet::MovingOnly);
+}
+
+
+// Cull every render group against several views in one pass over the entities, keeping the visible entities of each view for
+// RenderView. The bounding sphere of each entity is found once however many views there are
+void EntityManager::CullViews(const Frustum* const* frustums, unsigned int numViews)
+{
+	PROFILE_SCOPE("CullViews");
+	mNumViews = std::min(numViews, MAX_VIEWS);
+	mViewEntities.resize(mRenderGroups.size());
+
+	for (unsigned int group = 0; group < mRenderGroups.size(); ++group)
+	{
+		auto& viewEntities = mViewEntities[group];
+		for (unsigned int view = 0; view < mNumViews; ++view)  viewEntities[view].clear();
+
+		auto cull = [&](Entity* entity)
+		{
+			BoundingSphere bounds = entity->GetWorldBoundingSphere();
+			for (unsigned int view = 0; view < mNumViews; ++view)
+			{
+				if (frustums[view]->IsSphereVisible(bounds))  viewEntities[view].push_back(entity);
+				else                                          ++mRenderStats.culled;
+			}
+		};
+		for (auto entity : UnbatchedStaticEntities(group))       cull(entity);
+		for (auto entity : mRenderGroups[group].movingEntities)  cull(entity);
+	}
+}
+
+
+// Render a group for one of the views of the last CullViews from its list of visible entities
+void EntityManager::RenderView(unsigned int group, unsigned int view, const Frustum& frustum, DrawOrder order /*= DrawOrder::FrontToBack*/)
+{
+	PROFILE_SCOPE("RenderView");
+	if (group >= mViewEntities.size() || view >= mNumViews)  return;
+
+	// The batches are culled here, CullViews only culls the entities drawn one at a time
+	RenderStaticBatches(group, &frustum);
+
+	const auto& entities = mViewEntities[group][view];
+	if (entities.empty())  return;
+	if (mCosts.IsEnabled())
+	{
+		for (auto entity : entities)
+		{
+			if (HoldBackMeasured(entity))  continue;
+			int64_t start = CpuProfiler::Now();
+			RenderCulledEntity(entity, frustum);
+			mCosts.AddRender(entity->GetID(), mSlots[EntityIndex(entity->GetID())].costType, CpuProfiler::Now() - start);
+		}
+	}
+	else
+	{
+		for (auto entity : entities)  if (!HoldBackMeasured(entity))  RenderCulledEntity(entity, frustum);
+	}
+	FlushDrawsTimed(&frustum, order);
+	RenderMeasured(&frustum, nullptr, order, true);
+}
+
+
+// Render the static then the moving entities of a render group, or only one of them
+void EntityManager::RenderGroupEntities(unsigned int group, const Frustum* cullFrustum, OcclusionCuller* occlusion, DrawOrder order,
+                                        RenderSet set)
+{
+	// Static entities first, the batches then the rest from their sorted list. They are the occluders so aren't tested. Instances
+	// and sorted draws are rendered after each list so the static occluders are all drawn before any moving entity is tested
+	RenderGroupList& groupList = mRenderGroups[group];
+	if (set != RenderSet::MovingOnly && !groupList.staticEntities.empty())
+	{
+		const auto& staticEntities = UnbatchedStaticEntities(group);
+		RenderStaticBatches(group, cullFrustum);
+		for (auto entity : staticEntities)  if (!HoldBackMeasured(entity))  RenderEntityTimed(entity, cullFrustum, nullptr);
+		FlushDrawsTimed(cullFrustum, order);
+		RenderMeasured(cullFrustum, nullptr, order, false);
+	}
+
+	if (set != RenderSet::StaticOnly && !groupList.movingEntities.empty())
+	{
+		for (auto entity : groupList.movingEntities)  if (!HoldBackMeasured(entity))  RenderEntityTimed(entity, cullFrustum, occlusion);
+		FlushDrawsTimed(cullFrustum, order);
+		RenderMeasured(cullFrustum, occlusion, order, false);
+	}
+}
+
+
+// RenderEntity, adding the time it took to the entity costs when they are enabled
+void EntityManager::RenderEntityTimed(Entity* entity, const Frustum* cullFrustum, OcclusionCuller* occlusion)
+{
+	if (!mCosts.IsEnabled())
+	{
+		RenderEntity(entity, cullFrustum, occlusion);
+		return;
+	}
+	int64_t start = CpuProfiler::Now();
+	RenderEntity(entity, cullFrustum, occlusion);
+	mCosts.AddRender(entity->GetID(), mSlots[EntityIndex(entity->GetID())].costType, CpuProfiler::Now() - start);
+}
+
+
+// FlushDraws, adding the time it took to the entity costs when they are enabled. The instanced and sorted draws are submitted
+// for many entities together so aren't split by entity
+void EntityManager::FlushDrawsTimed(const Frustum* cullFrustum, DrawOrder order)
+{
+	if (!mCosts.IsEnabled())
+	{
+		FlushDraws(cullFrustum, order);
+		return;
+	}
+	int64_t start = CpuProfiler::Now();
+	FlushDraws(cullFrustum, order);
+	mCosts.AddBatchedRender(CpuProfiler::Now() - start);
+}
+
+
+// Whether an entity is held back from its list to be drawn by RenderMeasured, adding it to the held back list if so
+bool EntityManager::HoldBackMeasured(Entity* entity)
 {
-	for (auto& [ID, entity] : mEntities)
+	if (!mGpuCosts.IsEnabled() || !mGpuCosts.IsMeasured(&entity->Template()))  return false;
+	mMeasuredList.push_back(entity);
+	return true;
+}
+
+
+// Render the entities held back by HoldBackMeasured, one template at a time between the GPU costs' timestamps. Lists keep the
+// entities of a template together, so sorting by template keeps their order within each template
+void EntityManager::RenderMeasured(const Frustum* cullFrustum, OcclusionCuller* occlusion, DrawOrder order, bool culled)
+{
+	if (mMeasuredList.empty())  return;
+	std::stable_sort(mMeasuredList.begin(), mMeasuredList.end(), [](Entity* a, Entity* b) { return &a->Template() < &b->Template(); });
+
+	for (size_t i = 0; i < mMeasuredList.size(); )
+	{
+		EntityTemplate* entityTemplate = &mMeasuredList[i]->Template();
+		mGpuCosts.BeginTemplate(entityTemplate);
+		for (; i < mMeasuredList.size() && &mMeasuredList[i]->Template() == entityTemplate; ++i)
+		{
+			if (culled)  RenderCulledEntity(mMeasuredList[i], *cullFrustum);
+			else         RenderEntityTimed(mMeasuredList[i], cullFrustum, occlusion);
+		}
+		FlushDrawsTimed(cullFrustum, order);
+		mGpuCosts.EndTemplate();
+	}
+	mMeasuredList.clear();
+}
+
+
+// Render an entity for RenderGroup / RenderAll, skipping it if it is outside the frustum and testing it for occlusion if an
+// occlusion culler is given. Entities that can be rendered instanced are only gathered here, see RenderInstances
+void EntityManager::RenderEntity(Entity* entity, const Frustum* cullFrustum, OcclusionCuller* occlusion)
+{
+	// The level of detail decides which mesh is drawn, so it is chosen first
+	if (mLevelOfDetail && mLODProjectionScale > 0)  entity->SelectLOD(mLODCameraPosition, mLODProjectionScale);
+	else                                            entity->ResetLOD();
+
+	// Impostors are drawn after the list by the impostor renderer, they are small on screen so aren't occlusion tested
+	if (UseImpostor(entity))
+	{
+		BoundingSphere bounds = entity->GetWorldBoundingSphere();
+		if (cullFrustum != nullptr && !cullFrustum->IsSphereVisible(bounds))
+		{
+			++mRenderStats.culled;
+			return;
+		}
+		if (DrawImpostor(entity, bounds))  return;
+	}
+
+	Mesh& mesh = entity->LODMesh();
+	bool instanced = mInstancedRendering && mesh.CanRenderInstanced() && (occlusion == nullptr || !occlusion->WouldTest(mesh));
+
+	if (cullFrustum == nullptr && occlusion == nullptr)
+	{
+		if (instanced)  mInstanceList.push_back(entity);
+		else            DrawEntity(entity, nullptr);
+		++mRenderStats.rendered;
+		if (entity->LOD() > 0)  ++mRenderStats.reducedDetail;
+		return;
+	}
+
+	// The GPU culler tests instanced entities itself, see RenderInstances
+	if (instanced && UseGpuCulling(cullFrustum))
+	{
+		mInstanceList.push_back(entity);
+		++mRenderStats.gpuCulled;
+		if (entity->LOD() > 0)  ++mRenderStats.reducedDetail;
+		return;
+	}
+
+	BoundingSphere bounds = entity->GetWorldBoundingSphere();
+	if (cullFrustum != nullptr && !cullFrustum->IsSphereVisible(bounds))
+	{
+		++mRenderStats.culled;
+		return;
+	}
+	if (entity->LOD() > 0)  ++mRenderStats.reducedDetail;
+
+	if (instanced)
+	{
+		mInstanceList.push_back(entity);
+		++mRenderStats.rendered;
+		return;
+	}
+
+	// An occlusion test covers the draws made before EndTest, so a tested entity is drawn now rather than queued
+	if (occlusion != nullptr && occlusion->BeginTest(EntityIndex(entity->GetID()), mesh, bounds))
+	{
+		entity->Render(cullFrustum);
+		occlusion->EndTest();
+	}
+	else
 	{
-		if (entity->RenderGroup() == group)  entity->Render();
+		DrawEntity(entity, cullFrustum);
 	}
+	++mRenderStats.rendered;
+}
+
+
+// Render an entity already found to be visible by CullViews. The frustum is still passed on so the nodes of the entity's mesh
+// (e.g. the parts of an island) are culled individually
+void EntityManager::RenderCulledEntity(Entity* entity, const Frustum& frustum)
+{
+	if (mLevelOfDetail && mLODProjectionScale > 0)  entity->SelectLOD(mLODCameraPosition, mLODProjectionScale);
+	else                                            entity->ResetLOD();
+	if (UseImpostor(entity) && DrawImpostor(entity, entity->GetWorldBoundingSphere()))  return;
+	if (entity->LOD() > 0)  ++mRenderStats.reducedDetail;
+	++mRenderStats.rendered;
+
+	if (mInstancedRendering && entity->LODMesh().CanRenderInstanced())  mInstanceList.push_back(entity);
+	else                                                                 DrawEntity(entity, &frustum);
+}
+
+
+// Reset the counts of entities rendered and culled, and those of the render queue and GPU culler
+void EntityManager::ResetRenderStats()
+{
+	mRenderStats = {};
+	mRenderQueue.ResetStats();
+	if (mGpuCuller != nullptr)  mGpuCuller->ResetStats();
+	if (mImpostorRenderer != nullptr)  mImpostorRenderer->ResetStats();
+}
+
+
+// Whether instanced entities are culled by the GPU culler when rendering with the given frustum
+bool EntityManager::UseGpuCulling(const Frustum* cullFrustum)
+{
+	return cullFrustum != nullptr && mGpuCuller != nullptr && mGpuCuller->Enabled();
+}
+
+
+// Draw an entity that isn't instanced or occlusion tested, adding it to the render queue if sorted rendering is on
+void EntityManager::DrawEntity(Entity* entity, const Frustum* cullFrustum)
+{
+	if (mSortedRendering)  entity->QueueRender(mRenderQueue, cullFrustum);
+	else                   entity->Render(cullFrustum);
+}
+
+
+// Whether a visible entity is to be drawn as an impostor: its level of detail says so and the impostor renderer is in use
+bool EntityManager::UseImpostor(Entity* entity)
+{
+	return entity->UsesImpostor() && mImpostorRenderer != nullptr && mImpostorRenderer->Enabled();
 }
 
 
-// Render all entities regardless of group
-void EntityManager::RenderAll()
+// Pass a visible entity to the impostor renderer, with its world bounding sphere. Returns false if the impostor couldn't be drawn
+bool EntityManager::DrawImpostor(Entity* entity, const BoundingSphere& bounds)
 {
-	for (auto& [ID, entity] : mEntities)  entity->Render();
+	EntityTemplate& entityTemplate = entity->Template();
+	if (!mImpostorRenderer->Add(*entityTemplate.Impostor(), entityTemplate.GetMesh(), entity->Transform(), bounds, entity->RenderColour()))
+		return false;
+	++mRenderStats.rendered;
+	++mRenderStats.impostors;
+	return true;
+}
+
+
+// Render the instances and the sorted draws gathered from a list of entities, and update the render stats
+void EntityManager::FlushDraws(const Frustum* cullFrustum, DrawOrder order)
+{
+	RenderInstances(cullFrustum); // May add entities in small batches to the render queue
+	mRenderQueue.Flush(order);
+	if (mImpostorRenderer != nullptr)  mImpostorRenderer->Render();
+
+	const auto& queueStats = mRenderQueue.GetStats();
+	mRenderStats.sortedDraws          = queueStats.draws;
+	mRenderStats.stateChanges         = queueStats.stateChanges;
+	mRenderStats.unsortedStateChanges = queueStats.unsortedStateChanges;
+	mRenderStats.commandLists         = queueStats.commandLists;
+	mRenderStats.reducedShaders       = queueStats.reducedShaders;
+}
+
+
+// Render the entities gathered for instanced rendering by RenderEntity, in batches sharing a mesh and colour, then clear the list.
+// The matrices for every batch are written to the instance buffer together, then each batch is drawn from its part of the buffer
+void EntityManager::RenderInstances(const Frustum* cullFrustum)
+{
+	if (mInstanceList.empty())  return;
+
+	// Batches with fewer entities than this are rendered one entity at a time, which also keeps node frustum culling for them.
+	// With GPU culling the entities haven't been frustum culled yet, so even single entities are batched to be culled on the GPU
+	static constexpr size_t MIN_INSTANCES = 2;
+	bool gpuCulling = UseGpuCulling(cullFrustum);
+	size_t minInstances = gpuCulling ? 1 : MIN_INSTANCES;
+
+	// Group the entities by mesh (the level of detail they are using) then colour, the colour is set once for each batch. Stable
+	// sort so the order is the same each frame
+	auto colourKey = [](Entity* entity) { auto& colour = entity->RenderColour(); return std::tie(colour.r, colour.g, colour.b, colour.a); };
+	std::stable_sort(mInstanceList.begin(), mInstanceList.end(), [&](Entity* a, Entity* b)
+	{
+		Mesh* meshA = &a->LODMesh();
+		Mesh* meshB = &b->LODMesh();
+		if (meshA != meshB)  return std::less<Mesh*>()(meshA, meshB);
+		return colourKey(a) < colourKey(b);
+	});
+
+	// Find the batches and the total number of matrices for them
+	struct Batch
+	{
+		size_t first;           // Position of the first entity in mInstanceList
+		unsigned int count;     // Number of entities
+		unsigned int firstMatrix;
+	};
+	std::vector<Batch> batches;
+	unsigned int numMatrices = 0;
+	for (size_t first = 0; first < mInstanceList.size(); )
+	{
+		Mesh& mesh = mInstanceList[first]->LODMesh();
+		size_t end = first + 1;
+		while (end < mInstanceList.size() && &mInstanceList[end]->LODMesh() == &mesh &&
+		       colourKey(mInstanceList[end]) == colourKey(mInstanceList[first]))  ++end;
+
+		if (end - first >= minInstances)
+		{
+			batches.push_back({ first, static_cast<unsigned int>(end - first), numMatrices });
+			numMatrices += static_cast<unsigned int>(end - first) * mesh.InstanceMatrixCount();
+		}
+		else
+		{
+			for (size_t i = first; i < end; ++i)  DrawEntity(mInstanceList[i], cullFrustum);
+		}
+		first = end;
+	}
+
+	if (gpuCulling)
+	{
+		// Each entity's matrices and bounds go to its slot in the scene buffer, which only sends the GPU those that have changed
+		mGpuCuller->Begin();
+		SceneBuffer& scene = mGpuCuller->Scene();
+		for (auto& batch : batches)
+		{
+			Entity* entity = mInstanceList[batch.first];
+			unsigned int entityMatrices = entity->LODMesh().InstanceMatrixCount();
+			mSceneMatrices.resize(entityMatrices);
+			uint32_t* slots = mGpuCuller->AddBatch(entity->LODMesh(), entity->RenderColour(), batch.count);
+			for (unsigned int i = 0; i < batch.count; ++i)
+			{
+				Entity* instance = mInstanceList[batch.first + i];
+				slots[i] = EntityIndex(instance->GetID());
+				instance->WriteInstanceMatrices(mSceneMatrices.data(), 0, 1);
+				scene.Write(slots[i], mSceneMatrices.data(), entityMatrices, instance->GetWorldBoundingSphere());
+			}
+		}
+
+		// If the culler can't be used, draw the entities one at a time with node frustum culling instead
+		if (mGpuCuller->CullAndRender(*cullFrustum))
+		{
+			mRenderStats.indirectDraws = mGpuCuller->GetStats().draws;
+		}
+		else
+		{
+			for (auto entity : mInstanceList)  DrawEntity(entity, cullFrustum);
+		}
+		mInstanceList.clear();
+		return;
+	}
+
+	// Write all the matrices, if the buffer can't be used then render the batches one entity at a time instead
+	Matrix4x4* matrices = batches.empty() ? nullptr : mInstanceBuffer.Begin(numMatrices);
+	if (matrices == nullptr)
+	{
+		for (auto& batch : batches)
+		{
+			for (size_t i = batch.first; i < batch.first + batch.count; ++i)  DrawEntity(mInstanceList[i], cullFrustum);
+		}
+		mInstanceList.clear();
+		return;
+	}
+	for (auto& batch : batches)
+	{
+		for (unsigned int i = 0; i < batch.count; ++i)
+			mInstanceList[batch.first + i]->WriteInstanceMatrices(matrices + batch.firstMatrix, i, batch.count);
+	}
+	mInstanceBuffer.End();
+
+	for (auto& batch : batches)
+	{
+		Entity* entity = mInstanceList[batch.first];
+		entity->LODMesh().RenderInstanced(mInstanceBuffer.Buffer(), batch.firstMatrix, batch.count, entity->RenderColour());
+		mRenderStats.instanced += batch.count;
+		++mRenderStats.batches;
+	}
+	mInstanceList.clear();
 }
 
 
 // Call all current entity's Update functions. Any entity that returns false will be destroyed
 void EntityManager::UpdateAll(float frameTime)
 {
-	// Loop needs to be performed carefully here since we can erase entities as we progress - so note how the ++it is not in the if statement
-	for (auto it = mEntities.begin(); it != mEntities.end();)
+	PROFILE_SCOPE("UpdateAll");
+	ALLOCATION_SCOPE("Entities");
+
+	// Entities destroyed during the update phase (including by returning false here) are put on a kill list and only destroyed
+	// after every entity has been updated, so the update list is never rearranged during this loop. Entities created during
+	// the loop are added to the end of the list so are also updated this frame. Entities already due to be destroyed are skipped
+	// Static entities (see CreateEntity) are not on the update list at all
+	mUpdating = true;
+
+	// Templates finished loading in the background are added before any entities might create entities with them
+	CollectPrefetchedTemplates();
+
+	// Entities may have been moved since the last update (e.g. placed by the scene), so bring the spatial grid up to date first.
+	// After that each entity's grid position is updated as soon as it has been updated, so queries see the latest positions.
+	// The obstacle tree is also brought up to date here, before any entities might use it from worker threads
+	mSpatialGrid.MoveAll();
+	RebuildObstacleTree();
+
+	// Every boat's avoidance steering is worked out together from where the boats are now, see SteeringSystem.h
+	mSteering.Update(*this, mJobSystem);
+
+	// Patrolling boats due to look for enemies do so together, see SensorSystem.h
+	mSensors.Update(*this, frameTime);
+
+	// Then each team shares out what its boats have seen, see TeamBlackboard.h
+	mBlackboard.Update(*this, frameTime);
+
+	// Boats with the utility AI choose what to do next from that, those due first within the budget, see DecisionSystem.h
+	mDecisions.Update(*this, frameTime);
+
+	// Aiming boats' launch velocities are solved in one batch from where the boats are now, see BallisticSolver.h
+	mBallistics.UpdateAimingBoats(*this, frameTime);
+
+	// Messages sent since the last update are received during this one, whichever order the entities are updated in. The
+	// hits and repairs among them are applied to the boats' health first, see DamageSystem.h
+	gMessenger->BeginFrame(frameTime);
+	mDamage.Update(mBoatData);
+	mBehaviours.Update(*this, frameTime);
+	mReservations.Update(frameTime);
+	for (size_t i = 0; i < mUpdateEntities.size(); ++i)
 	{
-		auto entity = it->second.get();
-		++it; // Do this before potential entity destruction on next line, which would invalidate the current it value
+		auto entity = mUpdateEntities[i];
+		EntitySlot& slot = mSlots[EntityIndex(entity->GetID())];
+		if (slot.destroyPending)  continue;
+		if (slot.parallelUpdate && mJobSystem != nullptr)  continue; // Updated below
 
-		// If entity update returns false the entity is destroyed *UPDATE*
-		if (!entity->Update(frameTime))  DestroyEntity(entity->GetID());
-			
+		// If entity update returns false the entity is destroyed *UPDATE*. The update may create entities, moving the slots
+		if (mCosts.IsEnabled())
+		{
+			CostType costType = slot.costType;
+			int64_t start = CpuProfiler::Now();
+			if (!entity->Update(frameTime))  QueueDestroy(entity->GetID());
+			mCosts.AddUpdate(entity->GetID(), costType, CpuProfiler::Now() - start);
+		}
+		else
+		{
+			if (!entity->Update(frameTime))  QueueDestroy(entity->GetID());
+		}
+		mSpatialGrid.Move(entity);
 	}
+
+	if (mJobSystem != nullptr)  UpdateParallelEntities(frameTime);
+
+	// The boats move and their guns are rebuilt together once every boat has decided its speed and heading, see
+	// NavigationSystem.h and WeaponSystem.h
+	mBoatMovement.Update(mBoatData, mSpatialGrid, frameTime);
+	mWeapons.Update(mBoatData);
+
+	// Floating props bob after their own update has set the rest of their matrix. The spatial grid only uses positions in
+	// the XZ plane, so isn't affected by the change of height
+	mBobbing.Update(frameTime);
+
+	// Attached entities follow their parents' final positions, see Attach
+	ResolveAttachments();
+
+	// All entities are now in their final positions for this frame, so check the trigger volumes. Triggers that have gone off
+	// and destroy their owner are added to the kill list like any other destruction in the update phase
+	for (auto id : mTriggers.Update(mSpatialGrid))  QueueDestroy(id);
+	mUpdating = false;
+
+	FlushDestroyedEntities();
 }
 
+
+// Update all entities that can be updated in parallel on the job system's threads. Called from UpdateAll after the other entities
+// have been updated, so any entities created this frame are also included. The parallel entities only read the rest of the world
+// (see Entity::CanUpdateInParallel), so nothing changes while they run except their own data and the chunk buffers used here
+void EntityManager::UpdateParallelEntities(float frameTime)
+{
+	// Gather the entities in update list order, so the chunks are the same each run
+	mParallelEntities.clear();
+	for (auto entity : mUpdateEntities)
+	{
+		EntitySlot& slot = mSlots[EntityIndex(entity->GetID())];
+		if (slot.parallelUpdate && !slot.destroyPending)  mParallelEntities.push_back(entity);
+	}
+	if (mParallelEntities.empty())  return;
+
+	size_t numChunks = JobSystem::NumChunks(mParallelEntities.size(), PARALLEL_CHUNK_SIZE);
+	if (mChunkKillLists.size() < numChunks)  mChunkKillLists.resize(numChunks);
+	for (auto& killList : mChunkKillLists)  killList.clear();
+
+	// With the entity costs enabled each worker writes its entities' times to their own place in the list, they are added to
+	// the costs afterwards as the costs aren't thread safe
+	bool timed = mCosts.IsEnabled();
+	if (timed)  mParallelTicks.resize(mParallelEntities.size());
+
+	// Messages sent during the parallel phase are buffered per chunk in the same way
+	gMessenger->BeginParallelPhase(numChunks);
+	mJobSystem->ParallelFor(mParallelEntities.size(), PARALLEL_CHUNK_SIZE, [&](size_t chunk, size_t begin, size_t end)
+	{
+		gMessenger->SetParallelChunk(chunk);
+		for (size_t i = begin; i < end; ++i)
+		{
+			Entity* entity = mParallelEntities[i];
+			int64_t start = timed ? CpuProfiler::Now() : 0;
+			if (!entity->Update(frameTime))  mChunkKillLists[chunk].push_back(entity->GetID());
+			if (timed)  mParallelTicks[i] = CpuProfiler::Now() - start;
+		}
+	});
+	gMessenger->EndParallelPhase();
+
+	// Back on a single thread - update the spatial grid, which can't be changed while the workers are querying it, then queue
+	// the destroyed entities in chunk order
+	for (auto entity : mParallelEntities)  mSpatialGrid.Move(entity);
+	if (timed)
+	{
+		for (size_t i = 0; i < mParallelEntities.size(); ++i)
+		{
+			EntityID id = mParallelEntities[i]->GetID();
+			mCosts.AddUpdate(id, mSlots[EntityIndex(id)].costType, mParallelTicks[i]);
+		}
+	}
+	for (size_t chunk = 0; chunk < numChunks; ++chunk)
+	{
+		for (auto id : mChunkKillLists[chunk])  QueueDestroy(id);
+	}
+}
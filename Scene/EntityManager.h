@@ -11,17 +11,87 @@
 #define _ENTITY_MANAGER_H_INCLUDED_
 
 #include "Entity.h"
+#include "TransformStore.h"
+#include "SpatialGrid.h"
+#include "ObstacleBVH.h"
+#include "NavigationField.h"
+#include "TriggerSystem.h"
+#include "BobbingSystem.h"
+#include "SteeringSystem.h"
+#include "SensorSystem.h"
+#include "TeamBlackboard.h"
+#include "DecisionSystem.h"
+#include "BallisticSolver.h"
+#include "BoatComponents.h"
+#include "DamageSystem.h"
+#include "NavigationSystem.h"
+#include "WeaponSystem.h"
+#include "Behaviour.h"
+#include "ReloadService.h"
+#include "CrateReservations.h"
+#include "EntityCosts.h"
+#include "GpuTemplateCosts.h"
+#include "StaticBatcher.h"
+#include "Utility.h"
+#include "Atom.h"
 #include "Boat.h"
 #include "ReloadStation.h"
 #include "Obstacle.h"
 #include "RandomCrate.h"
 #include "SeaMine.h"
+#include "Missile.h"
+#include "Shield.h"
+#include "EntityPool.h"
+#include "InstanceBuffer.h"
+#include "RenderQueue.h"
 
 #include <string>
 #include <map>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <string_view>
+#include <deque>
+#include <functional>
+#include <future>
+#include <span>
+#include <tuple>
+#include <vector>
+#include <type_traits>
 #include <stdexcept>
 #include <stdint.h>
 
+// Forward declarations, the job system and the culling classes are only used in the cpp file
+class JobSystem;
+class OcclusionCuller;
+class GpuCuller;
+class ImpostorRenderer;
+
+//--------------------------------------------------------------------------------------
+// Template Handle
+//--------------------------------------------------------------------------------------
+// A template type kept with the template it was last found to be, for code that creates many entities of one type (e.g. a
+// missile for each shot). Creating an entity with a handle goes straight to the template, only looking the type up again
+// the first time or after templates have been replaced or destroyed (e.g. a level reload, or a streamed template released).
+// The handle doesn't construct a template registered to load when needed until it is first used, so it can be made before
+// the template is ready:
+//   TemplateHandle mMissileTemplate{ Atom("Missile") };
+//   gEntityManager->CreateEntity<Missile>(mMissileTemplate, transform, speed, velocity, boatID);
+class TemplateHandle
+{
+public:
+	TemplateHandle() = default;
+	explicit TemplateHandle(Atom type) : mType(type) {}
+
+	Atom GetType() const  { return mType; }
+
+private:
+	friend class EntityManager;
+	Atom            mType;
+	EntityTemplate* mTemplate = nullptr;
+	uint64_t        mVersion  = 0; // EntityManager::mTemplatesVersion when mTemplate was found, 0 if it hasn't been
+};
+
 
 //--------------------------------------------------------------------------------------
 // Entity Manager Class
@@ -49,16 +119,16 @@ public:
 	// The extra parameters are forwarded to the constructor by using a parameter pack (...) and std::forward. The syntax is ugly, but is powerful
 	// and worth knowing about. Look in particular how ConstructorTypes and constructorValues are used with ... to see what is going on here
 	template <typename EntityTemplateType, typename ...ConstructorTypes>
-	EntityTemplateType* CreateEntityTemplate(std::string type, std::string meshFilename, ConstructorTypes&&... constructorValues)
+	EntityTemplateType* CreateEntityTemplate(Atom type, std::string meshFilename, ConstructorTypes&&... constructorValues)
 	{
 		// See if template with the same name already exists, if so delete the existing one
-		if (mEntityTemplates.contains(type))  mEntityTemplates.erase(type);
+		if (mEntityTemplates.erase(type) > 0)  mTemplatesVersion = NextTemplatesVersion();
 
 		// Try to construct new entity template
 		EntityTemplateType* entityTemplate;
 		try
 		{
-			entityTemplate = new EntityTemplateType(type, meshFilename, std::forward<ConstructorTypes>(constructorValues)...);
+			entityTemplate = new EntityTemplateType(type.str(), meshFilename, std::forward<ConstructorTypes>(constructorValues)...);
 		}
 		catch (std::runtime_error e)
 		{
@@ -73,12 +143,104 @@ public:
 	}
 
 
+	// Add an entity template that has already been constructed, e.g. on another thread while a level's templates are loaded in
+	// parallel (see ParseLevel). Replaces any existing template with the same type name. Returns the template
+	EntityTemplate* AddEntityTemplate(Atom type, std::unique_ptr<EntityTemplate> entityTemplate)
+	{
+		auto& added = mEntityTemplates[type];
+		if (added != nullptr)  mTemplatesVersion = NextTemplatesVersion();
+		added = std::move(entityTemplate);
+		return added.get();
+	}
+
+
+	// Register an entity template that is only constructed when it is first needed, so templates that aren't used straight away
+	// (or at all) don't slow down loading. The create function constructs the template, importing its meshes and loading its
+	// textures, and can throw std::runtime_error. It is called by the first CreateEntity or GetTemplate for this type, or on a
+	// background thread after PrefetchTemplate. Replaces any template of the same type that hasn't been constructed yet.
+	// Templates that haven't been constructed are not included in CreateCollection
+	// The bounds, if known beforehand (e.g. from the mesh cache, see Mesh::ReadBounds), size the stand-in drawn for entities
+	// created while the template streams in (see CreateEntity), otherwise a small box is used
+	using TemplateFactory = std::function<std::unique_ptr<EntityTemplate>()>;
+	struct TemplateBounds
+	{
+		Vector3 boundsMin = { 0, 0, 0 };
+		Vector3 boundsMax = { 0, 0, 0 };
+		bool    known     = false;
+	};
+	void RegisterEntityTemplate(Atom type, TemplateFactory create, TemplateBounds bounds);
+	void RegisterEntityTemplate(Atom type, TemplateFactory create)  { RegisterEntityTemplate(type, std::move(create), TemplateBounds{}); }
+
+	// Hint that the given registered template will be needed soon, e.g. a type of entity spawned during the game. It starts being
+	// constructed on a background thread so the first CreateEntity using it waits less, or not at all. Does nothing if the template
+	// has already been constructed or started. Also does nothing if the D3D context can't be made thread-safe (see DXDevice), then
+	// the template is constructed when first needed
+	void PrefetchTemplate(Atom type);
+
+	// Returns true while the given template is being constructed on a background thread after PrefetchTemplate
+	bool IsTemplateLoading(Atom type);
+
+	// Returns true if the given template has been constructed, without constructing it if it is only registered
+	bool IsTemplateConstructed(Atom type)  { return mEntityTemplates.contains(type); }
+
+	// Number of registered templates not yet constructed, including those being prefetched
+	size_t PendingTemplateCount()  { return mPendingTemplates.size(); }
+
+	// Construct every registered template that hasn't been yet, prefetching them all so they load in parallel, e.g. for the asset
+	// cooker to import every mesh and texture a level can use. Returns the number that failed to load, with the last error set
+	// for the last of them
+	size_t ConstructAllTemplates();
+
+	// Number of templates that have been constructed, it changes as templates load (e.g. when a prefetch finishes)
+	size_t TemplateCount()  { return mEntityTemplates.size(); }
+
+	// Whether CreateEntity streams templates that haven't been constructed for entities of purely visual types (see
+	// CreateEntity), rather than waiting for them. On by default, and always off without a D3D device (headless)
+	// Streaming covers plain scenery entities and shields (see StreamsTemplate), the types none of the gameplay reads the mesh
+	// nodes or bounds of, so they can be drawn as a box until their template arrives. In practice that is the scenery of a
+	// partitioned level's cells as they stream in, as the level's other templates are constructed at load and the shield is
+	// prefetched. Gameplay types still construct their template when their first entity is created. The waiting templates are
+	// loaded in order of distance from the LOD camera to their nearest entity, at most MAX_STREAMING_LOADS at a time
+	bool& TemplateStreaming()  { return mTemplateStreaming; }
+
+	// Number of entities drawn as a stand-in box while their template streams in
+	size_t StreamingEntityCount()
+	{
+		size_t count = 0;
+		for (auto& [type, proxy] : mProxyTemplates)  count += proxy->mEntities.size();
+		return count;
+	}
+
+	// Memory used by a constructed template's meshes, all its levels of detail together (see MeshMemory). A mesh shared by
+	// several templates (same file and import flags) counts for each of them
+	struct TemplateMemory
+	{
+		std::string type;
+		uint32_t    entities = 0;
+		uint32_t    lods     = 0;
+		MeshMemory  memory;
+	};
+
+	// The memory used by every constructed template, e.g. for the memory report in the control panel. Looks at every mesh and
+	// texture, so gather it when wanted rather than every frame
+	std::vector<TemplateMemory> GetTemplateMemory();
+
+	// Write a report from GetTemplateMemory to a CSV file, one row for each template. Returns false if it can't be written
+	static bool ExportTemplateMemory(const std::vector<TemplateMemory>& report, const std::string& fileName);
+
+
+	// Make room for the given number of entities to be created, so creating many at once (e.g. loading a level) doesn't
+	// repeatedly grow the entity lists
+	void ReserveEntities(size_t count);
+
 	// Create any type of entity that inherits from Entity
 	// Returns NO_ID if the template type does not exist or if entity creation fails. Call GetLastError for a text description of the error
 	// 
 	// All entities must have a constructor whose first two parameters are an EntityTemplate& then an EntityID. However, they may
 	// also have further parameters. When calling this function you first pass a template name (no need to pass the ID, the manager will create that)
 	// Then pass any other parameters the entity's constructor expects after the template and ID
+	// The template type is an atom (see Atom.h), a string passed is made into one. Code creating many entities of a type keeps
+	// the atom, e.g. static const Atom MISSILE("Missile"), so creating them doesn't hash the name each time
 	// Note that even the base class entity type has further constructor parameters aside from the template name:
 	//   E.g. Entity* Tree1 = CreateEntity<Entity>("Tree");                                   // Create base class entity with default settings
 	//        Entity* Tree2 = CreateEntity<Entity>("Tree", Matrix4x4{(10, 0, 20}), "Bob");    // Create base class entity with initial position and name
@@ -86,39 +248,174 @@ public:
 	//
 	// The extra parameters are forwarded to the constructor by using a parameter pack (...) and std::forward. The syntax is ugly, but is powerful
 	// and worth knowing about. Look in particular how ConstructorTypes and constructorValues are used with ... to see what is going on here
+	//
+	// An entity of a purely visual type (see StreamsTemplate, plain scenery and shields) whose template was registered to load
+	// when needed but hasn't been constructed doesn't wait for it. The entity is created with a stand-in template of the same
+	// type, drawn as a box the size of the template's mesh if that was known when it was registered (otherwise a small one), and
+	// the template is loaded in the background, the nearest to the camera first. When it has loaded the entity is moved to it
+	// (see CollectPrefetchedTemplates). If it fails to load the entity is destroyed
 	template <typename EntityType, typename ...ConstructorTypes>
-	EntityID CreateEntity(std::string templateType, ConstructorTypes&&... constructorValues)
+	EntityID CreateEntity(Atom templateType, ConstructorTypes&&... constructorValues)
 	{
-		// Check that requested entity template exists
-		if (!mEntityTemplates.contains(templateType))
+		// Check that requested entity template exists, constructing it now if it was registered to load when needed
+		EntityTemplate* entityTemplate = nullptr;
+		if constexpr (StreamsTemplate<EntityType>())  entityTemplate = ProxyTemplate(templateType);
+		if (entityTemplate == nullptr)  entityTemplate = FindTemplate(templateType);
+		if (entityTemplate == nullptr)  return NO_ID;
+		
+		// Get ID for new entity
+		EntityID newID = AllocateID();
+		if (newID == NO_ID)
 		{
-			mLastError = "Entity Manager: Cannot find entity template '" + templateType + "'";
+			mLastError = "Entity Manager: Too many entities";
 			return NO_ID;
 		}
-		
-		// Get template and ID for new entity
-		EntityTemplate* entityTemplate = mEntityTemplates[templateType].get();
-		EntityID newID = mNextID++;
 
-		// Try to construct new entity
-		EntityType* entity;
-		try
+		return ConstructEntity<EntityType>(*entityTemplate, newID, std::forward<ConstructorTypes>(constructorValues)...);
+	}
+
+	// As CreateEntity, but with a template handle kept by the caller (see TemplateHandle above), so the template is found
+	// without a lookup. The handle is updated if its template had to be found again
+	template <typename EntityType, typename ...ConstructorTypes>
+	EntityID CreateEntity(TemplateHandle& templateHandle, ConstructorTypes&&... constructorValues)
+	{
+		// A handle that is up to date holds a constructed template, so only look for a stand-in when it isn't
+		EntityTemplate* entityTemplate = nullptr;
+		if constexpr (StreamsTemplate<EntityType>())
 		{
-			entity = new EntityType(*entityTemplate, newID, std::forward<ConstructorTypes>(constructorValues)...);
+			if (templateHandle.mVersion != mTemplatesVersion)  entityTemplate = ProxyTemplate(templateHandle.mType);
 		}
-		catch (std::runtime_error e)
+		if (entityTemplate == nullptr)  entityTemplate = ResolveTemplate(templateHandle);
+		if (entityTemplate == nullptr)  return NO_ID;
+
+		EntityID newID = AllocateID();
+		if (newID == NO_ID)
 		{
-			mLastError = e.what(); // This picks up the error message put in the exception
+			mLastError = "Entity Manager: Too many entities";
 			return NO_ID;
 		}
 
-		// Add new entity to map (map.emplace is needed here instead of map.insert because the map contains a unique_ptr, same effect though)
-		mEntities.emplace(newID, entity);
+		return ConstructEntity<EntityType>(*entityTemplate, newID, std::forward<ConstructorTypes>(constructorValues)...);
+	}
 
-		// Tell template about this new entity that is using it
-		entityTemplate->mEntities.push_back(newID);
+	// The template a handle refers to, finding it again (and constructing it if it was registered to load when needed) if
+	// templates have been replaced or destroyed since it was last found. Returns nullptr if there is no such template
+	EntityTemplate* ResolveTemplate(TemplateHandle& templateHandle)
+	{
+		if (templateHandle.mVersion != mTemplatesVersion)
+		{
+			templateHandle.mTemplate = FindTemplate(templateHandle.mType);
+			templateHandle.mVersion  = (templateHandle.mTemplate != nullptr) ? mTemplatesVersion : 0;
+		}
+		return templateHandle.mTemplate;
+	}
 
-		return newID;
+	// As CreateEntity, but the entity is given the ID passed rather than a new one, used when restoring a checkpoint (see
+	// Checkpoint.h). The ID's slot must be free, as after RestoreSlotTable. Returns NO_ID if the slot is in use or the entity
+	// can't be created, call GetLastError for a description of the error
+	template <typename EntityType, typename ...ConstructorTypes>
+	EntityID CreateEntityWithID(EntityID id, Atom templateType, ConstructorTypes&&... constructorValues)
+	{
+		EntityTemplate* entityTemplate = FindTemplate(templateType);
+		if (entityTemplate == nullptr)  return NO_ID;
+
+		if (!ClaimID(id))
+		{
+			mLastError = "Entity Manager: Entity ID already in use";
+			return NO_ID;
+		}
+
+		return ConstructEntity<EntityType>(*entityTemplate, id, std::forward<ConstructorTypes>(constructorValues)...);
+	}
+
+	// Create many entities of one type with one template together, e.g. a level's scenery or a wave of spawns. The template is
+	// found once, and the entity lists, typed registries, template's entity list and pool (for pooled types, see EntityPool.h)
+	// are grown once for them all. Each element of params holds the constructor parameters of one entity after the template
+	// and ID, either a tuple of them or a single value. Puts the ID of each entity in ids if it isn't nullptr, NO_ID for those
+	// that couldn't be created (call GetLastError). Returns the number created. IDs are allocated as CreateEntity does, so
+	// they are the same as creating the entities one at a time:
+	//   std::vector<std::tuple<Matrix4x4, std::string>> rocks = ...;
+	//   gEntityManager->CreateEntities<Obstacle>(rockTemplate, std::span(rocks));
+	template <typename EntityType, typename Params>
+	size_t CreateEntities(TemplateHandle& templateHandle, std::span<Params> params, EntityID* ids = nullptr)
+	{
+		if (ids != nullptr)  std::fill_n(ids, params.size(), NO_ID);
+		EntityTemplate* entityTemplate = ResolveTemplate(templateHandle);
+		if (entityTemplate == nullptr)  return 0;
+
+		// Static types aren't added to the update list, as decided in ConstructEntity
+		ReserveEntities(params.size());
+		entityTemplate->mEntities.reserve(entityTemplate->mEntities.size() + params.size());
+		if constexpr (!std::is_same_v<decltype(&EntityType::Update), bool (Entity::*)(float)>)
+		{
+			mUpdateEntities.reserve(mUpdateEntities.size() + params.size());
+		}
+		ReserveRegistries<EntityType>(params.size());
+		if constexpr (std::is_base_of_v<PooledEntity<EntityType>, EntityType>)
+		{
+			EntityType::Pool().Reserve(EntityType::Pool().NumInUse() + params.size());
+		}
+
+		size_t numCreated = 0;
+		for (size_t i = 0; i < params.size(); ++i)
+		{
+			EntityID newID = AllocateID();
+			if (newID == NO_ID)
+			{
+				mLastError = "Entity Manager: Too many entities";
+				break;
+			}
+
+			if constexpr (requires { std::tuple_size<std::remove_cv_t<Params>>::value; })
+			{
+				newID = std::apply([&](auto&... values) { return ConstructEntity<EntityType>(*entityTemplate, newID, values...); }, params[i]);
+			}
+			else
+			{
+				newID = ConstructEntity<EntityType>(*entityTemplate, newID, params[i]);
+			}
+			if (ids != nullptr)  ids[i] = newID;
+			if (newID != NO_ID)  ++numCreated;
+		}
+		return numCreated;
+	}
+
+	// As above, with the template found by type
+	template <typename EntityType, typename Params>
+	size_t CreateEntities(Atom templateType, std::span<Params> params, EntityID* ids = nullptr)
+	{
+		TemplateHandle templateHandle(templateType);
+		return CreateEntities<EntityType>(templateHandle, params, ids);
+	}
+
+
+	// The generation of every slot and the order free slots will be reused in, so a checkpoint can put them back and entities
+	// created afterwards get the same IDs as they did after the checkpoint was saved
+	struct SlotTable
+	{
+		std::vector<uint32_t> generations;
+		std::vector<uint32_t> freeSlots;
+	};
+	SlotTable GetSlotTable();
+
+	// Put back the slots of a slot table. The slots of live entities must not be free in the table, they keep their generation.
+	// Returns false (changing nothing) if a live entity's slot is free or beyond the table
+	bool RestoreSlotTable(const SlotTable& table);
+
+	// Forget what the AI systems have worked out from earlier updates (sensors, team knowledge, decisions), e.g. after
+	// restoring a checkpoint. They rebuild it from the entities over the next few updates. Their settings are kept
+	void ResetAISystems()
+	{
+		float sensorRate = mSensors.GetRefreshRate();
+		mSensors = SensorSystem();
+		mSensors.SetRefreshRate(sensorRate);
+		mBlackboard = TeamBlackboard();
+
+		bool decisionsEnabled = mDecisions.IsEnabled();
+		int  decisionBudget   = mDecisions.GetBudget();
+		mDecisions = DecisionSystem();
+		mDecisions.SetEnabled(decisionsEnabled);
+		mDecisions.SetBudget(decisionBudget);
 	}
 
 
@@ -130,12 +427,77 @@ public:
 	// Entity templates can use a lot of memory (meshes and textures) so they should be released when possible, but watch out
 	// for the implications of all their entities being destroyed
 	// Returns true on success, false if there is no entity template with the given type
-	bool DestroyEntityTemplate(std::string type);
+	// If this is called during UpdateAll the template and its entities are destroyed once all entities have been updated,
+	// along with the entities on the kill list (see DestroyEntity)
+	bool DestroyEntityTemplate(Atom type);
 
-	// Destroy the entity with the given ID. Returns true on success, false if there isn't an entity with this ID
+	// Destroy the entity with the given ID. Returns true on success, false if there isn't an entity with this ID (which includes
+	// IDs of entities that have already been destroyed or are already due to be destroyed)
+	// If this is called during UpdateAll (i.e. from an entity's Update function) the entity is not destroyed immediately, it
+	// is added to a kill list that is processed once all entities have been updated. Until then the entity can still be accessed
+	// normally, although it will not be updated again
 	bool DestroyEntity(EntityID id);
 
 
+	//--------------------------------------------------------------------------------------
+	// Private Entity Construction
+	//--------------------------------------------------------------------------------------
+private:
+	// Construct an entity with the given template and an ID whose slot is ready for it, then add it to all the manager's lists,
+	// for CreateEntity and CreateEntityWithID. Returns NO_ID if the constructor throws, freeing the slot again
+	template <typename EntityType, typename ...ConstructorTypes>
+	EntityID ConstructEntity(EntityTemplate& entityTemplate, EntityID newID, ConstructorTypes&&... constructorValues)
+	{
+		// Try to construct new entity
+		EntityType* entity;
+		try
+		{
+			entity = new EntityType(entityTemplate, newID, std::forward<ConstructorTypes>(constructorValues)...);
+		}
+		catch (std::runtime_error e)
+		{
+			mLastError = e.what(); // This picks up the error message put in the exception
+			ReleaseSlot(EntityIndex(newID));
+			return NO_ID;
+		}
+
+		// Put new entity in its slot and add it to the packed list of live entities. Don't take a reference to the slot before
+		// the constructor above, the constructor might create other entities, which can reallocate the slot storage
+		EntitySlot& slot = mSlots[EntityIndex(newID)];
+		slot.entity.reset(entity);
+		slot.liveIndex = static_cast<uint32_t>(mLiveEntities.size());
+		slot.parallelUpdate = entity->CanUpdateInParallel();
+		mLiveEntities.push_back(entity);
+		mTransforms.ResetPreviousRoot(EntityIndex(newID)); // Rendered where it was created until the next simulation step
+
+		// Entity types that don't override Entity::Update (scenery, obstacles etc.) have nothing to do each frame. The type is
+		// known here so this is decided at compile time: if EntityType has its own Update then &EntityType::Update is a pointer
+		// to an EntityType member, otherwise it is the pointer to Entity::Update. Static entities are never updated and are
+		// rendered from their own list, the others are added to the list of entities to update
+		slot.isStatic = std::is_same_v<decltype(&EntityType::Update), bool (Entity::*)(float)>;
+		slot.costType = CostTypeOf<EntityType>();
+		if (!slot.isStatic)
+		{
+			slot.updateIndex = static_cast<uint32_t>(mUpdateEntities.size());
+			mUpdateEntities.push_back(entity);
+		}
+		AddToRenderGroup(entity);
+		AddToNameIndex(entity);
+
+		// Tell template about this new entity that is using it
+		slot.templateIndex = static_cast<uint32_t>(entityTemplate.mEntities.size());
+		entityTemplate.mEntities.push_back(newID);
+
+		// Add to the typed registries used by View<T>(). The type is known at compile time here so there is no casting
+		AddToRegistries(entity);
+
+		// Types that are searched for by position are also added to the spatial grid, see Spatial()
+		if constexpr (SpatialTypeOf<EntityType>() != 0)  mSpatialGrid.Insert(entity, SpatialTypeOf<EntityType>());
+
+		return newID;
+	}
+
+
 	//--------------------------------------------------------------------------------------
 	// Access
 	//--------------------------------------------------------------------------------------
@@ -145,22 +507,13 @@ public:
 	//   E.g. EntityTemplate* baseTemplate   = myEntityManager->GetTemplate("Basic Wizard");
 	//   Or:  WizardTemplate* wizardTemplate = myEntityManager->GetTemplate<WizardTemplate>("Basic Wizard");
 	// Returns nullptr if no template of the given name exists or if you use an invalid template type (e.g. if you ask for a CarTemplate for "Basic Wizard")
+	// A template registered to load when needed (see RegisterEntityTemplate) is constructed first
 	template <typename T = EntityTemplate>
-	T* GetTemplate(std::string type)
+	T* GetTemplate(Atom type)
 	{
-		if (!mEntityTemplates.contains(type))  return nullptr;
-		
-		T* entityTemplate;
-		try
-		{
-			entityTemplate = dynamic_cast<T*>(mEntityTemplates[type].get());
-		}
-		catch (std::bad_cast e)
-		{
-			return nullptr;
-		}
-		
-		return entityTemplate;
+		EntityTemplate* found = FindTemplate(type);
+		if (found == nullptr)  return nullptr;
+		return TypeCast<T>(found); // A test of the template's type mask for tagged types, see TypeTag.h
 	}
 
 	// Returns the entity with the given name. Returns as a base class Entity pointer by default but if you know the inherited type
@@ -168,15 +521,26 @@ public:
 	//   E.g. Entity* tankBase = myEntityManager->GetEntity("MyTank");
 	//   Or:  Tank*   tank     = myEntityManager->GetEntity<Tank>("MyTank");
 	// Returns nullptr if no entity with the given ID exists or if you use an invalid entity type (e.g. if you ask for a Wizard with "MyTank")
+	// Names are atoms (see Atom.h) held in a hash table, so looking up with an atom is a constant time lookup that never hashes
+	// the text. Looking up with a string finds its atom first, without adding names that no entity has. Names do not need to be
+	// unique - if several entities share a name then any one of them may be returned. Unnamed entities cannot be found with this function
 	template <typename T = Entity>
-	T* GetEntity(std::string name)
+	T* GetEntity(std::string_view name)
 	{
-		// Linear search for name - not efficient, but this function is useful to make simpler examples of entity code
-		for (auto& entity : mEntities)
-		{
-			if (entity.second->GetName() == name)  return dynamic_cast<T*>(entity.second.get());
-		}
-		return nullptr;
+		Atom atom;
+		if (!Atom::Find(name, atom))  return nullptr;
+		return GetEntity<T>(atom);
+	}
+	template <typename T = Entity>
+	T* GetEntity(const char* name)  { return GetEntity<T>(std::string_view(name)); }
+	template <typename T = Entity>
+	T* GetEntity(const std::string& name)  { return GetEntity<T>(std::string_view(name)); }
+	template <typename T = Entity>
+	T* GetEntity(Atom name)
+	{
+		auto it = mNameIndex.find(name);
+		if (it == mNameIndex.end())  return nullptr;
+		return GetEntity<T>(it->second);
 	}
 		
 		
@@ -185,22 +549,68 @@ public:
 	//   E.g. Entity* tankBase = myEntityManager->GetEntity(tankID);
 	//   Or:  Tank*   tank     = myEntityManager->GetEntity<Tank>(tankID);
 	// Returns nullptr if no entity with the given ID exists or if you use an invalid entity type (e.g. if you ask for a Wizard with tankID)
+	// IDs of destroyed entities are detected and return nullptr, even if their slot has since been reused by a new entity. So it is
+	// always safe to store an entity's ID and look it up again later rather than keeping a pointer to it. The lookup is constant
+	// time, and checking the type is a test of the entity's type mask for tagged types (see TypeTag.h)
 	template <typename T = Entity>
 	T* GetEntity(EntityID id)
 	{
-		if (!mEntities.contains(id))  return nullptr;
+		return TypeCast<T>(FindEntity(id));
+	}
 
-		T* entity;
-		try
-		{
-			entity = dynamic_cast<T*>(mEntities[id].get());
-		}
-		catch (std::bad_cast e)
-		{
-			return nullptr;
-		}
+	// Returns true if the given ID refers to an entity that currently exists
+	bool IsAlive(EntityID id)
+	{
+		return FindEntity(id) != nullptr;
+	}
+
+	// Total number of entities destroyed so far. Lets other systems that hold entity IDs (e.g. the Messenger) tell cheaply whether
+	// anything has been destroyed since they last looked, rather than being told about each destruction
+	uint64_t GetNumDestroyed()  { return mNumDestroyed; }
+
+	// Changes each time a boat is created, destroyed or renamed, or any entity is renamed. Lets a list of boats that is kept
+	// from frame to frame (e.g. the one in the scene's control panel) be rebuilt only when it has changed
+	uint64_t GetBoatListVersion()  { return mBoatListVersion; }
+
+	// Changes each time a static entity is added to or removed from a render group (created, destroyed or moved between groups), or
+	// templates are added or removed. Static entities never move, so anything drawn from them once and kept (e.g. a cached shadow
+	// map, see ShadowMap.h) is out of date only when this has changed
+	uint64_t GetStaticVersion()  { return mStaticVersion + mTemplatesVersion; }
+
+	// Change the name of the given entity. Entity names must be changed through this function so that GetEntity(name) can find
+	// the entity by its new name. Returns false if there is no entity with this ID
+	bool RenameEntity(EntityID id, Atom newName);
+
+	// Change the render group of the given entity (see Entity::RenderGroup). Render groups must be changed through this function
+	// so that RenderGroup finds the entity in its new group's list. Returns false if there is no entity with this ID
+	bool SetRenderGroup(EntityID id, unsigned int group);
+
+	// The templates of the entities in the given render group, each once, e.g. to find the meshes the group's pass will draw
+	std::vector<EntityTemplate*> GroupTemplates(unsigned int group);
+
+
+	// Attach an entity to another, e.g. a shield to its boat. At the end of each UpdateAll, after every entity has been updated,
+	// the child's matrix is set to its local matrix (relative to the parent) combined with the parent's matrix, in one pass that
+	// places parents before their children so chains of attachments are resolved in the same frame. A child is destroyed along
+	// with its parent. Attaching an entity that is already attached moves it to the new parent. Returns false if either entity
+	// doesn't exist or the child is the parent or one of its ancestors
+	bool Attach(EntityID child, EntityID parent, const Matrix4x4& local);
+
+	// Detach an entity from its parent, leaving it where it is. Returns false if it isn't attached
+	bool Detach(EntityID child);
 
-		return entity;
+	// The parent an entity is attached to, NO_ID if it isn't attached
+	EntityID GetParent(EntityID child);
+
+	// Change an attached entity's matrix relative to its parent. Children may call this from their own update, including one on
+	// a worker thread, as only the child's own attachment is changed. Returns false if the entity isn't attached (or its parent
+	// has gone)
+	bool SetLocalTransform(EntityID child, const Matrix4x4& local)
+	{
+		uint32_t index = EntityIndex(child);
+		if (index >= mAttachments.size() || mAttachments[index].owner != child)  return false;
+		mAttachments[index].local = local;
+		return true;
 	}
 
 	template <typename T>
@@ -208,60 +618,47 @@ public:
 	{
 		for (auto& entityTemplate : mEntityTemplates)
 		{
-			try
-			{
-				T* matchingTemplate = dynamic_cast<T*>(entityTemplate.second.get());
-				if (matchingTemplate == nullptr)  continue;
-				collection.push_back(matchingTemplate);
-			}
-			catch (std::bad_cast e) {}
+			T* matchingTemplate = TypeCast<T>(entityTemplate.second.get());
+			if (matchingTemplate != nullptr)  collection.push_back(matchingTemplate);
 		}
 	}
 
 	std::vector<Entity*> GetAllEntities()
 	{
-		std::vector<Entity*> allEntities;
-		allEntities.reserve(mEntities.size());
+		return mLiveEntities;
+	}
 
-		for (auto& [id, entityPtr] : mEntities)
-		{
-			if (dynamic_cast<Entity*>(entityPtr.get()))
-			{
-				allEntities.emplace_back(entityPtr.get());
-			}
-		}
+	size_t NumEntities()  { return mLiveEntities.size(); }
 
-		return allEntities;
+
+	// Returns all the current entities of a given type without searching or allocating. The manager keeps a registry of
+	// entities for each of the gameplay types below, updated as entities are created and destroyed, so the cost of a typed
+	// query is the number of matching entities, not the number of entities in the world
+	//   E.g. for (Boat* boat : gEntityManager->View<Boat>()) { ... }
+	// The returned reference remains valid but its contents change when an entity of that type is created or destroyed, so
+	// do not create entities of type T while looping over View<T>() (destruction is safe during UpdateAll, as it is deferred).
+	// Supported types: Boat, Obstacle, ReloadStation, RandomCrate, SeaMine and Missile (and any types inherited from them)
+	template <typename T>
+	const std::vector<T*>& View()
+	{
+		return Registry<T>();
 	}
 
+	// The functions below return copies of the registries, kept for code that wants to hold on to a list of entities
+	// (e.g. the scene's UI). Prefer View<T>() in code that runs every frame
 	std::vector<Obstacle*> GetAllObstacleEntities()
 	{
-		std::vector<Obstacle*> allObstacleEntities;
-		allObstacleEntities.reserve(mEntities.size());
-
-		for (auto& [id, entityObstaclePtr] : mEntities)
-		{
-			if (dynamic_cast<Obstacle*>(entityObstaclePtr.get()))
-			{
-				allObstacleEntities.emplace_back(static_cast<Obstacle*>(entityObstaclePtr.get()));
-			}
-		}
-
-		return allObstacleEntities;
+		return mObstacles;
 	}
 
 	std::vector<Boat*> GetAllBoatEntities(EntityID excludeID = NO_ID)
 	{
 		std::vector<Boat*> allBoatEntities;
-		allBoatEntities.reserve(mEntities.size());
+		allBoatEntities.reserve(mBoats.size());
 
-		for (const auto& [id, entityBoatPtr] : mEntities)
+		for (Boat* boat : mBoats)
 		{
-			// Use dynamic_cast to check if the entity is a Boat
-			if (dynamic_cast<Boat*>(entityBoatPtr.get()) && id != excludeID)
-			{
-				allBoatEntities.emplace_back(static_cast<Boat*>(entityBoatPtr.get()));
-			}
+			if (boat->GetID() != excludeID)  allBoatEntities.emplace_back(boat);
 		}
 
 		return allBoatEntities;
@@ -270,14 +667,11 @@ public:
 	std::vector<EntityID> GetAllBoatIDS(EntityID excludeID = NO_ID)
 	{
 		std::vector<EntityID> allBoatIDS;
+		allBoatIDS.reserve(mBoats.size());
 
-		for (const auto& [id, entityBoatPtr] : mEntities)
+		for (Boat* boat : mBoats)
 		{
-			// Use dynamic_cast to check if the entity is a Boat
-			if (dynamic_cast<Boat*>(entityBoatPtr.get()) && id != excludeID)
-			{
-				allBoatIDS.emplace_back(id);
-			}
+			if (boat->GetID() != excludeID)  allBoatIDS.emplace_back(boat->GetID());
 		}
 
 		return allBoatIDS;
@@ -285,50 +679,17 @@ public:
 
 	std::vector<ReloadStation*> GetAllReloadStationEntities()
 	{
-		std::vector<ReloadStation*> allReloadStationEntities;
-		allReloadStationEntities.reserve(mEntities.size());
-
-		for (const auto& [id, entityPtr] : mEntities)
-		{
-			if (dynamic_cast<ReloadStation*>(entityPtr.get()))
-			{
-				allReloadStationEntities.emplace_back(static_cast<ReloadStation*>(entityPtr.get()));
-			}
-		}
-
-		return allReloadStationEntities;
+		return mReloadStations;
 	}
 
 	std::vector<RandomCrate*> GetAllCratesEntities()
 	{
-		std::vector<RandomCrate*> allCratesEntities;
-		allCratesEntities.reserve(mEntities.size());
-
-		for (const auto& [id, entityPtr] : mEntities)
-		{
-			if (dynamic_cast<RandomCrate*>(entityPtr.get()))
-			{
-				allCratesEntities.emplace_back(static_cast<RandomCrate*>(entityPtr.get()));
-			}
-		}
-
-		return allCratesEntities;
+		return mCrates;
 	}
 
 	std::vector<SeaMine*> GetAllMinesEntities()
 	{
-		std::vector<SeaMine*> allSeaMinesEntities;
-		allSeaMinesEntities.reserve(mEntities.size());
-
-		for (const auto& [id, entityPtr] : mEntities)
-		{
-			if (dynamic_cast<SeaMine*>(entityPtr.get()))
-			{
-				allSeaMinesEntities.emplace_back(static_cast<SeaMine*>(entityPtr.get()));
-			}
-		}
-
-		return allSeaMinesEntities;
+		return mMines;
 	}
 
 
@@ -337,14 +698,210 @@ public:
 	//--------------------------------------------------------------------------------------
 public:
 	// Render all entities in a particular render group (see render group comments in Entity.h)
-	void RenderGroup(unsigned int group);
+	// If a frustum is given (see Camera::GetFrustum) entities outside it are skipped, see Entity::Render. If an occlusion culler
+	// is given then moving entities are tested against the depth of the static entities, which are rendered first, and are not
+	// drawn by the GPU if they are hidden behind them (see OcclusionCuller.h)
+	// With sorted rendering on the draws are sorted in the given order before they are submitted, pass BackToFront for groups
+	// with blending (see RenderQueue.h)
+	// The static and moving entities can be rendered in separate calls by passing a render set. Static entities are never
+	// occlusion tested, so rendering them twice with the same frustum draws exactly the same meshes each time, which a depth
+	// pre-pass relies on (see Scene::RenderFromCamera)
+	enum class RenderSet
+	{
+		All,
+		StaticOnly,
+		MovingOnly,
+	};
+	void RenderGroup(unsigned int group, const Frustum* cullFrustum = nullptr, OcclusionCuller* occlusion = nullptr,
+	                 DrawOrder order = DrawOrder::FrontToBack, RenderSet set = RenderSet::All);
+
+	// Render all entities regardless of group, optionally culling and sorting them as above
+	void RenderAll(const Frustum* cullFrustum = nullptr, OcclusionCuller* occlusion = nullptr, DrawOrder order = DrawOrder::FrontToBack);
+
+	// Several views of the same frame (e.g. picture-in-picture cameras) share one culling pass rather than each going through
+	// every render group's entities. CullViews works out each entity's world bounding sphere once and tests it against every
+	// view's frustum, keeping a list of each view's visible entities in every group (static entities first, in their sorted
+	// order). RenderView then renders a group for one view from its list without testing the entities again. Level of detail,
+	// instancing and sorting are still done per view as they depend on the camera, call SetLODView before each view. The lists
+	// are valid until entities are created or destroyed. Occlusion culling is not used for these views
+	static constexpr unsigned int MAX_VIEWS = 8;
+	void CullViews(const Frustum* const* frustums, unsigned int numViews);
+	void RenderView(unsigned int group, unsigned int view, const Frustum& frustum, DrawOrder order = DrawOrder::FrontToBack);
 
-	// Render all entities regardless of group
-	void RenderAll();
+	// Whether RenderGroup / RenderAll queue the draws of each entity and sort them by render state before submitting them, rather
+	// than drawing the entities in the order they are stored. Entities being tested by the occlusion culler are still drawn directly
+	bool& SortedRendering()  { return mSortedRendering; }
+
+	// Whether the sorted draws are recorded into deferred contexts on the job system's worker threads when there are enough of
+	// them, then submitted in order on this thread (see RenderQueue.h). Needs a job system, see SetJobSystem
+	bool& ParallelRecording()  { return mRenderQueue.ParallelRecording(); }
+
+	// Whether RenderGroup / RenderAll use instanced rendering. When on, visible entities that share a mesh and tint colour are
+	// drawn together with one draw call per sub-mesh (see Mesh::RenderInstanced). Skinned meshes, and meshes that the occlusion
+	// culler would test, are still drawn one entity at a time
+	bool& InstancedRendering()  { return mInstancedRendering; }
+
+	// Whether RenderGroup / RenderAll / RenderView draw the static entities of each group from merged batches, with one draw for
+	// each material in each grid cell rather than drawing the entities one by one (see StaticBatcher.h). The batches are built
+	// before the first render after static entities are created or destroyed. Entities that can't be batched, and static
+	// entities attached to others, are still drawn one at a time. Batched entities must not be moved, call RebuildStaticBatches
+	// after moving any
+	bool& StaticBatching()  { return mStaticBatching; }
+	void  RebuildStaticBatches();
+
+	// Number of static entities drawn by the batches above, across all render groups
+	uint32_t GetNumStaticBatched();
+
+	// Set the GPU culler used for instanced rendering when it is enabled (see GpuCuller.h). Entities that would be drawn instanced
+	// are then frustum culled by a compute shader rather than here, in batches of every entity sharing a mesh and colour. They are
+	// counted as GPU culled in the render stats rather than rendered or culled. Pass nullptr to cull them all on the CPU (the
+	// default). The culler must exist for as long as it is set here
+	void SetGpuCuller(GpuCuller* gpuCuller)  { mGpuCuller = gpuCuller; }
+
+	// Set the renderer for impostors (see ImpostorRenderer.h). When it is set and enabled, visible entities that their level of
+	// detail puts beyond their template's impostor screen size (see EntityTemplate::SetImpostor) are drawn by it as a single quad,
+	// after the other entities of each list. Pass nullptr to always draw meshes (the default). The renderer must exist for as
+	// long as it is set here
+	void SetImpostorRenderer(ImpostorRenderer* impostorRenderer)  { mImpostorRenderer = impostorRenderer; }
+
+	// Whether RenderGroup / RenderAll render entities with the lower levels of detail of their templates when they are small on
+	// screen (see EntityTemplate::AddLOD). Sizes are measured from the view given to SetLODView, call it before rendering each
+	// camera view. Pass the camera position and its projection matrix's Y scale (e11). Until then the main meshes are used
+	bool& LevelOfDetail()  { return mLevelOfDetail; }
+	void  SetLODView(const Vector3& cameraPosition, float projectionScale)
+	{
+		mLODCameraPosition  = cameraPosition;
+		mLODProjectionScale = projectionScale * mLODScale;
+		mRenderQueue.SetProjectionScale(projectionScale * mLODScale);
+	}
+
+	// Scale for the sizes on screen measured from the view in SetLODView, 1 by default. Below 1 entities switch to their lower
+	// levels of detail sooner and ask for smaller textures, e.g. to save GPU memory (see MemoryBudget.h). Applies from the next
+	// SetLODView
+	float& LODScale()  { return mLODScale; }
+
+	// Whether sorted draws that are small on screen use cheaper shaders, e.g. normal mapping in place of parallax mapping (see
+	// RenderQueue::ShaderLOD). Sizes are measured from the view given to SetLODView
+	bool& ShaderLevelOfDetail()  { return mRenderQueue.ShaderLOD(); }
+
+	// Number of entities rendered and skipped by frustum culling in the RenderGroup / RenderAll calls since the last reset. Instanced
+	// is how many of the rendered entities were drawn instanced, in the given number of batches. Reduced detail is how many were
+	// drawn with a lower level of detail. Sorted draws are the sub-mesh draws submitted through the render queue, with the render
+	// state changes between them before and after sorting. Command lists are how many deferred context recordings were executed.
+	// GPU culled is how many entities were sent to the GPU culler, drawn with the given number of indirect draws. Reduced shaders
+	// are the sorted draws that used a cheaper shader level of detail. Impostors is how many of the rendered entities were drawn
+	// as impostors. Static batch draws are the draws of merged static entities, with the batches culled (see StaticBatching)
+	struct RenderStats
+	{
+		uint32_t rendered  = 0;
+		uint32_t culled    = 0;
+		uint32_t gpuCulled     = 0;
+		uint32_t indirectDraws = 0;
+		uint32_t reducedDetail = 0;
+		uint32_t instanced = 0;
+		uint32_t batches   = 0;
+		uint32_t sortedDraws          = 0;
+		uint32_t stateChanges         = 0;
+		uint32_t unsortedStateChanges = 0;
+		uint32_t commandLists         = 0;
+		uint32_t reducedShaders       = 0;
+		uint32_t impostors            = 0;
+		uint32_t staticBatchDraws     = 0;
+		uint32_t staticBatchesCulled  = 0;
+	};
+	const RenderStats& GetRenderStats()    { return mRenderStats; }
+	void               ResetRenderStats();
 	
 	// Call all current entity's Update functions. Any entity that returns false will be destroyed
+	// Entities whose class doesn't override Entity::Update are static and are skipped, see CreateEntity
+	// If a job system has been set, entities that support it (see Entity::CanUpdateInParallel) are updated on its worker threads
+	// after all other entities have been updated. The results are the same each run, whichever threads do the work
 	void UpdateAll(float frameTime);
 
+	// Storage for the transformation matrices of all entities, used by the Entity class, see TransformStore.h
+	TransformStore& Transforms()  { return mTransforms; }
+
+	// Grid of the boats, crates, mines and reload stations by position, for finding entities near a point, see SpatialGrid.h
+	// Positions in the grid are brought up to date at the start of UpdateAll and after each entity is updated
+	const SpatialGrid& Spatial()  { return mSpatialGrid; }
+
+	// Tree of the obstacles' bounding boxes for line of sight and overlap tests, see ObstacleBVH.h. The tree is rebuilt after
+	// obstacles are created or destroyed, here on first use or at the start of UpdateAll, so it is never rebuilt while entities
+	// are being updated on worker threads
+	const ObstacleBVH& ObstacleTree()
+	{
+		RebuildObstacleTree();
+		return mObstacleTree;
+	}
+
+	// Grid of the cells blocked by obstacles with flow fields for finding routes around them, see NavigationField.h. The grid
+	// is rebuilt along with the obstacle tree. Only use DirectionToGoal from entities updated on the main thread
+	NavigationField& Navigation()
+	{
+		RebuildObstacleTree();
+		return mNavigation;
+	}
+
+	// Trigger volumes that send messages when entities enter or leave them, see TriggerSystem.h. Triggers are checked once
+	// all entities have been updated in UpdateAll. Don't add or remove triggers from entities updated on worker threads
+	TriggerSystem& Triggers()  { return mTriggers; }
+
+	// Up and down motion of floating props, see BobbingSystem.h. All motions are updated together once all entities have been
+	// updated in UpdateAll. Don't add or remove motions from entities updated on worker threads
+	BobbingSystem& Bobbing()  { return mBobbing; }
+
+	// Rebuilds the boats' gun matrices once all entities have been updated in UpdateAll, less often for boats small on screen or
+	// out of view, see WeaponSystem.h. Add the views rendered each frame to it
+	WeaponSystem& Weapons()  { return mWeapons; }
+
+	// What each patrolling boat can see, see SensorSystem.h. Refreshed at the start of UpdateAll, before any entity is updated
+	SensorSystem& Sensors()  { return mSensors; }
+
+	// What each team knows about its enemies and which boat is to go after which, see TeamBlackboard.h. Brought up to date at
+	// the start of UpdateAll, straight after the sensors
+	TeamBlackboard& Blackboard()  { return mBlackboard; }
+
+	// What each boat is to do next, if the utility AI decisions are enabled, see DecisionSystem.h. Boats due to decide do so
+	// at the start of UpdateAll, after the team blackboard
+	DecisionSystem& Decisions()  { return mDecisions; }
+
+	// Launch velocities for missiles, see BallisticSolver.h. Every aiming boat's is solved together at the start of UpdateAll
+	BallisticSolver& Ballistics()  { return mBallistics; }
+
+	// Every boat's health, weapon, movement, shield and team in packed arrays, see BoatComponents.h. Boats add theirs when
+	// created and they are removed when the boat is destroyed
+	BoatComponents& BoatData()  { return mBoatData; }
+
+	// The results of the hits on each boat this update, applied to the boats' health before any entity is updated in
+	// UpdateAll, see DamageSystem.h
+	const DamageSystem& Damage()  { return mDamage; }
+
+	// Behaviours written as coroutines, see Behaviour.h. Resumed in UpdateAll once their waits are over, after the hits have
+	// been applied and before any entity is updated. An entity's behaviour is stopped when it is destroyed
+	BehaviourScheduler& Behaviours()  { return mBehaviours; }
+
+	// The reload station each reloading boat is queued at and whose turn it is, see ReloadService.h. Boats and stations are
+	// removed from it when they are destroyed
+	ReloadService& Reloads()  { return mReloads; }
+
+	// Which boat is going for each crate, see CrateReservations.h. A crate's reservation is removed when it is destroyed
+	CrateReservations& Reservations()  { return mReservations; }
+
+	// Time taken updating and rendering each type of entity and the most expensive entities, see EntityCosts.h. Off by default
+	EntityCosts& Costs()  { return mCosts; }
+
+	// GPU time of drawing each template and surface render method, sampled a few templates a frame, see GpuTemplateCosts.h.
+	// Off by default
+	GpuTemplateCosts& GpuCosts()  { return mGpuCosts; }
+
+	// Set the job system used to update entities in parallel in UpdateAll. Pass nullptr to update all entities on the calling
+	// thread (the default). The job system must exist for as long as it is set here
+	void SetJobSystem(JobSystem* jobSystem)
+	{
+		mJobSystem = jobSystem;
+		mRenderQueue.SetJobSystem(jobSystem);
+	}
+
 
 	// If the CreateEntityTemplate or CreateEntity functions return nullptr to indicate an error, the text description
 	// of the (most recent) error can be fetched with this function
@@ -353,19 +910,441 @@ public:
 	// Clear any error - useful to do before a block of Create operations, then check last error only once at the end
 	void ClearLastError() { mLastError = ""; }
 
+	// Record an error from creating a template or entity outside the manager (see AddEntityTemplate), for GetLastError
+	void SetLastError(const std::string& error) { mLastError = error; }
+
+
+	//--------------------------------------------------------------------------------------
+	// Private Helpers
+	//--------------------------------------------------------------------------------------
+private:
+	// Select the registry for a given entity type at compile time
+	template <typename T>
+	std::vector<T*>& Registry()
+	{
+		if      constexpr (std::is_same_v<T, Boat>)           return mBoats;
+		else if constexpr (std::is_same_v<T, Obstacle>)       return mObstacles;
+		else if constexpr (std::is_same_v<T, ReloadStation>)  return mReloadStations;
+		else if constexpr (std::is_same_v<T, RandomCrate>)    return mCrates;
+		else if constexpr (std::is_same_v<T, SeaMine>)        return mMines;
+		else if constexpr (std::is_same_v<T, Missile>)        return mMissiles;
+		else static_assert(!sizeof(T*), "EntityManager: no registry for this entity type");
+	}
+
+	// Add a newly created entity to each registry that matches its type (or one of its base types)
+	template <typename EntityType>
+	void AddToRegistries(EntityType* entity)
+	{
+		if constexpr (std::is_base_of_v<Boat,          EntityType>)  { mBoats.push_back(entity);  ++mBoatListVersion; }
+		if constexpr (std::is_base_of_v<Obstacle,      EntityType>)  { mObstacles.push_back(entity);  mObstacleTreeDirty = true; }
+		if constexpr (std::is_base_of_v<ReloadStation, EntityType>)  mReloadStations.push_back(entity);
+		if constexpr (std::is_base_of_v<RandomCrate,   EntityType>)  mCrates        .push_back(entity);
+		if constexpr (std::is_base_of_v<SeaMine,       EntityType>)  mMines         .push_back(entity);
+		if constexpr (std::is_base_of_v<Missile,       EntityType>)  mMissiles      .push_back(entity);
+	}
+
+	// Make room for the given number of new entities of a type in each registry that matches it, see CreateEntities
+	template <typename EntityType>
+	void ReserveRegistries(size_t count)
+	{
+		if constexpr (std::is_base_of_v<Boat,          EntityType>)  mBoats         .reserve(mBoats.size()          + count);
+		if constexpr (std::is_base_of_v<Obstacle,      EntityType>)  mObstacles     .reserve(mObstacles.size()      + count);
+		if constexpr (std::is_base_of_v<ReloadStation, EntityType>)  mReloadStations.reserve(mReloadStations.size() + count);
+		if constexpr (std::is_base_of_v<RandomCrate,   EntityType>)  mCrates        .reserve(mCrates.size()         + count);
+		if constexpr (std::is_base_of_v<SeaMine,       EntityType>)  mMines         .reserve(mMines.size()          + count);
+		if constexpr (std::is_base_of_v<Missile,       EntityType>)  mMissiles      .reserve(mMissiles.size()       + count);
+	}
+
+	// Remove all entities that are marked for destruction from the typed registries
+	void RemoveDestroyedFromRegistries();
+
+	// Construct a template registered with RegisterEntityTemplate and add it to the templates, waiting for it to finish if it
+	// is being prefetched. Returns false if there is no such template or it fails to load, with the last error set
+	bool LoadPendingTemplate(Atom type);
+
+	// The constructed template of the given type, constructing it first if it was registered to load when needed. Returns
+	// nullptr if there is no such template or it fails to load, with the last error set
+	EntityTemplate* FindTemplate(Atom type)
+	{
+		auto found = mEntityTemplates.find(type);
+		if (found != mEntityTemplates.end())  return found->second.get();
+		if (!LoadPendingTemplate(type))  return nullptr;
+		return mEntityTemplates[type].get();
+	}
+
+	// Remove a registered template that hasn't been constructed, waiting for it first if it is being prefetched
+	void CancelPendingTemplate(Atom type);
+
+	// A template version no other entity manager has used, so handles found with an earlier manager are never taken as current
+	static uint64_t NextTemplatesVersion()
+	{
+		static uint64_t lastVersion = 0;
+		return ++lastVersion;
+	}
+
+	// Add the templates whose prefetch has finished, called at the start of each update. Then start loading the templates that
+	// entities are waiting for with a stand-in, see StartStreamingLoads
+	void CollectPrefetchedTemplates();
+
+	// Whether entities of a type are created with a stand-in while their template loads (see CreateEntity), decided at compile
+	// time. Only purely visual types, none of the gameplay depends on their mesh's nodes or bounds: plain entities (scenery,
+	// the base class itself rather than anything inherited from it) and shields. Gameplay types aren't streamed, a box can't
+	// give them the mesh nodes and bounds their logic reads (e.g. a boat's gun turret and barrel nodes, an obstacle's box)
+	template <typename EntityType>
+	static constexpr bool StreamsTemplate()
+	{
+		return std::is_same_v<Entity, EntityType> || std::is_base_of_v<Shield, EntityType>;
+	}
+
+	// The stand-in template for a registered template of the given type that hasn't been constructed, asking for the template
+	// to be streamed. Returns nullptr if the template is constructed (or isn't registered), or if streaming is off
+	EntityTemplate* ProxyTemplate(Atom type);
+
+	// Move the entities of a type's stand-in template to the template now it has been constructed. If there is still no template,
+	// because it failed to load or was removed, the entities are destroyed
+	void ReplaceProxyTemplate(Atom type);
+
+	// Start loading the templates that entities are waiting for with a stand-in, those with an entity nearest the camera used for
+	// levels of detail first (see SetLODView), keeping at most MAX_STREAMING_LOADS background loads running
+	void StartStreamingLoads();
+
+	// Rebuild the obstacle tree and navigation grid if any obstacles have been created or destroyed since they were last built
+	void RebuildObstacleTree();
+
+	// Select the spatial grid type for a given entity type at compile time, 0 if the type is not put in the grid
+	template <typename EntityType>
+	static constexpr uint32_t SpatialTypeOf()
+	{
+		if      constexpr (std::is_base_of_v<Boat,          EntityType>)  return SPATIAL_BOAT;
+		else if constexpr (std::is_base_of_v<RandomCrate,   EntityType>)  return SPATIAL_CRATE;
+		else if constexpr (std::is_base_of_v<SeaMine,       EntityType>)  return SPATIAL_MINE;
+		else if constexpr (std::is_base_of_v<ReloadStation, EntityType>)  return SPATIAL_RELOAD_STATION;
+		else return 0;
+	}
+
+	// Select the type an entity type's update and render times are added to at compile time, see Costs()
+	template <typename EntityType>
+	static constexpr CostType CostTypeOf()
+	{
+		if      constexpr (std::is_base_of_v<Boat,        EntityType>)  return CostType::Boat;
+		else if constexpr (std::is_base_of_v<Missile,     EntityType>)  return CostType::Missile;
+		else if constexpr (std::is_base_of_v<SeaMine,     EntityType>)  return CostType::SeaMine;
+		else if constexpr (std::is_base_of_v<RandomCrate, EntityType>)  return CostType::Crate;
+		else if constexpr (std::is_base_of_v<Shield,      EntityType>)  return CostType::Shield;
+		else return CostType::Other;
+	}
+
+
+	// Mark an entity for destruction and add it to the kill list. Returns false if the entity doesn't exist or is already marked
+	bool QueueDestroy(EntityID id);
+
+	// Destroy all entities on the kill list
+	void FlushDestroyedEntities();
+
+	// Update the entities that can be updated in parallel using the job system, part of UpdateAll
+	void UpdateParallelEntities(float frameTime);
+
+	// Add or remove an entity from the list of its render group, see mRenderGroups
+	void AddToRenderGroup(Entity* entity);
+	void RemoveFromRenderGroup(Entity* entity);
+
+	// Sort the static entities of a render group if any have been added or removed since they were last sorted
+	void SortStaticEntities(unsigned int group);
+
+	// The static entities of a render group to render one at a time - all of them, or those the group's batches don't draw with
+	// static batching on, after rebuilding the batches that have changed
+	const std::vector<Entity*>& UnbatchedStaticEntities(unsigned int group);
+
+	// Draw the static batches of a render group visible in the frustum if static batching is on, updating the render stats
+	void RenderStaticBatches(unsigned int group, const Frustum* cullFrustum);
+
+	// Render the static then the moving entities of a render group, optionally only one of them, for RenderGroup / RenderAll
+	void RenderGroupEntities(unsigned int group, const Frustum* cullFrustum, OcclusionCuller* occlusion, DrawOrder order, RenderSet set);
+
+	// Render an entity for RenderGroup / RenderAll, skipping it if it is outside the frustum and testing it for occlusion if an
+	// occlusion culler is given. Updates the render stats
+	void RenderEntity(Entity* entity, const Frustum* cullFrustum, OcclusionCuller* occlusion);
+
+	// RenderEntity, also adding the time it took to the entity costs when they are enabled, see Costs()
+	void RenderEntityTimed(Entity* entity, const Frustum* cullFrustum, OcclusionCuller* occlusion);
+
+	// Render an entity already found to be visible by CullViews, for RenderView. Instanced entities are only gathered, as above
+	void RenderCulledEntity(Entity* entity, const Frustum& frustum);
+
+	// Render the instances and sorted draws gathered by the calls above, see FlushDraws, timing them if the entity costs are enabled
+	void FlushDrawsTimed(const Frustum* cullFrustum, DrawOrder order);
+
+	// Whether an entity is held back from its list to be drawn by RenderMeasured, as the GPU costs are measuring its template
+	// this frame. Adds it to mMeasuredList if so
+	bool HoldBackMeasured(Entity* entity);
+
+	// Render the entities held back by HoldBackMeasured once the rest of their list is drawn, one template at a time between the
+	// GPU costs' timestamps, each template's instances and sorted draws flushed on their own. With culled the entities were
+	// culled by CullViews and are rendered as RenderView does, otherwise as RenderGroup does
+	void RenderMeasured(const Frustum* cullFrustum, OcclusionCuller* occlusion, DrawOrder order, bool culled);
+
+	// Render the entities gathered for instanced rendering by RenderEntity, in batches sharing a mesh and colour, then clear the list
+	void RenderInstances(const Frustum* cullFrustum);
+
+	// Whether instanced entities are culled by the GPU culler when rendering with the given frustum
+	bool UseGpuCulling(const Frustum* cullFrustum);
+
+	// Draw an entity that isn't instanced or occlusion tested, adding it to the render queue if sorted rendering is on
+	void DrawEntity(Entity* entity, const Frustum* cullFrustum);
+
+	// Whether a visible entity is to be drawn as an impostor, and passing it to the impostor renderer. DrawImpostor returns false
+	// if the impostor couldn't be drawn, the entity is then drawn with its mesh
+	bool UseImpostor(Entity* entity);
+	bool DrawImpostor(Entity* entity, const BoundingSphere& bounds);
+
+	// Render the instances and the sorted draws gathered from a list of entities, and update the render stats
+	void FlushDraws(const Frustum* cullFrustum, DrawOrder order);
+
+	// Add or remove an entity from the name lookup table, unnamed entities are not added
+	void AddToNameIndex(Entity* entity);
+	void RemoveFromNameIndex(Entity* entity);
+
+	// Remove an entity from all the manager's lists and delete it. The entity must already have been removed from the typed registries
+	void DestroyEntityNow(EntityID id);
+
+
+	// Get a free slot for a new entity and return the ID that refers to it. Returns NO_ID if all slots are in use
+	EntityID AllocateID();
+
+	// Return a slot to the free list, increasing its generation so existing IDs for the slot become stale
+	void ReleaseSlot(uint32_t index);
+
+	// Take the slot of the given ID off the free list for an entity with that ID, adding slots up to it if needed. Returns false
+	// if the slot is in use or reserved
+	bool ClaimID(EntityID id);
+
+	// Find the entity with the given ID, returns nullptr if the ID is invalid or stale
+	Entity* FindEntity(EntityID id)
+	{
+		uint32_t index = EntityIndex(id);
+		if (index < FIRST_ENTITY_ID || index >= mSlots.size())  return nullptr;
+
+		EntitySlot& slot = mSlots[index];
+		if (slot.generation != EntityGeneration(id))  return nullptr;
+		return slot.entity.get();
+	}
+
 
 	//--------------------------------------------------------------------------------------
 	// Private Data
 	//--------------------------------------------------------------------------------------
 private:
-	// Entity templates are ordered and searched for by name
-	std::map<std::string, std::unique_ptr<EntityTemplate>> mEntityTemplates;
+	// Entity templates are searched for by their type's atom, a hash of a number
+	std::unordered_map<Atom, std::unique_ptr<EntityTemplate>> mEntityTemplates;
+
+	// Changes whenever a constructed template is replaced or destroyed, so template handles know to find their template again.
+	// Adding a template doesn't change it, the templates are held by pointer so others don't move
+	uint64_t mTemplatesVersion = NextTemplatesVersion();
+
+	// Templates registered to be constructed when first needed, see RegisterEntityTemplate. A prefetched template's load is
+	// valid while it is constructed on a background thread, the D3D context is kept thread-safe until the result is collected
+	struct TemplateLoadResult
+	{
+		std::unique_ptr<EntityTemplate> entityTemplate; // nullptr if it failed to load
+		std::string error;
+	};
+	struct PendingTemplate
+	{
+		TemplateFactory                  create;
+		std::future<TemplateLoadResult>  load;
+		bool                             streamed = false; // Entities are waiting for it with a stand-in, see ProxyTemplate
+		TemplateBounds                   bounds;           // Size of its stand-in
+	};
+	std::unordered_map<Atom, PendingTemplate> mPendingTemplates;
+
+	// Stand-ins for templates that are streaming, each holding the entities created before its template was ready. Those whose
+	// bounds are known have a box mesh of that size, the others share a small box mesh, made when first needed. See CreateEntity
+	static constexpr unsigned int MAX_STREAMING_LOADS = 2;
+	static constexpr float        PROXY_HALF_SIZE     = 1.5f;
+	inline static const ColourRGB PROXY_COLOUR        = { 0.3f, 0.3f, 0.35f };
+	std::unordered_map<Atom, std::unique_ptr<EntityTemplate>> mProxyTemplates;
+	std::shared_ptr<Mesh> mProxyMesh;
+	bool                  mTemplateStreaming = true;
+
+	// Matrices for all entities. Declared before the entity slots so it is destroyed after the entities are
+	TransformStore mTransforms;
+
+	// Entities are stored in slots and found directly from the slot index in their ID (see EntityTypes.h). A slot's generation
+	// is increased whenever its entity is destroyed, so IDs held for an old entity no longer match when the slot is reused
+	struct EntitySlot
+	{
+		std::unique_ptr<Entity> entity;
+		uint32_t generation     = 0;
+		uint32_t liveIndex      = 0;     // Position of the entity in mLiveEntities
+		uint32_t templateIndex  = 0;     // Position of the entity in its template's list of entities
+		bool     destroyPending = false; // Entity is on the kill list
+		bool     parallelUpdate = false; // Entity can be updated on a worker thread, from Entity::CanUpdateInParallel
+		bool     isStatic       = false; // Entity has no Update of its own so is never updated, see CreateEntity
+		uint32_t updateIndex    = 0;     // Position of the entity in mUpdateEntities (if not static)
+		uint32_t groupIndex     = 0;     // Position of the entity in its render group's moving entities (if not static)
+		CostType costType       = CostType::Other; // Which entity costs its times are added to, see Costs()
+	};
+	std::vector<EntitySlot> mSlots = std::vector<EntitySlot>(FIRST_ENTITY_ID); // The first few slots are reserved for NO_ID, SYSTEM_ID etc.
+
+	// Entities attached to others, indexed by the child's slot index. An entry belongs to the entity in the slot if its owner
+	// matches, see Attach. The attached children are also listed by slot index in the order they are resolved: sorted by the
+	// depth of their attachment (children of unattached entities first), then by slot index so the order is the same each run.
+	// The order is sorted again after attachments are added or removed
+	struct Attachment
+	{
+		EntityID  owner  = NO_ID;
+		EntityID  parent = NO_ID;
+		Matrix4x4 local;
+	};
+	std::vector<Attachment> mAttachments;
+	std::vector<uint32_t>   mAttachOrder;
+	bool                    mAttachOrderChanged = false;
+
+	// Set the matrices of all attached entities from their parents, see Attach
+	void ResolveAttachments();
+
+	// Indexes of slots available for reuse. The oldest freed slot is reused first, which spreads reuse over all free slots and so
+	// generations increase slowly - a stale ID will only be mistaken for a live one after its slot has been reused 65536 times
+	std::deque<uint32_t> mFreeSlots;
+
+	// Every live entity packed together so updating and rendering don't need to skip empty slots. When an entity is destroyed
+	// the last entity is moved into its place, so this list is not in any particular order
+	std::vector<Entity*> mLiveEntities;
+
+	// The live entities that need updating each frame, kept in the same way as the live list. Static entities are never updated
+	std::vector<Entity*> mUpdateEntities;
+
+	// The live entities of each render group, indexed by group number, so rendering a group only visits its own entities. Each
+	// group's moving (updated) entities are kept like the live list. Its static entities are sorted by template so rendering them
+	// draws entities sharing a mesh one after another, which is the order instancing batches and the render queue work best
+	// with. They are sorted again before rendering after any are added or removed. The static entities are also merged into
+	// the group's batches, those the batches don't draw are kept in order in the unbatched list (see StaticBatching)
+	struct RenderGroupList
+	{
+		std::vector<Entity*> staticEntities;
+		std::vector<Entity*> movingEntities;
+		bool staticDirty = false;
+		StaticBatcher        batches;
+		std::vector<Entity*> unbatchedEntities;
+	};
+	std::vector<RenderGroupList> mRenderGroups;
+
+	// Visible entities of each view in each render group from the last CullViews, indexed by group then view
+	std::vector<std::array<std::vector<Entity*>, MAX_VIEWS>> mViewEntities;
+	unsigned int mNumViews = 0;
+
+	// Look up entity IDs by the atom of their name
+	std::unordered_multimap<Atom, EntityID> mNameIndex;
+
+	// Entities waiting to be destroyed at the end of the update phase, and the batch currently being destroyed
+	std::vector<EntityID> mKillList;
+	std::vector<EntityID> mKillBatch;
+	bool mUpdating = false; // True while UpdateAll is running, destruction is deferred during that time
+	bool mFlushing = false; // True while FlushDestroyedEntities is running, nested flushes only add to the kill list
+
+	// Templates to destroy after the update phase or flush during which DestroyEntityTemplate was called, and stand-ins whose
+	// template failed to load then, removed once their entities have been destroyed (see ReplaceProxyTemplate)
+	std::vector<Atom> mDeferredTemplates;
+	std::vector<Atom> mDeferredProxies;
+	uint64_t mNumDestroyed = 0; // See GetNumDestroyed
+	uint64_t mBoatListVersion = 0; // See GetBoatListVersion
+	uint64_t mStaticVersion   = 0; // See GetStaticVersion
+
+	// Parallel update - the entities updated on worker threads this frame, split into chunks of PARALLEL_CHUNK_SIZE entities. Each
+	// chunk has its own list of entities whose Update returned false, these are added to the kill list in chunk order afterwards
+	static constexpr size_t PARALLEL_CHUNK_SIZE = 32;
+	JobSystem* mJobSystem = nullptr;
+	std::vector<Entity*> mParallelEntities;
+	std::vector<int64_t> mParallelTicks; // Update time of each of mParallelEntities, while the entity costs are enabled
+	std::vector<std::vector<EntityID>> mChunkKillLists;
+
+	// Typed registries of the entities above, see View<T>(). Entities are kept in creation order
+	std::vector<Boat*>          mBoats;
+	std::vector<Obstacle*>      mObstacles;
+	std::vector<ReloadStation*> mReloadStations;
+	std::vector<RandomCrate*>   mCrates;
+	std::vector<SeaMine*>       mMines;
+	std::vector<Missile*>       mMissiles;
+
+	// Positions of the entities in the registries above except obstacles, see Spatial()
+	SpatialGrid mSpatialGrid;
+
+	// Obstacles don't move so they are held in a tree that is only rebuilt when the obstacle registry changes, see ObstacleTree()
+	ObstacleBVH mObstacleTree;
+	bool mObstacleTreeDirty = false;
+
+	// Navigation grid over the obstacles, rebuilt with the obstacle tree, see Navigation()
+	NavigationField mNavigation;
+
+	// Trigger volumes of entities such as mines and crates, see Triggers()
+	TriggerSystem mTriggers;
+
+	// Bobbing motions of floating entities such as mines and crates, see Bobbing()
+	BobbingSystem mBobbing;
+
+	// Works out every boat's avoidance steering at the start of UpdateAll
+	SteeringSystem mSteering;
+
+	// Visible enemies of patrolling boats and cached lines of sight, see Sensors()
+	SensorSystem mSensors;
+
+	// Known enemies and boat assignments of each team, see Blackboard()
+	TeamBlackboard mBlackboard;
+
+	// Utility scored choices of the boats' next actions, see Decisions()
+	DecisionSystem mDecisions;
+
+	// Solves the launch velocities of aiming boats at the start of UpdateAll, see Ballistics()
+	BallisticSolver mBallistics;
+
+	// Boat data and the systems that work on all of it in UpdateAll, applying hits before the entities are updated, then
+	// moving the boats and turning their guns after, see BoatData()
+	BoatComponents   mBoatData;
+	DamageSystem     mDamage;
+	NavigationSystem mBoatMovement;
+	WeaponSystem     mWeapons;
+
+	// Coroutine behaviours of the entities, see Behaviours()
+	BehaviourScheduler mBehaviours;
+
+	// Reload station queues, see Reloads()
+	ReloadService mReloads;
+
+	// Crates boats are going for, see Reservations()
+	CrateReservations mReservations;
+
+	// Update and render times by type of entity, see Costs()
+	EntityCosts mCosts;
+
+	// GPU times by template, see GpuCosts(), and the entities held back from the current list to measure, see HoldBackMeasured
+	GpuTemplateCosts     mGpuCosts;
+	std::vector<Entity*> mMeasuredList;
+
+	// Counts of entities rendered and culled, see GetRenderStats
+	RenderStats mRenderStats;
+
+	// Visible entities waiting to be rendered instanced, and the buffer their matrices are written to, see RenderInstances
+	bool mInstancedRendering = true;
+	std::vector<Entity*> mInstanceList;
+	InstanceBuffer mInstanceBuffer;
+	GpuCuller* mGpuCuller = nullptr;
+	std::vector<Matrix4x4> mSceneMatrices; // Working space for an entity's matrices on their way to the GPU culler's scene buffer
+
+	// Draws distant entities as impostors, see SetImpostorRenderer
+	ImpostorRenderer* mImpostorRenderer = nullptr;
+
+	// Level of detail selection and the view it is measured from, see LevelOfDetail
+	bool    mLevelOfDetail = true;
+	Vector3 mLODCameraPosition  = { 0, 0, 0 };
+	float   mLODProjectionScale = 0; // No view set
+	float   mLODScale = 1.0f;
 
-	// Entities are ordered and searched for by ID (not by name for performance reasons)
-	std::map<EntityID, std::unique_ptr<Entity>> mEntities;
+	// Merging the static entities of each render group, see StaticBatching
+	bool mStaticBatching = true;
 
-	// The next entity will get this ID, incremented on each creation
-	EntityID mNextID = FIRST_ENTITY_ID;
+	// Draws waiting to be sorted by render state, see SortedRendering
+	bool mSortedRendering = true;
+	RenderQueue mRenderQueue;
 
 	// Description of the most recent error from CreateEntityTemplate or CreateEntity
 	std::string mLastError;
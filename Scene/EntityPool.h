@@ -0,0 +1,175 @@
+//--------------------------------------------------------------------------------------
+// Pooled storage for short-lived entity types
+//--------------------------------------------------------------------------------------
+// Some entities are created and destroyed constantly during play (missiles, shields, crates, mines). Ordinarily each one
+// is a separate heap allocation when the EntityManager creates it and a heap free when it is destroyed, and under heavy
+// combat that churn of allocations causes frame spikes.
+//
+// An entity class can opt in to pooled storage by also inheriting from PooledEntity, passing its own class name:
+//     class Missile : public Entity, public PooledEntity<Missile>
+//
+// This gives the class its own operator new and delete, so the EntityManager's "new EntityType(...)" and the eventual
+// delete (via the unique_ptr holding the entity) will use the pool without any other change to the code. Memory is taken
+// from the heap in blocks of several entities at a time and is never returned to the heap. Freed entities go onto a free
+// list and are reused by the next entity of the same type, so once the pool has grown to the peak number of entities of
+// that type there is no further heap traffic.
+//
+// The pool is not thread-safe in the same way as the EntityManager itself - only create/destroy entities from one thread
+
+#ifndef _ENTITY_POOL_H_INCLUDED_
+#define _ENTITY_POOL_H_INCLUDED_
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+
+
+/*-----------------------------------------------------------------------------------------
+   Entity Pool
+-----------------------------------------------------------------------------------------*/
+// A simple pool of fixed-size memory slots. Each pool holds one size of object only
+class EntityPool
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create a pool of slots of at least the given size and alignment, allocating slotsPerBlock slots whenever it needs to grow
+	EntityPool(std::size_t slotSize, std::size_t slotAlignment, std::size_t slotsPerBlock = 64)
+		: mSlotsPerBlock(slotsPerBlock)
+	{
+		// Each slot must be able to hold a free list pointer when it isn't in use, and each slot must start on a correctly
+		// aligned address (blocks are allocated with the same alignment)
+		if (slotSize < sizeof(FreeSlot))  slotSize = sizeof(FreeSlot);
+		mSlotAlignment = slotAlignment > alignof(FreeSlot) ? slotAlignment : alignof(FreeSlot);
+		mSlotSize = (slotSize + mSlotAlignment - 1) / mSlotAlignment * mSlotAlignment;
+	}
+
+	// Pool memory is released when the pool is destroyed - all objects in the pool must have been destroyed already
+	~EntityPool()
+	{
+		for (auto block : mBlocks)  ::operator delete(block, std::align_val_t(mSlotAlignment));
+	}
+
+	// Prevent copying - the pool owns its memory blocks
+	EntityPool(const EntityPool&) = delete;
+	EntityPool& operator=(const EntityPool&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Return memory for one object. Only uses the heap if there are no free slots left
+	void* Allocate()
+	{
+		if (mFreeList == nullptr)  Grow();
+
+		FreeSlot* slot = mFreeList;
+		mFreeList = slot->next;
+		++mNumInUse;
+		return slot;
+	}
+
+	// Return memory from Allocate to the pool for reuse
+	void Free(void* p)
+	{
+		if (p == nullptr)  return;
+
+		FreeSlot* slot = static_cast<FreeSlot*>(p);
+		slot->next = mFreeList;
+		mFreeList = slot;
+		--mNumInUse;
+	}
+
+	// Grow the pool to hold at least the given number of objects, so the first of them don't allocate when they are made
+	void Reserve(std::size_t count)
+	{
+		while (NumAllocated() < count)  Grow();
+	}
+
+	// Statistics, e.g. for displaying in a debug UI
+	std::size_t NumInUse()      { return mNumInUse; }
+	std::size_t NumAllocated()  { return mBlocks.size() * mSlotsPerBlock; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// An unused slot holds a pointer to the next unused slot
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+
+	// Allocate another block of slots from the heap and add them all to the free list
+	void Grow()
+	{
+		char* block = static_cast<char*>(::operator new(mSlotSize * mSlotsPerBlock, std::align_val_t(mSlotAlignment)));
+		mBlocks.push_back(block);
+
+		// Push slots in reverse so they are handed out in address order
+		for (std::size_t i = mSlotsPerBlock; i-- > 0;)
+		{
+			FreeSlot* slot = reinterpret_cast<FreeSlot*>(block + i * mSlotSize);
+			slot->next = mFreeList;
+			mFreeList = slot;
+		}
+	}
+
+	std::size_t mSlotSize;
+	std::size_t mSlotAlignment;
+	std::size_t mSlotsPerBlock;
+
+	std::vector<char*> mBlocks;     // All memory blocks taken from the heap
+	FreeSlot*   mFreeList = nullptr; // Singly linked list of unused slots
+	std::size_t mNumInUse = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+   Pooled Entity
+-----------------------------------------------------------------------------------------*/
+// Inherit from this (as well as Entity) to give an entity class pooled storage, see the comment at the top of the file
+// The pool is shared by T and any classes inherited from T that don't have their own pool. Objects of a larger inherited
+// class cannot use the pool and fall back to the normal heap. The fallback keeps T's alignment (entities hold 16-byte
+// aligned matrices), and over-aligned types come through the align_val_t forms with their own alignment
+template <typename T>
+class PooledEntity
+{
+public:
+	static void* operator new(std::size_t size)
+	{
+		return operator new(size, std::align_val_t(alignof(T)));
+	}
+
+	static void* operator new(std::size_t size, std::align_val_t alignment)
+	{
+		if (size != sizeof(T) || static_cast<std::size_t>(alignment) > alignof(T))  return ::operator new(size, alignment);
+		return Pool().Allocate();
+	}
+
+	static void operator delete(void* p, std::size_t size)
+	{
+		operator delete(p, size, std::align_val_t(alignof(T)));
+	}
+
+	static void operator delete(void* p, std::size_t size, std::align_val_t alignment)
+	{
+		if (size != sizeof(T) || static_cast<std::size_t>(alignment) > alignof(T))  ::operator delete(p, alignment);
+		else                                                                        Pool().Free(p);
+	}
+
+	// Access the pool used by this type, e.g. to display statistics
+	static EntityPool& Pool()
+	{
+		// Created on first use and intentionally never destroyed, since entities might still be deleted during program shutdown
+		static EntityPool* pool = new EntityPool(sizeof(T), alignof(T));
+		return *pool;
+	}
+};
+
+
+#endif //_ENTITY_POOL_H_INCLUDED_
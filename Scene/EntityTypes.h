@@ -12,13 +12,24 @@
    Definitions
 -----------------------------------------------------------------------------------------*/
 
-// Entity IDs are simply unsigned integers, could use uint64_t if you had a long running app
+// Entity IDs are handles into the entity manager's slot storage. The low bits are the index of the slot holding the entity
+// and the high bits are the generation of that slot, which increases each time an entity in the slot is destroyed. So when a
+// slot is reused for a new entity, any IDs still held for the old entity no longer match and are detected as stale.
+// Other code should treat IDs as opaque values - just compare them, store them and pass them to the entity manager
 using EntityID = uint32_t;
 
-// Allow for some special IDs
+const uint32_t ENTITY_INDEX_BITS = 16;                              // Up to 65536 live entities
+const uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+
+// Split an entity ID into its slot index and generation, or build one from those parts
+inline uint32_t EntityIndex     (EntityID id)  { return id & ENTITY_INDEX_MASK;  }
+inline uint32_t EntityGeneration(EntityID id)  { return id >> ENTITY_INDEX_BITS; }
+inline EntityID MakeEntityID(uint32_t index, uint32_t generation)  { return (generation << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK); }
+
+// Allow for some special IDs. These use slot indexes that are never given to entities, so they can't collide with a real ID
 const EntityID NO_ID = 0; // Special ID to indicate a null ID (e.g. return value in the case of an error)
 const EntityID SYSTEM_ID = 1; // Special ID of the system itself, can be used as the "from" parameter of messages
-const EntityID FIRST_ENTITY_ID = 2;
+const EntityID FIRST_ENTITY_ID = 2; // Slot index of the first entity slot
 
 
 #endif //_ENTITY_TYPES_H_INCLUDED_
@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// Floating text - short messages that rise from an entity and fade, e.g. the damage a boat has taken
+//--------------------------------------------------------------------------------------
+
+#include "FloatingText.h"
+
+#include <algorithm>
+
+
+FloatingText gFloatingText;
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+FloatingText::FloatingText()
+{
+	mTexts.reserve(MAX_TEXTS);
+	Intern(""); // NO_TEXT
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// The ID of the given text, adding it to the table of texts the first time it is seen
+FloatingText::TextID FloatingText::Intern(std::string_view text)
+{
+	auto found = mTextIDs.find(text);
+	if (found != mTextIDs.end())  return found->second;
+	if (mTexts.size() == MAX_TEXTS)  return NO_TEXT;
+
+	TextID id = static_cast<TextID>(mTexts.size());
+	mTexts.emplace_back(text);
+	mTextIDs.emplace(mTexts.back(), id);
+	return id;
+}
+
+
+// Show the given text rising from an entity. Only the last few popups are looked through for one to stack on, so the cost
+// doesn't depend on how many are showing
+void FloatingText::Emit(EntityID entity, TextID text, ColourRGB colour /*= ColourRGB(0xffcc00)*/)
+{
+	static constexpr size_t STACK_SEARCH = 16;
+
+	uint8_t line = 0;
+	for (size_t i = 0; i < std::min(mNumPopups, STACK_SEARCH); ++i)
+	{
+		const Popup& previous = mPopups[(mOldest + mNumPopups - 1 - i) % MAX_POPUPS];
+		if (mTime - previous.startTime >= STACK_TIME)  break; // The rest are older still
+		if (previous.entity == entity)
+		{
+			line = static_cast<uint8_t>((previous.line + 1) % MAX_LINES);
+			break;
+		}
+	}
+
+	// A full ring replaces its oldest popup
+	if (mNumPopups == MAX_POPUPS)
+	{
+		mOldest = (mOldest + 1) % MAX_POPUPS;
+		--mNumPopups;
+	}
+	mPopups[(mOldest + mNumPopups) % MAX_POPUPS] = { entity, text, line, colour, mTime };
+	++mNumPopups;
+}
+
+
+// Move the floating text clock on by the time of a simulation step, letting go of popups that have finished
+void FloatingText::Advance(float stepTime)
+{
+	mTime += stepTime;
+	while (mNumPopups > 0 && mTime - mPopups[mOldest].startTime >= LIFETIME)
+	{
+		mOldest = (mOldest + 1) % MAX_POPUPS;
+		--mNumPopups;
+	}
+}
+
+
+// Remove all popups. Interned texts are kept
+void FloatingText::Clear()
+{
+	mOldest    = 0;
+	mNumPopups = 0;
+}
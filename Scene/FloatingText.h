@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Floating text - short messages that rise from an entity and fade, e.g. the damage a boat has taken
+//--------------------------------------------------------------------------------------
+// Entities emit a popup with the ID of an interned text, so emitting builds no strings: texts are interned once (the text
+// for a given damage, "+2 Missiles"...) and each popup is a few bytes in a fixed size ring, the oldest popup being replaced
+// when the ring is full. Any number of popups can be showing over the same entity, one emitted shortly after another starts
+// a line above it rather than covering it.
+//
+// Popups hold the time they were emitted on the floating text clock, which is moved on by each simulation step. Nothing is
+// updated as they age: the scene gives the renderer each live popup's entity position once a frame, and the vertex shader
+// works out the rise and fade from the clock (see FloatingTextRenderer.h). Popups are cosmetic, they are not saved in
+// checkpoints and are cleared whenever the boats are replaced. Only for use by the main thread
+//
+//   static const FloatingText::TextID MISSILES_TEXT = gFloatingText.Intern("+2 Missiles");
+//   gFloatingText.Emit(GetID(), MISSILES_TEXT);
+
+#ifndef _FLOATING_TEXT_H_INCLUDED_
+#define _FLOATING_TEXT_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "ColourTypes.h"
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class FloatingText
+{
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Index of an interned text
+	using TextID = uint16_t;
+
+	// The empty text, also given by Intern once the table of texts is full
+	static constexpr TextID NO_TEXT = 0;
+
+	// Most texts that can be interned, and most popups showing at once
+	static constexpr size_t MAX_TEXTS  = 1024;
+	static constexpr size_t MAX_POPUPS = 1024;
+
+	// How popups move: they start this far above their entity and rise this much further over their lifetime, in world units.
+	// Each line of a stack of popups is a line of the font higher
+	static constexpr float LIFETIME     = 3.0f;
+	static constexpr float FADE_TIME    = 0.5f; // Fading out over the end of the lifetime
+	static constexpr float START_HEIGHT = 10.0f;
+	static constexpr float RISE_HEIGHT  = 10.0f;
+
+	// A popup emitted within this time of the last one over the same entity goes on the line above it, up to MAX_LINES lines
+	static constexpr float    STACK_TIME = 0.5f;
+	static constexpr uint32_t MAX_LINES  = 4;
+
+	struct Popup
+	{
+		EntityID  entity;
+		TextID    text;
+		uint8_t   line;      // Lines up from the bottom of a stack of popups
+		ColourRGB colour;
+		float     startTime; // On the floating text clock
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	FloatingText();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The ID of the given text, adding it to the table of texts the first time it is seen. Texts are kept for the life of the app
+	TextID Intern(std::string_view text);
+
+	// Texts interned so far, with IDs from 0 to NumTexts() - 1
+	TextID             NumTexts()  { return static_cast<TextID>(mTexts.size()); }
+	const std::string& Text(TextID text)  { return mTexts[text]; }
+
+	// Show the given text rising from an entity
+	void Emit(EntityID entity, TextID text, ColourRGB colour = ColourRGB(0xffcc00));
+
+	// Move the floating text clock on by the time of a simulation step, letting go of popups that have finished
+	void Advance(float stepTime);
+
+	// Remove all popups, e.g. when the entities they belong to are replaced. Interned texts are kept
+	void Clear();
+
+	// The floating text clock
+	float Time()  { return mTime; }
+
+	// Call the given function for each popup still showing, oldest first: function(const Popup&)
+	template <typename Function>
+	void ForEachPopup(Function function)
+	{
+		for (size_t i = 0; i < mNumPopups; ++i)  function(mPopups[(mOldest + i) % MAX_POPUPS]);
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Interned texts are looked up by string_view so finding an existing text makes no string
+	struct TextHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view text) const  { return std::hash<std::string_view>()(text); }
+	};
+	std::vector<std::string> mTexts;
+	std::unordered_map<std::string, TextID, TextHash, std::equal_to<>> mTextIDs;
+
+	// Popups in the order they were emitted, which is also the order they finish as they all have the same lifetime
+	std::array<Popup, MAX_POPUPS> mPopups;
+	size_t mOldest    = 0;
+	size_t mNumPopups = 0;
+
+	float mTime = 0;
+};
+
+
+// The floating text shown by every entity
+extern FloatingText gFloatingText;
+
+
+#endif //_FLOATING_TEXT_H_INCLUDED_
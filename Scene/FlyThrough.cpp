@@ -0,0 +1,247 @@
+//--------------------------------------------------------------------------------------
+// Fly-through benchmark - a scripted camera run through a level, timing every frame
+//--------------------------------------------------------------------------------------
+
+#include "FlyThrough.h"
+#include "Camera.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// A run of the given number of seconds with the default script
+FlyThrough::FlyThrough(float seconds /*= 60.0f*/)
+	: mSeconds(seconds)
+{
+	// Two 30 second laps around the middle of the level, low over the water then high looking down, with a look through each
+	// of the first three boats' chase cameras on the way
+	mKeys = {
+		{  0, {  120,  80, -180 }, { 0, 0,    0 } },
+		{  5, { -150,  30, -220 }, { 0, 0,    0 } },
+		{ 10, { -300,  20,    0 }, { 0, 0,  100 } },
+		{ 15, { -150,  60,  250 }, { 0, 0,    0 } },
+		{ 20, {  200,  15,  250 }, { 0, 0, -100 } },
+		{ 25, {  320,  40,    0 }, { 0, 0,    0 } },
+		{ 30, {  120,  80, -180 }, { 0, 0,    0 } },
+		{ 35, {    0, 250, -300 }, { 0, 0,    0 } },
+		{ 45, { -300, 250,  300 }, { 0, 0,    0 } },
+		{ 55, {  300, 150,  100 }, { 0, 0,    0 } },
+		{ 60, {  120,  80, -180 }, { 0, 0,    0 } },
+	};
+	mSwitches = { { 8, 0 }, { 11, -1 }, { 22, 1 }, { 25, -1 }, { 40, 2 }, { 44, -1 } };
+}
+
+
+// Replace the script with one read from a file. Returns false with error set if it can't be read or makes no sense
+bool FlyThrough::ReadScript(const std::string& fileName, std::string& error)
+{
+	std::ifstream file(fileName);
+	if (!file)
+	{
+		error = "Can't open " + fileName;
+		return false;
+	}
+
+	std::vector<CameraKey>    keys;
+	std::vector<CameraSwitch> switches;
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream words(line);
+		std::string command;
+		if (!(words >> command))  continue;
+
+		bool valid = false;
+		if (command == "camera")
+		{
+			CameraKey key;
+			valid = static_cast<bool>(words >> key.time >> key.position.x >> key.position.y >> key.position.z >>
+			                          key.target.x >> key.target.y >> key.target.z);
+			if (valid)  keys.push_back(key);
+		}
+		else if (command == "chase")
+		{
+			CameraSwitch cameraSwitch;
+			valid = static_cast<bool>(words >> cameraSwitch.time >> cameraSwitch.chaseCamera) && cameraSwitch.chaseCamera >= 0;
+			if (valid)  switches.push_back(cameraSwitch);
+		}
+		else if (command == "main")
+		{
+			CameraSwitch cameraSwitch = { 0, -1 };
+			valid = static_cast<bool>(words >> cameraSwitch.time);
+			if (valid)  switches.push_back(cameraSwitch);
+		}
+		if (!valid)
+		{
+			error = fileName + " line " + std::to_string(lineNumber) + ": can't read \"" + line + "\"";
+			return false;
+		}
+	}
+	if (keys.empty())
+	{
+		error = fileName + " has no camera keys";
+		return false;
+	}
+
+	// Kept in time order so the current key and switch are found by searching
+	std::stable_sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b) { return a.time < b.time; });
+	std::stable_sort(switches.begin(), switches.end(), [](const CameraSwitch& a, const CameraSwitch& b) { return a.time < b.time; });
+	mKeys = std::move(keys);
+	mSwitches = std::move(switches);
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Place the main camera for the current time and return the chase camera to view, -1 for the main camera
+int FlyThrough::PlaceCamera(Camera& camera)
+{
+	// Catmull-Rom through the keys either side of the time, using the keys beyond them (or the same keys at the ends) to
+	// shape the curve, so the camera passes through every key without sudden turns. Held at the first and last keys
+	float time = Time();
+	size_t next = std::upper_bound(mKeys.begin(), mKeys.end(), time, [](float t, const CameraKey& key) { return t < key.time; }) - mKeys.begin();
+	size_t i1 = next > 0 ? next - 1 : 0;
+	size_t i2 = std::min(next, mKeys.size() - 1);
+	size_t i0 = i1 > 0 ? i1 - 1 : i1;
+	size_t i3 = std::min(i2 + 1, mKeys.size() - 1);
+	float span = mKeys[i2].time - mKeys[i1].time;
+	float t = span > 0 ? std::clamp((time - mKeys[i1].time) / span, 0.0f, 1.0f) : 0.0f;
+
+	auto catmullRom = [t](const Vector3& p0, const Vector3& p1, const Vector3& p2, const Vector3& p3)
+	{
+		float t2 = t * t, t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	};
+	Vector3 position = catmullRom(mKeys[i0].position, mKeys[i1].position, mKeys[i2].position, mKeys[i3].position);
+	Vector3 target   = catmullRom(mKeys[i0].target,   mKeys[i1].target,   mKeys[i2].target,   mKeys[i3].target);
+	camera.Transform().Position() = position;
+	camera.Transform().FaceTarget(target);
+
+	// The last switch at or before the time
+	int chaseCamera = -1;
+	for (const CameraSwitch& cameraSwitch : mSwitches)
+	{
+		if (cameraSwitch.time > time)  break;
+		chaseCamera = cameraSwitch.chaseCamera;
+	}
+	return chaseCamera;
+}
+
+
+// Time the frame just finished and move on to the next
+void FlyThrough::EndFrame(float cpuMilliseconds, float gpuMilliseconds, uint64_t videoMemoryBytes, const EntityManager::RenderStats& renderStats,
+                          const CpuProfiler::Frame& profile, const AllocationTracker::Frame& allocations,
+                          const RenderCounters::Frame& renderCounts)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (mFrame >= WARM_UP_FRAMES)
+	{
+		float frameMilliseconds = std::chrono::duration<float, std::milli>(now - mLastFrameEnd).count();
+		float videoMemoryMegabytes = static_cast<float>(videoMemoryBytes / (1024.0 * 1024.0));
+		mFrames.push_back({ frameMilliseconds, cpuMilliseconds, gpuMilliseconds, videoMemoryMegabytes, renderStats.rendered,
+		                    renderStats.batches, renderStats.indirectDraws, renderStats.sortedDraws, renderStats.stateChanges,
+		                    static_cast<uint32_t>(allocations.allocations), static_cast<float>(allocations.bytes / 1024.0) });
+
+		size_t frame = mFrames.size() - 1;
+		auto addValue = [frame](std::vector<float>& values, float value)
+		{
+			values.resize(frame + 1);
+			values[frame] += value;
+		};
+		auto entry = [](auto& map, std::string_view name) -> auto&
+		{
+			auto found = map.find(name);
+			if (found == map.end())  found = map.try_emplace(std::string(name)).first;
+			return found->second;
+		};
+		for (const CpuProfiler::Event& event : profile.events)
+		{
+			addValue(entry(mScopeMilliseconds, event.name), static_cast<float>(CpuProfiler::TicksToMilliseconds(event.end - event.start)));
+		}
+		auto addCounts = [&](std::string_view pass, const RenderCounters::Counts& counts)
+		{
+			auto& values = entry(mRenderCounts, pass);
+			for (int counter = 0; counter < RenderCounters::NUM_COUNTERS; ++counter)  addValue(values[counter], static_cast<float>(counts[counter]));
+		};
+		addCounts("", renderCounts.total);
+		for (const RenderCounters::Pass& pass : renderCounts.passes)  addCounts(pass.name, pass.counts);
+	}
+	mLastFrameEnd = now;
+	++mFrame;
+}
+
+
+// Write the results as CSV, a row for each measure with its average, median, 95th and 99th percentiles and maximum
+bool FlyThrough::WriteResults(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << "Measure,Average,P50,P95,P99,Max\n";
+	auto writeValues = [&](const std::string& name, std::vector<double> values)
+	{
+		if (values.empty())
+		{
+			file << name << ",0,0,0,0,0\n";
+			return;
+		}
+		std::sort(values.begin(), values.end());
+		double total = 0;
+		for (double v : values)  total += v;
+
+		// Nearest rank: the smallest value at least the given fraction of the frames are no greater than
+		auto percentile = [&](double fraction)
+		{
+			size_t rank = static_cast<size_t>(std::ceil(fraction * values.size()));
+			return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+		};
+		file << name << ',' << total / values.size() << ',' << percentile(0.50) << ',' << percentile(0.95) << ','
+		     << percentile(0.99) << ',' << values.back() << '\n';
+	};
+	auto writeMeasure = [&](const char* name, auto value)
+	{
+		std::vector<double> values;
+		for (const FrameTimes& frame : mFrames)  values.push_back(static_cast<double>(value(frame)));
+		writeValues(name, std::move(values));
+	};
+	writeMeasure("FrameMs",          [](const FrameTimes& f) { return f.frameMilliseconds; });
+	writeMeasure("CpuMs",            [](const FrameTimes& f) { return f.cpuMilliseconds; });
+	writeMeasure("GpuMs",            [](const FrameTimes& f) { return f.gpuMilliseconds; });
+	writeMeasure("VideoMemoryMB",    [](const FrameTimes& f) { return f.videoMemoryMegabytes; });
+	writeMeasure("EntitiesDrawn",    [](const FrameTimes& f) { return f.entitiesDrawn; });
+	writeMeasure("InstancedBatches", [](const FrameTimes& f) { return f.instancedBatches; });
+	writeMeasure("IndirectDraws",    [](const FrameTimes& f) { return f.indirectDraws; });
+	writeMeasure("SortedDraws",      [](const FrameTimes& f) { return f.sortedDraws; });
+	writeMeasure("StateChanges",     [](const FrameTimes& f) { return f.stateChanges; });
+	writeMeasure("Allocations",      [](const FrameTimes& f) { return f.allocations; });
+	writeMeasure("AllocatedKB",      [](const FrameTimes& f) { return f.allocatedKilobytes; });
+	for (const auto& [scope, milliseconds] : mScopeMilliseconds)
+	{
+		std::vector<double> values(milliseconds.begin(), milliseconds.end());
+		values.resize(mFrames.size());
+		writeValues("Scope " + scope, std::move(values));
+	}
+	for (const auto& [pass, counts] : mRenderCounts)
+	{
+		for (int counter = 0; counter < RenderCounters::NUM_COUNTERS; ++counter)
+		{
+			std::vector<double> values(counts[counter].begin(), counts[counter].end());
+			values.resize(mFrames.size());
+			std::string name = RenderCounters::Name(static_cast<RenderCounter>(counter));
+			writeValues(pass.empty() ? "Render " + name : "Pass " + pass + ": " + name, std::move(values));
+		}
+	}
+	file << "StartupMs," << mStartupMilliseconds << ",,,,\n";
+	file << "Frames," << mFrames.size() << ",,,,\n";
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,143 @@
+//--------------------------------------------------------------------------------------
+// Fly-through benchmark - a scripted camera run through a level, timing every frame
+//--------------------------------------------------------------------------------------
+// The script moves the main camera along a smooth path (Catmull-Rom spline) through key positions, each with a point to look
+// at, and switches to boats' chase cameras and back at set times. The scene is moved on by the same fixed time each frame
+// and the game is seeded, so every run shows the same frames whatever the machine, and the frame times of two runs (e.g.
+// before and after a renderer change, or with two driver versions) can be compared directly. See RunFlyThrough in Main.cpp:
+//
+//   Boats.exe -flythrough [level.xml] [-script path.txt] [-time seconds] [-seed number] [-out results.csv]
+//
+// A script is a text file of lines, times in seconds from the start. Lines starting with # are ignored:
+//
+//   camera 0   120 80 -180   0 0 0   # Time, camera position, point to look at
+//   camera 8   -200 40 100   0 0 0
+//   chase  12  0                     # From 12s view chase camera 0 (the first boat's)
+//   main   16                        # Back to the main camera
+//
+// Frame, CPU and GPU times are recorded for each frame after a short warm-up, along with the video memory used, the entity
+// manager's render stats, the time of each CPU profiler scope (see CpuProfiler.h), the heap allocations made (see
+// AllocationTracker.h) and the render counters in total and for each pass (see RenderCounters.h), and written as CSV with the average, median, 95th and 99th percentiles and maximum of each. The startup time of the run is written too, as a single value
+
+#ifndef _FLY_THROUGH_H_INCLUDED_
+#define _FLY_THROUGH_H_INCLUDED_
+
+#include "Vector3.h"
+#include "EntityManager.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include "RenderCounters.h"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+
+
+class Camera;
+
+class FlyThrough
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Time passed each frame, the frame rate the run is made at rather than the frame rate it runs at
+	static constexpr float FRAME_TIME = 1.0f / 60;
+
+	// A run of the given number of seconds with the default script, a few laps around the middle of the level that visit
+	// the first few boats' chase cameras
+	explicit FlyThrough(float seconds = 60.0f);
+
+	// Replace the script with one read from a file, see the top of this file. Returns false with error set if the file can't
+	// be read, has a line that doesn't make sense or has no camera keys
+	bool ReadScript(const std::string& fileName, std::string& error);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Seconds of the run so far, and whether it has reached its length
+	float Time()      { return mFrame * FRAME_TIME; }
+	bool  Finished()  { return Time() >= mSeconds; }
+
+	// Place the main camera for the current time and return the chase camera to view, -1 for the main camera
+	int PlaceCamera(Camera& camera);
+
+	// Time the frame just finished and move on to the next. Pass the CPU time spent on the frame, excluding waits for the
+	// frame rate and the swap chain, the GPU profiler's frame time, the video memory in use, the frame's render stats, the
+	// CPU profiler's last frame, whose scopes are totalled by name (nested scopes are counted in their parents' times too),
+	// the allocation tracker's last frame and the render counters' last frame
+	void EndFrame(float cpuMilliseconds, float gpuMilliseconds, uint64_t videoMemoryBytes, const EntityManager::RenderStats& renderStats,
+	              const CpuProfiler::Frame& profile, const AllocationTracker::Frame& allocations, const RenderCounters::Frame& renderCounts);
+
+	// Time from the start of the app to the first frame, written with the results
+	void SetStartupMilliseconds(float milliseconds)  { mStartupMilliseconds = milliseconds; }
+
+	// Write the results as CSV, a row for each measure. Returns false if the file can't be written
+	bool WriteResults(const std::string& fileName) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Frames not recorded at the start, while the first textures stream in and the caches fill
+	static constexpr int WARM_UP_FRAMES = 30;
+
+	struct CameraKey
+	{
+		float   time;
+		Vector3 position;
+		Vector3 target;
+	};
+
+	struct CameraSwitch
+	{
+		float time;
+		int   chaseCamera; // -1 for the main camera
+	};
+
+	// A recorded frame
+	struct FrameTimes
+	{
+		float    frameMilliseconds;
+		float    cpuMilliseconds;
+		float    gpuMilliseconds;
+		float    videoMemoryMegabytes;
+		uint32_t entitiesDrawn;
+		uint32_t instancedBatches;
+		uint32_t indirectDraws;
+		uint32_t sortedDraws;
+		uint32_t stateChanges;
+		uint32_t allocations;
+		float    allocatedKilobytes;
+	};
+
+	float mSeconds;
+	int   mFrame = 0;
+
+	std::vector<CameraKey>    mKeys;     // In time order
+	std::vector<CameraSwitch> mSwitches; // In time order
+
+	std::chrono::steady_clock::time_point mLastFrameEnd;
+	std::vector<FrameTimes>               mFrames;
+
+	// Milliseconds of each scope name in each recorded frame, shorter than mFrames for a scope not seen in the last frames,
+	// and 0 in frames it wasn't seen in. Looked up by string_view so recording a frame doesn't allocate names, which would be
+	// counted in the next frame's allocations
+	std::map<std::string, std::vector<float>, std::less<>> mScopeMilliseconds;
+
+	// Each render counter in each recorded frame in the same way, by pass name ("" for the whole frame)
+	std::map<std::string, std::array<std::vector<float>, RenderCounters::NUM_COUNTERS>, std::less<>> mRenderCounts;
+
+	float mStartupMilliseconds = 0;
+};
+
+
+#endif //_FLY_THROUGH_H_INCLUDED_
@@ -0,0 +1,182 @@
+//--------------------------------------------------------------------------------------
+// Gameplay analytics - a record of every shot, hit, pickup and boat state change, for balancing
+//--------------------------------------------------------------------------------------
+
+#include "GameAnalytics.h"
+
+#include "EntityManager.h"
+#include "Messenger.h"
+#include "Boat.h"
+
+#include <cstring>
+
+
+namespace
+{
+	const char     ANALYTICS_MAGIC[4] = { 'G', 'A', 'N', 'A' };
+	const uint32_t ANALYTICS_VERSION  = 1;
+
+	// The columns in the order they are written, see the top of GameAnalytics.h
+	struct ColumnInfo
+	{
+		const char*               name;
+		GameAnalytics::ColumnType type;
+	};
+	const ColumnInfo ANALYTICS_COLUMNS[] =
+	{
+		{ "step",    GameAnalytics::ColumnType::UInt32  },
+		{ "time",    GameAnalytics::ColumnType::Float32 },
+		{ "event",   GameAnalytics::ColumnType::UInt8   },
+		{ "subject", GameAnalytics::ColumnType::UInt32  },
+		{ "other",   GameAnalytics::ColumnType::UInt32  },
+		{ "detail",  GameAnalytics::ColumnType::UInt32  },
+		{ "x",       GameAnalytics::ColumnType::Float32 },
+		{ "y",       GameAnalytics::ColumnType::Float32 },
+		{ "z",       GameAnalytics::ColumnType::Float32 },
+	};
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Create the file and write its header. Returns false if the file can't be created
+bool GameAnalytics::Start(const std::string& fileName)
+{
+	if (!mFile.Open(fileName))  return false;
+
+	mBytesWritten = 0;
+	uint32_t numColumns = static_cast<uint32_t>(std::size(ANALYTICS_COLUMNS));
+	mFile.Write(ANALYTICS_MAGIC, sizeof(ANALYTICS_MAGIC));
+	mFile.Write(&ANALYTICS_VERSION, sizeof(ANALYTICS_VERSION));
+	mFile.Write(&numColumns, sizeof(numColumns));
+	mBytesWritten += sizeof(ANALYTICS_MAGIC) + sizeof(ANALYTICS_VERSION) + sizeof(numColumns);
+	for (const ColumnInfo& column : ANALYTICS_COLUMNS)
+	{
+		uint8_t nameLength = static_cast<uint8_t>(std::strlen(column.name));
+		mFile.Write(&column.type, sizeof(column.type));
+		mFile.Write(&nameLength, sizeof(nameLength));
+		mFile.Write(column.name, nameLength);
+		mBytesWritten += sizeof(column.type) + sizeof(nameLength) + nameLength;
+	}
+
+	for (auto* column : { &mSteps, &mSubjects, &mOthers, &mDetails })  column->reserve(BLOCK_ROWS);
+	for (auto* column : { &mTimes, &mX, &mY, &mZ })                    column->reserve(BLOCK_ROWS);
+	mEvents.reserve(BLOCK_ROWS);
+	mStep = 0;
+	mGameTime = 0;
+	mEventsRecorded = 0;
+	return true;
+}
+
+
+// Record a missile fired by the given boat from the given position, during a simulation step
+void GameAnalytics::RecordShot(EntityID boat, const Vector3& position)
+{
+	if (!IsRecording())  return;
+	Add(AnalyticsEvent::Shot, boat, NO_ID, 0, position);
+}
+
+
+// Record the hits, mine hits and crate pickups delivered in the step just simulated, and the boats' state changes, then
+// move the game time on by the step's length. Call after each simulation step
+void GameAnalytics::RecordStep(EntityManager& entities, const Messenger& messenger, float stepTime)
+{
+	if (!IsRecording())  return;
+
+	// The position of the entity an event happened to, the origin if it has already gone
+	auto positionOf = [&](EntityID id)
+	{
+		Entity* entity = entities.GetEntity(id);
+		return entity != nullptr ? entity->Transform().Position() : Vector3{ 0, 0, 0 };
+	};
+
+	messenger.ForEachObserved([&](EntityID to, const Message& message)
+	{
+		switch (message.type)
+		{
+		case MessageType::Hit:
+		{
+			const MissileHitData* hit = std::get_if<MissileHitData>(&message.data);
+			Add(AnalyticsEvent::Hit, to, hit != nullptr ? hit->launchingBoatID : message.from, 0, positionOf(to));
+			break;
+		}
+		case MessageType::MineHit:
+			Add(AnalyticsEvent::MineHit, to, message.from, 0, positionOf(to));
+			break;
+		case MessageType::CrateCollected:
+		{
+			const CratePickupData* pickup = std::get_if<CratePickupData>(&message.data);
+			uint32_t crateType = pickup != nullptr ? static_cast<uint32_t>(pickup->type) : 0;
+			Add(AnalyticsEvent::CrateCollected, to, message.from, crateType, positionOf(to));
+			break;
+		}
+		default:
+			break;
+		}
+	});
+
+	for (const Boat::StateChange& change : Boat::StateChanges())
+	{
+		uint32_t states = static_cast<uint32_t>(change.from) | static_cast<uint32_t>(change.to) << 8;
+		Add(AnalyticsEvent::StateChange, change.boat, NO_ID, states, positionOf(change.boat));
+	}
+
+	mGameTime += stepTime;
+	++mStep;
+}
+
+
+// Write the last block and finish the file. Returns false if anything failed to be written
+bool GameAnalytics::Stop()
+{
+	if (!IsRecording())  return false;
+	if (!mEvents.empty())  WriteBlock();
+	return mFile.Close();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Add a row to the columns, writing them as a block once they are full
+void GameAnalytics::Add(AnalyticsEvent event, EntityID subject, EntityID other, uint32_t detail, const Vector3& position)
+{
+	mSteps   .push_back(mStep);
+	mTimes   .push_back(mGameTime);
+	mEvents  .push_back(static_cast<uint8_t>(event));
+	mSubjects.push_back(subject);
+	mOthers  .push_back(other);
+	mDetails .push_back(detail);
+	mX.push_back(position.x);
+	mY.push_back(position.y);
+	mZ.push_back(position.z);
+	++mEventsRecorded;
+
+	if (mEvents.size() >= BLOCK_ROWS)  WriteBlock();
+}
+
+
+// Write the rows collected as a block and empty the columns. The writer copies the data so the columns can be reused at once
+void GameAnalytics::WriteBlock()
+{
+	uint32_t numRows = static_cast<uint32_t>(mEvents.size());
+	mFile.Write(&numRows, sizeof(numRows));
+	mBytesWritten += sizeof(numRows);
+
+	WriteColumn(mSteps);
+	WriteColumn(mTimes);
+	WriteColumn(mEvents);
+	WriteColumn(mSubjects);
+	WriteColumn(mOthers);
+	WriteColumn(mDetails);
+	WriteColumn(mX);
+	WriteColumn(mY);
+	WriteColumn(mZ);
+
+	for (auto* column : { &mSteps, &mSubjects, &mOthers, &mDetails })  column->clear();
+	for (auto* column : { &mTimes, &mX, &mY, &mZ })                    column->clear();
+	mEvents.clear();
+}
@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Gameplay analytics - a record of every shot, hit, pickup and boat state change, for balancing
+//--------------------------------------------------------------------------------------
+// While recording, each event of the game is added as a row of a table held in columns, one vector for each field. Shots
+// come from Scene::LaunchMissile, and after each simulation step the hits, mine hits and crate pickups are taken from the
+// messages observed that step (see Messenger::Observe), and boat state changes (including their destruction) from
+// Boat::StateChanges. Adding a row is a push onto each column, nothing is formatted or written.
+//
+// Once BLOCK_ROWS rows have been collected the columns are written one after another as a block and handed to a background
+// thread to write (see AsyncFileWriter), then emptied keeping their capacity. So a batch of headless battles recording
+// millions of events does one large sequential write every few tens of thousands of events, and a reader can load any one
+// column of a block without going through the rest, as a columnar format allows.
+//
+//   GameAnalytics analytics;
+//   analytics.Start("Analytics.bin");
+//   ... analytics.RecordShot(boatID, position); for each shot
+//   ... analytics.RecordStep(*gEntityManager, *gMessenger, stepTime); after each simulation step
+//   analytics.Stop();
+//
+// File layout, all values little-endian as written by the game:
+//   Header: "GANA", version (uint32), number of columns (uint32), then for each column its type (uint8, see ColumnType),
+//           name length (uint8) and the name's characters
+//   Block:  number of rows (uint32), then each column's values for all the rows, in the order of the header
+// Columns: step (uint32), time (float, game seconds), event (uint8, see AnalyticsEvent), subject and other (uint32 entity
+// IDs, NO_ID for none), detail (uint32, see AnalyticsEvent), x, y, z (float, position of the subject)
+
+#ifndef _GAME_ANALYTICS_H_INCLUDED_
+#define _GAME_ANALYTICS_H_INCLUDED_
+
+#include "AsyncFileWriter.h"
+#include "EntityTypes.h"
+#include "Vector3.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+class EntityManager;
+class Messenger;
+
+// What happened, the event column. The subject, other and detail columns of each:
+enum class AnalyticsEvent : uint8_t
+{
+	Shot,           // Boat that fired,                    none,                 0
+	Hit,            // Entity hit by a missile,            boat that fired it,   0
+	MineHit,        // Entity that hit a mine,             the mine,             0
+	CrateCollected, // Entity that collected the crate,    the crate,            CrateType
+	StateChange,    // Boat,                               none,                 Boat::State before | Boat::State after << 8
+};
+
+
+class GameAnalytics
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Rows collected before they are written as a block
+	static constexpr uint32_t BLOCK_ROWS = 65536;
+
+	// Types of the columns in the file header
+	enum class ColumnType : uint8_t
+	{
+		UInt8,
+		UInt32,
+		Float32,
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the file and write its header. Returns false if the file can't be created
+	bool Start(const std::string& fileName);
+
+	// Record a missile fired by the given boat from the given position, during a simulation step
+	void RecordShot(EntityID boat, const Vector3& position);
+
+	// Record the hits, mine hits and crate pickups delivered in the step just simulated, and the boats' state changes, then
+	// move the game time on by the step's length. Call after each simulation step. The messenger must be observing the
+	// message types recorded, Start doesn't change what is observed
+	void RecordStep(EntityManager& entities, const Messenger& messenger, float stepTime);
+
+	// Write the last block and finish the file. Returns false if anything failed to be written
+	bool Stop();
+
+	bool IsRecording()  { return mFile.IsOpen(); }
+
+	// Events recorded and bytes given to the writer so far
+	uint64_t EventsRecorded()  { return mEventsRecorded; }
+	uint64_t BytesWritten()    { return mBytesWritten; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Add a row to the columns, writing them as a block once they are full
+	void Add(AnalyticsEvent event, EntityID subject, EntityID other, uint32_t detail, const Vector3& position);
+
+	// Write the rows collected as a block and empty the columns
+	void WriteBlock();
+
+	// Write one column's values for the block
+	template <typename T>
+	void WriteColumn(const std::vector<T>& column)
+	{
+		mFile.Write(column.data(), column.size() * sizeof(T));
+		mBytesWritten += column.size() * sizeof(T);
+	}
+
+	AsyncFileWriter mFile;
+
+	// The rows collected for the next block, one vector for each column
+	std::vector<uint32_t> mSteps;
+	std::vector<float>    mTimes;
+	std::vector<uint8_t>  mEvents;
+	std::vector<uint32_t> mSubjects;
+	std::vector<uint32_t> mOthers;
+	std::vector<uint32_t> mDetails;
+	std::vector<float>    mX, mY, mZ;
+
+	uint32_t mStep     = 0;
+	float    mGameTime = 0;
+	uint64_t mEventsRecorded = 0;
+	uint64_t mBytesWritten   = 0;
+};
+
+
+#endif //_GAME_ANALYTICS_H_INCLUDED_
@@ -0,0 +1,265 @@
+//--------------------------------------------------------------------------------------
+// GPU template costs - GPU time of drawing each entity template, sampled over many frames
+//--------------------------------------------------------------------------------------
+
+#include "GpuTemplateCosts.h"
+#include "Entity.h"
+#include "Mesh.h"
+#include "DXDevice.h"
+#include "RenderGlobals.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Whether the current frame measures the given template, or the static batches if it is nullptr
+bool GpuTemplateCosts::IsMeasured(EntityTemplate* entityTemplate)
+{
+	if (!mEnabled || !mFrameActive)  return false;
+	return IsMeasuredIn(mFrames[mNextFrame], TemplateEntry(entityTemplate));
+}
+
+
+// Start timing the draws of a measured template, or of the static batches if it is nullptr
+void GpuTemplateCosts::BeginTemplate(EntityTemplate* entityTemplate)
+{
+	if (!mFrameActive || mSpanOpen)  return;
+
+	// Reuse the frame's queries, creating more the first time a frame has this many spans
+	Frame& frame = mFrames[mNextFrame];
+	if (frame.numSpans == MAX_SPANS)  return;
+	if (frame.numSpans == frame.spans.size())
+	{
+		Span span;
+		D3D11_QUERY_DESC timestampDesc = { D3D11_QUERY_TIMESTAMP, 0 };
+		if (FAILED(DX->Device()->CreateQuery(&timestampDesc, &span.start)) ||
+		    FAILED(DX->Device()->CreateQuery(&timestampDesc, &span.end)))  return; // Just not timed
+		frame.spans.push_back(std::move(span));
+	}
+
+	Span& span = frame.spans[frame.numSpans];
+	span.entry = TemplateEntry(entityTemplate);
+	DX->Context()->End(span.start); // Timestamps only have an End
+	++frame.numSpans;
+	mSpanOpen = true;
+}
+
+
+// Finish timing the draws of the template started by BeginTemplate
+void GpuTemplateCosts::EndTemplate()
+{
+	if (!mSpanOpen)  return;
+	mSpanOpen = false;
+
+	Frame& frame = mFrames[mNextFrame];
+	DX->Context()->End(frame.spans[frame.numSpans - 1].end);
+}
+
+
+// Finish the current frame's measurements and start the next frame's with the next few templates in turn
+void GpuTemplateCosts::NextFrame()
+{
+	if (DX == nullptr)  return;
+	auto context = DX->Context();
+
+	if (mFrameActive)
+	{
+		EndTemplate();
+		context->End(mFrames[mNextFrame].disjoint);
+		mNextFrame = (mNextFrame + 1) % RING_SIZE;
+		++mFramesInFlight;
+		mFrameActive = false;
+	}
+	CollectResults();
+
+	// Skip this frame if measuring is off or every frame in the ring is still waiting for the GPU
+	if (!mEnabled || mFramesInFlight == RING_SIZE)  return;
+	Frame& frame = mFrames[mNextFrame];
+	if (frame.disjoint == nullptr)
+	{
+		D3D11_QUERY_DESC disjointDesc = { D3D11_QUERY_TIMESTAMP_DISJOINT, 0 };
+		if (FAILED(DX->Device()->CreateQuery(&disjointDesc, &frame.disjoint)))  return;
+	}
+
+	// Templates first seen during the frame join the rotation from the next one
+	frame.numSpans   = 0;
+	frame.numEntries = static_cast<unsigned int>(mTemplates.size());
+	frame.firstEntry = frame.numEntries > 0 ? mNextRotation % frame.numEntries : 0;
+	mNextRotation = frame.firstEntry + TEMPLATES_PER_FRAME;
+	context->Begin(frame.disjoint);
+	mFrameActive = true;
+}
+
+
+// Forget the times measured so far, keeping the templates
+void GpuTemplateCosts::Reset()
+{
+	for (auto& cost : mTemplates)
+	{
+		cost.totalMilliseconds = 0;
+		cost.framesMeasured    = 0;
+		cost.lastMilliseconds  = 0;
+	}
+}
+
+
+// Draw the costs in the current ImGui window: the templates, then the surface render methods, most expensive first
+void GpuTemplateCosts::Draw()
+{
+	bool enabled = IsEnabled();
+	if (ImGui::Checkbox("Measure Templates", &enabled))  SetEnabled(enabled);
+	ImGui::SameLine();
+	if (ImGui::Button("Reset##GpuTemplateCosts"))  Reset();
+	if (!enabled)  return;
+
+	unsigned int numTemplates = static_cast<unsigned int>(mTemplates.size());
+	ImGui::Text("%u templates, %u measured a frame, each every %u frames", numTemplates, TEMPLATES_PER_FRAME,
+	            std::max((numTemplates + TEMPLATES_PER_FRAME - 1) / TEMPLATES_PER_FRAME, 1u));
+
+	// Average GPU milliseconds a frame of each template, most expensive first
+	std::vector<unsigned int> order(numTemplates);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+	{
+		return mTemplates[a].AverageMilliseconds() > mTemplates[b].AverageMilliseconds();
+	});
+	double total = 0;
+	for (auto& cost : mTemplates)  total += cost.AverageMilliseconds();
+
+	if (ImGui::BeginTable("GPU Template Costs", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		for (const char* heading : { "Template", "Avg ms", "Last ms", "Frames", "Share" })  ImGui::TableSetupColumn(heading);
+		ImGui::TableHeadersRow();
+		for (unsigned int entry : order)
+		{
+			const TemplateCost& cost = mTemplates[entry];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();  ImGui::TextUnformatted(cost.name.c_str());
+			ImGui::TableNextColumn();  ImGui::Text("%.3f", cost.AverageMilliseconds());
+			ImGui::TableNextColumn();  ImGui::Text("%.3f", cost.lastMilliseconds);
+			ImGui::TableNextColumn();  ImGui::Text("%u", cost.framesMeasured);
+			ImGui::TableNextColumn();  ImGui::Text("%.1f%%", total > 0 ? cost.AverageMilliseconds() * 100 / total : 0.0);
+		}
+		ImGui::EndTable();
+	}
+	ImGui::Text("Total: %.3fms", total);
+
+	// The templates' times split between their surface render methods by triangles, see top of GpuTemplateCosts.h
+	std::array<double, NUM_SURFACE_RENDER_METHODS> methodTimes = {};
+	for (auto& cost : mTemplates)
+	{
+		for (int method = 0; method < NUM_SURFACE_RENDER_METHODS; ++method)
+			methodTimes[method] += cost.AverageMilliseconds() * cost.methodShares[method];
+	}
+	std::array<int, NUM_SURFACE_RENDER_METHODS> methodOrder;
+	std::iota(methodOrder.begin(), methodOrder.end(), 0);
+	std::sort(methodOrder.begin(), methodOrder.end(), [&](int a, int b) { return methodTimes[a] > methodTimes[b]; });
+
+	if (ImGui::BeginTable("GPU Method Costs", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		for (const char* heading : { "Surface Method", "Avg ms", "Share" })  ImGui::TableSetupColumn(heading);
+		ImGui::TableHeadersRow();
+		for (int method : methodOrder)
+		{
+			if (methodTimes[method] <= 0)  continue;
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();  ImGui::TextUnformatted(SurfaceRenderMethodName(static_cast<SurfaceRenderMethod>(method)));
+			ImGui::TableNextColumn();  ImGui::Text("%.3f", methodTimes[method]);
+			ImGui::TableNextColumn();  ImGui::Text("%.1f%%", total > 0 ? methodTimes[method] * 100 / total : 0.0);
+		}
+		ImGui::EndTable();
+	}
+	ImGui::TextUnformatted("Static batches aren't split by method");
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// The entry of a template in mTemplates, adding it if it is new and finding its method shares if the template has changed
+unsigned int GpuTemplateCosts::TemplateEntry(EntityTemplate* entityTemplate)
+{
+	static const Atom staticBatchesName("(Static batches)");
+	Atom name = entityTemplate != nullptr ? entityTemplate->GetType() : staticBatchesName;
+	auto [it, added] = mTemplateEntries.try_emplace(name, static_cast<unsigned int>(mTemplates.size()));
+	if (added)  mTemplates.push_back({ name });
+
+	// A template reloaded under the same name keeps its times, but its materials may have changed
+	TemplateCost& cost = mTemplates[it->second];
+	if (entityTemplate != nullptr && cost.entityTemplate != entityTemplate)
+	{
+		cost.entityTemplate = entityTemplate;
+		cost.methodShares = {};
+		Mesh& mesh = entityTemplate->GetMesh();
+		float triangles = 0;
+		for (unsigned int subMesh = 0; subMesh < mesh.SubMeshCount(); ++subMesh)
+		{
+			auto geometry = mesh.GetSubMeshGeometry(subMesh);
+			int method = static_cast<int>(geometry.renderState->GetSurfaceRenderMethod());
+			cost.methodShares[method] += static_cast<float>(geometry.numIndices);
+			triangles += static_cast<float>(geometry.numIndices);
+		}
+		if (triangles > 0)
+		{
+			for (float& share : cost.methodShares)  share /= triangles;
+		}
+	}
+	return it->second;
+}
+
+
+// Whether the given entry is measured in the given frame
+bool GpuTemplateCosts::IsMeasuredIn(const Frame& frame, unsigned int entry)
+{
+	if (entry >= frame.numEntries)  return false;
+	unsigned int offset = (entry + frame.numEntries - frame.firstEntry) % frame.numEntries;
+	return offset < TEMPLATES_PER_FRAME;
+}
+
+
+// Read each finished frame in the ring, oldest first, stopping at the first that the GPU hasn't finished
+void GpuTemplateCosts::CollectResults()
+{
+	auto context = DX->Context();
+	while (mFramesInFlight > 0)
+	{
+		// The disjoint query ends after every timestamp in the frame, so once it is ready they all are
+		Frame& frame = mFrames[mOldestFrame];
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		if (context->GetData(frame.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  return; // Still in use by the GPU
+		mOldestFrame = (mOldestFrame + 1) % RING_SIZE;
+		--mFramesInFlight;
+
+		// The timestamps are meaningless if the GPU clock changed during the frame, the templates are measured again next time round
+		if (disjoint.Disjoint || disjoint.Frequency == 0)  continue;
+		double toMilliseconds = 1000.0 / static_cast<double>(disjoint.Frequency);
+
+		mFrameTotals.assign(mTemplates.size(), 0.0);
+		for (unsigned int i = 0; i < frame.numSpans; ++i)
+		{
+			UINT64 start, end;
+			Span& span = frame.spans[i];
+			if (context->GetData(span.start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			    context->GetData(span.end,   &end,   sizeof(end),   D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)  continue;
+			mFrameTotals[span.entry] += (end - start) * toMilliseconds;
+		}
+
+		// Every template measured in the frame counts it, those not drawn in it cost nothing that frame
+		for (unsigned int entry = 0; entry < frame.numEntries; ++entry)
+		{
+			if (!IsMeasuredIn(frame, entry))  continue;
+			TemplateCost& cost = mTemplates[entry];
+			cost.totalMilliseconds += mFrameTotals[entry];
+			cost.lastMilliseconds   = static_cast<float>(mFrameTotals[entry]);
+			++cost.framesMeasured;
+		}
+	}
+}
@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// GPU template costs - GPU time of drawing each entity template, sampled over many frames
+//--------------------------------------------------------------------------------------
+// The GPU profiler's scopes show which pass is slow, not which assets make it slow. While enabled, the EntityManager holds the
+// entities of a few templates back from each list it renders (see RenderGroup and RenderView) and draws them after the rest of
+// the list, one template at a time between a pair of timestamp queries, along with their instanced, sorted and impostor draws.
+// The static batches merge many templates, so each list's batches are timed as a whole, as if they were one more template.
+//
+// To bound the number of queries only TEMPLATES_PER_FRAME templates are measured each frame, the next few in turn each frame,
+// so every template is measured once every few frames. A template's cost is the average over the frames it was measured of
+// its total time in that frame, over every group and view it was drawn in (zero in frames it wasn't drawn). Its time is also
+// split between the surface render methods of its main mesh in proportion to their triangles, giving the GPU time of each
+// method. The split is an estimate, it doesn't know the pixel cost of each material or which levels of detail were drawn.
+//
+// The timestamps are read back a few frames later from a ring, without waiting for the GPU, as in the GPU profiler. Drawing a
+// template on its own after its list costs a little state setting, and sorted draws are no longer sorted with the others, so
+// the frame is a little slower while measuring. Needs the D3D device, with no device (headless) nothing is measured
+//
+//   gEntityManager->GpuCosts().SetEnabled(true);
+//   ... gEntityManager->GpuCosts().NextFrame();  // Once a frame, outside rendering
+//   gEntityManager->GpuCosts().Draw();           // Tables of the templates and surface render methods by GPU time
+
+#ifndef _GPU_TEMPLATE_COSTS_H_INCLUDED_
+#define _GPU_TEMPLATE_COSTS_H_INCLUDED_
+
+#include "Atom.h"
+#include "RenderMethod.h" // For SurfaceRenderMethod
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <d3d11.h>
+#include <atlbase.h> // For CComPtr (see member variables)
+
+#include <array>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class EntityTemplate;
+
+class GpuTemplateCosts
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Templates measured in each frame, counting the static batches as one
+	static constexpr unsigned int TEMPLATES_PER_FRAME = 8;
+
+	// Most timestamp pairs in one frame, a template is timed once for each list it is drawn in. Beyond this the held back
+	// entities are still drawn, just not timed
+	static constexpr unsigned int MAX_SPANS = 128;
+
+	// Number of frames that can be waiting for the GPU
+	static constexpr int RING_SIZE = 5;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The measured cost of one template, or of the static batches
+	struct TemplateCost
+	{
+		Atom     name;
+		double   totalMilliseconds = 0; // Over the frames it was measured
+		uint32_t framesMeasured    = 0;
+		float    lastMilliseconds  = 0; // In the most recent frame it was measured
+
+		// Fraction of the main mesh's triangles drawn with each surface render method, all zero for the static batches
+		std::array<float, NUM_SURFACE_RENDER_METHODS> methodShares = {};
+		const EntityTemplate* entityTemplate = nullptr; // The template the shares were found from, to notice a reloaded template
+
+		double AverageMilliseconds() const  { return framesMeasured > 0 ? totalMilliseconds / framesMeasured : 0.0; }
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether templates are measured. Off by default. Change outside rendering
+	void SetEnabled(bool enabled)  { mEnabled = enabled; }
+	bool IsEnabled() const         { return mEnabled; }
+
+	// Whether the current frame measures the given template, or the static batches if it is nullptr. The EntityManager then
+	// draws its entities between BeginTemplate and EndTemplate. A template seen for the first time joins the rotation
+	bool IsMeasured(EntityTemplate* entityTemplate);
+
+	// Start and finish timing the draws of a measured template, or of the static batches if it is nullptr, on the immediate
+	// context. Pairs may not be nested
+	void BeginTemplate(EntityTemplate* entityTemplate);
+	void EndTemplate();
+
+	// Finish the current frame's measurements and start the next frame's with the next few templates in turn, collecting the
+	// results of earlier frames that are ready. Call once a frame on the main thread outside rendering
+	void NextFrame();
+
+	// Forget the times measured so far, keeping the templates
+	void Reset();
+
+	// The templates seen so far with their costs, in the order they were first seen. The static batches are the entry named
+	// "(Static batches)", with no method shares
+	const std::vector<TemplateCost>& Templates()  { return mTemplates; }
+
+	// Draw the costs in the current ImGui window: an enable checkbox, then tables of the templates and of the surface render
+	// methods, most expensive first
+	void Draw();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The entry of a template in mTemplates, adding it if it is new and finding its method shares if the template has changed
+	unsigned int TemplateEntry(EntityTemplate* entityTemplate);
+
+	// Read each finished frame in the ring, oldest first, stopping at the first that the GPU hasn't finished
+	void CollectResults();
+
+	bool mEnabled = false;
+
+	std::vector<TemplateCost>              mTemplates;
+	std::unordered_map<Atom, unsigned int> mTemplateEntries; // Index in mTemplates of each template name
+	unsigned int                           mNextRotation = 0; // First entry measured in the next frame
+
+	// A timed template in a frame, the queries are reused each time the frame's place in the ring comes round
+	struct Span
+	{
+		unsigned int entry = 0;
+		CComPtr<ID3D11Query> start;
+		CComPtr<ID3D11Query> end;
+	};
+
+	// The queries of one frame and the entries it measures, TEMPLATES_PER_FRAME of them from firstEntry, wrapping round the
+	// numEntries there were when it started
+	struct Frame
+	{
+		CComPtr<ID3D11Query> disjoint;
+		std::vector<Span>    spans;
+		unsigned int         numSpans   = 0;
+		unsigned int         firstEntry = 0;
+		unsigned int         numEntries = 0;
+	};
+
+	// Whether the given entry is measured in the given frame
+	static bool IsMeasuredIn(const Frame& frame, unsigned int entry);
+
+	// Frames are started at mNextFrame and collected from mOldestFrame, the number waiting is mFramesInFlight
+	Frame mFrames[RING_SIZE];
+	int   mNextFrame      = 0;
+	int   mOldestFrame    = 0;
+	int   mFramesInFlight = 0;
+	bool  mFrameActive    = false; // Between a NextFrame that started a frame and the next NextFrame
+	bool  mSpanOpen       = false; // Between a BeginTemplate that started a span and its EndTemplate
+
+	std::vector<double> mFrameTotals; // Working space for CollectResults, the time of each entry in a frame
+};
+
+
+#endif //_GPU_TEMPLATE_COSTS_H_INCLUDED_
@@ -0,0 +1,268 @@
+//--------------------------------------------------------------------------------------
+// Recording of the messages delivered each frame, and replay of a recording
+//--------------------------------------------------------------------------------------
+
+#include "MessageJournal.h"
+
+#include "Timer.h"
+
+#include <memory>
+#include <algorithm>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+
+
+// Start of every journal file, followed by the version. Change the version if the layout changes
+static const char     JOURNAL_MAGIC[4] = { 'M', 'S', 'G', 'J' };
+static const uint32_t JOURNAL_VERSION  = 1;
+
+static constexpr uint32_t NUM_PAYLOAD_TYPES = static_cast<uint32_t>(std::variant_size_v<MessageData>);
+
+// Payloads are written as their bytes, so must have no pointers or other state that is only valid in one run
+template <typename Variant>
+struct AllTriviallyCopyable;
+
+template <typename... Payloads>
+struct AllTriviallyCopyable<std::variant<Payloads...>>
+{
+	static constexpr bool value = (std::is_trivially_copyable_v<Payloads> && ...);
+};
+static_assert(AllTriviallyCopyable<MessageData>::value, "Message payloads are written to the journal as bytes");
+
+
+// Fixed part of each message in the file, see the layout in the header file
+#pragma pack(push, 1)
+struct JournalMessageHeader
+{
+	uint32_t from;
+	uint32_t to;
+	uint32_t sentFrame;
+	uint16_t type;
+	uint8_t  payloadType;
+	uint8_t  padding;
+	uint32_t payloadSize;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(JournalMessageHeader) == 20);
+
+// Largest payload accepted when reading, so a damaged size can't cause a huge allocation
+static constexpr uint32_t MAX_PAYLOAD_SIZE = 1024 * 1024;
+
+
+/*-----------------------------------------------------------------------------------------
+	Writing
+-----------------------------------------------------------------------------------------*/
+
+// Create the file and write its header. Returns false if the file can't be created
+bool MessageJournalWriter::Open(const std::string& fileName)
+{
+	if (!mFile.Open(fileName))  return false;
+
+	uint32_t numMessageTypes = NUM_MESSAGE_TYPES;
+	mFile.Write(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+	mFile.Write(&JOURNAL_VERSION, sizeof(JOURNAL_VERSION));
+	mFile.Write(&numMessageTypes, sizeof(numMessageTypes));
+	mFile.Write(&NUM_PAYLOAD_TYPES, sizeof(NUM_PAYLOAD_TYPES));
+	return true;
+}
+
+
+// Write the messages placed in a frame's inbox, in the order they were sent. A message sent to several recipients is written
+// once for each, so a frame can be read back without knowing how the messages were sent
+void MessageJournalWriter::WriteFrame(uint32_t frame, float frameTime, const std::vector<ReceivedMessages::Address>& addresses,
+                                      const std::vector<Message>& messages, const std::vector<uint32_t>& sentFrames,
+                                      const std::vector<std::byte>& arena)
+{
+	uint32_t numMessages = static_cast<uint32_t>(addresses.size());
+	mFile.Write(&frame, sizeof(frame));
+	mFile.Write(&frameTime, sizeof(frameTime));
+	mFile.Write(&numMessages, sizeof(numMessages));
+
+	for (const auto& address : addresses)
+	{
+		const Message& message = messages[address.message];
+		JournalMessageHeader header = {};
+		header.from        = message.from;
+		header.to          = address.to;
+		header.sentFrame   = sentFrames[address.message];
+		header.type        = static_cast<uint16_t>(message.type);
+		header.payloadType = static_cast<uint8_t>(message.data.index());
+
+		std::visit([&](const auto& payload)
+		{
+			using Payload = std::decay_t<decltype(payload)>;
+			if constexpr (std::is_same_v<Payload, LargePayloadRef>)
+			{
+				header.payloadSize = payload.size;
+				mFile.Write(&header, sizeof(header));
+				mFile.Write(arena.data() + payload.offset, payload.size);
+			}
+			else if constexpr (std::is_empty_v<Payload>)
+			{
+				mFile.Write(&header, sizeof(header));
+			}
+			else
+			{
+				header.payloadSize = sizeof(Payload);
+				mFile.Write(&header, sizeof(header));
+				mFile.Write(&payload, sizeof(Payload));
+			}
+		}, message.data);
+	}
+}
+
+
+// Finish writing the file. Returns false if anything failed to be written
+bool MessageJournalWriter::Close()
+{
+	return mFile.Close();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Reading
+-----------------------------------------------------------------------------------------*/
+
+// Set the payload to alternative Index of MessageData, copied from the given bytes. A large payload's bytes are added to the
+// arena instead. Returns false if the size is wrong for the type
+template <size_t Index>
+static bool LoadPayload(const std::vector<std::byte>& bytes, MessageData& data, std::vector<std::byte>& arena)
+{
+	using Payload = std::variant_alternative_t<Index, MessageData>;
+	if constexpr (std::is_same_v<Payload, LargePayloadRef>)
+	{
+		data = LargePayloadRef{ static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(bytes.size()) };
+		arena.insert(arena.end(), bytes.begin(), bytes.end());
+	}
+	else if constexpr (std::is_empty_v<Payload>)
+	{
+		if (!bytes.empty())  return false;
+		data.emplace<Index>();
+	}
+	else
+	{
+		if (bytes.size() != sizeof(Payload))  return false;
+		Payload payload;
+		std::memcpy(&payload, bytes.data(), sizeof(Payload));
+		data.emplace<Index>(payload);
+	}
+	return true;
+}
+
+// Choose the LoadPayload for the payload type read from the file
+template <size_t... Indices>
+static bool LoadPayload(size_t index, const std::vector<std::byte>& bytes, MessageData& data, std::vector<std::byte>& arena,
+                        std::index_sequence<Indices...>)
+{
+	bool loaded = false;
+	((index == Indices && (loaded = LoadPayload<Indices>(bytes, data, arena), true)) || ...);
+	return loaded;
+}
+
+
+MessageJournalReader::~MessageJournalReader()
+{
+	if (mFile != nullptr)  std::fclose(mFile);
+}
+
+
+// Open a journal and check its header matches the message types of this build
+bool MessageJournalReader::Open(const std::string& fileName)
+{
+	if (mFile != nullptr)  std::fclose(mFile);
+	mFile = std::fopen(fileName.c_str(), "rb");
+	if (mFile == nullptr)  return false;
+
+	char magic[4];
+	uint32_t version, numMessageTypes, numPayloadTypes;
+	return Read(magic, sizeof(magic)) && std::memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) == 0 &&
+	       Read(&version, sizeof(version)) && version == JOURNAL_VERSION &&
+	       Read(&numMessageTypes, sizeof(numMessageTypes)) && numMessageTypes == NUM_MESSAGE_TYPES &&
+	       Read(&numPayloadTypes, sizeof(numPayloadTypes)) && numPayloadTypes == NUM_PAYLOAD_TYPES;
+}
+
+
+// Read the next frame into the given frame, reusing its vectors. Returns false at the end of the file or if it is damaged
+bool MessageJournalReader::ReadFrame(Frame& frame)
+{
+	if (mFile == nullptr)  return false;
+
+	uint32_t numMessages;
+	if (!Read(&frame.frame, sizeof(frame.frame)) || !Read(&frame.frameTime, sizeof(frame.frameTime)) ||
+	    !Read(&numMessages, sizeof(numMessages)))  return false;
+
+	frame.messages.resize(numMessages);
+	frame.arena.clear();
+	std::vector<std::byte> bytes;
+	for (auto& message : frame.messages)
+	{
+		JournalMessageHeader header;
+		if (!Read(&header, sizeof(header)) || header.type >= NUM_MESSAGE_TYPES || header.payloadType >= NUM_PAYLOAD_TYPES ||
+		    header.payloadSize > MAX_PAYLOAD_SIZE)  return false;
+
+		bytes.resize(header.payloadSize);
+		if (!Read(bytes.data(), bytes.size()))  return false;
+		if (!LoadPayload(header.payloadType, bytes, message.msg.data, frame.arena, std::make_index_sequence<NUM_PAYLOAD_TYPES>()))  return false;
+
+		message.to        = header.to;
+		message.msg.from  = header.from;
+		message.msg.type  = static_cast<MessageType>(header.type);
+		message.sentFrame = header.sentFrame;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Replay
+-----------------------------------------------------------------------------------------*/
+
+// Feed the messages in a journal through a Messenger of its own, frame by frame
+MessageReplayResults ReplayMessageJournal(const std::string& fileName)
+{
+	MessageReplayResults results;
+	MessageJournalReader reader;
+	if (!reader.Open(fileName))  return results;
+	results.loaded = true;
+
+	// Messengers are large (the lock-free queue), so not on the stack
+	auto messenger = std::make_unique<Messenger>();
+	messenger->CheckRecipients() = false;
+
+	MessageJournalReader::Frame frame;
+	std::vector<EntityID> recipients;
+	Timer timer;
+	while (reader.ReadFrame(frame))
+	{
+		// Each recipient reads its messages once, as an entity's update would. Found before timing
+		recipients.clear();
+		for (const auto& message : frame.messages)  recipients.push_back(message.to);
+		std::sort(recipients.begin(), recipients.end());
+		recipients.erase(std::unique(recipients.begin(), recipients.end()), recipients.end());
+
+		timer.Reset();
+		for (auto& message : frame.messages)
+		{
+			MessageData data = message.msg.data;
+			if (auto ref = std::get_if<LargePayloadRef>(&data))  data = messenger->StorePayloadBytes(frame.arena.data() + ref->offset, ref->size);
+			messenger->DeliverMessage(message.msg.from, message.to, message.msg.type, std::move(data));
+		}
+		messenger->BeginFrame(frame.frameTime);
+
+		for (EntityID to : recipients)  results.messagesRead += messenger->ReceiveAll(to).size();
+		float frameMs = timer.GetTime() * 1000.0f;
+
+		++results.frames;
+		results.messages += frame.messages.size();
+		results.totalMs  += frameMs;
+		if (frameMs > results.worstFrameMs)
+		{
+			results.worstFrameMs       = frameMs;
+			results.worstFrame         = frame.frame;
+			results.worstFrameMessages = static_cast<uint32_t>(frame.messages.size());
+		}
+	}
+	return results;
+}
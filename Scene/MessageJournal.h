@@ -0,0 +1,123 @@
+//--------------------------------------------------------------------------------------
+// Recording of the messages delivered each frame, and replay of a recording
+//--------------------------------------------------------------------------------------
+// While journalling is on (see Messenger::StartJournal) every message placed in a frame's inbox is written to a binary file:
+// the frame, who it is from and to, its type and its payload. A recording of the messages that led up to a stutter can then
+// be fed back into a Messenger of its own with ReplayMessageJournal, reproducing the same inboxes frame by frame without any
+// of the world that sent them, so the cost of delivering and reading them can be timed and profiled on its own.
+//
+//   gMessenger->StartJournal("Messages.journal");
+//   ...
+//   gMessenger->StopJournal();
+//   auto results = ReplayMessageJournal("Messages.journal");
+//
+// File layout, all values little-endian as written by the game:
+//   Header:  "MSGJ", version (uint32), number of message types (uint32), number of payload types (uint32)
+//   Frame:   frame number (uint32), frame time (float), number of messages (uint32), then each message:
+//   Message: from (uint32), to (uint32), sent frame (uint32), type (uint16), payload type (uint8), padding (uint8),
+//            payload size (uint32), then the payload bytes. A LargePayloadRef payload is written as the bytes it refers to
+
+#ifndef _MESSAGE_JOURNAL_H_INCLUDED_
+#define _MESSAGE_JOURNAL_H_INCLUDED_
+
+#include "Messenger.h"
+#include "AsyncFileWriter.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+
+/*-----------------------------------------------------------------------------------------
+	Writing
+-----------------------------------------------------------------------------------------*/
+
+// Writes frames of messages to a journal file on a background thread, see AsyncFileWriter. Used by the Messenger
+class MessageJournalWriter
+{
+public:
+	// Create the file and write its header. Returns false if the file can't be created
+	bool Open(const std::string& fileName);
+
+	// Write the messages placed in a frame's inbox, in the order they were sent. The addresses refer to the given messages,
+	// sent frames and large payload arena, as in the Messenger's outbox
+	void WriteFrame(uint32_t frame, float frameTime, const std::vector<ReceivedMessages::Address>& addresses,
+	                const std::vector<Message>& messages, const std::vector<uint32_t>& sentFrames, const std::vector<std::byte>& arena);
+
+	// Finish writing the file. Returns false if anything failed to be written
+	bool Close();
+
+private:
+	AsyncFileWriter mFile;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Reading
+-----------------------------------------------------------------------------------------*/
+
+// Reads a journal file one frame at a time
+class MessageJournalReader
+{
+public:
+	struct JournalMessage
+	{
+		EntityID to;
+		Message  msg;     // A large payload's offset is into the frame's arena
+		uint32_t sentFrame;
+	};
+
+	struct Frame
+	{
+		uint32_t frame     = 0;
+		float    frameTime = 0;
+		std::vector<JournalMessage> messages;
+		std::vector<std::byte>      arena;
+	};
+
+	MessageJournalReader() = default;
+	~MessageJournalReader();
+
+	// Prevent copying - the reader owns its file
+	MessageJournalReader(const MessageJournalReader&) = delete;
+	MessageJournalReader& operator=(const MessageJournalReader&) = delete;
+
+	// Open a journal and check its header matches the message types of this build. Returns false if the file can't be read or
+	// was recorded with different message types
+	bool Open(const std::string& fileName);
+
+	// Read the next frame into the given frame, reusing its vectors. Returns false at the end of the file or if it is damaged
+	bool ReadFrame(Frame& frame);
+
+private:
+	bool Read(void* data, size_t size)  { return std::fread(data, 1, size, mFile) == size; }
+
+	std::FILE* mFile = nullptr;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Replay
+-----------------------------------------------------------------------------------------*/
+
+struct MessageReplayResults
+{
+	bool     loaded             = false; // False if the journal couldn't be opened
+	uint32_t frames             = 0;
+	uint64_t messages           = 0;
+	uint64_t messagesRead       = 0;     // Messages received by their recipients, the same as messages unless the journal is damaged
+	float    totalMs            = 0;     // Time to deliver and read all the messages
+	float    worstFrameMs       = 0;     // Slowest frame, with its frame number from the recording and its number of messages
+	uint32_t worstFrame         = 0;
+	uint32_t worstFrameMessages = 0;
+};
+
+// Feed the messages in a journal through a Messenger of its own, frame by frame: each frame's messages are sent, the frame is
+// begun with the recorded frame time and every recipient reads its messages, as the entities would. No entities exist during
+// the replay, so the Messenger's recipient checks are turned off. Timing covers only the messaging, not reading the file
+MessageReplayResults ReplayMessageJournal(const std::string& fileName);
+
+
+#endif //_MESSAGE_JOURNAL_H_INCLUDED_
@@ -5,6 +5,51 @@
 
 #include "Messenger.h"
 
+#include "SceneGlobals.h" // For gEntityManager, used to find the recipients of broadcasts
+#include "MessageJournal.h"
+#include "CpuProfiler.h"
+#include "AllocationTracker.h"
+#include "EventTrace.h"
+
+#include <algorithm>
+#include <iterator>
+#include <fstream>
+#include <bit>
+#include <cmath>
+
+
+// Index of the chunk buffer that messages sent from the current thread go into during the parallel phase
+static thread_local size_t tParallelChunk = 0;
+
+
+// Name of a message type for display, e.g. "Hit"
+const char* MessageTypeName(MessageType type)
+{
+	static const char* const names[] =
+	{
+		"Pause", "Unpause", "TargetEntity", "TargetPoint", "TargetNone", "Die", "Start", "Stop", "Hit", "Evade", "Help",
+		"Reload", "MineHit", "CrateCollected", "ShieldDestroyed", "AimComplete", "EvadeComplete", "ReloadTurn"
+	};
+	static_assert(std::size(names) == NUM_MESSAGE_TYPES, "Add a name for each message type");
+
+	int index = static_cast<int>(type);
+	return (index >= 0 && index < NUM_MESSAGE_TYPES) ? names[index] : "Unknown";
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Defined here, where MessageJournalWriter is a complete type
+Messenger::Messenger() = default;
+
+// Finishes writing the journal if one is being recorded
+Messenger::~Messenger()
+{
+	StopJournal();
+}
+
 
 /*-----------------------------------------------------------------------------------------
 	Message sending/receiving
@@ -15,37 +60,506 @@
 //
 // Each message type has an expected data payload (see the enum in Messenger.h). The final parameter must use the appropriate
 // message data type. Don't pass the final parameter (let it use the default) for messages that need no data payload.
-// No validation is performed to ensure the target UID exists or that the message is well-formed
-void Messenger::DeliverMessage(EntityID from, EntityID to, MessageType type, MessageData data /*= {}*/)
+// No validation is performed to ensure the message is well-formed. The recipient is only checked if ValidateRecipients is on,
+// returning false if it doesn't exist
+bool Messenger::DeliverMessage(EntityID from, EntityID to, MessageType type, MessageData data /*= {}*/)
+{
+	if (mValidateRecipients && !IsRecipientAlive(to))  return false;
+
+	// During the parallel phase the message can go into the shared queue instead of the chunk buffer, see UseLockFreeQueue
+	if (mQueuePhase)
+	{
+		QueuedMessage queued = { to, { from, type, std::move(data) }, mFrame };
+		if (mParallelQueue.TryPush(std::move(queued)))  return true;
+		data = std::move(queued.msg.data); // Queue full, use the chunk buffer
+	}
+
+	// Store the message and add its address to the end of the outbox, it is received on the next frame
+	Outbox& outbox = CurrentOutbox();
+	uint32_t message = StoreMessage(outbox, { from, type, std::move(data) }, mFrame);
+	outbox.addresses.push_back({ to, message });
+	return true;
+}
+
+
+// Send a message to every boat in the given team except the sender
+void Messenger::Broadcast(EntityID from, Team team, MessageType type, MessageData data /*= {}*/)
+{
+	Outbox& outbox = CurrentOutbox();
+	uint32_t message = StoreMessage(outbox, { from, type, std::move(data) }, mFrame);
+	for (Boat* boat : gEntityManager->View<Boat>())
+	{
+		if (boat->GetTeam() == team && boat->GetID() != from)  outbox.addresses.push_back({ boat->GetID(), message });
+	}
+}
+
+// Send a message to every boat within the given radius of a point except the sender, optionally only to those in the given team.
+// The recipients are found with the spatial grid so only boats near the point are visited
+void Messenger::BroadcastRadius(EntityID from, const Vector3& centre, float radius, MessageType type, MessageData data /*= {}*/,
+                                std::optional<Team> team /*= {}*/)
+{
+	Outbox& outbox = CurrentOutbox();
+	uint32_t message = StoreMessage(outbox, { from, type, std::move(data) }, mFrame);
+	gEntityManager->Spatial().QueryRadius(centre, radius, SPATIAL_BOAT, [&](Entity* entity)
+	{
+		if (entity->GetID() == from || (team && static_cast<Boat*>(entity)->GetTeam() != *team))  return;
+		outbox.addresses.push_back({ entity->GetID(), message });
+	});
+}
+
+// Send a message to every boat except the sender
+void Messenger::BroadcastAll(EntityID from, MessageType type, MessageData data /*= {}*/)
+{
+	Outbox& outbox = CurrentOutbox();
+	uint32_t message = StoreMessage(outbox, { from, type, std::move(data) }, mFrame);
+	for (Boat* boat : gEntityManager->View<Boat>())
+	{
+		if (boat->GetID() != from)  outbox.addresses.push_back({ boat->GetID(), message });
+	}
+}
+
+
+// Send a message that is received once the given delay in seconds has passed
+bool Messenger::DeliverAt(float delay, EntityID from, EntityID to, MessageType type, MessageData data /*= {}*/)
+{
+	if (delay <= 0.0f)  return DeliverMessage(from, to, type, std::move(data));
+	if (mValidateRecipients && !IsRecipientAlive(to))  return false;
+
+	// The delay is rounded up to whole ticks so the message is never early. During the parallel phase delayed messages are
+	// buffered with the others and added to the timers in chunk order
+	uint64_t ticks = static_cast<uint64_t>(std::ceil(delay / TIMER_TICK));
+	CurrentOutbox().delayed.push_back({ ticks, { to, { from, type, std::move(data) }, mFrame } });
+	if (!mParallelPhase)  AddDelayedMessages(mOutbox);
+	return true;
+}
+
+
+// Returns all the messages for the given UID this frame, in the order they were sent
+ReceivedMessages Messenger::ReceiveAll(EntityID to) const
+{
+	uint32_t slot = EntityIndex(to);
+	if (slot + 1 >= mSlotStart.size())  return {};
+
+	// All the slot's messages are for the same UID, which is not this one if the slot has been reused during the frame
+	const Address* first = mInbox.data() + mSlotStart[slot];
+	const Address* last  = mInbox.data() + mSlotStart[slot + 1];
+	if (first == last || first->to != to)  return {};
+
+	// Mark the messages as read for the statistics. Each entity only marks its own, so this is safe from several threads
+	if (mCountingFrame)  std::fill(mInboxRead.begin() + (first - mInbox.data()), mInboxRead.begin() + (last - mInbox.data()), 1);
+
+	return { mInboxMessages.data(), first, last };
+}
+
+
+// Start a new frame: the messages sent since the last call, and the delayed messages that are due, replace the messages
+// returned by ReceiveAll
+void Messenger::BeginFrame(float frameTime)
+{
+	PROFILE_SCOPE("Messenger::BeginFrame");
+	ALLOCATION_SCOPE("Messages");
+
+	// The inbox being replaced has had its chance to be read
+	if (mCountingFrame)  CountFrameStats();
+	++mFrame;
+
+	// Delayed messages that become due go on the end of the outbox, the same as if they had just been sent
+	mUnusedTime += frameTime;
+	while (mUnusedTime >= TIMER_TICK)
+	{
+		mUnusedTime -= TIMER_TICK;
+		mTimers.Tick([this](DelayedMessage&& due)
+		{
+			if (auto ref = std::get_if<LargePayloadRef>(&due.msg.data))
+			{
+				ref->offset = static_cast<uint32_t>(mOutbox.arena.size());
+				mOutbox.arena.insert(mOutbox.arena.end(), due.largePayload.begin(), due.largePayload.end());
+			}
+			uint32_t message = StoreMessage(mOutbox, std::move(due.msg), due.sentFrame);
+			mOutbox.addresses.push_back({ due.to, message });
+		});
+	}
+
+	DiscardDeadLetters();
+
+	// Note the messages of the types being observed, in the order they were sent
+	mObserved.clear();
+	if (mObservedTypes.any())
+	{
+		for (const auto& address : mOutbox.addresses)
+		{
+			if (mObservedTypes.test(static_cast<size_t>(mOutbox.messages[address.message].type)))  mObserved.push_back(address);
+		}
+	}
+
+	// Record the inbox as it will be received, in the order the messages were sent
+	if (mJournal)  mJournal->WriteFrame(mFrame, frameTime, mOutbox.addresses, mOutbox.messages, mOutbox.sentFrames, mOutbox.arena);
+
+	// The stored messages are used as they are, swapping the vectors so both keep their capacity from frame to frame
+	mInboxMessages.swap(mOutbox.messages);
+	mInboxSentFrames.swap(mOutbox.sentFrames);
+	mInboxArena.swap(mOutbox.arena);
+	mOutbox.messages.clear();
+	mOutbox.sentFrames.clear();
+	mOutbox.arena.clear();
+
+	// Count the addresses for each slot and turn the counts into start positions. Then place the addresses, using the start
+	// of each slot as its write position, which leaves it at the start of the next slot so they are shifted back afterwards.
+	// Going through the outbox in order keeps each slot's messages in the order they were sent
+	const auto& sent = mOutbox.addresses;
+	uint32_t numSlots = 0;
+	for (const auto& address : sent)  numSlots = std::max(numSlots, EntityIndex(address.to) + 1);
+	mSlotStart.assign(numSlots + 1, 0);
+	for (const auto& address : sent)  ++mSlotStart[EntityIndex(address.to) + 1];
+	for (size_t slot = 1; slot < mSlotStart.size(); ++slot)  mSlotStart[slot] += mSlotStart[slot - 1];
+
+	mInbox.resize(sent.size());
+	for (const auto& address : sent)  mInbox[mSlotStart[EntityIndex(address.to)]++] = address;
+	for (size_t slot = mSlotStart.size() - 1; slot > 0; --slot)  mSlotStart[slot] = mSlotStart[slot - 1];
+	mSlotStart[0] = 0;
+	mOutbox.addresses.clear();
+
+	gEventTrace.MessengerFlush(mFrame, static_cast<uint32_t>(mInbox.size()));
+
+	mCountingFrame = mStatsEnabled;
+	if (mCountingFrame)  mInboxRead.assign(mInbox.size(), 0);
+	else                 std::fill(std::begin(mDiscarded), std::end(mDiscarded), 0);
+}
+
+
+// Drop the outbox's messages for IDs that don't exist, so each slot in the inbox only has messages for one ID. If any entities
+// have been destroyed since the last call, the delayed messages waiting for them are dropped too. That visits every delayed
+// message, but only on frames after something was destroyed
+void Messenger::DiscardDeadLetters()
+{
+	if (!mCheckRecipients)  return;
+
+	auto isDead = [this](EntityID to, MessageType type)
+	{
+		if (gEntityManager->IsAlive(to))  return false;
+		++mDiscarded[static_cast<int>(type)];
+		return true;
+	};
+
+	std::erase_if(mOutbox.addresses, [&](const Address& address) { return isDead(address.to, mOutbox.messages[address.message].type); });
+
+	if (mNumDestroyedSeen != gEntityManager->GetNumDestroyed())
+	{
+		mNumDestroyedSeen = gEntityManager->GetNumDestroyed();
+		mTimers.RemoveIf([&](const DelayedMessage& delayed) { return isDead(delayed.to, delayed.msg.type); });
+	}
+}
+
+
+// Whether the recipient exists, always true if CheckRecipients is off
+bool Messenger::IsRecipientAlive(EntityID to) const
+{
+	return !mCheckRecipients || gEntityManager->IsAlive(to);
+}
+
+
+// Add an outbox's delayed messages to the timers, in the order they were sent, and empty its list of them. The outbox's arena
+// is emptied each frame, so large payloads are copied into the delayed message until it is due
+void Messenger::AddDelayedMessages(Outbox& outbox)
 {
-	// Create a Message object and insert the recipient UID + message into the multi-map of all current messages
-	// It will be inserted next to any other messages with the same recipient UID
-	Message msg = { from, type, data };
-	mMessages.insert({ to, msg });
+	for (auto& [ticks, delayed] : outbox.delayed)
+	{
+		if (auto ref = std::get_if<LargePayloadRef>(&delayed.msg.data))
+		{
+			auto first = outbox.arena.begin() + ref->offset;
+			delayed.largePayload.assign(first, first + ref->size);
+		}
+		mTimers.Add(ticks, std::move(delayed));
+	}
+	outbox.delayed.clear();
+}
+
+
+// Store a message in an outbox, returning its position for use in addresses
+uint32_t Messenger::StoreMessage(Outbox& outbox, Message&& message, uint32_t sentFrame)
+{
+	outbox.messages.push_back(std::move(message));
+	outbox.sentFrames.push_back(sentFrame);
+	return static_cast<uint32_t>(outbox.messages.size() - 1);
+}
+
+
+// Copy a large payload into the current outbox's arena and return the reference to it. Payloads are copied out again as bytes
+// (see GetLargePayload) so need no alignment
+LargePayloadRef Messenger::StorePayloadBytes(const void* data, size_t size)
+{
+	auto& arena = CurrentOutbox().arena;
+	LargePayloadRef ref = { static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(size) };
+	const std::byte* bytes = static_cast<const std::byte*>(data);
+	arena.insert(arena.end(), bytes, bytes + size);
+	return ref;
+}
 
-	// This is a more efficient way to replace the above two lines - it reduces copying and the need to construct a temporary Message
-	// It is particularly efficient when the data parameter is bracketed like this:  DeliverMessage(myUID, otherUID, MessageType::TargetPoint, TargetPointData{myTargetPoint, 5});
-	//mMessages.emplace(std::piecewise_construct, std::forward_as_tuple(to), std::forward_as_tuple(from, type, data));
+
+// The outbox that messages sent from the calling thread go into. During the parallel phase each thread writes only to the
+// buffer for the chunk it is processing, see header file
+Messenger::Outbox& Messenger::CurrentOutbox()
+{
+	return mParallelPhase ? mChunkOutboxes[tParallelChunk] : mOutbox;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Parallel update support
+-----------------------------------------------------------------------------------------*/
+
+// Start buffering messages, with one buffer for each chunk of work
+void Messenger::BeginParallelPhase(size_t numChunks)
+{
+	// Buffers are cleared rather than recreated so they keep their capacity from frame to frame
+	if (mChunkOutboxes.size() < numChunks)  mChunkOutboxes.resize(numChunks);
+	for (auto& buffer : mChunkOutboxes)
+	{
+		buffer.messages.clear();
+		buffer.sentFrames.clear();
+		buffer.addresses.clear();
+		buffer.delayed.clear();
+		buffer.arena.clear();
+	}
+	mParallelPhase = true;
+	mQueuePhase = mUseLockFreeQueue;
 }
 
+// Select the buffer that messages sent by the calling thread go into. Call from each thread before it processes a chunk
+void Messenger::SetParallelChunk(size_t chunk)
+{
+	tParallelChunk = chunk;
+}
 
-// Fetch the next available message for the given UID, returns the message through the given 
-// pointer. Returns false if there are no messages for this UID
-// Call multiple times until it returns false to fetch all messages for an entity
-bool Messenger::ReceiveMessage(EntityID to, Message* msg)
+// Add all buffered messages to the outbox in chunk order, then any from the lock-free queue, and go back to sending messages
+// directly to the outbox
+void Messenger::EndParallelPhase()
 {
-	// Find the first message for this UID in the message map
-	auto iter = mMessages.find(to);
+	PROFILE_SCOPE("Messenger::EndParallelPhase");
+	mParallelPhase = false;
+	mQueuePhase = false;
+
+	// Adding chunk by chunk gives the same message order as a serial update. The addresses in each buffer refer to the
+	// messages in that buffer, so are moved along to where the messages go in the outbox, and the same for large payloads.
+	// Delayed messages copy their large payloads from the buffer's arena, so are added before it is cleared
+	for (auto& buffer : mChunkOutboxes)
+	{
+		AddDelayedMessages(buffer);
+
+		uint32_t messageOffset = static_cast<uint32_t>(mOutbox.messages.size());
+		uint32_t arenaOffset   = static_cast<uint32_t>(mOutbox.arena.size());
+		for (auto& message : buffer.messages)
+		{
+			if (auto ref = std::get_if<LargePayloadRef>(&message.data))  ref->offset += arenaOffset;
+			mOutbox.messages.push_back(std::move(message));
+		}
+		mOutbox.arena.insert(mOutbox.arena.end(), buffer.arena.begin(), buffer.arena.end());
+		mOutbox.sentFrames.insert(mOutbox.sentFrames.end(), buffer.sentFrames.begin(), buffer.sentFrames.end());
+		for (Address address : buffer.addresses)
+		{
+			address.message += messageOffset;
+			mOutbox.addresses.push_back(address);
+		}
+		buffer.messages.clear();
+		buffer.sentFrames.clear();
+		buffer.addresses.clear();
+		buffer.arena.clear();
+	}
 
-	// Quit if no messages for this UID
-	if (iter == mMessages.end())
+	// Then the messages from the lock-free queue, this thread being its only consumer. All producers have finished by now
+	QueuedMessage queued;
+	while (mParallelQueue.TryPop(queued))
 	{
-		return false;
+		uint32_t message = StoreMessage(mOutbox, std::move(queued.msg), queued.sentFrame);
+		mOutbox.addresses.push_back({ queued.to, message });
 	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Checkpoints
+-----------------------------------------------------------------------------------------*/
+
+// Copy the messages waiting to be delivered. Between frames the chunk buffers are empty and every delayed message is in the
+// timers, so the outbox and the timers are all there is
+void Messenger::SaveState(SavedState& saved) const
+{
+	saved.messages   = mOutbox.messages;
+	saved.sentFrames = mOutbox.sentFrames;
+	saved.addresses  = mOutbox.addresses;
+	saved.arena      = mOutbox.arena;
+	saved.frame      = mFrame;
+	saved.unusedTime = mUnusedTime;
+
+	saved.delayed.clear();
+	saved.delayedPayloads.clear();
+	mTimers.ForEach([&](uint64_t ticks, const DelayedMessage& delayed)
+	{
+		uint32_t offset = static_cast<uint32_t>(saved.delayedPayloads.size());
+		saved.delayedPayloads.insert(saved.delayedPayloads.end(), delayed.largePayload.begin(), delayed.largePayload.end());
+		saved.delayed.push_back({ ticks, delayed.to, delayed.msg, delayed.sentFrame, offset,
+		                          static_cast<uint32_t>(delayed.largePayload.size()) });
+	});
+}
 
-	// Return message, then delete it
-	*msg = iter->second;
-	mMessages.erase(iter);
 
+// Replace the messages waiting to be delivered with saved ones, emptying this frame's inbox
+void Messenger::RestoreState(const SavedState& saved)
+{
+	mOutbox.messages   = saved.messages;
+	mOutbox.sentFrames = saved.sentFrames;
+	mOutbox.addresses  = saved.addresses;
+	mOutbox.arena      = saved.arena;
+	mOutbox.delayed.clear();
+	mFrame      = saved.frame;
+	mUnusedTime = saved.unusedTime;
+
+	// The delayed messages are added in the order they are due, so those due on the same tick keep their order
+	mTimers.Clear();
+	for (const SavedDelayed& delayed : saved.delayed)
+	{
+		auto first = saved.delayedPayloads.begin() + delayed.payloadOffset;
+		mTimers.Add(delayed.ticks, { delayed.to, delayed.msg, delayed.sentFrame, { first, first + delayed.payloadSize } });
+	}
+
+	// The inbox was for entities that may no longer exist. The restored delayed messages are checked for recipients that
+	// don't exist at the next BeginFrame
+	mInboxMessages.clear();
+	mInboxSentFrames.clear();
+	mInboxArena.clear();
+	mInbox.clear();
+	mSlotStart.clear();
+	mObserved.clear();
+	mCountingFrame = false;
+	mNumDestroyedSeen = UINT64_MAX;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Journal
+-----------------------------------------------------------------------------------------*/
+
+// Start recording to the given file, replacing any journal being recorded. Returns false if the file can't be created
+bool Messenger::StartJournal(const std::string& fileName)
+{
+	StopJournal();
+	auto journal = std::make_unique<MessageJournalWriter>();
+	if (!journal->Open(fileName))  return false;
+	mJournal = std::move(journal);
 	return true;
 }
+
+// Finish the journal being recorded, if any. Returns false if any of it failed to be written
+bool Messenger::StopJournal()
+{
+	if (!mJournal)  return true;
+	bool written = mJournal->Close();
+	mJournal.reset();
+	return written;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Statistics
+-----------------------------------------------------------------------------------------*/
+
+// Count the messages in the inbox of the frame just finished. Whether each was read was marked by ReceiveAll, the unread ones
+// are split into those whose recipient still exists and those whose recipient has been destroyed
+void Messenger::CountFrameStats()
+{
+	FrameStats frame;
+	frame.frame          = mFrame;
+	frame.inboxSize      = static_cast<uint32_t>(mInbox.size());
+	frame.delayedWaiting = static_cast<uint32_t>(mTimers.Size());
+
+	// Each recipient's addresses are next to each other (see mInbox), so the size of the largest mailbox is the longest run
+	uint32_t mailbox = 0;
+	for (size_t i = 0; i < mInbox.size(); ++i)
+	{
+		const Address& address = mInbox[i];
+		mailbox = (i > 0 && mInbox[i - 1].to == address.to) ? mailbox + 1 : 1;
+		frame.peakMailbox = std::max(frame.peakMailbox, mailbox);
+
+		TypeStats& typeStats = frame.types[static_cast<int>(mInboxMessages[address.message].type)];
+		++typeStats.sent;
+		if (mInboxRead[i])
+		{
+			++typeStats.received;
+			uint32_t delay = mFrame - mInboxSentFrames[address.message];
+			int bucket = (delay <= 1) ? 0 : std::min(static_cast<int>(std::bit_width(delay - 1)), NUM_DELAY_BUCKETS - 1);
+			++mStats.delayHistogram[bucket];
+		}
+		else if (IsRecipientAlive(address.to))
+		{
+			++typeStats.unread;
+		}
+		else
+		{
+			++typeStats.deadLetters;
+		}
+	}
+
+	for (int type = 0; type < NUM_MESSAGE_TYPES; ++type)
+	{
+		frame.types[type].discarded = mDiscarded[type];
+		mDiscarded[type] = 0;
+
+		mStats.totals[type].sent        += frame.types[type].sent;
+		mStats.totals[type].received    += frame.types[type].received;
+		mStats.totals[type].unread      += frame.types[type].unread;
+		mStats.totals[type].deadLetters += frame.types[type].deadLetters;
+		mStats.totals[type].discarded   += frame.types[type].discarded;
+	}
+	mStats.peakInboxSize = std::max(mStats.peakInboxSize, frame.inboxSize);
+	mStats.peakMailbox   = std::max(mStats.peakMailbox, frame.peakMailbox);
+	++mStats.framesCounted;
+	mStats.lastFrame = frame;
+
+	if (mStatsHistory.size() < MAX_STATS_HISTORY)
+	{
+		mStatsHistory.push_back(frame);
+	}
+	else
+	{
+		mStatsHistory[mStatsHistoryNext] = frame;
+		mStatsHistoryNext = (mStatsHistoryNext + 1) % MAX_STATS_HISTORY;
+	}
+}
+
+
+// Clear the statistics and the frames kept for export
+void Messenger::ResetStats()
+{
+	mStats = {};
+	std::fill(std::begin(mDiscarded), std::end(mDiscarded), 0);
+	mStatsHistory.clear();
+	mStatsHistoryNext = 0;
+}
+
+
+// Write the counts for the most recent frames to a CSV file, oldest first. Returns false if the file can't be written
+bool Messenger::ExportStats(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+
+	file << "Frame,Inbox,PeakMailbox,DelayedWaiting";
+	for (int type = 0; type < NUM_MESSAGE_TYPES; ++type)
+	{
+		const char* name = MessageTypeName(static_cast<MessageType>(type));
+		file << ',' << name << "Sent," << name << "Received," << name << "Unread," << name << "DeadLetters," << name << "Discarded";
+	}
+	file << '\n';
+
+	for (size_t i = 0; i < mStatsHistory.size(); ++i)
+	{
+		const FrameStats& frame = mStatsHistory[(mStatsHistoryNext + i) % mStatsHistory.size()];
+		file << frame.frame << ',' << frame.inboxSize << ',' << frame.peakMailbox << ',' << frame.delayedWaiting;
+		for (const TypeStats& typeStats : frame.types)
+		{
+			file << ',' << typeStats.sent << ',' << typeStats.received << ',' << typeStats.unread << ',' << typeStats.deadLetters << ',' << typeStats.discarded;
+		}
+		file << '\n';
+	}
+	return static_cast<bool>(file);
+}
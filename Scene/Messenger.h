@@ -8,9 +8,25 @@
 
 #include "Vector3.h"
 #include "Entity.h"
+#include "TimerWheel.h"
+#include "MpscQueue.h"
+
+enum class Team : int; // See Boat.h
+class MessageJournalWriter; // See MessageJournal.h
 
-#include <map>
 #include <variant>
+#include <vector>
+#include <optional>
+#include <utility>
+#include <string>
+#include <array>
+#include <bitset>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <stdint.h>
 
 
 /*-----------------------------------------------------------------------------------------
@@ -35,9 +51,19 @@ enum class MessageType
 	Reload,
 	MineHit,
 	CrateCollected,
-	ShieldDestroyed
+	ShieldDestroyed,
+	AimComplete,  // Aiming time is over, fire    - carries TimerData payload, sent to self with DeliverAt
+	EvadeComplete, // Evading time is over        - carries TimerData payload, sent to self with DeliverAt
+	ReloadTurn,   // A boat's turn at its reload station - no data payload, sent by the ReloadService from the station
+
+	NumMessageTypes // Not a message type, the number of types above. Keep this last
 };
 
+constexpr int NUM_MESSAGE_TYPES = static_cast<int>(MessageType::NumMessageTypes);
+
+// Name of a message type for display, e.g. "Hit"
+const char* MessageTypeName(MessageType type);
+
 
 // Some messages carry a "payload" of supporting data - define a struct for each. Other messages require no payload
 //*** These are examples, add structures if you need them for new message types, also add them to MessageData below
@@ -78,6 +104,21 @@ struct HelpMessageData
 	EntityID enemyBoatID; // The ID of the enemy boat that attacked
 };
 
+// Data payload for messages an entity schedules for itself with Messenger::DeliverAt. If the entity has moved on by the time
+// the message arrives, e.g. it has scheduled another since, the token won't match the entity's latest one and is ignored
+struct TimerData
+{
+	uint32_t token;
+};
+
+// Payload for a message whose data is too large to go in MessageData (see the size budget below). The data is stored once in
+// the messenger's payload arena and this refers to it, see Messenger::StoreLargePayload and Messenger::GetLargePayload
+struct LargePayloadRef
+{
+	uint32_t offset; // Position of the data in the arena
+	uint32_t size;   // Size of the data in bytes
+};
+
 
 // Then modify the MessageData type:
 // Different types of messages carry different payloads of data. We could do this with polymorphism, but messaging must be
@@ -85,9 +126,10 @@ struct HelpMessageData
 // Instead we use std::variant (C++17), which is a type that can be one from a collection of alternatives.
 // The type MessageData below can be one of TargetEntityData, TargetPointData or empty (indicated by std::monostate)
 //*** These are examples, if you add new message data structures, add them to this collection
-using MessageData = std::variant<std::monostate, TargetEntityData, TargetPointData, CratePickupData, MissileHitData, HelpMessageData>;
+using MessageData = std::variant<std::monostate, TargetEntityData, TargetPointData, CratePickupData, MissileHitData, HelpMessageData, TimerData,
+                                 LargePayloadRef>;
 
-// Message structure as returned from ReceiveMessage function: contains the sender, message type and optionally some kind of data payload
+// Message structure as returned from the ReceiveAll function: contains the sender, message type and optionally some kind of data payload
 //*** Do not change this structure
 struct Message
 {
@@ -97,13 +139,107 @@ struct Message
 };
 
 
+// Every message is as large as its largest payload type, so one large payload would slow down all messaging. Payloads must fit
+// in MESSAGE_PAYLOAD_BUDGET bytes, larger ones should be sent with Messenger::StoreLargePayload. PayloadSizes lists the size of
+// each alternative of MessageData in order, e.g. for display, and a payload over budget fails to compile naming its type
+constexpr size_t MESSAGE_PAYLOAD_BUDGET = 16;
+constexpr size_t MESSAGE_SIZE_BUDGET    = 32;
+
+template <typename Variant>
+struct PayloadSizes;
+
+template <typename... Payloads>
+struct PayloadSizes<std::variant<Payloads...>>
+{
+	static constexpr std::array<size_t, sizeof...(Payloads)> sizes = { sizeof(Payloads)... };
+	static constexpr size_t largest = std::max({ sizeof(Payloads)... });
+
+	// Instantiated for each payload type, so the error for one that is over budget shows which type it is
+	template <typename Payload>
+	static constexpr bool FitsBudget()
+	{
+		static_assert(sizeof(Payload) <= MESSAGE_PAYLOAD_BUDGET, "Message payload type is over MESSAGE_PAYLOAD_BUDGET, send it with Messenger::StoreLargePayload");
+		return true;
+	}
+	static constexpr bool allFitBudget = (FitsBudget<Payloads>() && ...);
+};
+
+static_assert(PayloadSizes<MessageData>::allFitBudget);
+static_assert(sizeof(Message) <= MESSAGE_SIZE_BUDGET, "Message has grown over MESSAGE_SIZE_BUDGET");
+
+
+/*-----------------------------------------------------------------------------------------
+	Received Messages
+----------------------------------------------------------------------------------------*/
+
+// The messages an entity has received this frame, as returned by Messenger::ReceiveAll. Used like a read-only container of
+// Message. Messages sent to several recipients at once (see Messenger::Broadcast) are only stored once, so this holds the
+// positions of the recipient's messages in the messenger's store rather than the messages themselves
+class ReceivedMessages
+{
+public:
+	// Where a message is in the messenger's store, with the ID of the recipient
+	struct Address
+	{
+		EntityID to;
+		uint32_t message;
+	};
+
+	class Iterator
+	{
+	public:
+		Iterator(const Message* store, const Address* address) : mStore(store), mAddress(address) {}
+		const Message& operator*()  const { return mStore[mAddress->message];  }
+		const Message* operator->() const { return &mStore[mAddress->message]; }
+		Iterator& operator++()  { ++mAddress; return *this; }
+		bool operator==(const Iterator& other) const { return mAddress == other.mAddress; }
+
+	private:
+		const Message* mStore;
+		const Address* mAddress;
+	};
+
+	ReceivedMessages() = default;
+	ReceivedMessages(const Message* store, const Address* first, const Address* last) : mStore(store), mFirst(first), mLast(last) {}
+
+	Iterator begin() const { return { mStore, mFirst }; }
+	Iterator end()   const { return { mStore, mLast  }; }
+	size_t   size()  const { return static_cast<size_t>(mLast - mFirst); }
+	bool     empty() const { return mFirst == mLast; }
+	const Message& operator[](size_t i) const { return mStore[mFirst[i].message]; }
+
+private:
+	const Message* mStore = nullptr;
+	const Address* mFirst = nullptr;
+	const Address* mLast  = nullptr;
+};
+
+
 /*-----------------------------------------------------------------------------------------
 	Messenger Class
 ----------------------------------------------------------------------------------------*/
 
 // Messenger class allows the sending and receiving of messages between entities - addressed by UID
+//
+// Messages are delivered in frames. Messages sent during one frame are collected in an outbox, and BeginFrame (called by
+// EntityManager::UpdateAll before any entities are updated) makes all of them visible together as the next frame's inbox.
+// So a message is always received on the frame after it was sent, whatever order the sender and recipient are updated in,
+// and no message sent during a frame can change what another entity receives in that same frame. Messages that are not
+// read during the frame they arrive in are discarded at the next BeginFrame.
+//
+// Messages addressed to entities that no longer exist are never delivered: they are dropped when the outbox becomes the inbox,
+// and delayed messages waiting for an entity are dropped at the start of the frame after it is destroyed. So messages for
+// destroyed entities (e.g. a hit on a boat that sank the same frame) don't take up space or slow down delivery
 class Messenger
 {
+	/*-----------------------------------------------------------------------------------------
+	    Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	Messenger();
+	~Messenger(); // Finishes writing the journal if one is being recorded
+
+
 	/*-----------------------------------------------------------------------------------------
 	    Message sending/receiving
 	-----------------------------------------------------------------------------------------*/
@@ -113,23 +249,329 @@ public:
 	//
 	// Each message type has an expected data payload (see the enum in Messenger.h). The final parameter must use the appropriate
 	// message data type. Don't pass the final parameter (let it use the default) for messages that need no data payload.
-	// No validation is performed to ensure the target UID exists or that the message is well-formed
-	void DeliverMessage(EntityID from, EntityID to, MessageType type, MessageData data = {});
+	// No validation is performed to ensure the message is well-formed. If recipient validation is on (see ValidateRecipients)
+	// a message to an ID that doesn't exist is not sent and false is returned, otherwise it is sent and discarded later
+	// The message is received on the next frame, see the comment above the class
+	bool DeliverMessage(EntityID from, EntityID to, MessageType type, MessageData data = {});
+
+	// Send a message to every boat in the given team, to every boat within a radius of a point (optionally only those in the
+	// given team) or to every boat. The sender never receives its own broadcast. The message and its data are stored once
+	// however many boats receive it, each recipient only adds a small address
+	//   Example: BroadcastRadius(myUID, enemyPos, 200.0f, MessageType::Help, HelpMessageData{enemyUID}, myTeam);
+	void Broadcast(EntityID from, Team team, MessageType type, MessageData data = {});
+	void BroadcastRadius(EntityID from, const Vector3& centre, float radius, MessageType type, MessageData data = {},
+	                     std::optional<Team> team = {});
+	void BroadcastAll(EntityID from, MessageType type, MessageData data = {});
+
+	// Send a message that is received once the given delay in seconds has passed, on the first frame at or after that time.
+	// Use instead of counting down a timer every frame, nothing is done for the message while it waits
+	//   Example: DeliverAt(2.0f, myUID, myUID, MessageType::AimComplete, TimerData{token}); // Wake myself up in 2 seconds
+	// A delay of 0 or less is the same as DeliverMessage. Returns false if the message is rejected by recipient validation.
+	// If the recipient is destroyed before the message is due the message is discarded
+	bool DeliverAt(float delay, EntityID from, EntityID to, MessageType type, MessageData data = {});
+
+	// Store a payload too large for MessageData (see MESSAGE_PAYLOAD_BUDGET) and return the reference to send as the message's
+	// data. The payload is copied as bytes so must be trivially copyable. The recipient reads it with GetLargePayload
+	//   Example: DeliverMessage(myUID, allyUID, MessageType::Orders, gMessenger->StoreLargePayload(orders));
+	// The stored payload is only valid for a message sent from the same thread before the next BeginFrame
+	template <typename T>
+	LargePayloadRef StoreLargePayload(const T& payload)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Large message payloads are copied as bytes");
+		return StorePayloadBytes(&payload, sizeof(T));
+	}
+
+	// Untyped version of StoreLargePayload, copying the given number of bytes. Used when replaying a journal
+	LargePayloadRef StorePayloadBytes(const void* data, size_t size);
+
+	// Return a copy of the large payload of a message received this frame. T must be the type that was stored
+	template <typename T>
+	T GetLargePayload(const Message& message) const
+	{
+		const LargePayloadRef& ref = std::get<LargePayloadRef>(message.data);
+		T payload;
+		std::memcpy(&payload, mInboxArena.data() + ref.offset, sizeof(T));
+		return payload;
+	}
+
+	// When on, DeliverMessage and DeliverAt check that the recipient exists (a single array lookup) and reject the message if
+	// not, which helps track down code that keeps sending to stale IDs. Broadcasts only ever go to existing entities
+	bool& ValidateRecipients()  { return mValidateRecipients; }
+
+	// When off, every recipient is treated as existing: nothing is discarded or rejected and the entity manager isn't used to
+	// check IDs. Only for messengers that run without entities, e.g. when replaying a journal (see MessageJournal.h)
+	bool& CheckRecipients()  { return mCheckRecipients; }
+
+	// Returns all the messages for the given UID this frame, in the order they were sent. Empty if there are none
+	//   Example: for (const Message& message : gMessenger->ReceiveAll(GetID())) { ... }
+	// The messages are unchanged until the next BeginFrame, which is why this is safe from worker threads. Don't keep the
+	// result beyond the current update
+	ReceivedMessages ReceiveAll(EntityID to) const;
+
+	// Keep a list of the messages of the given type placed in each frame's inbox, whoever they are for (see ForEachObserved).
+	// Lets code outside the entities, e.g. the UI, react to events as they happen rather than checking every entity each frame
+	void Observe(MessageType type, bool observe = true)  { mObservedTypes.set(static_cast<size_t>(type), observe); }
+
+	// Call function(recipient, message) for each message of an observed type in this frame's inbox, in the order they were sent
+	//   Example: ForEachObserved([&](EntityID boatID, const Message& message) { labels[boatID].dirty = true; });
+	template <typename Function>
+	void ForEachObserved(Function&& function) const
+	{
+		for (const Address& address : mObserved)  function(address.to, mInboxMessages[address.message]);
+	}
+
+	// Messages in this frame's inbox, one for each recipient. Always available, unlike the statistics below
+	size_t InboxSize() const  { return mInbox.size(); }
+
+	// Start a new frame, the given time after the last: the messages sent since the last call, and the delayed messages that
+	// have become due, replace the messages returned by ReceiveAll. Messages for entities that no longer exist are discarded
+	void BeginFrame(float frameTime);
+
+
+	/*-----------------------------------------------------------------------------------------
+	    Parallel update support
+	-----------------------------------------------------------------------------------------*/
+	// While entities are being updated on several threads (see EntityManager::UpdateAll) messages are not added to the
+	// outbox directly. Instead the messages sent while processing each chunk of entities go into a separate buffer for that chunk,
+	// and the buffers are added to the outbox in chunk order at the end. Messages end up in the same order as if the entities had
+	// been updated one by one, whichever thread ran each chunk. ReceiveAll can be used as normal during this phase
+	//
+	// Alternatively DeliverMessage can send through a single lock-free queue shared by all threads (see MpscQueue), collected at
+	// the end of the phase. This avoids the per-chunk buffers but the order of messages sent to one recipient from different
+	// chunks then varies from run to run, so gameplay is no longer exactly repeatable. Broadcasts, delayed messages and messages
+	// sent when the queue is full still use the chunk buffers
+public:
+	// Use the lock-free queue for messages sent with DeliverMessage during the parallel phase. Takes effect at the next
+	// BeginParallelPhase
+	bool& UseLockFreeQueue()  { return mUseLockFreeQueue; }
+
+	// Start buffering messages, with one buffer for each chunk of work
+	void BeginParallelPhase(size_t numChunks);
+
+	// Select the buffer that messages sent by the calling thread go into. Call from each thread before it processes a chunk
+	void SetParallelChunk(size_t chunk);
+
+	// Add all buffered messages to the outbox in chunk order, then any from the lock-free queue, and go back to sending messages
+	// directly to the outbox
+	void EndParallelPhase();
+
+
+	/*-----------------------------------------------------------------------------------------
+	    Statistics
+	-----------------------------------------------------------------------------------------*/
+	// Counts of message traffic for the control panel and for export, collected only while enabled. A frame's messages are
+	// counted at the next BeginFrame, when they have all had their chance to be read, so the figures are for the last
+	// complete frame. Recipients that read messages are marked during ReceiveAll, which is safe from worker threads as each
+	// entity only marks its own messages
+public:
+	// Buckets of the histogram of frames between sending and reading a message: 1, 2, 3-4, 5-8, ..., 33-64, 65 and over.
+	// Messages sent with DeliverMessage or a broadcast are always read one frame later, only delayed messages take longer
+	static constexpr int NUM_DELAY_BUCKETS = 8;
+
+	struct TypeStats
+	{
+		uint32_t sent        = 0; // Messages placed in an inbox, one for each recipient, including delayed messages that became due
+		uint32_t received    = 0; // Messages read by their recipient with ReceiveAll
+		uint32_t unread      = 0; // Messages discarded unread by a recipient that still exists
+		uint32_t deadLetters = 0; // Messages discarded unread because their recipient was destroyed after they were placed
+		uint32_t discarded   = 0; // Messages discarded before reaching an inbox because their recipient didn't exist
+	};
+
+	struct FrameStats
+	{
+		uint32_t  frame          = 0;
+		TypeStats types[NUM_MESSAGE_TYPES];
+		uint32_t  inboxSize      = 0; // Messages in the frame's inbox, one for each recipient
+		uint32_t  peakMailbox    = 0; // Most messages in the inbox for any one recipient
+		uint32_t  delayedWaiting = 0; // Delayed messages not yet due at the end of the frame
+	};
+
+	struct Stats
+	{
+		FrameStats lastFrame;
+		TypeStats  totals[NUM_MESSAGE_TYPES];
+		uint32_t   peakInboxSize = 0;
+		uint32_t   peakMailbox   = 0;
+		uint64_t   delayHistogram[NUM_DELAY_BUCKETS] = {};
+		uint32_t   framesCounted = 0;
+	};
+
+	// Enable or disable collecting statistics. Collection starts or stops at the next BeginFrame
+	bool& StatsEnabled()  { return mStatsEnabled; }
+
+	// Statistics since collection was enabled or last reset
+	const Stats& GetStats()  { return mStats; }
+
+	// Clear the statistics and the frames kept for export
+	void ResetStats();
+
+	// Write the counts for the most recent frames (up to MAX_STATS_HISTORY) to a CSV file, one row per frame with columns for
+	// each message type. Returns false if the file can't be written
+	bool ExportStats(const std::string& fileName) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+	    Checkpoints
+	-----------------------------------------------------------------------------------------*/
+	// The messages still to be delivered - those sent during the last frame and the delayed messages waiting - can be copied
+	// out and put back to save and restore the game, see Checkpoint.h. Only between frames, not during UpdateAll. The copy is
+	// plain data so it can be written as bytes, and is only meaningful alongside the entities it was saved with
+public:
+	// A delayed message with the number of ticks until it is due. Its large payload, if it has one, is a range of delayedPayloads
+	struct SavedDelayed
+	{
+		uint64_t ticks;
+		EntityID to;
+		Message  msg;
+		uint32_t sentFrame;
+		uint32_t payloadOffset;
+		uint32_t payloadSize;
+	};
+
+	struct SavedState
+	{
+		std::vector<Message>         messages;
+		std::vector<uint32_t>        sentFrames;
+		std::vector<ReceivedMessages::Address> addresses;
+		std::vector<std::byte>       arena;
+		std::vector<SavedDelayed>    delayed; // In the order they are due
+		std::vector<std::byte>       delayedPayloads;
+		uint32_t frame      = 0;
+		float    unusedTime = 0.0f;
+	};
+
+	// Copy the messages waiting to be delivered
+	void SaveState(SavedState& saved) const;
+
+	// Replace the messages waiting to be delivered with saved ones. This frame's inbox is emptied, the saved messages are
+	// delivered from the next BeginFrame as they would have been. Restore the entities first, delayed messages for IDs that
+	// don't exist are discarded at the next BeginFrame
+	void RestoreState(const SavedState& saved);
 
-	// Fetch the next available message for the given UID, returns the message through the given 
-	// pointer. Returns false if there are no messages for this UID
-	bool ReceiveMessage(EntityID to, Message* msg);
+
+	/*-----------------------------------------------------------------------------------------
+	    Journal
+	-----------------------------------------------------------------------------------------*/
+	// A journal records every message placed in each frame's inbox to a file, written on a background thread so it has little
+	// effect on the frame time. See MessageJournal.h for the file layout and for replaying a journal
+public:
+	// Start recording to the given file, replacing any journal being recorded. Returns false if the file can't be created
+	bool StartJournal(const std::string& fileName);
+
+	// Finish the journal being recorded, if any. Returns false if any of it failed to be written
+	bool StopJournal();
+
+	bool IsJournalling()  { return mJournal != nullptr; }
 
 
 	/*-----------------------------------------------------------------------------------------
 		Private data
 	-----------------------------------------------------------------------------------------*/
 private:
-	// A multimap is similar to a map - it maps keys to values. In a map each key can only occur once, but in a multimap there can
-	// be multiple entries with the same key. This is perfect for holding messages - the key is the recipient, the value the message.
-	// We can have more than one message per recipient (as this is a multimap) and the recipient can look up their messages efficiently
-	// since this is a map
-	std::multimap<EntityID, Message> mMessages;
+	using Address = ReceivedMessages::Address;
+
+	// A delayed message for one recipient, see DeliverAt
+	struct DelayedMessage
+	{
+		EntityID to;
+		Message  msg;
+		uint32_t sentFrame;
+		std::vector<std::byte> largePayload; // Copy of the message's large payload, if it has one, while the message waits
+	};
+
+	// Messages sent, each stored once with the frame it was sent on, and the address of each message for each of its recipients,
+	// in the order they were sent. Delayed messages are kept with the number of timer ticks until they are due. The arena holds
+	// the large payloads of the messages, see StoreLargePayload
+	struct Outbox
+	{
+		std::vector<Message>  messages;
+		std::vector<uint32_t> sentFrames;
+		std::vector<Address>  addresses;
+		std::vector<std::pair<uint64_t, DelayedMessage>> delayed;
+		std::vector<std::byte> arena;
+	};
+
+	// The outbox that messages sent from the calling thread go into, the chunk buffer during the parallel phase
+	Outbox& CurrentOutbox();
+
+	// Store a message in an outbox, returning its position for use in addresses
+	uint32_t StoreMessage(Outbox& outbox, Message&& message, uint32_t sentFrame);
+
+	// Add an outbox's delayed messages to the timers and empty its list of them
+	void AddDelayedMessages(Outbox& outbox);
+
+	// Messages sent this frame
+	Outbox mOutbox;
+
+	// Messages for this frame. The addresses are grouped by the slot index of the recipient's ID (see EntityIndex): the
+	// addresses for slot s are mInbox[mSlotStart[s]] to mInbox[mSlotStart[s + 1] - 1], each in the order they were sent, so
+	// finding them is a single array lookup. Messages for IDs that don't exist are dropped before the inbox is made, so all the
+	// addresses for a slot are for the same ID. The slot's entity may be destroyed and the slot reused during the frame, so
+	// ReceiveAll still checks the ID
+	std::vector<Message>  mInboxMessages;
+	std::vector<uint32_t> mInboxSentFrames;
+	std::vector<std::byte> mInboxArena; // Large payloads of the inbox messages
+	std::vector<Address>  mInbox;
+	std::vector<uint32_t> mSlotStart;
+
+	// Frames started so far, for the frame each message is sent on
+	uint32_t mFrame = 0;
+
+	// Message types being observed, and the addresses in mInbox of the messages of those types, see Observe
+	std::bitset<NUM_MESSAGE_TYPES> mObservedTypes;
+	std::vector<Address> mObserved;
+
+	// Delayed messages waiting until they are due. Time is measured in ticks of TIMER_TICK seconds, and mUnusedTime is the
+	// time passed since the last tick
+	static constexpr float TIMER_TICK = 0.01f;
+	TimerWheel<DelayedMessage> mTimers;
+	float mUnusedTime = 0.0f;
+
+	// Drop the outbox's messages for IDs that don't exist, and if any entities have been destroyed since the last call the
+	// delayed messages for them too
+	void DiscardDeadLetters();
+
+	// Whether the recipient exists, always true if CheckRecipients is off
+	bool IsRecipientAlive(EntityID to) const;
+
+	uint64_t mNumDestroyedSeen = 0; // EntityManager::GetNumDestroyed when the delayed messages were last checked
+	bool     mValidateRecipients = false;
+	bool     mCheckRecipients = true;
+
+	// Messages waiting in a buffer for each chunk during the parallel phase, see above
+	std::vector<Outbox> mChunkOutboxes;
+	bool mParallelPhase = false;
+
+	// Messages sent through the lock-free queue during the parallel phase, see UseLockFreeQueue
+	struct QueuedMessage
+	{
+		EntityID to = NO_ID;
+		Message  msg;
+		uint32_t sentFrame = 0;
+	};
+	static constexpr size_t PARALLEL_QUEUE_CAPACITY = 4096;
+	MpscQueue<QueuedMessage> mParallelQueue = MpscQueue<QueuedMessage>(PARALLEL_QUEUE_CAPACITY);
+	bool mUseLockFreeQueue = false;
+	bool mQueuePhase = false; // Messages are going into the queue this parallel phase
+
+	// Count the messages in the inbox of the frame just finished, see Statistics above
+	void CountFrameStats();
+
+	// Number of frames kept for ExportStats, about a minute at 60fps
+	static constexpr size_t MAX_STATS_HISTORY = 3600;
+
+	bool  mStatsEnabled = false;
+	bool  mCountingFrame = false; // Whether this frame's inbox is being counted, fixed at BeginFrame
+	Stats mStats;
+	uint32_t mDiscarded[NUM_MESSAGE_TYPES] = {}; // Messages discarded at the last BeginFrame, counted with that frame's inbox
+	std::vector<FrameStats> mStatsHistory; // Ring of the most recent frames, mStatsHistoryNext is the oldest once full
+	size_t mStatsHistoryNext = 0;
+
+	// For each address in mInbox, non-zero if ReceiveAll has returned it this frame. Only used while counting a frame
+	mutable std::vector<uint8_t> mInboxRead;
+
+	// Journal being recorded, null if none, see StartJournal
+	std::unique_ptr<MessageJournalWriter> mJournal;
 };
 
 
@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------
+// Timing of the Messenger's ways of collecting messages sent from worker threads
+//--------------------------------------------------------------------------------------
+
+#include "MessengerBenchmark.h"
+
+#include "Messenger.h"
+#include "Timer.h"
+
+#include <memory>
+
+
+// Entities per chunk of work, the same as the EntityManager uses for parallel updates
+static constexpr size_t CHUNK_SIZE = 32;
+
+// Frames timed with each method, after some untimed frames to let the buffers reach their full size
+static constexpr int WARM_UP_FRAMES = 5;
+static constexpr int TIMED_FRAMES   = 50;
+
+
+// Returns the average time in milliseconds for a frame of messages sent by the senders and collected by the given messenger
+static float TimeFrames(Messenger& messenger, JobSystem& jobSystem, const std::vector<EntityID>& recipients,
+                        uint32_t numSenders, uint32_t messagesPerSender)
+{
+	Timer timer;
+	float totalTime = 0;
+	for (int frame = 0; frame < WARM_UP_FRAMES + TIMED_FRAMES; ++frame)
+	{
+		timer.Reset();
+		messenger.BeginParallelPhase(JobSystem::NumChunks(numSenders, CHUNK_SIZE));
+		jobSystem.ParallelFor(numSenders, CHUNK_SIZE, [&](size_t chunk, size_t begin, size_t end)
+		{
+			messenger.SetParallelChunk(chunk);
+			for (size_t sender = begin; sender < end; ++sender)
+			{
+				for (uint32_t i = 0; i < messagesPerSender; ++i)
+				{
+					EntityID to = recipients[(sender + i) % recipients.size()];
+					messenger.DeliverMessage(SYSTEM_ID, to, MessageType::Hit, MissileHitData{ SYSTEM_ID });
+				}
+			}
+		});
+		messenger.EndParallelPhase();
+		messenger.BeginFrame(0);
+		if (frame >= WARM_UP_FRAMES)  totalTime += timer.GetTime();
+	}
+	return totalTime * 1000.0f / TIMED_FRAMES;
+}
+
+
+// Time sending the given number of messages per frame from the given number of senders to the recipients with each method
+MessengerBenchmarkResults RunMessengerBenchmark(JobSystem& jobSystem, const std::vector<EntityID>& recipients,
+                                                uint32_t numSenders /*= 512*/, uint32_t messagesPerSender /*= 4*/)
+{
+	MessengerBenchmarkResults results;
+	if (recipients.empty())  return results;
+	results.messagesPerFrame = numSenders * messagesPerSender;
+
+	// Messengers are large (the lock-free queue), so not on the stack
+	auto chunkBufferMessenger = std::make_unique<Messenger>();
+	results.chunkBufferMs = TimeFrames(*chunkBufferMessenger, jobSystem, recipients, numSenders, messagesPerSender);
+
+	auto queueMessenger = std::make_unique<Messenger>();
+	queueMessenger->UseLockFreeQueue() = true;
+	results.lockFreeQueueMs = TimeFrames(*queueMessenger, jobSystem, recipients, numSenders, messagesPerSender);
+
+	return results;
+}
@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Timing of the Messenger's ways of collecting messages sent from worker threads
+//--------------------------------------------------------------------------------------
+// Many senders on the job system's threads each send a batch of messages to a few recipients, as missiles, mines, crates
+// and shields all sending to the same boats would, and the time to send them and make them into the next frame's inbox is
+// measured. This is done with the per-chunk buffers (the default, repeatable message order) and with the lock-free queue
+// (see Messenger::UseLockFreeQueue), each in a Messenger of its own so the game's messages are unaffected.
+//
+//   auto results = RunMessengerBenchmark(*gJobSystem, boatIDs);
+//
+// The recipients must be entities that exist, as messages to other IDs are discarded
+
+#ifndef _MESSENGER_BENCHMARK_H_INCLUDED_
+#define _MESSENGER_BENCHMARK_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "JobSystem.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+struct MessengerBenchmarkResults
+{
+	uint32_t messagesPerFrame = 0;
+	float    chunkBufferMs    = 0; // Average time per frame to send and collect the messages with each method
+	float    lockFreeQueueMs  = 0;
+};
+
+// Time sending the given number of messages per frame from the given number of senders to the recipients with each method,
+// averaged over several frames. Must be called from the main thread outside of EntityManager::UpdateAll
+MessengerBenchmarkResults RunMessengerBenchmark(JobSystem& jobSystem, const std::vector<EntityID>& recipients,
+                                                uint32_t numSenders = 512, uint32_t messagesPerSender = 4);
+
+
+#endif //_MESSENGER_BENCHMARK_H_INCLUDED_
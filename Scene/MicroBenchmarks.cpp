@@ -0,0 +1,387 @@
+//--------------------------------------------------------------------------------------
+// Timing of hot paths in isolation - maths, the entity manager, the messenger and level loading
+//--------------------------------------------------------------------------------------
+
+#include "MicroBenchmarks.h"
+
+#include "EntityManager.h"
+#include "Messenger.h"
+#include "Obstacle.h"
+#include "Boat.h"
+#include "ParseLevel.h"
+#include "SceneGlobals.h"
+#include "Matrix4x4.h"
+#include "Vector3.h"
+#include "Random.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <memory>
+
+
+// Each benchmark is run this many times and the fastest taken, the slower runs being those disturbed by something else
+static constexpr int RUNS = 5;
+
+// Entity counts the entity manager is timed with
+static constexpr uint32_t ENTITY_COUNTS[] = { 10000, 100000 };
+
+// Results are added to this so the compiler can't leave out work whose result isn't used
+static volatile float sSink = 0;
+
+
+// Time of the fastest of RUNS calls to the function, in milliseconds. The setup function is called untimed before each run
+template <typename Setup, typename Work>
+static float Fastest(Setup setup, Work work)
+{
+	float fastest = 0;
+	for (int run = 0; run < RUNS; ++run)
+	{
+		setup();
+		Timer timer;
+		timer.Start();
+		work();
+		float milliseconds = timer.GetTime() * 1000.0f;
+		if (run == 0 || milliseconds < fastest)  fastest = milliseconds;
+	}
+	return fastest;
+}
+
+template <typename Work>
+static float Fastest(Work work)
+{
+	return Fastest([] {}, work);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Maths
+-----------------------------------------------------------------------------------------*/
+
+// Matrix multiply and inverse, and the common vector operations, over arrays of random values
+static void MathBenchmarks(std::vector<MicroBenchmarkResult>& results)
+{
+	constexpr uint32_t COUNT   = 4096; // Matrices fit in the cache, so it is the arithmetic being timed
+	constexpr uint32_t REPEATS = 100;
+
+	RandomStream random(RandomStream::DEFAULT_SEED, 0x4d415448);
+	auto randomVector = [&](float range) { return Vector3{ random.Range(-range, range), random.Range(-range, range), random.Range(-range, range) }; };
+	std::vector<Matrix4x4> a, b, out(COUNT);
+	std::vector<Vector3>   u, v, vectorsOut(COUNT);
+	for (uint32_t i = 0; i < COUNT; ++i)
+	{
+		a.push_back(Matrix4x4(randomVector(100.0f), randomVector(3.0f), random.Range(0.5f, 2.0f)));
+		b.push_back(Matrix4x4(randomVector(100.0f), randomVector(3.0f), random.Range(0.5f, 2.0f)));
+		u.push_back(randomVector(10.0f));
+		v.push_back(randomVector(10.0f));
+	}
+
+	auto add = [&](const char* name, auto work, auto check)
+	{
+		float milliseconds = Fastest([&]
+		{
+			for (uint32_t repeat = 0; repeat < REPEATS; ++repeat)  work();
+		});
+		sSink = sSink + check();
+		results.push_back({ name, COUNT * REPEATS, milliseconds });
+	};
+	auto matrixCheck = [&] { return out[COUNT / 2].e30; };
+	auto vectorCheck = [&] { return vectorsOut[COUNT / 2].x; };
+
+	add("Matrix4x4 multiply", [&] { for (uint32_t i = 0; i < COUNT; ++i)  out[i] = a[i] * b[i]; }, matrixCheck);
+	add("Matrix4x4 Inverse", [&] { for (uint32_t i = 0; i < COUNT; ++i)  out[i] = Inverse(a[i]); }, matrixCheck);
+	add("Matrix4x4 InverseAffine", [&] { for (uint32_t i = 0; i < COUNT; ++i)  out[i] = InverseAffine(a[i]); }, matrixCheck);
+	add("Vector3 add/scale", [&] { for (uint32_t i = 0; i < COUNT; ++i)  vectorsOut[i] = u[i] + v[i] * 0.5f; }, vectorCheck);
+	add("Vector3 Dot", [&] { for (uint32_t i = 0; i < COUNT; ++i)  vectorsOut[i].x = Dot(u[i], v[i]); }, vectorCheck);
+	add("Vector3 Cross", [&] { for (uint32_t i = 0; i < COUNT; ++i)  vectorsOut[i] = Cross(u[i], v[i]); }, vectorCheck);
+	add("Vector3 Normalise", [&] { for (uint32_t i = 0; i < COUNT; ++i)  vectorsOut[i] = Normalise(u[i]); }, vectorCheck);
+	add("Vector3 Length", [&] { for (uint32_t i = 0; i < COUNT; ++i)  vectorsOut[i].x = u[i].Length(); }, vectorCheck);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Entity manager
+-----------------------------------------------------------------------------------------*/
+
+// Create, look up, list and destroy the given number of plain entities using the given template. The level's own entities
+// are also in the manager, as they would be in the game
+static void EntityBenchmarks(Atom templateType, uint32_t count, std::vector<MicroBenchmarkResult>& results)
+{
+	std::string suffix = " (" + std::to_string(count) + ")";
+	RandomStream random(RandomStream::DEFAULT_SEED, 0x454e54);
+	std::vector<Matrix4x4> transforms;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		transforms.push_back(Matrix4x4(Vector3{ random.Range(-1000.0f, 1000.0f), 0.0f, random.Range(-1000.0f, 1000.0f) }));
+	}
+
+	// Each run destroys what it created, so every run creates into the same state
+	std::vector<EntityID> ids;
+	auto destroyAll = [&]
+	{
+		for (EntityID id : ids)  gEntityManager->DestroyEntity(id);
+		ids.clear();
+	};
+	auto createAll = [&]
+	{
+		TemplateHandle handle(templateType);
+		for (uint32_t i = 0; i < count; ++i)  ids.push_back(gEntityManager->CreateEntity<Entity>(handle, transforms[i]));
+	};
+
+	float milliseconds = Fastest(destroyAll, createAll);
+	results.push_back({ "EntityManager::CreateEntity" + suffix, count, milliseconds });
+	destroyAll();
+
+	milliseconds = Fastest(createAll, destroyAll);
+	results.push_back({ "EntityManager::DestroyEntity" + suffix, count, milliseconds });
+
+	// Looked up in a shuffled order, as entities holding each other's IDs would
+	createAll();
+	std::vector<EntityID> shuffled = ids;
+	for (size_t i = shuffled.size(); i > 1; --i)  std::swap(shuffled[i - 1], shuffled[random.Range(0, static_cast<int>(i) - 1)]);
+	milliseconds = Fastest([&]
+	{
+		size_t found = 0;
+		for (EntityID id : shuffled)  found += gEntityManager->GetEntity(id) != nullptr;
+		sSink = sSink + static_cast<float>(found);
+	});
+	results.push_back({ "EntityManager::GetEntity" + suffix, count, milliseconds });
+
+	// The list copies, timed per entity listed
+	constexpr int LIST_REPEATS = 20;
+	auto addList = [&](const char* name, auto list)
+	{
+		size_t listed = 0;
+		float listMilliseconds = Fastest([&]
+		{
+			listed = 0;
+			for (int repeat = 0; repeat < LIST_REPEATS; ++repeat)  listed += list();
+		});
+		results.push_back({ name + suffix, std::max<size_t>(listed, 1), listMilliseconds });
+	};
+	addList("EntityManager::GetAllEntities", [] { return gEntityManager->GetAllEntities().size(); });
+	addList("EntityManager::GetAllObstacleEntities", [] { return gEntityManager->GetAllObstacleEntities().size(); });
+	addList("EntityManager::GetAllBoatEntities", [] { return gEntityManager->GetAllBoatEntities().size(); });
+	destroyAll();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Messenger
+-----------------------------------------------------------------------------------------*/
+
+// Send messages to the recipients in turn, start the next frame and have every recipient read its messages, in a messenger
+// of its own so the global one is left as it was
+static void MessengerBenchmarks(const std::vector<EntityID>& recipients, std::vector<MicroBenchmarkResult>& results)
+{
+	constexpr uint32_t MESSAGES = 100000;
+	auto messenger = std::make_unique<Messenger>(); // Large (the lock-free queue), so not on the stack
+
+	float sendMilliseconds = 0, frameMilliseconds = 0, receiveMilliseconds = 0;
+	for (int run = 0; run < RUNS; ++run)
+	{
+		Timer timer;
+		timer.Start();
+		for (uint32_t i = 0; i < MESSAGES; ++i)
+		{
+			messenger->DeliverMessage(SYSTEM_ID, recipients[i % recipients.size()], MessageType::Hit, MissileHitData{ SYSTEM_ID });
+		}
+		float send = timer.GetLapTime() * 1000.0f;
+		messenger->BeginFrame(0);
+		float frame = timer.GetLapTime() * 1000.0f;
+		size_t received = 0;
+		for (EntityID to : recipients)
+		{
+			for (const Message& message : messenger->ReceiveAll(to))  received += message.type == MessageType::Hit;
+		}
+		float receive = timer.GetLapTime() * 1000.0f;
+		sSink = sSink + static_cast<float>(received);
+
+		if (run == 0 || send    < sendMilliseconds)     sendMilliseconds    = send;
+		if (run == 0 || frame   < frameMilliseconds)    frameMilliseconds   = frame;
+		if (run == 0 || receive < receiveMilliseconds)  receiveMilliseconds = receive;
+	}
+	results.push_back({ "Messenger::DeliverMessage", MESSAGES, sendMilliseconds });
+	results.push_back({ "Messenger::BeginFrame", MESSAGES, frameMilliseconds });
+	results.push_back({ "Messenger::ReceiveAll", MESSAGES, receiveMilliseconds });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Obstacles
+-----------------------------------------------------------------------------------------*/
+
+// Test random segments, missile-flight sized, against every obstacle in the level, timed per test
+static void ObstacleBenchmarks(std::vector<MicroBenchmarkResult>& results)
+{
+	constexpr uint32_t SEGMENTS = 10000;
+	const auto& obstacles = gEntityManager->View<Obstacle>();
+	if (obstacles.empty())  return;
+
+	RandomStream random(RandomStream::DEFAULT_SEED, 0x4f4253);
+	std::vector<Vector3> starts, ends;
+	for (uint32_t i = 0; i < SEGMENTS; ++i)
+	{
+		Vector3 start = { random.Range(-1000.0f, 1000.0f), random.Range(-5.0f, 20.0f), random.Range(-1000.0f, 1000.0f) };
+		starts.push_back(start);
+		ends.push_back(start + Vector3{ random.Range(-200.0f, 200.0f), random.Range(-5.0f, 5.0f), random.Range(-200.0f, 200.0f) });
+	}
+
+	float milliseconds = Fastest([&]
+	{
+		size_t hits = 0;
+		for (uint32_t i = 0; i < SEGMENTS; ++i)
+		{
+			for (Obstacle* obstacle : obstacles)  hits += obstacle->IntersectsLineSegment(starts[i], ends[i]);
+		}
+		sSink = sSink + static_cast<float>(hits);
+	});
+	results.push_back({ "Obstacle::IntersectsLineSegment", SEGMENTS * obstacles.size(), milliseconds });
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Level loading
+-----------------------------------------------------------------------------------------*/
+
+// Load a generated level of the given number of obstacles using the given level's templates, from its XML (compiling it)
+// and then from the compiled level. Each load is into an entity manager of its own, put in the global while loading as the
+// entities use it. Returns false if the level can't be written or loaded
+static bool LevelBenchmarks(JobSystem& jobSystem, const std::string& levelFile, const std::string& obstacleTemplate,
+                            uint32_t count, std::vector<MicroBenchmarkResult>& results, std::string& error)
+{
+	std::stringstream level;
+	level << std::ifstream(levelFile).rdbuf();
+	std::string text = level.str();
+	size_t templatesStart = text.find("<EntityTemplates>");
+	size_t templatesEnd   = text.find("</EntityTemplates>");
+	if (templatesStart == std::string::npos || templatesEnd == std::string::npos)
+	{
+		error = "No entity templates in " + levelFile;
+		return false;
+	}
+
+	std::string generatedFile = "MicroBenchmarkLevel" + std::to_string(count) + ".xml";
+	{
+		RandomStream random(RandomStream::DEFAULT_SEED, 0x4c564c);
+		std::ofstream generated(generatedFile);
+		generated << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<Scene>\n";
+		generated << text.substr(templatesStart, templatesEnd - templatesStart) << "</EntityTemplates>\n<Entities>\n";
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			generated << "<Entity Type=\"Obstacle\" Template=\"" << obstacleTemplate << "\"><Transform><Position X=\""
+			          << random.Range(-5000.0f, 5000.0f) << "\" Y=\"0\" Z=\"" << random.Range(-5000.0f, 5000.0f)
+			          << "\" /><Rotation X=\"0\" Y=\"" << random.Range(0.0f, 360.0f) << "\" Z=\"0\" /></Transform>"
+			          << "<Collision><HalfExtents X=\"20\" Y=\"20\" Z=\"20\" /></Collision></Entity>\n";
+		}
+		generated << "</Entities>\n</Scene>\n";
+		if (!generated)
+		{
+			error = "Can't write " + generatedFile;
+			return false;
+		}
+	}
+
+	std::error_code ignored;
+	std::string compiledFile = generatedFile + ".level";
+	std::filesystem::remove(compiledFile, ignored);
+
+	auto levelManager = std::move(gEntityManager);
+	auto load = [&]
+	{
+		gEntityManager = std::make_unique<EntityManager>();
+		gEntityManager->SetJobSystem(&jobSystem);
+		Timer timer;
+		timer.Start();
+		bool loaded = ParseLevel(*gEntityManager, &jobSystem, true).ParseFile(generatedFile);
+		float milliseconds = timer.GetTime() * 1000.0f;
+		gEntityManager.reset();
+		return loaded ? milliseconds : -1.0f;
+	};
+	std::string suffix = " (" + std::to_string(count) + ")";
+	float xmlMilliseconds = load(); // Compiles the level, only once as after that the compiled level is used
+	float compiledMilliseconds = 0;
+	for (int run = 0; run < RUNS && compiledMilliseconds >= 0; ++run)
+	{
+		float milliseconds = load();
+		if (run == 0 || milliseconds < compiledMilliseconds)  compiledMilliseconds = milliseconds;
+	}
+	gEntityManager = std::move(levelManager);
+
+	std::filesystem::remove(generatedFile, ignored);
+	std::filesystem::remove(compiledFile, ignored);
+	if (xmlMilliseconds < 0 || compiledMilliseconds < 0)
+	{
+		error = "Failed to load the generated level " + generatedFile;
+		return false;
+	}
+	results.push_back({ "ParseLevel XML" + suffix, count, xmlMilliseconds });
+	results.push_back({ "ParseLevel compiled" + suffix, count, compiledMilliseconds });
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Running
+-----------------------------------------------------------------------------------------*/
+
+// Run every benchmark, with the templates and obstacles of the given level
+bool RunMicroBenchmarks(JobSystem& jobSystem, const std::string& levelFile, std::vector<MicroBenchmarkResult>& results,
+                        std::string& error)
+{
+	MathBenchmarks(results);
+
+	gEntityManager = std::make_unique<EntityManager>();
+	gMessenger     = std::make_unique<Messenger>();
+	gEntityManager->SetJobSystem(&jobSystem);
+	bool success = false;
+	if (!ParseLevel(*gEntityManager, &jobSystem, true).ParseFile(levelFile))
+	{
+		error = "Error parsing level file (" + levelFile + ")";
+	}
+	else if (gEntityManager->View<Obstacle>().empty())
+	{
+		error = levelFile + " has no obstacles to take a template from";
+	}
+	else
+	{
+		Atom obstacleTemplate = gEntityManager->View<Obstacle>().front()->Template().GetType();
+		for (uint32_t count : ENTITY_COUNTS)  EntityBenchmarks(obstacleTemplate, count, results);
+
+		// Messages are sent to existing entities, as messages to other IDs are discarded
+		std::vector<EntityID> recipients;
+		for (Entity* entity : gEntityManager->GetAllEntities())  recipients.push_back(entity->GetID());
+		MessengerBenchmarks(recipients, results);
+
+		ObstacleBenchmarks(results);
+
+		success = true;
+		for (uint32_t count : ENTITY_COUNTS)
+		{
+			if (!LevelBenchmarks(jobSystem, levelFile, obstacleTemplate.str(), count, results, error))
+			{
+				success = false;
+				break;
+			}
+		}
+	}
+
+	gEntityManager.reset();
+	gMessenger.reset();
+	return success;
+}
+
+
+// The results as CSV, a header then a row for each benchmark
+std::string MicroBenchmarkCsv(const std::vector<MicroBenchmarkResult>& results)
+{
+	std::ostringstream csv;
+	csv << "Benchmark,Items,Milliseconds,NanosecondsPerItem\n";
+	for (const MicroBenchmarkResult& result : results)
+	{
+		csv << '"' << result.name << "\"," << result.items << ',' << result.milliseconds << ',' << result.NanosecondsPerItem() << '\n';
+	}
+	return csv.str();
+}
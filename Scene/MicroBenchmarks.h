@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// Timing of hot paths in isolation - maths, the entity manager, the messenger and level loading
+//--------------------------------------------------------------------------------------
+// Each benchmark repeats one operation over many items with fixed random inputs and reports the fastest of a few runs, so a
+// change to one of these paths can be measured without the noise of a whole frame. They are run from the command line with
+// no window or scene (see RunMicroBenchmarks in Main.cpp) and the results written as CSV to compare before and after:
+//
+//   Boats.exe -microbench [level.xml] [-out MicroBenchmarks.csv]
+//
+// The level gives the templates and obstacles used. The entity manager and messenger benchmarks make their own in the
+// globals, so must be run with no scene
+
+#ifndef _MICRO_BENCHMARKS_H_INCLUDED_
+#define _MICRO_BENCHMARKS_H_INCLUDED_
+
+#include "JobSystem.h"
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+struct MicroBenchmarkResult
+{
+	std::string name;
+	uint64_t    items        = 0; // Operations in one run
+	float       milliseconds = 0; // Time of the fastest run
+
+	double NanosecondsPerItem() const  { return items == 0 ? 0.0 : milliseconds * 1e6 / items; }
+};
+
+// Run every benchmark, with the templates and obstacles of the given level. Creates gEntityManager and gMessenger, and
+// leaves them empty afterwards, so must be called with no scene. Returns false with error set if the level can't be loaded
+bool RunMicroBenchmarks(JobSystem& jobSystem, const std::string& levelFile, std::vector<MicroBenchmarkResult>& results,
+                        std::string& error);
+
+// The results as CSV, a header then a row for each benchmark
+std::string MicroBenchmarkCsv(const std::vector<MicroBenchmarkResult>& results);
+
+
+#endif //_MICRO_BENCHMARKS_H_INCLUDED_
@@ -21,40 +21,37 @@ bool Missile::Update(float frameTime)
     mVelocity.y += -9.81f * frameTime;
 
     // Update position based on current velocity
-    Vector3 newPos = Transform().Position() + mVelocity * frameTime;
+    Vector3 oldPos = Transform().Position();
+    Vector3 newPos = oldPos + mVelocity * frameTime;
     Transform().Position() = newPos;
 
-    if (newPos.y < -15.0f)
-    {
-        return false;
-    }
-
     // Update missile's rotation to face its velocity direction
     if (mVelocity.Length() > 0.01f)
     {
         Transform().FaceDirection(Normalise(mVelocity));
     }
 
-    // Retrieve all Boat entities
-    std::vector<Boat*> allBoats = gEntityManager->GetAllBoatEntities();
-
-    // Check collision with each boat, excluding the launching boat
-    for (Boat* boatPtr : allBoats)
+    // Check collision with boats (excluding the launching boat) along the whole path moved this frame rather than just at the
+    // new position, so the missile can't pass through a boat between frames however fast it moves or however long the frame.
+    // The first boat along the path is hit. Done before the depth check so a boat hit on the way down still counts
+    Entity* hitBoat = gEntityManager->Spatial().QuerySweep(oldPos, newPos, 15.0f, SPATIAL_BOAT, [&](Entity* entity)
     {
-        if (boatPtr->GetID() == mLaunchingBoatID || boatPtr->GetState() == "Destroyed") continue;
+        return entity->GetID() != mLaunchingBoatID && !static_cast<Boat*>(entity)->IsDestroyed();
+    });
 
-        Vector3 toBoat = boatPtr->Transform().Position() - newPos;
-        float distSq = toBoat.x * toBoat.x + toBoat.y * toBoat.y + toBoat.z * toBoat.z;
+    if (hitBoat != nullptr)
+    {
+        MissileHitData hitData;
+        hitData.launchingBoatID = mLaunchingBoatID;
 
-        if (distSq <= (15.0f * 15.0f))
-        {
-            MissileHitData hitData;
-            hitData.launchingBoatID = mLaunchingBoatID;
+        gMessenger->DeliverMessage(GetID(), hitBoat->GetID(), MessageType::Hit, hitData);
 
-            gMessenger->DeliverMessage(GetID(), boatPtr->GetID(), MessageType::Hit, hitData);
+        return false;
+    }
 
-            return false;
-        }
+    if (newPos.y < -15.0f)
+    {
+        return false;
     }
 
     return true; // Keep missile alive
@@ -13,6 +13,7 @@
 #define _MISSILE_H_INCLUDED_
 
 #include "Entity.h"
+#include "EntityPool.h"
 #include "Vector3.h"
 #include "Matrix4x4.h"
 
@@ -21,7 +22,7 @@
 /*-----------------------------------------------------------------------------------------
     Missile Entity Class
 -----------------------------------------------------------------------------------------*/
-class Missile : public Entity // entity classes must inherit from Entity
+class Missile : public Entity, public PooledEntity<Missile>, public TaggedType<Missile, TypeTag::Missile> // entity classes must inherit from Entity
 {
     /*-----------------------------------------------------------------------------------------
        Constructor
@@ -41,6 +42,9 @@ public:
     // Update the missile (simple projectile motion and collision checks)
     virtual bool Update(float frameTime) override;
 
+    // Missiles only read boats and send messages, so can be updated on worker threads
+    virtual bool CanUpdateInParallel() override { return true; }
+
     // Setter for velocity
     void SetVelocity(const Vector3& newVelocity) {
         mVelocity = newVelocity;
@@ -56,6 +60,24 @@ public:
     -----------------------------------------------------------------------------------------*/
     float GetSpeed() { return mSpeed; }
 
+    /*-----------------------------------------------------------------------------------------
+       Checkpoints
+    -----------------------------------------------------------------------------------------*/
+    // Everything about the missile except its template, ID and matrix, as plain data for a checkpoint (see Checkpoint.h)
+    struct SavedState
+    {
+        float    speed;
+        Vector3  velocity;
+        EntityID launchingBoatID;
+    };
+    SavedState SaveState() { return { mSpeed, mVelocity, mLaunchingBoatID }; }
+    void RestoreState(const SavedState& saved)
+    {
+        mSpeed = saved.speed;
+        mVelocity = saved.velocity;
+        mLaunchingBoatID = saved.launchingBoatID;
+    }
+
     /*-----------------------------------------------------------------------------------------
        Private data
     -----------------------------------------------------------------------------------------*/
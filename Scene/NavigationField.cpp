@@ -0,0 +1,184 @@
+//--------------------------------------------------------------------------------------
+// Navigation grid and flow fields for steering boats around the obstacles
+//--------------------------------------------------------------------------------------
+
+#include "NavigationField.h"
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <functional>
+#include <cmath>
+
+
+// Offsets to the eight neighbours of a cell, the four straight neighbours first. Opposite neighbours are next to each other
+// in pairs, so the direction opposite to n is n ^ 1
+static const int NEIGHBOUR_X[8] = { 1, -1, 0,  0, 1, -1,  1, -1 };
+static const int NEIGHBOUR_Z[8] = { 0,  0, 1, -1, 1, -1, -1,  1 };
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Mark the blocked and near obstacle cells for the given obstacles and spread the navigation points over the rest
+void NavigationField::Build(const std::vector<Obstacle*>& obstacles)
+{
+	mBlocked.assign(GRID_SIZE * GRID_SIZE, 0);
+	mNearObstacle.assign(GRID_SIZE * GRID_SIZE, 0);
+	mAnyObstacles = !obstacles.empty();
+	for (auto& field : mFields)  field.goalCell = -1;
+
+	// Mark the range of cells from (minX, minZ) to (maxX, maxZ) in world space, clipped to the grid. Cells are included if
+	// they overlap the range at all, or if includeEdges is false only if their centre is in it
+	auto markCells = [](std::vector<uint8_t>& cells, float minX, float minZ, float maxX, float maxZ, bool includeEdges)
+	{
+		float firstOffset = includeEdges ? 1.0f : 0.5f;
+		float lastOffset  = includeEdges ? 0.0f : 0.5f;
+		int firstX = std::max(static_cast<int>(std::ceil ((minX + GRID_EXTENT) / CELL_SIZE - firstOffset)), 0);
+		int firstZ = std::max(static_cast<int>(std::ceil ((minZ + GRID_EXTENT) / CELL_SIZE - firstOffset)), 0);
+		int lastX  = std::min(static_cast<int>(std::floor((maxX + GRID_EXTENT) / CELL_SIZE - lastOffset)), GRID_SIZE - 1);
+		int lastZ  = std::min(static_cast<int>(std::floor((maxZ + GRID_EXTENT) / CELL_SIZE - lastOffset)), GRID_SIZE - 1);
+		for (int z = firstZ; z <= lastZ; ++z)
+		{
+			for (int x = firstX; x <= lastX; ++x)  cells[z * GRID_SIZE + x] = 1;
+		}
+	};
+
+	// Obstacles are tested against the cells in x and z only. The near distance is applied along each axis rather than as a
+	// radius, so the near cells cover a little more than they need to, never less
+	for (Obstacle* obstacle : obstacles)
+	{
+		const AABB& box = obstacle->GetAABB();
+		markCells(mBlocked, box.min.x - BOAT_CLEARANCE, box.min.z - BOAT_CLEARANCE,
+		                    box.max.x + BOAT_CLEARANCE, box.max.z + BOAT_CLEARANCE, false);
+		markCells(mNearObstacle, box.min.x - NEAR_OBSTACLE_DISTANCE, box.min.z - NEAR_OBSTACLE_DISTANCE,
+		                         box.max.x + NEAR_OBSTACLE_DISTANCE, box.max.z + NEAR_OBSTACLE_DISTANCE, true);
+	}
+
+	mPoints.Build(*this);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Queries
+-----------------------------------------------------------------------------------------*/
+
+// Returns the horizontal direction to travel from the given position to reach the goal by the shortest route around the obstacles
+Vector3 NavigationField::DirectionToGoal(const Vector3& position, const Vector3& goal)
+{
+	Vector3 toGoal = { goal.x - position.x, 0.0f, goal.z - position.z };
+	float distance = toGoal.Length();
+	if (distance < 0.0001f)  return { 0, 0, 0 };
+	Vector3 directToGoal = toGoal / distance;
+
+	// Head straight for the goal when it is in the same cell, or when the goal can't be reached from here (e.g. the boat has
+	// been pushed into a blocked cell). Also away from the obstacles when the route is as short as it would be with no obstacles,
+	// i.e. nothing is in the way. Near the obstacles the route is followed even then, as the straight line to the goal may clip
+	// a corner that the route goes round
+	int goalCell = ClampedCellAt(goal);
+	int cell     = ClampedCellAt(position);
+	if (cell == goalCell)  return directToGoal;
+
+	Field& field = FindField(goalCell);
+	if (field.direction[cell] == NO_DIRECTION)  return directToGoal;
+	if (!mNearObstacle[cell] && field.cost[cell] == OpenCost(cell, goalCell))  return directToGoal;
+
+	// Otherwise follow the route for a few cells and head for the centre of the last one
+	for (int step = 0; step < LOOKAHEAD_STEPS && cell != goalCell && field.direction[cell] != NO_DIRECTION; ++step)
+	{
+		int direction = field.direction[cell];
+		cell += NEIGHBOUR_Z[direction] * GRID_SIZE + NEIGHBOUR_X[direction];
+	}
+	if (cell == goalCell)  return directToGoal;
+
+	Vector3 toCell = CellCentre(cell, position.y) - position;
+	toCell.y = 0.0f;
+	float cellDistance = toCell.Length();
+	return cellDistance < 0.0001f ? directToGoal : toCell / cellDistance;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Returns the cell containing the given position, or the nearest edge cell if it is outside the grid
+int NavigationField::ClampedCellAt(const Vector3& position)
+{
+	int x = std::clamp(static_cast<int>(std::floor((position.x + GRID_EXTENT) / CELL_SIZE)), 0, GRID_SIZE - 1);
+	int z = std::clamp(static_cast<int>(std::floor((position.z + GRID_EXTENT) / CELL_SIZE)), 0, GRID_SIZE - 1);
+	return z * GRID_SIZE + x;
+}
+
+
+// Cost of the shortest route between two cells when nothing is in the way: diagonally until level with the goal in one
+// axis, then straight
+uint32_t NavigationField::OpenCost(int fromCell, int toCell)
+{
+	int dx = std::abs(fromCell % GRID_SIZE - toCell % GRID_SIZE);
+	int dz = std::abs(fromCell / GRID_SIZE - toCell / GRID_SIZE);
+	return STRAIGHT_COST * static_cast<uint32_t>(std::max(dx, dz) - std::min(dx, dz)) + DIAGONAL_COST * static_cast<uint32_t>(std::min(dx, dz));
+}
+
+
+// Return the field for the given goal cell, creating it in place of the field unused the longest if necessary
+NavigationField::Field& NavigationField::FindField(int goalCell)
+{
+	Field* oldest = &mFields[0];
+	for (auto& field : mFields)
+	{
+		if (field.goalCell == goalCell)
+		{
+			field.lastUsed = ++mUseCount;
+			return field;
+		}
+		if (field.goalCell < 0 || (oldest->goalCell >= 0 && field.lastUsed < oldest->lastUsed))  oldest = &field;
+	}
+
+	oldest->goalCell = goalCell;
+	oldest->lastUsed = ++mUseCount;
+	BuildField(*oldest);
+	return *oldest;
+}
+
+
+// Fill in the costs and directions of the given field, working outwards from the goal cell in order of cost (Dijkstra's
+// algorithm). Each cell's direction points back to the cell it was reached from. Boats can't move into blocked cells, or
+// diagonally past the corner of one. The goal cell itself may be blocked (e.g. a crate close to an obstacle)
+void NavigationField::BuildField(Field& field)
+{
+	field.cost.assign(GRID_SIZE * GRID_SIZE, UNREACHABLE);
+	field.direction.assign(GRID_SIZE * GRID_SIZE, NO_DIRECTION);
+
+	using CostAndCell = std::pair<uint32_t, int>;
+	std::priority_queue<CostAndCell, std::vector<CostAndCell>, std::greater<CostAndCell>> open;
+	field.cost[field.goalCell] = 0;
+	open.push({ 0, field.goalCell });
+	while (!open.empty())
+	{
+		auto [cost, cell] = open.top();
+		open.pop();
+		if (cost > field.cost[cell])  continue; // Already reached more cheaply
+
+		int x = cell % GRID_SIZE;
+		int z = cell / GRID_SIZE;
+		for (int n = 0; n < 8; ++n)
+		{
+			int nx = x + NEIGHBOUR_X[n];
+			int nz = z + NEIGHBOUR_Z[n];
+			if (nx < 0 || nz < 0 || nx >= GRID_SIZE || nz >= GRID_SIZE)  continue;
+
+			int neighbour = nz * GRID_SIZE + nx;
+			if (mBlocked[neighbour])  continue;
+			if (n >= 4 && (mBlocked[z * GRID_SIZE + nx] || mBlocked[nz * GRID_SIZE + x]))  continue; // Diagonal past a corner
+
+			uint32_t neighbourCost = cost + (n < 4 ? STRAIGHT_COST : DIAGONAL_COST);
+			if (neighbourCost >= field.cost[neighbour])  continue;
+
+			field.cost[neighbour] = neighbourCost;
+			field.direction[neighbour] = static_cast<uint8_t>(n ^ 1);
+			open.push({ neighbourCost, neighbour });
+		}
+	}
+}
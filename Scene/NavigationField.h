@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// Navigation grid and flow fields for steering boats around the obstacles
+//--------------------------------------------------------------------------------------
+// The sea is divided into a grid of square cells. When the obstacles are known, each cell is marked as blocked if it is
+// inside an obstacle (allowing some clearance for the boats), and as near an obstacle if it is within avoidance range of
+// one. These are then single lookups for any position.
+//
+// A flow field for a goal holds, for every cell, the direction to the neighbouring cell that is next on the shortest route
+// around the obstacles to the goal. It is made with one pass over the grid (Dijkstra's algorithm from the goal outwards) the
+// first time a goal is used, and kept for later use. Boats heading to the same place, e.g. a reload station, share a field,
+// and a boat following a field does a constant amount of work each frame however far away the goal is or however many
+// obstacles are in the way.
+//
+// The open water is also filled with an even spread of points when the grid is built, for boats to choose patrol and evade
+// points from, see NavigationPoints.h.
+//
+// The EntityManager owns the field and rebuilds the grid along with the obstacle tree, see EntityManager::Navigation:
+//     Vector3 heading = gEntityManager->Navigation().DirectionToGoal(boatPos, patrolPoint);
+//
+// The blocked / near obstacle and point queries are read-only and safe to use from worker threads. DirectionToGoal creates and
+// replaces fields so must only be used from the thread running the main entity updates
+
+#ifndef _NAVIGATION_FIELD_H_INCLUDED_
+#define _NAVIGATION_FIELD_H_INCLUDED_
+
+#include "Obstacle.h"
+#include "NavigationPoints.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class NavigationField
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Starts with an empty grid, as if built with no obstacles
+	NavigationField()  { Build({}); }
+
+	// Mark the blocked and near obstacle cells for the given obstacles and spread the navigation points over the rest,
+	// replacing any previous grid and points and discarding any fields
+	void Build(const std::vector<Obstacle*>& obstacles);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Queries
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Distance from an obstacle's box within which a position is near the obstacle, see IsNearObstacle. The same distance
+	// as the boats use for obstacle avoidance
+	static constexpr float NEAR_OBSTACLE_DISTANCE = 50.0f;
+
+	// Returns true if the given position is in a blocked cell, i.e. inside or very close to an obstacle. Positions outside
+	// the grid are never blocked
+	bool IsBlocked(const Vector3& position) const
+	{
+		int cell = CellAt(position);
+		return cell >= 0 && mBlocked[cell];
+	}
+
+	// Returns false if the given position is certainly further than NEAR_OBSTACLE_DISTANCE from every obstacle's box, in which
+	// case there is no need to look for obstacles to avoid. May return true for positions a little further away than that
+	bool IsNearObstacle(const Vector3& position) const
+	{
+		int cell = CellAt(position);
+		return cell < 0 ? mAnyObstacles : mNearObstacle[cell] != 0;
+	}
+
+	// Returns the horizontal direction (unit length, y = 0) to travel from the given position to reach the goal by the shortest
+	// route around the obstacles. Where nothing is in the way this is directly towards the goal. Returns a zero vector if the
+	// position is at the goal. Creates the flow field for the goal if there isn't one already
+	Vector3 DirectionToGoal(const Vector3& position, const Vector3& goal);
+
+	// Points spread over the open water in the boats' patrol area, see NavigationPoints.h
+	const NavigationPoints& Points() const  { return mPoints; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The grid covers the square from -GRID_EXTENT to +GRID_EXTENT in x and z, which includes the whole of the boats' patrol
+	// area with a margin. Positions outside the grid use the nearest edge cell for flow fields
+	static constexpr float GRID_EXTENT = 640.0f;
+	static constexpr float CELL_SIZE   = 20.0f;
+	static constexpr int   GRID_SIZE   = static_cast<int>(2 * GRID_EXTENT / CELL_SIZE); // Cells along each side
+
+	// Obstacle boxes are expanded by this much when marking blocked cells, so routes keep the boats clear of the obstacles
+	static constexpr float BOAT_CLEARANCE = 15.0f;
+
+	// Number of flow fields kept. When a new one is needed the one that has gone unused the longest is replaced
+	static constexpr int MAX_FIELDS = 16;
+
+	// Boats aim for the centre of the cell this many steps ahead on the route, which smooths out the grid's 45 degree turns
+	static constexpr int LOOKAHEAD_STEPS = 2;
+
+	// Costs of moving to a neighbouring cell straight and diagonally, roughly in the ratio 1 : sqrt(2)
+	static constexpr uint32_t STRAIGHT_COST = 10;
+	static constexpr uint32_t DIAGONAL_COST = 14;
+	static constexpr uint32_t UNREACHABLE   = 0xffffffff;
+	static constexpr uint8_t  NO_DIRECTION  = 0xff; // Direction of the goal cell and of cells that can't reach the goal
+
+	// Returns the cell containing the given position, or -1 if it is outside the grid
+	static int CellAt(const Vector3& position)
+	{
+		int x = static_cast<int>((position.x + GRID_EXTENT) / CELL_SIZE);
+		int z = static_cast<int>((position.z + GRID_EXTENT) / CELL_SIZE);
+		if (position.x < -GRID_EXTENT || position.z < -GRID_EXTENT || x >= GRID_SIZE || z >= GRID_SIZE)  return -1;
+		return z * GRID_SIZE + x;
+	}
+
+	// Returns the cell containing the given position, or the nearest edge cell if it is outside the grid
+	static int ClampedCellAt(const Vector3& position);
+
+	// World position of the centre of the given cell, at the given height
+	static Vector3 CellCentre(int cell, float y)
+	{
+		return { (cell % GRID_SIZE + 0.5f) * CELL_SIZE - GRID_EXTENT, y, (cell / GRID_SIZE + 0.5f) * CELL_SIZE - GRID_EXTENT };
+	}
+
+	// Cost of the shortest route between two cells when nothing is in the way
+	static uint32_t OpenCost(int fromCell, int toCell);
+
+	// Flow field towards a goal cell. For each cell, cost is the cost of the shortest route to the goal and direction is the
+	// index of the neighbour to move to next (see NEIGHBOUR_X/Z in the cpp)
+	struct Field
+	{
+		int      goalCell = -1;
+		uint32_t lastUsed = 0;
+		std::vector<uint32_t> cost;
+		std::vector<uint8_t>  direction;
+	};
+
+	// Return the field for the given goal cell, creating it if necessary
+	Field& FindField(int goalCell);
+
+	// Fill in the costs and directions of the given field for its goal cell
+	void BuildField(Field& field);
+
+	std::vector<uint8_t> mBlocked;      // For each cell, non-zero if it is blocked
+	std::vector<uint8_t> mNearObstacle; // For each cell, non-zero if any part of it might be near an obstacle
+	bool mAnyObstacles = false;
+
+	NavigationPoints mPoints;
+
+	Field    mFields[MAX_FIELDS];
+	uint32_t mUseCount = 0; // Incremented whenever a field is used, for finding the one unused the longest
+};
+
+
+#endif //_NAVIGATION_FIELD_H_INCLUDED_
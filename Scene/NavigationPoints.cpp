@@ -0,0 +1,169 @@
+//--------------------------------------------------------------------------------------
+// Navigation points - an even spread of points over the open water for boats to head for
+//--------------------------------------------------------------------------------------
+
+#include "NavigationPoints.h"
+#include "NavigationField.h"
+
+#include <algorithm>
+#include <numbers>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Spread the points over the cells of the given field that aren't blocked, replacing any previous points
+void NavigationPoints::Build(const NavigationField& field)
+{
+	// Bridson's method: keep a list of active points, and try a few random positions in the ring from SPACING to twice that
+	// around one of them. A position is kept if it is open water and no other point is within SPACING, found with a fine grid
+	// of cells small enough to hold a single point each. An active point is dropped once all its tries have failed
+	constexpr int   TRIES     = 20;
+	constexpr float CELL_SIZE = SPACING / std::numbers::sqrt2_v<float>;
+	const int cellsWide = static_cast<int>(std::ceil((AREA_MAX.x - AREA_MIN.x) / CELL_SIZE));
+	const int cellsDeep = static_cast<int>(std::ceil((AREA_MAX.z - AREA_MIN.z) / CELL_SIZE));
+	auto cellOf = [&](const Vector3& p)
+	{
+		int x = std::min(static_cast<int>((p.x - AREA_MIN.x) / CELL_SIZE), cellsWide - 1);
+		int z = std::min(static_cast<int>((p.z - AREA_MIN.z) / CELL_SIZE), cellsDeep - 1);
+		return z * cellsWide + x;
+	};
+
+	std::vector<int32_t> cells(cellsWide * cellsDeep, -1);
+	std::vector<Vector3> points;
+	std::vector<int32_t> active;
+	auto isFree = [&](const Vector3& p)
+	{
+		if (p.x < AREA_MIN.x || p.x > AREA_MAX.x || p.z < AREA_MIN.z || p.z > AREA_MAX.z || field.IsBlocked(p))  return false;
+		int cell  = cellOf(p);
+		int cellX = cell % cellsWide;
+		int cellZ = cell / cellsWide;
+		for (int z = std::max(cellZ - 2, 0); z <= std::min(cellZ + 2, cellsDeep - 1); ++z)
+		{
+			for (int x = std::max(cellX - 2, 0); x <= std::min(cellX + 2, cellsWide - 1); ++x)
+			{
+				int32_t other = cells[z * cellsWide + x];
+				if (other >= 0 && Distance(points[other], p) < SPACING)  return false;
+			}
+		}
+		return true;
+	};
+	auto add = [&](const Vector3& p)
+	{
+		cells[cellOf(p)] = static_cast<int32_t>(points.size());
+		active.push_back(static_cast<int32_t>(points.size()));
+		points.push_back(p);
+	};
+
+	// Seeds are tried on a coarse lattice so areas cut off from each other by obstacles all get points
+	RandomStream random(RandomStream::DEFAULT_SEED, 0x4e4156); // Fixed, so the points only depend on the level
+	for (float z = AREA_MIN.z + SPACING; z < AREA_MAX.z; z += 4 * SPACING)
+	{
+		for (float x = AREA_MIN.x + SPACING; x < AREA_MAX.x; x += 4 * SPACING)
+		{
+			Vector3 seed = { x, AREA_MIN.y, z };
+			if (isFree(seed))  add(seed);
+
+			while (!active.empty())
+			{
+				size_t pick = random.Range(0, static_cast<int>(active.size()) - 1);
+				Vector3 from = points[active[pick]];
+				bool added = false;
+				for (int i = 0; i < TRIES && !added; ++i)
+				{
+					float angle    = random.Range(0.0f, 2 * std::numbers::pi_v<float>);
+					float distance = random.Range(SPACING, 2 * SPACING);
+					Vector3 p = { from.x + distance * std::cos(angle), AREA_MIN.y, from.z + distance * std::sin(angle) };
+					if (isFree(p))
+					{
+						add(p);
+						added = true;
+					}
+				}
+				if (!added)
+				{
+					active[pick] = active.back();
+					active.pop_back();
+				}
+			}
+		}
+	}
+
+	// Sort the points into their buckets
+	int numBuckets = BUCKETS_WIDE * BUCKETS_DEEP;
+	mBucketStart.assign(numBuckets + 1, 0);
+	for (const Vector3& p : points)  ++mBucketStart[BucketZ(p.z) * BUCKETS_WIDE + BucketX(p.x) + 1];
+	for (int b = 0; b < numBuckets; ++b)  mBucketStart[b + 1] += mBucketStart[b];
+	mPoints.resize(points.size());
+	std::vector<uint32_t> next(mBucketStart.begin(), mBucketStart.end() - 1);
+	for (const Vector3& p : points)  mPoints[next[BucketZ(p.z) * BUCKETS_WIDE + BucketX(p.x)]++] = p;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Queries
+-----------------------------------------------------------------------------------------*/
+
+// Pick one of all the points at random. Returns false if there are none
+bool NavigationPoints::RandomPoint(RandomStream& random, Vector3& point) const
+{
+	if (mPoints.empty())  return false;
+	point = mPoints[random.Range(0, static_cast<int>(mPoints.size()) - 1)];
+	return true;
+}
+
+
+// Pick a point at random from those in the ring around the centre that are far enough from the given direction
+bool NavigationPoints::RandomPointInRing(const Vector3& centre, float minDistance, float maxDistance, const Vector3& avoidDirection,
+                                         float minAngle, RandomStream& random, Vector3& point) const
+{
+	if (mPoints.empty())  return false;
+
+	// Compared without square roots: the offset o is at least minAngle from the direction d if d.o <= |o| cos(minAngle)
+	float minSquared = minDistance * minDistance;
+	float maxSquared = maxDistance * maxDistance;
+	float cosAngle   = std::cos(minAngle);
+	bool  anyAngle   = minAngle <= 0.0f;
+
+	// Each point that fits replaces the one chosen so far with a chance of 1 in the number found, so each is equally likely
+	int found = 0;
+	int firstX = BucketX(centre.x - maxDistance), lastX = BucketX(centre.x + maxDistance);
+	int firstZ = BucketZ(centre.z - maxDistance), lastZ = BucketZ(centre.z + maxDistance);
+	for (int z = firstZ; z <= lastZ; ++z)
+	{
+		for (int x = firstX; x <= lastX; ++x)
+		{
+			int bucket = z * BUCKETS_WIDE + x;
+			for (uint32_t i = mBucketStart[bucket]; i < mBucketStart[bucket + 1]; ++i)
+			{
+				float offsetX = mPoints[i].x - centre.x;
+				float offsetZ = mPoints[i].z - centre.z;
+				float squared = offsetX * offsetX + offsetZ * offsetZ;
+				if (squared < minSquared || squared > maxSquared)  continue;
+				if (!anyAngle && offsetX * avoidDirection.x + offsetZ * avoidDirection.z > std::sqrt(squared) * cosAngle)  continue;
+
+				++found;
+				if (random.Range(1, found) == 1)  point = { mPoints[i].x, centre.y, mPoints[i].z };
+			}
+		}
+	}
+	return found > 0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Bucket containing the given coordinate, clamped to the buckets
+int NavigationPoints::BucketX(float x)
+{
+	return std::clamp(static_cast<int>(std::floor((x - AREA_MIN.x) / BUCKET_SIZE)), 0, BUCKETS_WIDE - 1);
+}
+
+int NavigationPoints::BucketZ(float z)
+{
+	return std::clamp(static_cast<int>(std::floor((z - AREA_MIN.z) / BUCKET_SIZE)), 0, BUCKETS_DEEP - 1);
+}
@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// Navigation points - an even spread of points over the open water for boats to head for
+//--------------------------------------------------------------------------------------
+// When the navigation grid is built, the boats' patrol area is filled with points at least SPACING apart that aren't in a
+// blocked cell (Poisson disc sampling, Bridson's method). Every point is open water that a boat can reach, so choosing a
+// patrol or evade point becomes picking one of these rather than trying random positions until one isn't in an obstacle.
+//
+// The points are bucketed by a coarse grid so the points in a ring around a position are found by visiting a few buckets.
+// Among the points that fit a query one is picked at random in a single pass (reservoir sampling) with the caller's stream,
+// so boats still choose differently from each other and every query does a fixed amount of work.
+//
+// The points are laid out with a fixed seed, so a level always has the same points. Built by the NavigationField (see
+// NavigationField::Points), the queries are read-only and safe to use from worker threads:
+//     Vector3 patrolPoint;
+//     gEntityManager->Navigation().Points().RandomPoint(mRandom, patrolPoint);
+
+#ifndef _NAVIGATION_POINTS_H_INCLUDED_
+#define _NAVIGATION_POINTS_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Random.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class NavigationField;
+
+class NavigationPoints
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Area covered by the points, at water level. Boats patrol within it
+	static constexpr Vector3 AREA_MIN = { -500.0f, -1.5f, -500.0f };
+	static constexpr Vector3 AREA_MAX = {  500.0f, -1.5f,  500.0f };
+
+	// Least distance between points, the same as the navigation grid's cell size
+	static constexpr float SPACING = 20.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Spread the points over the cells of the given field that aren't blocked, replacing any previous points
+	void Build(const NavigationField& field);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Queries
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Pick one of all the points at random. Returns false if there are none (the whole area is blocked)
+	bool RandomPoint(RandomStream& random, Vector3& point) const;
+
+	// Pick a point at random from those between minDistance and maxDistance from the centre whose direction from the centre
+	// is at least minAngle (radians) away from the given direction (horizontal, unit length). Pass a minAngle of 0 to accept
+	// any direction. The point is returned at the centre's height. Returns false if no point fits
+	bool RandomPointInRing(const Vector3& centre, float minDistance, float maxDistance, const Vector3& avoidDirection,
+	                       float minAngle, RandomStream& random, Vector3& point) const;
+
+	size_t NumPoints() const  { return mPoints.size(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Buckets are a few times the spacing, so the rings used for evading cover a handful of them
+	static constexpr float BUCKET_SIZE  = 80.0f;
+	static constexpr int   BUCKETS_WIDE = static_cast<int>((AREA_MAX.x - AREA_MIN.x) / BUCKET_SIZE) + 1;
+	static constexpr int   BUCKETS_DEEP = static_cast<int>((AREA_MAX.z - AREA_MIN.z) / BUCKET_SIZE) + 1;
+
+	static int BucketX(float x);
+	static int BucketZ(float z);
+
+	// Points sorted by bucket. The points of bucket b are mPoints[mBucketStart[b]] up to mPoints[mBucketStart[b + 1]]
+	std::vector<Vector3>  mPoints;
+	std::vector<uint32_t> mBucketStart;
+};
+
+
+#endif //_NAVIGATION_POINTS_H_INCLUDED_
@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Navigation system - moves every boat along its heading at its speed, once all the boats have been updated
+//--------------------------------------------------------------------------------------
+
+#include "NavigationSystem.h"
+#include "BoatComponents.h"
+#include "SpatialGrid.h"
+#include "Boat.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Move each boat marked as moving forwards by its speed for the frame time
+void NavigationSystem::Update(BoatComponents& boats, SpatialGrid& grid, float frameTime)
+{
+	const auto& navigation = boats.NavigationArray();
+	const auto& owners     = boats.Boats();
+	for (size_t boat = 0; boat < navigation.size(); ++boat)
+	{
+		if (!navigation[boat].moving)  continue;
+		owners[boat]->Transform().MoveLocalZ(navigation[boat].speed * frameTime);
+		grid.Move(owners[boat]);
+	}
+}
@@ -0,0 +1,29 @@
+//--------------------------------------------------------------------------------------
+// Navigation system - moves every boat along its heading at its speed, once all the boats have been updated
+//--------------------------------------------------------------------------------------
+// A boat's update decides its speed and turns it to the way it wants to go, then marks whether it moves this update (see
+// BoatNavigation in BoatComponents.h). After every entity has been updated the EntityManager has this system move all the
+// moving boats together, reading only the navigation array and the boats' root matrices. As every boat moves at the same
+// point, a boat's update sees every other boat where it was at the end of the last update, whatever order the boats are
+// updated in (as the steering, sensors and ballistics already do).
+
+#ifndef _NAVIGATION_SYSTEM_H_INCLUDED_
+#define _NAVIGATION_SYSTEM_H_INCLUDED_
+
+
+class BoatComponents;
+class SpatialGrid;
+
+class NavigationSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Move each boat marked as moving forwards by its speed for the frame time, and update its place in the spatial grid.
+	// Called by the EntityManager in UpdateAll once all entities have been updated
+	void Update(BoatComponents& boats, SpatialGrid& grid, float frameTime);
+};
+
+
+#endif //_NAVIGATION_SYSTEM_H_INCLUDED_
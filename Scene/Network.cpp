@@ -0,0 +1,787 @@
+//--------------------------------------------------------------------------------------
+// Networked play - an authoritative server sending snapshots of the game, and clients showing them and giving orders
+//--------------------------------------------------------------------------------------
+
+#include "Network.h"
+
+#include "Replay.h"
+#include "EntityManager.h"
+#include "SceneGlobals.h"
+#include "Boat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+// Change the version if the layout of any packet or of the snapshots changes
+static const char    NET_MAGIC[2] = { 'B', 'N' };
+static const uint8_t NET_VERSION  = 2;
+
+// Largest UDP datagram over IPv4
+static constexpr size_t MAX_DATAGRAM = 65507;
+
+enum class PacketType : uint8_t
+{
+	Connect,
+	Accept,
+	Snapshot,
+	Input,
+	Disconnect,
+};
+
+// Start of every packet, see the layout in the header file
+struct PacketHeader
+{
+	char       magic[2];
+	uint8_t    version;
+	PacketType type;
+};
+
+struct AcceptPacket
+{
+	PacketHeader header;
+	float        snapshotTime;
+};
+
+struct SnapshotHeader
+{
+	PacketHeader header;
+	uint32_t     tick;
+	uint32_t     baselineTick;
+	uint32_t     lastCommand;
+};
+
+struct InputHeader
+{
+	PacketHeader header;
+	uint32_t     newestTick;
+	uint32_t     numCommands;
+	float        viewPoint[3];
+	float        viewRadius;
+};
+
+static_assert(sizeof(PacketHeader) == 4 && sizeof(AcceptPacket) == 8 && sizeof(SnapshotHeader) == 16 &&
+              sizeof(InputHeader) == 28 && sizeof(NetCommand) == 24);
+
+
+static PacketHeader MakeHeader(PacketType type)
+{
+	return { { NET_MAGIC[0], NET_MAGIC[1] }, NET_VERSION, type };
+}
+
+// Type of a packet received, returns false if it isn't one of this game's packets of this version
+static bool ReadPacketType(const std::byte* data, size_t size, PacketType& type)
+{
+	PacketHeader header;
+	if (size < sizeof(header))  return false;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, NET_MAGIC, sizeof(NET_MAGIC)) != 0 || header.version != NET_VERSION)  return false;
+	type = header.type;
+	return true;
+}
+
+// True for the orders a client may give, see NetCommand
+static bool IsCommand(MessageType type)
+{
+	return type == MessageType::Start || type == MessageType::Stop || type == MessageType::Evade || type == MessageType::TargetPoint;
+}
+
+// How much a client cares about an entity of each kind being up to date, before its distance is taken into account. Shields
+// go with their boats, crates and mines barely move
+static float Relevance(ReplayKind kind)
+{
+	switch (kind)
+	{
+		case ReplayKind::Boat:    return 4.0f;
+		case ReplayKind::Missile: return 3.0f;
+		case ReplayKind::Shield:  return 4.0f;
+		default:                  return 1.0f;
+	}
+}
+
+// A new entity costs about this many moved ones, for its details and full pose
+static constexpr float NEW_ENTITY_UPDATES = 4.0f;
+
+// Interest cells, see the top of the header file
+static int InterestCell(float worldCoord)  { return static_cast<int>(std::floor(worldCoord / NetServer::INTEREST_CELL_SIZE)); }
+static uint64_t CellKey(int x, int z)      { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z); }
+
+static const ReplaySnapshotEntity* FindEntity(const ReplaySnapshot& snapshot, EntityID id)
+{
+	auto found = std::lower_bound(snapshot.entities.begin(), snapshot.entities.end(), id,
+	                              [](const ReplaySnapshotEntity& entity, EntityID id) { return entity.id < id; });
+	return (found != snapshot.entities.end() && found->id == id) ? &*found : nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Server
+-----------------------------------------------------------------------------------------*/
+
+// Open the port for clients to connect to. Returns false if it can't be opened
+bool NetServer::Start(uint16_t port, std::string& error)
+{
+	if (!mSocket.Open(port))
+	{
+		error = mSocket.GetLastError();
+		return false;
+	}
+	mClients.clear();
+	for (ReplaySnapshot& snapshot : mHistory)  snapshot.tick = NO_TICK;
+	mTick       = NO_TICK;
+	mTimeToTick = 0;
+	mRateStart  = std::chrono::steady_clock::now();
+	mBytesSent = mBytesSentBefore = 0;
+	mBytesPerSecond = 0;
+	return true;
+}
+
+
+// Tell the clients the server is stopping and close the port
+void NetServer::Stop()
+{
+	PacketHeader header = MakeHeader(PacketType::Disconnect);
+	for (const Client& client : mClients)  mSocket.Send(client.address, &header, sizeof(header));
+	mClients.clear();
+	mSocket.Close();
+}
+
+
+// Take in the packets clients have sent, delivering their commands to the boats
+void NetServer::Receive()
+{
+	if (!IsRunning())  return;
+
+	auto now = std::chrono::steady_clock::now();
+	mPacket.resize(MAX_DATAGRAM);
+	UdpSocket::Address from;
+	size_t size;
+	while ((size = mSocket.Receive(from, mPacket.data(), mPacket.size())) > 0)
+	{
+		PacketType type;
+		if (!ReadPacketType(mPacket.data(), size, type))  continue;
+		Client* client = FindClient(from);
+
+		if (type == PacketType::Connect)
+		{
+			// Accepted again if it is already connected, the first Accept may have been lost
+			if (client == nullptr && mClients.size() < MAX_CLIENTS)
+			{
+				mClients.push_back({ from });
+				client = &mClients.back();
+				client->sent.resize(HISTORY);
+				for (ReplaySnapshot& sent : client->sent)  sent.tick = NO_TICK;
+			}
+			if (client == nullptr)  continue;
+			client->lastHeard = now;
+			AcceptPacket accept = { MakeHeader(PacketType::Accept), SNAPSHOT_TIME };
+			mSocket.Send(from, &accept, sizeof(accept));
+		}
+		else if (type == PacketType::Input && client != nullptr && size >= sizeof(InputHeader))
+		{
+			InputHeader input;
+			std::memcpy(&input, mPacket.data(), sizeof(input));
+			client->lastHeard = now;
+			if (input.newestTick != NO_TICK && (client->ackedTick == NO_TICK || static_cast<int32_t>(input.newestTick - client->ackedTick) > 0))
+			{
+				client->ackedTick = input.newestTick;
+			}
+			Vector3 viewPoint = { input.viewPoint[0], input.viewPoint[1], input.viewPoint[2] };
+			if (std::isfinite(viewPoint.x) && std::isfinite(viewPoint.z) && std::isfinite(input.viewRadius))
+			{
+				client->viewPoint  = viewPoint;
+				client->viewRadius = std::clamp(input.viewRadius, 0.0f, MAX_VIEW_RADIUS);
+			}
+
+			// Every command not yet acknowledged is sent each time, so only the next one in order is applied from each
+			size_t numCommands = std::min(static_cast<size_t>(input.numCommands), (size - sizeof(input)) / sizeof(NetCommand));
+			for (size_t i = 0; i < numCommands; ++i)
+			{
+				NetCommand command;
+				std::memcpy(&command, mPacket.data() + sizeof(input) + i * sizeof(NetCommand), sizeof(command));
+				if (command.number != client->lastCommand + 1)  continue;
+				ApplyCommand(command);
+				client->lastCommand = command.number;
+			}
+		}
+		else if (type == PacketType::Disconnect && client != nullptr)
+		{
+			std::erase_if(mClients, [&](const Client& c) { return c.address == from; });
+		}
+	}
+
+	std::erase_if(mClients, [&](const Client& client)
+	{
+		return std::chrono::duration<float>(now - client.lastHeard).count() > CLIENT_TIMEOUT;
+	});
+}
+
+
+// Send a snapshot to every client if a snapshot time has passed. Call after each simulation step with the step's length
+void NetServer::Update(EntityManager& entities, float stepTime)
+{
+	if (!IsRunning())  return;
+
+	// Snapshots are timed as replay ticks are, see ReplayRecorder::Update
+	mTimeToTick -= stepTime;
+	if (mTimeToTick > stepTime * 0.5f)  return;
+	mTimeToTick = std::max(mTimeToTick + SNAPSHOT_TIME, 0.0f);
+
+	TakeSnapshot(entities);
+	mSnapshotBytes = 0;
+	mSentEntities  = 0;
+	for (Client& client : mClients)  SendSnapshot(client);
+
+	auto now = std::chrono::steady_clock::now();
+	float rateTime = std::chrono::duration<float>(now - mRateStart).count();
+	if (rateTime >= 1.0f)
+	{
+		mBytesPerSecond  = (mBytesSent - mBytesSentBefore) / rateTime;
+		mBytesSentBefore = mBytesSent;
+		mRateStart       = now;
+	}
+}
+
+
+NetServer::Stats NetServer::GetStats()
+{
+	Stats stats = {};
+	stats.clients        = static_cast<uint32_t>(mClients.size());
+	stats.entities       = mTick != NO_TICK ? static_cast<uint32_t>(mHistory[mTick % HISTORY].entities.size()) : 0;
+	stats.sentEntities   = mSentEntities;
+	stats.snapshotBytes  = mSnapshotBytes;
+	stats.bytesPerSecond = mBytesPerSecond;
+	return stats;
+}
+
+
+// Take a snapshot of the entities a replay records, into the next history slot, and sort them into the interest cells
+void NetServer::TakeSnapshot(EntityManager& entities)
+{
+	const ReplaySnapshot* previous = mTick != NO_TICK ? &mHistory[mTick % HISTORY] : nullptr;
+	++mTick;
+	ReplaySnapshot& snapshot = mHistory[mTick % HISTORY];
+	snapshot.tick = mTick;
+
+	mSamples.clear();
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		ReplayKind kind;
+		if (ReplayKindOf(entity, kind))  mSamples.push_back({ entity->GetID(), static_cast<uint32_t>(kind), ReplayPoseOf(entity->Transform()) });
+	}
+	std::sort(mSamples.begin(), mSamples.end(), [](const ReplaySample& a, const ReplaySample& b) { return a.id < b.id; });
+
+	// The details of entities in the last snapshot are copied from it, only new ones are described
+	snapshot.entities.resize(mSamples.size());
+	size_t p = 0;
+	for (size_t i = 0; i < mSamples.size(); ++i)
+	{
+		const ReplaySample& sample = mSamples[i];
+		ReplaySnapshotEntity& sent = snapshot.entities[i];
+		sent.id   = sample.id;
+		sent.pose = sample.pose;
+		while (previous != nullptr && p < previous->entities.size() && previous->entities[p].id < sample.id)  ++p;
+		if (previous != nullptr && p < previous->entities.size() && previous->entities[p].id == sample.id)
+		{
+			sent.info = previous->entities[p].info;
+		}
+		else
+		{
+			sent.info = ReplayEntityInfo();
+			DescribeReplayEntity(entities.GetEntity(sample.id), sent.info);
+		}
+		sent.info.kind = sample.kind;
+	}
+
+	// Positions are taken from the quantised poses, so they are where the clients will see the entities
+	for (auto& [key, cell] : mCells)  cell.clear();
+	mPositions.resize(snapshot.entities.size() * 2);
+	for (size_t i = 0; i < snapshot.entities.size(); ++i)
+	{
+		Vector3 position = ReplayPoseMatrix(snapshot.entities[i].pose, snapshot.entities[i].info.scale).Position();
+		mPositions[i * 2]     = position.x;
+		mPositions[i * 2 + 1] = position.z;
+		mCells[CellKey(InterestCell(position.x), InterestCell(position.z))].push_back(static_cast<uint32_t>(i));
+	}
+}
+
+
+// Find what a client could be sent of the latest snapshot, giving the snapshot of the client's it is coded against. The
+// candidates are left in mCandidates, most important first, and the unchanged entities in mUnchanged
+void NetServer::SelectEntities(Client& client, const ReplaySnapshot*& baseline)
+{
+	const ReplaySnapshot& snapshot = mHistory[mTick % HISTORY];
+	baseline = nullptr;
+	if (client.ackedTick != NO_TICK && mTick - client.ackedTick < HISTORY && client.sent[client.ackedTick % HISTORY].tick == client.ackedTick)
+	{
+		baseline = &client.sent[client.ackedTick % HISTORY];
+	}
+
+	// The entities in the cells under the client's view. Those it has already that haven't changed are sent as they cost
+	// nothing, the others are candidates and build up priority, faster the nearer and more relevant they are
+	mCandidates.clear();
+	mUnchanged.clear();
+	const Vector3& view = client.viewPoint;
+	const float keepRadius = client.viewRadius * INTEREST_KEEP;
+	int minX = InterestCell(view.x - keepRadius), maxX = InterestCell(view.x + keepRadius);
+	int minZ = InterestCell(view.z - keepRadius), maxZ = InterestCell(view.z + keepRadius);
+	for (int z = minZ; z <= maxZ && client.viewRadius > 0; ++z)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			auto cell = mCells.find(CellKey(x, z));
+			if (cell == mCells.end())  continue;
+
+			for (uint32_t index : cell->second)
+			{
+				const ReplaySnapshotEntity& entity = snapshot.entities[index];
+				float dx = mPositions[index * 2] - view.x;
+				float dz = mPositions[index * 2 + 1] - view.z;
+				float distance = std::sqrt(dx * dx + dz * dz);
+				if (distance > keepRadius)  continue;
+
+				const ReplaySnapshotEntity* had = baseline != nullptr ? FindEntity(*baseline, entity.id) : nullptr;
+				if (had == nullptr && distance > client.viewRadius)  continue;
+				if (had != nullptr && std::memcmp(&had->pose, &entity.pose, sizeof(ReplayPose)) == 0)
+				{
+					mUnchanged.push_back(index);
+					continue;
+				}
+
+				// A new shield waits for the client to have its boat, to be attached to
+				ReplayKind kind = static_cast<ReplayKind>(entity.info.kind);
+				if (had == nullptr && kind == ReplayKind::Shield && (baseline == nullptr || FindEntity(*baseline, entity.info.extra) == nullptr))  continue;
+
+				Client::Priority& priority = client.priorities[entity.id];
+				priority.value += Relevance(kind) * client.viewRadius / (distance + 0.1f * client.viewRadius);
+				priority.tick   = mTick;
+				mCandidates.push_back({ index, had, &priority });
+			}
+		}
+	}
+	std::sort(mCandidates.begin(), mCandidates.end(), [](const Candidate& a, const Candidate& b)
+	{
+		return a.priority->value > b.priority->value;
+	});
+	std::erase_if(client.priorities, [&](const auto& priority) { return priority.second.tick != mTick; });
+}
+
+
+// Put what a client is sent of the latest snapshot in its history: the unchanged entities and the most important candidates
+// that fit in the budget (in updates). One left out keeps the pose the client has, or if new to it isn't there yet. Nothing
+// is reset here, so a smaller budget can be tried if the packet is too large. Returns the cost of the changes chosen
+float NetServer::ChooseEntities(Client& client, float budget)
+{
+	const ReplaySnapshot& snapshot = mHistory[mTick % HISTORY];
+	ReplaySnapshot& sent = client.sent[mTick % HISTORY];
+	sent.tick = mTick;
+	sent.entities.clear();
+	for (uint32_t index : mUnchanged)  sent.entities.push_back(snapshot.entities[index]);
+
+	float updates = 0;
+	for (Candidate& candidate : mCandidates)
+	{
+		float cost = candidate.had != nullptr ? 1.0f : NEW_ENTITY_UPDATES;
+		candidate.chosen = updates + cost <= budget;
+		if (candidate.chosen)
+		{
+			updates += cost;
+			sent.entities.push_back(snapshot.entities[candidate.index]);
+		}
+		else if (candidate.had != nullptr)
+		{
+			sent.entities.push_back(*candidate.had);
+		}
+	}
+
+	std::sort(sent.entities.begin(), sent.entities.end(), [](const ReplaySnapshotEntity& a, const ReplaySnapshotEntity& b)
+	{
+		return a.id < b.id;
+	});
+	return updates;
+}
+
+
+// Send a client its part of the latest snapshot, coded against the newest it has acknowledged if that is still in its history
+void NetServer::SendSnapshot(Client& client)
+{
+	const ReplaySnapshot* baseline;
+	SelectEntities(client, baseline);
+	ReplaySnapshot& sent = client.sent[mTick % HISTORY];
+
+	// A snapshot that doesn't fit in a datagram (e.g. a burst of new entities) is chosen again with half the changes, until
+	// it fits. If even the unchanged entities don't, nothing is sent and the slot isn't used as a baseline
+	float budget = mClientBudget * SNAPSHOT_TIME / mBytesPerUpdate;
+	float updates;
+	while (true)
+	{
+		updates = ChooseEntities(client, budget);
+		mEncoder.Encode(sent, baseline);
+		if (sizeof(SnapshotHeader) + mEncoder.Bytes().size() <= MAX_DATAGRAM)  break;
+		if (updates == 0)
+		{
+			sent.tick = NO_TICK;
+			return;
+		}
+		budget = updates * 0.5f;
+	}
+	mSentEntities = std::max(mSentEntities, static_cast<uint32_t>(sent.entities.size()));
+
+	// Only the candidates actually sent lose their priority, the others keep it for the next snapshot
+	for (const Candidate& candidate : mCandidates)
+	{
+		if (candidate.chosen)  candidate.priority->value = 0;
+	}
+
+	// The cost of an update is learnt from what the changes chosen came to, for the next selection
+	const std::vector<std::byte>& bytes = mEncoder.Bytes();
+	if (updates >= 1.0f)
+	{
+		float measured = static_cast<float>(bytes.size()) / updates;
+		mBytesPerUpdate = std::clamp(mBytesPerUpdate * 0.9f + measured * 0.1f, 1.0f, 256.0f);
+	}
+
+	uint32_t baselineTick = baseline != nullptr ? baseline->tick : NO_TICK;
+	SnapshotHeader header = { MakeHeader(PacketType::Snapshot), mTick, baselineTick, client.lastCommand };
+	mPacket.resize(sizeof(header) + bytes.size());
+	std::memcpy(mPacket.data(), &header, sizeof(header));
+	std::memcpy(mPacket.data() + sizeof(header), bytes.data(), bytes.size());
+	if (mSocket.Send(client.address, mPacket.data(), mPacket.size()))  mBytesSent += mPacket.size();
+	mSnapshotBytes = std::max(mSnapshotBytes, static_cast<uint32_t>(mPacket.size()));
+}
+
+
+// Deliver a command to the boats it is for. Commands of other types or for entities that aren't boats are ignored
+void NetServer::ApplyCommand(const NetCommand& command)
+{
+	MessageType type = static_cast<MessageType>(command.type);
+	if (!IsCommand(type))  return;
+
+	if (command.boat == NO_ID)
+	{
+		if (type != MessageType::TargetPoint)  gMessenger->BroadcastAll(SYSTEM_ID, type);
+		return;
+	}
+	if (gEntityManager->GetEntity<Boat>(command.boat) == nullptr)  return;
+	if (type == MessageType::TargetPoint)
+	{
+		Vector3 point = { command.point[0], command.point[1], command.point[2] };
+		if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))  return;
+		gMessenger->DeliverMessage(SYSTEM_ID, command.boat, type, TargetPointData{ point, 5.0f });
+	}
+	else
+	{
+		gMessenger->DeliverMessage(SYSTEM_ID, command.boat, type);
+	}
+}
+
+
+NetServer::Client* NetServer::FindClient(const UdpSocket::Address& address)
+{
+	auto found = std::find_if(mClients.begin(), mClients.end(), [&](const Client& client) { return client.address == address; });
+	return found != mClients.end() ? &*found : nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Client
+-----------------------------------------------------------------------------------------*/
+
+// Find the server and start connecting to it. Returns false if the host can't be found or no socket can be opened
+bool NetClient::Connect(const std::string& host, uint16_t port, std::string& error)
+{
+	if (!UdpSocket::Resolve(host, port, mServer))
+	{
+		error = "Can't find " + host;
+		return false;
+	}
+	if (!mSocket.Open())
+	{
+		error = mSocket.GetLastError();
+		return false;
+	}
+	mConnected   = false;
+	mLastHeard   = Clock::now();
+	mLastConnect = mLastHeard;
+	mRateStart   = mLastHeard;
+	PacketHeader header = MakeHeader(PacketType::Connect);
+	mSocket.Send(mServer, &header, sizeof(header));
+	return true;
+}
+
+
+// Replace the game's entities of the kinds sent by the server with the server's from the next Apply
+void NetClient::Begin(EntityManager& entities)
+{
+	ReplayKind kind;
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		if (ReplayKindOf(entity, kind))  entities.DestroyEntity(entity->GetID());
+	}
+	for (ReplaySnapshot& snapshot : mHistory)  snapshot.tick = NO_TICK;
+	mCreated.clear();
+	mCommands.clear();
+	mNewestTick  = NO_TICK;
+	mAppliedFrom = mAppliedTo = NO_TICK;
+	mBlend = 1.0f;
+}
+
+
+// Tell the server the client is leaving and destroy the entities it created
+void NetClient::End(EntityManager& entities)
+{
+	PacketHeader header = MakeHeader(PacketType::Disconnect);
+	mSocket.Send(mServer, &header, sizeof(header));
+	mSocket.Close();
+	mConnected = false;
+
+	for (const auto& created : mCreated)
+	{
+		if (created.second.id != NO_ID)  entities.DestroyEntity(created.second.id);
+	}
+	mCreated.clear();
+}
+
+
+// Take in the snapshots that have arrived, acknowledge them and move the time shown on by the frame time. Returns false if
+// the connection has been lost
+bool NetClient::Update(float frameTime, std::string& error)
+{
+	auto now = Clock::now();
+	bool reply = false;
+	mPacket.resize(MAX_DATAGRAM);
+	UdpSocket::Address from;
+	size_t size;
+	while ((size = mSocket.Receive(from, mPacket.data(), mPacket.size())) > 0)
+	{
+		PacketType type;
+		if (!(from == mServer) || !ReadPacketType(mPacket.data(), size, type))  continue;
+		mLastHeard = now;
+		mBytesReceived += size;
+
+		if (type == PacketType::Accept && size >= sizeof(AcceptPacket))
+		{
+			AcceptPacket accept;
+			std::memcpy(&accept, mPacket.data(), sizeof(accept));
+			if (accept.snapshotTime > 0)  mSnapshotTime = accept.snapshotTime;
+			mConnected = true;
+			reply = true; // So the server knows the view before the first snapshot
+		}
+		else if (type == PacketType::Snapshot)
+		{
+			mConnected = true;
+			if (ReceiveSnapshot(mPacket.data(), size))  reply = true;
+			else                                         ++mSnapshotsDropped;
+		}
+		else if (type == PacketType::Disconnect)
+		{
+			error = "The server closed the connection";
+			return false;
+		}
+	}
+
+	float silence = std::chrono::duration<float>(now - mLastHeard).count();
+	if (silence > SERVER_TIMEOUT)
+	{
+		error = mConnected ? "Lost the connection to " + mServer.ToString() : "No reply from " + mServer.ToString();
+		return false;
+	}
+	if (!mConnected)
+	{
+		if (std::chrono::duration<float>(now - mLastConnect).count() >= CONNECT_RETRY)
+		{
+			PacketHeader header = MakeHeader(PacketType::Connect);
+			mSocket.Send(mServer, &header, sizeof(header));
+			mLastConnect = now;
+		}
+		return true;
+	}
+
+	// Each snapshot received is acknowledged, which also sends the view and the commands again until the server has applied them
+	if (reply)  SendInput();
+
+	float rateTime = std::chrono::duration<float>(now - mRateStart).count();
+	if (rateTime >= 1.0f)
+	{
+		mBytesPerSecond      = (mBytesReceived - mBytesReceivedBefore) / rateTime;
+		mBytesReceivedBefore = mBytesReceived;
+		mRateStart           = now;
+	}
+
+	// The time shown follows INTERPOLATION_TICKS behind the newest snapshot, running up to 10% fast or slow to stay there as
+	// snapshots arrive unevenly. It jumps if it gets too far out, e.g. on the first snapshot or after the server stalled
+	if (mNewestTick == NO_TICK)  return true;
+	double target = static_cast<double>(mNewestTick) - INTERPOLATION_TICKS;
+	if (std::abs(target - mShownTick) > 2 * INTERPOLATION_TICKS)
+	{
+		mShownTick = target;
+	}
+	else
+	{
+		double speed = 1.0 + std::clamp((target - mShownTick) * 0.1, -0.1, 0.1);
+		mShownTick += frameTime / mSnapshotTime * speed;
+	}
+	mShownTick = std::min(mShownTick, static_cast<double>(mNewestTick));
+	return true;
+}
+
+
+// Create, destroy and move the entities to match the snapshots either side of the time shown
+void NetClient::Apply(EntityManager& entities)
+{
+	if (mNewestTick == NO_TICK)  return;
+
+	// The newest snapshot at or before the time shown to blend from, and the next one received after it to blend to
+	++mApplyCount;
+	ReplaySnapshot* from = nullptr;
+	ReplaySnapshot* to   = nullptr;
+	int64_t shown = static_cast<int64_t>(std::floor(mShownTick));
+	for (uint32_t back = 0; back < NetServer::HISTORY && from == nullptr && shown - back >= 0; ++back)
+	{
+		from = FindSnapshot(static_cast<uint32_t>(shown - back));
+	}
+	if (from == nullptr)  from = FindSnapshot(mNewestTick);
+	for (uint32_t tick = from->tick + 1; tick <= mNewestTick && to == nullptr; ++tick)  to = FindSnapshot(tick);
+	if (to == nullptr)  to = from;
+	mBlend = to == from ? 1.0f : static_cast<float>(std::clamp((mShownTick - from->tick) / (to->tick - from->tick), 0.0, 1.0));
+
+	// The matrices only change when the snapshots do, otherwise only new entities need to be set up
+	bool newSnapshots = from->tick != mAppliedFrom || to->tick != mAppliedTo;
+	mAppliedFrom = from->tick;
+	mAppliedTo   = to->tick;
+
+	auto byID = [](const ReplaySnapshotEntity& entity, EntityID id) { return entity.id < id; };
+	for (const ReplaySnapshotEntity& sent : to->entities)
+	{
+		auto found = mCreated.find(sent.id);
+		bool isNew = found == mCreated.end();
+		if (!isNew)
+		{
+			found->second.applied = mApplyCount;
+			if (!newSnapshots || found->second.id == NO_ID)  continue;
+		}
+
+		// The matrix from the earlier snapshot is set as the previous one to blend from, entities new since then start still
+		auto before = std::lower_bound(from->entities.begin(), from->entities.end(), sent.id, byID);
+		const ReplayPose& previousPose = (before != from->entities.end() && before->id == sent.id) ? before->pose : sent.pose;
+		Matrix4x4 previous = ReplayPoseMatrix(previousPose, sent.info.scale);
+		EntityID id;
+		if (isNew)
+		{
+			id = CreateEntity(entities, sent, previous);
+			mCreated[sent.id] = { id, mApplyCount }; // Not tried again if it can't be created
+			if (id == NO_ID)  continue;
+		}
+		else
+		{
+			id = found->second.id;
+		}
+		Entity* entity = entities.GetEntity(id);
+		entity->Transform() = previous;
+		entities.Transforms().ResetPreviousRoot(EntityIndex(id));
+		entity->Transform() = ReplayPoseMatrix(sent.pose, sent.info.scale);
+	}
+
+	// Those the server no longer has
+	std::erase_if(mCreated, [&](const auto& created)
+	{
+		if (created.second.applied == mApplyCount)  return false;
+		if (created.second.id != NO_ID)  entities.DestroyEntity(created.second.id);
+		return true;
+	});
+}
+
+
+// Send an order for a boat to the server. Returns false if the order can't be sent
+bool NetClient::SendCommand(EntityID boat, MessageType type, const Vector3& point /*= {}*/)
+{
+	if (!mConnected || !IsCommand(type) || mCommands.size() >= MAX_COMMANDS)  return false;
+
+	// The server knows the boat by its own ID
+	EntityID serverBoat = NO_ID;
+	if (boat != NO_ID)
+	{
+		auto found = std::find_if(mCreated.begin(), mCreated.end(), [&](const auto& created) { return created.second.id == boat; });
+		if (found == mCreated.end())  return false;
+		serverBoat = found->first;
+	}
+	mCommands.push_back({ ++mLastCommand, static_cast<uint32_t>(type), serverBoat, { point.x, point.y, point.z } });
+	SendInput();
+	return true;
+}
+
+
+NetClient::Stats NetClient::GetStats()
+{
+	Stats stats = {};
+	stats.entities         = static_cast<uint32_t>(mCreated.size());
+	stats.snapshotBytes    = mSnapshotBytes;
+	stats.bytesPerSecond   = mBytesPerSecond;
+	stats.snapshotsDropped = mSnapshotsDropped;
+	stats.delay            = mNewestTick != NO_TICK ? static_cast<float>((mNewestTick - mShownTick) * mSnapshotTime) : 0.0f;
+	return stats;
+}
+
+
+// Decode a snapshot packet into the history. Returns false if it is of no use (old, damaged or against a missing baseline)
+bool NetClient::ReceiveSnapshot(const std::byte* data, size_t size)
+{
+	SnapshotHeader header;
+	if (size < sizeof(header))  return false;
+	std::memcpy(&header, data, sizeof(header));
+	if (header.tick == NO_TICK || (mNewestTick != NO_TICK && static_cast<int32_t>(header.tick - mNewestTick) <= 0))  return false;
+
+	const ReplaySnapshot* baseline = nullptr;
+	if (header.baselineTick != NO_TICK)
+	{
+		baseline = FindSnapshot(header.baselineTick);
+		if (baseline == nullptr)  return false;
+	}
+	ReplaySnapshot& snapshot = mHistory[header.tick % NetServer::HISTORY];
+	if (&snapshot == baseline)  return false;
+
+	// Decoded aside first, so a damaged packet doesn't lose the snapshot in the slot (which may be a later baseline)
+	if (!mDecoder.Decode(data + sizeof(header), size - sizeof(header), baseline, mDecoded))  return false;
+	std::swap(snapshot.entities, mDecoded.entities);
+	snapshot.tick = header.tick;
+	mNewestTick = header.tick;
+	mSnapshotBytes = static_cast<uint32_t>(size);
+
+	// Commands the server has applied needn't be sent again
+	std::erase_if(mCommands, [&](const NetCommand& command) { return command.number <= header.lastCommand; });
+	return true;
+}
+
+
+// Send the newest tick received and the commands not yet acknowledged
+void NetClient::SendInput()
+{
+	InputHeader header = { MakeHeader(PacketType::Input), mNewestTick, static_cast<uint32_t>(mCommands.size()),
+	                       { mViewPoint.x, mViewPoint.y, mViewPoint.z }, mViewRadius };
+	std::byte packet[sizeof(InputHeader) + MAX_COMMANDS * sizeof(NetCommand)];
+	std::memcpy(packet, &header, sizeof(header));
+	if (!mCommands.empty())  std::memcpy(packet + sizeof(header), mCommands.data(), mCommands.size() * sizeof(NetCommand));
+	mSocket.Send(mServer, packet, sizeof(header) + mCommands.size() * sizeof(NetCommand));
+}
+
+
+// The history slot holding the given tick, nullptr if it isn't there
+ReplaySnapshot* NetClient::FindSnapshot(uint32_t tick)
+{
+	ReplaySnapshot& snapshot = mHistory[tick % NetServer::HISTORY];
+	return snapshot.tick == tick ? &snapshot : nullptr;
+}
+
+
+// Create an entity as the server described it
+EntityID NetClient::CreateEntity(EntityManager& entities, const ReplaySnapshotEntity& sent, const Matrix4x4& transform)
+{
+	EntityID shieldBoat = NO_ID;
+	if (static_cast<ReplayKind>(sent.info.kind) == ReplayKind::Shield)
+	{
+		auto parent = mCreated.find(sent.info.extra);
+		if (parent != mCreated.end())  shieldBoat = parent->second.id;
+	}
+	return CreateReplayEntity(entities, sent.info, transform, shieldBoat);
+}
@@ -0,0 +1,325 @@
+//--------------------------------------------------------------------------------------
+// Networked play - an authoritative server sending snapshots of the game, and clients showing them and giving orders
+//--------------------------------------------------------------------------------------
+// The server runs the simulation as usual, normally headless (see RunServer in Main.cpp). Every SNAPSHOT_TIME seconds of game
+// time it takes a snapshot of the entities a replay records (boats, missiles, crates, mines and shields, the rest of the level
+// is loaded by the clients from the same level file), quantised as for a replay. Each client is sent the snapshot coded as its
+// changes from the latest snapshot that client has acknowledged (see ReplayStream.h), or in full until it has acknowledged
+// one, so an entity that hasn't moved costs nothing and the bandwidth follows what changes rather than how many entities there
+// are. A lost snapshot needs no resending, the next one is coded against a baseline the client is known to have.
+//
+// A client replaces its own moving entities with the server's, like a replay (see Replay.h): it doesn't simulate them, it
+// creates, destroys and moves them to match the snapshots. It shows the game INTERPOLATION_TICKS snapshots behind the newest
+// it has received, blending the matrices between the two snapshots either side of that time when rendering, so the entities
+// move smoothly through a lost snapshot or uneven arrival. The player's orders (start, stop, evade, go to a point) are sent
+// to the server as commands, numbered and sent again with every packet until the server acknowledges them, and applied in
+// order as the same messages the game sends to the boats.
+//
+//   Server:                                              Client:
+//   NetServer server;                                    NetClient client;
+//   server.Start(port, error);                           client.Connect(host, port, error);  client.Begin(*gEntityManager);
+//   ... server.Receive(); before the simulation steps    ... client.Update(frameTime); client.Apply(*gEntityManager); each frame
+//   ... server.Update(*gEntityManager, stepTime);        ... client.SendCommand(boat, MessageType::Evade);
+//       after each step                                  client.End(*gEntityManager);
+//
+// Each client only hears about the entities around its view, the point and radius it sends with every Input (the active
+// camera, so it works the same for players and spectators). The server sorts each snapshot's entities into square cells of
+// INTEREST_CELL_SIZE and looks only at the cells under a client's view, so the work and bytes for a client follow how much is
+// near it rather than how big the battle is. Entities it has that haven't changed cost nothing. Of those that have moved or
+// are new to it, the most important are sent first until its byte budget for the snapshot is spent: each builds up priority
+// every snapshot it is left out, faster for nearer entities and for boats and missiles than crates, and is sent when it gets
+// to the top. One left out keeps the pose the client has, a new one waits. Entities the client has stay until a little
+// outside the radius, so one moving along the edge isn't created and destroyed over and over. So server egress grows with
+// the number of clients times their budget, not clients times entities.
+//
+// Only poses and what is needed to create the entities are sent, a client's boats show their own health, missiles and state.
+// Packets are single UDP datagrams, a full snapshot of several thousand entities relies on IP fragmentation.
+//
+// Packet layout, all values little-endian as written by the game. Every packet starts with "BN", the protocol version (uint8)
+// and the packet type (uint8):
+//   Connect    (client to server):  nothing more, sent until accepted
+//   Accept     (server to client):  snapshot time (float)
+//   Snapshot   (server to client):  tick (uint32), baseline tick (uint32, NO_TICK for none), last command applied (uint32),
+//                                   then the range coded snapshot
+//   Input      (client to server):  newest tick received (uint32), number of commands (uint32), view point (3 floats),
+//                                   view radius (float), then the commands not yet acknowledged, oldest first, see NetCommand
+//   Disconnect (either way):        nothing more
+
+#ifndef _NETWORK_H_INCLUDED_
+#define _NETWORK_H_INCLUDED_
+
+#include "ReplayStream.h"
+#include "UdpSocket.h"
+#include "Messenger.h"
+#include "EntityTypes.h"
+#include "Matrix4x4.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+#include <cstddef>
+#include <stdint.h>
+
+
+class EntityManager;
+
+// Tick of no snapshot, e.g. the baseline of a snapshot sent in full
+static constexpr uint32_t NO_TICK = 0xFFFFFFFF;
+
+// An order for a boat, as sent from a client to the server
+struct NetCommand
+{
+	uint32_t number;    // Counts up from 1 for each command a client sends
+	uint32_t type;      // Start, Stop, Evade or TargetPoint, a MessageType
+	EntityID boat;      // Server's ID of the boat, NO_ID for every boat
+	float    point[3];  // For TargetPoint
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Server
+-----------------------------------------------------------------------------------------*/
+
+class NetServer
+{
+public:
+	static constexpr uint16_t DEFAULT_PORT   = 37015;
+	static constexpr float    SNAPSHOT_TIME  = 1.0f / 20; // Seconds of game time between snapshots
+	static constexpr uint32_t HISTORY        = 64;        // Snapshots kept to code against, 3.2 seconds
+	static constexpr uint32_t MAX_CLIENTS    = 32;
+	static constexpr float    CLIENT_TIMEOUT = 5.0f;      // Real seconds without a packet before a client is dropped
+
+	// Interest management, see the top of the file
+	static constexpr float    INTEREST_CELL_SIZE = 250.0f;
+	static constexpr float    INTEREST_KEEP      = 1.25f;      // Entities a client has are kept out to this times its radius
+	static constexpr float    MAX_VIEW_RADIUS    = 20000.0f;
+	static constexpr float    DEFAULT_BUDGET     = 48 * 1024;  // Bytes per second for each client
+
+	// Bytes per second each client is sent at most, roughly (the cost of each entity sent is estimated)
+	void  SetClientBudget(float bytesPerSecond)  { mClientBudget = std::max(bytesPerSecond, 1024.0f); }
+	float GetClientBudget()                      { return mClientBudget; }
+
+	// Open the port for clients to connect to. Returns false if it can't be opened
+	bool Start(uint16_t port, std::string& error);
+
+	// Tell the clients the server is stopping and close the port
+	void Stop();
+
+	bool IsRunning()  { return mSocket.IsOpen(); }
+
+	// Take in the packets clients have sent, delivering their commands to the boats. Call on the main thread before the
+	// simulation steps, outside UpdateAll
+	void Receive();
+
+	// Send a snapshot to every client if a snapshot time has passed. Call after each simulation step with the step's length
+	void Update(EntityManager& entities, float stepTime);
+
+	// For display
+	struct Stats
+	{
+		uint32_t clients;
+		uint32_t entities;      // In the last snapshot
+		uint32_t sentEntities;  // Most in the last snapshot sent to one client
+		uint32_t snapshotBytes; // Largest sent for the last snapshot
+		float    bytesPerSecond;
+	};
+	Stats GetStats();
+
+private:
+	struct Client
+	{
+		UdpSocket::Address address;
+		uint32_t ackedTick   = NO_TICK; // Newest snapshot it has received
+		uint32_t lastCommand = 0;       // Number of the last command applied
+		std::chrono::steady_clock::time_point lastHeard;
+
+		Vector3 viewPoint;
+		float   viewRadius = 0;       // Nothing is sent until the client has said where it is looking
+
+		// What the client was sent of each snapshot, at tick % HISTORY, to code against once acknowledged
+		std::vector<ReplaySnapshot> sent;
+
+		// Built up by the entities near the client that have changed since the snapshot it has, see SelectEntities
+		struct Priority
+		{
+			float    value = 0;
+			uint32_t tick  = 0; // Last snapshot the entity was a candidate in, the others are forgotten
+		};
+		std::unordered_map<EntityID, Priority> priorities;
+	};
+
+	// An entity of the latest snapshot that could be sent to a client, see SelectEntities
+	struct Candidate
+	{
+		uint32_t index;                    // In the snapshot
+		const ReplaySnapshotEntity* had;   // In the client's baseline, nullptr if new to it
+		Client::Priority* priority;
+		bool chosen = false;               // Sent in the snapshot being built, see ChooseEntities
+	};
+
+	// Take a snapshot of the entities a replay records, into the next history slot, and sort them into the interest cells
+	void TakeSnapshot(EntityManager& entities);
+
+	// Find what a client could be sent of the latest snapshot, giving the snapshot of the client's it is coded against (nullptr
+	// for none). The candidates' priorities are built up but not reset, that is left until the packet is known to fit
+	void SelectEntities(Client& client, const ReplaySnapshot*& baseline);
+
+	// Put the unchanged entities and the candidates that fit the budget (in updates) in the client's history. Returns the cost
+	// of the changes chosen in updates, for the estimate
+	float ChooseEntities(Client& client, float budget);
+
+	// Send a client its part of the latest snapshot, coded against the newest it has acknowledged if that is still in its history
+	void SendSnapshot(Client& client);
+
+	// Deliver a command to the boats it is for. Commands of other types or for entities that aren't boats are ignored
+	void ApplyCommand(const NetCommand& command);
+
+	Client* FindClient(const UdpSocket::Address& address);
+
+	UdpSocket mSocket;
+	std::vector<Client> mClients;
+
+	ReplaySnapshot        mHistory[HISTORY]; // Snapshot of each tick is at tick % HISTORY
+	ReplaySnapshotEncoder mEncoder;
+	std::vector<ReplaySample> mSamples;
+
+	// The latest snapshot's entities by interest cell, as indexes into it, with the position of each on X and Z. Cells aren't
+	// erased when empty, as in the SpatialGrid
+	std::unordered_map<uint64_t, std::vector<uint32_t>> mCells;
+	std::vector<float> mPositions;
+	std::vector<Candidate> mCandidates;
+	std::vector<uint32_t>  mUnchanged; // Indexes of the entities the client has as they are, sent as they cost nothing
+
+	float mClientBudget   = DEFAULT_BUDGET;
+	float mBytesPerUpdate = 8.0f; // Estimated cost of an entity that has moved, learnt from the snapshots sent
+	std::vector<std::byte> mPacket;
+	uint32_t mTick       = NO_TICK;          // Of the last snapshot taken
+	float    mTimeToTick = 0;
+
+	// Bytes sent over the last second, for display
+	uint64_t mBytesSent = 0;
+	uint64_t mBytesSentBefore = 0;
+	float    mBytesPerSecond = 0;
+	std::chrono::steady_clock::time_point mRateStart;
+	uint32_t mSnapshotBytes = 0;
+	uint32_t mSentEntities  = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Client
+-----------------------------------------------------------------------------------------*/
+
+class NetClient
+{
+public:
+	static constexpr float    INTERPOLATION_TICKS = 2;    // Snapshots behind the newest the game is shown at
+	static constexpr float    CONNECT_RETRY       = 0.5f; // Real seconds between connection attempts
+	static constexpr float    SERVER_TIMEOUT      = 5.0f; // Real seconds without a packet before the connection is lost
+	static constexpr uint32_t MAX_COMMANDS        = 32;   // Waiting for the server's acknowledgement, more are dropped
+	static constexpr float    DEFAULT_VIEW_RADIUS = 1500.0f;
+
+	// Find the server and start connecting to it. Returns false if the host can't be found or no socket can be opened
+	bool Connect(const std::string& host, uint16_t port, std::string& error);
+
+	// Replace the game's entities of the kinds sent by the server with the server's from the next Apply. Call on the main
+	// thread outside UpdateAll
+	void Begin(EntityManager& entities);
+
+	// Tell the server the client is leaving and destroy the entities it created
+	void End(EntityManager& entities);
+
+	// Take in the snapshots that have arrived, acknowledge them and move the time shown on by the frame time. Returns false if
+	// the connection has been lost, with the reason
+	bool Update(float frameTime, std::string& error);
+
+	// Create, destroy and move the entities to match the snapshots either side of the time shown. Call on the main thread
+	// outside UpdateAll
+	void Apply(EntityManager& entities);
+
+	// How far between the snapshots either side of the time shown, 0 to 1, to blend the entities' matrices with when rendering
+	float Blend()  { return mBlend; }
+
+	// Where the client is looking, e.g. the active camera, and how far around it entities are wanted. Sent to the server with
+	// the next acknowledgement, see interest management at the top of the file
+	void  SetViewPoint(const Vector3& point)  { mViewPoint = point; }
+	void  SetViewRadius(float radius)         { mViewRadius = radius; }
+	float GetViewRadius()                     { return mViewRadius; }
+
+	// Send an order for a boat (this client's ID of it, NO_ID for every boat) to the server. Only Start, Stop, Evade and
+	// TargetPoint are sent. Returns false if the order can't be sent
+	bool SendCommand(EntityID boat, MessageType type, const Vector3& point = {});
+
+	bool IsConnected()  { return mConnected; }
+
+	// For display
+	struct Stats
+	{
+		uint32_t entities;
+		uint32_t snapshotBytes;   // Of the last received
+		float    bytesPerSecond;  // Received over the last second
+		uint32_t snapshotsDropped; // Couldn't be decoded, e.g. their baseline was missing
+		float    delay;           // Seconds behind the newest snapshot
+	};
+	Stats GetStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Decode a snapshot packet into the history. Returns false if it is of no use (old, damaged or against a missing baseline)
+	bool ReceiveSnapshot(const std::byte* data, size_t size);
+
+	// Send the newest tick received and the commands not yet acknowledged
+	void SendInput();
+
+	// The history slot holding the given tick, nullptr if it isn't there
+	ReplaySnapshot* FindSnapshot(uint32_t tick);
+
+	// Create an entity as the server described it
+	EntityID CreateEntity(EntityManager& entities, const ReplaySnapshotEntity& sent, const Matrix4x4& transform);
+
+	UdpSocket mSocket;
+	UdpSocket::Address mServer;
+	bool  mConnected = false;
+	float mSnapshotTime = 1.0f / 20;
+	Clock::time_point mLastHeard;
+	Clock::time_point mLastConnect;
+	std::vector<std::byte> mPacket;
+	Vector3 mViewPoint;
+	float   mViewRadius = DEFAULT_VIEW_RADIUS;
+
+	ReplaySnapshot        mHistory[NetServer::HISTORY]; // As on the server
+	ReplaySnapshotDecoder mDecoder;
+	ReplaySnapshot        mDecoded; // A snapshot being received, moved into the history once decoded, see ReceiveSnapshot
+	uint32_t mNewestTick = NO_TICK;
+	double   mShownTick  = 0;          // Time shown, in ticks, usually between two snapshots
+	float    mBlend      = 1.0f;
+	uint32_t mAppliedFrom = NO_TICK;   // Snapshots last applied
+	uint32_t mAppliedTo   = NO_TICK;
+
+	std::vector<NetCommand> mCommands; // Sent and not yet acknowledged
+	uint32_t mLastCommand = 0;         // Number of the last command sent
+
+	// The entity created for each of the server's entities, and the Apply that last found it in a snapshot
+	struct Created
+	{
+		EntityID id;
+		uint32_t applied;
+	};
+	std::unordered_map<EntityID, Created> mCreated;
+	uint32_t mApplyCount = 0;
+
+	// For display
+	uint64_t mBytesReceived = 0;
+	uint64_t mBytesReceivedBefore = 0;
+	float    mBytesPerSecond = 0;
+	Clock::time_point mRateStart;
+	uint32_t mSnapshotBytes = 0;
+	uint32_t mSnapshotsDropped = 0;
+};
+
+
+#endif //_NETWORK_H_INCLUDED_
@@ -18,30 +18,38 @@ struct AABB
     Vector3 max;
 };
 
-class Obstacle : public Entity
+class Obstacle : public Entity, public TaggedType<Obstacle, TypeTag::Obstacle>
 {
 public:
-    // Constructor: The entity template, unique ID, initial transform, a vector repressenting half the width, height, 
-    // and depth of the obstacleand and optional name are passed in.
-    Obstacle(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, const std::string& name = "", 
-        const Vector3& halfExtents = Vector3(60.0f, 20.0f, 60.0f))
-        : Entity(entityTemplate, id, transform, name),
-        mHalfExtents(halfExtents)
-    {
-        // Compute the AABB based on the transform's position.
-        mAABB.min = Transform().Position() - mHalfExtents;
-        mAABB.max = Transform().Position() + mHalfExtents;
-    }
-
-    // Returns the obstacle's axis-aligned bounding box.
+    // Half-dimensions of the box used when the template's mesh has no bounding box (e.g. a skinned mesh)
+    static constexpr Vector3 DEFAULT_HALF_EXTENTS = { 60.0f, 20.0f, 60.0f };
+
+    // Constructor: The entity template, unique ID, initial transform, and optional name are passed in. The obstacle's box is
+    // the template mesh's bounding box (see EntityTemplate::GetBoundingBox), turned, scaled and placed by the transform. A
+    // vector of half the width, height and depth of the obstacle can be passed instead, for a box around its position that
+    // ignores the mesh, rotation and scale
+    Obstacle(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, Atom name = {}, 
+        const Vector3& halfExtents = Vector3(0.0f, 0.0f, 0.0f));
+
+    // Returns the obstacle's axis-aligned bounding box. For a turned obstacle this encloses its oriented box
     const AABB& GetAABB() const { return mAABB; }
 
-    // Determines if a line segment (start to end) intersects with this obstacle's AABB.
-    bool IntersectsLineSegment(const Vector3& start, const Vector3& end);
+    // Returns true if the obstacle is turned relative to the world axes, then its axis-aligned box is larger than the obstacle
+    // and segments touching it are tested against the oriented box as well (see HitsOrientedBox)
+    bool IsOriented() const { return mOriented; }
+
+    // Determines if a line segment (start to end) intersects with this obstacle's box, the oriented box if it is turned.
+    bool IntersectsLineSegment(const Vector3& start, const Vector3& end) const;
+
+    // Determines if a line segment intersects with the obstacle's box in its own space, for a segment already known to touch
+    // the axis-aligned box (e.g. by the obstacle BVH)
+    bool HitsOrientedBox(const Vector3& start, const Vector3& end) const;
 
 private:
-    AABB mAABB; // The axis-aligned bounding box for collision or occlusion tests.
-    Vector3 mHalfExtents;  // Half-dimensions of the obstacle.
+    AABB mAABB;             // The axis-aligned bounding box for collision or occlusion tests.
+    AABB mLocalBox;         // The box in the obstacle's own space, when it is oriented
+    Matrix4x4 mWorldToLocal; // Moves world points into the space of mLocalBox
+    bool mOriented = false;
 };
 
 #endif // _OBSTACLE_H_INCLUDED_
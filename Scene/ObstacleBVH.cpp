@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------------------
+// Bounding volume hierarchy over the obstacles in the level
+//--------------------------------------------------------------------------------------
+
+#include "ObstacleBVH.h"
+
+#include <algorithm>
+#include <cfloat>
+
+
+/*-----------------------------------------------------------------------------------------
+   Construction
+-----------------------------------------------------------------------------------------*/
+
+// Build the tree for the given obstacles, replacing any previous tree
+void ObstacleBVH::Build(const std::vector<Obstacle*>& obstacles)
+{
+	mObstacles = obstacles;
+	mNodes.clear();
+	mLeafBoxes.clear();
+	if (mObstacles.empty())  return;
+
+	// A tree with n leaves has 2n-1 nodes, reserve enough for the smallest leaves so the node list is allocated once
+	mNodes.reserve(2 * mObstacles.size());
+	mNodes.emplace_back();
+	BuildNode(0, 0, static_cast<uint32_t>(mObstacles.size()), 0);
+}
+
+
+// Build the node at the given index over mObstacles[first] to mObstacles[first + count - 1]. Obstacles are split in half at
+// the median of their centres along the axis where the centres are most spread out. Sorting by the centre rather than
+// searching for the best split is simple and gives a good enough tree for a level's worth of obstacles
+void ObstacleBVH::BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth)
+{
+	// Bounds of the obstacles' boxes and of their centres
+	Vector3 boxMin    = {  FLT_MAX,  FLT_MAX,  FLT_MAX };
+	Vector3 boxMax    = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	Vector3 centreMin = boxMin;
+	Vector3 centreMax = boxMax;
+	for (uint32_t i = first; i < first + count; ++i)
+	{
+		const AABB& box = mObstacles[i]->GetAABB();
+		Vector3 centre = (box.min + box.max) * 0.5f;
+		boxMin    = { std::min(boxMin.x, box.min.x),    std::min(boxMin.y, box.min.y),    std::min(boxMin.z, box.min.z) };
+		boxMax    = { std::max(boxMax.x, box.max.x),    std::max(boxMax.y, box.max.y),    std::max(boxMax.z, box.max.z) };
+		centreMin = { std::min(centreMin.x, centre.x),  std::min(centreMin.y, centre.y),  std::min(centreMin.z, centre.z) };
+		centreMax = { std::max(centreMax.x, centre.x),  std::max(centreMax.y, centre.y),  std::max(centreMax.z, centre.z) };
+	}
+	mNodes[nodeIndex].min = boxMin;
+	mNodes[nodeIndex].max = boxMax;
+
+	if (count <= MAX_LEAF_SIZE || depth + 2 >= MAX_DEPTH)
+	{
+		mNodes[nodeIndex].first = first;
+		mNodes[nodeIndex].count = count;
+		mNodes[nodeIndex].leafBoxes = static_cast<uint32_t>(mLeafBoxes.size());
+
+		// Copy the boxes into groups of four for the segment test, at the depth limit a leaf might need several groups
+		for (uint32_t group = 0; group < count; group += 4)
+		{
+			BoxGroup4& boxes = mLeafBoxes.emplace_back();
+			for (uint32_t n = 0; n < 4; ++n)
+			{
+				const AABB& box = mObstacles[first + (group + n < count ? group + n : group)]->GetAABB();
+				boxes.Set(n, box.min, box.max);
+			}
+		}
+		return;
+	}
+
+	// Split at the median along the widest axis of the centres
+	Vector3 spread = centreMax - centreMin;
+	int axis = (spread.x >= spread.y && spread.x >= spread.z) ? 0 : (spread.y >= spread.z ? 1 : 2);
+	auto centreOnAxis = [axis](Obstacle* obstacle)
+	{
+		const AABB& box = obstacle->GetAABB();
+		return axis == 0 ? box.min.x + box.max.x : (axis == 1 ? box.min.y + box.max.y : box.min.z + box.max.z);
+	};
+	uint32_t half = count / 2;
+	std::nth_element(mObstacles.begin() + first, mObstacles.begin() + first + half, mObstacles.begin() + first + count,
+	                 [&](Obstacle* a, Obstacle* b) { return centreOnAxis(a) < centreOnAxis(b); });
+
+	// Children are added as a pair. Don't hold a reference to the node across the emplace_back calls as they can reallocate
+	uint32_t children = static_cast<uint32_t>(mNodes.size());
+	mNodes.emplace_back();
+	mNodes.emplace_back();
+	mNodes[nodeIndex].first = children;
+	mNodes[nodeIndex].count = 0;
+
+	BuildNode(children,     first,        half,         depth + 1);
+	BuildNode(children + 1, first + half, count - half, depth + 1);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Queries
+-----------------------------------------------------------------------------------------*/
+
+// Returns true if the line segment from start to end passes through any obstacle (see Obstacle::IntersectsLineSegment)
+bool ObstacleBVH::IsSegmentBlocked(const Vector3& start, const Vector3& end) const
+{
+	if (mNodes.empty())  return false;
+
+	// The segment is prepared once for all the box tests. Node boxes contain all the obstacle boxes below them and the test
+	// includes touching, so a node is never skipped when an obstacle inside it touches the segment
+	PreparedSegment segment = PrepareSegment(start, end);
+
+	uint32_t stack[MAX_DEPTH];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = mNodes[stack[--stackSize]];
+		if (!SegmentHitsBox(segment, node.min, node.max))  continue;
+
+		if (node.count == 0)
+		{
+			stack[stackSize++] = node.first + 1;
+			stack[stackSize++] = node.first;
+			continue;
+		}
+
+		// Test the leaf's obstacles four at a time, the same test as Obstacle::IntersectsLineSegment. The world boxes of turned
+		// obstacles are larger than the obstacles, so those are tested against their oriented boxes before counting as a hit
+		for (uint32_t group = 0; group * 4 < node.count; ++group)
+		{
+			uint32_t boxesInGroup = std::min(node.count - group * 4, 4u);
+			unsigned int hits = SegmentHitsBoxes4(segment, mLeafBoxes[node.leafBoxes + group]) & ((1u << boxesInGroup) - 1);
+			for (uint32_t n = 0; hits != 0; ++n, hits >>= 1)
+			{
+				if ((hits & 1) && mObstacles[node.first + group * 4 + n]->HitsOrientedBox(start, end))  return true;
+			}
+		}
+	}
+	return false;
+}
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// Bounding volume hierarchy over the obstacles in the level
+//--------------------------------------------------------------------------------------
+// Obstacles never move once the level has been loaded, so their bounding boxes are arranged into a tree once: each node of
+// the tree has a box containing all the obstacles below it, and a query only visits the nodes whose box it touches. A line
+// of sight test or avoidance check then only looks at the few obstacles near the query rather than at every obstacle, so
+// the cost grows with the log of the number of obstacles.
+//
+// The EntityManager owns the tree and rebuilds it when obstacles are created or destroyed, see EntityManager::ObstacleTree:
+//     bool blocked = gEntityManager->ObstacleTree().IsSegmentBlocked(boatPos, enemyPos);
+//
+// Queries are read-only, so they are safe to use from entity updates on worker threads (see Entity::CanUpdateInParallel)
+
+#ifndef _OBSTACLE_BVH_H_INCLUDED_
+#define _OBSTACLE_BVH_H_INCLUDED_
+
+#include "Obstacle.h"
+#include "Vector3.h"
+#include "SegmentBoxTest.h"
+
+#include <vector>
+#include <type_traits>
+#include <stdint.h>
+
+
+class ObstacleBVH
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	ObstacleBVH() = default;
+
+	// Build the tree for the given obstacles, replacing any previous tree. The obstacles must not be destroyed while the
+	// tree is in use (the EntityManager rebuilds the tree when they are)
+	void Build(const std::vector<Obstacle*>& obstacles);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Queries
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Returns true if the line segment from start to end passes through any obstacle (see Obstacle::IntersectsLineSegment)
+	bool IsSegmentBlocked(const Vector3& start, const Vector3& end) const;
+
+	// Call the given function for each obstacle whose bounding box overlaps the given sphere. The function is passed an
+	// Obstacle* and may return void, or bool where returning false stops the query. Returns false if the query was stopped early
+	template <typename Function>
+	bool QuerySphere(const Vector3& centre, float radius, Function&& function) const
+	{
+		if (mNodes.empty())  return true;
+
+		float radiusSquared = radius * radius;
+		uint32_t stack[MAX_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const Node& node = mNodes[stack[--stackSize]];
+			if (BoxDistanceSquared(node.min, node.max, centre) > radiusSquared)  continue;
+
+			if (node.count == 0)
+			{
+				// Inner node, children are at node.first and node.first + 1
+				stack[stackSize++] = node.first + 1;
+				stack[stackSize++] = node.first;
+				continue;
+			}
+
+			for (uint32_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const AABB& box = mObstacles[i]->GetAABB();
+				if (BoxDistanceSquared(box.min, box.max, centre) > radiusSquared)  continue;
+
+				if constexpr (std::is_same_v<std::invoke_result_t<Function, Obstacle*>, bool>)
+				{
+					if (!function(mObstacles[i]))  return false;
+				}
+				else
+				{
+					function(mObstacles[i]);
+				}
+			}
+		}
+		return true;
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Build the node at the given index over mObstacles[first] to mObstacles[first + count - 1]
+	void BuildNode(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth);
+
+	// Squared distance from a point to the nearest point in a box, 0 if the point is inside
+	static float BoxDistanceSquared(const Vector3& boxMin, const Vector3& boxMax, const Vector3& point)
+	{
+		float dx = point.x < boxMin.x ? boxMin.x - point.x : (point.x > boxMax.x ? point.x - boxMax.x : 0.0f);
+		float dy = point.y < boxMin.y ? boxMin.y - point.y : (point.y > boxMax.y ? point.y - boxMax.y : 0.0f);
+		float dz = point.z < boxMin.z ? boxMin.z - point.z : (point.z > boxMax.z ? point.z - boxMax.z : 0.0f);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Leaves hold up to this many obstacles, which is the number of boxes SegmentHitsBoxes4 tests at once
+	static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+	// Bound on the depth of the tree, so queries can use a fixed size stack. Splits always halve the obstacles so this is
+	// only reached with billions of obstacles, but the build makes a leaf at this depth regardless
+	static constexpr uint32_t MAX_DEPTH = 64;
+
+	// Node of the tree. Leaves have a non-zero count and hold mObstacles[first] to mObstacles[first + count - 1], with their
+	// boxes in mLeafBoxes[leafBoxes]. Inner nodes have count 0 and their two children are mNodes[first] and mNodes[first + 1].
+	// The root is mNodes[0]
+	struct Node
+	{
+		Vector3  min;
+		Vector3  max;
+		uint32_t first     = 0;
+		uint32_t count     = 0;
+		uint32_t leafBoxes = 0;
+	};
+
+	std::vector<Node>      mNodes;
+	std::vector<Obstacle*> mObstacles; // Arranged so each leaf's obstacles are together
+
+	// Copies of the obstacle boxes of each leaf, laid out for SegmentHitsBoxes4. Leaves with fewer than four obstacles repeat
+	// their first box in the unused places, the results for those places are ignored
+	std::vector<BoxGroup4> mLeafBoxes;
+};
+
+
+#endif //_OBSTACLE_BVH_H_INCLUDED_
@@ -2,6 +2,43 @@
 #include "SceneGlobals.h"
 #include "Boat.h"
 
+RandomCrate::RandomCrate(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, CrateType crateType)
+    : Entity(entityTemplate, id, transform), mLocal(TRSFromMatrix(transform))
+{
+    mCrateType = crateType;
+
+    // The nearest boat within the collision radius picks up the crate, which destroys the crate
+    TriggerVolume trigger;
+    trigger.radius       = collisionRadius;
+    trigger.targetMask   = SPATIAL_BOAT;
+    trigger.enterMessage = MessageType::CrateCollected;
+    trigger.enterData    = CratePickupData{ mCrateType };
+    trigger.oneShot      = true;
+    gEntityManager->Triggers().Add(this, trigger);
+
+    // Bob up and down once risen to the surface
+    StartBobbing(mRiseDuration);
+}
+
+// Carry on from a saved state, bobbing from the same point in the motion
+void RandomCrate::RestoreState(const SavedState& saved)
+{
+    mCrateType = saved.crateType;
+    mRiseTimer = saved.riseTimer;
+    mLocal = saved.local;
+    StartBobbing(mRiseDuration - mRiseTimer);
+}
+
+// Start bobbing on the water after the given delay, a negative delay starts part way through the motion
+void RandomCrate::StartBobbing(float delay)
+{
+    BobbingMotion bobbing;
+    bobbing.baseY     = mBaseY;
+    bobbing.amplitude = 0.7f;
+    bobbing.delay     = delay;
+    gEntityManager->Bobbing().Add(this, bobbing);
+}
+
 bool RandomCrate::Update(float frameTime)
 {
     // Handle rising phase
@@ -11,42 +48,13 @@ bool RandomCrate::Update(float frameTime)
         float progress = mRiseTimer / mRiseDuration;
         progress = std::min(progress, 1.0f); // Clamp to 1.0
 
-        Vector3 minePos = Transform().Position();
-        minePos.y = mStartY + (mBaseY - mStartY) * progress;
-        Transform().Position() = minePos;
-    }
-    else // Start oscillating after rising
-    {
-        mOscillationTime += frameTime;
-        Vector3 cratePos = Transform().Position();
-        cratePos.y = mBaseY + 0.7f * std::sin(mOscillationTime);
-        Transform().Position() = cratePos;
+        mLocal.position.y = mStartY + (mBaseY - mStartY) * progress;
     }
+    // After rising the height is set by the bobbing motion added in the constructor
 
-	Transform().RotateLocalY(0.75f * frameTime);
-
-    std::vector<Boat*> boats = gEntityManager->GetAllBoatEntities();
-    float collisionRadiusSq = collisionRadius * collisionRadius;
-    Vector3 cratePos = Transform().Position();
-
-    for (Boat* boat : boats)
-    {
-        Vector3 diff = boat->Transform().Position() - cratePos;
-        float distSq = diff.x * diff.x + diff.y * diff.y + diff.z * diff.z;
-        if (distSq <= collisionRadiusSq)
-        {
-            // Prepare crate pickup message data.
-            CratePickupData data;
-            data.type = mCrateType;
-
-            // Send the crate pickup message to the boat.
-            // The message could carry a variant or a struct. Adjust to your messenger design.
-            gMessenger->DeliverMessage(GetID(), boat->GetID(), MessageType::CrateCollected, data);
-
-            // Return false to destroy the crate.
-            return false;
-        }
-    }
+    mLocal.RotateLocalY(0.75f * frameTime);
+    Transform() = mLocal.ToMatrix();
 
+    // Pickup by boats is handled by the crate's trigger volume, which also destroys the crate
     return true;
 }
@@ -2,38 +2,56 @@
 #define _RANDOM_CRATE_H_INCLUDED_
 
 #include "Entity.h"
+#include "EntityPool.h"
 #include "EntityTypes.h"
 #include "Messenger.h"
 #include "Vector3.h"
+#include "TRS.h"
 #include <string>
 
-class RandomCrate : public Entity
+class RandomCrate : public Entity, public PooledEntity<RandomCrate>, public TaggedType<RandomCrate, TypeTag::RandomCrate>
 {
 public:
     // Constructor: The entity template, unique ID, initial transform, and optional name are passed in.
-    RandomCrate(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, CrateType crateType)
-        : Entity(entityTemplate, id, transform)
-    {
-        mCrateType = crateType;
-    }
+    // The crate is given a one-shot trigger volume that sends CrateCollected to the first boat to come within the collision radius
+    RandomCrate(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, CrateType crateType);
 
 public:
     // The Update function is called every frame.
     virtual bool Update(float frameTime) override;
 
+    // Crates only move themselves (boats are detected by the trigger volume), so can be updated on worker threads
+    virtual bool CanUpdateInParallel() override { return true; }
+
     CrateType GetCrateType() const { return mCrateType; }
 
+    // Everything about the crate except its template, ID and matrix, as plain data for a checkpoint (see Checkpoint.h). Create
+    // the crate again with the saved type before restoring the rest, the bobbing motion then continues from the saved time
+    struct SavedState
+    {
+        CrateType crateType;
+        float     riseTimer;
+        TRS       local;
+    };
+    SavedState SaveState() { return { mCrateType, mRiseTimer, mLocal }; }
+    void RestoreState(const SavedState& saved);
+
     float collisionRadius = 15.0f;
 
 private:
+    // Start bobbing on the water after the given delay
+    void StartBobbing(float delay);
+
     CrateType mCrateType;
-    float mOscillationTime = 0.0f;
     float mBaseY = -0.6f;
 
     // Rising phase variables
     float mRiseTimer = 0.0f;
     float mRiseDuration = 2.0f;
     float mStartY = -10.0f;
+
+    // Position, spin and scale, the matrix is rebuilt from these each update rather than being rotated a little each frame
+    TRS mLocal;
 };
 
 #endif // _RANDOM_CRATE_H_INCLUDED_
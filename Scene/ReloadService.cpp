@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// Reload service - which reload station each reloading boat uses, and whose turn it is at each
+//--------------------------------------------------------------------------------------
+
+#include "ReloadService.h"
+#include "SpatialGrid.h"
+
+#include "SceneGlobals.h" // For gMessenger
+
+#include <algorithm>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add a boat to the queue of the nearest station with room, or the nearest station if none has room. Returns the station,
+// nullptr if there are no stations
+Entity* ReloadService::Join(const SpatialGrid& spatial, EntityID boat, const Vector3& point, bool docked /*= false*/)
+{
+	Leave(boat);
+
+	Entity* station = nullptr;
+	if (!docked)
+	{
+		station = spatial.QueryNearest(point, SPATIAL_RELOAD_STATION, FLT_MAX, [&](Entity* candidate)
+		{
+			return QueueLength(candidate->GetID()) < DOCKS + MAX_WAITING;
+		});
+	}
+	if (station == nullptr)  station = spatial.QueryNearest(point, SPATIAL_RELOAD_STATION);
+	if (station == nullptr)  return nullptr;
+
+	auto& queue = mQueues[station->GetID()];
+	if (docked)  queue.insert(queue.begin(), boat);
+	else         queue.push_back(boat);
+	mStations[boat] = station->GetID();
+	return station;
+}
+
+
+// Take a boat out of its station's queue, sending the next boat waiting there its turn
+void ReloadService::Leave(EntityID boat)
+{
+	auto found = mStations.find(boat);
+	if (found == mStations.end())  return;
+	EntityID station = found->second;
+	mStations.erase(found);
+
+	auto& queue = mQueues[station];
+	auto position = std::find(queue.begin(), queue.end(), boat);
+	if (position == queue.end())  return;
+	bool hadTurn = position - queue.begin() < DOCKS;
+	queue.erase(position);
+
+	// The boat that moved up into the last place with a turn is the next one
+	if (hadTurn && queue.size() >= static_cast<size_t>(DOCKS))  gMessenger->DeliverMessage(station, queue[DOCKS - 1], MessageType::ReloadTurn);
+	if (queue.empty())  mQueues.erase(station);
+}
+
+
+// Forget a boat or station that is being destroyed
+void ReloadService::Remove(EntityID entity)
+{
+	Leave(entity);
+
+	auto found = mQueues.find(entity);
+	if (found == mQueues.end())  return;
+	for (size_t i = 0; i < found->second.size(); ++i)
+	{
+		EntityID boat = found->second[i];
+		mStations.erase(boat);
+		if (i >= static_cast<size_t>(DOCKS))  gMessenger->DeliverMessage(entity, boat, MessageType::ReloadTurn);
+	}
+	mQueues.erase(found);
+}
+
+
+// Whether the boat is in a queue but it isn't its turn yet
+bool ReloadService::IsWaiting(EntityID boat) const
+{
+	auto found = mStations.find(boat);
+	if (found == mStations.end())  return false;
+
+	const auto& queue = mQueues.at(found->second);
+	auto position = std::find(queue.begin(), queue.end(), boat);
+	return position - queue.begin() >= DOCKS;
+}
+
+
+// The station the boat is queued at, NO_ID if it isn't in a queue
+EntityID ReloadService::StationOf(EntityID boat) const
+{
+	auto found = mStations.find(boat);
+	return (found != mStations.end()) ? found->second : NO_ID;
+}
+
+
+// Boats queued at the station, including those docked
+int ReloadService::QueueLength(EntityID station) const
+{
+	auto found = mQueues.find(station);
+	return (found != mQueues.end()) ? static_cast<int>(found->second.size()) : 0;
+}
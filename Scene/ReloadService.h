@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// Reload service - which reload station each reloading boat uses, and whose turn it is at each
+//--------------------------------------------------------------------------------------
+// A boat entering the Reloading state joins a station once, rather than looking for one every update. It is given the
+// nearest station with room in its queue (found with the spatial grid), so a large fleet spreads out over the stations
+// rather than all heading for the same one, or the nearest of all the stations if every queue is full.
+//
+// Each station has a queue of the boats that have joined it. The first DOCKS boats in the queue have their turn and can
+// dock and reload, the rest wait away from the station. When a boat leaves (it has reloaded, changed state or been
+// destroyed) the next boat in the queue is sent a ReloadTurn message. The boat's reload behaviour waits for the message,
+// so a waiting boat does nothing until its turn:
+//   Entity* station = gEntityManager->Reloads().Join(gEntityManager->Spatial(), GetID(), Transform().Position());
+//   ...
+//   while (gEntityManager->Reloads().IsWaiting(GetID()))  co_await WaitForMessage(MessageType::ReloadTurn);
+//
+// Queues are changed only from boat updates, which always run on the main thread, so nothing here locks.
+// They aren't saved, boats join again when they are restored (see Boat::RestoreState)
+
+#ifndef _RELOAD_SERVICE_H_INCLUDED_
+#define _RELOAD_SERVICE_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <unordered_map>
+
+
+class Entity;
+class SpatialGrid;
+
+class ReloadService
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Boats that can reload at a station at once
+	static constexpr int DOCKS = 1;
+
+	// Boats that can wait their turn at a station before boats joining are sent to another station
+	static constexpr int MAX_WAITING = 2;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add a boat to the queue of the station nearest the given point with room, or the nearest station if none has room,
+	// leaving any queue it is in. A docked boat (restored from a checkpoint) joins the nearest station whatever its queue,
+	// ahead of the boats waiting there. Returns the station, nullptr if there are no stations
+	Entity* Join(const SpatialGrid& spatial, EntityID boat, const Vector3& point, bool docked = false);
+
+	// Take a boat out of its station's queue, giving the next boat waiting there its turn. Does nothing if the boat isn't
+	// in a queue
+	void Leave(EntityID boat);
+
+	// Forget a boat or station that is being destroyed. The boats queued at a station are sent their turn, as there is
+	// nothing left to wait for. The EntityManager does this when an entity is destroyed
+	void Remove(EntityID entity);
+
+	// Whether the boat is in a queue but it isn't its turn yet
+	bool IsWaiting(EntityID boat) const;
+
+	// The station the boat is queued at, NO_ID if it isn't in a queue
+	EntityID StationOf(EntityID boat) const;
+
+	// Boats queued at the station, including those docked, for display
+	int QueueLength(EntityID station) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Queue of boats at each station, those with their turn first and in the order they joined. Only stations boats have
+	// joined are listed
+	std::unordered_map<EntityID, std::vector<EntityID>> mQueues;
+
+	// Station each queued boat is at
+	std::unordered_map<EntityID, EntityID> mStations;
+};
+
+
+#endif //_RELOAD_SERVICE_H_INCLUDED_
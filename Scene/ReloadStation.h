@@ -3,11 +3,11 @@
 
 #include "Entity.h"
 
-class ReloadStation : public Entity
+class ReloadStation : public Entity, public TaggedType<ReloadStation, TypeTag::ReloadStation>
 {
 public:
     // Constructor: The entity template, unique ID, initial transform, and optional name are passed in.
-    ReloadStation(EntityTemplate& entityTemplate, EntityID ID, const Matrix4x4& transform = Matrix4x4::Identity, const std::string& name = "")
+    ReloadStation(EntityTemplate& entityTemplate, EntityID ID, const Matrix4x4& transform = Matrix4x4::Identity, Atom name = {})
         : Entity(entityTemplate, ID, transform, name) {}
 };
 
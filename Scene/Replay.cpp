@@ -0,0 +1,426 @@
+//--------------------------------------------------------------------------------------
+// Replays - recording where every moving entity was, and playing it back without the simulation
+//--------------------------------------------------------------------------------------
+
+#include "Replay.h"
+
+#include "EntityManager.h"
+#include "Boat.h"
+#include "Missile.h"
+#include "RandomCrate.h"
+#include "SeaMine.h"
+#include "Shield.h"
+
+#include <algorithm>
+#include <numbers>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+// Start of every replay file, followed by the version. Change the version if the layout changes
+static const char     REPLAY_MAGIC[4] = { 'R', 'P', 'L', 'Y' };
+static const uint32_t REPLAY_VERSION  = 1;
+
+// Quantisation of the poses, positions to 1/32 of a unit (3cm in a scene of metres)
+static constexpr uint32_t POSITION_STEPS = 32;
+static constexpr float    POSITION_LIMIT = float(1 << 26) / POSITION_STEPS; // Well inside the 32 bits coded
+
+static constexpr float ROTATION_SCALE = REPLAY_ROTATION_STEPS / (2 * std::numbers::pi_v<float>);
+
+// Fixed part of the file, see the layout in the header file
+struct ReplayHeader
+{
+	char     magic[4];
+	uint32_t version;
+	float    tickTime;
+	uint32_t positionSteps;
+	uint32_t rotationSteps;
+};
+
+struct ReplayChunkHeader
+{
+	uint32_t firstTick;
+	uint32_t numTicks;
+	uint32_t size;
+};
+
+static_assert(sizeof(ReplayHeader) == 20 && sizeof(ReplayChunkHeader) == 12);
+
+
+/*-----------------------------------------------------------------------------------------
+	Entities
+-----------------------------------------------------------------------------------------*/
+
+// Kind of an entity if it is one that is recorded. Returns false if it isn't (it is part of the level)
+bool ReplayKindOf(Entity* entity, ReplayKind& kind)
+{
+	if      (entity->Is<Boat>())         kind = ReplayKind::Boat;
+	else if (entity->Is<Missile>())      kind = ReplayKind::Missile;
+	else if (entity->Is<RandomCrate>())  kind = ReplayKind::RandomCrate;
+	else if (entity->Is<SeaMine>())      kind = ReplayKind::SeaMine;
+	else if (entity->Is<Shield>())       kind = ReplayKind::Shield;
+	else return false;
+	return true;
+}
+
+
+// The quantised pose of an entity's matrix
+ReplayPose ReplayPoseOf(const Matrix4x4& transform)
+{
+	Vector3 position = transform.Position();
+	Vector3 rotation = transform.GetRotation();
+	const float positions[3] = { position.x, position.y, position.z };
+	const float rotations[3] = { rotation.x, rotation.y, rotation.z };
+	ReplayPose pose;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float clamped = std::clamp(positions[axis], -POSITION_LIMIT, POSITION_LIMIT);
+		pose.values[axis] = static_cast<int32_t>(std::lround(clamped * POSITION_STEPS));
+		pose.values[REPLAY_FIRST_ROTATION + axis] = static_cast<int32_t>(std::lround(rotations[axis] * ROTATION_SCALE)) &
+		                                            (REPLAY_ROTATION_STEPS - 1);
+	}
+	return pose;
+}
+
+
+// The matrix of a recorded pose with the given scale
+Matrix4x4 ReplayPoseMatrix(const ReplayPose& pose, const float scale[3])
+{
+	const int32_t* values = pose.values;
+	const int32_t* rotations = values + REPLAY_FIRST_ROTATION;
+	Vector3 position = Vector3(float(values[0]), float(values[1]), float(values[2])) * (1.0f / POSITION_STEPS);
+	Vector3 rotation = Vector3(float(rotations[0]), float(rotations[1]), float(rotations[2])) * (1.0f / ROTATION_SCALE);
+	return Matrix4x4(position, rotation, Vector3{ scale[0], scale[1], scale[2] });
+}
+
+
+// What is needed to create an entity of a recorded kind again
+void DescribeReplayEntity(Entity* entity, ReplayEntityInfo& info)
+{
+	info.templateName = entity->Template().GetType().str();
+	info.name = entity->GetName();
+	Vector3 scale = entity->Transform().GetScale();
+	info.scale[0] = scale.x;
+	info.scale[1] = scale.y;
+	info.scale[2] = scale.z;
+	if      (RandomCrate* crate = TypeCast<RandomCrate>(entity))  info.extra = static_cast<uint32_t>(crate->GetCrateType());
+	else if (Shield* shield = TypeCast<Shield>(entity))           info.extra = shield->GetParentBoatID();
+}
+
+
+// Create an entity of a recorded kind as described, a shield on the given boat. Returns NO_ID if its template doesn't exist
+EntityID CreateReplayEntity(EntityManager& entities, const ReplayEntityInfo& info, const Matrix4x4& transform, EntityID shieldBoat)
+{
+	switch (static_cast<ReplayKind>(info.kind))
+	{
+	case ReplayKind::Boat:
+		return entities.CreateEntity<Boat>(info.templateName, 0.0f, transform, info.name);
+	case ReplayKind::Missile:
+		return entities.CreateEntity<Missile>(info.templateName, transform);
+	case ReplayKind::RandomCrate:
+		return entities.CreateEntity<RandomCrate>(info.templateName, transform, 
+		                                         static_cast<CrateType>(std::min(info.extra, static_cast<uint32_t>(CrateType::Shield))));
+	case ReplayKind::SeaMine:
+		return entities.CreateEntity<SeaMine>(info.templateName, transform);
+	case ReplayKind::Shield:
+		return entities.CreateEntity<Shield>(info.templateName, transform, shieldBoat);
+	}
+	return NO_ID;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Recording
+-----------------------------------------------------------------------------------------*/
+
+// Create the file and write its header. Returns false if the file can't be created
+bool ReplayRecorder::Start(const std::string& fileName)
+{
+	if (!mFile.Open(fileName))  return false;
+
+	ReplayHeader header = {};
+	std::memcpy(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+	header.version       = REPLAY_VERSION;
+	header.tickTime      = TICK_TIME;
+	header.positionSteps = POSITION_STEPS;
+	header.rotationSteps = REPLAY_ROTATION_STEPS;
+	mFile.Write(&header, sizeof(header));
+
+	mEncoder.Reset();
+	mTimeToTick   = 0;
+	mFirstTick    = 0;
+	mBytesWritten = sizeof(header);
+	return true;
+}
+
+
+// Record the entities if a tick has passed. Call after each simulation step with the step's length
+void ReplayRecorder::Update(EntityManager& entities, float stepTime)
+{
+	if (!IsRecording())  return;
+
+	// A tick is recorded by the step that ends nearest its time. Steps longer than a tick record one tick, so the replay
+	// runs faster than the game did through them
+	mTimeToTick -= stepTime;
+	if (mTimeToTick > stepTime * 0.5f)  return;
+	mTimeToTick = std::max(mTimeToTick + TICK_TIME, 0.0f);
+
+	RecordTick(entities);
+	if (mEncoder.NumTicks() == CHUNK_TICKS)  WriteChunk();
+}
+
+
+// Write the last chunk and finish the file. Returns false if anything failed to be written
+bool ReplayRecorder::Stop()
+{
+	if (!IsRecording())  return false;
+	WriteChunk();
+	return mFile.Close();
+}
+
+
+// Code the pose of each recorded entity, as the next tick
+void ReplayRecorder::RecordTick(EntityManager& entities)
+{
+	mSamples.clear();
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		ReplayKind kind;
+		if (!ReplayKindOf(entity, kind))  continue;
+		mSamples.push_back({ entity->GetID(), static_cast<uint32_t>(kind), ReplayPoseOf(entity->Transform()) });
+	}
+
+	mEncoder.EncodeTick(mSamples, [&](EntityID id, ReplayEntityInfo& info) { DescribeReplayEntity(entities.GetEntity(id), info); });
+}
+
+
+// Pass the chunk coded to the writer and start the next
+void ReplayRecorder::WriteChunk()
+{
+	if (mEncoder.NumTicks() == 0)  return;
+
+	mEncoder.Finish();
+	const std::vector<std::byte>& bytes = mEncoder.Bytes();
+	ReplayChunkHeader header = { mFirstTick, mEncoder.NumTicks(), static_cast<uint32_t>(bytes.size()) };
+	mFile.Write(&header, sizeof(header));
+	mFile.Write(bytes.data(), bytes.size());
+
+	mBytesWritten += sizeof(header) + bytes.size();
+	mFirstTick    += mEncoder.NumTicks();
+	mEncoder.Reset();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Playback
+-----------------------------------------------------------------------------------------*/
+
+// Read the replay in the given file. Returns false with a description of the problem if it can't be read
+bool ReplayPlayer::Open(const std::string& fileName, std::string& error)
+{
+	mData.clear();
+	mChunks.clear();
+	mNumTicks = 0;
+
+	std::FILE* file = std::fopen(fileName.c_str(), "rb");
+	if (file == nullptr)
+	{
+		error = "Can't open " + fileName;
+		return false;
+	}
+	constexpr size_t READ_SIZE = 256 * 1024;
+	size_t read;
+	do
+	{
+		size_t size = mData.size();
+		mData.resize(size + READ_SIZE);
+		read = std::fread(mData.data() + size, 1, READ_SIZE, file);
+		mData.resize(size + read);
+	} while (read == READ_SIZE);
+	std::fclose(file);
+
+	ReplayHeader header = {};
+	if (mData.size() >= sizeof(header))  std::memcpy(&header, mData.data(), sizeof(header));
+	if (std::memcmp(header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0)
+	{
+		error = fileName + " is not a replay";
+		return false;
+	}
+	if (header.version != REPLAY_VERSION || header.positionSteps != POSITION_STEPS ||
+	    header.rotationSteps != REPLAY_ROTATION_STEPS || !(header.tickTime > 0))
+	{
+		error = fileName + " was recorded by a different version";
+		return false;
+	}
+	mTickTime = header.tickTime;
+
+	// Find the chunks, each must follow on from the last. A chunk cut short (e.g. the game stopped while writing it) ends
+	// the replay
+	size_t offset = sizeof(header);
+	ReplayChunkHeader chunk;
+	while (mData.size() - offset >= sizeof(chunk))
+	{
+		std::memcpy(&chunk, mData.data() + offset, sizeof(chunk));
+		offset += sizeof(chunk);
+		if (chunk.firstTick != mNumTicks || chunk.numTicks == 0 || chunk.size > mData.size() - offset)  break;
+		mChunks.push_back({ chunk.firstTick, chunk.numTicks, offset, chunk.size });
+		mNumTicks += chunk.numTicks;
+		offset += chunk.size;
+	}
+	if (mNumTicks == 0)
+	{
+		error = fileName + " has nothing recorded";
+		return false;
+	}
+	return true;
+}
+
+
+// Replace the game's entities of the kinds recorded with those of the replay from the next Apply
+void ReplayPlayer::Begin(EntityManager& entities)
+{
+	ReplayKind kind;
+	for (Entity* entity : entities.GetAllEntities())
+	{
+		if (ReplayKindOf(entity, kind))  entities.DestroyEntity(entity->GetID());
+	}
+	mCreated.clear();
+	mDecoder.Clear();
+	mTick = -1;
+	mAppliedTick = -1;
+	mDamaged = false;
+	Seek(0);
+}
+
+
+// Destroy the entities the replay created
+void ReplayPlayer::End(EntityManager& entities)
+{
+	for (const auto& created : mCreated)
+	{
+		if (created.second.id != NO_ID)  entities.DestroyEntity(created.second.id);
+	}
+	mCreated.clear();
+}
+
+
+// Move to the given time, decoding from the start of its chunk if it is earlier than the last tick decoded or more than a
+// chunk later
+bool ReplayPlayer::Seek(float time)
+{
+	mTime = std::clamp(time, 0.0f, Duration());
+	uint32_t tick = std::min(static_cast<uint32_t>(std::ceil(mTime / mTickTime)), mNumTicks - 1);
+	return DecodeTo(tick);
+}
+
+
+// Create, destroy and move the entities to match the replay at the current time
+void ReplayPlayer::Apply(EntityManager& entities)
+{
+	// The matrices only change when a tick has been decoded, otherwise only new entities need to be set up
+	++mApplyCount;
+	bool newTick = mTick != mAppliedTick;
+	mAppliedTick = mTick;
+
+	for (const ReplayTickDecoder::Entity& recorded : mDecoder.Entities())
+	{
+		auto found = mCreated.find(recorded.id);
+		bool isNew = found == mCreated.end();
+		if (!isNew)
+		{
+			found->second.applied = mApplyCount;
+			if (!newTick || found->second.id == NO_ID)  continue;
+		}
+
+		// The matrix from the tick before is set as the previous one to blend from, see Blend
+		Matrix4x4 previous = ReplayPoseMatrix(recorded.previous, recorded.info.scale);
+		EntityID id;
+		if (isNew)
+		{
+			id = CreateEntity(entities, recorded, previous);
+			mCreated[recorded.id] = { id, mApplyCount }; // Not tried again if it can't be created
+			if (id == NO_ID)  continue;
+		}
+		else
+		{
+			id = found->second.id;
+		}
+		Entity* entity = entities.GetEntity(id);
+		entity->Transform() = previous;
+		entities.Transforms().ResetPreviousRoot(EntityIndex(id));
+		entity->Transform() = ReplayPoseMatrix(recorded.pose, recorded.info.scale);
+	}
+
+	// Those the replay no longer has
+	std::erase_if(mCreated, [&](const auto& created)
+	{
+		if (created.second.applied == mApplyCount)  return false;
+		if (created.second.id != NO_ID)  entities.DestroyEntity(created.second.id);
+		return true;
+	});
+}
+
+
+// How far between the ticks either side of the current time, 0 to 1, to blend the entities' matrices with when rendering
+float ReplayPlayer::Blend()
+{
+	if (mTick <= 0)  return 1.0f;
+	float untilTick = mTick * mTickTime - mTime;
+	return std::clamp(1.0f - untilTick / mTickTime, 0.0f, 1.0f);
+}
+
+
+// Decode ticks until the given one has been decoded
+bool ReplayPlayer::DecodeTo(uint32_t tick)
+{
+	if (mDamaged)  return false;
+
+	// Going back, or far enough forward that it is quicker to start from the chunk, begins again from the start of the chunk.
+	// The entities decoded before are forgotten so nothing blends from where it was at another time
+	size_t chunk = ChunkOf(tick);
+	if (mTick < 0 || tick < mTick || chunk > mChunk + 1)
+	{
+		mChunk = chunk;
+		mDecoder.Clear();
+		mDecoder.Begin(mData.data() + mChunks[chunk].offset, mChunks[chunk].size);
+		mTick = static_cast<int64_t>(mChunks[chunk].firstTick) - 1;
+	}
+
+	while (mTick < tick)
+	{
+		if (mTick + 1 >= mChunks[mChunk].firstTick + mChunks[mChunk].numTicks)
+		{
+			++mChunk;
+			mDecoder.Begin(mData.data() + mChunks[mChunk].offset, mChunks[mChunk].size);
+		}
+		if (!mDecoder.DecodeTick())
+		{
+			mDamaged = true;
+			return false;
+		}
+		++mTick;
+	}
+	return true;
+}
+
+
+// Chunk holding the given tick
+size_t ReplayPlayer::ChunkOf(uint32_t tick)
+{
+	auto after = std::upper_bound(mChunks.begin(), mChunks.end(), tick, [](uint32_t tick, const Chunk& chunk) { return tick < chunk.firstTick; });
+	return static_cast<size_t>(after - mChunks.begin()) - 1;
+}
+
+
+// Create a replay entity as it was recorded. Returns NO_ID if its template doesn't exist
+EntityID ReplayPlayer::CreateEntity(EntityManager& entities, const ReplayTickDecoder::Entity& recorded, const Matrix4x4& transform)
+{
+	EntityID shieldBoat = NO_ID;
+	if (static_cast<ReplayKind>(recorded.info.kind) == ReplayKind::Shield)
+	{
+		auto parent = mCreated.find(recorded.info.extra);
+		if (parent != mCreated.end())  shieldBoat = parent->second.id;
+	}
+	return CreateReplayEntity(entities, recorded.info, transform, shieldBoat);
+}
@@ -0,0 +1,201 @@
+//--------------------------------------------------------------------------------------
+// Replays - recording where every moving entity was, and playing it back without the simulation
+//--------------------------------------------------------------------------------------
+// While recording, the boats, missiles, crates, mines and shields (the kinds a checkpoint saves, the rest of the level never
+// moves) are looked at every TICK_TIME seconds of game time. Each one's position and rotation are quantised, to 1/32 of a
+// unit and 1/4096 of a turn, and coded with the entities that appeared and disappeared since the last tick (see
+// ReplayStream.h). Ticks are coded in chunks of CHUNK_TICKS, and each finished chunk is handed to a background thread to
+// write (see AsyncFileWriter), so recording costs the game a little coding each tick and no waiting for the disk.
+//
+// Playing back reads the whole file, which is small, and decodes ticks as the replay time passes. Apply creates, destroys
+// and moves the entities to match, leaving everything else untouched, so boats are shown without their AI, physics or
+// messages running. The poses are set for the two ticks either side of the replay time and blended between them when
+// rendering (see TransformStore::BlendRoots), so the replay is smooth at any speed. Each chunk can be decoded on its own, so
+// seeking only decodes from the start of the chunk holding the time sought.
+//
+// Only the root matrix of each entity is recorded. The other nodes (e.g. a boat's gun turret) stay as the entity's
+// constructor left them, and an entity's scale is the one it had when first recorded in a chunk.
+//
+//   ReplayRecorder recorder;
+//   recorder.Start("Replay.bin");
+//   ... recorder.Update(*gEntityManager, stepTime); after each simulation step
+//   recorder.Stop();
+//
+//   ReplayPlayer player;
+//   player.Open("Replay.bin", error);
+//   player.Begin(*gEntityManager);
+//   ... player.Seek(player.Time() + frameTime * speed); player.Apply(*gEntityManager); each frame
+//   player.End(*gEntityManager);
+//
+// File layout, all values little-endian as written by the game:
+//   Header: "RPLY", version (uint32), tick time (float), position steps per unit (uint32), rotation steps per turn (uint32)
+//   Chunk:  first tick (uint32), number of ticks (uint32), size in bytes (uint32), then the range coded ticks
+
+#ifndef _REPLAY_H_INCLUDED_
+#define _REPLAY_H_INCLUDED_
+
+#include "ReplayStream.h"
+#include "AsyncFileWriter.h"
+#include "EntityTypes.h"
+#include "Matrix4x4.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <stdint.h>
+
+
+class EntityManager;
+class Entity;
+
+// Kinds of entity recorded, the kind of a ReplaySample
+enum class ReplayKind : uint32_t
+{
+	Boat,
+	Missile,
+	RandomCrate,
+	SeaMine,
+	Shield,
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Entities
+-----------------------------------------------------------------------------------------*/
+// Shared with the network snapshots, see Network.h
+
+// Kind of an entity if it is one that is recorded. Returns false if it isn't (it is part of the level)
+bool ReplayKindOf(Entity* entity, ReplayKind& kind);
+
+// The quantised pose of an entity's matrix
+ReplayPose ReplayPoseOf(const Matrix4x4& transform);
+
+// The matrix of a recorded pose with the given scale
+Matrix4x4 ReplayPoseMatrix(const ReplayPose& pose, const float scale[3]);
+
+// What is needed to create an entity of a recorded kind again
+void DescribeReplayEntity(Entity* entity, ReplayEntityInfo& info);
+
+// Create an entity of a recorded kind as described, a shield on the given boat. Returns NO_ID if its template doesn't exist
+EntityID CreateReplayEntity(EntityManager& entities, const ReplayEntityInfo& info, const Matrix4x4& transform, EntityID shieldBoat);
+
+
+/*-----------------------------------------------------------------------------------------
+	Recording
+-----------------------------------------------------------------------------------------*/
+
+class ReplayRecorder
+{
+public:
+	static constexpr float    TICK_TIME   = 1.0f / 20; // Seconds of game time between ticks
+	static constexpr uint32_t CHUNK_TICKS = 600;       // Ticks in each chunk, 30 seconds
+
+	// Create the file and write its header. Returns false if the file can't be created. The first tick is recorded by the
+	// next Update
+	bool Start(const std::string& fileName);
+
+	// Record the entities if a tick has passed. Call after each simulation step with the step's length
+	void Update(EntityManager& entities, float stepTime);
+
+	// Write the last chunk and finish the file. Returns false if anything failed to be written
+	bool Stop();
+
+	bool IsRecording()  { return mFile.IsOpen(); }
+
+	// Ticks recorded and bytes written so far, for display
+	uint32_t TicksRecorded()  { return mFirstTick + mEncoder.NumTicks(); }
+	uint64_t BytesWritten()   { return mBytesWritten; }
+
+private:
+	// Code the pose of each recorded entity, as the next tick
+	void RecordTick(EntityManager& entities);
+
+	// Pass the chunk coded to the writer and start the next
+	void WriteChunk();
+
+	AsyncFileWriter   mFile;
+	ReplayTickEncoder mEncoder;
+	std::vector<ReplaySample> mSamples;
+	float    mTimeToTick   = 0;
+	uint32_t mFirstTick    = 0; // Of the chunk being coded
+	uint64_t mBytesWritten = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Playback
+-----------------------------------------------------------------------------------------*/
+
+class ReplayPlayer
+{
+public:
+	// Read the replay in the given file. Returns false with a description of the problem if the file can't be read or isn't
+	// a replay from this version of the game
+	bool Open(const std::string& fileName, std::string& error);
+
+	// Replace the game's entities of the kinds recorded with those of the replay from the next Apply. Call on the main thread
+	// outside UpdateAll
+	void Begin(EntityManager& entities);
+
+	// Destroy the entities the replay created
+	void End(EntityManager& entities);
+
+	// Move to the given time, decoding from the start of its chunk if it is earlier than the last tick decoded or more than a
+	// chunk later. Times outside the replay are moved to its start or end. Returns false if the replay is found to be damaged,
+	// playback stays where it got to
+	bool Seek(float time);
+
+	// Create, destroy and move the entities to match the replay at the current time. Entities whose template doesn't exist
+	// are left out. Call on the main thread outside UpdateAll
+	void Apply(EntityManager& entities);
+
+	// How far between the ticks either side of the current time, 0 to 1, to blend the entities' matrices with when rendering
+	float Blend();
+
+	float Time()      { return mTime; }
+	float Duration()  { return mNumTicks > 0 ? (mNumTicks - 1) * mTickTime : 0.0f; }
+	size_t EntityCount()  { return mDecoder.Entities().size(); }
+
+private:
+	struct Chunk
+	{
+		uint32_t firstTick;
+		uint32_t numTicks;
+		size_t   offset;
+		size_t   size;
+	};
+
+	// Decode ticks until the given one has been decoded
+	bool DecodeTo(uint32_t tick);
+
+	// Chunk holding the given tick
+	size_t ChunkOf(uint32_t tick);
+
+	// Create a replay entity as it was recorded. Returns NO_ID if its template doesn't exist
+	EntityID CreateEntity(EntityManager& entities, const ReplayTickDecoder::Entity& recorded, const Matrix4x4& transform);
+
+	std::vector<std::byte> mData;
+	std::vector<Chunk>     mChunks;
+	uint32_t mNumTicks = 0;
+	float    mTickTime = ReplayRecorder::TICK_TIME;
+
+	ReplayTickDecoder mDecoder;
+	size_t  mChunk = 0;     // Being decoded
+	int64_t mTick  = -1;    // Last decoded, -1 before the first
+	float   mTime  = 0;
+	int64_t mAppliedTick = -1;
+	bool    mDamaged = false; // Decoding stopped at damaged data
+
+	// The entity created for each recorded entity, and the Apply that last found it in the replay
+	struct Created
+	{
+		EntityID id;
+		uint32_t applied;
+	};
+	std::unordered_map<EntityID, Created> mCreated;
+	uint32_t mApplyCount = 0;
+};
+
+
+#endif //_REPLAY_H_INCLUDED_
@@ -0,0 +1,435 @@
+//--------------------------------------------------------------------------------------
+// Replay stream - compact coding of entity poses and lifetimes, tick by tick
+//--------------------------------------------------------------------------------------
+
+#include "ReplayStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+// Most entities appearing in a tick accepted when decoding, so a damaged count can't cause a huge allocation
+static constexpr int32_t MAX_NEW_ENTITIES = 65536;
+
+static constexpr uint32_t MAX_STRING_LENGTH = 255;
+
+
+// Rotations wrap around, so a rotation just below a whole turn is next to 0
+static int32_t WrapRotation(int32_t rotation)
+{
+	return rotation & (REPLAY_ROTATION_STEPS - 1);
+}
+
+// Prediction of a pose value from the last value and the change before it
+static int32_t Predict(int channel, int32_t last, int32_t change)
+{
+	return channel >= REPLAY_FIRST_ROTATION ? WrapRotation(last + change) : last + change;
+}
+
+// Difference between two pose values, for rotations the shortest way round
+static int32_t Difference(int channel, int32_t to, int32_t from)
+{
+	if (channel < REPLAY_FIRST_ROTATION)  return to - from;
+	int32_t difference = WrapRotation(to - from);
+	return difference >= REPLAY_ROTATION_STEPS / 2 ? difference - REPLAY_ROTATION_STEPS : difference;
+}
+
+// Model used for a pose value, chosen by the sign of its previous error
+static AdaptiveInteger& PoseModel(ReplayModels& models, uint32_t kind, int channel, int32_t previousError)
+{
+	return models.poses[kind % REPLAY_MAX_KINDS][channel][previousError < 0 ? 0 : (previousError == 0 ? 1 : 2)];
+}
+
+
+// Code a string of up to 255 bytes
+static void EncodeString(RangeEncoder& encoder, ReplayModels& models, const std::string& text)
+{
+	models.lengths.Encode(encoder, static_cast<int32_t>(text.size()));
+	for (char c : text)  models.characters.Encode(encoder, static_cast<uint8_t>(c));
+}
+
+// Decode a string of up to 255 bytes. Returns false if the length is damaged
+static bool DecodeString(RangeDecoder& decoder, ReplayModels& models, std::string& text)
+{
+	int32_t length = models.lengths.Decode(decoder);
+	if (length < 0 || length > static_cast<int32_t>(MAX_STRING_LENGTH))  return false;
+	text.resize(length);
+	for (char& c : text)  c = static_cast<char>(models.characters.Decode(decoder));
+	return true;
+}
+
+
+// Code the ID and details of a new entity. IDs are mostly handed out in order, and the other details are mostly those of the
+// last entity of the kind
+static void EncodeNewEntity(RangeEncoder& encoder, ReplayModels& models, EntityID id, ReplayEntityInfo& info)
+{
+	info.kind = info.kind % REPLAY_MAX_KINDS;
+	info.templateName.resize(std::min(info.templateName.size(), size_t(MAX_STRING_LENGTH)));
+	info.name.resize(std::min(info.name.size(), size_t(MAX_STRING_LENGTH)));
+
+	models.ids.Encode(encoder, static_cast<int32_t>(id - models.lastID));
+	models.lastID = id;
+	models.kinds.Encode(encoder, info.kind);
+	ReplayEntityInfo& last = models.lastNew[info.kind];
+	bool sameTemplate = info.templateName == last.templateName;
+	bool sameName     = info.name == last.name;
+	bool sameScale    = std::memcmp(info.scale, last.scale, sizeof(info.scale)) == 0;
+	encoder.Encode(models.sameTemplate[info.kind], sameTemplate ? 1 : 0);
+	if (!sameTemplate)  EncodeString(encoder, models, info.templateName);
+	encoder.Encode(models.sameName[info.kind], sameName ? 1 : 0);
+	if (!sameName)  EncodeString(encoder, models, info.name);
+	encoder.Encode(models.sameScale[info.kind], sameScale ? 1 : 0);
+	if (!sameScale)
+	{
+		for (float scale : info.scale)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &scale, sizeof(bits));
+			encoder.EncodeDirect(bits, 32);
+		}
+	}
+	models.extras[info.kind].Encode(encoder, static_cast<int32_t>(info.extra - last.extra));
+	last = info;
+}
+
+// Decode the ID and details of a new entity. Returns false if they are damaged
+static bool DecodeNewEntity(RangeDecoder& decoder, ReplayModels& models, EntityID& id, ReplayEntityInfo& info)
+{
+	id = models.lastID + static_cast<uint32_t>(models.ids.Decode(decoder));
+	models.lastID = id;
+	if (id == NO_ID)  return false;
+
+	uint32_t kind = models.kinds.Decode(decoder);
+	ReplayEntityInfo& last = models.lastNew[kind];
+	info = last;
+	info.kind = kind;
+	if (!decoder.Decode(models.sameTemplate[info.kind]) && !DecodeString(decoder, models, info.templateName))  return false;
+	if (!decoder.Decode(models.sameName[info.kind]) && !DecodeString(decoder, models, info.name))  return false;
+	if (!decoder.Decode(models.sameScale[info.kind]))
+	{
+		for (float& scale : info.scale)
+		{
+			uint32_t bits = decoder.DecodeDirect(32);
+			std::memcpy(&scale, &bits, sizeof(bits));
+		}
+	}
+	info.extra = last.extra + static_cast<uint32_t>(models.extras[info.kind].Decode(decoder));
+	last = info;
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Encoding
+-----------------------------------------------------------------------------------------*/
+
+// Code the pose of every entity at the next tick, in any order
+void ReplayTickEncoder::EncodeTick(const std::vector<ReplaySample>& samples, const DescribeEntity& describe)
+{
+	mSampleIndex.clear();
+	for (uint32_t i = 0; i < samples.size(); ++i)  mSampleIndex[samples[i].id] = i;
+
+	// Entities gone, as the gaps between their positions in the list
+	int32_t numGone = 0;
+	for (const Tracked& tracked : mTracked)  numGone += mSampleIndex.contains(tracked.id) ? 0 : 1;
+	mModels.counts.Encode(mEncoder, numGone);
+	if (numGone > 0)
+	{
+		uint32_t next = 0;
+		for (uint32_t i = 0; i < mTracked.size(); ++i)
+		{
+			if (mSampleIndex.contains(mTracked[i].id))  continue;
+			mModels.gaps.Encode(mEncoder, static_cast<int32_t>(i - next));
+			next = i + 1;
+			mTrackedIndex.erase(mTracked[i].id);
+		}
+		std::erase_if(mTracked, [&](const Tracked& tracked) { return !mSampleIndex.contains(tracked.id); });
+		for (uint32_t i = 0; i < mTracked.size(); ++i)  mTrackedIndex[mTracked[i].id] = i;
+	}
+
+	// New entities, with what is needed to create them
+	int32_t numNew = 0;
+	for (const ReplaySample& sample : samples)  numNew += mTrackedIndex.contains(sample.id) ? 0 : 1;
+	mModels.counts.Encode(mEncoder, numNew);
+	ReplayEntityInfo info;
+	for (const ReplaySample& sample : samples)
+	{
+		if (mTrackedIndex.contains(sample.id))  continue;
+		info = ReplayEntityInfo();
+		describe(sample.id, info);
+		info.kind = sample.kind;
+		EncodeNewEntity(mEncoder, mModels, sample.id, info);
+
+		mTrackedIndex[sample.id] = static_cast<uint32_t>(mTracked.size());
+		mTracked.push_back({ sample.id, sample.kind, {}, {}, {}, true });
+	}
+
+	// Then the poses, as the errors of the predictions
+	for (Tracked& tracked : mTracked)
+	{
+		const ReplayPose& pose = samples[mSampleIndex[tracked.id]].pose;
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			int32_t value = pose.values[channel];
+			int32_t last  = tracked.last.values[channel];
+			int32_t error = tracked.isNew ? value : Difference(channel, value, Predict(channel, last, tracked.change.values[channel]));
+			PoseModel(mModels, tracked.kind, channel, tracked.error.values[channel]).Encode(mEncoder, error);
+			tracked.change.values[channel] = tracked.isNew ? 0 : Difference(channel, value, last);
+			tracked.error.values[channel]  = tracked.isNew ? 0 : error;
+			tracked.last.values[channel]   = value;
+		}
+		tracked.isNew = false;
+	}
+	++mNumTicks;
+}
+
+
+// Start a new chunk, with every entity new and the models learning from scratch
+void ReplayTickEncoder::Reset()
+{
+	mEncoder.Reset();
+	mTracked.clear();
+	mTrackedIndex.clear();
+	mNumTicks = 0;
+	mModels = ReplayModels();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Decoding
+-----------------------------------------------------------------------------------------*/
+
+// Start decoding a chunk. Entities decoded from the previous chunk are kept until the first tick of the new chunk
+void ReplayTickDecoder::Begin(const std::byte* data, size_t size)
+{
+	mDecoder = RangeDecoder(data, size);
+	mModels = ReplayModels();
+	mChunkStart = true;
+}
+
+
+// Decode the next tick of the chunk. Returns false if the data is found to be damaged
+bool ReplayTickDecoder::DecodeTick()
+{
+	// The first tick of a chunk has every entity new. Those also in the last tick of the previous chunk are given their
+	// pose from then as their previous pose
+	std::vector<Entity> lastChunk;
+	if (mChunkStart)
+	{
+		lastChunk = std::move(mEntities);
+		mEntities.clear();
+		mChunkStart = false;
+	}
+
+	int32_t numGone = mModels.counts.Decode(mDecoder);
+	if (numGone < 0 || numGone > static_cast<int32_t>(mEntities.size()))  return false;
+	if (numGone > 0)
+	{
+		uint32_t next = 0;
+		for (int32_t i = 0; i < numGone; ++i)
+		{
+			int32_t gap = mModels.gaps.Decode(mDecoder);
+			if (gap < 0 || next + gap >= mEntities.size())  return false;
+			mEntities[next + gap].id = NO_ID; // Marks it as gone, real entities never have this ID
+			next += gap + 1;
+		}
+		std::erase_if(mEntities, [](const Entity& entity) { return entity.id == NO_ID; });
+	}
+
+	int32_t numNew = mModels.counts.Decode(mDecoder);
+	if (numNew < 0 || numNew > MAX_NEW_ENTITIES)  return false;
+	for (int32_t i = 0; i < numNew; ++i)
+	{
+		Entity entity = {};
+		if (!DecodeNewEntity(mDecoder, mModels, entity.id, entity.info))  return false;
+		entity.isNew = true;
+		mEntities.push_back(std::move(entity));
+	}
+
+	for (Entity& entity : mEntities)
+	{
+		entity.previous = entity.pose;
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			int32_t error = PoseModel(mModels, entity.info.kind, channel, entity.error.values[channel]).Decode(mDecoder);
+			int32_t last  = entity.pose.values[channel];
+			int32_t value;
+			if (entity.isNew)
+			{
+				value = channel >= REPLAY_FIRST_ROTATION ? WrapRotation(error) : error;
+				entity.change.values[channel] = 0;
+				entity.error.values[channel]  = 0;
+			}
+			else
+			{
+				value = Predict(channel, last, entity.change.values[channel]) + error;
+				if (channel >= REPLAY_FIRST_ROTATION)  value = WrapRotation(value);
+				entity.change.values[channel] = Difference(channel, value, last);
+				entity.error.values[channel]  = error;
+			}
+			entity.pose.values[channel] = value;
+		}
+		if (entity.isNew)  entity.previous = entity.pose;
+		entity.isNew = false;
+	}
+
+	// Entities carried on from the last chunk
+	if (!lastChunk.empty())
+	{
+		std::unordered_map<EntityID, const Entity*> lastPoses;
+		for (const Entity& entity : lastChunk)  lastPoses[entity.id] = &entity;
+		for (Entity& entity : mEntities)
+		{
+			auto last = lastPoses.find(entity.id);
+			if (last != lastPoses.end())  entity.previous = last->second->pose;
+		}
+	}
+	return !mDecoder.IsOverrun();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Snapshots
+-----------------------------------------------------------------------------------------*/
+
+// Code a snapshot as its changes from the baseline, or in full if the baseline is nullptr
+void ReplaySnapshotEncoder::Encode(const ReplaySnapshot& snapshot, const ReplaySnapshot* baseline)
+{
+	mEncoder.Reset();
+	mModels = ReplayModels();
+
+	// Both lists are sorted by ID, so one pass over them finds the entities gone, changed and new
+	static const std::vector<ReplaySnapshotEntity> noEntities;
+	const std::vector<ReplaySnapshotEntity>& base = baseline != nullptr ? baseline->entities : noEntities;
+	mGone.clear();
+	mChanged.clear();
+	mChangedTo.clear();
+	mNew.clear();
+	uint32_t b = 0;
+	for (uint32_t i = 0; i < snapshot.entities.size(); ++i)
+	{
+		EntityID id = snapshot.entities[i].id;
+		while (b < base.size() && base[b].id < id)  mGone.push_back(b++);
+		if (b < base.size() && base[b].id == id)
+		{
+			if (std::memcmp(&base[b].pose, &snapshot.entities[i].pose, sizeof(ReplayPose)) != 0)
+			{
+				mChanged.push_back(b);
+				mChangedTo.push_back(i);
+			}
+			++b;
+		}
+		else
+		{
+			mNew.push_back(i);
+		}
+	}
+	while (b < base.size())  mGone.push_back(b++);
+
+	// Entities gone and changed, as the gaps between their positions in the baseline
+	for (const std::vector<uint32_t>* positions : { &mGone, &mChanged })
+	{
+		mModels.counts.Encode(mEncoder, static_cast<int32_t>(positions->size()));
+		uint32_t next = 0;
+		for (uint32_t position : *positions)
+		{
+			mModels.gaps.Encode(mEncoder, static_cast<int32_t>(position - next));
+			next = position + 1;
+		}
+	}
+
+	// The changes, each value's model chosen by the sign of the change to the value before it (a boat moving on x is
+	// usually turning and moving on z as well)
+	for (size_t i = 0; i < mChanged.size(); ++i)
+	{
+		const ReplaySnapshotEntity& from = base[mChanged[i]];
+		const ReplayPose& pose = snapshot.entities[mChangedTo[i]].pose;
+		int32_t previous = 0;
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			int32_t change = Difference(channel, pose.values[channel], from.pose.values[channel]);
+			PoseModel(mModels, from.info.kind, channel, previous).Encode(mEncoder, change);
+			previous = change;
+		}
+	}
+
+	// New entities, with what is needed to create them and their pose as it is
+	mModels.counts.Encode(mEncoder, static_cast<int32_t>(mNew.size()));
+	ReplayEntityInfo info;
+	for (uint32_t position : mNew)
+	{
+		const ReplaySnapshotEntity& entity = snapshot.entities[position];
+		info = entity.info;
+		EncodeNewEntity(mEncoder, mModels, entity.id, info);
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			PoseModel(mModels, info.kind, channel, 0).Encode(mEncoder, entity.pose.values[channel]);
+		}
+	}
+	mEncoder.Finish();
+}
+
+
+// Decode a snapshot coded against the given baseline, replacing the entities of the snapshot given
+bool ReplaySnapshotDecoder::Decode(const std::byte* data, size_t size, const ReplaySnapshot* baseline, ReplaySnapshot& snapshot)
+{
+	enum : uint8_t { Same, Gone, Changed };
+
+	RangeDecoder decoder(data, size);
+	mModels = ReplayModels();
+	snapshot.entities.clear();
+
+	static const std::vector<ReplaySnapshotEntity> noEntities;
+	const std::vector<ReplaySnapshotEntity>& base = baseline != nullptr ? baseline->entities : noEntities;
+	mState.assign(base.size(), Same);
+	for (uint8_t state : { Gone, Changed })
+	{
+		int32_t count = mModels.counts.Decode(decoder);
+		if (count < 0 || count > static_cast<int32_t>(base.size()))  return false;
+		uint32_t next = 0;
+		for (int32_t i = 0; i < count; ++i)
+		{
+			int32_t gap = mModels.gaps.Decode(decoder);
+			if (gap < 0 || next + gap >= base.size() || mState[next + gap] != Same)  return false;
+			mState[next + gap] = state;
+			next += gap + 1;
+		}
+	}
+
+	// The entities kept from the baseline, in its order, with their changes
+	for (size_t b = 0; b < base.size(); ++b)
+	{
+		if (mState[b] == Gone)  continue;
+		snapshot.entities.push_back(base[b]);
+		if (mState[b] != Changed)  continue;
+
+		ReplayPose& pose = snapshot.entities.back().pose;
+		int32_t previous = 0;
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			int32_t change = PoseModel(mModels, base[b].info.kind, channel, previous).Decode(decoder);
+			int32_t value  = pose.values[channel] + change;
+			pose.values[channel] = channel >= REPLAY_FIRST_ROTATION ? WrapRotation(value) : value;
+			previous = change;
+		}
+	}
+
+	// New entities are coded in ID order, so merging them with the kept ones leaves the list sorted by ID
+	int32_t numNew = mModels.counts.Decode(decoder);
+	if (numNew < 0 || numNew > MAX_NEW_ENTITIES)  return false;
+	size_t numKept = snapshot.entities.size();
+	for (int32_t i = 0; i < numNew; ++i)
+	{
+		ReplaySnapshotEntity entity = {};
+		if (!DecodeNewEntity(decoder, mModels, entity.id, entity.info))  return false;
+		for (int channel = 0; channel < REPLAY_CHANNELS; ++channel)
+		{
+			int32_t value = PoseModel(mModels, entity.info.kind, channel, 0).Decode(decoder);
+			entity.pose.values[channel] = channel >= REPLAY_FIRST_ROTATION ? WrapRotation(value) : value;
+		}
+		snapshot.entities.push_back(std::move(entity));
+	}
+	auto byID = [](const ReplaySnapshotEntity& a, const ReplaySnapshotEntity& b) { return a.id < b.id; };
+	std::inplace_merge(snapshot.entities.begin(), snapshot.entities.begin() + numKept, snapshot.entities.end(), byID);
+	return !decoder.IsOverrun();
+}
@@ -0,0 +1,231 @@
+//--------------------------------------------------------------------------------------
+// Replay stream - compact coding of entity poses and lifetimes, tick by tick
+//--------------------------------------------------------------------------------------
+// A replay is a series of ticks, each holding the pose of every entity recorded at that moment. Poses are quantised to
+// integers (see Replay.h for the scales) and each value is predicted from the entity's previous two ticks, assuming it keeps
+// moving as it was: prediction = last + (last - one before). Only the difference from the prediction is coded, which for
+// boats cruising or turning steadily is zero or close to it, and zero costs a fraction of a bit once the range coder has
+// learnt how common it is (see RangeCoder.h). Each kind of entity has its own models for each value, as a missile's errors
+// are nothing like a mine's, and each of those has three, chosen by the sign of the value's previous error. Rounding to
+// integers leaves errors of +-1 even for steady movement, and these follow a pattern (an error of +1 is usually followed by
+// 0 or -1) that the three models learn.
+//
+// Entities appearing and disappearing are coded at the start of the tick they happen in: the ones gone since the last tick
+// as positions in the list of entities, then the new ones with the details needed to create them again (ReplayEntityInfo).
+// The first pose of a new entity is coded as it is, without a prediction.
+//
+// The coders are reset at the start of each chunk of ticks (see Replay.h), which then starts with every entity new, so a
+// chunk can be decoded without the ones before it.
+//
+// Snapshots code the same poses for a network, where packets are lost and each must decode given only an earlier snapshot
+// the receiver is known to have, its baseline (see Network.h). The entities gone since the baseline and those whose pose
+// changed are coded as gaps between their positions in the baseline, then each change as its difference from the baseline
+// pose, then the new entities as for a tick. An entity that hasn't moved costs nothing, so a snapshot's size follows the
+// number of changes rather than the number of entities. The models start afresh for each snapshot
+
+#ifndef _REPLAY_STREAM_H_INCLUDED_
+#define _REPLAY_STREAM_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "RangeCoder.h"
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include <cstddef>
+#include <stdint.h>
+
+
+/*-----------------------------------------------------------------------------------------
+	Types
+-----------------------------------------------------------------------------------------*/
+
+// Values in an entity's pose: its position x, y and z, then its rotation about x, y and z (see Matrix4x4::GetRotation).
+// Rotations are in steps of 1/4096th of a turn, under a tenth of a degree, from 0 to 4095 and wrapping around
+static constexpr int     REPLAY_CHANNELS       = 6;
+static constexpr int     REPLAY_FIRST_ROTATION = 3;
+static constexpr int32_t REPLAY_ROTATION_STEPS = 4096;
+
+// Kinds of entity are numbered by the user of the stream, below this
+static constexpr uint32_t REPLAY_MAX_KINDS = 8;
+
+struct ReplayPose
+{
+	int32_t values[REPLAY_CHANNELS] = {};
+};
+
+// What is needed to create an entity again, coded when it first appears in a chunk
+struct ReplayEntityInfo
+{
+	uint32_t    kind = 0;  // Taken from the ReplaySample when encoding
+	std::string templateName;
+	std::string name;
+	uint32_t    extra = 0; // Meaning depends on the kind
+	float       scale[3] = { 1, 1, 1 };
+};
+
+// Probabilities learnt by the coders, the same on both sides, with the details of the last new entity of each kind as new
+// entities mostly repeat them (e.g. every missile has the same template and scale). Reset at the start of each chunk
+struct ReplayModels
+{
+	AdaptiveInteger     poses[REPLAY_MAX_KINDS][REPLAY_CHANNELS][3]; // Errors of the predictions, by the previous error's sign
+	AdaptiveInteger     counts;     // Entities gone and new in a tick
+	AdaptiveInteger     gaps;       // Between the positions of entities gone
+	AdaptiveInteger     ids;        // Differences between the IDs of new entities
+	AdaptiveSymbol<3>   kinds;
+	AdaptiveBit         sameTemplate[REPLAY_MAX_KINDS];
+	AdaptiveBit         sameName[REPLAY_MAX_KINDS];
+	AdaptiveBit         sameScale[REPLAY_MAX_KINDS];
+	AdaptiveInteger     extras[REPLAY_MAX_KINDS];
+	AdaptiveInteger     lengths;    // Of strings
+	AdaptiveSymbol<8>   characters;
+
+	EntityID         lastID = NO_ID;
+	ReplayEntityInfo lastNew[REPLAY_MAX_KINDS];
+};
+
+// An entity's pose at a tick, as given to the encoder
+struct ReplaySample
+{
+	EntityID   id;
+	uint32_t   kind;
+	ReplayPose pose;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Encoding
+-----------------------------------------------------------------------------------------*/
+
+class ReplayTickEncoder
+{
+public:
+	// Details of an entity appearing for the first time in the chunk, called by EncodeTick
+	using DescribeEntity = std::function<void(EntityID id, ReplayEntityInfo& info)>;
+
+	// Code the pose of every entity at the next tick, in any order. Entities not in the last tick are new and are described
+	// with the given function, those in the last tick and not in this one are gone
+	void EncodeTick(const std::vector<ReplaySample>& samples, const DescribeEntity& describe);
+
+	// Finish the ticks coded since the last Reset, Bytes then holds them
+	void Finish()  { mEncoder.Finish(); }
+	const std::vector<std::byte>& Bytes() const  { return mEncoder.Bytes(); }
+
+	// Start a new chunk, with every entity new and the models learning from scratch
+	void Reset();
+
+	uint32_t NumTicks() const  { return mNumTicks; }
+
+private:
+	struct Tracked
+	{
+		EntityID   id;
+		uint32_t   kind;
+		ReplayPose last;
+		ReplayPose change;    // From the tick before last
+		ReplayPose error;     // Of the prediction of last
+		bool       isNew;     // Last is the first pose, so there is no change to predict with
+	};
+
+	RangeEncoder mEncoder;
+	std::vector<Tracked> mTracked;
+	std::unordered_map<EntityID, uint32_t> mSampleIndex;
+	std::unordered_map<EntityID, uint32_t> mTrackedIndex;
+	uint32_t mNumTicks = 0;
+	ReplayModels mModels;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Decoding
+-----------------------------------------------------------------------------------------*/
+
+class ReplayTickDecoder
+{
+public:
+	struct Entity
+	{
+		EntityID         id;       // ID when recorded
+		ReplayEntityInfo info;
+		ReplayPose       pose;     // At the last tick decoded
+		ReplayPose       previous; // At the tick before, the same as pose if the entity was new then
+		ReplayPose       change;   // For the prediction, as in the encoder
+		ReplayPose       error;
+		bool             isNew;
+	};
+
+	// Start decoding a chunk. The data must stay valid while it is decoded. Entities decoded from the previous chunk are
+	// kept until the first tick of the new chunk, so entities in both keep their previous pose
+	void Begin(const std::byte* data, size_t size);
+
+	// Forget the entities decoded, so none keep a previous pose from the last chunk, e.g. when seeking
+	void Clear()  { mEntities.clear(); }
+
+	// Decode the next tick of the chunk. Returns false if the data is found to be damaged, then no more ticks should be
+	// decoded from the chunk
+	bool DecodeTick();
+
+	// Every entity at the last tick decoded, in the order they were first seen in the chunk
+	const std::vector<Entity>& Entities() const  { return mEntities; }
+
+private:
+	RangeDecoder mDecoder;
+	std::vector<Entity> mEntities;
+	bool mChunkStart = false;
+	ReplayModels mModels;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Snapshots
+-----------------------------------------------------------------------------------------*/
+
+struct ReplaySnapshotEntity
+{
+	EntityID         id;
+	ReplayEntityInfo info;
+	ReplayPose       pose;
+};
+
+// Every entity at one tick
+struct ReplaySnapshot
+{
+	uint32_t tick = 0;
+	std::vector<ReplaySnapshotEntity> entities; // Sorted by ID
+};
+
+
+class ReplaySnapshotEncoder
+{
+public:
+	// Code a snapshot as its changes from the baseline, or in full if the baseline is nullptr. Bytes then holds it. The tick
+	// isn't coded, the caller sends it with the snapshot
+	void Encode(const ReplaySnapshot& snapshot, const ReplaySnapshot* baseline);
+
+	const std::vector<std::byte>& Bytes() const  { return mEncoder.Bytes(); }
+
+private:
+	RangeEncoder mEncoder;
+	ReplayModels mModels;
+	std::vector<uint32_t> mGone;    // Positions in the baseline
+	std::vector<uint32_t> mChanged; // Positions in the baseline, with the positions in the snapshot in mChangedTo
+	std::vector<uint32_t> mChangedTo;
+	std::vector<uint32_t> mNew;     // Positions in the snapshot
+};
+
+
+class ReplaySnapshotDecoder
+{
+public:
+	// Decode a snapshot coded against the given baseline, which must be nullptr if it was coded in full, replacing the
+	// entities of the snapshot given. Returns false if the data is found to be damaged, the snapshot is then incomplete
+	bool Decode(const std::byte* data, size_t size, const ReplaySnapshot* baseline, ReplaySnapshot& snapshot);
+
+private:
+	ReplayModels mModels;
+	std::vector<uint8_t> mState; // Of each baseline entity while decoding, see Decode
+};
+
+
+#endif //_REPLAY_STREAM_H_INCLUDED_
@@ -18,55 +18,241 @@
 #include "CBufferTypes.h"
 #include "State.h"
 #include "RenderGlobals.h"
+#include "OcclusionCuller.h"
+#include "GpuCuller.h"
+#include "ImpostorRenderer.h"
+#include "ParticleSystem.h"
+#include "ClusteredLights.h"
+#include "ShadowMap.h"
+#include "EnvironmentLighting.h"
+#include "ShaderPrewarm.h"
+#include "Shader.h"
+#include "GpuMissiles.h"
+#include "IdBufferPicker.h"
+#include "RenderGraph.h"
+#include "WaterRenderer.h"
+#include "WorldPartition.h"
+#include "GpuProfiler.h"
+#include "FrameCapture.h"
+#include "RenderCounters.h"
+#include "BonePalette.h"
+#include "DynamicResolution.h"
+#include "HalfResEffects.h"
+#include "WeightedOit.h"
+#include "LabelRenderer.h"
+#include "FloatingTextRenderer.h"
+#include "MessengerBenchmark.h"
+#include "MessageJournal.h"
+#include "Checkpoint.h"
+#include "Replay.h"
+#include "GameAnalytics.h"
+#include "MetricsExporter.h"
+#include "Network.h"
+#include "FlyThrough.h"
+#include "FloatingText.h"
 
 #include "Matrix4x4.h" 
 #include "Vector3.h" 
 #include "ColourTypes.h" 
 #include "Input.h"
+#include "FrameLimiter.h"
+#include "AssetFiles.h"
+#include "StartupProfile.h"
+#include "CpuProfiler.h"
+#include "Timer.h"
+#include "AllocationTracker.h"
+#include "FrameArena.h"
+#include "Logger.h"
+#include "EventTrace.h"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx11.h"
 
+#include <psapi.h> // For GetProcessMemoryInfo
+
 #include <sstream>
 #include <cmath>
 #include <stdexcept>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <chrono>
+#include <thread>
 
 
 //--------------------------------------------------------------------------------------
 // Initialise scene geometry
 //--------------------------------------------------------------------------------------
 
-// Constructs a scene ready to be rendered/updated
-Scene::Scene()
+// Constructs a scene from the given level file ready to be rendered/updated. A headless scene skips everything on the GPU
+Scene::Scene(const std::string& levelFile /*= "Entities.xml"*/, bool headless /*= false*/)
+    : mHeadless(headless)
 {
+    StartupTimer startupTimer("Scene");
+
+    // The control panel builds its text every frame, so allocating there doesn't fail steady state allocation asserts
+    gAllocationTracker.ExemptFromAssert("ImGui");
+
     // Create the global constant buffers used by this app
-    if (!CreateCBuffers())  throw std::runtime_error("Error creating constant buffers");
+    if (!mHeadless && !CreateCBuffers())  throw std::runtime_error("Error creating constant buffers");
 
     // Create entity manager and messenger prior to any entities
     gEntityManager = std::make_unique<EntityManager>();
 	gMessenger     = std::make_unique<Messenger>();
 
-    // Initialise SpriteFont helper library for text drawing
-    mSpriteBatch = std::make_unique<DirectX::DX11::SpriteBatch>(DX->Context());
-	mSmallFont   = std::make_unique<DirectX::DX11::SpriteFont>(DX->Device(), L"tahoma12.spritefont");
-	mMediumFont  = std::make_unique<DirectX::DX11::SpriteFont>(DX->Device(), L"tahoma16.spritefont");
+    // The boat labels are rebuilt when these events change what they show (see MarkChangedBoatLabels), and they are the
+    // events recorded by the gameplay analytics
+    gMessenger->Observe(MessageType::Hit);
+    gMessenger->Observe(MessageType::MineHit);
+    gMessenger->Observe(MessageType::CrateCollected);
+
+    // Update suitable entities on worker threads (see Entity::CanUpdateInParallel). The job system may already have been
+    // created to read the level ahead (see ParseLevel::Preload)
+    if (!gJobSystem)  gJobSystem = std::make_unique<JobSystem>();
+    gEntityManager->SetJobSystem(gJobSystem.get());
+
+    // Rendering resources, none for a headless scene
+    if (!mHeadless)
+    {
+        // Occlusion culling for moving entities, the proxies it draws use the constant buffers created above
+        mOcclusionCuller = std::make_unique<OcclusionCuller>();
+        mIdPicker        = std::make_unique<IdBufferPicker>();
+        mRenderGraph     = std::make_unique<RenderGraph>();
+
+        // Renders the scene at a reduced resolution when the GPU is over budget, enabled from the control panel
+        mDynamicResolution = std::make_unique<DynamicResolution>();
+
+        mFrameLimiter = std::make_unique<FrameLimiter>();
+
+        // GPU culling is optional, without it instanced entities are frustum culled on the CPU
+        try {
+            mGpuCuller = std::make_unique<GpuCuller>();
+            gEntityManager->SetGpuCuller(mGpuCuller.get());
+        }
+        catch (const std::runtime_error&) {
+            // Leave mGpuCuller empty, the control panel hides its settings
+        }
+
+        // Impostors are optional too, without them distant entities are drawn with their lowest level of detail
+        try {
+            mImpostorRenderer = std::make_unique<ImpostorRenderer>();
+            gEntityManager->SetImpostorRenderer(mImpostorRenderer.get());
+        }
+        catch (const std::runtime_error&) {
+            // Leave mImpostorRenderer empty, the control panel hides its settings
+        }
+
+        // Particles need compute shaders, without them the game events have no effects
+        try {
+            mParticleSystem = std::make_unique<ParticleSystem>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mParticleSystem empty, the control panel hides its settings
+        }
+
+        // Tessellated water needs feature level 11, without it the water meshes of the level are drawn
+        try {
+            mWaterRenderer = std::make_unique<WaterRenderer>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mWaterRenderer empty, the control panel hides its settings
+        }
+
+        // Without the clustered lights only the main light lights the scene
+        try {
+            mClusteredLights = std::make_unique<ClusteredLights>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mClusteredLights empty, the control panel hides its settings
+        }
+
+        // Without half resolution effects the additive pass is always drawn at full resolution
+        try {
+            mHalfResEffects = std::make_unique<HalfResEffects>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mHalfResEffects empty, the control panel hides its settings
+        }
+
+        // Without weighted blended transparency the additive group is always sorted back to front
+        try {
+            mWeightedOit = std::make_unique<WeightedOit>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mWeightedOit empty, the control panel hides its settings
+        }
+
+        // Without the shadow map nothing casts shadows
+        try {
+            mShadowMap = std::make_unique<ShadowMap>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mShadowMap empty, the control panel hides its settings
+        }
+
+        // Without pre-warming the driver finishes each shader the first time it is drawn with, mid-frame
+        try {
+            mShaderPrewarm = std::make_unique<ShaderPrewarm>();
+        }
+        catch (const std::runtime_error&) {
+            // Leave mShaderPrewarm empty, then nothing is pre-warmed
+        }
+
+        // Fonts for text drawing use the SpriteFont helper library. Fonts are read through gAssetFiles so they can come from the asset archive
+        auto loadFont = [](const std::string& fileName) {
+            StartupTimer fontTimer("Font " + fileName);
+            AssetData file = gAssetFiles.Read(fileName);
+            if (file.empty())  throw std::runtime_error("Error loading font (" + fileName + ")");
+            return std::make_unique<DirectX::DX11::SpriteFont>(DX->Device(), file.data(), file.size());
+        };
+    	mSmallFont   = loadFont("tahoma12.spritefont");
+    	mMediumFont  = loadFont("tahoma16.spritefont");
+        mLabelRenderer = std::make_unique<LabelRenderer>(*mSmallFont);
+        mFloatingTextRenderer = std::make_unique<FloatingTextRenderer>(*mSmallFont);
+    }
 
     //----------------------------------------------------------------------
     // Load the level from XML.
     //----------------------------------------------------------------------
     {
-        // Create an instance of the XML parser and pass it our entity manager.
-        ParseLevel levelParser(*gEntityManager);
-        // Adjust the file path as needed.
-        if (!levelParser.ParseFile("Entities.xml"))
+        // Create an instance of the XML parser and pass it our entity manager. Templates the level's
+        // entities don't use are only loaded when first needed. A partitioned level's scenery and obstacles
+        // go to the world partition, to be streamed in around the boats and camera
+        mWorldPartition = std::make_unique<WorldPartition>();
+        mLevelFile = levelFile;
+        if (!headless)  mLoadedLevel = std::make_unique<LoadedLevel>(); // Only for reloading, headless processes don't keep a copy
+        ParseLevel levelParser(*gEntityManager, gJobSystem.get(), true, mWorldPartition.get());
+        if (!levelParser.ParseFile(levelFile, mLoadedLevel.get()))
         {
-            throw std::runtime_error("Error parsing level file (Entities.xml)");
+            throw std::runtime_error("Error parsing level file (" + levelFile + ")");
         }
+        if (mWorldPartition->NumCells() == 0)  mWorldPartition.reset();
+        mSpawnDirector.Configure(levelParser.Settings());
+        mSpawnDirector.ResetTimers();
+
+        // A seeded headless battle spawns the same on any machine, not as the time taken allows
+        if (mHeadless)  mSpawnDirector.SetTimeBudget(0);
+
+        // Templates spawned during play are loaded in the background so the first one doesn't stall a frame
+        for (auto type : { "Missile", "Shield", "RandomCrate", "SeaMine" })
+            gEntityManager->PrefetchTemplate(type);
     }
 
+    // Test for any errors loading entity templates
+    if (gEntityManager->GetLastError() != "")  throw std::runtime_error(gEntityManager->GetLastError());
+
+    BuildWorldSnapshot();
+
+    // The cells around the boats are there from the start, those around the camera stream in over the first steps
+    if (mWorldPartition)  UpdateWorldPartition(true);
+
+    // The rest is only needed for rendering
+    if (mHeadless)  return;
+
     ////// Camera
 
     mCamera = std::make_unique<Camera>();
@@ -77,45 +263,12 @@ Scene::Scene()
     mCamera->SetNearClip(1);
     mCamera->SetFarClip(10000);
 
-    // Test for any errors loading entity templates
-    if (gEntityManager->GetLastError() != "")  throw std::runtime_error(gEntityManager->GetLastError());
-
-    allBoats = gEntityManager->GetAllBoatEntities();
+    // Chase cameras are created as boats are followed, see UpdateChaseCameras
+    mChaseCameras.SetAspectRatio(static_cast<float>(DX->GetBackbufferWidth()) / DX->GetBackbufferHeight());
 
-    for (Boat* boatPtr : allBoats)
-    {
-        if (!boatPtr) continue;
-
-        auto chaseCamera = std::make_unique<Camera>();
-
-        // Configure the chase camera's default settings
-        chaseCamera->SetAspectRatio(static_cast<float>(DX->GetBackbufferWidth()) / DX->GetBackbufferHeight());
-        chaseCamera->SetFOV(ToRadians(60)); // Slightly narrower FOV for chase cameras
-        chaseCamera->SetNearClip(0.1f);
-        chaseCamera->SetFarClip(10000.0f);
-
-        // Set the chase camera's position and orientation based on the boat
-        Vector3 boatPos = boatPtr->Transform().Position();
-        Vector3 boatForward = boatPtr->Transform().ZAxis(); // Assuming ZAxis points forward
-
-        // Position the camera behind and above the boat
-        Vector3 cameraPos = boatPos - boatForward * mChaseDistance + Vector3(0, mChaseHeight, 0);
-        chaseCamera->Transform().Position() = cameraPos;
-
-        // Calculate yaw based on the boat's forward direction
-        float yaw = std::atan2(boatForward.x, boatForward.z);
-
-        // Set a fixed downward pitch angle
-        float pitch = mChasePitch;
-
-        // Apply rotation to the chase camera
-        chaseCamera->Transform().SetRotation({ pitch, yaw, 0 });
-
-        // Store the chase camera
-        mChaseCameras.emplace_back(std::move(chaseCamera));
-    }
-
-    // Create light entity (visual representation of light), scale of light adjusts its brightness
+    // Create light entity (visual representation of light), scale of light adjusts its brightness. Its template is constructed
+    // first, as a plain entity would otherwise be drawn as a stand-in box while it streams in (see EntityManager::CreateEntity)
+    gEntityManager->GetTemplate("Light");
     mLight = gEntityManager->CreateEntity<Entity>("Light", Matrix4x4({ -3250, 8000, -10000 }, { 0, 0, 0 }, 150.0f));
 
     // Test for any errors creating entities
@@ -129,20 +282,48 @@ Scene::Scene()
     // We could check lightPtr isn't nullptr, but no need as we are certain it will exist here. However, in gameplay code with entities that may not be the case
     auto lightPtr = gEntityManager->GetEntity(mLight);
 	lightPtr->RenderColour() = {1.0f, 0.6f, 0.2f};  // The light mesh will be tinted to the light's colour
-    lightPtr->RenderGroup() = 1;                    // Put additive blended entities in a different render group
+    gEntityManager->SetRenderGroup(mLight, PassRenderGroup(RenderPass::Additive)); // Put additive blended entities in a different render group
+
+    SetupLevelEntities();
 
     // Ambient light is used as global illumination in Blinn-Phong lighting (2nd year style graphics - see mesh code)
     // Global illumination is the light from the scene that is not directly from light sources
     mAmbientColour = { 0.5f, 0.5f, 0.5f };
 
-    // When using PBR we use an environment map for global illumination - a cube map of the scene we are in
-    std::tie(std::ignore, mEnvironmentMap) = DX->Textures()->LoadTexture("Media/sea-cube.dds", true);
-    RenderState::SetEnvironmentMap(mEnvironmentMap);
+    // When using PBR we use an environment map for global illumination - a cube map of the scene we are in. It is prefiltered
+    // for the shaders at load, or read back from the cache of an earlier run (see EnvironmentLighting.h)
+    try {
+        StartupTimer environmentTimer("Environment lighting");
+        mEnvironmentLighting = std::make_unique<EnvironmentLighting>("Media/sea-cube.dds");
+        RenderState::SetEnvironmentMap(mEnvironmentLighting->Maps());
+    }
+    catch (const std::runtime_error&) {
+        // Without it the PBR shaders reflect the environment map unfiltered and get no diffuse light from it
+        EnvironmentMaps environmentMaps;
+        std::tie(std::ignore, environmentMaps.specular) = DX->Textures()->LoadTexture("Media/sea-cube.dds", true);
+        environmentMaps.sampler = DX->Textures()->CreateSampler({ TextureFilter::FilterBilinear, TextureAddressingMode::AddressingClamp });
+        RenderState::SetEnvironmentMap(environmentMaps);
+    }
+
+    // The level's templates are warmed now, those loaded later (e.g. prefetched ones) before the frame after they load
+    StartupTimer prewarmTimer("Shader pre-warm");
+    PrewarmShaders();
 }
 
 
-// Empty destructor - nothing to do, but see comment on forward declarations in header file
-Scene::~Scene() {}
+// Finish any replay being recorded so the file is complete and tell network peers the game is ending, but see comment on
+// forward declarations in header file
+Scene::~Scene()
+{
+    FinishPipelinedSteps();
+    StopReplayRecording();
+    StopAnalytics();
+    StopMetrics();
+    StopServer();
+    if (mNetClient)  mNetClient->End(*gEntityManager);
+    CheckTraceWrite(true);
+    CheckLevelGeneration(true);
+}
 
 
 //--------------------------------------------------------------------------------------
@@ -152,18 +333,37 @@ Scene::~Scene() {}
 // Render the entire scene
 void Scene::Render()
 {
+    if (mHeadless)  return;
+    TIMING_SCOPE("Render");
+    TRACE_PHASE("Render");
+    ALLOCATION_SCOPE("Rendering");
+
     //*******************************
     // Prepare ImGUI for this frame
     //*******************************
 
-    ImGui_ImplDX11_NewFrame();
-    ImGui_ImplWin32_NewFrame();
-    ImGui::NewFrame();
+    // The control panel is only built when it is due (see mPanelRate), otherwise the last frame's draw data, which ImGui keeps
+    // until the next NewFrame, is drawn again. Input arriving in between is queued by ImGui for the next frame that is built
+    auto now = std::chrono::steady_clock::now();
+    float panelRate = mPanelCollapsed ? PANEL_COLLAPSED_RATE : mPanelRate;
+    bool buildPanel = panelRate <= 0 || ImGui::GetDrawData() == nullptr ||
+                      std::chrono::duration<float>(now - mLastPanelBuild).count() >= 1.0f / panelRate;
+    if (buildPanel)
+    {
+        mLastPanelBuild = now;
+        ImGui_ImplDX11_NewFrame();
+        ImGui_ImplWin32_NewFrame();
+        ImGui::NewFrame();
+    }
+
+    PrewarmShaders();
 
-    // Setup the rendering viewport to the size of the main window
+    // Choose the resolution of the 3D scene from recent GPU frame times, then setup the rendering viewport to that size. It is the
+    // size of the main window unless dynamic resolution has reduced it, the UI is always drawn at the size of the window
+    mDynamicResolution->Update(DX->Profiler()->FrameTime().milliseconds);
     D3D11_VIEWPORT vp;
-	vp.Width =  static_cast<FLOAT>(DX->GetBackbufferWidth());
-    vp.Height = static_cast<FLOAT>(DX->GetBackbufferHeight());
+	vp.Width =  static_cast<FLOAT>(DX->GetSceneWidth());
+    vp.Height = static_cast<FLOAT>(DX->GetSceneHeight());
     vp.MinDepth = 0.0f;
     vp.MaxDepth = 1.0f;
     vp.TopLeftX = 0;
@@ -179,146 +379,236 @@ void Scene::Render()
 
 	gPerFrameConstants.ambientColour  = mAmbientColour;
 
-	gPerFrameConstants.viewportWidth  = static_cast<float>(DX->GetBackbufferWidth());
-    gPerFrameConstants.viewportHeight = static_cast<float>(DX->GetBackbufferHeight());
+	gPerFrameConstants.viewportWidth  = static_cast<float>(DX->GetSceneWidth());
+    gPerFrameConstants.viewportHeight = static_cast<float>(DX->GetSceneHeight());
 
     // Send over to GPU
     DX->CBuffers()->UpdateCBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
+    DX->CBuffers()->ResetStats(); // Count the per-draw constants of this frame for the control panel
 
     // Determine which camera to use
-    Camera* activeCamera = mCamera.get(); // Default main camera
-    if (mActiveCameraIndex >= 0 && mActiveCameraIndex < static_cast<int>(mChaseCameras.size()))
-    {
-        // Ensure that the camera in use is still valid.
-        Camera* potentialCamera = mChaseCameras[mActiveCameraIndex].get();
-        if (potentialCamera)
-            activeCamera = potentialCamera;
-        else
-            mActiveCameraIndex = -1;
-    }
+    Camera* activeCamera = ActiveCamera();
 
-    // Render the scene from the active camera
-    RenderFromCamera(activeCamera);
+    // The guns of boats seen in this frame's views are animated in the next updates, see WeaponSystem.h
+    gEntityManager->Weapons().ClearViews();
 
-    // Output UI text for boats
-    mSpriteBatch->Begin(); // Using DirectX helper library SpriteBatch to draw text
-
-    allBoats = gEntityManager->GetAllBoatEntities();
+    // Render the scene from the active camera. With a fixed step simulation, a replay or a server's game the entities are
+    // shown part way between the last two steps (or replay ticks or snapshots), until the labels have been drawn
+    bool blendSteps = (mFixedStep || mReplay || mNetClient) && !mGamePaused;
+    if (blendSteps)  gEntityManager->Transforms().BlendRoots(mStepBlend);
+    if (mParticleSystem)
+    {
+        DX->Profiler()->BeginScope("Particles");
+        mParticleSystem->Update(); // Once for all the views
+        DX->Profiler()->EndScope();
+    }
+    if (mGpuMissiles)
+    {
+        DX->Profiler()->BeginScope("GPU Missiles");
+        UpdateGpuMissiles();
+        DX->Profiler()->EndScope();
+    }
+    if (mClusteredLights)  GatherLights(); // Binned for each view as its camera constants are set
 
-    for (Boat* boatPtr : allBoats)
+    // The water meshes are the fallback for the tessellated water, drawn only when it isn't
+    bool waterMeshes = !mWaterRenderer || !mWaterRenderer->GetSettings().enabled;
+    for (EntityID water : mWaterEntities)
     {
-        if (!boatPtr) continue;
+        gEntityManager->SetRenderGroup(water, waterMeshes ? PassRenderGroup(RenderPass::Opaque) : HIDDEN_RENDER_GROUP);
+    }
 
-        std::string text;
+    // Once for all the views, the static casters only when the camera has moved far enough or the scenery has changed
+    if (mShadowMap)
+    {
+        DX->Profiler()->BeginScope("Shadows");
+        RenderShadows(activeCamera);
+        DX->Profiler()->EndScope();
+    }
 
-        if (!mShowExtendedBoatUI)
-        {
-            text = boatPtr->Template().GetType() + ": " + boatPtr->GetName();
-        }
-        else
-        {
-            float hp = boatPtr->GetHP();
-            std::string state = boatPtr->GetState();
-            int fired = boatPtr->GetMissilesFired();
-            int missilesLeft = boatPtr->GetMissilesRemaining();
-            float speed = boatPtr->GetSpeed();
-
-            // Format speed with two decimal places
-            std::ostringstream speedStream;
-            speedStream << std::fixed << std::setprecision(2) << speed;
-
-            text = boatPtr->GetName()
-                + " [HP=" + std::to_string((int)hp)
-                + ", State=" + state
-                + ", Fired=" + std::to_string(fired)
-                + ", Missiles=" + std::to_string(missilesLeft)
-                + ", Speed=" + speedStream.str()
-                + "]";
-        }
-        // Determine label color
-        if (mSelectedBoat && (boatPtr == mSelectedBoat)) { colour = ColourRGB(0xffff00); } // Yellow for selected entity
-        else if (mNearestEntity && (boatPtr == mNearestEntity)) { colour = ColourRGB(0xff0000); } // Red for nearest entity
-        else if (boatPtr->GetTeam() == Team::TeamA) { colour = ColourRGB(0x6060ff); } // Blue for team A
-        else if (boatPtr->GetTeam() == Team::TeamB) { colour = ColourRGB(0x00ff00); } // Green for team B
-        else if (boatPtr->GetTeam() == Team::TeamC) { colour = ColourRGB(0x9932CC); } // Dark Orchid for team C
-        else { colour = ColourRGB(0xffffff); }
-
-        Vector3 boatPos = boatPtr->Transform().Position();
-
-        // Draw the text label using activeCamera
-        DrawTextAtWorldPt(boatPos, text, activeCamera, true);
-
-        if (!boatPtr->GetBoatText().empty())
-        {
-            float timeLeft = boatPtr->GetBoatTextTimer();
-            float maxTime = 3.0f;
-            float baseOffset = 10.0f;
-            float totalRise = 10.0f;
+    // The passes of the frame, ordered, culled and given their targets by the render graph (see RenderGraph.h). The 3D scene is
+    // rendered to the back buffer, or at a reduced resolution to a transient scene texture that is then upscaled onto it
+    mRenderGraph->BeginFrame();
+    auto backBuffer  = mRenderGraph->ImportTexture("Back buffer", DX->BackBuffer(), nullptr, nullptr, true);
+    auto depthBuffer = mRenderGraph->ImportTexture("Depth buffer", nullptr, DX->DepthBuffer(), nullptr);
+    auto sceneColour = backBuffer;
+    if (DX->RenderScale() < 1.0f)
+    {
+        sceneColour = mRenderGraph->CreateTexture("Scene", { DX->GetBackbufferWidth(), DX->GetBackbufferHeight(), DXDevice::SCENE_FORMAT });
+    }
+    auto idBuffer = mRenderGraph->CreateTexture("ID buffer", { DX->GetBackbufferWidth(), DX->GetBackbufferHeight(), DXGI_FORMAT_R32_UINT });
+
+    mRenderGraph->AddPass("Main view",
+        [&](RenderGraph::PassBuilder& pass) { pass.Write(sceneColour);  pass.Write(depthBuffer, RenderGraph::ClearDepth()); },
+        [&](RenderGraph::PassContext& context) {
+            DX->SetSceneTarget(context.RenderTarget(sceneColour));
+            RenderFromCamera(activeCamera);
+        });
+
+    // Only run when GPU picking, otherwise the pass is culled and no ID buffer is created
+    mRenderGraph->AddPass("ID buffer",
+        [&](RenderGraph::PassBuilder& pass) {
+            pass.Read(depthBuffer);
+            pass.Write(idBuffer, RenderGraph::ClearColour({ 0, 0, 0, 0 })); // 0 is no ID
+            if (mGpuPicking)  pass.SideEffect(); // The area around the cursor is copied back to the CPU
+        },
+        [&](RenderGraph::PassContext& context) { RenderIdBuffer(context.Texture(idBuffer), context.RenderTarget(idBuffer), activeCamera); });
+
+    mRenderGraph->AddPass("Picture-in-picture",
+        [&](RenderGraph::PassBuilder& pass) { pass.Write(sceneColour);  pass.Write(depthBuffer); },
+        [&](RenderGraph::PassContext&) { RenderPictureInPicture(vp, activeCamera); });
+
+    // Stretch the scene over the back buffer if it was rendered at a reduced resolution, the UI below is at full resolution
+    mRenderGraph->AddPass("Upscale",
+        [&](RenderGraph::PassBuilder& pass) {
+            if (sceneColour != backBuffer)  pass.Read(sceneColour);
+            pass.Write(backBuffer);
+        },
+        [&](RenderGraph::PassContext& context) {
+            DX->Profiler()->BeginScope("Upscale");
+            mDynamicResolution->Upscale(context.ShaderResource(sceneColour)); // Null for the back buffer
+            DX->Profiler()->EndScope();
+        });
 
-            float timeSinceBoatBehaviour = maxTime - timeLeft;
-            float fraction = timeSinceBoatBehaviour / maxTime;
+    // Output UI text for boats
+    mRenderGraph->AddPass("Labels",
+        [&](RenderGraph::PassBuilder& pass) { pass.Write(backBuffer); },
+        [&](RenderGraph::PassContext&) {
+            DX->Profiler()->BeginScope("Labels");
+            {
+                PROFILE_SCOPE("Labels");
+                ALLOCATION_SCOPE("Labels");
+
+                // Labels are gathered first then projected to the screen together and drawn by DrawWorldLabels
+                for (size_t i = 0; i < mWorld.NumBoats(); ++i)
+                {
+                    Boat* boatPtr = mWorld.boats[i];
+                    const std::string& text = BoatLabelText(i);
+
+                    // Determine label color
+                    ColourRGB colour;
+                    if (mSelectedBoat && (boatPtr == mSelectedBoat)) { colour = ColourRGB(0xffff00); } // Yellow for selected entity
+                    else if (mNearestEntity && (boatPtr == mNearestEntity)) { colour = ColourRGB(0xff0000); } // Red for nearest entity
+                    else if (mWorld.teams[i] == Team::TeamA) { colour = ColourRGB(0x6060ff); } // Blue for team A
+                    else if (mWorld.teams[i] == Team::TeamB) { colour = ColourRGB(0x00ff00); } // Green for team B
+                    else if (mWorld.teams[i] == Team::TeamC) { colour = ColourRGB(0x9932CC); } // Dark Orchid for team C
+                    else { colour = ColourRGB(0xffffff); }
+
+                    Vector3 boatPos = boatPtr->Transform().Position(); // Rather than mWorld, so the label follows the blended position
+                    AddWorldLabel(WorldLabelKey(mWorld.ids[i], WorldLabelSlot::Boat), boatPos, text, colour);
+                }
 
-            if (fraction > 1.0f) fraction = 1.0f;
+                HandleMousePicking(activeCamera);
 
-            float extraOffset = totalRise * fraction;
-            float finalOffset = baseOffset + extraOffset;
+                for (ReloadStation* reloadStation : gEntityManager->View<ReloadStation>())
+                {
+                    // Text label above the reload station
+                    Vector3 labelPosition = reloadStation->Transform().Position() + Vector3(0, 10, 0);
+                    AddWorldLabel(WorldLabelKey(reloadStation->GetID(), WorldLabelSlot::ReloadStation), labelPosition, reloadStation->GetName(), ColourRGB(0xffffff));
+                }
 
-            // Position the an text above the boat for certain time
-            Vector3 boatAddLabelPos = boatPos + Vector3(0.0f, finalOffset, 0.0f);
+                DrawWorldLabels(activeCamera);
+                DrawFloatingText(activeCamera); // Damage, pickups and so on rising above the boats
+            }
+            DX->Profiler()->EndScope();
+        });
+
+    mRenderGraph->AddPass("ImGui",
+        [&](RenderGraph::PassBuilder& pass) { pass.Write(backBuffer); },
+        [&](RenderGraph::PassContext&) {
+            //*******************************
+            // Draw ImGUI interface
+            //*******************************
+            // Draw ImGUI elements at any time between the frame preparation code at the top
+            // of this function, and the finalisation code below
+            {
+                PROFILE_SCOPE("ImGui");
+                ALLOCATION_SCOPE("ImGui"); // Exempt from steady state asserts, see the constructor
+                if (buildPanel)
+                {
+                    DrawGUI();
+
+                    //*******************************
+                    // Finalise ImGUI for this frame
+                    //*******************************
+                    ImGui::Render();
+                }
+                DX->Profiler()->BeginScope("ImGui");
+                DX->Context()->OMSetRenderTargets(1, &DX->BackBuffer(), nullptr);
+                ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+                DX->Profiler()->EndScope();
+            }
+        });
 
-            colour = ColourRGB(0xffcc00);
+    mRenderGraph->Execute();
+    DX->SetSceneTarget(nullptr); // The scene texture goes back to the render graph's pool
+    if (blendSteps)  gEntityManager->Transforms().RestoreRoots();
 
-            DrawTextAtWorldPt(boatAddLabelPos, boatPtr->GetBoatText(), activeCamera, true);
-        }
-    }
+    // The entities have been drawn, so a pipelined simulation can move them on while the frame is presented, see Update
+    StartPipelinedSteps();
 
-    HandleMousePicking();
+    // Everything counted by the render layer this frame has been drawn, see RenderCounters.h. The bone palette's ranges can be
+    // reused next frame
+    gRenderCounters.NextFrame();
+    DX->Bones()->NextFrame();
 
-    reloadStations = gEntityManager->GetAllReloadStationEntities();
-    for (ReloadStation* reloadStation : reloadStations)
+    if (mFlyThrough)
     {
-        // Prepare the text label for the reload station
-        std::string text = reloadStation->GetName();
-
-        // Draw the text label above the reload station
-        Vector3 labelPosition = reloadStation->Transform().Position() + Vector3(0, 10, 0);
-        colour = ColourRGB(0xffffff);
-
-        DrawTextAtWorldPt(labelPosition, text, activeCamera, true);
+        float cpuMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - mFrameStart).count();
+        mFlyThrough->EndFrame(cpuMilliseconds, DX->Profiler()->FrameTime().milliseconds, DX->VideoMemoryUsage(),
+                              gEntityManager->GetRenderStats(), gCpuProfiler.LastFrame(), gAllocationTracker.LastFrame(),
+                              gRenderCounters.LastFrame());
     }
 
-    mSpriteBatch->End();
-    RenderState::Reset(); // Must call this after using SpriteBatch functions
+    // Rendering is complete, "present" the image to the screen
+    DX->PresentFrame(mVSync);
+}
 
-    //*******************************
-    // Draw ImGUI interface
-    //*******************************
-    // Draw ImGUI elements at any time between the frame preparation code at the top
-    // of this function, and the finalisation code below
-    DrawGUI();
 
-    //*******************************
-    // Finalise ImGUI for this frame
-    //*******************************
-    ImGui::Render();
-    DX->Context()->OMSetRenderTargets(1, &DX->BackBuffer(), nullptr);
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+// Wait until it is time to start the next frame. The frame rate cap comes first so the swap chain wait is as close as possible
+// to sampling input
+void Scene::PaceFrame()
+{
+    mFrameLimiter->Wait();
+    if (mLowLatency)  DX->WaitForSwapChain();
+}
 
-    // Rendering is complete, "present" the image to the screen
-    DX->PresentFrame(mLockFPS);
+
+// Whether the window is hidden, so frames needn't be drawn. Occlusion is tested last as it may test the swap chain
+bool Scene::CheckHidden(bool minimised, bool focused)
+{
+    mHidden = mPowerSaving && !mFlyThrough && !mHeadless && (minimised || (!focused && mHideWhenUnfocused) || DX->IsOccluded());
+    return mHidden;
 }
 
 void Scene::DrawGUI() {
+    // Nothing in the panel is built while it is collapsed, and it is built less often (see Render)
     ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
-    ImGui::Begin("CO3301 Game Development - Control Panel", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    mPanelCollapsed = !ImGui::Begin("CO3301 Game Development - Control Panel", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    if (mPanelCollapsed) {
+        ImGui::End();
+        return;
+    }
 
     // ===================== Global Settings =====================
     if (ImGui::CollapsingHeader("Global Settings", ImGuiTreeNodeFlags_DefaultOpen)) {
-        // Lock FPS
-        static bool lockFPS = mLockFPS;
-        if (ImGui::Checkbox("Lock FPS", &lockFPS)) {
-            mLockFPS = lockFPS;
+        // Frame pacing, vsync can also be toggled with F
+        ImGui::Checkbox("Lock FPS (VSync)", &mVSync);
+        if (!mVSync)  ImGui::Text(DX->IsTearingSupported() ? "Tearing: Supported" : "Tearing: Unsupported, waits for vertical blank");
+        ImGui::Checkbox("Low Latency", &mLowLatency);
+        ImGui::Checkbox("Power Saving (stop drawing when hidden)", &mPowerSaving);
+        if (mPowerSaving) {
+            ImGui::Checkbox("Hide When Unfocused", &mHideWhenUnfocused);
+            ImGui::SliderFloat("Hidden Update Rate (0 - pause)", &mHiddenUpdateRate, 0.0f, 60.0f, "%.0f/s");
+        }
+        ImGui::SliderFloat("Panel Rate (0 - every frame)", &mPanelRate, 0.0f, 60.0f, "%.0f/s");
+        ImGui::Text("Input latency: %.2fms", GetInputLatency() * 1000.0f); // Oldest input event at the start of the frame
+        static const float frameRateCaps[] = { 0, 30, 60, 120, 144, 240 };
+        static const char* frameRateCapNames[] = { "Off", "30 FPS", "60 FPS", "120 FPS", "144 FPS", "240 FPS" };
+        static int frameRateCap = 0;
+        if (ImGui::Combo("Frame Rate Cap", &frameRateCap, frameRateCapNames, IM_ARRAYSIZE(frameRateCapNames))) {
+            mFrameLimiter->SetFrameRate(frameRateCaps[frameRateCap]);
         }
+        if (frameRateCap > 0 && !mFrameLimiter->IsHighResolution())  ImGui::Text("Low resolution timer, cap may be uneven");
 
         // Ambient Light
         static float ambientLight = mAmbientColour.r;
@@ -326,80 +616,210 @@ void Scene::DrawGUI() {
             mAmbientColour = { ambientLight, ambientLight, ambientLight };
         }
 
+        // Fixed step simulation, see Scene::Update
+        ImGui::Checkbox("Fixed Step Simulation (60Hz)", &mFixedStep);
+
+        // Run the fixed steps while the last frame is presented, see Update. This only overlaps the steps with the present and
+        // pacing, it doesn't run them alongside rendering, and what is drawn is a frame older, so say so where it's turned on
+        if (mFixedStep)
+        {
+            ImGui::Checkbox("Overlap Steps With Present (+1 frame latency)", &mPipelined);
+            if (ImGui::IsItemHovered())
+            {
+                ImGui::SetTooltip("Runs each frame's simulation steps on a worker while the frame is presented.\n"
+                                  "Only the present and frame pacing overlap the steps, and the screen shows the\n"
+                                  "simulation one frame late. Compare frame times with it off before keeping it.");
+            }
+            if (mPipelined)  ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.2f, 1.0f), "Adds one frame of input latency");
+            if (!mPipelineStatus.empty())  ImGui::Text("%s", mPipelineStatus.c_str());
+        }
+
+        // Streaming of a partitioned level's cells, see WorldPartition.h
+        if (mWorldPartition) {
+            float loadDistance = mWorldPartition->GetLoadDistance();
+            if (ImGui::SliderFloat("Streaming Distance", &loadDistance, mWorldPartition->GetCellSize(), 5000.0f, "%.0f")) {
+                mWorldPartition->SetLoadDistance(loadDistance);
+            }
+            WorldPartition::Stats streaming = mWorldPartition->GetStats();
+            ImGui::Text("Cells: %u loaded, %u loading of %u  Entities: %u of %u  Templates: %u of %u", streaming.loadedCells,
+                        streaming.loadingCells, streaming.cells, streaming.loadedEntities, streaming.entities,
+                        streaming.loadedTemplates, streaming.templates);
+        }
+
+        // Apply edits to the level file while the game runs, see CheckLevelReload
+        ImGui::Checkbox("Hot Reload Level", &mLevelReload);
+        if (!mLevelReloadStatus.empty())  ImGui::TextUnformatted(mLevelReloadStatus.c_str());
+
         // Pause Game
         static bool pauseGame = false;
         if (ImGui::Checkbox("Pause Game", &pauseGame)) {
             SetPauseState(pauseGame);
         }
-    }
-
-    // ===================== Boat Management =====================
-    if (ImGui::CollapsingHeader("Boat Management")) {
-        // Build a list of boat names and their IDs.
-        std::vector<std::pair<std::string, EntityID>> boatData;
-        allBoatIDS = gEntityManager->GetAllBoatIDS();
 
-        // Populate boatData only with valid boat entities.
-        for (EntityID boatID : allBoatIDS) {
-            Boat* boatPtr = gEntityManager->GetEntity<Boat>(boatID);
-            if (!boatPtr) continue;
-            boatData.emplace_back(boatPtr->GetName(), boatID);
+        // Save the whole simulation to a file and go back to it later, done at the start of the next update
+        CheckCheckpointWrite(false);
+        if (!mReplay && !mNetClient) {
+            if (ImGui::Button("Save Checkpoint"))  mSaveCheckpointNext = true;
+            ImGui::SameLine();
+            if (ImGui::Button("Load Checkpoint"))  mLoadCheckpointNext = true;
+            if (!mCheckpointStatus.empty())  ImGui::TextUnformatted(mCheckpointStatus.c_str());
         }
 
-        // Create a vector of const char* for the ImGui combo
-        std::vector<const char*> boatNames;
-        for (const auto& entry : boatData) {
-            boatNames.push_back(entry.first.c_str());
+        // Record where everything moves to a replay file, and play it back in place of the game, see Replay.h. Not while
+        // showing a server's game, replays are of this scene's own
+        if (!mReplay && !mNetClient) {
+            bool recording = mReplayRecorder && mReplayRecorder->IsRecording();
+            if (ImGui::Checkbox("Record Replay", &recording)) {
+                if (recording)  StartReplayRecording(REPLAY_FILE);
+                else            StopReplayRecording();
+            }
+            if (mReplayRecorder) {
+                ImGui::Text("Recorded %.0fs, %.1f KB", mReplayRecorder->TicksRecorded() * ReplayRecorder::TICK_TIME,
+                            mReplayRecorder->BytesWritten() / 1024.0f);
+            }
+            if (ImGui::Button("Play Replay"))  mStartReplayNext = true;
+
+            // The screen to a video, copied and encoded without stalling the frame, see FrameCapture.h
+            FrameCapture* capture = DX->Capture();
+            bool recordingVideo = capture->IsCapturing();
+            if (ImGui::Checkbox("Record Video", &recordingVideo)) {
+                if (recordingVideo) {
+                    mVideoStatus.clear();
+                    if (capture->Start(VIDEO_FILE, DX->GetBackbufferWidth(), DX->GetBackbufferHeight(), 60, mVideoStatus)) {
+                        mVideoStatus = std::string("Recording to ") + VIDEO_FILE;
+                    }
+                }
+                else {
+                    uint32_t frames = capture->FramesEncoded();
+                    mVideoStatus = capture->Stop() ? "Recorded " + std::to_string(frames) + " frames" : std::string("Failed to write the video");
+                }
+            }
+            if (capture->IsCapturing())  ImGui::Text("Encoded %u frames, %u dropped", capture->FramesEncoded(), capture->FramesDropped());
+            if (!mVideoStatus.empty())  ImGui::TextUnformatted(mVideoStatus.c_str());
+
+            // Every shot, hit and pickup to a columnar file for balancing, see GameAnalytics.h
+            bool analytics = mAnalytics && mAnalytics->IsRecording();
+            if (ImGui::Checkbox("Record Analytics", &analytics)) {
+                if (analytics)  StartAnalytics(ANALYTICS_FILE);
+                else            StopAnalytics();
+            }
+            if (mAnalytics) {
+                ImGui::Text("Recorded %llu events, %.1f KB", static_cast<unsigned long long>(mAnalytics->EventsRecorded()),
+                            mAnalytics->BytesWritten() / 1024.0f);
+            }
         }
-
-        // Display the boat selection dropdown
-        static int selectedBoatIndex = -1;
-        if (ImGui::Combo("Select Boat", &selectedBoatIndex, boatNames.data(), static_cast<int>(boatNames.size()))) {
-            if (selectedBoatIndex >= 0 && selectedBoatIndex < static_cast<int>(boatData.size())) {
-                // Retrieve the selected boat ID and update mSelectedUIBoat
-                EntityID selectedBoatID = boatData[selectedBoatIndex].second;
-                mSelectedUIBoat = gEntityManager->GetEntity<Boat>(selectedBoatID);
+        else if (mReplay) {
+            if (ImGui::Button("Stop Replay"))  mStopReplayNext = true;
+            ImGui::SliderFloat("Replay Speed", &mReplaySpeed, 0.25f, 8.0f, "%.2fx");
+            float replayTime = mReplay->Time();
+            if (ImGui::SliderFloat("Replay Time", &replayTime, 0.0f, mReplay->Duration(), "%.1fs")) {
+                mReplay->Seek(replayTime);
             }
         }
-
-        // Validate mSelectedUIBoat: re-check that it still exists.
-        if (mSelectedUIBoat) {
-            Boat* temp = gEntityManager->GetEntity<Boat>(mSelectedUIBoat->GetID());
-            if (!temp) {
-                mSelectedUIBoat = nullptr;
-                selectedBoatIndex = -1;
+        if (!mReplayStatus.empty())  ImGui::TextUnformatted(mReplayStatus.c_str());
+
+        // Serve this game to other instances, or join another's, see Network.h
+        if (mNetClient) {
+            if (ImGui::Button("Leave Server"))  mStopNetClientNext = true;
+            NetClient::Stats net = mNetClient->GetStats();
+            if (mNetClient->IsConnected()) {
+                ImGui::Text("Entities: %u  Snapshot: %u bytes  %.1f KB/s  Delay: %.0fms  Dropped: %u", net.entities, net.snapshotBytes,
+                            net.bytesPerSecond / 1024.0f, net.delay * 1000.0f, net.snapshotsDropped);
+                float viewRadius = mNetClient->GetViewRadius();
+                if (ImGui::SliderFloat("View Radius", &viewRadius, 200.0f, NetServer::MAX_VIEW_RADIUS, "%.0f")) {
+                    mNetClient->SetViewRadius(viewRadius);
+                }
+            }
+            else {
+                ImGui::Text("Connecting to %s...", mNetHost);
+            }
+        }
+        else if (!mReplay) {
+            bool serving = mNetServer != nullptr;
+            if (ImGui::Checkbox("Serve Game", &serving)) {
+                if (serving)  StartServer(NetServer::DEFAULT_PORT, mNetStatus);
+                else          StopServer();
+            }
+            if (mNetServer) {
+                NetServer::Stats net = mNetServer->GetStats();
+                ImGui::Text("Port %u  Clients: %u  Entities: %u (most sent %u)  Snapshot: %u bytes  %.1f KB/s", NetServer::DEFAULT_PORT,
+                            net.clients, net.entities, net.sentEntities, net.snapshotBytes, net.bytesPerSecond / 1024.0f);
+                float budget = mNetServer->GetClientBudget() / 1024.0f;
+                if (ImGui::SliderFloat("Client Budget (KB/s)", &budget, 4.0f, 512.0f, "%.0f")) {
+                    mNetServer->SetClientBudget(budget * 1024.0f);
+                }
             }
             else {
-                mSelectedUIBoat = temp;
+                ImGui::InputText("Server", mNetHost, sizeof(mNetHost));
+                ImGui::SameLine();
+                if (ImGui::Button("Join"))  StartNetClient(mNetHost, NetServer::DEFAULT_PORT, mNetStatus);
+            }
+        }
+        if (!mNetStatus.empty())  ImGui::TextUnformatted(mNetStatus.c_str());
+        if (mMetrics)  ImGui::Text("Metrics: %llu datagrams sent, %llu failed", static_cast<unsigned long long>(mMetrics->DatagramsSent()),
+                                   static_cast<unsigned long long>(mMetrics->DatagramsFailed()));
+    }
+
+    // ===================== Boat Management =====================
+    if (ImGui::CollapsingHeader("Boat Management")) {
+        // AI level of detail, see AIScheduler
+        bool aiLevelOfDetail = mAIScheduler.IsEnabled();
+        if (ImGui::Checkbox("AI Level of Detail", &aiLevelOfDetail))  mAIScheduler.SetEnabled(aiLevelOfDetail);
+        if (aiLevelOfDetail) {
+            int thinkBudget = mAIScheduler.GetThinkBudget();
+            if (ImGui::SliderInt("AI Budget (boats/step)", &thinkBudget, 1, 64))  mAIScheduler.SetThinkBudget(thinkBudget);
+            ImGui::Text("Boats thinking: %d, deferred: %d", mAIScheduler.ThinkingCount(), mAIScheduler.DeferredCount());
+        }
+
+        // Enemy sensing, see SensorSystem
+        SensorSystem& sensors = gEntityManager->Sensors();
+        float sensorRate = sensors.GetRefreshRate();
+        if (ImGui::SliderFloat("Sensor Refresh (Hz)", &sensorRate, 1.0f, 60.0f, "%.0f"))  sensors.SetRefreshRate(sensorRate);
+        ImGui::Text("Line of sight tests: %d, cached: %d", sensors.TestsDone(), sensors.TestsCached());
+
+        // What each team knows, see TeamBlackboard
+        const TeamBlackboard& blackboard = gEntityManager->Blackboard();
+        ImGui::Text("Known enemies: %s %d, %s %d, %s %d", teamNames[0], static_cast<int>(blackboard.KnownEnemies(0).size()),
+                    teamNames[1], static_cast<int>(blackboard.KnownEnemies(1).size()),
+                    teamNames[2], static_cast<int>(blackboard.KnownEnemies(2).size()));
+        ImGui::Text("Launches solved: %d", gEntityManager->Ballistics().AimingCount());
+
+        // Crates and mines, see SpawnDirector
+        SpawnDirector::Stats spawns = mSpawnDirector.GetStats();
+        ImGui::Text("Crates: %u  Mines: %u  Spawned: %u (%.2fms)  Deferred: %u  Unplaced: %u", spawns.crates, spawns.mines,
+                    spawns.spawned, spawns.milliseconds, spawns.deferred, spawns.placementsFailed);
+        float spawnBudget = mSpawnDirector.GetTimeBudget();
+        if (ImGui::SliderFloat("Spawn Budget (ms/step)", &spawnBudget, 0.0f, 5.0f, "%.2f"))  mSpawnDirector.SetTimeBudget(spawnBudget);
+
+        // Utility scored decisions in place of the state machine's checks, see DecisionSystem
+        DecisionSystem& decisions = gEntityManager->Decisions();
+        bool useDecisions = decisions.IsEnabled();
+        if (ImGui::Checkbox("Utility AI Decisions", &useDecisions))  decisions.SetEnabled(useDecisions);
+        if (useDecisions) {
+            int decisionBudget = decisions.GetBudget();
+            if (ImGui::SliderInt("Decision Budget (boats/step)", &decisionBudget, 1, 64))  decisions.SetBudget(decisionBudget);
+            ImGui::Text("Decisions: %d (%d on changes), deferred: %d", decisions.EvaluatedCount(), decisions.ChangedCount(),
+                        decisions.DeferredCount());
+        }
+
+        // Display the boat selection dropdown, from the retained list of boats
+        RefreshBoatList();
+        if (ImGui::Combo("Select Boat", &mBoatList.selected, mBoatList.names.data(), static_cast<int>(mBoatList.names.size()))) {
+            if (mBoatList.selected >= 0 && mBoatList.selected < static_cast<int>(mBoatList.ids.size())) {
+                mBoatList.selectedID = mBoatList.ids[mBoatList.selected];
+                mSelectedUIBoat = gEntityManager->GetEntity<Boat>(mBoatList.selectedID);
             }
         }
 
         // Display Selected Boat Details if one is selected.
         if (mSelectedUIBoat) {
             ImGui::Text("Selected Boat: %s", mSelectedUIBoat->GetName().c_str());
-            ImGui::Text("State: %s", mSelectedUIBoat->GetState().c_str());
+            ImGui::Text("State: %s", mSelectedUIBoat->GetStateName());
             ImGui::Text("Speed: %.2f", mSelectedUIBoat->GetSpeed());
 
+            // View from the selected boat's own chase camera, created by the next UpdateChaseCameras if it doesn't have one
             if (ImGui::Button("Spectate Boat")) {
-                // Find the chase camera that is closest to the selected boat.
-                if (mSelectedUIBoat) {
-                    Vector3 boatPos = mSelectedUIBoat->Transform().Position();
-                    int bestIndex = -1;
-                    float bestDistance = FLT_MAX;
-                    for (size_t i = 0; i < mChaseCameras.size(); ++i) {
-                        Camera* cam = mChaseCameras[i].get();
-                        if (!cam) continue;
-                        Vector3 camPos = cam->Transform().Position();
-                        float distance = (camPos - boatPos).Length();
-                        if (distance < bestDistance) {
-                            bestDistance = distance;
-                            bestIndex = static_cast<int>(i);
-                        }
-                    }
-                    if (bestIndex != -1) {
-                        mActiveCameraIndex = bestIndex;
-                    }
-                }
+                mActiveChaseBoat = mSelectedUIBoat->GetID();
             }
 
             ImGui::Text("HP: %.1f", mSelectedUIBoat->GetHP());
@@ -411,6 +831,7 @@ void Scene::DrawGUI() {
                 setHP = std::max(0.0f, setHP); // Prevent negative HP
                 if (setHP < mSelectedUIBoat->GetHP()) {
                     mSelectedUIBoat->SetHP(setHP);
+                    mBoatLabels[mSelectedUIBoat->GetID()].dirty = true;
                 }
             }
 
@@ -422,6 +843,7 @@ void Scene::DrawGUI() {
             if (ImGui::Button("Apply Missiles")) {
                 setMissiles = std::max(0, setMissiles); // Prevent negative missiles
                 mSelectedUIBoat->AddMissiles(setMissiles);
+                mBoatLabels[mSelectedUIBoat->GetID()].dirty = true;
             }
 
             // Display the current team
@@ -437,22 +859,24 @@ void Scene::DrawGUI() {
             // Change Boat State buttons.
             ImGui::Text("Change State:");
             if (ImGui::Button("Stop Boat")) {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Stop);
+                OrderBoat(mSelectedUIBoat->GetID(), MessageType::Stop);
             }
-            ImGui::SameLine();
-            if (ImGui::Button("Destroy Boat")) {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Die);
+            if (!mNetClient) { // Only orders are sent to a server
+                ImGui::SameLine();
+                if (ImGui::Button("Destroy Boat")) {
+                    gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Die);
+                }
             }
             if (ImGui::Button("Patrol")) {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Start);
+                OrderBoat(mSelectedUIBoat->GetID(), MessageType::Start);
             }
             ImGui::SameLine();
             if (ImGui::Button("Evade")) {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Evade);
+                OrderBoat(mSelectedUIBoat->GetID(), MessageType::Evade);
             }
             ImGui::SameLine();
             if (ImGui::Button("Inactive")) {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedUIBoat->GetID(), MessageType::Stop);
+                OrderBoat(mSelectedUIBoat->GetID(), MessageType::Stop);
             }
         }
     }
@@ -491,196 +915,1109 @@ void Scene::DrawGUI() {
             ImGui::ShowStyleEditor();
             ImGui::TreePop();
         }
+
+        // Write a larger level for scaling tests, from Entities.xml's templates
+        if (ImGui::TreeNode("Scenario Generator")) {
+            CheckLevelGeneration(false);
+            for (float factor : { 10.0f, 100.0f, 1000.0f }) {
+                char label[16];
+                snprintf(label, sizeof(label), "x%d", static_cast<int>(factor));
+                if (ImGui::Button(label))  mGeneratorSettings = LevelGeneratorSettings().Scaled(factor);
+                ImGui::SameLine();
+            }
+            if (ImGui::Button("Reset"))  mGeneratorSettings = {};
+            auto inputCount = [](const char* label, uint32_t& count) {
+                int value = static_cast<int>(count);
+                if (ImGui::InputInt(label, &value))  count = static_cast<uint32_t>(std::max(value, 0));
+            };
+            inputCount("Boats Per Team", mGeneratorSettings.boatsPerTeam);
+            inputCount("Obstacles", mGeneratorSettings.obstacles);
+            inputCount("Reload Stations", mGeneratorSettings.reloadStations);
+            inputCount("Max Crates", mGeneratorSettings.maxCrates);
+            inputCount("Max Mines", mGeneratorSettings.maxMines);
+            ImGui::InputFloat("World Size", &mGeneratorSettings.worldSize, 100.0f, 1000.0f, "%.0f");
+            ImGui::InputFloat("Cell Size (0 - not streamed)", &mGeneratorSettings.cellSize, 100.0f, 500.0f, "%.0f");
+            if (ImGui::Button("Generate"))  GenerateLevelFile();
+            if (!mGeneratorStatus.empty())  ImGui::TextUnformatted(mGeneratorStatus.c_str());
+            ImGui::TreePop();
+        }
     }
 
     // ===================== Debugging & Metrics =====================
     if (ImGui::CollapsingHeader("Debugging & Metrics")) {
-        // Metrics Window
-        static bool showMetricsWindow = false;
-        if (ImGui::Checkbox("Show Metrics Window", &showMetricsWindow)) {
-            if (showMetricsWindow) ImGui::ShowMetricsWindow(&showMetricsWindow);
+        // Frustum culling results for the last camera view
+        const auto& renderStats = gEntityManager->GetRenderStats();
+        ImGui::Text("Entities Drawn: %u  Culled: %u", renderStats.rendered, renderStats.culled);
+
+        // Entities sharing a mesh drawn together with one draw call for each part of the mesh
+        ImGui::Checkbox("Instanced Rendering", &gEntityManager->InstancedRendering());
+        ImGui::Text("Instanced: %u entities in %u batches", renderStats.instanced, renderStats.batches);
+
+        // Scenery merged at load into one draw per material in each grid cell
+        ImGui::Checkbox("Static Batching", &gEntityManager->StaticBatching());
+        ImGui::Text("Static Batched: %u entities  Draws: %u  Culled: %u", gEntityManager->GetNumStaticBatched(),
+                    renderStats.staticBatchDraws, renderStats.staticBatchesCulled);
+
+        // Instanced entities frustum culled by a compute shader and drawn with indirect draws, the visible count stays on the GPU
+        if (mGpuCuller) {
+            ImGui::Checkbox("GPU Culling", &mGpuCuller->Enabled());
+            ImGui::Text("GPU Culled: %u entities  Indirect Draws: %u", renderStats.gpuCulled, renderStats.indirectDraws);
+            auto& sceneStats = mGpuCuller->Scene().GetStats();
+            ImGui::Text("Scene Buffer Uploads: %u entries  %u matrices  %.1fKB", sceneStats.entries, sceneStats.matrices,
+                        sceneStats.bytes / 1024.0f);
         }
 
-        // Style Editor Window
-        static bool showStyleEditor = false;
-        if (ImGui::Checkbox("Show Style Editor", &showStyleEditor)) {
-            if (showStyleEditor) {
-                ImGui::Begin("Style Editor", &showStyleEditor);
-                ImGui::ShowStyleEditor();
-                ImGui::End();
-            }
-        }
-    }
+        // Simpler meshes for entities that are small on screen
+        ImGui::Checkbox("Level Of Detail", &gEntityManager->LevelOfDetail());
+        ImGui::Text("Reduced Detail: %u entities", renderStats.reducedDetail);
 
-    // End of the main Control Panel window
-    ImGui::End();
-}
+        // Guns of boats small on screen or out of view turned less often, or not at all
+        auto& weaponStats = gEntityManager->Weapons().GetStats();
+        ImGui::Checkbox("Animation Level Of Detail", &gEntityManager->Weapons().LevelOfDetail());
+        ImGui::Text("Guns Animated: %u  Reduced Rate: %u  Skipped: %u", weaponStats.fullRate, weaponStats.reducedRate, weaponStats.skipped);
 
+        // Distant islands and boats drawn as a single quad showing a baked view of their mesh
+        if (mImpostorRenderer) {
+            ImGui::Checkbox("Impostors", &mImpostorRenderer->Enabled());
+            ImGui::Text("Impostors: %u entities in %u draws  Baked: %u", renderStats.impostors,
+                        mImpostorRenderer->GetStats().draws, mImpostorRenderer->NumBaked());
+        }
 
-//--------------------------------------------------------------------------------------
-// Render From Camera
-//--------------------------------------------------------------------------------------
-void Scene::RenderFromCamera(Camera* camera)
-{
-    // Set camera matrices in the constant buffer and send over to GPU
-	gPerCameraConstants.cameraMatrix         = camera->Transform();
-	gPerCameraConstants.viewMatrix           = camera->GetViewMatrix();
-	gPerCameraConstants.projectionMatrix     = camera->GetProjectionMatrix();
-    gPerCameraConstants.viewProjectionMatrix = camera->GetViewProjectionMatrix();
-	gPerCameraConstants.cameraPosition       = camera->Transform().Position();
-    DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+        // Particles for missiles, hits and mine blasts, emitted and simulated by compute shaders. The number alive stays on the GPU
+        if (mParticleSystem) {
+            ImGui::Checkbox("Particles", &mParticleSystem->Enabled());
+            ImGui::Text("Particles: %u emitted in %u bursts  Pool: %u", mParticleSystem->GetStats().particles,
+                        mParticleSystem->GetStats().bursts, ParticleSystem::MAX_PARTICLES);
+        }
 
-    // Target the back buffer for rendering, clear depth buffer
-    DX->Context()->OMSetRenderTargets(1, &DX->BackBuffer(), DX->DepthBuffer());
-    DX->Context()->ClearDepthStencilView(DX->DepthBuffer(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+        // Missile glows, explosion flashes and reload station lights, binned into clusters of each view for the pixel shaders
+        if (mClusteredLights) {
+            const ClusteredLights::Stats& lightStats = mClusteredLights->GetStats();
+            ImGui::Checkbox("Clustered Lights", &mClusteredLights->Enabled());
+            ImGui::Text("Lights: %u (%u flashes)  Cluster entries: %u  Most in a cluster: %u", lightStats.lights,
+                        lightStats.flashes, lightStats.indices, lightStats.maxClusterLights);
+        }
 
-    // Render solid models (render group 0)
-    DX->States()->SetRasterizerState(RasterizerState::CullBack); // Default GPU states for non-blended rendering
-    DX->States()->SetDepthState(DepthState::DepthOn);
-    DX->States()->SetBlendState(BlendState::BlendNone);
-    gEntityManager->RenderGroup(0);
+        // Shadows of the main light. The static scenery is rendered into a cached map, only the moving entities every frame
+        if (mShadowMap) {
+            const ShadowMap::Stats& shadowStats = mShadowMap->GetStats();
+            ImGui::Checkbox("Shadows", &mShadowMap->Enabled());
+            ImGui::Text("Shadow casters: %u static (map rendered %u times)  %u moving", shadowStats.staticCasters,
+                        shadowStats.staticRenders, shadowStats.dynamicCasters);
+        }
 
-    // Render additive blended models (render group 1)
-    DX->States()->SetRasterizerState(RasterizerState::CullNone); // GPU states for additive blending
-    DX->States()->SetDepthState(DepthState::DepthReadOnly);      // Don't write to depth buffer to stop sorting errors on additive / multiplicative blending and similar
-    DX->States()->SetBlendState(BlendState::BlendAdditive);
-    gEntityManager->RenderGroup(1);
-}
+        // The sea drawn as a tessellated grid around the camera rather than the water meshes, see WaterRenderer.h
+        if (mWaterRenderer) {
+            WaterRenderer::Settings& water = mWaterRenderer->GetSettings();
+            ImGui::Checkbox("Tessellated Water", &water.enabled);
+            if (water.enabled) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Wireframe##Water", &water.wireframe);
+                ImGui::SliderFloat("Wave Height", &water.waveScale, 0.0f, 3.0f, "%.2f");
+                ImGui::SliderFloat("Wave Steepness", &water.steepness, 0.0f, 1.0f, "%.2f");
+                ImGui::SliderFloat("Water Tessellation", &water.tessellationScale, 1.0f, 64.0f, "%.0f");
+            }
+        }
 
+        // Combinations of shaders, input layout and states drawn offscreen as templates loaded, and shaders read from the shader pack
+        if (mShaderPrewarm) {
+            ImGui::Text("Pre-warmed shader combinations: %u  Packed shaders: %zu", mShaderPrewarm->CombinationCount(),
+                        DX->Shaders()->PackedShaderCount());
+        }
 
-//--------------------------------------------------------------------------------------
-// Update Chase Cameras
-//--------------------------------------------------------------------------------------
-void Scene::UpdateChaseCameras(float frameTime)
-{
-    size_t cameraIndex = 0; // To track chase cameras corresponding to boats
-    std::vector<std::unique_ptr<Camera>> validCameras; // Store valid cameras
+        // Passes run and culled by the render graph last frame, and its transient textures before and after aliasing
+        const RenderGraph::Stats& graphStats = mRenderGraph->GetStats();
+        ImGui::Text("Render graph passes: %u (%u culled)  Transient textures: %u in %.1f MB (%.1f MB unaliased)  Pool: %u, %.1f MB",
+                    graphStats.passes - graphStats.culledPasses, graphStats.culledPasses, graphStats.transients,
+                    graphStats.pooledBytes / (1024.0f * 1024.0f), graphStats.transientBytes / (1024.0f * 1024.0f),
+                    graphStats.pooledTextures, graphStats.poolBytes / (1024.0f * 1024.0f));
+
+        // Mass battle mode, missiles launched from now on are simulated and hit tested by compute shaders rather than being
+        // entities. Created when first turned on, as it needs the missile template, which is loaded in the background
+        if (!mGpuMissilesUnsupported) {
+            bool gpuMissiles = mGpuMissiles && mGpuMissiles->Enabled();
+            if (ImGui::Checkbox("GPU Missiles (mass battles)", &gpuMissiles) && gpuMissiles && !mGpuMissiles) {
+                try {
+                    EntityTemplate* missileTemplate = gEntityManager->ResolveTemplate(mMissileTemplate);
+                    if (missileTemplate == nullptr)  throw std::runtime_error("No missile template");
+                    mGpuMissiles = std::make_unique<GpuMissiles>(missileTemplate->GetMesh());
+                }
+                catch (const std::runtime_error&) {
+                    mGpuMissilesUnsupported = true; // Hide the setting
+                }
+            }
+            if (mGpuMissiles) {
+                mGpuMissiles->Enabled() = gpuMissiles;
+                ImGui::Text("GPU Missiles: %u in flight  Launched: %u  Hits: %u", mGpuMissiles->GetStats().inFlight,
+                            mGpuMissiles->GetStats().launched, mGpuMissiles->GetStats().hits);
+            }
+        }
 
-    // Associate each chase camera with its respective boat
-    allBoats = gEntityManager->GetAllBoatEntities();
+        // Cheaper shaders for sorted draws that are small on screen, normal mapping in place of parallax mapping and then neither
+        ImGui::Checkbox("Shader Level Of Detail", &gEntityManager->ShaderLevelOfDetail());
+        ImGui::Text("Reduced Shaders: %u draws", renderStats.reducedShaders);
 
-    for (Boat* boatPtr : allBoats)
-    {
-        if (!boatPtr || boatPtr->GetState() == "Destroyed") continue; // Skip destroyed boats
+        // Draws sorted by render state (shaders, textures, material) before they are submitted
+        ImGui::Checkbox("Sort Draws By State", &gEntityManager->SortedRendering());
+        ImGui::Text("Sorted Draws: %u  State Changes: %u  Saved: %d", renderStats.sortedDraws, renderStats.stateChanges,
+                    static_cast<int>(renderStats.unsortedStateChanges) - static_cast<int>(renderStats.stateChanges));
 
-        // Ensure we have enough chase cameras for the boats
-        if (cameraIndex >= mChaseCameras.size()) break;
+        // Large sets of sorted draws recorded on worker threads into deferred contexts, then submitted in order
+        ImGui::Checkbox("Record Draws In Parallel", &gEntityManager->ParallelRecording());
+        ImGui::Text("Command Lists: %u", renderStats.commandLists);
 
-        // Get the associated chase camera
-        Camera* chaseCam = mChaseCameras[cameraIndex].get();
-        if (!chaseCam)
-        {
-            ++cameraIndex;
-            continue;
+        // Per-draw constants written into one large buffer and bound at offsets, rather than a discard of a small buffer per draw
+        if (DX->CBuffers()->IsRingSupported()) {
+            ImGui::Checkbox("Constant Buffer Ring", &DX->CBuffers()->UseRing());
+            const auto& cbufferStats = DX->CBuffers()->GetStats();
+            ImGui::Text("Ring Updates: %u  Wraps: %u", cbufferStats.ringUpdates, cbufferStats.ringWraps);
+        }
+        else {
+            ImGui::Text("Constant Buffer Ring: Unsupported");
         }
 
-        // Update valid cameras list
-        validCameras.emplace_back(std::move(mChaseCameras[cameraIndex]));
+        // Occlusion culling of moving entities behind obstacles and other scenery, results arrive a frame or more later
+        ImGui::Checkbox("Occlusion Culling", &mOcclusionCuller->Enabled());
+        const auto& occlusionStats = mOcclusionCuller->GetStats();
+        ImGui::Text("Occlusion Tests: %u  Hidden: %u  Visible: %u", occlusionStats.tests, occlusionStats.hidden, occlusionStats.visible);
 
-        // Get boat's position and forward direction
-        Vector3 boatPos = boatPtr->Transform().Position();
-        Vector3 boatForward = boatPtr->Transform().ZAxis();
+        // Pick the boat exactly under the cursor from an ID buffer rather than the nearest boat position on screen
+        ImGui::Checkbox("GPU ID Picking", &mGpuPicking);
+        if (mGpuPicking)  ImGui::Text("Under Cursor: %s", mNearestEntity ? mNearestEntity->GetName().c_str() : "None");
 
-        // Desired camera position: behind the boat at a fixed distance and increased height
-        Vector3 desiredPos = boatPos - boatForward * mChaseDistance + Vector3(0, mChaseHeight, 0);
+        // Depth of the static solid entities rendered first so their pixel shaders only run for the visible surface
+        ImGui::Checkbox("Depth Pre-Pass", &mDepthPrePass);
 
-        // Smoothly interpolate camera position for smooth following
-        Vector3 currentPos = chaseCam->Transform().Position();
-        float smoothSpeed = 5.0f;
-        Vector3 newPos = Lerp(currentPos, desiredPos, smoothSpeed * frameTime);
-        chaseCam->Transform().Position() = newPos;
+        // How many times each pixel of the main view is shaded, from dark red for once to white for many (see RenderFromCamera)
+        ImGui::Checkbox("Overdraw Heatmap", &mShowOverdraw);
 
-        // Calculate yaw based on boat's forward direction
-        float yaw = std::atan2(boatForward.x, boatForward.z);
+        // Chase cameras of other boats in small views over the main one, culled together (see RenderPictureInPicture)
+        ImGui::SliderInt("Picture-in-Picture Views", &mPipViews, 0, MAX_PIP_VIEWS);
+        if (mPipViews > 0)  ImGui::SliderFloat("Picture-in-Picture Size", &mPipSize, 0.1f, 0.25f, "%.2f");
 
-        // Set a fixed downward pitch angle
-        float pitch = mChasePitch;
+        // Scene resolution reduced to keep the GPU frame time (see the profiler below) within the budget
+        ImGui::Checkbox("Dynamic Resolution", &mDynamicResolution->Enabled());
+        if (mDynamicResolution->Enabled()) {
+            ImGui::SliderFloat("GPU Budget (ms)", &mDynamicResolution->Budget(), 2.0f, 33.0f, "%.1f");
+            ImGui::Text("Render Scale: %.0f%%  (%ux%u)", DX->RenderScale() * 100.0f, DX->GetSceneWidth(), DX->GetSceneHeight());
+        }
 
-        // Apply rotation to the chase camera
-        chaseCam->Transform().SetRotation({ pitch, yaw, 0 });
+        // Light meshes, shields and particles of the main view drawn with a quarter of the pixels, then upsampled by depth
+        if (mHalfResEffects)  ImGui::Checkbox("Half Resolution Effects", &mHalfResEffects->Enabled());
 
-        // Move to the next camera
-        ++cameraIndex;
-    }
+        // Blended entities drawn in any order with weighted blended transparency, rather than sorted back to front each frame
+        if (mWeightedOit)  ImGui::Checkbox("Order-Independent Transparency", &mWeightedOit->Enabled());
 
-    // Replace mChaseCameras with only valid cameras
-    mChaseCameras = std::move(validCameras);
+        // GPU memory used by the process against the budget the OS allows it. Keeping to it sets the texture budget and lowers
+        // the levels of detail if need be (see MemoryBudget.h), otherwise the texture budget is set here
+        const auto& videoMemory = DX->GetVideoMemory();
+        if (mMemoryBudget.IsSupported()) {
+            ImGui::Text("GPU Memory: %.0fMB of %.0fMB budget  Budget changes: %u", videoMemory.usage / (1024.0 * 1024.0),
+                        videoMemory.budget / (1024.0 * 1024.0), videoMemory.budgetChanges);
+            ImGui::Checkbox("Keep To GPU Memory Budget", &mMemoryBudget.Enabled());
+        }
+        if (mMemoryBudget.IsSupported() && mMemoryBudget.Enabled()) {
+            ImGui::Text("Texture Budget: %dMB  LOD Scale: %.2f", DX->Textures()->BudgetMB(), mMemoryBudget.LODScale());
+        }
+        else {
+            // Streamed textures not drawn recently are evicted to stay within the budget (0 - no limit)
+            ImGui::SliderInt("Texture Budget (MB)", &DX->Textures()->BudgetMB(), 0, 4096);
+        }
+        const auto& textureStats = DX->Textures()->GetStats();
+        ImGui::Text("Textures: %u  Streamed: %u  Streaming: %u", textureStats.textures, textureStats.streamed, textureStats.streaming);
+        ImGui::Text("Texture Memory: %.1fMB  Streamed: %.1fMB", textureStats.bytes / (1024.0 * 1024.0), textureStats.streamedBytes / (1024.0 * 1024.0));
+        ImGui::Text("Evicted Mips: %u  Textures: %u", textureStats.evictedMips, textureStats.evictedTextures);
+        ImGui::Text("Texture Arrays: %u  Materials: %u", textureStats.textureArrays, textureStats.arrayMaterials);
+
+        // GPU time of each render pass over the last few seconds, read back a few frames late so profiling never stalls
+        if (ImGui::TreeNode("GPU Profiler")) {
+            auto profiler = DX->Profiler();
+            ImGui::Checkbox("Enable GPU Profiling", &profiler->Enabled());
+            auto plotScope = [](const GpuProfiler::Scope& scope) {
+                char overlay[32];
+                snprintf(overlay, sizeof(overlay), "%.2fms", scope.milliseconds);
+                ImGui::PlotLines(scope.name.c_str(), scope.history.data(), GpuProfiler::HISTORY_SIZE, scope.historyStart,
+                                 overlay, 0.0f, FLT_MAX, ImVec2(0, 40));
+            };
+            plotScope(profiler->FrameTime());
+            for (const auto& scope : profiler->Scopes())  plotScope(scope);
+
+            // Work each scope gave the pipeline, pixel shader invocations per pixel of the scene is the overdraw
+            ImGui::Checkbox("Pipeline Statistics", &profiler->PipelineStatistics());
+            if (profiler->PipelineStatistics() &&
+                ImGui::BeginTable("Pipeline Statistics", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+                for (const char* heading : { "Scope", "VS Invocations", "Primitives", "Clipper In", "Clipper Out", "PS Invocations", "PS / Pixel" })
+                    ImGui::TableSetupColumn(heading);
+                ImGui::TableHeadersRow();
+                double scenePixels = std::max(1.0, static_cast<double>(DX->GetBackbufferWidth()) * DX->RenderScale() *
+                                                   DX->GetBackbufferHeight() * DX->RenderScale());
+                auto statisticsRow = [scenePixels](const GpuProfiler::Scope& scope) {
+                    const auto& statistics = scope.statistics;
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(scope.name.c_str());
+                    for (UINT64 value : { statistics.VSInvocations, statistics.IAPrimitives, statistics.CInvocations, statistics.CPrimitives,
+                                          statistics.PSInvocations }) {
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(value));
+                    }
+                    ImGui::TableNextColumn(); ImGui::Text("%.2f", statistics.PSInvocations / scenePixels);
+                };
+                statisticsRow(profiler->FrameTime());
+                for (const auto& scope : profiler->Scopes())  statisticsRow(scope);
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
 
-    // Ensure active camera index remains valid
-    if (mActiveCameraIndex >= static_cast<int>(mChaseCameras.size()))
-    {
-        mActiveCameraIndex = static_cast<int>(mChaseCameras.size()) - 1;
-    }
+        // Rolling min / average / percentiles / max of the slots timed with TIMING_SCOPE, over the last few seconds of frames
+        if (ImGui::TreeNode("Timing Stats")) {
+            if (ImGui::BeginTable("Timing Stats", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+                for (const char* heading : { "Slot (ms)", "Min", "Average", "P50", "P95", "P99", "Max", "Calls" })  ImGui::TableSetupColumn(heading);
+                ImGui::TableHeadersRow();
+                for (int slot = 0; slot < gTimingStats.NumSlots(); ++slot) {
+                    const RollingStats& stats = gTimingStats.Stats(slot);
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(gTimingStats.Name(slot));
+                    for (double value : { static_cast<double>(stats.Min()), stats.Average(), static_cast<double>(stats.Percentile(0.5)),
+                                          static_cast<double>(stats.Percentile(0.95)), static_cast<double>(stats.Percentile(0.99)),
+                                          static_cast<double>(stats.Max()) }) {
+                        ImGui::TableNextColumn(); ImGui::Text("%.3f", value * 1e-6);
+                    }
+                    ImGui::TableNextColumn(); ImGui::Text("%u", gTimingStats.LastFrameCalls(slot));
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
 
-    if (mChaseCameras.empty())
-    {
-        mActiveCameraIndex = -1; // No available chase cameras
-    }
-}
+        // Draw calls, binds, state changes and constant buffer updates in the last frame, in total and for each GPU profiler scope
+        if (ImGui::TreeNode("Render Counters")) {
+            const RenderCounters::Frame& counts = gRenderCounters.LastFrame();
+            int columns = static_cast<int>(std::min<size_t>(counts.passes.size() + 2, 64));
+            if (ImGui::BeginTable("Render Counters", columns, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("Counter");
+                ImGui::TableSetupColumn("Frame");
+                for (int pass = 0; pass < columns - 2; ++pass)  ImGui::TableSetupColumn(counts.passes[pass].name.c_str());
+                ImGui::TableHeadersRow();
+                for (int counter = 0; counter < RenderCounters::NUM_COUNTERS; ++counter) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(RenderCounters::Name(static_cast<RenderCounter>(counter)));
+                    ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(counts.total[counter]));
+                    for (int pass = 0; pass < columns - 2; ++pass) {
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(counts.passes[pass].counts[counter]));
+                    }
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
 
+        // Text labels drawn, culled and laid out again in the last frame, see LabelRenderer.h
+        if (ImGui::TreeNode("Labels")) {
+            const LabelRenderer::Stats& labelStats = mLabelRenderer->GetStats();
+            ImGui::Text("Visible: %u, culled: %u, laid out: %u", labelStats.visibleLabels, labelStats.culledLabels, labelStats.laidOutLabels);
+            ImGui::Text("Glyphs: %u in 1 draw, cached labels: %u", labelStats.glyphs, labelStats.cachedLabels);
+            ImGui::Text("Floating text: %u popups in 1 draw, %u texts", mFloatingTextRenderer->NumPopups(), gFloatingText.NumTexts());
+            ImGui::TreePop();
+        }
 
-//--------------------------------------------------------------------------------------
-// Scene Update
-//--------------------------------------------------------------------------------------
+        // CPU time of the scopes marked with PROFILE_SCOPE in the last frame, on every thread
+        if (ImGui::TreeNode("CPU Profiler")) {
+            bool enabled = gCpuProfiler.IsEnabled();
+            if (ImGui::Checkbox("Enable CPU Profiling", &enabled))  gCpuProfiler.SetEnabled(enabled);
+            ImGui::SameLine();
+            ImGui::Checkbox("Freeze", &gCpuProfiler.Frozen());
+            gCpuProfiler.DrawTimeline();
+            ImGui::TreePop();
+        }
 
-// Update entire scene. frameTime is the time passed since the last frame
-void Scene::Update(float frameTime)
-{
-    mRandomCrateTimer -= frameTime;
-    mRandomMineTimer -= frameTime;
+        // CPU time of updating and rendering each type of entity in the last frame, and the most expensive entities
+        if (ImGui::TreeNode("Entity Costs")) {
+            gEntityManager->Costs().Draw(*gEntityManager);
+            ImGui::TreePop();
+        }
 
-    if (mGamePaused) {
-        return;
+        // GPU time of drawing each template and surface render method, measuring a few templates each frame in turn
+        if (ImGui::TreeNode("GPU Template Costs")) {
+            gEntityManager->GpuCosts().Draw();
+            ImGui::TreePop();
+        }
+
+        // Heap allocations in the last frame by subsystem (see ALLOCATION_SCOPE) and the places allocating the most
+        if (ImGui::TreeNode("Allocations")) {
+            gAllocationTracker.DrawStats();
+            ImGui::Text("Frame arena: %.1fKB of %.1fKB, peak %.1fKB, %u frames overflowed", gFrameArena.BytesUsed() / 1024.0,
+                        gFrameArena.Capacity() / 1024.0, gFrameArena.PeakBytes() / 1024.0, gFrameArena.Overflows());
+            ImGui::TreePop();
+        }
+
+        // The last few seconds of CPU scopes, GPU times and counters, saved as a file for chrome://tracing or ui.perfetto.dev
+        if (ImGui::TreeNode("Trace Capture")) {
+            if (ImGui::Checkbox("Capture Trace", &mTraceCapturing) && mTraceCapturing)  gCpuProfiler.SetEnabled(true);
+            ImGui::SliderFloat("Seconds Kept", &mTraceCapture.Seconds(), 1.0f, 60.0f, "%.0f");
+            ImGui::SliderFloat("Save Over Budget (ms)", &mTraceBudget, 0.0f, 100.0f, "%.1f");
+            ImGui::Text("Held: %.1fs  %zu frames", mTraceCapture.SecondsHeld(), mTraceCapture.NumFrames());
+            if (ImGui::Button("Save Trace (F11)"))  SaveTrace();
+            if (!mTraceStatus.empty())  ImGui::TextUnformatted(mTraceStatus.c_str());
+            ImGui::TreePop();
+        }
+
+        // Frames much slower than the ones before them saved with the world and stats, see FrameWatchdog.h
+        if (ImGui::TreeNode("Spike Watchdog")) {
+            if (ImGui::Checkbox("Watch For Spikes", &mWatchdogEnabled)) {
+                if (mWatchdogEnabled) {
+                    mTraceCapturing = true;
+                    gCpuProfiler.SetEnabled(true);
+                    gAllocationTracker.SetEnabled(true);
+                    gMessenger->StatsEnabled() = true;
+                    mFrameWatchdog.Reset();
+                }
+                else {
+                    ResumeAfterSpike();
+                }
+            }
+            ImGui::SameLine();
+            ImGui::Checkbox("Freeze On Spike", &mFreezeOnSpike);
+            ImGui::SliderFloat("Times Baseline", &mFrameWatchdog.Multiple(), 1.5f, 10.0f, "%.1f");
+            ImGui::SliderFloat("Minimum (ms)", &mFrameWatchdog.MinimumMs(), 0.0f, 200.0f, "%.0f");
+            ImGui::SliderFloat("Cool Down (s)", &mFrameWatchdog.CoolDownSeconds(), 0.0f, 60.0f, "%.0f");
+            ImGui::Text("Baseline: %.2fms  Spikes: %u", mFrameWatchdog.Baseline(), mFrameWatchdog.SpikesReported());
+            if (mSpikeFrozen) {
+                ImGui::TextUnformatted("Frozen on the spike");
+                ImGui::SameLine();
+                if (ImGui::Button("Resume"))  ResumeAfterSpike();
+            }
+            if (!mSpikeStatus.empty())  ImGui::TextUnformatted(mSpikeStatus.c_str());
+            ImGui::TreePop();
+        }
+
+        // Time spent in each part of startup, also written to StartupReport.txt
+        if (gStartupProfile.Scopes().size() > 0 && ImGui::TreeNode("Startup Report")) {
+            const auto& scopes = gStartupProfile.Scopes();
+            std::function<void(uint32_t)> showScope = [&](uint32_t index) {
+                const auto& scope = scopes[index];
+                ImGuiTreeNodeFlags flags = scope.children.empty() ? ImGuiTreeNodeFlags_Leaf : 0;
+                bool open = ImGui::TreeNodeEx(reinterpret_cast<void*>(static_cast<uintptr_t>(index)), flags,
+                                              "%.1fms  %.2fMB read  %.2fMB uploaded  %s", scope.seconds * 1000.0,
+                                              scope.bytesRead / (1024.0 * 1024.0), scope.bytesUploaded / (1024.0 * 1024.0), scope.name.c_str());
+                if (open) {
+                    for (auto child : scope.children)  showScope(child);
+                    ImGui::TreePop();
+                }
+            };
+            for (auto root : gStartupProfile.Roots())  showScope(root);
+            ImGui::TreePop();
+        }
+
+        // Message traffic for the last complete frame and since collection started
+        if (ImGui::TreeNode("Message Traffic")) {
+            ImGui::Checkbox("Collect Message Stats", &gMessenger->StatsEnabled());
+            ImGui::Checkbox("Validate Recipients On Send", &gMessenger->ValidateRecipients());
+            ImGui::Checkbox("Lock-Free Queue For Worker Messages", &gMessenger->UseLockFreeQueue());
+            const auto& messageStats = gMessenger->GetStats();
+            const auto& lastFrame = messageStats.lastFrame;
+            ImGui::Text("Last Frame: %u messages, at most %u for one entity, %u delayed waiting",
+                        lastFrame.inboxSize, lastFrame.peakMailbox, lastFrame.delayedWaiting);
+            ImGui::Text("Peak: %u messages in a frame, %u for one entity, over %u frames",
+                        messageStats.peakInboxSize, messageStats.peakMailbox, messageStats.framesCounted);
+            ImGui::Text("Message Size: %zu bytes, largest payload %zu of %zu bytes",
+                        sizeof(Message), PayloadSizes<MessageData>::largest, MESSAGE_PAYLOAD_BUDGET);
+
+            // Last frame's counts for each type, with the total sent. Types never sent are left out
+            if (ImGui::BeginTable("Message Types", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Type");
+                ImGui::TableSetupColumn("Sent");
+                ImGui::TableSetupColumn("Received");
+                ImGui::TableSetupColumn("Unread");
+                ImGui::TableSetupColumn("Dead IDs");
+                ImGui::TableSetupColumn("Total Sent");
+                ImGui::TableHeadersRow();
+                for (int type = 0; type < NUM_MESSAGE_TYPES; ++type) {
+                    if (messageStats.totals[type].sent == 0) continue;
+                    const auto& counts = lastFrame.types[type];
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(MessageTypeName(static_cast<MessageType>(type)));
+                    ImGui::TableNextColumn(); ImGui::Text("%u", counts.sent);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", counts.received);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", counts.unread);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", counts.deadLetters + counts.discarded);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", messageStats.totals[type].sent);
+                }
+                ImGui::EndTable();
+            }
+
+            // Frames taken from sending to reading, only delayed messages take more than one
+            float delayHistogram[Messenger::NUM_DELAY_BUCKETS];
+            for (int bucket = 0; bucket < Messenger::NUM_DELAY_BUCKETS; ++bucket) {
+                delayHistogram[bucket] = static_cast<float>(messageStats.delayHistogram[bucket]);
+            }
+            ImGui::PlotHistogram("Frames To Read", delayHistogram, Messenger::NUM_DELAY_BUCKETS, 0,
+                                 "1, 2, 3-4, 5-8, ... 65+", 0.0f, FLT_MAX, ImVec2(0, 60));
+
+            static const char* exportResult = "";
+            if (ImGui::Button("Export CSV")) {
+                exportResult = gMessenger->ExportStats("MessageStats.csv") ? "Saved MessageStats.csv" : "Failed to save MessageStats.csv";
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset")) {
+                gMessenger->ResetStats();
+                exportResult = "";
+            }
+            ImGui::TextUnformatted(exportResult);
+
+            // Compare the ways of collecting messages from worker threads, sending to the current boats
+            static MessengerBenchmarkResults benchmarkResults;
+            if (ImGui::Button("Run Messenger Benchmark")) {
+                std::vector<EntityID> boatIDs;
+                for (Boat* boat : gEntityManager->View<Boat>())  boatIDs.push_back(boat->GetID());
+                benchmarkResults = RunMessengerBenchmark(*gJobSystem, boatIDs);
+            }
+            if (benchmarkResults.messagesPerFrame > 0) {
+                ImGui::Text("%u messages/frame - Chunk Buffers: %.3fms  Lock-Free Queue: %.3fms",
+                            benchmarkResults.messagesPerFrame, benchmarkResults.chunkBufferMs, benchmarkResults.lockFreeQueueMs);
+            }
+
+            // Record every frame's messages to a file, then time delivering them again without the rest of the game
+            bool journalling = gMessenger->IsJournalling();
+            if (ImGui::Checkbox("Record Message Journal", &journalling)) {
+                if (journalling) gMessenger->StartJournal("Messages.journal");
+                else             gMessenger->StopJournal();
+            }
+            static MessageReplayResults replayResults;
+            if (!journalling && ImGui::Button("Replay Journal")) {
+                replayResults = ReplayMessageJournal("Messages.journal");
+            }
+            if (replayResults.loaded) {
+                ImGui::Text("%u frames, %llu messages (%llu read) in %.3fms", replayResults.frames,
+                            replayResults.messages, replayResults.messagesRead, replayResults.totalMs);
+                ImGui::Text("Worst: frame %u, %u messages in %.3fms", replayResults.worstFrame,
+                            replayResults.worstFrameMessages, replayResults.worstFrameMs);
+            }
+            ImGui::TreePop();
+        }
+
+        // Shields and other visual entities created before their template has loaded are drawn as boxes until it streams in
+        ImGui::Checkbox("Stream Templates", &gEntityManager->TemplateStreaming());
+        ImGui::SameLine();
+        ImGui::Text("%zu pending, %zu entities waiting", gEntityManager->PendingTemplateCount(),
+                    gEntityManager->StreamingEntityCount());
+
+        // Memory used by each template's meshes, textures and render states, to find the assets most worth simplifying or
+        // compressing. Gathered when opened, when templates load or unload, and on request, as it looks at every mesh
+        if (ImGui::TreeNode("Template Memory")) {
+            static std::vector<EntityManager::TemplateMemory> memoryReport;
+            static size_t reportTemplates = SIZE_MAX;
+            static bool sortReport = true;
+            if (ImGui::Button("Refresh") || reportTemplates != gEntityManager->TemplateCount()) {
+                memoryReport = gEntityManager->GetTemplateMemory();
+                reportTemplates = gEntityManager->TemplateCount();
+                sortReport = true;
+            }
+            ImGui::SameLine();
+            static const char* memoryExportResult = "";
+            if (ImGui::Button("Export CSV##Memory")) {
+                memoryExportResult = EntityManager::ExportTemplateMemory(memoryReport, "TemplateMemory.csv")
+                                   ? "Saved TemplateMemory.csv" : "Failed to save TemplateMemory.csv";
+            }
+            ImGui::SameLine();
+            ImGui::TextUnformatted(memoryExportResult);
+
+            MeshMemory total;
+            for (const auto& row : memoryReport)  total.Add(row.memory);
+            auto kb = [](uint64_t bytes) { return static_cast<double>(bytes) / 1024.0; };
+            ImGui::Text("Templates: %.1f MB GPU, %.1f MB CPU, %u render states", kb(total.GpuBytes()) / 1024.0, kb(total.cpuBytes) / 1024.0, total.renderStates);
+            if (DX != nullptr) {
+                ImGui::Text("All textures: %.1f MB, constant buffers: %.1f KB", kb(DX->Textures()->GetStats().bytes) / 1024.0,
+                            kb(DX->CBuffers()->GetBufferBytes()));
+            }
+
+            // Columns after the first three are in KB. Sorted by GPU memory, largest first, until a header is clicked
+            const char* columns[] = { "Template", "Entities", "LODs", "Vertices", "Indices", "Textures", "Constants", "GPU Total", "CPU", "States" };
+            const int numColumns = static_cast<int>(std::size(columns));
+            auto columnValue = [](const EntityManager::TemplateMemory& row, int column) -> uint64_t {
+                switch (column) {
+                    case 1:  return row.entities;
+                    case 2:  return row.lods;
+                    case 3:  return row.memory.vertexBytes;
+                    case 4:  return row.memory.indexBytes;
+                    case 5:  return row.memory.textureBytes;
+                    case 6:  return row.memory.constantBytes;
+                    case 7:  return row.memory.GpuBytes();
+                    case 8:  return row.memory.cpuBytes;
+                    default: return row.memory.renderStates;
+                }
+            };
+            ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit |
+                                         ImGuiTableFlags_Sortable | ImGuiTableFlags_ScrollY;
+            if (ImGui::BeginTable("Template Memory", numColumns, tableFlags, ImVec2(0, 300))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                for (int column = 0; column < numColumns; ++column) {
+                    ImGuiTableColumnFlags columnFlags = (column == 7) ? ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending
+                                                                      : ImGuiTableColumnFlags_None;
+                    ImGui::TableSetupColumn(columns[column], columnFlags);
+                }
+                ImGui::TableHeadersRow();
+
+                ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+                if (sortSpecs != nullptr && sortSpecs->SpecsCount > 0 && (sortSpecs->SpecsDirty || sortReport)) {
+                    int column = sortSpecs->Specs[0].ColumnIndex;
+                    bool ascending = sortSpecs->Specs[0].SortDirection == ImGuiSortDirection_Ascending;
+                    std::stable_sort(memoryReport.begin(), memoryReport.end(), [&](const auto& a, const auto& b) {
+                        if (column == 0)  return ascending ? a.type < b.type : b.type < a.type;
+                        return ascending ? columnValue(a, column) < columnValue(b, column) : columnValue(b, column) < columnValue(a, column);
+                    });
+                    sortSpecs->SpecsDirty = false;
+                    sortReport = false;
+                }
+
+                for (const auto& row : memoryReport) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn(); ImGui::TextUnformatted(row.type.c_str());
+                    ImGui::TableNextColumn(); ImGui::Text("%u", row.entities);
+                    ImGui::TableNextColumn(); ImGui::Text("%u", row.lods);
+                    for (int column = 3; column < numColumns - 1; ++column) {
+                        ImGui::TableNextColumn(); ImGui::Text("%.1f", kb(columnValue(row, column)));
+                    }
+                    ImGui::TableNextColumn(); ImGui::Text("%u", row.memory.renderStates);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::TreePop();
+        }
+
+        // Metrics Window
+        static bool showMetricsWindow = false;
+        if (ImGui::Checkbox("Show Metrics Window", &showMetricsWindow)) {
+            if (showMetricsWindow) ImGui::ShowMetricsWindow(&showMetricsWindow);
+        }
+
+        // Style Editor Window
+        static bool showStyleEditor = false;
+        if (ImGui::Checkbox("Show Style Editor", &showStyleEditor)) {
+            if (showStyleEditor) {
+                ImGui::Begin("Style Editor", &showStyleEditor);
+                ImGui::ShowStyleEditor();
+                ImGui::End();
+            }
+        }
+    }
+
+    // End of the main Control Panel window
+    ImGui::End();
+}
+
+// Update the boat list model if boats have come or gone since it was built, dropping the selection if its boat has gone
+void Scene::RefreshBoatList()
+{
+    uint64_t version = gEntityManager->GetBoatListVersion();
+    if (version == mBoatList.version)  return;
+    mBoatList.version = version;
+
+    mBoatList.ids.clear();
+    mBoatList.names.clear();
+    mBoatList.selected = -1;
+    for (Boat* boat : gEntityManager->View<Boat>()) {
+        if (boat->GetID() == mBoatList.selectedID) {
+            mBoatList.selected = static_cast<int>(mBoatList.ids.size());
+        }
+        mBoatList.ids.push_back(boat->GetID());
+        mBoatList.names.push_back(boat->GetName().c_str());
     }
+    if (mBoatList.selected < 0) {
+        mSelectedUIBoat = nullptr; // Its boat has gone
+        mBoatList.selectedID = NO_ID;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Render From Camera
+//--------------------------------------------------------------------------------------
 
-    // Update all entities
-    gEntityManager->UpdateAll(frameTime);
+// Passes of a camera view in the order they are drawn. Opaque entities first so the sky is only drawn where they don't cover
+// it, then blended entities over both. The UI pass is drawn by Render after the camera view
+static constexpr RenderPass RENDER_PASSES[] = { RenderPass::Opaque, RenderPass::Sky, RenderPass::Additive };
 
-    allBoatIDS = gEntityManager->GetAllBoatIDS();
+void Scene::RenderFromCamera(Camera* camera)
+{
+    SetCameraConstants(camera);
+
+    // Target the back buffer (or scene texture at reduced resolution) for rendering, the render graph has cleared the depth buffer
+    DX->Context()->OMSetRenderTargets(1, &DX->SceneTarget(), DX->DepthBuffer());
+
+    // Entities outside the camera's view are skipped, as are moving entities hidden behind static ones such as obstacles. The
+    // stats count what was drawn for the control panel
+    const Frustum& frustum = camera->GetFrustum();
+    gEntityManager->ResetRenderStats();
+    gEntityManager->SetLODView(camera->Transform().Position(), camera->GetProjectionMatrix().e11);
+    gEntityManager->Weapons().AddView(frustum, camera->Transform().Position(), camera->GetProjectionMatrix().e11);
+    mOcclusionCuller->BeginFrame(camera->Transform().Position(), camera->GetNearClip());
+
+    // The overdraw heatmap replaces every entity draw's pixel shader with one adding a little to black with additive blending,
+    // so a pixel's colour shows how many times it was shaded. The passes are otherwise unchanged, so the heatmap shows what the
+    // depth pre-pass, draw order and levels of detail save. The water, particles and GPU missiles have shaders of their own
+    // and are left out. Impostors keep their own shaders too, so show in their colours (added to the heat)
+    bool showOverdraw = mShowOverdraw;
+    if (showOverdraw && mOverdrawShader == nullptr)
+    {
+        mOverdrawShader = DX->Shaders()->LoadPixelShader("ps_overdraw");
+        if (mOverdrawShader == nullptr)  showOverdraw = mShowOverdraw = false;
+    }
+    if (showOverdraw)
+    {
+        const float black[4] = { 0, 0, 0, 1 };
+        DX->Context()->ClearRenderTargetView(DX->SceneTarget(), black);
+        RenderState::SetOverridePixelShader(mOverdrawShader);
+        DX->States()->OverrideBlendState(BlendState::BlendAdditive);
+    }
 
-    // Handle key inputs for starting and stopping boats
-    if (KeyHit(Key_1))
+    for (RenderPass pass : RENDER_PASSES)
     {
-        for (EntityID& boatID : allBoatIDS)
+        switch (pass)
         {
-            gMessenger->DeliverMessage(SYSTEM_ID, boatID, MessageType::Start);
+            case RenderPass::Opaque:    RenderOpaquePass(frustum);    break;
+            case RenderPass::Sky:       RenderSkyPass(frustum);       break;
+            case RenderPass::Additive:  RenderAdditivePass(frustum);  break;
+            default:                    break;
         }
     }
 
-    if (KeyHit(Key_2))
+    if (showOverdraw)
+    {
+        RenderState::SetOverridePixelShader(nullptr);
+        DX->States()->OverrideBlendState(std::nullopt);
+    }
+}
+
+
+// Render the main light's shadow map around the camera for this frame. The opaque entities cast shadows, with the levels of detail
+// they have from the camera but never as impostors, whose quads face the camera rather than the light
+void Scene::RenderShadows(Camera* camera)
+{
+    PROFILE_SCOPE("Shadows");
+    bool impostors = mImpostorRenderer && mImpostorRenderer->Enabled();
+    if (mImpostorRenderer)  mImpostorRenderer->Enabled() = false;
+    gEntityManager->SetLODView(camera->Transform().Position(), camera->GetProjectionMatrix().e11);
+
+    const unsigned int group = PassRenderGroup(RenderPass::Opaque);
+    mShadowMap->Render(gPerFrameConstants.light1Position, camera->Transform().Position(), gEntityManager->GetStaticVersion(),
+        [&](const Frustum& frustum, bool staticCasters) {
+            gEntityManager->ResetRenderStats();
+            gEntityManager->RenderGroup(group, &frustum, nullptr, DrawOrder::FrontToBack,
+                                        staticCasters ? EntityManager::RenderSet::StaticOnly : EntityManager::RenderSet::MovingOnly);
+            const EntityManager::RenderStats& stats = gEntityManager->GetRenderStats();
+            return stats.rendered + stats.gpuCulled;
+        });
+
+    if (mImpostorRenderer)  mImpostorRenderer->Enabled() = impostors;
+}
+
+
+// Set camera matrices in the constant buffer and send over to GPU
+void Scene::SetCameraConstants(Camera* camera)
+{
+	gPerCameraConstants.cameraMatrix         = camera->Transform();
+	gPerCameraConstants.viewMatrix           = camera->GetViewMatrix();
+	gPerCameraConstants.projectionMatrix     = camera->GetProjectionMatrix();
+    gPerCameraConstants.viewProjectionMatrix = camera->GetViewProjectionMatrix();
+	gPerCameraConstants.cameraPosition       = camera->Transform().Position();
+    DX->CBuffers()->UpdateCBuffer(gPerCameraConstantBuffer, gPerCameraConstants);
+
+    if (mClusteredLights)
+    {
+        PROFILE_SCOPE("Light Clusters");
+        mClusteredLights->Build(camera->GetViewMatrix(), camera->GetProjectionMatrix(), camera->GetNearClip(), camera->GetFarClip());
+    }
+}
+
+
+// Render the chase cameras of mPipBoats over the main view. Rather than a RenderFromCamera for each, which would go through
+// every entity again for each view, the entities are culled against all the views together first. Each view is a fraction
+// of the size of the main view, so its levels of detail are chosen as if for a screen that much smaller, which also lets
+// it use the cheaper shaders sooner. There is no depth pre-pass, occlusion culling or picking for these views
+void Scene::RenderPictureInPicture(const D3D11_VIEWPORT& sceneViewport, Camera* mainCamera)
+{
+    static_assert(MAX_PIP_VIEWS <= EntityManager::MAX_VIEWS);
+    Camera*        cameras[MAX_PIP_VIEWS];
+    const Frustum* frustums[MAX_PIP_VIEWS];
+    unsigned int numViews = 0;
+    for (EntityID boat : mPipBoats)
+    {
+        Camera* camera = mChaseCameras.Find(boat);
+        if (camera == nullptr || numViews == static_cast<unsigned int>(MAX_PIP_VIEWS))  continue;
+        cameras[numViews]  = camera;
+        frustums[numViews] = &camera->GetFrustum();
+        ++numViews;
+    }
+    if (numViews == 0)  return;
+
+    PROFILE_SCOPE("Picture-in-Picture");
+    DX->Profiler()->BeginScope("Picture-in-Picture");
+    gEntityManager->CullViews(frustums, numViews);
+
+    // The views don't overlap, so one clear of the depth buffer once the main view has finished with it serves them all
+    DX->Context()->ClearDepthStencilView(DX->DepthBuffer(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+    const float margin = std::floor(sceneViewport.Height * 0.01f);
+    D3D11_VIEWPORT viewport = sceneViewport;
+    viewport.Width  = std::floor(sceneViewport.Width  * mPipSize);
+    viewport.Height = std::floor(sceneViewport.Height * mPipSize);
+    viewport.TopLeftX = sceneViewport.TopLeftX + sceneViewport.Width - viewport.Width - margin;
+    for (unsigned int view = 0; view < numViews; ++view)
+    {
+        viewport.TopLeftY = sceneViewport.TopLeftY + margin + view * (viewport.Height + margin);
+        DX->Context()->RSSetViewports(1, &viewport);
+        SetCameraConstants(cameras[view]);
+        gEntityManager->SetLODView(cameras[view]->Transform().Position(), cameras[view]->GetProjectionMatrix().e11 * mPipSize);
+        gEntityManager->Weapons().AddView(*frustums[view], cameras[view]->Transform().Position(),
+                                          cameras[view]->GetProjectionMatrix().e11 * mPipSize);
+
+        mRenderView = static_cast<int>(view);
+        const Frustum& frustum = *frustums[view];
+        DX->States()->SetRasterizerState(RasterizerState::CullBack);
+        DX->States()->SetDepthState(DepthState::DepthOn);
+        DX->States()->SetBlendState(BlendState::BlendNone);
+        gEntityManager->RenderView(PassRenderGroup(RenderPass::Opaque), view, frustum);
+        if (mWaterRenderer)  mWaterRenderer->Render(cameras[view]->Transform().Position(), mPipSize);
+        RenderSkyPass(frustum);
+        RenderAdditivePass(frustum);
+        mRenderView = -1;
+    }
+
+    // Back to the main view for anything drawn later
+    DX->Context()->RSSetViewports(1, &sceneViewport);
+    SetCameraConstants(mainCamera);
+    DX->Profiler()->EndScope();
+}
+
+
+// Render a group for the sky or additive pass, from the current picture-in-picture view's visible list if there is one
+void Scene::RenderPassGroup(RenderPass pass, const Frustum& frustum, DrawOrder order /*= DrawOrder::FrontToBack*/)
+{
+    if (mRenderView >= 0)  gEntityManager->RenderView(PassRenderGroup(pass), static_cast<unsigned int>(mRenderView), frustum, order);
+    else                   gEntityManager->RenderGroup(PassRenderGroup(pass), &frustum, nullptr, order);
+}
+
+
+// Render solid entities
+void Scene::RenderOpaquePass(const Frustum& frustum)
+{
+    const unsigned int group = PassRenderGroup(RenderPass::Opaque);
+    DX->States()->SetRasterizerState(RasterizerState::CullBack); // Default GPU states for non-blended rendering
+    DX->States()->SetDepthState(DepthState::DepthOn);
+    DX->States()->SetBlendState(BlendState::BlendNone);
+    if (mDepthPrePass)
+    {
+        // Depth only for the static entities, with no render target and the depth-only shaders (see RenderState::SetDepthOnly).
+        // Static entities aren't occlusion tested so the colour pass below draws exactly the same meshes, and the shaders give
+        // exactly the same depths, so only the nearest surface of each pixel passes the equal test there. Moving entities are
+        // drawn normally afterwards, they may be occlusion tested and instanced differently each time they are rendered
+        DX->Profiler()->BeginScope("Depth Pre-Pass");
+        DX->Context()->OMSetRenderTargets(0, nullptr, DX->DepthBuffer());
+        RenderState::SetDepthOnly(true);
+        gEntityManager->RenderGroup(group, &frustum, nullptr, DrawOrder::FrontToBack, EntityManager::RenderSet::StaticOnly);
+        RenderState::SetDepthOnly(false);
+        DX->Context()->OMSetRenderTargets(1, &DX->SceneTarget(), DX->DepthBuffer());
+        DX->Profiler()->EndScope();
+
+        // The stats count the colour pass only
+        gEntityManager->ResetRenderStats();
+
+        DX->Profiler()->BeginScope("Solid");
+        DX->States()->SetDepthState(DepthState::DepthEqual);
+        gEntityManager->RenderGroup(group, &frustum, nullptr, DrawOrder::FrontToBack, EntityManager::RenderSet::StaticOnly);
+        DX->States()->SetDepthState(DepthState::DepthOn);
+        gEntityManager->RenderGroup(group, &frustum, mOcclusionCuller.get(), DrawOrder::FrontToBack, EntityManager::RenderSet::MovingOnly);
+        DX->Profiler()->EndScope();
+    }
+    else
+    {
+        DX->Profiler()->BeginScope("Solid");
+        gEntityManager->RenderGroup(group, &frustum, mOcclusionCuller.get());
+        DX->Profiler()->EndScope();
+    }
+    if (mShowOverdraw)  return; // These have their own shaders, see RenderFromCamera
+    if (mGpuMissiles)  mGpuMissiles->Render();
+    if (mWaterRenderer)  mWaterRenderer->Render(gPerCameraConstants.cameraPosition);
+}
+
+
+// Render the IDs of the boats visible from the camera for GPU picking, against the main view's depth buffer so only the nearest
+// surfaces count. The ID buffer is from the render graph, cleared to no ID
+void Scene::RenderIdBuffer(ID3D11Texture2D* idTexture, ID3D11RenderTargetView* idTarget, Camera* camera)
+{
+    // The mouse is in back buffer pixels, the IDs are rendered at the scene's resolution
+    Vector2i mousePos = GetRawMouse();
+    float renderScale = DX->RenderScale();
+    const Frustum& frustum = camera->GetFrustum();
+    mIdPicker->BeginPass(idTexture, idTarget, static_cast<int>(mousePos.x * renderScale), static_cast<int>(mousePos.y * renderScale));
+    for (Boat* boat : gEntityManager->View<Boat>())
+    {
+        if (frustum.IsSphereVisible(boat->GetWorldBoundingSphere()))  boat->RenderGeometry(IdBufferPicker::IdColour(boat->GetID()));
+    }
+    mIdPicker->EndPass();
+}
+
+
+// Render the sky at the far depth, where the depth buffer is still clear. Drawn after the opaque entities, the sky's pixels are
+// only shaded where nothing covers them, rather than the sky filling the screen to be overdrawn by the water and islands
+void Scene::RenderSkyPass(const Frustum& frustum)
+{
+    // A viewport depth range of exactly 1 puts every sky pixel at the far depth without changing its shaders, so the less-equal
+    // test passes only against the cleared depth. The sky doesn't write depth, nothing behind it needs hiding
+    UINT numViewports = 1;
+    D3D11_VIEWPORT viewport;
+    DX->Context()->RSGetViewports(&numViewports, &viewport);
+    D3D11_VIEWPORT skyViewport = viewport;
+    skyViewport.MinDepth = 1.0f;
+    skyViewport.MaxDepth = 1.0f;
+    DX->Context()->RSSetViewports(1, &skyViewport);
+
+    DX->States()->SetRasterizerState(RasterizerState::CullBack);
+    DX->States()->SetDepthState(DepthState::DepthReadOnlyLessEqual);
+    DX->States()->SetBlendState(BlendState::BlendNone);
+    DX->Profiler()->BeginScope("Sky");
+    RenderPassGroup(RenderPass::Sky, frustum);
+    DX->Profiler()->EndScope();
+
+    DX->Context()->RSSetViewports(1, &viewport);
+}
+
+
+// Render additive blended entities
+void Scene::RenderAdditivePass(const Frustum& frustum)
+{
+    DX->States()->SetRasterizerState(RasterizerState::CullNone); // GPU states for additive blending
+    DX->States()->SetDepthState(DepthState::DepthReadOnly);      // Don't write to depth buffer to stop sorting errors on additive / multiplicative blending and similar
+    DX->States()->SetBlendState(BlendState::BlendAdditive);
+    DX->Profiler()->BeginScope("Additive");
+
+    // With weighted blended transparency the entities don't need sorting by distance, and are composited before the particles.
+    // Not for the overdraw heatmap, which blends every draw additively itself
+    bool oit = mWeightedOit && mWeightedOit->Enabled() && !mShowOverdraw && mWeightedOit->Begin();
+    if (oit)
+    {
+        RenderPassGroup(RenderPass::Additive, frustum, DrawOrder::ByState);
+        mWeightedOit->End();
+    }
+
+    // The main view's effects can be drawn at half resolution, not the overdraw heatmap as it counts the full size pixels
+    bool halfRes = mHalfResEffects && mHalfResEffects->Enabled() && mRenderView < 0 && !mShowOverdraw &&
+                   mHalfResEffects->Begin(gPerCameraConstants.projectionMatrix);
+    if (!oit)  RenderPassGroup(RenderPass::Additive, frustum, DrawOrder::BackToFront);
+    if (mParticleSystem && !mShowOverdraw)  mParticleSystem->Render(); // Has its own shaders, see RenderFromCamera
+    if (halfRes)  mHalfResEffects->End();
+    DX->Profiler()->EndScope();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Update Chase Cameras
+//--------------------------------------------------------------------------------------
+void Scene::UpdateChaseCameras(float frameTime)
+{
+    // Cameras of boats that have gone are given back when the list of boats changes, not looked for every frame
+    if (mChaseBoatListVersion != gEntityManager->GetBoatListVersion())
+    {
+        mChaseBoatListVersion = gEntityManager->GetBoatListVersion();
+        mChaseCameras.ReleaseIf([](EntityID boat) { return !gEntityManager->IsAlive(boat); });
+    }
+
+    // Only the cameras being viewed follow their boats, the others catch up when they are next viewed (see ChaseCameras.h)
+    mChaseCameras.NextFrame();
+    auto follow = [&](EntityID boatID)
     {
-        for (EntityID& boatID : allBoatIDS)
+        Boat* boat = gEntityManager->GetEntity<Boat>(boatID);
+        if (boat == nullptr || boat->GetState() == Boat::State::Destroyed)
         {
-            gMessenger->DeliverMessage(SYSTEM_ID, boatID, MessageType::Stop);
+            mChaseCameras.Release(boatID);
+            return false;
         }
+
+        // The position is blended between simulation steps in the same way as the rendered boat (see Render), otherwise the
+        // boat would shake in a camera following it at a higher frame rate
+        Vector3 boatPos = boat->Transform().Position();
+        if (mFixedStep)
+        {
+            Vector3 previousPos = gEntityManager->Transforms().PreviousRoot(EntityIndex(boatID)).Position();
+            boatPos = Lerp(previousPos, boatPos, mStepBlend);
+        }
+        mChaseCameras.Follow(boatID, boatPos, boat->Transform().ZAxis(), frameTime);
+        return true;
+    };
+    if (mActiveChaseBoat != NO_ID && !follow(mActiveChaseBoat))  mActiveChaseBoat = NO_ID; // Back to the main camera
+
+    // The picture-in-picture views are of the boats following the one being viewed in the chase order
+    mPipBoats.clear();
+    EntityID pipBoat = mActiveChaseBoat;
+    for (int view = 0; view < mPipViews; ++view)
+    {
+        pipBoat = NextChaseBoat(pipBoat, 1);
+        if (pipBoat == NO_ID || pipBoat == mActiveChaseBoat || std::find(mPipBoats.begin(), mPipBoats.end(), pipBoat) != mPipBoats.end())  break;
+        if (follow(pipBoat))  mPipBoats.push_back(pipBoat);
     }
+}
 
-    if (KeyHit(Key_7))
+// The boat at the given position in the chase order (boats in mWorld that have not been destroyed), NO_ID if none
+EntityID Scene::ChaseBoat(int index)
+{
+    for (size_t i = 0; i < mWorld.NumBoats(); ++i)
+    {
+        if (mWorld.states[i] == Boat::State::Destroyed)  continue;
+        if (index-- == 0)  return mWorld.ids[i];
+    }
+    return NO_ID;
+}
+
+// The boat a number of places on from the given one in the chase order, wrapping around. From NO_ID (the main camera) a step
+// forwards is the first boat and a step back the last. Only used when the camera is switched, so the search doesn't matter
+EntityID Scene::NextChaseBoat(EntityID boat, int step)
+{
+    int numBoats = 0;
+    int current  = -1;
+    for (size_t i = 0; i < mWorld.NumBoats(); ++i)
+    {
+        if (mWorld.states[i] == Boat::State::Destroyed)  continue;
+        if (mWorld.ids[i] == boat)  current = numBoats;
+        ++numBoats;
+    }
+    if (numBoats == 0)  return NO_ID;
+    if (current < 0)  current = step > 0 ? -1 : 0;
+    return ChaseBoat(((current + step) % numBoats + numBoats) % numBoats);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Scene Update
+//--------------------------------------------------------------------------------------
+
+// Update entire scene. frameTime is the time passed since the last frame
+void Scene::Update(float frameTime)
+{
+    TIMING_SCOPE("Update");
+    TRACE_PHASE("Update");
+    auto frameStart = std::chrono::steady_clock::now();
+    float lastFrameMs = mFrameStart.time_since_epoch().count() == 0 ? 0.0f :
+                        std::chrono::duration<float, std::milli>(frameStart - mFrameStart).count();
+    mFrameStart = frameStart;
+
+    // Steps of a pipelined simulation started at the end of the last frame must finish before anything here looks at the game
+    FinishPipelinedSteps();
+
+    // CPU profiler frames run from here to the same point next frame, so they include the pipelined steps that ran while the last frame was presented
+    gCpuProfiler.NextFrame();
+    gAllocationTracker.NextFrame();
+    gEntityManager->Costs().NextFrame();
+    gEntityManager->GpuCosts().NextFrame();
+    gFrameArena.Reset(); // Scratch lists from the last frame's update and render are finished with
+    UpdateTraceCapture();
+    CheckFrameSpike(lastFrameMs);
+    if (mMetrics)  mMetrics->AddFrameTime(frameTime);
+
+    // Work queued for the main thread by jobs (e.g. anything using the D3D immediate context) is done first, see JobSystem.h
+    if (gJobSystem)  gJobSystem->RunMainThreadJobs();
+
+    // Checkpoints are saved and loaded between simulation steps, before the frame's steps are run. This is also allowed while
+    // paused, to look at a saved moment
+    if (mSaveCheckpointNext)  SaveCheckpoint();
+    if (mLoadCheckpointNext)  LoadCheckpoint();
+
+    // Edits to the level file are applied at the same point, not while a replay plays as it is of the level as it was, nor
+    // while showing a server's game
+    if (mLevelReload && !mReplay && !mNetClient)  CheckLevelReload(frameTime);
+
+    // Replays start and stop at the same point, and while one is playing it takes the place of the simulation steps. It is
+    // still applied while paused so seeking shows the time sought
+    if (mStartReplayNext)  StartReplay();
+    if (mStopReplayNext)   StopReplay();
+    if (mReplay)  UpdateReplay(mGamePaused ? 0.0f : frameTime);
+
+    // A server's game takes the place of the simulation steps in the same way. Serving, the clients' orders are delivered
+    // before the steps so the boats read them in the first
+    if (mStopNetClientNext)  StopNetClient();
+    if (mNetClient)  UpdateNetClient(mGamePaused ? 0.0f : frameTime);
+    if (mNetServer)  mNetServer->Receive();
+
+    if (mGamePaused) {
+        return;
+    }
+
+    bool simulating = !mReplay && !mNetClient;
+    if (mFixedStep && simulating)
     {
-        // Move to the next camera index
-        ++mActiveCameraIndex;
-        if (mActiveCameraIndex >= static_cast<int>(mChaseCameras.size()))
+        // Run the steps that fit in the time passed, keeping the remainder for the next frame. The matrices from before each
+        // step are kept so Render can show the entities between the last two steps. Pipelined, the steps are only counted
+        // here and run after this frame is drawn, which then shows the steps run during the last frame with the blend from
+        // then - a steady frame behind
+        bool pipelined = mPipelined && !mHeadless && !mHidden && gJobSystem; // Hidden frames aren't drawn, so nothing would start them
+        mStepAccumulator += frameTime;
+        int steps = 0;
+        while (mStepAccumulator >= SIMULATION_STEP && steps < MAX_STEPS_PER_FRAME)
+        {
+            if (!pipelined)
+            {
+                gEntityManager->Transforms().SavePreviousRoots();
+                SimulationStep(SIMULATION_STEP);
+            }
+            mStepAccumulator -= SIMULATION_STEP;
+            ++steps;
+        }
+        if (steps == MAX_STEPS_PER_FRAME)  mStepAccumulator = std::min(mStepAccumulator, SIMULATION_STEP);
+        if (pipelined)
+        {
+            mPipelinedSteps = steps;
+            mPipelinedBlend = mStepAccumulator / SIMULATION_STEP;
+        }
+        else
         {
-            // Wrap around
-            mActiveCameraIndex = 0;
+            mStepBlend = mStepAccumulator / SIMULATION_STEP;
         }
     }
+    else if (simulating)
+    {
+        SimulationStep(frameTime);
+        mStepBlend = 1.0f;
+    }
+
+    // A headless scene has no cameras and no input
+    if (mHeadless)  return;
+
+    // Keep the textures and levels of detail within the GPU memory the OS currently allows, before the frame is rendered
+    mMemoryBudget.Update(frameTime);
+    gEntityManager->LODScale() = mMemoryBudget.LODScale();
+    if (mMetrics)
+    {
+        constexpr double MB = 1024 * 1024;
+        mMetrics->SetGauge(mMetricIDs.videoMemory, DX->GetVideoMemory().usage / MB);
+        mMetrics->SetGauge(mMetricIDs.videoBudget, DX->GetVideoMemory().budget / MB);
+    }
+
+    // Handle key inputs for starting and stopping boats, none are given orders while a replay plays
+    if (KeyHit(Key_1) && !mReplay)
+    {
+        OrderBoat(NO_ID, MessageType::Start);
+    }
+
+    if (KeyHit(Key_2) && !mReplay)
+    {
+        OrderBoat(NO_ID, MessageType::Stop);
+    }
+
+    if (KeyHit(Key_7))
+    {
+        // Move to the next boat's chase camera, wrapping around
+        mActiveChaseBoat = NextChaseBoat(mActiveChaseBoat, 1);
+    }
 
     if (KeyHit(Key_8))
     {
-        // Move to the previous camera index
-        --mActiveCameraIndex;
-        if (mActiveCameraIndex < 0)
-        {
-            // Wrap to the last camera
-            mActiveCameraIndex = static_cast<int>(mChaseCameras.size()) - 1;
-        }
+        // Move to the previous boat's chase camera, wrapping around
+        mActiveChaseBoat = NextChaseBoat(mActiveChaseBoat, -1);
     }
 
     // Switch back to main camera
     if (KeyHit(Key_9))
     {
-        mActiveCameraIndex = -1;
+        mActiveChaseBoat = NO_ID;
     }
 
     // Toggle extended boat UI
@@ -689,8 +2026,15 @@ void Scene::Update(float frameTime)
         mShowExtendedBoatUI = !mShowExtendedBoatUI;
     }
 
+    // A fly-through moves the main camera and chooses the camera viewed from itself
+    if (mFlyThrough)
+    {
+        int chaseCamera = mFlyThrough->PlaceCamera(*mCamera);
+        mActiveChaseBoat = chaseCamera >= 0 ? ChaseBoat(chaseCamera) : NO_ID;
+    }
+
     // Control the main camera only if it's active
-    if (mActiveCameraIndex == -1)
+    else if (mActiveChaseBoat == NO_ID)
     {
         static float movementSpeed = 40.0f;
         const float rotationSpeed = 1.5f;   // Radians per second for rotation
@@ -700,63 +2044,28 @@ void Scene::Update(float frameTime)
     }
 
     // Handles mouse click interactions for selecting nearest boat
-    if (KeyHit(Mouse_LButton))
+    if (KeyHit(Mouse_LButton) && !mReplay)
     {
         if (mSelectedBoat) {
             Vector2i mousePos = { 0, 0 };
             mousePos = GetMousePosition(GetActiveWindow());
 
             Vector3 intersect = { 0.0f, 0.0f, 0.0f };
-            if (mCamera->WorldPtFromPixel(mousePos.x, mousePos.y, gPerFrameConstants.viewportWidth, gPerFrameConstants.viewportHeight, intersect))
+            if (ActiveCamera()->WorldPtFromPixel(mousePos.x, mousePos.y, gPerFrameConstants.viewportWidth, gPerFrameConstants.viewportHeight, intersect))
             {
-                gMessenger->DeliverMessage(SYSTEM_ID, mSelectedBoat->GetID(), MessageType::TargetPoint, TargetPointData{ intersect, 5.0f });
+                OrderBoat(mSelectedBoat->GetID(), MessageType::TargetPoint, intersect);
             }
             mSelectedBoat = nullptr;
         }
         else if (mNearestEntity)
         {
             mSelectedBoat = mNearestEntity;
-            gMessenger->DeliverMessage(SYSTEM_ID, mSelectedBoat->GetID(), MessageType::Evade);
-        }
-    }
-
-    if (AreBoatsActive()) // Only spawn if boats are active
-    {
-        existingCrates = gEntityManager->GetAllCratesEntities();
-        if (existingCrates.size() < mMaxCrates && mRandomCrateTimer <= 0.0f) {
-            Vector3 spawnPos(Random(-250.0f, 250.0f), -10.0f, Random(-250.0f, 250.0f));
-            Matrix4x4 transform(spawnPos, { 0, 0, 0 }, 1.0f);
-
-            float r = Random(0.0f, 1.0f);
-            CrateType type;
-            if (r < 0.33f)
-                type = CrateType::Missile;
-            else if (r < 0.66f)
-                type = CrateType::Health;
-            else
-                type = CrateType::Shield;
-
-            gEntityManager->CreateEntity<RandomCrate>("RandomCrate", transform, type);
-
-            // Reset the timer for the next crate spawn
-            mRandomCrateTimer = Random(12.0f, 20.0f);
-        }
-
-        // Check and spawn mines only if the current count is below the limit
-        existingMines = gEntityManager->GetAllMinesEntities();
-        if (existingMines.size() < mMaxMines && mRandomMineTimer <= 0.0f) {
-            Vector3 spawnPos(Random(-250.0f, 250.0f), -20.0f, Random(-250.0f, 250.0f));
-            Matrix4x4 transform(spawnPos, { 0, 0, 0 }, 1.0f);
-
-            gEntityManager->CreateEntity<SeaMine>("SeaMine", transform);
-
-            // Reset the timer for the next mine spawn
-            mRandomMineTimer = Random(12.0f, 15.0f);
+            OrderBoat(mSelectedBoat->GetID(), MessageType::Evade);
         }
     }
 
     // Toggle FPS limiting
-    if (KeyHit(Key_F))  mLockFPS = !mLockFPS;
+    if (KeyHit(Key_F))  mVSync = !mVSync;
     if (KeyHit(Key_P))  mGamePaused = !mGamePaused;
 
     // Update chase cameras to follow their boats
@@ -764,66 +2073,1171 @@ void Scene::Update(float frameTime)
 }
 
 
-//--------------------------------------------------------------------------------------
-// Draw Text at World Point
-//--------------------------------------------------------------------------------------
-// Draw given text at the given 3D point, also pass camera in use. Optionally centre align and colour the text
-void Scene::DrawTextAtWorldPt(const Vector3& point, std::string text, Camera* camera, bool centreAlign)
+// Run the steps counted by a pipelined Update on a worker, called at the end of Render before the frame is presented
+void Scene::StartPipelinedSteps()
 {
-    auto pixelPt = camera->PixelFromWorldPt(point, static_cast<float>(DX->GetBackbufferWidth()), static_cast<float>(DX->GetBackbufferHeight()));
-    if (pixelPt.z >= camera->GetNearClip())
+    int steps = mPipelinedSteps;
+    mPipelinedSteps = 0;
+    if (steps == 0)  return;
+
+    // Templates constructed when first used by the steps load textures with the D3D context while this thread presents.
+    // Without a thread-safe context the steps are run here instead, and pipelining is turned off
+    if (!DX->SetContextThreadSafe(true))
     {
-        if (centreAlign)
+        mPipelined = false;
+        mPipelineStatus = "Overlapping the present needs a thread-safe D3D context, not supported here";
+        for (int i = 0; i < steps; ++i)
         {
-            auto textSize = mSmallFont->MeasureString(text.c_str());
-            pixelPt.x -= DirectX::XMVectorGetX(textSize) / 2;
+            gEntityManager->Transforms().SavePreviousRoots();
+            SimulationStep(SIMULATION_STEP);
         }
-        mSmallFont->DrawString(mSpriteBatch.get(), text.c_str(), DirectX::XMFLOAT2{ pixelPt.x, pixelPt.y }, DirectX::FXMVECTOR{ colour.r, colour.g, colour.b, 0 });
+        mStepBlend = mPipelinedBlend;
+        return;
     }
+
+    mPipelineRandom = ThreadRandom();
+    mSimulationRunning = true;
+    gJobSystem->Run([this, steps]()
+    {
+        ThreadRandom() = mPipelineRandom;
+        for (int i = 0; i < steps; ++i)
+        {
+            gEntityManager->Transforms().SavePreviousRoots();
+            SimulationStep(SIMULATION_STEP);
+        }
+        mPipelineRandom = ThreadRandom();
+    }, &mSimulationJob);
 }
 
-//--------------------------------------------------------------------------------------
-// Handle Mouse Picking
-//--------------------------------------------------------------------------------------
-// Performs mouse picking to find the nearest boat entity to the cursor.
-void Scene::HandleMousePicking()
+
+// Wait for the steps started by StartPipelinedSteps to finish, called first thing in Update (and before the scene is destroyed)
+void Scene::FinishPipelinedSteps()
 {
-    Vector3f pixelPos3D;
-    Vector2i pixelPos;
-    Vector2i mousePos = { 0, 0 };
-    float nearestDistance = 50.0f;
-    mNearestEntity = nullptr; // Reset the nearest entity
+    if (!mSimulationRunning)  return;
 
-    allBoats = gEntityManager->GetAllBoatEntities();
+    gJobSystem->Wait(mSimulationJob);
+    DX->SetContextThreadSafe(false);
+    ThreadRandom() = mPipelineRandom;
+    mStepBlend = mPipelinedBlend;
+    mSimulationRunning = false;
+}
+
+
+// Move the entities on by the given time, spawn crates and mines and gather the results
+void Scene::SimulationStep(float stepTime)
+{
+    // Boat state changes are collected over a single step
+    Boat::ClearStateChanges();
+
+    // Choose which boats' behaviour runs this step, at full rate near the camera. A headless battle has no camera so every
+    // boat runs at full rate
+    if (mHeadless)  mAIScheduler.ClearFocus();
+    else            mAIScheduler.SetFocus(ActiveCamera()->Transform().Position());
+    mAIScheduler.Schedule(stepTime);
+
+    // Stream the level's cells in and out a few times a second, before the entity update as it creates and destroys entities
+    mStreamTimer -= stepTime;
+    if (mWorldPartition && mStreamTimer <= 0.0f)
+    {
+        UpdateWorldPartition(false);
+        mStreamTimer = WorldPartition::UPDATE_INTERVAL;
+    }
 
-    for (Boat* boatPtr : allBoats)
+    // Update all entities, then gather the boat data used by the rest of the scene. Text the entities show is timed from
+    // the end of the step
+    gFloatingText.Advance(stepTime);
+    gEntityManager->UpdateAll(stepTime);
+    BuildWorldSnapshot();
+    MarkChangedBoatLabels();
+    EmitParticleEffects(stepTime);
+    if (mGpuMissiles)  mGpuMissiles->Advance(stepTime);
+    if (mWaterRenderer)  mWaterRenderer->Advance(stepTime);
+
+    // Drop the mouse selection if the selected boat was destroyed this step, it can no longer be given orders and will soon be removed
+    for (const Boat::StateChange& change : Boat::StateChanges())
     {
-        if (!boatPtr) continue;
+        if (mSelectedBoat && change.to == Boat::State::Destroyed && change.boat == mSelectedBoat->GetID())  mSelectedBoat = nullptr;
+    }
+
+    // Spawn crates and mines, only while the boats are active
+    mSpawnDirector.Update(stepTime, AreBoatsActive(), mWorldPartition.get());
+
+    // Record the step's results if a replay or analytics are being recorded, and send them to the network clients
+    if (mReplayRecorder)  mReplayRecorder->Update(*gEntityManager, stepTime);
+    if (mAnalytics)  mAnalytics->RecordStep(*gEntityManager, *gMessenger, stepTime);
+    if (mMetrics)  UpdateStepMetrics();
+    if (mNetServer)  mNetServer->Update(*gEntityManager, stepTime);
+}
 
-        // Use active camera for picking
-        pixelPos3D = mCamera.get()->PixelFromWorldPt(boatPtr->Transform().Position(), gPerFrameConstants.viewportWidth, gPerFrameConstants.viewportHeight);
-        pixelPos = Vector2i(static_cast<int>(pixelPos3D.x), static_cast<int>(pixelPos3D.y));
-        mousePos = GetRawMouse();
-        float distToBoat = (pixelPos - mousePos).Length();
 
-        if (distToBoat < nearestDistance)
+//--------------------------------------------------------------------------------------
+// Headless Battles
+//--------------------------------------------------------------------------------------
+
+// Start the boats and simulate until only one team has boats left or timeLimit seconds of game time have passed, then return
+// the results. Steps are run back to back, so the battle runs as fast as the simulation allows
+BattleResult Scene::RunBattle(float timeLimit)
+{
+    // Destroyed boats are removed once they have sunk, so their results are kept from the start
+    BattleResult battle;
+    battle.seed = RandomSeed();
+    std::unordered_map<EntityID, size_t> resultIndex;
+    for (Boat* boat : mWorld.boats)
+    {
+        resultIndex[boat->GetID()] = battle.boats.size();
+        battle.boats.push_back({ boat->GetName(), boat->GetTeam(), boat->GetHP() });
+    }
+
+    gMessenger->BroadcastAll(SYSTEM_ID, MessageType::Start);
+
+    int steps = 0;
+    int teamsLeft = 0;
+    while (battle.gameTime < timeLimit)
+    {
+        SimulationStep(SIMULATION_STEP);
+        battle.gameTime = ++steps * SIMULATION_STEP;
+
+        // Missile hits are credited to the boat that fired them, whether or not a shield stopped the damage
+        gMessenger->ForEachObserved([&](EntityID, const Message& message)
         {
-            mNearestEntity = boatPtr;
-            nearestDistance = distToBoat;
+            if (message.type != MessageType::Hit)  return;
+            auto shooter = resultIndex.find(std::get<MissileHitData>(message.data).launchingBoatID);
+            if (shooter != resultIndex.end())  ++battle.boats[shooter->second].missileHits;
+        });
+
+        bool teamAlive[std::size(teamNames)] = {};
+        for (size_t i = 0; i < mWorld.NumBoats(); ++i)
+        {
+            auto result = resultIndex.find(mWorld.ids[i]);
+            if (result == resultIndex.end())  continue; // Not in the level at the start
+            BattleResult::BoatResult& boatResult = battle.boats[result->second];
+            boatResult.hp            = mWorld.boats[i]->GetHP();
+            boatResult.missilesFired = mWorld.boats[i]->GetMissilesFired();
+            if (mWorld.states[i] != Boat::State::Destroyed)  teamAlive[static_cast<int>(mWorld.teams[i])] = true;
+            else if (boatResult.destroyedTime < 0)           boatResult.destroyedTime = battle.gameTime;
         }
+        teamsLeft = static_cast<int>(std::count(std::begin(teamAlive), std::end(teamAlive), true));
+        if (teamsLeft <= 1)  break;
+    }
+
+    battle.timeLimitReached = teamsLeft > 1;
+    if (teamsLeft == 1)
+    {
+        auto survivor = std::find_if(battle.boats.begin(), battle.boats.end(), [](const auto& boat) { return boat.destroyedTime < 0; });
+        battle.winner = static_cast<int>(survivor->team);
+    }
+    return battle;
+}
+
+
+// Run as a dedicated server: start the boats and call Update in real time until timeLimit seconds have passed (0 - no limit).
+// Sleeping to the next step leaves the CPU free, Update runs however many steps the sleep actually took
+void Scene::RunServer(float timeLimit)
+{
+    using Clock = std::chrono::steady_clock;
+    const auto stepTime = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(SIMULATION_STEP));
+
+    gMessenger->BroadcastAll(SYSTEM_ID, MessageType::Start);
+
+    auto start = Clock::now();
+    auto last  = start;
+    while (timeLimit <= 0 || std::chrono::duration<float>(last - start).count() < timeLimit)
+    {
+        std::this_thread::sleep_until(last + stepTime);
+        auto now = Clock::now();
+        Update(std::chrono::duration<float>(now - last).count());
+        last = now;
+    }
+}
+
+
+// Readable summary of the battle: the winner, the game time taken and a line for each boat
+std::string BattleResult::Summary() const
+{
+    std::ostringstream summary;
+    summary.setf(std::ios::fixed);
+    summary.precision(2);
+    if (winner >= 0)            summary << "Winner: " << teamNames[winner] << "\n";
+    else if (timeLimitReached)  summary << "Winner: none, time limit reached\n";
+    else                        summary << "Winner: none, all boats destroyed\n";
+    summary << "Game time: " << gameTime << "s\n";
+    summary << "Seed: " << seed << "\n\n";
+    summary << "Boat, Team, HP, Missiles Fired, Hits, Destroyed At\n";
+    for (const BoatResult& boat : boats)
+    {
+        summary << boat.name << ", " << teamNames[static_cast<int>(boat.team)] << ", " << std::max(boat.hp, 0.0f) << ", "
+                << boat.missilesFired << ", " << boat.missileHits << ", ";
+        if (boat.destroyedTime < 0)  summary << "-\n";
+        else                         summary << boat.destroyedTime << "s\n";
+    }
+    return summary.str();
+}
+
+
+// Column names for CsvRows
+std::string BattleResult::CsvHeader()
+{
+    return "Scenario,Seed,Winner,Duration,Boat,Team,HP,Shots Fired,Hits,Hit Rate,Destroyed At\n";
+}
 
+// The battle as CSV, one row per boat, each starting with the scenario name (e.g. the level file), seed, winner and duration
+std::string BattleResult::CsvRows(const std::string& scenario) const
+{
+    std::ostringstream rows;
+    rows.setf(std::ios::fixed);
+    rows.precision(3);
+    for (const BoatResult& boat : boats)
+    {
+        float hitRate = boat.missilesFired > 0 ? static_cast<float>(boat.missileHits) / boat.missilesFired : 0.0f;
+        rows << scenario << ',' << seed << ',' << (winner >= 0 ? teamNames[winner] : "None") << ',' << gameTime << ','
+             << boat.name << ',' << teamNames[static_cast<int>(boat.team)] << ',' << std::max(boat.hp, 0.0f) << ','
+             << boat.missilesFired << ',' << boat.missileHits << ',' << hitRate << ',';
+        if (boat.destroyedTime >= 0)  rows << boat.destroyedTime;
+        rows << '\n';
     }
+    return rows.str();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Text Labels at World Points
+//--------------------------------------------------------------------------------------
+// Add a text label centred on the given 3D point, drawn by the next DrawWorldLabels. The text must stay valid until then
+void Scene::AddWorldLabel(uint64_t key, const Vector3& point, const std::string& text, ColourRGB colour)
+{
+    mLabelPoints.Add(point);
+    mLabels.push_back({ key, &text, colour });
+}
+
+// Draw the labels added since the last call as seen from the given camera. All the label points are projected to pixels in
+// one pass rather than one camera call per label, then the label renderer culls those off the screen and draws the rest at once
+void Scene::DrawWorldLabels(Camera* camera)
+{
+    float screenWidth  = static_cast<float>(DX->GetBackbufferWidth());
+    float screenHeight = static_cast<float>(DX->GetBackbufferHeight());
+    camera->PixelsFromWorldPts(mLabelPoints, screenWidth, screenHeight, mLabelPixels);
+    float nearClip = camera->GetNearClip();
+    mLabelRenderer->Begin(screenWidth, screenHeight);
+    for (size_t i = 0; i < mLabels.size(); ++i)
+    {
+        if (mLabelPixels.z[i] < nearClip)  continue; // Behind the camera
+        mLabelRenderer->Add(mLabels[i].key, mLabelPixels.x[i], mLabelPixels.y[i], *mLabels[i].text, mLabels[i].colour);
+    }
+    mLabelRenderer->Render();
+    mLabelPoints.Clear();
+    mLabels.clear();
+}
+
+// Draw the text floating above entities as seen from the given camera. Texts interned since the last frame are given to the
+// renderer first, then each popup only needs the position of its entity, the vertex shader animates it
+void Scene::DrawFloatingText(Camera* camera)
+{
+    for (uint32_t text = mFloatingTextRenderer->NumTexts(); text < gFloatingText.NumTexts(); ++text)
+    {
+        mFloatingTextRenderer->SetText(text, gFloatingText.Text(static_cast<FloatingText::TextID>(text)));
+    }
+
+    // Popups of entities that have gone disappear with them
+    mFloatingTextRenderer->Begin();
+    gFloatingText.ForEachPopup([this](const FloatingText::Popup& popup) {
+        Entity* entity = gEntityManager->GetEntity(popup.entity);
+        if (entity)  mFloatingTextRenderer->Add(entity->Transform().Position(), popup.text, popup.startTime, popup.line, popup.colour);
+    });
+
+    FloatingTextRenderer::Motion motion = { gFloatingText.Time(), FloatingText::LIFETIME, FloatingText::FADE_TIME,
+                                            FloatingText::START_HEIGHT, FloatingText::RISE_HEIGHT };
+    mFloatingTextRenderer->Render(camera->GetViewProjectionMatrix(), static_cast<float>(DX->GetBackbufferWidth()),
+                                  static_cast<float>(DX->GetBackbufferHeight()), motion);
+}
+
+//--------------------------------------------------------------------------------------
+// Active Camera
+//--------------------------------------------------------------------------------------
+// The camera currently being viewed from, the main camera or a chase camera
+Camera* Scene::ActiveCamera()
+{
+    // The chase camera is created by UpdateChaseCameras, until then the main camera is used
+    if (mActiveChaseBoat != NO_ID)
+    {
+        Camera* chaseCamera = mChaseCameras.Find(mActiveChaseBoat);
+        if (chaseCamera)  return chaseCamera;
+    }
+    return mCamera.get(); // Default main camera
+}
+
+
+//--------------------------------------------------------------------------------------
+// Handle Mouse Picking
+//--------------------------------------------------------------------------------------
+// Performs mouse picking to find the nearest boat entity to the cursor, as seen from the given camera.
+// The boats' screen positions are only recalculated when the boats or the camera have changed, and the nearest boat is only
+// searched for again when the screen positions or the mouse have changed
+void Scene::HandleMousePicking(Camera* camera)
+{
+    const float pickDistance = 50.0f; // Pixels
+
+    // Using the ID picked from the GPU buffer, which arrives a couple of frames late so the boat may have been destroyed since
+    if (mGpuPicking)
+    {
+        mNearestEntity = gEntityManager->GetEntity<Boat>(mIdPicker->GetPickedId());
+        mPickerValid = false; // Rebuild the screen picker when switching back
+        return;
+    }
+
+    const Matrix4x4& viewProjection = camera->GetViewProjectionMatrix();
+    bool cameraChanged = camera != mPickerCamera || std::memcmp(&viewProjection, &mPickerViewProjection, sizeof(Matrix4x4)) != 0;
+    if (!mPickerValid || cameraChanged || mWorld.version != mPickerWorldVersion)
+    {
+        mPicker.Build(mWorld.positions, *camera, gPerFrameConstants.viewportWidth, gPerFrameConstants.viewportHeight);
+        mPickerCamera = camera;
+        mPickerViewProjection = viewProjection;
+        mPickerWorldVersion = mWorld.version;
+        mPickerValid = true;
+    }
+    else
+    {
+        Vector2i mousePos = GetRawMouse();
+        if (mousePos.x == mPickerMouse.x && mousePos.y == mPickerMouse.y)  return; // Nothing has changed
+    }
+
+    mPickerMouse = GetRawMouse();
+    int nearest = mPicker.FindNearest({ static_cast<float>(mPickerMouse.x), static_cast<float>(mPickerMouse.y) }, pickDistance);
+    mNearestEntity = nearest >= 0 ? mWorld.boats[nearest] : nullptr;
 }
 
 bool Scene::AreBoatsActive()
 {
-    std::vector<Boat*> boats = gEntityManager->GetAllBoatEntities();
-    for (Boat* boat : boats)
+    return mWorld.anyBoatActive;
+}
+
+
+//--------------------------------------------------------------------------------------
+// World Snapshot
+//--------------------------------------------------------------------------------------
+// Gather the per-frame boat data in mWorld, call after the entities have been updated. The arrays are cleared rather than
+// recreated so they keep their capacity from frame to frame
+void Scene::BuildWorldSnapshot()
+{
+    mWorld.boats.clear();
+    mWorld.ids.clear();
+    mWorld.positions.clear();
+    mWorld.facings.clear();
+    mWorld.teams.clear();
+    mWorld.states.clear();
+    mWorld.anyBoatActive = false;
+    ++mWorld.version; // Boat pointers may have changed, see HandleMousePicking
+
+    for (Boat* boat : gEntityManager->View<Boat>())
+    {
+        mWorld.boats.push_back(boat);
+        mWorld.ids.push_back(boat->GetID());
+        mWorld.positions.push_back(boat->Transform().Position());
+        mWorld.facings.push_back(boat->Transform().ZAxis());
+        mWorld.teams.push_back(boat->GetTeam());
+        mWorld.states.push_back(boat->GetState());
+        if (boat->IsActive())  mWorld.anyBoatActive = true;
+    }
+}
+
+
+// Stream the cells of a partitioned level in and out around the boats and the active camera. A headless battle has no camera,
+// and there is none yet while the level loads
+void Scene::UpdateWorldPartition(bool wait)
+{
+    std::vector<Vector3> focusPoints = mWorld.positions;
+    if (!mHeadless && mCamera)  focusPoints.push_back(ActiveCamera()->Transform().Position());
+    mWorldPartition->Update(focusPoints, wait);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Checkpoints
+//--------------------------------------------------------------------------------------
+// Save the simulation to CHECKPOINT_FILE or the given file. The state is copied here, which is quick, and written on a
+// background thread so the frame doesn't wait for the disk
+void Scene::SaveCheckpoint(const std::string& fileName /*= CHECKPOINT_FILE*/)
+{
+    mSaveCheckpointNext = false;
+    CheckCheckpointWrite(true); // Only one write at a time
+
+    auto checkpoint = std::make_unique<Checkpoint>();
+    checkpoint->Capture(*gEntityManager, *gMessenger,
+                        { mSpawnDirector.GetTimer(SpawnKind::Crate), mSpawnDirector.GetTimer(SpawnKind::Mine), mStepAccumulator });
+    mCheckpointFileName = fileName;
+    mCheckpointStatus = "Saving " + std::to_string(checkpoint->EntityCount()) + " entities...";
+    mCheckpointWrite = std::async(std::launch::async, [checkpoint = std::move(checkpoint), fileName]()
+    {
+        return checkpoint->Write(fileName);
+    });
+}
+
+// Put the simulation back to the state in CHECKPOINT_FILE. The boats are all new entities afterwards, so everything holding
+// boat pointers is reset and the world snapshot is rebuilt straight away
+void Scene::LoadCheckpoint()
+{
+    mLoadCheckpointNext = false;
+    CheckCheckpointWrite(true); // The file may be being written
+
+    Checkpoint checkpoint;
+    Checkpoint::SceneState sceneState;
+    std::string error;
+    if (!checkpoint.Read(CHECKPOINT_FILE, error) || !checkpoint.Restore(*gEntityManager, *gMessenger, sceneState, error))
+    {
+        mCheckpointStatus = "Load failed: " + error;
+        LOG_WARNING("Checkpoint {} failed to load: {}", CHECKPOINT_FILE, error);
+        return;
+    }
+    mSpawnDirector.SetTimer(SpawnKind::Crate, sceneState.randomCrateTimer);
+    mSpawnDirector.SetTimer(SpawnKind::Mine, sceneState.randomMineTimer);
+    mStepAccumulator = sceneState.stepAccumulator;
+
+    ResetBoatReferences();
+    mCheckpointStatus = "Loaded " + std::to_string(checkpoint.EntityCount()) + " entities";
+    LOG_INFO("Checkpoint {} loaded, {} entities", CHECKPOINT_FILE, checkpoint.EntityCount());
+}
+
+// Set the checkpoint status from the background write if it has finished, waiting for it if wait is true
+void Scene::CheckCheckpointWrite(bool wait)
+{
+    if (!mCheckpointWrite.valid())  return;
+    if (!wait && mCheckpointWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)  return;
+    mCheckpointStatus = (mCheckpointWrite.get() ? "Saved " : "Failed to save ") + mCheckpointFileName;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Level Hot Reload
+//--------------------------------------------------------------------------------------
+
+// Apply the edits to the level file if its size or time has changed since it was last loaded. Only the templates and entities
+// that were changed are created again, so an edit shows in the running game straight away. If the file can't be parsed (e.g.
+// it is part way through being saved) the level is left as it is and the file is tried again when it next changes
+void Scene::CheckLevelReload(float frameTime)
+{
+    if (mHeadless || !mLoadedLevel)  return;
+    mLevelReloadTimer -= frameTime;
+    if (mLevelReloadTimer > 0.0f)  return;
+    mLevelReloadTimer = LEVEL_RELOAD_INTERVAL;
+
+    AssetInfo info;
+    if (!gAssetFiles.GetInfo(mLevelFile, info))  return;
+    if (info.size == mLoadedLevel->source.size && info.time == mLoadedLevel->source.time)  return;
+
+    auto start = std::chrono::steady_clock::now();
+    ParseLevel levelParser(*gEntityManager, gJobSystem.get(), true);
+    LevelReloadStats stats;
+    std::string error;
+    if (!levelParser.ReloadFile(mLevelFile, *mLoadedLevel, stats, error))
+    {
+        mLoadedLevel->source = info; // Not tried again until the file changes again
+        mLevelReloadStatus = "Reload failed: " + error;
+        return;
+    }
+    mSpawnDirector.Configure(levelParser.Settings());
+    if (mHeadless)  mSpawnDirector.SetTimeBudget(0);
+
+    // Boats may have been replaced, and the sky and water entities with them. Moved scenery is merged again where it is now
+    ResetBoatReferences();
+    SetupLevelEntities();
+    gEntityManager->RebuildStaticBatches();
+
+    float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    char status[160];
+    snprintf(status, sizeof(status), "Reloaded in %.0fms: %u templates, %u entities kept, %u moved, %u created, %u destroyed",
+             milliseconds, stats.templatesReloaded, stats.entitiesKept, stats.entitiesPatched, stats.entitiesCreated,
+             stats.entitiesDestroyed);
+    mLevelReloadStatus = status;
+    LOG_INFO("Level reloaded in {}ms: {} templates, {} entities kept, {} moved, {} created, {} destroyed", milliseconds,
+             stats.templatesReloaded, stats.entitiesKept, stats.entitiesPatched, stats.entitiesCreated, stats.entitiesDestroyed);
+
+    // A template that failed to load is shown rather than stopping the game, as it would at startup
+    if (gEntityManager->GetLastError() != "")
+    {
+        LOG_WARNING("Level reload: {}", gEntityManager->GetLastError());
+        mLevelReloadStatus += "\n" + gEntityManager->GetLastError();
+        gEntityManager->ClearLastError();
+    }
+}
+
+
+// Put the level's sky in the sky pass and find its water meshes, after the level is loaded or reloaded
+void Scene::SetupLevelEntities()
+{
+    // The sky is drawn after the opaque entities so it is never overdrawn, see RenderSkyPass
+    if (auto sky = gEntityManager->GetEntity("Sky"))  gEntityManager->SetRenderGroup(sky->GetID(), PassRenderGroup(RenderPass::Sky));
+
+    // The water meshes are hidden while the water renderer draws the sea, see Render
+    mWaterEntities.clear();
+    for (const char* waterName : { "WaterNear", "WaterFar" })
     {
-        if (boat && boat->GetState() != "Inactive")
+        if (auto water = gEntityManager->GetEntity(waterName))  mWaterEntities.push_back(water->GetID());
+    }
+}
+
+// Add the frame just finished to the trace capture, and save the capture if F11 was hit or the frame went over the budget
+void Scene::UpdateTraceCapture()
+{
+    CheckTraceWrite(false);
+    if (!mTraceCapturing || mHeadless)  return;
+    if (gCpuProfiler.Frozen())  return; // The profiler's last frame is the one frozen, not the frame just finished
+
+    // GPU times are read back a few frames after they were measured, see GpuProfiler.h, so lag the CPU scopes slightly
+    std::vector<TraceCapture::Counter> counters;
+    auto profiler = DX->Profiler();
+    if (profiler->Enabled())
+    {
+        counters.push_back({ "GPU ms", "Frame", profiler->FrameTime().milliseconds });
+        for (const auto& scope : profiler->Scopes())  counters.push_back({ "GPU ms", scope.name, scope.milliseconds });
+    }
+
+    PROCESS_MEMORY_COUNTERS_EX memory = {};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&memory), sizeof(memory)))
+    {
+        counters.push_back({ "Memory MB", "Working Set", memory.WorkingSetSize / (1024.0 * 1024.0) });
+        counters.push_back({ "Memory MB", "Private", memory.PrivateUsage / (1024.0 * 1024.0) });
+    }
+    counters.push_back({ "Memory MB", "Textures", DX->Textures()->GetStats().bytes / (1024.0 * 1024.0) });
+
+    if (gMessenger->StatsEnabled())
+    {
+        const auto& messages = gMessenger->GetStats().lastFrame;
+        uint32_t sent = 0;
+        for (const auto& type : messages.types)  sent += type.sent;
+        counters.push_back({ "Messages", "Sent", static_cast<double>(sent) });
+        counters.push_back({ "Messages", "Peak Mailbox", static_cast<double>(messages.peakMailbox) });
+        counters.push_back({ "Messages", "Delayed Waiting", static_cast<double>(messages.delayedWaiting) });
+    }
+
+    if (gEntityManager->Costs().IsEnabled())
+    {
+        const EntityCosts::Frame& costs = gEntityManager->Costs().LastFrame();
+        for (int type = 0; type < NUM_COST_TYPES; ++type)
         {
-            return true;
+            const char* name = CostTypeName(static_cast<CostType>(type));
+            counters.push_back({ "Update ms", name, CpuProfiler::TicksToMilliseconds(costs.update[type].total) });
+            counters.push_back({ "Render ms", name, CpuProfiler::TicksToMilliseconds(costs.render[type].total) });
         }
+        counters.push_back({ "Render ms", "Batched", CpuProfiler::TicksToMilliseconds(costs.batchedRender) });
+    }
+
+    const CpuProfiler::Frame& frame = gCpuProfiler.LastFrame();
+    mTraceCapture.AddFrame(frame, std::move(counters));
+
+    bool overBudget = mTraceBudget > 0.0f && CpuProfiler::TicksToMilliseconds(frame.end - frame.start) > mTraceBudget &&
+                      mTraceCapture.SecondsHeld() >= 1.0;
+    if (KeyHit(Key_F11) || overBudget)  SaveTrace();
+}
+
+// Write the trace capture to the next numbered trace file, or the given file, on a background thread
+void Scene::SaveTrace(const std::string& fileName /*= {}*/)
+{
+    CheckTraceWrite(true); // Only one write at a time
+    if (mTraceCapture.NumFrames() == 0)  return;
+
+    auto trace = mTraceCapture.Take();
+    mTraceFileName = !fileName.empty() ? fileName : std::string(TRACE_FILE) + std::to_string(++mTracesSaved) + ".json";
+    mTraceStatus = "Saving " + std::to_string(trace->frames.size()) + " frames...";
+    mTraceWrite = std::async(std::launch::async, [trace = std::move(trace), fileName = mTraceFileName]()
+    {
+        return trace->WriteJson(fileName);
+    });
+}
+
+// Set the trace status from the background write if it has finished, waiting for it if wait is true
+void Scene::CheckTraceWrite(bool wait)
+{
+    if (!mTraceWrite.valid())  return;
+    if (!wait && mTraceWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)  return;
+    mTraceStatus = (mTraceWrite.get() ? "Saved " : "Failed to save ") + mTraceFileName;
+}
+
+// Pass the time of the frame just finished to the spike watchdog. A spike is saved as the trace capture, which already holds
+// the frame, a checkpoint of the world as the frame left it and the message stats, then the stats are frozen on the spike
+void Scene::CheckFrameSpike(float frameMilliseconds)
+{
+    if (!mWatchdogEnabled || mHeadless || mSpikeFrozen || frameMilliseconds <= 0.0f)  return;
+    if (!mFrameWatchdog.AddFrame(frameMilliseconds))  return;
+    gEventTrace.FrameSpike(frameMilliseconds, mFrameWatchdog.LastSpikeBaseline());
+
+    std::string fileName = std::string(SPIKE_FILE) + std::to_string(mFrameWatchdog.SpikesReported());
+    LOG_WARNING("Frame spike: {}ms against a baseline of {}ms, saving {}.*", frameMilliseconds, mFrameWatchdog.LastSpikeBaseline(),
+                fileName);
+    SaveTrace(fileName + ".json");
+    SaveCheckpoint(fileName + ".bin");
+    bool messagesSaved = gMessenger->ExportStats(fileName + ".csv");
+
+    char status[128];
+    snprintf(status, sizeof(status), "Spike %u: %.1fms (baseline %.1fms), saved %s.json, .bin%s", mFrameWatchdog.SpikesReported(),
+             frameMilliseconds, mFrameWatchdog.LastSpikeBaseline(), fileName.c_str(), messagesSaved ? ", .csv" : "");
+    mSpikeStatus = status;
+
+    if (mFreezeOnSpike)
+    {
+        gCpuProfiler.Frozen() = true;
+        gAllocationTracker.Frozen() = true;
+        gMessenger->StatsEnabled() = false; // Collection stops, so the stats stay as they were at the spike
+        mSpikeFrozen = true;
+    }
+}
+
+// Unfreeze the stats frozen on a spike and start the watchdog's baseline again, the frames while frozen having been skipped
+void Scene::ResumeAfterSpike()
+{
+    if (!mSpikeFrozen)  return;
+    gCpuProfiler.Frozen() = false;
+    gAllocationTracker.Frozen() = false;
+    gMessenger->StatsEnabled() = true;
+    mFrameWatchdog.Reset();
+    mSpikeFrozen = false;
+}
+
+// Write a level from the generator settings to GENERATED_LEVEL_FILE on a background thread
+void Scene::GenerateLevelFile()
+{
+    CheckLevelGeneration(true); // Only one write at a time
+    mGeneratorStatus = "Generating...";
+    mGeneratorWrite = std::async(std::launch::async, [this, settings = mGeneratorSettings]()
+    {
+        return GenerateLevel("Entities.xml", GENERATED_LEVEL_FILE, settings, mGeneratorError);
+    });
+}
+
+// Set the generator status from the background write if it has finished, waiting for it if wait is true
+void Scene::CheckLevelGeneration(bool wait)
+{
+    if (!mGeneratorWrite.valid())  return;
+    if (!wait && mGeneratorWrite.wait_for(std::chrono::seconds(0)) != std::future_status::ready)  return;
+    if (mGeneratorWrite.get())
+        mGeneratorStatus = std::string("Wrote ") + GENERATED_LEVEL_FILE + ", play it with -level " + GENERATED_LEVEL_FILE;
+    else
+        mGeneratorStatus = "Failed: " + mGeneratorError;
+}
+
+// Forget everything holding boat pointers and rebuild the world snapshot, after the boats have been replaced as a whole
+void Scene::ResetBoatReferences()
+{
+    mSelectedBoat   = nullptr;
+    mSelectedUIBoat = nullptr;
+    mBoatList       = {};
+    mNearestEntity  = nullptr;
+    mPickerValid    = false;
+    mBoatLabels.clear();
+    gFloatingText.Clear();
+    Boat::ClearStateChanges();
+    BuildWorldSnapshot();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Replays
+//--------------------------------------------------------------------------------------
+
+// Record the boats, missiles, crates, mines and shields to the given file from the next simulation step on
+bool Scene::StartReplayRecording(const std::string& fileName)
+{
+    StopReplayRecording();
+    mReplayRecorder = std::make_unique<ReplayRecorder>();
+    if (!mReplayRecorder->Start(fileName))
+    {
+        mReplayRecorder.reset();
+        mReplayStatus = "Can't create " + fileName;
+        return false;
+    }
+    mReplayStatus = "Recording to " + fileName;
+    return true;
+}
+
+// Finish the recording, writing the last of it
+bool Scene::StopReplayRecording()
+{
+    if (!mReplayRecorder)  return false;
+    uint32_t ticks = mReplayRecorder->TicksRecorded();
+    bool written = mReplayRecorder->Stop();
+    mReplayRecorder.reset();
+    mReplayStatus = written ? "Recorded " + std::to_string(ticks) + " ticks" : std::string("Failed to write the replay");
+    return written;
+}
+
+// Record the gameplay events to the given file from the next simulation step on. The hits, mine hits and pickups are read
+// from the message types the scene always observes
+bool Scene::StartAnalytics(const std::string& fileName)
+{
+    StopAnalytics();
+    mAnalytics = std::make_unique<GameAnalytics>();
+    if (!mAnalytics->Start(fileName))
+    {
+        mAnalytics.reset();
+        return false;
+    }
+    return true;
+}
+
+// Finish the analytics file, writing the last block of events
+bool Scene::StopAnalytics()
+{
+    if (!mAnalytics)  return false;
+    bool written = mAnalytics->Stop();
+    mAnalytics.reset();
+    return written;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Live Metrics
+//--------------------------------------------------------------------------------------
+
+// Push the scene's metrics to a statsd server every second. Returns false with an error if the host can't be found
+bool Scene::StartMetrics(const std::string& host, uint16_t port, const std::string& prefix, std::string& error)
+{
+    StopMetrics();
+    mMetrics = std::make_unique<MetricsExporter>();
+    mMetricIDs.steps       = mMetrics->AddCounter("sim.steps");
+    mMetricIDs.messages    = mMetrics->AddCounter("messages");
+    mMetricIDs.entities    = mMetrics->AddGauge("entities.total");
+    mMetricIDs.boats       = mMetrics->AddGauge("entities.boats");
+    mMetricIDs.missiles    = mMetrics->AddGauge("entities.missiles");
+    mMetricIDs.crates      = mMetrics->AddGauge("entities.crates");
+    mMetricIDs.mines       = mMetrics->AddGauge("entities.mines");
+    mMetricIDs.obstacles   = mMetrics->AddGauge("entities.obstacles");
+    mMetricIDs.stations    = mMetrics->AddGauge("entities.stations");
+    mMetricIDs.videoMemory = mMetrics->AddGauge("gpu.memory_mb");
+    mMetricIDs.videoBudget = mMetrics->AddGauge("gpu.budget_mb");
+    if (!mMetrics->Start(host, port, prefix, 1.0f, error))
+    {
+        mMetrics.reset();
+        return false;
+    }
+    return true;
+}
+
+void Scene::StopMetrics()
+{
+    mMetrics.reset();
+}
+
+// Count the step and the messages it delivered and set the entity counts. Each is a relaxed atomic operation, the exporter's
+// thread does the rest
+void Scene::UpdateStepMetrics()
+{
+    mMetrics->Count(mMetricIDs.steps);
+    mMetrics->Count(mMetricIDs.messages, gMessenger->InboxSize());
+    mMetrics->SetGauge(mMetricIDs.entities,  static_cast<double>(gEntityManager->NumEntities()));
+    mMetrics->SetGauge(mMetricIDs.boats,     static_cast<double>(gEntityManager->View<Boat>().size()));
+    mMetrics->SetGauge(mMetricIDs.missiles,  static_cast<double>(gEntityManager->View<Missile>().size()));
+    mMetrics->SetGauge(mMetricIDs.crates,    static_cast<double>(gEntityManager->View<RandomCrate>().size()));
+    mMetrics->SetGauge(mMetricIDs.mines,     static_cast<double>(gEntityManager->View<SeaMine>().size()));
+    mMetrics->SetGauge(mMetricIDs.obstacles, static_cast<double>(gEntityManager->View<Obstacle>().size()));
+    mMetrics->SetGauge(mMetricIDs.stations,  static_cast<double>(gEntityManager->View<ReloadStation>().size()));
+}
+
+
+// Run a fly-through benchmark (pass nullptr to stop). Frames are produced as fast as they can be so their times are measured,
+// not the vertical blank's or the frame rate cap's
+void Scene::SetFlyThrough(FlyThrough* flyThrough)
+{
+    mFlyThrough = flyThrough;
+    if (!mFlyThrough)
+    {
+        mActiveChaseBoat = NO_ID;
+        return;
+    }
+    mVSync = false;
+    mFrameLimiter->SetFrameRate(0);
+    gCpuProfiler.SetEnabled(true); // For the time of each scope
+    gAllocationTracker.SetEnabled(true);
+    gMessenger->BroadcastAll(SYSTEM_ID, MessageType::Start);
+}
+
+// Play back REPLAY_FILE in place of the simulation. The game is captured as a checkpoint in memory to go back to afterwards,
+// as playing replaces its boats, missiles, crates, mines and shields
+void Scene::StartReplay()
+{
+    mStartReplayNext = false;
+    StopReplayRecording(); // The replay may be the one being recorded
+
+    auto replay = std::make_unique<ReplayPlayer>();
+    std::string error;
+    if (!replay->Open(REPLAY_FILE, error))
+    {
+        mReplayStatus = "Replay failed: " + error;
+        return;
+    }
+    mReplayReturn = std::make_unique<Checkpoint>();
+    mReplayReturn->Capture(*gEntityManager, *gMessenger,
+                           { mSpawnDirector.GetTimer(SpawnKind::Crate), mSpawnDirector.GetTimer(SpawnKind::Mine), mStepAccumulator });
+
+    mReplay = std::move(replay);
+    mReplay->Begin(*gEntityManager);
+    mReplay->Apply(*gEntityManager);
+    mStepBlend = mReplay->Blend();
+    ResetBoatReferences();
+    mReplayStatus = "Playing " + std::string(REPLAY_FILE);
+}
+
+// Stop the replay and put the game back as it was when the replay started
+void Scene::StopReplay()
+{
+    mStopReplayNext = false;
+    if (!mReplay)  return;
+
+    mReplay->End(*gEntityManager);
+    mReplay.reset();
+
+    Checkpoint::SceneState sceneState;
+    std::string error;
+    if (mReplayReturn->Restore(*gEntityManager, *gMessenger, sceneState, error))
+    {
+        mSpawnDirector.SetTimer(SpawnKind::Crate, sceneState.randomCrateTimer);
+        mSpawnDirector.SetTimer(SpawnKind::Mine, sceneState.randomMineTimer);
+        mStepAccumulator = sceneState.stepAccumulator;
+        mReplayStatus.clear();
+    }
+    else
+    {
+        mReplayStatus = "Failed to return to the game: " + error;
+    }
+    mReplayReturn.reset();
+    mStepBlend = 1.0f;
+    ResetBoatReferences();
+}
+
+// Move the replay on by the frame time at the replay speed, in place of the simulation steps
+void Scene::UpdateReplay(float frameTime)
+{
+    if (!mReplay->Seek(mReplay->Time() + frameTime * mReplaySpeed))  mReplayStatus = "Replay is damaged, stopped where it got to";
+    mReplay->Apply(*gEntityManager);
+    mStepBlend = mReplay->Blend();
+    BuildWorldSnapshot();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Networked Play
+//--------------------------------------------------------------------------------------
+
+// Serve the game to network clients on the given port. Returns false if the port can't be opened
+bool Scene::StartServer(uint16_t port, std::string& error)
+{
+    StopServer();
+    auto server = std::make_unique<NetServer>();
+    if (!server->Start(port, error))  return false;
+    mNetServer = std::move(server);
+    error.clear();
+    return true;
+}
+
+void Scene::StopServer()
+{
+    if (!mNetServer)  return;
+    mNetServer->Stop();
+    mNetServer.reset();
+}
+
+
+// Join the game served by another instance until the connection ends. This scene's own game is captured as a checkpoint in
+// memory to go back to afterwards, as joining replaces its boats, missiles, crates, mines and shields
+bool Scene::StartNetClient(const std::string& host, uint16_t port, std::string& error)
+{
+    if (mNetServer || mReplay || mNetClient)
+    {
+        error = "Can't join a server while serving, playing a replay or joined";
+        return false;
+    }
+    auto client = std::make_unique<NetClient>();
+    if (!client->Connect(host, port, error))  return false;
+
+    mNetReturn = std::make_unique<Checkpoint>();
+    mNetReturn->Capture(*gEntityManager, *gMessenger,
+                        { mSpawnDirector.GetTimer(SpawnKind::Crate), mSpawnDirector.GetTimer(SpawnKind::Mine), mStepAccumulator });
+    mNetClient = std::move(client);
+    mNetClient->Begin(*gEntityManager);
+    mStepBlend = 1.0f;
+    ResetBoatReferences();
+    error.clear();
+    return true;
+}
+
+// Leave the server's game and put this one back as it was when joining
+void Scene::StopNetClient()
+{
+    mStopNetClientNext = false;
+    if (!mNetClient)  return;
+
+    mNetClient->End(*gEntityManager);
+    mNetClient.reset();
+
+    Checkpoint::SceneState sceneState;
+    std::string error;
+    if (mNetReturn->Restore(*gEntityManager, *gMessenger, sceneState, error))
+    {
+        mSpawnDirector.SetTimer(SpawnKind::Crate, sceneState.randomCrateTimer);
+        mSpawnDirector.SetTimer(SpawnKind::Mine, sceneState.randomMineTimer);
+        mStepAccumulator = sceneState.stepAccumulator;
+    }
+    else
+    {
+        mNetStatus = "Failed to return to the game: " + error;
+    }
+    mNetReturn.reset();
+    mStepBlend = 1.0f;
+    ResetBoatReferences();
+}
+
+// Take in the server's snapshots and show its game at the time reached, in place of the simulation steps
+void Scene::UpdateNetClient(float frameTime)
+{
+    // The server sends what is around the camera being looked through, see interest management in Network.h
+    if (Camera* camera = ActiveCamera())  mNetClient->SetViewPoint(camera->Transform().Position());
+
+    std::string error;
+    if (!mNetClient->Update(frameTime, error))
+    {
+        StopNetClient();
+        mNetStatus = error;
+        return;
+    }
+
+    // Boats the server has removed are destroyed by Apply, so the mouse selection is checked again by ID
+    EntityID selected = mSelectedBoat  ? mSelectedBoat->GetID()  : NO_ID;
+    EntityID nearest  = mNearestEntity ? mNearestEntity->GetID() : NO_ID;
+    mNetClient->Apply(*gEntityManager);
+    if (!gEntityManager->IsAlive(selected))  mSelectedBoat = nullptr;
+    if (!gEntityManager->IsAlive(nearest))
+    {
+        mNearestEntity = nullptr;
+        mPickerValid   = false;
+    }
+    mStepBlend = mNetClient->Blend();
+    BuildWorldSnapshot();
+}
+
+// Give a boat (NO_ID for every boat) an order from the player. As a network client the order is sent to the server
+void Scene::OrderBoat(EntityID boat, MessageType type, const Vector3& point /*= {}*/)
+{
+    if (mNetClient)
+    {
+        mNetClient->SendCommand(boat, type, point);
+        return;
+    }
+    if (boat == NO_ID)                          gMessenger->BroadcastAll(SYSTEM_ID, type);
+    else if (type == MessageType::TargetPoint)  gMessenger->DeliverMessage(SYSTEM_ID, boat, type, TargetPointData{ point, 5.0f });
+    else                                        gMessenger->DeliverMessage(SYSTEM_ID, boat, type);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Boat Labels
+//--------------------------------------------------------------------------------------
+// Mark the labels of boats whose displayed values changed this frame. Hits, mine hits and crates change the health and missile
+// counts, and firing or reloading change the state as well as the missile counts, so these events cover everything shown
+// except the speed (see BoatLabelText)
+void Scene::MarkChangedBoatLabels()
+{
+    gMessenger->ForEachObserved([this](EntityID boatID, const Message&) { mBoatLabels[boatID].dirty = true; });
+    for (const Boat::StateChange& change : Boat::StateChanges())  mBoatLabels[change.boat].dirty = true;
+
+    // Forget the labels of boats that no longer exist
+    if (mBoatLabels.size() > mWorld.NumBoats())
+    {
+        std::erase_if(mBoatLabels, [](const auto& label) { return !gEntityManager->IsAlive(label.first); });
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Missiles
+//--------------------------------------------------------------------------------------
+// Launch a missile from the given boat, on the GPU in mass battle mode. GPU missiles only move when the scene is rendered, so a
+// headless scene always uses entities, as does a launch when every GPU missile slot is in use
+void Scene::LaunchMissile(const Matrix4x4& transform, float speed, const Vector3& velocity, EntityID boatID)
+{
+    if (mAnalytics)  mAnalytics->RecordShot(boatID, transform.Position());
+    if (!mHeadless && mGpuMissiles && mGpuMissiles->Enabled() && mGpuMissiles->Launch(transform.Position(), velocity, boatID))  return;
+    gEntityManager->CreateEntity<Missile>(mMissileTemplate, transform, speed, velocity, boatID);
+}
+
+
+// Move the GPU missiles on against the boats that can still be hit, then deliver the hits read back from earlier frames. The
+// messages are read in the next simulation step, as a Missile entity's would be, but the hits are a frame or so late
+void Scene::UpdateGpuMissiles()
+{
+    mMissileTargets.clear();
+    for (size_t i = 0; i < mWorld.boats.size(); ++i)
+    {
+        if (mWorld.states[i] != Boat::State::Destroyed)  mMissileTargets.push_back({ mWorld.positions[i], mWorld.ids[i] });
+    }
+    mGpuMissiles->Update(mMissileTargets);
+
+    for (const GpuMissiles::Hit& hit : mGpuMissiles->Hits())
+    {
+        MissileHitData hitData;
+        hitData.launchingBoatID = hit.launchingBoat;
+        gMessenger->DeliverMessage(NO_ID, hit.boat, MessageType::Hit, hitData);
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Particle Effects
+//--------------------------------------------------------------------------------------
+// Emit the particles for the events of a simulation step: a burst on each boat hit by a missile or a mine, a larger one for each
+// boat destroyed, and a puff behind each missile in flight. The entities know nothing of particles, the scene picks the effects
+// out of the messages it already observes, so an effect costs the CPU one burst whatever number of particles it has. Each hit and
+// destruction also lights its surroundings with a flash of the burst's colour
+void Scene::EmitParticleEffects(float stepTime)
+{
+    if (mParticleSystem)   mParticleSystem->Advance(stepTime);
+    if (mClusteredLights)  mClusteredLights->Advance(stepTime);
+    if (!mParticleSystem && !mClusteredLights)  return;
+
+    auto emit = [&](const ParticleBurst& burst, float flashBrightness, float flashRadius, float flashTime)
+    {
+        if (mParticleSystem)  mParticleSystem->Emit(burst);
+        if (mClusteredLights && flashRadius > 0)
+        {
+            ColourRGB flashColour(burst.colour.r * flashBrightness, burst.colour.g * flashBrightness, burst.colour.b * flashBrightness);
+            mClusteredLights->AddFlash(burst.position, flashColour, flashRadius, flashTime);
+        }
+    };
+
+    gMessenger->ForEachObserved([&](EntityID boatID, const Message& message)
+    {
+        if (message.type != MessageType::Hit && message.type != MessageType::MineHit)  return;
+        Entity* boat = gEntityManager->GetEntity(boatID);
+        if (boat == nullptr)  return;
+
+        ParticleBurst burst;
+        burst.position = boat->Transform().Position();
+        if (message.type == MessageType::Hit)
+        {
+            burst.speed = 25.0f;  burst.lifetime = 1.2f;  burst.size = 2.5f;  burst.numParticles = 400;
+            burst.colour = { 1.0f, 0.55f, 0.15f, 1.0f };
+            emit(burst, 3.0f, 60.0f, 0.4f);
+        }
+        else
+        {
+            // Mine blasts throw water up as well as fire
+            burst.velocity = { 0, 15.0f, 0 };
+            burst.speed = 20.0f;  burst.lifetime = 1.8f;  burst.size = 3.0f;  burst.numParticles = 600;
+            burst.colour = { 0.6f, 0.8f, 1.0f, 1.0f };
+            emit(burst, 2.0f, 60.0f, 0.5f);
+        }
+    });
+
+    for (const Boat::StateChange& change : Boat::StateChanges())
+    {
+        if (change.to != Boat::State::Destroyed)  continue;
+        Entity* boat = gEntityManager->GetEntity(change.boat);
+        if (boat == nullptr)  continue;
+
+        ParticleBurst burst;
+        burst.position = boat->Transform().Position();
+        burst.velocity = { 0, 10.0f, 0 };
+        burst.speed = 40.0f;  burst.lifetime = 2.5f;  burst.size = 4.0f;  burst.numParticles = 3000;
+        burst.colour = { 1.0f, 0.4f, 0.1f, 1.0f };
+        emit(burst, 4.0f, 120.0f, 1.0f);
+    }
+
+    if (!mParticleSystem)  return;
+    for (Missile* missile : gEntityManager->View<Missile>())
+    {
+        ParticleBurst burst;
+        burst.position = missile->Transform().Position();
+        burst.speed = 2.0f;  burst.lifetime = 0.8f;  burst.size = 0.8f;  burst.numParticles = 8;
+        burst.colour = { 0.9f, 0.7f, 0.5f, 0.6f };
+        mParticleSystem->Emit(burst);
+    }
+}
+
+
+// Add this frame's clustered lights, from the entities' positions as they are drawn (blended between steps). GPU missiles don't
+// glow, their positions never come back to the CPU
+void Scene::GatherLights()
+{
+    PROFILE_SCOPE("Gather Lights");
+    mClusteredLights->BeginFrame();
+    for (Missile* missile : gEntityManager->View<Missile>())
+    {
+        mClusteredLights->AddLight(missile->Transform().Position(), ColourRGB(2.0f, 1.2f, 0.5f), 25.0f);
+    }
+    for (ReloadStation* reloadStation : gEntityManager->View<ReloadStation>())
+    {
+        mClusteredLights->AddLight(reloadStation->Transform().Position() + Vector3(0, 5, 0), ColourRGB(0.4f, 1.5f, 0.6f), 50.0f);
+    }
+}
+
+
+// Draw the shaders of the templates loaded since the last call offscreen. Every template is warmed for the opaque pass, which
+// draws the entities spawned during play, and the templates of the sky and additive entities for those passes too. Combinations
+// already drawn are skipped, so running it again for one new template only draws that template's new ones
+void Scene::PrewarmShaders()
+{
+    if (!mShaderPrewarm || gEntityManager->TemplateCount() == mPrewarmedTemplates)  return;
+    mPrewarmedTemplates = gEntityManager->TemplateCount();
+
+    // The states of the passes in RenderOpaquePass (depth pre-pass, equal test colour pass, or neither), RenderSkyPass and
+    // RenderAdditivePass
+    const ShaderPrewarm::Pass opaquePasses[] =
+    {
+        { RasterizerState::CullBack, DepthState::DepthOn,    BlendState::BlendNone, true },
+        { RasterizerState::CullBack, DepthState::DepthEqual, BlendState::BlendNone },
+        { RasterizerState::CullBack, DepthState::DepthOn,    BlendState::BlendNone },
+    };
+    const ShaderPrewarm::Pass skyPass      = { RasterizerState::CullBack, DepthState::DepthReadOnlyLessEqual, BlendState::BlendNone };
+    const ShaderPrewarm::Pass additivePass = { RasterizerState::CullNone, DepthState::DepthReadOnly, BlendState::BlendAdditive };
+
+    auto warm = [&](EntityTemplate* entityTemplate, const ShaderPrewarm::Pass& pass)
+    {
+        for (unsigned int lod = 0; lod < entityTemplate->LODCount(); ++lod)  mShaderPrewarm->Warm(entityTemplate->GetLODMesh(lod), pass);
+    };
+
+    mShaderPrewarm->Begin();
+    std::vector<EntityTemplate*> templates;
+    gEntityManager->CreateCollection(templates);
+    for (EntityTemplate* entityTemplate : templates)
+    {
+        for (auto& pass : opaquePasses)  warm(entityTemplate, pass);
+    }
+    for (EntityTemplate* entityTemplate : gEntityManager->GroupTemplates(PassRenderGroup(RenderPass::Sky)))       warm(entityTemplate, skyPass);
+    for (EntityTemplate* entityTemplate : gEntityManager->GroupTemplates(PassRenderGroup(RenderPass::Additive)))  warm(entityTemplate, additivePass);
+    mShaderPrewarm->End();
+}
+
+
+// Return the label text for the given boat in mWorld, rebuilding it if what it shows has changed
+const std::string& Scene::BoatLabelText(size_t boatIndex)
+{
+    Boat* boatPtr = mWorld.boats[boatIndex];
+    BoatLabel& label = mBoatLabels[mWorld.ids[boatIndex]];
+
+    int speedHundredths = static_cast<int>(std::round(boatPtr->GetSpeed() * 100.0f));
+    int thinkRate = static_cast<int>(std::round(boatPtr->GetThinkRate()));
+    if (!label.dirty && label.extended == mShowExtendedBoatUI &&
+        (!mShowExtendedBoatUI || (label.speedHundredths == speedHundredths && label.thinkRate == thinkRate)))
+    {
+        return label.text;
+    }
+
+    if (!mShowExtendedBoatUI)
+    {
+        label.text.assign(boatPtr->Template().GetType().str()).append(": ").append(boatPtr->GetName());
+    }
+    else
+    {
+        float hp = boatPtr->GetHP();
+        const char* state = Boat::GetStateName(mWorld.states[boatIndex]);
+        int fired = boatPtr->GetMissilesFired();
+        int missilesLeft = boatPtr->GetMissilesRemaining();
+
+        // Formatted to a buffer then copied in, so the label's string reuses its memory rather than building temporaries
+        char text[256];
+        snprintf(text, sizeof(text), "%s [HP=%d, State=%s, Fired=%d, Missiles=%d, Speed=%.2f, AI=%dHz]", boatPtr->GetName().c_str(),
+                 static_cast<int>(hp), state, fired, missilesLeft, speedHundredths / 100.0f, thinkRate);
+        label.text.assign(text);
     }
-    return false; // All boats are inactive
+    label.dirty = false;
+    label.extended = mShowExtendedBoatUI;
+    label.speedHundredths = speedHundredths;
+    label.thinkRate = thinkRate;
+    return label.text;
 }
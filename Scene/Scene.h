@@ -13,6 +13,16 @@
 #include "RandomCrate.h"
 #include "EntityTypes.h"
 #include "ColourTypes.h"
+#include "ScreenPicker.h"
+#include "AIScheduler.h"
+#include "SpawnDirector.h"
+#include "JobSystem.h"
+#include "TraceCapture.h"
+#include "FrameWatchdog.h"
+#include "MemoryBudget.h"
+#include "LevelGenerator.h"
+#include "ChaseCameras.h"
+#include "GpuMissiles.h" // For GpuMissiles::Target in the member variables
 
 #define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
@@ -21,6 +31,9 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <future>
+#include <chrono>
 
 // Forward declarations of various classes allows us to use pointers to those classes before those classes have been fully declared
 // This help us reduce the number of include files here, which in turn minimises dependencies and speeds up compilation
@@ -30,7 +43,109 @@
 class EntityManager;
 class Entity;
 class Camera;
+class Frustum;
 class Mesh;
+class OcclusionCuller;
+class GpuCuller;
+class ImpostorRenderer;
+class ParticleSystem;
+class ClusteredLights;
+class ShadowMap;
+class EnvironmentLighting;
+class ShaderPrewarm;
+class IdBufferPicker;
+class RenderGraph;
+class WaterRenderer;
+class WorldPartition;
+struct LoadedLevel;
+class DynamicResolution;
+class HalfResEffects;
+class WeightedOit;
+class LabelRenderer;
+class FloatingTextRenderer;
+class FrameLimiter;
+class Checkpoint;
+class ReplayRecorder;
+class ReplayPlayer;
+class GameAnalytics;
+class MetricsExporter;
+class NetServer;
+class NetClient;
+class FlyThrough;
+
+
+//--------------------------------------------------------------------------------------
+// World Snapshot
+//--------------------------------------------------------------------------------------
+// Boat data gathered once per frame, straight after the entities are updated. The scene's rendering, picking, camera and UI
+// code all read this rather than each fetching its own copy of the list of boats. Each kind of data is in its own array, with
+// the same index for the same boat in every array, so a loop that only needs e.g. positions only touches that data.
+// The boat pointers are valid until the next entity update
+struct WorldSnapshot
+{
+    std::vector<Boat*>       boats;
+    std::vector<EntityID>    ids;
+    std::vector<Vector3>     positions;
+    std::vector<Vector3>     facings; // Z axis of each boat's world matrix
+    std::vector<Team>        teams;
+    std::vector<Boat::State> states;
+    bool anyBoatActive = false;       // True if any boat has been started
+    uint32_t version = 0;             // Increased each time the snapshot is gathered, so users can tell when it has changed
+
+    size_t NumBoats() const { return boats.size(); }
+};
+
+
+//--------------------------------------------------------------------------------------
+// Battle Results
+//--------------------------------------------------------------------------------------
+// The outcome of a battle run by Scene::RunBattle. Every boat in the level at the start has a result, including those that
+// were destroyed and removed. Can be written as readable text or as CSV for collecting the results of many battles
+struct BattleResult
+{
+    struct BoatResult
+    {
+        std::string name;
+        Team        team;
+        float       hp;
+        int         missilesFired = 0;
+        int         missileHits   = 0;    // Missiles fired by this boat that hit another boat
+        float       destroyedTime = -1.0f; // Game time the boat was destroyed, negative if it survived
+    };
+    std::vector<BoatResult> boats;
+    int      winner = -1;             // Index into teamNames of the last team with boats left, -1 if none
+    bool     timeLimitReached = false; // More than one team was left at the time limit
+    float    gameTime = 0.0f;         // Seconds of game time the battle lasted
+    uint64_t seed = 0;                // The RandomSeed the battle was run with
+
+    // Readable summary of the battle
+    std::string Summary() const;
+
+    // The CSV column names and the battle as CSV rows, one per boat. scenario is put in the first column, e.g. the level file
+    static std::string CsvHeader();
+    std::string CsvRows(const std::string& scenario) const;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Render Passes
+//--------------------------------------------------------------------------------------
+// The passes each frame is drawn in, in order. Each entity is drawn by the pass with the same value as its render group (see
+// Entity::RenderGroup), the default group 0 being opaque. The camera view's passes are listed in RENDER_PASSES and drawn by
+// RenderFromCamera, the UI (text labels and control panel) is drawn over them by Render
+enum class RenderPass : unsigned int
+{
+    Opaque,   // Solid entities, front to back, optionally after a depth pre-pass
+    Sky,      // At the far depth, only where no opaque entity was drawn
+    Additive, // Blended entities, back to front, reading but not writing depth
+    UI,
+};
+
+// Render group of the entities a pass draws
+constexpr unsigned int PassRenderGroup(RenderPass pass) { return static_cast<unsigned int>(pass); }
+
+// Render group no pass draws, for entities drawn another way for now (e.g. the water meshes while the water renderer is on)
+constexpr unsigned int HIDDEN_RENDER_GROUP = PassRenderGroup(RenderPass::UI) + 1;
 
 
 //--------------------------------------------------------------------------------------
@@ -42,8 +157,9 @@ class Scene
 	// Construction
 	//--------------------------------------------------------------------------------------
 public:
-    // Constructs a demo scene ready to be rendered/updated
-    Scene();
+    // Constructs a scene from the given level file ready to be rendered/updated. A headless scene is only simulated, never
+    // rendered, and creates nothing on the GPU so can be used without a DX device, see RunBattle
+    Scene(const std::string& levelFile = "Entities.xml", bool headless = false);
 
 	// No destruction required but see comment on forward declarations above
     ~Scene();
@@ -56,25 +172,216 @@ public:
     // Render entire scene
     void Render();
 
-    // Update entire scene. frameTime is the time passed since the last frame
+    // Update entire scene. frameTime is the time passed since the last frame. In fixed step mode (the default) the entities
+    // are moved in steps of SIMULATION_STEP seconds, as many as have passed, and rendered part way between the last two steps.
+    // Otherwise they are moved once by frameTime. The cameras and controls are updated once per frame either way
     void Update(float frameTime);
 
+    // Wait until it is time to start the next frame, for the frame rate cap and (in low latency mode) the swap chain. Call
+    // before timing and updating each frame
+    void PaceFrame();
+
+    // Power saving. Work out whether the window is hidden - minimised, covered by other windows or, if chosen in the control
+    // panel, not the focus - given the window's state from its messages. Hidden frames aren't drawn, so the main loop calls
+    // Update at HiddenUpdateRate and sleeps on the window messages in between, rather than running flat out. Nothing is
+    // hidden with power saving off or during a fly-through. Call once per loop, before Update
+    bool CheckHidden(bool minimised, bool focused);
+
+    // Updates per second while hidden, 0 to stop simulating until the window is seen again. Below 1 / (SIMULATION_STEP *
+    // MAX_STEPS_PER_FRAME) the game runs slower than real time, as each update runs no more than MAX_STEPS_PER_FRAME steps
+    float HiddenUpdateRate()  { return mHiddenUpdateRate; }
+
+    // Start the boats and simulate in SIMULATION_STEP steps as fast as possible, until only one team has boats left or
+    // timeLimit seconds of game time have passed. For headless scenes, no time is spent on rendering
+    BattleResult RunBattle(float timeLimit);
+
+    // Record the boats, missiles, crates, mines and shields to the given file from the next simulation step on, or finish the
+    // recording. Return false if the file can't be created or written, see Replay.h
+    bool StartReplayRecording(const std::string& fileName);
+    bool StopReplayRecording();
+
+    // Record every shot, hit, mine hit, crate pickup and boat state change to the given columnar file from the next simulation
+    // step on, or finish the file. Return false if the file can't be created or written, see GameAnalytics.h
+    bool StartAnalytics(const std::string& fileName);
+    bool StopAnalytics();
+
+    // Push frame time percentiles, entity counts, message and simulation step rates and GPU memory use to a statsd server at
+    // the given host and port every second, each metric named from the given prefix, or stop. Returns false with an error if
+    // the host can't be found, see MetricsExporter.h
+    bool StartMetrics(const std::string& host, uint16_t port, const std::string& prefix, std::string& error);
+    void StopMetrics();
+
+    // Serve the game to network clients on the given port, sending them snapshots after the simulation steps and applying
+    // their orders before them, or stop serving. Returns false if the port can't be opened, see Network.h
+    bool StartServer(uint16_t port, std::string& error);
+    void StopServer();
+
+    // Run as a dedicated server, normally headless: start the boats and call Update in real time, sleeping between steps, until
+    // timeLimit seconds have passed (0 to run until the process is ended). Call StartServer first
+    void RunServer(float timeLimit);
+
+    // Join the game served by another instance, showing its boats, missiles, crates, mines and shields in place of this one's
+    // and sending it the player's orders, until the connection ends. The level file should be the server's. Returns false if
+    // the server can't be found, see Network.h
+    bool StartNetClient(const std::string& host, uint16_t port, std::string& error);
+
+    // Run a fly-through benchmark (owned by the caller, pass nullptr to stop): start the boats, turn off vsync and the frame
+    // rate cap, and from then on place the cameras from its script and time each frame with it. The caller passes
+    // FlyThrough::FRAME_TIME to Update each frame, see FlyThrough.h
+    void SetFlyThrough(FlyThrough* flyThrough);
+
+    // Launch a missile from the given boat, as a Missile entity or, in mass battle mode, on the GPU (see GpuMissiles.h). Called
+    // by the boats as they fire
+    void LaunchMissile(const Matrix4x4& transform, float speed, const Vector3& velocity, EntityID boatID);
+
 
     //--------------------------------------------------------------------------------------
     // Private helper functions
     //--------------------------------------------------------------------------------------
 private:
-    // Render one viewpoint of the scene from the given camera, helper function for Scene::Render
+    // Render one viewpoint of the scene from the given camera, helper function for Scene::Render. Draws the passes of
+    // RENDER_PASSES in order
     void RenderFromCamera(Camera* camera);
 
-    // Draw given text at the given 3D point, also pass camera in use. Optionally centre align and colour the text
-    void DrawTextAtWorldPt(const Vector3& point, std::string text, Camera* camera, bool centreAlign = false);
+    // Render one pass of a camera view with the given frustum, helpers for RenderFromCamera
+    void RenderOpaquePass(const Frustum& frustum);
+    void RenderSkyPass(const Frustum& frustum);
+    void RenderAdditivePass(const Frustum& frustum);
+
+    // Render the IDs of the boats visible from the camera into the given ID buffer for GPU picking, see IdBufferPicker.h
+    void RenderIdBuffer(ID3D11Texture2D* idTexture, ID3D11RenderTargetView* idTarget, Camera* camera);
+
+    // Render the main light's shadow map around the camera for this frame, see ShadowMap.h
+    void RenderShadows(Camera* camera);
+
+    // Put a camera's matrices in the per-camera constant buffer
+    void SetCameraConstants(Camera* camera);
+
+    // Render the chase cameras of mPipBoats in small viewports down the right of the given scene viewport, over the main view,
+    // then set the viewport and camera constants back for the main camera. The views share one culling pass (see
+    // EntityManager::CullViews) and choose levels of detail for their smaller size
+    void RenderPictureInPicture(const D3D11_VIEWPORT& sceneViewport, Camera* mainCamera);
+
+    // Render a group for the sky or additive pass, from the current picture-in-picture view's visible list if there is one
+    void RenderPassGroup(RenderPass pass, const Frustum& frustum, DrawOrder order = DrawOrder::FrontToBack);
+
+    // Add a text label centred on the given 3D point, drawn by the next DrawWorldLabels. The text must stay valid until then.
+    // The key identifies the label from frame to frame so its layout is kept while its text is unchanged, see LabelRenderer.h
+    void AddWorldLabel(uint64_t key, const Vector3& point, const std::string& text, ColourRGB colour);
+
+    // Labels an entity can have, combined with its ID into the key of a world label
+    enum class WorldLabelSlot : uint64_t { Boat, ReloadStation };
+    static uint64_t WorldLabelKey(EntityID id, WorldLabelSlot slot)  { return (static_cast<uint64_t>(slot) << 32) | id; }
+
+    // Draw the labels added since the last call as seen from the given camera, projecting them to the screen together
+    void DrawWorldLabels(Camera* camera);
+
+    // Draw the text floating above entities as seen from the given camera, see FloatingText.h
+    void DrawFloatingText(Camera* camera);
+
+    // Mark the labels of boats whose displayed values changed this frame, from the observed messages and boat state changes
+    void MarkChangedBoatLabels();
+
+    // Emit the particles and light flashes for the events of a simulation step, from the observed messages and boat state changes,
+    // see ParticleSystem.h and ClusteredLights.h
+    void EmitParticleEffects(float stepTime);
+
+    // Add this frame's clustered lights: a glow on each missile in flight and a light on each reload station, as well as the flashes
+    void GatherLights();
+
+    // Draw the shaders of any templates loaded since the last call offscreen, with the states of each pass that may draw them, so
+    // they don't hitch the frame they are first seen in (see ShaderPrewarm.h)
+    void PrewarmShaders();
+
+    // Move the GPU missiles on, against the boats of mWorld, and deliver the hits that have been read back as Hit messages
+    void UpdateGpuMissiles();
+
+    // Return the label text for the given boat in mWorld, rebuilding it if what it shows has changed
+    const std::string& BoatLabelText(size_t boatIndex);
+
+    // The camera currently being viewed from, the main camera or a chase camera
+    Camera* ActiveCamera();
 
-    // Handle camera picking and selection
-    void HandleMousePicking();
+    // Find the boat nearest the mouse as seen from the given camera, only recalculated when the mouse, camera or boats have changed
+    void HandleMousePicking(Camera* camera);
 
-    // Chase camera helpers
+    // Move the entities on by the given time, spawn crates and mines and gather the results, helper function for Scene::Update
+    void SimulationStep(float stepTime);
+
+    // Run the steps counted by a pipelined Update on a worker, called at the end of Render before the frame is presented. And
+    // wait for them to finish, called first thing in Update (and before the scene is destroyed)
+    void StartPipelinedSteps();
+    void FinishPipelinedSteps();
+
+    // Chase camera helpers. Only the camera being viewed follows its boat each frame, the boats that can be chased are those
+    // in mWorld that have not been destroyed, in the order of mWorld
     void UpdateChaseCameras(float frameTime);
+    EntityID ChaseBoat(int index);              // The boat at the given position in the chase order, NO_ID if none
+    EntityID NextChaseBoat(EntityID boat, int step); // The boat a number of places on from the given one, wrapping around
+
+    // Gather the per-frame boat data in mWorld, call after the entities have been updated
+    void BuildWorldSnapshot();
+
+    // Stream the cells of a partitioned level in and out around the boats in mWorld and the active camera, see WorldPartition.h.
+    // With wait set the nearby cells are all created before it returns. Called from the simulation steps
+    void UpdateWorldPartition(bool wait);
+
+    // Save the simulation to CHECKPOINT_FILE (or the given file), written on a background thread, or put it back to the state
+    // in CHECKPOINT_FILE. Called from Update between simulation steps when requested from the control panel, see Checkpoint.h
+    void SaveCheckpoint(const std::string& fileName = CHECKPOINT_FILE);
+    void LoadCheckpoint();
+
+    // Set the checkpoint status from the background write if it has finished, waiting for it if wait is true
+    void CheckCheckpointWrite(bool wait);
+
+    // Apply the edits to the level file if it has changed since it was last loaded, see ParseLevel::ReloadFile. Checks the
+    // file's time every LEVEL_RELOAD_INTERVAL, called from Update between simulation steps
+    void CheckLevelReload(float frameTime);
+
+    // Put the level's sky in the sky pass and find its water meshes, after the level is loaded or reloaded
+    void SetupLevelEntities();
+
+    // Forget everything holding boat pointers and rebuild the world snapshot, after the boats have been replaced as a whole
+    void ResetBoatReferences();
+
+    // Add the frame just finished to the trace capture, and save the capture if F11 was hit or the frame went over the
+    // budget. Called from Update after the CPU profiler has collected the frame
+    void UpdateTraceCapture();
+
+    // Write the trace capture to the next numbered trace file (or the given file) on a background thread, see TraceCapture.h
+    void SaveTrace(const std::string& fileName = {});
+
+    // Set the trace status from the background write if it has finished, waiting for it if wait is true
+    void CheckTraceWrite(bool wait);
+
+    // Pass the time of the frame just finished to the spike watchdog, saving the spike files and freezing the stats if it is
+    // a spike. Called from Update after the trace capture has the frame. And unfreeze the stats to look for the next spike
+    void CheckFrameSpike(float frameMilliseconds);
+    void ResumeAfterSpike();
+
+    // Write a level from the generator settings to GENERATED_LEVEL_FILE on a background thread, see LevelGenerator.h. And set
+    // the generator status when it has finished, waiting for it if wait is true
+    void GenerateLevelFile();
+    void CheckLevelGeneration(bool wait);
+
+    // Play back REPLAY_FILE in place of the simulation, or stop and go back to the game as it was. Called from Update when
+    // requested from the control panel. While playing, UpdateReplay moves the replay on in place of the simulation steps
+    void StartReplay();
+    void StopReplay();
+    void UpdateReplay(float frameTime);
+
+    // Count each simulation step for the live metrics and set the entity counts, see StartMetrics
+    void UpdateStepMetrics();
+
+    // Leave the server's game and go back to this one as it was when joining, called from Update when requested from the
+    // control panel or the connection is lost. While joined, UpdateNetClient shows the server's game in place of the
+    // simulation steps
+    void StopNetClient();
+    void UpdateNetClient(float frameTime);
+
+    // Give a boat (NO_ID for every boat) an order from the player: Start, Stop, Evade or TargetPoint towards the given point.
+    // As a network client the order is sent to the server
+    void OrderBoat(EntityID boat, MessageType type, const Vector3& point = {});
 
     bool AreBoatsActive();
 
@@ -84,52 +391,310 @@ private:
     // Private Data
     //--------------------------------------------------------------------------------------
 private:
+    bool mHeadless = false; // Simulated only, see constructor
+
     // Cameras
     std::unique_ptr<Camera> mCamera; // User-controlled camera
-    std::vector<std::unique_ptr<Camera>> mChaseCameras; // Chase cameras for each boat
-    int mActiveCameraIndex = -1; // -1 indicates the main camera is active
+    ChaseCameras mChaseCameras;       // Chase cameras of the boats being watched, see UpdateChaseCameras
+    EntityID mActiveChaseBoat = NO_ID; // Boat whose chase camera is being viewed, NO_ID for the main camera
+    uint64_t mChaseBoatListVersion = 0; // EntityManager::GetBoatListVersion when cameras of boats that have gone were last released
+
+    // Picture-in-picture views of the chase cameras of the boats after the one being viewed (or the first boats when viewing
+    // from the main camera), chosen by UpdateChaseCameras. Each view is mPipSize of the scene's width and height
+    static constexpr int MAX_PIP_VIEWS = 4;
+    int   mPipViews = 0;
+    float mPipSize  = 0.25f;
+    std::vector<EntityID> mPipBoats;
+    int   mRenderView = -1; // Picture-in-picture view being rendered, -1 for the main view
 
     std::vector<BoatTemplate*> boatTemplates;
-    std::vector<Boat*> allBoats;
-    std::vector<EntityID> allBoatIDS;
-    std::vector<ReloadStation*> reloadStations;
-    std::vector<RandomCrate*> existingCrates;
-    std::vector<SeaMine*> existingMines;
+
+    // Boat data for the current frame
+    WorldSnapshot mWorld;
+
+    // Picks which boats' behaviour runs each step, less often for distant boats, see AIScheduler.h
+    AIScheduler mAIScheduler;
+
+    // Spawns the random crates and mines within the level's limits and budgets, see SpawnDirector.h
+    SpawnDirector mSpawnDirector;
+
+    // Cells of the level's scenery and obstacles streamed in around the boats and camera, nullptr if the level isn't partitioned.
+    // Updated every WorldPartition::UPDATE_INTERVAL of game time
+    std::unique_ptr<WorldPartition> mWorldPartition;
+    float mStreamTimer = 0;
 
     // Entities in the demo scene
     EntityID mLight = {};
 
     // Additional light information
     ColourRGB mAmbientColour = { 0, 0, 0 };
-    ColourRGB colour = ColourRGB(0xffffff);
-
-    ID3D11ShaderResourceView* mEnvironmentMap = {};
 
-    // Lock FPS to monitor refresh rate, which will set it to 60/120/144/240fps
-    bool mLockFPS = true;
+    // The environment map prefiltered for the PBR shaders' image-based lighting, nullptr if it couldn't be, see EnvironmentLighting.h
+    std::unique_ptr<EnvironmentLighting> mEnvironmentLighting;
+
+    // Frame pacing. Vsync locks FPS to monitor refresh rate, which will set it to 60/120/144/240fps. Low latency waits for the
+    // swap chain before each frame so input is never more than a frame old when shown. The frame rate cap is separate from
+    // vsync and sleeps rather than spinning, see FrameLimiter.h
+    bool mVSync      = true;
+    bool mLowLatency = true;
+
+    // Power saving, see CheckHidden. Serving a network game, a hidden update rate of 0 also stops the clients' games
+    bool  mPowerSaving       = true;
+    bool  mHideWhenUnfocused = false;
+    float mHiddenUpdateRate  = 15;
+    bool  mHidden            = false;
+    std::unique_ptr<FrameLimiter> mFrameLimiter;
     bool mGamePaused = false;
-    float mRandomCrateTimer = Random(3.0f, 6.0f);
-    float mRandomMineTimer = Random(5.0f, 8.0f);
+
+    // Fixed step simulation, see Update. Frames longer than MAX_STEPS_PER_FRAME steps are cut short so a slow frame doesn't
+    // lead to even slower frames catching up. mStepBlend is how far the frame is from the previous step to the latest (0 to 1)
+    static constexpr float SIMULATION_STEP     = 1.0f / 60;
+    static constexpr int   MAX_STEPS_PER_FRAME = 5;
+    bool  mFixedStep       = true;
+    float mStepAccumulator = 0.0f; // Time passed that hasn't been simulated yet, less than a step
+    float mStepBlend       = 1.0f;
+
+    // Pipelined fixed step simulation, see Update. A frame's steps are run on a worker while the frame is presented and the
+    // next one is paced, and Update waits for them before going on, so the rendered frame is one frame behind the simulation.
+    // While a frame is drawn nothing else is changing the entities, so rendering reads them as usual. The steps use the main
+    // thread's random stream, handed over in mPipelineRandom, so the game is the same as without pipelining. Only the present
+    // and pacing overlap the steps, so this is a present-overlap mode that costs a frame of latency, labelled as such in the UI
+    bool         mPipelined         = false;
+    bool         mSimulationRunning = false;
+    JobCounter   mSimulationJob;
+    int          mPipelinedSteps    = 0;    // Counted by Update, run by StartPipelinedSteps
+    float        mPipelinedBlend    = 1.0f; // Becomes mStepBlend once those steps have run
+    RandomStream mPipelineRandom;
+    std::string  mPipelineStatus;
+
+    // Checkpoint save or load requested from the control panel, done at the start of the next Update. The save being written
+    // in the background, and the result of the last save or load for display
+    static constexpr const char* CHECKPOINT_FILE = "Checkpoint.bin";
+    bool mSaveCheckpointNext = false;
+    bool mLoadCheckpointNext = false;
+    std::future<bool> mCheckpointWrite;
+    std::string       mCheckpointFileName;
+    std::string       mCheckpointStatus;
+
+    // Hot reload of the level file. While on, the file is checked for edits every LEVEL_RELOAD_INTERVAL seconds and the
+    // changes applied to the running game, see CheckLevelReload. The level as last loaded, and the result of the last reload
+    static constexpr float LEVEL_RELOAD_INTERVAL = 0.5f;
+    std::string                  mLevelFile;
+    std::unique_ptr<LoadedLevel> mLoadedLevel;
+    bool                         mLevelReload      = true;
+    float                        mLevelReloadTimer = 0;
+    std::string                  mLevelReloadStatus;
+
+    // Replay recording and playback, see Replay.h. While a replay plays the game is held in mReplayReturn to go back to
+    // afterwards, and the replay plays at mReplaySpeed times game speed
+    static constexpr const char* REPLAY_FILE = "Replay.bin";
+    std::unique_ptr<ReplayRecorder> mReplayRecorder;
+    std::unique_ptr<ReplayPlayer>   mReplay;
+    std::unique_ptr<Checkpoint>     mReplayReturn;
+    bool        mStartReplayNext = false;
+    bool        mStopReplayNext  = false;
+    float       mReplaySpeed     = 1.0f;
+    std::string mReplayStatus;
+
+    // Gameplay analytics being recorded, see GameAnalytics.h
+    static constexpr const char* ANALYTICS_FILE = "Analytics.bin";
+    std::unique_ptr<GameAnalytics> mAnalytics;
+
+    // Match video being recorded from the control panel, see FrameCapture.h
+    static constexpr const char* VIDEO_FILE = "Match.mp4";
+    std::string mVideoStatus;
+
+    // Live metrics being exported, see StartMetrics, and the indices of the metrics the scene sets
+    std::unique_ptr<MetricsExporter> mMetrics;
+    struct MetricIDs
+    {
+        int steps, messages;
+        int entities, boats, missiles, crates, mines, obstacles, stations;
+        int videoMemory, videoBudget;
+    };
+    MetricIDs mMetricIDs = {};
+
+    // Networked play, see Network.h. This scene is either serving its game or showing a server's, in which case its own game
+    // is held in mNetReturn to go back to afterwards
+    std::unique_ptr<NetServer>  mNetServer;
+    std::unique_ptr<NetClient>  mNetClient;
+    std::unique_ptr<Checkpoint> mNetReturn;
+    bool        mStopNetClientNext = false;
+    char        mNetHost[64] = "localhost"; // Edited in the control panel
+    std::string mNetStatus;
+
+    // Fly-through benchmark being run, see SetFlyThrough. The CPU time of each frame is from the start of Update to just
+    // before the frame is presented
+    FlyThrough* mFlyThrough = nullptr;
+    std::chrono::steady_clock::time_point mFrameStart;
+
+    // Capture of the last few seconds of profiling for offline analysis, see TraceCapture.h. Turning it on enables the CPU
+    // profiler. Saved to TRACE_FILE with a number added when F11 is hit or a frame takes longer than the budget (0 - never),
+    // though a frame over budget only saves once the capture has at least a second of frames, so one slow patch saves once
+    static constexpr const char* TRACE_FILE = "Trace";
+    TraceCapture      mTraceCapture;
+    bool              mTraceCapturing = false;
+    float             mTraceBudget    = 0.0f; // Milliseconds
+    int               mTracesSaved    = 0;
+    std::future<bool> mTraceWrite;
+    std::string       mTraceFileName;
+    std::string       mTraceStatus;
+
+    // Watchdog for frames much slower than the ones before them, see FrameWatchdog.h. Turning it on turns on the trace capture
+    // and the allocation and message stats. Each spike is saved as SPIKE_FILE with its number: the trace (.json), a checkpoint of
+    // the world just after the frame (.bin) and the message stats (.csv). With freezing on, the CPU profiler, allocation tracker
+    // and message stats are then frozen on the spike for a look in the control panel, and no more spikes are looked for until
+    // they are resumed
+    static constexpr const char* SPIKE_FILE = "Spike";
+    FrameWatchdog mFrameWatchdog;
+    bool          mWatchdogEnabled = false;
+    bool          mFreezeOnSpike   = true;
+    bool          mSpikeFrozen     = false;
+    std::string   mSpikeStatus;
+
+    // Large levels for scaling tests, made from the Configuration panel (or with -genlevel on the command line) and played
+    // with "-level Generated.xml". The levels' templates come from Entities.xml
+    static constexpr const char* GENERATED_LEVEL_FILE = "Generated.xml";
+    LevelGeneratorSettings mGeneratorSettings;
+    std::future<bool>      mGeneratorWrite;
+    std::string            mGeneratorError; // Set by the background write
+    std::string            mGeneratorStatus;
 
     // DirectXTK SpriteFont text drawing variables
-    std::unique_ptr<DirectX::DX11::SpriteBatch> mSpriteBatch;
+    // Skips drawing moving entities hidden behind the static scenery, see OcclusionCuller.h
+    std::unique_ptr<OcclusionCuller> mOcclusionCuller;
+
+    // Frustum culls instanced entities with a compute shader, nullptr if compute shaders aren't supported, see GpuCuller.h
+    std::unique_ptr<GpuCuller> mGpuCuller;
+
+    // Draws distant islands and boats as single quads from baked views of their meshes, nullptr if it couldn't be created
+    std::unique_ptr<ImpostorRenderer> mImpostorRenderer;
+
+    // Missile trails, explosions and mine blasts simulated and drawn on the GPU, nullptr if compute shaders aren't supported
+    std::unique_ptr<ParticleSystem> mParticleSystem;
+
+    // The sea tessellated around each camera, nullptr if the device can't tessellate. The water meshes of the level, drawn
+    // instead when there is no water renderer or it is turned off
+    std::unique_ptr<WaterRenderer> mWaterRenderer;
+    std::vector<EntityID>          mWaterEntities;
+
+    // Many small point lights binned into clusters of each view for the pixel shaders, nullptr if they couldn't be created
+    std::unique_ptr<ClusteredLights> mClusteredLights;
+
+    // Shadows of the main light, the static scenery's kept from frame to frame, nullptr if the maps couldn't be created
+    std::unique_ptr<ShadowMap> mShadowMap;
+
+    // Draws each combination of shaders, input layout and states the templates use once at load, nullptr if it couldn't be
+    // created. mPrewarmedTemplates is the number of templates there were when it last ran
+    std::unique_ptr<ShaderPrewarm> mShaderPrewarm;
+    size_t                         mPrewarmedTemplates = 0;
+
+    // Missiles simulated and hit tested by compute shaders for mass battles, used instead of Missile entities when enabled.
+    // nullptr until first enabled, and for good if they can't be created. The boats they can hit are gathered into
+    // mMissileTargets each frame
+    std::unique_ptr<GpuMissiles>     mGpuMissiles;
+    std::vector<GpuMissiles::Target> mMissileTargets;
+    bool                             mGpuMissilesUnsupported = false;
+
+    // Missiles are created for every shot, so their template is kept rather than looked up each time
+    TemplateHandle mMissileTemplate{ Atom("Missile") };
+
+    // Alternative to mPicker that picks the boat exactly under the cursor by rendering boat IDs, see IdBufferPicker.h
+    std::unique_ptr<IdBufferPicker> mIdPicker;
+    bool mGpuPicking = false;
+
+    // Orders, culls and gives targets to the passes of each frame, see Render and RenderGraph.h
+    std::unique_ptr<RenderGraph> mRenderGraph;
+
+    // Reduces the resolution of the 3D scene to keep the GPU frame time within a budget, see DynamicResolution.h
+    std::unique_ptr<DynamicResolution> mDynamicResolution;
+
+    // Draws the additive pass of the main view at half resolution, nullptr if it couldn't be created, see HalfResEffects.h
+    std::unique_ptr<HalfResEffects> mHalfResEffects;
+
+    // Draws the additive group with order-independent transparency, nullptr if it couldn't be created, see WeightedOit.h
+    std::unique_ptr<WeightedOit> mWeightedOit;
+
+    // Keeps GPU memory use within the budget the OS allows, by the texture budget and LOD scale, see MemoryBudget.h
+    MemoryBudget mMemoryBudget;
+
+    // Render the static solid entities' depth first, then their colour with an equal depth test so the expensive pixel shaders
+    // (parallax PBR) only run once per pixel, see RenderFromCamera. The GPU time of each part is shown in the control panel
+    bool mDepthPrePass = false;
+
+    // Show how many times each pixel is shaded instead of the scene, see RenderFromCamera. The shader is loaded when first shown
+    bool               mShowOverdraw   = false;
+    ID3D11PixelShader* mOverdrawShader = nullptr;
+
     std::unique_ptr<DirectX::DX11::SpriteFont>  mSmallFont;
     std::unique_ptr<DirectX::DX11::SpriteFont>  mMediumFont;
 
+    // Draws the text labels in the small font, keeping their layouts from frame to frame
+    std::unique_ptr<LabelRenderer> mLabelRenderer;
+    std::unique_ptr<FloatingTextRenderer> mFloatingTextRenderer;
+
     bool mShowExtendedBoatUI = false;
 
+    // Text label drawn above each boat. Only rebuilt when marked dirty (see MarkChangedBoatLabels), when switching between the
+    // normal and extended UI, or for the extended label when the speed shown changes
+    struct BoatLabel
+    {
+        std::string text;
+        bool dirty    = true;
+        bool extended = false;    // Text is for the extended UI
+        int  speedHundredths = 0; // Speed shown in the extended text
+        int  thinkRate       = 0; // AI thinks per second shown in the extended text
+    };
+    std::unordered_map<EntityID, BoatLabel> mBoatLabels;
+
+    // Text labels waiting to be drawn, see AddWorldLabel. The points are kept separately from the text so they can be projected
+    // in one pass into mLabelPixels. All are cleared rather than recreated each frame to keep their capacity
+    struct WorldLabel
+    {
+        uint64_t key;
+        const std::string* text;
+        ColourRGB colour;
+    };
+    std::vector<WorldLabel> mLabels;
+    PointsSoA mLabelPoints;
+    PointsSoA mLabelPixels;
+
     // Variables for camera picking
     Boat* mNearestEntity = nullptr;    // The entity closest to the mouse cursor
     Boat* mSelectedBoat = nullptr;     // The currently selected boat
+
+    // Screen positions of the boats for finding mNearestEntity, and what they were calculated from (see HandleMousePicking)
+    ScreenPicker mPicker;
+    Camera*      mPickerCamera = nullptr;
+    Matrix4x4    mPickerViewProjection = Matrix4x4::Identity;
+    uint32_t     mPickerWorldVersion = 0;
+    Vector2i     mPickerMouse = { -1, -1 };
+    bool         mPickerValid = false;
     Boat* mSelectedUIBoat = nullptr;     // The currently selected boat
     float PickDist = 100.0f;             // Distance to place the boat when moving
 
-    const float mChaseDistance = 40.0f;
-    const float mChaseHeight = 20.0f;
-    const float mChasePitch = ToRadians(15.0f);
-
-    const unsigned int mMaxCrates = 8;
-    const unsigned int mMaxMines = 10;
+    // The boats in the control panel's dropdown, kept from frame to frame and rebuilt only when the entity manager's boat list
+    // version changes (boats created, destroyed or renamed), which is also the only time the selected boat is checked again.
+    // The names point at the boats' own strings, which stay put until the version changes
+    struct BoatListModel
+    {
+        uint64_t                 version = UINT64_MAX;
+        std::vector<EntityID>    ids;
+        std::vector<const char*> names;
+        int                      selected = -1;    // Index in the list of mSelectedUIBoat, -1 if none
+        EntityID                 selectedID = NO_ID;
+    };
+    BoatListModel mBoatList;
+
+    // Update the boat list model if boats have come or gone since it was built, dropping the selection if its boat has gone
+    void RefreshBoatList();
+
+    // The control panel is built at most this many times a second, 0 for every frame. It is redrawn from the last frame it was
+    // built in between. While collapsed it is built at PANEL_COLLAPSED_RATE, enough to notice a click on its title bar
+    static constexpr float PANEL_COLLAPSED_RATE = 10.0f;
+    float mPanelRate = 0;
+    bool  mPanelCollapsed = true; // It starts collapsed, see DrawGUI
+    std::chrono::steady_clock::time_point mLastPanelBuild;
 
 public:
     void SetPauseState(bool pause) { mGamePaused = pause; }
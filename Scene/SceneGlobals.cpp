@@ -8,6 +8,8 @@
 // The gMessenger object is global so any entity class can send messages to other entities
 //
 // The gScene object is global so entity classes can access overall game data - in this case the Scene object maintains the overall list of cars in the game
+//
+// The gJobSystem object holds the worker threads used to run work in parallel, e.g. updating entities in the EntityManager
 // 
 // It would be possible to deal with these as "singleton" classes. These are classes that only ever have a single object.
 // It might make the code a tiny bit cleaner the benefit is marginal - singletons have the same downsides as globals
@@ -26,3 +28,6 @@ std::unique_ptr <Messenger> gMessenger;
 
 // Overall game scene
 std::unique_ptr<Scene> gScene;
+
+// Worker threads for parallel work
+std::unique_ptr<JobSystem> gJobSystem;
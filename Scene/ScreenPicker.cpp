@@ -0,0 +1,91 @@
+//--------------------------------------------------------------------------------------
+// Screen space picking - finding which of a set of world points is nearest to a pixel
+//--------------------------------------------------------------------------------------
+
+#include "ScreenPicker.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Project the given world points to pixels as seen from the camera and build the grid
+void ScreenPicker::Build(const std::vector<Vector3>& points, Camera& camera, float viewportWidth, float viewportHeight)
+{
+	mCellsX = static_cast<int>(std::ceil(viewportWidth  / CELL_SIZE)) + 2;
+	mCellsY = static_cast<int>(std::ceil(viewportHeight / CELL_SIZE)) + 2;
+
+	// Project all the points together with the same matrix. Clip space w is the distance in front of the camera, so points nearer
+	// than the near clip are behind the camera or too close to be seen (the same test as Camera::PixelFromWorldPt)
+	mProjected.Clear();
+	for (auto& point : points)  mProjected.Add(point);
+	camera.PixelsFromWorldPts(mProjected, viewportWidth, viewportHeight, mProjected);
+
+	float nearClip = camera.GetNearClip();
+	mPixels.resize(points.size());
+	mPointCells.resize(points.size());
+	mCellStart.assign(mCellsX * mCellsY + 1, 0);
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		mPointCells[i] = -1;
+		if (mProjected.z[i] < nearClip)  continue;
+
+		Vector2 pixel = { mProjected.x[i], mProjected.y[i] };
+		int cellX = static_cast<int>(std::floor(pixel.x / CELL_SIZE)) + 1;
+		int cellY = static_cast<int>(std::floor(pixel.y / CELL_SIZE)) + 1;
+		if (cellX < 0 || cellX >= mCellsX || cellY < 0 || cellY >= mCellsY)  continue;
+
+		mPixels[i] = pixel;
+		mPointCells[i] = cellY * mCellsX + cellX;
+		++mCellStart[mPointCells[i] + 1];
+	}
+
+	// Turn the counts into start positions, then place the points. The start of each cell is used as its write position while
+	// placing, which leaves it at the start of the next cell, so they are shifted back afterwards. Going through the points in
+	// order keeps each cell's points in index order
+	for (size_t cell = 1; cell < mCellStart.size(); ++cell)  mCellStart[cell] += mCellStart[cell - 1];
+	mCellPoints.resize(mCellStart.back());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		if (mPointCells[i] >= 0)  mCellPoints[mCellStart[mPointCells[i]]++] = static_cast<uint32_t>(i);
+	}
+	for (size_t cell = mCellStart.size() - 1; cell > 0; --cell)  mCellStart[cell] = mCellStart[cell - 1];
+	mCellStart[0] = 0;
+}
+
+
+// Return the index of the point nearest to the given pixel within maxDistance pixels, or -1 if there is none
+int ScreenPicker::FindNearest(const Vector2& pixel, float maxDistance) const
+{
+	if (mCellsX == 0)  return -1;
+
+	int minCellX = std::max(static_cast<int>(std::floor((pixel.x - maxDistance) / CELL_SIZE)) + 1, 0);
+	int maxCellX = std::min(static_cast<int>(std::floor((pixel.x + maxDistance) / CELL_SIZE)) + 1, mCellsX - 1);
+	int minCellY = std::max(static_cast<int>(std::floor((pixel.y - maxDistance) / CELL_SIZE)) + 1, 0);
+	int maxCellY = std::min(static_cast<int>(std::floor((pixel.y + maxDistance) / CELL_SIZE)) + 1, mCellsY - 1);
+
+	int   nearest = -1;
+	float nearestDistanceSquared = maxDistance * maxDistance;
+	for (int cellY = minCellY; cellY <= maxCellY; ++cellY)
+	{
+		for (int cellX = minCellX; cellX <= maxCellX; ++cellX)
+		{
+			int cell = cellY * mCellsX + cellX;
+			for (uint32_t p = mCellStart[cell]; p < mCellStart[cell + 1]; ++p)
+			{
+				uint32_t i = mCellPoints[p];
+				Vector2 offset = mPixels[i] - pixel;
+				float distanceSquared = offset.x * offset.x + offset.y * offset.y;
+				if (distanceSquared < nearestDistanceSquared || (distanceSquared == nearestDistanceSquared && static_cast<int>(i) < nearest))
+				{
+					nearest = static_cast<int>(i);
+					nearestDistanceSquared = distanceSquared;
+				}
+			}
+		}
+	}
+	return nearest;
+}
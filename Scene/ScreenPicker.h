@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------
+// Screen space picking - finding which of a set of world points is nearest to a pixel
+//--------------------------------------------------------------------------------------
+// The points are projected to pixel positions together in one pass (Camera::PixelsFromWorldPts) rather than with a camera
+// function call per point, and placed in a coarse grid of screen cells. Finding the point nearest the mouse then only looks
+// at the few cells around it. The picker is rebuilt only when the points or the camera change, and can be queried any
+// number of times in between, e.g. whenever the mouse moves.
+//
+//   picker.Build(mWorld.positions, *activeCamera, viewportWidth, viewportHeight);
+//   int nearest = picker.FindNearest(mousePixel, 50.0f); // Index into the positions, or -1
+
+#ifndef _SCREEN_PICKER_H_INCLUDED_
+#define _SCREEN_PICKER_H_INCLUDED_
+
+#include "Camera.h"
+#include "Vector2.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class ScreenPicker
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Project the given world points to pixels as seen from the camera, with the given viewport size, and build the grid. Points
+	// behind the camera's near clip plane or well off screen can't be picked
+	void Build(const std::vector<Vector3>& points, Camera& camera, float viewportWidth, float viewportHeight);
+
+	// Return the index of the point nearest to the given pixel, as long as it is within maxDistance pixels. Returns -1 if there
+	// is no such point. If several points are the same distance away the lowest index is returned
+	int FindNearest(const Vector2& pixel, float maxDistance) const;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Size of the square grid cells in pixels. Queries look at the cells overlapping the search circle, so this should be
+	// about the usual pick distance
+	static constexpr float CELL_SIZE = 64.0f;
+
+	// The grid covers the viewport and one cell beyond each edge, so points just off screen can still be picked from the edge
+	int mCellsX = 0;
+	int mCellsY = 0;
+
+	// The points while building, projected to pixels in place
+	PointsSoA mProjected;
+
+	// Pixel position of each point, only valid for points in the grid
+	std::vector<Vector2> mPixels;
+
+	// Points in each cell, stored together: the points in cell c are mCellPoints[mCellStart[c]] to mCellPoints[mCellStart[c + 1] - 1],
+	// in index order. Cells are numbered row by row
+	std::vector<uint32_t> mCellStart;
+	std::vector<uint32_t> mCellPoints;
+
+	// Cell of each point while building, or -1 if the point is not in the grid
+	std::vector<int> mPointCells;
+};
+
+
+#endif //_SCREEN_PICKER_H_INCLUDED_
@@ -7,6 +7,39 @@
 #include <vector>
 #include <cmath>
 
+SeaMine::SeaMine(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform)
+    : Entity(entityTemplate, id, transform), mLocal(TRSFromMatrix(transform))
+{
+    // The mine explodes on the nearest boat within the explosion radius, which destroys the mine
+    TriggerVolume trigger;
+    trigger.radius       = mExplosionRadius;
+    trigger.targetMask   = SPATIAL_BOAT;
+    trigger.enterMessage = MessageType::MineHit;
+    trigger.oneShot      = true;
+    gEntityManager->Triggers().Add(this, trigger);
+
+    // Bob up and down once risen to the surface
+    StartBobbing(mRiseDuration);
+}
+
+// Carry on from a saved state, bobbing from the same point in the motion
+void SeaMine::RestoreState(const SavedState& saved)
+{
+    mRiseTimer = saved.riseTimer;
+    mLocal = saved.local;
+    StartBobbing(mRiseDuration - mRiseTimer);
+}
+
+// Start bobbing on the water after the given delay, a negative delay starts part way through the motion
+void SeaMine::StartBobbing(float delay)
+{
+    BobbingMotion bobbing;
+    bobbing.baseY     = mBaseY;
+    bobbing.amplitude = 0.7f;
+    bobbing.delay     = delay;
+    gEntityManager->Bobbing().Add(this, bobbing);
+}
+
 bool SeaMine::Update(float frameTime)
 {
     // Handle rising phase
@@ -16,36 +49,14 @@ bool SeaMine::Update(float frameTime)
         float progress = mRiseTimer / mRiseDuration;
         progress = std::min(progress, 1.0f); // Clamp to 1.0
 
-        Vector3 minePos = Transform().Position();
-        minePos.y = mStartY + (mBaseY - mStartY) * progress;
-        Transform().Position() = minePos;
-    }
-    else // Start oscillating after rising
-    {
-        mOscillationTime += frameTime;
-        Vector3 minePos = Transform().Position();
-        minePos.y = mBaseY + 0.7f * std::sin(mOscillationTime);
-        Transform().Position() = minePos;
+        mLocal.position.y = mStartY + (mBaseY - mStartY) * progress;
     }
+    // After rising the height is set by the bobbing motion added in the constructor
 
     // Rotate continuously
-    Transform().RotateLocalY(0.35f * frameTime);
-
-    // Check for nearby boats
-    std::vector<Boat*> boats = gEntityManager->GetAllBoatEntities();
-    Vector3 minePos = Transform().Position();
-
-    for (Boat* boatPtr : boats)
-    {
-        Vector3 diff = boatPtr->Transform().Position() - minePos;
-        float distanceSq = diff.x * diff.x + diff.y * diff.y + diff.z * diff.z;
-
-        if (distanceSq <= (mExplosionRadius * mExplosionRadius))
-        {
-            gMessenger->DeliverMessage(GetID(), boatPtr->GetID(), MessageType::MineHit);
-            return false; // Destroy the mine
-        }
-    }
+    mLocal.RotateLocalY(0.35f * frameTime);
+    Transform() = mLocal.ToMatrix();
 
+    // Nearby boats are detected by the mine's trigger volume, which also destroys the mine
     return true; // Keep the mine alive
 }
\ No newline at end of file
@@ -2,25 +2,41 @@
 #define _SEAMINE_H_INCLUDED_
 
 #include "Entity.h" 
+#include "EntityPool.h"
 #include "EntityTypes.h"
 #include "Vector3.h"
 #include "Matrix4x4.h"
+#include "TRS.h"
 #include <string>
 
-class SeaMine : public Entity
+class SeaMine : public Entity, public PooledEntity<SeaMine>, public TaggedType<SeaMine, TypeTag::SeaMine>
 {
 public:
     // Constructor: Pass in the entity template, unique ID, initial transform, and optional name.
-    SeaMine(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform)
-        : Entity(entityTemplate, id, transform)
-    {}
+    // The mine is given a one-shot trigger volume that sends MineHit to the first boat to come within the explosion radius
+    SeaMine(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform);
 
 public:
     // Update is called every frame. Returns false when the mine should be destroyed.
     virtual bool Update(float frameTime) override;
 
+    // Mines only move themselves (boats are detected by the trigger volume), so can be updated on worker threads
+    virtual bool CanUpdateInParallel() override { return true; }
+
+    // Everything about the mine except its template, ID and matrix, as plain data for a checkpoint (see Checkpoint.h). The
+    // bobbing motion continues from the saved time
+    struct SavedState
+    {
+        float riseTimer;
+        TRS   local;
+    };
+    SavedState SaveState() { return { mRiseTimer, mLocal }; }
+    void RestoreState(const SavedState& saved);
+
 private:
-    float mOscillationTime = 0.0f;
+    // Start bobbing on the water after the given delay
+    void StartBobbing(float delay);
+
     float mBaseY = -11.5f; // Target surface level
     float mExplosionRadius = 15.0f;
 
@@ -28,6 +44,9 @@ private:
     float mRiseTimer = 0.0f;
     float mRiseDuration = 2.0f; // Time to rise (seconds)
     float mStartY = -20.0f; // Initial depth
+
+    // Position, spin and scale, the matrix is rebuilt from these each update rather than being rotated a little each frame
+    TRS mLocal;
 };
 
 #endif // _SEAMINE_H_INCLUDED_
@@ -0,0 +1,140 @@
+//--------------------------------------------------------------------------------------
+// Sensor system - what each boat can see, refreshed a few times a second rather than every update
+//--------------------------------------------------------------------------------------
+
+#include "SensorSystem.h"
+#include "EntityManager.h"
+#include "Boat.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Refresh the visible enemies of the patrolling boats due to look. Called by the EntityManager at the start of UpdateAll
+void SensorSystem::Update(EntityManager& entities, float frameTime)
+{
+	mTime += frameTime;
+	mTestsDone   = 0;
+	mTestsCached = 0;
+
+	// A boat that has just started patrolling looks straight away, this marks it
+	constexpr float LOOK_NOW = -1e30f;
+
+	float interval = 1.0f / mRefreshRate;
+	for (Boat* boat : entities.View<Boat>())
+	{
+		uint32_t index = EntityIndex(boat->GetID());
+		if (index >= mSensors.size())  mSensors.resize(index + 1);
+		BoatSensor& sensor = mSensors[index];
+		if (sensor.owner != boat->GetID() || boat->GetState() != Boat::State::Patrol)
+		{
+			sensor.owner = boat->GetID();
+			sensor.timer = LOOK_NOW;
+			sensor.visible.clear();
+			if (boat->GetState() != Boat::State::Patrol)  continue;
+		}
+
+		sensor.timer -= frameTime;
+		if (sensor.timer > 0.0f)  continue;
+		Refresh(entities, boat, sensor);
+
+		// After its first look, each boat is given its own point in the interval to look at, so boats that started
+		// patrolling together don't all look in the same update from then on
+		if (sensor.timer < -interval)
+		{
+			float stagger = std::fmod(index * 0.618034f, 1.0f);
+			sensor.timer = interval * stagger;
+		}
+		else
+		{
+			sensor.timer += interval;
+		}
+	}
+
+	// Forget pairs that haven't been looked at for a while (e.g. one boat has been destroyed or they have moved apart)
+	if (mTime >= mNextPrune)
+	{
+		std::erase_if(mLineOfSight, [this](const auto& pair) { return pair.second.lastUsed < mTime - 2.0f; });
+		mNextPrune = mTime + 1.0f;
+	}
+}
+
+
+// The enemies the given boat could see when it last looked, nearest first. Empty if it isn't patrolling
+const std::vector<EntityID>& SensorSystem::VisibleEnemies(Boat* boat) const
+{
+	static const std::vector<EntityID> NONE;
+	uint32_t index = EntityIndex(boat->GetID());
+	if (index >= mSensors.size() || mSensors[index].owner != boat->GetID())  return NONE;
+	return mSensors[index].visible;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Look for the enemies the given boat can see
+void SensorSystem::Refresh(EntityManager& entities, Boat* boat, BoatSensor& sensor)
+{
+	Vector3 forward = boat->Transform().ZAxis();
+	forward.y = 0.0f;
+	forward = Normalise(forward);
+	Vector3 boatPos = boat->Transform().Position();
+
+	// The cone test compares the dot product with the cosine of the cone angle rather than finding the angle
+	const float cosCone = std::cos(CONE_ANGLE);
+
+	mSightings.clear();
+	entities.Spatial().QueryRadius(boatPos, SENSOR_RANGE, SPATIAL_BOAT, [&](Entity* entity)
+	{
+		Boat* enemy = static_cast<Boat*>(entity);
+		if (enemy == boat || enemy->GetTeam() == boat->GetTeam() || enemy->IsDestroyed())  return;
+
+		Vector3 enemyPos = enemy->Transform().Position();
+		Vector3 toEnemy = enemyPos - boatPos;
+		float distance = toEnemy.Length();
+		if (distance < 0.0001f || Dot(forward, toEnemy) < cosCone * distance)  return;
+
+		if (HasLineOfSight(entities, boat, boatPos, enemy, enemyPos))  mSightings.push_back({ enemy->GetID(), distance });
+	});
+
+	std::sort(mSightings.begin(), mSightings.end(), [](const Sighting& a, const Sighting& b) { return a.distance < b.distance; });
+	sensor.visible.clear();
+	for (const Sighting& sighting : mSightings)  sensor.visible.push_back(sighting.enemy);
+}
+
+
+// Whether the two boats can see each other, from the cache if neither has moved far since it was last tested
+bool SensorSystem::HasLineOfSight(EntityManager& entities, Boat* a, const Vector3& aPos, Boat* b, const Vector3& bPos)
+{
+	bool aLower = a->GetID() < b->GetID();
+	const Vector3& lowerPos  = aLower ? aPos : bPos;
+	const Vector3& higherPos = aLower ? bPos : aPos;
+	uint64_t key = aLower ? (static_cast<uint64_t>(a->GetID()) << 32) | b->GetID()
+	                      : (static_cast<uint64_t>(b->GetID()) << 32) | a->GetID();
+
+	constexpr float TOLERANCE_SQUARED = LINE_OF_SIGHT_TOLERANCE * LINE_OF_SIGHT_TOLERANCE;
+	auto cached = mLineOfSight.find(key);
+	if (cached != mLineOfSight.end())
+	{
+		LineOfSight& lineOfSight = cached->second;
+		Vector3 lowerMoved = lowerPos - lineOfSight.lowerPos;
+		Vector3 higherMoved = higherPos - lineOfSight.higherPos;
+		if (Dot(lowerMoved, lowerMoved) <= TOLERANCE_SQUARED && Dot(higherMoved, higherMoved) <= TOLERANCE_SQUARED)
+		{
+			lineOfSight.lastUsed = mTime;
+			++mTestsCached;
+			return lineOfSight.visible;
+		}
+	}
+
+	++mTestsDone;
+	bool visible = !entities.ObstacleTree().IsSegmentBlocked(aPos, bPos);
+	mLineOfSight[key] = { lowerPos, higherPos, mTime, visible };
+	return visible;
+}
@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// Sensor system - what each boat can see, refreshed a few times a second rather than every update
+//--------------------------------------------------------------------------------------
+// A patrolling boat looks for enemies within SENSOR_RANGE in a cone of CONE_ANGLE either side of its heading that aren't
+// hidden behind an obstacle. Rather than every boat doing that in every update (see Boat::CheckForEnemy), the EntityManager
+// has this system refresh each patrolling boat's list of visible enemies at the refresh rate, and the boat reads the list.
+// Refreshes are staggered so only a share of the boats look in any update, spreading the cost evenly.
+//
+// Line of sight tests are the most expensive part, so their results are cached for each pair of boats and only tested again
+// once either boat has moved more than LINE_OF_SIGHT_TOLERANCE since. Boats patrol slowly, so most tests come from the cache.
+// The cache is cleared when the obstacles change, and pairs that haven't been looked at for a while are forgotten
+
+#ifndef _SENSOR_SYSTEM_H_INCLUDED_
+#define _SENSOR_SYSTEM_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "Vector3.h"
+#include "MathHelpers.h"
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class EntityManager;
+class Boat;
+
+class SensorSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	static constexpr float SENSOR_RANGE = 140.0f;
+	static constexpr float CONE_ANGLE   = ToRadians(70.0f);
+
+	// How far either boat of a pair can move before their line of sight is tested again
+	static constexpr float LINE_OF_SIGHT_TOLERANCE = 5.0f;
+
+	// Times a second each patrolling boat's visible enemies are refreshed
+	void  SetRefreshRate(float rate)  { mRefreshRate = rate < 1.0f ? 1.0f : rate; }
+	float GetRefreshRate()            { return mRefreshRate; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Refresh the visible enemies of the patrolling boats due to look. Called by the EntityManager at the start of UpdateAll
+	void Update(EntityManager& entities, float frameTime);
+
+	// The enemies the given boat could see when it last looked, nearest first. Empty if it isn't patrolling
+	const std::vector<EntityID>& VisibleEnemies(Boat* boat) const;
+
+	// Forget all cached lines of sight, called by the EntityManager when the obstacles change
+	void ClearLineOfSight()  { mLineOfSight.clear(); }
+
+	// Line of sight tests done and answered from the cache in the last update, for display
+	int TestsDone()    { return mTestsDone; }
+	int TestsCached()  { return mTestsCached; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A boat's visible enemies and the time until it looks again. Indexed by the boat's slot index (see EntityTypes.h), the ID
+	// shows whether the sensor belongs to the boat now in that slot
+	struct BoatSensor
+	{
+		EntityID owner = NO_ID;
+		float    timer = 0.0f;
+		std::vector<EntityID> visible;
+	};
+	std::vector<BoatSensor> mSensors;
+
+	// Look for the enemies the given boat can see
+	void Refresh(EntityManager& entities, Boat* boat, BoatSensor& sensor);
+
+	// Whether the two boats can see each other, from the cache if neither has moved far since it was last tested
+	bool HasLineOfSight(EntityManager& entities, Boat* a, const Vector3& aPos, Boat* b, const Vector3& bPos);
+
+	// Cached line of sight of a pair of boats, keyed by their IDs (lower first), with their positions when it was tested
+	struct LineOfSight
+	{
+		Vector3 lowerPos;
+		Vector3 higherPos;
+		float   lastUsed;
+		bool    visible;
+	};
+	std::unordered_map<uint64_t, LineOfSight> mLineOfSight;
+
+	// Working array for Refresh, kept to avoid reallocating it
+	struct Sighting
+	{
+		EntityID enemy;
+		float    distance;
+	};
+	std::vector<Sighting> mSightings;
+
+	float mRefreshRate  = 10.0f;
+	float mTime         = 0.0f; // Total update time, for ageing the cache
+	float mNextPrune    = 0.0f; // Time the cache will next be checked for old pairs
+	int   mTestsDone    = 0;
+	int   mTestsCached  = 0;
+};
+
+
+#endif //_SENSOR_SYSTEM_H_INCLUDED_
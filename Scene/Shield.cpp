@@ -2,42 +2,40 @@
 #include "SceneGlobals.h"
 #include "MathHelpers.h"
 
+Shield::Shield(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, EntityID parentBoatID)
+    : Entity(entityTemplate, id, transform),
+    mParentBoatID(parentBoatID), mElapsed(0.0f), mShieldDuration(7.0f)
+{
+    // The Messenger holds the message until the shield's time is up, so there is no countdown to do each frame
+    gMessenger->DeliverAt(mShieldDuration, GetID(), GetID(), MessageType::Die);
+    mLocal.position = { 0.0f, HEIGHT, 0.0f };
+}
+
 // Shield entity rotates around the Y-axis and pulsates in scale, to give a visual effect.
 bool Shield::Update(float frameTime)
 {
     mElapsed += frameTime;
 
-    // Retrieve the parent boat
-    Boat* parentBoat = gEntityManager->GetEntity<Boat>(mParentBoatID);
-    if (!parentBoat || parentBoat->GetState() == "Destroyed")
+    // Remove the shield when its time is up
+    for (const Message& message : gMessenger->ReceiveAll(GetID()))
     {
-        // Remove the shield if the parent boat is gone
-        return false;
+        if (message.type == MessageType::Die)
+        {
+            gMessenger->DeliverMessage(GetID(), mParentBoatID, MessageType::ShieldDestroyed);
+            return false;
+        }
     }
 
-    // Follow the boat's position
-    Vector3 boatPos = parentBoat->Transform().Position();
-    Vector3 shieldOffset(0.0f, 2.0f, 0.0f); // Slightly above the boat
-    Transform().Position() = boatPos + shieldOffset;
-
     // Rotate the shield
     float rotationSpeed = 15.0f;
-    Transform().RotateLocalY(ToRadians(rotationSpeed * frameTime));
+    mLocal.RotateLocalY(ToRadians(rotationSpeed * frameTime));
 
     // Make the shield pulse
     float pulseFrequency = 0.5f;
     float pulseAmplitude = 0.05f;
-    float scaleFactor = 1.0f + pulseAmplitude * std::sin(2.0f * std::numbers::pi_v<float> * pulseFrequency * mElapsed);
-    Transform().SetScale(scaleFactor);
-
-    // Decrement shield duration
-    mShieldDuration -= frameTime;
-    if (mShieldDuration <= 0.0f)
-    {
-        gMessenger->DeliverMessage(GetID(), mParentBoatID, MessageType::ShieldDestroyed);
-
-        return false;
-    }
+    float scaleFactor = 1.0f + pulseAmplitude * FastSin(2.0f * std::numbers::pi_v<float> * pulseFrequency * mElapsed);
+    mLocal.scale = { scaleFactor, scaleFactor, scaleFactor };
 
-    return true;
+    // The entity manager places the shield on the boat after all updates. A shield that isn't attached has lost its boat
+    return gEntityManager->SetLocalTransform(GetID(), mLocal.ToMatrix());
 }
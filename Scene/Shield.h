@@ -2,27 +2,55 @@
 #define _SHIELD_H_INCLUDED_
 
 #include "Entity.h"      // Base class for entities
+#include "EntityPool.h"  // For PooledEntity
 #include "EntityTypes.h" // For EntityID, etc.
 #include "Vector3.h"     // For Vector3 type
 #include "Matrix4x4.h"   // For Matrix4x4 type
+#include "TRS.h"         // For the shield's transform
 #include <string>
 
-class Shield : public Entity
+class Shield : public Entity, public PooledEntity<Shield>, public TaggedType<Shield, TypeTag::Shield>
 {
 public:
-    // Constructor: The entity template, unique ID, initial transform, duration of the shield, and optional name are passed in.
-    Shield(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, EntityID parentBoatID)
-        : Entity(entityTemplate, id, transform),
-        mParentBoatID(parentBoatID), mElapsed(0.0f), mShieldDuration(7.0f)
-    {}
+    // Height of the shield above its boat
+    static constexpr float HEIGHT = 2.0f;
+
+    // Constructor: The entity template, unique ID, initial transform and the ID of the boat it belongs to are passed in.
+    // Schedules a Die message to the shield itself for when its duration is over. The creator attaches the shield to
+    // the boat (see EntityManager::Attach), which then places it each frame and destroys it along with the boat
+    Shield(EntityTemplate& entityTemplate, EntityID id, const Matrix4x4& transform, EntityID parentBoatID);
 
     // Update function
     virtual bool Update(float frameTime) override;
 
+    // Shields only change their own attachment and send messages, so can be updated on worker threads
+    virtual bool CanUpdateInParallel() override { return true; }
+
+    EntityID GetParentBoatID() const { return mParentBoatID; }
+
+    // Everything about the shield except its template, ID and matrix, as plain data for a checkpoint (see Checkpoint.h). The
+    // Die message scheduled by the constructor is replaced when the checkpoint restores the messenger
+    struct SavedState
+    {
+        EntityID parentBoatID;
+        float    elapsed;
+        float    shieldDuration;
+        TRS      local;
+    };
+    SavedState SaveState() { return { mParentBoatID, mElapsed, mShieldDuration, mLocal }; }
+    void RestoreState(const SavedState& saved)
+    {
+        mParentBoatID = saved.parentBoatID;
+        mElapsed = saved.elapsed;
+        mShieldDuration = saved.shieldDuration;
+        mLocal = saved.local;
+    }
+
 private:
     EntityID mParentBoatID; // The ID of the boat this shield is attached to
     float mElapsed;  // Time elapsed since the shield was spawned
-    float mShieldDuration;  // Duration before shield disappears
+    float mShieldDuration;  // Duration before shield disappears, see constructor
+    TRS   mLocal;           // Position, spin and pulsing scale relative to the boat, given to the attachment each update
 };
 
 #endif // _SHIELD_H_INCLUDED_
@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// Uniform grid over the sea plane for finding entities near a point
+//--------------------------------------------------------------------------------------
+
+#include "SpatialGrid.h"
+
+
+/*-----------------------------------------------------------------------------------------
+   Maintenance
+-----------------------------------------------------------------------------------------*/
+
+// Add an entity to the grid at its current position, with the given spatial type
+void SpatialGrid::Insert(Entity* entity, uint32_t type)
+{
+	uint32_t index = EntityIndex(entity->GetID());
+	if (index >= mRecords.size())  mRecords.resize(index + 1);
+
+	Record& record = mRecords[index];
+	if (record.inGrid)  return;
+
+	record.type = type;
+	record.inGrid = true;
+	record.indexInMembers = static_cast<uint32_t>(mMembers.size());
+	mMembers.push_back(entity);
+
+	AddToCell(record, entity, entity->Transform().Position());
+}
+
+
+// Remove an entity from the grid, does nothing if the entity isn't in the grid
+void SpatialGrid::Remove(Entity* entity)
+{
+	uint32_t index = EntityIndex(entity->GetID());
+	if (index >= mRecords.size() || !mRecords[index].inGrid)  return;
+
+	Record& record = mRecords[index];
+	RemoveFromCell(record);
+
+	// Remove from the member list by moving the last member into the gap
+	Entity* lastMember = mMembers.back();
+	mMembers[record.indexInMembers] = lastMember;
+	mRecords[EntityIndex(lastMember->GetID())].indexInMembers = record.indexInMembers;
+	mMembers.pop_back();
+
+	record.inGrid = false;
+}
+
+
+// Update the grid with the entity's current position, does nothing if the entity isn't in the grid
+void SpatialGrid::Move(Entity* entity)
+{
+	uint32_t index = EntityIndex(entity->GetID());
+	if (index >= mRecords.size() || !mRecords[index].inGrid)  return;
+
+	Record& record = mRecords[index];
+	const Vector3& position = entity->Transform().Position();
+	uint64_t newCell = CellKey(CellCoord(position.x), CellCoord(position.z));
+	if (newCell == record.cell)
+	{
+		// Still in the same cell (the usual case), just update the stored position
+		mCells[record.cell][record.indexInCell].position = position;
+		return;
+	}
+
+	RemoveFromCell(record);
+	AddToCell(record, entity, position);
+}
+
+
+// Update the positions of all entities in the grid
+void SpatialGrid::MoveAll()
+{
+	for (auto entity : mMembers)  Move(entity);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Add the entity with the given record to the cell containing the given position
+void SpatialGrid::AddToCell(Record& record, Entity* entity, const Vector3& position)
+{
+	int x = CellCoord(position.x);
+	int z = CellCoord(position.z);
+	record.cell = CellKey(x, z);
+
+	auto& items = mCells[record.cell];
+	record.indexInCell = static_cast<uint32_t>(items.size());
+	items.push_back({ entity, position, record.type });
+
+	mMinCellX = std::min(mMinCellX, x);  mMaxCellX = std::max(mMaxCellX, x);
+	mMinCellZ = std::min(mMinCellZ, z);  mMaxCellZ = std::max(mMaxCellZ, z);
+}
+
+// Remove the entity with the given record from its cell by moving the last item in the cell into the gap
+void SpatialGrid::RemoveFromCell(Record& record)
+{
+	auto& items = mCells[record.cell];
+	Item& lastItem = items.back();
+	items[record.indexInCell] = lastItem;
+	mRecords[EntityIndex(lastItem.entity->GetID())].indexInCell = record.indexInCell;
+	items.pop_back();
+}
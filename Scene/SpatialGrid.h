@@ -0,0 +1,293 @@
+//--------------------------------------------------------------------------------------
+// Uniform grid over the sea plane for finding entities near a point
+//--------------------------------------------------------------------------------------
+// The sea is divided into square cells on the XZ plane, and each entity in the grid is listed in the cell that contains
+// its position. A query for entities near a point only needs to look in the few cells around that point rather than at
+// every entity in the world. Only cells that contain entities are stored (in a hash table) so the sea can be any size.
+//
+// The EntityManager puts the gameplay entity types that are searched for (boats, crates, mines and reload stations) into its
+// grid when they are created and keeps their positions up to date as they are updated, see EntityManager::UpdateAll. Game code
+// only needs to run queries, e.g. find all boats within 40 units:
+//     gEntityManager->Spatial().QueryRadius(position, 40.0f, SPATIAL_BOAT, [&](Entity* entity) { ... });
+//
+// Queries are read-only, so they are safe to use from entity updates on worker threads (see Entity::CanUpdateInParallel)
+
+#ifndef _SPATIAL_GRID_H_INCLUDED_
+#define _SPATIAL_GRID_H_INCLUDED_
+
+#include "Entity.h"
+#include "Vector3.h"
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <type_traits>
+#include <cmath>
+#include <cfloat>
+#include <stdint.h>
+
+
+//--------------------------------------------------------------------------------------
+// Spatial types
+//--------------------------------------------------------------------------------------
+// Each entity in the grid has one of these types. Queries take a mask of the types to find, combine types with | to find
+// several types at once, e.g. SPATIAL_CRATE | SPATIAL_MINE
+const uint32_t SPATIAL_BOAT           = 1 << 0;
+const uint32_t SPATIAL_CRATE          = 1 << 1;
+const uint32_t SPATIAL_MINE           = 1 << 2;
+const uint32_t SPATIAL_RELOAD_STATION = 1 << 3;
+const uint32_t SPATIAL_ALL            = UINT32_MAX;
+
+
+//--------------------------------------------------------------------------------------
+// Spatial Grid Class
+//--------------------------------------------------------------------------------------
+class SpatialGrid
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Cells should be around the size of the most common query radius - smaller cells mean more cells to visit for each query,
+	// larger cells mean more entities to check in each cell
+	SpatialGrid(float cellSize = 50.0f) : mCellSize(cellSize), mInvCellSize(1.0f / cellSize) {}
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Maintenance - used by the EntityManager
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add an entity to the grid at its current position, with the given spatial type
+	void Insert(Entity* entity, uint32_t type);
+
+	// Remove an entity from the grid, does nothing if the entity isn't in the grid
+	void Remove(Entity* entity);
+
+	// Update the grid with the entity's current position, does nothing if the entity isn't in the grid
+	void Move(Entity* entity);
+
+	// Update the positions of all entities in the grid
+	void MoveAll();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Queries
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Call the given function for each entity of the given types within radius of the given point (3D distance). The function
+	// is passed the Entity* and may return void, or bool where returning false stops the query. Entities are visited in no
+	// particular order (but the same order each run). Returns false if the query was stopped early
+	template <typename Function>
+	bool QueryRadius(const Vector3& point, float radius, uint32_t typeMask, Function&& function) const
+	{
+		return ForEachItemInRadius(point, radius, typeMask, [&](const Item& item)
+		{
+			if constexpr (std::is_same_v<std::invoke_result_t<Function, Entity*>, bool>)
+			{
+				return function(item.entity);
+			}
+			else
+			{
+				function(item.entity);
+				return true;
+			}
+		});
+	}
+
+	// Return the nearest entity of the given types to the given point that is within maxDistance (3D distance) and is accepted
+	// by the optional function, which is passed an Entity* and returns true to accept it. The function is only called for
+	// entities nearer than the best found so far. Returns nullptr if there is no such entity
+	Entity* QueryNearest(const Vector3& point, uint32_t typeMask, float maxDistance = FLT_MAX) const
+	{
+		return QueryNearest(point, typeMask, maxDistance, [](Entity*) { return true; });
+	}
+
+	template <typename Function>
+	Entity* QueryNearest(const Vector3& point, uint32_t typeMask, float maxDistance, Function&& accept) const
+	{
+		if (mMembers.empty())  return nullptr;
+
+		Entity* nearest = nullptr;
+		float nearestDistanceSquared = (maxDistance == FLT_MAX) ? FLT_MAX : maxDistance * maxDistance;
+		auto visitCell = [&](int x, int z)
+		{
+			auto cell = mCells.find(CellKey(x, z));
+			if (cell == mCells.end())  return;
+
+			for (auto& item : cell->second)
+			{
+				if ((item.type & typeMask) == 0)  continue;
+				float distanceSquared = DistanceSquared(item.position, point);
+				if (distanceSquared <= nearestDistanceSquared && accept(item.entity))
+				{
+					nearest = item.entity;
+					nearestDistanceSquared = distanceSquared;
+				}
+			}
+		};
+
+		// Search outwards from the cell containing the point one ring of cells at a time. Every cell outside ring n is at least
+		// n cell widths away, so stop once the best entity is nearer than that (which includes passing the maximum distance), or
+		// the rings have passed all occupied cells. Cells outside the occupied range are skipped
+		int centreX = CellCoord(point.x);
+		int centreZ = CellCoord(point.z);
+		int maxRing = std::max({ centreX - mMinCellX, mMaxCellX - centreX, centreZ - mMinCellZ, mMaxCellZ - centreZ });
+		for (int ring = 0; ring <= maxRing; ++ring)
+		{
+			int minZ = std::max(centreZ - ring, mMinCellZ), maxZ = std::min(centreZ + ring, mMaxCellZ);
+			int minX = std::max(centreX - ring, mMinCellX), maxX = std::min(centreX + ring, mMaxCellX);
+			for (int z = minZ; z <= maxZ; ++z)
+			{
+				if (z == centreZ - ring || z == centreZ + ring)
+				{
+					// Top or bottom row of the ring - visit the whole row
+					for (int x = minX; x <= maxX; ++x)  visitCell(x, z);
+				}
+				else
+				{
+					// Other rows only have the two cells at the sides of the ring, the inner cells were visited in earlier rings
+					if (centreX - ring >= mMinCellX)  visitCell(centreX - ring, z);
+					if (centreX + ring <= mMaxCellX)  visitCell(centreX + ring, z);
+				}
+			}
+
+			float ringDistance = ring * mCellSize;
+			if (ringDistance * ringDistance >= nearestDistanceSquared)  break;
+		}
+		return nearest;
+	}
+
+
+	// Move a sphere of the given radius from start to end and return the first entity of the given types that it touches and
+	// that is accepted by the function (passed an Entity*, returns true to accept it). Entities are treated as points at the
+	// positions they were at when last moved. This is a continuous test, so fast movers don't pass through entities between
+	// frames. If hitFraction is given it is set to how far along the sweep the hit is (0 = start, 1 = end). Returns nullptr
+	// if nothing is touched
+	template <typename Function>
+	Entity* QuerySweep(const Vector3& start, const Vector3& end, float radius, uint32_t typeMask, Function&& accept,
+	                   float* hitFraction = nullptr) const
+	{
+		// Candidates are the entities within the sphere that encloses the whole sweep
+		Vector3 sweep = { end.x - start.x, end.y - start.y, end.z - start.z };
+		Vector3 middle = { start.x + sweep.x * 0.5f, start.y + sweep.y * 0.5f, start.z + sweep.z * 0.5f };
+		float sweepLengthSquared = sweep.x * sweep.x + sweep.y * sweep.y + sweep.z * sweep.z;
+		float radiusSquared = radius * radius;
+
+		Entity* first = nullptr;
+		float firstFraction = FLT_MAX;
+		ForEachItemInRadius(middle, 0.5f * std::sqrt(sweepLengthSquared) + radius, typeMask, [&](const Item& item)
+		{
+			// Solve |start + t * sweep - position| = radius for the smallest t in [0,1]
+			Vector3 offset = { start.x - item.position.x, start.y - item.position.y, start.z - item.position.z };
+			float c = offset.x * offset.x + offset.y * offset.y + offset.z * offset.z - radiusSquared;
+			float fraction;
+			if (c <= 0.0f)
+			{
+				fraction = 0.0f; // Already touching at the start
+			}
+			else
+			{
+				if (sweepLengthSquared == 0.0f)  return true;
+				float b = offset.x * sweep.x + offset.y * sweep.y + offset.z * sweep.z;
+				float discriminant = b * b - sweepLengthSquared * c;
+				if (b >= 0.0f || discriminant < 0.0f)  return true; // Moving away, or passes by
+				fraction = (-b - std::sqrt(discriminant)) / sweepLengthSquared;
+				if (fraction > 1.0f)  return true;
+			}
+
+			if (fraction < firstFraction && accept(item.entity))
+			{
+				first = item.entity;
+				firstFraction = fraction;
+			}
+			return true;
+		});
+
+		if (first != nullptr && hitFraction != nullptr)  *hitFraction = firstFraction;
+		return first;
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Cell coordinate containing the given world X or Z coordinate
+	int CellCoord(float worldCoord) const  { return static_cast<int>(std::floor(worldCoord * mInvCellSize)); }
+
+	// Key for the cell hash table
+	static uint64_t CellKey(int x, int z)  { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z); }
+
+	static float DistanceSquared(const Vector3& a, const Vector3& b)
+	{
+		float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Call function(const Item&) for each item of the given types within radius of the point, stopping if it returns false.
+	// Returns false if stopped early
+	template <typename Function>
+	bool ForEachItemInRadius(const Vector3& point, float radius, uint32_t typeMask, Function&& function) const
+	{
+		if (mMembers.empty())  return true;
+
+		// Visit the cells overlapped by the square around the query circle, limited to the range of occupied cells
+		float radiusSquared = radius * radius;
+		int minX = std::max(CellCoord(point.x - radius), mMinCellX), maxX = std::min(CellCoord(point.x + radius), mMaxCellX);
+		int minZ = std::max(CellCoord(point.z - radius), mMinCellZ), maxZ = std::min(CellCoord(point.z + radius), mMaxCellZ);
+		for (int z = minZ; z <= maxZ; ++z)
+		{
+			for (int x = minX; x <= maxX; ++x)
+			{
+				auto cell = mCells.find(CellKey(x, z));
+				if (cell == mCells.end())  continue;
+
+				for (auto& item : cell->second)
+				{
+					if ((item.type & typeMask) == 0 || DistanceSquared(item.position, point) > radiusSquared)  continue;
+					if (!function(item))  return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Add / remove the entity with the given record to / from a cell
+	struct Record;
+	void AddToCell(Record& record, Entity* entity, const Vector3& position);
+	void RemoveFromCell(Record& record);
+
+	// Entity in a cell, with the position it was at when last moved
+	struct Item
+	{
+		Entity*  entity;
+		Vector3  position;
+		uint32_t type;
+	};
+
+	// Where an entity is in the grid, indexed by the entity's slot index (see EntityTypes.h)
+	struct Record
+	{
+		uint64_t cell           = 0;
+		uint32_t indexInCell    = 0;
+		uint32_t indexInMembers = 0;
+		uint32_t type           = 0;
+		bool     inGrid         = false;
+	};
+
+	float mCellSize;
+	float mInvCellSize;
+
+	// Only occupied cells are stored. Cells are not erased when they become empty, which avoids repeated reallocation as
+	// entities move back and forth between cells
+	std::unordered_map<uint64_t, std::vector<Item>> mCells;
+	std::vector<Record> mRecords;
+	std::vector<Entity*> mMembers; // All entities in the grid, for MoveAll
+
+	// Range of cells that have ever been occupied, limits how far QueryNearest searches
+	int mMinCellX = INT32_MAX, mMaxCellX = INT32_MIN;
+	int mMinCellZ = INT32_MAX, mMaxCellZ = INT32_MIN;
+};
+
+
+#endif //_SPATIAL_GRID_H_INCLUDED_
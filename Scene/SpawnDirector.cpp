@@ -0,0 +1,189 @@
+//--------------------------------------------------------------------------------------
+// Spawn director - places the random crates and sea mines during play, within limits and budgets
+//--------------------------------------------------------------------------------------
+
+#include "SpawnDirector.h"
+
+#include "SceneGlobals.h"
+#include "EntityManager.h"
+#include "WorldPartition.h"
+#include "MathHelpers.h"
+#include "Random.h"
+
+#include <algorithm>
+#include <chrono>
+
+
+// A random time between two from the settings, given either way round
+static float RandomTime(float a, float b)
+{
+	return Random(std::min(a, b), std::max(a, b));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Settings
+-----------------------------------------------------------------------------------------*/
+
+// Take the limits, intervals and budgets from a level's settings. The timers are left as they are
+void SpawnDirector::Configure(const LevelSettings& settings)
+{
+	mSettings = settings;
+	mKinds[static_cast<int>(SpawnKind::Crate)].settings = &mSettings.crateSpawns;
+	mKinds[static_cast<int>(SpawnKind::Crate)].max      = mSettings.maxCrates;
+	mKinds[static_cast<int>(SpawnKind::Mine)].settings  = &mSettings.mineSpawns;
+	mKinds[static_cast<int>(SpawnKind::Mine)].max       = mSettings.maxMines;
+
+	// Enough storage for the most there can be, so spawning never allocates
+	RandomCrate::Pool().Reserve(mSettings.maxCrates);
+	SeaMine::Pool().Reserve(mSettings.maxMines);
+}
+
+
+// Start the timers for the first spawns
+void SpawnDirector::ResetTimers()
+{
+	for (Kind& kind : mKinds)
+	{
+		if (kind.settings != nullptr)  kind.timer = RandomTime(kind.settings->minFirst, kind.settings->maxFirst);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Move the timers on by the step time and, if spawning is allowed, spawn the crates and mines that are due and fit the
+// limits and budgets
+void SpawnDirector::Update(float stepTime, bool spawn, WorldPartition* partition)
+{
+	for (Kind& kind : mKinds)  kind.timer -= stepTime;
+	mSpawned  = 0;
+	mDeferred = 0;
+	mMilliseconds = 0;
+	if (!spawn || mKinds[0].settings == nullptr)  return;
+
+	auto start = std::chrono::steady_clock::now();
+	auto overBudget = [&]()
+	{
+		if (mSettings.spawnBudget <= 0)  return false;
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() >= mSettings.spawnBudget;
+	};
+
+	// Each pass spawns at most one of each kind that is due, so one kind catching up doesn't use the whole step's budget
+	// before the other gets a turn. A kind with no room waits with its timer run out, one that can't be placed waits for
+	// the next step
+	uint32_t inPlay = Count(SpawnKind::Crate) + Count(SpawnKind::Mine);
+	uint32_t kindSpawned[2] = {};
+	bool     placementFailed[2] = {};
+	for (bool spawnedAny = true; spawnedAny; )
+	{
+		spawnedAny = false;
+		for (int k = 0; k < 2; ++k)
+		{
+			Kind& kind = mKinds[k];
+			SpawnKind spawnKind = static_cast<SpawnKind>(k);
+			if (kind.timer > 0 || placementFailed[k])  continue;
+			if (Count(spawnKind) >= kind.max || (mSettings.maxSpawned > 0 && inPlay >= mSettings.maxSpawned))
+			{
+				kind.timer = 0;
+				continue;
+			}
+			if (kindSpawned[k] >= kind.settings->perStep || mSpawned >= mSettings.spawnsPerStep || overBudget())  continue;
+
+			Vector3 point;
+			if (!ChoosePoint(kind.settings->height, partition, point))
+			{
+				placementFailed[k] = true;
+				++mPlacementsFailed;
+				continue;
+			}
+			Spawn(spawnKind, point);
+			kind.timer += RandomTime(kind.settings->minInterval, kind.settings->maxInterval);
+			++kindSpawned[k];
+			++mSpawned;
+			++inPlay;
+			spawnedAny = true;
+		}
+	}
+
+	// Those still due with room for them were held back by a budget
+	for (int k = 0; k < 2; ++k)
+	{
+		if (mKinds[k].timer <= 0 && !placementFailed[k] && Count(static_cast<SpawnKind>(k)) < mKinds[k].max &&
+		    (mSettings.maxSpawned == 0 || inPlay < mSettings.maxSpawned))  ++mDeferred;
+	}
+	mMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// For display
+SpawnDirector::Stats SpawnDirector::GetStats()
+{
+	Stats stats = {};
+	stats.crates           = Count(SpawnKind::Crate);
+	stats.mines            = Count(SpawnKind::Mine);
+	stats.spawned          = mSpawned;
+	stats.deferred         = mDeferred;
+	stats.placementsFailed = mPlacementsFailed;
+	stats.milliseconds     = mMilliseconds;
+	return stats;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Number of a kind in play, from the entity manager's registries
+uint32_t SpawnDirector::Count(SpawnKind kind)
+{
+	if (kind == SpawnKind::Crate)  return static_cast<uint32_t>(gEntityManager->View<RandomCrate>().size());
+	return static_cast<uint32_t>(gEntityManager->View<SeaMine>().size());
+}
+
+
+// Choose a clear point at the given height, on a navigation point within the spawn range or in a loaded cell of a
+// partitioned level. Returns false if none is found
+bool SpawnDirector::ChoosePoint(float height, WorldPartition* partition, Vector3& point)
+{
+	const NavigationField& navigation = gEntityManager->Navigation();
+	const float range = mSettings.spawnRange;
+	for (int i = 0; i < PLACEMENT_TRIES; ++i)
+	{
+		bool found;
+		if (partition != nullptr)
+		{
+			found = partition->RandomLoadedPoint(height, point) && !navigation.IsBlocked(point);
+		}
+		else
+		{
+			found = navigation.Points().RandomPointInRing({ 0, height, 0 }, 0, range, {}, 0, ThreadRandom(), point);
+			if (!found)
+			{
+				// No navigation point in range, e.g. a range smaller than their spacing
+				point = { Random(-range, range), height, Random(-range, range) };
+				found = !navigation.IsBlocked(point);
+			}
+		}
+		if (found && gEntityManager->Spatial().QueryNearest(point, SPATIAL_CRATE | SPATIAL_MINE, MIN_SPACING) == nullptr)  return true;
+	}
+	return false;
+}
+
+
+void SpawnDirector::Spawn(SpawnKind kind, const Vector3& point)
+{
+	Matrix4x4 transform(point, { 0, 0, 0 }, 1.0f);
+	if (kind == SpawnKind::Crate)
+	{
+		float r = Random(0.0f, 1.0f);
+		CrateType type = r < 0.33f ? CrateType::Missile : (r < 0.66f ? CrateType::Health : CrateType::Shield);
+		gEntityManager->CreateEntity<RandomCrate>(mCrateTemplate, transform, type);
+	}
+	else
+	{
+		gEntityManager->CreateEntity<SeaMine>(mMineTemplate, transform);
+	}
+}
@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// Spawn director - places the random crates and sea mines during play, within limits and budgets
+//--------------------------------------------------------------------------------------
+// Crates and mines each have a timer, reset to a random interval from the level's settings (see SpawnSettings in
+// ParseLevel.h) each time one is spawned. Once a timer has run out one is spawned when there is room for it:
+//  - fewer than the kind's maximum are in play, and fewer than the level's maximum of crates and mines together. The counts
+//    come from the entity manager's registries, which are kept as entities are created and destroyed, so nothing is
+//    searched for or copied to count them
+//  - fewer than the kind's and the level's most spawns in a step have been made, and the step's spawning has taken less
+//    than the level's budget of milliseconds. Spawns over a budget wait for the next step, so catching up after a long step
+//    (e.g. a fast-forwarded replay return or a slow frame) is spread over several steps rather than stalling one
+// A kind at its maximum waits with its timer run out, and spawns as soon as one of its kind goes.
+//
+// Each is placed on one of the navigation points (see NavigationPoints.h), which are spread over the open water clear of
+// the obstacles, within the level's spawn range of the centre. In a partitioned level it is placed in one of the cells
+// streamed in instead, avoiding blocked water. A point too near a crate or mine already in play is tried again. Crates and
+// mines have pooled storage (see EntityPool.h), which is grown to their maximums when the director is set up so spawning
+// reuses the memory of those that have gone and never allocates.
+//
+//   mSpawnDirector.Configure(levelParser.Settings());  mSpawnDirector.ResetTimers();
+//   mSpawnDirector.Update(stepTime, AreBoatsActive(), mWorldPartition.get());  // Each simulation step, after UpdateAll
+
+#ifndef _SPAWN_DIRECTOR_H_INCLUDED_
+#define _SPAWN_DIRECTOR_H_INCLUDED_
+
+#include "ParseLevel.h"
+#include "Vector3.h"
+
+#include <stdint.h>
+
+
+class WorldPartition;
+
+// Kinds of entity the director spawns
+enum class SpawnKind
+{
+	Crate,
+	Mine,
+};
+
+
+class SpawnDirector
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Closest a new crate or mine may be to another in play, and the places tried to find such a point
+	static constexpr float MIN_SPACING     = 20.0f;
+	static constexpr int   PLACEMENT_TRIES = 4;
+
+	// Take the limits, intervals and budgets from a level's settings, e.g. when it is loaded or reloaded. The timers are
+	// left as they are
+	void Configure(const LevelSettings& settings);
+
+	// Start the timers for the first spawns, when play starts
+	void ResetTimers();
+
+	// Milliseconds of spawning in one step, 0 for no limit (e.g. a seeded headless battle, so it spawns the same on any machine)
+	void  SetTimeBudget(float milliseconds)  { mSettings.spawnBudget = milliseconds; }
+	float GetTimeBudget()                    { return mSettings.spawnBudget; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Move the timers on by the step time and, if spawning is allowed, spawn the crates and mines that are due and fit the
+	// limits and budgets. Call on the thread running the entity updates but not from within UpdateAll
+	void Update(float stepTime, bool spawn, WorldPartition* partition);
+
+	// Seconds until the next of a kind is due, saved and restored with checkpoints
+	float GetTimer(SpawnKind kind)               { return mKinds[static_cast<int>(kind)].timer; }
+	void  SetTimer(SpawnKind kind, float timer)  { mKinds[static_cast<int>(kind)].timer = timer; }
+
+	// For display
+	struct Stats
+	{
+		uint32_t crates;
+		uint32_t mines;
+		uint32_t spawned;          // In the last step
+		uint32_t deferred;         // Kinds due with room for them but over a step budget in the last step
+		uint32_t placementsFailed; // Times no clear point was found
+		float    milliseconds;     // Spent spawning in the last step
+	};
+	Stats GetStats();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct Kind
+	{
+		const SpawnSettings* settings = nullptr;
+		uint32_t max   = 0;
+		float    timer = 0;
+	};
+
+	// Number of a kind in play
+	uint32_t Count(SpawnKind kind);
+
+	// Choose a clear point at the given height. Returns false if none is found
+	bool ChoosePoint(float height, WorldPartition* partition, Vector3& point);
+
+	void Spawn(SpawnKind kind, const Vector3& point);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	LevelSettings mSettings;
+	Kind mKinds[2];
+
+	TemplateHandle mCrateTemplate{ Atom("RandomCrate") };
+	TemplateHandle mMineTemplate { Atom("SeaMine") };
+
+	uint32_t mSpawned  = 0;
+	uint32_t mDeferred = 0;
+	uint32_t mPlacementsFailed = 0;
+	float    mMilliseconds = 0;
+};
+
+
+#endif //_SPAWN_DIRECTOR_H_INCLUDED_
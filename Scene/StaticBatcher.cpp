@@ -0,0 +1,340 @@
+//--------------------------------------------------------------------------------------
+// Static batcher - merges the geometry of scenery that never moves into a few large draws
+//--------------------------------------------------------------------------------------
+
+#include "StaticBatcher.h"
+
+#include "Entity.h"
+#include "Mesh.h"
+#include "RenderMethod.h"
+#include "CBuffer.h"
+#include "CBufferTypes.h"
+#include "RenderGlobals.h"
+#include "RenderCounters.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add a static entity to the cell it is in
+void StaticBatcher::Add(Entity* entity)
+{
+	CellKey key = CellOf(entity);
+	Cell& cell = mCells[key];
+	cell.entities.push_back(entity);
+	cell.dirty = true;
+	mEntityCells[entity] = key;
+}
+
+
+// Remove a static entity from its cell. Its batches are drawn without it once the cell is rebuilt, it is no longer reported
+// as batched straight away
+void StaticBatcher::Remove(Entity* entity)
+{
+	auto found = mEntityCells.find(entity);
+	if (found == mEntityCells.end())  return;
+
+	Cell& cell = mCells[found->second];
+	std::erase(cell.entities, entity);
+	std::erase(cell.batchedEntities, entity);
+	cell.dirty = true;
+	mBatched.erase(entity);
+	mEntityCells.erase(found);
+}
+
+
+// Rebuild the cell of an entity in the next Update
+void StaticBatcher::Refresh(Entity* entity)
+{
+	auto found = mEntityCells.find(entity);
+	if (found != mEntityCells.end())  mCells[found->second].dirty = true;
+}
+
+
+// Put every entity back in the cell it is now in and rebuild every cell
+void StaticBatcher::Rebuild()
+{
+	std::vector<Entity*> entities;
+	for (auto& [key, cell] : mCells)  entities.insert(entities.end(), cell.entities.begin(), cell.entities.end());
+
+	// The emptied cells are kept with no entities so their old batches are dropped by the next Update
+	for (auto& [key, cell] : mCells)
+	{
+		cell.entities.clear();
+		cell.dirty = true;
+	}
+	mEntityCells.clear();
+	for (Entity* entity : entities)  Add(entity);
+}
+
+
+// Build the batches of the cells that have changed
+bool StaticBatcher::Update(uint64_t templatesVersion, const std::function<bool(Entity*)>& canBatch)
+{
+	// The batches hold render states and the read back geometry is by mesh, both are lost if templates have been replaced
+	if (templatesVersion != mTemplatesVersion)
+	{
+		mTemplatesVersion = templatesVersion;
+		mSources.clear();
+		for (auto& [key, cell] : mCells)  cell.dirty = true;
+	}
+
+	bool changed = false;
+	for (auto cell = mCells.begin(); cell != mCells.end(); )
+	{
+		if (cell->second.dirty)
+		{
+			PROFILE_SCOPE("StaticBatcher::BuildCell");
+			BuildCell(cell->second, canBatch);
+			changed = true;
+		}
+		if (cell->second.entities.empty())  cell = mCells.erase(cell);
+		else                                ++cell;
+	}
+	if (!changed)  return false;
+
+	// Every cell's batches are drawn together in render state order, so cells sharing materials don't change state between them
+	mDrawOrder.clear();
+	for (auto& [key, cell] : mCells)
+	{
+		for (auto& batch : cell.batches)  mDrawOrder.push_back(&batch);
+	}
+	std::stable_sort(mDrawOrder.begin(), mDrawOrder.end(), [](const Batch* a, const Batch* b) { return a->stateKey < b->stateKey; });
+
+	mNumBatched = static_cast<uint32_t>(mBatched.size());
+	mNumBatches = static_cast<uint32_t>(mDrawOrder.size());
+	return true;
+}
+
+
+// Whether an entity is drawn by the batches
+bool StaticBatcher::IsBatched(Entity* entity)
+{
+	return mBatched.contains(entity);
+}
+
+
+// Draw the batches of the visible cells
+StaticBatcher::RenderStats StaticBatcher::Render(const Frustum* cullFrustum, const Vector3& cameraPosition, float projectionScale)
+{
+	PROFILE_SCOPE("StaticBatcher::Render");
+	RenderStats stats;
+
+	// The vertices are already in world space. The per-mesh constants are sent again when the colour changes
+	gPerMeshConstants.worldMatrix = Matrix4x4::Identity;
+	bool constantsSent = false;
+	RenderState* renderState = nullptr;
+
+	for (const Batch* batch : mDrawOrder)
+	{
+		if (cullFrustum != nullptr && !cullFrustum->IsSphereVisible(batch->bounds))
+		{
+			++stats.culled;
+			continue;
+		}
+
+		// Streamed textures are loaded at the size the batch appears on screen, as for the draws of a render queue
+		if (projectionScale > 0)
+		{
+			float distance = Distance(cameraPosition, batch->bounds.centre);
+			if (distance > batch->bounds.radius)
+				batch->renderState->RequestTextureSize(static_cast<unsigned int>(batch->bounds.radius * projectionScale / distance * DX->GetSceneHeight()) + 1);
+			else
+				batch->renderState->RequestTextureSize(UINT_MAX);
+		}
+
+		const ColourRGBA& colour = gPerMeshConstants.meshColour;
+		if (!constantsSent || std::tie(colour.r, colour.g, colour.b, colour.a) != std::tie(batch->colour.r, batch->colour.g, batch->colour.b, batch->colour.a))
+		{
+			gPerMeshConstants.meshColour = batch->colour;
+			DX->CBuffers()->UpdateDrawCBuffer(gPerMeshConstantBuffer, PER_MESH_CBUFFER_SLOT, gPerMeshConstants);
+			constantsSent = true;
+		}
+		if (batch->renderState != renderState)
+		{
+			batch->renderState->Apply();
+			renderState = batch->renderState;
+		}
+
+		DX->Geometry()->Bind(batch->geometry);
+		DX->Context()->DrawIndexed(batch->numIndices, batch->geometry.startIndex, batch->geometry.baseVertex);
+		gRenderCounters.Add(RenderCounter::Draws);
+		++stats.draws;
+	}
+	return stats;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private functions
+-----------------------------------------------------------------------------------------*/
+
+// The grid cell of an entity from the centre of its bounding sphere
+StaticBatcher::CellKey StaticBatcher::CellOf(Entity* entity)
+{
+	Vector3 centre = entity->GetWorldBoundingSphere().centre;
+	return { static_cast<int32_t>(std::floor(centre.x / CELL_SIZE)), static_cast<int32_t>(std::floor(centre.z / CELL_SIZE)) };
+}
+
+
+// Whether every sub-mesh of a mesh is rigid and has uncompressed positions, normals and tangents. Other vertex elements (UVs,
+// colours) are copied as they are
+bool StaticBatcher::CanTransform(Mesh& mesh)
+{
+	if (mesh.HasBones() || mesh.SubMeshCount() == 0)  return false;
+
+	for (unsigned int subMesh = 0; subMesh < mesh.SubMeshCount(); ++subMesh)
+	{
+		auto source = mesh.GetSubMeshGeometry(subMesh);
+		if (source.renderState == nullptr || source.geometry->pool == nullptr)  return false;
+
+		bool hasPosition = false;
+		for (auto& element : source.geometry->pool->vertexElements)
+		{
+			std::string_view name = element.SemanticName;
+			bool isPosition = (name == "position");
+			if (isPosition || name == "normal" || name == "tangent" || name == "bitangent")
+			{
+				if (element.Format != DXGI_FORMAT_R32G32B32_FLOAT)  return false;
+			}
+			hasPosition = hasPosition || isPosition;
+		}
+		if (!hasPosition)  return false;
+	}
+	return true;
+}
+
+
+// Build the batches of one cell: each batched entity's sub-meshes are transformed by their node's world matrix and appended to
+// the batch for their render state and the entity's colour
+void StaticBatcher::BuildCell(Cell& cell, const std::function<bool(Entity*)>& canBatch)
+{
+	cell.dirty = false;
+	cell.batches.clear(); // Releases the old geometry ranges
+	for (Entity* entity : cell.batchedEntities)  mBatched.erase(entity);
+	cell.batchedEntities.clear();
+
+	// Merged vertices and indices of each batch while they are built, ordered by render state so the batches are drawn in
+	// state order
+	struct Merged
+	{
+		RenderState*                  renderState;
+		ColourRGBA                    colour;
+		const GeometryManager::Range* source; // For the vertex layout
+		std::vector<uint8_t>          vertices;
+		std::vector<uint32_t>         indices;
+		BoundingSphere                bounds;
+	};
+	using MergedKey = std::tuple<uint64_t, RenderState*, float, float, float, float>;
+	std::map<MergedKey, Merged> merged;
+
+	for (Entity* entity : cell.entities)
+	{
+		EntityTemplate& entityTemplate = entity->Template();
+		Mesh& mesh = entityTemplate.GetMesh();
+		if (entityTemplate.LODCount() > 1 || entityTemplate.ImpostorScreenSize() > 0 || !CanTransform(mesh) || !canBatch(entity))  continue;
+
+		// All the entity's geometry must be read back before any of it is added, it isn't batched at all if any can't be
+		bool readable = true;
+		for (unsigned int subMesh = 0; subMesh < mesh.SubMeshCount() && readable; ++subMesh)  readable = GetSource(mesh, subMesh).valid;
+		if (!readable)  continue;
+
+		const Matrix4x4* worldMatrices = entity->WorldTransforms();
+		const ColourRGBA& colour = entity->RenderColour();
+		BoundingSphere entityBounds = entity->GetWorldBoundingSphere();
+		for (unsigned int subMesh = 0; subMesh < mesh.SubMeshCount(); ++subMesh)
+		{
+			auto geometry = mesh.GetSubMeshGeometry(subMesh);
+			const SourceGeometry& source = GetSource(mesh, subMesh);
+			MergedKey key = { geometry.renderState->StateKey(), geometry.renderState, colour.r, colour.g, colour.b, colour.a };
+			auto [entry, added] = merged.try_emplace(key);
+			Merged& batch = entry->second;
+			if (added)
+			{
+				batch.renderState = geometry.renderState;
+				batch.colour      = colour;
+				batch.source      = geometry.geometry;
+			}
+			batch.bounds.Merge(entityBounds);
+
+			// Indices are relative to the first vertex of the sub-mesh, so are offset by the vertices already in the batch
+			const GeometryManager::Pool& pool = *geometry.geometry->pool;
+			size_t firstVertex = batch.vertices.size() / pool.vertexSize;
+			for (uint32_t index : source.indices)  batch.indices.push_back(static_cast<uint32_t>(firstVertex + index));
+
+			// Positions are transformed as points and the normal and tangents as directions, as the vertex shader would with the
+			// node's world matrix. Elements can share an offset (see the bitangents in Mesh.cpp), each offset is only transformed once
+			size_t start = batch.vertices.size();
+			std::vector<UINT> transformedOffsets;
+			batch.vertices.insert(batch.vertices.end(), source.vertices.begin(), source.vertices.end());
+			const Matrix4x4& world = worldMatrices[geometry.node];
+			for (auto& element : pool.vertexElements)
+			{
+				std::string_view name = element.SemanticName;
+				bool isPosition = (name == "position");
+				if (!isPosition && name != "normal" && name != "tangent" && name != "bitangent")  continue;
+				if (std::find(transformedOffsets.begin(), transformedOffsets.end(), element.AlignedByteOffset) != transformedOffsets.end())  continue;
+				transformedOffsets.push_back(element.AlignedByteOffset);
+
+				for (unsigned int v = 0; v < geometry.numVertices; ++v)
+				{
+					uint8_t* data = batch.vertices.data() + start + static_cast<size_t>(v) * pool.vertexSize + element.AlignedByteOffset;
+					Vector3 value;
+					std::memcpy(&value, data, sizeof(Vector3));
+					Vector4 transformed = isPosition ? world.TransformPoint(value) : world.TransformVector(value);
+					value = { transformed.x, transformed.y, transformed.z };
+					if (!isPosition)  value = Normalise(value);
+					std::memcpy(data, &value, sizeof(Vector3));
+				}
+			}
+		}
+		cell.batchedEntities.push_back(entity);
+	}
+
+	// Add each batch's geometry to the shared buffers, with 32-bit indices as a batch may have more than 65536 vertices. A cell
+	// whose geometry can't be added is left unbatched
+	std::vector<Batch> batches;
+	try
+	{
+		for (auto& [key, batch] : merged)
+		{
+			const GeometryManager::Pool& pool = *batch.source->pool;
+			unsigned int numVertices = static_cast<unsigned int>(batch.vertices.size() / pool.vertexSize);
+			unsigned int numIndices  = static_cast<unsigned int>(batch.indices.size());
+			auto range = DX->Geometry()->AddGeometry(pool.vertexElements, pool.vertexSize, batch.vertices.data(), numVertices,
+			                                         batch.indices.data(), numIndices);
+			batches.push_back({ batch.renderState, std::get<0>(key), batch.colour, range, numIndices, batch.bounds });
+		}
+	}
+	catch (const std::runtime_error&)
+	{
+		cell.batchedEntities.clear();
+		return;
+	}
+	cell.batches = std::move(batches);
+	mBatched.insert(cell.batchedEntities.begin(), cell.batchedEntities.end());
+}
+
+
+// The vertices and indices of a sub-mesh, read back from the GPU the first time. Not valid if they couldn't be read
+const StaticBatcher::SourceGeometry& StaticBatcher::GetSource(Mesh& mesh, unsigned int subMesh)
+{
+	auto [entry, added] = mSources.try_emplace({ &mesh, subMesh });
+	SourceGeometry& source = entry->second;
+	if (added)
+	{
+		auto geometry = mesh.GetSubMeshGeometry(subMesh);
+		source.valid = DX->Geometry()->ReadGeometry(*geometry.geometry, geometry.numVertices, geometry.numIndices, source.vertices, source.indices);
+	}
+	return source;
+}
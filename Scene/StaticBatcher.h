@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// Static batcher - merges the geometry of scenery that never moves into a few large draws
+//--------------------------------------------------------------------------------------
+// Islands, pillars and rocks are static entities (see EntityManager::CreateEntity), they never move once the level is loaded.
+// Drawn one at a time each costs a constant buffer upload for every node of its mesh and a draw for every sub-mesh. Instead the
+// batcher of a render group pre-transforms the vertices of its static entities into world space and merges the sub-meshes that
+// share a render state into one range of the geometry buffers (see Geometry.h), so each is drawn with an identity world matrix
+// by the usual rigid shaders - one draw per material rather than per entity and part.
+//
+// So that frustum culling still works the entities are split by the grid cell their bounding sphere's centre is in, and each
+// cell has its own batches with the bounding sphere of the entities merged into them. The geometry is built by Update for the
+// cells whose entities have been added or removed since, the vertices of each mesh are read back from the GPU once and kept.
+// Entities that can't be batched are left to be rendered as usual:
+//   - templates with lower levels of detail or impostors, a batch can't change detail entity by entity
+//   - skinned meshes, and meshes whose positions, normals or tangents are compressed (see ImportFlags::CompressVertices)
+//   - entities the given test rejects, e.g. those attached to others
+// Batched entities must not be moved, call Rebuild after moving any
+//
+//   batcher.Add(entity);
+//   ...
+//   batcher.Update(templatesVersion, canBatch);          // Before rendering, rebuilds the cells that have changed
+//   batcher.Render(cullFrustum, cameraPosition, projectionScale);
+//   if (!batcher.IsBatched(entity))  entity->Render(cullFrustum);
+
+#ifndef _STATIC_BATCHER_H_INCLUDED_
+#define _STATIC_BATCHER_H_INCLUDED_
+
+#include "Geometry.h"
+#include "Frustum.h"
+#include "ColourTypes.h"
+#include "Vector3.h"
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+class Entity;
+class Mesh;
+class RenderState;
+
+
+class StaticBatcher
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Width of the grid cells the entities are split into, in world units
+	static constexpr float CELL_SIZE = 400.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add or remove a static entity. Its cell is rebuilt by the next Update
+	void Add(Entity* entity);
+	void Remove(Entity* entity);
+
+	// Rebuild the cell of an entity in the next Update, e.g. when it is attached to another entity
+	void Refresh(Entity* entity);
+
+	// Put every entity back in the cell it is now in and rebuild every cell in the next Update, e.g. after entities have been moved
+	void Rebuild();
+
+	// Build the batches of the cells that have changed. The entity templates version is passed so the batches are rebuilt if
+	// templates (and the render states the batches use) have been replaced. Entities the test returns false for aren't batched.
+	// Uses the immediate context. Returns true if any cell was rebuilt, so which entities are batched may have changed
+	bool Update(uint64_t templatesVersion, const std::function<bool(Entity*)>& canBatch);
+
+	// Whether an entity is drawn by the batches, as of the last Update
+	bool IsBatched(Entity* entity);
+
+	// Draw the batches of the cells visible in the frustum (all of them if nullptr). Streamed textures are requested at the size
+	// each batch appears on screen from the given camera position and projection Y scale (none if 0, see RenderQueue::AddDraw)
+	struct RenderStats
+	{
+		uint32_t draws  = 0;
+		uint32_t culled = 0;
+	};
+	RenderStats Render(const Frustum* cullFrustum, const Vector3& cameraPosition, float projectionScale);
+
+	// Entities drawn by the batches, and their batches
+	uint32_t NumBatchedEntities()  { return mNumBatched; }
+	uint32_t NumBatches()          { return mNumBatches; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private types
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The merged geometry of the sub-meshes sharing one render state and colour in a cell
+	struct Batch
+	{
+		RenderState*           renderState;
+		uint64_t               stateKey; // Of the render state, batches are drawn in this order
+		ColourRGBA             colour;
+		GeometryManager::Range geometry;
+		unsigned int           numIndices;
+		BoundingSphere         bounds;
+	};
+
+	using CellKey = std::pair<int32_t, int32_t>; // Grid x and z
+
+	struct Cell
+	{
+		std::vector<Entity*> entities;
+		std::vector<Batch>   batches;
+		std::vector<Entity*> batchedEntities;
+		bool dirty = true;
+	};
+
+	// A sub-mesh's vertices and indices read back from the GPU, kept so rebuilding a cell doesn't wait for the GPU again
+	struct SourceGeometry
+	{
+		std::vector<uint8_t>  vertices;
+		std::vector<uint32_t> indices;
+		bool valid = false;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The grid cell of an entity from the centre of its bounding sphere
+	static CellKey CellOf(Entity* entity);
+
+	// Whether every sub-mesh of a mesh is rigid and has uncompressed positions, normals and tangents, so can be transformed
+	static bool CanTransform(Mesh& mesh);
+
+	// Build the batches of one cell from its entities
+	void BuildCell(Cell& cell, const std::function<bool(Entity*)>& canBatch);
+
+	// The vertices and indices of a sub-mesh, read back from the GPU the first time
+	const SourceGeometry& GetSource(Mesh& mesh, unsigned int subMesh);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	std::map<CellKey, Cell>              mCells;
+	std::unordered_map<Entity*, CellKey> mEntityCells;
+	std::unordered_set<Entity*>          mBatched;
+	std::vector<Batch*>                  mDrawOrder; // Every cell's batches by render state, see Render
+
+	// Geometry read back from the GPU by mesh and sub-mesh. Cleared with the batches when the templates change
+	std::map<std::pair<Mesh*, unsigned int>, SourceGeometry> mSources;
+	uint64_t mTemplatesVersion = 0;
+
+	uint32_t mNumBatched = 0;
+	uint32_t mNumBatches = 0;
+};
+
+
+#endif //_STATIC_BATCHER_H_INCLUDED_
@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// Steering system - works out which way every boat should steer to avoid other boats and obstacles
+//--------------------------------------------------------------------------------------
+
+#include "SteeringSystem.h"
+#include "EntityManager.h"
+#include "Boat.h"
+#include "Obstacle.h"
+#include "JobSystem.h"
+
+#include <emmintrin.h> // SSE2, always available on x64
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Give every boat its avoidance direction. Called by the EntityManager at the start of UpdateAll
+void SteeringSystem::Update(EntityManager& entities, JobSystem* jobSystem)
+{
+	const auto& boats = entities.View<Boat>();
+	size_t count  = boats.size();
+	size_t padded = (count + 3) & ~size_t(3);
+
+	// Padding boats are placed too far away to be within any boat's safe distance, yet not so far that their squared
+	// distance overflows
+	constexpr float FAR_AWAY = 1e15f;
+	mBoats.assign(boats.begin(), boats.end());
+	mX.assign(padded, FAR_AWAY);
+	mY.assign(padded, FAR_AWAY);
+	mZ.assign(padded, FAR_AWAY);
+	mSafeDistance.resize(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		Vector3 position = mBoats[i]->Transform().Position();
+		mX[i] = position.x;
+		mY[i] = position.y;
+		mZ[i] = position.z;
+		mSafeDistance[i] = mBoats[i]->GetSteering().safeBoatDistance;
+	}
+
+	// Each boat's direction only depends on the arrays, so the boats can be shared between threads in any order
+	auto steer = [this, &entities](size_t, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; ++i)  mBoats[i]->SetAvoidance(BoatAvoidance(entities, i));
+	};
+	if (jobSystem != nullptr && count > PARALLEL_BOATS)  jobSystem->ParallelFor(count, PARALLEL_BOATS / 4, steer);
+	else                                                 steer(0, 0, count);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Avoidance direction of the boat at the given index in the arrays
+Vector3 SteeringSystem::BoatAvoidance(EntityManager& entities, size_t boat)
+{
+	Vector3 myPos = { mX[boat], mY[boat], mZ[boat] };
+	float safeDistance = mSafeDistance[boat];
+
+	// Push away from each other boat within the safe distance, by 1 - distance / safeDistance along the unit offset. The boat
+	// itself (and any boat at the same point) is skipped by the minimum distance
+	const __m128 x = _mm_set1_ps(myPos.x);
+	const __m128 y = _mm_set1_ps(myPos.y);
+	const __m128 z = _mm_set1_ps(myPos.z);
+	const __m128 safeSquared    = _mm_set1_ps(safeDistance * safeDistance);
+	const __m128 invSafe        = _mm_set1_ps(1.0f / safeDistance);
+	const __m128 minimumSquared = _mm_set1_ps(0.0001f * 0.0001f);
+	const __m128 one            = _mm_set1_ps(1.0f);
+	__m128 awayX = _mm_setzero_ps();
+	__m128 awayY = _mm_setzero_ps();
+	__m128 awayZ = _mm_setzero_ps();
+	for (size_t j = 0; j < mX.size(); j += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(&mX[j]), x);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(&mY[j]), y);
+		__m128 dz = _mm_sub_ps(_mm_loadu_ps(&mZ[j]), z);
+		__m128 distSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		__m128 inRange = _mm_and_ps(_mm_cmplt_ps(distSquared, safeSquared), _mm_cmpgt_ps(distSquared, minimumSquared));
+		if (_mm_movemask_ps(inRange) == 0)  continue;
+
+		// factor / dist so the offset needn't be normalised separately. Out of range lanes may divide by zero, but are masked off
+		__m128 dist   = _mm_sqrt_ps(distSquared);
+		__m128 factor = _mm_div_ps(_mm_sub_ps(one, _mm_mul_ps(dist, invSafe)), dist);
+		factor = _mm_and_ps(factor, inRange);
+		awayX = _mm_sub_ps(awayX, _mm_mul_ps(dx, factor));
+		awayY = _mm_sub_ps(awayY, _mm_mul_ps(dy, factor));
+		awayZ = _mm_sub_ps(awayZ, _mm_mul_ps(dz, factor));
+	}
+	alignas(16) float sums[3][4];
+	_mm_store_ps(sums[0], awayX);
+	_mm_store_ps(sums[1], awayY);
+	_mm_store_ps(sums[2], awayZ);
+	Vector3 avoidance = { sums[0][0] + sums[0][1] + sums[0][2] + sums[0][3],
+	                      sums[1][0] + sums[1][1] + sums[1][2] + sums[1][3],
+	                      sums[2][0] + sums[2][1] + sums[2][2] + sums[2][3] };
+
+	// Push away from the centre of each obstacle within NEAR_OBSTACLE_DISTANCE in the same way. The navigation grid knows
+	// where there are no obstacles that close, so most of the time the obstacle tree isn't searched at all
+	constexpr float OBSTACLE_DISTANCE = NavigationField::NEAR_OBSTACLE_DISTANCE;
+	if (entities.Navigation().IsNearObstacle(myPos))
+	{
+		entities.ObstacleTree().QuerySphere(myPos, OBSTACLE_DISTANCE, [&](Obstacle* obstacle)
+		{
+			const AABB& box = obstacle->GetAABB();
+			Vector3 offset = myPos - (box.min + box.max) * 0.5f;
+			float dist = offset.Length();
+			if (dist > OBSTACLE_DISTANCE)  return; // Box is within range but its centre isn't
+			avoidance += Normalise(offset) * (1.0f - dist / OBSTACLE_DISTANCE);
+		});
+	}
+	return avoidance;
+}
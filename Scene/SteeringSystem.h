@@ -0,0 +1,55 @@
+//--------------------------------------------------------------------------------------
+// Steering system - works out which way every boat should steer to avoid other boats and obstacles
+//--------------------------------------------------------------------------------------
+// Once per UpdateAll, before any entity is updated, the EntityManager has this system gather every boat's position into
+// tightly packed arrays and work out the avoidance direction of all of them together: the sum of the pushes away from each
+// other boat within the boat's SafeBoatDistance and each obstacle within NavigationField::NEAR_OBSTACLE_DISTANCE, stronger
+// the closer they are. The boat-to-boat part tests four other boats at a time with SSE. Each boat is given its result,
+// which Boat::HandleCollisionAvoidance then blends with its heading.
+//
+// The directions are taken from the positions at the start of the update, so they don't depend on the order the boats are
+// updated in, and each boat's is worked out independently so large fleets are split across the job system's threads
+
+#ifndef _STEERING_SYSTEM_H_INCLUDED_
+#define _STEERING_SYSTEM_H_INCLUDED_
+
+#include "Vector3.h"
+
+#include <vector>
+
+
+class EntityManager;
+class JobSystem;
+class Boat;
+
+class SteeringSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Give every boat its avoidance direction (see Boat::SetAvoidance). Called by the EntityManager at the start of UpdateAll.
+	// With a job system, fleets of more than PARALLEL_BOATS are split across its threads
+	void Update(EntityManager& entities, JobSystem* jobSystem);
+
+	static constexpr size_t PARALLEL_BOATS = 256;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Avoidance direction of the boat at the given index in the arrays
+	Vector3 BoatAvoidance(EntityManager& entities, size_t boat);
+
+	// Structure of arrays, one element per boat. The positions are padded to a multiple of four with boats far
+	// outside the world so the SSE loop needs no special case for the last few
+	std::vector<Boat*> mBoats;
+	std::vector<float> mX;
+	std::vector<float> mY;
+	std::vector<float> mZ;
+	std::vector<float> mSafeDistance;
+};
+
+
+#endif //_STEERING_SYSTEM_H_INCLUDED_
@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// Team blackboard - what each team knows about its enemies, and which boat goes after which
+//--------------------------------------------------------------------------------------
+
+#include "TeamBlackboard.h"
+#include "EntityManager.h"
+#include "Boat.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Bring the teams' knowledge up to date and give every boat its assignment. Called by the EntityManager at the start of
+// UpdateAll, after the sensors have been refreshed
+void TeamBlackboard::Update(EntityManager& entities, float frameTime)
+{
+	mTime += frameTime;
+
+	// Forget enemies that are gone or haven't been heard of for a while, and let the damage done by the rest fade
+	float fade = std::exp2(-frameTime / THREAT_HALF_LIFE);
+	for (auto& known : mTeams)
+	{
+		std::erase_if(known, [&](const KnownEnemy& enemy)
+		{
+			Boat* boat = entities.GetEntity<Boat>(enemy.id);
+			return boat == nullptr || boat->IsDestroyed() || mTime - enemy.lastKnown > FORGET_TIME;
+		});
+		for (KnownEnemy& enemy : known)
+		{
+			enemy.recentDamage *= fade;
+			enemy.attackers = 0;
+		}
+	}
+
+	// Everything the patrolling boats can see becomes known to their team
+	const auto& boats = entities.View<Boat>();
+	const SensorSystem& sensors = entities.Sensors();
+	for (Boat* boat : boats)
+	{
+		int team = static_cast<int>(boat->GetTeam());
+		for (EntityID enemyID : sensors.VisibleEnemies(boat))
+		{
+			Boat* enemy = entities.GetEntity<Boat>(enemyID);
+			if (enemy != nullptr && !enemy->IsDestroyed())  Know(team, enemy);
+		}
+	}
+
+	// Patrolling boats that can see enemies are given one to attack, going through the boats in the same order each update so
+	// the assignments don't change from run to run
+	for (Boat* boat : boats)
+	{
+		uint32_t index = EntityIndex(boat->GetID());
+		if (index >= mAssignments.size())  mAssignments.resize(index + 1);
+		mAssignments[index] = { boat->GetID(), NO_ID, NO_ID };
+		if (boat->GetState() != Boat::State::Patrol)  continue;
+
+		// The visible enemies are nearest first, so the nearest is taken of those equally worth attacking
+		int team = static_cast<int>(boat->GetTeam());
+		KnownEnemy* best = nullptr;
+		for (EntityID enemyID : sensors.VisibleEnemies(boat))
+		{
+			int known = FindKnown(team, enemyID);
+			if (known >= 0 && (best == nullptr || Score(mTeams[team][known]) > Score(*best)))  best = &mTeams[team][known];
+		}
+		if (best == nullptr)  continue;
+		mAssignments[index].target = best->id;
+		++best->attackers;
+	}
+
+	// Then boats free to help are sent towards enemies that teammates nearby have asked for help with
+	for (Boat* boat : boats)
+	{
+		Assignment& assignment = mAssignments[EntityIndex(boat->GetID())];
+		bool isFree = (boat->GetState() == Boat::State::Patrol && assignment.target == NO_ID) || boat->GetState() == Boat::State::Evade;
+		if (!isFree)  continue;
+
+		int team = static_cast<int>(boat->GetTeam());
+		Vector3 boatPos = boat->Transform().Position();
+		KnownEnemy* best = nullptr;
+		for (KnownEnemy& enemy : mTeams[team])
+		{
+			if (enemy.helpUntil <= mTime || enemy.helpAskedBy == boat->GetID())  continue;
+			if (Distance(boatPos, enemy.position) > HELP_DISTANCE)  continue;
+			if (best == nullptr || Score(enemy) > Score(*best))  best = &enemy;
+		}
+		if (best == nullptr)  continue;
+		assignment.assist = best->id;
+		++best->attackers;
+	}
+}
+
+
+// The given boat's assignment from the last update
+const TeamBlackboard::Assignment& TeamBlackboard::AssignmentOf(Boat* boat) const
+{
+	static const Assignment NONE;
+	uint32_t index = EntityIndex(boat->GetID());
+	if (index >= mAssignments.size() || mAssignments[index].owner != boat->GetID())  return NONE;
+	return mAssignments[index];
+}
+
+
+// The given enemy has hit the victim for the given damage. If askForHelp the victim's free teammates nearby will be sent
+// to help. Boats are updated on the main thread, so this can be called from Boat::Update
+void TeamBlackboard::ReportAttack(Boat* victim, Boat* attacker, float damage, bool askForHelp)
+{
+	if (attacker == nullptr || attacker->IsDestroyed())  return;
+
+	KnownEnemy& enemy = Know(static_cast<int>(victim->GetTeam()), attacker);
+	enemy.recentDamage += damage;
+	if (askForHelp)
+	{
+		enemy.helpUntil   = mTime + HELP_TIME;
+		enemy.helpAskedBy = victim->GetID();
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Entry for the given enemy in the given team's list, added if it isn't known yet
+TeamBlackboard::KnownEnemy& TeamBlackboard::Know(int team, Boat* enemy)
+{
+	int index = FindKnown(team, enemy->GetID());
+	if (index < 0)
+	{
+		index = static_cast<int>(mTeams[team].size());
+		mTeams[team].push_back({ enemy->GetID() });
+	}
+	KnownEnemy& known = mTeams[team][index];
+	known.position      = enemy->Transform().Position();
+	known.lastKnown     = mTime;
+	known.missileDamage = enemy->GetMissileDamage();
+	return known;
+}
+
+
+// Index of the entry for the given enemy in the given team's list, -1 if it isn't known. Teams only know a handful of
+// enemies at a time so a linear search is fine
+int TeamBlackboard::FindKnown(int team, EntityID enemy) const
+{
+	const auto& known = mTeams[team];
+	for (size_t i = 0; i < known.size(); ++i)
+	{
+		if (known[i].id == enemy)  return static_cast<int>(i);
+	}
+	return -1;
+}
@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// Team blackboard - what each team knows about its enemies, and which boat goes after which
+//--------------------------------------------------------------------------------------
+// Each team shares a list of the enemies its boats know about: where each was last seen and how much of a threat it is. An
+// enemy becomes known when a patrolling boat of the team sees it (see SensorSystem) or when it hits one of the team's boats,
+// and is forgotten once it is destroyed or hasn't been seen for FORGET_TIME. The threat of an enemy is the damage its
+// missiles do plus the damage it has done to the team recently (halving every THREAT_HALF_LIFE).
+//
+// Once per UpdateAll, after the sensors have been refreshed, the EntityManager has the blackboard give every boat its
+// assignment. Patrolling boats that can see enemies are given one to attack, and boats that are free to help (patrolling
+// without a target, or evading) are sent towards an enemy within HELP_DISTANCE that a teammate has asked for help with. In
+// both cases each boat takes the enemy with the highest threat shared by the number of boats already assigned to it, so the
+// team spreads its attacks over the enemies rather than all going after the nearest one. Boats read their assignment in
+// their own update instead of searching for enemies or sending each other help messages
+
+#ifndef _TEAM_BLACKBOARD_H_INCLUDED_
+#define _TEAM_BLACKBOARD_H_INCLUDED_
+
+#include "EntityTypes.h"
+#include "Vector3.h"
+
+#include <vector>
+
+
+class EntityManager;
+class Boat;
+
+class TeamBlackboard
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Enemies not seen or heard from for this long are forgotten
+	static constexpr float FORGET_TIME = 5.0f;
+
+	// Seconds for the recent damage an enemy has done to the team to halve
+	static constexpr float THREAT_HALF_LIFE = 5.0f;
+
+	// Free boats within this distance of an enemy a teammate asked for help with go to help, for HELP_TIME after the request
+	static constexpr float HELP_DISTANCE = 200.0f;
+	static constexpr float HELP_TIME     = 3.0f;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// An enemy known to a team
+	struct KnownEnemy
+	{
+		EntityID id;
+		Vector3  position;          // Where the enemy was last seen
+		float    lastKnown;         // Time it was last seen or hit the team
+		float    missileDamage;
+		float    recentDamage = 0;  // Damage done to the team, decaying
+		float    helpUntil    = 0;  // Time a request for help with this enemy runs out
+		EntityID helpAskedBy  = NO_ID;
+		int      attackers    = 0;  // Boats assigned to this enemy in the last update
+
+		float Threat() const { return missileDamage + recentDamage; }
+	};
+
+	// What a boat has been told to do in the last update. NO_ID for either if it has nothing to do
+	struct Assignment
+	{
+		EntityID owner  = NO_ID; // Shows whether the assignment belongs to the boat now in this slot
+		EntityID target = NO_ID; // Enemy to attack, one the boat can see
+		EntityID assist = NO_ID; // Enemy a teammate needs help with, to move towards
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Bring the teams' knowledge up to date and give every boat its assignment. Called by the EntityManager at the start of
+	// UpdateAll, after the sensors have been refreshed
+	void Update(EntityManager& entities, float frameTime);
+
+	// The given boat's assignment from the last update
+	const Assignment& AssignmentOf(Boat* boat) const;
+
+	// The given enemy has hit the victim for the given damage. If askForHelp the victim's free teammates nearby will be sent
+	// to help. Boats are updated on the main thread, so this can be called from Boat::Update
+	void ReportAttack(Boat* victim, Boat* attacker, float damage, bool askForHelp);
+
+	// The enemies known to a team, for display
+	const std::vector<KnownEnemy>& KnownEnemies(int team) const  { return mTeams[team]; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Entry for the given enemy in the given team's list, added if it isn't known yet
+	KnownEnemy& Know(int team, Boat* enemy);
+
+	// Index of the entry for the given enemy in the given team's list, -1 if it isn't known
+	int FindKnown(int team, EntityID enemy) const;
+
+	// How worth attacking an enemy is, its threat shared between the boats already assigned to it
+	static float Score(const KnownEnemy& known)  { return known.Threat() / (1 + known.attackers); }
+
+	static constexpr int NUM_TEAMS = 3; // See Team in Boat.h
+	std::vector<KnownEnemy> mTeams[NUM_TEAMS];
+
+	// Indexed by the boat's slot index (see EntityTypes.h)
+	std::vector<Assignment> mAssignments;
+
+	float mTime = 0.0f; // Total update time
+};
+
+
+#endif //_TEAM_BLACKBOARD_H_INCLUDED_
@@ -0,0 +1,163 @@
+//--------------------------------------------------------------------------------------
+// Hierarchical timer wheel - holds items until a given number of ticks has passed
+//--------------------------------------------------------------------------------------
+// Adding an item and advancing by a tick both take constant time, however many items are waiting and however far in the
+// future they are due, and nothing is done for an item while it waits. The wheel has several levels of slots, each level's
+// slots covering 64 times as many ticks as the level below. An item goes into the lowest level whose range reaches the tick
+// it is due. When the slots of a level have all been passed, the items in the next slot of the level above are moved down
+// into the lower levels, so each item is moved at most once per level before it is due.
+//
+//   TimerWheel<Message> wheel;
+//   wheel.Add(120, message);                       // Due 120 ticks from now
+//   wheel.Tick([](Message&& due) { Deliver(due); }); // Call once per tick
+
+#ifndef _TIMER_WHEEL_H_INCLUDED_
+#define _TIMER_WHEEL_H_INCLUDED_
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <stdint.h>
+
+
+template <typename T>
+class TimerWheel
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add an item that is due the given number of ticks from now. Items due 0 ticks from now are treated as due on the next
+	// tick and items due further ahead than MAX_TICKS are due after MAX_TICKS
+	void Add(uint64_t ticks, T item)
+	{
+		if (ticks < 1)          ticks = 1;
+		if (ticks > MAX_TICKS)  ticks = MAX_TICKS;
+		Insert({ mNow + ticks, mNextSequence++, std::move(item) });
+		++mSize;
+	}
+
+	// Advance by one tick, calling the given function with each item that is now due (as an rvalue T&&). Items due on the
+	// same tick are passed in the order they were added. The function must not add items to this wheel
+	template <typename Function>
+	void Tick(Function&& function)
+	{
+		++mNow;
+
+		// Move items down from any levels whose next slot has been reached. Higher levels go first so those items can
+		// reach the lowest level in one step
+		for (int level = NUM_LEVELS - 1; level > 0; --level)
+		{
+			if ((mNow & ((1ull << (SLOT_BITS * level)) - 1)) != 0)  continue;
+
+			auto& slot = mSlots[level][(mNow >> (SLOT_BITS * level)) & SLOT_MASK];
+			mCascade.swap(slot);
+			for (auto& entry : mCascade)  Insert(std::move(entry));
+			mCascade.clear();
+		}
+
+		// Everything in the current slot of the lowest level is due now. Items that were moved down from a higher level may
+		// have arrived after items added later, so they are put back in the order they were added
+		auto& due = mSlots[0][mNow & SLOT_MASK];
+		mCascade.swap(due);
+		mSize -= mCascade.size();
+		if (mCascade.size() > 1)
+		{
+			std::sort(mCascade.begin(), mCascade.end(), [](const Entry& a, const Entry& b) { return a.sequence < b.sequence; });
+		}
+		for (auto& entry : mCascade)  function(std::move(entry.item));
+		mCascade.clear();
+	}
+
+	// Remove every waiting item for which the given predicate returns true, keeping the rest in the order they were added.
+	// Visits every waiting item, so use for occasional clean-ups rather than every tick. Returns the number removed
+	template <typename Predicate>
+	size_t RemoveIf(Predicate&& predicate)
+	{
+		size_t removed = 0;
+		for (auto& level : mSlots)
+		{
+			for (auto& slot : level)
+			{
+				if (!slot.empty())  removed += std::erase_if(slot, [&](const Entry& entry) { return predicate(entry.item); });
+			}
+		}
+		mSize -= removed;
+		return removed;
+	}
+
+	// Call function(ticks, item) for every waiting item, with the number of ticks until it is due, in the order they are
+	// due (items due on the same tick in the order they were added). Adding the items to an empty wheel in this order with
+	// these ticks gives the same wheel. Visits every waiting item, so use for occasional jobs such as saving a checkpoint
+	template <typename Function>
+	void ForEach(Function&& function) const
+	{
+		std::vector<const Entry*> waiting;
+		waiting.reserve(mSize);
+		for (auto& level : mSlots)
+		{
+			for (auto& slot : level)
+			{
+				for (auto& entry : slot)  waiting.push_back(&entry);
+			}
+		}
+		std::sort(waiting.begin(), waiting.end(), [](const Entry* a, const Entry* b)
+		{
+			return a->due != b->due ? a->due < b->due : a->sequence < b->sequence;
+		});
+		for (const Entry* entry : waiting)  function(entry->due - mNow, entry->item);
+	}
+
+	// Remove every waiting item
+	void Clear()
+	{
+		for (auto& level : mSlots)
+		{
+			for (auto& slot : level)  slot.clear();
+		}
+		mSize = 0;
+	}
+
+	// Number of items waiting
+	size_t Size() const  { return mSize; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// 64 slots per level and four levels cover 2^24 ticks, e.g. over 46 hours with 10ms ticks
+	static constexpr int      SLOT_BITS  = 6;
+	static constexpr uint64_t SLOT_MASK  = (1ull << SLOT_BITS) - 1;
+	static constexpr int      NUM_LEVELS = 4;
+	static constexpr uint64_t MAX_TICKS  = (1ull << (SLOT_BITS * NUM_LEVELS)) - 1;
+
+	struct Entry
+	{
+		uint64_t due;      // Tick the item is due on
+		uint64_t sequence; // Order the item was added in
+		T        item;
+	};
+
+	// Put an entry in the slot for its due tick in the lowest level that reaches it
+	void Insert(Entry&& entry)
+	{
+		uint64_t ticks = entry.due - mNow;
+		int level = 0;
+		while (level < NUM_LEVELS - 1 && ticks >= (1ull << (SLOT_BITS * (level + 1))))  ++level;
+		mSlots[level][(entry.due >> (SLOT_BITS * level)) & SLOT_MASK].push_back(std::move(entry));
+	}
+
+	// The slots of each level. The vectors are emptied with clear() so they keep their capacity
+	std::vector<Entry> mSlots[NUM_LEVELS][1 << SLOT_BITS];
+
+	// Items being moved down a level or passed to the caller, kept to reuse its capacity
+	std::vector<Entry> mCascade;
+
+	uint64_t mNow  = 0; // Ticks so far
+	uint64_t mNextSequence = 0;
+	size_t   mSize = 0;
+};
+
+
+#endif //_TIMER_WHEEL_H_INCLUDED_
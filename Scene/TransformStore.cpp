@@ -0,0 +1,132 @@
+//--------------------------------------------------------------------------------------
+// Shared storage for entity transformation matrices
+//--------------------------------------------------------------------------------------
+
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Root matrix for the given slot index, the page holding it is allocated when first needed
+Matrix4x4& TransformStore::Root(uint32_t index)
+{
+	uint32_t page = index / PAGE_SIZE;
+	while (mRootPages.size() <= page)  mRootPages.push_back(std::make_unique<Matrix4x4[]>(PAGE_SIZE));
+
+	return mRootPages[page][index % PAGE_SIZE];
+}
+
+
+// Return space for the given number of (non-root) node matrices, all next to each other. Returns nullptr if count is 0
+Matrix4x4* TransformStore::AllocateNodes(uint32_t count)
+{
+	if (count == 0)  return nullptr;
+
+	// Reuse a range freed by an earlier entity if there is one of the right size
+	if (count < mFreeNodes.size() && !mFreeNodes[count].empty())
+	{
+		Matrix4x4* nodes = mFreeNodes[count].back();
+		mFreeNodes[count].pop_back();
+		return nodes;
+	}
+
+	// Meshes with a very large number of nodes get a page of their own. It is put at the front of the list of pages so the last
+	// page, which new ranges are taken from, is unchanged
+	if (count > PAGE_SIZE)
+	{
+		mNodePages.insert(mNodePages.begin(), std::make_unique<Matrix4x4[]>(count));
+		return mNodePages.front().get();
+	}
+
+	// Otherwise take the range from the end of the last page, starting a new page if there isn't enough room. Any space left
+	// at the end of the old page is wasted, but ranges are generally small compared to the page size
+	if (mNodePageUsed + count > PAGE_SIZE)
+	{
+		mNodePages.push_back(std::make_unique<Matrix4x4[]>(PAGE_SIZE));
+		mNodePageUsed = 0;
+	}
+	Matrix4x4* nodes = mNodePages.back().get() + mNodePageUsed;
+	mNodePageUsed += count;
+	return nodes;
+}
+
+
+// Return space from AllocateNodes to the store for reuse, pass the same count as was used to allocate it
+void TransformStore::FreeNodes(Matrix4x4* nodes, uint32_t count)
+{
+	if (nodes == nullptr || count == 0)  return;
+
+	if (mFreeNodes.size() <= count)  mFreeNodes.resize(count + 1);
+	mFreeNodes[count].push_back(nodes);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Interpolation between simulation steps
+-----------------------------------------------------------------------------------------*/
+
+// Copy all root matrices as the previous ones, call before each simulation step
+void TransformStore::SavePreviousRoots()
+{
+	while (mPreviousRootPages.size() < mRootPages.size())  mPreviousRootPages.push_back(std::make_unique<Matrix4x4[]>(PAGE_SIZE));
+	for (size_t page = 0; page < mRootPages.size(); ++page)
+	{
+		std::memcpy(mPreviousRootPages[page].get(), mRootPages[page].get(), PAGE_SIZE * sizeof(Matrix4x4));
+	}
+}
+
+
+// Set the previous root matrix for the given slot index to its current one
+void TransformStore::ResetPreviousRoot(uint32_t index)
+{
+	uint32_t page = index / PAGE_SIZE;
+	while (mPreviousRootPages.size() <= page)  mPreviousRootPages.push_back(std::make_unique<Matrix4x4[]>(PAGE_SIZE));
+	mPreviousRootPages[page][index % PAGE_SIZE] = Root(index);
+}
+
+
+// Previous root matrix for the given slot index
+const Matrix4x4& TransformStore::PreviousRoot(uint32_t index)
+{
+	uint32_t page = index / PAGE_SIZE;
+	if (page >= mPreviousRootPages.size())  return Root(index);
+	return mPreviousRootPages[page][index % PAGE_SIZE];
+}
+
+
+// Replace each root matrix with a blend from the previous one (t = 0) to the current one (t = 1)
+void TransformStore::BlendRoots(float t)
+{
+	while (mHeldRootPages.size() < mRootPages.size())  mHeldRootPages.push_back(std::make_unique<Matrix4x4[]>(PAGE_SIZE));
+
+	// Pages added since the last SavePreviousRoots have no previous matrices, those are left as they are
+	size_t numPages = std::min(mRootPages.size(), mPreviousRootPages.size());
+	for (size_t page = 0; page < numPages; ++page)
+	{
+		float* current = &mRootPages[page][0].e00;
+		const float* previous = &mPreviousRootPages[page][0].e00;
+		std::memcpy(mHeldRootPages[page].get(), current, PAGE_SIZE * sizeof(Matrix4x4));
+
+		// A plain loop over the floats of the page, which the compiler vectorises
+		for (uint32_t i = 0; i < PAGE_SIZE * 16; ++i)  current[i] = previous[i] + (current[i] - previous[i]) * t;
+	}
+	mRootsBlended = true;
+}
+
+
+// Put back the root matrices that BlendRoots replaced
+void TransformStore::RestoreRoots()
+{
+	if (!mRootsBlended)  return;
+	size_t numPages = std::min(mRootPages.size(), mPreviousRootPages.size());
+	for (size_t page = 0; page < numPages; ++page)
+	{
+		std::memcpy(mRootPages[page].get(), mHeldRootPages[page].get(), PAGE_SIZE * sizeof(Matrix4x4));
+	}
+	mRootsBlended = false;
+}
@@ -0,0 +1,108 @@
+//--------------------------------------------------------------------------------------
+// Shared storage for entity transformation matrices
+//--------------------------------------------------------------------------------------
+// Each entity has a root matrix (its world matrix) and a parent-relative matrix for each other node in its mesh. Rather than
+// each entity holding its own separately allocated array of matrices, the EntityManager keeps all of them in this store:
+//
+// - Root matrices are kept together, indexed by the entity's slot index (see EntityTypes.h). So root matrices of all entities
+//   are packed side by side and code that looks at many entity positions (distance checks, picking etc.) reads memory in order
+//   rather than jumping to a different heap block for each entity
+// - The matrices for the other nodes of an entity are kept together in a single range. Ranges are packed one after another,
+//   so the node matrices of entities created together (e.g. all the boats in a level) are also next to each other
+// - Entities with more than a root node also keep their world matrices in a node range, see Entity::WorldTransforms
+//
+// Matrices are held in fixed-size pages that never move once allocated, so pointers and references to them (e.g. from
+// Entity::Transform) stay valid as more entities are created. Node ranges of destroyed entities are reused by later entities
+// with the same number of nodes
+//
+// The store is not thread-safe - only create/destroy entities from one thread (the matrices themselves can be used as normal)
+//
+// For a simulation run in fixed steps (see Scene::Update) the store also keeps a copy of the root matrices from before the
+// latest step. Rendering can then show the entities part way between the two steps with BlendRoots, putting the latest
+// matrices back with RestoreRoots afterwards
+
+#ifndef _TRANSFORM_STORE_H_INCLUDED_
+#define _TRANSFORM_STORE_H_INCLUDED_
+
+#include "Matrix4x4.h"
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+
+class TransformStore
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	TransformStore() = default;
+
+	// Prevent copying - entities hold pointers into the store
+	TransformStore(const TransformStore&) = delete;
+	TransformStore& operator=(const TransformStore&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Root matrix for the given slot index, the page holding it is allocated when first needed
+	Matrix4x4& Root(uint32_t index);
+
+	// Return space for the given number of (non-root) node matrices, all next to each other. Returns nullptr if count is 0
+	Matrix4x4* AllocateNodes(uint32_t count);
+
+	// Return space from AllocateNodes to the store for reuse, pass the same count as was used to allocate it
+	void FreeNodes(Matrix4x4* nodes, uint32_t count);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Interpolation between simulation steps
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Copy all root matrices as the previous ones, call before each simulation step
+	void SavePreviousRoots();
+
+	// Set the previous root matrix for the given slot index to its current one, so a new entity doesn't blend from whatever
+	// entity used the slot before. The EntityManager does this when creating an entity
+	void ResetPreviousRoot(uint32_t index);
+
+	// Previous root matrix for the given slot index, see SavePreviousRoots
+	const Matrix4x4& PreviousRoot(uint32_t index);
+
+	// Replace each root matrix with a blend from the previous one (t = 0) to the current one (t = 1). The matrices are blended
+	// element by element, which slightly shrinks a turning entity part way through a step. Steps are short enough that this
+	// doesn't show. Call RestoreRoots before changing any matrices
+	void BlendRoots(float t);
+
+	// Put back the root matrices that BlendRoots replaced
+	void RestoreRoots();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Number of matrices in each page
+	static constexpr uint32_t PAGE_SIZE = 256;
+
+	// Root matrices, Root(index) is in page index / PAGE_SIZE
+	std::vector<std::unique_ptr<Matrix4x4[]>> mRootPages;
+
+	// Root matrices from before the latest simulation step, and those replaced by BlendRoots. Same layout as mRootPages
+	std::vector<std::unique_ptr<Matrix4x4[]>> mPreviousRootPages;
+	std::vector<std::unique_ptr<Matrix4x4[]>> mHeldRootPages;
+	bool mRootsBlended = false;
+
+	// Node matrices, new ranges are taken from the end of the last page
+	std::vector<std::unique_ptr<Matrix4x4[]>> mNodePages;
+	uint32_t mNodePageUsed = PAGE_SIZE; // Matrices used in the last node page, starts "full" so the first allocation adds a page
+
+	// Freed node ranges, indexed by their size
+	std::vector<std::vector<Matrix4x4*>> mFreeNodes;
+};
+
+
+#endif //_TRANSFORM_STORE_H_INCLUDED_
@@ -0,0 +1,115 @@
+//--------------------------------------------------------------------------------------
+// Trigger volumes - spheres around entities that send messages when other entities enter or leave them
+//--------------------------------------------------------------------------------------
+
+#include "TriggerSystem.h"
+#include "SceneGlobals.h"
+
+#include <algorithm>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Give an entity a trigger volume, replacing any trigger it already has
+void TriggerSystem::Add(Entity* owner, const TriggerVolume& volume)
+{
+	uint32_t index = EntityIndex(owner->GetID());
+	if (index >= mTriggerIndex.size())  mTriggerIndex.resize(index + 1, NO_TRIGGER);
+
+	if (mTriggerIndex[index] != NO_TRIGGER)
+	{
+		mTriggers[mTriggerIndex[index]].volume = volume;
+		return;
+	}
+
+	mTriggerIndex[index] = static_cast<uint32_t>(mTriggers.size());
+	mTriggers.push_back({ owner, volume });
+}
+
+
+// Remove an entity's trigger volume, does nothing if it doesn't have one
+void TriggerSystem::Remove(Entity* owner)
+{
+	uint32_t index = EntityIndex(owner->GetID());
+	if (index >= mTriggerIndex.size() || mTriggerIndex[index] == NO_TRIGGER)  return;
+
+	// Move the last trigger into the gap
+	uint32_t position = mTriggerIndex[index];
+	if (position != mTriggers.size() - 1)
+	{
+		mTriggers[position] = std::move(mTriggers.back());
+		mTriggerIndex[EntityIndex(mTriggers[position].owner->GetID())] = position;
+	}
+	mTriggers.pop_back();
+	mTriggerIndex[index] = NO_TRIGGER;
+}
+
+
+// Find the entities inside each trigger and send the enter and exit messages. Returns the owners of one-shot triggers that fired
+const std::vector<EntityID>& TriggerSystem::Update(const SpatialGrid& grid)
+{
+	mFiredOwners.clear();
+	for (auto& trigger : mTriggers)
+	{
+		if (trigger.fired)  continue;
+
+		const TriggerVolume& volume = trigger.volume;
+		Vector3 centre = trigger.owner->Transform().Position();
+
+		if (volume.oneShot)
+		{
+			// Only the nearest entity is sent the message, and the trigger is then finished with
+			Entity* nearest = grid.QueryNearest(centre, volume.targetMask, volume.radius, [&](Entity* entity)
+			{
+				return entity != trigger.owner;
+			});
+			if (nearest != nullptr)
+			{
+				gMessenger->DeliverMessage(trigger.owner->GetID(), nearest->GetID(), volume.enterMessage, volume.enterData);
+				trigger.fired = true;
+				mFiredOwners.push_back(trigger.owner->GetID());
+			}
+			continue;
+		}
+
+		// Sorted list of the entities inside the trigger now, compared with the list from the last update to find the
+		// entities that have entered or left. Messages are sent in ID order so they are the same each run
+		mNowInside.clear();
+		grid.QueryRadius(centre, volume.radius, volume.targetMask, [&](Entity* entity)
+		{
+			if (entity != trigger.owner)  mNowInside.push_back(entity->GetID());
+		});
+		std::sort(mNowInside.begin(), mNowInside.end());
+
+		auto wasInside = trigger.inside.begin();
+		auto isInside  = mNowInside.begin();
+		while (wasInside != trigger.inside.end() || isInside != mNowInside.end())
+		{
+			if (isInside == mNowInside.end() || (wasInside != trigger.inside.end() && *wasInside < *isInside))
+			{
+				// Was inside and no longer is, no message for entities that have been destroyed
+				if (volume.sendExitMessage && gEntityManager->IsAlive(*wasInside))
+				{
+					gMessenger->DeliverMessage(trigger.owner->GetID(), *wasInside, volume.exitMessage, volume.exitData);
+				}
+				++wasInside;
+			}
+			else if (wasInside == trigger.inside.end() || *isInside < *wasInside)
+			{
+				// Newly inside
+				gMessenger->DeliverMessage(trigger.owner->GetID(), *isInside, volume.enterMessage, volume.enterData);
+				++isInside;
+			}
+			else
+			{
+				// Still inside
+				++wasInside;
+				++isInside;
+			}
+		}
+		std::swap(trigger.inside, mNowInside);
+	}
+	return mFiredOwners;
+}
@@ -0,0 +1,91 @@
+//--------------------------------------------------------------------------------------
+// Trigger volumes - spheres around entities that send messages when other entities enter or leave them
+//--------------------------------------------------------------------------------------
+// Rather than each mine or crate looking for boats in its own Update, an entity can give itself a trigger volume and the
+// EntityManager checks all triggers together once per UpdateAll, after every entity has moved. Each trigger uses the
+// spatial grid to find the entities inside it, so the cost depends on the number of triggers and what is near them, not on
+// the total number of entities. When an entity enters the trigger (it is inside this update but was not last update) the
+// trigger's enter message is sent from the trigger's owner to that entity, and similarly for the exit message when it leaves.
+//
+// A trigger can be one-shot (e.g. a mine): the first time anything enters it the message is sent to the nearest entity that
+// entered and the owner is destroyed.
+//
+// Triggers are added by the owning entity, usually in its constructor, and are removed automatically when it is destroyed:
+//     TriggerVolume trigger;
+//     trigger.radius       = 15.0f;
+//     trigger.enterMessage = MessageType::MineHit;
+//     trigger.oneShot      = true;
+//     gEntityManager->Triggers().Add(this, trigger);
+
+#ifndef _TRIGGER_SYSTEM_H_INCLUDED_
+#define _TRIGGER_SYSTEM_H_INCLUDED_
+
+#include "Entity.h"
+#include "Messenger.h"
+#include "SpatialGrid.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+// Settings for a trigger volume, a sphere centred on the owner's position
+struct TriggerVolume
+{
+	float       radius     = 10.0f;
+	uint32_t    targetMask = SPATIAL_BOAT; // Spatial types that set off the trigger, see SpatialGrid.h
+
+	// Message sent to each entity that enters the trigger, and its payload
+	MessageType enterMessage = MessageType::Hit;
+	MessageData enterData    = {};
+
+	// Optional message sent to each entity that leaves the trigger. Entities that leave by being destroyed are not sent it
+	bool        sendExitMessage = false;
+	MessageType exitMessage     = MessageType::Hit;
+	MessageData exitData        = {};
+
+	// A one-shot trigger only sends its enter message once, to the nearest entity, and then its owner is destroyed
+	bool        oneShot = false;
+};
+
+
+class TriggerSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Give an entity a trigger volume, replacing any trigger it already has
+	void Add(Entity* owner, const TriggerVolume& volume);
+
+	// Remove an entity's trigger volume, does nothing if it doesn't have one. The EntityManager does this when the owner is destroyed
+	void Remove(Entity* owner);
+
+	// Find the entities inside each trigger using the given grid and send the enter and exit messages. Called by the EntityManager
+	// once all entities have been updated. Returns the owners of one-shot triggers that fired, to be destroyed by the caller
+	const std::vector<EntityID>& Update(const SpatialGrid& grid);
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct Trigger
+	{
+		Entity*               owner;
+		TriggerVolume         volume;
+		std::vector<EntityID> inside; // Entities inside the trigger at the last update, sorted
+		bool                  fired = false; // One-shot trigger has gone off, waiting for its owner to be destroyed
+	};
+	std::vector<Trigger> mTriggers;
+
+	// Position of each owner's trigger in mTriggers, indexed by the owner's slot index (see EntityTypes.h)
+	static constexpr uint32_t NO_TRIGGER = UINT32_MAX;
+	std::vector<uint32_t> mTriggerIndex;
+
+	// Working lists for Update, kept to avoid reallocating them every frame
+	std::vector<EntityID> mNowInside;
+	std::vector<EntityID> mFiredOwners;
+};
+
+
+#endif //_TRIGGER_SYSTEM_H_INCLUDED_
@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------
+// Type tags - compile time type IDs for entity and template classes, to check their types without dynamic_cast
+//--------------------------------------------------------------------------------------
+// Each tagged class has a bit of its own (see TypeTag), and each entity and template holds a mask of the bits of every tagged
+// class it is. So checking whether an Entity* is a Boat is one test against a constant rather than the RTTI search of the
+// inheritance chain that dynamic_cast does. A class is tagged by also inheriting from TaggedType, passing its own class name
+// and its tag, after Entity (or EntityTemplate) or the tagged class it derives from:
+//     class Boat : public Entity, public TaggedType<Boat, TypeTag::Boat>
+//
+// TaggedType's constructor adds the class's bit to the mask, after the base class has been constructed, so a tagged class
+// derived from another tagged class has both bits without any other change to its constructors. TypeCast then casts with a
+// test of the mask for tagged classes, statically for casts to a base class and with dynamic_cast for untagged classes:
+//     if (Boat* boat = TypeCast<Boat>(entity))  ...
+//     entity->Is<Missile>()
+//
+// A tagged class deriving from another needs "using TaggedType<Derived, TypeTag::Derived>::TaggedClass;" (and TYPE_BIT), as
+// it inherits both tags' names. Without it the class is still cast correctly, with dynamic_cast
+
+#ifndef _TYPE_TAG_H_INCLUDED_
+#define _TYPE_TAG_H_INCLUDED_
+
+#include <type_traits>
+#include <stdint.h>
+
+
+// The tagged classes, one bit each in a TypeMask
+enum class TypeTag : uint32_t
+{
+	Boat,
+	Missile,
+	RandomCrate,
+	SeaMine,
+	Shield,
+	ReloadStation,
+	Obstacle,
+	BoatTemplate,
+};
+
+using TypeMask = uint32_t;
+
+
+// Gives the class Derived the bit of the given tag in the type mask of its Entity or EntityTemplate base (see top of file)
+template <typename Derived, TypeTag Tag>
+class TaggedType
+{
+public:
+	using TaggedClass = Derived;
+	static constexpr TypeMask TYPE_BIT = TypeMask(1) << static_cast<uint32_t>(Tag);
+	static_assert(static_cast<uint32_t>(Tag) < 32, "Too many type tags for the TypeMask");
+
+protected:
+	// The base holding the mask is listed before this class so is already constructed
+	TaggedType()  { static_cast<Derived*>(this)->mTypeMask |= TYPE_BIT; }
+};
+
+
+// Whether T is a tagged class, rather than a class deriving from a tagged class without a tag of its own
+template <typename T>
+constexpr bool IsTaggedType()
+{
+	if constexpr (requires { typename T::TaggedClass; })  return std::is_same_v<typename T::TaggedClass, T>;
+	else return false;
+}
+
+
+// Cast an Entity or EntityTemplate pointer to a derived class, nullptr if it isn't one (or the pointer is null). A cast to a
+// tagged class tests the type mask, to a base class is static and to any other class uses dynamic_cast
+template <typename T, typename Base>
+T* TypeCast(Base* object)
+{
+	if constexpr (std::is_base_of_v<T, Base>)  return object;
+	else if constexpr (IsTaggedType<T>())      return (object != nullptr && (object->GetTypeMask() & T::TYPE_BIT) != 0) ? static_cast<T*>(object) : nullptr;
+	else                                       return dynamic_cast<T*>(object);
+}
+
+
+#endif //_TYPE_TAG_H_INCLUDED_
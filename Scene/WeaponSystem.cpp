@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Weapon system - rebuilds the matrices of the boats' guns from their turns, once all the boats have been updated
+//--------------------------------------------------------------------------------------
+
+#include "WeaponSystem.h"
+#include "BoatComponents.h"
+#include "Boat.h"
+
+#include <algorithm>
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Rebuild the gun matrices of the boats whose guns turned this update, at the rate their size in the views allows (see top of
+// WeaponSystem.h). The turret is node 3 and the barrel node 4
+void WeaponSystem::Update(BoatComponents& boats)
+{
+	auto&       weapons = boats.WeaponArray();
+	const auto& owners  = boats.Boats();
+	mStats = {};
+	++mUpdateCount;
+	for (size_t boat = 0; boat < weapons.size(); ++boat)
+	{
+		if (!weapons[boat].gunsTurned)  continue;
+
+		if (mLevelOfDetail)
+		{
+			// The largest the boat is in any view it may be visible in, zero if it is in none
+			BoundingSphere bounds = owners[boat]->GetWorldBoundingSphere();
+			float screenSize = 0;
+			for (const View& view : mViews)
+			{
+				if (!view.frustum.IsSphereVisible(bounds))  continue;
+				float distance = Distance(view.cameraPosition, bounds.centre);
+				if (distance <= bounds.radius)
+				{
+					screenSize = FULL_RATE_SCREEN_SIZE; // Camera inside the boat's bounds
+					break;
+				}
+				screenSize = std::max(screenSize, bounds.radius * view.projectionScale / distance);
+			}
+
+			if (screenSize < MIN_SCREEN_SIZE || (screenSize < FULL_RATE_SCREEN_SIZE && (mUpdateCount + boat) % REDUCED_RATE_INTERVAL != 0))
+			{
+				++mStats.skipped;
+				continue;
+			}
+			if (screenSize < FULL_RATE_SCREEN_SIZE)  ++mStats.reducedRate;
+			else                                     ++mStats.fullRate;
+		}
+		else
+		{
+			++mStats.fullRate;
+		}
+
+		owners[boat]->Transform(3) = weapons[boat].gunTurret.ToMatrix();
+		owners[boat]->Transform(4) = weapons[boat].gunBarrel.ToMatrix();
+		weapons[boat].gunsTurned = false;
+	}
+}
@@ -0,0 +1,93 @@
+//--------------------------------------------------------------------------------------
+// Weapon system - rebuilds the matrices of the boats' guns from their turns, once all the boats have been updated
+//--------------------------------------------------------------------------------------
+// Boats turn their gun turrets and barrels in TRS form as they patrol and aim (see BoatWeapon in BoatComponents.h), which
+// doesn't build up errors as a matrix turned a little every update would. After every entity has been updated the
+// EntityManager has this system rebuild the turret and barrel matrices of the boats whose guns turned, in one pass over the
+// weapon array. Boats that didn't think this update (see AIScheduler.h) left their guns alone, so they are skipped.
+//
+// The gun matrices are only for show, aiming and firing use the TRS and the boat's root matrix. So with animation level of
+// detail on (the default) the matrices of boats that are small on screen are rebuilt only every few updates, and those of boats
+// tiny on screen or outside every view not at all. Their TRS keep turning, and gunsTurned stays set until the matrices are
+// rebuilt, so they catch up in one step once the boat is rebuilt again. A node whose matrix isn't rebuilt is unchanged, so the
+// boat's kept world matrices aren't recalculated for it either (see Entity::WorldTransforms). The views are those rendered in the
+// last frame, added by the scene each frame; with none (e.g. headless) no gun matrices are rebuilt:
+//
+//   gEntityManager->Weapons().ClearViews();  // Each frame before rendering
+//   gEntityManager->Weapons().AddView(camera->GetFrustum(), camera->Transform().Position(), camera->GetProjectionMatrix().e11);
+
+#ifndef _WEAPON_SYSTEM_H_INCLUDED_
+#define _WEAPON_SYSTEM_H_INCLUDED_
+
+#include "Vector3.h"
+#include "Frustum.h"
+
+#include <vector>
+#include <stdint.h>
+
+
+class BoatComponents;
+
+class WeaponSystem
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Sizes on screen, the radius of a boat's bounding sphere as a fraction of half the viewport (as for the levels of detail in
+	// EntityTemplate), at or above which guns are rebuilt every update, and below which they aren't rebuilt at all
+	static constexpr float FULL_RATE_SCREEN_SIZE = 0.04f;
+	static constexpr float MIN_SCREEN_SIZE       = 0.008f;
+
+	// Guns between the two sizes are rebuilt once in this many updates, the boats spread over the updates in turn
+	static constexpr uint32_t REDUCED_RATE_INTERVAL = 4;
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Rebuild the gun matrices of the boats whose guns turned this update, at the rate their size in the views allows. Called by
+	// the EntityManager in UpdateAll once all entities have been updated
+	void Update(BoatComponents& boats);
+
+	// Whether the rate gun matrices are rebuilt at depends on the boats' sizes in the views, as described at the top of the file.
+	// When off every turned gun is rebuilt every update. On by default
+	bool& LevelOfDetail()  { return mLevelOfDetail; }
+
+	// Forget the views, then add each view rendered this frame: its frustum, camera position and projection matrix's Y scale (e11)
+	void ClearViews()  { mViews.clear(); }
+	void AddView(const Frustum& frustum, const Vector3& cameraPosition, float projectionScale)
+	{
+		mViews.push_back({ frustum, cameraPosition, projectionScale });
+	}
+
+	// Boats whose turned guns were rebuilt in the last update at the full rate and at the reduced rate, and those left for later
+	struct Stats
+	{
+		uint32_t fullRate    = 0;
+		uint32_t reducedRate = 0;
+		uint32_t skipped     = 0;
+	};
+	const Stats& GetStats()  { return mStats; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct View
+	{
+		Frustum frustum;
+		Vector3 cameraPosition;
+		float   projectionScale;
+	};
+	std::vector<View> mViews;
+
+	bool     mLevelOfDetail = true;
+	uint32_t mUpdateCount   = 0; // Picks which boats at the reduced rate are rebuilt this update
+	Stats    mStats;
+};
+
+
+#endif //_WEAPON_SYSTEM_H_INCLUDED_
@@ -0,0 +1,233 @@
+//--------------------------------------------------------------------------------------
+// World partition - the level's scenery and obstacles in square cells streamed in around the boats and camera
+//--------------------------------------------------------------------------------------
+
+#include "WorldPartition.h"
+
+#include "SceneGlobals.h"
+#include "Obstacle.h"
+#include "MathHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+/*-----------------------------------------------------------------------------------------
+   Level setup
+-----------------------------------------------------------------------------------------*/
+
+// Add a level entity to the cell its position is in, to be created when the cell is loaded
+void WorldPartition::AddEntity(EntityType type, Atom templateName, Atom name, const Matrix4x4& transform)
+{
+	int x = static_cast<int>(std::floor(transform.Position().x / mCellSize));
+	int z = static_cast<int>(std::floor(transform.Position().z / mCellSize));
+	Cell& cell = mCells[CellKey(x, z)];
+	if (cell.entities.empty())
+	{
+		cell.x = x;
+		cell.z = z;
+		if (mMinX > mMaxX)  { mMinX = mMaxX = x;  mMinZ = mMaxZ = z; }
+		mMinX = std::min(mMinX, x);  mMaxX = std::max(mMaxX, x);
+		mMinZ = std::min(mMinZ, z);  mMaxZ = std::max(mMaxZ, z);
+	}
+
+	cell.entities.push_back({ type, templateName, name, transform });
+	if (std::find(cell.templates.begin(), cell.templates.end(), templateName) == cell.templates.end())
+		cell.templates.push_back(templateName);
+	++mNumEntities;
+}
+
+
+// Give the partition the factory of a template only streamed entities use
+void WorldPartition::AddTemplate(Atom type, EntityManager::TemplateFactory create, EntityManager::TemplateBounds bounds)
+{
+	auto& streamed = mTemplates[type];
+	streamed.create = std::move(create);
+	streamed.bounds = bounds;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Usage
+-----------------------------------------------------------------------------------------*/
+
+// Load the cells near the given points and unload those far from all of them
+void WorldPartition::Update(const std::vector<Vector3>& focusPoints, bool wait /*= false*/)
+{
+	if (mCells.empty())  return;
+
+	++mUpdate;
+	for (const Vector3& focus : focusPoints)  MarkCells(focus);
+
+	// Unload the cells no focus point is near any more, and create the entities of the loading cells whose templates are ready
+	int cellsCreated = 0;
+	for (size_t i = 0; i < mActiveCells.size(); )
+	{
+		Cell& cell = *mActiveCells[i];
+		if (cell.keptUpdate != mUpdate)
+		{
+			Unload(cell);
+			mActiveCells[i] = mActiveCells.back();
+			mActiveCells.pop_back();
+			continue;
+		}
+
+		if (cell.state == CellState::Loading &&
+		    (wait || (cellsCreated < MAX_CELLS_CREATED_PER_UPDATE && TemplatesReady(cell))))
+		{
+			CreateEntities(cell);
+			++cellsCreated;
+		}
+		++i;
+	}
+
+	ReleaseTemplates();
+}
+
+
+// Choose a random point at the given height in one of the loaded cells. Returns false if no cell is loaded
+bool WorldPartition::RandomLoadedPoint(float height, Vector3& point)
+{
+	int loadedCells = 0;
+	for (Cell* cell : mActiveCells)
+	{
+		if (cell->state == CellState::Loaded)  ++loadedCells;
+	}
+	if (loadedCells == 0)  return false;
+
+	int chosen = Random(0, loadedCells - 1);
+	for (Cell* cell : mActiveCells)
+	{
+		if (cell->state != CellState::Loaded || chosen-- > 0)  continue;
+		point = { (cell->x + Random(0.0f, 1.0f)) * mCellSize, height, (cell->z + Random(0.0f, 1.0f)) * mCellSize };
+		return true;
+	}
+	return false;
+}
+
+
+// Current state of the cells, for display
+WorldPartition::Stats WorldPartition::GetStats()
+{
+	Stats stats = {};
+	stats.cells    = static_cast<uint32_t>(mCells.size());
+	stats.entities = mNumEntities;
+	for (Cell* cell : mActiveCells)
+	{
+		if (cell->state == CellState::Loaded)  ++stats.loadedCells;
+		else                                   ++stats.loadingCells;
+		stats.loadedEntities += static_cast<uint32_t>(cell->ids.size());
+	}
+	stats.templates = static_cast<uint32_t>(mTemplates.size());
+	for (auto& [type, streamed] : mTemplates)
+	{
+		if (gEntityManager->IsTemplateConstructed(type))  ++stats.loadedTemplates;
+	}
+	return stats;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+   Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Mark the cells within the unload distance of a focus point as kept, and start loading those within the load distance
+void WorldPartition::MarkCells(const Vector3& focus)
+{
+	const float keepDistance = mLoadDistance + mCellSize;
+	int minX = std::max(mMinX, static_cast<int>(std::floor((focus.x - keepDistance) / mCellSize)));
+	int maxX = std::min(mMaxX, static_cast<int>(std::floor((focus.x + keepDistance) / mCellSize)));
+	int minZ = std::max(mMinZ, static_cast<int>(std::floor((focus.z - keepDistance) / mCellSize)));
+	int maxZ = std::min(mMaxZ, static_cast<int>(std::floor((focus.z + keepDistance) / mCellSize)));
+	for (int z = minZ; z <= maxZ; ++z)
+	{
+		for (int x = minX; x <= maxX; ++x)
+		{
+			auto found = mCells.find(CellKey(x, z));
+			if (found == mCells.end())  continue;
+			Cell& cell = found->second;
+
+			// Distance on X and Z from the focus to the nearest point of the cell
+			float dx = std::max({ x * mCellSize - focus.x, 0.0f, focus.x - (x + 1) * mCellSize });
+			float dz = std::max({ z * mCellSize - focus.z, 0.0f, focus.z - (z + 1) * mCellSize });
+			float distanceSquared = dx * dx + dz * dz;
+			if (distanceSquared > keepDistance * keepDistance)  continue;
+
+			cell.keptUpdate = mUpdate;
+			if (cell.state == CellState::Unloaded && distanceSquared <= mLoadDistance * mLoadDistance)
+			{
+				StartLoading(cell);
+				mActiveCells.push_back(&cell);
+			}
+		}
+	}
+}
+
+
+// Start loading a cell, prefetching the templates it needs. Templates already constructed or being prefetched are left as they are
+void WorldPartition::StartLoading(Cell& cell)
+{
+	for (Atom type : cell.templates)
+	{
+		auto streamed = mTemplates.find(type);
+		if (streamed != mTemplates.end())  ++streamed->second.usingCells;
+		gEntityManager->PrefetchTemplate(type);
+	}
+	cell.state = CellState::Loading;
+}
+
+
+// Returns true if none of the cell's templates are still being prefetched
+bool WorldPartition::TemplatesReady(const Cell& cell)
+{
+	for (Atom type : cell.templates)
+	{
+		if (gEntityManager->IsTemplateLoading(type))  return false;
+	}
+	return true;
+}
+
+
+// Create the entities of a loading cell. Templates that couldn't be prefetched are constructed here by CreateEntity
+void WorldPartition::CreateEntities(Cell& cell)
+{
+	cell.ids.reserve(cell.entities.size());
+	for (const CellEntity& entity : cell.entities)
+	{
+		EntityID id = (entity.type == EntityType::Obstacle)
+		            ? gEntityManager->CreateEntity<Obstacle>(entity.templateName, entity.transform, entity.name)
+		            : gEntityManager->CreateEntity<Entity>(entity.templateName, entity.transform);
+		if (id != NO_ID)  cell.ids.push_back(id);
+	}
+	cell.state = CellState::Loaded;
+}
+
+
+// Destroy the entities of a loaded cell, or stop loading a loading one, and release the templates it needed
+void WorldPartition::Unload(Cell& cell)
+{
+	for (EntityID id : cell.ids)  gEntityManager->DestroyEntity(id);
+	cell.ids.clear();
+
+	for (Atom type : cell.templates)
+	{
+		auto streamed = mTemplates.find(type);
+		if (streamed != mTemplates.end() && streamed->second.usingCells > 0)  --streamed->second.usingCells;
+	}
+	cell.state = CellState::Unloaded;
+}
+
+
+// Destroy the streamed templates no cell needs and no other entity uses, registering them again to load when needed. A template
+// still being prefetched is left until its prefetch finishes, rather than waiting for it
+void WorldPartition::ReleaseTemplates()
+{
+	for (auto& [type, streamed] : mTemplates)
+	{
+		if (streamed.usingCells > 0 || !gEntityManager->IsTemplateConstructed(type))  continue;
+		if (!gEntityManager->GetTemplate(type)->Entities().empty())  continue;
+
+		gEntityManager->DestroyEntityTemplate(type);
+		gEntityManager->RegisterEntityTemplate(type, streamed.create, streamed.bounds);
+	}
+}
@@ -0,0 +1,194 @@
+//--------------------------------------------------------------------------------------
+// World partition - the level's scenery and obstacles in square cells streamed in around the boats and camera
+//--------------------------------------------------------------------------------------
+// A level with a CellSize in its <Settings> (see LevelSettings in ParseLevel.h) isn't created all at once. Its plain entities
+// and obstacles are sorted into square cells of that size by position, each cell holding its entities' templates, transforms
+// and names, and the templates they use (the cell's asset dependencies). Boats, reload stations and entities marked
+// Resident="true" in the level (e.g. the sky and water) are created with the level as usual.
+//
+// A few times a second the scene gives the partition its focus points, the active camera and every boat. Cells within the
+// load distance of a focus point start loading: the templates they use that aren't constructed yet are prefetched on
+// background threads (see EntityManager::PrefetchTemplate), and once they have all finished the cell's entities are created,
+// a couple of cells per update so a burst of cells doesn't stall a step. Loaded cells further than the load distance plus
+// one cell from every focus point have their entities destroyed, and a streamed template no loaded cell needs any more is
+// destroyed and registered again to load when next needed, freeing its meshes. So memory and load time follow the area
+// around the boats and camera rather than the size of the map:
+//     mWorldPartition->Update(focusPoints);  // Just before gEntityManager->UpdateAll, on the same thread
+//
+// Only the level's static entities are streamed, the ones the game changes (boats, missiles, crates, mines) are not. Boats
+// are focus points so obstacles they can reach are always loaded. A checkpoint only restores with the same cells loaded as
+// when it was saved (see Checkpoint.h)
+
+#ifndef _WORLD_PARTITION_H_INCLUDED_
+#define _WORLD_PARTITION_H_INCLUDED_
+
+#include "EntityManager.h"
+#include "Matrix4x4.h"
+#include "Vector3.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+
+class WorldPartition
+{
+	/*-----------------------------------------------------------------------------------------
+	   Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Seconds of game time between updates, see Scene::SimulationStep
+	static constexpr float UPDATE_INTERVAL = 0.25f;
+
+	// Most cells whose entities are created in one update, the rest wait for the next
+	static constexpr int MAX_CELLS_CREATED_PER_UPDATE = 2;
+
+	// Cells within this distance of a focus point are loaded. They are unloaded once they are more than a cell further away,
+	// so a camera moving back and forth over a cell edge doesn't load and unload the same cells
+	void  SetLoadDistance(float distance)  { mLoadDistance = distance; }
+	float GetLoadDistance()                { return mLoadDistance; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Level setup
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Kinds of entity that can be streamed
+	enum class EntityType
+	{
+		Entity,
+		Obstacle,
+	};
+
+	// Set the size of the cells, before any entities are added. The level is partitioned if this is more than 0
+	void  SetCellSize(float cellSize)  { mCellSize = cellSize; }
+	float GetCellSize()                { return mCellSize; }
+
+	// Add a level entity to the cell its position is in, to be created when the cell is loaded
+	void AddEntity(EntityType type, Atom templateName, Atom name, const Matrix4x4& transform);
+
+	// Give the partition the factory of a template only streamed entities use, so it can destroy the template when no loaded
+	// cell needs it and register it again afterwards, with the bounds for its stand-in. Templates without a factory stay once
+	// they are constructed
+	void AddTemplate(Atom type, EntityManager::TemplateFactory create, EntityManager::TemplateBounds bounds);
+
+	// Number of cells with any entities in them, 0 if the level isn't partitioned
+	size_t NumCells()  { return mCells.size(); }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Load the cells near the given points and unload those far from all of them. Must be called on the thread running the
+	// entity updates but not from within UpdateAll. With wait set, the cells near the points are all created before returning,
+	// constructing their templates on this thread if need be (e.g. when the level is first loaded)
+	void Update(const std::vector<Vector3>& focusPoints, bool wait = false);
+
+	// Choose a random point at the given height in one of the loaded cells, e.g. to spawn something where the boats are.
+	// Returns false if no cell is loaded
+	bool RandomLoadedPoint(float height, Vector3& point);
+
+	// Current state of the cells, for display
+	struct Stats
+	{
+		uint32_t cells;
+		uint32_t loadedCells;
+		uint32_t loadingCells;
+		uint32_t entities;        // In every cell
+		uint32_t loadedEntities;  // Created from the loaded cells
+		uint32_t templates;       // Streamed templates with a factory
+		uint32_t loadedTemplates; // Of those, the ones constructed
+	};
+	Stats GetStats();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private types
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A level entity in a cell. Random offsets in the level were chosen when it was loaded, so a cell is the same each
+	// time it is streamed in. Names are atoms so creating the entities doesn't hash their text
+	struct CellEntity
+	{
+		EntityType type;
+		Atom       templateName;
+		Atom       name;
+		Matrix4x4  transform;
+	};
+
+	enum class CellState
+	{
+		Unloaded,
+		Loading, // Waiting for its templates
+		Loaded,
+	};
+
+	struct Cell
+	{
+		int x, z; // Position in whole cells, the cell covers x * cellSize to (x + 1) * cellSize
+
+		std::vector<CellEntity> entities;
+		std::vector<Atom>       templates; // The templates of the entities, each once
+		std::vector<EntityID>   ids;       // Of the entities created while it is loaded
+
+		CellState state      = CellState::Unloaded;
+		uint32_t  keptUpdate = 0; // Last update it was within the unload distance of a focus point
+	};
+
+	// A streamed template and the number of loading or loaded cells that need it
+	struct StreamedTemplate
+	{
+		EntityManager::TemplateFactory create;
+		EntityManager::TemplateBounds  bounds;
+		uint32_t usingCells = 0;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private functions
+	-----------------------------------------------------------------------------------------*/
+private:
+	static uint64_t CellKey(int x, int z)  { return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(z); }
+
+	// Mark the cells within the unload distance of a focus point as kept, and start loading those within the load distance
+	void MarkCells(const Vector3& focus);
+
+	// Start loading a cell, prefetching the templates it needs
+	void StartLoading(Cell& cell);
+
+	// Returns true if none of the cell's templates are still being prefetched
+	bool TemplatesReady(const Cell& cell);
+
+	// Create the entities of a loading cell. Any of its templates not yet constructed are constructed on this thread
+	void CreateEntities(Cell& cell);
+
+	// Destroy the entities of a loaded cell, or stop loading a loading one, and release the templates it needed
+	void Unload(Cell& cell);
+
+	// Destroy the streamed templates no cell needs, registering them again to load when needed
+	void ReleaseTemplates();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	float mCellSize     = 0;
+	float mLoadDistance = 1200.0f;
+
+	std::unordered_map<uint64_t, Cell>         mCells;
+	std::vector<Cell*>                         mActiveCells; // Those loading or loaded
+	std::unordered_map<Atom, StreamedTemplate> mTemplates;
+
+	// Range of the cells with entities, focus points only look at cells within it
+	int mMinX = 0, mMaxX = -1;
+	int mMinZ = 0, mMaxZ = -1;
+	uint32_t mNumEntities = 0;
+
+	uint32_t mUpdate = 0; // Count of updates, to tell which cells were marked in this one
+};
+
+
+#endif //_WORLD_PARTITION_H_INCLUDED_
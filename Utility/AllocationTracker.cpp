@@ -0,0 +1,427 @@
+//--------------------------------------------------------------------------------------
+// AllocationTracker class - counts heap allocations frame by frame, by subsystem and call site
+//--------------------------------------------------------------------------------------
+
+#include "AllocationTracker.h"
+
+#include "imgui.h"
+
+#include <windows.h>
+#include <dbghelp.h>
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_map>
+
+
+// Constant initialised (see the constructor) so it can count allocations made while other globals are constructed
+constinit AllocationTracker gAllocationTracker;
+
+// The subsystem the calling thread's allocations are counted under, set by AllocationScope
+namespace { thread_local int tAllocationSubsystem = 0; }
+
+
+/*-----------------------------------------------------------------------------------------
+	Recording
+-----------------------------------------------------------------------------------------*/
+
+// Turn steady state asserts on or off. Turning them on enables counting and starts the warm-up again
+void AllocationTracker::SetSteadyStateAssert(bool assert)
+{
+	mSteady.store(false, std::memory_order_relaxed);
+	mWarmUpLeft = WARM_UP_FRAMES;
+	if (assert)
+	{
+		mFailures.store(0, std::memory_order_relaxed);
+		mFirstFailure.store(nullptr, std::memory_order_relaxed);
+		SetEnabled(true);
+	}
+	mAssertSteadyState.store(assert, std::memory_order_relaxed);
+}
+
+
+// Allocations under the given subsystem are never steady state failures
+void AllocationTracker::ExemptFromAssert(const char* subsystem)
+{
+	mExempt[SubsystemIndex(subsystem)].store(true, std::memory_order_relaxed);
+}
+
+
+// The index of the subsystem with the given name, adding it if it is new. The same literal can have a different address in
+// each file it is used in, so names are compared by text
+int AllocationTracker::SubsystemIndex(const char* name)
+{
+	while (mSubsystemLock.test_and_set(std::memory_order_acquire)) {}
+
+	int numSubsystems = mNumSubsystems.load(std::memory_order_relaxed);
+	int index = 0;
+	while (index < numSubsystems && std::strcmp(mSubsystemNames[index], name) != 0)  ++index;
+	if (index == numSubsystems)
+	{
+		if (numSubsystems < MAX_SUBSYSTEMS)
+		{
+			mSubsystemNames[index] = name;
+			mNumSubsystems.store(numSubsystems + 1, std::memory_order_release);
+		}
+		else
+		{
+			index = 0;
+		}
+	}
+
+	mSubsystemLock.clear(std::memory_order_release);
+	return index;
+}
+
+
+// Count an allocation. Called from inside operator new, so must not allocate itself. Not inlined so the stack traces of
+// call sites always start the same number of calls below it
+__declspec(noinline) void AllocationTracker::Allocated(size_t bytes)
+{
+	if (!IsEnabled())  return;
+
+	int subsystem = tAllocationSubsystem;
+	mAllocations[subsystem].fetch_add(1, std::memory_order_relaxed);
+	mBytes[subsystem].fetch_add(bytes, std::memory_order_relaxed);
+
+	CallSiteSlot* callSite = nullptr;
+	if (IsTrackingCallSites())
+	{
+		callSite = CurrentCallSite(subsystem);
+		if (callSite != nullptr)
+		{
+			callSite->allocations.fetch_add(1, std::memory_order_relaxed);
+			callSite->bytes.fetch_add(bytes, std::memory_order_relaxed);
+		}
+	}
+
+	if (mSteady.load(std::memory_order_relaxed) && !mExempt[subsystem].load(std::memory_order_relaxed) &&
+	    GetCurrentThreadId() == mMainThread.load(std::memory_order_relaxed))
+	{
+		// The first failure's trace is kept even when call sites aren't being tracked, to say where it was
+		if (mFailures.fetch_add(1, std::memory_order_relaxed) == 0)
+		{
+			mFirstFailure.store(callSite != nullptr ? callSite : CurrentCallSite(subsystem), std::memory_order_relaxed);
+			if (IsDebuggerPresent())  DebugBreak(); // A steady state frame has allocated, see the call stack
+		}
+	}
+}
+
+
+// Keep the counts since the last call as the last frame
+void AllocationTracker::NextFrame()
+{
+	mMainThread.store(GetCurrentThreadId(), std::memory_order_relaxed);
+	if (IsSteadyStateAsserting() && mWarmUpLeft > 0 && --mWarmUpLeft == 0)  mSteady.store(true, std::memory_order_relaxed);
+
+	if (mFrozen)
+	{
+		for (int i = 0; i < mNumSubsystems.load(std::memory_order_acquire); ++i)
+		{
+			mAllocations[i].store(0, std::memory_order_relaxed);
+			mBytes[i].store(0, std::memory_order_relaxed);
+		}
+		mFrees.store(0, std::memory_order_relaxed);
+		return;
+	}
+
+	Frame& frame = mLastFrame;
+	frame.numSubsystems = mNumSubsystems.load(std::memory_order_acquire);
+	frame.allocations = 0;
+	frame.bytes = 0;
+	for (int i = 0; i < frame.numSubsystems; ++i)
+	{
+		SubsystemCounts& counts = frame.subsystems[i];
+		counts.name        = mSubsystemNames[i];
+		counts.allocations = mAllocations[i].exchange(0, std::memory_order_relaxed);
+		counts.bytes       = mBytes[i].exchange(0, std::memory_order_relaxed);
+		frame.allocations += counts.allocations;
+		frame.bytes       += counts.bytes;
+	}
+	frame.frees = mFrees.exchange(0, std::memory_order_relaxed);
+
+	mHistory[mHistoryStart] = static_cast<float>(frame.allocations);
+	mHistoryStart = (mHistoryStart + 1) % HISTORY_SIZE;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Display
+-----------------------------------------------------------------------------------------*/
+
+// Where the first steady state failure was, empty if there were none
+std::string AllocationTracker::FirstFailure()
+{
+	const CallSiteSlot* callSite = mFirstFailure.load(std::memory_order_relaxed);
+	if (Failures() == 0)  return "";
+	if (callSite == nullptr || !callSite->ready.load(std::memory_order_acquire))  return "Unknown call site";
+
+	std::string description = std::string("Subsystem ") + mSubsystemNames[callSite->subsystem];
+	for (uint16_t i = 0; i < callSite->traceSize; ++i)  description += "\n  " + DescribeAddress(callSite->trace[i]);
+	return description;
+}
+
+
+// The call sites with the most allocations, most first
+std::vector<AllocationTracker::CallSite> AllocationTracker::TopCallSites(size_t count)
+{
+	std::vector<const CallSiteSlot*> slots;
+	for (const CallSiteSlot& slot : mCallSites)
+	{
+		if (slot.ready.load(std::memory_order_acquire) && slot.allocations.load(std::memory_order_relaxed) > 0)  slots.push_back(&slot);
+	}
+	count = std::min(count, slots.size());
+	std::partial_sort(slots.begin(), slots.begin() + count, slots.end(), [](const CallSiteSlot* a, const CallSiteSlot* b)
+	{
+		return a->allocations.load(std::memory_order_relaxed) > b->allocations.load(std::memory_order_relaxed);
+	});
+
+	// Traces start inside the allocator and often go through standard containers before reaching the code responsible
+	auto isAllocator = [](const std::string& function)
+	{
+		return function.starts_with("std::") || function.starts_with("operator new") || function.find("TrackedAllocate") != std::string::npos;
+	};
+	std::vector<CallSite> callSites;
+	for (size_t i = 0; i < count; ++i)
+	{
+		const CallSiteSlot& slot = *slots[i];
+		CallSite callSite = { "", {}, mSubsystemNames[slot.subsystem], slot.allocations.load(std::memory_order_relaxed),
+		                      slot.bytes.load(std::memory_order_relaxed) };
+		for (uint16_t frame = 0; frame < slot.traceSize; ++frame)
+		{
+			callSite.trace.push_back(DescribeAddress(slot.trace[frame]));
+			if (callSite.name.empty() && !isAllocator(callSite.trace.back()))  callSite.name = callSite.trace.back();
+		}
+		if (callSite.name.empty() && !callSite.trace.empty())  callSite.name = callSite.trace.back();
+		callSites.push_back(std::move(callSite));
+	}
+	return callSites;
+}
+
+
+// Start the call site totals again. Sites seen so far keep their slots
+void AllocationTracker::ResetCallSites()
+{
+	for (CallSiteSlot& slot : mCallSites)
+	{
+		slot.allocations.store(0, std::memory_order_relaxed);
+		slot.bytes.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+// Draw the options, the last frame's counts by subsystem and the top call sites
+void AllocationTracker::DrawStats()
+{
+	bool enabled = IsEnabled();
+	if (ImGui::Checkbox("Track Allocations", &enabled))  SetEnabled(enabled);
+	ImGui::SameLine();
+	bool callSites = IsTrackingCallSites();
+	if (ImGui::Checkbox("Track Call Sites", &callSites))  SetTrackCallSites(callSites);
+	ImGui::SameLine();
+	bool assert = IsSteadyStateAsserting();
+	if (ImGui::Checkbox("Assert Steady State", &assert))  SetSteadyStateAssert(assert);
+	ImGui::SameLine();
+	ImGui::Checkbox("Freeze", &mFrozen);
+	if (!enabled)  return;
+
+	const Frame& frame = mLastFrame;
+	char overlay[64];
+	snprintf(overlay, sizeof(overlay), "%llu allocations", static_cast<unsigned long long>(frame.allocations));
+	ImGui::PlotHistogram("Per Frame", mHistory.data(), HISTORY_SIZE, mHistoryStart, overlay, 0.0f, FLT_MAX, ImVec2(0, 40));
+	ImGui::Text("Frame: %llu allocations  %.1fKB  %llu frees", static_cast<unsigned long long>(frame.allocations), frame.bytes / 1024.0,
+	            static_cast<unsigned long long>(frame.frees));
+	for (int i = 0; i < frame.numSubsystems; ++i)
+	{
+		const SubsystemCounts& counts = frame.subsystems[i];
+		ImGui::Text("%8llux  %9.1fKB  %s%s", static_cast<unsigned long long>(counts.allocations), counts.bytes / 1024.0, counts.name,
+		            mExempt[i].load(std::memory_order_relaxed) ? " (exempt)" : "");
+	}
+
+	if (IsSteadyStateAsserting())
+	{
+		if (!mSteady.load(std::memory_order_relaxed))  ImGui::Text("Warming up: %u frames", mWarmUpLeft);
+		else if (Failures() == 0)                      ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "Steady state: no allocations");
+		else
+		{
+			ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Steady state failures: %llu", static_cast<unsigned long long>(Failures()));
+			ImGui::TextUnformatted(FirstFailure().c_str());
+		}
+	}
+
+	if (callSites)
+	{
+		if (ImGui::Button("Reset Call Sites"))  ResetCallSites();
+		ImGui::SameLine();
+		ImGui::Text("%u sites", std::min(mNumCallSites.load(std::memory_order_relaxed), MAX_CALL_SITES));
+		for (const CallSite& callSite : TopCallSites(10))
+		{
+			ImGui::Text("%8llux  %9.1fKB  %s: %s", static_cast<unsigned long long>(callSite.allocations), callSite.bytes / 1024.0,
+			            callSite.subsystem, callSite.name.c_str());
+			if (ImGui::IsItemHovered())
+			{
+				std::string trace;
+				for (const std::string& function : callSite.trace)  trace += function + "\n";
+				ImGui::SetTooltip("%s", trace.c_str());
+			}
+		}
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Find or add the slot of the calling stack trace, by open addressing on a hash of the trace. Returns nullptr if no slot is
+// found in a few probes, which only happens as the table fills
+__declspec(noinline) AllocationTracker::CallSiteSlot* AllocationTracker::CurrentCallSite(int subsystem)
+{
+	// Skips this function and Allocated
+	void* trace[TRACE_DEPTH];
+	USHORT traceSize = RtlCaptureStackBackTrace(2, TRACE_DEPTH, trace, nullptr);
+
+	uint64_t hash = 14695981039346656037ull; // FNV-1a
+	for (USHORT i = 0; i < traceSize; ++i)
+	{
+		hash = (hash ^ reinterpret_cast<uintptr_t>(trace[i])) * 1099511628211ull;
+	}
+	if (hash == 0)  hash = 1;
+
+	const uint32_t MAX_PROBES = 64;
+	for (uint32_t probe = 0; probe < MAX_PROBES; ++probe)
+	{
+		CallSiteSlot& slot = mCallSites[(hash + probe) & (MAX_CALL_SITES - 1)];
+		uint64_t slotHash = slot.hash.load(std::memory_order_acquire);
+		if (slotHash == 0 && slot.hash.compare_exchange_strong(slotHash, hash, std::memory_order_acq_rel))
+		{
+			std::copy(trace, trace + traceSize, slot.trace);
+			slot.traceSize = traceSize;
+			slot.subsystem = static_cast<uint16_t>(subsystem);
+			slot.ready.store(true, std::memory_order_release);
+			mNumCallSites.fetch_add(1, std::memory_order_relaxed);
+			return &slot;
+		}
+		if (slotHash == hash)  return &slot; // Possibly not ready yet, its counts can still be added to
+	}
+	return nullptr;
+}
+
+
+// The function name, file and line of a return address. DbgHelp isn't thread safe, this is only called on the main thread.
+// Descriptions are kept as looking up symbols is slow
+std::string AllocationTracker::DescribeAddress(void* address)
+{
+	static std::unordered_map<void*, std::string> descriptions;
+	auto found = descriptions.find(address);
+	if (found != descriptions.end())  return found->second;
+
+	HANDLE process = GetCurrentProcess();
+	static bool symbolsLoaded = false;
+	if (!symbolsLoaded)
+	{
+		SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES);
+		SymInitialize(process, nullptr, TRUE);
+		symbolsLoaded = true;
+	}
+
+	DWORD64 address64 = reinterpret_cast<DWORD64>(address);
+	alignas(SYMBOL_INFO) char symbolBuffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+	SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(symbolBuffer);
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = MAX_SYM_NAME;
+	DWORD64 symbolOffset = 0;
+	std::string description;
+	if (SymFromAddr(process, address64, &symbolOffset, symbol))
+	{
+		description = symbol->Name;
+	}
+	else
+	{
+		char hex[32];
+		snprintf(hex, sizeof(hex), "0x%llx", static_cast<unsigned long long>(address64));
+		description = hex;
+	}
+
+	IMAGEHLP_LINE64 line = {};
+	line.SizeOfStruct = sizeof(line);
+	DWORD lineOffset = 0;
+	if (SymGetLineFromAddr64(process, address64, &lineOffset, &line))
+	{
+		const char* fileName = std::max(std::strrchr(line.FileName, '\\'), std::strrchr(line.FileName, '/'));
+		description += std::string(" (") + (fileName != nullptr ? fileName + 1 : line.FileName) + ":" + std::to_string(line.LineNumber) + ")";
+	}
+	descriptions[address] = description;
+	return description;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	AllocationScope
+-----------------------------------------------------------------------------------------*/
+
+// Count the calling thread's allocations under the subsystem until the scope ends
+AllocationScope::AllocationScope(int subsystem)
+	: mPrevious(tAllocationSubsystem)
+{
+	tAllocationSubsystem = subsystem;
+}
+
+// Go back to the enclosing scope's subsystem
+AllocationScope::~AllocationScope()
+{
+	tAllocationSubsystem = mPrevious;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Global operator new and delete
+-----------------------------------------------------------------------------------------*/
+// The forms replaced are the ones every other form (nothrow, array) ends up calling. Memory comes from the CRT heap
+// as it would without the tracker, so the debug CRT's leak checks still see it
+
+#ifndef ALLOCATION_TRACKER_DISABLED
+
+namespace
+{
+	// Allocate as the standard operator new does, calling the new handler until it succeeds or there is none
+	void* TrackedAllocate(size_t bytes, size_t alignment)
+	{
+		gAllocationTracker.Allocated(bytes);
+		if (bytes == 0)  bytes = 1;
+		while (true)
+		{
+			void* memory = alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__ ? _aligned_malloc(bytes, alignment) : std::malloc(bytes);
+			if (memory != nullptr)  return memory;
+
+			std::new_handler handler = std::get_new_handler();
+			if (handler == nullptr)  throw std::bad_alloc();
+			handler();
+		}
+	}
+}
+
+void* operator new  (size_t bytes)                          { return TrackedAllocate(bytes, 0); }
+void* operator new[](size_t bytes)                          { return TrackedAllocate(bytes, 0); }
+void* operator new  (size_t bytes, std::align_val_t align)  { return TrackedAllocate(bytes, static_cast<size_t>(align)); }
+void* operator new[](size_t bytes, std::align_val_t align)  { return TrackedAllocate(bytes, static_cast<size_t>(align)); }
+
+void operator delete  (void* memory) noexcept          { if (memory) { gAllocationTracker.Freed(); std::free(memory); } }
+void operator delete[](void* memory) noexcept          { operator delete(memory); }
+void operator delete  (void* memory, size_t) noexcept  { operator delete(memory); }
+void operator delete[](void* memory, size_t) noexcept  { operator delete(memory); }
+
+void operator delete  (void* memory, std::align_val_t align) noexcept
+{
+	if (memory == nullptr)  return;
+	gAllocationTracker.Freed();
+	if (static_cast<size_t>(align) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)  _aligned_free(memory);
+	else                                                                std::free(memory);
+}
+void operator delete[](void* memory, std::align_val_t align) noexcept          { operator delete(memory, align); }
+void operator delete  (void* memory, size_t, std::align_val_t align) noexcept  { operator delete(memory, align); }
+void operator delete[](void* memory, size_t, std::align_val_t align) noexcept  { operator delete(memory, align); }
+
+#endif // ALLOCATION_TRACKER_DISABLED
@@ -0,0 +1,228 @@
+//--------------------------------------------------------------------------------------
+// AllocationTracker class - counts heap allocations frame by frame, by subsystem and call site
+//--------------------------------------------------------------------------------------
+// The global operator new and delete are replaced (see AllocationTracker.cpp) to count every allocation made through them,
+// its size and the subsystem it was made for. Code puts ALLOCATION_SCOPE at the top of a scope, with a string literal for
+// the subsystem's name, and allocations on that thread until the scope ends are counted under it. Scopes nest, the innermost
+// wins, and allocations outside any scope are counted as "Other". Once a frame the main thread calls NextFrame, which keeps
+// the counts of the frame just finished for display (see DrawStats) and starts counting again.
+//
+// With call sites tracked, each allocation also records a short stack trace and allocations are totalled by trace, so the
+// places allocating the most can be listed by name. With steady state asserts on, any allocation the main thread makes once
+// a warm-up has passed counts as a failure (and stops in the debugger if there is one), as a steady frame should allocate
+// nothing at all. Subsystems that are allowed to allocate, such as the control panel, can be exempted.
+//
+// Tracking is off by default, while off an allocation costs only a check of a flag. Defining ALLOCATION_TRACKER_DISABLED for
+// the build leaves operator new and delete as the standard ones and removes the scopes altogether
+//
+//   void EntityManager::UpdateAll(float frameTime)
+//   {
+//       ALLOCATION_SCOPE("Entities");
+//       ...
+
+#ifndef _ALLOCATION_TRACKER_H_INCLUDED_
+#define _ALLOCATION_TRACKER_H_INCLUDED_
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+class AllocationTracker
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	static constexpr int MAX_SUBSYSTEMS = 32; // Subsystem 0 is "Other", for allocations outside any scope
+
+	// Allocations counted under one subsystem in a frame
+	struct SubsystemCounts
+	{
+		const char* name        = nullptr;
+		uint64_t    allocations = 0;
+		uint64_t    bytes       = 0;
+	};
+
+	// A frame's counts, everything allocated and freed in it on every thread
+	struct Frame
+	{
+		std::array<SubsystemCounts, MAX_SUBSYSTEMS> subsystems;
+		int      numSubsystems = 0;
+		uint64_t allocations   = 0;
+		uint64_t bytes         = 0;
+		uint64_t frees         = 0;
+	};
+
+	// A place allocations are made from, totalled since call sites were last reset
+	struct CallSite
+	{
+		std::string              name;     // The first function on the trace that isn't the allocator or the standard library
+		std::vector<std::string> trace;    // Every function on the trace, innermost first, with file and line where known
+		const char*              subsystem;
+		uint64_t                 allocations;
+		uint64_t                 bytes;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Constant initialised, as allocations are counted from before any other global is constructed
+	constexpr AllocationTracker() = default;
+
+	AllocationTracker(const AllocationTracker&) = delete;
+	AllocationTracker& operator=(const AllocationTracker&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Recording
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether allocations are counted. Off by default
+	void SetEnabled(bool enabled)  { mEnabled.store(enabled, std::memory_order_relaxed); }
+	bool IsEnabled()               { return mEnabled.load(std::memory_order_relaxed); }
+
+	// Whether each allocation records a stack trace to total it by call site. Slows allocation a good deal. Off by default
+	void SetTrackCallSites(bool track)  { mTrackCallSites.store(track, std::memory_order_relaxed); }
+	bool IsTrackingCallSites()          { return mTrackCallSites.load(std::memory_order_relaxed); }
+
+	// Whether allocations on the main thread (the one calling NextFrame) are failures once WARM_UP_FRAMES frames have passed.
+	// Turning this on enables counting and starts the warm-up again
+	void SetSteadyStateAssert(bool assert);
+	bool IsSteadyStateAsserting()  { return mAssertSteadyState.load(std::memory_order_relaxed); }
+
+	// Allocations under the given subsystem are never steady state failures
+	void ExemptFromAssert(const char* subsystem);
+
+	// The index of the subsystem with the given name (a string literal, only the pointer is kept), adding it if it is new.
+	// Returns 0 ("Other") once MAX_SUBSYSTEMS have been added. Usually called once per scope by ALLOCATION_SCOPE
+	int SubsystemIndex(const char* name);
+
+	// Count an allocation or free, called by operator new and delete
+	void Allocated(size_t bytes);
+	void Freed()  { if (IsEnabled())  mFrees.fetch_add(1, std::memory_order_relaxed); }
+
+	// Keep the counts since the last call as the last frame, call once a frame on the main thread
+	void NextFrame();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Display
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Counts in the last frame
+	const Frame& LastFrame()  { return mLastFrame; }
+
+	// While frozen NextFrame still starts the counts again but keeps the last frame and the history as they are
+	bool& Frozen()  { return mFrozen; }
+
+	// Steady state failures since asserts were turned on, and the call site of the first (empty if there were none)
+	uint64_t Failures()  { return mFailures.load(std::memory_order_relaxed); }
+	std::string FirstFailure();
+
+	// The call sites with the most allocations, most first
+	std::vector<CallSite> TopCallSites(size_t count);
+	void ResetCallSites();
+
+	// Draw the tracker's options, the last frame's counts by subsystem and the top call sites in the current ImGui window
+	void DrawStats();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	static constexpr uint32_t WARM_UP_FRAMES = 120;
+	static constexpr int      TRACE_DEPTH    = 12;   // Return addresses kept for a call site
+	static constexpr uint32_t MAX_CALL_SITES = 4096; // A power of two, allocations from further sites are counted but not kept
+
+	// Totals for a distinct stack trace. A slot is claimed by setting its hash, then filled in and marked ready, all without
+	// allocating - this is called from inside operator new
+	struct CallSiteSlot
+	{
+		std::atomic<uint64_t> hash        = 0; // 0 for an unused slot
+		std::atomic<bool>     ready       = false;
+		std::atomic<uint64_t> allocations = 0;
+		std::atomic<uint64_t> bytes       = 0;
+		void*                 trace[TRACE_DEPTH] = {};
+		uint16_t              traceSize   = 0;
+		uint16_t              subsystem   = 0;
+	};
+
+	// Find or add the slot of the calling stack trace. Returns nullptr if the table is full
+	CallSiteSlot* CurrentCallSite(int subsystem);
+
+	// The function name, file and line of a return address
+	static std::string DescribeAddress(void* address);
+
+	std::atomic<bool> mEnabled           = false;
+	std::atomic<bool> mTrackCallSites    = false;
+	std::atomic<bool> mAssertSteadyState = false;
+	std::atomic<bool> mSteady            = false; // Asserting and passed the warm-up
+	uint32_t          mWarmUpLeft        = 0;
+
+	// Subsystem names are only added to, holding the lock (a spin lock, as a mutex may not be constant initialised). The
+	// count is read without it so is set after the name is written
+	std::atomic_flag                              mSubsystemLock;
+	std::array<const char*, MAX_SUBSYSTEMS>       mSubsystemNames = { "Other" };
+	std::atomic<int>                              mNumSubsystems  = 1;
+	std::array<std::atomic<bool>, MAX_SUBSYSTEMS> mExempt         = {};
+
+	// Counts for the frame in progress
+	std::array<std::atomic<uint64_t>, MAX_SUBSYSTEMS> mAllocations = {};
+	std::array<std::atomic<uint64_t>, MAX_SUBSYSTEMS> mBytes       = {};
+	std::atomic<uint64_t>                             mFrees       = 0;
+
+	std::atomic<uint64_t>      mFailures     = 0;
+	std::atomic<CallSiteSlot*> mFirstFailure = nullptr;
+	std::atomic<uint32_t>      mMainThread   = 0; // Thread ID of the NextFrame caller
+
+	std::array<CallSiteSlot, MAX_CALL_SITES> mCallSites;
+	std::atomic<uint32_t>                    mNumCallSites = 0;
+
+	// Allocations in each of the last HISTORY_SIZE frames, a ring starting at the oldest
+	static constexpr uint32_t           HISTORY_SIZE = 120;
+	std::array<float, HISTORY_SIZE>     mHistory      = {};
+	uint32_t                            mHistoryStart = 0;
+
+	Frame mLastFrame;
+	bool  mFrozen = false;
+};
+
+
+// Counts the calling thread's allocations under a subsystem for the rest of the scope, see ALLOCATION_SCOPE
+class AllocationScope
+{
+public:
+	explicit AllocationScope(int subsystem);
+	~AllocationScope();
+
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+	int mPrevious;
+};
+
+
+// The tracker operator new and delete count into
+extern AllocationTracker gAllocationTracker;
+
+
+// Count allocations in the rest of the enclosing scope under the given subsystem name, which must be a string literal
+#ifndef ALLOCATION_TRACKER_DISABLED
+	#define ALLOCATION_SCOPE_JOIN2(a, b)  a##b
+	#define ALLOCATION_SCOPE_JOIN(a, b)   ALLOCATION_SCOPE_JOIN2(a, b)
+	#define ALLOCATION_SCOPE(name) \
+		static const int ALLOCATION_SCOPE_JOIN(allocationSubsystem, __LINE__) = gAllocationTracker.SubsystemIndex(name); \
+		AllocationScope ALLOCATION_SCOPE_JOIN(allocationScope, __LINE__)(ALLOCATION_SCOPE_JOIN(allocationSubsystem, __LINE__))
+#else
+	#define ALLOCATION_SCOPE(name)
+#endif
+
+
+#endif // _ALLOCATION_TRACKER_H_INCLUDED_
@@ -0,0 +1,817 @@
+//--------------------------------------------------------------------------------------
+// AssetFiles class - reads asset files from packed archives or from the disk
+//--------------------------------------------------------------------------------------
+
+#include "AssetFiles.h"
+#include "StartupProfile.h"
+#include "JobSystem.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <windows.h>
+
+#include <fstream>
+#include <algorithm>
+#include <unordered_set>
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <system_error>
+#include <functional>
+
+
+// The asset files used by all loading code
+AssetFiles gAssetFiles;
+
+
+/*-----------------------------------------------------------------------------------------
+	File layout
+-----------------------------------------------------------------------------------------*/
+// Header, contents of each file (aligned to ARCHIVE_ALIGNMENT), then the index: an IndexEntry for each file followed by all
+// the names. Everything is little-endian
+
+static const uint32_t ARCHIVE_MAGIC   = 0x4B415042; // "BPAK"
+static const uint32_t ARCHIVE_VERSION = 2; // 2 added the content hashes, for rebuilding incrementally
+
+static const uint32_t ARCHIVE_ENTRY_LZ4 = 1; // Flag for a file stored LZ4 compressed
+
+struct ArchiveHeader
+{
+	uint32_t magic      = ARCHIVE_MAGIC;
+	uint32_t version    = ARCHIVE_VERSION;
+	uint32_t numEntries = 0;
+	uint32_t padding    = 0;
+	uint64_t indexOffset = 0;
+	uint64_t indexSize   = 0;
+};
+
+struct ArchiveIndexEntry
+{
+	uint64_t offset;
+	uint64_t storedSize;
+	uint64_t size;
+	int64_t  time;
+	uint32_t nameOffset; // From the start of the names, which follow the index entries
+	uint32_t nameLength;
+	uint32_t flags;
+	uint32_t padding;
+	uint64_t hash;       // FNV-1a of the uncompressed contents, see BuildAssetArchive
+};
+
+// Files BuildAssetArchive holds in memory at once, read and compressed in parallel
+static const size_t ARCHIVE_BUILD_BATCH = 64;
+
+
+// A mounted archive - the file, its mapping and its index
+struct AssetFiles::Archive
+{
+	HANDLE         file    = INVALID_HANDLE_VALUE;
+	HANDLE         mapping = nullptr;
+	const uint8_t* view    = nullptr;
+	uint64_t       size    = 0;
+
+	std::unordered_map<std::string, Entry> entries;
+
+	~Archive()
+	{
+		if (view != nullptr)                 UnmapViewOfFile(view);
+		if (mapping != nullptr)              CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)    CloseHandle(file);
+	}
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Helper functions
+-----------------------------------------------------------------------------------------*/
+
+// The name files are looked up by in archives - relative to the working folder, lower case, forward slashes
+static std::string ArchiveName(const std::filesystem::path& file)
+{
+	auto path = file;
+	if (path.is_absolute())
+	{
+		std::error_code error;
+		auto relative = path.lexically_relative(std::filesystem::current_path(error));
+		if (!error && !relative.empty() && *relative.begin() != "..")  path = relative;
+	}
+	auto name = path.lexically_normal().generic_string();
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return name;
+}
+
+
+// 64-bit FNV-1a hash of the given bytes
+static uint64_t HashBytes(const uint8_t* data, size_t size)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
+
+
+// Read the index of an archive open in the given stream, the entries by name and the names in the order they are stored.
+// Returns false, with nothing read, if the archive is missing, damaged or from another version
+static bool ReadArchiveIndex(std::ifstream& stream, std::unordered_map<std::string, ArchiveIndexEntry>& entries,
+                             std::vector<std::string>& order)
+{
+	ArchiveHeader header;
+	if (!stream || !stream.read(reinterpret_cast<char*>(&header), sizeof(header)))  return false;
+	if (header.magic != ARCHIVE_MAGIC || header.version != ARCHIVE_VERSION ||
+	    static_cast<uint64_t>(header.numEntries) * sizeof(ArchiveIndexEntry) > header.indexSize)  return false;
+
+	std::vector<char> index(static_cast<size_t>(header.indexSize));
+	stream.seekg(static_cast<std::streamoff>(header.indexOffset));
+	if (!stream.read(index.data(), static_cast<std::streamsize>(index.size())))  return false;
+
+	const char* names     = index.data() + header.numEntries * sizeof(ArchiveIndexEntry);
+	uint64_t    namesSize = header.indexSize - header.numEntries * sizeof(ArchiveIndexEntry);
+	for (uint32_t i = 0; i < header.numEntries; ++i)
+	{
+		ArchiveIndexEntry entry;
+		std::memcpy(&entry, index.data() + i * sizeof(ArchiveIndexEntry), sizeof(entry));
+		if (static_cast<uint64_t>(entry.nameOffset) + entry.nameLength > namesSize)
+		{
+			entries.clear();
+			order.clear();
+			return false;
+		}
+		order.emplace_back(names + entry.nameOffset, entry.nameLength);
+		entries.emplace(order.back(), entry);
+	}
+	return true;
+}
+
+
+// Read the whole of a file on disk. Returns false if it can't be read
+static bool ReadDiskFile(const std::filesystem::path& file, std::vector<uint8_t>& bytes)
+{
+	std::ifstream stream(file, std::ios::binary | std::ios::ate);
+	if (!stream)  return false;
+	auto fileSize = static_cast<size_t>(stream.tellg());
+	bytes.resize(fileSize);
+	stream.seekg(0);
+	return fileSize == 0 || static_cast<bool>(stream.read(reinterpret_cast<char*>(bytes.data()), fileSize));
+}
+
+
+// Read the first size bytes of a file from disk into the given array, fewer if the file is shorter
+static bool ReadDiskFileStart(const std::filesystem::path& file, size_t size, std::vector<uint8_t>& bytes)
+{
+	std::ifstream stream(file, std::ios::binary | std::ios::ate);
+	if (!stream)  return false;
+	auto readSize = std::min(size, static_cast<size_t>(stream.tellg()));
+	bytes.resize(readSize);
+	stream.seekg(0);
+	return readSize == 0 || static_cast<bool>(stream.read(reinterpret_cast<char*>(bytes.data()), readSize));
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	AssetData
+-----------------------------------------------------------------------------------------*/
+
+// Hold the given bytes, e.g. a file read from disk or built in memory
+AssetData::AssetData(std::vector<uint8_t> bytes)
+{
+	auto owner = std::make_shared<std::vector<uint8_t>>(std::move(bytes));
+	mData  = owner->data();
+	mSize  = owner->size();
+	mOwner = std::move(owner);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Archives
+-----------------------------------------------------------------------------------------*/
+
+// Memory-map the given archive, its files are found before those on disk. Returns false if the archive doesn't exist or is damaged
+bool AssetFiles::MountArchive(const std::filesystem::path& archiveFile)
+{
+	auto archive = std::make_shared<Archive>();
+	archive->file = CreateFileW(archiveFile.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+	                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	LARGE_INTEGER fileSize;
+	if (archive->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(archive->file, &fileSize))
+	{
+		SetLastError("Failure to open archive: " + archiveFile.string());
+		return false;
+	}
+	archive->size = static_cast<uint64_t>(fileSize.QuadPart);
+	if (archive->size < sizeof(ArchiveHeader))
+	{
+		SetLastError("Archive is damaged: " + archiveFile.string());
+		return false;
+	}
+
+	archive->mapping = CreateFileMappingW(archive->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (archive->mapping != nullptr)  archive->view = static_cast<const uint8_t*>(MapViewOfFile(archive->mapping, FILE_MAP_READ, 0, 0, 0));
+	if (archive->view == nullptr)
+	{
+		SetLastError("Failure to map archive: " + archiveFile.string());
+		return false;
+	}
+
+	// Check the header and index fit in the file before reading them, the contents are checked when they are read
+	ArchiveHeader header;
+	std::memcpy(&header, archive->view, sizeof(header));
+	if (header.magic == ARCHIVE_MAGIC && header.version != ARCHIVE_VERSION)
+	{
+		SetLastError("Archive is from another version, pack it again: " + archiveFile.string());
+		return false;
+	}
+	bool valid = header.magic == ARCHIVE_MAGIC &&
+	             header.indexOffset <= archive->size && header.indexSize <= archive->size - header.indexOffset &&
+	             static_cast<uint64_t>(header.numEntries) * sizeof(ArchiveIndexEntry) <= header.indexSize;
+	if (valid)
+	{
+		const uint8_t* index = archive->view + header.indexOffset;
+		const char*    names = reinterpret_cast<const char*>(index + header.numEntries * sizeof(ArchiveIndexEntry));
+		uint64_t       namesSize = header.indexSize - header.numEntries * sizeof(ArchiveIndexEntry);
+		for (uint32_t i = 0; i < header.numEntries && valid; ++i)
+		{
+			ArchiveIndexEntry indexEntry;
+			std::memcpy(&indexEntry, index + i * sizeof(ArchiveIndexEntry), sizeof(indexEntry));
+			valid = indexEntry.offset <= archive->size && indexEntry.storedSize <= archive->size - indexEntry.offset &&
+			        static_cast<uint64_t>(indexEntry.nameOffset) + indexEntry.nameLength <= namesSize &&
+			        ((indexEntry.flags & ARCHIVE_ENTRY_LZ4) != 0 || indexEntry.storedSize == indexEntry.size);
+			if (!valid)  break;
+
+			Entry entry = { indexEntry.offset, indexEntry.storedSize, indexEntry.size, indexEntry.time, (indexEntry.flags & ARCHIVE_ENTRY_LZ4) != 0 };
+			archive->entries.emplace(std::string(names + indexEntry.nameOffset, indexEntry.nameLength), entry);
+		}
+	}
+	if (!valid)
+	{
+		SetLastError("Archive is damaged: " + archiveFile.string());
+		return false;
+	}
+
+	std::unique_lock<std::shared_mutex> lock(mArchivesMutex);
+	mArchives.insert(mArchives.begin(), std::move(archive));
+	return true;
+}
+
+
+// Unmount all archives. Data already read from them stays valid until it is released
+void AssetFiles::UnmountAll()
+{
+	std::unique_lock<std::shared_mutex> lock(mArchivesMutex);
+	mArchives.clear();
+}
+
+
+// Number of files in the mounted archives
+size_t AssetFiles::ArchivedFileCount()
+{
+	std::shared_lock<std::shared_mutex> lock(mArchivesMutex);
+	size_t count = 0;
+	for (auto& archive : mArchives)  count += archive->entries.size();
+	return count;
+}
+
+
+// Find the given file in the mounted archives, returns the entry and fills in its archive, or nullptr if not found. Call with
+// mArchivesMutex held
+const AssetFiles::Entry* AssetFiles::Find(const std::filesystem::path& file, std::shared_ptr<Archive>* archive /*= nullptr*/)
+{
+	if (mArchives.empty())  return nullptr;
+
+	auto name = ArchiveName(file);
+	for (auto& mounted : mArchives)
+	{
+		auto entry = mounted->entries.find(name);
+		if (entry != mounted->entries.end())
+		{
+			if (archive != nullptr)  *archive = mounted;
+			return &entry->second;
+		}
+	}
+	return nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Reading files
+-----------------------------------------------------------------------------------------*/
+
+// Whether the given file exists in a mounted archive or on disk
+bool AssetFiles::Exists(const std::filesystem::path& file)
+{
+	if (InArchive(file))  return true;
+	std::error_code error;
+	return std::filesystem::exists(file, error);
+}
+
+
+// As Exists, but files on disk are looked up in an index of the names in their folder, made the first time the folder is looked in
+bool AssetFiles::ExistsIndexed(const std::filesystem::path& file)
+{
+	if (InArchive(file))  return true;
+
+	auto name = ArchiveName(file);
+	auto slash = name.rfind('/');
+	std::string folder   = (slash == std::string::npos) ? "" : name.substr(0, slash);
+	std::string fileName = (slash == std::string::npos) ? name : name.substr(slash + 1);
+	{
+		std::shared_lock<std::shared_mutex> lock(mFolderIndexesMutex);
+		auto index = mFolderIndexes.find(folder);
+		if (index != mFolderIndexes.end())  return index->second.contains(fileName);
+	}
+
+	// List the folder without the lock, so other threads can use the indexes meanwhile. A missing folder gets an empty index
+	std::unordered_set<std::string> index;
+	std::error_code error;
+	for (std::filesystem::directory_iterator entry(folder.empty() ? "." : folder, error), end; !error && entry != end; entry.increment(error))
+	{
+		auto entryName = entry->path().filename().string();
+		std::transform(entryName.begin(), entryName.end(), entryName.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		index.insert(std::move(entryName));
+	}
+	bool exists = index.contains(fileName);
+
+	// Another thread may have indexed the same folder meanwhile, either index will do
+	std::unique_lock<std::shared_mutex> lock(mFolderIndexesMutex);
+	mFolderIndexes.try_emplace(folder, std::move(index));
+	return exists;
+}
+
+
+// Forget the folder indexes of ExistsIndexed, they are made again from the disk as they are next used
+void AssetFiles::InvalidateFolderIndexes()
+{
+	std::unique_lock<std::shared_mutex> lock(mFolderIndexesMutex);
+	mFolderIndexes.clear();
+}
+
+
+// Whether the given file is in a mounted archive
+bool AssetFiles::InArchive(const std::filesystem::path& file)
+{
+	std::shared_lock<std::shared_mutex> lock(mArchivesMutex);
+	return Find(file) != nullptr;
+}
+
+
+// Get the size and modification time of the given file. Returns false if it doesn't exist
+bool AssetFiles::GetInfo(const std::filesystem::path& file, AssetInfo& info)
+{
+	{
+		std::shared_lock<std::shared_mutex> lock(mArchivesMutex);
+		auto entry = Find(file);
+		if (entry != nullptr)
+		{
+			info.size = entry->size;
+			info.time = entry->time;
+			return true;
+		}
+	}
+
+	std::error_code error;
+	info.size = std::filesystem::file_size(file, error);
+	if (error)  return false;
+	info.time = static_cast<int64_t>(std::filesystem::last_write_time(file, error).time_since_epoch().count());
+	return !error;
+}
+
+
+// Read the whole of the given file. Returns empty data if the file doesn't exist or can't be read, then call GetLastError().
+// Uncompressed files in an archive point into its mapping, others are read into memory
+AssetData AssetFiles::Read(const std::filesystem::path& file)
+{
+	std::shared_ptr<Archive> archive;
+	Entry entry;
+	bool archived = false;
+	{
+		std::shared_lock<std::shared_mutex> lock(mArchivesMutex);
+		auto found = Find(file, &archive);
+		if (found != nullptr)
+		{
+			entry    = *found;
+			archived = true;
+		}
+	}
+
+	if (archived)
+	{
+		const uint8_t* contents = archive->view + entry.offset;
+		gStartupProfile.AddBytesRead(entry.storedSize);
+		if (!entry.compressed)  return AssetData(contents, static_cast<size_t>(entry.size), std::move(archive));
+
+		std::vector<uint8_t> bytes(static_cast<size_t>(entry.size));
+		if (!LZ4Decompress(contents, static_cast<size_t>(entry.storedSize), bytes.data(), bytes.size()))
+		{
+			SetLastError("Archived file is damaged: " + file.string());
+			return {};
+		}
+		return AssetData(std::move(bytes));
+	}
+
+	if (mRecordDiskReads)
+	{
+		std::lock_guard<std::mutex> lock(mRecordMutex);
+		if (mRecordedNames.insert(ArchiveName(file)).second)  mRecordedDiskReads.push_back(file);
+	}
+
+	std::vector<uint8_t> bytes;
+	if (!ReadDiskFile(file, bytes))
+	{
+		SetLastError("Failure to open file: " + file.string());
+		return {};
+	}
+	gStartupProfile.AddBytesRead(bytes.size());
+	return AssetData(std::move(bytes));
+}
+
+
+// Read the start of the given file, e.g. a header, without reading the rest from disk. An uncompressed archived file is mapped
+// so it is returned whole without being read, a compressed one has to be decompressed whole
+AssetData AssetFiles::ReadStart(const std::filesystem::path& file, size_t size)
+{
+	bool archived;
+	{
+		std::shared_lock<std::shared_mutex> lock(mArchivesMutex);
+		archived = Find(file) != nullptr;
+	}
+	if (archived)  return Read(file);
+
+	if (mRecordDiskReads)
+	{
+		std::lock_guard<std::mutex> lock(mRecordMutex);
+		if (mRecordedNames.insert(ArchiveName(file)).second)  mRecordedDiskReads.push_back(file);
+	}
+
+	std::vector<uint8_t> bytes;
+	if (!ReadDiskFileStart(file, size, bytes))
+	{
+		SetLastError("Failure to open file: " + file.string());
+		return {};
+	}
+	gStartupProfile.AddBytesRead(bytes.size());
+	return AssetData(std::move(bytes));
+}
+
+
+// Start or stop keeping a list of the files Read looks for on disk rather than finding in an archive. Starting clears the list
+void AssetFiles::RecordDiskReads(bool record)
+{
+	std::lock_guard<std::mutex> lock(mRecordMutex);
+	if (record)
+	{
+		mRecordedDiskReads.clear();
+		mRecordedNames.clear();
+	}
+	mRecordDiskReads = record;
+}
+
+
+// The files recorded since RecordDiskReads(true), in the order first read, each once
+std::vector<std::filesystem::path> AssetFiles::RecordedDiskReads()
+{
+	std::lock_guard<std::mutex> lock(mRecordMutex);
+	return mRecordedDiskReads;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Building archives
+-----------------------------------------------------------------------------------------*/
+
+// Write an archive containing the given files, replacing any existing one. Returns false if a file can't be read or the archive
+// can't be written, with a description in error. Files are read from disk, not from mounted archives. Files whose contents
+// hash the same as in the existing archive are copied from it as they are stored, so only changed files are compressed again,
+// and if nothing has changed at all the archive isn't written
+bool BuildAssetArchive(const std::filesystem::path& archiveFile, const std::vector<AssetArchiveFile>& files, std::string& error,
+                       JobSystem* jobSystem /*= nullptr*/, AssetArchiveStats* stats /*= nullptr*/)
+{
+	AssetArchiveStats counts;
+	if (stats == nullptr)  stats = &counts;
+	*stats = {};
+
+	// Each file once, in the order given
+	struct PackedFile
+	{
+		std::string                  name;
+		const AssetArchiveFile*      file;
+		ArchiveIndexEntry            entry = {}; // Offset and name filled in as it is written
+		uint64_t                     hash  = 0;
+		bool                         readable = false;
+		const ArchiveIndexEntry*     previous = nullptr; // The same contents stored in the existing archive
+		std::vector<uint8_t>         stored; // Contents ready to write, while they are being written
+	};
+	std::vector<PackedFile> packed;
+	std::unordered_set<std::string> added;
+	for (auto& file : files)
+	{
+		auto name = ArchiveName(file.path);
+		if (added.insert(name).second)  packed.push_back({ std::move(name), &file });
+	}
+
+	// The existing archive's index, nothing is reused if it is missing, damaged or from an older version
+	std::ifstream previousStream(archiveFile, std::ios::binary);
+	std::unordered_map<std::string, ArchiveIndexEntry> previous;
+	std::vector<std::string> previousOrder;
+	ReadArchiveIndex(previousStream, previous, previousOrder);
+
+	// Hash every file on the workers, each read whole from disk. The contents aren't kept, there could be more than fit in memory
+	auto forEachFile = [&](size_t begin, size_t end, const std::function<void(PackedFile&)>& work)
+	{
+		if (jobSystem == nullptr)
+		{
+			for (size_t i = begin; i < end; ++i)  work(packed[i]);
+			return;
+		}
+		jobSystem->ParallelFor(end - begin, 1, [&](size_t, size_t first, size_t last)
+		{
+			for (size_t i = begin + first; i < begin + last; ++i)  work(packed[i]);
+		});
+	};
+	forEachFile(0, packed.size(), [&](PackedFile& file)
+	{
+		std::vector<uint8_t> bytes;
+		std::error_code fileError;
+		file.entry.time = static_cast<int64_t>(std::filesystem::last_write_time(file.file->path, fileError).time_since_epoch().count());
+		file.readable = !fileError && ReadDiskFile(file.file->path, bytes);
+		if (!file.readable)  return;
+		file.entry.size = bytes.size();
+		file.hash = HashBytes(bytes.data(), bytes.size());
+
+		// A file to compress can reuse contents stored either way, as compression gives the same result for the same contents
+		auto found = previous.find(file.name);
+		if (found != previous.end() && found->second.size == file.entry.size && found->second.hash == file.hash &&
+		    (file.file->compress || (found->second.flags & ARCHIVE_ENTRY_LZ4) == 0))  file.previous = &found->second;
+	});
+	for (auto& file : packed)
+	{
+		if (!file.readable)
+		{
+			error = "Failure to read file for archive: " + file.file->path.string();
+			return false;
+		}
+	}
+
+	// Nothing to do if the archive holds exactly these files, in this order, with the same contents and times
+	bool upToDate = previousOrder.size() == packed.size();
+	for (size_t i = 0; i < packed.size() && upToDate; ++i)
+	{
+		upToDate = packed[i].previous != nullptr && previousOrder[i] == packed[i].name && packed[i].previous->time == packed[i].entry.time;
+	}
+	if (upToDate)
+	{
+		stats->reused   = static_cast<uint32_t>(packed.size());
+		stats->upToDate = true;
+		return true;
+	}
+
+	// Written to a temporary file that replaces the archive when complete, so a failure never leaves a damaged archive
+	auto tempFile = archiveFile;
+	tempFile += ".tmp";
+	std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		error = "Failure to create archive: " + archiveFile.string();
+		return false;
+	}
+
+	ArchiveHeader header;
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header)); // Rewritten with the index position at the end
+	uint64_t position = sizeof(header);
+	auto padTo = [&](uint64_t alignment)
+	{
+		static const char zeros[ARCHIVE_ALIGNMENT] = {};
+		uint64_t padding = (alignment - position % alignment) % alignment;
+		stream.write(zeros, static_cast<std::streamsize>(padding));
+		position += padding;
+	};
+
+	// A batch of files at a time: the changed ones are read and compressed on the workers, then all are written in order
+	std::vector<ArchiveIndexEntry> index;
+	std::string names;
+	for (size_t batch = 0; batch < packed.size(); batch += ARCHIVE_BUILD_BATCH)
+	{
+		size_t batchEnd = std::min(batch + ARCHIVE_BUILD_BATCH, packed.size());
+		forEachFile(batch, batchEnd, [&](PackedFile& file)
+		{
+			if (file.previous != nullptr)
+			{
+				file.entry.storedSize = file.previous->storedSize;
+				file.entry.flags      = file.previous->flags;
+				return;
+			}
+			std::vector<uint8_t> bytes;
+			file.readable = ReadDiskFile(file.file->path, bytes) && bytes.size() == file.entry.size && HashBytes(bytes.data(), bytes.size()) == file.hash;
+			if (!file.readable)  return; // Changed since it was hashed
+
+			std::vector<uint8_t> compressed;
+			if (file.file->compress)  compressed = LZ4Compress(bytes.data(), bytes.size());
+			file.entry.flags = compressed.empty() ? 0 : ARCHIVE_ENTRY_LZ4;
+			file.stored      = compressed.empty() ? std::move(bytes) : std::move(compressed);
+			file.entry.storedSize = file.stored.size();
+		});
+
+		for (size_t i = batch; i < batchEnd; ++i)
+		{
+			PackedFile& file = packed[i];
+			if (file.previous != nullptr)
+			{
+				file.stored.resize(static_cast<size_t>(file.entry.storedSize));
+				previousStream.seekg(static_cast<std::streamoff>(file.previous->offset));
+				file.readable = static_cast<bool>(previousStream.read(reinterpret_cast<char*>(file.stored.data()),
+				                                                      static_cast<std::streamsize>(file.stored.size())));
+				++stats->reused;
+			}
+			else
+			{
+				++stats->packed;
+			}
+			if (!file.readable)
+			{
+				stream.close();
+				std::error_code fileError;
+				std::filesystem::remove(tempFile, fileError);
+				error = "Failure to read file for archive: " + file.file->path.string();
+				return false;
+			}
+
+			padTo(ARCHIVE_ALIGNMENT);
+			file.entry.offset     = position;
+			file.entry.hash       = file.hash;
+			file.entry.nameOffset = static_cast<uint32_t>(names.size());
+			file.entry.nameLength = static_cast<uint32_t>(file.name.size());
+			index.push_back(file.entry);
+			names += file.name;
+
+			stream.write(reinterpret_cast<const char*>(file.stored.data()), static_cast<std::streamsize>(file.stored.size()));
+			position += file.stored.size();
+			file.stored = {};
+		}
+	}
+	previousStream.close(); // So the archive can be replaced
+
+	padTo(sizeof(uint64_t));
+	header.numEntries  = static_cast<uint32_t>(index.size());
+	header.indexOffset = position;
+	header.indexSize   = index.size() * sizeof(ArchiveIndexEntry) + names.size();
+	stream.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(ArchiveIndexEntry)));
+	stream.write(names.data(), static_cast<std::streamsize>(names.size()));
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.close();
+
+	std::error_code fileError;
+	if (!stream.fail())  std::filesystem::rename(tempFile, archiveFile, fileError);
+	if (stream.fail() || fileError)
+	{
+		std::filesystem::remove(tempFile, fileError);
+		error = "Failure to write archive: " + archiveFile.string();
+		return false;
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	LZ4
+-----------------------------------------------------------------------------------------*/
+// A block is a series of sequences, each a token byte (literal count in the top 4 bits, match length - 4 in the bottom 4), any
+// extra literal count bytes, the literals, a 16-bit offset back to the match and any extra match length bytes. Counts of 15 or
+// more continue in following bytes, each adding up to 255. The last sequence is only literals, and the last 5 bytes of the
+// data are always literals. The compressor is the simple greedy one: a hash table of the last position each 4 bytes were seen
+
+static const size_t LZ4_MIN_MATCH     = 4;
+static const size_t LZ4_LAST_LITERALS = 5;  // Bytes at the end that must be literals
+static const size_t LZ4_MATCH_LIMIT   = 12; // A match can't start within this many bytes of the end
+static const size_t LZ4_MAX_OFFSET    = 65535;
+static const int    LZ4_HASH_BITS     = 16;
+
+// Add a count that doesn't fit in a token's 4 bits
+static void LZ4WriteCount(std::vector<uint8_t>& output, size_t count)
+{
+	for (count -= 15; count >= 255; count -= 255)  output.push_back(255);
+	output.push_back(static_cast<uint8_t>(count));
+}
+
+// Add a sequence of literals then a match - a matchLength of 0 for the last sequence, which has no match
+static void LZ4WriteSequence(std::vector<uint8_t>& output, const uint8_t* literals, size_t numLiterals, size_t matchLength, size_t offset)
+{
+	size_t tokenPosition = output.size();
+	output.push_back(0);
+	uint8_t token = static_cast<uint8_t>(std::min<size_t>(numLiterals, 15) << 4);
+	if (numLiterals >= 15)  LZ4WriteCount(output, numLiterals);
+	output.insert(output.end(), literals, literals + numLiterals);
+
+	if (matchLength > 0)
+	{
+		output.push_back(static_cast<uint8_t>(offset & 0xFF));
+		output.push_back(static_cast<uint8_t>(offset >> 8));
+		size_t length = matchLength - LZ4_MIN_MATCH;
+		token |= static_cast<uint8_t>(std::min<size_t>(length, 15));
+		if (length >= 15)  LZ4WriteCount(output, length);
+	}
+	output[tokenPosition] = token;
+}
+
+
+// Compress data with LZ4. Returns an empty vector if the data doesn't get smaller
+std::vector<uint8_t> LZ4Compress(const uint8_t* data, size_t size)
+{
+	if (size == 0 || size >= UINT32_MAX)  return {};
+
+	std::vector<uint8_t> output;
+	output.reserve(size);
+	std::vector<uint32_t> lastSeen(size_t(1) << LZ4_HASH_BITS, UINT32_MAX);
+	auto hash = [](uint32_t bytes) { return (bytes * 2654435761u) >> (32 - LZ4_HASH_BITS); };
+
+	size_t literalStart = 0, position = 0;
+	if (size > LZ4_MATCH_LIMIT)
+	{
+		size_t matchEnd = size - LZ4_LAST_LITERALS;
+		while (position + LZ4_MATCH_LIMIT <= size)
+		{
+			uint32_t bytes;
+			std::memcpy(&bytes, data + position, sizeof(bytes));
+			uint32_t& slot = lastSeen[hash(bytes)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position);
+
+			if (candidate == UINT32_MAX || position - candidate > LZ4_MAX_OFFSET || std::memcmp(data + candidate, data + position, LZ4_MIN_MATCH) != 0)
+			{
+				++position;
+				continue;
+			}
+
+			size_t length = LZ4_MIN_MATCH;
+			while (position + length < matchEnd && data[candidate + length] == data[position + length])  ++length;
+			LZ4WriteSequence(output, data + literalStart, position - literalStart, length, position - candidate);
+			position += length;
+			literalStart = position;
+			if (output.size() >= size)  return {};
+		}
+	}
+	LZ4WriteSequence(output, data + literalStart, size - literalStart, 0, 0);
+
+	if (output.size() >= size)  return {};
+	return output;
+}
+
+
+// Decompress LZ4 data into output. Returns false if the data is damaged or doesn't decompress to exactly outputSize bytes
+bool LZ4Decompress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize)
+{
+	// Read a count that continues after the token, returns false if the data runs out
+	size_t position = 0, written = 0;
+	auto readCount = [&](size_t& count)
+	{
+		uint8_t extra;
+		do
+		{
+			if (position >= size)  return false;
+			extra = data[position++];
+			count += extra;
+		} while (extra == 255);
+		return true;
+	};
+
+	while (position < size)
+	{
+		uint8_t token = data[position++];
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !readCount(numLiterals))  return false;
+		if (numLiterals > size - position || numLiterals > outputSize - written)  return false;
+		std::memcpy(output + written, data + position, numLiterals);
+		position += numLiterals;
+		written  += numLiterals;
+		if (position == size)  break; // Last sequence
+
+		if (size - position < 2)  return false;
+		size_t offset = data[position] | (static_cast<size_t>(data[position + 1]) << 8);
+		position += 2;
+		if (offset == 0 || offset > written)  return false;
+
+		size_t length = token & 0xF;
+		if (length == 15 && !readCount(length))  return false;
+		length += LZ4_MIN_MATCH;
+		if (length > outputSize - written)  return false;
+
+		// Byte by byte, the match can overlap what it is writing (e.g. an offset of 1 repeats a byte)
+		const uint8_t* match = output + written - offset;
+		for (size_t i = 0; i < length; ++i)  output[written + i] = match[i];
+		written += length;
+	}
+	return written == outputSize;
+}
+
+
+// 64-bit FNV-1a hash of the contents of a file (read through gAssetFiles). Returns false if it can't be read
+bool HashFile(const std::filesystem::path& file, uint64_t& hash)
+{
+	AssetData data = gAssetFiles.Read(file);
+	if (data.empty() && !gAssetFiles.Exists(file))  return false;
+
+	hash = HashBytes(data.data(), data.size());
+	return true;
+}
@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------------------
+// AssetFiles class - reads asset files from packed archives or from the disk
+//--------------------------------------------------------------------------------------
+// All asset loading (meshes, textures, shaders, fonts, level files) reads through the global gAssetFiles rather than opening
+// files itself. Files are looked for in the mounted archives first, then on disk, so an archive can hold all the media in one
+// file, with loose files still working for anything not in it (e.g. while editing a level):
+//
+//   gAssetFiles.MountArchive("Assets.pak");           // At startup, before anything loads
+//   AssetData file = gAssetFiles.Read("Media/Boat.fbx");
+//   if (!file.empty())  ... use file.data() and file.size() ...
+//
+// An archive is a header, then the contents of each file one after the other, each starting at a multiple of ARCHIVE_ALIGNMENT,
+// then an index of the file names, sizes and positions. The archive is memory-mapped, so reading an uncompressed file doesn't
+// copy anything - the AssetData points straight into the mapping and the OS pages the contents in as they are used, e.g. as a
+// DDS texture or mesh cache is passed to CreateTexture2D/CreateBuffer. Files can also be LZ4 compressed in the archive, those
+// are decompressed into memory when read. Compression suits text and small files, GPU data is better left uncompressed
+//
+// Files are named by their path relative to the working folder, case insensitive, with either kind of slash. Absolute paths
+// inside the working folder work too. Can be used on several threads at once, but mount archives before loading starts
+//
+// Code that looks for many files that mostly don't exist (e.g. the textures a material might have, see MaterialRenderMethod in
+// Mesh.cpp) can use ExistsIndexed. It lists each folder on disk once, then answers from the list without asking the file system
+
+#ifndef _ASSET_FILES_H_INCLUDED_
+#define _ASSET_FILES_H_INCLUDED_
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <shared_mutex>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+
+class JobSystem;
+
+
+// Contents of a file read by AssetFiles. Either points into an archive's memory mapping, which it keeps open, or holds the
+// contents itself. Cheap to copy, copies share the same contents
+class AssetData
+{
+public:
+	AssetData() = default;
+
+	// Hold the given bytes, e.g. a file read from disk or built in memory
+	explicit AssetData(std::vector<uint8_t> bytes);
+
+	// Point into memory kept alive by the given owner (e.g. an archive mapping)
+	AssetData(const uint8_t* data, size_t size, std::shared_ptr<const void> owner)
+		: mData(data), mSize(size), mOwner(std::move(owner)) {}
+
+	const uint8_t* data() const  { return mData; }
+	size_t         size() const  { return mSize; }
+	bool           empty() const { return mSize == 0; }
+
+private:
+	const uint8_t*              mData = nullptr;
+	size_t                      mSize = 0;
+	std::shared_ptr<const void> mOwner;
+};
+
+
+// Size and modification time of a file. The time is in std::filesystem::file_time_type ticks, as the time of the original file
+// when it was packed for files in an archive
+struct AssetInfo
+{
+	uint64_t size = 0;
+	int64_t  time = 0;
+};
+
+
+// A file to put in an archive, see BuildAssetArchive
+struct AssetArchiveFile
+{
+	std::filesystem::path path;             // Also its name in the archive, so relative to the working folder
+	bool                  compress = false; // Stored with LZ4 if that makes it smaller
+};
+
+
+// Start of each file's contents within an archive, a page so each file's contents are mapped separately
+static const uint64_t ARCHIVE_ALIGNMENT = 4096;
+
+
+class AssetFiles
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	AssetFiles() = default;
+
+	// Prevent copying - mounted archives are shared with the AssetData read from them
+	AssetFiles(const AssetFiles&) = delete;
+	AssetFiles& operator=(const AssetFiles&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Archives
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Memory-map the given archive, its files are found before those on disk. Archives mounted later are searched first. Returns
+	// false if the archive doesn't exist or is damaged, then call GetLastError()
+	bool MountArchive(const std::filesystem::path& archiveFile);
+
+	// Unmount all archives. Data already read from them stays valid until it is released
+	void UnmountAll();
+
+	// Number of files in the mounted archives
+	size_t ArchivedFileCount();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Reading files
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether the given file exists in a mounted archive or on disk
+	bool Exists(const std::filesystem::path& file);
+
+	// As Exists, but files on disk are looked up in an index of the names in their folder, made the first time the folder is
+	// looked in. Case insensitive, as archive names are. Files added to or removed from the folder after that are not seen until
+	// InvalidateFolderIndexes is called
+	bool ExistsIndexed(const std::filesystem::path& file);
+
+	// Forget the folder indexes of ExistsIndexed, they are made again from the disk as they are next used. Call when files may
+	// have changed on disk, e.g. before reloading a level
+	void InvalidateFolderIndexes();
+
+	// Whether the given file is in a mounted archive
+	bool InArchive(const std::filesystem::path& file);
+
+	// Get the size and modification time of the given file. Returns false if it doesn't exist
+	bool GetInfo(const std::filesystem::path& file, AssetInfo& info);
+
+	// Read the whole of the given file. Returns empty data if the file doesn't exist or can't be read, then call GetLastError()
+	AssetData Read(const std::filesystem::path& file);
+
+	// Read the start of the given file, e.g. a header, without reading the rest from disk. Gives the first size bytes, or the
+	// whole file if it is shorter or is compressed in an archive. Returns empty data on failure as Read does
+	AssetData ReadStart(const std::filesystem::path& file, size_t size);
+
+	// Start or stop keeping a list of the files Read looks for on disk rather than finding in an archive, whether or not they
+	// exist, e.g. to pack the files a level loads into an archive for other processes to map (see RunHeadlessBattle in Main.cpp).
+	// Starting clears the list
+	void RecordDiskReads(bool record);
+
+	// The files recorded since RecordDiskReads(true), in the order first read, each once
+	std::vector<std::filesystem::path> RecordedDiskReads();
+
+
+	// Description of the most recent error
+	std::string GetLastError()  { std::lock_guard<std::mutex> lock(mErrorMutex);  return mLastError; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// A file in an archive
+	struct Entry
+	{
+		uint64_t offset;     // Of the contents from the start of the archive
+		uint64_t storedSize; // Size in the archive, smaller than size if compressed
+		uint64_t size;
+		int64_t  time;
+		bool     compressed;
+	};
+
+	// A mounted archive, held by shared_ptr so data read from it can keep it open after it is unmounted
+	struct Archive;
+
+	// Find the given file in the mounted archives, returns the entry and fills in its archive, or nullptr if not found. Call
+	// with mArchivesMutex held
+	const Entry* Find(const std::filesystem::path& file, std::shared_ptr<Archive>* archive = nullptr);
+
+	void SetLastError(std::string error)  { std::lock_guard<std::mutex> lock(mErrorMutex);  mLastError = std::move(error); }
+
+	std::vector<std::shared_ptr<Archive>> mArchives; // Most recently mounted first
+	std::shared_mutex                     mArchivesMutex;
+
+	// Lower case names of the files in each folder looked in by ExistsIndexed, by the folder's archive style name (see top of file)
+	std::unordered_map<std::string, std::unordered_set<std::string>> mFolderIndexes;
+	std::shared_mutex                                                mFolderIndexesMutex;
+
+	// See RecordDiskReads
+	std::atomic<bool>                  mRecordDiskReads = false;
+	std::vector<std::filesystem::path> mRecordedDiskReads;
+	std::unordered_set<std::string>    mRecordedNames; // Archive style names (see top of file) of mRecordedDiskReads
+	std::mutex                         mRecordMutex;
+
+	std::string mLastError;
+	std::mutex  mErrorMutex;
+};
+
+
+// What BuildAssetArchive did with the files
+struct AssetArchiveStats
+{
+	uint32_t packed   = 0;     // Read from disk and compressed afresh
+	uint32_t reused   = 0;     // Unchanged since the existing archive, copied from it as stored
+	bool     upToDate = false; // The existing archive already held exactly these files, so wasn't written
+};
+
+// Write an archive containing the given files, replacing any existing one. Returns false if a file can't be read or the archive
+// can't be written, with a description in error. The build is incremental: the contents of files that hash the same as in the
+// existing archive are copied from it rather than compressed again. With a job system the files are hashed and compressed in
+// parallel on it
+bool BuildAssetArchive(const std::filesystem::path& archiveFile, const std::vector<AssetArchiveFile>& files, std::string& error,
+                       JobSystem* jobSystem = nullptr, AssetArchiveStats* stats = nullptr);
+
+
+// LZ4 block compression (the format of the LZ4 library) used in archives. Compress returns an empty vector if the data doesn't
+// get smaller. Decompress returns false if the data is damaged or doesn't decompress to exactly the given size
+std::vector<uint8_t> LZ4Compress(const uint8_t* data, size_t size);
+bool LZ4Decompress(const uint8_t* data, size_t size, uint8_t* output, size_t outputSize);
+
+
+// 64-bit FNV-1a hash of the contents of a file (read through gAssetFiles), e.g. to tell whether a cache made from it is still
+// in date. Returns false if it can't be read
+bool HashFile(const std::filesystem::path& file, uint64_t& hash);
+
+
+// The asset files used by all loading code
+extern AssetFiles gAssetFiles;
+
+
+#endif // _ASSET_FILES_H_INCLUDED_
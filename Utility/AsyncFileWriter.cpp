@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// AsyncFileWriter class - writes a binary file on a background thread
+//--------------------------------------------------------------------------------------
+
+#include "AsyncFileWriter.h"
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Closes the file if it is open
+AsyncFileWriter::~AsyncFileWriter()
+{
+	Close();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Create the given file, replacing any existing one, and start the background thread. Returns false if the file can't be created
+bool AsyncFileWriter::Open(const std::string& fileName)
+{
+	Close();
+
+	mFile = std::fopen(fileName.c_str(), "wb");
+	if (mFile == nullptr)  return false;
+
+	mCollecting.clear();
+	mCollecting.reserve(BUFFER_SIZE);
+	mWritePending = false;
+	mClosing      = false;
+	mFailed       = false;
+	mWriterThread = std::thread(&AsyncFileWriter::WriterLoop, this);
+	return true;
+}
+
+
+// Add the given data to the end of the file
+void AsyncFileWriter::Write(const void* data, size_t size)
+{
+	if (mFile == nullptr)  return;
+
+	const std::byte* bytes = static_cast<const std::byte*>(data);
+	mCollecting.insert(mCollecting.end(), bytes, bytes + size);
+	if (mCollecting.size() >= BUFFER_SIZE)  SubmitBuffer();
+}
+
+
+// Write any data still buffered, close the file and stop the background thread. Returns false if anything failed to be written
+bool AsyncFileWriter::Close()
+{
+	if (mFile == nullptr)  return true;
+
+	if (!mCollecting.empty())  SubmitBuffer();
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mClosing = true;
+	}
+	mWriteReady.notify_one();
+	mWriterThread.join();
+
+	if (std::fclose(mFile) != 0)  mFailed = true;
+	mFile = nullptr;
+	return !mFailed;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Pass the buffer being collected to the background thread, waiting for it to finish the previous one first. The buffers are
+// swapped rather than copied so both keep their capacity
+void AsyncFileWriter::SubmitBuffer()
+{
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWriteDone.wait(lock, [this] { return !mWritePending; });
+		mWriting.swap(mCollecting);
+		mWritePending = true;
+	}
+	mWriteReady.notify_one();
+	mCollecting.clear();
+}
+
+
+// Function run by the background thread - writes each buffer submitted until the file is closed. Any buffer submitted before
+// closing is written first
+void AsyncFileWriter::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		mWriteReady.wait(lock, [this] { return mWritePending || mClosing; });
+		if (!mWritePending)  return; // Closing with nothing left to write
+
+		// Write without holding the lock, the calling thread doesn't touch mWriting while a write is pending
+		lock.unlock();
+		bool written = std::fwrite(mWriting.data(), 1, mWriting.size(), mFile) == mWriting.size();
+		lock.lock();
+
+		if (!written)  mFailed = true;
+		mWritePending = false;
+		mWriteDone.notify_one();
+	}
+}
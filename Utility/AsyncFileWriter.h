@@ -0,0 +1,87 @@
+//--------------------------------------------------------------------------------------
+// AsyncFileWriter class - writes a binary file on a background thread
+//--------------------------------------------------------------------------------------
+// Data written is collected in a memory buffer. When the buffer is full it is passed to a background thread to write to the
+// file while a second buffer collects more data, so the calling thread never waits for the disk unless it writes faster than
+// the disk can keep up. Only one thread may call Write.
+//
+//   AsyncFileWriter writer;
+//   if (!writer.Open("Log.bin"))  ...;
+//   writer.Write(&record, sizeof(record));
+//   writer.Close(); // Writes what is left and waits for the file to be finished
+
+#ifndef _ASYNC_FILE_WRITER_H_INCLUDED_
+#define _ASYNC_FILE_WRITER_H_INCLUDED_
+
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+class AsyncFileWriter
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	AsyncFileWriter() = default;
+
+	// Closes the file if it is open, see Close
+	~AsyncFileWriter();
+
+	// Prevent copying - the writer owns its thread
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the given file, replacing any existing one, and start the background thread. Returns false if the file can't be
+	// created. Closes any file already open first
+	bool Open(const std::string& fileName);
+
+	// Add the given data to the end of the file
+	void Write(const void* data, size_t size);
+
+	// Write any data still buffered, close the file and stop the background thread. Returns false if anything failed to be
+	// written since the file was opened
+	bool Close();
+
+	bool IsOpen()  { return mFile != nullptr; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Function run by the background thread - writes each full buffer it is given
+	void WriterLoop();
+
+	// Pass the buffer being collected to the background thread, waiting for it to finish the previous one first
+	void SubmitBuffer();
+
+	// Data is passed to the background thread when this much has been collected
+	static constexpr size_t BUFFER_SIZE = 256 * 1024;
+
+	std::FILE*  mFile = nullptr;
+	std::thread mWriterThread;
+
+	std::vector<std::byte> mCollecting; // Buffer being filled by Write, only used by the calling thread
+	std::vector<std::byte> mWriting;    // Buffer given to the background thread, only changed while mWritePending is false
+
+	std::mutex              mMutex;
+	std::condition_variable mWriteReady; // Signalled when a buffer is submitted or on close
+	std::condition_variable mWriteDone;  // Signalled when the background thread has written a buffer
+	bool mWritePending = false;
+	bool mClosing      = false;
+	bool mFailed       = false;
+};
+
+
+#endif //_ASYNC_FILE_WRITER_H_INCLUDED_
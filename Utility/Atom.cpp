@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// Atoms - strings held once in a table and compared and hashed as a number
+//--------------------------------------------------------------------------------------
+
+#include "Atom.h"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <stdexcept>
+
+
+namespace
+{
+	// The strings are kept in fixed size blocks that never move, so an atom's text can be read while another thread adds
+	// strings, and the table's keys can be views of them
+	constexpr uint32_t BLOCK_SIZE = 1024;
+	constexpr uint32_t MAX_BLOCKS = 4096; // Room for four million strings
+
+	struct AtomTable
+	{
+		std::mutex mutex; // Held while adding, and while looking up text
+		std::unordered_map<std::string_view, uint32_t> indexes;
+		std::atomic<std::string*> blocks[MAX_BLOCKS] = {};
+		std::atomic<uint32_t> count = 1; // Index 0 is the empty string
+
+		AtomTable()  { blocks[0] = new std::string[BLOCK_SIZE]; }
+	};
+
+	// Made on first use so atoms can be made while other globals are constructed, and never destroyed so they can be read
+	// while others are destroyed
+	AtomTable& Table()
+	{
+		static AtomTable* table = new AtomTable;
+		return *table;
+	}
+}
+
+
+// The atom for the given text, adding the text to the table if it is new
+Atom::Atom(std::string_view text)
+{
+	if (text.empty())  return;
+
+	AtomTable& table = Table();
+	std::lock_guard lock(table.mutex);
+	auto found = table.indexes.find(text);
+	if (found != table.indexes.end())
+	{
+		mIndex = found->second;
+		return;
+	}
+
+	uint32_t index = table.count.load(std::memory_order_relaxed);
+	uint32_t block = index / BLOCK_SIZE;
+	if (block >= MAX_BLOCKS)  throw std::runtime_error("Too many different names");
+	if (table.blocks[block].load(std::memory_order_relaxed) == nullptr)
+		table.blocks[block].store(new std::string[BLOCK_SIZE], std::memory_order_release);
+
+	std::string& stored = table.blocks[block].load(std::memory_order_relaxed)[index % BLOCK_SIZE];
+	stored = text;
+	table.indexes.emplace(stored, index);
+	table.count.store(index + 1, std::memory_order_release);
+	mIndex = index;
+}
+
+
+// Find the atom for the given text without adding it to the table. Returns false if the text has never been made into an atom
+bool Atom::Find(std::string_view text, Atom& atom)
+{
+	atom = Atom();
+	if (text.empty())  return true;
+
+	AtomTable& table = Table();
+	std::lock_guard lock(table.mutex);
+	auto found = table.indexes.find(text);
+	if (found == table.indexes.end())  return false;
+	atom.mIndex = found->second;
+	return true;
+}
+
+
+// Number of different strings in the table
+uint32_t Atom::Count()
+{
+	return Table().count.load(std::memory_order_acquire);
+}
+
+
+// The atom's text. An atom passed between threads was passed with the synchronisation that makes its string visible
+const std::string& Atom::str() const
+{
+	return Table().blocks[mIndex / BLOCK_SIZE].load(std::memory_order_acquire)[mIndex % BLOCK_SIZE];
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// Atoms - strings held once in a table and compared and hashed as a number
+//--------------------------------------------------------------------------------------
+// An atom stands for a piece of text kept once in an app-wide table. Making an atom from text hashes the text and looks it
+// up (adding it the first time it is seen), after that copying, comparing and hashing the atom are single integer operations
+// and its text is read straight from the table. Template types and entity names are atoms, so creating an entity from a
+// template or finding one by name hashes a number rather than a string. Text used over and over is made into an atom once:
+//
+//   static const Atom MISSILE("Missile");
+//   gEntityManager->CreateEntity<Missile>(MISSILE, transform, ...);
+//   if (entity->GetNameAtom() == playerName)  ...
+//   ImGui::Text("%s", atom.c_str());
+//
+// Text is never removed from the table, so atoms suit names a game reuses (template types, level entity names), not text that
+// keeps changing. Atoms can be made on any thread (templates are loaded on background threads), reading an atom's text takes
+// no lock. The default atom is the empty string. Atoms order by when their text was first seen, not alphabetically
+
+#ifndef _ATOM_H_INCLUDED_
+#define _ATOM_H_INCLUDED_
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <stdint.h>
+
+
+class Atom
+{
+	/*-----------------------------------------------------------------------------------------
+	   Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The empty string
+	Atom() = default;
+
+	// The atom for the given text, adding the text to the table if it is new. Implicit so a string can be passed wherever an
+	// atom is expected, but each conversion hashes the string, keep atoms for text used often
+	Atom(std::string_view text);
+	Atom(const std::string& text) : Atom(std::string_view(text)) {}
+	Atom(const char* text)        : Atom(std::string_view(text)) {}
+
+	// Find the atom for the given text without adding it to the table, e.g. to look up a name typed by the user. Returns false
+	// if the text has never been made into an atom, then nothing can be using it
+	static bool Find(std::string_view text, Atom& atom);
+
+	// Number of different strings in the table, for display
+	static uint32_t Count();
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	const std::string& str() const;
+	const char*        c_str() const  { return str().c_str(); }
+	bool               empty() const  { return mIndex == 0; }
+
+	// Position of the text in the table, the same for equal text for the rest of the run. Not saved, as it depends on the
+	// order text was first seen
+	uint32_t Index() const  { return mIndex; }
+
+	bool operator==(const Atom& other) const  { return mIndex == other.mIndex; }
+	bool operator!=(const Atom& other) const  { return mIndex != other.mIndex; }
+	bool operator< (const Atom& other) const  { return mIndex <  other.mIndex; }
+
+
+	/*-----------------------------------------------------------------------------------------
+	   Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	uint32_t mIndex = 0;
+};
+
+
+// Atoms hash as their index so unordered containers keyed by atoms never look at the text
+template <>
+struct std::hash<Atom>
+{
+	size_t operator()(const Atom& atom) const  { return std::hash<uint32_t>{}(atom.Index()); }
+};
+
+
+#endif //_ATOM_H_INCLUDED_
@@ -0,0 +1,252 @@
+//--------------------------------------------------------------------------------------
+// Batch runner - runs many headless battles in parallel and collects their results as CSV
+//--------------------------------------------------------------------------------------
+
+#include "BatchRunner.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks std::clamp
+#include <windows.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+
+/*-----------------------------------------------------------------------------------------
+	Job file
+-----------------------------------------------------------------------------------------*/
+
+// Read the battles listed in a job file into jobs, in order. Returns false with error set on failure
+bool ReadBattleJobs(const std::filesystem::path& jobFile, std::vector<BattleJob>& jobs, std::string& error)
+{
+	std::ifstream file(jobFile);
+	if (!file)
+	{
+		error = "Batch Runner: Cannot open job file " + jobFile.string();
+		return false;
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+	{
+		std::istringstream fields(line);
+		std::string levelFile, seeds, time;
+		if (!(fields >> levelFile) || levelFile[0] == '#')  continue; // Blank line or comment
+
+		try
+		{
+			if (!(fields >> seeds))  throw std::invalid_argument("no seeds");
+			float timeLimit = (fields >> time) ? std::stof(time) : 300.0f;
+
+			// Single seed or range first-last
+			size_t dash = seeds.find('-');
+			uint64_t firstSeed = std::stoull(seeds.substr(0, dash));
+			uint64_t lastSeed  = dash == std::string::npos ? firstSeed : std::stoull(seeds.substr(dash + 1));
+			if (lastSeed < firstSeed || timeLimit <= 0)  throw std::invalid_argument("bad seeds or time limit");
+
+			for (uint64_t seed = firstSeed; seed <= lastSeed; ++seed)  jobs.push_back({ levelFile, seed, timeLimit });
+		}
+		catch (const std::logic_error&) // std::stoull throws invalid_argument or out_of_range, both logic errors
+		{
+			error = "Batch Runner: Cannot read line " + std::to_string(lineNumber) + " of " + jobFile.string() +
+			        ", expected <level file> <seed or first-last seeds> [time limit]";
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Work queue
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	// Files in the queue folder for the battle with the given index. The worker writes to the part file, which is renamed
+	// to the results file when the worker succeeds or to the error file when it fails, so other runners never see a
+	// half-written file
+	std::filesystem::path QueueFile(const std::filesystem::path& queueFolder, size_t index, const char* type)
+	{
+		return queueFolder / (std::to_string(index) + type);
+	}
+
+	// Claim the battle with the given index for this process. Returns false if another process, possibly on another
+	// machine, already has it. Creating a new file either succeeds or fails as a whole, even on a network share
+	bool ClaimBattle(const std::filesystem::path& queueFolder, size_t index)
+	{
+		HANDLE claim = CreateFileW(QueueFile(queueFolder, index, ".claim").c_str(), GENERIC_WRITE, 0, nullptr,
+		                           CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (claim == INVALID_HANDLE_VALUE)  return false;
+		CloseHandle(claim);
+		return true;
+	}
+
+	// Start a headless process for the given battle writing CSV to resultsFile, sharing the level's files through sharedFile
+	// (see top of BatchRunner.h). Returns the process handle, or nullptr if it can't be started
+	HANDLE StartBattle(const std::wstring& exe, const BattleJob& job, const std::filesystem::path& resultsFile,
+	                   const std::filesystem::path& sharedFile)
+	{
+		std::wstring commandLine = L"\"" + exe + L"\" -headless \"" + std::filesystem::path(job.levelFile).wstring() +
+		                           L"\" -seed " + std::to_wstring(job.seed) + L" -time " + std::to_wstring(job.timeLimit) +
+		                           L" -out \"" + resultsFile.wstring() + L"\" -shared \"" + sharedFile.wstring() + L"\"";
+
+		// Below normal priority keeps the machine responsive while every core is busy
+		STARTUPINFOW startup = { sizeof(startup) };
+		PROCESS_INFORMATION process = {};
+		if (!CreateProcessW(exe.c_str(), commandLine.data(), nullptr, nullptr, FALSE, CREATE_NO_WINDOW | BELOW_NORMAL_PRIORITY_CLASS,
+		                    nullptr, nullptr, &startup, &process))  return nullptr;
+		CloseHandle(process.hThread);
+		return process.hProcess;
+	}
+
+	// Wait until the first worker of a level has packed the level's files into sharedFile for the others to map, or has
+	// finished without doing so (e.g. the level failed to load), then the others load from disk as usual
+	void WaitForSharedAssets(HANDLE process, const std::filesystem::path& sharedFile)
+	{
+		std::error_code fileError;
+		while (!std::filesystem::exists(sharedFile, fileError) && WaitForSingleObject(process, 100) == WAIT_TIMEOUT) {}
+	}
+
+	// A worker process and the battle it is running
+	struct Worker
+	{
+		HANDLE process;
+		size_t index;
+	};
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Running the batch
+-----------------------------------------------------------------------------------------*/
+
+// Run the battles in a job file, up to the given number of worker processes at once, and write the results of every battle
+// finished so far to resultsFile. Returns false with error set on failure
+bool RunBattleBatch(const std::filesystem::path& jobFile, const std::filesystem::path& resultsFile, int workers, std::string& error)
+{
+	std::vector<BattleJob> jobs;
+	if (!ReadBattleJobs(jobFile, jobs, error))  return false;
+
+	std::filesystem::path queueFolder = jobFile;
+	queueFolder += ".queue";
+	std::error_code fileError;
+	std::filesystem::create_directories(queueFolder, fileError);
+	if (fileError)
+	{
+		error = "Batch Runner: Cannot create work queue folder " + queueFolder.string();
+		return false;
+	}
+
+	// Each worker is another copy of this executable
+	wchar_t exe[MAX_PATH];
+	if (GetModuleFileNameW(nullptr, exe, MAX_PATH) == 0)
+	{
+		error = "Batch Runner: Cannot find the executable to start workers with";
+		return false;
+	}
+
+	// The archive of each level's files shared by this runner's workers, in a folder of its own on this machine as the pages
+	// of a mapped file are only shared between processes on the same machine. Removed when the workers are done, so an edited
+	// level is never loaded from a stale archive by a later batch
+	std::filesystem::path sharedFolder = std::filesystem::temp_directory_path(fileError) /
+	                                     ("BoatsBatch" + std::to_string(GetCurrentProcessId()));
+	std::filesystem::remove_all(sharedFolder, fileError);
+	std::filesystem::create_directories(sharedFolder, fileError);
+	std::map<std::string, std::filesystem::path> sharedFiles; // By level file
+
+	// Keep the workers busy, claiming the next unclaimed battle as each finishes. A battle whose worker can't be started is
+	// released again for another machine, and no more are claimed. The first battle of each level runs alone until it has
+	// packed the level's files, so the rest of the level's battles map them rather than each reading its own copy
+	workers = std::clamp(workers, 1, static_cast<int>(MAXIMUM_WAIT_OBJECTS));
+	std::vector<Worker> running;
+	std::vector<HANDLE> processes;
+	size_t next = 0;
+	int failed = 0;
+	while (true)
+	{
+		while (running.size() < static_cast<size_t>(workers) && next < jobs.size())
+		{
+			size_t index = next++;
+			if (!ClaimBattle(queueFolder, index))  continue;
+			auto shared = sharedFiles.find(jobs[index].levelFile);
+			bool firstOfLevel = shared == sharedFiles.end();
+			if (firstOfLevel)
+			{
+				std::filesystem::path sharedFile = sharedFolder / ("Level" + std::to_string(sharedFiles.size()) + ".pak");
+				shared = sharedFiles.emplace(jobs[index].levelFile, sharedFile).first;
+			}
+			HANDLE process = StartBattle(exe, jobs[index], QueueFile(queueFolder, index, ".part.csv"), shared->second);
+			if (process == nullptr)
+			{
+				std::filesystem::remove(QueueFile(queueFolder, index, ".claim"), fileError);
+				error = "Batch Runner: Cannot start worker process";
+				next = jobs.size();
+				break;
+			}
+			running.push_back({ process, index });
+			if (firstOfLevel)  WaitForSharedAssets(process, shared->second);
+		}
+		if (running.empty())  break;
+
+		processes.clear();
+		for (const Worker& worker : running)  processes.push_back(worker.process);
+		DWORD wait = WaitForMultipleObjects(static_cast<DWORD>(processes.size()), processes.data(), FALSE, INFINITE);
+		if (wait >= WAIT_OBJECT_0 + processes.size())
+		{
+			std::filesystem::remove_all(sharedFolder, fileError);
+			error = "Batch Runner: Lost track of worker processes";
+			return false;
+		}
+
+		// Publish the finished battle's results, or its error
+		Worker finished = running[wait - WAIT_OBJECT_0];
+		running.erase(running.begin() + (wait - WAIT_OBJECT_0));
+		DWORD exitCode = 1;
+		GetExitCodeProcess(finished.process, &exitCode);
+		CloseHandle(finished.process);
+		if (exitCode != 0)  ++failed;
+		std::filesystem::rename(QueueFile(queueFolder, finished.index, ".part.csv"),
+		                        QueueFile(queueFolder, finished.index, exitCode == 0 ? ".csv" : ".error.txt"), fileError);
+	}
+
+	std::filesystem::remove_all(sharedFolder, fileError);
+
+	// Gather every finished battle in job order, including those run by other machines. Each battle's file has the column
+	// names as its first line, only the first is kept
+	std::ofstream results(resultsFile);
+	if (!results)
+	{
+		error = "Batch Runner: Cannot write results file " + resultsFile.string();
+		return false;
+	}
+	bool headerWritten = false;
+	for (size_t index = 0; index < jobs.size(); ++index)
+	{
+		std::ifstream battle(QueueFile(queueFolder, index, ".csv"));
+		if (!battle)  continue; // Not finished yet, or failed
+
+		std::string line;
+		if (!std::getline(battle, line))  continue;
+		if (!headerWritten)  results << line << '\n';
+		headerWritten = true;
+		while (std::getline(battle, line))
+		{
+			if (!line.empty())  results << line << '\n';
+		}
+	}
+	if (!results)
+	{
+		error = "Batch Runner: Error writing results file " + resultsFile.string();
+		return false;
+	}
+
+	if (failed > 0)
+	{
+		error = "Batch Runner: " + std::to_string(failed) + " battles failed, see the .error.txt files in " + queueFolder.string();
+		return false;
+	}
+	return error.empty();
+}
@@ -0,0 +1,53 @@
+//--------------------------------------------------------------------------------------
+// Batch runner - runs many headless battles in parallel and collects their results as CSV
+//--------------------------------------------------------------------------------------
+// A job file lists the battles, one scenario per line: a level file, the seeds to run it with and optionally the time limit
+// in seconds of game time (default 300). Seeds are a single number or a range. Lines starting with # are ignored, e.g.
+//
+//   # Level              Seeds    Time limit
+//   Entities.xml         1-500    300
+//   Levels/ThreeTeams.xml 1-200
+//
+// Team compositions are varied with different level files, as boat templates and their settings are read from the level.
+//
+// The scene uses globals, so each battle is run by its own headless process (see RunHeadlessBattle in Main.cpp), as many at
+// once as there are workers. The work queue is a folder next to the job file (<job file>.queue). A battle is claimed by
+// creating its .claim file in the folder, which only one process can do, so several machines running the same job file
+// from a shared folder split the battles between them. A finished battle's rows are left in the folder, and when a runner
+// has no battles left to claim it waits for its own, then gathers every finished battle into the results CSV - the last
+// machine to finish writes the complete results. Running the batch again with the queue folder in place just gathers the
+// results, delete the folder to start again
+//
+// The battles of a level all load the same level and mesh files. Rather than each worker reading its own copy, the first
+// worker to run a level packs the files it read into an uncompressed archive in a temporary folder, while the runner holds
+// back the other workers. They then mount the archive, and as its files are memory-mapped read-only the OS keeps one copy
+// of them in memory for every worker on the machine
+
+#ifndef _BATCH_RUNNER_H_INCLUDED_
+#define _BATCH_RUNNER_H_INCLUDED_
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// A single battle from a job file
+struct BattleJob
+{
+	std::string levelFile;
+	uint64_t    seed;
+	float       timeLimit;
+};
+
+// Read the battles listed in a job file into jobs, in order. Returns false with error set if the file can't be read or has
+// a line that doesn't make sense
+bool ReadBattleJobs(const std::filesystem::path& jobFile, std::vector<BattleJob>& jobs, std::string& error);
+
+// Run the battles in a job file, up to the given number of worker processes at once, and write the results of every battle
+// finished so far (by this or any other machine) to resultsFile. Returns false with error set if the job file can't be read,
+// the results can't be written or any battle failed (its error is left in the queue folder)
+bool RunBattleBatch(const std::filesystem::path& jobFile, const std::filesystem::path& resultsFile, int workers, std::string& error);
+
+
+#endif //_BATCH_RUNNER_H_INCLUDED_
@@ -0,0 +1,204 @@
+//--------------------------------------------------------------------------------------
+// CpuProfiler class - times named scopes of CPU work on every thread, frame by frame
+//--------------------------------------------------------------------------------------
+
+#include "CpuProfiler.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <map>
+#include <string_view>
+#include <functional>
+
+
+CpuProfiler gCpuProfiler;
+
+// The calling thread's buffer in gCpuProfiler, and the number of its scopes open. There is only the one profiler
+static thread_local void*    tProfileBuffer = nullptr;
+static thread_local uint16_t tProfileDepth  = 0;
+
+
+/*-----------------------------------------------------------------------------------------
+	Recording
+-----------------------------------------------------------------------------------------*/
+
+// Record a finished scope for the calling thread, dropped if the thread's buffer is full
+void CpuProfiler::Record(const char* name, int64_t start, int64_t end, uint16_t depth)
+{
+	ThreadBuffer& buffer = CurrentBuffer();
+
+	// The read count is only increased by the collector, so a full buffer can only become less full while this looks at it
+	uint32_t written = buffer.written.load(std::memory_order_relaxed);
+	if (written - buffer.read.load(std::memory_order_acquire) >= BUFFER_SIZE)
+	{
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	buffer.events[written & (BUFFER_SIZE - 1)] = { name, start, end, depth, buffer.index };
+	buffer.written.store(written + 1, std::memory_order_release); // The event is complete before the collector can see it
+}
+
+
+// Collect the scopes finished since the last call as the last frame
+void CpuProfiler::NextFrame()
+{
+	int64_t now = Now();
+	mCollecting.events.clear();
+	mCollecting.dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		for (auto& buffer : mBuffers)
+		{
+			uint32_t read    = buffer->read.load(std::memory_order_relaxed);
+			uint32_t written = buffer->written.load(std::memory_order_acquire);
+			for (; read != written; ++read)  mCollecting.events.push_back(buffer->events[read & (BUFFER_SIZE - 1)]);
+			buffer->read.store(read, std::memory_order_release);
+			mCollecting.dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+		}
+		mCollecting.numThreads = static_cast<uint32_t>(mBuffers.size());
+	}
+	mCollecting.start = mFrameStart;
+	mCollecting.end   = now;
+	mFrameStart = now;
+
+	if (!mFrozen)  std::swap(mLastFrame, mCollecting);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Display
+-----------------------------------------------------------------------------------------*/
+
+// Draw the last frame in the current ImGui window: a timeline with a row per thread and scopes stacked by depth, then the
+// total time of each scope name
+void CpuProfiler::DrawTimeline()
+{
+	const Frame& frame = mLastFrame;
+	int64_t ticks = std::max<int64_t>(frame.end - frame.start, 1);
+	ImGui::Text("Frame: %.2fms  Scopes: %zu  Dropped: %u", TicksToMilliseconds(ticks), frame.events.size(), frame.dropped);
+
+	// Each thread's rows are as many as its deepest scope needs, threads that recorded nothing this frame get none
+	std::vector<uint16_t> threadDepth(frame.numThreads, 0);
+	std::vector<bool>     threadUsed(frame.numThreads, false);
+	for (const Event& event : frame.events)
+	{
+		threadDepth[event.thread] = std::max(threadDepth[event.thread], event.depth);
+		threadUsed[event.thread] = true;
+	}
+	const float ROW_HEIGHT = ImGui::GetTextLineHeight() + 2.0f;
+	const float LABEL_WIDTH = 70.0f;
+	std::vector<float> threadTop(frame.numThreads, 0.0f);
+	float height = 0.0f;
+	for (uint32_t t = 0; t < frame.numThreads; ++t)
+	{
+		threadTop[t] = height;
+		if (threadUsed[t])  height += (threadDepth[t] + 1) * ROW_HEIGHT + 4.0f;
+	}
+	if (height == 0.0f)  return;
+
+	ImVec2 origin = ImGui::GetCursorScreenPos();
+	float  width  = std::max(ImGui::GetContentRegionAvail().x - LABEL_WIDTH, 100.0f);
+	ImGui::InvisibleButton("##CpuTimeline", ImVec2(width + LABEL_WIDTH, height));
+	bool   hovered = ImGui::IsItemHovered();
+	ImVec2 mouse   = ImGui::GetIO().MousePos;
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(ImVec2(origin.x + LABEL_WIDTH, origin.y), ImVec2(origin.x + LABEL_WIDTH + width, origin.y + height),
+	                        IM_COL32(30, 30, 30, 255));
+	for (uint32_t t = 0; t < frame.numThreads; ++t)
+	{
+		if (!threadUsed[t])  continue;
+		char label[16];
+		snprintf(label, sizeof(label), "Thread %u", t);
+		drawList->AddText(ImVec2(origin.x, origin.y + threadTop[t]), IM_COL32(200, 200, 200, 255), label);
+	}
+
+	// Scopes that started in the last frame or end in the next are cut off at the frame's edges. A colour for each name
+	const Event* hoveredEvent = nullptr;
+	drawList->PushClipRect(ImVec2(origin.x + LABEL_WIDTH, origin.y), ImVec2(origin.x + LABEL_WIDTH + width, origin.y + height), true);
+	for (const Event& event : frame.events)
+	{
+		float x0 = origin.x + LABEL_WIDTH + width * std::clamp(static_cast<float>(event.start - frame.start) / ticks, 0.0f, 1.0f);
+		float x1 = origin.x + LABEL_WIDTH + width * std::clamp(static_cast<float>(event.end   - frame.start) / ticks, 0.0f, 1.0f);
+		x1 = std::max(x1, x0 + 1.0f);
+		float y0 = origin.y + threadTop[event.thread] + event.depth * ROW_HEIGHT;
+		float y1 = y0 + ROW_HEIGHT - 1.0f;
+
+		size_t hash = std::hash<std::string_view>()(event.name);
+		ImU32 colour = ImColor::HSV((hash % 360) / 360.0f, 0.5f, 0.7f);
+		drawList->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), colour);
+		if (ImGui::CalcTextSize(event.name).x < x1 - x0 - 4.0f)
+		{
+			drawList->AddText(ImVec2(x0 + 2.0f, y0 + 1.0f), IM_COL32(0, 0, 0, 255), event.name);
+		}
+		if (hovered && mouse.x >= x0 && mouse.x < x1 && mouse.y >= y0 && mouse.y < y1)  hoveredEvent = &event;
+	}
+	drawList->PopClipRect();
+
+	if (hoveredEvent != nullptr)
+	{
+		ImGui::SetTooltip("%s\n%.3fms", hoveredEvent->name, TicksToMilliseconds(hoveredEvent->end - hoveredEvent->start));
+	}
+
+	// Totals by name. The same literal can have a different address in each file it is used in, so names are compared by text
+	struct Total
+	{
+		int64_t  ticks = 0;
+		uint32_t count = 0;
+	};
+	std::map<std::string_view, Total> totals;
+	for (const Event& event : frame.events)
+	{
+		Total& total = totals[event.name];
+		total.ticks += event.end - event.start;
+		++total.count;
+	}
+	std::vector<std::pair<std::string_view, Total>> sorted(totals.begin(), totals.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.ticks > b.second.ticks; });
+	for (const auto& [name, total] : sorted)
+	{
+		ImGui::Text("%8.3fms  %5ux  %.*s", TicksToMilliseconds(total.ticks), total.count, static_cast<int>(name.size()), name.data());
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// The calling thread's buffer, created the first time it records a scope. Buffers are kept after their thread ends
+CpuProfiler::ThreadBuffer& CpuProfiler::CurrentBuffer()
+{
+	if (tProfileBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		mBuffers.push_back(std::make_unique<ThreadBuffer>());
+		mBuffers.back()->index = static_cast<uint16_t>(mBuffers.size() - 1);
+		tProfileBuffer = mBuffers.back().get();
+	}
+	return *static_cast<ThreadBuffer*>(tProfileBuffer);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	ProfileScope
+-----------------------------------------------------------------------------------------*/
+
+// Note the start time if profiling is enabled
+ProfileScope::ProfileScope(const char* name)
+	: mName(name)
+{
+	if (!gCpuProfiler.IsEnabled())  return;
+	++tProfileDepth;
+	mStart = CpuProfiler::Now();
+}
+
+// Record the scope if it was started with profiling enabled, even if it has been disabled since, so depths stay balanced
+ProfileScope::~ProfileScope()
+{
+	if (mStart == 0)  return;
+	int64_t end = CpuProfiler::Now();
+	--tProfileDepth;
+	gCpuProfiler.Record(mName, mStart, end, tProfileDepth);
+}
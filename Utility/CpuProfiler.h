@@ -0,0 +1,161 @@
+//--------------------------------------------------------------------------------------
+// CpuProfiler class - times named scopes of CPU work on every thread, frame by frame
+//--------------------------------------------------------------------------------------
+// Code to time puts PROFILE_SCOPE at the top of the scope, with a string literal for the name. When the scope ends its start
+// and end time are written to a buffer belonging to the calling thread, so recording never takes a lock or waits for another
+// thread: each buffer is a ring with a single writer (its thread) and a single reader (the collector), see ThreadBuffer.
+// Scopes nest, each keeps its depth on its thread.
+//
+// Once a frame the main thread calls NextFrame, which takes the scopes finished since the last call from every thread's
+// buffer. They are kept as the last frame for display (see DrawTimeline) until the next call, unless the display has been
+// frozen to look at a frame. While profiling is disabled a scope costs only a check of a flag, and defining
+// CPU_PROFILER_DISABLED for the build removes the scopes altogether
+//
+//   void EntityManager::UpdateAll(float frameTime)
+//   {
+//       PROFILE_SCOPE("UpdateAll");
+//       ...
+
+#ifndef _CPU_PROFILER_H_INCLUDED_
+#define _CPU_PROFILER_H_INCLUDED_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+
+
+class CpuProfiler
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// A finished scope. Times are clock ticks, see TicksToMilliseconds
+	struct Event
+	{
+		const char* name;
+		int64_t     start;
+		int64_t     end;
+		uint16_t    depth;  // 0 for a scope with no enclosing scope on its thread
+		uint16_t    thread; // Index of the thread's buffer, in the order threads first recorded a scope
+	};
+
+	// The scopes finished in a frame, in the order each thread finished them, threads one after another
+	struct Frame
+	{
+		int64_t            start = 0;
+		int64_t            end   = 0;
+		std::vector<Event> events;
+		uint32_t           numThreads = 0; // Threads that had recorded anything by the end of the frame
+		uint32_t           dropped    = 0; // Scopes lost because a thread's buffer was full
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Recording
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether scopes are recorded. Off by default
+	void SetEnabled(bool enabled)  { mEnabled.store(enabled, std::memory_order_relaxed); }
+	bool IsEnabled()               { return mEnabled.load(std::memory_order_relaxed); }
+
+	// Record a finished scope for the calling thread. Usually called by ProfileScope
+	void Record(const char* name, int64_t start, int64_t end, uint16_t depth);
+
+	// Current clock ticks
+	static int64_t Now()  { return Clock::now().time_since_epoch().count(); }
+
+	static double TicksToMilliseconds(int64_t ticks)
+	{
+		return ticks * 1000.0 * Clock::period::num / Clock::period::den;
+	}
+
+	// Collect the scopes finished since the last call as the last frame, call once a frame on the main thread
+	void NextFrame();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Display
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The last frame collected
+	const Frame& LastFrame()  { return mLastFrame; }
+
+	// While frozen NextFrame still empties the buffers but keeps the last frame as it is
+	bool& Frozen()  { return mFrozen; }
+
+	// Draw the last frame in the current ImGui window: a timeline with a row per thread and scopes stacked by depth (hover for
+	// the name and time), then the total time of each scope name, largest first
+	void DrawTimeline();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Scopes recorded by one thread, a ring written only by that thread and read only by the collector. The writer fills
+	// the event at the write count then increases the count, the reader takes events up to the count and increases the read
+	// count, so each side only ever writes its own count. A scope finished with the ring full is dropped
+	static constexpr uint32_t BUFFER_SIZE = 32768; // Scopes a thread can record in a frame, a power of two
+	struct ThreadBuffer
+	{
+		std::array<Event, BUFFER_SIZE> events;
+		std::atomic<uint32_t> written = 0;
+		std::atomic<uint32_t> read    = 0;
+		std::atomic<uint32_t> dropped = 0;
+		uint16_t              index   = 0;
+	};
+
+	// The calling thread's buffer, created the first time it records a scope
+	ThreadBuffer& CurrentBuffer();
+
+	std::atomic<bool> mEnabled = false;
+	bool              mFrozen  = false;
+
+	// Every thread's buffer, only added to. The mutex is only taken when a thread first records and by the collector
+	std::mutex                                 mBuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
+
+	int64_t mFrameStart = Now();
+	Frame   mLastFrame;
+	Frame   mCollecting; // Kept to reuse its capacity
+};
+
+
+// Times the rest of the scope it is declared in, see PROFILE_SCOPE
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name);
+	~ProfileScope();
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* mName;
+	int64_t     mStart = 0; // 0 if profiling was disabled at the start of the scope
+};
+
+
+// The profiler all PROFILE_SCOPEs record to
+extern CpuProfiler gCpuProfiler;
+
+
+// Time the rest of the enclosing scope under the given name, which must be a string literal (only the pointer is kept)
+#ifndef CPU_PROFILER_DISABLED
+	#define PROFILE_SCOPE_JOIN2(a, b)  a##b
+	#define PROFILE_SCOPE_JOIN(a, b)   PROFILE_SCOPE_JOIN2(a, b)
+	#define PROFILE_SCOPE(name)        ProfileScope PROFILE_SCOPE_JOIN(profileScope, __LINE__)(name)
+#else
+	#define PROFILE_SCOPE(name)
+#endif
+
+
+#endif // _CPU_PROFILER_H_INCLUDED_
@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// EventTrace class - marks the game's frames, phases, loads and spikes as ETW events for Windows Performance Analyzer
+//--------------------------------------------------------------------------------------
+
+#include "EventTrace.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks some libraries (e.g. assimp)
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+
+#include <cstring>
+
+
+// The provider all events are written to. Its GUID {adc31df4-bbf0-5a9e-f6a2-122631da7967} is the one EventSource derives from
+// the name "Boats", so tools that take a provider as *Boats find it without being told the GUID
+TRACELOGGING_DEFINE_PROVIDER(gBoatsProvider, "Boats",
+	(0xadc31df4, 0xbbf0, 0x5a9e, 0xf6, 0xa2, 0x12, 0x26, 0x31, 0xda, 0x79, 0x67));
+
+EventTrace gEventTrace;
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Register the provider with ETW, once at startup before anything is traced. A failure to register just means no events
+void EventTrace::Register()
+{
+	if (mRegistered)  return;
+	mRegistered = SUCCEEDED(TraceLoggingRegister(gBoatsProvider));
+}
+
+void EventTrace::Unregister()
+{
+	if (!mRegistered)  return;
+	TraceLoggingUnregister(gBoatsProvider);
+	mRegistered = false;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Events
+-----------------------------------------------------------------------------------------*/
+
+// Whether a trace session is listening to the provider. TraceLoggingWrite makes the same check before writing anything
+bool EventTrace::Listening()
+{
+	return TraceLoggingProviderEnabled(gBoatsProvider, 0, 0);
+}
+
+
+// Start and end of a frame of the main loop, with its number
+void EventTrace::FrameBegin(uint64_t frame)
+{
+	TraceLoggingWrite(gBoatsProvider, "Frame", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingUInt64(frame, "Frame"));
+}
+
+void EventTrace::FrameEnd(uint64_t frame)
+{
+	TraceLoggingWrite(gBoatsProvider, "Frame", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingUInt64(frame, "Frame"));
+}
+
+
+// Start and end of a phase of the frame on the calling thread
+void EventTrace::PhaseBegin(const char* phase)
+{
+	TraceLoggingWrite(gBoatsProvider, "Phase", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingString(phase, "Name"));
+}
+
+void EventTrace::PhaseEnd(const char* phase)
+{
+	TraceLoggingWrite(gBoatsProvider, "Phase", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingString(phase, "Name"));
+}
+
+
+// Start and end of a load of the given name, as an activity with an ID of its own so overlapping loads on worker threads are
+// paired up correctly. The ID is only made when a session is listening
+void EventTrace::LoadBegin(EventTraceActivity& activity, const std::string& name)
+{
+	activity.started = false;
+	if (!Listening())  return;
+
+	GUID id;
+	if (EventActivityIdControl(EVENT_ACTIVITY_CTRL_CREATE_ID, &id) != ERROR_SUCCESS)  return;
+	std::memcpy(activity.id, &id, sizeof(activity.id));
+	activity.started = true;
+	TraceLoggingWriteActivity(gBoatsProvider, "Load", &id, nullptr, TraceLoggingOpcode(WINEVENT_OPCODE_START),
+	                          TraceLoggingString(name.c_str(), "Name"));
+}
+
+void EventTrace::LoadEnd(EventTraceActivity& activity)
+{
+	if (!activity.started)  return;
+	activity.started = false;
+
+	GUID id;
+	std::memcpy(&id, activity.id, sizeof(id));
+	TraceLoggingWriteActivity(gBoatsProvider, "Load", &id, nullptr, TraceLoggingOpcode(WINEVENT_OPCODE_STOP));
+}
+
+
+// The messenger delivered the given number of messages at the start of the given frame
+void EventTrace::MessengerFlush(uint64_t frame, uint32_t messages)
+{
+	TraceLoggingWrite(gBoatsProvider, "MessengerFlush", TraceLoggingUInt64(frame, "Frame"), TraceLoggingUInt32(messages, "Messages"));
+}
+
+
+// The spike watchdog reported a frame of the given time against the given baseline
+void EventTrace::FrameSpike(float milliseconds, float baselineMilliseconds)
+{
+	TraceLoggingWrite(gBoatsProvider, "FrameSpike", TraceLoggingLevel(WINEVENT_LEVEL_WARNING),
+	                  TraceLoggingFloat32(milliseconds, "Milliseconds"), TraceLoggingFloat32(baselineMilliseconds, "BaselineMilliseconds"));
+}
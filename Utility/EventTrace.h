@@ -0,0 +1,116 @@
+//--------------------------------------------------------------------------------------
+// EventTrace class - marks the game's frames, phases, loads and spikes as ETW events for Windows Performance Analyzer
+//--------------------------------------------------------------------------------------
+// The CPU and GPU profilers show the game on its own. For a deep dive alongside the DXGI present, driver and kernel events
+// the game's timeline goes into the same ETW trace: a TraceLogging provider named "Boats" writes events for
+//  - each frame of the main loop, a start and stop event with the frame number
+//  - the phases of a frame (update, render, present), start and stop events with the phase name, see TRACE_PHASE
+//  - each load timed by a StartupTimer (meshes, textures, shaders, levels), as an ETW activity so loads on worker threads
+//    pair up with their own stop events
+//  - each messenger flush (Messenger::BeginFrame), with the number of messages delivered
+//  - each frame the spike watchdog reports, with its time and the baseline (see Scene::CheckFrameSpike)
+//
+// Record them with WPR or xperf along with the usual GPU and CPU providers, e.g. with UIforETW or a WPR profile adding the
+// provider by name as *Boats (its GUID is the one EventSource derives from the name, see EventTrace.cpp). The events show in
+// WPA's Generic Events table, and GPUView shows them on the process's track.
+//
+// Every event checks first whether a session is listening to the provider, a load and test of a flag in the provider, so with
+// no session they cost next to nothing. Nothing is written until Register is called
+//
+//   gEventTrace.Register();                        // Once at startup
+//   { TRACE_PHASE("Update");  ... }                // Start and stop events around the rest of the scope
+
+#ifndef _EVENT_TRACE_H_INCLUDED_
+#define _EVENT_TRACE_H_INCLUDED_
+
+#include <string>
+#include <stdint.h>
+
+
+// An activity in progress, pairing its start and stop events. Kept by the code that starts it, e.g. StartupTimer
+struct EventTraceActivity
+{
+	uint8_t id[16]  = {}; // GUID of the ETW activity
+	bool    started = false;
+};
+
+
+class EventTrace
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	EventTrace() = default;
+	~EventTrace()  { Unregister(); }
+
+	EventTrace(const EventTrace&) = delete;
+	EventTrace& operator=(const EventTrace&) = delete;
+
+	// Register the provider with ETW, once at startup before anything is traced. Events before this, or after Unregister,
+	// are dropped. Unregistered on destruction
+	void Register();
+	void Unregister();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Events
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Whether a trace session is listening to the provider, e.g. to skip working out what only an event would use
+	bool Listening();
+
+	// Start and end of a frame of the main loop, with its number
+	void FrameBegin(uint64_t frame);
+	void FrameEnd(uint64_t frame);
+
+	// Start and end of a phase of the frame on the calling thread, see TRACE_PHASE. Only the pointer is kept, pass a string literal
+	void PhaseBegin(const char* phase);
+	void PhaseEnd(const char* phase);
+
+	// Start and end of a load (or other timed part of startup) of the given name, on any thread. Pass the same activity to both,
+	// the end does nothing if the start wasn't traced
+	void LoadBegin(EventTraceActivity& activity, const std::string& name);
+	void LoadEnd(EventTraceActivity& activity);
+
+	// The messenger delivered the given number of messages at the start of the given frame
+	void MessengerFlush(uint64_t frame, uint32_t messages);
+
+	// The spike watchdog reported a frame of the given time against the given baseline
+	void FrameSpike(float milliseconds, float baselineMilliseconds);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	bool mRegistered = false;
+};
+
+
+// The trace all game events are written to
+extern EventTrace gEventTrace;
+
+
+// Writes phase start and stop events around the rest of the scope it is declared in, see TRACE_PHASE
+class TracePhase
+{
+public:
+	explicit TracePhase(const char* phase) : mPhase(phase)  { gEventTrace.PhaseBegin(phase); }
+	~TracePhase()                                           { gEventTrace.PhaseEnd(mPhase); }
+
+	TracePhase(const TracePhase&) = delete;
+	TracePhase& operator=(const TracePhase&) = delete;
+
+private:
+	const char* mPhase;
+};
+
+
+// Mark the rest of the enclosing scope as a phase of the given name, which must be a string literal
+#define TRACE_PHASE_JOIN2(a, b)  a##b
+#define TRACE_PHASE_JOIN(a, b)   TRACE_PHASE_JOIN2(a, b)
+#define TRACE_PHASE(name)        TracePhase TRACE_PHASE_JOIN(tracePhase, __LINE__)(name)
+
+
+#endif //_EVENT_TRACE_H_INCLUDED_
@@ -0,0 +1,81 @@
+//--------------------------------------------------------------------------------------
+// FrameArena class - a bump allocator for scratch data that only lives until the end of the frame
+//--------------------------------------------------------------------------------------
+
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <bit>
+#include <stdint.h>
+
+
+FrameArena gFrameArena;
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// The block starts at the given size, it grows to fit the largest frame
+FrameArena::FrameArena(size_t initialBytes /*= 64 * 1024*/)
+	: mCapacity(initialBytes)
+{
+	mBlock = static_cast<std::byte*>(std::pmr::new_delete_resource()->allocate(mCapacity, BLOCK_ALIGNMENT));
+}
+
+FrameArena::~FrameArena()
+{
+	Reset();
+	std::pmr::new_delete_resource()->deallocate(mBlock, mCapacity, BLOCK_ALIGNMENT);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Free everything allocated since the last reset. When the frame overflowed, the block is replaced by one large enough for
+// all of it (rounded up to a power of two so a slowly growing frame doesn't do this every time)
+void FrameArena::Reset()
+{
+	size_t used = BytesUsed();
+	mPeak = std::max(mPeak, used);
+
+	for (const HeapAllocation& allocation : mOverflow)
+	{
+		std::pmr::new_delete_resource()->deallocate(allocation.memory, allocation.bytes, allocation.alignment);
+	}
+	if (!mOverflow.empty())
+	{
+		++mOverflows;
+		std::pmr::new_delete_resource()->deallocate(mBlock, mCapacity, BLOCK_ALIGNMENT);
+		mCapacity = std::bit_ceil(used);
+		mBlock = static_cast<std::byte*>(std::pmr::new_delete_resource()->allocate(mCapacity, BLOCK_ALIGNMENT));
+		mOverflow.clear();
+	}
+	mUsed = 0;
+	mOverflowBytes = 0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private functions
+-----------------------------------------------------------------------------------------*/
+
+// Take the next suitably aligned bytes of the block, or go to the heap if they don't fit
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t start  = reinterpret_cast<uintptr_t>(mBlock) + mUsed;
+	size_t    offset = ((start + alignment - 1) & ~(alignment - 1)) - reinterpret_cast<uintptr_t>(mBlock);
+	if (offset + bytes <= mCapacity)
+	{
+		mUsed = offset + bytes;
+		return mBlock + offset;
+	}
+
+	// Padding is counted as it would be in the block, so the grown block is large enough for the same allocations
+	void* memory = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	mOverflow.push_back({ memory, bytes, alignment });
+	mOverflowBytes += bytes + alignment;
+	return memory;
+}
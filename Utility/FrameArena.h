@@ -0,0 +1,86 @@
+//--------------------------------------------------------------------------------------
+// FrameArena class - a bump allocator for scratch data that only lives until the end of the frame
+//--------------------------------------------------------------------------------------
+// Lists built and thrown away every frame (names for a combo box, IDs to look through) would otherwise go to the general
+// heap each time. The arena hands out memory by moving a pointer along a single block, frees nothing individually, and is
+// reset at the start of each frame by Scene::Update, so everything allocated from it must be finished with by then.
+//
+// It is a std::pmr::memory_resource, so standard containers use it by being given it when constructed. A frame that needs
+// more than the block holds gets the extra memory from the heap, then on the next reset the block is grown to fit, so a
+// steady state frame makes no heap allocations at all (see AllocationTracker.h). Only for use by the main thread
+//
+//   std::pmr::vector<const char*> names(&gFrameArena);
+//   names.reserve(boats.size());
+
+#ifndef _FRAME_ARENA_H_INCLUDED_
+#define _FRAME_ARENA_H_INCLUDED_
+
+#include <memory_resource>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+
+class FrameArena : public std::pmr::memory_resource
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The block starts at the given size, it grows to fit the largest frame
+	explicit FrameArena(size_t initialBytes = 64 * 1024);
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Free everything allocated since the last reset, growing the block if the frame didn't fit in it
+	void Reset();
+
+	// Bytes allocated since the last reset (including alignment padding), the size of the block, the most any frame has
+	// used, and the number of frames that didn't fit in the block
+	size_t   BytesUsed() const  { return mUsed + mOverflowBytes; }
+	size_t   Capacity() const   { return mCapacity; }
+	size_t   PeakBytes() const  { return mPeak; }
+	uint32_t Overflows() const  { return mOverflows; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private functions / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void  do_deallocate(void*, size_t, size_t) override {} // Everything is freed together by Reset
+	bool  do_is_equal(const std::pmr::memory_resource& other) const noexcept override  { return this == &other; }
+
+	// Memory from the heap, for the block and for allocations that don't fit in it
+	struct HeapAllocation
+	{
+		void*  memory;
+		size_t bytes;
+		size_t alignment;
+	};
+
+	static constexpr size_t BLOCK_ALIGNMENT = alignof(std::max_align_t);
+
+	std::byte* mBlock    = nullptr;
+	size_t     mCapacity = 0;
+	size_t     mUsed     = 0;
+
+	std::vector<HeapAllocation> mOverflow;
+	size_t   mOverflowBytes = 0;
+	size_t   mPeak          = 0;
+	uint32_t mOverflows     = 0;
+};
+
+
+// The arena reset every frame by the scene
+extern FrameArena gFrameArena;
+
+
+#endif // _FRAME_ARENA_H_INCLUDED_
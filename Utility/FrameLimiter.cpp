@@ -0,0 +1,64 @@
+//--------------------------------------------------------------------------------------
+// Frame limiter - caps the frame rate by sleeping until each frame is due
+//--------------------------------------------------------------------------------------
+
+#include "FrameLimiter.h"
+
+#include <thread>
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Create the waitable timer, the limiter starts with no cap
+FrameLimiter::FrameLimiter()
+{
+	mTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	mHighResolution = (mTimer != nullptr);
+	if (mTimer == nullptr)  mTimer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	mNextFrame = Clock::now();
+}
+
+FrameLimiter::~FrameLimiter()
+{
+	if (mTimer != nullptr)  CloseHandle(mTimer);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Sleep until the next frame is due. Returns immediately if there is no cap or the frame is late
+void FrameLimiter::Wait()
+{
+	auto now = Clock::now();
+	if (mFrameRate <= 0)
+	{
+		mNextFrame = now;
+		return;
+	}
+	auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / mFrameRate));
+
+	// Late, start now and schedule from here. Also if the schedule is more than a frame ahead, e.g. after raising the cap
+	if (now >= mNextFrame || mNextFrame - now > period)
+	{
+		mNextFrame = now + period;
+		return;
+	}
+
+	// Sleep on the timer for most of the wait. Due times are relative, in negative units of 100ns
+	auto spin = mHighResolution ? HIGH_RESOLUTION_SPIN : LOW_RESOLUTION_SPIN;
+	auto sleep = std::chrono::duration_cast<std::chrono::duration<long long, std::ratio<1, 10'000'000>>>(mNextFrame - now - spin);
+	if (mTimer != nullptr && sleep.count() > 0)
+	{
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -sleep.count();
+		if (SetWaitableTimerEx(mTimer, &dueTime, 0, nullptr, nullptr, nullptr, 0))  WaitForSingleObject(mTimer, INFINITE);
+	}
+
+	// Then spin for the rest, giving the processor to other threads
+	while (Clock::now() < mNextFrame)  std::this_thread::yield();
+	mNextFrame += period;
+}
@@ -0,0 +1,70 @@
+//--------------------------------------------------------------------------------------
+// Frame limiter - caps the frame rate by sleeping until each frame is due
+//--------------------------------------------------------------------------------------
+// Frames are due at a fixed period after the previous one was due, so an occasional long frame doesn't shift every later one.
+// A frame that is already late starts straight away and the schedule restarts from it, rather than rushing several frames to
+// catch up. The wait uses a high resolution waitable timer where Windows supports one (Windows 10 1803 or later), and an
+// ordinary one otherwise, followed by a short spin for the last fraction of a millisecond the timer can't be trusted with.
+// That keeps the CPU idle while waiting, unlike presenting without vsync as fast as possible
+//
+//   frameLimiter.SetFrameRate(144);
+//   ... each frame ...
+//   frameLimiter.Wait();
+
+#ifndef _FRAME_LIMITER_H_INCLUDED_
+#define _FRAME_LIMITER_H_INCLUDED_
+
+#include <windows.h>
+
+#include <chrono>
+
+
+class FrameLimiter
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+
+	// Create the waitable timer, the limiter starts with no cap
+	FrameLimiter();
+	~FrameLimiter();
+
+	// Owns a Windows handle, so can't be copied
+	FrameLimiter(const FrameLimiter&) = delete;
+	FrameLimiter& operator=(const FrameLimiter&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+
+	// Frames per second to cap at, 0 for no cap
+	void  SetFrameRate(float framesPerSecond)  { mFrameRate = framesPerSecond; }
+	float GetFrameRate()                       { return mFrameRate; }
+
+	// Sleep until the next frame is due. Returns immediately if there is no cap or the frame is late
+	void Wait();
+
+	// Whether the timer has high resolution, shown in the control panel
+	bool IsHighResolution()  { return mHighResolution; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private member data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// Time before a frame is due to stop sleeping and spin instead, for each kind of timer
+	static constexpr std::chrono::microseconds HIGH_RESOLUTION_SPIN = std::chrono::microseconds(200);
+	static constexpr std::chrono::microseconds LOW_RESOLUTION_SPIN  = std::chrono::microseconds(2000);
+
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point mNextFrame; // When the next frame is due
+
+	HANDLE mTimer = nullptr;      // nullptr if no timer could be created, then the limiter only spins
+	bool   mHighResolution = false;
+	float  mFrameRate = 0;
+};
+
+
+#endif //_FRAME_LIMITER_H_INCLUDED_
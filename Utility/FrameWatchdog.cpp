@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// Frame watchdog - spots frames that take much longer than the frames before them
+//--------------------------------------------------------------------------------------
+
+#include "FrameWatchdog.h"
+
+#include <algorithm>
+
+
+// Add the time of the frame just finished. Returns true if it is a spike to be reported
+bool FrameWatchdog::AddFrame(float milliseconds)
+{
+	// The frame is judged against the baseline of the frames before it, then joins them
+	float baseline = mBaseline;
+	bool spike = mFrames == BASELINE_FRAMES && milliseconds > baseline * mMultiple && milliseconds > mMinimumMs &&
+	             mSinceSpike >= mCoolDown;
+
+	mTimes[mNext] = milliseconds;
+	mNext = (mNext + 1) % BASELINE_FRAMES;
+	if (mFrames < BASELINE_FRAMES)  ++mFrames;
+	if (mFrames == BASELINE_FRAMES)
+	{
+		mSorted = mTimes;
+		auto middle = mSorted.begin() + BASELINE_FRAMES / 2;
+		std::nth_element(mSorted.begin(), middle, mSorted.end());
+		mBaseline = *middle;
+	}
+
+	mSinceSpike += milliseconds / 1000.0f;
+	if (!spike)  return false;
+
+	mLastSpikeBaseline = baseline;
+	mLastSpike  = milliseconds;
+	mSinceSpike = 0.0f;
+	++mSpikes;
+	return true;
+}
+
+
+// Forget the frames so far. Spikes are reported again once the window is full
+void FrameWatchdog::Reset()
+{
+	mNext     = 0;
+	mFrames   = 0;
+	mBaseline = 0.0f;
+}
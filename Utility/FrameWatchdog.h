@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Frame watchdog - spots frames that take much longer than the frames before them
+//--------------------------------------------------------------------------------------
+// Keeps the times of the last BASELINE_FRAMES frames and takes their median as the baseline, so a run of spikes or a slow
+// stretch of the game don't throw it off the way an average would. A frame is a spike if it takes longer than the baseline
+// times the multiple and longer than the minimum (so a game running at 2ms a frame doesn't call a 7ms frame a spike). Spikes
+// aren't reported until the baseline has a full window of frames, nor within the cool down of the last one reported, so a
+// run of slow frames (e.g. a level loading) is reported once. The scene decides what to do with a spike, see
+// Scene::CheckFrameSpike
+//
+//   if (watchdog.AddFrame(frameMilliseconds))  ... save what the frame did ...
+
+#ifndef _FRAME_WATCHDOG_H_INCLUDED_
+#define _FRAME_WATCHDOG_H_INCLUDED_
+
+#include <array>
+#include <stdint.h>
+
+
+class FrameWatchdog
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Frames the baseline is the median of
+	static constexpr uint32_t BASELINE_FRAMES = 120;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add the time of the frame just finished. Returns true if it is a spike to be reported
+	bool AddFrame(float milliseconds);
+
+	// Forget the frames so far, e.g. after changing what is being run. Spikes are reported again once the window is full
+	void Reset();
+
+	// A frame is a spike if it takes longer than the baseline times Multiple, and longer than MinimumMs
+	float& Multiple()         { return mMultiple; }
+	float& MinimumMs()        { return mMinimumMs; }
+	float& CoolDownSeconds()  { return mCoolDown; }
+
+	// Median of the last BASELINE_FRAMES frames in milliseconds, 0 until there have been that many
+	float Baseline()  { return mBaseline; }
+
+	// The last spike reported and its baseline, and the number reported since the start
+	float    LastSpikeMs()        { return mLastSpike; }
+	float    LastSpikeBaseline()  { return mLastSpikeBaseline; }
+	uint32_t SpikesReported()     { return mSpikes; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	float mMultiple  = 3.0f;
+	float mMinimumMs = 50.0f;
+	float mCoolDown  = 10.0f;
+
+	// The last frames' times in a ring, with mFrames counting up to a full window
+	std::array<float, BASELINE_FRAMES> mTimes = {};
+	uint32_t mNext   = 0;
+	uint32_t mFrames = 0;
+	std::array<float, BASELINE_FRAMES> mSorted = {}; // Copy of the times the median is found in
+
+	float    mBaseline          = 0.0f;
+	float    mSinceSpike        = 0.0f; // Seconds of frames since the last spike reported
+	float    mLastSpike         = 0.0f;
+	float    mLastSpikeBaseline = 0.0f;
+	uint32_t mSpikes            = 0;
+};
+
+
+#endif //_FRAME_WATCHDOG_H_INCLUDED_
@@ -4,7 +4,12 @@
 // Not encapsulated into a class to keep familiar TL-Engine-like usage
 
 #include "Input.h"
+#include "MpscQueue.h"
 #include <array>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <algorithm>
 
 
 /*-----------------------------------------------------------------------------------------
@@ -14,11 +19,117 @@
 // Current state of all keys (and mouse buttons)
 std::array<KeyState, NumKeyCodes> gKeyStates;
 
+// Keys released in the same frame they were pressed. They stay Pressed for that frame so the hit isn't lost, and are
+// released at the start of the next
+std::array<bool, NumKeyCodes> gReleasePending;
+
 // Current position of mouse
 Vector2i gMousePosition = {0, 0};
 
 Vector2i gRawMousePosition = { 0, 0 };
 
+// Events waiting for ProcessInputEvents. Queued from the window procedure or the input thread, each with the time it arrived
+struct InputEvent
+{
+    enum class Type { KeyDown, KeyUp, MouseMove, MousePosition };
+    Type    type = Type::KeyDown;
+    KeyCode key  = Key_None;
+    int     x = 0, y = 0;
+    int64_t time = 0; // Performance counter
+};
+static constexpr size_t INPUT_QUEUE_CAPACITY = 4096; // Far more than arrive in a frame, events pushed to a full queue are dropped
+MpscQueue<InputEvent> gInputEvents(INPUT_QUEUE_CAPACITY);
+
+float gInputLatency = 0;
+std::atomic<bool> gRawMouseEnabled = true;
+
+// The input thread, if used, and its message-only window that receives raw input
+std::thread gInputThread;
+DWORD       gInputThreadID = 0;
+HWND        gInputWindow   = nullptr; // The main window, input is only taken while it is in the foreground
+
+
+/*-----------------------------------------------------------------------------------------
+    Private helpers
+-----------------------------------------------------------------------------------------*/
+
+static int64_t InputTime()
+{
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart;
+}
+
+static void QueueInputEvent(InputEvent::Type type, KeyCode key, int x, int y)
+{
+    gInputEvents.TryPush({ type, key, x, y, InputTime() });
+}
+
+// Register for raw keyboard and mouse input sent to the given window, flags as RAWINPUTDEVICE::dwFlags
+static bool RegisterRawInput(HWND target, DWORD flags)
+{
+    RAWINPUTDEVICE devices[2];
+    devices[0].usUsagePage = 0x01; // HID_USAGE_PAGE_GENERIC
+    devices[0].usUsage     = 0x02; // HID_USAGE_GENERIC_MOUSE
+    devices[0].dwFlags     = flags;
+    devices[0].hwndTarget  = target;
+    devices[1] = devices[0];
+    devices[1].usUsage     = 0x06; // HID_USAGE_GENERIC_KEYBOARD
+    return RegisterRawInputDevices(devices, 2, sizeof(devices[0])) != FALSE;
+}
+
+// Window procedure of the input thread's message-only window. Raw input is received whichever window has the focus
+// (RIDEV_INPUTSINK), so only key releases are taken while the main window isn't in the foreground - otherwise keys held
+// when the user switched away would stay held
+static LRESULT CALLBACK InputThreadProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
+{
+    if (message == WM_INPUT)
+    {
+        if (GetForegroundWindow() == gInputWindow)
+        {
+            RawInputEvent(lParam);
+        }
+        else
+        {
+            RAWINPUT rawInput;
+            UINT size = sizeof(rawInput);
+            if (GetRawInputData((HRAWINPUT)lParam, RID_INPUT, &rawInput, &size, sizeof(RAWINPUTHEADER)) != static_cast<UINT>(-1) &&
+                rawInput.header.dwType == RIM_TYPEKEYBOARD && (rawInput.data.keyboard.Flags & RI_KEY_BREAK) &&
+                rawInput.data.keyboard.VKey < Key_None)
+            {
+                QueueInputEvent(InputEvent::Type::KeyUp, static_cast<KeyCode>(rawInput.data.keyboard.VKey), 0, 0);
+            }
+        }
+    }
+    return DefWindowProc(hWnd, message, wParam, lParam);
+}
+
+// The input thread - makes a message-only window for raw input and handles its messages until told to quit
+static void InputThreadLoop(std::promise<bool> started)
+{
+    WNDCLASSEXW windowClass = {};
+    windowClass.cbSize        = sizeof(windowClass);
+    windowClass.lpfnWndProc   = InputThreadProc;
+    windowClass.hInstance     = GetModuleHandle(nullptr);
+    windowClass.lpszClassName = L"RawInputThread";
+    RegisterClassExW(&windowClass);
+    HWND window = CreateWindowExW(0, windowClass.lpszClassName, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, windowClass.hInstance, nullptr);
+    if (window == nullptr || !RegisterRawInput(window, RIDEV_INPUTSINK))
+    {
+        if (window != nullptr)  DestroyWindow(window);
+        started.set_value(false);
+        return;
+    }
+    gInputThreadID = GetCurrentThreadId();
+    started.set_value(true);
+
+    MSG msg;
+    while (GetMessage(&msg, nullptr, 0, 0) > 0)  DispatchMessage(&msg);
+
+    RegisterRawInput(nullptr, RIDEV_REMOVE);
+    DestroyWindow(window);
+}
+
 
 
 /*-----------------------------------------------------------------------------------------
@@ -29,7 +140,89 @@ void InitInput()
 {
     // Initialise input data
     for (auto& keyState : gKeyStates)  keyState = NotPressed;
+    gReleasePending.fill(false);
     gMousePosition = { 0, 0 };
+    InputEvent discarded;
+    while (gInputEvents.TryPop(discarded)) {}
+}
+
+// Register for raw keyboard and mouse input for the given window, on a thread of its own if asked. Falls back to the window
+// if the thread can't be started
+bool InitRawInput(HWND window, bool inputThread)
+{
+    gInputWindow = window;
+    if (inputThread && !gInputThread.joinable())
+    {
+        std::promise<bool> started;
+        std::future<bool> result = started.get_future();
+        gInputThread = std::thread(InputThreadLoop, std::move(started));
+        if (result.get())  return true;
+        gInputThread.join();
+    }
+    return RegisterRawInput(window, 0);
+}
+
+// Stop the input thread if there is one
+void ShutdownRawInput()
+{
+    if (!gInputThread.joinable())  return;
+    PostThreadMessage(gInputThreadID, WM_QUIT, 0, 0);
+    gInputThread.join();
+}
+
+// Whether raw mouse movement is passed on to GetMouse
+void EnableRawMouse(bool enable)
+{
+    gRawMouseEnabled = enable;
+}
+
+// Apply all the events queued since the last call, in the order they happened
+void ProcessInputEvents()
+{
+    for (int key = 0; key < NumKeyCodes; ++key)
+    {
+        if (gReleasePending[key])  gKeyStates[key] = NotPressed;
+    }
+    gReleasePending.fill(false);
+
+    int64_t now    = InputTime();
+    int64_t oldest = now;
+    InputEvent event;
+    while (gInputEvents.TryPop(event))
+    {
+        oldest = std::min(oldest, event.time);
+        switch (event.type)
+        {
+        case InputEvent::Type::KeyDown:
+            // Repeats while held leave the key held. A key pressed again after a release in the same frame is still held
+            if (gKeyStates[event.key] == NotPressed)  gKeyStates[event.key] = Pressed;
+            gReleasePending[event.key] = false;
+            break;
+
+        case InputEvent::Type::KeyUp:
+            if (gKeyStates[event.key] == Pressed)  gReleasePending[event.key] = true; // Not seen yet, released next frame
+            else                                   gKeyStates[event.key] = NotPressed;
+            break;
+
+        case InputEvent::Type::MouseMove:
+            gMousePosition += { event.x, event.y };
+            break;
+
+        case InputEvent::Type::MousePosition:
+            gRawMousePosition = { event.x, event.y };
+            break;
+        }
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    gInputLatency = static_cast<float>(now - oldest) / frequency.QuadPart;
+}
+
+// Seconds from the oldest event applied by the last ProcessInputEvents happening until it was applied
+float GetInputLatency()
+{
+    return gInputLatency;
 }
 
 
@@ -37,34 +230,51 @@ void InitInput()
     Events
 -----------------------------------------------------------------------------------------*/
 
+// The events only queue what happened, it is applied by ProcessInputEvents
+
 // Event called to indicate that a key or mouse button has been pressed down
 void KeyDownEvent(KeyCode Key)
 {
-    if (gKeyStates[Key] == NotPressed)
-    {
-        gKeyStates[Key] = Pressed;
-    }
-    else
-    {
-        gKeyStates[Key] = Held;
-    }
+    QueueInputEvent(InputEvent::Type::KeyDown, Key, 0, 0);
 }
 
 // Event called to indicate that a key or mouse button has been lifted up
 void KeyUpEvent(KeyCode Key)
 {
-   gKeyStates[Key] = NotPressed;
+    QueueInputEvent(InputEvent::Type::KeyUp, Key, 0, 0);
 }
 
 // Event called to indicate that the mouse has been moved
 void MouseMoveEvent(int X, int Y)
 {
-    gMousePosition += { X, Y };
+    QueueInputEvent(InputEvent::Type::MouseMove, Key_None, X, Y);
 }
 
+// Event called with the mouse cursor's position in the window
 void MouseGetEvent(int X, int Y)
 {
-    gRawMousePosition = { X, Y };
+    QueueInputEvent(InputEvent::Type::MousePosition, Key_None, X, Y);
+}
+
+// Event called with a WM_INPUT message's lParam, queues the keyboard or mouse event it holds. Mouse buttons come from the
+// window's button messages instead, so clicks outside the window's client area aren't counted
+void RawInputEvent(LPARAM lParam)
+{
+    RAWINPUT rawInput;
+    UINT size = sizeof(rawInput);
+    if (GetRawInputData((HRAWINPUT)lParam, RID_INPUT, &rawInput, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1))  return;
+
+    if (rawInput.header.dwType == RIM_TYPEMOUSE)
+    {
+        if (gRawMouseEnabled)  MouseMoveEvent(rawInput.data.mouse.lLastX, rawInput.data.mouse.lLastY);
+    }
+    else if (rawInput.header.dwType == RIM_TYPEKEYBOARD)
+    {
+        const RAWKEYBOARD& keyboard = rawInput.data.keyboard;
+        if (keyboard.VKey >= Key_None)  return; // 0xFF is sent as part of some key sequences, it isn't a key
+        if (keyboard.Flags & RI_KEY_BREAK)  KeyUpEvent(static_cast<KeyCode>(keyboard.VKey));
+        else                                KeyDownEvent(static_cast<KeyCode>(keyboard.VKey));
+    }
 }
 
 
@@ -2,6 +2,13 @@
 // Key/mouse input functions
 //--------------------------------------------------------------------------------------
 // Not encapsulated into a class to keep familiar TL-Engine-like usage
+//
+// Input arrives as events: raw input (WM_INPUT) for the keyboard and mouse movement, window messages for the mouse buttons
+// and cursor position. Events are not applied when they arrive but put in a timestamped queue, which ProcessInputEvents
+// empties at the start of each frame, applying every event in the order it happened. So the key states and mouse position
+// queried by KeyHit, GetMouse etc. hold still for the whole frame, and a key pressed and released between two frames still
+// counts as one hit. Raw input can be collected on a thread of its own (see InitRawInput), so events are timestamped and
+// queued as they happen even while the main thread is busy with a long frame
 
 #ifndef _INPUT_H_DEFINED_
 #define _INPUT_H_DEFINED_
@@ -172,6 +179,22 @@ enum KeyCode
 // Initialise the input system
 void InitInput();
 
+// Register for raw keyboard and mouse input for the given window. With inputThread the raw input is received by a thread
+// of its own, otherwise the window must pass WM_INPUT to RawInputEvent. Returns false if raw input can't be registered
+bool InitRawInput(HWND window, bool inputThread);
+
+// Stop the input thread if there is one
+void ShutdownRawInput();
+
+// Whether raw mouse movement is passed on to GetMouse, e.g. off while the mouse isn't controlling the camera
+void EnableRawMouse(bool enable);
+
+// Apply all the events queued since the last call, call once at the start of each frame before any input is queried
+void ProcessInputEvents();
+
+// Seconds from the oldest event applied by the last ProcessInputEvents happening until it was applied, for display
+float GetInputLatency();
+
 
 /*-----------------------------------------------------------------------------------------
     Events
@@ -186,8 +209,14 @@ void KeyUpEvent(KeyCode Key);
 // Event called to indicate that the mouse has been moved
 void MouseMoveEvent(int X, int Y);
 
+// Event called with the mouse cursor's position in the window
 void MouseGetEvent(int X, int Y);
 
+// Event called with a WM_INPUT message's lParam, queues the keyboard or mouse event it holds
+void RawInputEvent(LPARAM lParam);
+
+// The events above may be called from any thread, they only queue the event
+
 /*-----------------------------------------------------------------------------------------
     Input functions
 -----------------------------------------------------------------------------------------*/
@@ -0,0 +1,289 @@
+//--------------------------------------------------------------------------------------
+// JobSystem class - runs work in parallel on a pool of worker threads
+//--------------------------------------------------------------------------------------
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+
+// The job system and worker index of the calling thread, so jobs queued from a worker go on its own queue
+static thread_local const JobSystem* tJobSystem   = nullptr;
+static thread_local int              tWorkerIndex = -1;
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Start the worker threads. Pass 0 to use one worker per hardware thread, less one for the calling thread
+JobSystem::JobSystem(unsigned int numWorkers /*= 0*/)
+	: mMainThread(std::this_thread::get_id())
+{
+	if (numWorkers == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency(); // Can return 0 if unknown
+		numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	// All the queues exist before any worker starts, as workers steal from each other's
+	for (unsigned int i = 0; i < numWorkers; ++i)  mWorkerQueues.push_back(std::make_unique<JobQueue>());
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		mWorkers.emplace_back(&JobSystem::WorkerLoop, this, i);
+	}
+}
+
+// Stops and joins all worker threads. Jobs still queued for the workers are run first
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mShutdown = true;
+	}
+	mWorkReady.notify_all();
+
+	for (auto& worker : mWorkers)  worker.join();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Queue a job to run on a worker, counted by the counter if one is given
+void JobSystem::Run(Job job, JobCounter* counter /*= nullptr*/)
+{
+	if (counter != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		++counter->mPending;
+	}
+	Queue({ std::move(job), counter });
+}
+
+
+// Queue a job to run once the dependency's jobs have finished, straight away if they already have
+void JobSystem::RunAfter(JobCounter& dependency, Job job, JobCounter* counter /*= nullptr*/)
+{
+	if (counter != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		++counter->mPending;
+	}
+	{
+		std::lock_guard<std::mutex> lock(dependency.mMutex);
+		if (dependency.mPending > 0)
+		{
+			dependency.mContinuations.push_back({ std::move(job), counter }); // Queued by the dependency's last job, see Execute
+			return;
+		}
+	}
+	Queue({ std::move(job), counter });
+}
+
+
+// Queue a job to run on the main thread, in RunMainThreadJobs or while the main thread waits for a counter
+void JobSystem::RunOnMainThread(Job job, JobCounter* counter /*= nullptr*/)
+{
+	if (counter != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(counter->mMutex);
+		++counter->mPending;
+	}
+	std::lock_guard<std::mutex> lock(mMainThreadQueue.mutex);
+	mMainThreadQueue.jobs.push_back({ std::move(job), counter });
+}
+
+
+// Run the jobs queued for the main thread, including any they queue for it
+void JobSystem::RunMainThreadJobs()
+{
+	while (RunOneMainThreadJob()) {}
+}
+
+
+// Return once all the jobs given with the counter have finished, running other queued jobs meanwhile
+void JobSystem::Wait(JobCounter& counter)
+{
+	Help(counter, IsMainThread());
+}
+
+
+// Split the items 0 to count-1 into chunks of chunkSize items and call work(chunk, begin, end) for each chunk. Chunks are run
+// in parallel on the workers and the calling thread. Returns when all chunks are complete
+void JobSystem::ParallelFor(size_t count, size_t chunkSize, const ChunkFunction& work)
+{
+	if (count == 0)  return;
+	if (chunkSize == 0)  chunkSize = 1;
+	size_t numChunks = NumChunks(count, chunkSize);
+
+	// Not worth waking the workers for a single chunk
+	if (numChunks == 1)
+	{
+		work(0, 0, count);
+		return;
+	}
+
+	// The chunks aren't queued one by one. Instead a job for each worker that could help takes chunks from a shared count
+	// until there are none left, as does this thread, so threads that get through their chunks quickly take more of them.
+	// Helpers that start after all the chunks have been taken return straight away
+	std::atomic<size_t> nextChunk = 0;
+	auto runChunks = [&]()
+	{
+		while (true)
+		{
+			size_t chunk = nextChunk.fetch_add(1);
+			if (chunk >= numChunks)  return;
+
+			size_t begin = chunk * chunkSize;
+			size_t end   = std::min(begin + chunkSize, count);
+			work(chunk, begin, end);
+		}
+	};
+
+	JobCounter helpers;
+	size_t numHelpers = std::min(mWorkers.size(), numChunks - 1);
+	for (size_t i = 0; i < numHelpers; ++i)  Run(runChunks, &helpers);
+	runChunks();
+
+	// Wait for the helpers to finish any chunks they took, it is then safe for the caller to use the results
+	Help(helpers, false);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Function run by each worker thread - runs jobs, sleeping while there are none
+void JobSystem::WorkerLoop(unsigned int index)
+{
+	tJobSystem   = this;
+	tWorkerIndex = static_cast<int>(index);
+
+	while (true)
+	{
+		QueuedJob queued;
+		if (TakeJob(tWorkerIndex, queued))
+		{
+			Execute(queued);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mWorkReady.wait(lock, [this] { return mShutdown || mQueuedJobs > 0; });
+		if (mShutdown && mQueuedJobs == 0)  return;
+	}
+}
+
+
+// Add a counted job to the calling worker's queue, or the shared queue from other threads, and wake a worker
+void JobSystem::Queue(QueuedJob queued)
+{
+	// Counted before it is queued, so the count is never less than the jobs that can be taken. A worker that sees the count
+	// just before the job is queued looks again
+	++mQueuedJobs;
+	int worker = CurrentWorker();
+	JobQueue& queue = worker >= 0 ? *mWorkerQueues[worker] : mSharedQueue;
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(queued));
+	}
+
+	// Taking the mutex means a worker about to sleep has either seen the new count or is already waiting to be woken
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+	}
+	mWorkReady.notify_one();
+}
+
+
+// Take a job for the given worker (-1 for other threads): its own newest job, then the oldest shared one, then the oldest of
+// another worker. Returns false if there are none
+bool JobSystem::TakeJob(int worker, QueuedJob& taken)
+{
+	auto take = [&](JobQueue& queue, bool newest)
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())  return false;
+		if (newest)
+		{
+			taken = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			taken = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		--mQueuedJobs;
+		return true;
+	};
+
+	if (worker >= 0 && take(*mWorkerQueues[worker], true))  return true;
+	if (take(mSharedQueue, false))  return true;
+
+	// Steal starting from the next worker along, so thieves don't all try the same worker first
+	size_t numQueues = mWorkerQueues.size();
+	size_t first = worker >= 0 ? worker + 1 : 0;
+	for (size_t i = 0; i < numQueues; ++i)
+	{
+		size_t victim = (first + i) % numQueues;
+		if (static_cast<int>(victim) != worker && take(*mWorkerQueues[victim], false))  return true;
+	}
+	return false;
+}
+
+
+// Run a job taken from a queue and count it finished, queueing the jobs that were waiting for its counter if it was the last
+void JobSystem::Execute(QueuedJob& queued)
+{
+	queued.job();
+	if (queued.counter == nullptr)  return;
+
+	// The counter is not touched after its mutex is released, a waiting thread may destroy it as soon as it sees it is done
+	std::vector<JobCounter::Continuation> ready;
+	{
+		std::lock_guard<std::mutex> lock(queued.counter->mMutex);
+		if (--queued.counter->mPending == 0)  ready.swap(queued.counter->mContinuations);
+	}
+	for (auto& continuation : ready)  Queue({ std::move(continuation.job), continuation.counter });
+}
+
+
+// Run other jobs until the counter is done, including main thread jobs if asked
+void JobSystem::Help(JobCounter& counter, bool mainThreadJobs)
+{
+	int worker = CurrentWorker();
+	while (!counter.IsDone())
+	{
+		if (mainThreadJobs && RunOneMainThreadJob())  continue;
+
+		QueuedJob queued;
+		if (TakeJob(worker, queued))  Execute(queued);
+		else                          std::this_thread::yield(); // The remaining jobs are running on other threads
+	}
+}
+
+
+// Run one main thread job if there is one. Returns false if there were none
+bool JobSystem::RunOneMainThreadJob()
+{
+	QueuedJob queued;
+	{
+		std::lock_guard<std::mutex> lock(mMainThreadQueue.mutex);
+		if (mMainThreadQueue.jobs.empty())  return false;
+		queued = std::move(mMainThreadQueue.jobs.front());
+		mMainThreadQueue.jobs.pop_front();
+	}
+	Execute(queued);
+	return true;
+}
+
+
+// Index of the calling thread's worker, -1 if it isn't one of this job system's workers
+int JobSystem::CurrentWorker()
+{
+	return tJobSystem == this ? tWorkerIndex : -1;
+}
@@ -0,0 +1,193 @@
+//--------------------------------------------------------------------------------------
+// JobSystem class - runs work in parallel on a pool of worker threads
+//--------------------------------------------------------------------------------------
+// The job system starts a fixed number of worker threads when it is created and keeps them
+// waiting until there is work to do. Work is given either as single jobs or as a loop over a
+// range of items, which is split into chunks (ParallelFor).
+//
+// Each worker has its own queue of jobs. Jobs queued from a worker go on that worker's queue and
+// it runs the newest first, which keeps related work on one thread while its data is in the cache.
+// A worker with nothing to do steals the oldest job from another worker's queue, so work spreads
+// out without threads contending for a single shared queue. Jobs queued from other threads (e.g.
+// the main thread) go on a shared queue that every worker takes from.
+//
+// A JobCounter counts the unfinished jobs given with it. Waiting for a counter runs other jobs
+// rather than blocking, so jobs may queue and wait for jobs of their own, and ParallelFor may be
+// called from inside a job. Instead of waiting, a job can be queued to start once a counter is
+// done (RunAfter), to build chains of dependent work without tying up a thread.
+//
+// Work that must happen on the main thread, such as using the D3D immediate context, can be
+// queued from any thread with RunOnMainThread. The main thread runs it in RunMainThreadJobs,
+// called at the start of each frame, or while the main thread is waiting for a counter.
+//
+// Which thread processes a job or chunk varies from run to run. If results must be the same
+// each run (e.g. for gameplay), write each chunk's output to a buffer for that chunk
+// index and combine the buffers in chunk order after ParallelFor returns
+//
+//   JobCounter loaded;
+//   for (auto& file : files)  gJobSystem->Run([&file] { file.Load(); }, &loaded);
+//   gJobSystem->RunAfter(loaded, [&] { BuildIndex(files); });
+//   ...
+//   gJobSystem->Wait(loaded);
+
+#ifndef _JOB_SYSTEM_H_INCLUDED_
+#define _JOB_SYSTEM_H_INCLUDED_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+
+// Counts jobs that haven't finished. Give the same counter to each job in a group, then wait for it or queue jobs to run
+// after it (see JobSystem). A counter must outlive the jobs given with it and any waits on it
+class JobCounter
+{
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	// Whether all the jobs given with this counter have finished
+	bool IsDone()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mPending == 0;
+	}
+
+private:
+	friend class JobSystem;
+
+	struct Continuation
+	{
+		std::function<void()> job;
+		JobCounter*           counter;
+	};
+
+	// The count and the jobs waiting for it to reach 0 are changed together, so a job queued with RunAfter just as the last
+	// job finishes is never missed
+	std::mutex                mMutex;
+	int                       mPending = 0;
+	std::vector<Continuation> mContinuations;
+};
+
+
+class JobSystem
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start the worker threads. Pass 0 to use one worker per hardware thread, less one for the calling thread. The calling
+	// thread becomes the main thread for RunOnMainThread
+	JobSystem(unsigned int numWorkers = 0);
+
+	// Stops and joins all worker threads. Jobs still queued for the workers are run first, main thread jobs are not
+	~JobSystem();
+
+	// Prevent copying - the job system owns its threads
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	using Job = std::function<void()>;
+
+	// Queue a job to run on a worker. If a counter is given it counts the job until it has finished
+	void Run(Job job, JobCounter* counter = nullptr);
+
+	// Queue a job to run on a worker once all the jobs of the dependency have finished, straight away if they already have.
+	// The job is counted by its own counter (if given) from now, so it can be waited for before it has started
+	void RunAfter(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+
+	// Queue a job to run on the main thread, in RunMainThreadJobs or while the main thread waits for a counter. Called from
+	// the main thread the job still waits for one of those, it is never run inside the call
+	void RunOnMainThread(Job job, JobCounter* counter = nullptr);
+
+	// Run the jobs queued for the main thread, including any they queue for it. Call on the main thread at a point where
+	// such work is safe, e.g. the start of the frame
+	void RunMainThreadJobs();
+
+	// Return once all the jobs given with the counter have finished, running other queued jobs meanwhile (on the main thread
+	// these include the main thread's jobs)
+	void Wait(JobCounter& counter);
+
+	// Split the items 0 to count-1 into chunks of chunkSize items and call work(chunk, begin, end) for each chunk, where chunk
+	// is the chunk index and begin/end is the range of items in the chunk. Chunks are run in parallel on the workers and the
+	// calling thread. Returns when all chunks are complete. May be called from inside a job or another ParallelFor. Main
+	// thread jobs are not run while waiting, so a ParallelFor in the middle of an update doesn't run them part way through
+	using ChunkFunction = std::function<void(size_t chunk, size_t begin, size_t end)>;
+	void ParallelFor(size_t count, size_t chunkSize, const ChunkFunction& work);
+
+	// Number of chunks ParallelFor will use for the given count and chunk size - useful for sizing per-chunk output buffers
+	static size_t NumChunks(size_t count, size_t chunkSize)  { return chunkSize == 0 ? 0 : (count + chunkSize - 1) / chunkSize; }
+
+	// Number of threads that run work, including the calling thread
+	unsigned int NumThreads()  { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+
+	// Whether the calling thread is the one that created the job system
+	bool IsMainThread()  { return std::this_thread::get_id() == mMainThread; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct QueuedJob
+	{
+		Job         job;
+		JobCounter* counter = nullptr;
+	};
+
+	// A queue of jobs. A worker takes from the back of its own queue and steals from the front of others
+	struct JobQueue
+	{
+		std::mutex            mutex;
+		std::deque<QueuedJob> jobs;
+	};
+
+	// Function run by each worker thread - runs jobs, sleeping while there are none
+	void WorkerLoop(unsigned int index);
+
+	// Add a counted job to the calling worker's queue, or the shared queue from other threads, and wake a worker
+	void Queue(QueuedJob queued);
+
+	// Take a job for the given worker (-1 for other threads): its own newest job, then the oldest shared one, then the oldest
+	// of another worker. Returns false if there are none
+	bool TakeJob(int worker, QueuedJob& taken);
+
+	// Run a job taken from a queue and count it finished, queueing the jobs that were waiting for its counter if it was the last
+	void Execute(QueuedJob& queued);
+
+	// Run other jobs until the counter is done, including main thread jobs if asked
+	void Help(JobCounter& counter, bool mainThreadJobs);
+
+	// Run one main thread job if there is one. Returns false if there were none
+	bool RunOneMainThreadJob();
+
+	// Index of the calling thread's worker, -1 if it isn't one of this job system's workers
+	int CurrentWorker();
+
+	std::vector<std::thread>               mWorkers;
+	std::vector<std::unique_ptr<JobQueue>> mWorkerQueues; // One per worker, same order
+	JobQueue                               mSharedQueue;
+	JobQueue                               mMainThreadQueue;
+	std::thread::id                        mMainThread;
+
+	// Workers sleep on this while there are no jobs. The count is of jobs in the worker and shared queues, changed before any
+	// worker is woken so one checking it under the mutex never misses a job
+	std::mutex              mMutex;
+	std::condition_variable mWorkReady;   // Signalled when a job is queued or on shutdown
+	std::atomic<size_t>     mQueuedJobs = 0;
+	bool                    mShutdown   = false;
+};
+
+
+#endif //_JOB_SYSTEM_H_INCLUDED_
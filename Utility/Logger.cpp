@@ -0,0 +1,274 @@
+//--------------------------------------------------------------------------------------
+// Logger class - text log of what the game is doing, written to rotating files on a background thread
+//--------------------------------------------------------------------------------------
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <cinttypes>
+
+
+Logger gLogger;
+
+// The calling thread's buffer in gLogger. There is only the one logger
+static thread_local void* tLogBuffer = nullptr;
+
+
+// Name of a severity for the log
+const char* LogLevelName(LogLevel level)
+{
+	switch (level)
+	{
+	case LogLevel::Debug:    return "DEBUG";
+	case LogLevel::Info:     return "INFO ";
+	case LogLevel::Warning:  return "WARN ";
+	case LogLevel::Error:    return "ERROR";
+	}
+	return "?    ";
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Stops the logger if it is running
+Logger::~Logger()
+{
+	Stop();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Create the log file, replacing any existing one, and start the background thread
+bool Logger::Start(const std::string& fileName, size_t maxFileSize /*= 4 * 1024 * 1024*/, int maxFiles /*= 3*/)
+{
+	Stop();
+	mFile = std::fopen(fileName.c_str(), "wb");
+	if (mFile == nullptr)  return false;
+
+	mFileName    = fileName;
+	mFileSize    = 0;
+	mMaxFileSize = maxFileSize;
+	mMaxFiles    = std::max(maxFiles, 1);
+	mStartTime   = Clock::now().time_since_epoch().count();
+	mStopping    = false;
+	mTotalDropped.store(0, std::memory_order_relaxed);
+
+	// Anything left in the buffers from an earlier run is from before this file
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		for (auto& buffer : mBuffers)
+		{
+			buffer->read.store(buffer->written.load(std::memory_order_acquire), std::memory_order_release);
+			buffer->dropped.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	mWriterThread = std::thread(&Logger::WriterLoop, this);
+	mRunning.store(true, std::memory_order_release);
+	return true;
+}
+
+
+// Write everything logged so far, close the file and stop the background thread
+void Logger::Stop()
+{
+	if (!mWriterThread.joinable())  return;
+
+	mRunning.store(false, std::memory_order_release);
+	{
+		std::lock_guard<std::mutex> lock(mWakeMutex);
+		mStopping = true;
+	}
+	mWake.notify_one();
+	mWriterThread.join();
+
+	if (mFile != nullptr)  std::fclose(mFile);
+	mFile = nullptr;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// The calling thread's buffer, created the first time it logs
+Logger::ThreadBuffer& Logger::CurrentBuffer()
+{
+	if (tLogBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		mBuffers.push_back(std::make_unique<ThreadBuffer>());
+		mBuffers.back()->index = static_cast<uint16_t>(mBuffers.size() - 1);
+		tLogBuffer = mBuffers.back().get();
+	}
+	return *static_cast<ThreadBuffer*>(tLogBuffer);
+}
+
+
+// Collect and write the records every FLUSH_INTERVAL until stopped, then once more for those logged before stopping
+void Logger::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(mWakeMutex);
+	while (!mStopping)
+	{
+		mWake.wait_for(lock, FLUSH_INTERVAL, [this] { return mStopping; });
+		lock.unlock();
+		Collect();
+		lock.lock();
+	}
+	lock.unlock();
+	Collect();
+}
+
+
+// Take the records logged since the last call from every thread's buffer and write them in time order
+void Logger::Collect()
+{
+	mCollected.clear();
+	uint32_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		for (auto& buffer : mBuffers)
+		{
+			uint32_t read    = buffer->read.load(std::memory_order_relaxed);
+			uint32_t written = buffer->written.load(std::memory_order_acquire);
+			for (; read != written; ++read)  mCollected.push_back(buffer->records[read & (BUFFER_SIZE - 1)]);
+			buffer->read.store(read, std::memory_order_release);
+			dropped += buffer->dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+	if (mCollected.empty() && dropped == 0)  return;
+
+	// Each thread's records are in order, but the threads' are interleaved
+	std::stable_sort(mCollected.begin(), mCollected.end(), [](const Record& a, const Record& b) { return a.time < b.time; });
+	for (const Record& record : mCollected)
+	{
+		char prefix[48];
+		double seconds = (record.time - mStartTime) * static_cast<double>(Clock::period::num) / Clock::period::den;
+		snprintf(prefix, sizeof(prefix), "[%10.4f] %s T%-2u ", seconds, LogLevelName(record.level), record.thread);
+		mText = prefix;
+		Format(record, mText);
+		mText += '\n';
+		WriteText(mText);
+	}
+	if (dropped > 0)
+	{
+		mTotalDropped.fetch_add(dropped, std::memory_order_relaxed);
+		WriteText("[          ] WARN  -- " + std::to_string(dropped) + " log messages dropped, a thread's buffer was full\n");
+	}
+	if (mFile != nullptr)  std::fflush(mFile);
+}
+
+
+// Append a record's text to the line, each {} in the format replaced by the next argument
+void Logger::Format(const Record& record, std::string& line)
+{
+	size_t offset = 0;
+	int    arg    = 0;
+	for (const char* c = record.format; *c != '\0'; ++c)
+	{
+		if (c[0] != '{' || c[1] != '}')
+		{
+			line += *c;
+			continue;
+		}
+		++c;
+		if (arg >= record.numArgs)
+		{
+			line += '?';
+			continue;
+		}
+
+		char text[32];
+		const std::byte* data = &record.data[offset];
+		switch (record.types[arg++])
+		{
+		case ArgType::Int:
+		{
+			int64_t value;
+			std::memcpy(&value, data, sizeof(value));
+			offset += sizeof(value);
+			snprintf(text, sizeof(text), "%" PRId64, value);
+			line += text;
+			break;
+		}
+		case ArgType::UInt:
+		{
+			uint64_t value;
+			std::memcpy(&value, data, sizeof(value));
+			offset += sizeof(value);
+			snprintf(text, sizeof(text), "%" PRIu64, value);
+			line += text;
+			break;
+		}
+		case ArgType::Float:
+		{
+			double value;
+			std::memcpy(&value, data, sizeof(value));
+			offset += sizeof(value);
+			snprintf(text, sizeof(text), "%g", value);
+			line += text;
+			break;
+		}
+		case ArgType::Bool:
+			line += (data[0] != std::byte{ 0 }) ? "true" : "false";
+			offset += 1;
+			break;
+		case ArgType::Pointer:
+		{
+			uintptr_t value;
+			std::memcpy(&value, data, sizeof(value));
+			offset += sizeof(value);
+			snprintf(text, sizeof(text), "0x%" PRIxPTR, value);
+			line += text;
+			break;
+		}
+		case ArgType::String:
+		{
+			size_t length = static_cast<size_t>(data[0]);
+			line.append(reinterpret_cast<const char*>(data + 1), length);
+			offset += 1 + length;
+			break;
+		}
+		}
+	}
+}
+
+
+// Write a line to the file, rotating the files first if it would take the file past its maximum size
+void Logger::WriteText(const std::string& text)
+{
+	if (mFileSize > 0 && mFileSize + text.size() > mMaxFileSize)  Rotate();
+	if (mFile == nullptr)  return;
+	mFileSize += std::fwrite(text.data(), 1, text.size(), mFile);
+}
+
+
+// Number the current file and the older ones up by one, deleting the oldest, and start a new file
+void Logger::Rotate()
+{
+	std::fclose(mFile);
+
+	// Boats.log is numbered Boats.1.log, Boats.1.log becomes Boats.2.log and so on
+	size_t dot = mFileName.find_last_of('.');
+	size_t slash = mFileName.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))  dot = mFileName.size();
+	auto numbered = [&](int number)
+	{
+		return mFileName.substr(0, dot) + "." + std::to_string(number) + mFileName.substr(dot);
+	};
+	if (mMaxFiles > 1)
+	{
+		std::remove(numbered(mMaxFiles - 1).c_str());
+		for (int number = mMaxFiles - 2; number >= 1; --number)  std::rename(numbered(number).c_str(), numbered(number + 1).c_str());
+		std::rename(mFileName.c_str(), numbered(1).c_str());
+	}
+
+	mFile = std::fopen(mFileName.c_str(), "wb");
+	mFileSize = 0;
+}
@@ -0,0 +1,307 @@
+//--------------------------------------------------------------------------------------
+// Logger class - text log of what the game is doing, written to rotating files on a background thread
+//--------------------------------------------------------------------------------------
+// Code logs with a severity macro, a format string literal with {} for each argument, and the arguments:
+//   LOG_INFO("Level {} loaded with {} entities", levelName, count);
+//   LOG_WARNING("Boat {} has no route to {}", boat->GetID(), station);
+//
+// A log call formats nothing. It copies the time, the format's pointer and the arguments by value (numbers as they are,
+// strings copied up to the space left) into a fixed size record in a ring belonging to the calling thread, so logging never
+// takes a lock or waits for another thread or the disk: each ring has a single writer (its thread) and a single reader (the
+// background thread), see ThreadBuffer. A record logged with its thread's ring full is dropped and counted, the count is
+// written to the log. A call costs a few tens of nanoseconds, safe for entity updates on any thread.
+//
+// The background thread collects the records every FLUSH_INTERVAL, formats them in time order and writes them to the file.
+// A file that grows to the maximum size is renamed with a number (Boats.log becomes Boats.1.log and so on) and a new one
+// started, the oldest being deleted so only the most recent files are kept.
+//
+// Severities below LOG_MIN_LEVEL are removed from the build (their arguments aren't even evaluated), by default Debug in
+// debug builds and Info otherwise. Define LOG_MIN_LEVEL for the build to change that. Severities below SetLevel are
+// skipped at run time for the cost of a check. Nothing is logged until Start is called
+//
+//   gLogger.Start("Boats.log");  ...  gLogger.Stop(); // Writes what is left
+
+#ifndef _LOGGER_H_INCLUDED_
+#define _LOGGER_H_INCLUDED_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
+
+
+// Severity of a log message, lowest first
+enum class LogLevel : uint8_t
+{
+	Debug   = 0,
+	Info    = 1,
+	Warning = 2,
+	Error   = 3,
+};
+
+// Name of a severity for the log, e.g. "WARN"
+const char* LogLevelName(LogLevel level);
+
+
+class Logger
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Arguments a record can hold, and bytes for them. Arguments past either are written as ?
+	static constexpr int    MAX_ARGS      = 8;
+	static constexpr size_t MAX_ARG_BYTES = 88;
+
+	// Records a thread can log between collections by the background thread, a power of two
+	static constexpr uint32_t BUFFER_SIZE = 2048;
+
+	// How often the background thread collects and writes the records
+	static constexpr std::chrono::milliseconds FLUSH_INTERVAL{ 20 };
+
+
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	Logger() = default;
+
+	// Stops the logger if it is running, see Stop
+	~Logger();
+
+	// Prevent copying - the logger owns its thread and other threads hold pointers to its buffers
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create the log file, replacing any existing one, and start the background thread. Files are rotated once they reach
+	// maxFileSize bytes, keeping maxFiles files including the current one. Returns false if the file can't be created
+	bool Start(const std::string& fileName, size_t maxFileSize = 4 * 1024 * 1024, int maxFiles = 3);
+
+	// Write everything logged so far, close the file and stop the background thread. Records logged after this are dropped
+	void Stop();
+
+	// Skip severities below the given one at run time. Info by default
+	void     SetLevel(LogLevel level)  { mLevel.store(level, std::memory_order_relaxed); }
+	LogLevel GetLevel()                { return mLevel.load(std::memory_order_relaxed); }
+
+	// Whether a message of the given severity would be logged now. Checked by the LOG macros before the arguments are captured
+	bool IsLogging(LogLevel level)
+	{
+		return mRunning.load(std::memory_order_relaxed) && level >= mLevel.load(std::memory_order_relaxed);
+	}
+
+	// Log a message with {} in the format for each argument. The format must be a string literal (only the pointer is kept).
+	// Arguments may be numbers, bools, enums, pointers and strings (const char*, std::string, std::string_view). Usually
+	// called by the LOG macros
+	template <typename... Args>
+	void Write(LogLevel level, const char* format, const Args&... args)
+	{
+		ThreadBuffer& buffer = CurrentBuffer();
+
+		// The read count is only increased by the background thread, so a full buffer can only become less full meanwhile
+		uint32_t written = buffer.written.load(std::memory_order_relaxed);
+		if (written - buffer.read.load(std::memory_order_acquire) >= BUFFER_SIZE)
+		{
+			buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		Record& record = buffer.records[written & (BUFFER_SIZE - 1)];
+		record.time    = Clock::now().time_since_epoch().count();
+		record.format  = format;
+		record.level   = level;
+		record.thread  = buffer.index;
+		record.numArgs = 0;
+		record.used    = 0;
+		(Capture(record, args), ...);
+		buffer.written.store(written + 1, std::memory_order_release); // The record is complete before the reader can see it
+	}
+
+	// Messages dropped because a thread's buffer was full, since Start
+	uint64_t Dropped()  { return mTotalDropped.load(std::memory_order_relaxed); }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// How each argument is stored in a record's data
+	enum class ArgType : uint8_t { Int, UInt, Float, Bool, Pointer, String };
+
+	// A logged message waiting to be formatted. Strings are stored as a length byte followed by the characters
+	struct Record
+	{
+		int64_t     time;
+		const char* format;
+		LogLevel    level;
+		uint8_t     numArgs;
+		uint8_t     used; // Bytes of data used
+		uint16_t    thread;
+		std::array<ArgType, MAX_ARGS>        types;
+		std::array<std::byte, MAX_ARG_BYTES> data;
+	};
+	static_assert(sizeof(Record) <= 128, "Keep log records small, they are copied on the hot path");
+
+	// Records logged by one thread, a ring written only by that thread and read only by the background thread. The writer
+	// fills the record at the write count then increases the count, the reader takes records up to the count and increases
+	// the read count, so each side only ever writes its own count
+	struct ThreadBuffer
+	{
+		std::array<Record, BUFFER_SIZE> records;
+		std::atomic<uint32_t> written = 0;
+		std::atomic<uint32_t> read    = 0;
+		std::atomic<uint32_t> dropped = 0;
+		uint16_t              index   = 0;
+	};
+
+	// The calling thread's buffer, created the first time it logs
+	ThreadBuffer& CurrentBuffer();
+
+	// Add an argument to a record, if there is room
+	template <typename T>
+	static void Capture(Record& record, const T& value)
+	{
+		if (record.numArgs >= MAX_ARGS)  return;
+
+		if constexpr (std::is_same_v<T, bool>)
+		{
+			CaptureValue(record, ArgType::Bool, static_cast<uint8_t>(value));
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			CaptureValue(record, ArgType::Int, static_cast<int64_t>(value));
+		}
+		else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+		{
+			CaptureValue(record, ArgType::Int, static_cast<int64_t>(value));
+		}
+		else if constexpr (std::is_integral_v<T>)
+		{
+			CaptureValue(record, ArgType::UInt, static_cast<uint64_t>(value));
+		}
+		else if constexpr (std::is_floating_point_v<T>)
+		{
+			CaptureValue(record, ArgType::Float, static_cast<double>(value));
+		}
+		else if constexpr (std::is_convertible_v<const T&, std::string_view>)
+		{
+			if constexpr (std::is_pointer_v<T>)
+			{
+				if (value == nullptr)  { CaptureString(record, "(null)");  return; }
+			}
+			CaptureString(record, std::string_view(value));
+		}
+		else if constexpr (std::is_pointer_v<T>)
+		{
+			CaptureValue(record, ArgType::Pointer, reinterpret_cast<uintptr_t>(value));
+		}
+		else
+		{
+			static_assert(std::is_pointer_v<T>, "Log arguments must be numbers, bools, enums, pointers or strings");
+		}
+	}
+
+	template <typename T>
+	static void CaptureValue(Record& record, ArgType type, T value)
+	{
+		if (record.used + sizeof(T) > MAX_ARG_BYTES)  return;
+		std::memcpy(&record.data[record.used], &value, sizeof(T));
+		record.used = static_cast<uint8_t>(record.used + sizeof(T));
+		record.types[record.numArgs++] = type;
+	}
+
+	static void CaptureString(Record& record, std::string_view text)
+	{
+		if (static_cast<size_t>(record.used) + 1 > MAX_ARG_BYTES)  return;
+		size_t length = MAX_ARG_BYTES - record.used - 1; // Fits the length byte, as MAX_ARG_BYTES is below 256
+		if (text.size() < length)  length = text.size();
+		record.data[record.used] = static_cast<std::byte>(length);
+		std::memcpy(&record.data[record.used + 1], text.data(), length);
+		record.used = static_cast<uint8_t>(record.used + 1 + length);
+		record.types[record.numArgs++] = ArgType::String;
+	}
+
+	// Function run by the background thread - collects, formats and writes the records every FLUSH_INTERVAL until stopped
+	void WriterLoop();
+
+	// Take the records logged since the last call from every thread's buffer and write them in time order
+	void Collect();
+
+	// Append a record's text to the line
+	void Format(const Record& record, std::string& line);
+
+	// Write text to the file, rotating the files first if it would take the file past its maximum size
+	void WriteText(const std::string& text);
+	void Rotate();
+
+	std::atomic<bool>     mRunning = false;
+	std::atomic<LogLevel> mLevel   = LogLevel::Info;
+
+	// Every thread's buffer, only added to. The mutex is only taken when a thread first logs and by the background thread
+	std::mutex                                 mBuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
+
+	// Used by the background thread only, once started
+	std::thread             mWriterThread;
+	std::mutex              mWakeMutex;
+	std::condition_variable mWake; // Signalled by Stop
+	bool                    mStopping = false;
+	std::FILE*              mFile = nullptr;
+	std::string             mFileName;
+	size_t                  mFileSize    = 0;
+	size_t                  mMaxFileSize = 0;
+	int                     mMaxFiles    = 0;
+	int64_t                 mStartTime   = 0;
+	std::vector<Record>     mCollected; // Kept to reuse their capacity
+	std::string             mText;
+	std::atomic<uint64_t>   mTotalDropped = 0;
+};
+
+
+// The logger the LOG macros write to
+extern Logger gLogger;
+
+
+// Severities below this are removed from the build, see the comment at the top of the file
+#ifndef LOG_MIN_LEVEL
+	#ifdef _DEBUG
+		#define LOG_MIN_LEVEL 0
+	#else
+		#define LOG_MIN_LEVEL 1
+	#endif
+#endif
+
+// Log a message of the given severity: LOG_INFO("Format with {} and {}", a, b). The arguments are only evaluated if the
+// message is logged
+#define LOG_AT(level, ...)                                                                   \
+	do                                                                                       \
+	{                                                                                        \
+		if constexpr (static_cast<int>(level) >= LOG_MIN_LEVEL)                              \
+		{                                                                                    \
+			if (gLogger.IsLogging(level))  gLogger.Write(level, __VA_ARGS__);                \
+		}                                                                                    \
+	} while (false)
+
+#define LOG_DEBUG(...)    LOG_AT(LogLevel::Debug,   __VA_ARGS__)
+#define LOG_INFO(...)     LOG_AT(LogLevel::Info,    __VA_ARGS__)
+#define LOG_WARNING(...)  LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...)    LOG_AT(LogLevel::Error,   __VA_ARGS__)
+
+
+#endif // _LOGGER_H_INCLUDED_
@@ -0,0 +1,171 @@
+//--------------------------------------------------------------------------------------
+// Metrics exporter - pushes live counters and gauges to a statsd server over UDP from a background thread
+//--------------------------------------------------------------------------------------
+
+#include "MetricsExporter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+// Stops the export thread if it is running
+MetricsExporter::~MetricsExporter()
+{
+	Stop();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Setup
+-----------------------------------------------------------------------------------------*/
+
+int MetricsExporter::AddMetric(const std::string& name, bool isGauge)
+{
+	if (IsRunning() || mNumMetrics == MAX_METRICS)  return -1;
+	Metric& metric = mMetrics[mNumMetrics];
+	metric.name    = name;
+	metric.isGauge = isGauge;
+	return mNumMetrics++;
+}
+
+
+// Start sending the metrics to the given host and port every interval seconds. Returns false with an error if the host can't
+// be found or the socket can't be opened
+bool MetricsExporter::Start(const std::string& host, uint16_t port, const std::string& prefix, float interval, std::string& error)
+{
+	Stop();
+
+	if (!UdpSocket::Resolve(host, port, mAddress))
+	{
+		error = "Can't find metrics host " + host;
+		return false;
+	}
+	if (!mSocket.Open())
+	{
+		error = mSocket.GetLastError();
+		return false;
+	}
+
+	mPrefix   = prefix.empty() ? prefix : prefix + ".";
+	mInterval = std::max(interval, 0.1f);
+	for (int i = 0; i < mNumMetrics; ++i)  mMetrics[i].sent = mMetrics[i].count.load(std::memory_order_relaxed);
+	mFramesExported = mFramesAdded.load(std::memory_order_acquire);
+	mFrameSamples.reserve(FRAME_TIMES);
+	mDatagram.reserve(MAX_DATAGRAM);
+	mStopping = false;
+	mThread = std::thread(&MetricsExporter::ExportLoop, this);
+	return true;
+}
+
+
+// Send the metrics a last time and stop the export thread
+void MetricsExporter::Stop()
+{
+	if (!IsRunning())  return;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWake.notify_one();
+	mThread.join();
+	mSocket.Close();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Private helpers
+-----------------------------------------------------------------------------------------*/
+
+// Wake every interval and export, until stopped. Exports are timed from the start so a slow send doesn't make them drift
+void MetricsExporter::ExportLoop()
+{
+	using Clock = std::chrono::steady_clock;
+	const auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(mInterval));
+	auto next = Clock::now() + interval;
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (!mStopping)
+	{
+		if (mWake.wait_until(lock, next, [this] { return mStopping; }))  break;
+		lock.unlock();
+		Export();
+		lock.lock();
+		next += interval;
+	}
+	lock.unlock();
+	Export();
+}
+
+
+// Send the metrics as statsd lines
+void MetricsExporter::Export()
+{
+	char value[64];
+	for (int i = 0; i < mNumMetrics; ++i)
+	{
+		Metric& metric = mMetrics[i];
+		if (metric.isGauge)
+		{
+			std::snprintf(value, sizeof(value), ":%g|g", metric.gauge.load(std::memory_order_relaxed));
+		}
+		else
+		{
+			uint64_t count = metric.count.load(std::memory_order_relaxed);
+			std::snprintf(value, sizeof(value), ":%llu|c", static_cast<unsigned long long>(count - metric.sent));
+			metric.sent = count;
+		}
+		AddLine(mPrefix + metric.name + value);
+	}
+
+	// The frame times added since the last export, the most recent FRAME_TIMES if more. A time being overwritten as it is read
+	// belongs to a newer frame, which is as good a sample
+	uint64_t framesAdded = mFramesAdded.load(std::memory_order_acquire);
+	uint64_t frames = std::min<uint64_t>(framesAdded - mFramesExported, FRAME_TIMES);
+	mFramesExported = framesAdded;
+	std::snprintf(value, sizeof(value), ":%llu|c", static_cast<unsigned long long>(frames));
+	AddLine(mPrefix + "frame.count" + value);
+	if (frames > 0)
+	{
+		mFrameSamples.clear();
+		for (uint64_t frame = framesAdded - frames; frame < framesAdded; ++frame)
+		{
+			mFrameSamples.push_back(mFrameTimes[frame % FRAME_TIMES].load(std::memory_order_relaxed));
+		}
+		auto percentile = [&](const char* name, size_t rank)
+		{
+			std::nth_element(mFrameSamples.begin(), mFrameSamples.begin() + rank, mFrameSamples.end());
+			std::snprintf(value, sizeof(value), ":%.3f|g", mFrameSamples[rank] * 1000.0f);
+			AddLine(mPrefix + "frame.ms." + name + value);
+		};
+		size_t last = mFrameSamples.size() - 1;
+		percentile("p50", last * 50 / 100);
+		percentile("p95", last * 95 / 100);
+		percentile("p99", last * 99 / 100);
+		percentile("max", last);
+	}
+
+	SendDatagram();
+}
+
+
+// Add a line to the datagram being built, sending it first if the line won't fit
+void MetricsExporter::AddLine(const std::string& line)
+{
+	if (!mDatagram.empty() && mDatagram.size() + 1 + line.size() > MAX_DATAGRAM)  SendDatagram();
+	if (!mDatagram.empty())  mDatagram += '\n';
+	mDatagram += line;
+}
+
+
+void MetricsExporter::SendDatagram()
+{
+	if (mDatagram.empty())  return;
+	if (mSocket.Send(mAddress, mDatagram.data(), mDatagram.size()))  mDatagramsSent  .fetch_add(1, std::memory_order_relaxed);
+	else                                                             mDatagramsFailed.fetch_add(1, std::memory_order_relaxed);
+	mDatagram.clear();
+}
@@ -0,0 +1,157 @@
+//--------------------------------------------------------------------------------------
+// Metrics exporter - pushes live counters and gauges to a statsd server over UDP from a background thread
+//--------------------------------------------------------------------------------------
+// For monitoring many running instances remotely (display walls, batch farms). The metrics are named when the exporter is
+// set up, then the game thread updates them with single relaxed atomic operations: counters are added to, gauges are stored
+// and frame times go into a ring of the most recent FRAME_TIMES. The export thread wakes every interval, reads the values,
+// takes the percentiles of the frame times added since it last looked and sends the lot as statsd lines in as few datagrams
+// as fit. So the game thread never takes a lock, waits or makes a system call for the exporter, and a monitoring server that
+// is down or missing costs lost datagrams, nothing more.
+//
+//   MetricsExporter metrics;
+//   int steps  = metrics.AddCounter("sim.steps");    // Before Start
+//   int boats  = metrics.AddGauge("entities.boats");
+//   if (!metrics.Start("monitor", MetricsExporter::DEFAULT_PORT, "boats.wall3", 1.0f, error))  ...
+//   ... metrics.Count(steps);  metrics.SetGauge(boats, numBoats);  metrics.AddFrameTime(frameTime);
+//   metrics.Stop();
+//
+// Lines sent, each prefixed with the prefix given to Start and a dot (see https://github.com/statsd/statsd):
+//   <counter>:<added since the last export>|c
+//   <gauge>:<value>|g
+//   frame.ms.p50, frame.ms.p95, frame.ms.p99, frame.ms.max:<milliseconds>|g, and frame.count:<frames>|c
+
+#ifndef _METRICS_EXPORTER_H_INCLUDED_
+#define _METRICS_EXPORTER_H_INCLUDED_
+
+#include "UdpSocket.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+
+class MetricsExporter
+{
+	/*-----------------------------------------------------------------------------------------
+		Settings
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The usual statsd port
+	static constexpr uint16_t DEFAULT_PORT = 8125;
+
+	// Counters and gauges that can be set up, and the most recent frame times kept for the percentiles
+	static constexpr int MAX_METRICS = 64;
+	static constexpr int FRAME_TIMES = 1024;
+
+	// Largest datagram sent, to stay within a typical network MTU
+	static constexpr size_t MAX_DATAGRAM = 1400;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	MetricsExporter() = default;
+
+	// Stops the export thread if it is running
+	~MetricsExporter();
+
+	// Prevent copying - the exporter owns its thread
+	MetricsExporter(const MetricsExporter&) = delete;
+	MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Setup
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add a counter or gauge with the given name, e.g. "entities.boats". Returns its index for Count or SetGauge, or -1 if there
+	// are already MAX_METRICS. Metrics can only be added while the exporter is stopped
+	int AddCounter(const std::string& name)  { return AddMetric(name, false); }
+	int AddGauge  (const std::string& name)  { return AddMetric(name, true); }
+
+	// Start sending the metrics to the given host and port every interval seconds, each name prefixed with the given prefix
+	// (e.g. the machine's name). Returns false with an error if the host can't be found or the socket can't be opened
+	bool Start(const std::string& host, uint16_t port, const std::string& prefix, float interval, std::string& error);
+
+	// Send the metrics a last time and stop the export thread
+	void Stop();
+
+	bool IsRunning()  { return mThread.joinable(); }
+
+	// Datagrams sent and failed to send, for display
+	uint64_t DatagramsSent()    { return mDatagramsSent.load(std::memory_order_relaxed); }
+	uint64_t DatagramsFailed()  { return mDatagramsFailed.load(std::memory_order_relaxed); }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Updating metrics - lock-free, from one thread at a time
+	-----------------------------------------------------------------------------------------*/
+public:
+	void Count(int counter, uint64_t amount = 1)  { mMetrics[counter].count.fetch_add(amount, std::memory_order_relaxed); }
+	void SetGauge(int gauge, double value)        { mMetrics[gauge].gauge.store(value, std::memory_order_relaxed); }
+
+	// Add the time a frame took, in seconds
+	void AddFrameTime(float seconds)
+	{
+		uint64_t frame = mFramesAdded.load(std::memory_order_relaxed);
+		mFrameTimes[frame % FRAME_TIMES].store(seconds, std::memory_order_relaxed);
+		mFramesAdded.store(frame + 1, std::memory_order_release);
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct Metric
+	{
+		std::string           name;
+		bool                  isGauge = false;
+		std::atomic<uint64_t> count   = 0;
+		std::atomic<double>   gauge   = 0;
+		uint64_t              sent    = 0; // Count when last exported, only used by the export thread
+	};
+
+	int AddMetric(const std::string& name, bool isGauge);
+
+	// Wake every interval and export, until stopped
+	void ExportLoop();
+
+	// Send the metrics as statsd lines
+	void Export();
+
+	// Add a line to the datagram being built, sending it first if the line won't fit
+	void AddLine(const std::string& line);
+	void SendDatagram();
+
+	Metric mMetrics[MAX_METRICS];
+	int    mNumMetrics = 0;
+
+	std::atomic<float>    mFrameTimes[FRAME_TIMES];
+	std::atomic<uint64_t> mFramesAdded = 0;
+	uint64_t              mFramesExported = 0; // Only used by the export thread
+	std::vector<float>    mFrameSamples;       // Scratch for the percentiles
+
+	UdpSocket           mSocket;
+	UdpSocket::Address  mAddress;
+	std::string         mPrefix;
+	std::string         mDatagram;
+	float               mInterval = 1.0f;
+
+	std::atomic<uint64_t> mDatagramsSent   = 0;
+	std::atomic<uint64_t> mDatagramsFailed = 0;
+
+	// Only Start, Stop and the export thread use these
+	std::thread             mThread;
+	std::mutex              mMutex;
+	std::condition_variable mWake;
+	bool                    mStopping = false;
+};
+
+
+#endif //_METRICS_EXPORTER_H_INCLUDED_
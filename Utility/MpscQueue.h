@@ -0,0 +1,125 @@
+//--------------------------------------------------------------------------------------
+// MpscQueue class - bounded lock-free queue for many producer threads and one consumer
+//--------------------------------------------------------------------------------------
+// Items are held in a fixed ring of cells. Each cell has a sequence number that says whether it is free for the producer
+// that has claimed it or holds an item ready for the consumer. Producers claim a position with a compare-and-swap on the
+// tail and then fill their cell, so they only contend with each other for the tail and never wait for the consumer. The
+// consumer takes items from the head without any atomic read-modify-write. Pushing to a full queue fails rather than waits.
+//
+// The head and tail are on separate cache lines, so the consumer and the producers don't slow each other down by writing to
+// the same line (false sharing).
+//
+// Items pushed by one producer are popped in the order that producer pushed them. Items from different producers are
+// interleaved in whatever order their pushes happened to claim positions, which varies from run to run
+
+#ifndef _MPSC_QUEUE_H_INCLUDED_
+#define _MPSC_QUEUE_H_INCLUDED_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <stddef.h>
+
+
+template <typename T>
+class MpscQueue
+{
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Create an empty queue that can hold the given number of items, rounded up to a power of two
+	MpscQueue(size_t capacity = 1024)
+	{
+		size_t size = 2;
+		while (size < capacity)  size *= 2;
+		mCapacity = size;
+		mCells = std::make_unique<Cell[]>(size);
+		for (size_t i = 0; i < size; ++i)  mCells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	// Prevent copying - other threads may hold references to the queue
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Add an item to the back of the queue. Safe to call from any number of threads at once. Returns false if the queue is
+	// full, in which case the item is not moved from
+	bool TryPush(T&& item)
+	{
+		size_t position = mTail.value.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = mCells[position & (mCapacity - 1)];
+			size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			if (sequence == position)
+			{
+				// The cell is free, claim it. On failure position is updated to the current tail and we try again
+				if (mTail.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.item = std::move(item);
+					cell.sequence.store(position + 1, std::memory_order_release); // Now ready for the consumer
+					return true;
+				}
+			}
+			else if (sequence < position)
+			{
+				return false; // The cell still holds an item from the previous time round the ring, so the queue is full
+			}
+			else
+			{
+				position = mTail.value.load(std::memory_order_relaxed); // Another producer claimed this position first
+			}
+		}
+	}
+
+	// Take the item at the front of the queue. Only one thread may pop at a time. Returns false if the queue is empty or the
+	// item at the front is still being written by its producer
+	bool TryPop(T& item)
+	{
+		size_t position = mHead.value;
+		Cell& cell = mCells[position & (mCapacity - 1)];
+		if (cell.sequence.load(std::memory_order_acquire) != position + 1)  return false;
+
+		item = std::move(cell.item);
+		cell.sequence.store(position + mCapacity, std::memory_order_release); // Free for the producer next time round the ring
+		mHead.value = position + 1;
+		return true;
+	}
+
+	// Maximum number of items held at once
+	size_t Capacity() const  { return mCapacity; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T item;
+	};
+
+	// Each index on its own cache line
+	template <typename Index>
+	struct alignas(CACHE_LINE_SIZE) PaddedIndex
+	{
+		Index value = 0;
+	};
+
+	PaddedIndex<std::atomic<size_t>> mTail; // Next position for a producer to claim, shared by all producers
+	PaddedIndex<size_t>              mHead; // Next position for the consumer to take, only used by the consumer
+
+	size_t mCapacity;
+	std::unique_ptr<Cell[]> mCells;
+};
+
+
+#endif //_MPSC_QUEUE_H_INCLUDED_
@@ -0,0 +1,455 @@
+//--------------------------------------------------------------------------------------
+// Performance gate - repeated benchmark runs compared against a stored baseline
+//--------------------------------------------------------------------------------------
+
+#include "PerfGate.h"
+
+#define NOMINMAX // Use NOMINMAX to stop certain Microsoft headers defining "min" and "max", which breaks std::clamp
+#include <windows.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+/*-----------------------------------------------------------------------------------------
+	Statistics
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	// Student's t distribution for 1 to 30 degrees of freedom, the value below which 97.5% (two-sided 95% intervals) and 95%
+	// (one-sided 95% tests) of it lies. Beyond 30 the value for 30 is used up to 120, then the normal distribution's, which
+	// slightly overstates the intervals in between
+	const double T_975[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+	                         2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	const double T_95[]  = { 6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812, 1.796, 1.782, 1.771, 1.761, 1.753,
+	                         1.746, 1.740, 1.734, 1.729, 1.725, 1.721, 1.717, 1.714, 1.711, 1.708, 1.706, 1.703, 1.701, 1.699, 1.697 };
+
+	double TValue(const double (&table)[30], double normal, double degreesOfFreedom)
+	{
+		int row = static_cast<int>(degreesOfFreedom); // Rounding down is the wider interval
+		if (row < 1)    return table[0];
+		if (row <= 30)  return table[row - 1];
+		return row <= 120 ? table[29] : normal;
+	}
+}
+
+// Half the width of the 95% confidence interval of the mean
+double MetricSummary::ConfidenceInterval() const
+{
+	if (runs < 2)  return 0;
+	return TValue(T_975, 1.960, runs - 1) * stdDev / std::sqrt(runs);
+}
+
+// Summarise the values of a metric from each run
+MetricSummary SummariseMetric(const std::vector<double>& values)
+{
+	MetricSummary summary;
+	summary.runs = static_cast<int>(values.size());
+	if (values.empty())  return summary;
+
+	for (double value : values)  summary.mean += value;
+	summary.mean /= values.size();
+	if (values.size() > 1)
+	{
+		double squares = 0;
+		for (double value : values)  squares += (value - summary.mean) * (value - summary.mean);
+		summary.stdDev = std::sqrt(squares / (values.size() - 1));
+	}
+	return summary;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Baseline
+-----------------------------------------------------------------------------------------*/
+
+// A baseline is written as
+//   { "metrics": {
+//     "FlyThrough FrameMs P95": { "mean": 12.5, "stdDev": 0.31, "runs": 5 },
+//     ... } }
+// and read back by a reader for just that: objects, strings and numbers
+
+namespace
+{
+	void WriteJsonString(std::ostream& out, const std::string& text)
+	{
+		out << '"';
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')  out << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)  out << ' ';
+			else  out << c;
+		}
+		out << '"';
+	}
+
+	class JsonReader
+	{
+	public:
+		JsonReader(const std::string& text) : mText(text) {}
+
+		bool Expect(char c)
+		{
+			SkipSpace();
+			if (mPosition >= mText.size() || mText[mPosition] != c)  return false;
+			++mPosition;
+			return true;
+		}
+
+		bool String(std::string& value)
+		{
+			if (!Expect('"'))  return false;
+			value.clear();
+			while (mPosition < mText.size() && mText[mPosition] != '"')
+			{
+				if (mText[mPosition] == '\\' && mPosition + 1 < mText.size())  ++mPosition;
+				value += mText[mPosition++];
+			}
+			return Expect('"');
+		}
+
+		bool Number(double& value)
+		{
+			SkipSpace();
+			const char* start = mText.c_str() + mPosition;
+			char* end;
+			value = std::strtod(start, &end);
+			if (end == start)  return false;
+			mPosition += end - start;
+			return true;
+		}
+
+		// Read an object's members, calling member(name) for each with the reader at its value. Stops and returns false if
+		// member does, or the object is malformed
+		template <typename Member> bool Object(Member member)
+		{
+			if (!Expect('{'))  return false;
+			if (Expect('}'))  return true;
+			do
+			{
+				std::string name;
+				if (!String(name) || !Expect(':') || !member(name))  return false;
+			} while (Expect(','));
+			return Expect('}');
+		}
+
+	private:
+		void SkipSpace()
+		{
+			while (mPosition < mText.size() && std::isspace(static_cast<unsigned char>(mText[mPosition])))  ++mPosition;
+		}
+
+		const std::string& mText;
+		size_t mPosition = 0;
+	};
+}
+
+// Read a baseline, returns false with error set if the file can't be read or isn't a baseline
+bool ReadPerfBaseline(const std::filesystem::path& file, MetricSummaries& metrics, std::string& error)
+{
+	std::ifstream stream(file);
+	if (!stream)
+	{
+		error = "Perf Gate: Cannot open baseline " + file.string() + ", make one with -save-baseline";
+		return false;
+	}
+	std::stringstream text;
+	text << stream.rdbuf();
+	std::string json = text.str();
+
+	JsonReader reader(json);
+	bool read = reader.Object([&](const std::string& name)
+	{
+		if (name != "metrics")  return false;
+		return reader.Object([&](const std::string& metricName)
+		{
+			MetricSummary& summary = metrics[metricName];
+			return reader.Object([&](const std::string& field)
+			{
+				double value;
+				if (!reader.Number(value))  return false;
+				if      (field == "mean")    summary.mean   = value;
+				else if (field == "stdDev")  summary.stdDev = value;
+				else if (field == "runs")    summary.runs   = static_cast<int>(value);
+				return true;
+			});
+		});
+	});
+	if (!read)
+	{
+		error = "Perf Gate: " + file.string() + " is not a baseline";
+		return false;
+	}
+	return true;
+}
+
+// Write a baseline, returns false if it can't be written
+bool WritePerfBaseline(const std::filesystem::path& file, const MetricSummaries& metrics)
+{
+	std::ofstream stream(file);
+	if (!stream)  return false;
+	stream << std::setprecision(9) << "{ \"metrics\": {";
+	const char* separator = "\n";
+	for (const auto& [name, summary] : metrics)
+	{
+		stream << separator << "  ";
+		WriteJsonString(stream, name);
+		stream << ": { \"mean\": " << summary.mean << ", \"stdDev\": " << summary.stdDev << ", \"runs\": " << summary.runs << " }";
+		separator = ",\n";
+	}
+	stream << "\n} }\n";
+	return static_cast<bool>(stream);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Comparison
+-----------------------------------------------------------------------------------------*/
+
+// Compare the current metrics with the baseline, returning the report
+std::string ComparePerfMetrics(const MetricSummaries& baseline, const MetricSummaries& current, double threshold, int& regressions)
+{
+	enum class Result { Regression, Improvement, Unchanged, New, Missing };
+	const char* resultNames[] = { "REGRESSION", "improved", "ok", "new", "missing" };
+	struct Line
+	{
+		Result      result;
+		std::string name, baseline, current, change;
+	};
+
+	auto format = [](const MetricSummary& summary)
+	{
+		std::ostringstream text;
+		text << std::setprecision(4) << summary.mean << " +- " << std::setprecision(2) << summary.ConfidenceInterval();
+		return text.str();
+	};
+
+	std::vector<Line> lines;
+	for (const auto& [name, now] : current)
+	{
+		auto found = baseline.find(name);
+		if (found == baseline.end())
+		{
+			lines.push_back({ Result::New, name, "", format(now), "" });
+			continue;
+		}
+
+		// Welch's t-test, which doesn't assume the two sets of runs are equally noisy, then the change must also pass the
+		// threshold so tiny but consistent changes don't fail the gate
+		const MetricSummary& before = found->second;
+		double difference = now.mean - before.mean;
+		double beforeError = before.runs > 0 ? before.stdDev * before.stdDev / before.runs : 0;
+		double nowError    = now.runs    > 0 ? now.stdDev * now.stdDev / now.runs          : 0;
+		double standardError = std::sqrt(beforeError + nowError);
+		bool significant;
+		if (standardError == 0)
+		{
+			significant = difference != 0;
+		}
+		else
+		{
+			double degreesOfFreedom = std::pow(beforeError + nowError, 2) /
+			                          ((before.runs > 1 ? beforeError * beforeError / (before.runs - 1) : 0) +
+			                           (now.runs    > 1 ? nowError * nowError / (now.runs - 1)          : 0) + 1e-300);
+			significant = std::abs(difference) / standardError > TValue(T_95, 1.645, degreesOfFreedom);
+		}
+		double change = before.mean != 0 ? difference / std::abs(before.mean) : (difference > 0 ? 1.0 : difference < 0 ? -1.0 : 0);
+
+		Result result = Result::Unchanged;
+		if (significant && change > threshold)        result = Result::Regression;
+		else if (significant && change < -threshold)  result = Result::Improvement;
+
+		std::ostringstream changeText;
+		changeText << std::showpos << std::fixed << std::setprecision(1) << change * 100 << '%';
+		lines.push_back({ result, name, format(before), format(now), changeText.str() });
+	}
+	for (const auto& [name, before] : baseline)
+	{
+		if (current.find(name) == current.end())  lines.push_back({ Result::Missing, name, format(before), "", "" });
+	}
+
+	std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) { return a.result < b.result; });
+	regressions = static_cast<int>(std::count_if(lines.begin(), lines.end(), [](const Line& line) { return line.result == Result::Regression; }));
+
+	size_t nameWidth = 6;
+	for (const Line& line : lines)  nameWidth = std::max(nameWidth, line.name.size());
+	std::ostringstream report;
+	report << std::left << regressions << " regressions in " << current.size() << " metrics (threshold "
+	       << threshold * 100 << "%, mean +- 95% confidence interval)\n\n"
+	       << std::setw(nameWidth + 2) << "Metric" << std::setw(22) << "Baseline" << std::setw(22) << "Current"
+	       << std::setw(10) << "Change" << "Result\n";
+	for (const Line& line : lines)
+	{
+		report << std::setw(nameWidth + 2) << line.name << std::setw(22) << line.baseline << std::setw(22) << line.current
+		       << std::setw(10) << line.change << resultNames[static_cast<int>(line.result)] << '\n';
+	}
+	return report.str();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Runs
+-----------------------------------------------------------------------------------------*/
+
+namespace
+{
+	// Run this executable with the given arguments and wait for it, returning its exit code or -1 if it can't be started
+	int RunProcess(const std::wstring& exe, const std::wstring& arguments, bool window)
+	{
+		std::wstring commandLine = L"\"" + exe + L"\" " + arguments;
+		STARTUPINFOW startup = { sizeof(startup) };
+		PROCESS_INFORMATION process = {};
+		if (!CreateProcessW(exe.c_str(), commandLine.data(), nullptr, nullptr, FALSE, window ? 0 : CREATE_NO_WINDOW,
+		                    nullptr, nullptr, &startup, &process))  return -1;
+		CloseHandle(process.hThread);
+		WaitForSingleObject(process.hProcess, INFINITE);
+		DWORD exitCode = 1;
+		GetExitCodeProcess(process.hProcess, &exitCode);
+		CloseHandle(process.hProcess);
+		return static_cast<int>(exitCode);
+	}
+
+	std::wstring Quoted(const std::filesystem::path& path)  { return L"\"" + path.wstring() + L"\""; }
+
+	// The CSV fields of a line, a field in quotes may contain commas
+	std::vector<std::string> CsvFields(const std::string& line)
+	{
+		std::vector<std::string> fields(1);
+		bool quoted = false;
+		for (char c : line)
+		{
+			if (c == '"')                 quoted = !quoted;
+			else if (c == ',' && !quoted) fields.emplace_back();
+			else if (c != '\r')           fields.back() += c;
+		}
+		return fields;
+	}
+
+	// Add the nanoseconds per item of each benchmark in a microbenchmark results file, returns false if it can't be read
+	bool ReadMicroBenchmarks(const std::filesystem::path& file, std::map<std::string, std::vector<double>>& values)
+	{
+		std::ifstream stream(file);
+		std::string line;
+		if (!std::getline(stream, line) || line.rfind("Benchmark,", 0) != 0)  return false;
+		while (std::getline(stream, line))
+		{
+			auto fields = CsvFields(line);
+			if (fields.size() >= 4)  values["Micro " + fields[0] + " ns"].push_back(std::atof(fields[3].c_str()));
+		}
+		return true;
+	}
+
+	// Add the timing measures of a fly-through results file, returns false if it can't be read. Counts such as entities drawn
+	// are the same every run so are left out
+	bool ReadFlyThrough(const std::filesystem::path& file, std::map<std::string, std::vector<double>>& values)
+	{
+		std::ifstream stream(file);
+		std::string line;
+		if (!std::getline(stream, line) || line.rfind("Measure,", 0) != 0)  return false;
+		while (std::getline(stream, line))
+		{
+			auto fields = CsvFields(line);
+			if (fields.size() < 6)  continue;
+			const std::string& measure = fields[0];
+			auto add = [&](const char* column, size_t field) { values["FlyThrough " + measure + " " + column].push_back(std::atof(fields[field].c_str())); };
+			if (measure == "FrameMs")
+			{
+				add("Average", 1);  add("P50", 2);  add("P95", 3);  add("P99", 4);
+			}
+			else if (measure == "CpuMs" || measure == "GpuMs")
+			{
+				add("Average", 1);  add("P95", 3);
+			}
+			else if (measure == "VideoMemoryMB")          add("Max", 5);
+			else if (measure.rfind("Scope ", 0) == 0)     add("Average", 1);
+			else if (measure == "StartupMs")              values["FlyThrough StartupMs"].push_back(std::atof(fields[1].c_str()));
+		}
+		return true;
+	}
+}
+
+// Make the runs, compare them with the baseline and write the report (or save the runs as the baseline)
+bool RunPerfGate(const PerfGateOptions& options, int& regressions, std::string& error)
+{
+	regressions = 0;
+	MetricSummaries baseline;
+	if (!options.saveBaseline && !ReadPerfBaseline(options.baselineFile, baseline, error))  return false;
+
+	std::filesystem::path runsFolder = options.reportFile;
+	runsFolder += ".runs";
+	std::error_code fileError;
+	std::filesystem::create_directories(runsFolder, fileError);
+	if (fileError)
+	{
+		error = "Perf Gate: Cannot create folder " + runsFolder.string();
+		return false;
+	}
+
+	// Each run is another copy of this executable
+	wchar_t exe[MAX_PATH];
+	if (GetModuleFileNameW(nullptr, exe, MAX_PATH) == 0)
+	{
+		error = "Perf Gate: Cannot find the executable to run";
+		return false;
+	}
+
+	// The two benchmarks alternate, so a change in the machine's state over the runs affects both alike
+	std::map<std::string, std::vector<double>> values;
+	int runs = std::max(options.runs, 2);
+	for (int run = 1; run <= runs; ++run)
+	{
+		auto microFile = runsFolder / ("MicroBenchmarks" + std::to_string(run) + ".csv");
+		auto flyFile   = runsFolder / ("FlyThrough" + std::to_string(run) + ".csv");
+		if (RunProcess(exe, L"-microbench " + Quoted(options.levelFile) + L" -out " + Quoted(microFile), false) != 0 ||
+		    !ReadMicroBenchmarks(microFile, values))
+		{
+			error = "Perf Gate: Microbenchmark run " + std::to_string(run) + " failed, see " + microFile.string();
+			return false;
+		}
+		if (RunProcess(exe, L"-flythrough " + Quoted(options.levelFile) + L" -time " + std::to_wstring(options.seconds) +
+		                    L" -out " + Quoted(flyFile), true) != 0 ||
+		    !ReadFlyThrough(flyFile, values))
+		{
+			error = "Perf Gate: Fly-through run " + std::to_string(run) + " failed, see " + flyFile.string();
+			return false;
+		}
+	}
+
+	MetricSummaries current;
+	for (const auto& [name, metricValues] : values)  current[name] = SummariseMetric(metricValues);
+
+	std::ofstream report(options.reportFile);
+	if (!report)
+	{
+		error = "Perf Gate: Cannot write report " + options.reportFile.string();
+		return false;
+	}
+	report << "Performance report: " << runs << " runs of " << options.levelFile << ", " << options.seconds << "s fly-throughs\n";
+	if (options.saveBaseline)
+	{
+		if (!WritePerfBaseline(options.baselineFile, current))
+		{
+			error = "Perf Gate: Cannot write baseline " + options.baselineFile.string();
+			return false;
+		}
+		report << "Saved as the baseline " << options.baselineFile.string() << "\n\n";
+		report << ComparePerfMetrics(current, current, options.threshold, regressions);
+	}
+	else
+	{
+		report << "Compared with " << options.baselineFile.string() << "\n\n";
+		report << ComparePerfMetrics(baseline, current, options.threshold, regressions);
+	}
+	if (!report)
+	{
+		error = "Perf Gate: Error writing report " + options.reportFile.string();
+		return false;
+	}
+	return true;
+}
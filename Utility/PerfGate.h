@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Performance gate - repeated benchmark runs compared against a stored baseline
+//--------------------------------------------------------------------------------------
+// Runs the microbenchmarks and the fly-through benchmark (see MicroBenchmarks.h and FlyThrough.h) a number of times, each
+// run in a process of its own as they use the app's globals, and summarises every metric - frame time percentiles, CPU and
+// GPU time, video memory, startup time, the time of each CPU profiler scope and of each microbenchmark - as its mean with a
+// 95% confidence interval. These are compared with a baseline saved from an earlier build: a metric regresses when it is
+// worse by more than the threshold and Welch's t-test says the difference is unlikely to be noise (one-sided, 95%). The
+// report is plain text, a line per metric with regressions listed first, so a build can be gated on the exit code:
+//
+//   Boats.exe -perfgate [level.xml] [-runs 5] [-time 30] [-baseline PerfBaseline.json] [-out PerfReport.txt]
+//                       [-threshold 2] [-save-baseline]
+//
+// The baseline is JSON, a mean, standard deviation and run count per metric. With -save-baseline the runs replace it.
+// Every metric is lower-is-better. Runs are made one after another on an otherwise idle machine, as any other load on it
+// widens the intervals and hides small regressions
+
+#ifndef _PERF_GATE_H_INCLUDED_
+#define _PERF_GATE_H_INCLUDED_
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+
+// A metric over a number of runs
+struct MetricSummary
+{
+	double mean   = 0;
+	double stdDev = 0; // Sample standard deviation, 0 with fewer than two runs
+	int    runs   = 0;
+
+	// Half the width of the 95% confidence interval of the mean
+	double ConfidenceInterval() const;
+};
+
+// The metrics of a set of runs, by name
+using MetricSummaries = std::map<std::string, MetricSummary>;
+
+// Summarise the values of a metric from each run
+MetricSummary SummariseMetric(const std::vector<double>& values);
+
+// Read and write baselines, see the top of this file. Reading returns false with error set if the file can't be read or isn't
+// a baseline
+bool ReadPerfBaseline(const std::filesystem::path& file, MetricSummaries& metrics, std::string& error);
+bool WritePerfBaseline(const std::filesystem::path& file, const MetricSummaries& metrics);
+
+// Compare the current metrics with the baseline, returning the report. Sets regressions to the number of metrics that
+// regressed. A threshold of 0.02 ignores changes under 2%
+std::string ComparePerfMetrics(const MetricSummaries& baseline, const MetricSummaries& current, double threshold, int& regressions);
+
+
+struct PerfGateOptions
+{
+	std::string           levelFile  = "Entities.xml";
+	int                   runs       = 5;     // At least 2, for a standard deviation
+	float                 seconds    = 30.0f; // Length of each fly-through
+	double                threshold  = 0.02;  // Smallest change counted as a regression, a fraction of the baseline
+	std::filesystem::path baselineFile = "PerfBaseline.json";
+	std::filesystem::path reportFile   = "PerfReport.txt";
+	bool                  saveBaseline = false;
+};
+
+// Make the runs, compare them with the baseline and write the report (or save the runs as the baseline). Sets regressions
+// to the number of metrics that regressed. Returns false with error set if a run fails, the baseline can't be read or a file
+// can't be written. Run files are kept in a folder next to the report (<report>.runs)
+bool RunPerfGate(const PerfGateOptions& options, int& regressions, std::string& error);
+
+
+#endif //_PERF_GATE_H_INCLUDED_
@@ -0,0 +1,290 @@
+//--------------------------------------------------------------------------------------
+// Range coder - adaptive binary entropy coding into a byte buffer
+//--------------------------------------------------------------------------------------
+// Values are coded one bit at a time. Each bit is coded with a probability that adapts to the bits it has seen, so a bit
+// that is nearly always the same costs a small fraction of a bit in the output. The arithmetic is the binary range coder
+// used by LZMA: 32-bit range, 11-bit probabilities and a carry propagated through a cached byte.
+//
+// Larger values are built from bits with AdaptiveInteger, which suits values that are usually small, e.g. the error of a
+// prediction. Each kind of value should have its own models, so each learns its own distribution:
+//
+//   RangeEncoder encoder;
+//   AdaptiveInteger speedModel;
+//   speedModel.Encode(encoder, speedChange);
+//   encoder.Finish(); // encoder.Bytes() now holds the coded data
+//
+//   RangeDecoder decoder(bytes.data(), bytes.size());
+//   AdaptiveInteger speedModel; // Must start in the same state as the encoder's
+//   int32_t speedChange = speedModel.Decode(decoder);
+//
+// Everything is inline as it is called for every bit coded
+
+#ifndef _RANGE_CODER_H_INCLUDED_
+#define _RANGE_CODER_H_INCLUDED_
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+
+/*-----------------------------------------------------------------------------------------
+	Coders
+-----------------------------------------------------------------------------------------*/
+
+// Probability that a bit is 0, out of 1 << PROBABILITY_BITS. Moved 1/32 of the way towards each bit coded with it
+struct AdaptiveBit
+{
+	static constexpr uint32_t PROBABILITY_BITS = 11;
+	static constexpr uint32_t ADAPT_SHIFT      = 5;
+
+	uint16_t probability = (1 << PROBABILITY_BITS) / 2;
+};
+
+
+class RangeEncoder
+{
+public:
+	// Code a bit with the given probability, then adapt it
+	void Encode(AdaptiveBit& model, uint32_t bit)
+	{
+		uint32_t bound = (mRange >> AdaptiveBit::PROBABILITY_BITS) * model.probability;
+		if (bit == 0)
+		{
+			mRange = bound;
+			model.probability += ((1 << AdaptiveBit::PROBABILITY_BITS) - model.probability) >> AdaptiveBit::ADAPT_SHIFT;
+		}
+		else
+		{
+			mLow   += bound;
+			mRange -= bound;
+			model.probability -= model.probability >> AdaptiveBit::ADAPT_SHIFT;
+		}
+		Normalise();
+	}
+
+	// Code the low numBits bits of value, highest first, each as likely to be 0 as 1. For bits that don't follow a pattern
+	void EncodeDirect(uint32_t value, int numBits)
+	{
+		for (int bit = numBits - 1; bit >= 0; --bit)
+		{
+			mRange >>= 1;
+			if ((value >> bit) & 1)  mLow += mRange;
+			Normalise();
+		}
+	}
+
+	// Write out the last of the coded data. Nothing more can be coded until Reset
+	void Finish()
+	{
+		for (int i = 0; i < 5; ++i)  ShiftLow();
+	}
+
+	// Start again with an empty buffer, keeping its capacity
+	void Reset()
+	{
+		mBytes.clear();
+		mLow       = 0;
+		mRange     = 0xFFFFFFFF;
+		mCache     = 0;
+		mCacheSize = 1;
+	}
+
+	// Data coded so far, only complete after Finish
+	const std::vector<std::byte>& Bytes() const  { return mBytes; }
+
+private:
+	void Normalise()
+	{
+		while (mRange < TOP)
+		{
+			mRange <<= 8;
+			ShiftLow();
+		}
+	}
+
+	// Move the top byte of mLow to the output. A byte of 0xFF may still have a carry added to it, so those are held back in
+	// mCacheSize until a byte that can't overflow arrives
+	void ShiftLow()
+	{
+		if (static_cast<uint32_t>(mLow) < 0xFF000000 || (mLow >> 32) != 0)
+		{
+			uint8_t carry = static_cast<uint8_t>(mLow >> 32);
+			uint8_t byte  = mCache;
+			do
+			{
+				mBytes.push_back(static_cast<std::byte>(static_cast<uint8_t>(byte + carry)));
+				byte = 0xFF;
+			} while (--mCacheSize != 0);
+			mCache = static_cast<uint8_t>(mLow >> 24);
+		}
+		++mCacheSize;
+		mLow = (mLow & 0x00FFFFFF) << 8;
+	}
+
+	static constexpr uint32_t TOP = 1 << 24;
+
+	std::vector<std::byte> mBytes;
+	uint64_t mLow       = 0;
+	uint32_t mRange     = 0xFFFFFFFF;
+	uint8_t  mCache     = 0;
+	uint64_t mCacheSize = 1;
+};
+
+
+class RangeDecoder
+{
+public:
+	RangeDecoder() = default;
+
+	// Decode data from a RangeEncoder. The data must stay valid while decoding. Reading past the end gives zero bytes rather
+	// than failing, so damaged data decodes to wrong values but never reads outside the buffer
+	RangeDecoder(const std::byte* data, size_t size)
+		: mData(data), mSize(size)
+	{
+		for (int i = 0; i < 5; ++i)  mCode = (mCode << 8) | NextByte();
+	}
+
+	uint32_t Decode(AdaptiveBit& model)
+	{
+		uint32_t bound = (mRange >> AdaptiveBit::PROBABILITY_BITS) * model.probability;
+		uint32_t bit;
+		if (mCode < bound)
+		{
+			mRange = bound;
+			model.probability += ((1 << AdaptiveBit::PROBABILITY_BITS) - model.probability) >> AdaptiveBit::ADAPT_SHIFT;
+			bit = 0;
+		}
+		else
+		{
+			mCode  -= bound;
+			mRange -= bound;
+			model.probability -= model.probability >> AdaptiveBit::ADAPT_SHIFT;
+			bit = 1;
+		}
+		Normalise();
+		return bit;
+	}
+
+	uint32_t DecodeDirect(int numBits)
+	{
+		uint32_t value = 0;
+		for (int bit = 0; bit < numBits; ++bit)
+		{
+			mRange >>= 1;
+			uint32_t set = mCode >= mRange ? 1 : 0;
+			if (set)  mCode -= mRange;
+			value = (value << 1) | set;
+			Normalise();
+		}
+		return value;
+	}
+
+	// True if more bytes have been read than were coded, which only happens with damaged data
+	bool IsOverrun() const  { return mPosition > mSize + 4; }
+
+private:
+	void Normalise()
+	{
+		while (mRange < TOP)
+		{
+			mRange <<= 8;
+			mCode = (mCode << 8) | NextByte();
+		}
+	}
+
+	uint32_t NextByte()
+	{
+		uint32_t byte = mPosition < mSize ? static_cast<uint32_t>(mData[mPosition]) : 0;
+		++mPosition;
+		return byte;
+	}
+
+	static constexpr uint32_t TOP = 1 << 24;
+
+	const std::byte* mData = nullptr;
+	size_t   mSize     = 0;
+	size_t   mPosition = 0;
+	uint32_t mCode     = 0;
+	uint32_t mRange    = 0xFFFFFFFF;
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Models
+-----------------------------------------------------------------------------------------*/
+
+// Signed integers that are usually near zero. Coded as: is it zero, its sign, the number of bits in its size (one adaptive
+// bit for each, so the usual sizes are cheap), the bit after the leading 1 (adaptive, per size), then the remaining bits
+// directly. Zero costs a fraction of a bit once it is common
+struct AdaptiveInteger
+{
+	void Encode(RangeEncoder& encoder, int32_t value)
+	{
+		encoder.Encode(isZero, value == 0 ? 1 : 0);
+		if (value == 0)  return;
+		encoder.Encode(isNegative, value < 0 ? 1 : 0);
+
+		// Size of the magnitude, 0 - 31 for 1 to 32 bits, in unary
+		uint32_t magnitude = value < 0 ? 0u - static_cast<uint32_t>(value) : static_cast<uint32_t>(value);
+		int size = 0;
+		while (size < 31 && (magnitude >> (size + 1)) != 0)  ++size;
+		for (int i = 0; i < size; ++i)  encoder.Encode(sizes[i], 1);
+		if (size < 31)  encoder.Encode(sizes[size], 0);
+
+		if (size == 0)  return;
+		encoder.Encode(secondBits[size], (magnitude >> (size - 1)) & 1);
+		encoder.EncodeDirect(magnitude, size - 1);
+	}
+
+	int32_t Decode(RangeDecoder& decoder)
+	{
+		if (decoder.Decode(isZero))  return 0;
+		bool negative = decoder.Decode(isNegative) != 0;
+
+		int size = 0;
+		while (size < 31 && decoder.Decode(sizes[size]))  ++size;
+
+		uint32_t magnitude = 1;
+		if (size > 0)
+		{
+			magnitude = (magnitude << 1) | decoder.Decode(secondBits[size]);
+			magnitude = (magnitude << (size - 1)) | decoder.DecodeDirect(size - 1);
+		}
+		return negative ? static_cast<int32_t>(0u - magnitude) : static_cast<int32_t>(magnitude);
+	}
+
+	AdaptiveBit isZero;
+	AdaptiveBit isNegative;
+	AdaptiveBit sizes[32];
+	AdaptiveBit secondBits[32];
+};
+
+
+// Symbols of a fixed number of bits, e.g. bytes of text, coded highest bit first with an adaptive bit for every prefix, so
+// the frequency of each symbol is learnt
+template <int NUM_BITS>
+struct AdaptiveSymbol
+{
+	void Encode(RangeEncoder& encoder, uint32_t symbol)
+	{
+		uint32_t node = 1;
+		for (int bit = NUM_BITS - 1; bit >= 0; --bit)
+		{
+			uint32_t value = (symbol >> bit) & 1;
+			encoder.Encode(nodes[node], value);
+			node = (node << 1) | value;
+		}
+	}
+
+	uint32_t Decode(RangeDecoder& decoder)
+	{
+		uint32_t node = 1;
+		for (int bit = 0; bit < NUM_BITS; ++bit)  node = (node << 1) | decoder.Decode(nodes[node]);
+		return node - (1 << NUM_BITS);
+	}
+
+	AdaptiveBit nodes[1 << NUM_BITS];
+};
+
+
+#endif //_RANGE_CODER_H_INCLUDED_
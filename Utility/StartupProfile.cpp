@@ -0,0 +1,168 @@
+//--------------------------------------------------------------------------------------
+// StartupProfile class - times the parts of startup and reports them as a tree
+//--------------------------------------------------------------------------------------
+
+#include "StartupProfile.h"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+
+
+// The startup profile all startup code records to
+StartupProfile gStartupProfile;
+
+// Scopes open on the calling thread, innermost last
+static thread_local std::vector<uint32_t> tOpenScopes;
+
+
+/*-----------------------------------------------------------------------------------------
+	Recording
+-----------------------------------------------------------------------------------------*/
+
+// Start a scope, returns its index for End, or NO_SCOPE once recording has finished
+uint32_t StartupProfile::Begin(const std::string& name)
+{
+	if (!mRecording)  return NO_SCOPE;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mRecording)  return NO_SCOPE;
+	if (mScopes.empty())
+	{
+		mStart      = Clock::now();
+		mMainThread = std::this_thread::get_id();
+	}
+
+	Scope scope;
+	scope.name   = name;
+	scope.parent = CurrentScope();
+	scope.depth  = (scope.parent == NO_SCOPE) ? 0 : mScopes[scope.parent].depth + 1;
+	scope.start  = Now();
+
+	auto index = static_cast<uint32_t>(mScopes.size());
+	mScopes.push_back(std::move(scope));
+	tOpenScopes.push_back(index);
+	if (std::this_thread::get_id() == mMainThread)  mMainScope = index;
+	return index;
+}
+
+void StartupProfile::End(uint32_t scope)
+{
+	if (scope == NO_SCOPE)  return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!tOpenScopes.empty() && tOpenScopes.back() == scope)  tOpenScopes.pop_back();
+	if (!mRecording)  return; // Already ended by Finish
+
+	mScopes[scope].seconds = Now() - mScopes[scope].start;
+	mScopes[scope].open    = false;
+	if (std::this_thread::get_id() == mMainThread)  mMainScope = tOpenScopes.empty() ? NO_SCOPE : tOpenScopes.back();
+}
+
+
+// Count bytes against the innermost open scope of the calling thread
+void StartupProfile::AddBytesRead(uint64_t bytes)
+{
+	if (!mRecording)  return;
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto scope = CurrentScope();
+	if (mRecording && scope != NO_SCOPE)  mScopes[scope].bytesRead += bytes;
+}
+
+void StartupProfile::AddBytesUploaded(uint64_t bytes)
+{
+	if (!mRecording)  return;
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto scope = CurrentScope();
+	if (mRecording && scope != NO_SCOPE)  mScopes[scope].bytesUploaded += bytes;
+}
+
+
+// Stop recording, ending any open scopes, and total up the scopes for the report
+void StartupProfile::Finish()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mRecording)  return;
+	mRecording = false;
+
+	double now = Now();
+	for (auto& scope : mScopes)
+	{
+		if (scope.open)  scope.seconds = now - scope.start;
+		scope.open = false;
+	}
+
+	// Parents are always before their children, so going backwards adds each scope to its parent after its own children
+	// have been added to it
+	for (size_t i = mScopes.size(); i-- > 0; )
+	{
+		auto& scope = mScopes[i];
+		if (scope.parent == NO_SCOPE)  continue;
+		mScopes[scope.parent].bytesRead     += scope.bytesRead;
+		mScopes[scope.parent].bytesUploaded += scope.bytesUploaded;
+	}
+	for (uint32_t i = 0; i < mScopes.size(); ++i)
+	{
+		if (mScopes[i].parent == NO_SCOPE)  mRoots.push_back(i);
+		else                                mScopes[mScopes[i].parent].children.push_back(i);
+	}
+}
+
+
+// Innermost open scope of the calling thread, scopes on other threads fall back to that of the main thread
+uint32_t StartupProfile::CurrentScope()
+{
+	return tOpenScopes.empty() ? mMainScope : tOpenScopes.back();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Report
+-----------------------------------------------------------------------------------------*/
+
+// The report as indented text, one line per scope, each followed by its children
+std::string StartupProfile::Report()
+{
+	double total = 0;
+	for (auto root : mRoots)  total = std::max(total, mScopes[root].start + mScopes[root].seconds);
+
+	char line[256];
+	snprintf(line, sizeof(line), "Startup took %.2fs\n\n%10s %12s %12s\n", total, "ms", "MB read", "MB uploaded");
+	std::string report = line;
+	std::function<void(uint32_t)> addScope = [&](uint32_t index)
+	{
+		auto& scope = mScopes[index];
+		snprintf(line, sizeof(line), "%10.1f %12.2f %12.2f  %*s", scope.seconds * 1000.0, scope.bytesRead / (1024.0 * 1024.0),
+		         scope.bytesUploaded / (1024.0 * 1024.0), static_cast<int>(scope.depth * 2), "");
+		report += line + scope.name + "\n";
+		for (auto child : scope.children)  addScope(child);
+	};
+	for (auto root : mRoots)  addScope(root);
+	return report;
+}
+
+// Write the report to the given file, returns false if it can't be written
+bool StartupProfile::WriteReport(const std::filesystem::path& file)
+{
+	std::ofstream stream(file, std::ios::trunc);
+	stream << Report();
+	return static_cast<bool>(stream);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	StartupTimer
+-----------------------------------------------------------------------------------------*/
+
+StartupTimer::StartupTimer(const std::string& name)
+	: mScope(gStartupProfile.Begin(name))
+{
+	gEventTrace.LoadBegin(mTraceActivity, name);
+}
+
+StartupTimer::~StartupTimer()
+{
+	gEventTrace.LoadEnd(mTraceActivity);
+	gStartupProfile.End(mScope);
+}
@@ -0,0 +1,133 @@
+//--------------------------------------------------------------------------------------
+// StartupProfile class - times the parts of startup and reports them as a tree
+//--------------------------------------------------------------------------------------
+// Code that takes part in startup (device creation, level loading, mesh import, texture and shader loading) puts a
+// StartupTimer at the top of the work it does. Timers started while another is running on the same thread become its
+// children, timers on worker threads (e.g. templates loaded in parallel) become children of the timer running on the main
+// thread, so their times overlap each other and can add up to more than their parent's:
+//
+//   StartupTimer timer("Mesh " + fileName);  // Times the rest of the scope
+//   ...
+//   gStartupProfile.AddBytesRead(size);      // Counted against the innermost timer on this thread
+//
+// Once the game is ready Finish stops recording, so later loading (streaming, templates loaded when needed) isn't timed,
+// and the report is written to a file and shown in the control panel. Bytes and times in the report include children
+
+#ifndef _STARTUP_PROFILE_H_INCLUDED_
+#define _STARTUP_PROFILE_H_INCLUDED_
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdint.h>
+
+#include "EventTrace.h"
+
+
+class StartupProfile
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// A timed part of startup
+	struct Scope
+	{
+		std::string name;
+		uint32_t parent        = NO_SCOPE;
+		uint32_t depth         = 0;
+		double   start         = 0; // Seconds from the first scope
+		double   seconds       = 0;
+		uint64_t bytesRead     = 0; // Through gAssetFiles, or by assimp
+		uint64_t bytesUploaded = 0; // Sent to the GPU in textures and geometry
+		bool     open          = true;
+		std::vector<uint32_t> children; // Filled in by Finish
+	};
+
+	static const uint32_t NO_SCOPE = UINT32_MAX;
+
+
+	/*-----------------------------------------------------------------------------------------
+		Recording
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Start a scope, returns its index for End, or NO_SCOPE once recording has finished. Usually called by StartupTimer
+	uint32_t Begin(const std::string& name);
+	void End(uint32_t scope);
+
+	// Count bytes against the innermost open scope of the calling thread
+	void AddBytesRead(uint64_t bytes);
+	void AddBytesUploaded(uint64_t bytes);
+
+	// Stop recording, ending any open scopes, and total up the scopes for the report
+	void Finish();
+
+	bool Recording()  { return mRecording; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Report
+	-----------------------------------------------------------------------------------------*/
+public:
+	// The scopes in the order they started, a scope's parent is always before it. Only call after Finish
+	const std::vector<Scope>& Scopes()  { return mScopes; }
+
+	// Top-level scopes, only call after Finish
+	const std::vector<uint32_t>& Roots()  { return mRoots; }
+
+	// The report as indented text, one line per scope. Only call after Finish
+	std::string Report();
+
+	// Write the report to the given file, returns false if it can't be written
+	bool WriteReport(const std::filesystem::path& file);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private helpers / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	using Clock = std::chrono::steady_clock;
+
+	double Now()  { return std::chrono::duration<double>(Clock::now() - mStart).count(); }
+
+	// Innermost open scope of the calling thread, scopes on other threads fall back to that of the main thread.
+	// Call with mMutex held
+	uint32_t CurrentScope();
+
+	std::vector<Scope>    mScopes;
+	std::vector<uint32_t> mRoots;
+	std::mutex            mMutex;
+	std::atomic<bool>     mRecording = true;
+
+	// Times are from the first scope, which is started on the main thread
+	Clock::time_point mStart;
+	std::thread::id   mMainThread;
+	uint32_t          mMainScope = NO_SCOPE;
+};
+
+
+// Times the rest of the scope it is declared in as part of startup
+class StartupTimer
+{
+public:
+	explicit StartupTimer(const std::string& name);
+	~StartupTimer();
+
+	StartupTimer(const StartupTimer&) = delete;
+	StartupTimer& operator=(const StartupTimer&) = delete;
+
+private:
+	uint32_t           mScope;
+	EventTraceActivity mTraceActivity; // The load's events in an ETW trace, see EventTrace.h
+};
+
+
+// The startup profile all startup code records to
+extern StartupProfile gStartupProfile;
+
+
+#endif // _STARTUP_PROFILE_H_INCLUDED_
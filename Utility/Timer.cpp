@@ -1,10 +1,18 @@
 //--------------------------------------------------------------------------------------
-// Timer class - works like a stopwatch
+// Timer class - works like a stopwatch, and timing statistics built on it
 //--------------------------------------------------------------------------------------
 // Uses new std::chrono classes
 
 #include "Timer.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+
+TimingStats gTimingStats;
+
 
 /*-----------------------------------------------------------------------------------------
 	Constructor
@@ -73,3 +81,138 @@ float Timer::GetLapTime()
 	mLap = lastRunningTime;
 	return timePassed.count();
 }
+
+// Get time passed (nanoseconds) since since timer was started or last reset
+int64_t Timer::GetTimeNanoseconds()
+{
+	Clock::time_point lastRunningTime = mRunning ? mClock.now() : mStop;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(lastRunningTime - mStart).count();
+}
+
+// Get time passed (nanoseconds) since the last lap, see GetLapTime
+int64_t Timer::GetLapNanoseconds()
+{
+	Clock::time_point lastRunningTime = mRunning ? mClock.now() : mStop;
+	int64_t timePassed = std::chrono::duration_cast<std::chrono::nanoseconds>(lastRunningTime - mLap).count();
+	mLap = lastRunningTime;
+	return timePassed;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	RollingStats
+-----------------------------------------------------------------------------------------*/
+
+// Add a sample, forgetting the oldest if the window is full
+void RollingStats::Add(int64_t value)
+{
+	value = std::max<int64_t>(value, 0);
+	if (mCount == WINDOW_SIZE)
+	{
+		int64_t oldest = mSamples[mNext];
+		mSum -= oldest;
+		--mHistogram[Bucket(oldest)];
+	}
+	else
+	{
+		++mCount;
+	}
+	mSamples[mNext] = value;
+	mSum += value;
+	++mHistogram[Bucket(value)];
+	mNext = (mNext + 1) % WINDOW_SIZE;
+}
+
+// Forget every sample
+void RollingStats::Clear()
+{
+	mHistogram = {};
+	mNext = mCount = 0;
+	mSum = 0;
+}
+
+// Smallest and largest samples kept. The window is searched, these are for display so are called far less than Add
+int64_t RollingStats::Min() const
+{
+	int64_t minimum = mCount > 0 ? INT64_MAX : 0;
+	ForEachSample([&](int64_t value) { minimum = std::min(minimum, value); });
+	return minimum;
+}
+
+int64_t RollingStats::Max() const
+{
+	int64_t maximum = 0;
+	ForEachSample([&](int64_t value) { maximum = std::max(maximum, value); });
+	return maximum;
+}
+
+// The value that the given fraction of the samples are no greater than, the middle of its histogram bucket kept within the
+// smallest and largest samples
+int64_t RollingStats::Percentile(double fraction) const
+{
+	if (mCount == 0)  return 0;
+	int rank = std::clamp(static_cast<int>(std::ceil(fraction * mCount)), 1, mCount);
+	int seen = 0;
+	for (int bucket = 0; bucket < NUM_BUCKETS; ++bucket)
+	{
+		seen += mHistogram[bucket];
+		if (seen >= rank)  return std::clamp(BucketMiddle(bucket), Min(), Max());
+	}
+	return Max();
+}
+
+// Histogram bucket of a value. Values below SUB_BUCKETS have a bucket each, above that each power of two is split into
+// SUB_BUCKETS buckets by the bits below the top one
+int RollingStats::Bucket(int64_t value)
+{
+	if (value < SUB_BUCKETS)  return static_cast<int>(value);
+	int topBit = std::bit_width(static_cast<uint64_t>(value)) - 1; // At least SUB_BUCKET_BITS
+	int shift  = topBit - SUB_BUCKET_BITS;
+	int sub    = static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+	return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+// The value in the middle of a histogram bucket
+int64_t RollingStats::BucketMiddle(int bucket)
+{
+	if (bucket < SUB_BUCKETS)  return bucket;
+	int shift = bucket / SUB_BUCKETS - 1;
+	int64_t lowest = static_cast<int64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return lowest + ((int64_t(1) << shift) >> 1);
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	TimingStats
+-----------------------------------------------------------------------------------------*/
+
+// The index of the slot with the given name, adding it if it is new. The same literal can have a different address in each
+// file it is used in, so names are compared by text
+int TimingStats::Slot(const char* name)
+{
+	std::lock_guard<std::mutex> lock(mSlotsMutex);
+	int numSlots = mNumSlots.load(std::memory_order_relaxed);
+	for (int slot = 0; slot < numSlots; ++slot)
+	{
+		if (std::strcmp(mSlots[slot].name, name) == 0)  return slot;
+	}
+	if (numSlots == MAX_SLOTS)  return -1;
+
+	mSlots[numSlots].name = name;
+	mNumSlots.store(numSlots + 1, std::memory_order_release);
+	return numSlots;
+}
+
+// Add each slot's total for the frame to its rolling stats
+void TimingStats::NextFrame()
+{
+	int numSlots = NumSlots();
+	for (int slot = 0; slot < numSlots; ++slot)
+	{
+		TimingSlot& timing = mSlots[slot];
+		int64_t  nanoseconds = timing.frameNanoseconds.exchange(0, std::memory_order_relaxed);
+		uint32_t calls       = timing.frameCalls.exchange(0, std::memory_order_relaxed);
+		timing.lastFrameCalls = calls;
+		if (calls > 0)  timing.stats.Add(nanoseconds);
+	}
+}
@@ -1,12 +1,27 @@
 //--------------------------------------------------------------------------------------
-// Timer class - works like a stopwatch
+// Timer class - works like a stopwatch, and timing statistics built on it
 //--------------------------------------------------------------------------------------
-// Uses new std::chrono classes
+// Uses new std::chrono classes. Times can be read as float seconds or as int64 nanoseconds, which keep their precision
+// however long the timer has been running.
+//
+// RollingStats keeps the most recent samples of a measurement (e.g. frame times) for their minimum, average and maximum,
+// with a histogram of them for percentiles. TimingStats has named slots that ScopedTimers (usually placed with TIMING_SCOPE)
+// add their time to. Once a frame NextFrame adds each slot's total for the frame to its rolling stats. A scoped timer costs
+// two clock reads and two atomic adds, so they are cheap enough to leave in release builds
+//
+//   void Scene::Update(float frameTime)
+//   {
+//       TIMING_SCOPE("Update");
+//       ...
 
 #ifndef _TIMER_H_INCLUDED_
 #define _TIMER_H_INCLUDED_
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <mutex>
+#include <stdint.h>
 
 class Timer
 {
@@ -43,6 +58,13 @@ public:
 	// the time since timer was started or the last reset is returned
 	float GetLapTime();
 
+	// As GetTime and GetLapTime, in nanoseconds. A lap is shared with GetLapTime, each call of either starts the next lap
+	int64_t GetTimeNanoseconds();
+	int64_t GetLapNanoseconds();
+
+	// Nanoseconds on the clock timers use, for measuring intervals without a timer (see ScopedTimer)
+	static int64_t Now()  { return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count(); }
+
 
 	/*-----------------------------------------------------------------------------------------
 		Private member data
@@ -59,4 +81,140 @@ private:
 };
 
 
+// The most recent samples of a measurement, with their minimum, average, maximum and percentiles
+class RollingStats
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+
+	// Number of samples kept, older ones are forgotten
+	static constexpr int WINDOW_SIZE = 256;
+
+	// Add a sample, values must not be negative
+	void Add(int64_t value);
+
+	// Forget every sample
+	void Clear();
+
+	// Statistics of the samples kept, 0 if there are none
+	int     Count() const  { return mCount; }
+	int64_t Min() const;
+	int64_t Max() const;
+	double  Average() const  { return mCount > 0 ? static_cast<double>(mSum) / mCount : 0.0; }
+
+	// The value that the given fraction of the samples (e.g. 0.99) are no greater than. Found from the histogram, so within
+	// 1/16th of the true value
+	int64_t Percentile(double fraction) const;
+
+	// The most recent sample, and the samples kept oldest first (for graphs)
+	int64_t Latest() const  { return mCount > 0 ? mSamples[(mNext + WINDOW_SIZE - 1) % WINDOW_SIZE] : 0; }
+	template <typename F> void ForEachSample(F function) const
+	{
+		for (int i = 0; i < mCount; ++i)  function(mSamples[(mNext + WINDOW_SIZE - mCount + i) % WINDOW_SIZE]);
+	}
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private functions / data
+	-----------------------------------------------------------------------------------------*/
+private:
+	// The histogram has 16 buckets for every power of two (exactly one per value below 16), so a bucket's width is at most
+	// 1/16th of the values in it. Counts are updated as samples arrive and are forgotten, so percentiles need no sorting
+	static constexpr int SUB_BUCKET_BITS = 4;
+	static constexpr int SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+	static constexpr int NUM_BUCKETS     = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+	static int     Bucket(int64_t value);
+	static int64_t BucketMiddle(int bucket);
+
+	std::array<int64_t, WINDOW_SIZE>  mSamples   = {};
+	std::array<uint16_t, NUM_BUCKETS> mHistogram = {};
+	int     mNext  = 0; // Where the next sample goes
+	int     mCount = 0;
+	int64_t mSum   = 0;
+};
+
+
+// Named slots of time, each totalled over a frame then kept in rolling stats
+class TimingStats
+{
+public:
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+
+	static constexpr int MAX_SLOTS = 64;
+
+	// The index of the slot with the given name (a string literal, only the pointer is kept), adding it if it is new.
+	// Returns -1 once MAX_SLOTS have been added. Usually called once per scope by TIMING_SCOPE
+	int Slot(const char* name);
+
+	// Add nanoseconds to a slot's total for this frame, on any thread
+	void Add(int slot, int64_t nanoseconds)
+	{
+		if (slot < 0)  return;
+		mSlots[slot].frameNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+		mSlots[slot].frameCalls.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Add each slot's total for the frame to its rolling stats, call once a frame on the main thread. Slots not used in the
+	// frame get no sample, so a slot only timed now and then isn't swamped by zeros
+	void NextFrame();
+
+	// The slots so far, in the order they were added, and the nanoseconds per frame of each
+	int                 NumSlots()                { return mNumSlots.load(std::memory_order_acquire); }
+	const char*         Name(int slot)            { return mSlots[slot].name; }
+	const RollingStats& Stats(int slot)           { return mSlots[slot].stats; }
+	uint32_t            LastFrameCalls(int slot)  { return mSlots[slot].lastFrameCalls; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	struct TimingSlot
+	{
+		const char*           name = nullptr;
+		std::atomic<int64_t>  frameNanoseconds = 0;
+		std::atomic<uint32_t> frameCalls       = 0;
+		uint32_t              lastFrameCalls   = 0;
+		RollingStats          stats;
+	};
+
+	// Slots are only added to, under the mutex. The count is read without it so is set after the slot's name
+	std::mutex                        mSlotsMutex;
+	std::array<TimingSlot, MAX_SLOTS> mSlots;
+	std::atomic<int>                  mNumSlots = 0;
+};
+
+
+// The timing stats TIMING_SCOPE adds to
+extern TimingStats gTimingStats;
+
+
+// Adds the time of the rest of the scope it is declared in to a timing slot, see TIMING_SCOPE
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(int slot) : mSlot(slot), mStart(Timer::Now()) {}
+	~ScopedTimer()  { gTimingStats.Add(mSlot, Timer::Now() - mStart); }
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	int     mSlot;
+	int64_t mStart;
+};
+
+
+// Add the time of the rest of the enclosing scope to the timing slot of the given name, which must be a string literal
+#define TIMING_SCOPE_JOIN2(a, b)  a##b
+#define TIMING_SCOPE_JOIN(a, b)   TIMING_SCOPE_JOIN2(a, b)
+#define TIMING_SCOPE(name) \
+	static const int TIMING_SCOPE_JOIN(timingSlot, __LINE__) = gTimingStats.Slot(name); \
+	ScopedTimer TIMING_SCOPE_JOIN(scopedTimer, __LINE__)(TIMING_SCOPE_JOIN(timingSlot, __LINE__))
+
+
 #endif //_TIMER_H_INCLUDED_
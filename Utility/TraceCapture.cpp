@@ -0,0 +1,126 @@
+//--------------------------------------------------------------------------------------
+// TraceCapture class - keeps the last few seconds of profiled frames to save for offline analysis
+//--------------------------------------------------------------------------------------
+
+#include "TraceCapture.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <string_view>
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Add a frame to the capture, dropping those that have become too old. A frame already added is ignored
+void TraceCapture::AddFrame(const CpuProfiler::Frame& cpu, std::vector<Counter> counters)
+{
+	if (cpu.end <= mLastFrameEnd)  return;
+	mLastFrameEnd = cpu.end;
+	mFrames.push_back({ cpu, std::move(counters) });
+
+	while (mFrames.size() > 1 && CpuProfiler::TicksToMilliseconds(cpu.end - mFrames.front().cpu.end) > mSeconds * 1000.0)
+	{
+		mFrames.pop_front();
+	}
+}
+
+
+// Move the frames out of the capture, which carries on collecting from empty
+std::unique_ptr<TraceCapture::Trace> TraceCapture::Take()
+{
+	auto trace = std::make_unique<Trace>();
+	trace->frames.swap(mFrames);
+	return trace;
+}
+
+
+// Seconds from the start of the oldest frame to the end of the newest
+double TraceCapture::SecondsHeld()
+{
+	if (mFrames.empty())  return 0.0;
+	return CpuProfiler::TicksToMilliseconds(mFrames.back().cpu.end - mFrames.front().cpu.start) / 1000.0;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Trace
+-----------------------------------------------------------------------------------------*/
+
+// Write the frames as a Chrome Trace Event JSON file: thread names, a complete event for each frame and scope, and a counter
+// event for each group of counters in each frame. Times are microseconds from the start of the first frame
+bool TraceCapture::Trace::WriteJson(const std::string& fileName) const
+{
+	std::ofstream file(fileName);
+	if (!file)  return false;
+	file << std::fixed << std::setprecision(3);
+
+	// Names are written as JSON strings, only quotes, backslashes and control characters need escaping
+	auto writeString = [&](const std::string_view text)
+	{
+		file << '"';
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')  file << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)  file << ' ';
+			else  file << c;
+		}
+		file << '"';
+	};
+
+	// The frames go on a track of their own after the threads
+	uint32_t numThreads = 0;
+	for (const Frame& frame : frames)  numThreads = std::max(numThreads, frame.cpu.numThreads);
+	const uint32_t FRAME_TRACK = numThreads;
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (uint32_t thread = 0; thread < numThreads; ++thread)
+	{
+		file << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"name\":\"thread_name\",\"args\":{\"name\":\"Thread " << thread << "\"}},\n";
+	}
+	file << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << FRAME_TRACK << ",\"name\":\"thread_name\",\"args\":{\"name\":\"Frames\"}}";
+
+	int64_t base = frames.empty() ? 0 : frames.front().cpu.start;
+	auto microseconds = [&](int64_t ticks) { return CpuProfiler::TicksToMilliseconds(ticks - base) * 1000.0; };
+	auto duration     = [&](int64_t start, int64_t end) { return CpuProfiler::TicksToMilliseconds(end - start) * 1000.0; };
+
+	size_t frameNumber = 0;
+	for (const Frame& frame : frames)
+	{
+		file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << FRAME_TRACK << ",\"name\":\"Frame\",\"ts\":" << microseconds(frame.cpu.start)
+		     << ",\"dur\":" << duration(frame.cpu.start, frame.cpu.end) << ",\"args\":{\"frame\":" << frameNumber++
+		     << ",\"dropped\":" << frame.cpu.dropped << "}}";
+
+		for (const CpuProfiler::Event& event : frame.cpu.events)
+		{
+			file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"name\":";
+			writeString(event.name);
+			file << ",\"ts\":" << microseconds(event.start) << ",\"dur\":" << duration(event.start, event.end) << '}';
+		}
+
+		// One event for each group, with a value for each of its names. Counters of a group are usually next to each other
+		std::vector<bool> written(frame.counters.size(), false);
+		for (size_t i = 0; i < frame.counters.size(); ++i)
+		{
+			if (written[i])  continue;
+			file << ",\n{\"ph\":\"C\",\"pid\":1,\"name\":";
+			writeString(frame.counters[i].group);
+			file << ",\"ts\":" << microseconds(frame.cpu.end) << ",\"args\":{";
+			const char* separator = "";
+			for (size_t j = i; j < frame.counters.size(); ++j)
+			{
+				if (written[j] || frame.counters[j].group != frame.counters[i].group)  continue;
+				written[j] = true;
+				file << separator;
+				writeString(frame.counters[j].name);
+				file << ':' << frame.counters[j].value;
+				separator = ",";
+			}
+			file << "}}";
+		}
+	}
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,89 @@
+//--------------------------------------------------------------------------------------
+// TraceCapture class - keeps the last few seconds of profiled frames to save for offline analysis
+//--------------------------------------------------------------------------------------
+// Each frame the CPU profiler's last frame (see CpuProfiler.h) is added along with counters for anything else worth seeing
+// over time: GPU times, memory use, message traffic. Frames older than the capture length are dropped, so the capture always
+// holds the most recent few seconds and can be saved at any moment, e.g. just after a frame that went over its budget.
+//
+// Taking the capture moves the frames out into a Trace and starts the capture afresh. A Trace writes a Chrome Trace Event
+// JSON file, which chrome://tracing and the Perfetto UI (ui.perfetto.dev) open directly: a track per thread with its scopes
+// nested, a track of frames, and a graph for each group of counters. The capture is only used by the main thread, a Trace it
+// has given out may be written on any thread
+//
+//   capture.AddFrame(gCpuProfiler.LastFrame(), { { "Memory MB", "Textures", textureMB } });
+//   ...
+//   auto trace = capture.Take();
+//   std::async(std::launch::async, [trace = std::move(trace)] { return trace->WriteJson("Trace.json"); });
+
+#ifndef _TRACE_CAPTURE_H_INCLUDED_
+#define _TRACE_CAPTURE_H_INCLUDED_
+
+#include "CpuProfiler.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+class TraceCapture
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// A value for a frame. Counters with the same group are drawn on the same graph, one line for each name
+	struct Counter
+	{
+		std::string group;
+		std::string name;
+		double      value;
+	};
+
+	struct Frame
+	{
+		CpuProfiler::Frame   cpu;
+		std::vector<Counter> counters;
+	};
+
+	// Frames taken from a capture, oldest first
+	class Trace
+	{
+	public:
+		// Write the frames as a Chrome Trace Event JSON file. Returns false if the file can't be written
+		bool WriteJson(const std::string& fileName) const;
+
+		std::deque<Frame> frames;
+	};
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Seconds of the most recent frames kept
+	float& Seconds()  { return mSeconds; }
+
+	// Add a frame to the capture, dropping those that have become too old. A frame already added (e.g. the CPU profiler's
+	// last frame while it is frozen) is ignored
+	void AddFrame(const CpuProfiler::Frame& cpu, std::vector<Counter> counters);
+
+	// Move the frames out of the capture, which carries on collecting from empty
+	std::unique_ptr<Trace> Take();
+
+	// Frames in the capture, and the seconds from the start of the oldest to the end of the newest
+	size_t NumFrames()    { return mFrames.size(); }
+	double SecondsHeld();
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	float             mSeconds = 10.0f;
+	std::deque<Frame> mFrames;
+	int64_t           mLastFrameEnd = 0; // End of the last frame added, even if it has since been taken
+};
+
+
+#endif //_TRACE_CAPTURE_H_INCLUDED_
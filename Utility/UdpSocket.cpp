@@ -0,0 +1,149 @@
+//--------------------------------------------------------------------------------------
+// UDP socket - non-blocking datagrams over Winsock
+//--------------------------------------------------------------------------------------
+
+// Winsock 2 must be included before anything includes windows.h
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "UdpSocket.h"
+
+
+/*-----------------------------------------------------------------------------------------
+	Types
+-----------------------------------------------------------------------------------------*/
+
+std::string UdpSocket::Address::ToString() const
+{
+	return std::to_string(ip >> 24) + "." + std::to_string((ip >> 16) & 0xFF) + "." + std::to_string((ip >> 8) & 0xFF) + "." +
+	       std::to_string(ip & 0xFF) + ":" + std::to_string(port);
+}
+
+
+// Find the IPv4 address of a host name or dotted address. Returns false if it can't be found
+bool UdpSocket::Resolve(const std::string& host, uint16_t port, Address& address)
+{
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)  return false;
+
+	addrinfo hints = {};
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* found = nullptr;
+	bool resolved = getaddrinfo(host.c_str(), nullptr, &hints, &found) == 0 && found != nullptr;
+	if (resolved)
+	{
+		address.ip   = ntohl(reinterpret_cast<sockaddr_in*>(found->ai_addr)->sin_addr.s_addr);
+		address.port = port;
+	}
+	if (found != nullptr)  freeaddrinfo(found);
+	WSACleanup();
+	return resolved;
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Construction
+-----------------------------------------------------------------------------------------*/
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+
+// Open a non-blocking socket on the given local port, 0 for any free port. Returns false on failure
+bool UdpSocket::Open(uint16_t port /*= 0*/)
+{
+	Close();
+
+	WSADATA wsaData;
+	int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	if (result != 0)
+	{
+		mLastError = "Can't start Winsock (error " + std::to_string(result) + ")";
+		return false;
+	}
+
+	SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == INVALID_SOCKET)
+	{
+		mLastError = "Can't create a socket (error " + std::to_string(WSAGetLastError()) + ")";
+		WSACleanup();
+		return false;
+	}
+
+	sockaddr_in local = {};
+	local.sin_family      = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port        = htons(port);
+	u_long nonBlocking = 1;
+	if (bind(s, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == SOCKET_ERROR ||
+	    ioctlsocket(s, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+	{
+		mLastError = "Can't open UDP port " + std::to_string(port) + " (error " + std::to_string(WSAGetLastError()) + ")";
+		closesocket(s);
+		WSACleanup();
+		return false;
+	}
+
+	mSocket = static_cast<uintptr_t>(s);
+	mLastError.clear();
+	return true;
+}
+
+
+void UdpSocket::Close()
+{
+	if (mSocket == INVALID)  return;
+	closesocket(static_cast<SOCKET>(mSocket));
+	mSocket = INVALID;
+	WSACleanup();
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Usage
+-----------------------------------------------------------------------------------------*/
+
+// Send a datagram. Returns false if it couldn't be sent
+bool UdpSocket::Send(const Address& to, const void* data, size_t size)
+{
+	if (mSocket == INVALID)  return false;
+
+	sockaddr_in remote = {};
+	remote.sin_family      = AF_INET;
+	remote.sin_addr.s_addr = htonl(to.ip);
+	remote.sin_port        = htons(to.port);
+	int sent = sendto(static_cast<SOCKET>(mSocket), static_cast<const char*>(data), static_cast<int>(size), 0,
+	                  reinterpret_cast<sockaddr*>(&remote), sizeof(remote));
+	return sent == static_cast<int>(size);
+}
+
+
+// Receive the next datagram waiting, with the address it came from. Returns its size, or 0 if there are none waiting
+size_t UdpSocket::Receive(Address& from, void* buffer, size_t size)
+{
+	if (mSocket == INVALID)  return 0;
+
+	while (true)
+	{
+		sockaddr_in remote = {};
+		int remoteSize = sizeof(remote);
+		int received = recvfrom(static_cast<SOCKET>(mSocket), static_cast<char*>(buffer), static_cast<int>(size), 0,
+		                        reinterpret_cast<sockaddr*>(&remote), &remoteSize);
+		if (received > 0)
+		{
+			from.ip   = ntohl(remote.sin_addr.s_addr);
+			from.port = ntohs(remote.sin_port);
+			return static_cast<size_t>(received);
+		}
+
+		// Windows reports an earlier send that got "port unreachable" back as an error on the next receive, and a datagram
+		// too large for the buffer is an error too. Both are skipped, anything else means nothing is waiting
+		int error = received == 0 ? 0 : WSAGetLastError();
+		if (received == 0 || error == WSAECONNRESET || error == WSAEMSGSIZE)  continue;
+		return 0;
+	}
+}
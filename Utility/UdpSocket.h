@@ -0,0 +1,91 @@
+//--------------------------------------------------------------------------------------
+// UDP socket - non-blocking datagrams over Winsock
+//--------------------------------------------------------------------------------------
+// A socket bound to a local port that sends datagrams to any address and receives whatever has arrived without waiting, so
+// it can be polled once a frame. Datagrams may be lost, duplicated or arrive out of order, the user of the socket deals with
+// that (see Network.h). Winsock is started with each socket opened and stopped as it is closed, Windows counts these.
+//
+//   UdpSocket socket;
+//   if (!socket.Open(port))  ... socket.GetLastError();
+//   UdpSocket::Address server;
+//   UdpSocket::Resolve("localhost", port, server);
+//   socket.Send(server, data, size);
+//   while ((size = socket.Receive(from, buffer, sizeof(buffer))) > 0)  ...
+
+#ifndef _UDP_SOCKET_H_INCLUDED_
+#define _UDP_SOCKET_H_INCLUDED_
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+
+class UdpSocket
+{
+	/*-----------------------------------------------------------------------------------------
+		Types
+	-----------------------------------------------------------------------------------------*/
+public:
+	// An IPv4 address and port, in host byte order
+	struct Address
+	{
+		uint32_t ip   = 0;
+		uint16_t port = 0;
+
+		bool operator==(const Address& other) const  { return ip == other.ip && port == other.port; }
+		std::string ToString() const;
+	};
+
+	// Find the IPv4 address of a host name or dotted address, e.g. "localhost" or "192.168.0.10". Blocks while the name is
+	// looked up. Returns false if it can't be found
+	static bool Resolve(const std::string& host, uint16_t port, Address& address);
+
+
+	/*-----------------------------------------------------------------------------------------
+		Construction
+	-----------------------------------------------------------------------------------------*/
+public:
+	UdpSocket() = default;
+
+	// Closes the socket if it is open
+	~UdpSocket();
+
+	// Prevent copying - the socket owns its handle
+	UdpSocket(const UdpSocket&) = delete;
+	UdpSocket& operator=(const UdpSocket&) = delete;
+
+	// Open a non-blocking socket on the given local port, 0 for any free port (e.g. for a client). Returns false on failure,
+	// see GetLastError
+	bool Open(uint16_t port = 0);
+
+	void Close();
+
+	bool IsOpen()  { return mSocket != INVALID; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Usage
+	-----------------------------------------------------------------------------------------*/
+public:
+	// Send a datagram. Returns false if it couldn't be sent, which for UDP is no different to it being lost on the way
+	bool Send(const Address& to, const void* data, size_t size);
+
+	// Receive the next datagram waiting, with the address it came from. Returns its size, or 0 if there are none waiting.
+	// Datagrams larger than the buffer, and errors such as an ICMP "port unreachable" from an earlier send, are skipped
+	size_t Receive(Address& from, void* buffer, size_t size);
+
+	std::string GetLastError()  { return mLastError; }
+
+
+	/*-----------------------------------------------------------------------------------------
+		Private data
+	-----------------------------------------------------------------------------------------*/
+private:
+	static constexpr uintptr_t INVALID = ~uintptr_t(0); // INVALID_SOCKET, the handle is a SOCKET
+
+	uintptr_t   mSocket = INVALID;
+	std::string mLastError;
+};
+
+
+#endif //_UDP_SOCKET_H_INCLUDED_
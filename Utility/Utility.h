@@ -6,6 +6,8 @@
 #define _UTILITY_H_INCLUDED_
 
 #include <string>
+#include <string_view>
+#include <functional>
 #include <type_traits>
 
 
@@ -63,4 +65,19 @@ inline bool EndsWithCI(const std::string& str, const std::string& substr)
 }
 
 
+//--------------------------------------------------------------------------------------
+// String hashing
+//--------------------------------------------------------------------------------------
+
+// Hash function object for unordered containers with std::string keys that allows lookups with a std::string_view or
+// string literal without first building a temporary std::string. Use together with std::equal_to<>, e.g.
+//     std::unordered_map<std::string, int, StringHash, std::equal_to<>> map;   map.find("name");
+struct StringHash
+{
+	using is_transparent = void; // Marks this hash as supporting heterogeneous lookup
+
+	size_t operator()(std::string_view str) const  { return std::hash<std::string_view>{}(str); }
+};
+
+
 #endif //_UTILITY_H_INCLUDED_
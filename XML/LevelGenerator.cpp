@@ -0,0 +1,398 @@
+// Writes synthetic levels for scaling tests, using the templates of an existing level - see LevelGenerator.h
+
+#include "LevelGenerator.h"
+#include "tinyxml2.h"
+#include "AssetFiles.h"
+#include "MathHelpers.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <unordered_map>
+#include <vector>
+using std::vector;
+
+using namespace tinyxml2;
+
+
+//------------------------------------------------------------------------------
+// Sizes
+//------------------------------------------------------------------------------
+
+// Radii of the circles kept clear around each kind of entity on X and Z, obstacles use their collision extents
+static const float BOAT_RADIUS    = 12.0f;
+static const float STATION_RADIUS = 15.0f; // At scale 1
+static const float GAP            = 5.0f;  // Kept between any two entities
+
+// Boats of a team start in a circle of this area per boat, the circle grows if they don't fit
+static const float BOAT_SPACING = 40.0f;
+
+// Team groups are centred this fraction of the way from the middle to the edge of the world
+static const float TEAM_DISTANCE = 0.7f;
+
+// Crates and mines appear up to this fraction of the world size from the middle, about the same as Entities.xml
+static const float SPAWN_RANGE = 0.1f;
+
+// Random positions tried for an entity before giving up (or growing a team's circle)
+static const int MAX_ATTEMPTS = 200;
+
+LevelGeneratorSettings LevelGeneratorSettings::Scaled(float factor) const
+{
+    auto scale = [factor](uint32_t count) { return static_cast<uint32_t>(std::lround(count * factor)); };
+    LevelGeneratorSettings scaled = *this;
+    scaled.boatsPerTeam   = scale(boatsPerTeam);
+    scaled.obstacles      = scale(obstacles);
+    scaled.reloadStations = scale(reloadStations);
+    scaled.maxCrates      = scale(maxCrates);
+    scaled.maxMines       = scale(maxMines);
+    scaled.worldSize      = worldSize * std::sqrt(factor);
+    return scaled;
+}
+
+
+//------------------------------------------------------------------------------
+// Source level
+//------------------------------------------------------------------------------
+
+// A kind of obstacle found in the source level, placed as it was there but for position and rotation
+struct ObstacleKind
+{
+    string templateName;
+    float  scale;
+    float  halfExtents[3];
+    float  radius;
+};
+
+// What a generated level is made from
+struct SourceLevel
+{
+    vector<XMLElement*>    templates;        // <EntityTemplates> elements, copied as they are
+    vector<XMLElement*>    scenery;          // Plain <Entity> elements (sky, water...), copied as they are
+    vector<ObstacleKind>   obstacles;
+    string                 stationTemplate;  // From the first reload station, or a template called ReloadStation
+    float                  stationScale = 2.0f;
+    vector<string>         teamNames;        // In the order first seen
+    vector<vector<string>> teamTemplates;    // Boat template names of each team
+    float                  boatHeight = -1.5f; // From the first boat
+    float                  boatSpeed  = 7.0f;
+};
+
+// Gather the templates and kinds of entity in a parsed level
+static void ReadSourceLevel(tinyxml2::XMLDocument& xmlDoc, SourceLevel& source)
+{
+    bool haveBoat = false, haveStation = false;
+    for (XMLElement* scene = xmlDoc.FirstChildElement("Scene"); scene != nullptr; scene = scene->NextSiblingElement("Scene"))
+    {
+        for (XMLElement* element = scene->FirstChildElement("EntityTemplates"); element != nullptr;
+             element = element->NextSiblingElement("EntityTemplates"))
+        {
+            source.templates.push_back(element);
+            for (XMLElement* templateElem = element->FirstChildElement("EntityTemplate"); templateElem != nullptr;
+                 templateElem = templateElem->NextSiblingElement("EntityTemplate"))
+            {
+                const char* type = templateElem->Attribute("Type");
+                const char* name = templateElem->Attribute("Name");
+                if (name == nullptr)  continue;
+                if (type != nullptr && string(type) == "BoatTemplate")
+                {
+                    const char* team = templateElem->Attribute("Team");
+                    if (team == nullptr)  continue;
+                    auto found = std::find(source.teamNames.begin(), source.teamNames.end(), team);
+                    if (found == source.teamNames.end())
+                    {
+                        source.teamNames.push_back(team);
+                        source.teamTemplates.emplace_back();
+                        found = source.teamNames.end() - 1;
+                    }
+                    source.teamTemplates[found - source.teamNames.begin()].push_back(name);
+                }
+                else if (string(name) == "ReloadStation" && source.stationTemplate.empty())
+                {
+                    source.stationTemplate = name;
+                }
+            }
+        }
+
+        for (XMLElement* entitiesElem = scene->FirstChildElement("Entities"); entitiesElem != nullptr;
+             entitiesElem = entitiesElem->NextSiblingElement("Entities"))
+        {
+            for (XMLElement* element = entitiesElem->FirstChildElement("Entity"); element != nullptr;
+                 element = element->NextSiblingElement("Entity"))
+            {
+                const char* type         = element->Attribute("Type");
+                const char* templateName = element->Attribute("Template");
+                if (type == nullptr || templateName == nullptr)  continue;
+
+                float scale = 1.0f;
+                XMLElement* transformElem = element->FirstChildElement("Transform");
+                XMLElement* scaleElem = transformElem ? transformElem->FirstChildElement("Scale") : nullptr;
+                if (scaleElem != nullptr)  scale = scaleElem->FloatAttribute("Value", 1.0f);
+
+                string entityType = type;
+                if (entityType == "Entity")
+                {
+                    source.scenery.push_back(element);
+                }
+                else if (entityType == "Obstacle")
+                {
+                    ObstacleKind kind = { templateName, scale, { 75, 20, 75 }, 0 };
+                    XMLElement* collisionElem = element->FirstChildElement("Collision");
+                    XMLElement* extentsElem = collisionElem ? collisionElem->FirstChildElement("HalfExtents") : nullptr;
+                    if (extentsElem != nullptr)
+                    {
+                        extentsElem->QueryFloatAttribute("X", &kind.halfExtents[0]);
+                        extentsElem->QueryFloatAttribute("Y", &kind.halfExtents[1]);
+                        extentsElem->QueryFloatAttribute("Z", &kind.halfExtents[2]);
+                    }
+                    kind.radius = std::max(kind.halfExtents[0], kind.halfExtents[2]) * scale;
+                    source.obstacles.push_back(kind);
+                }
+                else if (entityType == "ReloadStation" && !haveStation)
+                {
+                    haveStation = true;
+                    source.stationTemplate = templateName;
+                    source.stationScale = scale;
+                }
+                else if (entityType == "Boat" && !haveBoat)
+                {
+                    haveBoat = true;
+                    XMLElement* positionElem = transformElem ? transformElem->FirstChildElement("Position") : nullptr;
+                    if (positionElem != nullptr)  positionElem->QueryFloatAttribute("Y", &source.boatHeight);
+                    XMLElement* speedElem = element->FirstChildElement("Speed");
+                    if (speedElem != nullptr)  speedElem->QueryFloatAttribute("Value", &source.boatSpeed);
+                }
+            }
+        }
+    }
+}
+
+
+//------------------------------------------------------------------------------
+// Placement
+//------------------------------------------------------------------------------
+
+// The circles placed so far on X and Z, in a grid of cells wide enough that a new circle can only touch those in the 3x3
+// cells around its centre
+class Placement
+{
+public:
+    Placement(float worldSize, float maxRadius)
+        : mHalfSize(worldSize * 0.5f)
+    {
+        // Larger cells for a world that would otherwise need a huge grid, it just means more circles to check per cell
+        mCellSize = std::max(2.0f * maxRadius + GAP, worldSize / MAX_CELLS);
+        mCellsPerSide = std::max(1, static_cast<int>(std::ceil(worldSize / mCellSize)));
+        mCells.resize(static_cast<size_t>(mCellsPerSide) * mCellsPerSide);
+    }
+
+    // Add a circle if it is inside the world and clear of those already placed
+    bool TryAdd(float x, float z, float radius)
+    {
+        if (std::abs(x) > mHalfSize - radius || std::abs(z) > mHalfSize - radius)  return false;
+
+        int cellX = Cell(x), cellZ = Cell(z);
+        for (int nearZ = std::max(cellZ - 1, 0); nearZ <= std::min(cellZ + 1, mCellsPerSide - 1); ++nearZ)
+        {
+            for (int nearX = std::max(cellX - 1, 0); nearX <= std::min(cellX + 1, mCellsPerSide - 1); ++nearX)
+            {
+                for (const Circle& circle : mCells[nearZ * mCellsPerSide + nearX])
+                {
+                    float dx = circle.x - x, dz = circle.z - z, clear = circle.radius + radius + GAP;
+                    if (dx * dx + dz * dz < clear * clear)  return false;
+                }
+            }
+        }
+        mCells[cellZ * mCellsPerSide + cellX].push_back({ x, z, radius });
+        return true;
+    }
+
+private:
+    static constexpr float MAX_CELLS = 4096.0f; // Per side
+
+    int Cell(float position)  { return std::clamp(static_cast<int>((position + mHalfSize) / mCellSize), 0, mCellsPerSide - 1); }
+
+    struct Circle
+    {
+        float x, z, radius;
+    };
+
+    float mHalfSize;
+    float mCellSize;
+    int   mCellsPerSide;
+    vector<vector<Circle>> mCells;
+};
+
+
+//------------------------------------------------------------------------------
+// Generating
+//------------------------------------------------------------------------------
+
+// Add a new element or comment to the end of the given element
+static XMLElement* AddChild(XMLNode* parent, const char* name)
+{
+    return parent->InsertEndChild(parent->GetDocument()->NewElement(name))->ToElement();
+}
+
+static void AddComment(XMLNode* parent, const char* text)
+{
+    parent->InsertEndChild(parent->GetDocument()->NewComment(text));
+}
+
+// Add an <Entity> element with the given transform, rotation about Y in degrees
+static void AddEntity(tinyxml2::XMLDocument& xmlDoc, XMLElement* entitiesElem, const char* type, const string& templateName,
+                      const string& name, float x, float y, float z, float yaw, float scale)
+{
+    XMLElement* entity = xmlDoc.NewElement("Entity");
+    entity->SetAttribute("Type", type);
+    entity->SetAttribute("Template", templateName.c_str());
+    if (!name.empty())  entity->SetAttribute("Name", name.c_str());
+
+    XMLElement* transform = AddChild(entity, "Transform");
+    XMLElement* position  = AddChild(transform, "Position");
+    position->SetAttribute("X", x);
+    position->SetAttribute("Y", y);
+    position->SetAttribute("Z", z);
+    XMLElement* rotation  = AddChild(transform, "Rotation");
+    rotation->SetAttribute("X", 0);
+    rotation->SetAttribute("Y", yaw);
+    rotation->SetAttribute("Z", 0);
+    if (scale != 1.0f)  AddChild(transform, "Scale")->SetAttribute("Value", scale);
+    entitiesElem->InsertEndChild(entity);
+}
+
+// Generate a level from the given settings and the source level's templates and write it to the output file
+bool GenerateLevel(const string& sourceFile, const string& outputFile, const LevelGeneratorSettings& settings, string& error)
+{
+    // Read the source level (from the asset archive if it is in one)
+    tinyxml2::XMLDocument sourceDoc;
+    AssetData file = gAssetFiles.Read(sourceFile);
+    if (file.empty() || sourceDoc.Parse(reinterpret_cast<const char*>(file.data()), file.size()) != XML_SUCCESS)
+    {
+        error = "Error parsing level file (" + sourceFile + ")";
+        return false;
+    }
+    SourceLevel source;
+    ReadSourceLevel(sourceDoc, source);
+    if (settings.boatsPerTeam > 0 && source.teamNames.empty())
+    {
+        error = sourceFile + " has no boat templates with a team";
+        return false;
+    }
+    if (settings.obstacles > 0 && source.obstacles.empty())
+    {
+        error = sourceFile + " has no obstacles to copy";
+        return false;
+    }
+    if (settings.reloadStations > 0 && source.stationTemplate.empty())
+    {
+        error = sourceFile + " has no reload station to copy";
+        return false;
+    }
+
+    float maxRadius = std::max(BOAT_RADIUS, STATION_RADIUS * source.stationScale);
+    for (const ObstacleKind& kind : source.obstacles)  maxRadius = std::max(maxRadius, kind.radius);
+    Placement placement(settings.worldSize, maxRadius);
+    RandomStream random(settings.seed);
+    float halfSize = settings.worldSize * 0.5f;
+
+    tinyxml2::XMLDocument xmlDoc;
+    xmlDoc.InsertEndChild(xmlDoc.NewDeclaration());
+    XMLElement* scene = xmlDoc.NewElement("Scene");
+    xmlDoc.InsertEndChild(scene);
+
+    XMLElement* settingsElem = AddChild(scene, "Settings");
+    settingsElem->SetAttribute("MaxCrates", settings.maxCrates);
+    settingsElem->SetAttribute("MaxMines", settings.maxMines);
+    settingsElem->SetAttribute("SpawnRange", settings.worldSize * SPAWN_RANGE);
+    if (settings.cellSize > 0)  settingsElem->SetAttribute("CellSize", settings.cellSize);
+    for (XMLElement* templates : source.templates)  scene->InsertEndChild(templates->DeepClone(&xmlDoc));
+
+    XMLElement* entities = AddChild(scene, "Entities");
+    AddComment(entities, " Scenery ");
+    for (XMLElement* scenery : source.scenery)  entities->InsertEndChild(scenery->DeepClone(&xmlDoc));
+
+    // Boats first, so the teams' groups are clear of obstacles
+    for (size_t team = 0; team < source.teamNames.size() && settings.boatsPerTeam > 0; ++team)
+    {
+        AddComment(entities, (" Boats (" + source.teamNames[team] + ") ").c_str());
+        float angle = 2.0f * std::numbers::pi_v<float> * team / source.teamNames.size();
+        float centreX = std::sin(angle) * halfSize * TEAM_DISTANCE;
+        float centreZ = std::cos(angle) * halfSize * TEAM_DISTANCE;
+        float groupRadius = BOAT_SPACING * std::sqrt(static_cast<float>(settings.boatsPerTeam));
+        const vector<string>& templates = source.teamTemplates[team];
+        for (uint32_t boat = 0; boat < settings.boatsPerTeam; ++boat)
+        {
+            float x, z;
+            for (int attempt = 0; ; ++attempt)
+            {
+                if (attempt == MAX_ATTEMPTS)
+                {
+                    // No room left in the group, spread it out
+                    if (groupRadius > settings.worldSize)
+                    {
+                        error = "No room for " + std::to_string(settings.boatsPerTeam) + " boats per team, try a larger world";
+                        return false;
+                    }
+                    groupRadius *= 1.25f;
+                    attempt = 0;
+                }
+                float distance = groupRadius * std::sqrt(random.Range(0.0f, 1.0f)); // Even over the circle's area
+                float direction = random.Range(0.0f, 2.0f * std::numbers::pi_v<float>);
+                x = centreX + std::sin(direction) * distance;
+                z = centreZ + std::cos(direction) * distance;
+                if (placement.TryAdd(x, z, BOAT_RADIUS))  break;
+            }
+            const string& templateName = templates[boat % templates.size()];
+            AddEntity(xmlDoc, entities, "Boat", templateName, templateName + " " + std::to_string(boat + 1), x, source.boatHeight, z,
+                      ToDegrees(std::atan2(-x, -z)), 1.0f);
+            AddChild(entities->LastChildElement(), "Speed")->SetAttribute("Value", source.boatSpeed);
+        }
+    }
+
+    // Then reload stations and obstacles anywhere they fit
+    auto placeAnywhere = [&](float radius, float& x, float& z)
+    {
+        for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+        {
+            x = random.Range(-halfSize, halfSize);
+            z = random.Range(-halfSize, halfSize);
+            if (placement.TryAdd(x, z, radius))  return true;
+        }
+        return false;
+    };
+    if (settings.reloadStations > 0)  AddComment(entities, " Reload Stations ");
+    for (uint32_t station = 0; station < settings.reloadStations; ++station)
+    {
+        float x, z;
+        if (!placeAnywhere(STATION_RADIUS * source.stationScale, x, z))
+        {
+            error = "No room for " + std::to_string(settings.reloadStations) + " reload stations, try a larger world";
+            return false;
+        }
+        AddEntity(xmlDoc, entities, "ReloadStation", source.stationTemplate, "Reload Station " + std::to_string(station + 1),
+                  x, 0, z, random.Range(0.0f, 360.0f), source.stationScale);
+    }
+
+    if (settings.obstacles > 0)  AddComment(entities, " Obstacles ");
+    for (uint32_t obstacle = 0; obstacle < settings.obstacles; ++obstacle)
+    {
+        const ObstacleKind& kind = source.obstacles[random.Range(0, static_cast<int>(source.obstacles.size()) - 1)];
+        float x, z;
+        if (!placeAnywhere(kind.radius, x, z))
+        {
+            error = "No room for " + std::to_string(settings.obstacles) + " obstacles, try a larger world";
+            return false;
+        }
+        AddEntity(xmlDoc, entities, "Obstacle", kind.templateName, "", x, 0, z, random.Range(0.0f, 360.0f), kind.scale);
+        XMLElement* extents = AddChild(AddChild(entities->LastChildElement(), "Collision"), "HalfExtents");
+        extents->SetAttribute("X", kind.halfExtents[0]);
+        extents->SetAttribute("Y", kind.halfExtents[1]);
+        extents->SetAttribute("Z", kind.halfExtents[2]);
+    }
+
+    if (xmlDoc.SaveFile(outputFile.c_str()) != XML_SUCCESS)
+    {
+        error = "Can't write " + outputFile;
+        return false;
+    }
+    return true;
+}
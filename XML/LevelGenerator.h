@@ -0,0 +1,47 @@
+#ifndef _LEVEL_GENERATOR_H_INCLUDED_
+#define _LEVEL_GENERATOR_H_INCLUDED_
+
+#include "Random.h"
+
+#include <string>
+#include <stdint.h>
+using std::string;
+
+/*---------------------------------------------------------------------------------------------
+    Level generator
+    Writes synthetic levels far larger than the hand-made ones, to test how the game scales.
+
+    The templates, scenery (sky, water) and the kinds of obstacle and reload station are taken
+    from an existing level, then the given numbers of boats for each team (every team with a
+    boat template), obstacles and reload stations are placed at random in a square world, none
+    overlapping another. Each team starts in a group of its own around the edge of the world,
+    facing the middle. The crate and mine limits and the cell size are written as the level's
+    <Settings> (see LevelSettings in ParseLevel.h). The same settings and seed always give the
+    same level.
+
+    The defaults are about the size of Entities.xml, Scaled gives a level with 10x, 100x, ...
+    as many of everything at the same density. Run from the command line (see RunLevelGenerator
+    in Main.cpp) or from the Configuration panel in the game.
+---------------------------------------------------------------------------------------------*/
+struct LevelGeneratorSettings
+{
+    uint32_t boatsPerTeam   = 3;
+    uint32_t obstacles      = 13;
+    uint32_t reloadStations = 3;
+    uint32_t maxCrates      = 8;       // Written to the level's <Settings>
+    uint32_t maxMines       = 10;
+    float    worldSize      = 2400.0f; // Width and depth of the square everything is placed in, centred on the origin
+    float    cellSize       = 0.0f;    // Written to the level's <Settings>, to stream the level in cells of this size (see
+                                       // WorldPartition.h). 0 for a level created all at once
+    uint64_t seed           = RandomStream::DEFAULT_SEED;
+
+    // These settings with every count multiplied by the given factor and the world made larger to keep the same density
+    LevelGeneratorSettings Scaled(float factor) const;
+};
+
+// Generate a level from the given settings, with the templates and kinds of entity in the source level, and write it to the
+// output file. Returns false with error set if the source level can't be read or has nothing to make an entity type from,
+// the entities don't fit in the world or the output can't be written
+bool GenerateLevel(const string& sourceFile, const string& outputFile, const LevelGeneratorSettings& settings, string& error);
+
+#endif // _LEVEL_GENERATOR_H_INCLUDED_
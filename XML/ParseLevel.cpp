@@ -3,16 +3,235 @@
 
 #include "ParseLevel.h"
 #include "tinyxml2.h"
+#include "DXDevice.h"
+#include "RenderGlobals.h"
+#include "AssetFiles.h"
+#include "StartupProfile.h"
+#include "Mesh.h"
+#include "MeshCache.h"
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <map>
+#include <unordered_map>
+#include <span>
+#include <tuple>
+#include <system_error>
 
 // This kind of statement would be bad practice in a include file, but here in a cpp it is a reasonable convenience
 // since this file is dedicated to this namespace (and the exposed names won't leak into other parts of the program)
 using namespace tinyxml2;
 
-// Parse the entire level file and create all the templates and entities inside
-bool ParseLevel::ParseFile(const string& fileName)
+
+//------------------------------------------------------------------------------
+// Compiled level layout
+//------------------------------------------------------------------------------
+// A compiled level is a header, then the text of the level's <EntityTemplates> elements (there are few templates
+// so they stay as XML and are parsed by ParseEntityTemplates), then the string table: an offset for each string and
+// one past the last, then the characters. Last are the entity records, at a multiple of 4 bytes from the start of the
+// file. Strings are referred to by their index in the table, string 0 is always "". Everything is little-endian
+
+static const uint32_t LEVEL_FILE_MAGIC   = 0x4C56454C; // "LEVL"
+static const uint32_t LEVEL_FILE_VERSION = 4;
+
+struct LevelFileHeader
 {
+    uint32_t magic         = LEVEL_FILE_MAGIC;
+    uint32_t version       = LEVEL_FILE_VERSION;
+    uint64_t sourceSize    = 0; // Size and modification time of the XML file it was compiled from
+    int64_t  sourceTime    = 0;
+    uint32_t templatesSize = 0; // Bytes of template XML text
+    uint32_t numStrings    = 0;
+    uint32_t stringsSize   = 0; // Bytes of string characters
+    uint32_t numEntities   = 0;
+    uint32_t maxCrates     = LevelSettings().maxCrates; // The level's <Settings>
+    uint32_t maxMines      = LevelSettings().maxMines;
+    float    spawnRange    = LevelSettings().spawnRange;
+    float    cellSize      = LevelSettings().cellSize;
+    SpawnSettings crateSpawns = LevelSettings().crateSpawns;
+    SpawnSettings mineSpawns  = LevelSettings().mineSpawns;
+    uint32_t maxSpawned    = LevelSettings().maxSpawned;
+    uint32_t spawnsPerStep = LevelSettings().spawnsPerStep;
+    float    spawnBudget   = LevelSettings().spawnBudget;
+};
+
+// Entity types that can be created from a level file
+enum class LevelEntityType : uint32_t
+{
+    Entity,
+    Boat,
+    Obstacle,
+    ReloadStation,
+};
+
+// Flags of an entity record
+static const uint32_t LEVEL_ENTITY_RESIDENT = 1; // Resident="true", never streamed out in a partitioned level
+
+// An <Entity> element. Random ranges are half the range given in the XML, the random offset is chosen at load
+struct LevelEntityRecord
+{
+    LevelEntityType type;
+    uint32_t templateName; // String index
+    uint32_t name;         // String index
+    float    position[3];
+    float    positionRandom[3];
+    float    rotation[3];  // In radians
+    float    rotationRandom[3];
+    float    scale;
+    float    speed;        // Boats only
+    uint32_t flags;        // LEVEL_ENTITY_ flags
+};
+static_assert(sizeof(LevelEntityRecord) == 72, "Level entity records are a fixed layout");
+
+// The compiled level is kept next to the XML file
+static string CompiledFileName(const string& fileName)  { return fileName + ".level"; }
+
+// Round up to a multiple of 4 bytes
+static size_t Align4(size_t size)  { return (size + 3) & ~size_t(3); }
+
+
+//------------------------------------------------------------------------------
+// Compiling
+//------------------------------------------------------------------------------
+
+// Read a vector from the "X", "Y" and "Z" attributes of the given element, and the half ranges of the random offset
+// from the same attributes of an optional <Randomise> child
+static void ReadVector3(XMLElement* element, float value[3], float random[3])
+{
+    element->QueryFloatAttribute("X", &value[0]);
+    element->QueryFloatAttribute("Y", &value[1]);
+    element->QueryFloatAttribute("Z", &value[2]);
+
+    XMLElement* randomElem = element->FirstChildElement("Randomise");
+    if (randomElem)
+    {
+        const char* axes[] = { "X", "Y", "Z" };
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const XMLAttribute* attr = randomElem->FindAttribute(axes[axis]);
+            if (attr != nullptr)  random[axis] = attr->FloatValue() * 0.5f;
+        }
+    }
+}
+
+// Strings of a level being compiled, each distinct string is stored once
+class LevelStrings
+{
+public:
+    LevelStrings()  { Add(""); }
+
+    uint32_t Add(const string& value)
+    {
+        auto [it, added] = mIndexes.try_emplace(value, static_cast<uint32_t>(mStrings.size()));
+        if (added)  mStrings.push_back(value);
+        return it->second;
+    }
+
+    const vector<string>& Strings()  { return mStrings; }
+
+private:
+    vector<string> mStrings;
+    std::unordered_map<string, uint32_t> mIndexes;
+};
+
+// Read the <Entity> elements in an <Entities> element into records. As when levels were read directly, an entity
+// missing a required attribute ends the element, the entities before it are kept
+static void ReadEntitiesElement(XMLElement* entitiesElem, vector<LevelEntityRecord>& entities, LevelStrings& strings)
+{
+    for (XMLElement* element = entitiesElem->FirstChildElement("Entity"); element != nullptr;
+         element = element->NextSiblingElement("Entity"))
+    {
+        // Read the required attributes: "Type", "Template", "Name"
+        const XMLAttribute* typeAttr     = element->FindAttribute("Type");
+        const XMLAttribute* templateAttr = element->FindAttribute("Template");
+        if (typeAttr == nullptr || templateAttr == nullptr)  return;
+
+        LevelEntityRecord entity = {};
+        string entityType = typeAttr->Value();
+        if      (entityType == "Boat")           entity.type = LevelEntityType::Boat;
+        else if (entityType == "Obstacle")       entity.type = LevelEntityType::Obstacle;
+        else if (entityType == "ReloadStation")  entity.type = LevelEntityType::ReloadStation;
+        else                                     entity.type = LevelEntityType::Entity;
+
+        entity.templateName = strings.Add(templateAttr->Value());
+        const XMLAttribute* attr = element->FindAttribute("Name");
+        if (attr != nullptr)  entity.name = strings.Add(attr->Value());
+        if (element->BoolAttribute("Resident"))  entity.flags |= LEVEL_ENTITY_RESIDENT;
+
+        // Default transform unless there is a <Transform> element
+        entity.scale = 1.0f;
+        XMLElement* transformElem = element->FirstChildElement("Transform");
+        if (transformElem)
+        {
+            XMLElement* child = transformElem->FirstChildElement("Position");
+            if (child != nullptr)  ReadVector3(child, entity.position, entity.positionRandom);
+
+            // Rotation is given in degrees
+            child = transformElem->FirstChildElement("Rotation");
+            if (child != nullptr)
+            {
+                ReadVector3(child, entity.rotation, entity.rotationRandom);
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    entity.rotation[axis]       = ToRadians(entity.rotation[axis]);
+                    entity.rotationRandom[axis] = ToRadians(entity.rotationRandom[axis]);
+                }
+            }
+
+            child = transformElem->FirstChildElement("Scale");
+            if (child != nullptr)
+            {
+                attr = child->FindAttribute("Value");
+                if (attr == nullptr)  return;
+                entity.scale = attr->FloatValue();
+            }
+        }
+
+        // Boats also have a <Speed> element
+        if (entity.type == LevelEntityType::Boat)
+        {
+            XMLElement* speedElem = element->FirstChildElement("Speed");
+            if (speedElem != nullptr)  entity.speed = speedElem->FloatAttribute("Value", 0.0f);
+        }
+
+        entities.push_back(entity);
+    }
+}
+
+// Read the attributes of a <CrateSpawns> or <MineSpawns> element, those missing are left as they are
+static void ReadSpawnsElement(XMLElement* spawnsElem, SpawnSettings& spawns)
+{
+    if (spawnsElem == nullptr)  return;
+    spawnsElem->QueryFloatAttribute("MinInterval", &spawns.minInterval);
+    spawnsElem->QueryFloatAttribute("MaxInterval", &spawns.maxInterval);
+    spawnsElem->QueryFloatAttribute("MinFirst", &spawns.minFirst);
+    spawnsElem->QueryFloatAttribute("MaxFirst", &spawns.maxFirst);
+    spawnsElem->QueryFloatAttribute("Height", &spawns.height);
+    spawnsElem->QueryUnsignedAttribute("PerStep", &spawns.perStep);
+}
+
+// Read the attributes of a <Settings> element and its spawn elements into the header, those missing are left as they are
+static void ReadSettingsElement(XMLElement* settingsElem, LevelFileHeader& header)
+{
+    settingsElem->QueryUnsignedAttribute("MaxCrates", &header.maxCrates);
+    settingsElem->QueryUnsignedAttribute("MaxMines", &header.maxMines);
+    settingsElem->QueryFloatAttribute("SpawnRange", &header.spawnRange);
+    settingsElem->QueryFloatAttribute("CellSize", &header.cellSize);
+    settingsElem->QueryUnsignedAttribute("MaxSpawned", &header.maxSpawned);
+    settingsElem->QueryUnsignedAttribute("SpawnsPerStep", &header.spawnsPerStep);
+    settingsElem->QueryFloatAttribute("SpawnBudget", &header.spawnBudget);
+    ReadSpawnsElement(settingsElem->FirstChildElement("CrateSpawns"), header.crateSpawns);
+    ReadSpawnsElement(settingsElem->FirstChildElement("MineSpawns"), header.mineSpawns);
+}
+
+// Compile the given XML level file into the binary level format
+bool ParseLevel::CompileFile(const string& fileName, vector<uint8_t>& compiled)
+{
+    StartupTimer startupTimer("Compile level");
+
     // The tinyXML object XMLDocument will hold the parsed structure and data from the XML file
     // NOTE: even though there is a "using namespace tinyxml2;" at the top of the file, you still need to
     // give this declaration a tinyxml2:: because the Windows header files have also declared XMLDocument
@@ -20,278 +239,935 @@ bool ParseLevel::ParseFile(const string& fileName)
     // why namespaces are important (and this occurs more than once in Windows header files)
     tinyxml2::XMLDocument xmlDoc;
 
-    // Open and parse document into tinyxml2 object xmlDoc
-    XMLError error = xmlDoc.LoadFile(fileName.c_str());
+    // Read the file (from the asset archive if it is in one) and parse it into tinyxml2 object xmlDoc
+    AssetData file = gAssetFiles.Read(fileName);
+    if (file.empty())  return false;
+    XMLError error = xmlDoc.Parse(reinterpret_cast<const char*>(file.data()), file.size());
     if (error != XML_SUCCESS) return false;
 
     // Note: I am ignoring XML nodes here and traversing the XML elements directly. Elements are a kind of node, they are
     // the tags but other kinds of node are comments, embedded documents or free text (not in a tag). I am ignoring those
 
     // No XML element in the level file means malformed XML or not an XML document at all
-    XMLElement* element = xmlDoc.FirstChildElement();
-    if (element == nullptr)  return false;
+    if (xmlDoc.FirstChildElement() == nullptr)  return false;
+
+    // Templates are kept as compact XML text, entities become records and settings go in the header
+    LevelFileHeader header;
+    XMLPrinter templates(nullptr, true);
+    vector<LevelEntityRecord> entities;
+    LevelStrings strings;
+    for (XMLElement* scene = xmlDoc.FirstChildElement("Scene"); scene != nullptr; scene = scene->NextSiblingElement("Scene"))
+    {
+        for (XMLElement* element = scene->FirstChildElement(); element != nullptr; element = element->NextSiblingElement())
+        {
+            // Things expected in a "Scene" tag
+            string elementName = element->Name();
+            if      (elementName == "EntityTemplates")  element->Accept(&templates);
+            else if (elementName == "Entities")         ReadEntitiesElement(element, entities, strings);
+            else if (elementName == "Settings")         ReadSettingsElement(element, header);
+        }
+    }
+
+    // Lay out the file, see the top of the file
+    AssetInfo info;
+    if (gAssetFiles.GetInfo(fileName, info))
+    {
+        header.sourceSize = info.size;
+        header.sourceTime = info.time;
+    }
+    header.templatesSize = static_cast<uint32_t>(templates.CStrSize() - 1);
+    header.numStrings    = static_cast<uint32_t>(strings.Strings().size());
+    header.numEntities   = static_cast<uint32_t>(entities.size());
+
+    vector<uint32_t> stringOffsets;
+    for (auto& value : strings.Strings())
+    {
+        stringOffsets.push_back(header.stringsSize);
+        header.stringsSize += static_cast<uint32_t>(value.size());
+    }
+    stringOffsets.push_back(header.stringsSize);
+
+    size_t stringsStart  = sizeof(header) + header.templatesSize;
+    size_t charsStart    = stringsStart + stringOffsets.size() * sizeof(uint32_t);
+    size_t entitiesStart = Align4(charsStart + header.stringsSize);
+    compiled.assign(entitiesStart + entities.size() * sizeof(LevelEntityRecord), 0);
+
+    uint8_t* data = compiled.data();
+    std::memcpy(data, &header, sizeof(header));
+    std::memcpy(data + sizeof(header), templates.CStr(), header.templatesSize);
+    std::memcpy(data + stringsStart, stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+    for (size_t i = 0; i < strings.Strings().size(); ++i)
+    {
+        auto& value = strings.Strings()[i];
+        std::memcpy(data + charsStart + stringOffsets[i], value.data(), value.size());
+    }
+    if (!entities.empty())  std::memcpy(data + entitiesStart, entities.data(), entities.size() * sizeof(LevelEntityRecord));
+    return true;
+}
+
+
+//------------------------------------------------------------------------------
+// Loading
+//------------------------------------------------------------------------------
+
+// A compiled level checked and read in place, see ReadCompiled
+struct CompiledLevel
+{
+    LevelFileHeader          header;
+    const char*              templates; // header.templatesSize characters of XML
+    vector<string>           strings;
+    const LevelEntityRecord* entities;
+};
+
+// Check the data holds everything its header says it does and read the strings, before using any of it. Returns false if the
+// level is damaged
+static bool ReadCompiled(const uint8_t* data, size_t size, CompiledLevel& level)
+{
+    if (size < sizeof(LevelFileHeader))  return false;
+    LevelFileHeader& header = level.header;
+    std::memcpy(&header, data, sizeof(header));
+    size_t stringsStart  = sizeof(header) + header.templatesSize;
+    size_t charsStart    = stringsStart + (static_cast<size_t>(header.numStrings) + 1) * sizeof(uint32_t);
+    size_t entitiesStart = Align4(charsStart + header.stringsSize);
+    if (header.numStrings == 0 || entitiesStart + static_cast<size_t>(header.numEntities) * sizeof(LevelEntityRecord) > size)
+        return false;
+
+    const uint32_t* stringOffsets = reinterpret_cast<const uint32_t*>(data + stringsStart);
+    level.strings.assign(header.numStrings, string());
+    for (uint32_t i = 0; i < header.numStrings; ++i)
+    {
+        if (stringOffsets[i] > stringOffsets[i + 1] || stringOffsets[i + 1] > header.stringsSize)  return false;
+        level.strings[i].assign(reinterpret_cast<const char*>(data + charsStart + stringOffsets[i]), stringOffsets[i + 1] - stringOffsets[i]);
+    }
+
+    level.entities = reinterpret_cast<const LevelEntityRecord*>(data + entitiesStart);
+    for (uint32_t i = 0; i < header.numEntities; ++i)
+    {
+        if (level.entities[i].templateName >= header.numStrings || level.entities[i].name >= header.numStrings)  return false;
+    }
+    level.templates = reinterpret_cast<const char*>(data + sizeof(header));
+    return true;
+}
+
+// The transform of an entity record, with its random offsets chosen
+static Matrix4x4 RecordTransform(const LevelEntityRecord& entity)
+{
+    auto randomised = [](const float value[3], const float random[3])
+    {
+        Vector3 result(value[0], value[1], value[2]);
+        if (random[0] != 0)  result.x += Random(-random[0], random[0]);
+        if (random[1] != 0)  result.y += Random(-random[1], random[1]);
+        if (random[2] != 0)  result.z += Random(-random[2], random[2]);
+        return result;
+    };
+    return Matrix4x4(randomised(entity.position, entity.positionRandom), randomised(entity.rotation, entity.rotationRandom), entity.scale);
+}
+
+// Create the entity of an entity record, returns NO_ID if it can't be (e.g. its template failed to load)
+static EntityID CreateRecordEntity(EntityManager& entityManager, const LevelEntityRecord& entity, const Matrix4x4& transform,
+                                   const vector<string>& strings)
+{
+    const string& templateName = strings[entity.templateName];
+    const string& entityName   = strings[entity.name];
+
+    // Depending on the entity type, create the appropriate entity.
+    switch (entity.type)
+    {
+    case LevelEntityType::Boat:
+        return entityManager.CreateEntity<Boat>(templateName, entity.speed, transform, entityName);
+    case LevelEntityType::Obstacle:
+        return entityManager.CreateEntity<Obstacle>(templateName, transform, entityName);
+    case LevelEntityType::ReloadStation:
+        return entityManager.CreateEntity<ReloadStation>(templateName, transform, entityName);
+    default:
+        return entityManager.CreateEntity<Entity>(templateName, transform);
+    }
+}
+
+// Create the entities of a run of records with the same type and template together (see EntityManager::CreateEntities),
+// putting their IDs in ids if it isn't nullptr
+static void CreateRecordEntities(EntityManager& entityManager, std::span<const LevelEntityRecord> records,
+                                 const vector<string>& strings, EntityID* ids)
+{
+    TemplateHandle templateHandle(Atom(strings[records[0].templateName]));
+    switch (records[0].type)
+    {
+    case LevelEntityType::Boat:
+    {
+        vector<std::tuple<float, Matrix4x4, string>> params;
+        params.reserve(records.size());
+        for (const auto& entity : records)  params.emplace_back(entity.speed, RecordTransform(entity), strings[entity.name]);
+        entityManager.CreateEntities<Boat>(templateHandle, std::span(params), ids);
+        break;
+    }
+    case LevelEntityType::Obstacle:
+    case LevelEntityType::ReloadStation:
+    {
+        vector<std::tuple<Matrix4x4, string>> params;
+        params.reserve(records.size());
+        for (const auto& entity : records)  params.emplace_back(RecordTransform(entity), strings[entity.name]);
+        if (records[0].type == LevelEntityType::Obstacle)  entityManager.CreateEntities<Obstacle>     (templateHandle, std::span(params), ids);
+        else                                               entityManager.CreateEntities<ReloadStation>(templateHandle, std::span(params), ids);
+        break;
+    }
+    default:
+    {
+        vector<Matrix4x4> transforms;
+        transforms.reserve(records.size());
+        for (const auto& entity : records)  transforms.push_back(RecordTransform(entity));
+        entityManager.CreateEntities<Entity>(templateHandle, std::span(transforms), ids);
+    }
+    }
+}
+
+// Save a compiled level beside its XML file for next time. Write to a temporary file then rename it, so an interrupted write
+// never leaves a damaged level. Failing to save isn't an error, the level is compiled again next time
+static void SaveCompiled(const string& fileName, const vector<uint8_t>& bytes)
+{
+    auto compiledFile = CompiledFileName(fileName);
+    auto tempFile = compiledFile + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+    bool written;
+    {
+        std::ofstream stream(tempFile, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        written = static_cast<bool>(stream);
+    }
+    std::error_code error;
+    if (written)  std::filesystem::rename(tempFile, compiledFile, error);
+    if (!written || error)  std::filesystem::remove(tempFile, error);
+}
+
+// Whether a compiled level is of this version and was made from the XML file as it is now, or there is no XML file (see
+// haveSource). Only the header is checked, see ReadCompiled for the rest
+static bool IsCurrentCompiled(const AssetData& compiled, bool haveSource, const AssetInfo& info)
+{
+    if (compiled.size() < sizeof(LevelFileHeader))  return false;
+    LevelFileHeader header;
+    std::memcpy(&header, compiled.data(), sizeof(header));
+    return header.magic == LEVEL_FILE_MAGIC && header.version == LEVEL_FILE_VERSION &&
+           (!haveSource || (header.sourceSize == info.size && header.sourceTime == info.time));
+}
+
+// Whether an entity record goes in the world partition's cells rather than being created, in a level streamed in cells (see
+// LoadCompiled)
+static bool IsStreamedRecord(const LevelEntityRecord& entity, bool partitioned)
+{
+    return partitioned && (entity.flags & LEVEL_ENTITY_RESIDENT) == 0 &&
+           (entity.type == LevelEntityType::Entity || entity.type == LevelEntityType::Obstacle);
+}
+
+// A level being read ahead by ParseLevel::Preload, taken by the next ParseFile. The jobs refer to it, so it is kept until
+// they are done
+struct LevelPreload
+{
+    string     fileName;
+    JobSystem* jobSystem = nullptr;
+    JobCounter done;
+    AssetData  compiled; // Empty if the level couldn't be read or compiled
+};
+static std::unique_ptr<LevelPreload> gLevelPreload;
+
+// Read a level file ahead of parsing it
+void ParseLevel::Preload(const string& fileName, JobSystem& jobSystem)
+{
+    if (gLevelPreload)  gLevelPreload->jobSystem->Wait(gLevelPreload->done); // One preload at a time, the new one replaces it
+    gLevelPreload = std::make_unique<LevelPreload>();
+    gLevelPreload->fileName  = fileName;
+    gLevelPreload->jobSystem = &jobSystem;
+
+    LevelPreload* preload = gLevelPreload.get();
+    jobSystem.Run([preload]()
+    {
+        StartupTimer startupTimer("Preload " + preload->fileName);
+
+        // As ParseFile, but saving a newly compiled level here so ParseFile finds it up to date
+        AssetInfo info;
+        bool haveSource = gAssetFiles.GetInfo(preload->fileName, info);
+        preload->compiled = gAssetFiles.Read(CompiledFileName(preload->fileName));
+        if (!IsCurrentCompiled(preload->compiled, haveSource, info))
+        {
+            vector<uint8_t> bytes;
+            if (!CompileFile(preload->fileName, bytes))  { preload->compiled = {};  return; }
+            SaveCompiled(preload->fileName, bytes);
+            preload->compiled = AssetData(std::move(bytes));
+        }
+        CompiledLevel level;
+        if (!ReadCompiled(preload->compiled.data(), preload->compiled.size(), level) || level.header.templatesSize == 0)  return;
+
+        // The templates ParseFile will construct, those of the entities not streamed in cells. The game always gives a
+        // world partition, so a level with a cell size is taken to be streamed
+        std::set<string> usedTemplates;
+        bool partitioned = level.header.cellSize > 0;
+        for (uint32_t i = 0; i < level.header.numEntities; ++i)
+        {
+            if (!IsStreamedRecord(level.entities[i], partitioned))  usedTemplates.insert(level.strings[level.entities[i].templateName]);
+        }
+
+        // Read the caches of their meshes and levels of detail with the flags and details the templates will load them with,
+        // one job each. A mesh with no cache is left to be imported when its template is constructed
+        tinyxml2::XMLDocument xmlDoc;
+        if (xmlDoc.Parse(level.templates, level.header.templatesSize) != XML_SUCCESS)  return;
+        for (XMLElement* templates = xmlDoc.FirstChildElement("EntityTemplates"); templates != nullptr;
+             templates = templates->NextSiblingElement("EntityTemplates"))
+        {
+            for (XMLElement* element = templates->FirstChildElement("EntityTemplate"); element != nullptr;
+                 element = element->NextSiblingElement("EntityTemplate"))
+            {
+                const char* name = element->Attribute("Name");
+                const char* mesh = element->Attribute("Mesh");
+                const char* type = element->Attribute("Type");
+                if (name == nullptr || mesh == nullptr || type == nullptr || !usedTemplates.contains(name))  continue;
+
+                // Only plain templates take import flags, see ParseEntityTemplates
+                ImportFlags importFlags = {};
+                const char* flagNames = element->Attribute("ImportFlags");
+                if (flagNames != nullptr && string(type) == "EntityTemplate")  importFlags = ParseImportFlags(flagNames);
+
+                LODDesc lods = ParseLODs(element);
+                auto preloadMesh = [preload, importFlags](string meshFile, float detail)
+                {
+                    preload->jobSystem->Run([=]() { Mesh::Preload(meshFile, importFlags, detail); }, &preload->done);
+                };
+                preloadMesh(mesh, 1.0f);
+                for (auto& lodMesh : lods.meshes)  preloadMesh(lodMesh, 1.0f);
+                if (lods.meshes.empty())
+                {
+                    for (float detail : lods.details)  preloadMesh(mesh, detail);
+                }
+            }
+        }
+    }, &preload->done);
+}
+
+// Parse the entire level file and create all the templates and entities inside
+bool ParseLevel::ParseFile(const string& fileName, LoadedLevel* loaded /*= nullptr*/)
+{
+    StartupTimer startupTimer("Level " + fileName);
+
+    // Wait for a level being read ahead by Preload, and use what it read if it is this level
+    AssetData compiled;
+    bool preloaded = false;
+    if (gLevelPreload)
+    {
+        {
+            StartupTimer waitTimer("Wait for preload");
+            gLevelPreload->jobSystem->Wait(gLevelPreload->done);
+        }
+        preloaded = gLevelPreload->fileName == fileName;
+        if (preloaded)  compiled = gLevelPreload->compiled;
+        gLevelPreload.reset();
+    }
+
+    // Media may have changed on disk since the last level was loaded, so textures are looked for afresh (see AssetFiles::ExistsIndexed)
+    gAssetFiles.InvalidateFolderIndexes();
+
+    // Use the compiled level if it was made from the XML file as it is now, or if there is no XML file
+    AssetInfo info;
+    bool haveSource = gAssetFiles.GetInfo(fileName, info);
+    vector<EntityID>* entityIds = loaded ? &loaded->entityIds : nullptr;
+    if (!preloaded)  compiled = gAssetFiles.Read(CompiledFileName(fileName));
+    bool created = IsCurrentCompiled(compiled, haveSource, info) && LoadCompiled(compiled.data(), compiled.size(), entityIds);
+
+    // Mesh caches preloaded for templates that weren't constructed aren't needed
+    if (preloaded)  ClearPreloadedMeshCaches();
+    if (created)
+    {
+        if (loaded)
+        {
+            loaded->compiled.assign(compiled.data(), compiled.data() + compiled.size());
+            loaded->source = info;
+        }
+        return true;
+    }
+
+    vector<uint8_t> bytes;
+    if (!CompileFile(fileName, bytes))  return false;
+    SaveCompiled(fileName, bytes);
 
-    while (element != nullptr)
+    if (!LoadCompiled(bytes.data(), bytes.size(), entityIds))  return false;
+    if (loaded)
     {
-        // We found a "Level" tag at the root level, parse it
-        string elementName = element->Name();
-        if (elementName == "Scene")
+        loaded->compiled = std::move(bytes);
+        loaded->source = info;
+    }
+    return true;
+}
+
+// Create the templates and entities of a compiled level. A damaged level is found before anything is created
+bool ParseLevel::LoadCompiled(const uint8_t* data, size_t size, vector<EntityID>* entityIds)
+{
+    CompiledLevel level;
+    if (!ReadCompiled(data, size, level))  return false;
+    const LevelFileHeader& header = level.header;
+    const vector<string>& strings = level.strings;
+    const LevelEntityRecord* entities = level.entities;
+
+    mSettings.maxCrates  = header.maxCrates;
+    mSettings.maxMines   = header.maxMines;
+    mSettings.spawnRange = header.spawnRange;
+    mSettings.cellSize   = header.cellSize;
+    mSettings.crateSpawns   = header.crateSpawns;
+    mSettings.mineSpawns    = header.mineSpawns;
+    mSettings.maxSpawned    = header.maxSpawned;
+    mSettings.spawnsPerStep = header.spawnsPerStep;
+    mSettings.spawnBudget   = header.spawnBudget;
+
+    // In a partitioned level the scenery and obstacles go in the world partition's cells, unless they are marked resident.
+    // The other entities move or are used from anywhere in the level (boats, reload stations), so are always created
+    bool partitioned = mPartition != nullptr && header.cellSize > 0;
+    if (partitioned)  mPartition->SetCellSize(header.cellSize);
+    auto isStreamed = [partitioned](const LevelEntityRecord& entity)  { return IsStreamedRecord(entity, partitioned); };
+
+
+    //-----------------------------------
+    // Templates
+
+    // With lazy templates only those the created entities use are loaded now, templates only streamed entities use are
+    // loaded as their cells are streamed in
+    if (mLazyTemplates)
+    {
+        for (uint32_t i = 0; i < header.numEntities; ++i)
         {
-            ParseSceneElement(element);
+            if (isStreamed(entities[i]))  mStreamedTemplates.insert(strings[entities[i].templateName]);
+            else                          mUsedTemplates.insert(strings[entities[i].templateName]);
         }
+    }
 
-        element = element->NextSiblingElement();
+    if (header.templatesSize > 0)
+    {
+        StartupTimer templatesTimer("Templates");
+        tinyxml2::XMLDocument xmlDoc;
+        if (xmlDoc.Parse(level.templates, header.templatesSize) != XML_SUCCESS)  return false;
+        for (XMLElement* element = xmlDoc.FirstChildElement("EntityTemplates"); element != nullptr;
+             element = element->NextSiblingElement("EntityTemplates"))
+        {
+            ParseEntityTemplates(element);
+        }
+    }
+
+
+    //-----------------------------------
+    // Entities
+
+    // Straight from the records, only the random offsets are chosen here. Levels list the copies of each piece of scenery
+    // together, so each run of records with the same type and template is created in one go. They are still created in
+    // record order, so get the same IDs as they would one at a time
+    StartupTimer entitiesTimer("Entities (" + std::to_string(header.numEntities) + ")");
+    mEntityManager->ReserveEntities(header.numEntities);
+    if (entityIds)  entityIds->assign(header.numEntities, NO_ID);
+    for (uint32_t i = 0; i < header.numEntities; )
+    {
+        const LevelEntityRecord& entity = entities[i];
+        if (isStreamed(entity))
+        {
+            auto type = (entity.type == LevelEntityType::Obstacle) ? WorldPartition::EntityType::Obstacle : WorldPartition::EntityType::Entity;
+            mPartition->AddEntity(type, strings[entity.templateName], strings[entity.name], RecordTransform(entity));
+            ++i;
+            continue;
+        }
+
+        uint32_t runEnd = i + 1;
+        while (runEnd < header.numEntities && !isStreamed(entities[runEnd]) && entities[runEnd].type == entity.type &&
+               entities[runEnd].templateName == entity.templateName)  ++runEnd;
+        CreateRecordEntities(*mEntityManager, { entities + i, runEnd - i }, strings, entityIds ? entityIds->data() + i : nullptr);
+        i = runEnd;
     }
 
     return true;
 }
 
-// Parse a "Level" tag within the level XML file
-bool ParseLevel::ParseSceneElement(XMLElement* rootElement)
+
+//------------------------------------------------------------------------------
+// Hot reload
+//------------------------------------------------------------------------------
+
+// The <EntityTemplate> elements of a compiled level's template text, each printed on its own, by template name
+static std::map<string, string> TemplateTexts(const CompiledLevel& level)
 {
-    XMLElement* element = rootElement->FirstChildElement();
-    while (element != nullptr)
+    std::map<string, string> texts;
+    tinyxml2::XMLDocument xmlDoc;
+    if (level.header.templatesSize == 0 || xmlDoc.Parse(level.templates, level.header.templatesSize) != XML_SUCCESS)  return texts;
+    for (XMLElement* templates = xmlDoc.FirstChildElement("EntityTemplates"); templates != nullptr;
+         templates = templates->NextSiblingElement("EntityTemplates"))
     {
-        // Things expected in a "Level" tag
-        string elementName = element->Name();
-        if      (elementName == "EntityTemplates")  ParseEntityTemplates(element);
-        else if (elementName == "Entities")         ParseEntitiesElement(element);
+        for (XMLElement* element = templates->FirstChildElement("EntityTemplate"); element != nullptr;
+             element = element->NextSiblingElement("EntityTemplate"))
+        {
+            const char* name = element->Attribute("Name");
+            if (name == nullptr)  continue;
+            XMLPrinter text(nullptr, true);
+            element->Accept(&text);
+            texts[name] = text.CStr(); // A later template with the same name replaces an earlier one, as when loading
+        }
+    }
+    return texts;
+}
 
-        element = element->NextSiblingElement();
+// A key that is the same for two entity records only if they create the same entity, whichever level they came from: the
+// record with its string indexes replaced by the strings
+static string RecordKey(const LevelEntityRecord& entity, const vector<string>& strings)
+{
+    LevelEntityRecord values = entity;
+    values.templateName = 0;
+    values.name = 0;
+    string key(reinterpret_cast<const char*>(&values), sizeof(values));
+    key += strings[entity.templateName];
+    key += '\0';
+    key += strings[entity.name];
+    return key;
+}
+
+// Apply the changes in a level file to the level as it was loaded
+bool ParseLevel::ReloadFile(const string& fileName, LoadedLevel& loaded, LevelReloadStats& stats, string& error)
+{
+    stats = {};
+    vector<uint8_t> bytes;
+    if (!CompileFile(fileName, bytes))
+    {
+        error = fileName + " can't be read or parsed";
+        return false;
     }
+    CompiledLevel oldLevel, newLevel;
+    if (!ReadCompiled(loaded.compiled.data(), loaded.compiled.size(), oldLevel) || !ReadCompiled(bytes.data(), bytes.size(), newLevel) ||
+        loaded.entityIds.size() != oldLevel.header.numEntities)
+    {
+        error = "Compiled level is damaged";
+        return false;
+    }
+    if (oldLevel.header.cellSize > 0 || newLevel.header.cellSize > 0)
+    {
+        error = "A level streamed in cells can't be reloaded, restart to see the changes";
+        return false;
+    }
+    SaveCompiled(fileName, bytes);
+    gAssetFiles.InvalidateFolderIndexes();
+
+    mSettings.maxCrates  = newLevel.header.maxCrates;
+    mSettings.maxMines   = newLevel.header.maxMines;
+    mSettings.spawnRange = newLevel.header.spawnRange;
+    mSettings.crateSpawns   = newLevel.header.crateSpawns;
+    mSettings.mineSpawns    = newLevel.header.mineSpawns;
+    mSettings.maxSpawned    = newLevel.header.maxSpawned;
+    mSettings.spawnsPerStep = newLevel.header.spawnsPerStep;
+    mSettings.spawnBudget   = newLevel.header.spawnBudget;
+
 
+    //-----------------------------------
+    // Templates
+
+    // Templates whose element has changed in any way, or that are new, are constructed again. The entities of a changed
+    // template are destroyed first, the level's own are created again below. The new template is constructed before the
+    // old one is replaced, so meshes and textures the edit didn't touch are shared from the old one rather than imported
+    auto oldTemplates = TemplateTexts(oldLevel);
+    auto newTemplates = TemplateTexts(newLevel);
+    std::set<string> changedTemplates;
+    for (auto& [name, text] : newTemplates)
+    {
+        auto old = oldTemplates.find(name);
+        if (old == oldTemplates.end() || old->second != text)  changedTemplates.insert(name);
+    }
+
+    if (!changedTemplates.empty())
+    {
+        for (const string& name : changedTemplates)
+        {
+            if (!mEntityManager->IsTemplateConstructed(name))  continue;
+            vector<EntityID> ids = mEntityManager->GetTemplate(name)->Entities(); // Copied, destroying entities changes the list
+            for (EntityID id : ids)
+            {
+                if (mEntityManager->DestroyEntity(id))  ++stats.entitiesDestroyed;
+            }
+            mUsedTemplates.insert(name); // Constructed now if it was constructed before
+        }
+        for (uint32_t i = 0; i < newLevel.header.numEntities; ++i)  mUsedTemplates.insert(newLevel.strings[newLevel.entities[i].templateName]);
+
+        tinyxml2::XMLDocument xmlDoc;
+        if (xmlDoc.Parse(newLevel.templates, newLevel.header.templatesSize) == XML_SUCCESS)
+        {
+            for (XMLElement* templates = xmlDoc.FirstChildElement("EntityTemplates"); templates != nullptr;
+                 templates = templates->NextSiblingElement("EntityTemplates"))
+            {
+                for (XMLElement* element = templates->FirstChildElement("EntityTemplate"); element != nullptr; )
+                {
+                    XMLElement* next = element->NextSiblingElement("EntityTemplate");
+                    const char* name = element->Attribute("Name");
+                    if (name == nullptr || !changedTemplates.contains(name))  templates->DeleteChild(element);
+                    element = next;
+                }
+                ParseEntityTemplates(templates);
+            }
+        }
+        stats.templatesReloaded = static_cast<uint32_t>(changedTemplates.size());
+    }
+
+
+    //-----------------------------------
+    // Entities
+
+    // An unchanged record keeps its entity as it is, including a random offset chosen when it was created, or staying
+    // destroyed if it was destroyed in the game (e.g. a sunk boat). Records of changed templates aren't matched, their
+    // entities were destroyed with the template
+    auto isChanged = [&](const CompiledLevel& level, uint32_t i) { return changedTemplates.contains(level.strings[level.entities[i].templateName]); };
+    vector<EntityID> newIds(newLevel.header.numEntities, NO_ID);
+    vector<bool> newMatched(newLevel.header.numEntities, false);
+    vector<bool> oldMatched(oldLevel.header.numEntities, false);
+    std::unordered_multimap<string, uint32_t> oldByKey;
+    for (uint32_t i = 0; i < oldLevel.header.numEntities; ++i)
+    {
+        if (!isChanged(oldLevel, i))  oldByKey.emplace(RecordKey(oldLevel.entities[i], oldLevel.strings), i);
+    }
+    for (uint32_t i = 0; i < newLevel.header.numEntities; ++i)
+    {
+        if (isChanged(newLevel, i))  continue;
+        auto old = oldByKey.find(RecordKey(newLevel.entities[i], newLevel.strings));
+        if (old == oldByKey.end())  continue;
+        newIds[i] = loaded.entityIds[old->second];
+        newMatched[i] = oldMatched[old->second] = true;
+        oldByKey.erase(old);
+        ++stats.entitiesKept;
+    }
+
+    // Plain entities that have only moved are patched in place, matched by template and name in the order they appear. Other
+    // types are created again, as boats, obstacles and reload stations are placed in the entity manager's grids and trees
+    std::multimap<std::pair<string, string>, uint32_t> oldPlain;
+    for (uint32_t i = 0; i < oldLevel.header.numEntities; ++i)
+    {
+        const LevelEntityRecord& entity = oldLevel.entities[i];
+        if (!oldMatched[i] && !isChanged(oldLevel, i) && entity.type == LevelEntityType::Entity)
+            oldPlain.emplace(std::make_pair(oldLevel.strings[entity.templateName], oldLevel.strings[entity.name]), i);
+    }
+    for (uint32_t i = 0; i < newLevel.header.numEntities; ++i)
+    {
+        const LevelEntityRecord& entity = newLevel.entities[i];
+        if (newMatched[i] || isChanged(newLevel, i) || entity.type != LevelEntityType::Entity)  continue;
+        auto old = oldPlain.find(std::make_pair(newLevel.strings[entity.templateName], newLevel.strings[entity.name]));
+        if (old == oldPlain.end())  continue;
+        Entity* liveEntity = mEntityManager->GetEntity(loaded.entityIds[old->second]);
+        if (liveEntity != nullptr)
+        {
+            liveEntity->Transform() = RecordTransform(entity);
+            mEntityManager->Transforms().ResetPreviousRoot(EntityIndex(liveEntity->GetID())); // Jump there, not blend from the old place
+            newIds[i] = liveEntity->GetID();
+            newMatched[i] = oldMatched[old->second] = true;
+            ++stats.entitiesPatched;
+        }
+        oldPlain.erase(old);
+    }
+
+    // Destroy the entities of the records that have gone or changed, then create the entities of the new and changed records
+    for (uint32_t i = 0; i < oldLevel.header.numEntities; ++i)
+    {
+        if (!oldMatched[i] && loaded.entityIds[i] != NO_ID && mEntityManager->DestroyEntity(loaded.entityIds[i]))  ++stats.entitiesDestroyed;
+    }
+    for (uint32_t i = 0; i < newLevel.header.numEntities; ++i)
+    {
+        if (newMatched[i])  continue;
+        newIds[i] = CreateRecordEntity(*mEntityManager, newLevel.entities[i], RecordTransform(newLevel.entities[i]), newLevel.strings);
+        if (newIds[i] != NO_ID)  ++stats.entitiesCreated;
+    }
+
+    loaded.compiled  = std::move(bytes);
+    loaded.entityIds = std::move(newIds);
+    gAssetFiles.GetInfo(fileName, loaded.source);
     return true;
 }
 
 //------------------------------------------------------------------------------
 // Parse the <EntityTemplates> element.
+// Templates are read in two passes. First the attributes of every template are read, then the templates are
+// constructed (mesh import and texture loading), which is by far the slower part, so that is done in parallel
+// (see LoadEntityTemplates). With lazy templates, those no entity in the level uses are registered with the
+// entity manager instead, to be constructed when the game first creates one (e.g. missiles)
 bool ParseLevel::ParseEntityTemplates(XMLElement* templatesElem)
 {
+    vector<TemplateDesc> templates;
+
     XMLElement* templateElem = templatesElem->FirstChildElement("EntityTemplate");
     while (templateElem != nullptr)
     {
-        // Read the type, name and mesh attributes - these are all required, so fail on error
+        // Read the type, name and mesh attributes - these are all required, so fail on error. The templates read
+        // so far are still loaded, as they were before templates were loaded in parallel
         const XMLAttribute* attr = templateElem->FindAttribute("Type");
-        if (attr == nullptr)  return false;
+        if (attr == nullptr)  { LoadEntityTemplates(templates);  return false; }
         string type = attr->Value();
 
         attr = templateElem->FindAttribute("Name");
-        if (attr == nullptr)  return false;
+        if (attr == nullptr)  { LoadEntityTemplates(templates);  return false; }
         string name = attr->Value();
 
         attr = templateElem->FindAttribute("Mesh");
-        if (attr == nullptr)  return false;
+        if (attr == nullptr)  { LoadEntityTemplates(templates);  return false; }
         string mesh = attr->Value();
 
+        TemplateDesc desc = { name };
+        ImportFlags importFlags = {};
         if (type == "EntityTemplate")
         {
             // Check for an optional import flags attribute.
             attr = templateElem->FindAttribute("ImportFlags");
-            if (attr && std::string(attr->Value()) == "NoLighting") {
-                mEntityManager->CreateEntityTemplate<EntityTemplate>(name, mesh, ImportFlags::NoLighting);
+            if (attr) {
+                importFlags = ParseImportFlags(attr->Value());
+                desc.create = [=]() { return std::make_unique<EntityTemplate>(name, mesh, importFlags); };
             }
             else {
-                mEntityManager->CreateEntityTemplate<EntityTemplate>(name, mesh);
+                desc.create = [=]() { return std::make_unique<EntityTemplate>(name, mesh); };
             }
         }
         else if (type == "BoatTemplate")
         {
-            attr = templateElem->FindAttribute("MaxSpeed");
-            if (attr == nullptr)  return false;
-            float maxSpeed = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("Acceleration");
-            if (attr == nullptr)  return false;
-            float acceleration = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("TurnSpeed");
-            if (attr == nullptr)  return false;
-            float turnSpeed = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("GunTurnSpeed");
-            if (attr == nullptr)  return false;
-            float gunTurnSpeed = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("MaxHP");
-            if (attr == nullptr)  return false;
-            float maxHP = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("MissileDamage");
-            if (attr == nullptr)  return false;
-            float missileDamage = attr->FloatValue();
-
-            attr = templateElem->FindAttribute("Missiles");
-            if (attr == nullptr)  return false;
-            int missiles = attr->IntValue();
-
-            attr = templateElem->FindAttribute("Team");
-            if (attr == nullptr)
-                return false;
-            std::string teamStr = attr->Value();
-
-            Team teamEnum = Team::TeamA;
-            if (teamStr == "TeamA")
-                teamEnum = Team::TeamA;
-            else if (teamStr == "TeamB")
-                teamEnum = Team::TeamB;
-            else if (teamStr == "TeamC")
-                teamEnum = Team::TeamC;
-
-            mEntityManager->CreateEntityTemplate<BoatTemplate>(name, mesh, maxSpeed, acceleration, turnSpeed, gunTurnSpeed, maxHP, missiles, missileDamage, teamEnum);
-        }
-        // You can add other template types here as needed.
-
-        templateElem = templateElem->NextSiblingElement("EntityTemplate");
-    }
-    return true;
-}
+            bool complete = false;
+            do
+            {
+                attr = templateElem->FindAttribute("MaxSpeed");
+                if (attr == nullptr)  break;
+                float maxSpeed = attr->FloatValue();
 
-//------------------------------------------------------------------------------
-// Parse a list of entity tags, creating each entity when enough data has been read.
-// Ordinary entities are parsed in this pass.
-bool ParseLevel::ParseEntitiesElement(XMLElement* entitiesElem)
-{
-    // Iterate over all <Entity> elements.
-    XMLElement* element = entitiesElem->FirstChildElement("Entity");
-    while (element != nullptr)
-    {
-        // Read the required attributes: "Type", "Template", "Name"
-        const XMLAttribute* attr = element->FindAttribute("Type");
-        if (attr == nullptr)  return false;
-        std::string entityType = attr->Value();
+                attr = templateElem->FindAttribute("Acceleration");
+                if (attr == nullptr)  break;
+                float acceleration = attr->FloatValue();
 
-        attr = element->FindAttribute("Template");
-        if (attr == nullptr)  return false;
-        std::string templateName = attr->Value();
+                attr = templateElem->FindAttribute("TurnSpeed");
+                if (attr == nullptr)  break;
+                float turnSpeed = attr->FloatValue();
 
-        std::string entityName;
-        attr = element->FindAttribute("Name");
-        if (attr != nullptr)
-            entityName = attr->Value();
+                attr = templateElem->FindAttribute("GunTurnSpeed");
+                if (attr == nullptr)  break;
+                float gunTurnSpeed = attr->FloatValue();
 
-        // Set default transform values.
-        Vector3 pos(0, 0, 0);
-        Vector3 rot(0, 0, 0);
-        float scale = 1.0f;
+                attr = templateElem->FindAttribute("MaxHP");
+                if (attr == nullptr)  break;
+                float maxHP = attr->FloatValue();
 
-        // Look for a <Transform> element.
-        XMLElement* transformElem = element->FirstChildElement("Transform");
-        if (transformElem)
-        {
-            // Read the Position element.
-            XMLElement* child = transformElem->FirstChildElement("Position");
-            if (child != nullptr)
-                pos = GetVector3FromElement(child);
+                attr = templateElem->FindAttribute("MissileDamage");
+                if (attr == nullptr)  break;
+                float missileDamage = attr->FloatValue();
 
-            // Read the Rotation element.
-            child = transformElem->FirstChildElement("Rotation");
-            if (child != nullptr)
-            {
-                rot = GetVector3FromElement(child);
-                // Convert rotation from degrees to radians.
-                rot.x = ToRadians(rot.x);
-                rot.y = ToRadians(rot.y);
-                rot.z = ToRadians(rot.z);
-            }
+                attr = templateElem->FindAttribute("Missiles");
+                if (attr == nullptr)  break;
+                int missiles = attr->IntValue();
 
-            // Read the Scale element.
-            child = transformElem->FirstChildElement("Scale");
-            if (child != nullptr)
-            {
-                attr = child->FindAttribute("Value");
+                attr = templateElem->FindAttribute("Team");
                 if (attr == nullptr)
-                    return false;
-                scale = attr->FloatValue();
-            }
-        }
+                    break;
+                std::string teamStr = attr->Value();
 
-        // Build the transform matrix regardless.
-        Matrix4x4 transform(pos, rot, scale);
+                Team teamEnum = Team::TeamA;
+                if (teamStr == "TeamA")
+                    teamEnum = Team::TeamA;
+                else if (teamStr == "TeamB")
+                    teamEnum = Team::TeamB;
+                else if (teamStr == "TeamC")
+                    teamEnum = Team::TeamC;
 
-        // Depending on the entity type, create the appropriate entity.
-        if (entityType == "Boat")
-        {
-            // For Boat entities, also read a <Speed> element.
-            float speed = 0.0f;
-            XMLElement* speedElem = element->FirstChildElement("Speed");
-            if (speedElem != nullptr)
-                speed = speedElem->FloatAttribute("Value", 0.0f);
+                // Steering is optional, missing attributes keep their defaults
+                SteeringSettings steering;
+                steering.safeBoatDistance = templateElem->FloatAttribute("SafeBoatDistance", steering.safeBoatDistance);
+                steering.threatSpeedCap   = templateElem->FloatAttribute("ThreatSpeedCap",   steering.threatSpeedCap);
+                steering.avoidStrength    = templateElem->FloatAttribute("AvoidStrength",    steering.avoidStrength);
+                steering.avoidWeight      = templateElem->FloatAttribute("AvoidWeight",      steering.avoidWeight);
+                steering.forwardWeight    = templateElem->FloatAttribute("ForwardWeight",    steering.forwardWeight);
+                steering.turnMultiplier   = templateElem->FloatAttribute("TurnMultiplier",   steering.turnMultiplier);
+                steering.directionBlend   = templateElem->FloatAttribute("DirectionBlend",   steering.directionBlend);
 
-            mEntityManager->CreateEntity<Boat>(templateName, speed, transform, entityName);
-        }
+                desc.create = [=]()
+                {
+                    return std::make_unique<BoatTemplate>(name, mesh, maxSpeed, acceleration, turnSpeed, gunTurnSpeed,
+                                                          maxHP, missiles, missileDamage, teamEnum, steering);
+                };
+                complete = true;
+            } while (false);
 
-        else if (entityType == "Obstacle")
-        {
-            mEntityManager->CreateEntity<Obstacle>(templateName, transform, entityName);
+            if (!complete)  { LoadEntityTemplates(templates);  return false; }
         }
-        else if (entityType == "Obstacle")
-        {
-            Vector3 halfExtents(10.0f, 20.0f, 10.0f);
+        // You can add other template types here as needed.
 
-            XMLElement* collisionElem = element->FirstChildElement("Collision");
-            if (collisionElem)
+        if (desc.create)
+        {
+            // Any template type can have levels of detail
+            desc.create = [construct = std::move(desc.create), lods = ParseLODs(templateElem)]()
             {
-                // Look for a <HalfExtents> element
-                XMLElement* heElem = collisionElem->FirstChildElement("HalfExtents");
-                if (heElem)
-                {
-                    halfExtents = GetVector3FromElement(heElem);
-                }
-            }
-            // Create the obstacle with the parsed transform and half-extents.
-            mEntityManager->CreateEntity<Obstacle>(templateName, transform, entityName, halfExtents);
-        }
+                auto entityTemplate = construct();
+                AddLODs(lods, *entityTemplate);
+                return entityTemplate;
+            };
 
-        else if (entityType == "ReloadStation")
-        {
-            mEntityManager->CreateEntity<ReloadStation>(templateName, transform, entityName);
-        }
-        else
-        {
-            mEntityManager->CreateEntity<Entity>(templateName, transform);
+            // Entities created before a template registered here is constructed may be drawn as a box its size while it streams
+            // in (see EntityManager::CreateEntity). The size is read from the header of the mesh's cache, if it has one. Nothing
+            // streams without a device, so headless runs don't read them
+            EntityManager::TemplateBounds bounds;
+            if (mLazyTemplates && !mUsedTemplates.contains(name) && DX != nullptr)
+                bounds.known = Mesh::ReadBounds(mesh, importFlags, 1.0f, bounds.boundsMin, bounds.boundsMax);
+
+            // The world partition keeps the factories of the templates only streamed entities use, so it can unload them
+            if (mLazyTemplates && !mUsedTemplates.contains(name) && mStreamedTemplates.contains(name))
+                mPartition->AddTemplate(name, desc.create, bounds);
+
+            if (mLazyTemplates && !mUsedTemplates.contains(name))
+                mEntityManager->RegisterEntityTemplate(name, std::move(desc.create), bounds);
+            else
+                templates.push_back(std::move(desc));
         }
 
-        // Move to the next <Entity> element.
-        element = element->NextSiblingElement("Entity");
+        templateElem = templateElem->NextSiblingElement("EntityTemplate");
     }
 
+    LoadEntityTemplates(templates);
     return true;
 }
 
 //------------------------------------------------------------------------------
-// Helper method: Read a Vector3 from an XML element.
-// Expects the element to have uppercase attributes "X", "Y", and "Z".
-// Also supports an optional child element "Randomise" to add a random offset.
-Vector3 ParseLevel::GetVector3FromElement(XMLElement* element)
+// Construct the given templates and add them to the entity manager. The templates are constructed in parallel on
+// the job system, each one importing its meshes and loading its textures on a different thread, then added to the
+// manager in the order they were declared in the level file, so the result is the same as loading them one by one.
+// The D3D device is thread-safe, but the immediate context is not and texture loading uses it (to generate mip-maps),
+// so the context is made thread-safe while the templates load. If that isn't supported the templates load in turn
+void ParseLevel::LoadEntityTemplates(vector<TemplateDesc>& templates)
 {
-    Vector3 vec(0, 0, 0);
-    element->QueryFloatAttribute("X", &vec.x);
-    element->QueryFloatAttribute("Y", &vec.y);
-    element->QueryFloatAttribute("Z", &vec.z);
+    // Construction results, one per template, filled in by whichever thread constructs that template
+    struct Result
+    {
+        std::unique_ptr<EntityTemplate> entityTemplate;
+        string error;
+    };
+    vector<Result> results(templates.size());
 
-    // Check for an optional "Randomise" child element.
-    XMLElement* randomElem = element->FirstChildElement("Randomise");
-    if (randomElem)
+    auto loadTemplate = [&](size_t i)
     {
-        float randomVal = 0;
-        const XMLAttribute* attr = randomElem->FindAttribute("X");
-        if (attr != nullptr)
+        try
         {
-            randomVal = attr->FloatValue() * 0.5f;
-            vec.x += Random(-randomVal, randomVal);
+            results[i].entityTemplate = templates[i].create();
         }
-        attr = randomElem->FindAttribute("Y");
-        if (attr != nullptr)
+        catch (const std::runtime_error& e)
         {
-            randomVal = attr->FloatValue() * 0.5f;
-            vec.y += Random(-randomVal, randomVal);
+            results[i].entityTemplate = nullptr;
+            results[i].error = e.what(); // This picks up the error message put in the exception
         }
-        attr = randomElem->FindAttribute("Z");
-        if (attr != nullptr)
+    };
+
+    if (mJobSystem != nullptr && templates.size() > 1 && (DX == nullptr || DX->SetContextThreadSafe(true)))
+    {
+        // One template per chunk - templates vary a lot in loading time, so small chunks keep all the threads busy
+        mJobSystem->ParallelFor(templates.size(), 1, [&](size_t, size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)  loadTemplate(i);
+        });
+        if (DX != nullptr)  DX->SetContextThreadSafe(false);
+    }
+    else
+    {
+        for (size_t i = 0; i < templates.size(); ++i)  loadTemplate(i);
+    }
+
+    // Add the templates to the manager in declaration order, so a later template with the same name replaces an
+    // earlier one, and the last error is the one from the last template that failed
+    for (size_t i = 0; i < templates.size(); ++i)
+    {
+        if (results[i].entityTemplate != nullptr)
+            mEntityManager->AddEntityTemplate(templates[i].name, std::move(results[i].entityTemplate));
+        else
+            mEntityManager->SetLastError(results[i].error);
+    }
+}
+
+//------------------------------------------------------------------------------
+// Helper method: Read the optional levels of detail of a template, added to it once
+// it is constructed by AddLODs. Either numbered
+// mesh files, Mesh1="Rock_LOD1.fbx" Mesh2="Rock_LOD2.fbx", or fractions of the
+// main mesh's triangles to simplify it to, LODDetail="0.4 0.1". LODScreenSizes
+// gives the screen size below which each is used (see EntityTemplate::AddLOD),
+// otherwise each level is used from half the size of the one before it. A level
+// that fails to load is skipped along with those after it. ImpostorScreenSize
+// draws the template as an impostor beyond the last level, ImpostorScreenSize="0.02"
+// (see EntityTemplate::SetImpostor).
+//------------------------------------------------------------------------------
+ParseLevel::LODDesc ParseLevel::ParseLODs(XMLElement* templateElem)
+{
+    LODDesc lods;
+    const XMLAttribute* attr = templateElem->FindAttribute("LODScreenSizes");
+    if (attr != nullptr)  lods.screenSizes = ParseFloatList(attr->Value());
+
+    for (unsigned int level = 0; ; ++level)
+    {
+        attr = templateElem->FindAttribute(("Mesh" + std::to_string(level + 1)).c_str());
+        if (attr == nullptr)  break;
+        lods.meshes.push_back(attr->Value());
+    }
+
+    attr = templateElem->FindAttribute("LODDetail");
+    if (attr != nullptr)  lods.details = ParseFloatList(attr->Value());
+
+    templateElem->QueryFloatAttribute("ImpostorScreenSize", &lods.impostorScreenSize);
+    return lods;
+}
+
+// Add the levels of detail read by ParseLODs to a newly constructed template
+void ParseLevel::AddLODs(const LODDesc& lods, EntityTemplate& entityTemplate)
+{
+    auto screenSize = [&](unsigned int level) {
+        if (level < lods.screenSizes.size())  return lods.screenSizes[level];
+        return DEFAULT_LOD_SCREEN_SIZE / static_cast<float>(1 << level);
+    };
+
+    try
+    {
+        // Numbered mesh files take priority over simplified levels
+        for (unsigned int level = 0; level < lods.meshes.size(); ++level)
+            entityTemplate.AddLOD(lods.meshes[level], screenSize(level));
+
+        if (entityTemplate.LODCount() == 1)
         {
-            randomVal = attr->FloatValue() * 0.5f;
-            vec.z += Random(-randomVal, randomVal);
+            for (unsigned int level = 0; level < lods.details.size(); ++level)
+                entityTemplate.AddSimplifiedLOD(lods.details[level], screenSize(level));
         }
     }
-    return vec;
+    catch (const std::runtime_error&) {
+        // The template is still usable with the levels added so far
+    }
+
+    try
+    {
+        if (lods.impostorScreenSize > 0)  entityTemplate.SetImpostor(lods.impostorScreenSize);
+    }
+    catch (const std::runtime_error&) {
+        // An impostor size that overlaps the levels of detail is ignored
+    }
+}
+
+//------------------------------------------------------------------------------
+// Helper method: Read a space separated list of numbers, e.g. "0.4 0.1"
+//------------------------------------------------------------------------------
+vector<float> ParseLevel::ParseFloatList(const string& values)
+{
+    vector<float> list;
+    const char* value = values.c_str();
+    char* end = nullptr;
+    for (float number = std::strtof(value, &end); end != value; number = std::strtof(value, &end))
+    {
+        list.push_back(number);
+        value = end;
+    }
+    return list;
+}
+
+//------------------------------------------------------------------------------
+// Helper method: Read mesh import flags from a space separated list of flag names,
+// e.g. ImportFlags="NoLighting OptimiseVertexOrder". Unknown names are ignored.
+//------------------------------------------------------------------------------
+ImportFlags ParseLevel::ParseImportFlags(const string& flagNames)
+{
+    ImportFlags flags = {};
+    size_t start = 0;
+    while (start < flagNames.length())
+    {
+        size_t end = flagNames.find(' ', start);
+        if (end == string::npos)  end = flagNames.length();
+        string flagName = flagNames.substr(start, end - start);
+        if      (flagName == "NoLighting")          flags |= ImportFlags::NoLighting;
+        else if (flagName == "CompressVertices")    flags |= ImportFlags::CompressVertices;
+        else if (flagName == "CompressPositions")   flags |= ImportFlags::CompressPositions;
+        else if (flagName == "OptimiseVertexOrder") flags |= ImportFlags::OptimiseVertexOrder;
+        else if (flagName == "TextureArrays")       flags |= ImportFlags::TextureArrays;
+        start = end + 1;
+    }
+    return flags;
 }
@@ -13,15 +13,77 @@
 #include "ReloadStation.h" // For ReloadStation type
 #include "Obstacle.h"      // For Obstacle type
 #include "Entity.h"        // For generic Entity
+#include "JobSystem.h"     // For loading templates in parallel
+#include "WorldPartition.h" // For streamed levels
+#include "AssetFiles.h"    // For AssetInfo
 
 #include <string>
 #include <vector>
+#include <set>
+#include <memory>
+#include <functional>
+#include <stdint.h>
 using std::string;
 using std::vector;
 
+// How one kind of pickup or hazard is spawned during play, see SpawnDirector.h
+struct SpawnSettings
+{
+    float    minInterval;  // Seconds from one spawn to the next, chosen at random between these
+    float    maxInterval;
+    float    minFirst;     // Seconds to the first one, likewise
+    float    maxFirst;
+    float    height;       // They appear below the water and float up
+    uint32_t perStep;      // Most spawned in one simulation step, when catching up after a long one
+};
+
+// Settings of the level as a whole, from an optional <Settings> element in the <Scene>, e.g.
+//     <Settings MaxCrates="8" MaxMines="10" SpawnRange="250" CellSize="500" MaxSpawned="16" SpawnsPerStep="2" SpawnBudget="0.5">
+//         <CrateSpawns MinInterval="12" MaxInterval="20" MinFirst="3" MaxFirst="6" Height="-10" PerStep="1" />
+//         <MineSpawns  MinInterval="12" MaxInterval="15" MinFirst="5" MaxFirst="8" Height="-20" PerStep="1" />
+//     </Settings>
+struct LevelSettings
+{
+    uint32_t maxCrates  = 8;      // Most random crates and sea mines in play at once
+    uint32_t maxMines   = 10;
+    float    spawnRange = 250.0f; // Crates and mines appear up to this far from the centre of the level on X and Z
+    float    cellSize   = 0.0f;   // Size of the cells the level is streamed in, 0 to create it all at once (see WorldPartition.h)
+
+    SpawnSettings crateSpawns = { 12.0f, 20.0f, 3.0f, 6.0f, -10.0f, 1 };
+    SpawnSettings mineSpawns  = { 12.0f, 15.0f, 5.0f, 8.0f, -20.0f, 1 };
+    uint32_t maxSpawned    = 0;    // Most crates and mines in play together, 0 for no limit but their own
+    uint32_t spawnsPerStep = 2;    // Most crates and mines spawned in one step
+    float    spawnBudget   = 0.5f; // Milliseconds of spawning in one step, spawns over it wait for the next step
+};
+
+// A level as it was last loaded or reloaded, kept to hot reload it (see ParseLevel::ReloadFile)
+struct LoadedLevel
+{
+    vector<uint8_t>  compiled;  // The compiled level its entities were created from
+    vector<EntityID> entityIds; // The entity created from each of its entity records, NO_ID if none was (e.g. streamed)
+    AssetInfo        source;    // Size and time of the level file when it was read, to notice when it has been edited
+};
+
+// What a hot reload changed
+struct LevelReloadStats
+{
+    uint32_t templatesReloaded = 0;
+    uint32_t entitiesKept      = 0; // Records that hadn't changed
+    uint32_t entitiesPatched   = 0; // Plain entities moved in place
+    uint32_t entitiesCreated   = 0;
+    uint32_t entitiesDestroyed = 0;
+};
+
 /*---------------------------------------------------------------------------------------------
     ParseLevel class
     Reads and sets up a level by parsing an XML file.
+
+    Levels are written in XML, but reading a large level's DOM and searching the attributes of
+    every entity is slow, so the XML is first compiled to a flat binary level (see CompileFile):
+    a string table, the templates, then a fixed-layout record for each entity. The entities are
+    created straight from the records. The compiled level is saved beside the XML file (e.g.
+    Entities.xml.level) and loaded instead of the XML while the XML is unchanged, or if only
+    the compiled level has been shipped (see LEVEL_FILE_VERSION in the cpp).
 ---------------------------------------------------------------------------------------------*/
 class ParseLevel
 {
@@ -30,25 +92,80 @@ class ParseLevel
         Construction
     ---------------------------------------------------------------------------------------------*/
 public:
-    // Constructor just stores a pointer to the entity manager so all methods below can access it
-    ParseLevel(EntityManager& entityManager) : mEntityManager(&entityManager) 
+    // Constructor just stores a pointer to the entity manager so all methods below can access it. If a job system
+    // is given, the entity templates are loaded in parallel on it. With lazy templates, only the templates used by
+    // the level's entities are loaded, the others are registered to load when first used (see
+    // EntityManager::RegisterEntityTemplate). If a world partition is given and the level has a cell size, the level's
+    // scenery and obstacles are added to the partition's cells to be streamed in rather than created (see WorldPartition.h)
+    ParseLevel(EntityManager& entityManager, JobSystem* jobSystem = nullptr, bool lazyTemplates = false,
+               WorldPartition* partition = nullptr)
+        : mEntityManager(&entityManager), mJobSystem(jobSystem), mLazyTemplates(lazyTemplates), mPartition(partition)
     {}
 
     /*-----------------------------------------------------------------------------------------
         Usage
     -----------------------------------------------------------------------------------------*/
 public:
-    bool ParseFile(const string& fileName);
+    // Create all the templates and entities in the given level file, from its compiled level if that is up to date. If
+    // loaded is given it is filled in for ReloadFile. If the file is being read ahead by Preload, waits for that and uses it
+    bool ParseFile(const string& fileName, LoadedLevel* loaded = nullptr);
+
+    // Read a level file ahead of parsing it, on the given job system, so the reading overlaps other startup work such as
+    // creating the window and D3D device. The compiled level is read (or compiled), then the mesh caches of the templates
+    // the level's created entities use are read and checked in parallel (see PreloadMeshCache). Needs no D3D device, nothing
+    // is created on the GPU until ParseFile. The job system must outlive the next ParseFile, which waits for the jobs
+    static void Preload(const string& fileName, JobSystem& jobSystem);
+
+    // Apply the changes in an edited level file to the level as it was loaded, rather than loading it again. The file is
+    // compiled and compared with the loaded level record by record:
+    //  - A template whose element has changed is constructed again (its unchanged meshes and textures are shared from the
+    //    old template) and all its entities are created again
+    //  - Entities whose element is unchanged are left as they are
+    //  - Plain entities that have only moved are moved, other changed entities are destroyed and created again
+    //  - Entities that have gone are destroyed and new ones created
+    // Templates removed from the file are left loaded. Returns false with the error set if the file can't be compiled, in which
+    // case nothing is changed. A level streamed in cells can't be reloaded. Call between updates on the main thread
+    bool ReloadFile(const string& fileName, LoadedLevel& loaded, LevelReloadStats& stats, string& error);
+
+    // Settings of the level last parsed, the defaults if it had none
+    const LevelSettings& Settings()  { return mSettings; }
+
+    // Compile the given XML level file into the binary level format. Returns false if it can't be read or parsed.
+    // Random offsets in the XML (<Randomise>) are kept as ranges and chosen each time the level is loaded
+    static bool CompileFile(const string& fileName, vector<uint8_t>& compiled);
 
     /*-----------------------------------------------------------------------------------------
         Private Helpers
     -----------------------------------------------------------------------------------------*/
 private:
-    bool ParseSceneElement(tinyxml2::XMLElement* rootElement);
+    // Create the templates and entities of a compiled level, returns false if it is damaged. The ID of the entity created from
+    // each record is put in entityIds if it is given
+    bool LoadCompiled(const uint8_t* data, size_t size, vector<EntityID>* entityIds);
+
     bool ParseEntityTemplates(tinyxml2::XMLElement* templatesElem);
-    bool ParseEntitiesElement(tinyxml2::XMLElement* entitiesElem);
 
-    Vector3 GetVector3FromElement(tinyxml2::XMLElement* rootElement);
+    static ImportFlags ParseImportFlags(const string& flagNames);
+    static vector<float> ParseFloatList(const string& values);
+
+    // Levels of detail read from a template element, added to the template once it is constructed. Kept apart from
+    // the XML so templates can be constructed after the document is gone
+    struct LODDesc
+    {
+        vector<string> meshes;      // Numbered mesh files, these take priority over simplified levels
+        vector<float>  details;     // Fractions of the main mesh's triangles for simplified levels
+        vector<float>  screenSizes; // Given in the file, defaults are used for the rest
+        float          impostorScreenSize = 0; // Below which entities are drawn as impostors, 0 for none
+    };
+    static LODDesc ParseLODs(tinyxml2::XMLElement* templateElem);
+    static void AddLODs(const LODDesc& lods, EntityTemplate& entityTemplate);
+
+    // An entity template read from the level file but not yet constructed
+    struct TemplateDesc
+    {
+        string name;
+        std::function<std::unique_ptr<EntityTemplate>()> create; // Constructs the template and its LODs, may throw std::runtime_error
+    };
+    void LoadEntityTemplates(vector<TemplateDesc>& templates);
 
     /*---------------------------------------------------------------------------------------------
         Private Data
@@ -57,6 +174,23 @@ private:
     // Constructer is passed a pointer to an entity manager used to create templates and
     // entities as they are parsed
     EntityManager* mEntityManager;
+
+    // Job system used to load entity templates in parallel, nullptr to load them in turn
+    JobSystem* mJobSystem;
+
+    // Whether templates no entity in the level uses are left to load when needed, and the templates that are used
+    bool             mLazyTemplates;
+    std::set<string> mUsedTemplates;
+
+    // World partition given the streamed entities, nullptr to create them all, and the templates only they use
+    WorldPartition*  mPartition;
+    std::set<string> mStreamedTemplates;
+
+    LevelSettings mSettings;
+
+    // Screen size below which the first level of detail of a template is used, when the
+    // level file doesn't give one
+    static constexpr float DEFAULT_LOD_SCREEN_SIZE = 0.15f;
 };
 
 #endif // _PARSE_LEVEL_H_INCLUDED_